@@ -2,6 +2,10 @@
 #include <lib/platform_efi/uefi.h>
 #include <lib/platform_efi/enable_avx.h>
 #include <src/platform/m256.h>
+#include <src/platform/memory_vectorized.h>
+#include <src/platform/memory.h>
+#include <src/kangaroo_twelve.h>
+#include <src/four_q.h>
 
 #define EFI_TEXT(s) (CHAR16*)(L##s)
 
@@ -9,6 +13,11 @@
 EFI_SYSTEM_TABLE *gSystemTable = nullptr;
 static unsigned long long g_tsc_frequency = 0;
 
+// Copy of everything printed with print_line(), written to RESULTS_FILE_NAME on the file system at the end
+#define RESULTS_FILE_NAME EFI_TEXT("benchmark_results.txt")
+static CHAR16 g_results[128 * 1024];
+static unsigned long long g_results_length = 0;
+
 // Helper function to convert unsigned long long to CHAR16 hex string
 void ull_to_hex_str(unsigned long long n, CHAR16* out_str) {
     if (out_str == nullptr) return;
@@ -64,6 +73,13 @@ void print_line(const CHAR16* str) {
         gSystemTable->ConOut->OutputString(gSystemTable->ConOut, (CHAR16*)str);
         gSystemTable->ConOut->OutputString(gSystemTable->ConOut, EFI_TEXT("\r\n"));
     }
+    for (int i = 0; str[i] != L'\0' && g_results_length < sizeof(g_results) / sizeof(g_results[0]) - 2; ++i) {
+        g_results[g_results_length++] = str[i];
+    }
+    if (g_results_length < sizeof(g_results) / sizeof(g_results[0]) - 2) {
+        g_results[g_results_length++] = L'\r';
+        g_results[g_results_length++] = L'\n';
+    }
 }
 
 #if defined(__clang__)
@@ -290,12 +306,524 @@ static void run_zero_benchmark(uint32_t iterations) {
     print_line(L""); // Blank line for spacing
 }
 
+// Helper to print a string followed by a decimal value and newline
+void print_value_dec(const CHAR16* prefix, unsigned long long value) {
+    CHAR16 buffer[256];
+    int i = 0;
+    while (prefix[i] != L'\0' && i < 200) {
+        buffer[i] = prefix[i];
+        i++;
+    }
+    buffer[i++] = L' ';
+
+    CHAR16 digits[21];
+    int n = 0;
+    do {
+        digits[n++] = L'0' + (CHAR16)(value % 10);
+        value /= 10;
+    } while (value);
+    while (n > 0) {
+        buffer[i++] = digits[--n];
+    }
+    buffer[i] = L'\0';
+
+    print_line(buffer);
+}
+
+#if defined(__clang__)
+void print_value_dec(const wchar_t* prefix, unsigned long long value) {
+    print_value_dec((CHAR16*)(prefix), value);
+}
+#endif
+
+#if !defined(NDEBUG)
+// Declared in src/platform/assert.h (used by ASSERT of the core headers)
+static void addDebugMessageAssert(const char* message, const char* file, const unsigned int lineNumber) {
+    print_value_dec(L"Assertion failed in line", lineNumber);
+}
+#endif
+
+// Open root directory of the first file system (the boot volume if there is only one). Returns nullptr on failure.
+static EFI_FILE_PROTOCOL* open_file_system_root() {
+    EFI_GUID simpleFileSystemProtocolGuid = EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_GUID;
+    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL* simpleFileSystemProtocol = nullptr;
+    EFI_FILE_PROTOCOL* root = nullptr;
+    if (gSystemTable->BootServices->LocateProtocol(&simpleFileSystemProtocolGuid, nullptr, (void**)&simpleFileSystemProtocol)
+        || simpleFileSystemProtocol->OpenVolume(simpleFileSystemProtocol, (void**)&root)) {
+        return nullptr;
+    }
+    return root;
+}
+
+// Write and read a temporary file with each chunk size (size of single EFI_FILE_PROTOCOL request) and print the
+// throughput in MB/s, for choosing READING_CHUNK_SIZE / WRITING_CHUNK_SIZE / MAX_FILE_IO_CHUNK_SIZE of the node.
+static void run_file_io_benchmark(unsigned long long totalSize) {
+    print_line(L"--- Starting File I/O Benchmark ---");
+
+    if (!g_tsc_frequency) {
+        print_line(L"TSC frequency unknown, skipping.");
+        print_line(L"--- File I/O Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+
+    EFI_FILE_PROTOCOL* root = open_file_system_root();
+    if (!root) {
+        print_line(L"No file system found, skipping.");
+        print_line(L"--- File I/O Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+
+    unsigned char* buffer = nullptr;
+    if (gSystemTable->BootServices->AllocatePool(EfiLoaderData, totalSize, (void**)&buffer)) {
+        print_line(L"Cannot allocate buffer, skipping.");
+        root->Close(root);
+        print_line(L"--- File I/O Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+    for (unsigned long long i = 0; i < totalSize; i += 8) {
+        *((unsigned long long*)(buffer + i)) = i * 0x9E3779B97F4A7C15ULL;
+    }
+
+    CHAR16* fileName = EFI_TEXT("io_benchmark.tmp");
+    print_value_dec(L"Bytes per file:", totalSize);
+    for (unsigned long long chunkSize = 16384; chunkSize <= 16 * 1024 * 1024; chunkSize *= 2) {
+        print_value_dec(L"Chunk size (bytes):", chunkSize);
+
+        for (int write = 1; write >= 0; --write) {
+            EFI_FILE_PROTOCOL* file = nullptr;
+            unsigned long long openMode = write ? (EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE) : EFI_FILE_MODE_READ;
+            if (root->Open(root, (void**)&file, fileName, openMode, 0)) {
+                print_line(L"  Cannot open file.");
+                break;
+            }
+
+            bool failed = false;
+            unsigned long long start_tsc = __rdtsc();
+            for (unsigned long long pos = 0; pos < totalSize; pos += chunkSize) {
+                unsigned long long size = (chunkSize <= totalSize - pos) ? chunkSize : totalSize - pos;
+                const unsigned long long requestedSize = size;
+                EFI_STATUS status = write ? file->Write(file, &size, buffer + pos) : file->Read(file, &size, buffer + pos);
+                if (status || size != requestedSize) {
+                    failed = true;
+                    break;
+                }
+            }
+            if (write) {
+                file->Flush(file);
+            }
+            unsigned long long cycles = __rdtsc() - start_tsc;
+            file->Close(file);
+
+            if (failed) {
+                print_line(write ? L"  Write failed (chunk size not supported by file system driver)." : L"  Read failed (chunk size not supported by file system driver).");
+                break;
+            }
+            if (!cycles) {
+                cycles = 1;
+            }
+            print_value_dec(write ? L"  Write (MB/s):" : L"  Read (MB/s):", totalSize * g_tsc_frequency / cycles / (1024 * 1024));
+        }
+    }
+
+    EFI_FILE_PROTOCOL* file = nullptr;
+    if (!root->Open(root, (void**)&file, fileName, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0)) {
+        file->Delete(file);
+    }
+    root->Close(root);
+    gSystemTable->BootServices->FreePool(buffer);
+
+    print_line(L"--- File I/O Benchmark Complete ---");
+    print_line(L""); // Blank line for spacing
+}
+
+// Measure throughput of firmware SetMem/CopyMem and the vectorized setMem/copyMem of the node for buffers of
+// different size (small copies of network messages up to multi-MB copies of spectrum and tick storage).
+static void run_memory_benchmark(unsigned long long maxSize) {
+    print_line(L"--- Starting Memory Benchmark ---");
+
+    if (!g_tsc_frequency) {
+        print_line(L"TSC frequency unknown, skipping.");
+        print_line(L"--- Memory Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+
+    EFI_BOOT_SERVICES* bs = gSystemTable->BootServices;
+    unsigned char* source = nullptr;
+    unsigned char* destination = nullptr;
+    if (bs->AllocatePool(EfiLoaderData, maxSize + 64, (void**)&source)
+        || bs->AllocatePool(EfiLoaderData, maxSize + 64, (void**)&destination)) {
+        print_line(L"Cannot allocate buffers, skipping.");
+        if (source) {
+            bs->FreePool(source);
+        }
+        print_line(L"--- Memory Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+    for (unsigned long long i = 0; i < maxSize; i += 8) {
+        *((unsigned long long*)(source + i)) = i * 0x9E3779B97F4A7C15ULL;
+    }
+
+    // process about 1 GB per measurement; offset 1 of the destination tests the unaligned case
+    const unsigned long long totalBytes = 1024ULL * 1024 * 1024;
+    for (unsigned long long size = 256; size <= maxSize; size *= 16) {
+        const unsigned long long iterations = (totalBytes / size) ? totalBytes / size : 1;
+        print_value_dec(L"Size (bytes):", size);
+        for (unsigned long long offset = 0; offset <= 1; ++offset) {
+            unsigned char* dst = destination + offset;
+            unsigned long long cycles[4];
+
+            unsigned long long start_tsc = __rdtsc();
+            for (unsigned long long i = 0; i < iterations; ++i) {
+                bs->SetMem(dst, size, (unsigned char)i);
+            }
+            cycles[0] = __rdtsc() - start_tsc;
+
+            start_tsc = __rdtsc();
+            for (unsigned long long i = 0; i < iterations; ++i) {
+                setMemVectorized(dst, size, (unsigned char)i);
+            }
+            cycles[1] = __rdtsc() - start_tsc;
+
+            start_tsc = __rdtsc();
+            for (unsigned long long i = 0; i < iterations; ++i) {
+                bs->CopyMem(dst, source, size);
+            }
+            cycles[2] = __rdtsc() - start_tsc;
+
+            start_tsc = __rdtsc();
+            for (unsigned long long i = 0; i < iterations; ++i) {
+                copyMemVectorized(dst, source, size);
+            }
+            cycles[3] = __rdtsc() - start_tsc;
+
+            const CHAR16* labels[4] = {
+                offset ? EFI_TEXT("  Firmware SetMem, unaligned (MB/s):") : EFI_TEXT("  Firmware SetMem (MB/s):"),
+                offset ? EFI_TEXT("  Vectorized setMem, unaligned (MB/s):") : EFI_TEXT("  Vectorized setMem (MB/s):"),
+                offset ? EFI_TEXT("  Firmware CopyMem, unaligned (MB/s):") : EFI_TEXT("  Firmware CopyMem (MB/s):"),
+                offset ? EFI_TEXT("  Vectorized copyMem, unaligned (MB/s):") : EFI_TEXT("  Vectorized copyMem (MB/s):"),
+            };
+            for (int j = 0; j < 4; ++j) {
+                print_value_dec(labels[j], iterations * size * g_tsc_frequency / (cycles[j] ? cycles[j] : 1) / (1024 * 1024));
+            }
+        }
+    }
+
+    bs->FreePool(source);
+    bs->FreePool(destination);
+
+    print_line(L"--- Memory Benchmark Complete ---");
+    print_line(L""); // Blank line for spacing
+}
+
+// Print cycles per operation and, if the TSC frequency is known, operations per second
+static void print_cycles_per_op(const CHAR16* label, unsigned long long cycles, unsigned long long ops) {
+    CHAR16 buffer[200];
+    int i = 0;
+    while (label[i] != L'\0' && i < 150) {
+        buffer[i] = label[i];
+        i++;
+    }
+    buffer[i] = L'\0';
+    print_value_dec(buffer, cycles / (ops ? ops : 1));
+    if (g_tsc_frequency && cycles) {
+        print_value_dec(L"    ops/s:", ops * g_tsc_frequency / cycles);
+    }
+}
+
+#if defined(__clang__)
+static void print_cycles_per_op(const wchar_t* label, unsigned long long cycles, unsigned long long ops) {
+    print_cycles_per_op((CHAR16*)(label), cycles, ops);
+}
+#endif
+
+// Measure KangarooTwelve for message sizes used by the node: 32 bytes (digests of digests), 64 bytes with the
+// specialized KangarooTwelve64To32() (Merkle tree nodes), transactions up to 1 KB, and multi-MB state digests.
+static void run_k12_benchmark() {
+    print_line(L"--- Starting KangarooTwelve Benchmark ---");
+
+    const unsigned long long maxSize = 16 * 1024 * 1024;
+    unsigned char* input = nullptr;
+    if (!allocatePool(maxSize, (void**)&input)) {
+        print_line(L"Cannot allocate buffer, skipping.");
+        print_line(L"--- KangarooTwelve Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+    for (unsigned long long i = 0; i < maxSize; i += 8) {
+        *((unsigned long long*)(input + i)) = i * 0x9E3779B97F4A7C15ULL;
+    }
+
+    m256i digest = m256i::zero();
+    unsigned long long accumulator = 0;
+    const unsigned long long iterations = 100000;
+
+    unsigned long long start_tsc = __rdtsc();
+    for (unsigned long long i = 0; i < iterations; ++i) {
+        input[0] = (unsigned char)i;
+        KangarooTwelve64To32(input, &digest);
+        accumulator += digest.m256i_u64[0];
+    }
+    print_cycles_per_op(L"KangarooTwelve64To32 (cycles/op):", __rdtsc() - start_tsc, iterations);
+
+    start_tsc = __rdtsc();
+    for (unsigned long long i = 0; i < iterations; i += 16) {
+        KangarooTwelve64To32Batch(input, input + maxSize / 2, 16);
+        accumulator += input[maxSize / 2];
+    }
+    print_cycles_per_op(L"KangarooTwelve64To32Batch (cycles/op):", __rdtsc() - start_tsc, iterations);
+
+    for (unsigned long long size = 32; size <= maxSize; size *= 8) {
+        const unsigned long long sizeIterations = (size <= 1024 * 1024) ? (64 * 1024 * 1024) / size : 4;
+        start_tsc = __rdtsc();
+        for (unsigned long long i = 0; i < sizeIterations; ++i) {
+            input[0] = (unsigned char)i;
+            KangarooTwelve(input, (unsigned int)size, digest.m256i_u8, 32);
+            accumulator += digest.m256i_u64[0];
+        }
+        const unsigned long long cycles = __rdtsc() - start_tsc;
+        print_value_dec(L"Message size (bytes):", size);
+        print_cycles_per_op(L"  KangarooTwelve (cycles/op):", cycles, sizeIterations);
+        if (g_tsc_frequency) {
+            print_value_dec(L"  KangarooTwelve (MB/s):", sizeIterations * size * g_tsc_frequency / (cycles ? cycles : 1) / (1024 * 1024));
+        }
+    }
+    print_value_hex(L"Accumulator (K12):", accumulator);
+
+    freePool(input);
+
+    print_line(L"--- KangarooTwelve Benchmark Complete ---");
+    print_line(L""); // Blank line for spacing
+}
+
+// Rebuild a Merkle tree of 2^depth leaf digests level by level, as done for the spectrum and universe digests
+static void run_merkle_benchmark(unsigned int depth) {
+    print_line(L"--- Starting Merkle Tree Benchmark ---");
+
+    const unsigned long long leafCount = 1ULL << depth;
+    m256i* digests = nullptr;
+    if (!allocatePool((leafCount * 2 - 1) * sizeof(m256i), (void**)&digests)) {
+        print_line(L"Cannot allocate buffer, skipping.");
+        print_line(L"--- Merkle Tree Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+    for (unsigned long long i = 0; i < leafCount; ++i) {
+        digests[i] = m256i(i, i * 0x9E3779B97F4A7C15ULL, ~i, depth);
+    }
+
+    unsigned long long start_tsc = __rdtsc();
+    m256i* level = digests;
+    for (unsigned long long levelSize = leafCount; levelSize > 1; levelSize /= 2) {
+        KangarooTwelve64To32Batch(level, level + levelSize, levelSize / 2);
+        level += levelSize;
+    }
+    const unsigned long long cycles = __rdtsc() - start_tsc;
+
+    print_value_dec(L"Leaves:", leafCount);
+    print_value_dec(L"Total cycles (Merkle rebuild):", cycles);
+    print_cycles_per_op(L"Cycles per inner node:", cycles, leafCount - 1);
+    print_value_hex(L"Root digest (first 8 bytes):", digests[leafCount * 2 - 2].m256i_u64[0]);
+
+    freePool(digests);
+
+    print_line(L"--- Merkle Tree Benchmark Complete ---");
+    print_line(L""); // Blank line for spacing
+}
+
+// Key pair and signed message used by the FourQ and multi-core benchmarks
+static m256i g_subseed, g_publicKey, g_messageDigest;
+static unsigned char g_signature[64];
+
+static void run_fourq_benchmark(unsigned int iterations) {
+    print_line(L"--- Starting FourQ Benchmark ---");
+
+    if (iterations == 0) {
+        print_line(L"No iterations performed.");
+        print_line(L"--- FourQ Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+
+    g_subseed = m256i(0x0123456789ABCDEFULL, 0x9E3779B97F4A7C15ULL, __rdtsc(), 42);
+    m256i privateKey;
+    unsigned long long start_tsc = __rdtsc();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        g_subseed.m256i_u32[7] = i;
+        getPrivateKey(g_subseed.m256i_u8, privateKey.m256i_u8);
+        getPublicKey(privateKey.m256i_u8, g_publicKey.m256i_u8);
+    }
+    print_cycles_per_op(L"Key generation (cycles/op):", __rdtsc() - start_tsc, iterations);
+
+    unsigned long long accumulator = 0;
+    start_tsc = __rdtsc();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        g_messageDigest = m256i(i, 2 * i, 3 * i, 4 * i);
+        sign(g_subseed.m256i_u8, g_publicKey.m256i_u8, g_messageDigest.m256i_u8, g_signature);
+        accumulator += g_signature[0];
+    }
+    print_cycles_per_op(L"Sign (cycles/op):", __rdtsc() - start_tsc, iterations);
+
+    unsigned long long validCount = 0;
+    start_tsc = __rdtsc();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        validCount += verify(g_publicKey.m256i_u8, g_messageDigest.m256i_u8, g_signature);
+    }
+    print_cycles_per_op(L"Verify (cycles/op):", __rdtsc() - start_tsc, iterations);
+    print_value_dec(L"Valid signatures:", validCount);
+    print_value_hex(L"Accumulator (FourQ):", accumulator);
+
+    print_line(L"--- FourQ Benchmark Complete ---");
+    print_line(L""); // Blank line for spacing
+}
+
+// Work distributed to application processors (APs) by the multi-core benchmark. Only the first participantCount APs
+// that start the procedure do the work, so the scaling can be measured with StartupAllAPs().
+struct MultiCoreJob {
+    void (*work)(unsigned long long ops);
+    unsigned long long opsPerProcessor;
+    long participantCount;
+    volatile long startedCount;
+};
+
+static void __cdecl run_multicore_job(void* argument) {
+    MultiCoreJob* job = (MultiCoreJob*)argument;
+    enableAVX();
+    if (_InterlockedIncrement(&job->startedCount) <= job->participantCount) {
+        job->work(job->opsPerProcessor);
+    }
+}
+
+static volatile unsigned long long g_multicore_accumulator = 0;
+
+static void multicore_k12_work(unsigned long long ops) {
+    unsigned char message[1024];
+    m256i digest;
+    for (unsigned int i = 0; i < sizeof(message); ++i) {
+        message[i] = (unsigned char)i;
+    }
+    for (unsigned long long i = 0; i < ops; ++i) {
+        message[0] = (unsigned char)i;
+        KangarooTwelve(message, sizeof(message), digest.m256i_u8, 32);
+    }
+    _InterlockedExchangeAdd64((volatile long long*)&g_multicore_accumulator, digest.m256i_u64[0]);
+}
+
+static void multicore_verify_work(unsigned long long ops) {
+    unsigned long long validCount = 0;
+    for (unsigned long long i = 0; i < ops; ++i) {
+        validCount += verify(g_publicKey.m256i_u8, g_messageDigest.m256i_u8, g_signature);
+    }
+    _InterlockedExchangeAdd64((volatile long long*)&g_multicore_accumulator, validCount);
+}
+
+// Run K12 of 1 KB messages (transaction digests) and signature verification on 1, 2, 4, ... APs through the MP
+// services and print throughput and speedup (in percent of one AP). Requires run_fourq_benchmark() before.
+static void run_multicore_benchmark() {
+    print_line(L"--- Starting Multi-Core Benchmark ---");
+
+    EFI_GUID mpServicesProtocolGuid = EFI_MP_SERVICES_PROTOCOL_GUID;
+    EFI_MP_SERVICES_PROTOCOL* mpServices = nullptr;
+    unsigned long long numberOfAllProcessors = 0, numberOfEnabledProcessors = 0;
+    if (!g_tsc_frequency
+        || gSystemTable->BootServices->LocateProtocol(&mpServicesProtocolGuid, nullptr, (void**)&mpServices)
+        || mpServices->GetNumberOfProcessors(mpServices, &numberOfAllProcessors, &numberOfEnabledProcessors)
+        || numberOfEnabledProcessors < 2) {
+        print_line(L"MP services or TSC frequency not available, skipping.");
+        print_line(L"--- Multi-Core Benchmark Complete ---");
+        print_line(L"");
+        return;
+    }
+    const unsigned long long numberOfAPs = numberOfEnabledProcessors - 1;
+    print_value_dec(L"Application processors:", numberOfAPs);
+
+    struct {
+        const CHAR16* name;
+        void (*work)(unsigned long long ops);
+        unsigned long long opsPerProcessor;
+    } workloads[2] = {
+        { EFI_TEXT("K12 1 KB"), multicore_k12_work, 20000 },
+        { EFI_TEXT("Verify"), multicore_verify_work, 500 },
+    };
+    for (int w = 0; w < 2; ++w) {
+        print_line(workloads[w].name);
+        unsigned long long singleOpsPerSecond = 0;
+        for (unsigned long long participants = 1; ; participants *= 2) {
+            if (participants > numberOfAPs) {
+                participants = numberOfAPs;
+            }
+            MultiCoreJob job;
+            job.work = workloads[w].work;
+            job.opsPerProcessor = workloads[w].opsPerProcessor;
+            job.participantCount = (long)participants;
+            job.startedCount = 0;
+
+            const unsigned long long start_tsc = __rdtsc();
+            // blocking call, returns after all APs have finished
+            if (mpServices->StartupAllAPs(mpServices, run_multicore_job, FALSE, nullptr, 0, &job, nullptr)) {
+                print_line(L"  StartupAllAPs() failed.");
+                break;
+            }
+            const unsigned long long cycles = __rdtsc() - start_tsc;
+
+            const unsigned long long opsPerSecond = participants * job.opsPerProcessor * g_tsc_frequency / (cycles ? cycles : 1);
+            if (participants == 1) {
+                singleOpsPerSecond = opsPerSecond;
+            }
+            print_value_dec(L"  Processors:", participants);
+            print_value_dec(L"    ops/s:", opsPerSecond);
+            print_value_dec(L"    Speedup (%):", opsPerSecond * 100 / (singleOpsPerSecond ? singleOpsPerSecond : 1));
+            if (participants == numberOfAPs) {
+                break;
+            }
+        }
+    }
+    print_value_hex(L"Accumulator (Multi-Core):", g_multicore_accumulator);
+
+    print_line(L"--- Multi-Core Benchmark Complete ---");
+    print_line(L""); // Blank line for spacing
+}
+
+// Write everything printed so far to RESULTS_FILE_NAME (UTF-16 text), replacing the file of a previous run
+static void write_results_file() {
+    EFI_FILE_PROTOCOL* root = open_file_system_root();
+    if (!root) {
+        print_line(L"No file system found, results are not saved.");
+        return;
+    }
+    EFI_FILE_PROTOCOL* file = nullptr;
+    if (!root->Open(root, (void**)&file, RESULTS_FILE_NAME, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0)) {
+        file->Delete(file);
+    }
+    if (root->Open(root, (void**)&file, RESULTS_FILE_NAME, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0)) {
+        print_line(L"Cannot create results file.");
+        root->Close(root);
+        return;
+    }
+    CHAR16 byteOrderMark = 0xFEFF;
+    unsigned long long size = sizeof(byteOrderMark);
+    EFI_STATUS status = file->Write(file, &size, &byteOrderMark);
+    size = g_results_length * sizeof(CHAR16);
+    if (!status) {
+        status = file->Write(file, &size, g_results);
+    }
+    file->Close(file);
+    root->Close(root);
+    print_line(status ? L"Writing results file failed." : L"Results written to benchmark_results.txt.");
+}
+
 EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
     // Suppress unused parameter warnings
     (void)ImageHandle;
 
     // Store SystemTable globally
     gSystemTable = SystemTable;
+    st = SystemTable;
+    bs = SystemTable->BootServices;
 
     // Basic check for SystemTable and ConOut
     if (!gSystemTable || !gSystemTable->ConOut) {
@@ -306,7 +834,7 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
     gSystemTable->ConOut->ClearScreen(gSystemTable->ConOut);
 
     enableAVX();
-    print_line(L"UEFI m256i Benchmark Application");
+    print_line(L"UEFI Core Primitives Benchmark Application");
     print_line(L"=================================");
 
     const unsigned long long iterations = 100000; // 100k iterations
@@ -321,8 +849,15 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
     run_setrandom_benchmark(iterations);
     run_zero_benchmark(iterations);
     run_rdrnd_benchmark(iterations);
+    run_memory_benchmark(256 * 1024 * 1024ULL);
+    run_file_io_benchmark(256 * 1024 * 1024ULL);
+    run_k12_benchmark();
+    run_merkle_benchmark(20);
+    run_fourq_benchmark(1000);
+    run_multicore_benchmark();
 
     print_line(L"=================================");
+    write_results_file();
     print_line(L"Benchmark complete. System will halt in a moment or press ESC to exit.");
 
     // Wait for a key press (optional, good for seeing output)
@@ -55,3 +55,42 @@ void quickSort(T* range, int first, int last, SortingOrder order)
 
     return;
 }
+
+// Reorders the elements from range[first] to range[last] so that range[k] is the element that would be at index k
+// if the range was sorted according to the given `order`, and returns it. Elements before k go before or are equal
+// to range[k], elements after k go after or are equal to range[k]. Runs in expected linear time without recursion.
+// Elements equal to the pivot are grouped in the middle (three-way partition), so ranges with many equal elements,
+// such as mostly-zero reports, don't degrade to quadratic time as with partition().
+template <typename T>
+T quickSelect(T* range, int first, int last, int k, SortingOrder order)
+{
+    constexpr auto swap = [](T& a, T& b) { T tmp = b; b = a; a = tmp; };
+    const auto goesBefore = [order](const T& a, const T& b) { return (order == SortingOrder::SortAscending) ? (a < b) : (b < a); };
+
+    while (first < last)
+    {
+        // middle element as pivot to avoid worst case for sorted input
+        const T pivot = range[first + (last - first) / 2];
+
+        // after loop: [first, lt) before pivot, [lt, i) equal to pivot, (gt, last] after pivot
+        int lt = first, i = first, gt = last;
+        while (i <= gt)
+        {
+            if (goesBefore(range[i], pivot))
+                swap(range[lt++], range[i++]);
+            else if (goesBefore(pivot, range[i]))
+                swap(range[i], range[gt--]);
+            else
+                ++i;
+        }
+
+        if (k < lt)
+            last = lt - 1;
+        else if (k > gt)
+            first = gt + 1;
+        else
+            return range[k];
+    }
+
+    return range[k];
+}
@@ -13,33 +13,31 @@
 
 #include "../public_settings.h"
 #include "../system.h"
+#include "../ticking/tick_storage.h"
 
 
-typedef struct
+// Status of the transactions of a tick, one bit per transaction slot of TickStorage (slot = index in
+// TickData::transactionDigests). The digests aren't stored here, because they are available in TickData already.
+struct TickTxStatusFlags
 {
-    unsigned int tick;
-    unsigned char moneyFlew;
-    unsigned char _padding[3];
-    m256i digest;
-} ConfirmedTx;
+    unsigned long long executed[NUMBER_OF_TRANSACTIONS_PER_TICK / 64];  // transaction has been executed
+    unsigned long long moneyFlew[NUMBER_OF_TRANSACTIONS_PER_TICK / 64]; // money has flown in executed transaction
+};
+
+static_assert(NUMBER_OF_TRANSACTIONS_PER_TICK % 64 == 0, "NUMBER_OF_TRANSACTIONS_PER_TICK must be multiple of 64");
 
-constexpr unsigned long long confirmedTxCurrentEpochLength = (((unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK / TRANSACTION_SPARSENESS);
-constexpr unsigned long long confirmedTxPreviousEpochLength = (((unsigned long long)TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK / TRANSACTION_SPARSENESS);
-constexpr unsigned long long confirmedTxLength = confirmedTxCurrentEpochLength + confirmedTxPreviousEpochLength;
+constexpr unsigned long long tickTxStatusFlagsLength = ((unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH) + TICKS_TO_KEEP_FROM_PRIOR_EPOCH;
 
-// Memory to store confirmed TX's (arrays store data of current epoch, followed by last ticks of previous epoch)
-static ConfirmedTx *confirmedTx = NULL;
-static volatile char confirmedTxLock = 0;
+// Memory to store tx status flags (array stores data of current epoch, followed by last ticks of previous epoch)
+static TickTxStatusFlags* tickTxStatusFlags = NULL;
 
 static struct
 {
-    unsigned int tickTxCounter[MAX_NUMBER_OF_TICKS_PER_EPOCH + TICKS_TO_KEEP_FROM_PRIOR_EPOCH];    // store the amount of tx per tick
-    unsigned int tickTxIndexStart[MAX_NUMBER_OF_TICKS_PER_EPOCH + TICKS_TO_KEEP_FROM_PRIOR_EPOCH]; // store the index position per tick
     unsigned int confirmedTxPreviousEpochBeginTick;  // first tick kept from previous epoch (or 0 if no tick from prev. epoch available)
     unsigned int confirmedTxCurrentEpochBeginTick;   // first tick of current epoch stored
+    unsigned int snapshotTickCount;                  // number of ticks of current epoch in snapshot
 } txStatusData;
 
-
 struct RequestTxStatus
 {
     unsigned int tick;
@@ -81,14 +79,15 @@ static RespondTxStatus* tickTxStatusStorage = NULL;
 // Allocate buffers
 static bool initTxStatusRequestAddOn()
 {
-    // Allocate pool to store confirmed TX's
-    if (!allocPoolWithErrorLog(L"confirmedTx", confirmedTxLength * sizeof(ConfirmedTx), (void**)&confirmedTx, __LINE__))
+    // Allocate pool to store tx status flags of ticks
+    if (!allocPoolWithErrorLog(L"tickTxStatusFlags", tickTxStatusFlagsLength * sizeof(TickTxStatusFlags), (void**)&tickTxStatusFlags, __LINE__))
         return false;
     // allocate tickTxStatus responses storage
     if (!allocPoolWithErrorLog(L"tickTxStatusStorage", MAX_NUMBER_OF_PROCESSORS * sizeof(RespondTxStatus), (void**)&tickTxStatusStorage, __LINE__))
         return false;
     txStatusData.confirmedTxPreviousEpochBeginTick = 0;
     txStatusData.confirmedTxCurrentEpochBeginTick = 0;
+    txStatusData.snapshotTickCount = 0;
     return true;
 }
 
@@ -96,61 +95,50 @@ static bool initTxStatusRequestAddOn()
 // Free buffers
 static void deinitTxStatusRequestAddOn()
 {
-    if (confirmedTx)
-        freePool(confirmedTx);
+    if (tickTxStatusFlags)
+    {
+        freePool(tickTxStatusFlags);
+        tickTxStatusFlags = NULL;
+    }
+    if (tickTxStatusStorage)
+    {
+        freePool(tickTxStatusStorage);
+        tickTxStatusStorage = NULL;
+    }
+}
+
+
+// Return tx status flags of tick or NULL if tick isn't available. The last ticks of the previous epoch are stored
+// first, so the data to save in a snapshot is contiguous.
+static TickTxStatusFlags* getTickTxStatusFlags(unsigned int tick)
+{
+    const unsigned int tickBegin = txStatusData.confirmedTxCurrentEpochBeginTick;
+    const unsigned int oldTickBegin = txStatusData.confirmedTxPreviousEpochBeginTick;
+    if (tick >= tickBegin && tick < tickBegin + MAX_NUMBER_OF_TICKS_PER_EPOCH)
+        return tickTxStatusFlags + TICKS_TO_KEEP_FROM_PRIOR_EPOCH + (tick - tickBegin);
+    if (oldTickBegin != 0 && tick >= oldTickBegin && tick < tickBegin)
+        return tickTxStatusFlags + (tick - oldTickBegin);
+    return NULL;
 }
 
 
 // Begin new epoch. If not called the first time (seamless transition), assume that the ticks to keep
-// are ticks in [newInitialTick-TICKS_TO_KEEP_FROM_PRIOR_EPOCH, newInitialTick-1].
+// are ticks in [newInitialTick-TICKS_TO_KEEP_FROM_PRIOR_EPOCH, newInitialTick-1], same as in TickStorage.
 static void beginEpochTxStatusRequestAddOn(unsigned int newInitialTick)
 {
     unsigned int& tickBegin = txStatusData.confirmedTxCurrentEpochBeginTick;
     unsigned int& oldTickBegin = txStatusData.confirmedTxPreviousEpochBeginTick;
 
-    bool keepTicks = tickBegin && newInitialTick > tickBegin && newInitialTick <= tickBegin + MAX_NUMBER_OF_TICKS_PER_EPOCH;
+    bool keepTicks = tickBegin && newInitialTick > tickBegin && newInitialTick < tickBegin + MAX_NUMBER_OF_TICKS_PER_EPOCH;
     if (keepTicks)
     {
-        // Seamless epoch transition: keep some ticks of prior epoch
-        // The number of ticks to keep is limited by:
-        // - the length of the previous epoch tick buffer (tickCount < TICKS_TO_KEEP_FROM_PRIOR_EPOCH)
-        // - the length of the previous epoch confirmedTx array (confirmedTxPreviousEpochLength)
-        // - the number of ticks available from in ended epoch (tickIndex >= 0)
-        unsigned int tickCount = 0;
-        unsigned int txCount = 0;
-        for (int tickIndex = (newInitialTick - 1) - tickBegin; tickIndex >= 0; --tickIndex)
-        {
-            unsigned int newTxCount = txCount + txStatusData.tickTxCounter[tickIndex];
-            if (newTxCount <= confirmedTxPreviousEpochLength && tickCount < TICKS_TO_KEEP_FROM_PRIOR_EPOCH)
-            {
-                txCount = newTxCount;
-                ++tickCount;
-            }
-            else
-            {
-                break;
-            }
-        }
-
+        // Seamless epoch transition: keep flags of last ticks of prior epoch
+        const unsigned int tickCount = (newInitialTick - tickBegin < TICKS_TO_KEEP_FROM_PRIOR_EPOCH) ? newInitialTick - tickBegin : TICKS_TO_KEEP_FROM_PRIOR_EPOCH;
         oldTickBegin = newInitialTick - tickCount;
-        const unsigned int oldTickEnd = newInitialTick;
-        const unsigned int tickIndex = oldTickBegin - tickBegin;
+        copyMem(tickTxStatusFlags, tickTxStatusFlags + TICKS_TO_KEEP_FROM_PRIOR_EPOCH + (oldTickBegin - tickBegin), tickCount * sizeof(TickTxStatusFlags));
 
-        // copy confirmedTx and tickTxCounter from recently ended epoch into storage of previous epoch
-        copyMem(txStatusData.tickTxCounter + MAX_NUMBER_OF_TICKS_PER_EPOCH, txStatusData.tickTxCounter + tickIndex, tickCount * sizeof(txStatusData.tickTxCounter[0]));
-        copyMem(confirmedTx + confirmedTxCurrentEpochLength, confirmedTx + txStatusData.tickTxIndexStart[tickIndex], txCount * sizeof(confirmedTx[0]));
-
-        // copy adjusted tickTxIndexStart
-        const unsigned int indexStartDelta = confirmedTxCurrentEpochLength - txStatusData.tickTxIndexStart[tickIndex];
-        for (unsigned int tickOffset = 0; tickOffset < tickCount; ++tickOffset)
-        {
-            txStatusData.tickTxIndexStart[MAX_NUMBER_OF_TICKS_PER_EPOCH + tickOffset] = txStatusData.tickTxIndexStart[tickIndex + tickOffset] + indexStartDelta;
-        }
-
-        // init pool of current epoch with 0
-        setMem(confirmedTx, confirmedTxCurrentEpochLength * sizeof(ConfirmedTx), 0);
-        setMem(txStatusData.tickTxCounter, MAX_NUMBER_OF_TICKS_PER_EPOCH * sizeof(txStatusData.tickTxCounter[0]), 0);
-        setMem(txStatusData.tickTxIndexStart, MAX_NUMBER_OF_TICKS_PER_EPOCH * sizeof(txStatusData.tickTxIndexStart[0]), 0);
+        // init rest of pool with 0
+        setMem(tickTxStatusFlags + tickCount, (tickTxStatusFlagsLength - tickCount) * sizeof(TickTxStatusFlags), 0);
     }
     else
     {
@@ -158,45 +146,28 @@ static void beginEpochTxStatusRequestAddOn(unsigned int newInitialTick)
         oldTickBegin = 0;
 
         // init pool with 0
-        setMem(confirmedTx, confirmedTxLength * sizeof(ConfirmedTx), 0);
-        setMem(txStatusData.tickTxCounter, sizeof(txStatusData.tickTxCounter), 0);
-        setMem(txStatusData.tickTxIndexStart, sizeof(txStatusData.tickTxIndexStart), 0);
+        setMem(tickTxStatusFlags, tickTxStatusFlagsLength * sizeof(TickTxStatusFlags), 0);
     }
 
     tickBegin = newInitialTick;
 }
 
 
-// adds a tx to the confirmed tx store
-// txNumberMinusOne: the current tx number -1
-// moneyFlew: if money has been flow
+// Mark tx as executed. Only sets bits with atomic operations, so no lock is needed.
 // tick: tick of tx (needs to be in range of current epoch)
-// digest: digest of tx
-static bool saveConfirmedTx(unsigned int txNumberMinusOne, bool moneyFlew, unsigned int tick, const m256i& digest)
+// transactionIndex: slot of tx in tick (index in TickData::transactionDigests)
+// moneyFlew: if money has been flow
+static void saveConfirmedTx(unsigned int tick, unsigned int transactionIndex, bool moneyFlew)
 {
     ASSERT(txStatusData.confirmedTxCurrentEpochBeginTick == system.initialTick);
     ASSERT(tick >= system.initialTick && tick < system.initialTick + MAX_NUMBER_OF_TICKS_PER_EPOCH);
+    ASSERT(transactionIndex < NUMBER_OF_TRANSACTIONS_PER_TICK);
 
-    // skip if confirmedTx storage is full
-    if (txNumberMinusOne >= confirmedTxCurrentEpochLength)
-        return false;
-
-    ACQUIRE(confirmedTxLock);
-
-    // set confirmedTx data
-    ConfirmedTx & txConfirmation = confirmedTx[txNumberMinusOne];
-    txConfirmation.tick = tick;
-    txConfirmation.moneyFlew = moneyFlew;
-    txConfirmation.digest = digest;
-
-    // get current tick number in epoch
-    int tickIndex = tick - system.initialTick;
-    // keep track of tx number in tick to find it later easier
-    txStatusData.tickTxCounter[tickIndex]++;
-
-    RELEASE(confirmedTxLock);
-
-    return true;
+    TickTxStatusFlags& flags = tickTxStatusFlags[TICKS_TO_KEEP_FROM_PRIOR_EPOCH + (tick - txStatusData.confirmedTxCurrentEpochBeginTick)];
+    const long long bit = 1LL << (transactionIndex & 63);
+    if (moneyFlew)
+        _InterlockedOr64((long long*)&flags.moneyFlew[transactionIndex >> 6], bit);
+    _InterlockedOr64((long long*)&flags.executed[transactionIndex >> 6], bit);
 }
 
 
@@ -211,46 +182,70 @@ static void processRequestConfirmedTx(long long processorNumber, Peer *peer, Req
     if (request->tick >= system.tick)
         return;
 
-    int tickIndex;
-    if (request->tick >= txStatusData.confirmedTxCurrentEpochBeginTick && request->tick < txStatusData.confirmedTxCurrentEpochBeginTick + MAX_NUMBER_OF_TICKS_PER_EPOCH)
+    const TickTxStatusFlags* flags = getTickTxStatusFlags(request->tick);
+    if (!flags)
     {
-        // current epoch
-        tickIndex = request->tick - txStatusData.confirmedTxCurrentEpochBeginTick;
+        // tick not available
+        return;
     }
-    else if (txStatusData.confirmedTxPreviousEpochBeginTick != 0 && request->tick >= txStatusData.confirmedTxPreviousEpochBeginTick && request->tick < txStatusData.confirmedTxCurrentEpochBeginTick)
+
+    // get digests of tick transactions from tick storage (NULL for empty tick)
+    const m256i* transactionDigests = NULL;
+#if TICK_STORAGE_TIERED_MODE
+    const bool archived = ts.tickInArchive(request->tick);
+    if (archived)
     {
-        // available tick of previous epoch (stored behind current epoch data)
-        tickIndex = request->tick - txStatusData.confirmedTxPreviousEpochBeginTick + MAX_NUMBER_OF_TICKS_PER_EPOCH;
+        ts.tickArchive.acquireLock();
+        const auto* archivedTick = ts.tickArchive.getTick(request->tick);
+        if (archivedTick && archivedTick->tickData.epoch != 0 && archivedTick->tickData.epoch != INVALIDATED_TICK_DATA)
+            transactionDigests = archivedTick->tickData.transactionDigests;
     }
     else
+#endif
     {
-        // tick not available
-        return;
+        const TickData* td = ts.tickData.getByTickIfNotEmpty(request->tick);
+        if (td)
+            transactionDigests = td->transactionDigests;
     }
 
-    // get index where confirmedTx are starting to be stored in memory
-    int index = txStatusData.tickTxIndexStart[tickIndex];
-
     // init response message data, get it from the storage to avoid increasing stack mem
     RespondTxStatus& tickTxStatus = tickTxStatusStorage[processorNumber];
     tickTxStatus.currentTickOfNode = system.tick;
     tickTxStatus.tick = request->tick;
-    tickTxStatus.txCount = txStatusData.tickTxCounter[tickIndex];
+    tickTxStatus.txCount = 0;
     setMem(&tickTxStatus.moneyFlew, sizeof(tickTxStatus.moneyFlew), 0);
 
-    // loop over the number of tx which were stored for the given tick
-    ASSERT(tickTxStatus.txCount <= NUMBER_OF_TRANSACTIONS_PER_TICK);
-    for (unsigned int i = 0; i < tickTxStatus.txCount; i++)
+    // add executed tx in order of slots
+    bool tickDataMissing = false;
+    for (unsigned int w = 0; w < NUMBER_OF_TRANSACTIONS_PER_TICK / 64; ++w)
     {
-        ConfirmedTx& localConfirmedTx = confirmedTx[index + i];
+        unsigned long long executed = flags->executed[w];
+        if (executed && !transactionDigests)
+        {
+            tickDataMissing = true;
+            break;
+        }
+        const unsigned long long moneyFlew = flags->moneyFlew[w];
+        while (executed)
+        {
+            const unsigned int bitIndex = (unsigned int)_tzcnt_u64(executed);
+            executed &= executed - 1;
 
-        ASSERT(index + i < confirmedTxLength);
-        ASSERT(localConfirmedTx.tick == request->tick);
-        ASSERT(localConfirmedTx.moneyFlew == 1 || localConfirmedTx.moneyFlew == 0);
+            const unsigned int i = tickTxStatus.txCount++;
+            tickTxStatus.txDigests[i] = transactionDigests[w * 64 + bitIndex];
+            tickTxStatus.moneyFlew[i >> 3] |= (unsigned char)(((moneyFlew >> bitIndex) & 1) << (i & 7));
+        }
+    }
 
-        tickTxStatus.txDigests[i] = localConfirmedTx.digest;
-        tickTxStatus.moneyFlew[i >> 3] |= (localConfirmedTx.moneyFlew << (i & 7));
+#if TICK_STORAGE_TIERED_MODE
+    if (archived)
+    {
+        ts.tickArchive.releaseLock();
     }
+#endif
+
+    if (tickDataMissing)
+        return;
 
     ASSERT(tickTxStatus.size() <= sizeof(tickTxStatus));
     enqueueResponse(peer, tickTxStatus.size(), RespondTxStatus::type(), header->dejavu(), &tickTxStatus);
@@ -258,8 +253,14 @@ static void processRequestConfirmedTx(long long processorNumber, Peer *peer, Req
 
 #if TICK_STORAGE_AUTOSAVE_MODE
 // can only be called from main thread
-static bool saveStateTxStatus(const unsigned int numberOfTransactions, CHAR16* directory)
+static bool saveStateTxStatus(CHAR16* directory)
 {
+    // save flags of kept ticks of previous epoch and of current epoch up to current tick
+    const unsigned int tickBegin = txStatusData.confirmedTxCurrentEpochBeginTick;
+    txStatusData.snapshotTickCount = (system.tick >= tickBegin) ? system.tick - tickBegin + 1 : 0;
+    if (txStatusData.snapshotTickCount > MAX_NUMBER_OF_TICKS_PER_EPOCH)
+        txStatusData.snapshotTickCount = MAX_NUMBER_OF_TICKS_PER_EPOCH;
+
     static unsigned short TX_STATUS_SNAPSHOT_FILE_NAME[] = L"snapshotTxStatusData";
     long long savedSize = save(TX_STATUS_SNAPSHOT_FILE_NAME, sizeof(txStatusData), (unsigned char*)&txStatusData, directory);
     if (savedSize != sizeof(txStatusData))
@@ -268,37 +269,36 @@ static bool saveStateTxStatus(const unsigned int numberOfTransactions, CHAR16* d
         return false;
     }
 
-    static unsigned short CONFIRMED_TX_SNAPSHOT_FILE_NAME[] = L"snapshotConfirmedTx";
-    savedSize = saveLargeFile(CONFIRMED_TX_SNAPSHOT_FILE_NAME, numberOfTransactions*sizeof(ConfirmedTx), (unsigned char*)confirmedTx, directory);
-    if (savedSize != numberOfTransactions * sizeof(ConfirmedTx))
+    static unsigned short TX_STATUS_FLAGS_SNAPSHOT_FILE_NAME[] = L"snapshotTxStatusFlags";
+    const unsigned long long flagsSize = (TICKS_TO_KEEP_FROM_PRIOR_EPOCH + txStatusData.snapshotTickCount) * sizeof(TickTxStatusFlags);
+    savedSize = saveLargeFile(TX_STATUS_FLAGS_SNAPSHOT_FILE_NAME, flagsSize, (unsigned char*)tickTxStatusFlags, directory);
+    if (savedSize != flagsSize)
     {
-        logToConsole(L"Failed to save ConfirmedTx");
+        logToConsole(L"Failed to save tickTxStatusFlags");
         return false;
     }
     return true;
 }
 
 // can only be called from main thread
-// numberOfTransactions must be known before calling this
-static bool loadStateTxStatus(const unsigned int numberOfTransactions, CHAR16* directory)
+static bool loadStateTxStatus(CHAR16* directory)
 {
     static unsigned short TX_STATUS_SNAPSHOT_FILE_NAME[] = L"snapshotTxStatusData";
     long long loadedSize = load(TX_STATUS_SNAPSHOT_FILE_NAME, sizeof(txStatusData), (unsigned char*)&txStatusData, directory);
-    if (loadedSize != sizeof(txStatusData))
+    if (loadedSize != sizeof(txStatusData) || txStatusData.snapshotTickCount > MAX_NUMBER_OF_TICKS_PER_EPOCH)
     {
         logToConsole(L"Failed to load txStatusData");
         return false;
     }
 
-    if (numberOfTransactions)
+    setMem(tickTxStatusFlags, tickTxStatusFlagsLength * sizeof(TickTxStatusFlags), 0);
+    static unsigned short TX_STATUS_FLAGS_SNAPSHOT_FILE_NAME[] = L"snapshotTxStatusFlags";
+    const unsigned long long flagsSize = (TICKS_TO_KEEP_FROM_PRIOR_EPOCH + txStatusData.snapshotTickCount) * sizeof(TickTxStatusFlags);
+    loadedSize = loadLargeFile(TX_STATUS_FLAGS_SNAPSHOT_FILE_NAME, flagsSize, (unsigned char*)tickTxStatusFlags, directory);
+    if (loadedSize != flagsSize)
     {
-        static unsigned short CONFIRMED_TX_SNAPSHOT_FILE_NAME[] = L"snapshotConfirmedTx";
-        loadedSize = loadLargeFile(CONFIRMED_TX_SNAPSHOT_FILE_NAME, numberOfTransactions * sizeof(ConfirmedTx), (unsigned char*)confirmedTx, directory);
-        if (loadedSize != numberOfTransactions * sizeof(ConfirmedTx))
-        {
-            logToConsole(L"Failed to load ConfirmedTx");
-            return false;
-        }
+        logToConsole(L"Failed to load tickTxStatusFlags");
+        return false;
     }
     return true;
 }
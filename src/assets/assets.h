@@ -3,6 +3,7 @@
 #include "platform/global_var.h"
 #include "platform/m256.h"
 #include "platform/concurrency.h"
+#include "platform/read_write_lock.h"
 #include <lib/platform_efi/uefi.h>
 #include "platform/file_io.h"
 #include "platform/time_stamp_counter.h"
@@ -14,10 +15,14 @@
 #include "contract_core/contract_def.h"
 
 #include "public_settings.h"
+#include "system.h"
 #include "logging/logging.h"
 #include "kangaroo_twelve.h"
 #include "four_q.h"
 #include "common_buffers.h"
+#include "merkle_tree.h"
+#include "delta_snapshot.h"
+#include "sparse_snapshot.h"
 
 
 // CAUTION: Currently, there is no locking of universeLock if contracts use the QPI asset iteration classes directly.
@@ -26,14 +31,27 @@
 //   or tickProcessor(), which doesn't run in parallel to contractProcessor(),
 //   or during a single-threading phase (node startup); NO WRITING OF ASSETS IN REQUEST PROCESSOR OR MAIN THREAD!
 // - QPI asset iteration classes do not allow writing access to the universe (if this is changed in the future,
-//   note that all write access requires locking universeLock)
+//   note that all write access requires locking universeLock for writing)
 
 // TODO: move this into AssetStorage class
-GLOBAL_VAR_DECL volatile char universeLock GLOBAL_VAR_INIT(0);
+// Lock of universe: queries that only read the universe (network requests, numberOfShares(), saving) acquire it
+// for reading, so they can run in parallel; all modifications acquire it for writing.
+GLOBAL_VAR_DECL ReadWriteLock universeLock;
 GLOBAL_VAR_DECL AssetRecord* assets GLOBAL_VAR_INIT(nullptr);
 GLOBAL_VAR_DECL m256i* assetDigests GLOBAL_VAR_INIT(nullptr);
 static constexpr unsigned long long assetDigestsSizeInBytes = (ASSETS_CAPACITY * 2 - 1) * 32ULL;
 GLOBAL_VAR_DECL unsigned long long* assetChangeFlags GLOBAL_VAR_INIT(nullptr);
+GLOBAL_VAR_DECL IncrementalMerkleTree<ASSETS_CAPACITY> assetDigestTree;
+
+// Sequence counter for reading assetDigests without lock (seqlock), odd while the digests are updated by
+// getUniverseDigest() or loadUniverse()
+GLOBAL_VAR_DECL volatile long universeDigestsSequence GLOBAL_VAR_INIT(0);
+
+// Tracking of universe changes since the last full universe snapshot (see saveUniverseSnapshot())
+GLOBAL_VAR_DECL DeltaSnapshot<ASSETS_CAPACITY, AssetRecord> universeDeltaSnapshot;
+
+// Sparse file format of the universe (see saveUniverseRecords())
+typedef SparseSnapshot<ASSETS_CAPACITY, AssetRecord> UniverseSparseSnapshot;
 static constexpr char CONTRACT_ASSET_UNIT_OF_MEASUREMENT[7] = { 0, 0, 0, 0, 0, 0, 0 };
 
 static constexpr unsigned int NO_ASSET_INDEX = 0xffffffff;
@@ -56,6 +74,8 @@ public: // TODO: make protected
     // - all issuances,
     // - all ownerships belonging to each issuance
     // - all possessions belonging to each ownership
+    // - all ownerships and all possessions belonging to each entity (owner / possessor)
+    // - all issuances with the same asset name (different issuers)
     struct IndexLists
     {
         unsigned int issuancesFirstIdx;
@@ -63,6 +83,119 @@ public: // TODO: make protected
 
         unsigned int nextIdx[ASSETS_CAPACITY];
 
+        // First ownership and first possession record of an entity
+        struct EntityFirstIdx
+        {
+            unsigned int ownership;
+            unsigned int possession;
+        };
+
+        // Hash map of entities owning or possessing shares. The public key isn't stored but taken from the
+        // record that the entry points to. Each entity needs at least one record, but most entities have several
+        // (ownership and possession of each asset), so the map is sized for a quarter of the universe capacity (32 MB
+        // instead of 128 MB) and filled up to 3/4. If more entities have records, isEntityIndexComplete is cleared
+        // and the lookup falls back to scanning the universe hash map cluster of the entity until the next rebuild().
+        static constexpr unsigned int entityIndexCapacity = ASSETS_CAPACITY / 4;
+        static constexpr unsigned int maxEntityCount = entityIndexCapacity / 4 * 3;
+        EntityFirstIdx entityFirstIdx[entityIndexCapacity];
+        unsigned int entityCount;
+        bool isEntityIndexComplete;
+
+        // For ownership and possession records: next record of same entity.
+        // For issuance records: next issuance with same asset name.
+        // Needs one entry per record, because every record may be in a list.
+        unsigned int entityNextIdx[ASSETS_CAPACITY];
+
+        // Hash map of asset names, pointing to the first issuance with the name (following ones in entityNextIdx).
+        // The asset name isn't stored but taken from the issuance record that the entry points to.
+        unsigned int assetNameFirstIdx[ASSETS_CAPACITY];
+
+        // Return slot of entity in entityFirstIdx (slot with empty entry if entity has no records)
+        unsigned int entitySlot(const m256i& publicKey) const
+        {
+            unsigned int slot = publicKey.m256i_u32[0] & (entityIndexCapacity - 1);
+            while (true)
+            {
+                const EntityFirstIdx& entry = entityFirstIdx[slot];
+                const unsigned int recordIdx = (entry.ownership != NO_ASSET_INDEX) ? entry.ownership : entry.possession;
+                if (recordIdx == NO_ASSET_INDEX || assets[recordIdx].varStruct.issuance.publicKey == publicKey)
+                    return slot;
+                slot = (slot + 1) & (entityIndexCapacity - 1);
+            }
+        }
+
+        // Return entry of entity in entityFirstIdx for adding a record, or nullptr if the entity index is full
+        EntityFirstIdx* entityEntryForAdding(const m256i& publicKey)
+        {
+            if (!isEntityIndexComplete)
+                return nullptr;
+            EntityFirstIdx& entry = entityFirstIdx[entitySlot(publicKey)];
+            if (entry.ownership == NO_ASSET_INDEX && entry.possession == NO_ASSET_INDEX)
+            {
+                if (entityCount >= maxEntityCount)
+                {
+                    isEntityIndexComplete = false;
+                    return nullptr;
+                }
+                ++entityCount;
+            }
+            return &entry;
+        }
+
+        // Return index of the first record at universeIdx or later in the hash map cluster of the entity that has the
+        // given type (OWNERSHIP or POSSESSION) and public key, or NO_ASSET_INDEX (fallback if entity index is full)
+        static unsigned int scanEntityRecords(const m256i& publicKey, unsigned char type, unsigned int universeIdx)
+        {
+            while (assets[universeIdx].varStruct.issuance.type != EMPTY)
+            {
+                if (assets[universeIdx].varStruct.issuance.type == type && assets[universeIdx].varStruct.issuance.publicKey == publicKey)
+                    return universeIdx;
+                universeIdx = (universeIdx + 1) & (ASSETS_CAPACITY - 1);
+            }
+            return NO_ASSET_INDEX;
+        }
+
+        // Return index of first record with type OWNERSHIP or POSSESSION of entity (following ones are returned by
+        // entityNextRecordIdx()) or NO_ASSET_INDEX
+        unsigned int entityFirstRecordIdx(const m256i& publicKey, unsigned char type) const
+        {
+            ASSERT(type == OWNERSHIP || type == POSSESSION);
+            if (!isEntityIndexComplete)
+                return scanEntityRecords(publicKey, type, publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1));
+            const EntityFirstIdx& entry = entityFirstIdx[entitySlot(publicKey)];
+            return (type == OWNERSHIP) ? entry.ownership : entry.possession;
+        }
+
+        // Return index of the record of entity following recordIdx in the list of entityFirstRecordIdx() or NO_ASSET_INDEX
+        unsigned int entityNextRecordIdx(const m256i& publicKey, unsigned char type, unsigned int recordIdx) const
+        {
+            ASSERT(recordIdx < ASSETS_CAPACITY);
+            if (!isEntityIndexComplete)
+                return scanEntityRecords(publicKey, type, (recordIdx + 1) & (ASSETS_CAPACITY - 1));
+            return entityNextIdx[recordIdx];
+        }
+
+        // Return slot of asset name in assetNameFirstIdx (slot with empty entry if there is no issuance with the name)
+        unsigned int assetNameSlot(unsigned long long assetName) const
+        {
+            // names are mostly upper-case letters, so the bits are mixed before taking the slot
+            unsigned int slot = (unsigned int)((assetName * 0x9E3779B97F4A7C15ULL) >> 32) & (ASSETS_CAPACITY - 1);
+            while (true)
+            {
+                const unsigned int recordIdx = assetNameFirstIdx[slot];
+                if (recordIdx == NO_ASSET_INDEX
+                    || ((*((unsigned long long*)assets[recordIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == assetName)
+                    return slot;
+                slot = (slot + 1) & (ASSETS_CAPACITY - 1);
+            }
+        }
+
+        // Return index of first issuance record with asset name (following ones in entityNextIdx) or NO_ASSET_INDEX
+        unsigned int assetNameFirstIssuanceIdx(unsigned long long assetName) const
+        {
+            return assetNameFirstIdx[assetNameSlot(assetName)];
+        }
+
         void addIssuance(unsigned int newIssuanceIdx)
         {
             // add as first element in linked list of all issuances
@@ -71,6 +204,11 @@ public: // TODO: make protected
             ASSERT(issuancesFirstIdx == NO_ASSET_INDEX || assets[issuancesFirstIdx].varStruct.issuance.type == ISSUANCE);
             nextIdx[newIssuanceIdx] = issuancesFirstIdx;
             issuancesFirstIdx = newIssuanceIdx;
+
+            // add as first element in linked list of all issuances with the same name
+            unsigned int& nameFirstIdx = assetNameFirstIdx[assetNameSlot((*((unsigned long long*)assets[newIssuanceIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF)];
+            entityNextIdx[newIssuanceIdx] = nameFirstIdx;
+            nameFirstIdx = newIssuanceIdx;
         }
 
         // Add newOwnershipIdx as first element in linked list of all ownerships of issuanceIdx
@@ -83,6 +221,14 @@ public: // TODO: make protected
             ASSERT(ownershipsPossessionsFirstIdx[issuanceIdx] == NO_ASSET_INDEX || assets[ownershipsPossessionsFirstIdx[issuanceIdx]].varStruct.issuance.type == OWNERSHIP);
             nextIdx[newOwnershipIdx] = ownershipsPossessionsFirstIdx[issuanceIdx];
             ownershipsPossessionsFirstIdx[issuanceIdx] = newOwnershipIdx;
+
+            // add as first element in linked list of all ownerships of owner
+            EntityFirstIdx* entity = entityEntryForAdding(assets[newOwnershipIdx].varStruct.ownership.publicKey);
+            if (entity)
+            {
+                entityNextIdx[newOwnershipIdx] = entity->ownership;
+                entity->ownership = newOwnershipIdx;
+            }
         }
 
         // Add newPossessionIdx as first element in linked list of all possessions of ownershipIdx
@@ -95,6 +241,14 @@ public: // TODO: make protected
             ASSERT(ownershipsPossessionsFirstIdx[ownershipIdx] == NO_ASSET_INDEX || assets[ownershipsPossessionsFirstIdx[ownershipIdx]].varStruct.possession.type == POSSESSION);
             nextIdx[newPossessionIdx] = ownershipsPossessionsFirstIdx[ownershipIdx];
             ownershipsPossessionsFirstIdx[ownershipIdx] = newPossessionIdx;
+
+            // add as first element in linked list of all possessions of possessor
+            EntityFirstIdx* entity = entityEntryForAdding(assets[newPossessionIdx].varStruct.possession.publicKey);
+            if (entity)
+            {
+                entityNextIdx[newPossessionIdx] = entity->possession;
+                entity->possession = newPossessionIdx;
+            }
         }
 
         // Reset lists to empty
@@ -104,6 +258,11 @@ public: // TODO: make protected
             static_assert(NO_ASSET_INDEX == 0xffffffff, "Following setMem() expects NO_ASSET_INDEX == 0xffffffff");
             setMem(ownershipsPossessionsFirstIdx, sizeof(ownershipsPossessionsFirstIdx), 0xff);
             setMem(nextIdx, sizeof(nextIdx), 0xff);
+            setMem(entityFirstIdx, sizeof(entityFirstIdx), 0xff);
+            entityCount = 0;
+            isEntityIndexComplete = true;
+            setMem(entityNextIdx, sizeof(entityNextIdx), 0xff);
+            setMem(assetNameFirstIdx, sizeof(assetNameFirstIdx), 0xff);
         }
 
         // Rebuild lists from assets array (includes reset)
@@ -165,31 +324,45 @@ static unsigned int issuanceIndex(const m256i& issuer, unsigned long long assetN
 
 static bool initAssets()
 {
-    if (!allocPoolWithErrorLog(L"assets", ASSETS_CAPACITY * sizeof(AssetRecord), (void**)&assets, __LINE__)
-        || !allocPoolWithErrorLog(L"assetDigets", assetDigestsSizeInBytes, (void**)&assetDigests, __LINE__)
-        || !allocPoolWithErrorLog(L"assetChangeFlags", ASSETS_CAPACITY / 8, (void**)&assetChangeFlags, __LINE__))
+    universeLock.reset();
+
+    if (!allocLargeWithErrorLog(L"assets", ASSETS_CAPACITY * sizeof(AssetRecord), (void**)&assets, __LINE__)
+        || !allocLargeWithErrorLog(L"assetDigets", assetDigestsSizeInBytes, (void**)&assetDigests, __LINE__)
+        || !allocLargeWithErrorLog(L"assetChangeFlags", assetDigestTree.changeFlagsSizeInBytes, (void**)&assetChangeFlags, __LINE__)
+        || !universeDeltaSnapshot.init())
     {
         return false;
     }
-    setMem(assetChangeFlags, ASSETS_CAPACITY / 8, 0xFF);
+    assetDigestTree.init(assetDigests, assetChangeFlags);
+    assetDigestTree.markAllLeafsChanged();
+
+    // Most of the universe is empty, so empty subtrees are resolved from a precomputed table in getUniverseDigest()
+    AssetRecord emptyAssetRecord;
+    setMem(&emptyAssetRecord, sizeof(emptyAssetRecord), 0);
+    m256i emptyAssetDigest;
+    KangarooTwelve(&emptyAssetRecord, sizeof(AssetRecord), &emptyAssetDigest, 32);
+    assetDigestTree.setEmptyLeafDigest(emptyAssetDigest);
+
     return true;
 }
 
 static void deinitAssets()
 {
+    assetDigestTree.deinit();
+    universeDeltaSnapshot.deinit();
     if (assetChangeFlags)
     {
-        freePool(assetChangeFlags);
+        freeLarge(assetChangeFlags, assetDigestTree.changeFlagsSizeInBytes);
         assetChangeFlags = nullptr;
     }
     if (assetDigests)
     {
-        freePool(assetDigests);
+        freeLarge(assetDigests, assetDigestsSizeInBytes);
         assetDigests = nullptr;
     }
     if (assets)
     {
-        freePool(assets);
+        freeLarge(assets, ASSETS_CAPACITY * sizeof(AssetRecord));
         assets = nullptr;
     }
 }
@@ -201,7 +374,7 @@ static long long issueAsset(const m256i& issuerPublicKey, const char name[7], ch
 
     *issuanceIndex = issuerPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
 
-    ACQUIRE(universeLock);
+    universeLock.acquireWrite();
 
 iteration:
     if (assets[*issuanceIndex].varStruct.issuance.type == EMPTY)
@@ -240,7 +413,7 @@ iteration:
                 as.indexLists.addOwnership(*issuanceIndex, *ownershipIndex);
                 as.indexLists.addPossession(*ownershipIndex, *possessionIndex);
 
-                RELEASE(universeLock);
+                universeLock.releaseWrite();
 
                 AssetIssuance assetIssuance;
                 assetIssuance.issuerPublicKey = issuerPublicKey;
@@ -273,7 +446,7 @@ iteration:
             && ((*((unsigned long long*)assets[*issuanceIndex].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == ((*((unsigned long long*)name)) & 0xFFFFFFFFFFFFFF)
             && assets[*issuanceIndex].varStruct.issuance.publicKey == issuerPublicKey)
         {
-            RELEASE(universeLock);
+            universeLock.releaseWrite();
             return 0;
         }
 
@@ -290,7 +463,7 @@ static sint64 numberOfShares(
 {
     PROFILE_SCOPE();
 
-    ACQUIRE(universeLock);
+    universeLock.acquireRead();
 
     sint64 numOfShares = 0;
     if (possession.anyPossessor && possession.anyManagingContract)
@@ -308,7 +481,7 @@ static sint64 numberOfShares(
         }
     }
 
-    RELEASE(universeLock);
+    universeLock.releaseRead();
 
     return numOfShares;
 }
@@ -332,7 +505,7 @@ static bool transferShareManagementRights(int sourceOwnershipIndex, int sourcePo
 
     if (lock)
     {
-        ACQUIRE(universeLock);
+        universeLock.acquireWrite();
     }
 
     if (assets[sourceOwnershipIndex].varStruct.ownership.type != OWNERSHIP || assets[sourceOwnershipIndex].varStruct.ownership.numberOfShares < numberOfShares
@@ -341,7 +514,7 @@ static bool transferShareManagementRights(int sourceOwnershipIndex, int sourcePo
     {
         if (lock)
         {
-            RELEASE(universeLock);
+            universeLock.releaseWrite();
         }
 
         return false;
@@ -402,7 +575,7 @@ iteration:
 
             if (lock)
             {
-                RELEASE(universeLock);
+                universeLock.releaseWrite();
             }
 
             AssetOwnershipManagingContractChange logOM;
@@ -465,7 +638,7 @@ static bool transferShareOwnershipAndPossession(int sourceOwnershipIndex, int so
 
     if (lock)
     {
-        ACQUIRE(universeLock);
+        universeLock.acquireWrite();
     }
 
     ASSERT(sourceOwnershipIndex >= 0 && sourceOwnershipIndex < ASSETS_CAPACITY);
@@ -476,7 +649,7 @@ static bool transferShareOwnershipAndPossession(int sourceOwnershipIndex, int so
     {
         if (lock)
         {
-            RELEASE(universeLock);
+            universeLock.releaseWrite();
         }
 
         return false;
@@ -494,7 +667,7 @@ static bool transferShareOwnershipAndPossession(int sourceOwnershipIndex, int so
         {
             if (lock)
             {
-                RELEASE(universeLock);
+                universeLock.releaseWrite();
             }
 
             return false;
@@ -508,7 +681,7 @@ static bool transferShareOwnershipAndPossession(int sourceOwnershipIndex, int so
 
         if (lock)
         {
-            RELEASE(universeLock);
+            universeLock.releaseWrite();
         }
 
         AssetOwnershipChange assetOwnershipChange;
@@ -588,7 +761,7 @@ iteration:
 
             if (lock)
             {
-                RELEASE(universeLock);
+                universeLock.releaseWrite();
             }
 
             AssetOwnershipChange assetOwnershipChange;
@@ -634,13 +807,13 @@ static long long numberOfPossessedShares(unsigned long long assetName, const m25
 {
     PROFILE_SCOPE();
 
-    ACQUIRE(universeLock);
+    universeLock.acquireRead();
 
     int issuanceIndex = issuer.m256i_u32[0] & (ASSETS_CAPACITY - 1);
 iteration:
     if (assets[issuanceIndex].varStruct.issuance.type == EMPTY)
     {
-        RELEASE(universeLock);
+        universeLock.releaseRead();
 
         return 0;
     }
@@ -654,7 +827,7 @@ iteration:
         iteration2:
             if (assets[ownershipIndex].varStruct.ownership.type == EMPTY)
             {
-                RELEASE(universeLock);
+                universeLock.releaseRead();
 
                 return 0;
             }
@@ -669,7 +842,7 @@ iteration:
                 iteration3:
                     if (assets[possessionIndex].varStruct.possession.type == EMPTY)
                     {
-                        RELEASE(universeLock);
+                        universeLock.releaseRead();
 
                         return 0;
                     }
@@ -682,7 +855,7 @@ iteration:
                         {
                             const long long numberOfPossessedShares = assets[possessionIndex].varStruct.possession.numberOfShares;
 
-                            RELEASE(universeLock);
+                            universeLock.releaseRead();
 
                             return numberOfPossessedShares;
                         }
@@ -711,42 +884,108 @@ iteration:
     }
 }
 
+// Check if all bytes of the record are zero, which is the case for all unused entries of the universe hash map
+static inline bool isEmptyAssetRecord(const AssetRecord& record)
+{
+    static_assert(sizeof(AssetRecord) == 6 * sizeof(unsigned long long), "Unexpected size of AssetRecord");
+    const unsigned long long* words = (const unsigned long long*)&record;
+    return !(words[0] | words[1] | words[2] | words[3] | words[4] | words[5]);
+}
+
 // Should only be called from tick processor to avoid concurrent asset state changes, which may cause race conditions
 static void getUniverseDigest(m256i& digest)
 {
     PROFILE_SCOPE();
 
-    unsigned int digestIndex;
-    for (digestIndex = 0; digestIndex < ASSETS_CAPACITY; digestIndex++)
+    _InterlockedIncrement(&universeDigestsSequence);
+    for (unsigned long long i = assetDigestTree.findNextChangedLeaf(0); i < ASSETS_CAPACITY; i = assetDigestTree.findNextChangedLeaf(i + 1))
+    {
+        if (isEmptyAssetRecord(assets[i]))
+            assetDigests[i] = assetDigestTree.emptyDigest(0);
+        else
+            KangarooTwelve(&assets[i], sizeof(AssetRecord), &assetDigests[i], 32);
+    }
+    assetDigestTree.updateInnerNodes();
+    _InterlockedIncrement(&universeDigestsSequence);
+
+    digest = assetDigestTree.root();
+}
+
+// Copy count asset records starting at firstIndex, which need to form a complete subtree of 2^level leafs, together
+// with the siblings of the subtree up to the root (ASSETS_DEPTH - level digests) and the root digest, for serving
+// state chunks to peers. Return false if the records have changed since the last update of the digests or the digests
+// were updated concurrently too often, because the records cannot be proven then.
+static bool readUniverseChunk(unsigned int firstIndex, unsigned int count, unsigned int level, AssetRecord* records, m256i* siblings, m256i& rootDigest)
+{
+    ASSERT(count == (1u << level) && !(firstIndex & (count - 1)));
+    bool consistent = false;
+    universeLock.acquireRead();
+    for (unsigned int attempt = 0; attempt < 4 && !consistent; ++attempt)
     {
-        if (assetChangeFlags[digestIndex >> 6] & (1ULL << (digestIndex & 63)))
+        const long sequence = universeDigestsSequence;
+        if (sequence & 1)
         {
-            KangarooTwelve(&assets[digestIndex], sizeof(AssetRecord), &assetDigests[digestIndex], 32);
+            _mm_pause();
+            continue;
         }
+        _mm_lfence();
+
+        copyMem(records, &assets[firstIndex], count * sizeof(AssetRecord));
+        assetDigestTree.getSubtreeSiblings(firstIndex >> level, level, siblings);
+        rootDigest = assetDigestTree.root();
+
+        _mm_lfence();
+        consistent = universeDigestsSequence == sequence && !assetDigestTree.anyLeafChanged(firstIndex, firstIndex + count);
     }
-    unsigned int previousLevelBeginning = 0;
-    unsigned int numberOfLeafs = ASSETS_CAPACITY;
-    while (numberOfLeafs > 1)
+    universeLock.releaseRead();
+    return consistent;
+}
+
+// Copy the digests of count nodes of the given level of the universe Merkle tree starting at node firstNode, which need
+// to form a complete subtree of 2^countLevel nodes, together with the siblings of the subtree up to the root
+// (ASSETS_DEPTH - level - countLevel digests) and the root digest, for serving state chunk digests to peers. Reads like
+// readUniverseChunk(). Return false if the nodes are not up to date.
+static bool readUniverseChunkDigests(unsigned int level, unsigned int firstNode, unsigned int count, unsigned int countLevel, m256i* nodeDigests, m256i* siblings, m256i& rootDigest)
+{
+    ASSERT(count == (1u << countLevel) && !(firstNode & (count - 1)) && level + countLevel <= ASSETS_DEPTH);
+    const unsigned long long firstLeaf = (unsigned long long)firstNode << level;
+    const unsigned long long endLeaf = (unsigned long long)(firstNode + count) << level;
+    bool consistent = false;
+    universeLock.acquireRead();
+    for (unsigned int attempt = 0; attempt < 4 && !consistent; ++attempt)
     {
-        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
+        const long sequence = universeDigestsSequence;
+        if (sequence & 1)
         {
-            if (assetChangeFlags[i >> 6] & (3ULL << (i & 63)))
-            {
-                KangarooTwelve64To32(&assetDigests[previousLevelBeginning + i], &assetDigests[digestIndex]);
-                assetChangeFlags[i >> 6] &= ~(3ULL << (i & 63));
-                assetChangeFlags[i >> 7] |= (1ULL << ((i >> 1) & 63));
-            }
-            digestIndex++;
+            _mm_pause();
+            continue;
         }
-        previousLevelBeginning += numberOfLeafs;
-        numberOfLeafs >>= 1;
-    }
-    assetChangeFlags[0] = 0;
+        _mm_lfence();
+
+        for (unsigned int i = 0; i < count; ++i)
+            nodeDigests[i] = assetDigestTree.nodeDigest(level, firstNode + i);
+        assetDigestTree.getSubtreeSiblings(firstNode >> countLevel, level + countLevel, siblings);
+        rootDigest = assetDigestTree.root();
 
-    digest = assetDigests[(ASSETS_CAPACITY * 2 - 1) - 1];
+        _mm_lfence();
+        consistent = universeDigestsSequence == sequence && !assetDigestTree.anyLeafChanged(firstLeaf, endLeaf);
+    }
+    universeLock.releaseRead();
+    return consistent;
 }
 
 
+// Save universe in sparse format (only non-empty records, see SparseSnapshot) if that is smaller than the full
+// universe, otherwise in full format. Both can be loaded with loadUniverse(). buffer needs universeSizeInBytes. Caller
+// has to acquire universeLock for reading. Returns number of bytes written or -1 on error.
+static long long saveUniverseRecords(const CHAR16* fileName, const CHAR16* directory, unsigned char* buffer)
+{
+    const unsigned long long sparseSize = UniverseSparseSnapshot::build(assets, buffer);
+    const unsigned long long size = sparseSize ? sparseSize : universeSizeInBytes;
+    const long long savedSize = save(fileName, size, sparseSize ? buffer : (unsigned char*)assets, directory);
+    return (savedSize == (long long)size) ? savedSize : -1;
+}
+
 static bool saveUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, const CHAR16* directory = NULL)
 {
     PROFILE_SCOPE();
@@ -755,11 +994,14 @@ static bool saveUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, const CHAR
 
     const unsigned long long beginningTick = __rdtsc();
 
-    ACQUIRE(universeLock);
-    long long savedSize = save(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory);
-    RELEASE(universeLock);
+    unsigned char* buffer = (unsigned char*)reorgBuffers.acquireBuffer(universeSizeInBytes);
+    ASSERT(buffer);
+    universeLock.acquireRead();
+    long long savedSize = saveUniverseRecords(fileName, directory, buffer);
+    universeLock.releaseRead();
+    reorgBuffers.releaseBuffer(buffer);
 
-    if (savedSize == ASSETS_CAPACITY * sizeof(AssetRecord))
+    if (savedSize >= 0)
     {
         setNumber(message, savedSize, TRUE);
         appendText(message, L" bytes of the universe data are saved (");
@@ -771,114 +1013,337 @@ static bool saveUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, const CHAR
     return false;
 }
 
-static bool loadUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, CHAR16* directory = NULL)
+// Number of asset records that are hashed at once while loading the universe
+static constexpr unsigned long long universeLoadHashingPartSize = 65536;
+
+// Compute leaf digests of asset records [begin, end)
+static void computeUniverseLeafDigests(unsigned long long begin, unsigned long long end)
 {
-    PROFILE_SCOPE();
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        if (isEmptyAssetRecord(assets[i]))
+            assetDigests[i] = assetDigestTree.emptyDigest(0);
+        else
+            KangarooTwelve(&assets[i], sizeof(AssetRecord), &assetDigests[i], 32);
+    }
+}
+
+// Compute leaf digests of universe part [begin, end) in bytes that has just been loaded (LoadedPartFunction)
+static void computeLoadedUniverseLeafDigests(void*, unsigned long long begin, unsigned long long end)
+{
+    computeUniverseLeafDigests(begin / sizeof(AssetRecord), end / sizeof(AssetRecord));
+}
 
-    long long loadedSize = load(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory);
-    if (loadedSize != ASSETS_CAPACITY * sizeof(AssetRecord))
+// Load asset records from file saved in full or sparse format (without rebuilding the index lists). If computeDigests
+// is true, the leaf digests are computed while loading and all digests are up to date afterwards.
+static bool loadUniverseRecords(const CHAR16* fileName, const CHAR16* directory, bool computeDigests)
+{
+    long long loadedSize = loadAndProcess(fileName, ASSETS_CAPACITY * sizeof(AssetRecord), (unsigned char*)assets, directory,
+        computeDigests ? computeLoadedUniverseLeafDigests : NULL, NULL, universeLoadHashingPartSize * sizeof(AssetRecord),
+        /*allowShorterFile=*/true);
+    if (loadedSize > 0 && loadedSize < (long long)universeSizeInBytes)
+    {
+        // File is shorter than the full universe -> sparse format, the digests computed while loading are invalid
+        unsigned char* sparseBuffer = (unsigned char*)reorgBuffers.acquireBuffer(loadedSize);
+        ASSERT(sparseBuffer);
+        copyMem(sparseBuffer, assets, loadedSize);
+        const bool okay = UniverseSparseSnapshot::unpack(sparseBuffer, loadedSize, assets);
+        reorgBuffers.releaseBuffer(sparseBuffer);
+        if (!okay)
+        {
+            logToConsole(L"Invalid sparse universe file");
+            return false;
+        }
+        if (computeDigests)
+        {
+            computeUniverseLeafDigests(0, ASSETS_CAPACITY);
+        }
+    }
+    else if (loadedSize != ASSETS_CAPACITY * sizeof(AssetRecord))
     {
         logStatusToConsole(L"EFI_FILE_PROTOCOL.Read() reads invalid number of bytes", loadedSize, __LINE__);
 
         return false;
     }
+    if (computeDigests)
+    {
+        _InterlockedIncrement(&universeDigestsSequence);
+        assetDigestTree.rebuildInnerNodes();
+        _InterlockedIncrement(&universeDigestsSequence);
+    }
+    return true;
+}
+
+// Load universe from file saved in full or sparse format. If computeDigests is true, the leaf digests are computed
+// while loading and all digests are up to date afterwards (getUniverseDigest() doesn't need to rehash).
+static bool loadUniverse(const CHAR16* fileName = UNIVERSE_FILE_NAME, CHAR16* directory = NULL, bool computeDigests = false)
+{
+    PROFILE_SCOPE();
+
+    if (!loadUniverseRecords(fileName, directory, computeDigests))
+    {
+        return false;
+    }
     as.indexLists.rebuild();
     return true;
 }
 
+// Save universe to node state snapshot: if there is a full universe file of the current epoch saved before and not
+// too much changed since then, only a delta of the changed blocks is saved. Otherwise, the full universe is saved as
+// new base and an empty delta. Must be loaded with loadUniverseSnapshot().
+static bool saveUniverseSnapshot(const CHAR16* baseFileName, const CHAR16* deltaFileName, const CHAR16* directory)
+{
+    PROFILE_SCOPE();
+
+    const unsigned long long beginningTick = __rdtsc();
+
+    unsigned char* deltaBuffer = (unsigned char*)reorgBuffers.acquireBuffer(universeSizeInBytes);
+    ASSERT(deltaBuffer);
+    universeLock.acquireRead();
+
+    unsigned long long deltaSize = 0;
+    if (universeDeltaSnapshot.hasBase(system.epoch))
+    {
+        deltaSize = universeDeltaSnapshot.buildDelta(assetDigestTree, assets, deltaBuffer);
+    }
+    if (!deltaSize)
+    {
+        // Base needs to be saved -> forget old base in case saving fails (delta buffer is large enough to be used
+        // for building the sparse base before building the delta)
+        universeDeltaSnapshot.reset();
+        logToConsole(L"Saving universe as base of delta snapshots ...");
+        decltype(universeDeltaSnapshot)::DeltaHeader marker;
+        const unsigned long long markerSize = universeDeltaSnapshot.buildBaseBeingSavedMarker((unsigned char*)&marker);
+        if (save(deltaFileName, markerSize, (unsigned char*)&marker, directory) != (long long)markerSize
+            || saveUniverseRecords(baseFileName, directory, deltaBuffer) < 0)
+        {
+            universeLock.releaseRead();
+            reorgBuffers.releaseBuffer(deltaBuffer);
+            return false;
+        }
+        universeDeltaSnapshot.setBase(assetDigestTree, system.epoch);
+        deltaSize = universeDeltaSnapshot.buildDelta(assetDigestTree, assets, deltaBuffer);
+    }
+    universeLock.releaseRead();
+
+    const long long savedSize = save(deltaFileName, deltaSize, deltaBuffer, directory);
+    reorgBuffers.releaseBuffer(deltaBuffer);
+    if (savedSize != (long long)deltaSize)
+    {
+        return false;
+    }
+
+    setNumber(message, savedSize, TRUE);
+    appendText(message, L" bytes of universe delta are saved (");
+    appendNumber(message, (__rdtsc() - beginningTick) * 1000000 / frequency, TRUE);
+    appendText(message, L" microseconds).");
+    logToConsole(message);
+    return true;
+}
+
+// Load universe from node state snapshot saved with saveUniverseSnapshot(). A missing delta file is treated as empty
+// delta (snapshot saved before delta snapshots have been introduced).
+static bool loadUniverseSnapshot(const CHAR16* baseFileName, CHAR16* deltaFileName, CHAR16* directory)
+{
+    PROFILE_SCOPE();
+
+    if (!loadUniverseRecords(baseFileName, directory, false))
+    {
+        return false;
+    }
+
+    const long long deltaSize = getFileSize(deltaFileName, directory);
+    if (deltaSize > (long long)universeDeltaSnapshot.maxDeltaSizeInBytes)
+    {
+        logToConsole(L"Invalid size of universe delta file");
+        return false;
+    }
+    if (deltaSize >= 0)
+    {
+        unsigned char* deltaBuffer = (unsigned char*)reorgBuffers.acquireBuffer(universeDeltaSnapshot.maxDeltaSizeInBytes);
+        ASSERT(deltaBuffer);
+        const bool okay = load(deltaFileName, deltaSize, deltaBuffer, directory) == deltaSize
+            && universeDeltaSnapshot.applyDelta(deltaBuffer, deltaSize, assets);
+        reorgBuffers.releaseBuffer(deltaBuffer);
+        if (!okay)
+        {
+            logToConsole(L"Failed to load universe delta");
+            return false;
+        }
+    }
+
+    as.indexLists.rebuild();
+    return true;
+}
+
+// Number of asset records per chunk when scanning, copying, and hashing the universe in parallel in assetsEndEpoch()
+static constexpr unsigned long long universeReorgParallelChunkSize = 65536;
+static constexpr unsigned long long universeReorgParallelChunkCount = (ASSETS_CAPACITY + universeReorgParallelChunkSize - 1) / universeReorgParallelChunkSize;
+
+// Number of live possessions per chunk, converted to the number of live possessions in previous chunks
+GLOBAL_VAR_DECL unsigned int universeReorgChunkLivePossessions[universeReorgParallelChunkCount];
+
+struct UniverseReorgContext
+{
+    AssetRecord* reorgAssets;
+    unsigned int* livePossessionIndices;
+};
+
+static inline bool isLivePossession(const AssetRecord& record)
+{
+    return record.varStruct.possession.type == POSSESSION && record.varStruct.possession.numberOfShares > 0;
+}
+
+// Clear reorg buffer records [begin, end) and count live possessions in asset records [begin, end)
+// (ParallelJobs::ChunkFunction)
+static void countChunkLivePossessions(void* context, unsigned long long begin, unsigned long long end)
+{
+    const UniverseReorgContext* ctx = (const UniverseReorgContext*)context;
+    setMem(&ctx->reorgAssets[begin], (end - begin) * sizeof(AssetRecord), 0);
+    unsigned int count = 0;
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        count += isLivePossession(assets[i]);
+    }
+    universeReorgChunkLivePossessions[begin / universeReorgParallelChunkSize] = count;
+}
+
+// Write indices of live possessions in asset records [begin, end) to the list, requires
+// universeReorgChunkLivePossessions to contain the number of live possessions in previous chunks
+// (ParallelJobs::ChunkFunction)
+static void collectChunkLivePossessions(void* context, unsigned long long begin, unsigned long long end)
+{
+    const UniverseReorgContext* ctx = (const UniverseReorgContext*)context;
+    unsigned int* list = ctx->livePossessionIndices + universeReorgChunkLivePossessions[begin / universeReorgParallelChunkSize];
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        if (isLivePossession(assets[i]))
+            *list++ = (unsigned int)i;
+    }
+}
+
+// Copy reorganized asset records [begin, end) back to the universe and hash them into leaf digests
+// (ParallelJobs::ChunkFunction)
+static void copyBackAndHashChunkAssets(void* context, unsigned long long begin, unsigned long long end)
+{
+    const UniverseReorgContext* ctx = (const UniverseReorgContext*)context;
+    copyMem(&assets[begin], &ctx->reorgAssets[begin], (end - begin) * sizeof(AssetRecord));
+    computeUniverseLeafDigests(begin, end);
+}
+
+// Rebuild asset hash map, getting rid of all elements with zero shares. The universe is scanned for live possessions
+// in parallel first. The possessions are inserted by the calling processor in index order, so the resulting layout is
+// the same as with a serial scan. Finally, the records are copied back and all digests are rebuilt in parallel.
 static void assetsEndEpoch()
 {
     PROFILE_SCOPE();
 
-    ACQUIRE(universeLock);
+    static_assert(reorgBuffersSize >= universeReorgSizeInBytes, "reorgBuffers too small for reorganizing universe");
+
+    universeLock.acquireWrite();
+
+    UniverseReorgContext ctx;
+    ctx.reorgAssets = (AssetRecord*)reorgBuffers.acquireBuffer(universeReorgSizeInBytes);
+    ASSERT(ctx.reorgAssets);
+    ctx.livePossessionIndices = (unsigned int*)(ctx.reorgAssets + ASSETS_CAPACITY);
+    AssetRecord* reorgAssets = ctx.reorgAssets;
+
+    parallelJobs.run(countChunkLivePossessions, &ctx, ASSETS_CAPACITY, universeReorgParallelChunkSize);
+
+    // Convert counts per chunk to counts of previous chunks
+    unsigned int livePossessionCount = 0;
+    for (unsigned int chunkIndex = 0; chunkIndex < universeReorgParallelChunkCount; chunkIndex++)
+    {
+        const unsigned int chunkCount = universeReorgChunkLivePossessions[chunkIndex];
+        universeReorgChunkLivePossessions[chunkIndex] = livePossessionCount;
+        livePossessionCount += chunkCount;
+    }
+
+    parallelJobs.run(collectChunkLivePossessions, &ctx, ASSETS_CAPACITY, universeReorgParallelChunkSize);
 
-    // rebuild asset hash map, getting rid of all elements with zero shares
-    AssetRecord* reorgAssets = (AssetRecord*)commonBuffers.acquireBuffer(universeSizeInBytes);
-    setMem(reorgAssets, universeSizeInBytes, 0);
-    for (unsigned int i = 0; i < ASSETS_CAPACITY; i++)
+    for (unsigned int livePossessionIndex = 0; livePossessionIndex < livePossessionCount; livePossessionIndex++)
     {
-        if (assets[i].varStruct.possession.type == POSSESSION
-            && assets[i].varStruct.possession.numberOfShares > 0)
+        const unsigned int i = ctx.livePossessionIndices[livePossessionIndex];
+        const unsigned int oldOwnershipIndex = assets[i].varStruct.possession.ownershipIndex;
+        const unsigned int oldIssuanceIndex = assets[oldOwnershipIndex].varStruct.ownership.issuanceIndex;
+        const m256i& issuerPublicKey = assets[oldIssuanceIndex].varStruct.issuance.publicKey;
+        char* name = assets[oldIssuanceIndex].varStruct.issuance.name;
+        int issuanceIndex = issuerPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+    iteration2:
+        if (reorgAssets[issuanceIndex].varStruct.issuance.type == EMPTY
+            || (reorgAssets[issuanceIndex].varStruct.issuance.type == ISSUANCE
+                && ((*((unsigned long long*)reorgAssets[issuanceIndex].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == ((*((unsigned long long*)name)) & 0xFFFFFFFFFFFFFF)
+                && reorgAssets[issuanceIndex].varStruct.issuance.publicKey == issuerPublicKey))
         {
-            const unsigned int oldOwnershipIndex = assets[i].varStruct.possession.ownershipIndex;
-            const unsigned int oldIssuanceIndex = assets[oldOwnershipIndex].varStruct.ownership.issuanceIndex;
-            const m256i& issuerPublicKey = assets[oldIssuanceIndex].varStruct.issuance.publicKey;
-            char* name = assets[oldIssuanceIndex].varStruct.issuance.name;
-            int issuanceIndex = issuerPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-        iteration2:
-            if (reorgAssets[issuanceIndex].varStruct.issuance.type == EMPTY
-                || (reorgAssets[issuanceIndex].varStruct.issuance.type == ISSUANCE
-                    && ((*((unsigned long long*)reorgAssets[issuanceIndex].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == ((*((unsigned long long*)name)) & 0xFFFFFFFFFFFFFF)
-                    && reorgAssets[issuanceIndex].varStruct.issuance.publicKey == issuerPublicKey))
+            if (reorgAssets[issuanceIndex].varStruct.issuance.type == EMPTY)
+            {
+                copyMem(&reorgAssets[issuanceIndex], &assets[oldIssuanceIndex], sizeof(AssetRecord));
+            }
+
+            const m256i& ownerPublicKey = assets[oldOwnershipIndex].varStruct.ownership.publicKey;
+            int ownershipIndex = ownerPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+        iteration3:
+            if (reorgAssets[ownershipIndex].varStruct.ownership.type == EMPTY
+                || (reorgAssets[ownershipIndex].varStruct.ownership.type == OWNERSHIP
+                    && reorgAssets[ownershipIndex].varStruct.ownership.managingContractIndex == assets[oldOwnershipIndex].varStruct.ownership.managingContractIndex
+                    && reorgAssets[ownershipIndex].varStruct.ownership.issuanceIndex == issuanceIndex
+                    && reorgAssets[ownershipIndex].varStruct.ownership.publicKey == ownerPublicKey))
             {
-                if (reorgAssets[issuanceIndex].varStruct.issuance.type == EMPTY)
+                if (reorgAssets[ownershipIndex].varStruct.ownership.type == EMPTY)
                 {
-                    copyMem(&reorgAssets[issuanceIndex], &assets[oldIssuanceIndex], sizeof(AssetRecord));
+                    reorgAssets[ownershipIndex].varStruct.ownership.publicKey = ownerPublicKey;
+                    reorgAssets[ownershipIndex].varStruct.ownership.type = OWNERSHIP;
+                    reorgAssets[ownershipIndex].varStruct.ownership.managingContractIndex = assets[oldOwnershipIndex].varStruct.ownership.managingContractIndex;
+                    reorgAssets[ownershipIndex].varStruct.ownership.issuanceIndex = issuanceIndex;
                 }
-
-                const m256i& ownerPublicKey = assets[oldOwnershipIndex].varStruct.ownership.publicKey;
-                int ownershipIndex = ownerPublicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-            iteration3:
-                if (reorgAssets[ownershipIndex].varStruct.ownership.type == EMPTY
-                    || (reorgAssets[ownershipIndex].varStruct.ownership.type == OWNERSHIP
-                        && reorgAssets[ownershipIndex].varStruct.ownership.managingContractIndex == assets[oldOwnershipIndex].varStruct.ownership.managingContractIndex
-                        && reorgAssets[ownershipIndex].varStruct.ownership.issuanceIndex == issuanceIndex
-                        && reorgAssets[ownershipIndex].varStruct.ownership.publicKey == ownerPublicKey))
+                reorgAssets[ownershipIndex].varStruct.ownership.numberOfShares += assets[i].varStruct.possession.numberOfShares;
+
+                int possessionIndex = assets[i].varStruct.possession.publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
+            iteration4:
+                if (reorgAssets[possessionIndex].varStruct.possession.type == EMPTY
+                    || (reorgAssets[possessionIndex].varStruct.possession.type == POSSESSION
+                        && reorgAssets[possessionIndex].varStruct.possession.managingContractIndex == assets[i].varStruct.possession.managingContractIndex
+                        && reorgAssets[possessionIndex].varStruct.possession.ownershipIndex == ownershipIndex
+                        && reorgAssets[possessionIndex].varStruct.possession.publicKey == assets[i].varStruct.possession.publicKey))
                 {
-                    if (reorgAssets[ownershipIndex].varStruct.ownership.type == EMPTY)
-                    {
-                        reorgAssets[ownershipIndex].varStruct.ownership.publicKey = ownerPublicKey;
-                        reorgAssets[ownershipIndex].varStruct.ownership.type = OWNERSHIP;
-                        reorgAssets[ownershipIndex].varStruct.ownership.managingContractIndex = assets[oldOwnershipIndex].varStruct.ownership.managingContractIndex;
-                        reorgAssets[ownershipIndex].varStruct.ownership.issuanceIndex = issuanceIndex;
-                    }
-                    reorgAssets[ownershipIndex].varStruct.ownership.numberOfShares += assets[i].varStruct.possession.numberOfShares;
-
-                    int possessionIndex = assets[i].varStruct.possession.publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-                iteration4:
-                    if (reorgAssets[possessionIndex].varStruct.possession.type == EMPTY
-                        || (reorgAssets[possessionIndex].varStruct.possession.type == POSSESSION
-                            && reorgAssets[possessionIndex].varStruct.possession.managingContractIndex == assets[i].varStruct.possession.managingContractIndex
-                            && reorgAssets[possessionIndex].varStruct.possession.ownershipIndex == ownershipIndex
-                            && reorgAssets[possessionIndex].varStruct.possession.publicKey == assets[i].varStruct.possession.publicKey))
+                    if (reorgAssets[possessionIndex].varStruct.possession.type == EMPTY)
                     {
-                        if (reorgAssets[possessionIndex].varStruct.possession.type == EMPTY)
-                        {
-                            reorgAssets[possessionIndex].varStruct.possession.publicKey = assets[i].varStruct.possession.publicKey;
-                            reorgAssets[possessionIndex].varStruct.possession.type = POSSESSION;
-                            reorgAssets[possessionIndex].varStruct.possession.managingContractIndex = assets[i].varStruct.possession.managingContractIndex;
-                            reorgAssets[possessionIndex].varStruct.possession.ownershipIndex = ownershipIndex;
-                        }
-                        reorgAssets[possessionIndex].varStruct.possession.numberOfShares += assets[i].varStruct.possession.numberOfShares;
-                    }
-                    else
-                    {
-                        possessionIndex = (possessionIndex + 1) & (ASSETS_CAPACITY - 1);
-
-                        goto iteration4;
+                        reorgAssets[possessionIndex].varStruct.possession.publicKey = assets[i].varStruct.possession.publicKey;
+                        reorgAssets[possessionIndex].varStruct.possession.type = POSSESSION;
+                        reorgAssets[possessionIndex].varStruct.possession.managingContractIndex = assets[i].varStruct.possession.managingContractIndex;
+                        reorgAssets[possessionIndex].varStruct.possession.ownershipIndex = ownershipIndex;
                     }
+                    reorgAssets[possessionIndex].varStruct.possession.numberOfShares += assets[i].varStruct.possession.numberOfShares;
                 }
                 else
                 {
-                    ownershipIndex = (ownershipIndex + 1) & (ASSETS_CAPACITY - 1);
+                    possessionIndex = (possessionIndex + 1) & (ASSETS_CAPACITY - 1);
 
-                    goto iteration3;
+                    goto iteration4;
                 }
             }
             else
             {
-                issuanceIndex = (issuanceIndex + 1) & (ASSETS_CAPACITY - 1);
+                ownershipIndex = (ownershipIndex + 1) & (ASSETS_CAPACITY - 1);
 
-                goto iteration2;
+                goto iteration3;
             }
         }
+        else
+        {
+            issuanceIndex = (issuanceIndex + 1) & (ASSETS_CAPACITY - 1);
+
+            goto iteration2;
+        }
     }
-    copyMem(assets, reorgAssets, ASSETS_CAPACITY * sizeof(AssetRecord));
-    commonBuffers.releaseBuffer(reorgAssets);
 
-    setMem(assetChangeFlags, ASSETS_CAPACITY / 8, 0xFF);
+    _InterlockedIncrement(&universeDigestsSequence);
+    parallelJobs.run(copyBackAndHashChunkAssets, &ctx, ASSETS_CAPACITY, universeReorgParallelChunkSize);
+    assetDigestTree.rebuildInnerNodes();
+    _InterlockedIncrement(&universeDigestsSequence);
+    reorgBuffers.releaseBuffer(reorgAssets);
 
     as.indexLists.rebuild();
 
-    RELEASE(universeLock);
+    universeLock.releaseWrite();
 }
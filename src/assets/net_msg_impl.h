@@ -12,7 +12,7 @@ static void processRequestIssuedAssets(Peer* peer, RequestResponseHeader* header
 
     unsigned int universeIndex = request->publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
 
-    ACQUIRE(universeLock);
+    universeLock.acquireRead();
 
 iteration:
     if (universeIndex >= ASSETS_CAPACITY
@@ -28,7 +28,7 @@ iteration:
             copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
             response.tick = system.tick;
             response.universeIndex = universeIndex;
-            getSiblings<ASSETS_DEPTH>(response.universeIndex, assetDigests, response.siblings);
+            assetDigestTree.getSiblings(response.universeIndex, response.siblings);
 
             enqueueResponse(peer, sizeof(response), RespondIssuedAssets::type(), header->dejavu(), &response);
         }
@@ -38,7 +38,7 @@ iteration:
         goto iteration;
     }
 
-    RELEASE(universeLock);
+    universeLock.releaseRead();
 }
 
 static void processRequestOwnedAssets(Peer* peer, RequestResponseHeader* header)
@@ -47,36 +47,29 @@ static void processRequestOwnedAssets(Peer* peer, RequestResponseHeader* header)
 
     RequestOwnedAssets* request = header->getPayload<RequestOwnedAssets>();
 
-    unsigned int universeIndex = request->publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-
-    ACQUIRE(universeLock);
+    universeLock.acquireRead();
 
-iteration:
-    if (universeIndex >= ASSETS_CAPACITY
-        || assets[universeIndex].varStruct.issuance.type == EMPTY)
-    {
-        enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
-    }
-    else
+    // iterate through list of all ownership records of the entity
+    for (unsigned int universeIndex = as.indexLists.entityFirstRecordIdx(request->publicKey, OWNERSHIP);
+        universeIndex != NO_ASSET_INDEX;
+        universeIndex = as.indexLists.entityNextRecordIdx(request->publicKey, OWNERSHIP, universeIndex))
     {
-        if (assets[universeIndex].varStruct.issuance.type == OWNERSHIP
-            && assets[universeIndex].varStruct.issuance.publicKey == request->publicKey)
-        {
-            copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
-            copyMem(&response.issuanceAsset, &assets[assets[universeIndex].varStruct.ownership.issuanceIndex], sizeof(AssetRecord));
-            response.tick = system.tick;
-            response.universeIndex = universeIndex;
-            getSiblings<ASSETS_DEPTH>(response.universeIndex, assetDigests, response.siblings);
+        ASSERT(universeIndex < ASSETS_CAPACITY);
+        ASSERT(assets[universeIndex].varStruct.issuance.type == OWNERSHIP);
+        ASSERT(assets[universeIndex].varStruct.issuance.publicKey == request->publicKey);
 
-            enqueueResponse(peer, sizeof(response), RespondOwnedAssets::type(), header->dejavu(), &response);
-        }
+        copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
+        copyMem(&response.issuanceAsset, &assets[assets[universeIndex].varStruct.ownership.issuanceIndex], sizeof(AssetRecord));
+        response.tick = system.tick;
+        response.universeIndex = universeIndex;
+        assetDigestTree.getSiblings(response.universeIndex, response.siblings);
 
-        universeIndex = (universeIndex + 1) & (ASSETS_CAPACITY - 1);
-
-        goto iteration;
+        enqueueResponse(peer, sizeof(response), RespondOwnedAssets::type(), header->dejavu(), &response);
     }
 
-    RELEASE(universeLock);
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+
+    universeLock.releaseRead();
 }
 
 static void processRequestPossessedAssets(Peer* peer, RequestResponseHeader* header)
@@ -85,37 +78,30 @@ static void processRequestPossessedAssets(Peer* peer, RequestResponseHeader* hea
 
     RequestPossessedAssets* request = header->getPayload<RequestPossessedAssets>();
 
-    unsigned int universeIndex = request->publicKey.m256i_u32[0] & (ASSETS_CAPACITY - 1);
-
-    ACQUIRE(universeLock);
+    universeLock.acquireRead();
 
-iteration:
-    if (universeIndex >= ASSETS_CAPACITY
-        || assets[universeIndex].varStruct.issuance.type == EMPTY)
+    // iterate through list of all possession records of the entity
+    for (unsigned int universeIndex = as.indexLists.entityFirstRecordIdx(request->publicKey, POSSESSION);
+        universeIndex != NO_ASSET_INDEX;
+        universeIndex = as.indexLists.entityNextRecordIdx(request->publicKey, POSSESSION, universeIndex))
     {
-        enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+        ASSERT(universeIndex < ASSETS_CAPACITY);
+        ASSERT(assets[universeIndex].varStruct.issuance.type == POSSESSION);
+        ASSERT(assets[universeIndex].varStruct.issuance.publicKey == request->publicKey);
+
+        copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
+        copyMem(&response.ownershipAsset, &assets[assets[universeIndex].varStruct.possession.ownershipIndex], sizeof(AssetRecord));
+        copyMem(&response.issuanceAsset, &assets[assets[assets[universeIndex].varStruct.possession.ownershipIndex].varStruct.ownership.issuanceIndex], sizeof(AssetRecord));
+        response.tick = system.tick;
+        response.universeIndex = universeIndex;
+        assetDigestTree.getSiblings(response.universeIndex, response.siblings);
+
+        enqueueResponse(peer, sizeof(response), RespondPossessedAssets::type(), header->dejavu(), &response);
     }
-    else
-    {
-        if (assets[universeIndex].varStruct.issuance.type == POSSESSION
-            && assets[universeIndex].varStruct.issuance.publicKey == request->publicKey)
-        {
-            copyMem(&response.asset, &assets[universeIndex], sizeof(AssetRecord));
-            copyMem(&response.ownershipAsset, &assets[assets[universeIndex].varStruct.possession.ownershipIndex], sizeof(AssetRecord));
-            copyMem(&response.issuanceAsset, &assets[assets[assets[universeIndex].varStruct.possession.ownershipIndex].varStruct.ownership.issuanceIndex], sizeof(AssetRecord));
-            response.tick = system.tick;
-            response.universeIndex = universeIndex;
-            getSiblings<ASSETS_DEPTH>(response.universeIndex, assetDigests, response.siblings);
-
-            enqueueResponse(peer, sizeof(response), RespondPossessedAssets::type(), header->dejavu(), &response);
-        }
-
-        universeIndex = (universeIndex + 1) & (ASSETS_CAPACITY - 1);
 
-        goto iteration;
-    }
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 
-    RELEASE(universeLock);
+    universeLock.releaseRead();
 }
 
 static void processRequestAssetsSendRecord(Peer* peer, RequestResponseHeader* responseHeader, unsigned int universeIndex)
@@ -128,11 +114,80 @@ static void processRequestAssetsSendRecord(Peer* peer, RequestResponseHeader* re
     payload->universeIndex = universeIndex;
     if (!responseHeader->checkPayloadSize(sizeof(RequestAssets)))
     {
-        getSiblings<ASSETS_DEPTH>(universeIndex, assetDigests, payload->siblings);
+        assetDigestTree.getSiblings(universeIndex, payload->siblings);
     }
     enqueueResponse(peer, responseHeader);
 }
 
+// Collects records of processRequestAssets() with flag batchResponse and sends a RespondAssetsBatch message whenever
+// RespondAssetsBatch::maxRecords are collected. Caller has to acquire universeLock for reading before add() / flush().
+struct RespondAssetsBatchSender
+{
+    Peer* peer;
+    unsigned int dejavu;
+    bool withSiblings;
+    unsigned int count;
+    unsigned int universeIndices[RespondAssetsBatch::maxRecords];
+
+    void add(unsigned int universeIndex)
+    {
+        if (universeIndex >= ASSETS_CAPACITY)
+            return;
+        universeIndices[count++] = universeIndex;
+        if (count == RespondAssetsBatch::maxRecords)
+            flush();
+    }
+
+    // Send collected records (if any)
+    void flush()
+    {
+        if (!count)
+            return;
+
+        // sort records by universe index (required for multiproof)
+        for (unsigned int i = 1; i < count; i++)
+        {
+            const unsigned int universeIndex = universeIndices[i];
+            unsigned int j = i;
+            for (; j > 0 && universeIndices[j - 1] > universeIndex; j--)
+                universeIndices[j] = universeIndices[j - 1];
+            universeIndices[j] = universeIndex;
+        }
+
+        struct
+        {
+            RequestResponseHeader header;
+            RespondAssetsBatch payload;
+            unsigned char data[RespondAssetsBatch::maxRecords * sizeof(RespondAssetsBatch::Record) + RespondAssetsBatch::maxSiblings * sizeof(m256i)];
+        } response;
+        static_assert(sizeof(response) < 32 * 1024, "Large alloc in stack may need reconsideration.");
+
+        response.payload.tick = system.tick;
+        response.payload.numberOfRecords = (unsigned short)count;
+        response.payload.numberOfSiblings = 0;
+        RespondAssetsBatch::Record* records = response.payload.records();
+        unsigned long long leafIndices[RespondAssetsBatch::maxRecords];
+        for (unsigned int i = 0; i < count; i++)
+        {
+            copyMemory(records[i].asset, assets[universeIndices[i]]);
+            records[i].universeIndex = universeIndices[i];
+            records[i]._padding = 0;
+            leafIndices[i] = universeIndices[i];
+        }
+        if (withSiblings)
+        {
+            response.payload.numberOfSiblings = (unsigned short)assetDigestTree.getMultiproofSiblings(leafIndices, count, response.payload.siblings());
+        }
+
+        response.header.checkAndSetSize(sizeof(RequestResponseHeader) + response.payload.payloadSize());
+        response.header.setType(RespondAssetsBatch::type());
+        response.header.setDejavu(dejavu);
+        enqueueResponse(peer, &response.header);
+
+        count = 0;
+    }
+};
+
 static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
 {
     // check size of recieved message (request by universe index may be smaller than sizeof(RequestAssets))
@@ -158,6 +213,11 @@ static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
     else
         response.header.setSize<sizeof(RequestResponseHeader) + sizeof(RespondAssets)>();
 
+    // optionally, records are packed into batch messages
+    RespondAssetsBatchSender batchSender{ peer, header->dejavu(), (request->byFilter.flags & RequestAssets::getSiblings) != 0, 0 };
+    const bool batchResponse = request->assetReqType != RequestAssets::requestByUniverseIdx
+        && (request->byFilter.flags & RequestAssets::batchResponse);
+
     // find asset records and enqueue response messages (depending on request type)
     switch (request->assetReqType)
     {
@@ -181,14 +241,18 @@ static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
         }
 
         // iterate through assets records with filter
-        ACQUIRE(universeLock);
+        universeLock.acquireRead();
         AssetIssuanceIterator iter(issuanceFilter);
         while (!iter.reachedEnd())
         {
-            processRequestAssetsSendRecord(peer, &response.header, iter.issuanceIndex());
+            if (batchResponse)
+                batchSender.add(iter.issuanceIndex());
+            else
+                processRequestAssetsSendRecord(peer, &response.header, iter.issuanceIndex());
             iter.next();
         }
-        RELEASE(universeLock);
+        batchSender.flush();
+        universeLock.releaseRead();
     }
     break;
 
@@ -217,14 +281,18 @@ static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
         if (request->assetReqType == RequestAssets::requestOwnershipRecords)
         {
             // iterate through asset ownership records with filter
-            ACQUIRE(universeLock);
+            universeLock.acquireRead();
             AssetOwnershipIterator iter(asset, ownershipFilter);
             while (!iter.reachedEnd())
             {
-                processRequestAssetsSendRecord(peer, &response.header, iter.ownershipIndex());
+                if (batchResponse)
+                    batchSender.add(iter.ownershipIndex());
+                else
+                    processRequestAssetsSendRecord(peer, &response.header, iter.ownershipIndex());
                 iter.next();
             }
-            RELEASE(universeLock);
+            batchSender.flush();
+            universeLock.releaseRead();
         }
         else
         {
@@ -246,23 +314,27 @@ static void processRequestAssets(Peer* peer, RequestResponseHeader* header)
             }
 
             // iterate through asset possession records with filter
-            ACQUIRE(universeLock);
+            universeLock.acquireRead();
             AssetPossessionIterator iter(asset, ownershipFilter, possessionFilter);
             while (!iter.reachedEnd())
             {
-                processRequestAssetsSendRecord(peer, &response.header, iter.possessionIndex());
+                if (batchResponse)
+                    batchSender.add(iter.possessionIndex());
+                else
+                    processRequestAssetsSendRecord(peer, &response.header, iter.possessionIndex());
                 iter.next();
             }
-            RELEASE(universeLock);
+            batchSender.flush();
+            universeLock.releaseRead();
         }
     }
     break;
 
     case RequestAssets::requestByUniverseIdx:
     {
-        ACQUIRE(universeLock);
+        universeLock.acquireRead();
         processRequestAssetsSendRecord(peer, &response.header, request->byUniverseIdx.universeIdx);
-        RELEASE(universeLock);
+        universeLock.releaseRead();
     }
     break;
     }
@@ -11,22 +11,29 @@
 #include "contracts/math_lib.h"
 
 
-constexpr unsigned long long spectrumSizeInBytes = SPECTRUM_CAPACITY * sizeof(EntityRecord);
-constexpr unsigned long long universeSizeInBytes = ASSETS_CAPACITY * sizeof(AssetRecord);
-constexpr unsigned long long defaultCommonBuffersSize = math_lib::max(MAX_CONTRACT_STATE_SIZE, math_lib::max(spectrumSizeInBytes, universeSizeInBytes));
-
-// Buffer(s) used for:
-// - reorganizing spectrum and universe hash maps (tick processor)
-// - scratchpad buffer used internally in QPI::Collection, QPI::HashMap, QPI::HashSet,
-//   QPI::ProposalAndVotingByShareholders
-//   (often used in contract processor which does not run concurrently with tick processor, but now also used outside
-//   of contracts, e.g. pendingTxsPool.add() running in request processor may trigger Collection::_rebuild() which
-//   uses scratchpad)
-// - building oracle transactions in processTick() in tick processor
-// - calculateStableComputorIndex() in tick processor
-// - saving and loading of logging state
-// - DustBurnLogger used in increaseEnergy() in tick / contract processor
-// Must be large enough to fit any contract, full spectrum, and full universe!
+constexpr unsigned long long spectrumSizeInBytes = SPECTRUM_CAPACITY * sizeof(EntityRecord);
+constexpr unsigned long long universeSizeInBytes = ASSETS_CAPACITY * sizeof(AssetRecord);
+constexpr unsigned long long defaultCommonBuffersSize = math_lib::max(MAX_CONTRACT_STATE_SIZE, math_lib::max(spectrumSizeInBytes, universeSizeInBytes));
+// Reorganizing the universe needs the new universe followed by the list of indices of live possession records
+constexpr unsigned long long universeReorgSizeInBytes = universeSizeInBytes + ASSETS_CAPACITY * sizeof(unsigned int);
+constexpr unsigned long long reorgBuffersSize = math_lib::max(spectrumSizeInBytes, universeReorgSizeInBytes);
+
+// Size of the scratch arena of each processor (see ProcessorScratchpads)
+constexpr unsigned long long defaultScratchArenaSize = 1024 * 1024;
+
+// Pool of equally sized buffers that may be used by multiple processors. There are separate pools per use case, so a
+// user doesn't block unrelated users and each pool is only as large as needed by its users:
+// - commonBuffers: scratchpad buffers used internally in QPI::Collection, QPI::HashMap, QPI::HashSet,
+//   QPI::ProposalAndVotingByShareholders that don't fit into the scratch arena of the processor (mostly contract
+//   processor), hashing large contract states, saving and loading of logging state.
+//   Must be large enough to fit any contract!
+// - reorgBuffers: reorganizing spectrum and universe hash maps and saving / loading their delta snapshots,
+//   calculateStableComputorIndex() (tick processor and main processor).
+//   Must be large enough to fit full spectrum and full universe!
+// - PendingTxsPool::scratchpadBuffers: Collection::_rebuild() triggered by pendingTxsPool.add() in request processors
+//   (see ScopedScratchpadPool)
+// Small scratchpads, such as for building oracle transactions, DustBurnLogger, and rebuilding small QPI containers, are
+// taken from the scratch arena of the running processor (see ProcessorScratchpads).
 class CommonBuffers
 {
 public:
@@ -152,6 +159,15 @@ public:
         RELEASE(subBufferLock[bufferIdx]);
     }
 
+    // Return if buffer is one of the buffers of this pool
+    bool containsBuffer(const void* buffer) const
+    {
+        for (unsigned int i = 0; i < bufferCount; ++i)
+            if (subBufferPtr[i] == buffer)
+                return true;
+        return false;
+    }
+
     // Heuristics how many processors were waiting for a buffer in parallel (for deciding the count of buffers)
     long getMaxWaitingProcessorCount() const
     {
@@ -186,17 +202,221 @@ protected:
 
 
 GLOBAL_VAR_DECL CommonBuffers commonBuffers;
+GLOBAL_VAR_DECL CommonBuffers reorgBuffers;
+
+
+// Scratchpad state of each processor, used by __acquireScratchpad() and __releaseScratchpad():
+// - a small stack-like arena for short-lived scratchpads, which avoids waiting for the shared pools,
+// - the pool used for scratchpads that don't fit into the arena (commonBuffers by default, see ScopedScratchpadPool).
+// Each processor only accesses its own state, so no locking is needed. Processors with index >= processorCount always
+// use commonBuffers.
+// The state of the running processor is found by the address of its call stack (see setStack()), because asking the
+// firmware for the processor ID is too slow for every scratchpad. Processors running on a stack that hasn't been set
+// (such as the main processor and the processors in tests) use commonBuffers.
+class ProcessorScratchpads
+{
+public:
+    // Maximum number of scratchpads of one processor that may be acquired from its arena at the same time
+    static constexpr unsigned int maxNestedArenaScratchpads = 8;
+
+    // Allocate arenas of processors with ID < processorCount.
+    bool init(unsigned int processorCount, unsigned long long arenaSize = defaultScratchArenaSize)
+    {
+        deinit();
+        if (!processorCount || !arenaSize)
+            return false;
+
+        // memory layout: processor states | arena 1 | arena 2 | ...
+        arenaSize = (arenaSize + 63) & ~63ULL;
+        const unsigned long long stateSize = (processorCount * sizeof(ProcessorState) + 63) & ~63ULL;
+        unsigned char* buffer = nullptr;
+        if (!allocPoolWithErrorLog(L"processorScratchpads", stateSize + processorCount * arenaSize, (void**)&buffer, __LINE__))
+        {
+            return false;
+        }
+
+        setMem(buffer, stateSize, 0);
+        states = (ProcessorState*)buffer;
+        unsigned char* arena = buffer + stateSize;
+        for (unsigned int i = 0; i < processorCount; ++i)
+        {
+            states[i].arena = arena;
+            arena += arenaSize;
+        }
+        this->arenaSize = arenaSize;
+        this->processorCount = processorCount;
+
+        return true;
+    }
+
+    // Free arenas.
+    void deinit()
+    {
+        if (states)
+        {
+            freePool(states);
+            states = nullptr;
+            arenaSize = 0;
+            processorCount = 0;
+            maxArenaUsage = 0;
+        }
+    }
+
+    // Set call stack [stackBottom, stackTop) of the processor, which is used for finding the state of the running processor.
+    void setStack(unsigned int processor, const void* stackBottom, const void* stackTop)
+    {
+        if (processor >= processorCount)
+            return;
+        states[processor].stackBottom = (const unsigned char*)stackBottom;
+        states[processor].stackTop = (const unsigned char*)stackTop;
+    }
+
+    // Return index of the processor running on the stack of the caller or processorCount if the stack is unknown.
+    unsigned int findRunningProcessor() const
+    {
+        volatile unsigned char stackMarker = 0;
+        const unsigned char* stackAddress = (const unsigned char*)&stackMarker;
+        for (unsigned int i = 0; i < processorCount; ++i)
+        {
+            if (stackAddress >= states[i].stackBottom && stackAddress < states[i].stackTop)
+                return i;
+        }
+        return processorCount;
+    }
+
+    // Get buffer of given size for the processor, which must be the running processor. Returns nullptr if size is too
+    // big for the pool. Otherwise may block until buffer is available. Does not init buffer!
+    void* acquire(unsigned long long processor, unsigned long long size)
+    {
+        if (processor >= processorCount)
+            return commonBuffers.acquireBuffer(size);
+
+        ProcessorState& state = states[processor];
+        const unsigned long long alignedSize = (size + 63) & ~63ULL;
+        if (state.depth < maxNestedArenaScratchpads && alignedSize <= arenaSize - state.top)
+        {
+            void* ptr = state.arena + state.top;
+            state.offsets[state.depth++] = state.top;
+            state.top += alignedSize;
+            if (maxArenaUsage < state.top)
+                maxArenaUsage = state.top;
+            return ptr;
+        }
+
+        return (state.pool) ? state.pool->acquireBuffer(size) : commonBuffers.acquireBuffer(size);
+    }
+
+    // Release buffer that was acquired with acquire() by the same processor before.
+    void release(unsigned long long processor, void* buffer)
+    {
+        if (processor >= processorCount)
+        {
+            commonBuffers.releaseBuffer(buffer);
+            return;
+        }
+
+        ProcessorState& state = states[processor];
+        if (buffer >= state.arena && buffer < state.arena + arenaSize)
+        {
+            // scratchpads may be released before others acquired earlier, so the arena space is only freed when all
+            // scratchpads on top of it are released
+            const unsigned long long offset = (unsigned char*)buffer - state.arena;
+            for (unsigned int i = state.depth; i-- > 0; )
+            {
+                if (state.offsets[i] == offset && !(state.releasedFlags & (1u << i)))
+                {
+                    state.releasedFlags |= (1u << i);
+                    break;
+                }
+            }
+            while (state.depth && (state.releasedFlags & (1u << (state.depth - 1))))
+            {
+                --state.depth;
+                state.releasedFlags &= ~(1u << state.depth);
+                state.top = state.offsets[state.depth];
+            }
+            return;
+        }
+
+        if (state.pool && state.pool->containsBuffer(buffer))
+            state.pool->releaseBuffer(buffer);
+        else
+            commonBuffers.releaseBuffer(buffer);
+    }
+
+    // Set pool used by processor for scratchpads that don't fit into the arena (nullptr means commonBuffers). Returns
+    // the previous pool.
+    CommonBuffers* setPool(unsigned long long processor, CommonBuffers* pool)
+    {
+        if (processor >= processorCount)
+            return nullptr;
+        CommonBuffers* previousPool = states[processor].pool;
+        states[processor].pool = pool;
+        return previousPool;
+    }
+
+    // Number of bytes of the arena currently used by the processor
+    unsigned long long arenaUsage(unsigned long long processor) const
+    {
+        return (processor < processorCount) ? states[processor].top : 0;
+    }
+
+    // Maximum number of bytes used in an arena (for deciding the arena size)
+    unsigned long long getMaxArenaUsage() const
+    {
+        return maxArenaUsage;
+    }
+
+protected:
+    struct ProcessorState
+    {
+        unsigned char* arena;
+        unsigned long long top;
+        unsigned long long offsets[maxNestedArenaScratchpads];
+        unsigned int depth;
+        unsigned int releasedFlags;
+        CommonBuffers* pool;
+        const unsigned char* stackBottom;
+        const unsigned char* stackTop;
+    };
+
+    ProcessorState* states = nullptr;
+    unsigned long long arenaSize = 0;
+    unsigned int processorCount = 0;
+    unsigned long long maxArenaUsage = 0;
+};
+
+GLOBAL_VAR_DECL ProcessorScratchpads processorScratchpads;
+
+
+// Create an instance on the stack to take the scratchpads of the running processor that don't fit into its arena from
+// the given pool until the scope is left. The pool must be large enough for all scratchpads acquired in the scope.
+struct ScopedScratchpadPool
+{
+    ScopedScratchpadPool(CommonBuffers& pool) : processor(processorScratchpads.findRunningProcessor())
+    {
+        previousPool = processorScratchpads.setPool(processor, &pool);
+    }
+
+    ~ScopedScratchpadPool()
+    {
+        processorScratchpads.setPool(processor, previousPool);
+    }
+
+    unsigned long long processor;
+    CommonBuffers* previousPool;
+};
 
 
 static void* __acquireScratchpad(unsigned long long size, bool initZero = true)
 {
-    void* ptr = commonBuffers.acquireBuffer(size);
+    void* ptr = processorScratchpads.acquire(processorScratchpads.findRunningProcessor(), size);
     if (ptr && initZero)
-        setMem(ptr, size, 0);
+        setMem(ptr, size, 0);
     return ptr;
 }
 
 static void __releaseScratchpad(void* ptr)
 {
-    commonBuffers.releaseBuffer(ptr);
+    processorScratchpads.release(processorScratchpads.findRunningProcessor(), ptr);
 }
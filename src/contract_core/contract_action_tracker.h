@@ -2,6 +2,7 @@
 
 #include "../platform/m256.h"
 #include "platform/memory_util.h"
+#include "platform/assert.h"
 
 struct ContractAction
 {
@@ -41,11 +42,15 @@ public:
             freePool(actions);
     }
 
-    // Called before every use, allocBuffer() needs to be called before.
-    void init()
+    // Called before every use, allocBuffer() needs to be called before. The QU balance of watchedPublicKey is
+    // updated with each action added, so getOverallQuTransferBalance(watchedPublicKey) doesn't need to iterate all
+    // actions.
+    void init(const m256i& watchedPublicKey = m256i::zero())
     {
         ASSERT(actions != nullptr);
         numActions = 0;
+        this->watchedPublicKey = watchedPublicKey;
+        watchedBalance = 0;
     }
 
     bool addQuTransfer(const m256i& sourcePublicKey, const m256i& destinationPublicKey, long long amount)
@@ -62,11 +67,25 @@ public:
         qa.quTransfer.destinationPublicKey = destinationPublicKey;
         qa.quTransfer.amount = amount;
 
+        if (sourcePublicKey == watchedPublicKey)
+            watchedBalance -= amount;
+        if (destinationPublicKey == watchedPublicKey)
+            watchedBalance += amount;
+
         return true;
     }
 
+    // Check if count more actions can be added
+    bool hasCapacity(unsigned long long count) const
+    {
+        return count <= maxActions - numActions;
+    }
+
     long long getOverallQuTransferBalance(const m256i& publicKey)
     {
+        if (publicKey == watchedPublicKey && !isZero(watchedPublicKey))
+            return watchedBalance;
+
         long long amount = 0;
         for (unsigned int i = 0; i < numActions; ++i)
         {
@@ -85,4 +104,6 @@ public:
 private:
     ContractAction* actions;
     unsigned int numActions;
+    m256i watchedPublicKey;
+    long long watchedBalance;
 };
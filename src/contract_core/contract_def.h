@@ -303,8 +303,10 @@ constexpr unsigned short TESTEXD_CONTRACT_INDEX = (CONTRACT_INDEX + 1);
 // The following are included after the contracts to keep their definitions and dependencies
 // inaccessible for contracts
 #include "qpi_collection_impl.h"
+#include "qpi_order_book_impl.h"
 #include "qpi_trivial_impl.h"
 #include "qpi_hash_map_impl.h"
+#include "qpi_weighted_set_impl.h"
 
 #include "platform/global_var.h"
 
@@ -368,23 +370,29 @@ constexpr unsigned int contractCount = sizeof(contractDescriptions) / sizeof(con
 
 GLOBAL_VAR_DECL EXPAND_PROCEDURE contractExpandProcedures[contractCount];
 
+// Entry point of a user function or procedure with the sizes of its input, output, and locals. Keeping the sizes next
+// to the function pointer lets a call load everything it needs with one cache line access (16 bytes per entry).
+template <typename FunctionType>
+struct ContractUserEntryPoint
+{
+    FunctionType function;
+    unsigned short inputSize;
+    unsigned short outputSize;
+    // This has been changed to unsigned short to avoid the misalignment issue happening in epochs 109 and 110,
+    // probably due to too high numbers in localsSize causing stack buffer alloc to fail
+    // probably due to buffer overflow that is difficult to reproduce in test net
+    // TODO: change back to unsigned int
+    unsigned short localsSize;
+    // Peak usage of the contract locals stack by a call of the entry point from the core (including input, output,
+    // and nested calls) observed since node start, in KiB rounded up (see updateContractLocalsStackPeak())
+    unsigned short localsStackPeakKB;
+};
+static_assert(sizeof(ContractUserEntryPoint<USER_FUNCTION>) == 16, "Entry point should not cross cache line boundaries");
+static_assert(sizeof(ContractUserEntryPoint<USER_PROCEDURE>) == 16, "Entry point should not cross cache line boundaries");
+
 // TODO: all below are filled very sparsely, so a better data structure could save almost all the memory
-GLOBAL_VAR_DECL USER_FUNCTION contractUserFunctions[contractCount][65536];
-GLOBAL_VAR_DECL unsigned short contractUserFunctionInputSizes[contractCount][65536];
-GLOBAL_VAR_DECL unsigned short contractUserFunctionOutputSizes[contractCount][65536];
-// This has been changed to unsigned short to avoid the misalignment issue happening in epochs 109 and 110,
-// probably due to too high numbers in contractUserProcedureLocalsSizes causing stack buffer alloc to fail
-// probably due to buffer overflow that is difficult to reproduce in test net
-// TODO: change back to unsigned int
-GLOBAL_VAR_DECL unsigned short contractUserFunctionLocalsSizes[contractCount][65536];
-GLOBAL_VAR_DECL USER_PROCEDURE contractUserProcedures[contractCount][65536];
-GLOBAL_VAR_DECL unsigned short contractUserProcedureInputSizes[contractCount][65536];
-GLOBAL_VAR_DECL unsigned short contractUserProcedureOutputSizes[contractCount][65536];
-// This has been changed to unsigned short to avoid the misalignment issue happening in epochs 109 and 110,
-// probably due to too high numbers in contractUserProcedureLocalsSizes causing stack buffer alloc to fail
-// probably due to buffer overflow that is difficult to reproduce in test net
-// TODO: change back to unsigned int
-GLOBAL_VAR_DECL unsigned short contractUserProcedureLocalsSizes[contractCount][65536];
+GLOBAL_VAR_DECL ContractUserEntryPoint<USER_FUNCTION> contractUserFunctions[contractCount][65536];
+GLOBAL_VAR_DECL ContractUserEntryPoint<USER_PROCEDURE> contractUserProcedures[contractCount][65536];
 
 enum SystemProcedureID
 {
@@ -414,6 +422,15 @@ enum OtherEntryPointIDs
 
 GLOBAL_VAR_DECL SYSTEM_PROCEDURE contractSystemProcedures[contractCount][contractSystemProcedureCount];
 GLOBAL_VAR_DECL unsigned short contractSystemProcedureLocalsSizes[contractCount][contractSystemProcedureCount];
+// Peak usage of the contract locals stack by system procedures, like ContractUserEntryPoint::localsStackPeakKB
+GLOBAL_VAR_DECL unsigned short contractSystemProcedureLocalsStackPeakKB[contractCount][contractSystemProcedureCount];
+
+// Contracts whose BEGIN_TICK and END_TICK only write their own state (declared with TICK_HOOKS_ACCESS_ONLY_OWN_STATE()),
+// so they can run concurrently with the tick procedures of other independent contracts without changing the result
+GLOBAL_VAR_DECL bool contractTickHooksIndependent[contractCount];
+
+// Contracts that declared NO_ZERO_INIT_OF_LOCALS(), whose locals aren't zeroed when invoked by transaction or request
+GLOBAL_VAR_DECL bool contractSkipLocalsZeroInit[contractCount];
 
 
 #define REGISTER_CONTRACT_FUNCTIONS_AND_PROCEDURES(contractName) { \
@@ -443,6 +460,8 @@ contractSystemProcedureLocalsSizes[contractIndex][SET_SHAREHOLDER_PROPOSAL] = co
 if (!contractName::__setShareholderVotesEmpty) contractSystemProcedures[contractIndex][SET_SHAREHOLDER_VOTES] = (SYSTEM_PROCEDURE)contractName::__setShareholderVotes;\
 contractSystemProcedureLocalsSizes[contractIndex][SET_SHAREHOLDER_VOTES] = contractName::__setShareholderVotesLocalsSize; \
 if (!contractName::__expandEmpty) contractExpandProcedures[contractIndex] = (EXPAND_PROCEDURE)contractName::__expand;\
+contractTickHooksIndependent[contractIndex] = contractName::__tickHooksAccessOnlyOwnState; \
+contractSkipLocalsZeroInit[contractIndex] = !contractName::__zeroInitLocals; \
 QpiContextForInit qpi(contractIndex); \
 contractName::__registerUserFunctionsAndProcedures(qpi); \
 static_assert(sizeof(contractName) <= MAX_CONTRACT_STATE_SIZE, "Size of contract state " #contractName " is too large!"); \
@@ -529,7 +548,7 @@ public:
 
 protected:
     UserProcedureData userProcData[MAX_CONTRACT_PROCEDURES_REGISTERED];
-    QPI::HashMap<unsigned int, unsigned int, MAX_CONTRACT_PROCEDURES_REGISTERED> idToIndex;
+    QPI::HashMap<unsigned int, unsigned int, MAX_CONTRACT_PROCEDURES_REGISTERED, QPI::FastHashFunction<unsigned int>> idToIndex;
 };
 
 // For registering and looking up user procedures independently of input type (for notifications), initialized by initContractExec()
@@ -15,6 +15,8 @@
 #include "contract_core/stack_buffer.h"
 #include "contract_core/contract_action_tracker.h"
 #include "contract_core/execution_time_accumulator.h"
+#include "contract_core/contract_state_snapshot.h"
+#include "contract_core/contract_execution_profile.h"
 
 #include "logging/logging.h"
 #include "common_buffers.h"
@@ -40,33 +42,62 @@ enum ContractError
 
 // Used to store: locals and for first invocation level also input and output
 typedef StackBuffer<unsigned int, 32 * 1024 * 1024> ContractLocalsStack;
-GLOBAL_VAR_DECL ContractLocalsStack contractLocalsStack[NUMBER_OF_CONTRACT_EXECUTION_BUFFERS];
-GLOBAL_VAR_DECL volatile char contractLocalsStackLock[NUMBER_OF_CONTRACT_EXECUTION_BUFFERS];
+static_assert(NUMBER_OF_CONTRACT_EXECUTION_BUFFERS >= 2, "NUMBER_OF_CONTRACT_EXECUTION_BUFFERS should be at least 2.");
+static_assert(NUMBER_OF_CONTRACT_EXECUTION_BUFFERS <= 64, "Free list of contract locals stacks supports up to 64 stacks.");
+
+// Pool of contractLocalsStackCount stacks (between 2 and NUMBER_OF_CONTRACT_EXECUTION_BUFFERS, set at startup).
+// Free stacks are marked by the bits of contractLocalsStackFreeMask. Low priority users (contract functions) wait
+// in FIFO order using the tickets below.
+GLOBAL_VAR_DECL ContractLocalsStack* contractLocalsStack GLOBAL_VAR_INIT(nullptr);
+GLOBAL_VAR_DECL unsigned int contractLocalsStackCount;
+GLOBAL_VAR_DECL volatile long long contractLocalsStackFreeMask;
+GLOBAL_VAR_DECL volatile long contractLocalsStackNextTicket;
+GLOBAL_VAR_DECL volatile long contractLocalsStackServingTicket;
 GLOBAL_VAR_DECL volatile long contractLocalsStackLockWaitingCount;
 GLOBAL_VAR_DECL long contractLocalsStackLockWaitingCountMax;
 
+// Largest peak usage of the contract locals stack by any entry point (see updateContractLocalsStackPeak()) and contract
+// of that entry point, for reporting the headroom of the stacks
+GLOBAL_VAR_DECL volatile short contractLocalsStackPeakMaxKB;
+GLOBAL_VAR_DECL unsigned int contractLocalsStackPeakMaxContractIndex;
+
 struct ContractExecErrorData
 {
     LongJumpBuffer longJumpBuffer;
     unsigned int errorCode;
     unsigned int _paddingTo8;
 };
-GLOBAL_VAR_DECL ContractExecErrorData contractExecutionErrorData[contractCount];
+GLOBAL_VAR_DECL ContractExecErrorData contractExecutionErrorData[NUMBER_OF_CONTRACT_EXECUTION_BUFFERS];
 
 GLOBAL_VAR_DECL ReadWriteLock contractStateLock[contractCount];
 GLOBAL_VAR_DECL unsigned char* contractStates[contractCount];
 
+// Read-only copies of contract states published at the end of tick, used by contract functions requested via network
+GLOBAL_VAR_DECL ContractStateSnapshot contractStateSnapshots[contractCount];
+
 // Total contract execution time (as CPU clock cycles) accumulated over the whole runtime of the node (reset on restart, includes contract functions).
 GLOBAL_VAR_DECL volatile long long contractTotalExecutionTime[contractCount];
 GLOBAL_VAR_DECL ExecutionTimeAccumulator executionTimeAccumulator;
 
+// Execution time per contract entry point and tick, queried by operators for finding slow procedures and functions
+GLOBAL_VAR_DECL ContractExecutionProfile<4096, 65536, NUMBER_OF_CONTRACT_EXECUTION_BUFFERS + 1> contractExecutionProfile;
+
 // Contract error state, persistent and only set on error of procedure (TODO: only execute procedures if NoContractError)
 GLOBAL_VAR_DECL unsigned int contractError[contractCount];
 
-// TODO: If we ever have parallel procedure calls (of different contracts), we need to make
-// access to contractStateChangeFlags thread-safe
+// Set with atomic operation by system procedures, because those of different contracts may run in parallel (see
+// contractTickHooksIndependent)
 GLOBAL_VAR_DECL unsigned long long* contractStateChangeFlags GLOBAL_VAR_INIT(nullptr);
 
+// Check if a QPI call is made by BEGIN_TICK or END_TICK of a contract declaring TICK_HOOKS_ACCESS_ONLY_OWN_STATE(). Those
+// may run concurrently on helper processors, so QPI calls accessing more than the own state are refused. This doesn't
+// depend on whether they actually run concurrently on this node, so all nodes get the same result.
+static inline bool isOwnStateOnlyTickHook(unsigned int contractIndex, unsigned char entryPoint)
+{
+    ASSERT(contractIndex < contractCount);
+    return contractTickHooksIndependent[contractIndex] && (entryPoint == BEGIN_TICK || entryPoint == END_TICK);
+}
+
 // Forward declaration for getContractFeeReserve (defined in qpi_spectrum_impl.h)
 static long long getContractFeeReserve(unsigned int contractIndex);
 
@@ -103,9 +134,14 @@ struct ContractRollbackInfo
     static_assert(contractCount < (1 << 30) - 1, "Implementation assumes fewer contracts and must be changed!");
 };
 
+static inline bool isContractLocalsStackInUse(int stackIndex)
+{
+    return (contractLocalsStackFreeMask & (1ULL << stackIndex)) == 0;
+}
+
 static inline ContractRollbackInfo* contractStackUnwindRollbackInfo(int stackIndex)
 {
-    ASSERT(stackIndex >= 0 && stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(stackIndex >= 0 && stackIndex < (int)contractLocalsStackCount);
     char* ptr;
     unsigned int size;
     bool specialBlock;
@@ -120,9 +156,9 @@ static inline ContractRollbackInfo* contractStackUnwindRollbackInfo(int stackInd
 static bool rollbackContractFunctionCall(int stackIndex)
 {
     ASSERT(stackIndex >= 0);
-    ASSERT(stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
-    ASSERT(contractLocalsStackLock[stackIndex]);
-    if (stackIndex < 0 || stackIndex >= NUMBER_OF_CONTRACT_EXECUTION_BUFFERS || !contractLocalsStackLock[stackIndex])
+    ASSERT(stackIndex < (int)contractLocalsStackCount);
+    ASSERT(isContractLocalsStackInUse(stackIndex));
+    if (stackIndex < 0 || stackIndex >= (int)contractLocalsStackCount || !isContractLocalsStackInUse(stackIndex))
         return false;
 
     char* ptr;
@@ -148,7 +184,7 @@ static bool rollbackContractFunctionCall(int stackIndex)
     return true;
 }
 
-static bool initContractExec()
+static bool initContractExec(unsigned int localsStackCount = NUMBER_OF_CONTRACT_EXECUTION_BUFFERS)
 {
     for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
     {
@@ -156,29 +192,40 @@ static bool initContractExec()
     }
     setMem(contractSystemProcedures, sizeof(contractSystemProcedures), 0);
     setMem(contractSystemProcedureLocalsSizes, sizeof(contractSystemProcedureLocalsSizes), 0);
+    setMem(contractSystemProcedureLocalsStackPeakKB, sizeof(contractSystemProcedureLocalsStackPeakKB), 0);
     setMem(contractUserFunctions, sizeof(contractUserFunctions), 0);
     setMem(contractUserProcedures, sizeof(contractUserProcedures), 0);
-    setMem(contractUserFunctionInputSizes, sizeof(contractUserFunctionInputSizes), 0);
-    setMem(contractUserFunctionOutputSizes, sizeof(contractUserFunctionOutputSizes), 0);
-    setMem(contractUserFunctionLocalsSizes, sizeof(contractUserFunctionLocalsSizes), 0);
-    setMem(contractUserProcedureInputSizes, sizeof(contractUserProcedureInputSizes), 0);
-    setMem(contractUserProcedureOutputSizes, sizeof(contractUserProcedureOutputSizes), 0);
-    setMem(contractUserProcedureLocalsSizes, sizeof(contractUserProcedureLocalsSizes), 0);
-
-    for (ContractLocalsStack::SizeType i = 0; i < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS; ++i)
+
+    if (localsStackCount < 2)
+        localsStackCount = 2;
+    if (localsStackCount > NUMBER_OF_CONTRACT_EXECUTION_BUFFERS)
+        localsStackCount = NUMBER_OF_CONTRACT_EXECUTION_BUFFERS;
+    if (!allocPoolWithErrorLog(L"contractLocalsStack", localsStackCount * sizeof(ContractLocalsStack), (void**)&contractLocalsStack, __LINE__))
+    {
+        return false;
+    }
+    contractLocalsStackCount = localsStackCount;
+    for (unsigned int i = 0; i < contractLocalsStackCount; ++i)
         contractLocalsStack[i].init();
-    setMem((void*)contractLocalsStackLock, sizeof(contractLocalsStackLock), 0);
+    contractLocalsStackFreeMask = (contractLocalsStackCount == 64) ? -1LL : (long long)((1ULL << contractLocalsStackCount) - 1);
+    contractLocalsStackNextTicket = 0;
+    contractLocalsStackServingTicket = 0;
     contractLocalsStackLockWaitingCount = 0;
     contractLocalsStackLockWaitingCountMax = 0;
+    contractLocalsStackPeakMaxKB = 0;
+    contractLocalsStackPeakMaxContractIndex = 0;
 
     setMem((void*)contractTotalExecutionTime, sizeof(contractTotalExecutionTime), 0);
     executionTimeAccumulator.init();
+    if (!contractExecutionProfile.init())
+        return false;
 
     setMem((void*)contractError, sizeof(contractError), 0);
     setMem((void*)contractExecutionErrorData, sizeof(contractExecutionErrorData), 0);
     for (int i = 0; i < contractCount; ++i)
     {
         contractStateLock[i].reset();
+        contractStateSnapshots[i].reset();
     }
 
     if (!allocPoolWithErrorLog(L"contractStateChangeFlags", MAX_NUMBER_OF_CONTRACTS / 8, (void**)&contractStateChangeFlags, __LINE__))
@@ -224,34 +271,96 @@ static void deinitContractExec()
         freePool(contractStateChangeFlags);
     }
 
+    if (contractLocalsStack)
+    {
+        freePool(contractLocalsStack);
+        contractLocalsStack = nullptr;
+        contractLocalsStackCount = 0;
+    }
+
     if (userProcedureRegistry)
         freePool(userProcedureRegistry);
 
     contractActionTracker.freeBuffer();
+    contractExecutionProfile.deinit();
+
+    for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
+        contractStateSnapshots[contractIndex].deinit();
+}
+
+#if CONTRACT_FUNCTION_STATE_SNAPSHOTS
+// Allocate snapshots of contract states (optional, functions lock the live state if this fails)
+static void initContractStateSnapshots()
+{
+    for (unsigned int contractIndex = 1; contractIndex < contractCount; contractIndex++)
+        contractStateSnapshots[contractIndex].init(contractDescriptions[contractIndex].stateSize, CONTRACT_STATE_CHANGE_TRACKING);
+}
+#endif
+
+// Publish snapshot of contract state, must be called by tick processor after the state changed (see ContractStateSnapshot)
+static void publishContractStateSnapshot(unsigned int contractIndex)
+{
+    if (contractIndex >= contractCount || !contractStateSnapshots[contractIndex].isEnabled())
+        return;
+    contractStateLock[contractIndex].acquireRead();
+    contractStateSnapshots[contractIndex].publish(contractStates[contractIndex]);
+    contractStateLock[contractIndex].releaseRead();
 }
 
-// Acquire lock of an currently unused stack (may block if all in use)
+// Try to claim a free stack with index >= firstIndex from the free list. Returns stack index or -1 if there is none.
+static int tryClaimContractLocalsStack(unsigned int firstIndex)
+{
+    while (1)
+    {
+        const long long freeMask = contractLocalsStackFreeMask;
+        const unsigned long long candidates = (unsigned long long)freeMask & (~0ULL << firstIndex);
+        if (!candidates)
+            return -1;
+        const int i = (int)_tzcnt_u64(candidates);
+        if (_InterlockedCompareExchange64(&contractLocalsStackFreeMask, (long long)((unsigned long long)freeMask & ~(1ULL << i)), freeMask) == freeMask)
+            return i;
+    }
+}
+
+// Acquire a currently unused stack (may block if all in use)
 // stacksToIgnore > 0 can be passed by low priority tasks to keep some stacks reserved for high prio purposes.
+// Low priority tasks get stacks in the order of their requests, high priority tasks do not queue behind them.
 static void acquireContractLocalsStack(int& stackIdx, unsigned int stacksToIgnore = 0)
 {
-    static_assert(NUMBER_OF_CONTRACT_EXECUTION_BUFFERS >= 2, "NUMBER_OF_CONTRACT_EXECUTION_BUFFERS should be at least 2.");
     ASSERT(stackIdx < 0);
-    ASSERT(stacksToIgnore < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(stacksToIgnore < contractLocalsStackCount);
 
-    long waitingCount = _InterlockedIncrement(&contractLocalsStackLockWaitingCount);
-    if (contractLocalsStackLockWaitingCountMax < waitingCount)
-        contractLocalsStackLockWaitingCountMax = waitingCount;
+    // fast path without waiting (low priority tasks only if nobody is waiting for their turn)
+    int i = -1;
+    if (!stacksToIgnore || contractLocalsStackServingTicket == contractLocalsStackNextTicket)
+        i = tryClaimContractLocalsStack(stacksToIgnore);
 
-    int i = stacksToIgnore;
-    BEGIN_WAIT_WHILE(TRY_ACQUIRE(contractLocalsStackLock[i]) == false)
+    if (i < 0)
     {
-        ++i;
-        if (i == NUMBER_OF_CONTRACT_EXECUTION_BUFFERS)
-            i = stacksToIgnore;
-    }
-    END_WAIT_WHILE();
+        long waitingCount = _InterlockedIncrement(&contractLocalsStackLockWaitingCount);
+        if (contractLocalsStackLockWaitingCountMax < waitingCount)
+            contractLocalsStackLockWaitingCountMax = waitingCount;
 
-    _InterlockedDecrement(&contractLocalsStackLockWaitingCount);
+        if (stacksToIgnore)
+        {
+            // wait for turn in queue, then for a free stack
+            const long ticket = _InterlockedIncrement(&contractLocalsStackNextTicket) - 1;
+            BEGIN_WAIT_WHILE(contractLocalsStackServingTicket != ticket || (i = tryClaimContractLocalsStack(stacksToIgnore)) < 0)
+            {
+            }
+            END_WAIT_WHILE();
+            _InterlockedIncrement(&contractLocalsStackServingTicket);
+        }
+        else
+        {
+            BEGIN_WAIT_WHILE((i = tryClaimContractLocalsStack(0)) < 0)
+            {
+            }
+            END_WAIT_WHILE();
+        }
+
+        _InterlockedDecrement(&contractLocalsStackLockWaitingCount);
+    }
 
     stackIdx = i;
     ASSERT(stackIdx >= 0);
@@ -259,23 +368,56 @@ static void acquireContractLocalsStack(int& stackIdx, unsigned int stacksToIgnor
     ASSERT(contractLocalsStack[stackIdx].size() == 0);
     if (contractLocalsStack[stackIdx].size())
         contractLocalsStack[stackIdx].freeAll();
+    contractLocalsStack[stackIdx].resetPeakSize();
 }
 
-// Release locked stack (and reset stackIdx)
+// Release stack to free list (and reset stackIdx)
 static void releaseContractLocalsStack(int& stackIdx)
 {
     ASSERT(stackIdx >= 0);
-    ASSERT(stackIdx < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
-    ASSERT(contractLocalsStackLock[stackIdx]);
-    RELEASE(contractLocalsStackLock[stackIdx]);
+    ASSERT(stackIdx < (int)contractLocalsStackCount);
+    ASSERT(isContractLocalsStackInUse(stackIdx));
+    _InterlockedOr64(&contractLocalsStackFreeMask, 1LL << stackIdx);
     stackIdx = -1;
 }
 
+// Raise peakKB of an entry point of contractIndex to the peak usage of the stack acquired for the call (in KiB rounded
+// up). Called after the entry point returned. Calls of the same entry point may run in parallel (functions).
+static void updateContractLocalsStackPeak(unsigned short& peakKB, int stackIdx, unsigned int contractIndex)
+{
+    static_assert(ContractLocalsStack::capacity() / 1024 <= 0xffff, "Peak in KiB needs to fit into unsigned short");
+    ASSERT(stackIdx >= 0 && stackIdx < (int)contractLocalsStackCount);
+    const unsigned short newPeakKB = (unsigned short)((contractLocalsStack[stackIdx].peakSize() + 1023) / 1024);
+
+    unsigned short oldPeakKB = peakKB;
+    while (newPeakKB > oldPeakKB)
+    {
+        const unsigned short prevPeakKB = (unsigned short)_InterlockedCompareExchange16((volatile short*)&peakKB, (short)newPeakKB, (short)oldPeakKB);
+        if (prevPeakKB == oldPeakKB)
+        {
+            // only informational, so contract index may be set by a different thread than the max in rare cases
+            unsigned short oldMaxKB = (unsigned short)contractLocalsStackPeakMaxKB;
+            while (newPeakKB > oldMaxKB)
+            {
+                const unsigned short prevMaxKB = (unsigned short)_InterlockedCompareExchange16(&contractLocalsStackPeakMaxKB, (short)newPeakKB, (short)oldMaxKB);
+                if (prevMaxKB == oldMaxKB)
+                {
+                    contractLocalsStackPeakMaxContractIndex = contractIndex;
+                    break;
+                }
+                oldMaxKB = prevMaxKB;
+            }
+            break;
+        }
+        oldPeakKB = prevPeakKB;
+    }
+}
+
 // Allocate storage on ContractLocalsStack of QPI execution context
 void* QPI::QpiContextFunctionCall::__qpiAllocLocals(unsigned int sizeOfLocals) const
 {
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
-    if (_stackIndex < 0 || _stackIndex >= NUMBER_OF_CONTRACT_EXECUTION_BUFFERS)
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
+    if (_stackIndex < 0 || _stackIndex >= (int)contractLocalsStackCount)
     {
 #ifndef NDEBUG
         CHAR16 dbgMsgBuf[100];
@@ -314,8 +456,8 @@ void* QPI::QpiContextFunctionCall::__qpiAllocLocals(unsigned int sizeOfLocals) c
 // Free last allocated storage on ContractLocalsStack of QPI execution context
 void QPI::QpiContextFunctionCall::__qpiFreeLocals() const
 {
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
-    if (_stackIndex < 0 || _stackIndex >= NUMBER_OF_CONTRACT_EXECUTION_BUFFERS)
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
+    if (_stackIndex < 0 || _stackIndex >= (int)contractLocalsStackCount)
         return;
     contractLocalsStack[_stackIndex].free();
 }
@@ -324,7 +466,14 @@ void QPI::QpiContextFunctionCall::__qpiFreeLocals() const
 const QpiContextFunctionCall* QPI::QpiContextFunctionCall::__qpiConstructContextOtherContractFunctionCall(unsigned int otherContractIndex, InterContractCallError& callError) const
 {
     ASSERT(otherContractIndex < _currentContractIndex);
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
+
+    // Contract with tick procedures declared to only access own state
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+    {
+        callError = CallErrorOwnStateOnlyTickHook;
+        return nullptr;
+    }
 
     // Check if called contract is in an error state
     if (contractError[otherContractIndex] != NoContractError)
@@ -363,11 +512,18 @@ const QpiContextFunctionCall* QPI::QpiContextFunctionCall::__qpiConstructContext
 const QpiContextProcedureCall* QPI::QpiContextProcedureCall::__qpiConstructProcedureCallContext(unsigned int procContractIndex, QPI::sint64 invocationReward, InterContractCallError& callError, bool skipFeeCheck) const
 {
     ASSERT(_entryPoint != USER_FUNCTION_CALL);
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
 
     // A contract can only run a procedure of a contract with a lower index, exceptions are callback system procedures
     ASSERT(procContractIndex < _currentContractIndex || contractCallbacksRunning != NoContractCallback);
 
+    // Contract with tick procedures declared to only access own state
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+    {
+        callError = CallErrorOwnStateOnlyTickHook;
+        return nullptr;
+    }
+
     // Check if called contract is in an error state
     if (contractError[procContractIndex] != NoContractError)
     {
@@ -416,7 +572,7 @@ const QpiContextProcedureCall* QPI::QpiContextProcedureCall::__qpiConstructProce
 // Called after a contract has run a function or procedure of a different contract or a system procedure
 void QPI::QpiContextFunctionCall::__qpiFreeContext() const
 {
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
     contractLocalsStack[_stackIndex].free();
 }
 
@@ -451,7 +607,7 @@ void* QPI::QpiContextFunctionCall::__qpiAcquireStateForReading(unsigned int cont
     addDebugMessageAboutContractStateLockChange(L"__qpiAcquireStateForReading", _currentContractIndex, contractIndex, _entryPoint);
 #endif
 
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
     ASSERT(contractIndex < contractCount);
     ASSERT(contractIndex <= _currentContractIndex);
 
@@ -536,7 +692,7 @@ void QPI::QpiContextFunctionCall::__qpiReleaseStateForReading(unsigned int contr
     addDebugMessageAboutContractStateLockChange(L"__qpiReleaseStateForReading", _currentContractIndex, contractIndex, _entryPoint);
 #endif
 
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
     ASSERT(contractIndex < contractCount);
     ASSERT(contractIndex <= _currentContractIndex);
     if (contractCallbacksRunning == NoContractCallback)
@@ -577,7 +733,7 @@ void* QPI::QpiContextProcedureCall::__qpiAcquireStateForWriting(unsigned int con
     // Entry point is procedure (running in contract processor), because functions cannot acquire write lock.
     ASSERT(_entryPoint != USER_FUNCTION_CALL);
     ASSERT(contractIndex < contractCount);
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
 
     // Add rollback info for this lock to the stack
     auto rollbackInfo = reinterpret_cast<ContractRollbackInfo*>(contractLocalsStack[_stackIndex].allocateSpecial(sizeof(ContractRollbackInfo)));
@@ -636,7 +792,7 @@ void QPI::QpiContextProcedureCall::__qpiReleaseStateForWriting(unsigned int cont
     addDebugMessageAboutContractStateLockChange(L"__qpiReleaseStateForWriting", _currentContractIndex, contractIndex, _entryPoint);
 #endif
 
-    ASSERT(_stackIndex >= 0 && _stackIndex < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS);
+    ASSERT(_stackIndex >= 0 && _stackIndex < (int)contractLocalsStackCount);
     ASSERT(_entryPoint != USER_FUNCTION_CALL);
     ASSERT(contractIndex < contractCount);
     if (contractCallbacksRunning == NoContractCallback)
@@ -888,22 +1044,39 @@ void QPI::QpiContextFunctionCall::__qpiAbort(unsigned int errorCode) const
 // rollback should mark contract as faulty, state may be inconsistent, so exclude it from contractDigest?
 
 
-// Prologue of contract functions / procedures
-static void __beginFunctionOrProcedure(const unsigned int functionOrProcedureId)
+// Prologue of contract functions / procedures, returns start time passed to __endFunctionOrProcedure()
+static unsigned long long __beginFunctionOrProcedure(const unsigned int functionOrProcedureId)
 {
-    // TODO
     // called by all non-empty system procedures, user procedures, and user functions
-    // purpose:
+    // TODO:
     // - make sure the limit of nested calls is not violated
-    // - measure execution time
     // - construction of execution graph
     // - debugging
+    return __rdtsc();
 }
 
-// Epilogue of contract functions / procedures
-static void __endFunctionOrProcedure(const unsigned int functionOrProcedureId)
+// Epilogue of contract functions / procedures, adding the call to the contractExecutionProfile
+static void __endFunctionOrProcedure(const unsigned int functionOrProcedureId, const unsigned long long beginTime, const void* locals)
 {
-    // TODO
+    const unsigned long long cycles = __rdtsc() - beginTime;
+
+    // Locals are on top of the contract locals stack while the entry point runs, so the used size of the stack
+    // containing them is the stack usage of the call (including the callers in the same stack). The stack is only used
+    // by one processor at a time, so its index selects the shard of the profile.
+    unsigned int localsStackUsage = 0;
+    unsigned int shard = contractExecutionProfile.sharedShard;
+    if (locals && contractLocalsStack)
+    {
+        const unsigned long long offset = (const char*)locals - (const char*)contractLocalsStack;
+        const unsigned long long stackIndex = offset / sizeof(ContractLocalsStack);
+        if ((const char*)locals >= (const char*)contractLocalsStack && stackIndex < contractLocalsStackCount)
+        {
+            localsStackUsage = contractLocalsStack[stackIndex].size();
+            shard = (unsigned int)stackIndex;
+        }
+    }
+
+    contractExecutionProfile.addCall(shard, functionOrProcedureId, cycles, localsStackUsage);
 }
 
 QPI::QpiContextForInit::QpiContextForInit(unsigned int contractIndex) : QpiContext(contractIndex, NULL_ID, NULL_ID, 0, REGISTER_USER_FUNCTIONS_AND_PROCEDURES_CALL)
@@ -912,18 +1085,20 @@ QPI::QpiContextForInit::QpiContextForInit(unsigned int contractIndex) : QpiConte
 
 void QPI::QpiContextForInit::__registerUserFunction(USER_FUNCTION userFunction, unsigned short inputType, unsigned short inputSize, unsigned short outputSize, unsigned int localsSize) const
 {
-    contractUserFunctions[_currentContractIndex][inputType] = userFunction;
-    contractUserFunctionInputSizes[_currentContractIndex][inputType] = inputSize;
-    contractUserFunctionOutputSizes[_currentContractIndex][inputType] = outputSize;
-    contractUserFunctionLocalsSizes[_currentContractIndex][inputType] = localsSize;
+    ContractUserEntryPoint<USER_FUNCTION>& entry = contractUserFunctions[_currentContractIndex][inputType];
+    entry.function = userFunction;
+    entry.inputSize = inputSize;
+    entry.outputSize = outputSize;
+    entry.localsSize = localsSize;
 }
 
 void QPI::QpiContextForInit::__registerUserProcedure(USER_PROCEDURE userProcedure, unsigned short inputType, unsigned short inputSize, unsigned short outputSize, unsigned int localsSize) const
 {
-    contractUserProcedures[_currentContractIndex][inputType] = userProcedure;
-    contractUserProcedureInputSizes[_currentContractIndex][inputType] = inputSize;
-    contractUserProcedureOutputSizes[_currentContractIndex][inputType] = outputSize;
-    contractUserProcedureLocalsSizes[_currentContractIndex][inputType] = localsSize;
+    ContractUserEntryPoint<USER_PROCEDURE>& entry = contractUserProcedures[_currentContractIndex][inputType];
+    entry.function = userProcedure;
+    entry.inputSize = inputSize;
+    entry.outputSize = outputSize;
+    entry.localsSize = localsSize;
 }
 
 void QPI::QpiContextForInit::__registerUserProcedureNotification(USER_PROCEDURE userProcedure, unsigned int procedureId, unsigned short inputSize, unsigned short outputSize, unsigned int localsSize) const
@@ -942,9 +1117,12 @@ void QPI::QpiContextForInit::__registerUserProcedureNotification(USER_PROCEDURE
 // Currently, all system procedures that are run from outside a QpiContext are without invocation reward.
 struct QpiContextSystemProcedureCall : public QPI::QpiContextProcedureCall
 {
-    QpiContextSystemProcedureCall(unsigned int contractIndex, SystemProcedureID systemProcId) : QPI::QpiContextProcedureCall(contractIndex, NULL_ID, 0, systemProcId)
+    // Tick procedures of independent contracts running concurrently (see contractTickHooksIndependent) don't use
+    // contractActionTracker, which is shared, so it is only initialized once before by the contract processor.
+    QpiContextSystemProcedureCall(unsigned int contractIndex, SystemProcedureID systemProcId, bool initActionTracker = true) : QPI::QpiContextProcedureCall(contractIndex, NULL_ID, 0, systemProcId)
     {
-        contractActionTracker.init();
+        if (initActionTracker)
+            contractActionTracker.init();
     }
 
     // Run system procedure without input and output
@@ -1017,13 +1195,14 @@ private:
             contractLocalsStack[_stackIndex].free();
             ASSERT(contractLocalsStack[_stackIndex].size() == 0);
         }
+        updateContractLocalsStackPeak(contractSystemProcedureLocalsStackPeakKB[_currentContractIndex][systemProcId], _stackIndex, _currentContractIndex);
         const unsigned long long executionTime = endTime - startTime;
         _interlockedadd64(&contractTotalExecutionTime[_currentContractIndex], executionTime);
         executionTimeAccumulator.addTime(_currentContractIndex, executionTime);
 
         // release lock of contract state and set state to changed
         contractStateLock[_currentContractIndex].releaseWrite();
-        contractStateChangeFlags[_currentContractIndex >> 6] |= (1ULL << (_currentContractIndex & 63));
+        _InterlockedOr64((long long*)&contractStateChangeFlags[_currentContractIndex >> 6], 1LL << (_currentContractIndex & 63));
 
         // release stack
         releaseContractLocalsStack(_stackIndex);
@@ -1038,7 +1217,8 @@ struct QpiContextUserProcedureCall : public QPI::QpiContextProcedureCall
 
     QpiContextUserProcedureCall(unsigned int contractIndex, const m256i& originator, long long invocationReward) : QPI::QpiContextProcedureCall(contractIndex, originator, invocationReward, USER_PROCEDURE_CALL)
     {
-        contractActionTracker.init();
+        // track balance of invocator for finding out whether money flew in this transaction
+        contractActionTracker.init(_originator);
         if (!contractActionTracker.addQuTransfer(_originator, _currentContractId, _invocationReward))
             __qpiAbort(ContractErrorTooManyActions);
         outputBuffer = nullptr;
@@ -1065,15 +1245,16 @@ struct QpiContextUserProcedureCall : public QPI::QpiContextProcedureCall
         addDebugMessage(dbgMsgBuf);
 #endif
         ASSERT(_currentContractIndex < contractCount);
-        ASSERT(contractUserProcedures[_currentContractIndex][inputType]);
+        const ContractUserEntryPoint<USER_PROCEDURE> entry = contractUserProcedures[_currentContractIndex][inputType];
+        ASSERT(entry.function);
 
         // reserve stack for this processor (may block)
         acquireContractLocalsStack(_stackIndex);
 
         // allocate input, output, and locals buffer from stack and init them
-        unsigned short fullInputSize = contractUserProcedureInputSizes[_currentContractIndex][inputType];
-        outputSize = contractUserProcedureOutputSizes[_currentContractIndex][inputType];
-        unsigned int localsSize = contractUserProcedureLocalsSizes[_currentContractIndex][inputType];
+        unsigned short fullInputSize = entry.inputSize;
+        outputSize = entry.outputSize;
+        unsigned int localsSize = entry.localsSize;
         char* inputBuffer = contractLocalsStack[_stackIndex].allocate(fullInputSize + outputSize + localsSize);
         if (!inputBuffer)
         {
@@ -1113,16 +1294,17 @@ struct QpiContextUserProcedureCall : public QPI::QpiContextProcedureCall
             inputSize = fullInputSize;
         }
         copyMem(inputBuffer, inputPtr, inputSize);
-        setMem(outputBuffer, outputSize + localsSize, 0);
+        setMem(outputBuffer, contractSkipLocalsZeroInit[_currentContractIndex] ? outputSize : outputSize + localsSize, 0);
 
         // acquire lock of contract state for writing (shouldn't block because 1 stack is not used by functions and thus kept free for procedures)
         contractStateLock[_currentContractIndex].acquireWrite();
 
         // run procedure
         const unsigned long long startTime = __rdtsc();
-        contractUserProcedures[_currentContractIndex][inputType](*this, contractStates[_currentContractIndex], inputBuffer, outputBuffer, localsBuffer);
+        entry.function(*this, contractStates[_currentContractIndex], inputBuffer, outputBuffer, localsBuffer);
         
         const unsigned long long executionTime = __rdtsc() - startTime;
+        updateContractLocalsStackPeak(contractUserProcedures[_currentContractIndex][inputType].localsStackPeakKB, _stackIndex, _currentContractIndex);
         _interlockedadd64(&contractTotalExecutionTime[_currentContractIndex], executionTime);
         executionTimeAccumulator.addTime(_currentContractIndex, executionTime);
 
@@ -1152,10 +1334,18 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
     char* outputBuffer;
     unsigned short outputSize;
 
+    // buffer of contractStateSnapshots[_currentContractIndex] used while running function, or -1 if live state is used
+    int snapshotBufferIndex;
+
+    // version of snapshot read by last successful call(), or 0 if live state has been read
+    unsigned int snapshotVersion;
+
     QpiContextUserFunctionCall(unsigned int contractIndex) : QPI::QpiContextFunctionCall(contractIndex, NULL_ID, 0, USER_FUNCTION_CALL)
     {
         outputBuffer = nullptr;
         outputSize = 0;
+        snapshotBufferIndex = -1;
+        snapshotVersion = 0;
     }
 
     ~QpiContextUserFunctionCall()
@@ -1163,8 +1353,10 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
         freeBuffer();
     }
 
-    // call function and return error code ContractError (output is invalid if != NoContractError)
-    unsigned int call(unsigned short inputType, const void* inputPtr, unsigned short inputSize)
+    // call function and return error code ContractError (output is invalid if != NoContractError). If the caller
+    // doesn't need the input anymore (inputWritable), the function may run directly on the input buffer instead of a
+    // copy, because inputs are passed as non-const reference.
+    unsigned int call(unsigned short inputType, const void* inputPtr, unsigned short inputSize, bool inputWritable = false)
     {
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         CHAR16 dbgMsgBuf[300];
@@ -1180,7 +1372,8 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
 #endif
 
         ASSERT(_currentContractIndex < contractCount);
-        ASSERT(contractUserFunctions[_currentContractIndex][inputType]);
+        const ContractUserEntryPoint<USER_FUNCTION> entry = contractUserFunctions[_currentContractIndex][inputType];
+        ASSERT(entry.function);
 
         // Check if contract is in an error state before executing function
         if (contractError[_currentContractIndex] != NoContractError)
@@ -1192,11 +1385,13 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
         constexpr unsigned int stacksNotUsedToReserveThemForStateWriter = 1;
         acquireContractLocalsStack(_stackIndex, stacksNotUsedToReserveThemForStateWriter);
 
-        // allocate input, output, and locals buffer from stack and init them
-        unsigned short fullInputSize = contractUserFunctionInputSizes[_currentContractIndex][inputType];
-        outputSize = contractUserFunctionOutputSizes[_currentContractIndex][inputType];
-        unsigned int localsSize = contractUserFunctionLocalsSizes[_currentContractIndex][inputType];
-        char* inputBuffer = contractLocalsStack[_stackIndex].allocate(fullInputSize + outputSize + localsSize);
+        // allocate input (unless input buffer can be used directly), output, and locals buffer from stack and init them
+        unsigned short fullInputSize = entry.inputSize;
+        outputSize = entry.outputSize;
+        unsigned int localsSize = entry.localsSize;
+        const bool useInputDirectly = inputWritable && inputSize >= fullInputSize;
+        const unsigned int allocatedInputSize = useInputDirectly ? 0 : fullInputSize;
+        char* inputBuffer = contractLocalsStack[_stackIndex].allocate(allocatedInputSize + outputSize + localsSize);
         if (!inputBuffer)
         {
 #ifndef NDEBUG
@@ -1221,20 +1416,28 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
             // abort execution of contract here
             __qpiAbort(ContractErrorAllocInputOutputFailed);
         }
-        outputBuffer = inputBuffer + fullInputSize;
+        outputBuffer = inputBuffer + allocatedInputSize;
         char* localsBuffer = outputBuffer + outputSize;
-        if (inputSize < fullInputSize)
+        if (useInputDirectly)
         {
-            // less input data than expected by contract -> fill with 0
-            setMem(inputBuffer + inputSize, fullInputSize - inputSize, 0);
+            // additional bytes of input are ignored
+            inputBuffer = (char*)inputPtr;
         }
-        else if (inputSize > fullInputSize)
+        else
         {
-            // more input data than expected by contract -> discard additional bytes
-            inputSize = fullInputSize;
+            if (inputSize < fullInputSize)
+            {
+                // less input data than expected by contract -> fill with 0
+                setMem(inputBuffer + inputSize, fullInputSize - inputSize, 0);
+            }
+            else if (inputSize > fullInputSize)
+            {
+                // more input data than expected by contract -> discard additional bytes
+                inputSize = fullInputSize;
+            }
+            copyMem(inputBuffer, inputPtr, inputSize);
         }
-        copyMem(inputBuffer, inputPtr, inputSize);
-        setMem(outputBuffer, outputSize + localsSize, 0);
+        setMem(outputBuffer, contractSkipLocalsZeroInit[_currentContractIndex] ? outputSize : outputSize + localsSize, 0);
 
         // set error handler for canceling
         contractExecutionErrorData[_stackIndex].errorCode = NoContractError;
@@ -1247,6 +1450,11 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
             // release all locks using stack unwinding
             rollbackContractFunctionCall(_stackIndex);
             ASSERT(contractLocalsStack[_stackIndex].size() == 0);
+            if (snapshotBufferIndex >= 0)
+            {
+                contractStateSnapshots[_currentContractIndex].release(snapshotBufferIndex);
+                snapshotBufferIndex = -1;
+            }
 
             // release stack
             releaseContractLocalsStack(_stackIndex);
@@ -1255,16 +1463,35 @@ struct QpiContextUserFunctionCall : public QPI::QpiContextFunctionCall
             return errorCode;
         }
 
-        // acquire lock of contract state for reading (may block)
-        __qpiAcquireStateForReading(_currentContractIndex);
+        // prefer read-only snapshot of the state published at the end of last tick, which doesn't block procedures
+        // of the tick processor; otherwise acquire lock of live contract state for reading (may block)
+        unsigned int bufferIndex;
+        void* state = (void*)contractStateSnapshots[_currentContractIndex].acquire(bufferIndex);
+        snapshotVersion = 0;
+        if (state)
+        {
+            snapshotBufferIndex = bufferIndex;
+            snapshotVersion = contractStateSnapshots[_currentContractIndex].getVersion(bufferIndex);
+        }
+        else
+            state = __qpiAcquireStateForReading(_currentContractIndex);
 
         // run function
         const unsigned long long startTime = __rdtsc();
-        contractUserFunctions[_currentContractIndex][inputType](*this, contractStates[_currentContractIndex], inputBuffer, outputBuffer, localsBuffer);
+        entry.function(*this, state, inputBuffer, outputBuffer, localsBuffer);
         _interlockedadd64(&contractTotalExecutionTime[_currentContractIndex], __rdtsc() - startTime);
+        updateContractLocalsStackPeak(contractUserFunctions[_currentContractIndex][inputType].localsStackPeakKB, _stackIndex, _currentContractIndex);
 
-        // release lock of contract state
-        __qpiReleaseStateForReading(_currentContractIndex);
+        // release snapshot or lock of contract state
+        if (snapshotBufferIndex >= 0)
+        {
+            contractStateSnapshots[_currentContractIndex].release(snapshotBufferIndex);
+            snapshotBufferIndex = -1;
+        }
+        else
+        {
+            __qpiReleaseStateForReading(_currentContractIndex);
+        }
 
         return NoContractError;
     }
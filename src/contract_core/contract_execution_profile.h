@@ -0,0 +1,244 @@
+#pragma once
+
+#include "network_messages/special_command.h"
+
+#include "platform/memory_util.h"
+#include "platform/concurrency.h"
+#include "platform/assert.h"
+
+// Execution profile of contract entry points, for finding out which procedures, functions, and system procedures
+// (such as BEGIN_TICK and END_TICK) are slow. Complements the per-contract execution time of the execution fees.
+//
+// Each call of an entry point is added by the prologue/epilogue guard of the contract (see
+// __FunctionOrProcedureBeginEndGuard) to the statistics of the current tick. The statistics are kept in small open
+// addressing tables, one per shard, so processors running contracts in parallel don't contend for a common lock. The
+// caller passes the index of the contract locals stack it runs on as shard, which is used by one processor at a time
+// (calls that can't be attributed to a stack use the last shard). At the end of each tick, the tick processor merges
+// the tables of all shards and moves the statistics of the tick to a ring buffer of ContractExecutionProfileEntry
+// records, which can be queried with SPECIAL_COMMAND_GET_CONTRACT_EXECUTION_PROFILE. Records are numbered
+// consecutively, so a client can continue with the next record of its last query.
+//
+// Times are inclusive, that is, the time of a procedure includes the time of the procedures it calls. Function calls
+// requested via network are counted in the tick that was processed while they ran.
+template <unsigned int tickCapacity, unsigned int recordCapacity, unsigned int shardCount>
+class ContractExecutionProfile
+{
+    static_assert((tickCapacity & (tickCapacity - 1)) == 0, "ContractExecutionProfile tickCapacity has to be 2^N");
+    static_assert((recordCapacity & (recordCapacity - 1)) == 0, "ContractExecutionProfile recordCapacity has to be 2^N");
+    static_assert(shardCount >= 1, "ContractExecutionProfile needs at least one shard");
+
+    // Statistics of the current tick added by one shard. The lock is only contended while the tick processor merges.
+    struct Shard
+    {
+        ContractExecutionProfileEntry* entries; // entryPointId 0 means empty slot, tick is unused
+        unsigned int entryCount;
+        unsigned long long droppedCalls; // calls not counted because entries was full
+        volatile char lock;
+        char _padding[39];
+    };
+    static_assert(sizeof(Shard) == 64, "Shard is expected to fill one cache line");
+
+    Shard* shards = nullptr;
+    ContractExecutionProfileEntry* mergedEntries = nullptr; // statistics of all shards, only used by finishTick()
+    ContractExecutionProfileEntry* records = nullptr;
+    unsigned long long numberOfRecords; // total number of records added, index of next record
+    unsigned long long droppedMergedCalls; // calls not counted because mergedEntries was full
+    volatile char recordsLock;
+
+    static unsigned int slot(unsigned int entryPointId)
+    {
+        // contract index is in the upper bits, source line in lower bits
+        return (entryPointId * 0x9E3779B1u) >> 16;
+    }
+
+    // Return entry of entryPointId in table, adding it if needed, or nullptr if the table is full (more than 3/4).
+    static ContractExecutionProfileEntry* findOrAddEntry(ContractExecutionProfileEntry* table, unsigned int& entryCount, unsigned int entryPointId)
+    {
+        // linear probing, table is at most 3/4 full
+        unsigned int i = slot(entryPointId);
+        while (true)
+        {
+            i &= (tickCapacity - 1);
+            if (table[i].entryPointId == entryPointId)
+                return &table[i];
+            if (table[i].entryPointId == 0)
+            {
+                if (entryCount >= tickCapacity / 4 * 3)
+                    return nullptr;
+                table[i].entryPointId = entryPointId;
+                ++entryCount;
+                return &table[i];
+            }
+            ++i;
+        }
+    }
+
+public:
+    // Shard for calls that can't be attributed to a contract locals stack
+    static constexpr unsigned int sharedShard = shardCount - 1;
+
+    // Init at node startup.
+    bool init()
+    {
+        const unsigned long long tableSize = tickCapacity * sizeof(ContractExecutionProfileEntry);
+        if (!allocPoolWithErrorLog(L"ContractExecutionProfile::shards ", shardCount * (sizeof(Shard) + tableSize), (void**)&shards, __LINE__)
+            || !allocPoolWithErrorLog(L"ContractExecutionProfile::mergedEntries ", tableSize, (void**)&mergedEntries, __LINE__)
+            || !allocPoolWithErrorLog(L"ContractExecutionProfile::records ", recordCapacity * sizeof(ContractExecutionProfileEntry), (void**)&records, __LINE__))
+        {
+            deinit();
+            return false;
+        }
+        setMem(shards, shardCount * (sizeof(Shard) + tableSize), 0);
+        ContractExecutionProfileEntry* tables = (ContractExecutionProfileEntry*)(shards + shardCount);
+        for (unsigned int i = 0; i < shardCount; ++i)
+            shards[i].entries = tables + i * tickCapacity;
+        setMem(mergedEntries, tableSize, 0);
+        setMem(records, recordCapacity * sizeof(ContractExecutionProfileEntry), 0);
+        numberOfRecords = 0;
+        droppedMergedCalls = 0;
+        recordsLock = 0;
+        return true;
+    }
+
+    // Cleanup at node shutdown.
+    void deinit()
+    {
+        if (shards)
+        {
+            freePool(shards);
+            shards = nullptr;
+        }
+        if (mergedEntries)
+        {
+            freePool(mergedEntries);
+            mergedEntries = nullptr;
+        }
+        if (records)
+        {
+            freePool(records);
+            records = nullptr;
+        }
+    }
+
+    // Add call of entry point that took the given number of CPU cycles and used the given number of bytes of the
+    // contract locals stack. Shard is the index of the contract locals stack used by the caller or sharedShard.
+    void addCall(unsigned int shard, unsigned int entryPointId, unsigned long long cycles, unsigned int localsStackUsage)
+    {
+        ASSERT(entryPointId != 0);
+        if (!shards)
+            return;
+        if (shard >= shardCount)
+            shard = sharedShard;
+
+        Shard& s = shards[shard];
+        ACQUIRE(s.lock);
+        ContractExecutionProfileEntry* entry = findOrAddEntry(s.entries, s.entryCount, entryPointId);
+        if (!entry)
+        {
+            ++s.droppedCalls;
+            RELEASE(s.lock);
+            return;
+        }
+        ++entry->count;
+        entry->totalCycles += cycles;
+        if (cycles > entry->maxCycles)
+            entry->maxCycles = cycles;
+        if (localsStackUsage > entry->maxLocalsStackUsage)
+            entry->maxLocalsStackUsage = localsStackUsage;
+        RELEASE(s.lock);
+    }
+
+    // Merge statistics of the tick of all shards and move them to the ring buffer of records. Called by the tick
+    // processor at the end of the tick.
+    void finishTick(unsigned int tick)
+    {
+        if (!shards)
+            return;
+
+        unsigned int mergedEntryCount = 0;
+        for (unsigned int shard = 0; shard < shardCount; ++shard)
+        {
+            Shard& s = shards[shard];
+            if (!s.entryCount)
+                continue;
+            ACQUIRE(s.lock);
+            for (unsigned int i = 0; i < tickCapacity; ++i)
+            {
+                const ContractExecutionProfileEntry& entry = s.entries[i];
+                if (!entry.entryPointId)
+                    continue;
+                ContractExecutionProfileEntry* merged = findOrAddEntry(mergedEntries, mergedEntryCount, entry.entryPointId);
+                if (!merged)
+                {
+                    droppedMergedCalls += entry.count;
+                    continue;
+                }
+                merged->count += entry.count;
+                merged->totalCycles += entry.totalCycles;
+                if (entry.maxCycles > merged->maxCycles)
+                    merged->maxCycles = entry.maxCycles;
+                if (entry.maxLocalsStackUsage > merged->maxLocalsStackUsage)
+                    merged->maxLocalsStackUsage = entry.maxLocalsStackUsage;
+            }
+            setMem(s.entries, tickCapacity * sizeof(ContractExecutionProfileEntry), 0);
+            s.entryCount = 0;
+            RELEASE(s.lock);
+        }
+
+        if (mergedEntryCount)
+        {
+            ACQUIRE(recordsLock);
+            for (unsigned int i = 0; i < tickCapacity; ++i)
+            {
+                if (mergedEntries[i].entryPointId)
+                {
+                    ContractExecutionProfileEntry& record = records[numberOfRecords & (recordCapacity - 1)];
+                    record = mergedEntries[i];
+                    record.tick = tick;
+                    ++numberOfRecords;
+                }
+            }
+            RELEASE(recordsLock);
+            setMem(mergedEntries, tickCapacity * sizeof(ContractExecutionProfileEntry), 0);
+        }
+    }
+
+    // Copy up to maxCount records to output, starting with record index firstRecord (or the oldest record still
+    // available if firstRecord has been overwritten). Returns number of records copied and sets firstRecord to the
+    // index of the first record copied and nextRecord to the index for continuing with the next query.
+    unsigned int getRecords(unsigned long long& firstRecord, unsigned long long& nextRecord, ContractExecutionProfileEntry* output, unsigned int maxCount)
+    {
+        if (!records)
+        {
+            nextRecord = firstRecord;
+            return 0;
+        }
+
+        ACQUIRE(recordsLock);
+        if (firstRecord > numberOfRecords)
+            firstRecord = numberOfRecords;
+        if (numberOfRecords > recordCapacity && firstRecord < numberOfRecords - recordCapacity)
+            firstRecord = numberOfRecords - recordCapacity;
+        unsigned int count = 0;
+        while (count < maxCount && firstRecord + count < numberOfRecords)
+        {
+            output[count] = records[(firstRecord + count) & (recordCapacity - 1)];
+            ++count;
+        }
+        nextRecord = firstRecord + count;
+        RELEASE(recordsLock);
+        return count;
+    }
+
+    // Number of calls that could not be counted because too many different entry points were called in a tick
+    unsigned long long getDroppedCalls() const
+    {
+        unsigned long long droppedCalls = droppedMergedCalls;
+        if (shards)
+        {
+            for (unsigned int shard = 0; shard < shardCount; ++shard)
+                droppedCalls += shards[shard].droppedCalls;
+        }
+        return droppedCalls;
+    }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "platform/m256.h"
+#include "platform/memory_util.h"
+#include "platform/concurrency.h"
+#include "platform/debugging.h"
+
+// Cache of outputs of contract functions requested via network, for serving identical queries (such as order book
+// queries of explorers and bots) without executing the function again.
+//
+// Entries are identified by a digest of contract index, input type, and input, the tick in which the function was
+// executed, and the version of the contract state snapshot read by the function (see ContractStateSnapshot). Besides
+// their contract state, functions may read other data that changes from tick to tick (spectrum, universe, states of
+// other contracts, tick and time), so an entry is only valid in the same tick and for the same snapshot.
+//
+// Direct-mapped: a new entry overwrites the entry with the same slot. Each slot has its own lock, so request
+// processors copying outputs of different slots do not wait for each other.
+template <unsigned int capacity, unsigned int maxOutputSize>
+class ContractFunctionCache
+{
+    static_assert((capacity & (capacity - 1)) == 0, "ContractFunctionCache capacity has to be 2^N");
+
+    struct Entry
+    {
+        m256i key; // zero means empty slot
+        unsigned int tick;
+        unsigned int stateVersion;
+        unsigned int outputSize;
+        unsigned char output[maxOutputSize];
+    };
+
+    Entry* entries = nullptr;
+    volatile char locks[capacity];
+
+    static unsigned int slot(const m256i& key)
+    {
+        return key.m256i_u32[0] & (capacity - 1);
+    }
+
+public:
+    // Init at node startup.
+    bool init()
+    {
+        if (!allocPoolWithErrorLog(L"ContractFunctionCache::entries ", capacity * sizeof(Entry), (void**)&entries, __LINE__))
+        {
+            return false;
+        }
+        setMem(entries, capacity * sizeof(Entry), 0);
+        setMem((void*)locks, sizeof(locks), 0);
+        return true;
+    }
+
+    // Cleanup at node shutdown.
+    void deinit()
+    {
+        if (entries)
+        {
+            freePool(entries);
+            entries = nullptr;
+        }
+    }
+
+    // Store output of function call identified by key, executed in tick with contract state snapshot stateVersion.
+    void add(const m256i& key, unsigned int tick, unsigned int stateVersion, const void* output, unsigned int outputSize)
+    {
+        ASSERT(!isZero(key));
+        if (!entries || !stateVersion || outputSize > maxOutputSize)
+            return;
+
+        const unsigned int i = slot(key);
+        ACQUIRE(locks[i]);
+        Entry& entry = entries[i];
+        entry.key = key;
+        entry.tick = tick;
+        entry.stateVersion = stateVersion;
+        entry.outputSize = outputSize;
+        copyMem(entry.output, output, outputSize);
+        RELEASE(locks[i]);
+    }
+
+    // Copy output of function call identified by key to buffer (with maxOutputSize bytes) if it is cached for the
+    // given tick and contract state snapshot. Returns false if not found.
+    bool get(const m256i& key, unsigned int tick, unsigned int stateVersion, void* output, unsigned int& outputSize)
+    {
+        if (!entries || !stateVersion || isZero(key))
+            return false;
+
+        const unsigned int i = slot(key);
+        ACQUIRE(locks[i]);
+        const Entry& entry = entries[i];
+        const bool found = entry.key == key && entry.tick == tick && entry.stateVersion == stateVersion;
+        if (found)
+        {
+            outputSize = entry.outputSize;
+            copyMem(output, entry.output, outputSize);
+        }
+        RELEASE(locks[i]);
+        return found;
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "platform/memory.h"
+#include "platform/parallel_jobs.h"
+
+#include "common_buffers.h"
+#include "kangaroo_twelve.h"
+
+// Contract states of at least this size are hashed with multiple processors (K12 leaf chunks in parallel)
+static constexpr unsigned long long contractStateParallelHashingMinSize = 32 * K12_chunkSize;
+static constexpr unsigned long long contractStateParallelHashingLeafsPerChunk = 16;
+
+// Cache of the K12 leaf chunks (pages of K12_chunkSize bytes) of a large contract state, for only rehashing the
+// pages that changed since the last digest. Contracts write their state directly, so changed pages are detected
+// by comparing with a copy of the pages that is updated when rehashing. The digest stays K12 of the whole state.
+struct ContractStateLeafCache
+{
+    unsigned char* stateCopy;
+    unsigned char* leafChainingValues;
+    bool valid;
+};
+struct ContractStateLeafsJob
+{
+    const unsigned char* state;
+    unsigned char* leafChainingValues;
+    unsigned char* stateCopy; // nullptr if there is no cache
+    bool compareWithCopy;
+};
+
+// Check if K12_chunkSize bytes are equal
+static bool isContractStatePageUnchanged(const unsigned char* page, const unsigned char* copy)
+{
+    const __m256i* a = (const __m256i*)page;
+    const __m256i* b = (const __m256i*)copy;
+    for (unsigned int i = 0; i < K12_chunkSize / sizeof(__m256i); i += 4)
+    {
+        const __m256i diff = _mm256_or_si256(
+            _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(a + i), _mm256_loadu_si256(b + i)),
+                _mm256_xor_si256(_mm256_loadu_si256(a + i + 1), _mm256_loadu_si256(b + i + 1))),
+            _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(a + i + 2), _mm256_loadu_si256(b + i + 2)),
+                _mm256_xor_si256(_mm256_loadu_si256(a + i + 3), _mm256_loadu_si256(b + i + 3))));
+        if (!_mm256_testz_si256(diff, diff))
+            return false;
+    }
+    return true;
+}
+
+// Compute chaining values of K12 leafs [begin, end) of a contract state, skipping unchanged pages if the
+// cache is valid (ParallelJobs::ChunkFunction)
+static void computeContractStateLeafs(void* context, unsigned long long begin, unsigned long long end)
+{
+    const ContractStateLeafsJob* job = (const ContractStateLeafsJob*)context;
+    KangarooTwelveLeafBatcher batcher;
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        // leaf i is the (i + 1)-th chunk, because the first chunk is absorbed into the final node
+        const unsigned char* page = job->state + (i + 1) * K12_chunkSize;
+        if (job->stateCopy)
+        {
+            unsigned char* copy = job->stateCopy + i * K12_chunkSize;
+            if (job->compareWithCopy && isContractStatePageUnchanged(page, copy))
+                continue;
+            copyMem(copy, page, K12_chunkSize);
+        }
+        batcher.add(page, job->leafChainingValues + i * K12_capacityInBytes);
+    }
+    batcher.flush();
+}
+
+// Fill leaf cache with the K12 leaf chunks contained in the contract state part [begin, end) in bytes that has just
+// been loaded (LoadedPartFunction), so the digest doesn't need a second pass over the state
+static void computeLoadedContractStateLeafs(void* context, unsigned long long begin, unsigned long long end)
+{
+    // chunk c >= 1 is leaf c - 1, only full chunks are leafs
+    const unsigned long long beginChunk = (begin / K12_chunkSize) ? begin / K12_chunkSize : 1;
+    const unsigned long long endChunk = end / K12_chunkSize;
+    if (endChunk > beginChunk)
+        computeContractStateLeafs(context, beginChunk - 1, endChunk - 1);
+}
+
+// Allocate leaf cache for a contract state of size bytes. Returns false if the state is too small for hashing leafs in
+// parallel or allocation fails (digests are computed without cache then).
+static bool allocateContractStateLeafCache(ContractStateLeafCache& cache, unsigned long long size)
+{
+    cache.stateCopy = nullptr;
+    cache.leafChainingValues = nullptr;
+    cache.valid = false;
+    if (size < contractStateParallelHashingMinSize)
+        return false;
+
+    const unsigned int leafCount = KangarooTwelveFullLeafCount((unsigned int)size);
+    if (!allocatePool(leafCount * K12_chunkSize, (void**)&cache.stateCopy)
+        || !allocatePool(leafCount * K12_capacityInBytes, (void**)&cache.leafChainingValues))
+    {
+        if (cache.stateCopy)
+            freePool(cache.stateCopy);
+        cache.stateCopy = nullptr;
+        cache.leafChainingValues = nullptr;
+        return false;
+    }
+    return true;
+}
+
+static void freeContractStateLeafCache(ContractStateLeafCache& cache)
+{
+    if (cache.stateCopy)
+        freePool(cache.stateCopy);
+    if (cache.leafChainingValues)
+        freePool(cache.leafChainingValues);
+    cache.stateCopy = nullptr;
+    cache.leafChainingValues = nullptr;
+    cache.valid = false;
+}
+
+// Compute K12 digest of contract state with size bytes. Large states are split into K12 leaf chunks hashed by idle
+// processors in parallel (same digest as serial K12). With valid cache, only the pages that changed since the last
+// digest are rehashed.
+static void computeContractStateDigestWithLeafCache(const unsigned char* state, unsigned long long size, ContractStateLeafCache& cache, m256i& digest)
+{
+    void* leafChainingValues = nullptr;
+    void* leafChainingValuesBuffer = nullptr;
+    if (size >= contractStateParallelHashingMinSize)
+    {
+        const unsigned int leafCount = KangarooTwelveFullLeafCount((unsigned int)size);
+        ContractStateLeafsJob job{ state, cache.leafChainingValues, cache.stateCopy, cache.valid };
+        if (!cache.stateCopy)
+        {
+            leafChainingValuesBuffer = commonBuffers.acquireBuffer(leafCount * K12_capacityInBytes);
+            job.leafChainingValues = (unsigned char*)leafChainingValuesBuffer;
+        }
+        if (job.leafChainingValues)
+        {
+            parallelJobs.run(computeContractStateLeafs, &job, leafCount, contractStateParallelHashingLeafsPerChunk);
+            leafChainingValues = job.leafChainingValues;
+            cache.valid = (cache.stateCopy != nullptr);
+        }
+    }
+    KangarooTwelve(state, (unsigned int)size, &digest, 32, leafChainingValues);
+
+    if (leafChainingValuesBuffer)
+        commonBuffers.releaseBuffer(leafChainingValuesBuffer);
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "platform/memory.h"
+#include "platform/concurrency.h"
+#include "platform/assert.h"
+
+// Double-buffered read-only copy of a contract state, for running contract functions requested via network without
+// holding the lock of the live state (which delays procedures executed by the tick processor).
+//
+// The tick processor publishes the state after computing the state digest, that is, at the end of each tick in which
+// the state changed. Publishing copies the state into the buffer not handed out to readers and then swaps the
+// buffers, so a published buffer is never written. If a reader still runs in the unpublished buffer (started before
+// the last swap), publishing is postponed. Until it succeeds, the snapshot is outdated and acquire() fails, so
+// callers fall back to locking the live state.
+//
+// Each published snapshot gets a new version number (starting with 1), which identifies the state that was read.
+//
+// Optionally, the version in which each page of contractStateSnapshotPageSize bytes changed last is tracked, so
+// external mirrors of the state can sync incrementally by fetching the pages changed since the version they have.
+// Changed pages are found by comparing with the last published snapshot while copying the state.
+static constexpr unsigned long long contractStateSnapshotPageSize = 4096;
+
+class ContractStateSnapshot
+{
+    unsigned char* buffers[2];
+    unsigned long long size;
+    unsigned int* pageVersions; // nullptr if page changes aren't tracked
+    unsigned int pageCount;
+    volatile long readers[2];
+    unsigned int versions[2];
+    unsigned int lastVersion;
+    volatile char lock;
+    unsigned char publishedIndex;
+    bool upToDate;
+    bool publishPending;
+
+public:
+    // Set empty state without buffers (acquire() always fails)
+    void reset()
+    {
+        buffers[0] = nullptr;
+        buffers[1] = nullptr;
+        size = 0;
+        pageVersions = nullptr;
+        pageCount = 0;
+        readers[0] = 0;
+        readers[1] = 0;
+        versions[0] = 0;
+        versions[1] = 0;
+        lastVersion = 0;
+        lock = 0;
+        publishedIndex = 0;
+        upToDate = false;
+        publishPending = false;
+    }
+
+    // Allocate buffers for state of given size. Returns false if allocation failed (snapshot stays disabled).
+    bool init(unsigned long long stateSize, bool trackPageChanges = false)
+    {
+        reset();
+        if (!stateSize)
+            return false;
+        const unsigned int statePageCount = (unsigned int)((stateSize + contractStateSnapshotPageSize - 1) / contractStateSnapshotPageSize);
+        if (!allocatePool(stateSize, (void**)&buffers[0]) || !allocatePool(stateSize, (void**)&buffers[1])
+            || (trackPageChanges && !allocatePool(statePageCount * sizeof(unsigned int), (void**)&pageVersions)))
+        {
+            deinit();
+            return false;
+        }
+        memoryRegistry.add(L"ContractStateSnapshot", buffers[0], stateSize, stateSize);
+        memoryRegistry.add(L"ContractStateSnapshot", buffers[1], stateSize, stateSize);
+        if (pageVersions)
+            memoryRegistry.add(L"ContractStateSnapshot", pageVersions, statePageCount * sizeof(unsigned int), statePageCount * sizeof(unsigned int));
+        size = stateSize;
+        if (pageVersions)
+        {
+            setMem(pageVersions, statePageCount * sizeof(unsigned int), 0);
+            pageCount = statePageCount;
+        }
+        return true;
+    }
+
+    // Free buffers. No reader may be active.
+    void deinit()
+    {
+        ASSERT(readers[0] == 0 && readers[1] == 0);
+        if (buffers[0])
+            freePool(buffers[0]);
+        if (buffers[1])
+            freePool(buffers[1]);
+        if (pageVersions)
+            freePool(pageVersions);
+        reset();
+    }
+
+    bool isEnabled() const
+    {
+        return size != 0;
+    }
+
+    // Return whether last publish() has been postponed and needs to be retried
+    bool isPublishPending() const
+    {
+        return publishPending;
+    }
+
+    // Copy state to snapshot and make it available to readers. The caller must make sure that the state isn't
+    // written during the call (for example by holding the read lock of the state). Returns false if publishing has
+    // been postponed, because readers are still active in the unpublished buffer.
+    bool publish(const void* state)
+    {
+        if (!isEnabled())
+            return true;
+
+        ACQUIRE(lock);
+        const unsigned char backIndex = publishedIndex ^ 1;
+        if (readers[backIndex])
+        {
+            // readers of the snapshot before the last one are still running -> stop handing out outdated snapshot
+            upToDate = false;
+            publishPending = true;
+            RELEASE(lock);
+            return false;
+        }
+        RELEASE(lock);
+
+        // new readers only get the published buffer, so the back buffer can be written without lock
+        if (pageVersions)
+            copyAndTrackPageChanges(state, backIndex);
+        else
+            copyMem(buffers[backIndex], state, size);
+
+        ACQUIRE(lock);
+        publishedIndex = backIndex;
+        versions[backIndex] = ++lastVersion;
+        upToDate = true;
+        publishPending = false;
+        RELEASE(lock);
+        return true;
+    }
+
+    // Get published snapshot for reading or nullptr if it isn't available. If successful, release(bufferIndex) must
+    // be called after reading.
+    const void* acquire(unsigned int& bufferIndex)
+    {
+        if (!isEnabled())
+            return nullptr;
+
+        ACQUIRE(lock);
+        if (!upToDate)
+        {
+            RELEASE(lock);
+            return nullptr;
+        }
+        bufferIndex = publishedIndex;
+        _InterlockedIncrement(&readers[bufferIndex]);
+        RELEASE(lock);
+        return buffers[bufferIndex];
+    }
+
+    // Get version of snapshot acquired before
+    unsigned int getVersion(unsigned int bufferIndex) const
+    {
+        ASSERT(bufferIndex < 2);
+        return versions[bufferIndex];
+    }
+
+    // Get version of published snapshot, or 0 if it isn't available
+    unsigned int getPublishedVersion()
+    {
+        if (!isEnabled())
+            return 0;
+
+        ACQUIRE(lock);
+        const unsigned int version = upToDate ? versions[publishedIndex] : 0;
+        RELEASE(lock);
+        return version;
+    }
+
+    // Finish reading snapshot acquired before
+    void release(unsigned int bufferIndex)
+    {
+        ASSERT(bufferIndex < 2);
+        ASSERT(readers[bufferIndex] > 0);
+        _InterlockedDecrement(&readers[bufferIndex]);
+    }
+
+    // Return whether versions of page changes are available (see getPageVersion())
+    bool isTrackingPageChanges() const
+    {
+        return pageVersions != nullptr;
+    }
+
+    // Number of pages of contractStateSnapshotPageSize bytes (the last one may be shorter), 0 if changes aren't tracked
+    unsigned int getPageCount() const
+    {
+        return pageCount;
+    }
+
+    // Get version of the last published snapshot in which the page changed. May be called while reading an acquired
+    // snapshot. A page changed after the acquired version may already report the newer version, but a page never
+    // reports an older version than the last change it contains.
+    unsigned int getPageVersion(unsigned int page) const
+    {
+        ASSERT(page < pageCount);
+        return ((volatile unsigned int*)pageVersions)[page];
+    }
+
+private:
+    static bool isPageEqual(const unsigned char* a, const unsigned char* b, unsigned long long pageSize)
+    {
+        // compare 8 bytes at once, remainder (only in last page of odd-sized state) byte by byte
+        const unsigned long long words = pageSize / 8;
+        for (unsigned long long i = 0; i < words; ++i)
+        {
+            if (((const unsigned long long*)a)[i] != ((const unsigned long long*)b)[i])
+                return false;
+        }
+        for (unsigned long long i = words * 8; i < pageSize; ++i)
+        {
+            if (a[i] != b[i])
+                return false;
+        }
+        return true;
+    }
+
+    // Copy state to back buffer and set version of pages that differ from the published snapshot to the next version.
+    // Called by publish() only, while no reader is active in the back buffer.
+    void copyAndTrackPageChanges(const void* state, unsigned char backIndex)
+    {
+        const unsigned int nextVersion = lastVersion + 1;
+        const unsigned char* src = (const unsigned char*)state;
+        const unsigned char* published = buffers[publishedIndex];
+        unsigned char* dst = buffers[backIndex];
+        for (unsigned int page = 0; page < pageCount; ++page)
+        {
+            const unsigned long long begin = page * contractStateSnapshotPageSize;
+            const unsigned long long pageSize = (size - begin < contractStateSnapshotPageSize) ? size - begin : contractStateSnapshotPageSize;
+            // published buffer isn't initialized before the first version
+            if (!lastVersion || !isPageEqual(src + begin, published + begin, pageSize))
+                pageVersions[page] = nextVersion;
+            copyMem(dst + begin, src + begin, pageSize);
+        }
+    }
+};
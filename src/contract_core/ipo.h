@@ -13,6 +13,40 @@ static m256i releasedPublicKeys[NUMBER_OF_COMPUTORS];
 static long long releasedAmounts[NUMBER_OF_COMPUTORS];
 static unsigned int numberOfReleasedEntities;
 
+// Hash map from public key to index + 1 in releasedPublicKeys (0 = empty slot), for aggregating refunds per entity
+// without scanning all entities released before
+static constexpr unsigned int releasedEntitiesHashMapCapacity = 2048; // must be 2^N and larger than NUMBER_OF_COMPUTORS
+static unsigned short releasedEntitiesHashMap[releasedEntitiesHashMapCapacity];
+
+static void resetReleasedEntities()
+{
+    numberOfReleasedEntities = 0;
+    setMem(releasedEntitiesHashMap, sizeof(releasedEntitiesHashMap), 0);
+}
+
+// Add amount to the refund of publicKey. Entities are kept in the order of their first release.
+static void releaseAmount(const m256i& publicKey, long long amount)
+{
+    unsigned int slot = publicKey.m256i_u32[0] & (releasedEntitiesHashMapCapacity - 1);
+    while (releasedEntitiesHashMap[slot])
+    {
+        const unsigned int j = releasedEntitiesHashMap[slot] - 1;
+        if (releasedPublicKeys[j] == publicKey)
+        {
+            releasedAmounts[j] += amount;
+            return;
+        }
+        slot = (slot + 1) & (releasedEntitiesHashMapCapacity - 1);
+    }
+    ASSERT(numberOfReleasedEntities < NUMBER_OF_COMPUTORS);
+    releasedPublicKeys[numberOfReleasedEntities] = publicKey;
+    releasedAmounts[numberOfReleasedEntities++] = amount;
+    releasedEntitiesHashMap[slot] = (unsigned short)numberOfReleasedEntities;
+}
+
+// Incremented whenever bids of the IPO of a contract change, so responses derived from the bids can be cached
+static volatile long ipoBidsVersion[contractCount];
+
 
 // Bid in contract IPO (caller has to ensure that contractIndex is in IPO phase).
 // This deducts price * quantity QU. Bids that don't get shares are refunded.
@@ -39,70 +73,57 @@ static long long bidInContractIPO(long long price, unsigned short quantity, cons
             const QuTransfer quTransfer = { sourcePublicKey, m256i::zero(), amount };
             logger.logQuTransfer(quTransfer);
 
-            registeredBids = 0;
-            numberOfReleasedEntities = 0;
+            resetReleasedEntities();
             contractStateLock[contractIndex].acquireWrite();
             IPO* ipo = (IPO*)contractStates[contractIndex];
-            for (unsigned int i = 0; i < quantity; i++)
+
+            // Bids are sorted by price in descending order, bids with the same price in order of arrival. Find the
+            // position behind all bids with price >= price by binary search. Each unit of quantity replaces the
+            // lowest bid if that is lower than price, so the result is the same as inserting the units one by one.
+            unsigned int insertionIndex = 0, endIndex = NUMBER_OF_COMPUTORS;
+            while (insertionIndex < endIndex)
             {
-                if (price <= ipo->prices[NUMBER_OF_COMPUTORS - 1])
+                const unsigned int middleIndex = (insertionIndex + endIndex) / 2;
+                if (ipo->prices[middleIndex] < price)
                 {
-                    unsigned int j;
-                    for (j = 0; j < numberOfReleasedEntities; j++)
-                    {
-                        if (sourcePublicKey == releasedPublicKeys[j])
-                        {
-                            break;
-                        }
-                    }
-                    if (j == numberOfReleasedEntities)
-                    {
-                        releasedPublicKeys[numberOfReleasedEntities] = sourcePublicKey;
-                        releasedAmounts[numberOfReleasedEntities++] = price;
-                    }
-                    else
-                    {
-                        releasedAmounts[j] += price;
-                    }
+                    endIndex = middleIndex;
                 }
                 else
                 {
-                    unsigned int j;
-                    for (j = 0; j < numberOfReleasedEntities; j++)
-                    {
-                        if (ipo->publicKeys[NUMBER_OF_COMPUTORS - 1] == releasedPublicKeys[j])
-                        {
-                            break;
-                        }
-                    }
-                    if (j == numberOfReleasedEntities)
-                    {
-                        releasedPublicKeys[numberOfReleasedEntities] = ipo->publicKeys[NUMBER_OF_COMPUTORS - 1];
-                        releasedAmounts[numberOfReleasedEntities++] = ipo->prices[NUMBER_OF_COMPUTORS - 1];
-                    }
-                    else
-                    {
-                        releasedAmounts[j] += ipo->prices[NUMBER_OF_COMPUTORS - 1];
-                    }
-
-                    ipo->publicKeys[NUMBER_OF_COMPUTORS - 1] = sourcePublicKey;
-                    ipo->prices[NUMBER_OF_COMPUTORS - 1] = price;
-                    j = NUMBER_OF_COMPUTORS - 1;
-                    while (j
-                        && ipo->prices[j - 1] < ipo->prices[j])
-                    {
-                        const m256i tmpPublicKey = ipo->publicKeys[j - 1];
-                        const long long tmpPrice = ipo->prices[j - 1];
-                        ipo->publicKeys[j - 1] = ipo->publicKeys[j];
-                        ipo->prices[j - 1] = ipo->prices[j];
-                        ipo->publicKeys[j] = tmpPublicKey;
-                        ipo->prices[j--] = tmpPrice;
-                    }
-
-                    contractStateChangeFlags[contractIndex >> 6] |= (1ULL << (contractIndex & 63));
-                    ++registeredBids;
+                    insertionIndex = middleIndex + 1;
                 }
             }
+            const unsigned int lowerBids = NUMBER_OF_COMPUTORS - insertionIndex;
+            const unsigned int acceptedBids = (quantity < lowerBids) ? quantity : lowerBids;
+
+            if (acceptedBids)
+            {
+                // Release the lowest bids, starting with the last one
+                for (unsigned int j = 1; j <= acceptedBids; j++)
+                {
+                    releaseAmount(ipo->publicKeys[NUMBER_OF_COMPUTORS - j], ipo->prices[NUMBER_OF_COMPUTORS - j]);
+                }
+
+                // Move remaining lower bids behind the new bids
+                for (unsigned int j = NUMBER_OF_COMPUTORS - 1; j >= insertionIndex + acceptedBids; j--)
+                {
+                    ipo->publicKeys[j] = ipo->publicKeys[j - acceptedBids];
+                    ipo->prices[j] = ipo->prices[j - acceptedBids];
+                }
+                for (unsigned int j = insertionIndex; j < insertionIndex + acceptedBids; j++)
+                {
+                    ipo->publicKeys[j] = sourcePublicKey;
+                    ipo->prices[j] = price;
+                }
+
+                contractStateChangeFlags[contractIndex >> 6] |= (1ULL << (contractIndex & 63));
+                ipoBidsVersion[contractIndex] = ipoBidsVersion[contractIndex] + 1;
+            }
+            if (acceptedBids < quantity)
+            {
+                releaseAmount(sourcePublicKey, price * (quantity - acceptedBids));
+            }
+            registeredBids = acceptedBids;
             contractStateLock[contractIndex].releaseWrite();
 
             for (unsigned int i = 0; i < numberOfReleasedEntities; i++)
@@ -141,28 +162,12 @@ static void finishIPOs()
                     finalPrice = 0;
                 }
             }
-            numberOfReleasedEntities = 0;
+            resetReleasedEntities();
             for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
             {
                 if (ipo->prices[i] > finalPrice)
                 {
-                    unsigned int j;
-                    for (j = 0; j < numberOfReleasedEntities; j++)
-                    {
-                        if (ipo->publicKeys[i] == releasedPublicKeys[j])
-                        {
-                            break;
-                        }
-                    }
-                    if (j == numberOfReleasedEntities)
-                    {
-                        releasedPublicKeys[numberOfReleasedEntities] = ipo->publicKeys[i];
-                        releasedAmounts[numberOfReleasedEntities++] = ipo->prices[i] - finalPrice;
-                    }
-                    else
-                    {
-                        releasedAmounts[j] += (ipo->prices[i] - finalPrice);
-                    }
+                    releaseAmount(ipo->publicKeys[i], ipo->prices[i] - finalPrice);
                 }
                 if (finalPrice)
                 {
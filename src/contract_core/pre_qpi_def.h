@@ -31,8 +31,8 @@ constexpr unsigned long long CONTRACT_ACTION_TRACKER_SIZE = 16 * 1024 * 1024;
 constexpr unsigned int MAX_CONTRACT_PROCEDURES_REGISTERED = 16 * 1024;
 
 
-static void __beginFunctionOrProcedure(const unsigned int); // TODO: more human-readable form of function ID?
-static void __endFunctionOrProcedure(const unsigned int);
+static unsigned long long __beginFunctionOrProcedure(const unsigned int); // TODO: more human-readable form of function ID?
+static void __endFunctionOrProcedure(const unsigned int, const unsigned long long, const void*);
 template <typename T> static m256i __K12(T);
 template <typename T> static void __logContractDebugMessage(unsigned int, T&);
 template <typename T> static void __logContractErrorMessage(unsigned int, T&);
@@ -78,15 +78,18 @@ struct __ScopedScratchpad
 template <unsigned int functionOrProcedureId>
 struct __FunctionOrProcedureBeginEndGuard
 {
-    // Constructor calling __beginFunctionOrProcedure()
-    __FunctionOrProcedureBeginEndGuard()
+    // Constructor calling __beginFunctionOrProcedure(). Locals are passed for measuring the contract locals stack usage.
+    __FunctionOrProcedureBeginEndGuard(const void* locals = nullptr) : locals(locals)
     {
-        __beginFunctionOrProcedure(functionOrProcedureId);
+        beginTime = __beginFunctionOrProcedure(functionOrProcedureId);
     }
 
     // Destructor making sure __endFunctionOrProcedure() is called for every return path
     ~__FunctionOrProcedureBeginEndGuard()
     {
-        __endFunctionOrProcedure(functionOrProcedureId);
+        __endFunctionOrProcedure(functionOrProcedureId, beginTime, locals);
     }
+
+    unsigned long long beginTime;
+    const void* locals;
 };
@@ -5,6 +5,11 @@
 #include "assets/assets.h"
 #include "spectrum/spectrum.h"
 
+// Shareholders and dividends collected by distributeDividends() (not reentrant, because it isn't allowed in
+// POST_INCOMING_TRANSFER callbacks)
+GLOBAL_VAR_DECL m256i dividendRecipients[NUMBER_OF_COMPUTORS];
+GLOBAL_VAR_DECL long long dividendAmounts[NUMBER_OF_COMPUTORS];
+
 
 
 // Start iteration with issuance filter (selects first record).
@@ -59,9 +64,29 @@ bool QPI::AssetIssuanceIterator::next()
         _issuanceIdx = NO_ASSET_INDEX;
         return false;
     }
+    else if (!_issuance.anyName)
+    {
+        // issuer is unknown but name is given -> use list of issuances with the name
+        if (_issuanceIdx == NO_ASSET_INDEX)
+        {
+            // get first issuance with name
+            _issuanceIdx = as.indexLists.assetNameFirstIssuanceIdx(_issuance.assetName);
+        }
+        else
+        {
+            // get next issuance with name
+            _issuanceIdx = as.indexLists.entityNextIdx[_issuanceIdx];
+        }
+        ASSERT(_issuanceIdx == NO_ASSET_INDEX
+            || (_issuanceIdx < ASSETS_CAPACITY
+                && assets[_issuanceIdx].varStruct.issuance.type == ISSUANCE
+                && ((*((unsigned long long*)assets[_issuanceIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) == _issuance.assetName));
+
+        return _issuanceIdx != NO_ASSET_INDEX;
+    }
     else
     {
-        // issuer is unknow -> use index lists instead of hash map to iterate through issuances
+        // issuer and name are unknown -> use index lists instead of hash map to iterate through all issuances
         if (_issuanceIdx == NO_ASSET_INDEX)
         {
             // get first issuance
@@ -76,19 +101,6 @@ bool QPI::AssetIssuanceIterator::next()
             || (_issuanceIdx < ASSETS_CAPACITY
                 && assets[_issuanceIdx].varStruct.issuance.type == ISSUANCE));
 
-        // if specific asset name is requested, make sure the issuance matches
-        if (!_issuance.anyName)
-        {
-            while (_issuanceIdx != NO_ASSET_INDEX
-                && ((*((unsigned long long*)assets[_issuanceIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF) != _issuance.assetName)
-            {
-                _issuanceIdx = as.indexLists.nextIdx[_issuanceIdx];
-                ASSERT(_issuanceIdx == NO_ASSET_INDEX
-                    || (_issuanceIdx < ASSETS_CAPACITY
-                        && assets[_issuanceIdx].varStruct.issuance.type == ISSUANCE));
-            }
-        }
-
         return _issuanceIdx != NO_ASSET_INDEX;
     }
 }
@@ -379,6 +391,9 @@ sint64 QPI::QpiContextProcedureCall::acquireShares(
     uint16 sourceOwnershipManagingContractIndex, uint16 sourcePossessionManagingContractIndex,
     sint64 offeredTransferFee) const
 {
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+        return INVALID_AMOUNT;
+
     // prevent nested calling of management rights transfer from callbacks
     if (contractCallbacksRunning & ContractCallbackManagementRightsTransfer)
     {
@@ -462,6 +477,8 @@ sint64 QPI::QpiContextProcedureCall::acquireShares(
 
 bool QPI::QpiContextProcedureCall::distributeDividends(long long amountPerShare) const
 {
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+        return false;
     if (contractCallbacksRunning & ContractCallbackPostIncomingTransfer)
     {
         return false;
@@ -495,11 +512,14 @@ bool QPI::QpiContextProcedureCall::distributeDividends(long long amountPerShare)
 
     if (decreaseEnergy(index, amountPerShare * NUMBER_OF_COMPUTORS))
     {
-        ACQUIRE(universeLock);
+        // Collect shareholders while holding the universe lock only once (the iterator follows the possession lists
+        // of the contract's asset, see AssetStorage::IndexLists)
+        universeLock.acquireRead();
 
         Asset asset(id::zero(), *((unsigned long long*)contractDescriptions[_currentContractIndex].assetName));
         AssetPossessionIterator iter(asset);
         long long totalShareCounter = 0;
+        unsigned int recipientCount = 0;
 
         while (!iter.reachedEnd())
         {
@@ -507,18 +527,11 @@ bool QPI::QpiContextProcedureCall::distributeDividends(long long amountPerShare)
 
             const auto& possession = assets[iter.possessionIndex()].varStruct.possession;
 
-            if (possession.numberOfShares)
+            if (possession.numberOfShares && recipientCount < NUMBER_OF_COMPUTORS)
             {
-                const long long dividend = amountPerShare * possession.numberOfShares;
-                increaseEnergy(possession.publicKey, dividend);
-
-                if (!contractActionTracker.addQuTransfer(_currentContractId, possession.publicKey, dividend))
-                    __qpiAbort(ContractErrorTooManyActions);
-
-                __qpiNotifyPostIncomingTransfer(_currentContractId, possession.publicKey, dividend, TransferType::qpiDistributeDividends);
-
-                const QuTransfer quTransfer = { _currentContractId, possession.publicKey, dividend };
-                logger.logQuTransfer(quTransfer);
+                dividendRecipients[recipientCount] = possession.publicKey;
+                dividendAmounts[recipientCount] = amountPerShare * possession.numberOfShares;
+                ++recipientCount;
 
                 totalShareCounter += possession.numberOfShares;
             }
@@ -528,7 +541,47 @@ bool QPI::QpiContextProcedureCall::distributeDividends(long long amountPerShare)
 
         ASSERT(totalShareCounter == NUMBER_OF_COMPUTORS || totalShareCounter == 0);
 
-        RELEASE(universeLock);
+        universeLock.releaseRead();
+
+        if (!contractActionTracker.hasCapacity(recipientCount))
+            __qpiAbort(ContractErrorTooManyActions);
+
+        // Pay out in order of possession records, locking the spectrum once per run of recipients up to the next
+        // contract, because the POST_INCOMING_TRANSFER callback of a contract has to see the same spectrum as if
+        // each dividend was paid out separately. Transfers are logged in QuTransferBatch messages, split before the
+        // callbacks.
+        QuTransferBatchLogger batchLogger(_currentContractId);
+        unsigned int first = 0;
+        while (first < recipientCount)
+        {
+            unsigned int end = first;
+            while (end < recipientCount)
+            {
+                // same condition as in __qpiNotifyPostIncomingTransfer()
+                const m256i& recipient = dividendRecipients[end++];
+                if (recipient.u64._0 < contractCount && !recipient.u64._2 && !recipient.u64._3)
+                    break;
+            }
+
+            increaseEnergyOfMany(dividendRecipients + first, dividendAmounts + first, end - first);
+
+            for (unsigned int i = first; i < end; ++i)
+            {
+                contractActionTracker.addQuTransfer(_currentContractId, dividendRecipients[i], dividendAmounts[i]);
+
+                const m256i& recipient = dividendRecipients[i];
+                if (recipient.u64._0 < contractCount && !recipient.u64._2 && !recipient.u64._3)
+                {
+                    batchLogger.finished();
+                    __qpiNotifyPostIncomingTransfer(_currentContractId, recipient, dividendAmounts[i], TransferType::qpiDistributeDividends);
+                }
+
+                batchLogger.addTransfer(dividendRecipients[i], dividendAmounts[i]);
+            }
+
+            first = end;
+        }
+        batchLogger.finished();
     }
     dcm = DummyCustomMessage{ CUSTOM_MESSAGE_OP_END_DISTRIBUTE_DIVIDENDS };
     logger.logCustomMessage(dcm);
@@ -538,6 +591,8 @@ bool QPI::QpiContextProcedureCall::distributeDividends(long long amountPerShare)
 
 long long QPI::QpiContextProcedureCall::issueAsset(unsigned long long name, const QPI::id& issuer, signed char numberOfDecimalPlaces, long long numberOfShares, unsigned long long unitOfMeasurement) const
 {
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+        return 0;
     if (((unsigned char)name) < 'A' || ((unsigned char)name) > 'Z'
         || name > 0xFFFFFFFFFFFFFF)
     {
@@ -613,6 +668,9 @@ sint64 QPI::QpiContextProcedureCall::releaseShares(
     uint16 destinationOwnershipManagingContractIndex, uint16 destinationPossessionManagingContractIndex,
     sint64 offeredTransferFee) const
 {
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+        return INVALID_AMOUNT;
+
     // prevent nested calling of management rights transfer from callbacks
     if (contractCallbacksRunning & ContractCallbackManagementRightsTransfer)
     {
@@ -693,18 +751,20 @@ sint64 QPI::QpiContextProcedureCall::releaseShares(
 
 long long QPI::QpiContextProcedureCall::transferShareOwnershipAndPossession(unsigned long long assetName, const m256i& issuer, const m256i& owner, const m256i& possessor, long long numberOfShares, const m256i& newOwnerAndPossessor) const
 {
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+        return -((long long)(MAX_AMOUNT + 1));
     if (numberOfShares <= 0 || numberOfShares > MAX_AMOUNT)
     {
         return -((long long)(MAX_AMOUNT + 1));
     }
 
-    ACQUIRE(universeLock);
+    universeLock.acquireWrite();
 
     int issuanceIndex = issuer.m256i_u32[0] & (ASSETS_CAPACITY - 1);
 iteration:
     if (assets[issuanceIndex].varStruct.issuance.type == EMPTY)
     {
-        RELEASE(universeLock);
+        universeLock.releaseWrite();
 
         return -numberOfShares;
     }
@@ -718,7 +778,7 @@ iteration:
         iteration2:
             if (assets[ownershipIndex].varStruct.ownership.type == EMPTY)
             {
-                RELEASE(universeLock);
+                universeLock.releaseWrite();
 
                 return -numberOfShares;
             }
@@ -733,7 +793,7 @@ iteration:
                 iteration3:
                     if (assets[possessionIndex].varStruct.possession.type == EMPTY)
                     {
-                        RELEASE(universeLock);
+                        universeLock.releaseWrite();
 
                         return -numberOfShares;
                     }
@@ -750,27 +810,27 @@ iteration:
                                     int destinationOwnershipIndex, destinationPossessionIndex;
                                     if (!::transferShareOwnershipAndPossession(ownershipIndex, possessionIndex, newOwnerAndPossessor, numberOfShares, &destinationOwnershipIndex, &destinationPossessionIndex, false))
                                     {
-                                        RELEASE(universeLock);
+                                        universeLock.releaseWrite();
 
                                         return INVALID_AMOUNT;
                                     }
                                     else
                                     {
-                                        RELEASE(universeLock);
+                                        universeLock.releaseWrite();
 
                                         return assets[possessionIndex].varStruct.possession.numberOfShares;
                                     }
                                 }
                                 else
                                 {
-                                    RELEASE(universeLock);
+                                    universeLock.releaseWrite();
 
                                     return assets[possessionIndex].varStruct.possession.numberOfShares - numberOfShares;
                                 }
                             }
                             else
                             {
-                                RELEASE(universeLock);
+                                universeLock.releaseWrite();
 
                                 return -numberOfShares;
                             }
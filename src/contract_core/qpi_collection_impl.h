@@ -10,8 +10,8 @@
 
 namespace QPI
 {
-	template <typename T, uint64 L>
-	void Collection<T, L>::_softReset()
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	void Collection<T, L, selfBalancing, reclaimRemovedSlots>::_softReset()
 	{
 		setMem(_povs, sizeof(_povs), 0);
 		setMem(_povOccupationFlags, sizeof(_povOccupationFlags), 0);
@@ -19,8 +19,8 @@ namespace QPI
 		_markRemovalCounter = 0;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_povIndex(const id& pov) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_povIndex(const id& pov) const
 	{
 		sint64 povIndex = pov.u64._0 & (L - 1);
 		for (sint64 counter = 0; counter < L; counter += 32)
@@ -45,8 +45,8 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_headIndex(const sint64 povIndex, const sint64 maxPriority) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_headIndex(const sint64 povIndex, const sint64 maxPriority) const
 	{
 		// with current code path, pov is not empty here
 		const auto& pov = _povs[povIndex];
@@ -94,8 +94,8 @@ namespace QPI
 		return idx;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_tailIndex(const sint64 povIndex, const sint64 minPriority) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_tailIndex(const sint64 povIndex, const sint64 minPriority) const
 	{
 		// with current code path, pov is not empty here
 		const auto& pov = _povs[povIndex];
@@ -144,8 +144,8 @@ namespace QPI
 		return idx;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_searchElement(const sint64 bstRootIndex,
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_searchElement(const sint64 bstRootIndex,
 		const sint64 priority, int* pIterationsCount) const
 	{
 		sint64 idx = bstRootIndex;
@@ -182,8 +182,8 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_addPovElement(const sint64 povIndex, const T value, const sint64 priority)
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_addPovElement(const sint64 povIndex, const T value, const sint64 priority)
 	{
 		const sint64 newElementIdx = _population++;
 		auto& newElement = _elements[newElementIdx].init(value, priority, povIndex);
@@ -220,7 +220,14 @@ namespace QPI
 			{
 				pov.tailIndex = newElementIdx;
 			}
-			if (pov.population > 32 && iterations_count > pov.population / 4)
+			if constexpr (selfBalancing)
+			{
+				if (iterations_count > _maxBalancedHeight(pov.population))
+				{
+					_rebalanceAfterInsert(povIndex, newElementIdx);
+				}
+			}
+			else if (pov.population > 32 && iterations_count > pov.population / 4)
 			{
 				// make balanced binary search tree to get better performance
 				pov.bstRootIndex = _rebuild(pov.bstRootIndex);
@@ -229,13 +236,19 @@ namespace QPI
 		return newElementIdx;
 	}
 
-	template <typename T, uint64 L>
-	uint64 Collection<T, L>::_getSortedElements(const sint64 rootIdx, sint64* sortedElementIndices) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	uint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_getSortedElements(const sint64 rootIdx, sint64* sortedElementIndices) const
 	{
+		if (rootIdx == NULL_INDEX)
+		{
+			return 0;
+		}
 		uint64 count = 0;
 		sint64 elementIdx = rootIdx;
-		sint64 lastElementIdx = NULL_INDEX;
-		while (elementIdx != NULL_INDEX)
+		// traversal ends when returning from subtree root to its parent
+		const sint64 endIdx = _elements[rootIdx].bstParentIndex;
+		sint64 lastElementIdx = endIdx;
+		while (elementIdx != endIdx)
 		{
 			if (lastElementIdx == _elements[elementIdx].bstParentIndex)
 			{
@@ -249,7 +262,11 @@ namespace QPI
 			}
 			if (lastElementIdx == _elements[elementIdx].bstLeftIndex)
 			{
-				sortedElementIndices[count++] = elementIdx;
+				if (sortedElementIndices)
+				{
+					sortedElementIndices[count] = elementIdx;
+				}
+				count++;
 
 				if (_elements[elementIdx].bstRightIndex != NULL_INDEX)
 				{
@@ -268,8 +285,8 @@ namespace QPI
 		return count;
 	}
 
-	template <typename T, uint64 L>
-	inline void Collection<T, L>::_set(sint64_4& vec, sint64 v0, sint64 v1, sint64 v2, sint64 v3) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	inline void Collection<T, L, selfBalancing, reclaimRemovedSlots>::_set(sint64_4& vec, sint64 v0, sint64 v1, sint64 v2, sint64 v3) const
 	{
 		vec.set(0, v0);
 		vec.set(1, v1);
@@ -277,8 +294,8 @@ namespace QPI
 		vec.set(3, v3);
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_rebuild(sint64 rootIdx)
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_rebuild(sint64 rootIdx)
 	{
 		__ScopedScratchpad scratchpad(sizeof(*this), /*initZero=*/false);
 		auto* sortedElementIndices = reinterpret_cast<sint64*>(scratchpad.ptr);
@@ -291,12 +308,25 @@ namespace QPI
 		{
 			return rootIdx;
 		}
-		// initialize root
+		// initialize root, keeping parent of subtree
+		const sint64 oldRootIdx = rootIdx;
+		const sint64 rootParentIdx = _elements[oldRootIdx].bstParentIndex;
 		sint64 mid = n / 2;
 		rootIdx = sortedElementIndices[mid];
-		_elements[rootIdx].bstParentIndex = NULL_INDEX;
+		_elements[rootIdx].bstParentIndex = rootParentIdx;
 		_elements[rootIdx].bstLeftIndex = NULL_INDEX;
 		_elements[rootIdx].bstRightIndex = NULL_INDEX;
+		if (rootParentIdx != NULL_INDEX)
+		{
+			if (_elements[rootParentIdx].bstLeftIndex == oldRootIdx)
+			{
+				_elements[rootParentIdx].bstLeftIndex = rootIdx;
+			}
+			else
+			{
+				_elements[rootParentIdx].bstRightIndex = rootIdx;
+			}
+		}
 		// initialize queue
 		auto* queue = reinterpret_cast<sint64_4*>(sortedElementIndices + ((n + 3) / 4) * 4);
 		sint64 dequeueIdx = 0;
@@ -364,8 +394,51 @@ namespace QPI
 		return rootIdx;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_getMostLeft(sint64 elementIdx) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_maxBalancedHeight(uint64 n)
+	{
+		sint64 height = 0;
+		while (n > 1)
+		{
+			n >>= 1;
+			height += 2;
+		}
+		return height;
+	}
+
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	void Collection<T, L, selfBalancing, reclaimRemovedSlots>::_rebalanceAfterInsert(const sint64 povIndex, const sint64 newElementIdx)
+	{
+		// Walk up from the new leaf and find the lowest ancestor whose subtree is too deep for its size. Such a
+		// scapegoat exists, because the new element is too deep for the whole tree. Its subtree is rebuilt, which
+		// doesn't change the order of elements.
+		sint64 subtreeRootIdx = newElementIdx;
+		uint64 subtreeSize = 1;
+		sint64 subtreeHeight = 0;
+		while (_elements[subtreeRootIdx].bstParentIndex != NULL_INDEX)
+		{
+			const sint64 childIdx = subtreeRootIdx;
+			subtreeRootIdx = _elements[childIdx].bstParentIndex;
+			const auto& parent = _elements[subtreeRootIdx];
+			const sint64 siblingIdx = (parent.bstLeftIndex == childIdx) ? parent.bstRightIndex : parent.bstLeftIndex;
+			subtreeSize += 1 + _getSortedElements(siblingIdx, nullptr);
+			subtreeHeight++;
+			if (subtreeHeight > _maxBalancedHeight(subtreeSize))
+			{
+				break;
+			}
+		}
+
+		auto& pov = _povs[povIndex];
+		const sint64 newSubtreeRootIdx = _rebuild(subtreeRootIdx);
+		if (pov.bstRootIndex == subtreeRootIdx)
+		{
+			pov.bstRootIndex = newSubtreeRootIdx;
+		}
+	}
+
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_getMostLeft(sint64 elementIdx) const
 	{
 		while (_elements[elementIdx].bstLeftIndex != NULL_INDEX)
 		{
@@ -374,8 +447,8 @@ namespace QPI
 		return elementIdx;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_getMostRight(sint64 elementIdx) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_getMostRight(sint64 elementIdx) const
 	{
 		while (_elements[elementIdx].bstRightIndex != NULL_INDEX)
 		{
@@ -384,8 +457,8 @@ namespace QPI
 		return elementIdx;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_previousElementIndex(sint64 elementIdx) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_previousElementIndex(sint64 elementIdx) const
 	{
 		elementIdx &= (L - 1);
 		if (uint64(elementIdx) < _population)
@@ -415,8 +488,8 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::_nextElementIndex(sint64 elementIdx) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_nextElementIndex(sint64 elementIdx) const
 	{
 		elementIdx &= (L - 1);
 		if (uint64(elementIdx) < _population)
@@ -446,8 +519,8 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename T, uint64 L>
-	bool Collection<T, L>::_updateParent(const sint64 elementIdx, const sint64 newElementIdx)
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	bool Collection<T, L, selfBalancing, reclaimRemovedSlots>::_updateParent(const sint64 elementIdx, const sint64 newElementIdx)
 	{
 		if (elementIdx != NULL_INDEX)
 		{
@@ -473,8 +546,8 @@ namespace QPI
 		return false;
 	}
 
-	template <typename T, uint64 L>
-	void Collection<T, L>::_moveElement(const sint64 srcIdx, const sint64 dstIdx)
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	void Collection<T, L, selfBalancing, reclaimRemovedSlots>::_moveElement(const sint64 srcIdx, const sint64 dstIdx)
 	{
 		copyMem(&_elements[dstIdx], &_elements[srcIdx], sizeof(_elements[0]));
 
@@ -516,8 +589,8 @@ namespace QPI
 		}
 	}
 
-	template <typename T, uint64 L>
-	uint64 Collection<T, L>::_getEncodedPovOccupationFlags(const uint64* povOccupationFlags, const sint64 povIndex) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	uint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::_getEncodedPovOccupationFlags(const uint64* povOccupationFlags, const sint64 povIndex) const
 	{
 		const sint64 offset = (povIndex & 31) << 1;
 		uint64 flags = povOccupationFlags[povIndex >> 5] >> offset;
@@ -528,8 +601,8 @@ namespace QPI
 		return flags;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::add(const id& pov, T element, sint64 priority)
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::add(const id& pov, T element, sint64 priority)
 	{
 		if (_population < capacity())
 		{
@@ -585,8 +658,8 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename T, uint64 L>
-	void Collection<T, L>::cleanupIfNeeded(uint64 removalThresholdPercent)
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	void Collection<T, L, selfBalancing, reclaimRemovedSlots>::cleanupIfNeeded(uint64 removalThresholdPercent)
 	{
 		if (_markRemovalCounter > (removalThresholdPercent * L / 100))
 		{
@@ -594,8 +667,8 @@ namespace QPI
 		}
 	}
 
-	template <typename T, uint64 L>
-	void Collection<T, L>::cleanup()
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	void Collection<T, L, selfBalancing, reclaimRemovedSlots>::cleanup()
 	{
 		// _povs gets occupied over time with entries of type 3 which means they are marked for cleanup.
 		// Once cleanup is called it's necessary to remove all these type 3 entries by reconstructing a fresh Collection residing in scratchpad buffer.
@@ -707,22 +780,22 @@ namespace QPI
 #endif
 	}
 
-	template <typename T, uint64 L>
-	inline T Collection<T, L>::element(sint64 elementIndex) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	inline T Collection<T, L, selfBalancing, reclaimRemovedSlots>::element(sint64 elementIndex) const
 	{
 		return _elements[elementIndex & (L - 1)].value;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::headIndex(const id& pov) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::headIndex(const id& pov) const
 	{
 		const sint64 povIndex = _povIndex(pov);
 
 		return povIndex < 0 ? NULL_INDEX : _povs[povIndex].headIndex;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::headIndex(const id& pov, sint64 maxPriority) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::headIndex(const id& pov, sint64 maxPriority) const
 	{
 		const sint64 povIndex = _povIndex(pov);
 		if (povIndex < 0)
@@ -733,46 +806,81 @@ namespace QPI
 		return _headIndex(povIndex, maxPriority);
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::nextElementIndex(sint64 elementIndex) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::elementIndex(const id& pov, sint64 priority) const
+	{
+		const sint64 povIndex = _povIndex(pov);
+		if (povIndex < 0)
+		{
+			return NULL_INDEX;
+		}
+
+		const sint64 idx = _headIndex(povIndex, priority);
+		return (idx != NULL_INDEX && _elements[idx].priority == priority) ? idx : NULL_INDEX;
+	}
+
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::nextElementIndex(sint64 elementIndex) const
 	{
 		return _nextElementIndex(elementIndex);
 	}
 
-	template <typename T, uint64 L>
-	inline uint64 Collection<T, L>::population() const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	inline uint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::population() const
 	{
 		return _population;
 	}
 
-	template <typename T, uint64 L>
-	uint64 Collection<T, L>::population(const id& pov) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	uint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::population(const id& pov) const
 	{
 		const sint64 povIndex = _povIndex(pov);
 
 		return povIndex < 0 ? 0 : _povs[povIndex].population;
 	}
 
-	template <typename T, uint64 L>
-	id Collection<T, L>::pov(sint64 elementIndex) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	id Collection<T, L, selfBalancing, reclaimRemovedSlots>::pov(sint64 elementIndex) const
 	{
 		return _povs[_elements[elementIndex & (L - 1)].povIndex].value;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::prevElementIndex(sint64 elementIndex) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::prevElementIndex(sint64 elementIndex) const
 	{
 		return _previousElementIndex(elementIndex);
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::priority(sint64 elementIndex) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::priority(sint64 elementIndex) const
 	{
 		return _elements[elementIndex & (L - 1)].priority;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::remove(sint64 elementIdx)
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	void Collection<T, L, selfBalancing, reclaimRemovedSlots>::_reclaimRemovedPovSlots(sint64 povIndex)
+	{
+		const sint64 nextIndex = (povIndex + 1) & (L - 1);
+		if ((_povOccupationFlags[nextIndex >> 5] >> ((nextIndex & 31) << 1)) & 3ULL)
+		{
+			return;
+		}
+		for (sint64 i = 0; i < _maxReclaimedSlots && _markRemovalCounter; i++)
+		{
+			const uint64 shift = (povIndex & 31) << 1;
+			if (((_povOccupationFlags[povIndex >> 5] >> shift) & 3ULL) != 2)
+			{
+				break;
+			}
+			_povOccupationFlags[povIndex >> 5] &= ~(3ULL << shift);
+			setMem(&_povs[povIndex], sizeof(PoV), 0);
+			_markRemovalCounter--;
+			povIndex = (povIndex - 1) & (L - 1);
+		}
+	}
+
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::remove(sint64 elementIdx)
 	{
 		sint64 nextElementIdxOfRemoved = NULL_INDEX;
 		elementIdx &= (L - 1);
@@ -866,6 +974,10 @@ namespace QPI
 				pov.population = 0;
 				_markRemovalCounter++;
 				_povOccupationFlags[povIndex >> 5] ^= (3ULL << ((povIndex & 31) << 1));
+				if constexpr (reclaimRemovedSlots)
+				{
+					_reclaimRemovedPovSlots(povIndex);
+				}
 			}
 
 			if (--_population && deleteElementIdx != _population)
@@ -886,8 +998,8 @@ namespace QPI
 		return nextElementIdxOfRemoved;
 	}
 
-	template <typename T, uint64 L>
-	void Collection<T, L>::replace(sint64 oldElementIndex, const T& newElement)
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	void Collection<T, L, selfBalancing, reclaimRemovedSlots>::replace(sint64 oldElementIndex, const T& newElement)
 	{
 		if (uint64(oldElementIndex) < _population)
 		{
@@ -895,22 +1007,22 @@ namespace QPI
 		}
 	}
 
-	template <typename T, uint64 L>
-	void Collection<T, L>::reset()
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	void Collection<T, L, selfBalancing, reclaimRemovedSlots>::reset()
 	{
 		setMem(this, sizeof(*this), 0);
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::tailIndex(const id& pov) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::tailIndex(const id& pov) const
 	{
 		const sint64 povIndex = _povIndex(pov);
 
 		return povIndex < 0 ? NULL_INDEX : _povs[povIndex].tailIndex;
 	}
 
-	template <typename T, uint64 L>
-	sint64 Collection<T, L>::tailIndex(const id& pov, sint64 minPriority) const
+	template <typename T, uint64 L, bool selfBalancing, bool reclaimRemovedSlots>
+	sint64 Collection<T, L, selfBalancing, reclaimRemovedSlots>::tailIndex(const id& pov, sint64 minPriority) const
 	{
 		const sint64 povIndex = _povIndex(pov);
 		if (povIndex < 0)
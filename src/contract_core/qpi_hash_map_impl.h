@@ -27,11 +27,56 @@ namespace QPI
 		return key.u64._0;
 	}
 
+	// Multiply 64-bit numbers to 128-bit result and fold it to 64 bits
+	static inline uint64 __fastHashMix(uint64 a, uint64 b)
+	{
+		uint64 high;
+		const uint64 low = _umul128(a, b, &high);
+		return low ^ high;
+	}
+
+	template <typename KeyT>
+	uint64 FastHashFunction<KeyT>::hash(const KeyT& key)
+	{
+		constexpr uint64 secret0 = 0xa0761d6478bd642full;
+		constexpr uint64 secret1 = 0xe7037ed1a0b428dbull;
+		constexpr uint64 secret2 = 0x8ebc6af09c88c6e3ull;
+		constexpr uint64 size = sizeof(KeyT);
+
+		// mix key in 8-byte words, last word is zero-padded (fully unrolled for small keys)
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+		uint64 h = secret0 ^ size;
+		for (uint64 offset = 0; offset < size; offset += 8)
+		{
+			uint64 word = 0;
+			if (offset + 8 <= size)
+			{
+				word = *reinterpret_cast<const uint64*>(bytes + offset);
+			}
+			else
+			{
+				for (uint64 i = 0; offset + i < size; ++i)
+				{
+					word |= uint64(bytes[offset + i]) << (8 * i);
+				}
+			}
+			h = __fastHashMix(word ^ secret1, h ^ secret2);
+		}
+		return __fastHashMix(h ^ secret1, secret0 ^ size);
+	}
+
+	// IDs are random, so the first 8 bytes are used as hash as in HashFunction<m256i>.
+	template <>
+	inline uint64 FastHashFunction<m256i>::hash(const m256i& key)
+	{
+		return key.u64._0;
+	}
+
 	//////////////////////////////////////////////////////////////////////////////
 	// HashMap template class
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	uint64 HashMap<KeyT, ValueT, L, HashFunc>::_getEncodedOccupationFlags(const uint64* occupationFlags, const sint64 elementIndex) const
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	uint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::_getEncodedOccupationFlags(const uint64* occupationFlags, const sint64 elementIndex) const
 	{
 		const sint64 offset = (elementIndex & 31) << 1;
 		uint64 flags = occupationFlags[elementIndex >> 5] >> offset;
@@ -42,14 +87,14 @@ namespace QPI
 		return flags;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	bool HashMap<KeyT, ValueT, L, HashFunc>::contains(const KeyT& key) const
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	bool HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::contains(const KeyT& key) const
 	{
 		return getElementIndex(key) != NULL_INDEX;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	bool HashMap<KeyT, ValueT, L, HashFunc>::get(const KeyT& key, ValueT& value) const 
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	bool HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::get(const KeyT& key, ValueT& value) const 
 	{
 		sint64 elementIndex = getElementIndex(key);
 		if (elementIndex != NULL_INDEX) 
@@ -60,10 +105,15 @@ namespace QPI
 		return false;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	sint64 HashMap<KeyT, ValueT, L, HashFunc>::getElementIndex(const KeyT& key) const
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::getElementIndex(const KeyT& key) const
+	{
+		return _getElementIndex(key, HashFunc::hash(key) & (L - 1));
+	}
+
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::_getElementIndex(const KeyT& key, sint64 index) const
 	{
-		sint64 index = HashFunc::hash(key) & (L - 1);
 		for (sint64 counter = 0; counter < L; counter += 32)
 		{
 			uint64 flags = _getEncodedOccupationFlags(_occupationFlags, index);
@@ -86,32 +136,37 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	inline const KeyT& HashMap<KeyT, ValueT, L, HashFunc>::key(sint64 elementIndex) const
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	inline const KeyT& HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::key(sint64 elementIndex) const
 	{
 		return _elements[elementIndex & (L - 1)].key;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	inline const ValueT& HashMap<KeyT, ValueT, L, HashFunc>::value(sint64 elementIndex) const
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	inline const ValueT& HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::value(sint64 elementIndex) const
 	{
 		return _elements[elementIndex & (L - 1)].value;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	inline uint64 HashMap<KeyT, ValueT, L, HashFunc>::population() const
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	inline uint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::population() const
 	{
 		return _population;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	sint64 HashMap<KeyT, ValueT, L, HashFunc>::set(const KeyT& key, const ValueT& value)
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::set(const KeyT& key, const ValueT& value)
+	{
+		return _set(key, value, HashFunc::hash(key) & (L - 1));
+	}
+
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::_set(const KeyT& key, const ValueT& value, sint64 index)
 	{
 		if (_population < capacity())
 		{
 			// search in hash map
 			sint64 markedForRemovalIndexForReuse = NULL_INDEX;
-			sint64 index = HashFunc::hash(key) & (L - 1);
 			for (sint64 counter = 0; counter < L; counter += 32)
 			{
 				uint64 flags = _getEncodedOccupationFlags(_occupationFlags, index);
@@ -166,7 +221,7 @@ namespace QPI
 		else // _population == capacity()
 		{
 			// Check if key exists for value replacement.
-			sint64 index = getElementIndex(key);
+			index = _getElementIndex(key, index);
 			if (index != NULL_INDEX)
 			{
 				_elements[index].value = value;
@@ -176,16 +231,16 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	bool HashMap<KeyT, ValueT, L, HashFunc>::isEmptySlot(sint64 elementIndex) const
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	bool HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::isEmptySlot(sint64 elementIndex) const
 	{
 		elementIndex &= (L - 1);
 		uint64 flags = _getEncodedOccupationFlags(_occupationFlags, elementIndex);
 		return ((flags & 3ULL) != 1);
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	sint64 HashMap<KeyT, ValueT, L, HashFunc>::nextElementIndex(sint64 elementIndex) const
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::nextElementIndex(sint64 elementIndex) const
 	{
 		if (!_population)
 			return NULL_INDEX;
@@ -223,8 +278,29 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	void HashMap<KeyT, ValueT, L, HashFunc>::removeByIndex(sint64 elementIdx)
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::_reclaimRemovedSlots(sint64 elementIndex)
+	{
+		const sint64 nextIndex = (elementIndex + 1) & (L - 1);
+		if ((_occupationFlags[nextIndex >> 5] >> ((nextIndex & 31) << 1)) & 3ULL)
+		{
+			return;
+		}
+		for (sint64 i = 0; i < _maxReclaimedSlots && _markRemovalCounter; i++)
+		{
+			const uint64 shift = (elementIndex & 31) << 1;
+			if (((_occupationFlags[elementIndex >> 5] >> shift) & 3ULL) != 2)
+			{
+				break;
+			}
+			_occupationFlags[elementIndex >> 5] &= ~(3ULL << shift);
+			_markRemovalCounter--;
+			elementIndex = (elementIndex - 1) & (L - 1);
+		}
+	}
+
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::removeByIndex(sint64 elementIdx)
 	{
 		elementIdx &= (L - 1);
 		uint64 flags = _getEncodedOccupationFlags(_occupationFlags, elementIdx);
@@ -240,11 +316,16 @@ namespace QPI
 			{
 				setMem(&_elements[elementIdx], sizeof(Element), 0);
 			}
+
+			if constexpr (reclaimRemovedSlots)
+			{
+				_reclaimRemovedSlots(elementIdx);
+			}
 		}
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	sint64 HashMap<KeyT, ValueT, L, HashFunc>::removeByKey(const KeyT& key)
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::removeByKey(const KeyT& key)
 	{
 		sint64 elementIndex = getElementIndex(key);
 		if (elementIndex == NULL_INDEX)
@@ -258,8 +339,109 @@ namespace QPI
 		}
 	}
 	
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	void HashMap<KeyT, ValueT, L, HashFunc>::cleanupIfNeeded(uint64 removalThresholdPercent)
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	void HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::_prepareBatch(const Array<KeyT, N>& keys, uint64 begin, uint64 end, sint64* hashIndices) const
+	{
+		for (uint64 i = begin; i < end; ++i)
+		{
+			const sint64 index = HashFunc::hash(keys.get(i)) & (L - 1);
+			hashIndices[i - begin] = index;
+			_mm_prefetch(reinterpret_cast<const char*>(&_occupationFlags[index >> 5]), _MM_HINT_T0);
+			_mm_prefetch(reinterpret_cast<const char*>(&_elements[index]), _MM_HINT_T0);
+		}
+	}
+
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	uint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::getElementIndices(const Array<KeyT, N>& keys, Array<sint64, N>& elementIndices, uint64 count) const
+	{
+		count = math_lib::min(count, N);
+		uint64 found = 0;
+		sint64 hashIndices[_batchChunkSize];
+		for (uint64 begin = 0; begin < count; begin += _batchChunkSize)
+		{
+			const uint64 end = math_lib::min(begin + _batchChunkSize, count);
+			_prepareBatch(keys, begin, end, hashIndices);
+			for (uint64 i = begin; i < end; ++i)
+			{
+				const sint64 elementIndex = _getElementIndex(keys.get(i), hashIndices[i - begin]);
+				elementIndices.set(i, elementIndex);
+				found += (elementIndex != NULL_INDEX);
+			}
+		}
+		return found;
+	}
+
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	uint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::getMany(const Array<KeyT, N>& keys, Array<ValueT, N>& values, uint64 count) const
+	{
+		count = math_lib::min(count, N);
+		uint64 found = 0;
+		sint64 hashIndices[_batchChunkSize];
+		for (uint64 begin = 0; begin < count; begin += _batchChunkSize)
+		{
+			const uint64 end = math_lib::min(begin + _batchChunkSize, count);
+			_prepareBatch(keys, begin, end, hashIndices);
+			for (uint64 i = begin; i < end; ++i)
+			{
+				const sint64 elementIndex = _getElementIndex(keys.get(i), hashIndices[i - begin]);
+				if (elementIndex != NULL_INDEX)
+				{
+					values.set(i, _elements[elementIndex].value);
+					++found;
+				}
+			}
+		}
+		return found;
+	}
+
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	uint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::setMany(const Array<KeyT, N>& keys, const Array<ValueT, N>& values, uint64 count)
+	{
+		count = math_lib::min(count, N);
+		uint64 setCount = 0;
+		sint64 hashIndices[_batchChunkSize];
+		for (uint64 begin = 0; begin < count; begin += _batchChunkSize)
+		{
+			const uint64 end = math_lib::min(begin + _batchChunkSize, count);
+			_prepareBatch(keys, begin, end, hashIndices);
+			for (uint64 i = begin; i < end; ++i)
+			{
+				setCount += (_set(keys.get(i), values.get(i), hashIndices[i - begin]) != NULL_INDEX);
+			}
+		}
+		return setCount;
+	}
+
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	uint64 HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::removeMany(const Array<KeyT, N>& keys, uint64 count)
+	{
+		count = math_lib::min(count, N);
+		uint64 removed = 0;
+		sint64 hashIndices[_batchChunkSize];
+		for (uint64 begin = 0; begin < count; begin += _batchChunkSize)
+		{
+			const uint64 end = math_lib::min(begin + _batchChunkSize, count);
+			_prepareBatch(keys, begin, end, hashIndices);
+			for (uint64 i = begin; i < end; ++i)
+			{
+				const sint64 elementIndex = _getElementIndex(keys.get(i), hashIndices[i - begin]);
+				if (elementIndex != NULL_INDEX)
+				{
+					removeByIndex(elementIndex);
+					++removed;
+				}
+			}
+		}
+		return removed;
+	}
+
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::cleanupIfNeeded(uint64 removalThresholdPercent)
 	{
 		if (_markRemovalCounter > (removalThresholdPercent * L / 100))
 		{
@@ -267,8 +449,8 @@ namespace QPI
 		}
 	}
 	
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	void HashMap<KeyT, ValueT, L, HashFunc>::cleanup()
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::cleanup()
 	{
 		// _elements gets occupied over time with entries of type 3 which means they are marked for cleanup.
 		// Once cleanup is called it's necessary to remove all these type 3 entries by reconstructing a fresh hash map residing in scratchpad buffer.
@@ -358,8 +540,8 @@ namespace QPI
 #endif
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	bool HashMap<KeyT, ValueT, L, HashFunc>::replace(const KeyT& key, const ValueT& newValue)
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	bool HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::replace(const KeyT& key, const ValueT& newValue)
 	{
 		sint64 elementIndex = getElementIndex(key);
 		if (elementIndex != NULL_INDEX) 
@@ -370,8 +552,8 @@ namespace QPI
 		return false;
 	}
 
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc>
-	void HashMap<KeyT, ValueT, L, HashFunc>::reset()
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashMap<KeyT, ValueT, L, HashFunc, reclaimRemovedSlots>::reset()
 	{
 		setMem(this, sizeof(*this), 0);
 	}
@@ -379,8 +561,8 @@ namespace QPI
 	//////////////////////////////////////////////////////////////////////////////
 	// HashSet template class
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	uint64 HashSet<KeyT, L, HashFunc>::_getEncodedOccupationFlags(const uint64* occupationFlags, const sint64 elementIndex) const
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	uint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::_getEncodedOccupationFlags(const uint64* occupationFlags, const sint64 elementIndex) const
 	{
 		const sint64 offset = (elementIndex & 31) << 1;
 		uint64 flags = occupationFlags[elementIndex >> 5] >> offset;
@@ -391,16 +573,21 @@ namespace QPI
 		return flags;
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	bool HashSet<KeyT, L, HashFunc>::contains(const KeyT& key) const
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	bool HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::contains(const KeyT& key) const
 	{
 		return getElementIndex(key) != NULL_INDEX;
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	sint64 HashSet<KeyT, L, HashFunc>::getElementIndex(const KeyT& key) const
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::getElementIndex(const KeyT& key) const
+	{
+		return _getElementIndex(key, HashFunc::hash(key) & (L - 1));
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::_getElementIndex(const KeyT& key, sint64 index) const
 	{
-		sint64 index = HashFunc::hash(key) & (L - 1);
 		for (sint64 counter = 0; counter < L; counter += 32)
 		{
 			uint64 flags = _getEncodedOccupationFlags(_occupationFlags, index);
@@ -423,26 +610,31 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	inline KeyT HashSet<KeyT, L, HashFunc>::key(sint64 elementIndex) const
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	inline KeyT HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::key(sint64 elementIndex) const
 	{
 		return _keys[elementIndex & (L - 1)];
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	inline uint64 HashSet<KeyT, L, HashFunc>::population() const
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	inline uint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::population() const
 	{
 		return _population;
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	sint64 HashSet<KeyT, L, HashFunc>::add(const KeyT& key)
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::add(const KeyT& key)
+	{
+		return _add(key, HashFunc::hash(key) & (L - 1));
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::_add(const KeyT& key, sint64 index)
 	{
 		if (_population < capacity())
 		{
 			// search in hash map
 			sint64 markedForRemovalIndexForReuse = NULL_INDEX;
-			sint64 index = HashFunc::hash(key) & (L - 1);
 			for (sint64 counter = 0; counter < L; counter += 32)
 			{
 				uint64 flags = _getEncodedOccupationFlags(_occupationFlags, index);
@@ -495,7 +687,7 @@ namespace QPI
 		else // _population == capacity()
 		{
 			// Check if key exists.
-			sint64 index = getElementIndex(key);
+			index = _getElementIndex(key, index);
 			if (index != NULL_INDEX)
 			{
 				return index;
@@ -504,16 +696,16 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	bool HashSet<KeyT, L, HashFunc>::isEmptySlot(sint64 elementIndex) const
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	bool HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::isEmptySlot(sint64 elementIndex) const
 	{
 		elementIndex &= (L - 1);
 		uint64 flags = _getEncodedOccupationFlags(_occupationFlags, elementIndex);
 		return ((flags & 3ULL) != 1);
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	sint64 HashSet<KeyT, L, HashFunc>::nextElementIndex(sint64 elementIndex) const
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::nextElementIndex(sint64 elementIndex) const
 	{
 		if (!_population)
 			return NULL_INDEX;
@@ -551,8 +743,29 @@ namespace QPI
 		return NULL_INDEX;
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	void HashSet<KeyT, L, HashFunc>::removeByIndex(sint64 elementIdx)
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::_reclaimRemovedSlots(sint64 elementIndex)
+	{
+		const sint64 nextIndex = (elementIndex + 1) & (L - 1);
+		if ((_occupationFlags[nextIndex >> 5] >> ((nextIndex & 31) << 1)) & 3ULL)
+		{
+			return;
+		}
+		for (sint64 i = 0; i < _maxReclaimedSlots && _markRemovalCounter; i++)
+		{
+			const uint64 shift = (elementIndex & 31) << 1;
+			if (((_occupationFlags[elementIndex >> 5] >> shift) & 3ULL) != 2)
+			{
+				break;
+			}
+			_occupationFlags[elementIndex >> 5] &= ~(3ULL << shift);
+			_markRemovalCounter--;
+			elementIndex = (elementIndex - 1) & (L - 1);
+		}
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::removeByIndex(sint64 elementIdx)
 	{
 		elementIdx &= (L - 1);
 		uint64 flags = _getEncodedOccupationFlags(_occupationFlags, elementIdx);
@@ -568,11 +781,16 @@ namespace QPI
 			{
 				setMem(&_keys[elementIdx], sizeof(KeyT), 0);
 			}
+
+			if constexpr (reclaimRemovedSlots)
+			{
+				_reclaimRemovedSlots(elementIdx);
+			}
 		}
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	sint64 HashSet<KeyT, L, HashFunc>::remove(const KeyT& key)
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	sint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::remove(const KeyT& key)
 	{
 		sint64 elementIndex = getElementIndex(key);
 		if (elementIndex == NULL_INDEX)
@@ -586,8 +804,85 @@ namespace QPI
 		}
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	void HashSet<KeyT, L, HashFunc>::cleanupIfNeeded(uint64 removalThresholdPercent)
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	void HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::_prepareBatch(const Array<KeyT, N>& keys, uint64 begin, uint64 end, sint64* hashIndices) const
+	{
+		for (uint64 i = begin; i < end; ++i)
+		{
+			const sint64 index = HashFunc::hash(keys.get(i)) & (L - 1);
+			hashIndices[i - begin] = index;
+			_mm_prefetch(reinterpret_cast<const char*>(&_occupationFlags[index >> 5]), _MM_HINT_T0);
+			_mm_prefetch(reinterpret_cast<const char*>(&_keys[index]), _MM_HINT_T0);
+		}
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	uint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::getElementIndices(const Array<KeyT, N>& keys, Array<sint64, N>& elementIndices, uint64 count) const
+	{
+		count = math_lib::min(count, N);
+		uint64 found = 0;
+		sint64 hashIndices[_batchChunkSize];
+		for (uint64 begin = 0; begin < count; begin += _batchChunkSize)
+		{
+			const uint64 end = math_lib::min(begin + _batchChunkSize, count);
+			_prepareBatch(keys, begin, end, hashIndices);
+			for (uint64 i = begin; i < end; ++i)
+			{
+				const sint64 elementIndex = _getElementIndex(keys.get(i), hashIndices[i - begin]);
+				elementIndices.set(i, elementIndex);
+				found += (elementIndex != NULL_INDEX);
+			}
+		}
+		return found;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	uint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::addMany(const Array<KeyT, N>& keys, uint64 count)
+	{
+		count = math_lib::min(count, N);
+		uint64 added = 0;
+		sint64 hashIndices[_batchChunkSize];
+		for (uint64 begin = 0; begin < count; begin += _batchChunkSize)
+		{
+			const uint64 end = math_lib::min(begin + _batchChunkSize, count);
+			_prepareBatch(keys, begin, end, hashIndices);
+			for (uint64 i = begin; i < end; ++i)
+			{
+				added += (_add(keys.get(i), hashIndices[i - begin]) != NULL_INDEX);
+			}
+		}
+		return added;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	template <uint64 N>
+	uint64 HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::removeMany(const Array<KeyT, N>& keys, uint64 count)
+	{
+		count = math_lib::min(count, N);
+		uint64 removed = 0;
+		sint64 hashIndices[_batchChunkSize];
+		for (uint64 begin = 0; begin < count; begin += _batchChunkSize)
+		{
+			const uint64 end = math_lib::min(begin + _batchChunkSize, count);
+			_prepareBatch(keys, begin, end, hashIndices);
+			for (uint64 i = begin; i < end; ++i)
+			{
+				const sint64 elementIndex = _getElementIndex(keys.get(i), hashIndices[i - begin]);
+				if (elementIndex != NULL_INDEX)
+				{
+					removeByIndex(elementIndex);
+					++removed;
+				}
+			}
+		}
+		return removed;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::cleanupIfNeeded(uint64 removalThresholdPercent)
 	{
 		if (_markRemovalCounter > (removalThresholdPercent * L / 100))
 		{
@@ -595,8 +890,8 @@ namespace QPI
 		}
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	void HashSet<KeyT, L, HashFunc>::cleanup()
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::cleanup()
 	{
 		// _keys gets occupied over time with entries of type 3 which means they are marked for cleanup.
 		// Once cleanup is called it's necessary to remove all these type 3 entries by reconstructing a fresh hash map residing in scratchpad buffer.
@@ -686,8 +981,8 @@ namespace QPI
 #endif
 	}
 
-	template <typename KeyT, uint64 L, typename HashFunc>
-	void HashSet<KeyT, L, HashFunc>::reset()
+	template <typename KeyT, uint64 L, typename HashFunc, bool reclaimRemovedSlots>
+	void HashSet<KeyT, L, HashFunc, reclaimRemovedSlots>::reset()
 	{
 		setMem(this, sizeof(*this), 0);
 	}
@@ -4,7 +4,7 @@
 
 QPI::sint64 QPI::QpiContextProcedureCall::bidInIPO(unsigned int IPOContractIndex, long long price, unsigned int quantity) const
 {
-    if (contractCallbacksRunning != NoContractCallback)
+    if (contractCallbacksRunning != NoContractCallback || isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
         return -1;
 
     if (_currentContractIndex >= contractCount || IPOContractIndex >= contractCount || _currentContractIndex >= IPOContractIndex)
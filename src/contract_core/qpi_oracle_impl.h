@@ -32,6 +32,10 @@ QPI::sint64 QPI::QpiContextProcedureCall::__qpiQueryOracle(
 	if (!notificationProcPtr || ContractStateType::__contract_index != contractIndex)
 		return -1;
 
+	// oracle engine and spectrum may not be accessed by tick procedures declared to only access own state
+	if (isOwnStateOnlyTickHook(contractIndex, this->_entryPoint))
+		return -1;
+
 	// check vs registry of user procedures for notification
 	const UserProcedureRegistry::UserProcedureData* procData;
 	if (!userProcedureRegistry || !(procData = userProcedureRegistry->get(notificationProcId)) || procData->procedure != (USER_PROCEDURE)notificationProcPtr)
@@ -0,0 +1,279 @@
+// Implements functions of QPI::OrderBook in order to:
+// 1. keep setMem() and copyMem() unavailable to contracts
+// 2. keep QPI file smaller and easier to read for contract devs
+// CAUTION: Include this AFTER the contract implementations!
+
+#pragma once
+
+#include "../contracts/qpi.h"
+#include "../platform/memory.h"
+
+namespace QPI
+{
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::_levelIndex(const id& pov, sint64 priority) const
+	{
+		const sint64 levelIdx = _levels.headIndex(pov, priority);
+		if (levelIdx == NULL_INDEX || _levels.priority(levelIdx) != priority)
+		{
+			return NULL_INDEX;
+		}
+		return levelIdx;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	void OrderBook<T, L, levelCapacity>::_unlinkOrder(sint64 orderIndex)
+	{
+		Order& order = _orders[orderIndex];
+		const sint64 levelIdx = _levelIndex(order.pov, order.priority);
+		ASSERT(levelIdx != NULL_INDEX);
+
+		Level level = _levels.element(levelIdx);
+		if (order.prevOrderIndex != NULL_INDEX)
+		{
+			_orders[order.prevOrderIndex].nextOrderIndex = order.nextOrderIndex;
+		}
+		else
+		{
+			level.firstOrderIndex = order.nextOrderIndex;
+		}
+		if (order.nextOrderIndex != NULL_INDEX)
+		{
+			_orders[order.nextOrderIndex].prevOrderIndex = order.prevOrderIndex;
+		}
+		else
+		{
+			level.lastOrderIndex = order.prevOrderIndex;
+		}
+		level.quantity -= order.quantity;
+		level.orderCount--;
+
+		if (level.orderCount)
+		{
+			_levels.replace(levelIdx, level);
+		}
+		else
+		{
+			_levels.remove(levelIdx);
+			_levels.cleanupIfNeeded();
+		}
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::add(const id& pov, const T& value, sint64 priority, sint64 quantity)
+	{
+		if (quantity <= 0 || _population >= L)
+		{
+			return NULL_INDEX;
+		}
+
+		sint64 levelIdx = _levelIndex(pov, priority);
+		if (levelIdx == NULL_INDEX)
+		{
+			if (_levels.population() >= levelCapacity)
+			{
+				return NULL_INDEX;
+			}
+			Level level;
+			level.quantity = 0;
+			level.orderCount = 0;
+			level.firstOrderIndex = NULL_INDEX;
+			level.lastOrderIndex = NULL_INDEX;
+			levelIdx = _levels.add(pov, level, priority);
+			ASSERT(levelIdx != NULL_INDEX);
+		}
+
+		// take slot from free list or never used slot
+		sint64 orderIndex;
+		if (_freeListHead)
+		{
+			orderIndex = _freeListHead - 1;
+			_freeListHead = _orders[orderIndex].nextOrderIndex + 1;
+		}
+		else
+		{
+			orderIndex = _usedOrderSlots++;
+		}
+		ASSERT(orderIndex >= 0 && orderIndex < sint64(L));
+		_orderOccupationFlags[orderIndex >> 6] |= (1ULL << (orderIndex & 63));
+		_population++;
+
+		// append to queue of level
+		Level level = _levels.element(levelIdx);
+		Order& order = _orders[orderIndex];
+		order.value = value;
+		order.pov = pov;
+		order.priority = priority;
+		order.quantity = quantity;
+		order.prevOrderIndex = level.lastOrderIndex;
+		order.nextOrderIndex = NULL_INDEX;
+		if (level.lastOrderIndex != NULL_INDEX)
+		{
+			_orders[level.lastOrderIndex].nextOrderIndex = orderIndex;
+		}
+		else
+		{
+			level.firstOrderIndex = orderIndex;
+		}
+		level.lastOrderIndex = orderIndex;
+		level.quantity += quantity;
+		level.orderCount++;
+		_levels.replace(levelIdx, level);
+
+		return orderIndex;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	bool OrderBook<T, L, levelCapacity>::isOrder(sint64 orderIndex) const
+	{
+		return uint64(orderIndex) < L && (_orderOccupationFlags[orderIndex >> 6] >> (orderIndex & 63)) & 1;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	T OrderBook<T, L, levelCapacity>::order(sint64 orderIndex) const
+	{
+		return _orders[orderIndex & (L - 1)].value;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	id OrderBook<T, L, levelCapacity>::pov(sint64 orderIndex) const
+	{
+		return isOrder(orderIndex) ? _orders[orderIndex].pov : id::zero();
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::priority(sint64 orderIndex) const
+	{
+		return isOrder(orderIndex) ? _orders[orderIndex].priority : 0;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::quantity(sint64 orderIndex) const
+	{
+		return isOrder(orderIndex) ? _orders[orderIndex].quantity : 0;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::nextOrderIndex(sint64 orderIndex) const
+	{
+		return isOrder(orderIndex) ? _orders[orderIndex].nextOrderIndex : NULL_INDEX;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	uint64 OrderBook<T, L, levelCapacity>::population() const
+	{
+		return _population;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	uint64 OrderBook<T, L, levelCapacity>::populationOfLevels() const
+	{
+		return _levels.population();
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	uint64 OrderBook<T, L, levelCapacity>::populationOfLevels(const id& pov) const
+	{
+		return _levels.population(pov);
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	bool OrderBook<T, L, levelCapacity>::setQuantity(sint64 orderIndex, sint64 newQuantity)
+	{
+		if (!isOrder(orderIndex))
+		{
+			return false;
+		}
+		if (newQuantity <= 0)
+		{
+			remove(orderIndex);
+			return true;
+		}
+
+		Order& order = _orders[orderIndex];
+		const sint64 levelIdx = _levelIndex(order.pov, order.priority);
+		ASSERT(levelIdx != NULL_INDEX);
+		Level level = _levels.element(levelIdx);
+		level.quantity += newQuantity - order.quantity;
+		_levels.replace(levelIdx, level);
+		order.quantity = newQuantity;
+		return true;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	void OrderBook<T, L, levelCapacity>::replace(sint64 orderIndex, const T& newValue)
+	{
+		if (isOrder(orderIndex))
+		{
+			_orders[orderIndex].value = newValue;
+		}
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::remove(sint64 orderIndex)
+	{
+		if (!isOrder(orderIndex))
+		{
+			return NULL_INDEX;
+		}
+
+		const sint64 nextIdx = _orders[orderIndex].nextOrderIndex;
+		_unlinkOrder(orderIndex);
+
+		// add slot to free list
+		_orderOccupationFlags[orderIndex >> 6] &= ~(1ULL << (orderIndex & 63));
+		_orders[orderIndex].nextOrderIndex = sint64(_freeListHead) - 1;
+		_freeListHead = orderIndex + 1;
+		_population--;
+
+		return nextIdx;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::bestLevelIndex(const id& pov) const
+	{
+		return _levels.headIndex(pov);
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::levelIndex(const id& pov, sint64 priority) const
+	{
+		return _levelIndex(pov, priority);
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::nextLevelIndex(sint64 levelIndex) const
+	{
+		return _levels.nextElementIndex(levelIndex);
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::levelPriority(sint64 levelIndex) const
+	{
+		return _levels.priority(levelIndex);
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::levelQuantity(sint64 levelIndex) const
+	{
+		return _levels.element(levelIndex).quantity;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	uint64 OrderBook<T, L, levelCapacity>::levelOrderCount(sint64 levelIndex) const
+	{
+		return _levels.element(levelIndex).orderCount;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	sint64 OrderBook<T, L, levelCapacity>::firstOrderIndex(sint64 levelIndex) const
+	{
+		return _levels.element(levelIndex).firstOrderIndex;
+	}
+
+	template <typename T, uint64 L, uint64 levelCapacity>
+	void OrderBook<T, L, levelCapacity>::reset()
+	{
+		setMem(this, sizeof(*this), 0);
+	}
+}
@@ -474,6 +474,19 @@ namespace QPI
 			}
 			return vv;
 		}
+
+		// Add number of option votes with value v to counts[v] (for v < 8). Scans the vote storage directly instead of
+		// calling getVoteValue() for each vote.
+		void countOptionVotes(uint32 counts[8]) const
+		{
+			for (uint32 i = 0; i < numOfVotes; ++i)
+			{
+				// no-vote values (0xff in uint8 storage, NO_VOTE_VALUE in sint64 storage) are out of range as uint64
+				const uint64 value = static_cast<uint64>(votes[i]);
+				if (value < 8)
+					++counts[value];
+			}
+		}
 	};
 
 	// Used internally by ProposalVoting to store a proposal with all votes
@@ -542,6 +555,36 @@ namespace QPI
 			}
 			return vv;
 		}
+
+		// Add number of option votes with value v to counts[v] (for v < 3). Counts 32 votes at once with popcount on
+		// the 2-bit fields.
+		void countOptionVotes(uint32 counts[8]) const
+		{
+			constexpr uint64 lowBits = 0x5555555555555555ULL;
+			constexpr uint32 fullWords = sizeof(votes) / 8;
+			for (uint32 w = 0; w <= fullWords; ++w)
+			{
+				uint64 word;
+				if (w < fullWords)
+				{
+					word = *reinterpret_cast<const uint64*>(votes + w * 8);
+				}
+				else
+				{
+					// remaining bytes, padded with no-vote values
+					if (sizeof(votes) % 8 == 0)
+						break;
+					word = 0xffffffffffffffffULL;
+					for (uint32 b = 0; b < sizeof(votes) % 8; ++b)
+						word = (word & ~(0xffULL << (b * 8))) | (uint64(votes[w * 8 + b]) << (b * 8));
+				}
+				const uint64 low = word & lowBits;
+				const uint64 high = (word >> 1) & lowBits;
+				counts[0] += static_cast<uint32>(_mm_popcnt_u64(~(low | high) & lowBits));
+				counts[1] += static_cast<uint32>(_mm_popcnt_u64(low & ~high));
+				counts[2] += static_cast<uint32>(_mm_popcnt_u64(high & ~low));
+			}
+		}
 	};
 
 	template <typename ProposerAndVoterHandlingType, typename ProposalDataType>
@@ -987,14 +1030,12 @@ namespace QPI
 			ASSERT(votingSummary.optionCount <= votingSummary.optionVoteCount.capacity());
 			auto& hist = votingSummary.optionVoteCount;
 			hist.setAll(0);
-			for (uint32 i = 0; i < pv.maxVotes; ++i)
+			uint32 counts[8] = { 0 };
+			p.countOptionVotes(counts);
+			for (uint32 i = 0; i < votingSummary.optionCount; ++i)
 			{
-				sint64 value = p.getVoteValue(i);
-				if (value != NO_VOTE_VALUE && value >= 0 && value < votingSummary.optionCount)
-				{
-					++votingSummary.totalVotesCasted;
-					hist.set(value, hist.get(value) + 1);
-				}
+				votingSummary.totalVotesCasted += counts[i];
+				hist.set(i, counts[i]);
 			}
 		}
 
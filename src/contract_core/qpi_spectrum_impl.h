@@ -95,6 +95,8 @@ long long QPI::QpiContextFunctionCall::queryFeeReserve(unsigned int contractInde
 
 long long QPI::QpiContextProcedureCall::burn(long long amount, unsigned int contractIndexBurnedFor) const
 {
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+        return -((long long)(MAX_AMOUNT + 1));
     if (amount < 0 || amount > MAX_AMOUNT)
     {
         return -((long long)(MAX_AMOUNT + 1));
@@ -135,6 +137,8 @@ long long QPI::QpiContextProcedureCall::burn(long long amount, unsigned int cont
 
 long long QPI::QpiContextProcedureCall::__transfer(const m256i& destination, long long amount, unsigned char transferType) const
 {
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+        return INVALID_AMOUNT;
     // Transfer to contract is forbidden inside POST_INCOMING_TRANSFER to prevent nested callbacks
     if (contractCallbacksRunning & ContractCallbackPostIncomingTransfer
         && destination.u64._0 < contractCount && !destination.u64._1 && !destination.u64._2 && !destination.u64._3)
@@ -182,6 +186,76 @@ long long QPI::QpiContextProcedureCall::transfer(const m256i& destination, long
     return __transfer(destination, amount, TransferType::qpiTransfer);
 }
 
+long long QPI::QpiContextProcedureCall::__transferMany(const m256i* destinations, const long long* amounts, unsigned long long count) const
+{
+    if (isOwnStateOnlyTickHook(_currentContractIndex, _entryPoint))
+        return INVALID_AMOUNT;
+    long long totalAmount = 0;
+    for (unsigned long long i = 0; i < count; ++i)
+    {
+        // Transfer to contract is forbidden inside POST_INCOMING_TRANSFER to prevent nested callbacks
+        const m256i& destination = destinations[i];
+        if (contractCallbacksRunning & ContractCallbackPostIncomingTransfer
+            && destination.u64._0 < contractCount && !destination.u64._1 && !destination.u64._2 && !destination.u64._3)
+        {
+            return INVALID_AMOUNT;
+        }
+
+        if (amounts[i] < 0 || amounts[i] > MAX_AMOUNT)
+        {
+            return -((long long)(MAX_AMOUNT + 1));
+        }
+        totalAmount += amounts[i];
+        if (totalAmount > MAX_AMOUNT)
+        {
+            return -((long long)(MAX_AMOUNT + 1));
+        }
+    }
+
+    const int index = spectrumIndex(_currentContractId);
+
+    if (index < 0)
+    {
+        return -totalAmount;
+    }
+
+    const long long remainingAmount = energy(index) - totalAmount;
+
+    if (remainingAmount < 0 || !count)
+    {
+        return remainingAmount;
+    }
+
+    if (!contractActionTracker.hasCapacity(count))
+        __qpiAbort(ContractErrorTooManyActions);
+
+    if (decreaseEnergy(index, totalAmount, (unsigned int)count))
+    {
+        increaseEnergyOfMany(destinations, amounts, count);
+
+        // Transfers are logged in QuTransferBatch messages, split before transfers to contracts, whose
+        // POST_INCOMING_TRANSFER callback may log messages. All destinations have been credited above, so the
+        // callbacks see the balances after the whole batch (documented in QpiContextProcedureCall::transferMany()).
+        QuTransferBatchLogger batchLogger(_currentContractId);
+        for (unsigned long long i = 0; i < count; ++i)
+        {
+            const m256i& destination = destinations[i];
+            contractActionTracker.addQuTransfer(_currentContractId, destination, amounts[i]);
+
+            // same condition as in __qpiNotifyPostIncomingTransfer()
+            if (destination.u64._0 < contractCount && !destination.u64._2 && !destination.u64._3)
+            {
+                batchLogger.finished();
+                __qpiNotifyPostIncomingTransfer(_currentContractId, destination, amounts[i], TransferType::qpiTransfer);
+            }
+
+            batchLogger.addTransfer(destination, amounts[i]);
+        }
+    }
+
+    return remainingAmount;
+}
+
 m256i QPI::QpiContextFunctionCall::nextId(const m256i& currentId) const
 {
     int index = spectrumIndex(currentId);
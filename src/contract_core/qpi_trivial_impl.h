@@ -110,6 +110,45 @@ m256i QPI::QpiContextFunctionCall::K12(const T& data) const
 	return digest;
 }
 
+template <typename T, QPI::uint64 N>
+void QPI::QpiContextFunctionCall::K12Batch(const Array<T, N>& data, Array<id, N>& digests, uint64 count) const
+{
+	if (count > N)
+		count = N;
+
+	uint64 i = 0;
+	if constexpr (sizeof(T) <= K12_SHORT_MAX_INPUT_SIZE)
+	{
+		const void* inputs[K12_64TO32_LANES];
+		unsigned int inputByteLens[K12_64TO32_LANES];
+		void* outputs[K12_64TO32_LANES];
+		m256i laneDigests[K12_64TO32_LANES];
+		for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+		{
+			inputByteLens[k] = sizeof(T);
+			outputs[k] = &laneDigests[k];
+		}
+		for (; i + K12_64TO32_LANES <= count; i += K12_64TO32_LANES)
+		{
+			for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+				inputs[k] = &data.get(i + k);
+			KangarooTwelveShortLanes(inputs, inputByteLens, outputs, sizeof(m256i));
+			for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+				digests.set(i + k, laneDigests[k]);
+		}
+	}
+	for (; i < count; i++)
+	{
+		digests.set(i, K12(data.get(i)));
+	}
+}
+
+template <typename T>
+QPI::uint64 QPI::QpiContextFunctionCall::hash64(const T& data) const
+{
+	return FastHashFunction<T>::hash(data);
+}
+
 //////////
 // safety multiplying a and b and then clamp
 
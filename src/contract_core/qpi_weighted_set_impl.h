@@ -0,0 +1,206 @@
+// Implements functions of QPI::WeightedSet in order to:
+// 1. keep setMem() and copyMem() unavailable to contracts
+// 2. keep QPI file smaller and easier to read for contract devs
+// CAUTION: Include this AFTER the contract implementations!
+
+#pragma once
+
+#include "../contracts/qpi.h"
+#include "../platform/memory.h"
+
+namespace QPI
+{
+	template <typename KeyT, uint64 L, typename HashFunc>
+	void WeightedSet<KeyT, L, HashFunc>::_addToTree(sint64 elementIndex, uint64 delta)
+	{
+		for (uint64 node = elementIndex + 1; node <= L; node += node & (~node + 1))
+		{
+			_tree[node - 1] += delta;
+		}
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	void WeightedSet<KeyT, L, HashFunc>::_rebuildTree()
+	{
+		for (uint64 i = 0; i < L; i++)
+		{
+			_tree[i] = (_weights.isEmptySlot(i)) ? 0 : _weights.value(i);
+		}
+		for (uint64 node = 1; node <= L; node++)
+		{
+			const uint64 parent = node + (node & (~node + 1));
+			if (parent <= L)
+			{
+				_tree[parent - 1] += _tree[node - 1];
+			}
+		}
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	sint64 WeightedSet<KeyT, L, HashFunc>::add(const KeyT& key, uint64 weight)
+	{
+		if (!weight || _totalWeight + weight < _totalWeight)
+		{
+			return NULL_INDEX;
+		}
+
+		uint64 oldWeight = 0;
+		_weights.get(key, oldWeight);
+		const sint64 elementIndex = _weights.set(key, oldWeight + weight);
+		if (elementIndex == NULL_INDEX)
+		{
+			return NULL_INDEX;
+		}
+
+		_addToTree(elementIndex, weight);
+		_totalWeight += weight;
+		return elementIndex;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	uint64 WeightedSet<KeyT, L, HashFunc>::population() const
+	{
+		return _weights.population();
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	uint64 WeightedSet<KeyT, L, HashFunc>::totalWeight() const
+	{
+		return _totalWeight;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	bool WeightedSet<KeyT, L, HashFunc>::contains(const KeyT& key) const
+	{
+		return _weights.contains(key);
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	uint64 WeightedSet<KeyT, L, HashFunc>::weight(const KeyT& key) const
+	{
+		uint64 value = 0;
+		_weights.get(key, value);
+		return value;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	sint64 WeightedSet<KeyT, L, HashFunc>::getElementIndex(const KeyT& key) const
+	{
+		return _weights.getElementIndex(key);
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	bool WeightedSet<KeyT, L, HashFunc>::isEmptySlot(sint64 elementIndex) const
+	{
+		return _weights.isEmptySlot(elementIndex);
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	sint64 WeightedSet<KeyT, L, HashFunc>::nextElementIndex(sint64 elementIndex) const
+	{
+		return _weights.nextElementIndex(elementIndex);
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	const KeyT& WeightedSet<KeyT, L, HashFunc>::key(sint64 elementIndex) const
+	{
+		return _weights.key(elementIndex);
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	uint64 WeightedSet<KeyT, L, HashFunc>::weightAt(sint64 elementIndex) const
+	{
+		return _weights.value(elementIndex);
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	sint64 WeightedSet<KeyT, L, HashFunc>::sample(uint64 random) const
+	{
+		if (!_totalWeight)
+		{
+			return NULL_INDEX;
+		}
+
+		// descend the tree to find the element whose cumulative weight range contains the target
+		uint64 target = random % _totalWeight;
+		uint64 node = 0;
+		for (uint64 step = L; step; step >>= 1)
+		{
+			if (node + step <= L && _tree[node + step - 1] <= target)
+			{
+				node += step;
+				target -= _tree[node - 1];
+			}
+		}
+		ASSERT(node < L && !_weights.isEmptySlot(node));
+		return node;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	uint64 WeightedSet<KeyT, L, HashFunc>::removeWeight(const KeyT& key, uint64 weight)
+	{
+		const sint64 elementIndex = _weights.getElementIndex(key);
+		if (elementIndex == NULL_INDEX)
+		{
+			return 0;
+		}
+
+		const uint64 oldWeight = _weights.value(elementIndex);
+		if (weight >= oldWeight)
+		{
+			removeByKey(key);
+			return 0;
+		}
+
+		_weights.set(key, oldWeight - weight);
+		_addToTree(elementIndex, ~weight + 1);
+		_totalWeight -= weight;
+		return oldWeight - weight;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	sint64 WeightedSet<KeyT, L, HashFunc>::removeByKey(const KeyT& key)
+	{
+		const sint64 elementIndex = _weights.getElementIndex(key);
+		if (elementIndex == NULL_INDEX)
+		{
+			return NULL_INDEX;
+		}
+
+		const uint64 oldWeight = _weights.value(elementIndex);
+		_addToTree(elementIndex, ~oldWeight + 1);
+		_totalWeight -= oldWeight;
+		_weights.removeByIndex(elementIndex);
+		_removalCounter++;
+		return elementIndex;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	void WeightedSet<KeyT, L, HashFunc>::cleanupIfNeeded(uint64 removalThresholdPercent)
+	{
+		if (_removalCounter > (removalThresholdPercent * L / 100))
+		{
+			cleanup();
+		}
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	void WeightedSet<KeyT, L, HashFunc>::cleanup()
+	{
+		if (!_removalCounter)
+		{
+			return;
+		}
+
+		// cleanup of hash map moves elements, so the tree needs to be rebuilt
+		_weights.cleanup();
+		_rebuildTree();
+		_removalCounter = 0;
+	}
+
+	template <typename KeyT, uint64 L, typename HashFunc>
+	void WeightedSet<KeyT, L, HashFunc>::reset()
+	{
+		setMem(this, sizeof(*this), 0);
+	}
+}
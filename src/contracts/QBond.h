@@ -562,48 +562,24 @@ protected:
             }
         }
 
-        if (state._askOrders.population(locals.mbondIdentity) == 0)
+        // jump to the price level and merge with an existing order of the invocator at this price
+        locals.elementIndex = state._askOrders.elementIndex(locals.mbondIdentity, -input.price);
+        while (locals.elementIndex != NULL_INDEX && state._askOrders.priority(locals.elementIndex) == -input.price)
         {
-            locals.tempAskOrder.epoch = input.epoch;
-            locals.tempAskOrder.numberOfMBonds = input.numberOfMBonds;
-            locals.tempAskOrder.owner = qpi.invocator();
-            state._askOrders.add(locals.mbondIdentity, locals.tempAskOrder, -input.price);
-            return;
-        }
-
-        locals.elementIndex = state._askOrders.headIndex(locals.mbondIdentity, 0);
-        while (locals.elementIndex != NULL_INDEX)
-        {
-            if (input.price < -state._askOrders.priority(locals.elementIndex))
-            {
-                locals.tempAskOrder.epoch = input.epoch;
-                locals.tempAskOrder.numberOfMBonds = input.numberOfMBonds;
-                locals.tempAskOrder.owner = qpi.invocator();
-                state._askOrders.add(locals.mbondIdentity, locals.tempAskOrder, -input.price);
-                break;
-            }
-            else if (input.price == -state._askOrders.priority(locals.elementIndex))
-            {
-                if (state._askOrders.element(locals.elementIndex).owner == qpi.invocator())
-                {
-                    locals.tempAskOrder = state._askOrders.element(locals.elementIndex);
-                    locals.tempAskOrder.numberOfMBonds += input.numberOfMBonds;
-                    state._askOrders.replace(locals.elementIndex, locals.tempAskOrder);
-                    break;
-                }
-            }
-
-            if (state._askOrders.nextElementIndex(locals.elementIndex) == NULL_INDEX)
+            if (state._askOrders.element(locals.elementIndex).owner == qpi.invocator())
             {
-                locals.tempAskOrder.epoch = input.epoch;
-                locals.tempAskOrder.numberOfMBonds = input.numberOfMBonds;
-                locals.tempAskOrder.owner = qpi.invocator();
-                state._askOrders.add(locals.mbondIdentity, locals.tempAskOrder, -input.price);
-                break;
+                locals.tempAskOrder = state._askOrders.element(locals.elementIndex);
+                locals.tempAskOrder.numberOfMBonds += input.numberOfMBonds;
+                state._askOrders.replace(locals.elementIndex, locals.tempAskOrder);
+                return;
             }
-
             locals.elementIndex = state._askOrders.nextElementIndex(locals.elementIndex);
         }
+
+        locals.tempAskOrder.epoch = input.epoch;
+        locals.tempAskOrder.numberOfMBonds = input.numberOfMBonds;
+        locals.tempAskOrder.owner = qpi.invocator();
+        state._askOrders.add(locals.mbondIdentity, locals.tempAskOrder, -input.price);
     }
 
     struct RemoveAskOrder_locals
@@ -635,10 +611,10 @@ protected:
             locals.mbondIdentity.u16._3 = (uint16) input.epoch;
         }
 
-        locals.elementIndex = state._askOrders.headIndex(locals.mbondIdentity, 0);
-        while (locals.elementIndex != NULL_INDEX)
+        locals.elementIndex = state._askOrders.elementIndex(locals.mbondIdentity, -input.price);
+        while (locals.elementIndex != NULL_INDEX && state._askOrders.priority(locals.elementIndex) == -input.price)
         {
-            if (input.price == -state._askOrders.priority(locals.elementIndex) && state._askOrders.element(locals.elementIndex).owner == qpi.invocator())
+            if (state._askOrders.element(locals.elementIndex).owner == qpi.invocator())
             {
                 if (state._askOrders.element(locals.elementIndex).numberOfMBonds <= input.numberOfMBonds)
                 {
@@ -776,48 +752,24 @@ protected:
             }
         }
 
-        if (state._bidOrders.population(locals.mbondIdentity) == 0)
+        // jump to the price level and merge with an existing order of the invocator at this price
+        locals.elementIndex = state._bidOrders.elementIndex(locals.mbondIdentity, input.price);
+        while (locals.elementIndex != NULL_INDEX && state._bidOrders.priority(locals.elementIndex) == input.price)
         {
-            locals.tempBidOrder.epoch = input.epoch;
-            locals.tempBidOrder.numberOfMBonds = input.numberOfMBonds;
-            locals.tempBidOrder.owner = qpi.invocator();
-            state._bidOrders.add(locals.mbondIdentity, locals.tempBidOrder, input.price);
-            return;
-        }
-
-        locals.elementIndex = state._bidOrders.headIndex(locals.mbondIdentity);
-        while (locals.elementIndex != NULL_INDEX)
-        {
-            if (input.price > state._bidOrders.priority(locals.elementIndex))
-            {
-                locals.tempBidOrder.epoch = input.epoch;
-                locals.tempBidOrder.numberOfMBonds = input.numberOfMBonds;
-                locals.tempBidOrder.owner = qpi.invocator();
-                state._bidOrders.add(locals.mbondIdentity, locals.tempBidOrder, input.price);
-                break;
-            }
-            else if (input.price == state._bidOrders.priority(locals.elementIndex))
-            {
-                if (state._bidOrders.element(locals.elementIndex).owner == qpi.invocator())
-                {
-                    locals.tempBidOrder = state._bidOrders.element(locals.elementIndex);
-                    locals.tempBidOrder.numberOfMBonds += input.numberOfMBonds;
-                    state._bidOrders.replace(locals.elementIndex, locals.tempBidOrder);
-                    break;
-                }
-            }
-
-            if (state._bidOrders.nextElementIndex(locals.elementIndex) == NULL_INDEX)
+            if (state._bidOrders.element(locals.elementIndex).owner == qpi.invocator())
             {
-                locals.tempBidOrder.epoch = input.epoch;
-                locals.tempBidOrder.numberOfMBonds = input.numberOfMBonds;
-                locals.tempBidOrder.owner = qpi.invocator();
-                state._bidOrders.add(locals.mbondIdentity, locals.tempBidOrder, input.price);
-                break;
+                locals.tempBidOrder = state._bidOrders.element(locals.elementIndex);
+                locals.tempBidOrder.numberOfMBonds += input.numberOfMBonds;
+                state._bidOrders.replace(locals.elementIndex, locals.tempBidOrder);
+                return;
             }
-
             locals.elementIndex = state._bidOrders.nextElementIndex(locals.elementIndex);
         }
+
+        locals.tempBidOrder.epoch = input.epoch;
+        locals.tempBidOrder.numberOfMBonds = input.numberOfMBonds;
+        locals.tempBidOrder.owner = qpi.invocator();
+        state._bidOrders.add(locals.mbondIdentity, locals.tempBidOrder, input.price);
     }
 
     struct RemoveBidOrder_locals
@@ -849,10 +801,10 @@ protected:
             locals.mbondIdentity.u16._3 = (uint16) input.epoch;
         }
 
-        locals.elementIndex = state._bidOrders.headIndex(locals.mbondIdentity);
-        while (locals.elementIndex != NULL_INDEX)
+        locals.elementIndex = state._bidOrders.elementIndex(locals.mbondIdentity, input.price);
+        while (locals.elementIndex != NULL_INDEX && state._bidOrders.priority(locals.elementIndex) == input.price)
         {
-            if (input.price == state._bidOrders.priority(locals.elementIndex) && state._bidOrders.element(locals.elementIndex).owner == qpi.invocator())
+            if (state._bidOrders.element(locals.elementIndex).owner == qpi.invocator())
             {
                 if (state._bidOrders.element(locals.elementIndex).numberOfMBonds <= input.numberOfMBonds)
                 {
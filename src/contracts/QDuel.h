@@ -388,6 +388,9 @@ public:
 		sint64 roomIndex;
 		uint32 currentTimestamp;
 		uint64 elapsedSeconds;
+		Array<id, QDUEL_MAX_NUMBER_OF_ROOMS> expiredRoomIds;
+		uint64 expiredRoomCount;
+		uint64 expiredIndex;
 		FinalizeRoom_input finalizeInput;
 		FinalizeRoom_output finalizeOutput;
 	};
@@ -456,11 +459,12 @@ public:
 			return;
 		}
 
+		locals.now = qpi.now();
+		locals.expiredRoomCount = 0;
 		locals.roomIndex = state.rooms.nextElementIndex(NULL_INDEX);
 		while (locals.roomIndex != NULL_INDEX)
 		{
 			locals.room = state.rooms.value(locals.roomIndex);
-			locals.now = qpi.now();
 
 			/**
 			 * The interval between the end of the epoch and the first valid tick can be large.
@@ -474,11 +478,10 @@ public:
 			locals.elapsedSeconds = div(locals.room.lastUpdate.durationMicrosec(locals.now), 1000000ULL);
 			if (locals.elapsedSeconds >= locals.room.closeTimer)
 			{
-				locals.finalizeInput.roomId = locals.room.roomId;
-				locals.finalizeInput.owner = locals.room.owner;
-				locals.finalizeInput.roomAmount = locals.room.amount;
-				locals.finalizeInput.includeLocked = true;
-				CALL(FinalizeRoom, locals.finalizeInput, locals.finalizeOutput);
+				// Finalize after the sweep, because finalizing removes the room, may create a follow-up room, and may
+				// clean up the hash map, which would invalidate the iteration.
+				locals.expiredRoomIds.set(locals.expiredRoomCount, locals.room.roomId);
+				++locals.expiredRoomCount;
 			}
 			else
 			{
@@ -490,6 +493,19 @@ public:
 			locals.roomIndex = state.rooms.nextElementIndex(locals.roomIndex);
 		}
 
+		for (locals.expiredIndex = 0; locals.expiredIndex < locals.expiredRoomCount; ++locals.expiredIndex)
+		{
+			if (!state.rooms.get(locals.expiredRoomIds.get(locals.expiredIndex), locals.room))
+			{
+				continue;
+			}
+			locals.finalizeInput.roomId = locals.room.roomId;
+			locals.finalizeInput.owner = locals.room.owner;
+			locals.finalizeInput.roomAmount = locals.room.amount;
+			locals.finalizeInput.includeLocked = true;
+			CALL(FinalizeRoom, locals.finalizeInput, locals.finalizeOutput);
+		}
+
 		state.firstTick = false;
 	}
 
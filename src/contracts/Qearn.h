@@ -7,6 +7,7 @@ constexpr uint64 QEARN_MAX_USERS = 131072;
 constexpr uint64 QEARN_MAX_LOCK_AMOUNT = 1000000000000ULL;
 constexpr uint64 QEARN_MAX_BONUS_AMOUNT = 1000000000000ULL;
 constexpr uint64 QEARN_INITIAL_EPOCH = 138;
+constexpr uint64 QEARN_PAYOUT_BATCH_SIZE = 512;                  // number of full unlocks paid out with one qpi.transferMany() in END_EPOCH
 
 constexpr uint64 QEARN_EARLY_UNLOCKING_PERCENT_0_3 = 0;
 constexpr uint64 QEARN_EARLY_UNLOCKING_PERCENT_4_7 = 5;
@@ -1035,6 +1036,11 @@ protected:
         QEARNLogger log;
         _RemoveGapsInLockerArray_input gapRemovalInput;
         _RemoveGapsInLockerArray_output gapRemovalOutput;
+        Array<id, QEARN_PAYOUT_BATCH_SIZE> payoutDestinations;
+        Array<sint64, QEARN_PAYOUT_BATCH_SIZE> payoutAmounts;
+        uint64 payoutCount;
+        uint64 _p;
+        bit payoutBatchTransferred;
 
         uint64 _rewardPercent;
         uint64 _rewardAmount;
@@ -1068,11 +1074,27 @@ protected:
             ASSERT(state.locker.get(locals._t)._lockedEpoch == locals.lockedEpoch);
 
             locals._rewardAmount = div(state.locker.get(locals._t)._lockedAmount * locals._rewardPercent, 10000000ULL);
-            qpi.transfer(state.locker.get(locals._t).ID, locals._rewardAmount + state.locker.get(locals._t)._lockedAmount);
-
             locals.transferAmount = locals._rewardAmount + state.locker.get(locals._t)._lockedAmount;
-            locals.log = {QEARN_CONTRACT_INDEX, SELF, qpi.invocator(), locals.transferAmount, QearnSuccessFullyUnlocking, 0};
-            LOG_INFO(locals.log);
+
+            // collect payouts and transfer them in batches, each unlock is logged after its transfer
+            locals.payoutDestinations.set(locals.payoutCount, state.locker.get(locals._t).ID);
+            locals.payoutAmounts.set(locals.payoutCount, locals.transferAmount);
+            locals.payoutCount++;
+            if (locals.payoutCount == QEARN_PAYOUT_BATCH_SIZE)
+            {
+                locals.payoutBatchTransferred = (qpi.transferMany(locals.payoutDestinations, locals.payoutAmounts, locals.payoutCount) >= 0);
+                for (locals._p = 0; locals._p < locals.payoutCount; locals._p++)
+                {
+                    if (!locals.payoutBatchTransferred)
+                    {
+                        // insufficient balance for whole batch -> transfer one by one as far as possible
+                        qpi.transfer(locals.payoutDestinations.get(locals._p), locals.payoutAmounts.get(locals._p));
+                    }
+                    locals.log = {QEARN_CONTRACT_INDEX, SELF, qpi.invocator(), locals.payoutAmounts.get(locals._p), QearnSuccessFullyUnlocking, 0};
+                    LOG_INFO(locals.log);
+                }
+                locals.payoutCount = 0;
+            }
 
             if(state._fullyUnlockedCnt < QEARN_MAX_USERS) 
             {
@@ -1096,6 +1118,20 @@ protected:
             locals.tmpStats.rewardedAmount += locals._rewardAmount;
         }
 
+        if (locals.payoutCount)
+        {
+            locals.payoutBatchTransferred = (qpi.transferMany(locals.payoutDestinations, locals.payoutAmounts, locals.payoutCount) >= 0);
+            for (locals._p = 0; locals._p < locals.payoutCount; locals._p++)
+            {
+                if (!locals.payoutBatchTransferred)
+                {
+                    qpi.transfer(locals.payoutDestinations.get(locals._p), locals.payoutAmounts.get(locals._p));
+                }
+                locals.log = {QEARN_CONTRACT_INDEX, SELF, qpi.invocator(), locals.payoutAmounts.get(locals._p), QearnSuccessFullyUnlocking, 0};
+                LOG_INFO(locals.log);
+            }
+        }
+
         locals.tmpEpochIndex.startIndex = 0;
         locals.tmpEpochIndex.endIndex = 0;
         state._epochIndex.set(locals.lockedEpoch, locals.tmpEpochIndex);
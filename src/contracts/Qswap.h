@@ -18,6 +18,13 @@ constexpr uint64 QSWAP_MAX_USER_PER_POOL = 256;
 constexpr sint64 QSWAP_MIN_LIQUIDITY = 1000;
 constexpr uint32 QSWAP_SWAP_FEE_BASE = 10000;
 constexpr uint32 QSWAP_FEE_BASE_100 = 100;
+constexpr uint64 QSWAP_MAX_QUOTES_PER_CALL = 64;
+
+// Quote types of QuoteMany
+constexpr uint8 QSWAP_QUOTE_EXACT_QU_INPUT = 0;
+constexpr uint8 QSWAP_QUOTE_EXACT_QU_OUTPUT = 1;
+constexpr uint8 QSWAP_QUOTE_EXACT_ASSET_INPUT = 2;
+constexpr uint8 QSWAP_QUOTE_EXACT_ASSET_OUTPUT = 3;
 
 struct QSWAP2 
 {
@@ -169,6 +176,40 @@ public:
 		sint64 quAmountIn;
 	};
 
+	struct QuoteRequest
+	{
+		id assetIssuer;
+		uint64 assetName;
+		sint64 amount;		// amount passed to the quote function of the type
+		uint8 type;			// QSWAP_QUOTE_EXACT_QU_INPUT, ..., QSWAP_QUOTE_EXACT_ASSET_OUTPUT
+	};
+
+	// Evaluate up to QSWAP_MAX_QUOTES_PER_CALL quotes in one call, for example of all pools a bot watches.
+	struct QuoteMany_input
+	{
+		Array<QuoteRequest, QSWAP_MAX_QUOTES_PER_CALL> requests;
+		uint32 count;
+	};
+	struct QuoteMany_output
+	{
+		Array<sint64, QSWAP_MAX_QUOTES_PER_CALL> amounts;	// same as output of single quote function, -1 on error
+	};
+
+	// Quote for swapping asset in -> qu -> asset out through two pools (see SwapExactAssetForAsset)
+	struct QuoteExactAssetForAsset_input
+	{
+		id assetInIssuer;
+		uint64 assetInName;
+		id assetOutIssuer;
+		uint64 assetOutName;
+		sint64 assetAmountIn;
+	};
+	struct QuoteExactAssetForAsset_output
+	{
+		sint64 quAmount;		// qu amount of intermediate hop
+		sint64 assetAmountOut;	// -1 on error
+	};
+
 	struct IssueAsset_input
 	{
 		uint64 assetName;
@@ -285,6 +326,20 @@ public:
 		sint64 assetAmountIn;
 	};
 
+	struct SwapExactAssetForAsset_input
+	{
+		id assetInIssuer;
+		uint64 assetInName;
+		sint64 assetAmountIn;
+		id assetOutIssuer;
+		uint64 assetOutName;
+		sint64 assetAmountOutMin;
+	};
+	struct SwapExactAssetForAsset_output
+	{
+		sint64 assetAmountOut;
+	};
+
 	struct TransferShareManagementRights_input
 	{
 		Asset asset;
@@ -854,6 +909,185 @@ protected:
 		);
 	}
 
+	struct _Quote_input
+	{
+		id poolID;
+		sint64 amount;
+		uint8 type;
+	};
+	struct _Quote_output
+	{
+		sint64 amount;
+	};
+	struct _Quote_locals
+	{
+		sint64 poolSlot;
+		PoolBasicState poolBasicState;
+		sint64 quAmountOutWithFee;
+
+		uint32 i0;
+		uint128 i1, i2, i3, i4;
+	};
+
+	// Same results as QuoteExactQuInput, QuoteExactQuOutput, QuoteExactAssetInput, and QuoteExactAssetOutput
+	PRIVATE_FUNCTION_WITH_LOCALS(_Quote)
+	{
+		output.amount = -1;
+
+		if (input.amount <= 0 || input.type > QSWAP_QUOTE_EXACT_ASSET_OUTPUT)
+		{
+			return;
+		}
+
+		locals.poolSlot = -1;
+		for (locals.i0 = 0; locals.i0 < QSWAP_MAX_POOL; locals.i0 ++)
+		{
+			if (state.mPoolBasicStates.get(locals.i0).poolID == input.poolID)
+			{
+				locals.poolSlot = locals.i0;
+				break;
+			}
+		}
+
+		if (locals.poolSlot == -1)
+		{
+			return;
+		}
+
+		locals.poolBasicState = state.mPoolBasicStates.get(locals.poolSlot);
+
+		// no liquidity in the pool
+		if (locals.poolBasicState.totalLiquidity == 0)
+		{
+			return;
+		}
+
+		if (input.type == QSWAP_QUOTE_EXACT_QU_INPUT)
+		{
+			output.amount = getAmountOutTakeFeeFromInToken(
+				input.amount,
+				locals.poolBasicState.reservedQuAmount,
+				locals.poolBasicState.reservedAssetAmount,
+				state.swapFeeRate,
+				locals.i1,
+				locals.i2,
+				locals.i3,
+				locals.i4
+			);
+		}
+		else if (input.type == QSWAP_QUOTE_EXACT_QU_OUTPUT)
+		{
+			if (input.amount >= locals.poolBasicState.reservedQuAmount)
+			{
+				return;
+			}
+			output.amount = getAmountInTakeFeeFromOutToken(
+				input.amount,
+				locals.poolBasicState.reservedAssetAmount,
+				locals.poolBasicState.reservedQuAmount,
+				state.swapFeeRate,
+				locals.i1,
+				locals.i2,
+				locals.i3
+			);
+		}
+		else if (input.type == QSWAP_QUOTE_EXACT_ASSET_INPUT)
+		{
+			locals.quAmountOutWithFee = getAmountOutTakeFeeFromOutToken(
+				input.amount,
+				locals.poolBasicState.reservedAssetAmount,
+				locals.poolBasicState.reservedQuAmount,
+				state.swapFeeRate,
+				locals.i1,
+				locals.i2,
+				locals.i3
+			);
+			if (locals.quAmountOutWithFee == -1)
+			{
+				return;
+			}
+			output.amount = sint64(div(
+				uint128(locals.quAmountOutWithFee) * uint128(QSWAP_SWAP_FEE_BASE - state.swapFeeRate),
+				uint128(QSWAP_SWAP_FEE_BASE)
+			).low);
+		}
+		else
+		{
+			if (input.amount >= locals.poolBasicState.reservedAssetAmount)
+			{
+				return;
+			}
+			output.amount = getAmountInTakeFeeFromInToken(
+				input.amount,
+				locals.poolBasicState.reservedQuAmount,
+				locals.poolBasicState.reservedAssetAmount,
+				state.swapFeeRate,
+				locals.i1,
+				locals.i2,
+				locals.i3
+			);
+		}
+	}
+
+	struct QuoteMany_locals
+	{
+		_Quote_input quoteInput;
+		_Quote_output quoteOutput;
+		QuoteRequest request;
+		uint32 i0;
+	};
+
+	PUBLIC_FUNCTION_WITH_LOCALS(QuoteMany)
+	{
+		for (locals.i0 = 0; locals.i0 < QSWAP_MAX_QUOTES_PER_CALL; locals.i0++)
+		{
+			output.amounts.set(locals.i0, -1);
+		}
+
+		for (locals.i0 = 0; locals.i0 < input.count && locals.i0 < QSWAP_MAX_QUOTES_PER_CALL; locals.i0++)
+		{
+			locals.request = input.requests.get(locals.i0);
+			locals.quoteInput.poolID = locals.request.assetIssuer;
+			locals.quoteInput.poolID.u64._3 = locals.request.assetName;
+			locals.quoteInput.amount = locals.request.amount;
+			locals.quoteInput.type = locals.request.type;
+			CALL(_Quote, locals.quoteInput, locals.quoteOutput);
+			output.amounts.set(locals.i0, locals.quoteOutput.amount);
+		}
+	}
+
+	struct QuoteExactAssetForAsset_locals
+	{
+		_Quote_input quoteInput;
+		_Quote_output quoteOutput;
+	};
+
+	PUBLIC_FUNCTION_WITH_LOCALS(QuoteExactAssetForAsset)
+	{
+		output.quAmount = -1;
+		output.assetAmountOut = -1;
+
+		locals.quoteInput.poolID = input.assetInIssuer;
+		locals.quoteInput.poolID.u64._3 = input.assetInName;
+		locals.quoteInput.amount = input.assetAmountIn;
+		locals.quoteInput.type = QSWAP_QUOTE_EXACT_ASSET_INPUT;
+		CALL(_Quote, locals.quoteInput, locals.quoteOutput);
+		output.quAmount = locals.quoteOutput.amount;
+
+		// both hops through the same pool are not supported
+		if (output.quAmount <= 0 || (input.assetInIssuer == input.assetOutIssuer && input.assetInName == input.assetOutName))
+		{
+			return;
+		}
+
+		locals.quoteInput.poolID = input.assetOutIssuer;
+		locals.quoteInput.poolID.u64._3 = input.assetOutName;
+		locals.quoteInput.amount = output.quAmount;
+		locals.quoteInput.type = QSWAP_QUOTE_EXACT_QU_INPUT;
+		CALL(_Quote, locals.quoteInput, locals.quoteOutput);
+		output.assetAmountOut = locals.quoteOutput.amount;
+	}
+
 	PUBLIC_FUNCTION(InvestRewardsInfo)
 	{
 		output.investRewardsFee = state.investRewardsFeeRate;
@@ -2168,6 +2402,278 @@ protected:
 		LOG_INFO(locals.swapMessage);
 	}
 
+	struct SwapExactAssetForAsset_locals
+	{
+		QSWAPSwapMessage swapMessage;
+		id poolInID;
+		id poolOutID;
+		sint64 poolInSlot;
+		sint64 poolOutSlot;
+		PoolBasicState poolIn;
+		PoolBasicState poolOut;
+		sint64 quAmountOutWithFee;
+		sint64 quAmount;
+		sint64 assetAmountOut;
+		sint64 transferredAssetAmountBefore;
+		sint64 transferredAssetAmountAfter;
+
+		uint32 i0;
+		uint128 i1, i2, i3, i4;
+		uint128 swapFee;
+		uint128 feeToInvestRewards1, feeToShareholders1, feeToQx1, feeToBurn1;
+		uint128 feeToInvestRewards2, feeToShareholders2, feeToQx2, feeToBurn2;
+
+		sint64 totalFee;
+	};
+
+	// Swap given amount of asset in for asset out through the pools of both assets (asset in -> qu -> asset out) in
+	// one transaction, only execute swapping if assetAmountOut >= input.assetAmountOutMin. Each hop is computed and
+	// accounted like SwapExactAssetForQu and SwapExactQuForAsset, but the qu of the intermediate hop stays in the
+	// contract. The invocator needs to give management rights of asset in to QSWAP as for SwapExactAssetForQu.
+	PUBLIC_PROCEDURE_WITH_LOCALS(SwapExactAssetForAsset)
+	{
+		output.assetAmountOut = 0;
+		if (qpi.invocationReward() > 0)
+		{
+			qpi.transfer(qpi.invocator(), qpi.invocationReward());
+		}
+
+		// check input param validity
+		if ((input.assetAmountIn <= 0) || (input.assetAmountOutMin < 0))
+		{
+			return;
+		}
+
+		locals.poolInID = input.assetInIssuer;
+		locals.poolInID.u64._3 = input.assetInName;
+		locals.poolOutID = input.assetOutIssuer;
+		locals.poolOutID.u64._3 = input.assetOutName;
+
+		// both hops through the same pool are not supported
+		if (locals.poolInID == locals.poolOutID)
+		{
+			return;
+		}
+
+		locals.poolInSlot = -1;
+		locals.poolOutSlot = -1;
+		for (locals.i0 = 0; locals.i0 < QSWAP_MAX_POOL; locals.i0++)
+		{
+			if (state.mPoolBasicStates.get(locals.i0).poolID == locals.poolInID)
+			{
+				locals.poolInSlot = locals.i0;
+			}
+			else if (state.mPoolBasicStates.get(locals.i0).poolID == locals.poolOutID)
+			{
+				locals.poolOutSlot = locals.i0;
+			}
+			if (locals.poolInSlot != -1 && locals.poolOutSlot != -1)
+			{
+				break;
+			}
+		}
+
+		if (locals.poolInSlot == -1 || locals.poolOutSlot == -1)
+		{
+			return;
+		}
+
+		locals.poolIn = state.mPoolBasicStates.get(locals.poolInSlot);
+		locals.poolOut = state.mPoolBasicStates.get(locals.poolOutSlot);
+
+		// check the liquidity validity 
+		if (locals.poolIn.totalLiquidity == 0 || locals.poolOut.totalLiquidity == 0)
+		{
+			return;
+		}
+
+		// invocator's asset not enough 
+		if (qpi.numberOfPossessedShares(
+				input.assetInName,
+				input.assetInIssuer,
+				qpi.invocator(),
+				qpi.invocator(),
+				SELF_INDEX,
+				SELF_INDEX
+			) < input.assetAmountIn)
+		{
+			return;
+		}
+
+		// first hop: asset in -> qu (see SwapExactAssetForQu)
+		locals.quAmountOutWithFee = getAmountOutTakeFeeFromOutToken(
+			input.assetAmountIn,
+			locals.poolIn.reservedAssetAmount,
+			locals.poolIn.reservedQuAmount,
+			state.swapFeeRate,
+			locals.i1,
+			locals.i2,
+			locals.i3
+		);
+		if (locals.quAmountOutWithFee == -1)
+		{
+			return;
+		}
+		locals.quAmount = sint64(div(
+				uint128(locals.quAmountOutWithFee) * uint128(QSWAP_SWAP_FEE_BASE - state.swapFeeRate), 
+				uint128(QSWAP_SWAP_FEE_BASE)
+			).low);
+		if (locals.quAmount <= 0)
+		{
+			return;
+		}
+
+		locals.swapFee = div(uint128(locals.quAmountOutWithFee) * uint128(state.swapFeeRate), uint128(QSWAP_SWAP_FEE_BASE));
+		locals.feeToShareholders1 = div(locals.swapFee * uint128(state.shareholderFeeRate), uint128(QSWAP_FEE_BASE_100));
+		locals.feeToQx1 = div(locals.swapFee * uint128(state.qxFeeRate), uint128(QSWAP_FEE_BASE_100));
+		locals.feeToInvestRewards1 = div(locals.swapFee * uint128(state.investRewardsFeeRate), uint128(QSWAP_FEE_BASE_100));
+		locals.feeToBurn1 = div(locals.swapFee * uint128(state.burnFeeRate), uint128(QSWAP_FEE_BASE_100));
+
+		// second hop: qu -> asset out (see SwapExactQuForAsset)
+		locals.assetAmountOut = getAmountOutTakeFeeFromInToken(
+			locals.quAmount,
+			locals.poolOut.reservedQuAmount,
+			locals.poolOut.reservedAssetAmount,
+			state.swapFeeRate,
+			locals.i1,
+			locals.i2,
+			locals.i3,
+			locals.i4
+		);
+
+		// overflow or not meet user's amountOut requirement
+		if (locals.assetAmountOut <= 0 || locals.assetAmountOut < input.assetAmountOutMin)
+		{
+			return;
+		}
+
+		locals.swapFee = div(uint128(locals.quAmount) * uint128(state.swapFeeRate), uint128(QSWAP_SWAP_FEE_BASE));
+		locals.feeToShareholders2 = div(locals.swapFee * uint128(state.shareholderFeeRate), uint128(QSWAP_FEE_BASE_100));
+		locals.feeToQx2 = div(locals.swapFee * uint128(state.qxFeeRate), uint128(QSWAP_FEE_BASE_100));
+		locals.feeToInvestRewards2 = div(locals.swapFee * uint128(state.investRewardsFeeRate), uint128(QSWAP_FEE_BASE_100));
+		locals.feeToBurn2 = div(locals.swapFee * uint128(state.burnFeeRate), uint128(QSWAP_FEE_BASE_100));
+
+		// Overflow protection: ensure all fees fit in uint64
+		if (locals.feeToShareholders1.high != 0 || locals.feeToQx1.high != 0
+			|| locals.feeToInvestRewards1.high != 0 || locals.feeToBurn1.high != 0
+			|| locals.feeToShareholders2.high != 0 || locals.feeToQx2.high != 0
+			|| locals.feeToInvestRewards2.high != 0 || locals.feeToBurn2.high != 0)
+		{
+			return;
+		}
+
+		locals.totalFee = sint64(locals.feeToShareholders2.low) + sint64(locals.feeToQx2.low) + sint64(locals.feeToInvestRewards2.low) + sint64(locals.feeToBurn2.low);
+		if (locals.quAmount < locals.totalFee)
+		{
+			return;
+		}
+
+		// transfer asset in from user to pool
+		locals.transferredAssetAmountBefore = qpi.numberOfPossessedShares(
+			input.assetInName,
+			input.assetInIssuer,
+			SELF,
+			SELF,
+			SELF_INDEX,
+			SELF_INDEX
+		);
+		qpi.transferShareOwnershipAndPossession(
+			input.assetInName,
+			input.assetInIssuer,
+			qpi.invocator(),
+			qpi.invocator(),
+			input.assetAmountIn,
+			SELF
+		);
+		locals.transferredAssetAmountAfter = qpi.numberOfPossessedShares(
+			input.assetInName,
+			input.assetInIssuer,
+			SELF,
+			SELF,
+			SELF_INDEX,
+			SELF_INDEX
+		);
+
+		// pool does not receive enough asset, rollback any received shares
+		if (locals.transferredAssetAmountAfter - locals.transferredAssetAmountBefore < input.assetAmountIn)
+		{
+			if (locals.transferredAssetAmountAfter > locals.transferredAssetAmountBefore)
+			{
+				qpi.transferShareOwnershipAndPossession(
+					input.assetInName,
+					input.assetInIssuer,
+					SELF,
+					SELF,
+					locals.transferredAssetAmountAfter - locals.transferredAssetAmountBefore,
+					qpi.invocator()
+				);
+			}
+			return;
+		}
+
+		// transfer asset out from pool to user, rollback asset in if it fails
+		if (qpi.transferShareOwnershipAndPossession(
+				input.assetOutName,
+				input.assetOutIssuer,
+				SELF,
+				SELF,
+				locals.assetAmountOut,
+				qpi.invocator()
+			) < 0)
+		{
+			qpi.transferShareOwnershipAndPossession(
+				input.assetInName,
+				input.assetInIssuer,
+				SELF,
+				SELF,
+				input.assetAmountIn,
+				qpi.invocator()
+			);
+			return;
+		}
+		output.assetAmountOut = locals.assetAmountOut;
+
+		// update fee state after successful transfers
+		state.shareholderEarnedFee += locals.feeToShareholders1.low + locals.feeToShareholders2.low;
+		state.qxEarnedFee += locals.feeToQx1.low + locals.feeToQx2.low;
+		state.investRewardsEarnedFee += locals.feeToInvestRewards1.low + locals.feeToInvestRewards2.low;
+		state.burnEarnedFee += locals.feeToBurn1.low + locals.feeToBurn2.low;
+
+		// update pool states
+		locals.poolIn.reservedAssetAmount += input.assetAmountIn;
+		locals.totalFee = locals.quAmount + sint64(locals.feeToShareholders1.low) + sint64(locals.feeToQx1.low) + sint64(locals.feeToInvestRewards1.low) + sint64(locals.feeToBurn1.low);
+		if (locals.poolIn.reservedQuAmount < locals.totalFee)
+		{
+			locals.poolIn.reservedQuAmount = 0;
+		}
+		else
+		{
+			locals.poolIn.reservedQuAmount -= locals.totalFee;
+		}
+		state.mPoolBasicStates.set(locals.poolInSlot, locals.poolIn);
+
+		locals.totalFee = sint64(locals.feeToShareholders2.low) + sint64(locals.feeToQx2.low) + sint64(locals.feeToInvestRewards2.low) + sint64(locals.feeToBurn2.low);
+		locals.poolOut.reservedQuAmount += locals.quAmount - locals.totalFee;
+		locals.poolOut.reservedAssetAmount -= locals.assetAmountOut;
+		state.mPoolBasicStates.set(locals.poolOutSlot, locals.poolOut);
+
+		// Log both hops like SwapExactAssetForQu and SwapExactQuForAsset
+		locals.swapMessage._contractIndex = SELF_INDEX;
+		locals.swapMessage._type = QSWAPSwapExactAssetForQu;
+		locals.swapMessage.assetIssuer = input.assetInIssuer;
+		locals.swapMessage.assetName = input.assetInName;
+		locals.swapMessage.assetAmountIn = input.assetAmountIn;
+		locals.swapMessage.assetAmountOut = locals.quAmount;
+		LOG_INFO(locals.swapMessage);
+
+		locals.swapMessage._type = QSWAPSwapExactQuForAsset;
+		locals.swapMessage.assetIssuer = input.assetOutIssuer;
+		locals.swapMessage.assetName = input.assetOutName;
+		locals.swapMessage.assetAmountIn = locals.quAmount;
+		locals.swapMessage.assetAmountOut = output.assetAmountOut;
+		LOG_INFO(locals.swapMessage);
+	}
+
 	PUBLIC_PROCEDURE(TransferShareOwnershipAndPossession)
 	{
 		output.transferredAmount = 0;
@@ -2304,6 +2810,8 @@ protected:
 		REGISTER_USER_FUNCTION(QuoteExactAssetInput, 6);
 		REGISTER_USER_FUNCTION(QuoteExactAssetOutput, 7);
 		REGISTER_USER_FUNCTION(InvestRewardsInfo, 8);
+		REGISTER_USER_FUNCTION(QuoteMany, 9);
+		REGISTER_USER_FUNCTION(QuoteExactAssetForAsset, 10);
 
 		// procedure
 		REGISTER_USER_PROCEDURE(IssueAsset, 1);
@@ -2317,6 +2825,7 @@ protected:
 		REGISTER_USER_PROCEDURE(SwapAssetForExactQu, 9);
 		REGISTER_USER_PROCEDURE(SetInvestRewardsInfo, 10);
 		REGISTER_USER_PROCEDURE(TransferShareManagementRights, 11);
+		REGISTER_USER_PROCEDURE(SwapExactAssetForAsset, 12);
 	}
 
 	INITIALIZE()
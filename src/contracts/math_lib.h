@@ -70,10 +70,22 @@ inline constexpr unsigned long long findNextPowerOf2(unsigned long long num)
 //////////
 // safety multiplying a and b and then clamp
 
+#if !defined(_MSC_VER) || defined(__clang__)
+// 128-bit integers of GCC and Clang. __extension__ keeps -Wpedantic from warning about these non-standard types.
+__extension__ typedef __int128 int128_native_t;
+__extension__ typedef unsigned __int128 uint128_native_t;
+#endif
+
 inline static long long smul(long long a, long long b)
 {
 	long long hi, lo;
+#if defined(_MSC_VER) && !defined(__clang__)
 	lo = _mul128(a, b, &hi);
+#else
+	const int128_native_t product = (int128_native_t)a * b;
+	lo = (long long)product;
+	hi = (long long)(product >> 64);
+#endif
 	if (hi != (lo >> 63))
 	{
 		return ((a > 0) == (b > 0)) ? INT64_MAX : INT64_MIN;
@@ -84,7 +96,13 @@ inline static long long smul(long long a, long long b)
 inline static unsigned long long smul(unsigned long long a, unsigned long long b)
 {
 	unsigned long long hi, lo;
+#if defined(_MSC_VER) && !defined(__clang__)
 	lo = _umul128(a, b, &hi);
+#else
+	const uint128_native_t product = (uint128_native_t)a * b;
+	lo = (unsigned long long)product;
+	hi = (unsigned long long)(product >> 64);
+#endif
 	if (hi != 0)
 	{
 		return UINT64_MAX;
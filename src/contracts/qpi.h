@@ -57,6 +57,7 @@ namespace QPI
 		CallErrorContractInErrorState = 1,      // Called contract is already in error state
 		CallErrorInsufficientFees = 2,          // Called contract has no execution fee reserve
 		CallErrorAllocationFailed = 3,          // Failed to allocate context on stack
+		CallErrorOwnStateOnlyTickHook = 4,      // Caller is BEGIN_TICK / END_TICK declared with TICK_HOOKS_ACCESS_ONLY_OWN_STATE()
 	};
 
 	typedef uint128_t uint128;
@@ -1030,9 +1031,23 @@ namespace QPI
 		static uint64 hash(const KeyT& key);
 	};
 
+	// Fast non-cryptographic hash function (multiply-xor mixing of the key bytes) that can be passed as HashFunc to the
+	// hash map / hash set instead of the default, which runs KangarooTwelve on the key. The result only depends on the
+	// bytes of the key, so it is the same on all nodes. Keys must not contain uninitialized padding bytes.
+	// CAUTION: Hash maps in existing contract states cannot switch the hash function, because it determines the
+	// position of the stored elements.
+	template <typename KeyT> class FastHashFunction
+	{
+	public:
+		static uint64 hash(const KeyT& key);
+	};
+
 	// Hash map of (key, value) pairs of type (KeyT, ValueT) and total element capacity L. Access time is approx. constant
 	// with population < 80% of L but gets close to linear with population > 90% of L.
-	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc = HashFunction<KeyT>>
+	// With reclaimRemovedSlots, slots marked for removal at the end of a probe sequence are turned back into empty slots
+	// on removal (with bounded cost), so fewer slots are left for cleanup(). This changes the content of the hash map
+	// compared to the default, so it must not be toggled for existing contract states.
+	template <typename KeyT, typename ValueT, uint64 L, typename HashFunc = HashFunction<KeyT>, bool reclaimRemovedSlots = false>
 	class HashMap
 	{
 	private:
@@ -1059,6 +1074,23 @@ namespace QPI
 		// Read and encode 32 POV occupation flags, return a 64bits number presents 32 occupation flags
 		uint64 _getEncodedOccupationFlags(const uint64* occupationFlags, const sint64 elementIndex) const;
 
+		// Turn slots marked for removal into empty slots, going backward from elementIndex, if they are directly followed
+		// by an empty slot. Lookups stop at empty slots anyway, so results don't change, but probe sequences get shorter.
+		// Processes at most _maxReclaimedSlots slots and doesn't move any element.
+		static constexpr sint64 _maxReclaimedSlots = 64;
+		void _reclaimRemovedSlots(sint64 elementIndex);
+
+		// Number of keys processed at once by the batch functions
+		static constexpr uint64 _batchChunkSize = 16;
+
+		// Compute hash indices of keys[begin] to keys[end - 1] and prefetch their slots (end - begin <= _batchChunkSize)
+		template <uint64 N>
+		void _prepareBatch(const Array<KeyT, N>& keys, uint64 begin, uint64 end, sint64* hashIndices) const;
+
+		// Implementations of getElementIndex() and set() with precomputed hash index
+		sint64 _getElementIndex(const KeyT& key, sint64 index) const;
+		sint64 _set(const KeyT& key, const ValueT& value, sint64 index);
+
 	public:
 		HashMap()
 		{
@@ -1102,13 +1134,34 @@ namespace QPI
 		// If the hash map is full, return NULL_INDEX.
 		sint64 set(const KeyT& key, const ValueT& value);
 
-		// Mark element for removal.
+		// Mark element for removal. With reclaimRemovedSlots, slots marked for removal at the end of a probe sequence
+		// are reclaimed immediately (with bounded cost), which reduces the number of slots left for cleanup().
 		void removeByIndex(sint64 elementIdx);
 
 		// Mark element for removal if key is contained in the hash map, 
 		// returning the elementIndex (or NULL_INDEX if the hash map does not contain the key).
 		sint64 removeByKey(const KeyT& key);
 
+		// Batch versions of getElementIndex(), get(), set(), and removeByKey() for keys[0] to keys[count - 1]. The hashes
+		// of a group of keys are computed and their slots are prefetched before the keys are processed in order, which
+		// hides memory latency with large maps. The result is the same as calling the single-key function in a loop.
+
+		// Write index of element with keys[i] (or NULL_INDEX) to elementIndices[i]. Return number of keys found.
+		template <uint64 N>
+		uint64 getElementIndices(const Array<KeyT, N>& keys, Array<sint64, N>& elementIndices, uint64 count = N) const;
+
+		// Write value associated with keys[i] to values[i] (unchanged if key isn't contained). Return number of keys found.
+		template <uint64 N>
+		uint64 getMany(const Array<KeyT, N>& keys, Array<ValueT, N>& values, uint64 count = N) const;
+
+		// Set (keys[i], values[i]) as with set(). Return number of elements set successfully.
+		template <uint64 N>
+		uint64 setMany(const Array<KeyT, N>& keys, const Array<ValueT, N>& values, uint64 count = N);
+
+		// Mark elements with keys[i] for removal. Return number of elements removed.
+		template <uint64 N>
+		uint64 removeMany(const Array<KeyT, N>& keys, uint64 count = N);
+
 		// Call cleanup() if it makes sense. The content of this object may be reordered, so prior indices are invalidated.
 		void cleanupIfNeeded(uint64 removalThresholdPercent = 50);
 
@@ -1127,7 +1180,8 @@ namespace QPI
 
 	// Hash set of keys of type KeyT and total element capacity L. Access time is approx. constant with
 	// population < 80% of L but gets close to linear with population > 90% of L.
-	template <typename KeyT, uint64 L, typename HashFunc = HashFunction<KeyT>>
+	// See HashMap for reclaimRemovedSlots.
+	template <typename KeyT, uint64 L, typename HashFunc = HashFunction<KeyT>, bool reclaimRemovedSlots = false>
 	class HashSet
 	{
 	private:
@@ -1150,6 +1204,23 @@ namespace QPI
 		// Read and encode 32 POV occupation flags, return a 64bits number presents 32 occupation flags
 		uint64 _getEncodedOccupationFlags(const uint64* occupationFlags, const sint64 elementIndex) const;
 
+		// Turn slots marked for removal into empty slots, going backward from elementIndex, if they are directly followed
+		// by an empty slot. Lookups stop at empty slots anyway, so results don't change, but probe sequences get shorter.
+		// Processes at most _maxReclaimedSlots slots and doesn't move any element.
+		static constexpr sint64 _maxReclaimedSlots = 64;
+		void _reclaimRemovedSlots(sint64 elementIndex);
+
+		// Number of keys processed at once by the batch functions
+		static constexpr uint64 _batchChunkSize = 16;
+
+		// Compute hash indices of keys[begin] to keys[end - 1] and prefetch their slots (end - begin <= _batchChunkSize)
+		template <uint64 N>
+		void _prepareBatch(const Array<KeyT, N>& keys, uint64 begin, uint64 end, sint64* hashIndices) const;
+
+		// Implementations of getElementIndex() and add() with precomputed hash index
+		sint64 _getElementIndex(const KeyT& key, sint64 index) const;
+		sint64 _add(const KeyT& key, sint64 index);
+
 	public:
 		HashSet()
 		{
@@ -1186,13 +1257,28 @@ namespace QPI
 		// If the hash map is full, return NULL_INDEX.
 		sint64 add(const KeyT& key);
 
-		// Mark element for removal.
+		// Mark element for removal. With reclaimRemovedSlots, slots marked for removal at the end of a probe sequence
+		// are reclaimed immediately (with bounded cost), which reduces the number of slots left for cleanup().
 		void removeByIndex(sint64 elementIdx);
 
 		// Mark element for removal if key is contained in the hash set, 
 		// returning the elementIndex (or NULL_INDEX if the hash map does not contain the key).
 		sint64 remove(const KeyT& key);
 
+		// Batch versions of getElementIndex(), add(), and remove() for keys[0] to keys[count - 1] (see HashMap).
+
+		// Write index of element with keys[i] (or NULL_INDEX) to elementIndices[i]. Return number of keys found.
+		template <uint64 N>
+		uint64 getElementIndices(const Array<KeyT, N>& keys, Array<sint64, N>& elementIndices, uint64 count = N) const;
+
+		// Add keys[i] as with add(). Return number of keys contained afterwards.
+		template <uint64 N>
+		uint64 addMany(const Array<KeyT, N>& keys, uint64 count = N);
+
+		// Mark elements with keys[i] for removal. Return number of elements removed.
+		template <uint64 N>
+		uint64 removeMany(const Array<KeyT, N>& keys, uint64 count = N);
+
 		// Call cleanup() if it makes sense. The content of this object may be reordered, so prior indices are invalidated.
 		void cleanupIfNeeded(uint64 removalThresholdPercent = 50);
 
@@ -1207,7 +1293,13 @@ namespace QPI
 
 	// Collection of priority queues of elements with type T and total element capacity L.
 	// Each ID pov (point of view) has an own queue.
-	template <typename T, uint64 L>
+	// With selfBalancing, the search tree of a queue is kept balanced on insertion by rebuilding the smallest too deep
+	// subtree (scapegoat tree), which bounds the insertion cost for monotonic priorities (such as timestamps). This
+	// changes the tree layout compared to the default, so it must not be toggled for existing contract states.
+	// Iteration order is the same in both modes.
+	// With reclaimRemovedSlots, pov slots are reclaimed on removal like in HashMap, which must not be toggled for
+	// existing contract states either.
+	template <typename T, uint64 L, bool selfBalancing = false, bool reclaimRemovedSlots = false>
 	struct Collection
 	{
 	private:
@@ -1277,15 +1369,21 @@ namespace QPI
 		// Add element to priority queue, return elementIndex of new element
 		sint64 _addPovElement(const sint64 povIndex, const T value, const sint64 priority);
 
-		// Get element indices and store them in an array, return number of elements
+		// Get element indices of subtree and store them in an array (if not nullptr), return number of elements
 		uint64 _getSortedElements(const sint64 rootIdx, sint64* sortedElementIndices) const;
 
 		// Fill a sint64_4 vector with specified values
 		inline void _set(sint64_4& vec, sint64 v0, sint64 v1, sint64 v2, sint64 v3) const;
 
-		// Rebuild pov's elements indexing as balanced BST
+		// Rebuild subtree of pov's elements indexing as balanced BST, return new subtree root
 		sint64 _rebuild(sint64 rootIdx);
 
+		// Return max height of subtree with n elements that is considered balanced (2 * floor(log2(n)))
+		static sint64 _maxBalancedHeight(uint64 n);
+
+		// Rebuild smallest too deep subtree containing the new element (only used with selfBalancing)
+		void _rebalanceAfterInsert(const sint64 povIndex, const sint64 newElementIdx);
+
 		// Return most left element index
 		sint64 _getMostLeft(sint64 elementIdx) const;
 
@@ -1307,6 +1405,11 @@ namespace QPI
 		// Read and encode 32 POV occupation flags, return a 64bits number presents 32 occupation flags
 		uint64 _getEncodedPovOccupationFlags(const uint64* povOccupationFlags, const sint64 povIndex) const;;
 
+		// Turn pov slots marked for removal into empty slots, going backward from povIndex, if they are directly
+		// followed by an empty slot (see HashMap::_reclaimRemovedSlots()). Processes at most _maxReclaimedSlots slots.
+		static constexpr sint64 _maxReclaimedSlots = 64;
+		void _reclaimRemovedPovSlots(sint64 povIndex);
+
 	public:
 		// Add element to priority queue of ID pov, return elementIndex of new element
 		sint64 add(const id& pov, T element, sint64 priority);
@@ -1333,6 +1436,11 @@ namespace QPI
 		// Return elementIndex of first element with priority <= maxPriority in priority queue of pov (or NULL_INDEX if pov is unknown).
 		sint64 headIndex(const id& pov, sint64 maxPriority) const;
 
+		// Return elementIndex of first element with priority == priority in priority queue of pov (or NULL_INDEX if there
+		// is none). Using unique priorities per pov as keys, this allows to use the collection as multimap with O(log n)
+		// lookup of (pov, key), for example per-user records keyed by project index, which are updated in-place with replace().
+		sint64 elementIndex(const id& pov, sint64 priority) const;
+
 		// Return elementIndex of next element in priority queue (or NULL_INDEX if this is the last element).
 		sint64 nextElementIndex(sint64 elementIndex) const;
 
@@ -1351,7 +1459,8 @@ namespace QPI
 		// Return priority of elementIndex (or 0 id if unused).
 		sint64 priority(sint64 elementIndex) const;
 
-		// Remove element and mark its pov for removal, if the last element.
+		// Remove element and mark its pov for removal, if the last element (with reclaimRemovedSlots, reclaiming pov
+		// slots at the end of a probe sequence immediately, see HashMap::removeByIndex()).
 		// Returns element index of next element in priority queue (the one following elementIdx).
 		// Element indices obtained before this call are invalidated, because at least one element is moved.
 		sint64 remove(sint64 elementIdx);
@@ -1371,6 +1480,211 @@ namespace QPI
 		sint64 tailIndex(const id& pov, sint64 minPriority) const;
 	};
 
+	// Order book with orders of type T and total order capacity L, aggregating orders by price level.
+	// Each ID pov (point of view, for example an asset) has an own book side, in which the orders are grouped into
+	// price levels sorted by descending priority, each level holding its orders in FIFO order (price-time priority).
+	// Use the price as priority for bids and the negated price for asks, so the best level is always the first.
+	// Levels are stored in a Collection with capacity levelCapacity, so the best level is found in O(1) and a level
+	// in O(log levels). Order indices stay valid until the order is removed, level indices are invalidated by adding
+	// and removing orders.
+	template <typename T, uint64 L, uint64 levelCapacity = L>
+	struct OrderBook
+	{
+	private:
+		static_assert(L && !(L & (L - 1)),
+			"The capacity of the OrderBook must be 2^N."
+			);
+
+		// Price level, the priority and pov of the level are stored in the Collection
+		struct Level
+		{
+			sint64 quantity;
+			uint64 orderCount;
+			sint64 firstOrderIndex, lastOrderIndex;
+		};
+		Collection<Level, levelCapacity, true> _levels;
+
+		// Orders, the ones in use are linked in the FIFO queue of their level, the free ones in the free list
+		struct Order
+		{
+			T value;
+			id pov;
+			sint64 priority;
+			sint64 quantity;
+			sint64 prevOrderIndex, nextOrderIndex;
+		} _orders[L];
+		uint64 _orderOccupationFlags[(L + 63) / 64];
+		uint64 _population;
+		uint64 _usedOrderSlots; // orders with index >= _usedOrderSlots have never been used
+		uint64 _freeListHead; // index + 1 of first free order slot < _usedOrderSlots (linked by nextOrderIndex), 0 if none
+
+		// Return index of level of pov with priority, or NULL_INDEX if not found
+		sint64 _levelIndex(const id& pov, sint64 priority) const;
+
+		// Unlink order from the queue of its level and update the level, removing it if it becomes empty
+		void _unlinkOrder(sint64 orderIndex);
+
+	public:
+		// Add order with priority and quantity > 0 to the end of the queue of its level, creating the level if needed.
+		// Return index of the new order, or NULL_INDEX if the order book is full or quantity <= 0.
+		sint64 add(const id& pov, const T& value, sint64 priority, sint64 quantity);
+
+		// Return maximum number of orders that may be stored.
+		static constexpr uint64 capacity()
+		{
+			return L;
+		}
+
+		// Return maximum number of levels that may be stored (of all povs together).
+		static constexpr uint64 capacityOfLevels()
+		{
+			return levelCapacity;
+		}
+
+		// Return whether orderIndex refers to an order in the book.
+		bool isOrder(sint64 orderIndex) const;
+
+		// Return value of order (undefined if the order doesn't exist).
+		T order(sint64 orderIndex) const;
+
+		// Return pov of order (0 id if the order doesn't exist).
+		id pov(sint64 orderIndex) const;
+
+		// Return priority of order (0 if the order doesn't exist).
+		sint64 priority(sint64 orderIndex) const;
+
+		// Return remaining quantity of order (0 if the order doesn't exist).
+		sint64 quantity(sint64 orderIndex) const;
+
+		// Return index of next order of the same level (or NULL_INDEX if this is the last order of the level).
+		sint64 nextOrderIndex(sint64 orderIndex) const;
+
+		// Return overall number of orders.
+		uint64 population() const;
+
+		// Return number of levels of all povs.
+		uint64 populationOfLevels() const;
+
+		// Return number of levels of specific pov.
+		uint64 populationOfLevels(const id& pov) const;
+
+		// Change quantity of order and its level, keeping its position in the queue. The order is removed if
+		// newQuantity <= 0. Return false if the order doesn't exist.
+		bool setQuantity(sint64 orderIndex, sint64 newQuantity);
+
+		// Replace value of existing order, do nothing otherwise.
+		void replace(sint64 orderIndex, const T& newValue);
+
+		// Remove order. Returns index of the next order of the same level (or NULL_INDEX if it was the last one).
+		sint64 remove(sint64 orderIndex);
+
+		// Return level index of best level (the one with highest priority) of pov, or NULL_INDEX if pov has no orders.
+		sint64 bestLevelIndex(const id& pov) const;
+
+		// Return level index of level of pov with given priority, or NULL_INDEX if there is no such level.
+		sint64 levelIndex(const id& pov, sint64 priority) const;
+
+		// Return level index of next level of the same pov with lower priority (or NULL_INDEX if this is the last level).
+		sint64 nextLevelIndex(sint64 levelIndex) const;
+
+		// Return priority of level.
+		sint64 levelPriority(sint64 levelIndex) const;
+
+		// Return total quantity of orders in level.
+		sint64 levelQuantity(sint64 levelIndex) const;
+
+		// Return number of orders in level.
+		uint64 levelOrderCount(sint64 levelIndex) const;
+
+		// Return index of first (oldest) order in level.
+		sint64 firstOrderIndex(sint64 levelIndex) const;
+
+		// Reinitialize as empty order book.
+		void reset();
+	};
+
+	// Set of keys with weights, for example participants of a lottery with their number of tickets. Each key is stored
+	// once with its accumulated weight, so the number of distinct keys is the population. Weights are kept in a
+	// Fenwick tree over the slots of the underlying HashMap, so adding weight and weighted random selection run in
+	// O(log L), with the key lookup of HashMap. Element indices are invalidated by cleanup().
+	template <typename KeyT, uint64 L, typename HashFunc = HashFunction<KeyT>>
+	struct WeightedSet
+	{
+	private:
+		static_assert(L && !(L & (L - 1)),
+			"The capacity of the WeightedSet must be 2^N."
+			);
+
+		HashMap<KeyT, uint64, L, HashFunc> _weights;
+		uint64 _tree[L]; // Fenwick tree of weights by element index (node i covers the range ending with element i)
+		uint64 _totalWeight;
+		uint64 _removalCounter; // keys removed since last cleanup
+
+		// Add delta (may wrap around to subtract) to weight of element in tree
+		void _addToTree(sint64 elementIndex, uint64 delta);
+
+		// Rebuild tree from weights in O(L) after elements have been moved
+		void _rebuildTree();
+
+	public:
+		// Add weight > 0 to key, inserting the key if it isn't contained yet. Return elementIndex of the key, or
+		// NULL_INDEX if the set is full, weight is 0, or the total weight would overflow.
+		sint64 add(const KeyT& key, uint64 weight);
+
+		// Return maximum number of keys that may be stored.
+		static constexpr uint64 capacity()
+		{
+			return L;
+		}
+
+		// Return number of distinct keys.
+		uint64 population() const;
+
+		// Return sum of weights of all keys.
+		uint64 totalWeight() const;
+
+		// Return if key is contained.
+		bool contains(const KeyT& key) const;
+
+		// Return weight of key (0 if it isn't contained).
+		uint64 weight(const KeyT& key) const;
+
+		// Return elementIndex of key (or NULL_INDEX if it isn't contained).
+		sint64 getElementIndex(const KeyT& key) const;
+
+		// Return if slot at elementIndex is empty (not occupied by a key). If false, key() and weightAt() are valid.
+		bool isEmptySlot(sint64 elementIndex) const;
+
+		// Return elementIndex of next key, skipping empty slots (or NULL_INDEX if there is none). Pass NULL_INDEX to
+		// get the first key.
+		sint64 nextElementIndex(sint64 elementIndex) const;
+
+		// Return key at elementIndex. Invalid if isEmptySlot(elementIndex).
+		const KeyT& key(sint64 elementIndex) const;
+
+		// Return weight of key at elementIndex. Invalid if isEmptySlot(elementIndex).
+		uint64 weightAt(sint64 elementIndex) const;
+
+		// Select a key with probability weight / totalWeight() using a uniformly distributed random value, such as a
+		// part of the output of K12() or the Random contract. Return elementIndex of the key (or NULL_INDEX if empty).
+		sint64 sample(uint64 random) const;
+
+		// Subtract weight from key, removing the key if its weight reaches 0. Return remaining weight of the key.
+		uint64 removeWeight(const KeyT& key, uint64 weight);
+
+		// Remove key with all its weight. Return elementIndex it had (or NULL_INDEX if it wasn't contained).
+		sint64 removeByKey(const KeyT& key);
+
+		// Call cleanup() if it makes sense. The content of this object may be reordered, so prior indices are invalidated.
+		void cleanupIfNeeded(uint64 removalThresholdPercent = 50);
+
+		// Cleanup underlying hash map to speed up lookup after many removes. Prior indices are invalidated.
+		void cleanup();
+
+		// Reinitialize as empty set.
+		void reset();
+	};
+
 	//////////
 	// safety multiplying a and b and then clamp
 	
@@ -2350,6 +2664,22 @@ namespace QPI
 			const T& data
 		) const;
 
+		// Set digests[i] = K12(data[i]) for all i < count. Elements of up to 166 bytes are hashed several at once,
+		// which is much faster than calling K12() for each element.
+		template <typename T, uint64 N>
+		inline void K12Batch(
+			const Array<T, N>& data,
+			Array<id, N>& digests,
+			uint64 count = N
+		) const;
+
+		// Fast non-cryptographic 64-bit hash of data, the same as FastHashFunction<T>::hash(). Use it for indexing
+		// and bucketing, but not as source of randomness or as commitment, because collisions are easy to find.
+		template <typename T>
+		inline uint64 hash64(
+			const T& data
+		) const;
+
 		inline uint16 millisecond(
 		) const; // [0..999]
 
@@ -2580,6 +2910,30 @@ namespace QPI
 			sint64 amount // Energy amount to transfer, must be in [0..1'000'000'000'000'000] range
 		) const; // Returns remaining energy amount; if the value is less than 0 then the attempt has failed, in this case the absolute value equals to the insufficient amount
 
+		/**
+		* @brief Transfer energy from this qubic to many destinations at once, for example for paying out rewards.
+		* @param destinations Destinations to transfer to, destinations.get(i) receives amounts.get(i).
+		* @param amounts Energy amounts to transfer, each in [0..1'000'000'000'000'000] range, sum of all as well.
+		* @param count Number of transfers, only the first count elements of destinations and amounts are used.
+		* @return Remaining energy amount; if the value is less than 0 then the attempt has failed and no energy has
+		*         been transferred, in this case the absolute value equals to the insufficient amount.
+		*
+		* Has the same effect as calling transfer() for each destination in order, except that either all or none
+		* of the transfers are done and that all destinations are credited before the first POST_INCOMING_TRANSFER
+		* callback of a destination contract runs. The callbacks then run in input order, so a callback sees the
+		* balances after all transfers of the batch. Cheaper than single transfers, because the balance of this qubic
+		* is checked and decreased only once and the spectrum is locked only once.
+		*/
+		template <uint64 capacity>
+		inline sint64 transferMany(
+			const Array<id, capacity>& destinations,
+			const Array<sint64, capacity>& amounts,
+			uint64 count
+		) const
+		{
+			return __transferMany(&destinations.get(0), &amounts.get(0), (count < capacity) ? count : capacity);
+		}
+
 		inline sint64 transferShareOwnershipAndPossession(
 			uint64 assetName,
 			const id& issuer,
@@ -2635,6 +2989,9 @@ namespace QPI
 			uint8 transferType // the type of transfer
 		) const; // Returns remaining energy amount; if the value is less than 0 then the attempt has failed, in this case the absolute value equals to the insufficient amount
 
+		// Internal version of transferMany() working on plain arrays of count elements.
+		inline sint64 __transferMany(const id* destinations, const sint64* amounts, uint64 count) const;
+
 	protected:
 		// Construction is done in core, not allowed in contracts
 		QpiContextProcedureCall(unsigned int contractIndex, const m256i& originator, long long invocationReward, unsigned char entryPoint) : QpiContextFunctionCall(contractIndex, originator, invocationReward, entryPoint) {}
@@ -2747,6 +3104,8 @@ namespace QPI
 		static void __acceptOracleUnknownReply(const QpiContextProcedureCall&, void*, void*) {}
 		enum { __expandEmpty = 1 };
 		static void __expand(const QpiContextProcedureCall& qpi, void*, void*) {}
+		enum { __tickHooksAccessOnlyOwnState = 0 };
+		enum { __zeroInitLocals = 1 };
 	};
 
 	// Internal macro for defining the system procedure macros
@@ -2760,7 +3119,7 @@ namespace QPI
 		 public: \
 			enum { FuncName##Empty = 0, FuncName##LocalsSize = sizeof(CapLetterName##_locals) }; \
 			static_assert(sizeof(CapLetterName##_locals) <= MAX_SIZE_OF_CONTRACT_LOCALS, #CapLetterName "_locals size too large"); \
-			inline static void FuncName(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, InputType& input, OutputType& output, CapLetterName##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller; __impl_##FuncName(qpi, state, input, output, locals); } \
+			inline static void FuncName(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, InputType& input, OutputType& output, CapLetterName##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller(&locals); __impl_##FuncName(qpi, state, input, output, locals); } \
 			static void __impl_##FuncName(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, InputType& input, OutputType& output, CapLetterName##_locals& locals)
 
 	// Define contract system procedure called to initialize contract state after IPO
@@ -2793,6 +3152,23 @@ namespace QPI
 	// Define contract system procedure called at end of each tick, provides zeroed instance of BEGIN_TICK_locals struct
 	#define END_TICK_WITH_LOCALS() NO_IO_SYSTEM_PROC_WITH_LOCALS(END_TICK, __endTick, NoData, NoData)
 
+	// Declare that BEGIN_TICK and END_TICK of the contract only write the contract's own state: no transfers, no asset
+	// operations, no logging, and no calls of other contracts (reading tick data, time, spectrum, and universe is fine).
+	// This allows the node to run them concurrently with the tick procedures of other contracts declaring the same.
+	// QPI calls accessing more than the own state fail in these procedures (calls of other contracts with
+	// CallErrorOwnStateOnlyTickHook).
+	#define TICK_HOOKS_ACCESS_ONLY_OWN_STATE() \
+		public: \
+			enum { __tickHooksAccessOnlyOwnState = 1 };
+
+	// Declare that the user procedures and functions of the contract (PUBLIC_PROCEDURE_WITH_LOCALS,
+	// PUBLIC_FUNCTION_WITH_LOCALS) write each member of their locals before reading it, so the node may skip zeroing the
+	// locals when they are invoked by transaction or network request. CAUTION: Reading a member before writing it
+	// then yields undefined data, which breaks consensus in procedures.
+	#define NO_ZERO_INIT_OF_LOCALS() \
+		public: \
+			enum { __zeroInitLocals = 0 };
+
 	// Define contract system procedure called before asset management rights transfer with `qpi.releaseShares(). See
 	// `doc/contracts.md` for details.
 	#define PRE_ACQUIRE_SHARES() \
@@ -2902,7 +3278,7 @@ namespace QPI
 	#define PRIVATE_FUNCTION_WITH_LOCALS(function) \
 		protected: \
 			enum { __is_function_##function = true }; \
-			inline static void function(const QPI::QpiContextFunctionCall& qpi, const CONTRACT_STATE_TYPE& state, function##_input& input, function##_output& output, function##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller; __impl_##function(qpi, state, input, output, locals); } \
+			inline static void function(const QPI::QpiContextFunctionCall& qpi, const CONTRACT_STATE_TYPE& state, function##_input& input, function##_output& output, function##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller(&locals); __impl_##function(qpi, state, input, output, locals); } \
 			static void __impl_##function(const QPI::QpiContextFunctionCall& qpi, const CONTRACT_STATE_TYPE& state, function##_input& input, function##_output& output, function##_locals& locals)
 
 	#define PRIVATE_PROCEDURE(procedure) \
@@ -2913,7 +3289,7 @@ namespace QPI
 	#define PRIVATE_PROCEDURE_WITH_LOCALS(procedure) \
 		protected: \
 			enum { __is_function_##procedure = false, __id_##procedure = (CONTRACT_INDEX << 22) | __LINE__ }; \
-			inline static void procedure(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, procedure##_input& input, procedure##_output& output, procedure##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller; __impl_##procedure(qpi, state, input, output, locals); } \
+			inline static void procedure(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, procedure##_input& input, procedure##_output& output, procedure##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller(&locals); __impl_##procedure(qpi, state, input, output, locals); } \
 			static void __impl_##procedure(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, procedure##_input& input, procedure##_output& output, procedure##_locals& locals)
 
 	#define PUBLIC_FUNCTION(function) \
@@ -2924,7 +3300,7 @@ namespace QPI
 	#define PUBLIC_FUNCTION_WITH_LOCALS(function) \
 		public: \
 			enum { __is_function_##function = true }; \
-			inline static void function(const QPI::QpiContextFunctionCall& qpi, const CONTRACT_STATE_TYPE& state, function##_input& input, function##_output& output, function##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller; __impl_##function(qpi, state, input, output, locals); } \
+			inline static void function(const QPI::QpiContextFunctionCall& qpi, const CONTRACT_STATE_TYPE& state, function##_input& input, function##_output& output, function##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller(&locals); __impl_##function(qpi, state, input, output, locals); } \
 			static void __impl_##function(const QPI::QpiContextFunctionCall& qpi, const CONTRACT_STATE_TYPE& state, function##_input& input, function##_output& output, function##_locals& locals)
 
 	#define PUBLIC_PROCEDURE(procedure) \
@@ -2935,7 +3311,7 @@ namespace QPI
 	#define PUBLIC_PROCEDURE_WITH_LOCALS(procedure) \
 		public: \
 			enum { __is_function_##procedure = false, __id_##procedure = (CONTRACT_INDEX << 22) | __LINE__ }; \
-			inline static void procedure(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, procedure##_input& input, procedure##_output& output, procedure##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller; __impl_##procedure(qpi, state, input, output, locals); } \
+			inline static void procedure(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, procedure##_input& input, procedure##_output& output, procedure##_locals& locals) { ::__FunctionOrProcedureBeginEndGuard<(CONTRACT_INDEX << 22) | __LINE__> __prologueEpilogueCaller(&locals); __impl_##procedure(qpi, state, input, output, locals); } \
 			static void __impl_##procedure(const QPI::QpiContextProcedureCall& qpi, CONTRACT_STATE_TYPE& state, procedure##_input& input, procedure##_output& output, procedure##_locals& locals)
 
 	#define REGISTER_USER_FUNCTIONS_AND_PROCEDURES() \
@@ -3050,6 +3426,9 @@ namespace QPI
 	* and input.queryID is -1 (invalid).
 	* Other errors that may happen with valid input.queryID are input.status == ORACLE_QUERY_STATUS_TIMEOUT and
 	* input.status == ORACLE_QUERY_STATUS_UNRESOLVABLE.
+	*
+	* If an identical query (same oracle interface and query data) is pending or has succeeded within the last few
+	* ticks, the query shares its reply and status. Thus, the notification may come early, in the tick of the call.
 	*/
 	#define QUERY_ORACLE(OracleInterface, query, userProcNotification, timeoutMillisec) qpi.__qpiQueryOracle<OracleInterface>(query, userProcNotification, __id_##userProcNotification, timeoutMillisec)
 
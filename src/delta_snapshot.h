@@ -0,0 +1,184 @@
+#pragma once
+
+#include "platform/m256.h"
+#include "platform/memory_util.h"
+#include "platform/assert.h"
+
+#include "merkle_tree.h"
+
+// Delta snapshots of an array of capacity records that has an IncrementalMerkleTree over it (spectrum, universe).
+// The array is split into blocks of recordsPerBlock records. When a full (base) snapshot is saved, the digests of
+// the subtrees of all blocks are recorded. Later snapshots only write the blocks whose subtree digest differs from
+// the recorded one (delta relative to the base, so only one delta has to be applied when loading). If the delta
+// gets too large, a new base snapshot is saved instead.
+//
+// Blocks with leafs that are flagged as changed in the tree are always treated as changed, because their subtree
+// digest isn't up to date yet. Such blocks get a zero base digest, so they are always part of the delta.
+//
+// Delta layout: DeltaHeader | block indices (unsigned int[blockCount]) | block data (blockCount * blockSizeInBytes)
+//
+// When a new base is saved, a delta with baseBeingSavedFlag is written before the base file and replaced by the real
+// delta afterwards. So if saving is interrupted between the two files, loading fails instead of silently applying the
+// old delta to the new base (or using the old base without its delta).
+template <unsigned long long capacity, typename RecordType>
+class DeltaSnapshot
+{
+public:
+    // Level of the block subtrees in the Merkle tree (block of 64 records, matching one word of change flags)
+    static constexpr unsigned int blockLevel = 6;
+    static constexpr unsigned long long recordsPerBlock = 1ULL << blockLevel;
+    static_assert(capacity >= recordsPerBlock * 8, "DeltaSnapshot requires capacity >= 512");
+    static constexpr unsigned long long blockCount = capacity / recordsPerBlock;
+    static constexpr unsigned long long blockSizeInBytes = recordsPerBlock * sizeof(RecordType);
+
+    // Save base instead of delta if more than this number of blocks changed since the last base
+    static constexpr unsigned long long maxDeltaBlockCount = blockCount / 8;
+
+    // Flag in DeltaHeader::flags marking that the base file is being saved and may not match the delta
+    static constexpr unsigned int baseBeingSavedFlag = 1;
+
+    struct DeltaHeader
+    {
+        unsigned int blockCount;
+        unsigned int flags;
+    };
+
+    static constexpr unsigned long long maxDeltaSizeInBytes = sizeof(DeltaHeader) + maxDeltaBlockCount * (sizeof(unsigned int) + blockSizeInBytes);
+
+    // Init at node startup. No base is recorded, so the next save has to be a base.
+    bool init()
+    {
+        if (!allocPoolWithErrorLog(L"DeltaSnapshot::baseBlockDigests", blockCount * sizeof(m256i), (void**)&baseBlockDigests, __LINE__))
+        {
+            return false;
+        }
+        reset();
+        return true;
+    }
+
+    // Cleanup at node shutdown.
+    void deinit()
+    {
+        if (baseBlockDigests)
+        {
+            freePool(baseBlockDigests);
+            baseBlockDigests = nullptr;
+        }
+        baseEpoch = 0;
+    }
+
+    // Forget base, for example if the snapshot directory changed. The next save has to be a base.
+    void reset()
+    {
+        baseEpoch = 0;
+    }
+
+    // Check if a base snapshot of given epoch has been recorded with setBase().
+    bool hasBase(unsigned short epoch) const
+    {
+        return baseEpoch && baseEpoch == epoch;
+    }
+
+    // Record block digests after saving a base snapshot of the records in given epoch (epoch > 0).
+    void setBase(const IncrementalMerkleTree<capacity>& tree, unsigned short epoch)
+    {
+        ASSERT(baseBlockDigests && epoch);
+        for (unsigned long long blockIndex = 0; blockIndex < blockCount; blockIndex++)
+        {
+            baseBlockDigests[blockIndex] = tree.nodeDigest(blockLevel, blockIndex);
+        }
+        for (unsigned long long i = tree.findNextChangedLeaf(0); i < capacity; i = tree.findNextChangedLeaf((i | (recordsPerBlock - 1)) + 1))
+        {
+            baseBlockDigests[i >> blockLevel] = m256i::zero();
+        }
+        baseEpoch = epoch;
+    }
+
+    // Write delta of all blocks that changed since the base to buffer (of maxDeltaSizeInBytes). Returns size of
+    // delta in bytes or 0 if the delta would be too large and a new base needs to be saved instead.
+    unsigned long long buildDelta(const IncrementalMerkleTree<capacity>& tree, const RecordType* records, unsigned char* buffer) const
+    {
+        ASSERT(baseBlockDigests && baseEpoch);
+        DeltaHeader* header = (DeltaHeader*)buffer;
+        unsigned int* blockIndices = (unsigned int*)(buffer + sizeof(DeltaHeader));
+        unsigned int changedBlockCount = 0;
+        unsigned long long nextChangedLeaf = tree.findNextChangedLeaf(0);
+        for (unsigned long long blockIndex = 0; blockIndex < blockCount; blockIndex++)
+        {
+            // block is changed if its digest differs or if it has leafs which aren't hashed yet
+            if (nextChangedLeaf < (blockIndex << blockLevel))
+            {
+                nextChangedLeaf = tree.findNextChangedLeaf(blockIndex << blockLevel);
+            }
+            if (tree.nodeDigest(blockLevel, blockIndex) != baseBlockDigests[blockIndex] || isZero(baseBlockDigests[blockIndex])
+                || (nextChangedLeaf >> blockLevel) == blockIndex)
+            {
+                if (changedBlockCount >= maxDeltaBlockCount)
+                {
+                    return 0;
+                }
+                blockIndices[changedBlockCount++] = (unsigned int)blockIndex;
+            }
+        }
+
+        unsigned char* blockData = (unsigned char*)(blockIndices + changedBlockCount);
+        for (unsigned int i = 0; i < changedBlockCount; i++)
+        {
+            copyMem(blockData + i * blockSizeInBytes, records + (((unsigned long long)blockIndices[i]) << blockLevel), blockSizeInBytes);
+        }
+        header->blockCount = changedBlockCount;
+        header->flags = 0;
+        return deltaSizeInBytes(changedBlockCount);
+    }
+
+    // Write delta marking that the base file is being saved to buffer (of at least sizeof(DeltaHeader)). Has to be saved
+    // as delta file before the base file. Returns size of delta in bytes.
+    static unsigned long long buildBaseBeingSavedMarker(unsigned char* buffer)
+    {
+        DeltaHeader* header = (DeltaHeader*)buffer;
+        header->blockCount = 0;
+        header->flags = baseBeingSavedFlag;
+        return sizeof(DeltaHeader);
+    }
+
+    // Apply delta of given size to records loaded from the base snapshot. Returns false if delta is invalid.
+    static bool applyDelta(const unsigned char* buffer, unsigned long long size, RecordType* records)
+    {
+        if (size < sizeof(DeltaHeader))
+        {
+            return false;
+        }
+        const DeltaHeader* header = (const DeltaHeader*)buffer;
+        if (header->flags || header->blockCount > maxDeltaBlockCount || size != deltaSizeInBytes(header->blockCount))
+        {
+            return false;
+        }
+        const unsigned int* blockIndices = (const unsigned int*)(buffer + sizeof(DeltaHeader));
+        const unsigned char* blockData = (const unsigned char*)(blockIndices + header->blockCount);
+        for (unsigned int i = 0; i < header->blockCount; i++)
+        {
+            if (blockIndices[i] >= blockCount)
+            {
+                return false;
+            }
+        }
+        for (unsigned int i = 0; i < header->blockCount; i++)
+        {
+            copyMem(records + (((unsigned long long)blockIndices[i]) << blockLevel), blockData + i * blockSizeInBytes, blockSizeInBytes);
+        }
+        return true;
+    }
+
+    // Return size of delta with given number of blocks
+    static constexpr unsigned long long deltaSizeInBytes(unsigned long long changedBlockCount)
+    {
+        return sizeof(DeltaHeader) + changedBlockCount * (sizeof(unsigned int) + blockSizeInBytes);
+    }
+
+protected:
+    // Digests of the block subtrees at the time of the base snapshot (zero if unknown)
+    m256i* baseBlockDigests = nullptr;
+
+    // Epoch of base snapshot or 0 if there is no base
+    unsigned short baseEpoch = 0;
+};
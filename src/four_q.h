@@ -1319,16 +1319,19 @@ static void ecc_precomp_double(point_extproj_t P, point_extproj_precomp_t* Table
     R1_to_R2(Q, Table[3]);                  // Converting from (X,Y,Z,Ta,Tb) to (X+Y,Y-X,2Z,2dT)
 }
 
-static bool ecc_mul_double(unsigned long long* k, unsigned long long* l, point_t Q)
-{ // Double scalar multiplication R = k*G + l*Q, where the G is the generator
-  // Uses DOUBLE_SCALAR_TABLE, which contains multiples of G, Phi(G), Psi(G) and Phi(Psi(G))
-  // The function uses wNAF with interleaving.
-    char digits_k1[65], digits_k2[65], digits_k3[65], digits_k4[65];
-    char digits_l1[65], digits_l2[65], digits_l3[65], digits_l4[65];
-    point_precomp_t V;
-    point_extproj_t Q1, Q2, Q3, Q4, T;
-    point_extproj_precomp_t U, Q_table1[4], Q_table2[4], Q_table3[4], Q_table4[4];
-    unsigned long long k_scalars[4], l_scalars[4];
+typedef struct
+{ // Precomputation tables of a point Q and its endomorphisms Phi(Q), Psi(Q), Psi(Phi(Q)) used by ecc_mul_double_precomp()
+    point_extproj_precomp_t table1[4];
+    point_extproj_precomp_t table2[4];
+    point_extproj_precomp_t table3[4];
+    point_extproj_precomp_t table4[4];
+} point_double_precomp;
+typedef point_double_precomp point_double_precomp_t[1];
+
+static bool ecc_precomp_mul_double(point_t Q, point_double_precomp_t QTables)
+{ // Generation of the precomputation tables of point Q used by ecc_mul_double_precomp()
+  // Output: false if Q is not on the curve, true otherwise
+    point_extproj_t Q1, Q2, Q3, Q4;
 
     point_setup(Q, Q1);                                             // Convert to representation (X,Y,1,Ta,Tb)
 
@@ -1357,6 +1360,30 @@ static bool ecc_mul_double(unsigned long long* k, unsigned long long* l, point_t
     *((__m256i*) & Q4->tb) = *((__m256i*) & Q2->tb);
     ecc_psi(Q4);
 
+    ecc_precomp_double(Q1, QTables->table1);
+    ecc_precomp_double(Q2, QTables->table2);
+    ecc_precomp_double(Q3, QTables->table3);
+    ecc_precomp_double(Q4, QTables->table4);
+
+    return true;
+}
+
+static void ecc_mul_double_precomp(unsigned long long* k, unsigned long long* l, point_double_precomp_t QTables, point_t Q)
+{ // Double scalar multiplication R = k*G + l*Q, where the G is the generator and QTables are the precomputation tables
+  // of Q generated by ecc_precomp_mul_double()
+  // Uses DOUBLE_SCALAR_TABLE, which contains multiples of G, Phi(G), Psi(G) and Phi(Psi(G))
+  // The function uses wNAF with interleaving.
+    char digits_k1[65], digits_k2[65], digits_k3[65], digits_k4[65];
+    char digits_l1[65], digits_l2[65], digits_l3[65], digits_l4[65];
+    point_precomp_t V;
+    point_extproj_t T;
+    point_extproj_precomp_t U;
+    point_extproj_precomp_t* Q_table1 = QTables->table1;
+    point_extproj_precomp_t* Q_table2 = QTables->table2;
+    point_extproj_precomp_t* Q_table3 = QTables->table3;
+    point_extproj_precomp_t* Q_table4 = QTables->table4;
+    unsigned long long k_scalars[4], l_scalars[4];
+
     decompose((unsigned long long*)k, k_scalars);                   // Scalar decomposition
     decompose((unsigned long long*)l, l_scalars);
     wNAF_recode(k_scalars[0], 8, digits_k1);                        // Scalar recoding
@@ -1367,10 +1394,6 @@ static bool ecc_mul_double(unsigned long long* k, unsigned long long* l, point_t
     wNAF_recode(l_scalars[1], 4, digits_l2);
     wNAF_recode(l_scalars[2], 4, digits_l3);
     wNAF_recode(l_scalars[3], 4, digits_l4);
-    ecc_precomp_double(Q1, Q_table1);
-    ecc_precomp_double(Q2, Q_table2);
-    ecc_precomp_double(Q3, Q_table3);
-    ecc_precomp_double(Q4, Q_table4);
 
     T->x[0][0] = 0; T->x[0][1] = 0; T->x[1][0] = 0; T->x[1][1] = 0; // Initialize T as the neutral point (0:1:1)
     T->y[0][0] = 1; T->y[0][1] = 0; T->y[1][0] = 0; T->y[1][1] = 0;
@@ -1462,6 +1485,18 @@ static bool ecc_mul_double(unsigned long long* k, unsigned long long* l, point_t
     }
 
     eccnorm(T, Q);
+}
+
+static bool ecc_mul_double(unsigned long long* k, unsigned long long* l, point_t Q)
+{ // Double scalar multiplication R = k*G + l*Q, where the G is the generator
+  // Output: false if Q is not on the curve, true otherwise
+    point_double_precomp_t QTables;
+
+    if (!ecc_precomp_mul_double(Q, QTables))
+    {
+        return false;
+    }
+    ecc_mul_double_precomp(k, l, QTables, Q);
 
     return true;
 }
@@ -1774,7 +1809,8 @@ static bool getSharedKey(const unsigned char* privateKey, const unsigned char* p
     return true;
 }
 
-static void getIdentity(const unsigned char* publicKey, CHAR16* identity, bool isLowerCase)
+// Write 60 characters of identity (and terminating 0) from publicKey and the first 3 bytes of its K12 digest
+static void getIdentityWithChecksum(const unsigned char* publicKey, unsigned int identityBytesChecksum, CHAR16* identity, bool isLowerCase)
 {
     for (int i = 0; i < 4; i++)
     {
@@ -1785,8 +1821,6 @@ static void getIdentity(const unsigned char* publicKey, CHAR16* identity, bool i
             publicKeyFragment /= 26;
         }
     }
-    unsigned int identityBytesChecksum;
-    KangarooTwelve(publicKey, 32, (unsigned char*)&identityBytesChecksum, 3);
     identityBytesChecksum &= 0x3FFFF;
     for (int i = 0; i < 4; i++)
     {
@@ -1796,6 +1830,46 @@ static void getIdentity(const unsigned char* publicKey, CHAR16* identity, bool i
     identity[60] = 0;
 }
 
+static void getIdentity(const unsigned char* publicKey, CHAR16* identity, bool isLowerCase)
+{
+    unsigned int identityBytesChecksum;
+    KangarooTwelve(publicKey, 32, (unsigned char*)&identityBytesChecksum, 3);
+    getIdentityWithChecksum(publicKey, identityBytesChecksum, identity, isLowerCase);
+}
+
+// Batch variant of getIdentity() for count public keys, writing 61 characters (including terminating 0) per key to
+// identities. The checksums of K12_64TO32_LANES keys are hashed at once with the multi-lane K12 kernel.
+static void getIdentities(const m256i* publicKeys, CHAR16* identities, unsigned int count, bool isLowerCase)
+{
+    const void* inputs[K12_64TO32_LANES];
+    unsigned int inputByteLens[K12_64TO32_LANES];
+    void* outputs[K12_64TO32_LANES];
+    unsigned int checksums[K12_64TO32_LANES];
+    for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+    {
+        inputByteLens[k] = 32;
+        outputs[k] = &checksums[k];
+    }
+
+    unsigned int i = 0;
+    for (; i + K12_64TO32_LANES <= count; i += K12_64TO32_LANES)
+    {
+        for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+        {
+            inputs[k] = &publicKeys[i + k];
+        }
+        KangarooTwelveShortLanes(inputs, inputByteLens, outputs, 3);
+        for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+        {
+            getIdentityWithChecksum(publicKeys[i + k].m256i_u8, checksums[k], identities + (i + k) * 61, isLowerCase);
+        }
+    }
+    for (; i < count; i++)
+    {
+        getIdentity(publicKeys[i].m256i_u8, identities + i * 61, isLowerCase);
+    }
+}
+
 static void sign(const unsigned char* subseed, const unsigned char* publicKey, const unsigned char* messageDigest, unsigned char* signature)
 { // SchnorrQ signature generation
   // It produces the signature signature of a message messageDigest of size 32 in bytes
@@ -1835,29 +1909,42 @@ static void sign(const unsigned char* subseed, const unsigned char* publicKey, c
     }
 }
 
-// same as sign() but here k is completely random instead of deriving from subseed
-static void signWithRandomK(const unsigned char* subseed, const unsigned char* publicKey, const unsigned char* messageDigest, unsigned char* signature)
+static void getSigningKey(const unsigned char* privateKey, unsigned char* signingKey)
+{ // Precompute the Montgomery representation of the private scalar, which signWithSigningKeyAndRandomK() needs
+  // Input:  32-byte privateKey (see getPrivateKey())
+  // Output: 32-byte signingKey
+    Montgomery_multiply_mod_order((const unsigned long long*)privateKey, Montgomery_Rprime, (unsigned long long*)signingKey);
+}
+
+// same as signWithRandomK() but with signingKey precomputed by getSigningKey()
+// New random nonces are drawn until the first 4 bytes of the signature, interpreted as big-endian number, are less or equal
+// maxSignatureScore. The rest of the signature is only computed for the accepted nonce, so each rejected nonce just costs the
+// fixed-base scalar multiplication.
+static void signWithSigningKeyAndRandomK(const unsigned char* signingKey, const unsigned char* publicKey, const unsigned char* messageDigest, unsigned char* signature, unsigned int maxSignatureScore = 0xffffffff)
 { // SchnorrQ signature generation
   // It produces the signature signature of a message messageDigest of size 32 in bytes
-  // Inputs: 32-byte subseed, 32-byte publicKey, and messageDigest of size 32 in bytes
+  // Inputs: 32-byte signingKey, 32-byte publicKey, and messageDigest of size 32 in bytes
   // Output: 64-byte signature 
     point_t R;
-    unsigned char k[64], h[64], temp[32 + 64];
+    unsigned char h[64], temp[32 + 64];
     unsigned long long r[8];
-    KangarooTwelve((unsigned char*)subseed, 32, k, 32);
-    for (int i = 32; i < 64; i += 8)
-    {
-        _rdrand64_step((unsigned long long*)(k + i));
-    }
+
     // NOTE: the nonce consists 2 parts: random K and message digest
     // This nonce is supposed to be random to avoid key leakage.
-    *((__m256i*)(temp + 32)) = *((__m256i*)(k + 32));
     *((__m256i*)(temp + 64)) = *((__m256i*)messageDigest);
+    do
+    {
+        for (int i = 32; i < 64; i += 8)
+        {
+            _rdrand64_step((unsigned long long*)(temp + i));
+        }
 
-    KangarooTwelve(temp + 32, 32 + 32, (unsigned char*)r, 64);
+        KangarooTwelve(temp + 32, 32 + 32, (unsigned char*)r, 64);
+
+        ecc_mul_fixed(r, R);
+        encode(R, signature); // Encode lowest 32 bytes of signature
+    } while ((((unsigned int)signature[0] << 24) | ((unsigned int)signature[1] << 16) | ((unsigned int)signature[2] << 8) | signature[3]) > maxSignatureScore);
 
-    ecc_mul_fixed(r, R);
-    encode(R, signature); // Encode lowest 32 bytes of signature
     *((__m256i*)temp) = *((__m256i*)signature);
     *((__m256i*)(temp + 32)) = *((__m256i*)publicKey);
 
@@ -1866,9 +1953,8 @@ static void signWithRandomK(const unsigned char* subseed, const unsigned char* p
     Montgomery_multiply_mod_order(r, ONE, r);
     Montgomery_multiply_mod_order((unsigned long long*)h, Montgomery_Rprime, (unsigned long long*)h);
     Montgomery_multiply_mod_order((unsigned long long*)h, ONE, (unsigned long long*)h);
-    Montgomery_multiply_mod_order((unsigned long long*)k, Montgomery_Rprime, (unsigned long long*)(signature + 32));
     Montgomery_multiply_mod_order((unsigned long long*)h, Montgomery_Rprime, (unsigned long long*)h);
-    Montgomery_multiply_mod_order((unsigned long long*)(signature + 32), (unsigned long long*)h, (unsigned long long*)(signature + 32));
+    Montgomery_multiply_mod_order((const unsigned long long*)signingKey, (unsigned long long*)h, (unsigned long long*)(signature + 32));
     Montgomery_multiply_mod_order((unsigned long long*)(signature + 32), ONE, (unsigned long long*)(signature + 32));
     if (_subborrow_u64(_subborrow_u64(_subborrow_u64(_subborrow_u64(0, r[0], ((unsigned long long*)signature)[4], &((unsigned long long*)signature)[4]), r[1], ((unsigned long long*)signature)[5], &((unsigned long long*)signature)[5]), r[2], ((unsigned long long*)signature)[6], &((unsigned long long*)signature)[6]), r[3], ((unsigned long long*)signature)[7], &((unsigned long long*)signature)[7]))
     {
@@ -1876,16 +1962,24 @@ static void signWithRandomK(const unsigned char* subseed, const unsigned char* p
     }
 }
 
-static bool verify(const unsigned char* publicKey, const unsigned char* messageDigest, const unsigned char* signature)
-{ // SchnorrQ signature verification
-  // It verifies the signature Signature of a message MessageDigest of size 32 in bytes
-  // Inputs: 32-byte PublicKey, 64-byte Signature, and MessageDigest of size 32 in bytes
-  // Output: TRUE (valid signature) or FALSE (invalid signature)
+// same as sign() but here k is completely random instead of deriving from subseed
+static void signWithRandomK(const unsigned char* subseed, const unsigned char* publicKey, const unsigned char* messageDigest, unsigned char* signature)
+{
+    unsigned char privateKey[32], signingKey[32];
+    KangarooTwelve((unsigned char*)subseed, 32, privateKey, 32);
+    getSigningKey(privateKey, signingKey);
+    signWithSigningKeyAndRandomK(signingKey, publicKey, messageDigest, signature);
+}
+
+static bool getVerificationKey(const unsigned char* publicKey, point_double_precomp_t verificationKey)
+{ // Decode the public key and compute the precomputation tables needed for SchnorrQ signature verification, so
+  // verifying several signatures of the same public key with verifyWithKey() only pays for this once
+  // Inputs: 32-byte PublicKey
+  // Output: TRUE (valid public key) or FALSE (invalid public key)
     point_t A;
-    unsigned char temp[32 + 64], h[64];
 
-    if ((publicKey[15] & 0x80) || (signature[15] & 0x80) || (signature[62] & 0xC0) || signature[63])
-    {  // Are bit128(PublicKey) = bit128(Signature) = 0 and Signature+32 < 2^246?
+    if (publicKey[15] & 0x80)
+    {  // Is bit128(PublicKey) = 0?
         return false;
     }
 
@@ -1894,17 +1988,49 @@ static bool verify(const unsigned char* publicKey, const unsigned char* messageD
         return false;
     }
 
+    return ecc_precomp_mul_double(A, verificationKey);
+}
+
+static bool verifyWithKey(const unsigned char* publicKey, point_double_precomp_t verificationKey, const unsigned char* messageDigest, const unsigned char* signature)
+{ // SchnorrQ signature verification with the verification key obtained from getVerificationKey(publicKey)
+  // Inputs: 32-byte PublicKey, its verification key, 64-byte Signature, and MessageDigest of size 32 in bytes
+  // Output: TRUE (valid signature) or FALSE (invalid signature)
+    point_t A;
+    unsigned char temp[32 + 64], h[64];
+
+    if ((signature[15] & 0x80) || (signature[62] & 0xC0) || signature[63])
+    {  // Are bit128(Signature) = 0 and Signature+32 < 2^246?
+        return false;
+    }
+
     *((__m256i*)temp) = *((__m256i*)signature);
     *((__m256i*)(temp + 32)) = *((__m256i*)publicKey);
     *((__m256i*)(temp + 64)) = *((__m256i*)messageDigest);
 
     KangarooTwelve(temp, 32 + 64, h, 64);
 
-    if (!ecc_mul_double((unsigned long long*)(signature + 32), (unsigned long long*)h, A))
+    ecc_mul_double_precomp((unsigned long long*)(signature + 32), (unsigned long long*)h, verificationKey, A);
+
+    encode(A, (unsigned char*)A);
+    return *((__m256i*)A) == *((__m256i*)signature);
+}
+
+static bool verify(const unsigned char* publicKey, const unsigned char* messageDigest, const unsigned char* signature)
+{ // SchnorrQ signature verification
+  // It verifies the signature Signature of a message MessageDigest of size 32 in bytes
+  // Inputs: 32-byte PublicKey, 64-byte Signature, and MessageDigest of size 32 in bytes
+  // Output: TRUE (valid signature) or FALSE (invalid signature)
+    point_double_precomp_t verificationKey;
+
+    if ((signature[15] & 0x80) || (signature[62] & 0xC0) || signature[63])
+    {  // Are bit128(Signature) = 0 and Signature+32 < 2^246? (checked before the expensive key decoding)
+        return false;
+    }
+
+    if (!getVerificationKey(publicKey, verificationKey))
     {
         return false;
     }
 
-    encode(A, (unsigned char*)A);
-    return *((__m256i*)A) == *((__m256i*)signature);
+    return verifyWithKey(publicKey, verificationKey, messageDigest, signature);
 }
@@ -1391,7 +1391,28 @@ static void KangarooTwelve_F_Absorb(KangarooTwelve_F* instance, const unsigned c
     }
 }
 
-static void KangarooTwelve(const unsigned char* input, unsigned int inputByteLen, unsigned char* output, unsigned int outputByteLen)
+// Number of full leaf chunks of K12 tree mode following the first chunk, which can be hashed independently with
+// KangarooTwelveLeaf()
+static inline unsigned int KangarooTwelveFullLeafCount(unsigned int inputByteLen)
+{
+    return (inputByteLen > K12_chunkSize) ? (inputByteLen - K12_chunkSize) / K12_chunkSize : 0;
+}
+
+// Compute chaining value (K12_capacityInBytes bytes) of a full leaf chunk (K12_chunkSize bytes) of K12 tree mode
+static void KangarooTwelveLeaf(const unsigned char* chunk, unsigned char* chainingValue)
+{
+    KangarooTwelve_F queueNode;
+    setMem(&queueNode, sizeof(KangarooTwelve_F), 0);
+    KangarooTwelve_F_Absorb(&queueNode, chunk, K12_chunkSize);
+    queueNode.state[queueNode.byteIOIndex] ^= K12_suffixLeaf;
+    queueNode.state[K12_rateInBytes - 1] ^= 0x80;
+    KeccakP1600_Permute_12rounds(queueNode.state);
+    copyMem(chainingValue, queueNode.state, K12_capacityInBytes);
+}
+
+// If leafChainingValues is passed, it must contain the KangarooTwelveLeaf() results of the
+// KangarooTwelveFullLeafCount(inputByteLen) full chunks following the first chunk (for example computed in parallel).
+static void KangarooTwelve(const unsigned char* input, unsigned int inputByteLen, unsigned char* output, unsigned int outputByteLen, const unsigned char* leafChainingValues = nullptr)
 {
     KangarooTwelve_F queueNode;
     KangarooTwelve_F finalNode;
@@ -1420,6 +1441,15 @@ static void KangarooTwelve(const unsigned char* input, unsigned int inputByteLen
         while (inputByteLen > 0)
         {
             const unsigned int len = K12_chunkSize ^ ((inputByteLen ^ K12_chunkSize) & -(inputByteLen < K12_chunkSize));
+            if (len == K12_chunkSize && leafChainingValues)
+            {
+                ++blockNumber;
+                KangarooTwelve_F_Absorb(&finalNode, leafChainingValues, K12_capacityInBytes);
+                leafChainingValues += K12_capacityInBytes;
+                input += len;
+                inputByteLen -= len;
+                continue;
+            }
             setMem(&queueNode, sizeof(KangarooTwelve_F), 0);
             KangarooTwelve_F_Absorb(&queueNode, input, len);
             input += len;
@@ -1529,9 +1559,9 @@ static void KangarooTwelve(const unsigned char* input, unsigned int inputByteLen
     copyMem(output, finalNode.state, outputByteLen);
 }
 
-static inline void KangarooTwelve(const void* input, unsigned int inputByteLen, void* output, unsigned int outputByteLen)
+static inline void KangarooTwelve(const void* input, unsigned int inputByteLen, void* output, unsigned int outputByteLen, const void* leafChainingValues = nullptr)
 {
-    KangarooTwelve((const unsigned char*)input, inputByteLen, (unsigned char*)output, outputByteLen);
+    KangarooTwelve((const unsigned char*)input, inputByteLen, (unsigned char*)output, outputByteLen, (const unsigned char*)leafChainingValues);
 }
 
 static void KangarooTwelve64To32(const unsigned char* input, unsigned char* output)
@@ -2495,6 +2525,434 @@ static void KangarooTwelve64To32(const void* input, void* output)
     KangarooTwelve64To32((const unsigned char*)input, (unsigned char*)output);
 }
 
+// Multi-lane KangarooTwelve64To32: hashes K12_64TO32_LANES independent 64-byte inputs at once by interleaving
+// the Keccak-p[1600,12] states of the inputs in the 64-bit elements of SIMD registers (state lane j of input k
+// is element k of vector j). This gives the same result as K12_64TO32_LANES calls of KangarooTwelve64To32().
+#if defined (__AVX512F__)
+#define K12_64TO32_LANES 8
+typedef __m512i K12LanesVector;
+#define K12LanesXor(a, b) _mm512_xor_si512(a, b)
+#define K12LanesAndNot(a, b) _mm512_andnot_si512(a, b)
+#define K12LanesRol(a, offset) _mm512_rol_epi64(a, offset)
+#define K12LanesSet1(a) _mm512_set1_epi64(a)
+#else
+#define K12_64TO32_LANES 4
+typedef __m256i K12LanesVector;
+#define K12LanesXor(a, b) _mm256_xor_si256(a, b)
+#define K12LanesAndNot(a, b) _mm256_andnot_si256(a, b)
+#define K12LanesRol(a, offset) _mm256_or_si256(_mm256_slli_epi64(a, offset), _mm256_srli_epi64(a, 64 - (offset)))
+#define K12LanesSet1(a) _mm256_set1_epi64x(a)
+#endif
+
+// One round of Keccak-p[1600] on interleaved states A00 ... A24 (lane x + 5 * y), using B00 ... B24, C0 ... C4, D
+#define K12LanesRound(roundConstant) \
+    C0 = K12LanesXor(K12LanesXor(K12LanesXor(A00, A05), K12LanesXor(A10, A15)), A20); \
+    C1 = K12LanesXor(K12LanesXor(K12LanesXor(A01, A06), K12LanesXor(A11, A16)), A21); \
+    C2 = K12LanesXor(K12LanesXor(K12LanesXor(A02, A07), K12LanesXor(A12, A17)), A22); \
+    C3 = K12LanesXor(K12LanesXor(K12LanesXor(A03, A08), K12LanesXor(A13, A18)), A23); \
+    C4 = K12LanesXor(K12LanesXor(K12LanesXor(A04, A09), K12LanesXor(A14, A19)), A24); \
+    D = K12LanesXor(C4, K12LanesRol(C1, 1)); \
+    A00 = K12LanesXor(A00, D); A05 = K12LanesXor(A05, D); A10 = K12LanesXor(A10, D); A15 = K12LanesXor(A15, D); A20 = K12LanesXor(A20, D); \
+    D = K12LanesXor(C0, K12LanesRol(C2, 1)); \
+    A01 = K12LanesXor(A01, D); A06 = K12LanesXor(A06, D); A11 = K12LanesXor(A11, D); A16 = K12LanesXor(A16, D); A21 = K12LanesXor(A21, D); \
+    D = K12LanesXor(C1, K12LanesRol(C3, 1)); \
+    A02 = K12LanesXor(A02, D); A07 = K12LanesXor(A07, D); A12 = K12LanesXor(A12, D); A17 = K12LanesXor(A17, D); A22 = K12LanesXor(A22, D); \
+    D = K12LanesXor(C2, K12LanesRol(C4, 1)); \
+    A03 = K12LanesXor(A03, D); A08 = K12LanesXor(A08, D); A13 = K12LanesXor(A13, D); A18 = K12LanesXor(A18, D); A23 = K12LanesXor(A23, D); \
+    D = K12LanesXor(C3, K12LanesRol(C0, 1)); \
+    A04 = K12LanesXor(A04, D); A09 = K12LanesXor(A09, D); A14 = K12LanesXor(A14, D); A19 = K12LanesXor(A19, D); A24 = K12LanesXor(A24, D); \
+    B00 = A00; \
+    B16 = K12LanesRol(A05, 36); \
+    B07 = K12LanesRol(A10, 3); \
+    B23 = K12LanesRol(A15, 41); \
+    B14 = K12LanesRol(A20, 18); \
+    B10 = K12LanesRol(A01, 1); \
+    B01 = K12LanesRol(A06, 44); \
+    B17 = K12LanesRol(A11, 10); \
+    B08 = K12LanesRol(A16, 45); \
+    B24 = K12LanesRol(A21, 2); \
+    B20 = K12LanesRol(A02, 62); \
+    B11 = K12LanesRol(A07, 6); \
+    B02 = K12LanesRol(A12, 43); \
+    B18 = K12LanesRol(A17, 15); \
+    B09 = K12LanesRol(A22, 61); \
+    B05 = K12LanesRol(A03, 28); \
+    B21 = K12LanesRol(A08, 55); \
+    B12 = K12LanesRol(A13, 25); \
+    B03 = K12LanesRol(A18, 21); \
+    B19 = K12LanesRol(A23, 56); \
+    B15 = K12LanesRol(A04, 27); \
+    B06 = K12LanesRol(A09, 20); \
+    B22 = K12LanesRol(A14, 39); \
+    B13 = K12LanesRol(A19, 8); \
+    B04 = K12LanesRol(A24, 14); \
+    A00 = K12LanesXor(B00, K12LanesAndNot(B01, B02)); \
+    A01 = K12LanesXor(B01, K12LanesAndNot(B02, B03)); \
+    A02 = K12LanesXor(B02, K12LanesAndNot(B03, B04)); \
+    A03 = K12LanesXor(B03, K12LanesAndNot(B04, B00)); \
+    A04 = K12LanesXor(B04, K12LanesAndNot(B00, B01)); \
+    A05 = K12LanesXor(B05, K12LanesAndNot(B06, B07)); \
+    A06 = K12LanesXor(B06, K12LanesAndNot(B07, B08)); \
+    A07 = K12LanesXor(B07, K12LanesAndNot(B08, B09)); \
+    A08 = K12LanesXor(B08, K12LanesAndNot(B09, B05)); \
+    A09 = K12LanesXor(B09, K12LanesAndNot(B05, B06)); \
+    A10 = K12LanesXor(B10, K12LanesAndNot(B11, B12)); \
+    A11 = K12LanesXor(B11, K12LanesAndNot(B12, B13)); \
+    A12 = K12LanesXor(B12, K12LanesAndNot(B13, B14)); \
+    A13 = K12LanesXor(B13, K12LanesAndNot(B14, B10)); \
+    A14 = K12LanesXor(B14, K12LanesAndNot(B10, B11)); \
+    A15 = K12LanesXor(B15, K12LanesAndNot(B16, B17)); \
+    A16 = K12LanesXor(B16, K12LanesAndNot(B17, B18)); \
+    A17 = K12LanesXor(B17, K12LanesAndNot(B18, B19)); \
+    A18 = K12LanesXor(B18, K12LanesAndNot(B19, B15)); \
+    A19 = K12LanesXor(B19, K12LanesAndNot(B15, B16)); \
+    A20 = K12LanesXor(B20, K12LanesAndNot(B21, B22)); \
+    A21 = K12LanesXor(B21, K12LanesAndNot(B22, B23)); \
+    A22 = K12LanesXor(B22, K12LanesAndNot(B23, B24)); \
+    A23 = K12LanesXor(B23, K12LanesAndNot(B24, B20)); \
+    A24 = K12LanesXor(B24, K12LanesAndNot(B20, B21)); \
+    A00 = K12LanesXor(A00, K12LanesSet1(roundConstant))
+
+static void KangarooTwelve64To32Lanes(const void* const* inputs, void* const* outputs)
+{
+    K12LanesVector A00, A01, A02, A03, A04, A05, A06, A07, A08, A09, A10, A11, A12, A13, A14, A15, A16, A17, A18, A19, A20, A21, A22, A23, A24;
+    K12LanesVector B00, B01, B02, B03, B04, B05, B06, B07, B08, B09, B10, B11, B12, B13, B14, B15, B16, B17, B18, B19, B20, B21, B22, B23, B24;
+    K12LanesVector C0, C1, C2, C3, C4, D;
+
+    // Load 8 message lanes of all inputs. Padding: K12 suffix 0x07 after empty customization string (lane 8)
+    // and final bit of rate (lane 20).
+    alignas(64) unsigned long long transposed[K12_64TO32_LANES];
+#define K12LanesLoad(A, j) \
+    for (unsigned int k = 0; k < K12_64TO32_LANES; k++) \
+        transposed[k] = ((const unsigned long long*)inputs[k])[j]; \
+    A = *((K12LanesVector*)transposed)
+    K12LanesLoad(A00, 0);
+    K12LanesLoad(A01, 1);
+    K12LanesLoad(A02, 2);
+    K12LanesLoad(A03, 3);
+    K12LanesLoad(A04, 4);
+    K12LanesLoad(A05, 5);
+    K12LanesLoad(A06, 6);
+    K12LanesLoad(A07, 7);
+#undef K12LanesLoad
+    A08 = K12LanesSet1(0x0700);
+    A09 = A10 = A11 = A12 = A13 = A14 = A15 = A16 = A17 = A18 = A19 = K12LanesSet1(0);
+    A20 = K12LanesSet1(0x8000000000000000ULL);
+    A21 = A22 = A23 = A24 = K12LanesSet1(0);
+
+    K12LanesRound(KeccakF1600RoundConstant0);
+    K12LanesRound(KeccakF1600RoundConstant1);
+    K12LanesRound(KeccakF1600RoundConstant2);
+    K12LanesRound(KeccakF1600RoundConstant3);
+    K12LanesRound(KeccakF1600RoundConstant4);
+    K12LanesRound(KeccakF1600RoundConstant5);
+    K12LanesRound(KeccakF1600RoundConstant6);
+    K12LanesRound(KeccakF1600RoundConstant7);
+    K12LanesRound(KeccakF1600RoundConstant8);
+    K12LanesRound(KeccakF1600RoundConstant9);
+    K12LanesRound(KeccakF1600RoundConstant10);
+    K12LanesRound(0x8000000080008008ULL);
+
+    // Store first 4 state lanes (32 bytes) of each state
+#define K12LanesStore(A, j) \
+    *((K12LanesVector*)transposed) = A; \
+    for (unsigned int k = 0; k < K12_64TO32_LANES; k++) \
+        ((unsigned long long*)outputs[k])[j] = transposed[k]
+    K12LanesStore(A00, 0);
+    K12LanesStore(A01, 1);
+    K12LanesStore(A02, 2);
+    K12LanesStore(A03, 3);
+#undef K12LanesStore
+}
+
+// Hash count consecutive 64-byte inputs into count consecutive 32-byte outputs, equivalent to calling
+// KangarooTwelve64To32(input + 64 * i, output + 32 * i) for all i < count.
+static void KangarooTwelve64To32Batch(const void* input, void* output, unsigned long long count)
+{
+    const unsigned char* in = (const unsigned char*)input;
+    unsigned char* out = (unsigned char*)output;
+    const void* inputs[K12_64TO32_LANES];
+    void* outputs[K12_64TO32_LANES];
+    for (; count >= K12_64TO32_LANES; count -= K12_64TO32_LANES)
+    {
+        for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+        {
+            inputs[k] = in;
+            outputs[k] = out;
+            in += 64;
+            out += 32;
+        }
+        KangarooTwelve64To32Lanes(inputs, outputs);
+    }
+    for (; count > 0; count--)
+    {
+        KangarooTwelve64To32(in, out);
+        in += 64;
+        out += 32;
+    }
+}
+
+// Collects independent KangarooTwelve64To32() calls with arbitrary input/output addresses and hashes them with
+// the multi-lane kernel. Inputs have to stay unchanged and outputs must not be read until flush() is called.
+struct KangarooTwelve64To32Batcher
+{
+    const void* inputs[K12_64TO32_LANES];
+    void* outputs[K12_64TO32_LANES];
+    unsigned int count = 0;
+
+    // Add hashing of 64 bytes at input to 32 bytes at output, may hash all pending inputs
+    void add(const void* input, void* output)
+    {
+        inputs[count] = input;
+        outputs[count] = output;
+        if (++count == K12_64TO32_LANES)
+        {
+            KangarooTwelve64To32Lanes(inputs, outputs);
+            count = 0;
+        }
+    }
+
+    // Hash all pending inputs
+    void flush()
+    {
+        for (unsigned int k = 0; k < count; k++)
+        {
+            KangarooTwelve64To32(inputs[k], outputs[k]);
+        }
+        count = 0;
+    }
+};
+
+// Maximum size of input of KangarooTwelveShortLanes(). Inputs of up to this size are absorbed in a single block
+// together with the encoding of the empty customization string (0x00), the K12 suffix (0x07), and the final bit.
+#define K12_SHORT_MAX_INPUT_SIZE (K12_rateInBytes - 2)
+
+// Multi-lane KangarooTwelve for short inputs of at most K12_SHORT_MAX_INPUT_SIZE bytes with outputs of at most 32 bytes,
+// using the same interleaved state layout as KangarooTwelve64To32Lanes(). This gives the same result as
+// K12_64TO32_LANES calls of KangarooTwelve(inputs[k], inputByteLens[k], outputs[k], outputByteLen).
+static void KangarooTwelveShortLanes(const void* const* inputs, const unsigned int* inputByteLens, void* const* outputs, unsigned int outputByteLen)
+{
+    K12LanesVector A00, A01, A02, A03, A04, A05, A06, A07, A08, A09, A10, A11, A12, A13, A14, A15, A16, A17, A18, A19, A20, A21, A22, A23, A24;
+    K12LanesVector B00, B01, B02, B03, B04, B05, B06, B07, B08, B09, B10, B11, B12, B13, B14, B15, B16, B17, B18, B19, B20, B21, B22, B23, B24;
+    K12LanesVector C0, C1, C2, C3, C4, D;
+
+    // Pad each input to a full block of 21 lanes
+    unsigned long long blocks[K12_64TO32_LANES][K12_rateInBytes / 8];
+    for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+    {
+        unsigned char* block = (unsigned char*)blocks[k];
+        setMem(block, K12_rateInBytes, 0);
+        copyMem(block, inputs[k], inputByteLens[k]);
+        block[inputByteLens[k] + 1] = 0x07;
+        block[K12_rateInBytes - 1] ^= 0x80;
+    }
+
+    alignas(64) unsigned long long transposed[K12_64TO32_LANES];
+#define K12LanesLoad(A, j) \
+    for (unsigned int k = 0; k < K12_64TO32_LANES; k++) \
+        transposed[k] = blocks[k][j]; \
+    A = *((K12LanesVector*)transposed)
+    K12LanesLoad(A00, 0);
+    K12LanesLoad(A01, 1);
+    K12LanesLoad(A02, 2);
+    K12LanesLoad(A03, 3);
+    K12LanesLoad(A04, 4);
+    K12LanesLoad(A05, 5);
+    K12LanesLoad(A06, 6);
+    K12LanesLoad(A07, 7);
+    K12LanesLoad(A08, 8);
+    K12LanesLoad(A09, 9);
+    K12LanesLoad(A10, 10);
+    K12LanesLoad(A11, 11);
+    K12LanesLoad(A12, 12);
+    K12LanesLoad(A13, 13);
+    K12LanesLoad(A14, 14);
+    K12LanesLoad(A15, 15);
+    K12LanesLoad(A16, 16);
+    K12LanesLoad(A17, 17);
+    K12LanesLoad(A18, 18);
+    K12LanesLoad(A19, 19);
+    K12LanesLoad(A20, 20);
+#undef K12LanesLoad
+    A21 = A22 = A23 = A24 = K12LanesSet1(0);
+
+    K12LanesRound(KeccakF1600RoundConstant0);
+    K12LanesRound(KeccakF1600RoundConstant1);
+    K12LanesRound(KeccakF1600RoundConstant2);
+    K12LanesRound(KeccakF1600RoundConstant3);
+    K12LanesRound(KeccakF1600RoundConstant4);
+    K12LanesRound(KeccakF1600RoundConstant5);
+    K12LanesRound(KeccakF1600RoundConstant6);
+    K12LanesRound(KeccakF1600RoundConstant7);
+    K12LanesRound(KeccakF1600RoundConstant8);
+    K12LanesRound(KeccakF1600RoundConstant9);
+    K12LanesRound(KeccakF1600RoundConstant10);
+    K12LanesRound(0x8000000080008008ULL);
+
+    // Store first 4 state lanes (32 bytes) of each state and copy requested part to output
+#define K12LanesStore(A, j) \
+    *((K12LanesVector*)transposed) = A; \
+    for (unsigned int k = 0; k < K12_64TO32_LANES; k++) \
+        blocks[k][j] = transposed[k]
+    K12LanesStore(A00, 0);
+    K12LanesStore(A01, 1);
+    K12LanesStore(A02, 2);
+    K12LanesStore(A03, 3);
+#undef K12LanesStore
+    for (unsigned int k = 0; k < K12_64TO32_LANES; k++)
+    {
+        copyMem(outputs[k], blocks[k], outputByteLen);
+    }
+}
+
+// Collects independent KangarooTwelve() calls of short inputs (at most K12_SHORT_MAX_INPUT_SIZE bytes) with
+// outputByteLen <= 32 and hashes them with the multi-lane kernel, such as the digests of small log events.
+// Inputs have to stay unchanged and outputs must not be read until flush() is called.
+template <unsigned int outputByteLen>
+struct KangarooTwelveShortBatcher
+{
+    static_assert(outputByteLen <= 32, "KangarooTwelveShortBatcher supports up to 32 bytes of output");
+
+    const void* inputs[K12_64TO32_LANES];
+    unsigned int inputByteLens[K12_64TO32_LANES];
+    void* outputs[K12_64TO32_LANES];
+    unsigned int count = 0;
+
+    // Add hashing of inputByteLen bytes at input to outputByteLen bytes at output, may hash all pending inputs
+    void add(const void* input, unsigned int inputByteLen, void* output)
+    {
+        ASSERT(inputByteLen <= K12_SHORT_MAX_INPUT_SIZE);
+        inputs[count] = input;
+        inputByteLens[count] = inputByteLen;
+        outputs[count] = output;
+        if (++count == K12_64TO32_LANES)
+        {
+            KangarooTwelveShortLanes(inputs, inputByteLens, outputs, outputByteLen);
+            count = 0;
+        }
+    }
+
+    // Hash all pending inputs
+    void flush()
+    {
+        for (unsigned int k = 0; k < count; k++)
+        {
+            KangarooTwelve(inputs[k], inputByteLens[k], outputs[k], outputByteLen);
+        }
+        count = 0;
+    }
+};
+
+// Multi-lane KangarooTwelveLeaf() for tree hashing: computes the chaining values of K12_64TO32_LANES full leaf chunks
+// (K12_chunkSize bytes each) at once, using the same interleaved state layout as KangarooTwelve64To32Lanes(). This
+// gives the same result as K12_64TO32_LANES calls of KangarooTwelveLeaf(chunks[k], chainingValues[k]).
+static void KangarooTwelveLeafLanes(const unsigned char* const* chunks, unsigned char* const* chainingValues)
+{
+    // the last block of a chunk has 16 lanes of data, followed by the leaf suffix and the final bit
+    static_assert(K12_chunkSize % K12_rateInBytes == 16 * 8, "Padding of last block assumes 16 lanes of data");
+
+    K12LanesVector A00, A01, A02, A03, A04, A05, A06, A07, A08, A09, A10, A11, A12, A13, A14, A15, A16, A17, A18, A19, A20, A21, A22, A23, A24;
+    K12LanesVector B00, B01, B02, B03, B04, B05, B06, B07, B08, B09, B10, B11, B12, B13, B14, B15, B16, B17, B18, B19, B20, B21, B22, B23, B24;
+    K12LanesVector C0, C1, C2, C3, C4, D;
+
+    A00 = A01 = A02 = A03 = A04 = A05 = A06 = A07 = A08 = A09 = A10 = A11 = A12 = K12LanesSet1(0);
+    A13 = A14 = A15 = A16 = A17 = A18 = A19 = A20 = A21 = A22 = A23 = A24 = K12LanesSet1(0);
+
+    alignas(64) unsigned long long transposed[K12_64TO32_LANES];
+    for (unsigned int offset = 0; offset < K12_chunkSize; offset += K12_rateInBytes)
+    {
+#define K12LanesAbsorb(A, j) \
+        for (unsigned int k = 0; k < K12_64TO32_LANES; k++) \
+            transposed[k] = ((const unsigned long long*)(chunks[k] + offset))[j]; \
+        A = K12LanesXor(A, *((K12LanesVector*)transposed))
+        K12LanesAbsorb(A00, 0);
+        K12LanesAbsorb(A01, 1);
+        K12LanesAbsorb(A02, 2);
+        K12LanesAbsorb(A03, 3);
+        K12LanesAbsorb(A04, 4);
+        K12LanesAbsorb(A05, 5);
+        K12LanesAbsorb(A06, 6);
+        K12LanesAbsorb(A07, 7);
+        K12LanesAbsorb(A08, 8);
+        K12LanesAbsorb(A09, 9);
+        K12LanesAbsorb(A10, 10);
+        K12LanesAbsorb(A11, 11);
+        K12LanesAbsorb(A12, 12);
+        K12LanesAbsorb(A13, 13);
+        K12LanesAbsorb(A14, 14);
+        K12LanesAbsorb(A15, 15);
+        if (offset + K12_rateInBytes <= K12_chunkSize)
+        {
+            K12LanesAbsorb(A16, 16);
+            K12LanesAbsorb(A17, 17);
+            K12LanesAbsorb(A18, 18);
+            K12LanesAbsorb(A19, 19);
+            K12LanesAbsorb(A20, 20);
+        }
+        else
+        {
+            A16 = K12LanesXor(A16, K12LanesSet1(K12_suffixLeaf));
+            A20 = K12LanesXor(A20, K12LanesSet1(0x8000000000000000ULL));
+        }
+#undef K12LanesAbsorb
+
+        K12LanesRound(KeccakF1600RoundConstant0);
+        K12LanesRound(KeccakF1600RoundConstant1);
+        K12LanesRound(KeccakF1600RoundConstant2);
+        K12LanesRound(KeccakF1600RoundConstant3);
+        K12LanesRound(KeccakF1600RoundConstant4);
+        K12LanesRound(KeccakF1600RoundConstant5);
+        K12LanesRound(KeccakF1600RoundConstant6);
+        K12LanesRound(KeccakF1600RoundConstant7);
+        K12LanesRound(KeccakF1600RoundConstant8);
+        K12LanesRound(KeccakF1600RoundConstant9);
+        K12LanesRound(KeccakF1600RoundConstant10);
+        K12LanesRound(0x8000000080008008ULL);
+    }
+
+    // Store first 4 state lanes (K12_capacityInBytes bytes) of each state
+#define K12LanesStore(A, j) \
+    *((K12LanesVector*)transposed) = A; \
+    for (unsigned int k = 0; k < K12_64TO32_LANES; k++) \
+        ((unsigned long long*)chainingValues[k])[j] = transposed[k]
+    K12LanesStore(A00, 0);
+    K12LanesStore(A01, 1);
+    K12LanesStore(A02, 2);
+    K12LanesStore(A03, 3);
+#undef K12LanesStore
+}
+
+// Collects independent KangarooTwelveLeaf() calls and hashes them with the multi-lane kernel, such as the changed
+// leafs of a contract state. Chunks have to stay unchanged and chaining values must not be read until flush() is called.
+struct KangarooTwelveLeafBatcher
+{
+    const unsigned char* chunks[K12_64TO32_LANES];
+    unsigned char* chainingValues[K12_64TO32_LANES];
+    unsigned int count = 0;
+
+    // Add computing the chaining value of the leaf chunk, may hash all pending chunks
+    void add(const unsigned char* chunk, unsigned char* chainingValue)
+    {
+        chunks[count] = chunk;
+        chainingValues[count] = chainingValue;
+        if (++count == K12_64TO32_LANES)
+        {
+            KangarooTwelveLeafLanes(chunks, chainingValues);
+            count = 0;
+        }
+    }
+
+    // Hash all pending chunks
+    void flush()
+    {
+        for (unsigned int k = 0; k < count; k++)
+        {
+            KangarooTwelveLeaf(chunks[k], chainingValues[k]);
+        }
+        count = 0;
+    }
+};
+
 static void random(const unsigned char* publicKey, const unsigned char* nonce, unsigned char* output, unsigned long long outputSize)
 {
     unsigned char state[200];
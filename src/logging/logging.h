@@ -38,6 +38,7 @@ struct Peer;
 // if we include xkcp "outside" it will break the gtest
 #include "K12/kangaroo_twelve_xkcp.h"
 #include "common_buffers.h"
+#include "merkle_tree.h"
 #endif
 
 // Logger defines
@@ -58,6 +59,7 @@ struct Peer;
 #define ASSET_POSSESSION_MANAGING_CONTRACT_CHANGE 12
 #define CONTRACT_RESERVE_DEDUCTION 13
 #define ORACLE_QUERY_STATUS_CHANGE 14
+#define QU_TRANSFER_BATCH 15
 #define CUSTOM_MESSAGE 255
 
 #define CUSTOM_MESSAGE_OP_START_DISTRIBUTE_DIVIDENDS 6217575821008262227ULL // STA_DDIV
@@ -224,6 +226,35 @@ struct DustBurning
     }
 };
 
+// Contains N QU transfers from one source in the memory layout: [source public key] | [N with 2 bytes] | [destination public key 0] | [amount 0] | ... | [destination public key N-1] | [amount N-1].
+// Logged by batched payouts (such as qpi.transferMany() and dividends) instead of N QuTransfer messages. The transfers
+// are equivalent to N QuTransfer messages in the same order.
+// CAUTION: This is a variable-size log type and the full log message content goes boyond the size of this struct!
+struct QuTransferBatch
+{
+    m256i sourcePublicKey;
+    unsigned short numberOfTransfers;
+
+    struct Transfer
+    {
+        m256i destinationPublicKey;
+        long long amount;
+    };
+    static_assert(sizeof(Transfer) == (sizeof(m256i) + sizeof(long long)), "Unexpected size");
+
+    unsigned int messageSize() const
+    {
+        return sizeof(m256i) + 2 + numberOfTransfers * sizeof(Transfer);
+    }
+
+    Transfer& transfer(unsigned short i)
+    {
+        ASSERT(i < numberOfTransfers);
+        char* buf = reinterpret_cast<char*>(this);
+        return *reinterpret_cast<Transfer*>(buf + sizeof(m256i) + 2 + i * sizeof(Transfer));
+    }
+};
+
 struct SpectrumStats
 {
     unsigned long long totalAmount;
@@ -284,20 +315,37 @@ public:
     };
 
 private:
-    inline static VirtualMemory<char, TEXT_BUF_AS_NUMBER, TEXT_LOGS_AS_NUMBER, LOG_BUFFER_PAGE_SIZE, VM_NUM_CACHE_PAGE> logBuffer;
-    inline static VirtualMemory<BlobInfo, TEXT_PMAP_AS_NUMBER, TEXT_LOGS_AS_NUMBER, PMAP_LOG_PAGE_SIZE, VM_NUM_CACHE_PAGE> mapLogIdToBufferIndex;
-    inline static VirtualMemory<TickBlobInfo, TEXT_IMAP_AS_NUMBER, TEXT_LOGS_AS_NUMBER, IMAP_LOG_PAGE_SIZE, VM_NUM_CACHE_PAGE> mapTxToLogId;
+    inline static VirtualMemory<char, TEXT_BUF_AS_NUMBER, TEXT_LOGS_AS_NUMBER, LOG_BUFFER_PAGE_SIZE, VM_NUM_CACHE_PAGE, VM_NUM_CACHE_PAGE / 4, VM_COMPRESS_PAGES> logBuffer;
+    inline static VirtualMemory<BlobInfo, TEXT_PMAP_AS_NUMBER, TEXT_LOGS_AS_NUMBER, PMAP_LOG_PAGE_SIZE, VM_NUM_CACHE_PAGE, VM_NUM_CACHE_PAGE / 4, VM_COMPRESS_PAGES> mapLogIdToBufferIndex;
+    inline static VirtualMemory<TickBlobInfo, TEXT_IMAP_AS_NUMBER, TEXT_LOGS_AS_NUMBER, IMAP_LOG_PAGE_SIZE, VM_NUM_CACHE_PAGE, VM_NUM_CACHE_PAGE / 4, VM_COMPRESS_PAGES> mapTxToLogId;
     inline static TickBlobInfo currentTickTxToId;
     inline static char responseBuffers[MAX_NUMBER_OF_PROCESSORS][RequestResponseHeader::max_size];
 
 #if LOG_STATE_DIGEST
     // Digests of log data:
-    // d(i) = K12(concat(d(i-1), log(spectrum), log(universe))
+    // d(i) = K12(concat(d(i-1), r(i)))
+    // r(i) is the root of a Merkle tree over the transaction slots of tick i (see registerNewTx()). Leaf j is the
+    // K12 of the concatenated spectrum and universe logs of slot j, or zero if the slot has no such logs. If logs
+    // of a slot are interrupted by logs of another slot, the leaf is K12(concat(leaf, K12(logs after interruption))).
+    // Thus, the logs of some transactions can be verified with the siblings of their leafs without rehashing the
+    // whole tick, and inner nodes are combined with batched multi-lane hashing at the end of the tick.
     // custom log from smart contracts are not included in the digest computation
+    static constexpr unsigned long long LOG_DIGEST_TREE_CAPACITY = 2 * NUMBER_OF_TRANSACTIONS_PER_TICK;
+    static_assert(LOG_DIGEST_TREE_CAPACITY >= LOG_TX_PER_TICK, "LOG_DIGEST_TREE_CAPACITY is too small");
+    typedef IncrementalMerkleTree<LOG_DIGEST_TREE_CAPACITY> LogDigestTree;
     inline static m256i digests[MAX_NUMBER_OF_TICKS_PER_EPOCH];
-    inline static XKCP::KangarooTwelve_Instance k12;
+    inline static XKCP::KangarooTwelve_Instance k12; // open chunk of logs of slot digestTxId
+    inline static unsigned int digestTxId; // LOG_TX_PER_TICK if no chunk is open
+    inline static LogDigestTree digestTree;
+    inline static m256i digestTreeDigests[LogDigestTree::digestCount];
+    inline static unsigned long long digestTreeChangeFlags[LogDigestTree::changeFlagWords];
 #endif
 
+    // Summaries of log events per tick (see TickLogSummary), built in updateTick()
+    inline static TickLogSummary tickSummaries[MAX_NUMBER_OF_TICKS_PER_EPOCH];
+    inline static TickLogSummary currentTickSummary;
+    static constexpr unsigned int LOG_SUMMARY_TYPE_COUNT = sizeof(TickLogSummary::numberOfLogsPerType) / sizeof(unsigned int);
+
     inline static unsigned long long logBufferTail;
     inline static unsigned long long logId;
     inline static unsigned int tickBegin; // initial tick of the epoch
@@ -306,6 +354,24 @@ private:
     inline static unsigned int currentTick;
     inline static bool isPausing;
 
+    // Staging buffer of the tick processor: events get their logId immediately, but are written to logBuffer and
+    // mapLogIdToBufferIndex in bulk when the buffer is full and at the end of the tick (see flushStagedLogs()). This
+    // saves locking the virtual memory twice per event. Log requests only find events after they have been flushed.
+    static constexpr unsigned long long LOG_STAGING_BUFFER_SIZE = 1024 * 1024;
+    static constexpr unsigned int LOG_STAGING_MAX_EVENTS = 16384;
+    inline static char stagingBuffer[LOG_STAGING_BUFFER_SIZE];
+    inline static BlobInfo stagingBlobInfo[LOG_STAGING_MAX_EVENTS];
+    inline static unsigned long long stagingSize;
+    inline static unsigned int stagingEventCount;
+    static_assert(LOG_STAGING_BUFFER_SIZE <= RequestResponseHeader::max_size - sizeof(RequestResponseHeader), "Staged logs have to fit into one message");
+
+    // Peers subscribed to log events (see RequestLogSubscription), which get the staged events pushed when they are
+    // flushed. Entries of peers whose connection has been closed are removed lazily (Peer::reset() clears
+    // isLogSubscriber).
+    static constexpr unsigned int LOG_MAX_SUBSCRIBERS = 4;
+    inline static Peer* logSubscribers[LOG_MAX_SUBSCRIBERS];
+    inline static volatile char logSubscribersLock;
+
     static unsigned long long getLogId(const char* ptr)
     {
         // first 10 bytes are: epoch(2) + tick(4)+ size/type(4)
@@ -351,24 +417,53 @@ private:
     {
 #if ENABLED_LOGGING
         if (isPausing) return;
-        char buffer[LOG_HEADER_SIZE];
+        const unsigned long long logSize = LOG_HEADER_SIZE + messageSize;
+        if (stagingSize + logSize > LOG_STAGING_BUFFER_SIZE || stagingEventCount == LOG_STAGING_MAX_EVENTS)
+        {
+            flushStagedLogs();
+        }
+
+        // events larger than the staging buffer are written directly (staging buffer is empty after flushing)
+        const bool staged = (logSize <= LOG_STAGING_BUFFER_SIZE);
+        char headerBuffer[LOG_HEADER_SIZE];
+        char* buffer = (staged) ? stagingBuffer + stagingSize : headerBuffer;
         tx.addLogId();
-        logBuf.set(logId, logBufferTail, LOG_HEADER_SIZE + messageSize);
         *((unsigned short*)(buffer)) = system.epoch;
         *((unsigned int*)(buffer + 2)) = system.tick;
         *((unsigned int*)(buffer + 6)) = messageSize | (messageType << 24);
-        *((unsigned long long*)(buffer + 10)) = logId++;
-        unsigned long long logDigest = 0;
-        KangarooTwelve(message, messageSize, &logDigest, 8);
-        *((unsigned long long*)(buffer + 18)) = logDigest;
-        logBufferTail += LOG_HEADER_SIZE + messageSize;
-        logBuffer.appendMany(buffer, LOG_HEADER_SIZE);
-        logBuffer.appendMany((char*)message, messageSize);
+        *((unsigned long long*)(buffer + 10)) = logId;
+        if (staged)
+        {
+            // log digest is computed when flushing, hashing many small messages at once
+            copyMem(buffer + LOG_HEADER_SIZE, message, messageSize);
+            stagingBlobInfo[stagingEventCount].startIndex = logBufferTail;
+            stagingBlobInfo[stagingEventCount].length = logSize;
+            ++stagingEventCount;
+            stagingSize += logSize;
+        }
+        else
+        {
+            unsigned long long logDigest = 0;
+            KangarooTwelve(message, messageSize, &logDigest, 8);
+            *((unsigned long long*)(buffer + 18)) = logDigest;
+            logBuf.set(logId, logBufferTail, logSize);
+            logBuffer.appendMany(buffer, LOG_HEADER_SIZE);
+            logBuffer.appendMany((char*)message, messageSize);
+        }
+        ++currentTickSummary.numberOfLogsPerType[logTypeSlot(messageType)];
+        ++logId;
+        logBufferTail += logSize;
 #if LOG_STATE_DIGEST
         if (messageType == QU_TRANSFER || messageType == ASSET_ISSUANCE || messageType == ASSET_OWNERSHIP_CHANGE || messageType == ASSET_POSSESSION_CHANGE ||
             messageType == BURNING || messageType == DUST_BURNING || messageType == SPECTRUM_STATS || messageType == ASSET_OWNERSHIP_MANAGING_CONTRACT_CHANGE ||
-            messageType == ASSET_POSSESSION_MANAGING_CONTRACT_CHANGE)
+            messageType == ASSET_POSSESSION_MANAGING_CONTRACT_CHANGE || messageType == QU_TRANSFER_BATCH)
         {
+            if (digestTxId != currentTxId)
+            {
+                finishDigestChunk();
+                XKCP::KangarooTwelve_Initialize(&k12, 128, 32);
+                digestTxId = currentTxId;
+            }
             auto ret = XKCP::KangarooTwelve_Update(&k12, reinterpret_cast<const unsigned char*>(message), messageSize);
 #ifndef NDEBUG
             if (ret != 0)
@@ -381,6 +476,184 @@ private:
 #endif
     }
 public:
+    // Write staged log events to logBuffer and mapLogIdToBufferIndex. Called by the tick processor at the end of each
+    // tick and before saving the logging state. The event data is appended before its index entry, so concurrent log
+    // requests never find an index entry pointing to data that isn't written yet.
+    static void flushStagedLogs()
+    {
+#if ENABLED_LOGGING
+        if (stagingEventCount)
+        {
+            ASSERT(logId - stagingEventCount == mapLogIdToBufferIndex.size());
+
+            // compute log digests of staged events, most messages are small enough for the multi-lane K12
+            KangarooTwelveShortBatcher<8> digestBatcher;
+            const long long stagingStart = stagingBlobInfo[0].startIndex;
+            for (unsigned int i = 0; i < stagingEventCount; ++i)
+            {
+                char* event = stagingBuffer + (stagingBlobInfo[i].startIndex - stagingStart);
+                const unsigned int messageSize = (unsigned int)stagingBlobInfo[i].length - LOG_HEADER_SIZE;
+                if (messageSize <= K12_SHORT_MAX_INPUT_SIZE)
+                    digestBatcher.add(event + LOG_HEADER_SIZE, messageSize, event + 18);
+                else
+                    KangarooTwelve(event + LOG_HEADER_SIZE, messageSize, event + 18, 8);
+            }
+            digestBatcher.flush();
+
+            logBuffer.appendMany(stagingBuffer, stagingSize);
+
+            // Index entries are appended and events are pushed with logSubscribersLock acquired, so peers subscribing
+            // concurrently either get the events pushed or a nextLogId following them (see processRequestLogSubscription())
+            ACQUIRE(logSubscribersLock);
+            mapLogIdToBufferIndex.appendMany(stagingBlobInfo, stagingEventCount);
+#ifndef NO_UEFI
+            pushStagedLogsToSubscribers();
+#endif
+            RELEASE(logSubscribersLock);
+            stagingSize = 0;
+            stagingEventCount = 0;
+        }
+#endif
+    }
+
+    // Id that will be assigned to the next log event
+    static unsigned long long getNextLogId()
+    {
+        return logId;
+    }
+
+    // Number of pages of log buffer and maps written to disk since reset
+    static unsigned long long getWrittenPageCount()
+    {
+        return logBuffer.getWrittenPageCount() + mapLogIdToBufferIndex.getWrittenPageCount() + mapTxToLogId.getWrittenPageCount();
+    }
+
+    // Index of log type in TickLogSummary::numberOfLogsPerType and bit in RequestFilteredLog::typeMask
+    static unsigned int logTypeSlot(unsigned char messageType)
+    {
+        return (messageType < LOG_SUMMARY_TYPE_COUNT - 1) ? messageType : LOG_SUMMARY_TYPE_COUNT - 1;
+    }
+
+    // Check if log event with given type and message matches the type, identity, and asset filters of request
+    static bool matchesFilter(const RequestFilteredLog& filter, unsigned char messageType, const char* message, unsigned int messageSize)
+    {
+        if (!((filter.typeMask >> logTypeSlot(messageType)) & 1))
+            return false;
+
+        // asset filter: check issuer and name of asset events
+        const bool filterAsset = !isZero(filter.assetIssuer) || filter.assetName;
+        if (filterAsset)
+        {
+            unsigned int issuerOffset, nameOffset, minSize;
+            switch (messageType)
+            {
+            case ASSET_ISSUANCE:
+                issuerOffset = offsetof(AssetIssuance, issuerPublicKey);
+                nameOffset = offsetof(AssetIssuance, name);
+                minSize = offsetof(AssetIssuance, _terminator);
+                break;
+            case ASSET_OWNERSHIP_CHANGE:
+                issuerOffset = offsetof(AssetOwnershipChange, issuerPublicKey);
+                nameOffset = offsetof(AssetOwnershipChange, name);
+                minSize = offsetof(AssetOwnershipChange, _terminator);
+                break;
+            case ASSET_POSSESSION_CHANGE:
+                issuerOffset = offsetof(AssetPossessionChange, issuerPublicKey);
+                nameOffset = offsetof(AssetPossessionChange, name);
+                minSize = offsetof(AssetPossessionChange, _terminator);
+                break;
+            case ASSET_OWNERSHIP_MANAGING_CONTRACT_CHANGE:
+                issuerOffset = offsetof(AssetOwnershipManagingContractChange, issuerPublicKey);
+                nameOffset = offsetof(AssetOwnershipManagingContractChange, assetName);
+                minSize = offsetof(AssetOwnershipManagingContractChange, _terminator);
+                break;
+            case ASSET_POSSESSION_MANAGING_CONTRACT_CHANGE:
+                issuerOffset = offsetof(AssetPossessionManagingContractChange, issuerPublicKey);
+                nameOffset = offsetof(AssetPossessionManagingContractChange, assetName);
+                minSize = offsetof(AssetPossessionManagingContractChange, _terminator);
+                break;
+            default:
+                return false;
+            }
+            if (messageSize < minSize)
+                return false;
+            if (!isZero(filter.assetIssuer) && *((const m256i*)(message + issuerOffset)) != filter.assetIssuer)
+                return false;
+            unsigned long long name = 0;
+            copyMem(&name, message + nameOffset, 7);
+            if (filter.assetName && name != filter.assetName)
+                return false;
+        }
+
+        // identity filter: check all public keys of entities involved in the event
+        if (!isZero(filter.identity))
+        {
+            const m256i* keys = (const m256i*)message;
+            switch (messageType)
+            {
+            case QU_TRANSFER:
+                return messageSize >= offsetof(QuTransfer, _terminator) && (keys[0] == filter.identity || keys[1] == filter.identity);
+            case ASSET_ISSUANCE:
+            case BURNING:
+                return messageSize >= sizeof(m256i) && keys[0] == filter.identity;
+            case ASSET_OWNERSHIP_CHANGE:
+            case ASSET_POSSESSION_CHANGE:
+                return messageSize >= offsetof(AssetOwnershipChange, _terminator) && (keys[0] == filter.identity || keys[1] == filter.identity);
+            case ASSET_OWNERSHIP_MANAGING_CONTRACT_CHANGE:
+                return messageSize >= offsetof(AssetOwnershipManagingContractChange, _terminator) && keys[0] == filter.identity;
+            case ASSET_POSSESSION_MANAGING_CONTRACT_CHANGE:
+                return messageSize >= offsetof(AssetPossessionManagingContractChange, _terminator) && (keys[0] == filter.identity || keys[1] == filter.identity);
+            case ORACLE_QUERY_STATUS_CHANGE:
+                return messageSize >= offsetof(OracleQueryStatusChange, _terminator) && keys[0] == filter.identity;
+            case DUST_BURNING:
+            {
+                const DustBurning* dustBurning = (const DustBurning*)message;
+                if (messageSize < 2 || messageSize < dustBurning->messageSize())
+                    return false;
+                const DustBurning::Entity* entities = (const DustBurning::Entity*)(message + 2);
+                for (unsigned short i = 0; i < dustBurning->numberOfBurns; ++i)
+                {
+                    if (entities[i].publicKey == filter.identity)
+                        return true;
+                }
+                return false;
+            }
+            case QU_TRANSFER_BATCH:
+            {
+                const QuTransferBatch* batch = (const QuTransferBatch*)message;
+                if (messageSize < sizeof(m256i) + 2 || messageSize < batch->messageSize())
+                    return false;
+                if (batch->sourcePublicKey == filter.identity)
+                    return true;
+                const QuTransferBatch::Transfer* transfers = (const QuTransferBatch::Transfer*)(message + sizeof(m256i) + 2);
+                for (unsigned short i = 0; i < batch->numberOfTransfers; ++i)
+                {
+                    if (transfers[i].destinationPublicKey == filter.identity)
+                        return true;
+                }
+                return false;
+            }
+            default:
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Get summary of log events of tick. Returns false if logs of the tick are not available.
+    static bool getTickSummary(unsigned int tick, TickLogSummary& summary)
+    {
+#if ENABLED_LOGGING
+        if (tick >= tickBegin && tick <= lastUpdatedTick && tick - tickBegin < MAX_NUMBER_OF_TICKS_PER_EPOCH)
+        {
+            summary = tickSummaries[tick - tickBegin];
+            return summary.tick == tick;
+        }
+#endif
+        return false;
+    }
+
     // 5 special txs for 5 special events in qubic
     static constexpr unsigned int SC_INITIALIZE_TX = NUMBER_OF_TRANSACTIONS_PER_TICK + 0;
     static constexpr unsigned int SC_BEGIN_EPOCH_TX = NUMBER_OF_TRANSACTIONS_PER_TICK + 1;
@@ -593,32 +866,96 @@ public:
         tx.init();
         logBufferTail = 0;
         logId = 0;
+        stagingSize = 0;
+        stagingEventCount = 0;
         lastUpdatedTick = 0;
         tickBegin = _tickBegin;
+        startTickSummary();
         tx.cleanCurrentTickTxToId();
 #if LOG_STATE_DIGEST
-        XKCP::KangarooTwelve_Initialize(&k12, 128, 32);
-        m256i zeroHash = m256i::zero();
-        XKCP::KangarooTwelve_Update(&k12, zeroHash.m256i_u8, 32); // init tick, feed zero hash
+        resetDigestTree();
 #endif
         isPausing = false;
 #endif
     }
 
+    static void startTickSummary()
+    {
+        setMem(&currentTickSummary, sizeof(currentTickSummary), 0);
+        currentTickSummary.fromLogId = logId;
+        currentTickSummary.bufferOffset = logBufferTail;
+    }
+
+#if LOG_STATE_DIGEST
+    // Set storage of digest tree and clear all leafs (inner nodes of empty tree are resolved without hashing)
+    static void resetDigestTree()
+    {
+        digestTree.init(digestTreeDigests, digestTreeChangeFlags);
+        digestTree.setEmptyLeafDigest(m256i::zero());
+        setMem(digestTreeDigests, sizeof(digestTreeDigests), 0);
+        digestTree.markAllLeafsChanged();
+        digestTree.updateInnerNodes();
+        digestTxId = LOG_TX_PER_TICK;
+    }
+
+    // Finalize open chunk of logs and add it to the leaf of its transaction slot
+    static void finishDigestChunk()
+    {
+        if (digestTxId >= LOG_TX_PER_TICK)
+            return;
+        m256i chunkDigest;
+        XKCP::KangarooTwelve_Final(&k12, chunkDigest.m256i_u8, (const unsigned char*)"", 0);
+        m256i& leaf = digestTree.leafDigest(digestTxId);
+        if (isZero(leaf))
+        {
+            leaf = chunkDigest;
+        }
+        else
+        {
+            const m256i leafInput[2] = { leaf, chunkDigest };
+            KangarooTwelve64To32(leafInput, &leaf);
+        }
+        digestTree.markLeafChanged(digestTxId);
+        digestTxId = LOG_TX_PER_TICK;
+    }
+#endif
+
     // updateTick is called right after _tick is processed
     static void updateTick(unsigned int _tick)
     {
 #if ENABLED_LOGGING
         ASSERT((_tick == lastUpdatedTick + 1) || (_tick == tickBegin));
         ASSERT(_tick >= tickBegin);
+        flushStagedLogs();
 #if LOG_STATE_DIGEST
         unsigned long long index = _tick - tickBegin;
-        XKCP::KangarooTwelve_Final(&k12, digests[index].m256i_u8, (const unsigned char*)"", 0);
-        XKCP::KangarooTwelve_Initialize(&k12, 128, 32); // init new k12
-        XKCP::KangarooTwelve_Update(&k12, digests[index].m256i_u8, 32); // feed the prev hash back to this
+        finishDigestChunk();
+        digestTree.updateInnerNodes();
+        const m256i digestInput[2] = { (index) ? digests[index - 1] : m256i::zero(), digestTree.root() };
+        KangarooTwelve64To32(digestInput, &digests[index]);
+
+        // Clear leafs for next tick. Their paths are updated together with the leafs of the next tick, which
+        // resolves the empty subtrees without hashing.
+        for (unsigned int i = 0; i < LOG_TX_PER_TICK; i++)
+        {
+            m256i& leaf = digestTree.leafDigest(i);
+            if (!isZero(leaf))
+            {
+                leaf = m256i::zero();
+                digestTree.markLeafChanged(i);
+            }
+        }
 #endif
         tx.commitAndCleanCurrentTxToLogId();
         ASSERT(mapTxToLogId.size() == (_tick - tickBegin + 1));
+        if (_tick - tickBegin < MAX_NUMBER_OF_TICKS_PER_EPOCH)
+        {
+            currentTickSummary.tick = _tick;
+            currentTickSummary.numberOfLogs = (unsigned int)(logId - currentTickSummary.fromLogId);
+            currentTickSummary.bufferSize = (unsigned int)(logBufferTail - currentTickSummary.bufferOffset);
+            tickSummaries[_tick - tickBegin] = currentTickSummary;
+        }
+        startTickSummary();
         lastUpdatedTick = _tick;
         isPausing = false;
 #endif
@@ -632,8 +969,10 @@ public:
     {
 #if ENABLED_LOGGING
         constexpr auto bufferSize = LOG_BUFFER_PAGE_SIZE + PMAP_LOG_PAGE_SIZE * sizeof(BlobInfo) + IMAP_LOG_PAGE_SIZE * sizeof(TickBlobInfo)
-            + sizeof(digests) + 600;
+            + sizeof(digests) + sizeof(tickSummaries) + sizeof(currentTickSummary)
+            + sizeof(digestTreeDigests) + sizeof(digestTreeChangeFlags) + 600;
         static_assert(defaultCommonBuffersSize >= bufferSize, "commonBuffer size is too small");
+        flushStagedLogs();
         __ScopedScratchpad scratchpad(bufferSize, /*initZero=*/false);
         ASSERT(scratchpad.ptr);
         unsigned char* buffer = (unsigned char*)scratchpad.ptr;
@@ -671,6 +1010,21 @@ public:
         *((unsigned int*)buffer) = currentTxId; buffer += 4;
         *((unsigned int*)buffer) = currentTick; buffer += 4;
         writeSz += 8 + 8 + 4 + 4 + 4 + 4;
+
+        // copy tick summaries ~ 74MiB (at the end for compatibility with files of older versions)
+        copyMem(buffer, tickSummaries, sizeof(tickSummaries));
+        buffer += sizeof(tickSummaries);
+        copyMem(buffer, &currentTickSummary, sizeof(currentTickSummary));
+        buffer += sizeof(currentTickSummary);
+        writeSz += sizeof(tickSummaries) + sizeof(currentTickSummary);
+
+        // copy state of digest tree of current tick ~ 128KiB (at the end for compatibility with files of older versions)
+        *((unsigned int*)buffer) = digestTxId; buffer += 4;
+        copyMem(buffer, digestTreeDigests, sizeof(digestTreeDigests));
+        buffer += sizeof(digestTreeDigests);
+        copyMem(buffer, digestTreeChangeFlags, sizeof(digestTreeChangeFlags));
+        buffer += sizeof(digestTreeChangeFlags);
+        writeSz += 4 + sizeof(digestTreeDigests) + sizeof(digestTreeChangeFlags);
         buffer = (unsigned char*)scratchpad.ptr; // reset back to original pos
         sz = save(L"logEventState.db", writeSz, buffer, dir);
         if (sz != writeSz)
@@ -687,7 +1041,8 @@ public:
     {
 #if ENABLED_LOGGING
         constexpr auto bufferSize = LOG_BUFFER_PAGE_SIZE + PMAP_LOG_PAGE_SIZE * sizeof(BlobInfo) + IMAP_LOG_PAGE_SIZE * sizeof(TickBlobInfo)
-            + sizeof(digests) + 600;
+            + sizeof(digests) + sizeof(tickSummaries) + sizeof(currentTickSummary)
+            + sizeof(digestTreeDigests) + sizeof(digestTreeChangeFlags) + 600;
         static_assert(defaultCommonBuffersSize >= bufferSize, "commonBuffer size is too small");
         __ScopedScratchpad scratchpad(bufferSize, /*initZero=*/false);
         unsigned char* buffer = (unsigned char*)scratchpad.ptr;
@@ -739,7 +1094,33 @@ public:
         tickBegin = *((unsigned int*)buffer); buffer += 4;
         lastUpdatedTick = *((unsigned int*)buffer); buffer += 4;
         currentTxId = *((unsigned int*)buffer); buffer += 4;
-        currentTick = *((unsigned int*)buffer);
+        currentTick = *((unsigned int*)buffer); buffer += 4;
+        readSz += 8 + 8 + 4 + 4 + 4 + 4;
+
+        // tick summaries are missing in files of older versions
+        if (readSz + sizeof(tickSummaries) + sizeof(currentTickSummary) <= (unsigned long long)fileSz)
+        {
+            copyMem(tickSummaries, buffer, sizeof(tickSummaries));
+            buffer += sizeof(tickSummaries);
+            copyMem(&currentTickSummary, buffer, sizeof(currentTickSummary));
+            buffer += sizeof(currentTickSummary);
+            readSz += sizeof(tickSummaries) + sizeof(currentTickSummary);
+        }
+        else
+        {
+            setMem(tickSummaries, sizeof(tickSummaries), 0);
+            startTickSummary();
+        }
+
+        // digest tree is missing in files of older versions (k12 instance of these is ignored)
+        resetDigestTree();
+        if (readSz + 4 + sizeof(digestTreeDigests) + sizeof(digestTreeChangeFlags) <= (unsigned long long)fileSz)
+        {
+            digestTxId = *((unsigned int*)buffer); buffer += 4;
+            copyMem(digestTreeDigests, buffer, sizeof(digestTreeDigests));
+            buffer += sizeof(digestTreeDigests);
+            copyMem(digestTreeChangeFlags, buffer, sizeof(digestTreeChangeFlags));
+        }
 #endif
     }
 
@@ -868,6 +1249,13 @@ public:
 #endif
     }
 
+    void logQuTransferBatch(const QuTransferBatch* message)
+    {
+#if LOG_SPECTRUM
+        logMessage(message->messageSize(), QU_TRANSFER_BATCH, message);
+#endif
+    }
+
     void logSpectrumStats(const SpectrumStats& message)
     {
 #if LOG_SPECTRUM
@@ -912,6 +1300,18 @@ public:
     // get logging content from log ID
     static void processRequestLog(unsigned long long processorNumber, Peer* peer, RequestResponseHeader* header);
 
+    // subscribe to / unsubscribe from log events pushed by the node
+    static void processRequestLogSubscription(Peer* peer, RequestResponseHeader* header);
+
+    // send staged log events to subscribed peers, called by flushStagedLogs() with logSubscribersLock acquired
+    static void pushStagedLogsToSubscribers();
+
+    // get summaries of log events of ticks
+    static void processRequestTickLogSummaries(unsigned long long processorNumber, Peer* peer, RequestResponseHeader* header);
+
+    // get log events of ticks matching filters
+    static void processRequestFilteredLog(unsigned long long processorNumber, Peer* peer, RequestResponseHeader* header);
+
     // convert from tx id to log ID
     static void processRequestTxLogInfo(unsigned long long processorNumber, Peer* peer, RequestResponseHeader* header);
 
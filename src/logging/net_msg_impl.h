@@ -19,29 +19,53 @@ void qLogger::processRequestLog(unsigned long long processorNumber, Peer* peer,
         if (startIdBufferRange.startIndex != -1 && startIdBufferRange.length != -1
             && endIdBufferRange.startIndex != -1 && endIdBufferRange.length != -1)
         {
-            unsigned long long toID = request->toID;
             long long startFrom = startIdBufferRange.startIndex;
             long long length = endIdBufferRange.length + endIdBufferRange.startIndex - startFrom;
             constexpr long long maxPayloadSize = RequestResponseHeader::max_size - sizeof(sizeof(RequestResponseHeader));
 
+            const long long readLength = (length < maxPayloadSize) ? length : maxPayloadSize;
+
+            // Read log events right into the response queue instead of copying them from responseBuffers. Later
+            // responses aren't sent while the reservation is held, so this is only done if all pages of the log
+            // events are cached. Otherwise the reservation is given up and the pages are loaded from disk before
+            // enqueuing the response.
+            unsigned short responseElementIndex;
+            char* rBuffer = (char*)reserveResponse(peer, (unsigned int)readLength, responseElementIndex);
+            if (!rBuffer)
+            {
+                // response queue is full
+                return;
+            }
+            bool isReserved = true;
+            if (!logBuffer.getMany(rBuffer, startFrom, readLength, true))
+            {
+                cancelResponse(responseElementIndex);
+                isReserved = false;
+                rBuffer = responseBuffers[processorNumber];
+                logBuffer.getMany(rBuffer, startFrom, readLength);
+            }
+
             if (length > maxPayloadSize)
             {
-                while (length > maxPayloadSize && toID > request->fromID)
+                // Cut after the last complete event that fits, instead of looking up the end of smaller and smaller
+                // ranges. Events are stored consecutively, so the headers tell where they end.
+                long long fittingLength = 0;
+                while (fittingLength + LOG_HEADER_SIZE <= maxPayloadSize
+                    && fittingLength + LOG_HEADER_SIZE + getLogSize(rBuffer + fittingLength) <= maxPayloadSize)
                 {
-                    toID = request->fromID + (toID - request->fromID) / 2;
-                    endIdBufferRange = logBuf.getBlobInfo(toID);
-                    length = endIdBufferRange.length + endIdBufferRange.startIndex - startFrom;
+                    fittingLength += LOG_HEADER_SIZE + getLogSize(rBuffer + fittingLength);
                 }
+                length = (fittingLength) ? fittingLength : maxPayloadSize;
             }
-            if (length < maxPayloadSize)
+            const unsigned int responseSize = (length < maxPayloadSize) ? (unsigned int)(length) : 0;
+            const unsigned char responseType = (length < maxPayloadSize) ? RespondLog::type() : EndResponse::type();
+            if (isReserved)
             {
-                char* rBuffer = responseBuffers[processorNumber];
-                logBuffer.getMany(rBuffer, startFrom, length);
-                enqueueResponse(peer, (unsigned int)(length), RespondLog::type(), header->dejavu(), rBuffer);
+                commitResponse(responseElementIndex, responseSize, responseType, header->dejavu());
             }
             else
             {
-                enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+                enqueueResponse(peer, responseSize, responseType, header->dejavu(), rBuffer);
             }
         }
         else
@@ -54,6 +78,249 @@ void qLogger::processRequestLog(unsigned long long processorNumber, Peer* peer,
     enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
 
+void qLogger::processRequestLogSubscription(Peer* peer, RequestResponseHeader* header)
+{
+#if ENABLED_LOGGING
+    RequestLogSubscription* request = header->getPayload<RequestLogSubscription>();
+    if (request->passcode[0] == logReaderPasscodes[0]
+        && request->passcode[1] == logReaderPasscodes[1]
+        && request->passcode[2] == logReaderPasscodes[2]
+        && request->passcode[3] == logReaderPasscodes[3])
+    {
+        RespondLogSubscription resp;
+        resp.nextLogId = -1;
+
+        ACQUIRE(logSubscribersLock);
+
+        // Find entry of peer. It may be left from a closed connection that used the same Peer, so a peer never has
+        // more than one entry and doesn't get events pushed twice.
+        unsigned int i = 0;
+        while (i < LOG_MAX_SUBSCRIBERS && logSubscribers[i] != peer)
+        {
+            ++i;
+        }
+        if (request->subscribe)
+        {
+            if (i < LOG_MAX_SUBSCRIBERS && peer->isLogSubscriber)
+            {
+                // reject duplicate subscription of the connection (nextLogId -1), its events are pushed already
+            }
+            else
+            {
+                if (i == LOG_MAX_SUBSCRIBERS)
+                {
+                    // use free entry or entry of closed connection
+                    i = 0;
+                    while (i < LOG_MAX_SUBSCRIBERS && logSubscribers[i] && logSubscribers[i]->isLogSubscriber)
+                    {
+                        ++i;
+                    }
+                }
+                if (i < LOG_MAX_SUBSCRIBERS)
+                {
+                    logSubscribers[i] = peer;
+                    peer->isLogSubscriber = TRUE;
+                    // flushStagedLogs() appends index entries and pushes their events with logSubscribersLock
+                    // acquired, so all events following nextLogId will be pushed.
+                    resp.nextLogId = mapLogIdToBufferIndex.size();
+                }
+            }
+        }
+        else if (i < LOG_MAX_SUBSCRIBERS)
+        {
+            logSubscribers[i] = NULL;
+            peer->isLogSubscriber = FALSE;
+        }
+        RELEASE(logSubscribersLock);
+
+        enqueueResponse(peer, sizeof(RespondLogSubscription), RespondLogSubscription::type(), header->dejavu(), &resp);
+        return;
+    }
+#endif
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+}
+
+// Push staged log events to subscribed peers right from the staging buffer, so archivers don't need to poll with
+// RequestLog, which looks up the virtual memory pages of the log buffer for every request.
+// The caller flushStagedLogs() holds logSubscribersLock.
+void qLogger::pushStagedLogsToSubscribers()
+{
+#if ENABLED_LOGGING
+    for (unsigned int i = 0; i < LOG_MAX_SUBSCRIBERS; ++i)
+    {
+        Peer* peer = logSubscribers[i];
+        if (!peer)
+            continue;
+        if (!peer->isLogSubscriber)
+        {
+            // connection has been closed
+            logSubscribers[i] = NULL;
+            continue;
+        }
+        enqueueResponse(peer, (unsigned int)stagingSize, RespondSubscribedLog::type(), 0, stagingBuffer);
+    }
+#endif
+}
+
+void qLogger::processRequestTickLogSummaries(unsigned long long processorNumber, Peer* peer, RequestResponseHeader* header)
+{
+#if ENABLED_LOGGING
+    RequestTickLogSummaries* request = header->getPayload<RequestTickLogSummaries>();
+    if (request->passcode[0] == logReaderPasscodes[0]
+        && request->passcode[1] == logReaderPasscodes[1]
+        && request->passcode[2] == logReaderPasscodes[2]
+        && request->passcode[3] == logReaderPasscodes[3])
+    {
+        constexpr unsigned int maxNumberOfSummaries = (RequestResponseHeader::max_size - sizeof(RequestResponseHeader)) / sizeof(TickLogSummary);
+        TickLogSummary* summaries = (TickLogSummary*)responseBuffers[processorNumber];
+        unsigned int numberOfSummaries = 0;
+        unsigned long long tick = (request->fromTick < tickBegin) ? tickBegin : request->fromTick;
+        unsigned long long endTick = (unsigned long long)request->fromTick + request->numberOfTicks;
+        if (endTick > lastUpdatedTick + 1ULL)
+        {
+            endTick = lastUpdatedTick + 1ULL;
+        }
+        for (; tick < endTick && numberOfSummaries < maxNumberOfSummaries; ++tick)
+        {
+            if (getTickSummary((unsigned int)tick, summaries[numberOfSummaries]))
+            {
+                ++numberOfSummaries;
+            }
+        }
+        enqueueResponse(peer, numberOfSummaries * sizeof(TickLogSummary), RespondTickLogSummaries::type(), header->dejavu(), summaries);
+        return;
+    }
+#endif
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+}
+
+// Move log event to lower address in the same buffer (dst <= src) in parts that don't overlap
+static void moveLogEventDown(char* dst, const char* src, unsigned long long size)
+{
+    if (dst == src)
+        return;
+    ASSERT(dst < src);
+    const unsigned long long partSize = src - dst;
+    for (unsigned long long offset = 0; offset < size; offset += partSize)
+    {
+        copyMem(dst + offset, src + offset, (size - offset < partSize) ? size - offset : partSize);
+    }
+}
+
+void qLogger::processRequestFilteredLog(unsigned long long processorNumber, Peer* peer, RequestResponseHeader* header)
+{
+#if ENABLED_LOGGING
+    RequestFilteredLog* request = header->getPayload<RequestFilteredLog>();
+    if (request->passcode[0] == logReaderPasscodes[0]
+        && request->passcode[1] == logReaderPasscodes[1]
+        && request->passcode[2] == logReaderPasscodes[2]
+        && request->passcode[3] == logReaderPasscodes[3])
+    {
+        constexpr unsigned long long maxPayloadSize = RequestResponseHeader::max_size - sizeof(RequestResponseHeader);
+        char* rBuffer = responseBuffers[processorNumber];
+        unsigned long long responseSize = sizeof(RespondFilteredLog);
+        unsigned long long nextLogId = request->fromLogId;
+        unsigned int tick = (request->fromTick < tickBegin) ? tickBegin : request->fromTick;
+        const unsigned int endTick = (request->toTick < lastUpdatedTick) ? request->toTick : lastUpdatedTick;
+        bool full = false;
+        while (tick <= endTick)
+        {
+            TickLogSummary summary;
+            if (getTickSummary(tick, summary))
+            {
+                // skip tick if it has no events of the selected types or all events have been checked already
+                const unsigned long long tickEndLogId = summary.fromLogId + summary.numberOfLogs;
+                bool hasSelectedTypes = false;
+                for (unsigned int i = 0; i < LOG_SUMMARY_TYPE_COUNT; ++i)
+                {
+                    if (((request->typeMask >> i) & 1) && summary.numberOfLogsPerType[i])
+                        hasSelectedTypes = true;
+                }
+                if (!hasSelectedTypes || nextLogId >= tickEndLogId)
+                {
+                    if (nextLogId < tickEndLogId)
+                        nextLogId = tickEndLogId;
+                }
+                else
+                {
+                    // start with first event of tick that hasn't been checked yet
+                    const long long readEnd = summary.bufferOffset + summary.bufferSize;
+                    long long readOffset = summary.bufferOffset;
+                    const unsigned long long firstUncheckedLogId = nextLogId;
+                    if (nextLogId > (unsigned long long)summary.fromLogId)
+                    {
+                        // if the event cannot be found (getBlobInfo() returns -1 if the ID isn't verified), read the
+                        // whole tick and skip the events that have been checked already
+                        const long long startIndex = logBuf.getBlobInfo(nextLogId).startIndex;
+                        if (startIndex >= summary.bufferOffset && startIndex < readEnd)
+                            readOffset = startIndex;
+                    }
+                    while (readOffset < readEnd)
+                    {
+                        // Read as much as fits into the unused end of the response buffer. Matching events are moved
+                        // down to the end of the response, so events are only copied once.
+                        unsigned long long chunkSize = maxPayloadSize - responseSize;
+                        if (chunkSize > (unsigned long long)(readEnd - readOffset))
+                            chunkSize = readEnd - readOffset;
+                        char* chunk = rBuffer + maxPayloadSize - chunkSize;
+                        logBuffer.getMany(chunk, readOffset, chunkSize);
+
+                        unsigned long long pos = 0;
+                        while (pos + LOG_HEADER_SIZE <= chunkSize)
+                        {
+                            const unsigned int messageSize = getLogSize(chunk + pos);
+                            const unsigned long long eventSize = LOG_HEADER_SIZE + messageSize;
+                            if (pos + eventSize > chunkSize)
+                                break;
+                            const unsigned char messageType = (unsigned char)(*((unsigned int*)(chunk + pos + 6)) >> 24);
+                            const unsigned long long logId = getLogId(chunk + pos);
+                            if (logId < firstUncheckedLogId)
+                            {
+                                pos += eventSize;
+                                continue;
+                            }
+                            nextLogId = logId + 1;
+                            if (matchesFilter(*request, messageType, chunk + pos + LOG_HEADER_SIZE, messageSize))
+                            {
+                                moveLogEventDown(rBuffer + responseSize, chunk + pos, eventSize);
+                                responseSize += eventSize;
+                            }
+                            pos += eventSize;
+                        }
+                        readOffset += pos;
+
+                        if (pos == 0)
+                        {
+                            if (responseSize == sizeof(RespondFilteredLog) && chunkSize >= LOG_HEADER_SIZE)
+                            {
+                                // event doesn't fit into any response, skip it
+                                readOffset += LOG_HEADER_SIZE + getLogSize(chunk);
+                                if (getLogId(chunk) >= firstUncheckedLogId)
+                                    nextLogId = getLogId(chunk) + 1;
+                                continue;
+                            }
+                            full = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (full)
+                break;
+            ++tick;
+        }
+
+        RespondFilteredLog* response = (RespondFilteredLog*)rBuffer;
+        response->nextLogId = nextLogId;
+        response->nextTick = tick;
+        response->_padding = 0;
+        enqueueResponse(peer, (unsigned int)responseSize, RespondFilteredLog::type(), header->dejavu(), rBuffer);
+        return;
+    }
+#endif
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+}
+
 void qLogger::processRequestTxLogInfo(unsigned long long processorNumber, Peer* peer, RequestResponseHeader* header)
 {
 #if ENABLED_LOGGING
@@ -150,7 +417,8 @@ void qLogger::processRequestPrunePageFile(Peer* peer, RequestResponseHeader* hea
             long long logBufferStart = bis.startIndex;
             long long logBufferEnd = bie.startIndex + bie.length;
             resp.success = 0;
-            bool res0 = mapLogIdToBufferIndex.pruneRange(fromLogId, toLogId);
+            // page files are removed in background, so pruning doesn't stall this request processor and the main loop
+            bool res0 = mapLogIdToBufferIndex.pruneRange(fromLogId, toLogId, /*background=*/true);
             if (!res0)
             {
                 resp.success = 1;
@@ -158,7 +426,7 @@ void qLogger::processRequestPrunePageFile(Peer* peer, RequestResponseHeader* hea
 
             if (logBufferEnd > logBufferStart)
             {
-                bool res1 = logBuffer.pruneRange(logBufferStart, logBufferEnd);
+                bool res1 = logBuffer.pruneRange(logBufferStart, logBufferEnd, /*background=*/true);
                 if (!res1)
                 {
                     resp.success = (resp.success << 1) | 1;
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "platform/m256.h"
+#include "platform/memory.h"
+#include "platform/assert.h"
+#include "platform/spin_lock.h"
+
+// Small cache of Merkle proofs (siblings on the path from leaf to root) of recently requested leafs, for serving
+// repeated requests for hot entities (such as exchange addresses polled by many wallets) without walking the digest
+// tree. Entries are keyed by leaf index and version of the digests (for example the value of a seqlock counter that
+// changes with each update of the tree), so entries of older versions are never returned. If the cache is full, the
+// least recently used entry is replaced.
+//
+// All functions are thread-safe. The lock is only held for scanning the entries and copying one proof.
+template <unsigned int depth, unsigned int capacity = 64>
+class MerkleSiblingsCache
+{
+public:
+    struct Statistics
+    {
+        unsigned long long hits;
+        unsigned long long misses;
+    };
+
+    // Remove all entries and reset statistics. An object with all bytes zero is also an empty cache.
+    void reset()
+    {
+        lock.reset();
+        setMem(entries, sizeof(entries), 0);
+        useCounter = 0;
+        stats.hits = 0;
+        stats.misses = 0;
+    }
+
+    // Copy siblings of leafIndex with digest version to siblings and return true if available.
+    bool get(unsigned long long leafIndex, long long version, m256i siblings[depth])
+    {
+        lock.acquire();
+        for (unsigned int i = 0; i < capacity; ++i)
+        {
+            Entry& entry = entries[i];
+            if (entry.lastUse && entry.leafIndex == leafIndex && entry.version == version)
+            {
+                copyMem(siblings, entry.siblings, sizeof(entry.siblings));
+                entry.lastUse = ++useCounter;
+                ++stats.hits;
+                lock.release();
+                return true;
+            }
+        }
+        ++stats.misses;
+        lock.release();
+        return false;
+    }
+
+    // Add siblings of leafIndex with digest version, replacing the entry of the same leaf or the least recently used
+    // entry.
+    void add(unsigned long long leafIndex, long long version, const m256i siblings[depth])
+    {
+        lock.acquire();
+        unsigned int replaced = 0;
+        for (unsigned int i = 0; i < capacity; ++i)
+        {
+            const Entry& entry = entries[i];
+            if (entry.lastUse && entry.leafIndex == leafIndex)
+            {
+                replaced = i;
+                break;
+            }
+            if (entry.lastUse < entries[replaced].lastUse)
+                replaced = i;
+        }
+        Entry& entry = entries[replaced];
+        entry.leafIndex = leafIndex;
+        entry.version = version;
+        copyMem(entry.siblings, siblings, sizeof(entry.siblings));
+        entry.lastUse = ++useCounter;
+        lock.release();
+    }
+
+    // Return statistics (may be slightly inconsistent if the cache is currently used)
+    const Statistics& getStatistics() const
+    {
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        m256i siblings[depth];
+        unsigned long long leafIndex;
+        long long version;
+        unsigned long long lastUse; // 0 = unused entry
+    };
+
+    Entry entries[capacity];
+    unsigned long long useCounter;
+    SpinLock<> lock;
+    Statistics stats;
+};
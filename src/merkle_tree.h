@@ -0,0 +1,416 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+#include "platform/m256.h"
+#include "platform/memory.h"
+#include "platform/assert.h"
+#include "platform/parallel_jobs.h"
+
+#include "kangaroo_twelve.h"
+
+// Return depth of binary Merkle tree with capacity leafs (number of levels above the leafs)
+static constexpr unsigned int merkleTreeDepth(unsigned long long capacity)
+{
+    unsigned int d = 0;
+    while ((1ULL << d) < capacity)
+        ++d;
+    return d;
+}
+
+// Binary Merkle tree over capacity leafs (capacity must be 2^N), as used for spectrum, universe, and contract
+// states. Digests are stored level by level in one array of (capacity * 2 - 1) digests: first the leaf digests,
+// then the digests of the next level, and so on, having the root as the last element. Inner node digests are
+// KangarooTwelve64To32() of the two child digests.
+//
+// Changes are tracked with one change flag per leaf. The owner of the tree computes the digests of changed
+// leafs and calls updateInnerNodes(), which only rehashes the paths from the changed leafs to the root.
+// The change flag array is reused for tracking the changed nodes of upper levels during the update.
+//
+// If the digest of an empty leaf is set with setEmptyLeafDigest(), pairs of nodes that are both roots of
+// completely empty subtrees are resolved to the precomputed digest of the empty subtree of the next level without
+// hashing. This speeds up sparse trees a lot and doesn't change the resulting digests.
+//
+// Storage is provided by the owner with init(), because the leaf hashing and the storage of digests
+// (for example in snapshot files) differ between the trees. The class is not thread-safe; locking needs
+// to be done by the owner.
+template <unsigned long long capacity>
+class IncrementalMerkleTree
+{
+public:
+    static_assert(capacity >= 2 && (capacity & (capacity - 1)) == 0, "Capacity of IncrementalMerkleTree must be 2^N");
+
+    static constexpr unsigned int depth = merkleTreeDepth(capacity);
+    static constexpr unsigned long long digestCount = capacity * 2 - 1;
+    static constexpr unsigned long long digestsSizeInBytes = digestCount * sizeof(m256i);
+    static constexpr unsigned long long changeFlagWords = (capacity + 63) / 64;
+    static constexpr unsigned long long changeFlagsSizeInBytes = changeFlagWords * sizeof(unsigned long long);
+
+    // Set storage of digests (digestsSizeInBytes) and change flags (changeFlagsSizeInBytes). Does not init memory.
+    void init(m256i* digestStorage, unsigned long long* changeFlagStorage)
+    {
+        ASSERT(digestStorage && changeFlagStorage);
+        digests = digestStorage;
+        changeFlags = changeFlagStorage;
+    }
+
+    // Reset storage pointers
+    void deinit()
+    {
+        digests = nullptr;
+        changeFlags = nullptr;
+        hasEmptyDigests = false;
+    }
+
+    // Precompute digests of empty subtrees of each level from the digest of an empty leaf and enable skipping
+    // hashing of empty subtrees in updateInnerNodes() and rebuildInnerNodes().
+    void setEmptyLeafDigest(const m256i& emptyLeafDigest)
+    {
+        emptyDigests[0] = emptyLeafDigest;
+        for (unsigned int level = 1; level <= depth; level++)
+        {
+            const m256i pair[2] = { emptyDigests[level - 1], emptyDigests[level - 1] };
+            KangarooTwelve64To32(pair, &emptyDigests[level]);
+        }
+        hasEmptyDigests = true;
+    }
+
+    // Return digest of empty subtree with root in given level (leaf level is 0, requires setEmptyLeafDigest())
+    const m256i& emptyDigest(unsigned int level) const
+    {
+        ASSERT(hasEmptyDigests && level <= depth);
+        return emptyDigests[level];
+    }
+
+    // Return array of all digests
+    m256i* getDigests() const
+    {
+        return digests;
+    }
+
+    // Return digest of leaf (to be set by the owner for changed leafs before calling updateInnerNodes())
+    m256i& leafDigest(unsigned long long leafIndex)
+    {
+        ASSERT(leafIndex < capacity);
+        return digests[leafIndex];
+    }
+
+    // Return digest of node in given level (leaf level is 0). Up to date if no leaf below the node is flagged as
+    // changed.
+    const m256i& nodeDigest(unsigned int level, unsigned long long nodeIndex) const
+    {
+        ASSERT(level <= depth && nodeIndex < (capacity >> level));
+        return digests[2 * capacity - 2 * (capacity >> level) + nodeIndex];
+    }
+
+    // Return root digest (valid after updateInnerNodes() or rebuildInnerNodes())
+    const m256i& root() const
+    {
+        return digests[digestCount - 1];
+    }
+
+    // Flag leaf as changed
+    void markLeafChanged(unsigned long long leafIndex)
+    {
+        ASSERT(leafIndex < capacity);
+        changeFlags[leafIndex >> 6] |= (1ULL << (leafIndex & 63));
+    }
+
+    // Check if leaf is flagged as changed
+    bool isLeafChanged(unsigned long long leafIndex) const
+    {
+        ASSERT(leafIndex < capacity);
+        return (changeFlags[leafIndex >> 6] >> (leafIndex & 63)) & 1;
+    }
+
+    // Flag all leafs as changed
+    void markAllLeafsChanged()
+    {
+        setMem(changeFlags, changeFlagsSizeInBytes, 0xFF);
+    }
+
+    // Reset all change flags
+    void clearChangeFlags()
+    {
+        setMem(changeFlags, changeFlagsSizeInBytes, 0);
+    }
+
+    // Return whether any leaf in [beginIndex, endIndex) is flagged as changed.
+    bool anyLeafChanged(unsigned long long beginIndex, unsigned long long endIndex) const
+    {
+        ASSERT(beginIndex <= endIndex && endIndex <= capacity);
+        for (unsigned long long i = beginIndex; i < endIndex; )
+        {
+            const unsigned long long wordIndex = i >> 6;
+            const unsigned long long wordEnd = (wordIndex + 1) << 6;
+            unsigned long long bits = changeFlags[wordIndex] & (0xFFFFFFFFFFFFFFFFULL << (i & 63));
+            if (endIndex < wordEnd)
+                bits &= (1ULL << (endIndex & 63)) - 1;
+            if (bits)
+                return true;
+            i = wordEnd;
+        }
+        return false;
+    }
+
+    // Return index of first changed leaf >= beginIndex or capacity if there is none. Skips 64 unchanged leafs
+    // per step.
+    unsigned long long findNextChangedLeaf(unsigned long long beginIndex) const
+    {
+        if (beginIndex >= capacity)
+            return capacity;
+        unsigned long long wordIndex = beginIndex >> 6;
+        unsigned long long bits = changeFlags[wordIndex] & (0xFFFFFFFFFFFFFFFFULL << (beginIndex & 63));
+        while (!bits)
+        {
+            if (++wordIndex >= changeFlagWords)
+                return capacity;
+            bits = changeFlags[wordIndex];
+        }
+        return (wordIndex << 6) + _tzcnt_u64(bits);
+    }
+
+    // Rehash inner nodes on the paths from changed leafs to the root and reset all change flags. The digests of
+    // the changed leafs have to be up to date before. Unchanged words of the change flags are skipped.
+    void updateInnerNodes()
+    {
+        KangarooTwelve64To32Batcher batcher;
+        unsigned long long previousLevelBeginning = 0;
+        unsigned long long levelBeginning = capacity;
+        unsigned long long numberOfLeafs = capacity;
+        unsigned int level = 0;
+        while (numberOfLeafs > 1)
+        {
+            const unsigned long long wordCount = (numberOfLeafs + 63) / 64;
+            for (unsigned long long wordIndex = 0; wordIndex < wordCount; wordIndex++)
+            {
+                const unsigned long long bits = changeFlags[wordIndex];
+                if (!bits)
+                    continue;
+                changeFlags[wordIndex] = 0;
+
+                // One bit per pair of siblings with at least one changed node (at position of even node)
+                unsigned long long pairs = (bits | (bits >> 1)) & 0x5555555555555555ULL;
+                unsigned long long parentBits = 0;
+                while (pairs)
+                {
+                    const unsigned long long bit = _tzcnt_u64(pairs);
+                    pairs &= pairs - 1;
+                    const unsigned long long nodeIndex = (wordIndex << 6) + bit;
+                    hashPair(batcher, &digests[previousLevelBeginning + nodeIndex], &digests[levelBeginning + (nodeIndex >> 1)], level);
+                    parentBits |= (1ULL << (bit >> 1));
+                }
+
+                // Flags of parents are stored in word that has already been processed in this level
+                changeFlags[wordIndex >> 1] |= parentBits << ((wordIndex & 1) * 32);
+            }
+
+            // Digests of this level are input of the next level
+            batcher.flush();
+
+            previousLevelBeginning = levelBeginning;
+            numberOfLeafs >>= 1;
+            levelBeginning += numberOfLeafs;
+            ++level;
+        }
+        changeFlags[0] = 0;
+    }
+
+    // Recompute all inner nodes from the leaf digests and reset all change flags. Levels are split into chunks
+    // that are processed by idle processors in parallel (see ParallelJobs).
+    void rebuildInnerNodes()
+    {
+        LevelJob job{ this, 0, capacity, 0 };
+        unsigned long long numberOfLeafs = capacity;
+        while (numberOfLeafs > 1)
+        {
+            const unsigned long long numberOfDigests = numberOfLeafs >> 1;
+            parallelJobs.run(computeLevelDigests, &job, numberOfDigests, parallelChunkSize);
+
+            job.previousLevelBeginning = job.levelBeginning;
+            job.levelBeginning += numberOfDigests;
+            ++job.level;
+            numberOfLeafs = numberOfDigests;
+        }
+        clearChangeFlags();
+    }
+
+    // Compute the siblings of each level on the path from leaf to root (same as getSiblings()).
+    void getSiblings(unsigned long long leafIndex, m256i siblings[depth]) const
+    {
+        ASSERT(leafIndex < capacity);
+        unsigned long long siblingIndex = leafIndex;
+        unsigned long long digestOffset = 0;
+        for (unsigned int j = 0; j < depth; j++)
+        {
+            siblings[j] = digests[digestOffset + (siblingIndex ^ 1)];
+            digestOffset += (capacity >> j);
+            siblingIndex >>= 1;
+        }
+    }
+
+    // Compute the siblings of each level on the path from the node nodeIndex of the given level (leaf level is 0) to the
+    // root, which are depth - level digests. This is the proof of the complete subtree of 2^level leafs starting at leaf
+    // nodeIndex << level (see verifyMerkleSubtree()).
+    void getSubtreeSiblings(unsigned long long nodeIndex, unsigned int level, m256i* siblings) const
+    {
+        ASSERT(level <= depth && nodeIndex < (capacity >> level));
+        unsigned long long digestOffset = 0;
+        for (unsigned int j = 0; j < level; j++)
+            digestOffset += (capacity >> j);
+        for (unsigned int j = level; j < depth; j++)
+        {
+            siblings[j - level] = digests[digestOffset + (nodeIndex ^ 1)];
+            digestOffset += (capacity >> j);
+            nodeIndex >>= 1;
+        }
+    }
+
+    // Compute the siblings needed for verifying multiple leafs at once (multiproof), which are much less than
+    // count * depth siblings if the leafs are close to each other. leafIndices must be sorted in ascending order
+    // without duplicates and is overwritten. Siblings are written level by level starting with the leaf level, in
+    // ascending order of node index within each level. Return number of siblings (at most count * depth).
+    unsigned int getMultiproofSiblings(unsigned long long* leafIndices, unsigned int count, m256i* siblings) const
+    {
+        unsigned int siblingCount = 0;
+        unsigned long long digestOffset = 0;
+        for (unsigned int j = 0; j < depth; j++)
+        {
+            // Nodes of the next level are written to the beginning of leafIndices (never ahead of reading position)
+            unsigned int parentCount = 0;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const unsigned long long nodeIndex = leafIndices[i];
+                ASSERT(nodeIndex < (capacity >> j));
+                if (!(nodeIndex & 1) && i + 1 < count && leafIndices[i + 1] == nodeIndex + 1)
+                {
+                    // Sibling is known to the verifier, because it is on the path of another leaf
+                    i++;
+                }
+                else
+                {
+                    siblings[siblingCount++] = digests[digestOffset + (nodeIndex ^ 1)];
+                }
+                leafIndices[parentCount++] = nodeIndex >> 1;
+            }
+            count = parentCount;
+            digestOffset += (capacity >> j);
+        }
+        return siblingCount;
+    }
+
+    // Number of digests hashed per chunk in parallel rebuild
+    static constexpr unsigned long long parallelChunkSize = 65536;
+
+protected:
+    struct LevelJob
+    {
+        IncrementalMerkleTree* tree;
+        unsigned long long previousLevelBeginning;
+        unsigned long long levelBeginning;
+        unsigned int level;
+    };
+
+    // Hash pair of child digests into parent digest or set digest of empty subtree if both children are empty
+    void hashPair(KangarooTwelve64To32Batcher& batcher, const m256i* children, m256i* parent, unsigned int childLevel) const
+    {
+        if (hasEmptyDigests && children[0] == emptyDigests[childLevel] && children[1] == emptyDigests[childLevel])
+            *parent = emptyDigests[childLevel + 1];
+        else
+            batcher.add(children, parent);
+    }
+
+    // Hash pairs of digests of previous level into digests [begin, end) of current level (ParallelJobs::ChunkFunction)
+    static void computeLevelDigests(void* context, unsigned long long begin, unsigned long long end)
+    {
+        const LevelJob* job = (const LevelJob*)context;
+        m256i* children = &job->tree->digests[job->previousLevelBeginning + 2 * begin];
+        m256i* parents = &job->tree->digests[job->levelBeginning + begin];
+        if (!job->tree->hasEmptyDigests)
+        {
+            KangarooTwelve64To32Batch(children, parents, end - begin);
+            return;
+        }
+
+        KangarooTwelve64To32Batcher batcher;
+        for (unsigned long long i = 0; i < end - begin; i++)
+        {
+            job->tree->hashPair(batcher, &children[2 * i], &parents[i], job->level);
+        }
+        batcher.flush();
+    }
+
+    m256i* digests = nullptr;
+    unsigned long long* changeFlags = nullptr;
+    m256i emptyDigests[depth + 1];
+    bool hasEmptyDigests = false;
+};
+
+// Compute the root digest of the complete subtree with the given count = 2^N leaf digests.
+static void computeMerkleSubtreeRoot(const m256i* leafDigests, unsigned long long count, m256i& root)
+{
+    ASSERT(count && !(count & (count - 1)));
+
+    // Keep the roots of the completed smaller subtrees on a stack (at most one per level)
+    m256i stack[64];
+    unsigned int stackLevels[64];
+    unsigned int stackSize = 0;
+    m256i pair[2];
+    for (unsigned long long i = 0; i < count; i++)
+    {
+        pair[1] = leafDigests[i];
+        unsigned int nodeLevel = 0;
+        while (stackSize && stackLevels[stackSize - 1] == nodeLevel)
+        {
+            pair[0] = stack[--stackSize];
+            m256i parent;
+            KangarooTwelve64To32(pair, &parent);
+            pair[1] = parent;
+            ++nodeLevel;
+        }
+        stack[stackSize] = pair[1];
+        stackLevels[stackSize] = nodeLevel;
+        ++stackSize;
+    }
+    ASSERT(stackSize == 1);
+    root = stack[0];
+}
+
+// Verify that the count leaf digests starting at firstLeaf belong to a Merkle tree of the given depth with the given
+// root. The leafs have to form a complete subtree (count = 2^N, firstLeaf a multiple of count) and siblings are the
+// depth - N digests returned by IncrementalMerkleTree::getSubtreeSiblings(firstLeaf >> N, N). Used for checking state
+// chunks downloaded from peers against the digests confirmed by the quorum. The leafs may also be the digests of
+// nodes of a higher level L of a tree of depth D, which are checked with depth = D - L.
+static bool verifyMerkleSubtree(const m256i* leafDigests, unsigned long long firstLeaf, unsigned long long count,
+    const m256i* siblings, unsigned int depth, const m256i& root)
+{
+    if (!count || (count & (count - 1)) || (firstLeaf & (count - 1)) || depth >= 64)
+        return false;
+    unsigned int level = 0;
+    while ((1ULL << level) < count)
+        ++level;
+    if (level > depth || (firstLeaf >> level) >= (1ULL << (depth - level)))
+        return false;
+
+    // Hash path from subtree root to root
+    m256i node;
+    computeMerkleSubtreeRoot(leafDigests, count, node);
+    m256i pair[2];
+    unsigned long long nodeIndex = firstLeaf >> level;
+    for (unsigned int j = level; j < depth; j++)
+    {
+        if (nodeIndex & 1)
+        {
+            pair[0] = siblings[j - level];
+            pair[1] = node;
+        }
+        else
+        {
+            pair[0] = node;
+            pair[1] = siblings[j - level];
+        }
+        KangarooTwelve64To32(pair, &node);
+        nodeIndex >>= 1;
+    }
+    return node == root;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "platform/memory_util.h"
+#include "platform/assert.h"
+#include "platform/file_io.h"
+
+// Set of the flag indices (hash of miner public key, mining seed, and nonce) of the solutions processed in the current
+// epoch, for processing each solution only once.
+//
+// The flags are stored in a bitmap of flagCount bits, which gives exact lookup for any number of solutions (buffers
+// can only be allocated at startup, so the set cannot grow later). Only a tiny fraction of the bits is set in
+// practice, so the indices of the set flags are also recorded in a list. As long as the list hasn't overflown,
+// reset(), save(), and load() only touch the set flags instead of the whole bitmap.
+//
+// set() and reset() may only be called by one processor at a time (the tick processor), isSet() by any processor.
+template <unsigned long long flagCount, unsigned int listCapacity>
+class MinerSolutionFlags
+{
+    static_assert(flagCount % 64 == 0, "flagCount must be a multiple of 64");
+
+public:
+    static constexpr unsigned long long bitmapSize = flagCount / 8;
+
+    bool init()
+    {
+        // each buffer is preceded by the number of set flags when saved to a file
+        if (!allocPoolWithErrorLog(L"minerSolutionFlags", sizeof(unsigned long long) + bitmapSize, (void**)&bitmapBuffer, __LINE__)
+            || !allocPoolWithErrorLog(L"minerSolutionFlagList", sizeof(unsigned long long) + listCapacity * sizeof(unsigned int), (void**)&listBuffer, __LINE__))
+        {
+            return false;
+        }
+        bitmap = (unsigned long long*)(bitmapBuffer + sizeof(unsigned long long));
+        list = (unsigned int*)(listBuffer + sizeof(unsigned long long));
+        count = 0;
+        return true;
+    }
+
+    void deinit()
+    {
+        if (bitmapBuffer)
+        {
+            freePool(bitmapBuffer);
+            bitmapBuffer = nullptr;
+            bitmap = nullptr;
+        }
+        if (listBuffer)
+        {
+            freePool(listBuffer);
+            listBuffer = nullptr;
+            list = nullptr;
+        }
+    }
+
+    // Clear all flags (only the flags in the list, unless it has overflown).
+    void reset()
+    {
+        if (count <= listCapacity)
+        {
+            for (unsigned long long i = 0; i < count; ++i)
+                bitmap[list[i] >> 6] = 0;
+        }
+        else
+        {
+            setMem(bitmap, bitmapSize, 0);
+        }
+        count = 0;
+    }
+
+    bool isSet(unsigned long long flagIndex) const
+    {
+        ASSERT(flagIndex < flagCount);
+        return (bitmap[flagIndex >> 6] & (1ULL << (flagIndex & 63))) != 0;
+    }
+
+    // Set flag. Returns false if it was already set.
+    bool set(unsigned long long flagIndex)
+    {
+        ASSERT(flagIndex < flagCount);
+        if (isSet(flagIndex))
+            return false;
+        bitmap[flagIndex >> 6] |= (1ULL << (flagIndex & 63));
+        if (count < listCapacity)
+            list[count] = (unsigned int)flagIndex;
+        ++count;
+        return true;
+    }
+
+    // Return number of set flags
+    unsigned long long getCount() const
+    {
+        return count;
+    }
+
+    // Save set flags to file: number of flags followed by the list of flag indices, or by the bitmap if the list has
+    // overflown. Returns false on error.
+    bool save(const CHAR16* fileName, const CHAR16* directory = NULL)
+    {
+        unsigned char* buffer;
+        unsigned long long size;
+        if (count <= listCapacity)
+        {
+            buffer = listBuffer;
+            size = sizeof(unsigned long long) + count * sizeof(unsigned int);
+        }
+        else
+        {
+            buffer = bitmapBuffer;
+            size = sizeof(unsigned long long) + bitmapSize;
+        }
+        *(unsigned long long*)buffer = count;
+        return ::save(fileName, size, buffer, directory) == (long long)size;
+    }
+
+    // Load flags saved with save(). Returns false on error.
+    bool load(const CHAR16* fileName, const CHAR16* directory = NULL)
+    {
+        setMem(bitmap, bitmapSize, 0);
+        count = 0;
+        const long long loadedSize = loadUpTo(fileName, sizeof(unsigned long long) + listCapacity * sizeof(unsigned int), listBuffer, directory);
+        if (loadedSize < (long long)sizeof(unsigned long long))
+            return false;
+        const unsigned long long loadedCount = *(unsigned long long*)listBuffer;
+        if (loadedCount <= listCapacity)
+        {
+            if (loadedSize != (long long)(sizeof(unsigned long long) + loadedCount * sizeof(unsigned int)))
+                return false;
+            for (unsigned long long i = 0; i < loadedCount; ++i)
+            {
+                if (list[i] >= flagCount || !set(list[i]))
+                {
+                    reset();
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            if (loadedCount > flagCount
+                || ::load(fileName, sizeof(unsigned long long) + bitmapSize, bitmapBuffer, directory) != (long long)(sizeof(unsigned long long) + bitmapSize))
+            {
+                setMem(bitmap, bitmapSize, 0);
+                return false;
+            }
+            count = loadedCount;
+        }
+        return true;
+    }
+
+private:
+    unsigned char* bitmapBuffer;
+    unsigned char* listBuffer;
+    unsigned long long* bitmap;
+    unsigned int* list;
+    unsigned long long count;
+};
@@ -7,6 +7,7 @@
 #include "network_messages/custom_mining.h"
 #include "network_messages/transactions.h"
 #include "kangaroo_twelve.h"
+#include "ten_bit_packing.h"
 
 #include <lib/platform_efi/uefi.h>
 
@@ -141,30 +142,11 @@ private:
 protected:
     unsigned int extract10Bit(const unsigned char* data, unsigned int idx)
     {
-        //TODO: simplify this
-        unsigned int byte0 = data[idx + (idx >> 2)];
-        unsigned int byte1 = data[idx + (idx >> 2) + 1];
-        unsigned int last_bit0 = 8 - (idx & 3) * 2;
-        unsigned int first_bit1 = 10 - last_bit0;
-        unsigned int res = (byte0 & ((1 << last_bit0) - 1)) << first_bit1;
-        res |= (byte1 >> (8 - first_bit1));
-        return res;
+        return read10Bit(data, idx);
     }
     void update10Bit(unsigned char* data, unsigned int idx, unsigned int value)
     {
-        //TODO: simplify this
-        unsigned char& byte0 = data[idx + (idx >> 2)];
-        unsigned char& byte1 = data[idx + (idx >> 2) + 1];
-        unsigned int last_bit0 = 8 - (idx & 3) * 2;
-        unsigned int first_bit1 = 10 - last_bit0;
-        unsigned char mask0 = ~((1 << last_bit0) - 1);
-        unsigned char mask1 = ((1 << (8 - first_bit1)) - 1);
-        byte0 &= mask0;
-        byte1 &= mask1;
-        unsigned char ubyte0 = (value >> first_bit1);
-        unsigned char ubyte1 = (value & ((1 << first_bit1) - 1)) << (8 - first_bit1);
-        byte0 |= ubyte0;
-        byte1 |= ubyte1;
+        write10Bit(data, idx, value);
     }
 
     void accumulateSharesCount(unsigned int computorIdx, unsigned int value)
@@ -208,10 +190,7 @@ public:
         }
 
         _buffer[ownComputorIdx] = 0; // remove self-report
-        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-        {
-            update10Bit(customMiningShareCountPacket, i, _buffer[i]);
-        }
+        pack10BitArray(_buffer, customMiningShareCountPacket, NUMBER_OF_COMPUTORS);
     }
 
     bool validateNewSharesPacket(const unsigned char* customMiningShareCountPacket, unsigned int computorIdx)
@@ -228,10 +207,10 @@ public:
     {
         if (validateNewSharesPacket(newSharePacket, computorIdx))
         {
+            unpack10BitArray(newSharePacket, _buffer, NUMBER_OF_COMPUTORS);
             for (int i = 0; i < NUMBER_OF_COMPUTORS; i++)
             {
-                unsigned int shareCount = extract10Bit(newSharePacket, i);
-                accumulateSharesCount(i, shareCount);
+                accumulateSharesCount(i, _buffer[i]);
             }
         }
     }
@@ -284,21 +263,30 @@ public:
     }
 };
 
-/// Cache storing scores for custom mining data (hash map)
 static constexpr int CUSTOM_MINING_CACHE_MISS = -1;
 static constexpr int CUSTOM_MINING_CACHE_COLLISION = -2;
 static constexpr int CUSTOM_MINING_CACHE_HIT = -3;
 
+/// Cache storing scores for custom mining data (hash map)
+///
+/// The table is split into shards of consecutive entries with one lock each (same as ScoreCache), so request
+/// processors recording and verifying solutions in parallel rarely wait for each other. Probing for collisions wraps
+/// around within the shard of the hashed index, so each access only needs the lock of one shard.
 template <typename T, unsigned int size, unsigned int collisionRetries = 20>
 class CustomMininingCache
 {
     static_assert(collisionRetries < size, "Number of fetch retries in case of collision is too big!");
+
+    static constexpr unsigned int maxShardCount = 1024;
+    static constexpr unsigned int shardSize = (size + maxShardCount - 1) / maxShardCount;
+    static constexpr unsigned int shardCount = (size + shardSize - 1) / shardSize;
+
 public:
 
     void init()
     {
         setMem((unsigned char*)cache, sizeof(cache), 0);
-        lock = 0;
+        setMem((void*)shardLocks, sizeof(shardLocks), 0);
         hits = 0;
         misses = 0;
         collisions = 0;
@@ -309,12 +297,12 @@ public:
     /// Reset all cache entries
     void reset()
     {
-        ACQUIRE(lock);
+        acquireAllShards();
         setMem((unsigned char*)cache, sizeof(cache), 0);
         hits = 0;
         misses = 0;
         collisions = 0;
-        RELEASE(lock);
+        releaseAllShards();
     }
 
     /// Return maximum number of entries that can be stored in cache
@@ -333,100 +321,112 @@ public:
     void getEntry(T& rData, unsigned int cacheIndex)
     {
         cacheIndex %= capacity();
-        ACQUIRE(lock);
+        const unsigned int shard = cacheIndex / shardSize;
+        ACQUIRE(shardLocks[shard]);
         rData = cache[cacheIndex];
-        RELEASE(lock);
+        RELEASE(shardLocks[shard]);
     }
 
     // Try to fetch data from cacheIndex, also checking a few following entries in case of collisions (may update cacheIndex),
     // increments counter of hits, misses, or collisions
     int tryFetching(T& rData, unsigned int& cacheIndex)
     {
-        int retVal;
         unsigned int tryFetchIdx = rData.getHashIndex() % capacity();
-        ACQUIRE(lock);
-        for (unsigned int i = 0; i < collisionRetries; ++i)
-        {
-            const T& cacheData = cache[tryFetchIdx];
-            if (cacheData.isEmpty())
-            {
-                // miss: data not available in cache yet (entry is empty)
-                misses++;
-                retVal = CUSTOM_MINING_CACHE_MISS;
-                break;
-            }
-
-            if (cacheData.isMatched(rData))
-            {
-                // hit: data available in cache -> return score
-                hits++;
-                retVal = CUSTOM_MINING_CACHE_HIT;
-                break;
-            }
-
-            // collision: other data is mapped to same index -> retry at following index
-            retVal = CUSTOM_MINING_CACHE_COLLISION;
-            tryFetchIdx = (tryFetchIdx + 1) % capacity();
-        }
-        RELEASE(lock);
+        const unsigned int shard = tryFetchIdx / shardSize;
+        ACQUIRE(shardLocks[shard]);
+        const int retVal = probe(rData, tryFetchIdx, shard);
+        RELEASE(shardLocks[shard]);
 
-        if (retVal ==  CUSTOM_MINING_CACHE_COLLISION)
+        if (retVal == CUSTOM_MINING_CACHE_COLLISION)
         {
-            ACQUIRE(lock);
-            collisions++;
-            RELEASE(lock);
+            _InterlockedIncrement64(&collisions);
         }
         else
         {
+            _InterlockedIncrement64((retVal == CUSTOM_MINING_CACHE_MISS) ? &misses : &hits);
             cacheIndex = tryFetchIdx;
         }
         return retVal;
     }
 
-    // Try to fetch data from cacheIndex, also checking a few following entries in case of collisions,
-    bool tryFetchingAndUpdateHitData(T& rData)
+    // Check if data is already in cache without changing the cache or its counters
+    bool contains(T& rData)
     {
-        int retVal;
         unsigned int tryFetchIdx = rData.getHashIndex() % capacity();
-        ACQUIRE(lock);
-        for (unsigned int i = 0; i < collisionRetries; ++i)
-        {
-            const T& cacheData = cache[tryFetchIdx];
-            if (cacheData.isEmpty())
-            {
-                retVal = CUSTOM_MINING_CACHE_MISS;
-                break;
-            }
+        const unsigned int shard = tryFetchIdx / shardSize;
+        ACQUIRE(shardLocks[shard]);
+        const int retVal = probe(rData, tryFetchIdx, shard);
+        RELEASE(shardLocks[shard]);
+        return retVal == CUSTOM_MINING_CACHE_HIT;
+    }
 
-            if (cacheData.isMatched(rData))
-            {
-                retVal = CUSTOM_MINING_CACHE_HIT;
-                break;
-            }
+    // Count hits of data that has been found with contains() and is not fetched
+    void addHits(unsigned int count)
+    {
+        _InterlockedExchangeAdd64(&hits, count);
+    }
 
-            // collision: other data is mapped to same index -> retry at following index
-            retVal = CUSTOM_MINING_CACHE_COLLISION;
-            tryFetchIdx = (tryFetchIdx + 1) % capacity();
-        }
+    // Try to fetch data from cacheIndex, also checking a few following entries in case of collisions,
+    bool tryFetchingAndUpdateHitData(T& rData)
+    {
+        unsigned int tryFetchIdx = rData.getHashIndex() % capacity();
+        const unsigned int shard = tryFetchIdx / shardSize;
+        ACQUIRE(shardLocks[shard]);
+        const int retVal = probe(rData, tryFetchIdx, shard);
 
         // This allow update data with additional field beside the key
         if (retVal == CUSTOM_MINING_CACHE_HIT)
         {
             cache[tryFetchIdx] = rData;
         }
-        RELEASE(lock);
+        RELEASE(shardLocks[shard]);
 
         return (retVal == CUSTOM_MINING_CACHE_HIT);
     }
 
+    // Batch version of tryFetchingAndUpdateHitData() for count entries, setting hit[i] for each of them. Hashes are
+    // computed before taking any lock and consecutive entries of the same shard share one lock acquisition.
+    // Returns number of hits.
+    unsigned int tryFetchingAndUpdateHitData(T* data, unsigned int count, bool* hit)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+            data[i].getHashIndex();
+
+        unsigned int hitCount = 0;
+        unsigned int lockedShard = shardCount;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            unsigned int tryFetchIdx = data[i].getHashIndex() % capacity();
+            const unsigned int shard = tryFetchIdx / shardSize;
+            if (shard != lockedShard)
+            {
+                if (lockedShard < shardCount)
+                    RELEASE(shardLocks[lockedShard]);
+                ACQUIRE(shardLocks[shard]);
+                lockedShard = shard;
+            }
+            hit[i] = (probe(data[i], tryFetchIdx, shard) == CUSTOM_MINING_CACHE_HIT);
+            if (hit[i])
+            {
+                cache[tryFetchIdx] = data[i];
+                ++hitCount;
+            }
+        }
+        if (lockedShard < shardCount)
+            RELEASE(shardLocks[lockedShard]);
+
+        return hitCount;
+    }
+
 
     /// Add entry to cache (may overwrite existing entry)
     void addEntry(const T& rData, unsigned int cacheIndex)
     {
         cacheIndex %= capacity();
-        ACQUIRE(lock);
+        const unsigned int shard = cacheIndex / shardSize;
+        ACQUIRE(shardLocks[shard]);
         cache[cacheIndex] = rData;
-        RELEASE(lock);
+        RELEASE(shardLocks[shard]);
     }
 
 #ifdef NO_UEFI
@@ -435,9 +435,9 @@ public:
     void save(CHAR16* filename, CHAR16* directory = NULL)
     {
         const unsigned long long beginningTick = __rdtsc();
-        ACQUIRE(lock);
+        acquireAllShards();
         long long savedSize = ::save(filename, sizeof(cache), (unsigned char*)cache, directory);
-        RELEASE(lock);
+        releaseAllShards();
         if (savedSize == sizeof(cache))
         {
             setNumber(message, savedSize, TRUE);
@@ -453,9 +453,9 @@ public:
     {
         bool success = true;
         reset();
-        ACQUIRE(lock);
+        acquireAllShards();
         long long loadedSize = ::load(filename, sizeof(cache), (unsigned char*)cache, directory);
-        RELEASE(lock);
+        releaseAllShards();
         if (loadedSize != sizeof(cache))
         {
             if (loadedSize == -1)
@@ -481,47 +481,87 @@ public:
 #endif
 
     // Return number of hits (data available in cache when fetched)
-    unsigned int hitCount()
+    unsigned long long hitCount() const
     {
-        unsigned int result = 0;
-        ACQUIRE(lock);
-        result = hits;
-        RELEASE(lock);
-        return result;
+        return hits;
     }
 
     // Return number of misses (data not in cache yet)
-    unsigned int missCount()
+    unsigned long long missCount() const
     {
-        unsigned int result = 0;
-        ACQUIRE(lock);
-        result = misses;
-        RELEASE(lock);
-        return result;
+        return misses;
     }
 
     // Return number of collisions (other data is mapped to same index)
-    unsigned int collisionCount()
+    unsigned long long collisionCount() const
     {
-        unsigned int result = 0;
-        ACQUIRE(lock);
-        result = collisions;
-        RELEASE(lock);
-        return result;
+        return collisions;
     }
 
 private:
 
+    // Probe up to collisionRetries entries of shard starting at tryFetchIdx (updated to index of hit or empty entry).
+    // Shard lock must be held by caller.
+    int probe(const T& rData, unsigned int& tryFetchIdx, unsigned int shard) const
+    {
+        const unsigned int retries = probeCount(shard);
+        for (unsigned int i = 0; i < retries; ++i)
+        {
+            const T& cacheData = cache[tryFetchIdx];
+            if (cacheData.isEmpty())
+            {
+                // miss: data not available in cache yet (entry is empty)
+                return CUSTOM_MINING_CACHE_MISS;
+            }
+
+            if (cacheData.isMatched(rData))
+            {
+                // hit: data available in cache
+                return CUSTOM_MINING_CACHE_HIT;
+            }
+
+            // collision: other data is mapped to same index -> retry at following index
+            tryFetchIdx = nextIndexInShard(tryFetchIdx, shard);
+        }
+        return CUSTOM_MINING_CACHE_COLLISION;
+    }
+
+    // Number of entries to probe in shard, which may be smaller than collisionRetries for the last shard
+    static unsigned int probeCount(unsigned int shard)
+    {
+        const unsigned int end = (shard + 1) * shardSize;
+        const unsigned int entriesInShard = ((end < size) ? end : size) - shard * shardSize;
+        return (entriesInShard < collisionRetries) ? entriesInShard : collisionRetries;
+    }
+
+    static unsigned int nextIndexInShard(unsigned int index, unsigned int shard)
+    {
+        ++index;
+        return (index == size || index == (shard + 1) * shardSize) ? shard * shardSize : index;
+    }
+
+    void acquireAllShards()
+    {
+        for (unsigned int i = 0; i < shardCount; ++i)
+            ACQUIRE(shardLocks[i]);
+    }
+
+    void releaseAllShards()
+    {
+        for (unsigned int i = 0; i < shardCount; ++i)
+            RELEASE(shardLocks[i]);
+    }
+
     // cache entries (set zero or load from a file on init)
     T cache[size];
 
-    // lock to prevent race conditions on parallel access
-    volatile char lock;
+    // locks to prevent race conditions on parallel access, one per shard of shardSize entries
+    volatile char shardLocks[shardCount];
 
     // statistics of hits, misses, and collisions
-    unsigned int hits;
-    unsigned int misses;
-    unsigned int collisions;
+    volatile long long hits;
+    volatile long long misses;
+    volatile long long collisions;
 
     // statistics of verification and invalid count
     unsigned int verification;
@@ -766,7 +806,9 @@ public:
         BUFFER_FULL = 2,
         UNKNOWN_ERROR = 3,
     };
-    void init()
+    // Per-processor buffers are only needed for getSerializedData(timeStamp, processorNumber). Storages that are
+    // only queried with copyData() can skip them.
+    void init(bool allocateProcessorBuffers = true)
     {
         allocPoolWithErrorLog(L"CustomMiningSortedStorageData", maxItems * sizeof(DataType), (void**)&_data, __LINE__);
         allocPoolWithErrorLog(L"CustomMiningSortedStorageIndices", maxItems * sizeof(unsigned long long), (void**)&_indices, __LINE__);
@@ -775,7 +817,11 @@ public:
         // Buffer allocation for each processors. It is limited to 10MB each
         for (unsigned int i = 0; i < MAX_NUMBER_OF_PROCESSORS; i++)
         {
-            allocPoolWithErrorLog(L"CustomMiningSortedStorageProcBuffer", CUSTOM_MINING_STORAGE_PROCESSOR_MAX_STORAGE, (void**)&_dataBuffer[i], __LINE__);
+            _dataBuffer[i] = NULL;
+            if (allocateProcessorBuffers)
+            {
+                allocPoolWithErrorLog(L"CustomMiningSortedStorageProcBuffer", CUSTOM_MINING_STORAGE_PROCESSOR_MAX_STORAGE, (void**)&_dataBuffer[i], __LINE__);
+            }
         }
     }
 
@@ -797,6 +843,7 @@ public:
             if (NULL != _dataBuffer[i])
             {
                 freePool(_dataBuffer[i]);
+                _dataBuffer[i] = NULL;
             }
         }
     }
@@ -950,30 +997,15 @@ public:
         return _storageIndex;
     }
 
-    // Packed array of data to a serialized data
-    unsigned char* getSerializedData(
-        unsigned long long fromTimeStamp, 
+    // Copy the items with fromTimeStamp <= taskIndex < toTimeStamp (all items from fromTimeStamp on if toTimeStamp
+    // is 0 or less than fromTimeStamp) directly to buffer, at most maxItemCount items. Returns the number of items
+    // copied.
+    unsigned long long copyData(
+        unsigned long long fromTimeStamp,
         unsigned long long toTimeStamp,
-        unsigned long long processorNumber)
+        unsigned char* buffer,
+        unsigned long long maxItemCount)
     {
-        unsigned char* pData = _dataBuffer[processorNumber];
-
-        // 8 bytes for the item size
-        CustomMiningRespondDataHeader* pHeader = (CustomMiningRespondDataHeader*)pData;
-
-        // Init the header as an empty data
-        pHeader->itemCount = 0;
-        pHeader->itemSize = 0;
-        pHeader->fromTimeStamp = CUSTOM_MINING_INVALID_INDEX;
-        pHeader->toTimeStamp = CUSTOM_MINING_INVALID_INDEX;
-
-        // Remainder of the data
-        pData += sizeof(CustomMiningRespondDataHeader);
-
-        // Fill the header/
-        constexpr long long remainedSize = CUSTOM_MINING_STORAGE_PROCESSOR_MAX_STORAGE - sizeof(CustomMiningRespondDataHeader);
-        constexpr long long maxReturnItems = remainedSize / sizeof(DataType);
-
         // Look for the first task index
         unsigned long long startIndex = 0;
         if (fromTimeStamp > 0)
@@ -983,7 +1015,7 @@ public:
 
         if (startIndex == CUSTOM_MINING_INVALID_INDEX)
         {
-            return NULL;
+            return 0;
         }
 
         // Check for the range of task
@@ -1001,29 +1033,14 @@ public:
             }
         }
 
-        unsigned long long respondTaskCount = endIndex - startIndex;
-        if (respondTaskCount == 0)
+        unsigned long long respondTaskCount = (endIndex > startIndex) ? endIndex - startIndex : 0;
+        respondTaskCount = (maxItemCount < respondTaskCount) ? maxItemCount : respondTaskCount;
+        for (unsigned long long i = 0; i < respondTaskCount; i++, buffer += sizeof(DataType))
         {
-            return NULL;
+            copyMem(buffer, getDataByIndex(startIndex + i), sizeof(DataType));
         }
 
-        // Pack data into respond
-        respondTaskCount = (maxReturnItems < respondTaskCount) ? maxReturnItems : respondTaskCount;
-        for (unsigned long long i = 0; i < respondTaskCount; i++, pData += sizeof(DataType))
-        {
-            unsigned long long index = startIndex + i;
-            DataType* pItemData = getDataByIndex(index);
-            copyMem(pData, pItemData, sizeof(DataType));
-        }
-
-        pHeader->itemCount = respondTaskCount;
-        pHeader->itemSize = sizeof(DataType);
-
-        pHeader->fromTimeStamp = fromTimeStamp;
-        pHeader->toTimeStamp = getDataByIndex(startIndex + respondTaskCount - 1)->taskIndex;
-
-        // Return the pointer to the data
-        return _dataBuffer[processorNumber];
+        return respondTaskCount;
     }
 
     // Packed array of data to a serialized data
@@ -1119,7 +1136,7 @@ class CustomMiningStorage
 public:
     void init()
     {
-        _taskV2Storage.init();
+        _taskV2Storage.init(false);
         _solutionV2Storage.init();
         // Buffer allocation for each processors. It is limited to 10MB each
         for (unsigned int i = 0; i < MAX_NUMBER_OF_PROCESSORS; i++)
@@ -1167,25 +1184,10 @@ public:
         packedHeader->toTimeStamp = toTimeStamp;
         packedHeader->itemCount = 0;
 
+        // Copy the tasks directly into the response buffer, so the caller holds the task storage lock for a single copy
         unsigned char* traverseData = packedData + sizeof(CustomMiningRespondDataHeader);
-        unsigned char* data = _taskV2Storage.getSerializedData(fromTimeStamp, toTimeStamp, processorNumber);
-        if (data != NULL)
-        {
-            CustomMiningRespondDataHeader* customMiningInternalHeader = (CustomMiningRespondDataHeader*)data;
-            ASSERT(packedHeader->itemSize == customMiningInternalHeader->itemSize);
-            unsigned long long dataSize = customMiningInternalHeader->itemCount * sizeof(CustomMiningTaskV2);
-            if (customMiningInternalHeader->itemCount > 0 && remainedSize >= dataSize)
-            {
-                packedHeader->itemCount += customMiningInternalHeader->itemCount;
-                // Copy data
-                copyMem(traverseData, data + sizeof(CustomMiningRespondDataHeader), dataSize);
-
-                // Update pointer and size
-                traverseData += dataSize;
-                remainedSize -= dataSize;
-            }
-        }
-        
+        remainedSize -= sizeof(CustomMiningRespondDataHeader);
+        packedHeader->itemCount = _taskV2Storage.copyData(fromTimeStamp, toTimeStamp, traverseData, remainedSize / sizeof(CustomMiningTaskV2));
 
         return packedData;
     }
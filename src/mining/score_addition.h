@@ -80,10 +80,14 @@ struct ScoreAddition
     alignas(64) char neuronValuesBuffer0[maxNumberOfNeurons * PADDED_SAMPLES];
     alignas(64) char neuronValuesBuffer1[maxNumberOfNeurons * PADDED_SAMPLES];
 
-    // Incoming synapses
+    // Incoming synapses. Sources connected with weight +1 are stored from the beginning of the slot of the target
+    // neuron and sources connected with weight -1 from its end, so ticks only add and subtract neuron values.
     alignas(64) unsigned int incomingSource[maxNumberOfNeurons * maxNumberOfNeighbors];
-    alignas(64) Synapse incomingSynapses[maxNumberOfNeurons * maxNumberOfNeighbors];
-    unsigned int incomingCount[maxNumberOfNeurons];
+    unsigned int incomingPositiveCount[maxNumberOfNeurons];
+    unsigned int incomingNegativeCount[maxNumberOfNeurons];
+
+    // Max number of neuron values (-1, 0, 1) that can be summed in int8 lanes without overflow
+    static constexpr unsigned int maxInt8Terms = 127;
 
     // For tracking/compacting sample after each tick
     alignas(64) unsigned int sampleMapping[PADDED_SAMPLES];
@@ -589,31 +593,32 @@ struct ScoreAddition
             if (neuronTypes[targetNeuron] == INPUT_NEURON_TYPE)
                 continue;
 
-            unsigned int numIncoming = incomingCount[targetNeuron];
-            const unsigned long long targetNeuronOffset = targetNeuron * maxNumberOfNeighbors;
+            const unsigned int numPositive = incomingPositiveCount[targetNeuron];
+            const unsigned int numNegative = incomingNegativeCount[targetNeuron];
+            const unsigned int* positiveSources = &incomingSource[targetNeuron * maxNumberOfNeighbors];
+            const unsigned int* negativeSources = positiveSources + maxNumberOfNeighbors - numNegative;
             for (unsigned long long s = 0; s < activeSamplePad; s += BATCH_SIZE)
             {
                 __m512i acc0 = _mm512_setzero_si512();  // samples 0-31 (int16)
                 __m512i acc1 = _mm512_setzero_si512();  // samples 32-63 (int16)
-                for (unsigned int i = 0; i < numIncoming; i++)
-                {
-                    unsigned int srcNeuron = incomingSource[targetNeuronOffset + i];
-                    __m512i weight512 = _mm512_set1_epi8(incomingSynapses[targetNeuronOffset + i]);
-
-                    // Load 64 source neuron values
-                    //__m512i srcValues = _mm512_load_si512((__m512i*)&neuronValues[srcNeuron][s]);
-                    __m512i srcValues = _mm512_loadu_si512((__m512i*)&prevNeuronValues[srcNeuron * PADDED_SAMPLES + s]);
 
-                    __mmask64 negMask = _mm512_movepi8_mask(weight512);
-                    __m512i negated = _mm512_sub_epi8(_mm512_setzero_si512(), srcValues);
-                    __m512i product = _mm512_mask_blend_epi8(negMask, srcValues, negated);
-
-                    // Sign-extend char to int16 and accumulate
-                    __m256i lo = _mm512_extracti64x4_epi64(product, 0);
-                    __m256i hi = _mm512_extracti64x4_epi64(product, 1);
+                // Sum up to maxInt8Terms source values in int8, then sign-extend to int16 and accumulate
+                for (unsigned int begin = 0; begin < numPositive + numNegative; begin += maxInt8Terms)
+                {
+                    const unsigned int end = (begin + maxInt8Terms < numPositive + numNegative) ? begin + maxInt8Terms : numPositive + numNegative;
+                    __m512i sum = _mm512_setzero_si512();
+                    unsigned int i = begin;
+                    for (; i < end && i < numPositive; i++)
+                    {
+                        sum = _mm512_add_epi8(sum, _mm512_loadu_si512((__m512i*)&prevNeuronValues[positiveSources[i] * PADDED_SAMPLES + s]));
+                    }
+                    for (; i < end; i++)
+                    {
+                        sum = _mm512_sub_epi8(sum, _mm512_loadu_si512((__m512i*)&prevNeuronValues[negativeSources[i - numPositive] * PADDED_SAMPLES + s]));
+                    }
 
-                    acc0 = _mm512_add_epi16(acc0, _mm512_cvtepi8_epi16(lo));
-                    acc1 = _mm512_add_epi16(acc1, _mm512_cvtepi8_epi16(hi));
+                    acc0 = _mm512_add_epi16(acc0, _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(sum, 0)));
+                    acc1 = _mm512_add_epi16(acc1, _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(sum, 1)));
                 }
 
                 // Clamp to [-1, 1]
@@ -642,29 +647,32 @@ struct ScoreAddition
             if (neuronTypes[targetNeuron] == INPUT_NEURON_TYPE)
                 continue;
 
-            unsigned int numIncoming = incomingCount[targetNeuron];
-            const unsigned long long targetNeuronOffset = targetNeuron * maxNumberOfNeighbors;
+            const unsigned int numPositive = incomingPositiveCount[targetNeuron];
+            const unsigned int numNegative = incomingNegativeCount[targetNeuron];
+            const unsigned int* positiveSources = &incomingSource[targetNeuron * maxNumberOfNeighbors];
+            const unsigned int* negativeSources = positiveSources + maxNumberOfNeighbors - numNegative;
             for (unsigned long long s = 0; s < activeSamplePad; s += BATCH_SIZE)
             {
                 __m256i acc0 = _mm256_setzero_si256();  // samples 0-15 (int16)
                 __m256i acc1 = _mm256_setzero_si256();  // samples 16-31 (int16)
-                for (unsigned int i = 0; i < numIncoming; i++)
-                {
-                    unsigned int srcNeuron = incomingSource[targetNeuronOffset + i];
-                    __m256i weight256 = _mm256_set1_epi8(incomingSynapses[targetNeuronOffset + i]);
-
-                    // Load 32 source neuron values
-                    __m256i srcValues = _mm256_loadu_si256((__m256i*)&prevNeuronValues[srcNeuron * PADDED_SAMPLES + s]);
-
-                    __m256i negated = _mm256_sub_epi8(_mm256_setzero_si256(), srcValues);
-                    __m256i product = _mm256_blendv_epi8(srcValues, negated, weight256);
 
-                    // Sign-extend char to int16 and accumulate
-                    __m128i lo = _mm256_castsi256_si128(product);
-                    __m128i hi = _mm256_extracti128_si256(product, 1);
+                // Sum up to maxInt8Terms source values in int8, then sign-extend to int16 and accumulate
+                for (unsigned int begin = 0; begin < numPositive + numNegative; begin += maxInt8Terms)
+                {
+                    const unsigned int end = (begin + maxInt8Terms < numPositive + numNegative) ? begin + maxInt8Terms : numPositive + numNegative;
+                    __m256i sum = _mm256_setzero_si256();
+                    unsigned int i = begin;
+                    for (; i < end && i < numPositive; i++)
+                    {
+                        sum = _mm256_add_epi8(sum, _mm256_loadu_si256((__m256i*)&prevNeuronValues[positiveSources[i] * PADDED_SAMPLES + s]));
+                    }
+                    for (; i < end; i++)
+                    {
+                        sum = _mm256_sub_epi8(sum, _mm256_loadu_si256((__m256i*)&prevNeuronValues[negativeSources[i - numPositive] * PADDED_SAMPLES + s]));
+                    }
 
-                    acc0 = _mm256_add_epi16(acc0, _mm256_cvtepi8_epi16(lo));
-                    acc1 = _mm256_add_epi16(acc1, _mm256_cvtepi8_epi16(hi));
+                    acc0 = _mm256_add_epi16(acc0, _mm256_cvtepi8_epi16(_mm256_castsi256_si128(sum)));
+                    acc1 = _mm256_add_epi16(acc1, _mm256_cvtepi8_epi16(_mm256_extracti128_si256(sum, 1)));
                 }
 
                 // Clamp to [-1, 1]
@@ -717,7 +725,8 @@ struct ScoreAddition
         unsigned long long endIdx = getSynapseEndIndex();
 
         // Clear counts
-        setMem(incomingCount, sizeof(incomingCount), 0);
+        setMem(incomingPositiveCount, sizeof(incomingPositiveCount), 0);
+        setMem(incomingNegativeCount, sizeof(incomingNegativeCount), 0);
 
         // Convert outgoing synapses to incoming ones
         for (unsigned long long n = 0; n < population; n++)
@@ -731,10 +740,9 @@ struct ScoreAddition
                 long long offset = bufferIndexToOffset(synIdx);
                 unsigned long long nnIndex = clampNeuronIndex((long long)n, offset);
 
-                unsigned int idx = incomingCount[nnIndex]++;
-                incomingSynapses[nnIndex * maxNumberOfNeighbors + idx] = weight;
-
-                // Cache the incomming neuron
+                // Cache the incomming neuron. A neuron has at most one incoming synapse per neighbor offset, so the
+                // positive and negative parts of the slot never overlap.
+                unsigned int idx = (weight > 0) ? incomingPositiveCount[nnIndex]++ : (unsigned int)maxNumberOfNeighbors - 1 - incomingNegativeCount[nnIndex]++;
                 incomingSource[nnIndex * maxNumberOfNeighbors + idx] = (unsigned int)n;
             }
         }
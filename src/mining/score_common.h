@@ -152,6 +152,26 @@ static inline unsigned popcnt256(__m256i v)
         popcnt64(_mm256_extract_epi64(v, 3));
 }
 
+// Population count of each 64-bit lane, computed in-register with a nibble lookup table (vpshufb) instead of
+// extracting the lanes. Used for accumulating counts over several vectors before reducing them to a scalar.
+static inline __m256i popcnt256Epi64(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    const __m256i lo = _mm256_and_si256(v, lowMask);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+    const __m256i bytesCount = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(bytesCount, _mm256_setzero_si256());
+}
+
+static inline long long reduceAdd256Epi64(__m256i v)
+{
+    const __m128i sum128 = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return _mm_cvtsi128_si64(sum128) + _mm_extract_epi64(sum128, 1);
+}
+
 #endif
 
 static void generateRandom2Pool(const unsigned char* miningSeed, unsigned char* state, unsigned char* pool)
@@ -52,6 +52,30 @@ struct ScoreEngine
         }
     }
 
+    // Compute scores of count solutions (publicKeys[i], nonces[i]) with the same random pool and store them in
+    // scores[i]. Solutions are processed grouped by algorithm, so bursts of mixed solutions keep the working set of
+    // one algorithm in cache instead of alternating between both. Solutions are not evaluated in lockstep, because
+    // each mutation changes population and structure of the ANN of one solution only.
+    void computeScores(const m256i* publicKeys, const m256i* nonces, unsigned int count, const unsigned char* randomPool, unsigned int* scores)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            if ((nonces[i].m256i_u8[0] & 1) == 0)
+            {
+                scores[i] = computeHyperIdentityScore(publicKeys[i].m256i_u8, nonces[i].m256i_u8, randomPool);
+                lastNonceByte0 = nonces[i].m256i_u8[0];
+            }
+        }
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            if ((nonces[i].m256i_u8[0] & 1) != 0)
+            {
+                scores[i] = computeAdditionScore(publicKeys[i].m256i_u8, nonces[i].m256i_u8, randomPool);
+                lastNonceByte0 = nonces[i].m256i_u8[0];
+            }
+        }
+    }
+
     // returns last computed output neurons, only returns 256 non-zero neurons, neuron values are compressed to bit
     m256i getLastOutput()
     {
@@ -693,6 +693,10 @@ struct ScoreHyperIdentity
             unsigned char* pSynapsePlus = pPaddingSynapsePlus;
             unsigned char* pSynapseMinus = pPaddingSynapseMinus;
 
+            // Per-lane counts are accumulated over all chunks and reduced once per neuron
+            __m256i plusPopulation = _mm256_setzero_si256();
+            __m256i minusPopulation = _mm256_setzero_si256();
+
             int synapseBlkIdx = 0; // blk index of synapse
             int neuronBlkIdx = 0;
             for (unsigned blk = 0; blk < chunks; ++blk, synapseBlkIdx += BATCH_SIZE, neuronBlkIdx += BATCH_SIZE_X8)
@@ -710,8 +714,10 @@ struct ScoreHyperIdentity
                 __m256i minus = _mm256_or_si256(_mm256_and_si256(neuronPlus, synapseMinus),
                     _mm256_and_si256(neuronMinus, synapsePlus));
 
-                score += popcnt256(plus) - popcnt256(minus);
+                plusPopulation = _mm256_add_epi64(plusPopulation, popcnt256Epi64(plus));
+                minusPopulation = _mm256_add_epi64(minusPopulation, popcnt256Epi64(minus));
             }
+            score = (int)reduceAdd256Epi64(_mm256_sub_epi64(plusPopulation, minusPopulation));
 
             neuronValue = (score > 0) - (score < 0);
             neuronValueBuffer[n] = neuronValue;
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "platform/memory_util.h"
+#include "platform/assert.h"
+
+// Approximate set of the packets received within a fixed time window, for dropping duplicates before processing
+// (dejavu filter). Packets are identified by a 64-bit salted digest (see receiveFromPeers()).
+//
+// This is a cuckoo filter: each packet is stored as a 32-bit fingerprint in one of two candidate buckets of
+// entriesPerBucket entries. Each entry also stores the time of insertion. Entries older than the time window count as
+// empty, so packets are remembered for the same time regardless of the packet rate, as long as the number of packets
+// per window fits into the filter. If both candidate buckets are full, entries are moved to their alternative bucket
+// (cuckoo kicking). If that fails too, the last moved entry is dropped (counted as overflow), which may let a
+// duplicate of that packet through.
+//
+// A lookup finds a false positive with probability of at most 2 * entriesPerBucket / 2^32. The time is passed by the
+// caller in arbitrary units (such as seconds) and may wrap around.
+//
+// Not thread-safe: contains() and insert() must be called by the same processor.
+template <unsigned long long bucketCount>
+class DejavuFilter
+{
+    static_assert(bucketCount >= 2 && (bucketCount & (bucketCount - 1)) == 0, "bucketCount must be 2^N");
+
+public:
+    static constexpr unsigned int entriesPerBucket = 4;
+    static constexpr unsigned int maxKicks = 128;
+
+    struct Entry
+    {
+        unsigned int fingerprint; // 0 = empty
+        unsigned int time;
+    };
+
+    static constexpr unsigned long long bufferSize = bucketCount * entriesPerBucket * sizeof(Entry);
+
+    bool init(unsigned int windowLength)
+    {
+        ASSERT(windowLength > 0);
+        if (!allocLargeWithErrorLog(L"dejavuFilter", bufferSize, (void**)&entries, __LINE__))
+            return false;
+        window = windowLength;
+        overflowCount = 0;
+        return true;
+    }
+
+    void deinit()
+    {
+        if (entries)
+        {
+            freeLarge(entries, bufferSize);
+            entries = nullptr;
+        }
+    }
+
+    // Remove all packets.
+    void reset()
+    {
+        setMem(entries, bufferSize, 0);
+        overflowCount = 0;
+    }
+
+    // Return if packet with given id has been inserted within the time window before now (may be false positive).
+    bool contains(unsigned long long id, unsigned int now) const
+    {
+        const unsigned int fingerprint = getFingerprint(id);
+        const unsigned long long bucket1 = id & (bucketCount - 1);
+        return findInBucket(bucket1, fingerprint, now) || findInBucket(getAlternativeBucket(bucket1, fingerprint), fingerprint, now);
+    }
+
+    // Insert packet with given id, received at time now.
+    void insert(unsigned long long id, unsigned int now)
+    {
+        Entry entry{ getFingerprint(id), now };
+        unsigned long long bucket = id & (bucketCount - 1);
+        if (tryInsertIntoBucket(bucket, entry, now))
+            return;
+        bucket = getAlternativeBucket(bucket, entry.fingerprint);
+        for (unsigned int kick = 0; kick < maxKicks; ++kick)
+        {
+            if (tryInsertIntoBucket(bucket, entry, now))
+                return;
+
+            // Kick out an entry (varied by the kick count) and insert it into its alternative bucket next
+            Entry& victim = entries[bucket * entriesPerBucket + ((kick + entry.fingerprint) & (entriesPerBucket - 1))];
+            const Entry kickedEntry = victim;
+            victim = entry;
+            entry = kickedEntry;
+            bucket = getAlternativeBucket(bucket, entry.fingerprint);
+        }
+        ++overflowCount;
+    }
+
+    // Return number of entries dropped because the filter was full.
+    unsigned long long getOverflowCount() const
+    {
+        return overflowCount;
+    }
+
+private:
+    static unsigned int getFingerprint(unsigned long long id)
+    {
+        const unsigned int fingerprint = (unsigned int)(id >> 32);
+        return fingerprint ? fingerprint : 1;
+    }
+
+    // The alternative bucket is derived from the bucket and the fingerprint only, so an entry can be moved without
+    // knowing the id. Applying the function twice returns the original bucket.
+    static unsigned long long getAlternativeBucket(unsigned long long bucket, unsigned int fingerprint)
+    {
+        return (bucket ^ (fingerprint * 0x5bd1e995ULL)) & (bucketCount - 1);
+    }
+
+    bool isLive(const Entry& entry, unsigned int now) const
+    {
+        return entry.fingerprint && now - entry.time < window;
+    }
+
+    bool findInBucket(unsigned long long bucket, unsigned int fingerprint, unsigned int now) const
+    {
+        const Entry* bucketEntries = &entries[bucket * entriesPerBucket];
+        for (unsigned int i = 0; i < entriesPerBucket; ++i)
+        {
+            if (bucketEntries[i].fingerprint == fingerprint && isLive(bucketEntries[i], now))
+                return true;
+        }
+        return false;
+    }
+
+    // Store entry in an empty or expired entry of the bucket. Return false if the bucket is full.
+    bool tryInsertIntoBucket(unsigned long long bucket, const Entry& entry, unsigned int now)
+    {
+        Entry* bucketEntries = &entries[bucket * entriesPerBucket];
+        for (unsigned int i = 0; i < entriesPerBucket; ++i)
+        {
+            if (!isLive(bucketEntries[i], now))
+            {
+                bucketEntries[i] = entry;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Entry* entries;
+    unsigned int window;
+    unsigned long long overflowCount;
+};
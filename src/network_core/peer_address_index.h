@@ -0,0 +1,112 @@
+#pragma once
+
+#include "network_messages/common_def.h"
+#include "platform/memory_util.h"
+#include "platform/assert.h"
+
+// Hash index from IPv4 address to slot in a table of peers, so a peer can be found without scanning the table. It uses
+// open addressing with linear probing and backward-shift deletion (no tombstones). The capacity should be at least
+// twice the number of slots of the table to keep the probe sequences short.
+//
+// Not thread-safe: the caller has to hold the lock protecting the table of peers.
+template <unsigned int capacityBits>
+class PeerAddressIndex
+{
+public:
+    static constexpr unsigned int capacity = 1u << capacityBits;
+
+    void reset()
+    {
+        setMem(entries, sizeof(entries), 0);
+        count = 0;
+    }
+
+    // Position where probing for address starts
+    static unsigned int home(const IPv4Address& address)
+    {
+        return (address.u32 * 2654435761u) >> (32 - capacityBits);
+    }
+
+    // Return slot of address or -1 if it isn't in the index
+    int find(const IPv4Address& address) const
+    {
+        return int(entries[findPosition(address)].slot) - 1;
+    }
+
+    // Add address with slot. Returns false if the address is already in the index or the index is full.
+    bool insert(const IPv4Address& address, unsigned int slot)
+    {
+        const unsigned int pos = findPosition(address);
+        if (entries[pos].slot || count >= capacity - 1)
+        {
+            return false;
+        }
+        entries[pos].address = address;
+        entries[pos].slot = slot + 1;
+        ++count;
+        return true;
+    }
+
+    // Change slot of address that is in the index, for example after moving the peer to another slot of the table
+    void setSlot(const IPv4Address& address, unsigned int slot)
+    {
+        const unsigned int pos = findPosition(address);
+        ASSERT(entries[pos].slot);
+        entries[pos].slot = slot + 1;
+    }
+
+    // Remove address, moving following entries of the probe sequence back to keep them reachable. Returns false if the
+    // address isn't in the index.
+    bool remove(const IPv4Address& address)
+    {
+        unsigned int pos = findPosition(address);
+        if (!entries[pos].slot)
+        {
+            return false;
+        }
+        unsigned int next = pos;
+        while (1)
+        {
+            next = (next + 1) & (capacity - 1);
+            if (!entries[next].slot)
+            {
+                break;
+            }
+            // entry can be moved to pos if its home is not in (pos, next]
+            const unsigned int entryHome = home(entries[next].address);
+            if (((next - entryHome) & (capacity - 1)) >= ((next - pos) & (capacity - 1)))
+            {
+                entries[pos] = entries[next];
+                pos = next;
+            }
+        }
+        entries[pos].slot = 0;
+        --count;
+        return true;
+    }
+
+    unsigned int size() const
+    {
+        return count;
+    }
+
+private:
+    struct Entry
+    {
+        IPv4Address address;
+        unsigned int slot; // slot + 1, 0 means empty
+    };
+    Entry entries[capacity];
+    unsigned int count;
+
+    // Return position of address or the empty position where it would be inserted
+    unsigned int findPosition(const IPv4Address& address) const
+    {
+        unsigned int pos = home(address);
+        while (entries[pos].slot && !(entries[pos].address == address))
+        {
+            pos = (pos + 1) & (capacity - 1);
+        }
+        return pos;
+    }
+};
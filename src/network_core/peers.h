@@ -7,12 +7,20 @@
 #include <lib/platform_efi/uefi.h>
 #include "platform/random.h"
 #include "platform/concurrency.h"
+#include "platform/spin_lock.h"
 #include "platform/profiling.h"
 
 #include "network_messages/common_def.h"
 #include "network_messages/header.h"
 #include "network_messages/common_response.h"
 
+#include "oracle_core/oracle_machine_channel.h"
+
+#include "dejavu_filter.h"
+#include "request_budget.h"
+#include "receive_buffer.h"
+#include "peer_address_index.h"
+
 #include "tcp4.h"
 #include "kangaroo_twelve.h"
 
@@ -20,20 +28,24 @@
 #include "private_settings.h"
 
 
-#define DEJAVU_SWAP_LIMIT 1000000
+#define DEJAVU_FILTER_BUCKETS 2097152 // Must be 2^N, 4 packets per bucket (64 MB)
+#define DEJAVU_WINDOW_SECONDS 30 // Time in which duplicates of a received packet are dropped
+#define PEER_QUERY_REQUEST_BUDGET_PERCENT 50 // Share (in %) of one request processor that query requests of a peer may use on average
 #define DISSEMINATION_MULTIPLIER 6
 #define NUMBER_OF_REGULAR_OUTGOING_CONNECTIONS 8
 #define NUMBER_OF_OM_NODE_CONNECTIONS (sizeof(oracleMachineIPs) / sizeof(oracleMachineIPs[0]))
 #define NUMBER_OF_OUTGOING_CONNECTIONS (NUMBER_OF_REGULAR_OUTGOING_CONNECTIONS + NUMBER_OF_OM_NODE_CONNECTIONS)
 #define NUMBER_OF_INCOMING_CONNECTIONS 88
 #define MAX_NUMBER_OF_PUBLIC_PEERS 1024
-#define REQUEST_QUEUE_BUFFER_SIZE 1073741824
-#define REQUEST_QUEUE_LENGTH 65536 // Must be 65536
+#define REQUEST_QUEUE_BUFFER_SIZE 1073741824 // Sum of buffer sizes of all request queues
+#define REQUEST_QUEUE_LENGTH 65536 // Must be 65536 (per request queue)
 #define RESPONSE_QUEUE_BUFFER_SIZE 1073741824
 #define RESPONSE_QUEUE_LENGTH 65536 // Must be 65536
 #define NUMBER_OF_PUBLIC_PEERS_TO_KEEP 10
 #define NUMBER_OF_WHITE_LIST_PEERS sizeof(whiteListPeers) / sizeof(whiteListPeers[0])
 #define NUMBER_OF_INCOMING_CONNECTIONS_RESERVED_FOR_WHITELIST_IPS 16
+#define PEER_SMALL_BUFFER_SIZE 1048576 // Size of receive and transmit buffers each peer has
+#define NUMBER_OF_PEER_LARGE_BUFFERS 128 // Number of shared buffers of BUFFER_SIZE for peers that need larger buffers
 
 // OM related setting
 static constexpr unsigned int ORACLE_MACHINE_CONNECTION_TIMEOUT_SECS = 15; // Config timout for connecting attemp to OM
@@ -45,9 +57,24 @@ static_assert((NUMBER_OF_INCOMING_CONNECTIONS / NUMBER_OF_REGULAR_OUTGOING_CONNE
 
 static volatile bool listOfPeersIsStatic = false;
 
-#define OM_RETRY_COUNT(dejavu) ((dejavu) >> 24)
-#define OM_SET_RETRY_COUNT(dejavu, count) (((dejavu) & 0x00FFFFFF) | ((count) << 24))
-#define OM_MAX_RETRIES 3
+// Pool of large buffers (BUFFER_SIZE) shared by all peers. A peer uses small buffers (PEER_SMALL_BUFFER_SIZE) for
+// receiving and transmitting by default and only takes large buffers from the pool if it sends or receives more data
+// than fits into them. The large buffers are returned when the connection is closed. Only accessed by main thread.
+static void* peerLargeBuffers[NUMBER_OF_PEER_LARGE_BUFFERS];
+static unsigned int numberOfFreePeerLargeBuffers = 0;
+
+// Take large buffer from pool. Returns NULL if the pool is exhausted.
+static void* acquirePeerLargeBuffer()
+{
+    return (numberOfFreePeerLargeBuffers) ? peerLargeBuffers[--numberOfFreePeerLargeBuffers] : NULL;
+}
+
+// Return large buffer to pool.
+static void releasePeerLargeBuffer(void* buffer)
+{
+    ASSERT(numberOfFreePeerLargeBuffers < NUMBER_OF_PEER_LARGE_BUFFERS);
+    peerLargeBuffers[numberOfFreePeerLargeBuffers++] = buffer;
+}
 
 struct Peer
 {
@@ -55,17 +82,23 @@ struct Peer
     EFI_TCP4_LISTEN_TOKEN connectAcceptToken;
     IPv4Address address;
     void* receiveBuffer;
+    unsigned int receiveBufferSize; // PEER_SMALL_BUFFER_SIZE or BUFFER_SIZE
     EFI_TCP4_RECEIVE_DATA receiveData;
     EFI_TCP4_IO_TOKEN receiveToken;
     EFI_TCP4_TRANSMIT_DATA transmitData;
+    unsigned int transmitBufferSize; // size of transmitData.FragmentTable[0].FragmentBuffer
     EFI_TCP4_IO_TOKEN transmitToken;
     char* dataToTransmit;
     unsigned int dataToTransmitSize;
+    unsigned int dataToTransmitBufferSize; // size of dataToTransmit buffer
+    void* smallBuffers[3]; // buffers of PEER_SMALL_BUFFER_SIZE owned by this peer
     BOOLEAN isConnectingAccepting;
     BOOLEAN isConnectedAccepted;
     BOOLEAN isReceiving, isTransmitting;
     BOOLEAN exchangedPublicPeers;
     BOOLEAN isClosing;
+    // Indicate the peer has subscribed to log events (see RequestLogSubscription)
+    BOOLEAN isLogSubscriber;
     // Indicate the peer is incomming connection type
     BOOLEAN isIncommingConnection;
 
@@ -75,6 +108,8 @@ struct Peer
     unsigned long long lastOMActivityTime;
     unsigned long long omTransmitStartTime;
     unsigned long long lastOMCloseTime;
+    // Queries per frame supported by OM node, announced with OracleMachineCapabilities after connecting
+    unsigned int omMaxQueriesPerFrame;
 
     // Extra data to determine if this peer is a fullnode
     // Note: an **active fullnode** is a peer that is able to reply valid tick data, tick vote to this node after getting requested
@@ -86,6 +121,15 @@ struct Peer
     long trackRequestedCounter; // "long" to discard warning from intrin.h
     unsigned int lastActiveTick; // indicate the tick number that this peer transfer valid tick/vote data
 
+    // Statistics for choosing receivers of disseminated messages (see disseminationWeight()), only accessed by main thread
+    unsigned long long transmitStartTime;
+    unsigned long long averageTransmitDuration; // moving average of duration of successful transmissions in CPU ticks
+    unsigned int numberOfReceivedMessages;
+    unsigned int numberOfReceivedDuplicates;
+
+    // Admission control of query requests (see isRequestAdmitted()), only accessed by main thread
+    RequestBudget queryRequestBudget;
+
     bool isFullNode() const
     {
         return (lastActiveTick >= system.tick - 100);
@@ -96,6 +140,47 @@ struct Peer
         return isOMNode;
     }
 
+    // Weight (1 to 64) for choosing this peer as receiver of disseminated messages. Peers with little data waiting for
+    // transmission, fast transmissions, and few duplicates received from them (indicating that they already receive
+    // messages from others) are preferred. Every peer keeps a chance to be chosen, so propagation is not restricted to
+    // a subset of peers.
+    unsigned int disseminationWeight() const
+    {
+        // halve weight for each MB waiting for transmission
+        unsigned int weight = 64 >> min(dataToTransmitSize >> 20, 5u);
+
+        // halve weight if transmissions are slow (more than 10 ms on average)
+        if (averageTransmitDuration > frequency / 100)
+            weight >>= 1;
+
+        // reduce weight by up to 3/4 depending on ratio of duplicates
+        if (numberOfReceivedMessages >= 64)
+            weight -= (weight * 3 * numberOfReceivedDuplicates) / (4 * numberOfReceivedMessages);
+
+        return (weight) ? weight : 1;
+    }
+
+    // Update statistics of received messages (called for each received message)
+    void countReceivedMessage(bool isDuplicate)
+    {
+        // keep statistics of recent messages by halving counters regularly
+        if (numberOfReceivedMessages >= 1024)
+        {
+            numberOfReceivedMessages >>= 1;
+            numberOfReceivedDuplicates >>= 1;
+        }
+        ++numberOfReceivedMessages;
+        if (isDuplicate)
+            ++numberOfReceivedDuplicates;
+    }
+
+    // Update statistics of transmission duration (called when transmission completed successfully)
+    void countCompletedTransmission()
+    {
+        const unsigned long long duration = __rdtsc() - transmitStartTime;
+        averageTransmitDuration = (averageTransmitDuration) ? (averageTransmitDuration * 7 + duration) / 8 : duration;
+    }
+
     // store a dejavu number into local list
     void trackDejavu(unsigned int dejavu)
     {
@@ -121,6 +206,51 @@ struct Peer
         return 0;
     }
 
+    // Set receiveBuffer, dataToTransmit, and transmit fragment buffer to the small buffers of this peer after
+    // returning large buffers to the pool. Must not be called while receiving or transmitting.
+    void useSmallBuffers()
+    {
+        if (receiveBufferSize == BUFFER_SIZE)
+            releasePeerLargeBuffer(receiveBuffer);
+        if (dataToTransmitBufferSize == BUFFER_SIZE)
+            releasePeerLargeBuffer(dataToTransmit);
+        if (transmitBufferSize == BUFFER_SIZE)
+            releasePeerLargeBuffer(transmitData.FragmentTable[0].FragmentBuffer);
+        receiveBuffer = smallBuffers[0];
+        dataToTransmit = (char*)smallBuffers[1];
+        transmitData.FragmentTable[0].FragmentBuffer = smallBuffers[2];
+        receiveBufferSize = dataToTransmitBufferSize = transmitBufferSize = PEER_SMALL_BUFFER_SIZE;
+    }
+
+    // Replace dataToTransmit by large buffer from pool, keeping its content. Returns false if pool is exhausted.
+    bool growDataToTransmit()
+    {
+        ASSERT(dataToTransmitBufferSize < BUFFER_SIZE);
+        void* largeBuffer = acquirePeerLargeBuffer();
+        if (!largeBuffer)
+            return false;
+        copyMem(largeBuffer, dataToTransmit, dataToTransmitSize);
+        dataToTransmit = (char*)largeBuffer;
+        dataToTransmitBufferSize = BUFFER_SIZE;
+        return true;
+    }
+
+    // Replace receiveBuffer by large buffer from pool, keeping its content. Returns false if pool is exhausted.
+    // Must not be called while receiving.
+    bool growReceiveBuffer()
+    {
+        ASSERT(receiveBufferSize < BUFFER_SIZE);
+        void* largeBuffer = acquirePeerLargeBuffer();
+        if (!largeBuffer)
+            return false;
+        const unsigned long long receivedDataSize = ((unsigned long long)receiveData.FragmentTable[0].FragmentBuffer) - ((unsigned long long)receiveBuffer);
+        copyMem(largeBuffer, receiveBuffer, receivedDataSize);
+        receiveBuffer = largeBuffer;
+        receiveData.FragmentTable[0].FragmentBuffer = ((char*)largeBuffer) + receivedDataSize;
+        receiveBufferSize = BUFFER_SIZE;
+        return true;
+    }
+
     // set handler to null and all params to false/zeroes
     void reset()
     {
@@ -132,15 +262,23 @@ struct Peer
         exchangedPublicPeers = FALSE;
         isClosing = FALSE;
         isIncommingConnection = FALSE;
+        isLogSubscriber = FALSE;
         
         isOMNode = FALSE;
         lastOMActivityTime = 0;
         connectionStartTime = 0;
         omTransmitStartTime = 0;
         lastOMCloseTime = 0;
+        omMaxQueriesPerFrame = OM_MAX_QUERIES_PER_FRAME;
 
         dataToTransmitSize = 0;
+        useSmallBuffers();
         lastActiveTick = 0;
+        transmitStartTime = 0;
+        averageTransmitDuration = 0;
+        numberOfReceivedMessages = 0;
+        numberOfReceivedDuplicates = 0;
+        queryRequestBudget.reset();
         trackRequestedCounter = 0;
         setMem(trackRequestedTick, sizeof(trackRequestedTick), 0);
         setMem(trackRequestedDejavu, sizeof(trackRequestedDejavu), 0);
@@ -151,6 +289,7 @@ typedef struct
 {
     bool isHandshaked;
     bool isFullnode;
+    unsigned char rejectedConnections; // since last handshake, saturating
     IPv4Address address;
 } PublicPeer;
 
@@ -163,40 +302,77 @@ static volatile char publicPeersLock = 0;
 static unsigned int numberOfPublicPeers = 0;
 static PublicPeer publicPeers[MAX_NUMBER_OF_PUBLIC_PEERS];
 
+// Index from address to slot in publicPeers, protected by publicPeersLock
+static PeerAddressIndex<11> publicPeersIndex;
+static_assert(publicPeersIndex.capacity >= 2 * MAX_NUMBER_OF_PUBLIC_PEERS, "publicPeersIndex too small");
+
 static volatile char omPeersLock = 0;
 static unsigned int numberOfOMPeers = 0;
 IPv4Address omIPv4Address[NUMBER_OF_OM_NODE_CONNECTIONS];
 
-static unsigned long long* dejavu0 = NULL;
-static unsigned long long* dejavu1 = NULL;
-static unsigned int dejavuSwapCounter = DEJAVU_SWAP_LIMIT;
+static DejavuFilter<DEJAVU_FILTER_BUCKETS> dejavuFilter;
 
 static volatile long long numberOfProcessedRequests = 0, prevNumberOfProcessedRequests = 0;
 static volatile long long numberOfDiscardedRequests = 0, prevNumberOfDiscardedRequests = 0;
 static volatile long long numberOfDuplicateRequests = 0, prevNumberOfDuplicateRequests = 0;
 static volatile long long numberOfDisseminatedRequests = 0, prevNumberOfDisseminatedRequests = 0;
+static volatile long long numberOfThrottledRequests = 0, prevNumberOfThrottledRequests = 0;
+
+// Processing time of requests per message type, measured by request processors and used for admission control
+static RequestCostEstimator requestCostEstimator;
 
 static unsigned char* requestQueueBuffer = NULL;
 static unsigned char* responseQueueBuffer = NULL;
 
-static struct Request
+struct Request
 {
     Peer* peer;
     unsigned int offset;
-} requestQueueElements[REQUEST_QUEUE_LENGTH];
+    volatile char released; // set by request processor after copying the request, reset when freeing the element
+    m256i payloadDigest; // K12 of payload if already computed (see processReceivedData()), zero otherwise
+};
 
 static struct Response
 {
     Peer* peer;
     unsigned int offset;
+    unsigned int size; // buffer space used by the element, may be more than the message size (see reserveResponse())
+    volatile char isReserved; // set while the message is written in place, elements behind it are not sent before
+    char isCanceled; // set by cancelResponse(), the message is dropped instead of being sent
 } responseQueueElements[RESPONSE_QUEUE_LENGTH];
 
-static volatile unsigned int requestQueueBufferHead = 0, requestQueueBufferTail = 0;
+// Traffic classes of received requests. Each class has its own request queue with its own buffer budget, so a flood of
+// requests of one class (such as queries of wallets) neither delays nor causes dropping of requests of another class
+// (such as consensus messages). The order of the classes is the priority order used by the request processors.
+enum RequestQueueType
+{
+    CONSENSUS_REQUEST_QUEUE = 0,
+    TRANSACTION_REQUEST_QUEUE = 1,
+    MINING_REQUEST_QUEUE = 2,
+    QUERY_REQUEST_QUEUE = 3,
+    NUMBER_OF_REQUEST_QUEUES
+};
+
+// Buffer sizes of the request queues, partitioning requestQueueBuffer
+static constexpr unsigned int requestQueueBufferSizes[NUMBER_OF_REQUEST_QUEUES] = { 268435456, 268435456, 134217728, 402653184 };
+static_assert(requestQueueBufferSizes[0] + requestQueueBufferSizes[1] + requestQueueBufferSizes[2] + requestQueueBufferSizes[3] == REQUEST_QUEUE_BUFFER_SIZE, "Request queue buffer sizes must sum up to REQUEST_QUEUE_BUFFER_SIZE");
+static_assert(requestQueueBufferSizes[MINING_REQUEST_QUEUE] > 2 * BUFFER_SIZE, "Request queue buffer must be able to hold messages of maximum size in addition to BUFFER_SIZE reserved at the end");
+
+// Each request queue has a single producer (peerReceiveAndTransmit() in main processor) and multiple consumers (request
+// processors). Elements in [elementTail, elementHead) are waiting to be claimed, elements in [elementReleaseTail,
+// elementTail) are claimed but may not be released yet. The buffer space of an element is only reused after it has been
+// released and its index passed by elementReleaseTail.
+static struct RequestQueue
+{
+    unsigned char* buffer; // part of requestQueueBuffer with size requestQueueBufferSizes[queue type]
+    Request elements[REQUEST_QUEUE_LENGTH];
+    volatile unsigned int bufferHead, bufferTail;
+    volatile unsigned short elementHead, elementTail, elementReleaseTail;
+} requestQueues[NUMBER_OF_REQUEST_QUEUES];
+
 static volatile unsigned int responseQueueBufferHead = 0, responseQueueBufferTail = 0;
-static volatile unsigned short requestQueueElementHead = 0, requestQueueElementTail = 0;
 static volatile unsigned short responseQueueElementHead = 0, responseQueueElementTail = 0;
-static volatile char requestQueueTailLock = 0;
-static volatile char responseQueueHeadLock = 0;
+static SpinLock<true> responseQueueHeadLock;
 static volatile unsigned long long queueProcessingNumerator = 0, queueProcessingDenominator = 0;
 static volatile unsigned long long tickerLoopNumerator = 0, tickerLoopDenominator = 0;
 
@@ -337,7 +513,9 @@ static void push(Peer* peer, RequestResponseHeader* requestResponseHeader)
     // The sending buffer may queue multiple messages, each of which may need to transmitted in many small packets.
     if (peer->tcp4Protocol && peer->isConnectedAccepted && !peer->isClosing)
     {
-        if (peer->dataToTransmitSize + requestResponseHeader->size() > BUFFER_SIZE)
+        if (peer->dataToTransmitSize + requestResponseHeader->size() > peer->dataToTransmitBufferSize
+            && (peer->dataToTransmitSize + requestResponseHeader->size() > BUFFER_SIZE
+                || peer->dataToTransmitBufferSize == BUFFER_SIZE || !peer->growDataToTransmit()))
         {
             // Buffer is full, which indicates a problem
 #ifndef NDEBUG
@@ -365,27 +543,57 @@ static void push(Peer* peer, RequestResponseHeader* requestResponseHeader)
     }
 }
 
+// Check if any connected peer that messages can be pushed to is a full node, can only called from main thread.
+static bool isAnyFullNodeConnected()
+{
+    for (unsigned int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS; i++)
+    {
+        if (peers[i].tcp4Protocol && peers[i].isConnectedAccepted && peers[i].exchangedPublicPeers && !peers[i].isClosing
+            && peers[i].isFullNode())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Add message to sending buffer of custom filtered (and random) peer, can only called from main thread (not thread-safe).
+// The receivers are chosen randomly with probabilities proportional to Peer::disseminationWeight().
 static void pushCustom(RequestResponseHeader* requestResponseHeader, int numberOfReceivers, bool filterFullNode)
 {
     unsigned short suitablePeerIndices[NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS];
+    unsigned int suitablePeerWeights[NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS];
     unsigned short numberOfSuitablePeers = 0;
+    unsigned int totalWeight = 0;
     for (unsigned int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS; i++)
     {
         if (peers[i].tcp4Protocol && peers[i].isConnectedAccepted && peers[i].exchangedPublicPeers && !peers[i].isClosing)
         {
             if ((filterFullNode && peers[i].isFullNode()) || (!filterFullNode))
             {
-                suitablePeerIndices[numberOfSuitablePeers++] = i;
+                suitablePeerIndices[numberOfSuitablePeers] = i;
+                suitablePeerWeights[numberOfSuitablePeers] = peers[i].disseminationWeight();
+                totalWeight += suitablePeerWeights[numberOfSuitablePeers];
+                numberOfSuitablePeers++;
             }
         }
     }
     unsigned short numberOfRemainingSuitablePeers = numberOfReceivers;
     while (numberOfRemainingSuitablePeers-- && numberOfSuitablePeers)
     {
-        const unsigned short index = random(numberOfSuitablePeers);
+        unsigned int randomWeight = random(totalWeight);
+        unsigned short index = 0;
+        while (randomWeight >= suitablePeerWeights[index])
+        {
+            randomWeight -= suitablePeerWeights[index];
+            ++index;
+        }
+        ASSERT(index < numberOfSuitablePeers);
         push(&peers[suitablePeerIndices[index]], requestResponseHeader);
-        suitablePeerIndices[index] = suitablePeerIndices[--numberOfSuitablePeers];
+        totalWeight -= suitablePeerWeights[index];
+        --numberOfSuitablePeers;
+        suitablePeerIndices[index] = suitablePeerIndices[numberOfSuitablePeers];
+        suitablePeerWeights[index] = suitablePeerWeights[numberOfSuitablePeers];
     }
 }
 
@@ -436,12 +644,129 @@ static void pushToFullNodes(RequestResponseHeader* requestResponseHeader, int nu
     }
 }
 
+// Assign the parts of the allocated requestQueueBuffer to the request queues.
+static void initRequestQueues()
+{
+    unsigned long long offset = 0;
+    for (unsigned int queueType = 0; queueType < NUMBER_OF_REQUEST_QUEUES; queueType++)
+    {
+        requestQueues[queueType].buffer = requestQueueBuffer + offset;
+        offset += requestQueueBufferSizes[queueType];
+    }
+}
+
+// Return the traffic class (RequestQueueType) of a received request with the given message type.
+static unsigned int getRequestQueueType(unsigned char messageType)
+{
+    switch (messageType)
+    {
+    case EXCHANGE_PUBLIC_PEERS:
+    case BROADCAST_COMPUTORS:
+    case BROADCAST_TICK:
+    case BROADCAST_FUTURE_TICK_DATA:
+    case REQUEST_COMPUTORS:
+    case REQUEST_QUORUM_TICK:
+    case REQUEST_TICK_DATA:
+    case ORACLE_MACHINE_REPLY:
+    case SPECIAL_COMMAND:
+        return CONSENSUS_REQUEST_QUEUE;
+
+    case BROADCAST_TRANSACTION:
+    case REQUEST_TICK_TRANSACTIONS:
+        return TRANSACTION_REQUEST_QUEUE;
+
+    case BROADCAST_MESSAGE:
+    case REQUEST_CUSTOM_MINING_DATA:
+    case REQUEST_CUSTOM_MINING_SOLUTION_VERIFICATION:
+        return MINING_REQUEST_QUEUE;
+
+    default:
+        return QUERY_REQUEST_QUEUE;
+    }
+}
+
+// Admission control of received requests: query requests are only queued while the peer has processing budget left
+// (see RequestBudget), so expensive requests of one client cannot crowd out the requests of everyone else. Requests of
+// the other traffic classes are always admitted. Only called by main thread.
+static bool isRequestAdmitted(Peer& peer, unsigned int queueType, unsigned char messageType)
+{
+    if (queueType != QUERY_REQUEST_QUEUE)
+        return true;
+
+    // types that haven't been processed yet are estimated to take 10 microseconds; requests of contract state changes
+    // are charged at least 10 milliseconds, because their responses (up to 64 KiB) are much larger than the request
+    const unsigned long long minimumCost = (messageType == REQUEST_CONTRACT_STATE_CHANGES) ? frequency / 100 : frequency / 100000;
+    const unsigned long long cost = requestCostEstimator.estimate(messageType, minimumCost);
+    if (peer.queryRequestBudget.tryConsume(cost, __rdtsc(), frequency, PEER_QUERY_REQUEST_BUDGET_PERCENT))
+        return true;
+
+    _InterlockedIncrement64(&numberOfThrottledRequests);
+    return false;
+}
+
+// Claim the oldest request of the request queue without locking. Can be called from any request processor. Return false
+// if the queue is empty. The element has to be released with releaseRequestQueueElement() as soon as the request has been
+// copied, because the buffer space of later requests cannot be reused before.
+static bool claimRequestQueueElement(RequestQueue& queue, unsigned short& elementIndex)
+{
+    unsigned short tail = queue.elementTail;
+    while (tail != queue.elementHead)
+    {
+        const unsigned short prevTail = (unsigned short)_InterlockedCompareExchange16((volatile short*)&queue.elementTail, (short)(tail + 1), (short)tail);
+        if (prevTail == tail)
+        {
+            elementIndex = tail;
+            return true;
+        }
+        tail = prevTail;
+    }
+    return false;
+}
+
+// Claim the oldest request of the preferred request queue of the calling request processor. If this queue is empty, claim
+// the oldest request of the non-empty request queue with the highest priority. Return false if all queues are empty.
+static bool claimRequestQueueElement(unsigned int preferredQueueType, unsigned int& queueType, unsigned short& elementIndex)
+{
+    if (claimRequestQueueElement(requestQueues[preferredQueueType], elementIndex))
+    {
+        queueType = preferredQueueType;
+        return true;
+    }
+    for (queueType = 0; queueType < NUMBER_OF_REQUEST_QUEUES; queueType++)
+    {
+        if (queueType != preferredQueueType && claimRequestQueueElement(requestQueues[queueType], elementIndex))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Mark claimed element of request queue as released, so its buffer space can be reused.
+static void releaseRequestQueueElement(RequestQueue& queue, unsigned short elementIndex)
+{
+    ASSERT(!queue.elements[elementIndex].released);
+    _InterlockedExchange8(&queue.elements[elementIndex].released, 1);
+}
+
+// Advance elementReleaseTail and bufferTail over the released elements of the request queue.
+// Only called by the producer (peerReceiveAndTransmit() in main processor).
+static void freeReleasedRequestQueueElements(RequestQueue& queue)
+{
+    while (queue.elementReleaseTail != queue.elementHead && queue.elements[queue.elementReleaseTail].released)
+    {
+        queue.elements[queue.elementReleaseTail].released = 0;
+        queue.elementReleaseTail++;
+    }
+    queue.bufferTail = (queue.elementReleaseTail == queue.elementHead) ? queue.bufferHead : queue.elements[queue.elementReleaseTail].offset;
+}
+
 // Add message to response queue of specific peer. If peer is NULL, it will be sent to random peers. Can be called from any thread.
 static void enqueueResponse(Peer* peer, RequestResponseHeader* responseHeader)
 {
     PROFILE_SCOPE();
 
-    ACQUIRE(responseQueueHeadLock);
+    responseQueueHeadLock.acquire();
 
     if ((responseQueueBufferHead >= responseQueueBufferTail || responseQueueBufferHead + responseHeader->size() < responseQueueBufferTail)
         && (unsigned short)(responseQueueElementHead + 1) != responseQueueElementTail)
@@ -451,6 +776,9 @@ static void enqueueResponse(Peer* peer, RequestResponseHeader* responseHeader)
         ASSERT(responseQueueBufferHead + responseHeader->size() < RESPONSE_QUEUE_BUFFER_SIZE);
 
         responseQueueElements[responseQueueElementHead].offset = responseQueueBufferHead;
+        responseQueueElements[responseQueueElementHead].size = responseHeader->size();
+        responseQueueElements[responseQueueElementHead].isReserved = 0;
+        responseQueueElements[responseQueueElementHead].isCanceled = 0;
         copyMem(&responseQueueBuffer[responseQueueBufferHead], responseHeader, responseHeader->size());
         responseQueueBufferHead += responseHeader->size();
         responseQueueElements[responseQueueElementHead].peer = peer;
@@ -461,65 +789,51 @@ static void enqueueResponse(Peer* peer, RequestResponseHeader* responseHeader)
         responseQueueElementHead++;
     }
 
-    RELEASE(responseQueueHeadLock);
+    responseQueueHeadLock.release();
 }
 
 
-static void pushToOracleMachineNodes(RequestResponseHeader* requestResponseHeader)
+// Send queries of oracleMachineChannel that are due (new queries and queries waiting too long for reply) to all
+// connected oracle machine nodes. If no OM node is connected, the queries are kept in the channel. Only called by
+// main thread.
+static void pushToOracleMachineNodes()
 {
-#if !defined(NDEBUG)
-    // TODO: cleanup this debug code when OM connection is fully stable
-    setText(::message, L"pushToOracleMachineNodes(): ");
-#endif
     if (NUMBER_OF_OM_NODE_CONNECTIONS > 0)
     {
-        bool pushedToAny = false;
-        unsigned short numberOfSuitablePeers = 0;
-
-        // Heuristic pick the first byte of dejavu for tracking the retries
-        // Clear the dejavu retry if first bytes is greater than OM_MAX_RETRIES
-        // Incase of first bytes is 1 .. OM_MAX_RETRIES, we retrie fewer
-        // Currently is 0 when creating a querry, so it is not a problem
-        unsigned int currentDejavu = requestResponseHeader->dejavu();
-        if (OM_RETRY_COUNT(currentDejavu) > OM_MAX_RETRIES)
-        {
-            requestResponseHeader->setDejavu(currentDejavu & 0x00FFFFFF);
-        }
-
+        Peer* omPeers[NUMBER_OF_OM_NODE_CONNECTIONS];
+        unsigned int numberOfSuitablePeers = 0;
         for (unsigned int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS && numberOfSuitablePeers < NUMBER_OF_OM_NODE_CONNECTIONS; i++)
         {
-            if (peers[i].isOracleMachineNode())
+            if (peers[i].isOracleMachineNode()
+                && peers[i].tcp4Protocol
+                && peers[i].isConnectedAccepted
+                && !peers[i].isClosing)
             {
-                if (peers[i].tcp4Protocol
-                    && peers[i].isConnectedAccepted
-                    && !peers[i].isClosing)
-                {
-#if !defined(NDEBUG)
-                    appendIPv4Address(::message, peers[i].address);
-#endif
-                    push(&peers[i], requestResponseHeader);
-                    numberOfSuitablePeers++;
-                    pushedToAny = true;
-                }
+                omPeers[numberOfSuitablePeers++] = &peers[i];
             }
         }
+        if (!numberOfSuitablePeers)
+        {
+            return;
+        }
 
-        // Re-enqueue if no OM peer was ready.
-        if (!pushedToAny)
+        // queries due for sending are pipelined (not waiting for replies) and coalesced into frames if supported by all
+        // connected OM nodes
+        unsigned int maxQueriesPerFrame = OM_MAX_QUERIES_PER_BATCH_FRAME;
+        for (unsigned int i = 0; i < numberOfSuitablePeers; i++)
+        {
+            maxQueriesPerFrame = min(maxQueriesPerFrame, omPeers[i]->omMaxQueriesPerFrame);
+        }
+        const unsigned long long now = __rdtsc();
+        const RequestResponseHeader* frame;
+        while ((frame = oracleMachineChannel.buildFrame(now, frequency, maxQueriesPerFrame)) != nullptr)
         {
-            unsigned int retryCount = OM_RETRY_COUNT(requestResponseHeader->dejavu());
-            if (retryCount < OM_MAX_RETRIES)
+            for (unsigned int i = 0; i < numberOfSuitablePeers; i++)
             {
-                requestResponseHeader->setDejavu(
-                    OM_SET_RETRY_COUNT(requestResponseHeader->dejavu(), retryCount + 1));
-                enqueueResponse((Peer*)1, requestResponseHeader);
+                push(omPeers[i], (RequestResponseHeader*)frame);
             }
         }
     }
-#if !defined(NDEBUG)
-    addDebugMessage(::message);
-#endif
-
 }
 
 
@@ -528,7 +842,7 @@ static void enqueueResponse(Peer* peer, unsigned int dataSize, unsigned char typ
 {
     PROFILE_SCOPE();
 
-    ACQUIRE(responseQueueHeadLock);
+    responseQueueHeadLock.acquire();
 
     if ((responseQueueBufferHead >= responseQueueBufferTail || responseQueueBufferHead + sizeof(RequestResponseHeader) + dataSize < responseQueueBufferTail)
         && (unsigned short)(responseQueueElementHead + 1) != responseQueueElementTail)
@@ -551,6 +865,9 @@ static void enqueueResponse(Peer* peer, unsigned int dataSize, unsigned char typ
         {
             copyMem(&responseQueueBuffer[responseQueueBufferHead + sizeof(RequestResponseHeader)], data, dataSize);
         }
+        responseQueueElements[responseQueueElementHead].size = responseHeader->size();
+        responseQueueElements[responseQueueElementHead].isReserved = 0;
+        responseQueueElements[responseQueueElementHead].isCanceled = 0;
         responseQueueBufferHead += responseHeader->size();
         responseQueueElements[responseQueueElementHead].peer = peer;
         if (responseQueueBufferHead > RESPONSE_QUEUE_BUFFER_SIZE - BUFFER_SIZE)
@@ -560,7 +877,157 @@ static void enqueueResponse(Peer* peer, unsigned int dataSize, unsigned char typ
         responseQueueElementHead++;
     }
 
-    RELEASE(responseQueueHeadLock);
+    responseQueueHeadLock.release();
+}
+
+// Reserve space for a message with up to maxDataSize bytes of payload in the response queue, so the payload can be
+// written in place instead of being copied to the queue from another buffer. Returns the payload buffer or NULL if the
+// queue is full. The message has to be finished with commitResponse() or cancelResponse() right after writing the
+// payload, because later responses are not sent before. So only write payloads that are available in memory and never
+// wait for I/O (such as loading pages from disk) while holding the reservation. Can be called from any thread.
+static void* reserveResponse(Peer* peer, unsigned int maxDataSize, unsigned short& elementIndex)
+{
+    PROFILE_SCOPE();
+
+    void* payload = NULL;
+    const unsigned int size = sizeof(RequestResponseHeader) + maxDataSize;
+    ASSERT(size <= RequestResponseHeader::max_size);
+
+    responseQueueHeadLock.acquire();
+
+    if ((responseQueueBufferHead >= responseQueueBufferTail || responseQueueBufferHead + size < responseQueueBufferTail)
+        && (unsigned short)(responseQueueElementHead + 1) != responseQueueElementTail)
+    {
+        ASSERT(responseQueueElementHead < RESPONSE_QUEUE_LENGTH);
+        ASSERT(responseQueueBufferHead < RESPONSE_QUEUE_BUFFER_SIZE);
+        ASSERT(responseQueueBufferHead + size < RESPONSE_QUEUE_BUFFER_SIZE);
+
+        Response& element = responseQueueElements[responseQueueElementHead];
+        element.peer = peer;
+        element.offset = responseQueueBufferHead;
+        element.size = size;
+        element.isReserved = 1;
+        element.isCanceled = 0;
+        payload = &responseQueueBuffer[responseQueueBufferHead + sizeof(RequestResponseHeader)];
+        elementIndex = responseQueueElementHead;
+        responseQueueBufferHead += size;
+        if (responseQueueBufferHead > RESPONSE_QUEUE_BUFFER_SIZE - BUFFER_SIZE)
+        {
+            responseQueueBufferHead = 0;
+        }
+        responseQueueElementHead++;
+    }
+
+    responseQueueHeadLock.release();
+
+    return payload;
+}
+
+// Finish message reserved with reserveResponse() after dataSize bytes of payload have been written (dataSize must not
+// exceed maxDataSize of the reservation) and release it for sending. Unused space of the reservation is given back if
+// no other message has been enqueued in the meantime.
+static void commitResponse(unsigned short elementIndex, unsigned int dataSize, unsigned char type, unsigned int dejavu)
+{
+    Response& element = responseQueueElements[elementIndex];
+    ASSERT(element.isReserved);
+    ASSERT(sizeof(RequestResponseHeader) + dataSize <= element.size);
+
+    RequestResponseHeader* responseHeader = (RequestResponseHeader*)&responseQueueBuffer[element.offset];
+    responseHeader->checkAndSetSize(sizeof(RequestResponseHeader) + dataSize);
+    responseHeader->setType(type);
+    responseHeader->setDejavu(dejavu);
+
+    responseQueueHeadLock.acquire();
+    if ((unsigned short)(elementIndex + 1) == responseQueueElementHead && responseQueueBufferHead == element.offset + element.size)
+    {
+        element.size = responseHeader->size();
+        responseQueueBufferHead = element.offset + element.size;
+    }
+    responseQueueHeadLock.release();
+
+    _InterlockedExchange8(&element.isReserved, 0);
+}
+
+// Give up message reserved with reserveResponse() without sending it, for example if the payload cannot be written
+// without waiting. The space of the reservation is given back if no other message has been enqueued in the meantime.
+static void cancelResponse(unsigned short elementIndex)
+{
+    Response& element = responseQueueElements[elementIndex];
+    ASSERT(element.isReserved);
+    element.isCanceled = 1;
+
+    responseQueueHeadLock.acquire();
+    if ((unsigned short)(elementIndex + 1) == responseQueueElementHead && responseQueueBufferHead == element.offset + element.size)
+    {
+        element.size = 0;
+        responseQueueBufferHead = element.offset;
+    }
+    responseQueueHeadLock.release();
+
+    _InterlockedExchange8(&element.isReserved, 0);
+}
+
+// Reserve count consecutive messages with dataSize bytes of payload each in the response queue and set their headers, so
+// many messages can be enqueued with one acquisition of the response queue lock. Returns the number of reserved messages
+// (less than count if the queue is full) and the index of the first element (following elements have consecutive
+// indices). The payloads have to be written with getReservedResponsePayload() and each message has to be released with
+// releaseReservedResponse() as soon as possible, because later responses are not sent before. Can be called from any
+// thread.
+static unsigned int reserveResponses(Peer* peer, unsigned int count, unsigned int dataSize, unsigned char type, unsigned int dejavu, unsigned short& firstElementIndex)
+{
+    PROFILE_SCOPE();
+
+    const unsigned int size = sizeof(RequestResponseHeader) + dataSize;
+    ASSERT(size <= RequestResponseHeader::max_size);
+    unsigned int reservedCount = 0;
+
+    responseQueueHeadLock.acquire();
+
+    firstElementIndex = responseQueueElementHead;
+    while (reservedCount < count
+        && (responseQueueBufferHead >= responseQueueBufferTail || responseQueueBufferHead + size < responseQueueBufferTail)
+        && (unsigned short)(responseQueueElementHead + 1) != responseQueueElementTail)
+    {
+        ASSERT(responseQueueElementHead < RESPONSE_QUEUE_LENGTH);
+        ASSERT(responseQueueBufferHead < RESPONSE_QUEUE_BUFFER_SIZE);
+        ASSERT(responseQueueBufferHead + size < RESPONSE_QUEUE_BUFFER_SIZE);
+
+        Response& element = responseQueueElements[responseQueueElementHead];
+        element.peer = peer;
+        element.offset = responseQueueBufferHead;
+        element.size = size;
+        element.isReserved = 1;
+        element.isCanceled = 0;
+        RequestResponseHeader* responseHeader = (RequestResponseHeader*)&responseQueueBuffer[responseQueueBufferHead];
+        responseHeader->checkAndSetSize(size);
+        responseHeader->setType(type);
+        responseHeader->setDejavu(dejavu);
+        responseQueueBufferHead += size;
+        if (responseQueueBufferHead > RESPONSE_QUEUE_BUFFER_SIZE - BUFFER_SIZE)
+        {
+            responseQueueBufferHead = 0;
+        }
+        responseQueueElementHead++;
+        reservedCount++;
+    }
+
+    responseQueueHeadLock.release();
+
+    return reservedCount;
+}
+
+// Return payload buffer of message reserved with reserveResponses()
+static void* getReservedResponsePayload(unsigned short elementIndex)
+{
+    ASSERT(responseQueueElements[elementIndex].isReserved);
+    return &responseQueueBuffer[responseQueueElements[elementIndex].offset + sizeof(RequestResponseHeader)];
+}
+
+// Release message reserved with reserveResponses() for sending after its payload has been written
+static void releaseReservedResponse(unsigned short elementIndex)
+{
+    ASSERT(responseQueueElements[elementIndex].isReserved);
+    _InterlockedExchange8(&responseQueueElements[elementIndex].isReserved, 0);
 }
 
 /**
@@ -618,16 +1085,18 @@ static void forgetPublicPeer(const IPv4Address& address)
 
     ACQUIRE(publicPeersLock);
 
-    for (unsigned int i = 0; numberOfPublicPeers > NUMBER_OF_PUBLIC_PEERS_TO_KEEP && i < numberOfPublicPeers; i++)
+    if (numberOfPublicPeers > NUMBER_OF_PUBLIC_PEERS_TO_KEEP)
     {
-        if (publicPeers[i].address == address)
+        const int i = publicPeersIndex.find(address);
+        if (i >= 0)
         {
-            if (i != --numberOfPublicPeers)
+            publicPeersIndex.remove(address);
+            if ((unsigned int)i != --numberOfPublicPeers)
             {
+                // move last peer to the free slot
+                publicPeersIndex.setSlot(publicPeers[numberOfPublicPeers].address, i);
                 copyMem(&publicPeers[i], &publicPeers[numberOfPublicPeers], sizeof(PublicPeer));
             }
-
-            break;
         }
     }
 
@@ -641,20 +1110,21 @@ static void penalizePublicPeerRejectedConnection(const IPv4Address& address)
 
     ACQUIRE(publicPeersLock);
 
-    for (unsigned int i = 0; i < numberOfPublicPeers; i++)
+    const int i = publicPeersIndex.find(address);
+    if (i >= 0)
     {
-        if (publicPeers[i].address == address)
+        if (publicPeers[i].rejectedConnections < 255)
         {
-            if (publicPeers[i].isHandshaked || publicPeers[i].isFullnode)
-            {
-                publicPeers[i].isHandshaked = false;
-                publicPeers[i].isFullnode = false;
-            }
-            else
-            {
-                forgetPeer = true;
-            }
-            break;
+            publicPeers[i].rejectedConnections++;
+        }
+        if (publicPeers[i].isHandshaked || publicPeers[i].isFullnode)
+        {
+            publicPeers[i].isHandshaked = false;
+            publicPeers[i].isFullnode = false;
+        }
+        else
+        {
+            forgetPeer = true;
         }
     }
 
@@ -677,26 +1147,56 @@ static void addPublicPeer(const IPv4Address& address)
     {
         return;
     }
-    for (unsigned int i = 0; i < numberOfPublicPeers; i++)
-    {
-        if (address == publicPeers[i].address)
-        {
-            return;
-        }
-    }
 
     ACQUIRE(publicPeersLock);
 
-    if (numberOfPublicPeers < MAX_NUMBER_OF_PUBLIC_PEERS)
+    if (numberOfPublicPeers < MAX_NUMBER_OF_PUBLIC_PEERS && publicPeersIndex.insert(address, numberOfPublicPeers))
     {
         publicPeers[numberOfPublicPeers].isHandshaked = false;
         publicPeers[numberOfPublicPeers].isFullnode = false;
+        publicPeers[numberOfPublicPeers].rejectedConnections = 0;
         publicPeers[numberOfPublicPeers++].address = address;
     }
 
     RELEASE(publicPeersLock);
 }
 
+// Mark public peer as handshaked after it has sent ExchangePublicPeers on an outgoing connection
+static void setPublicPeerHandshaked(const IPv4Address& address)
+{
+    ACQUIRE(publicPeersLock);
+
+    const int i = publicPeersIndex.find(address);
+    if (i >= 0)
+    {
+        publicPeers[i].isHandshaked = true;
+        publicPeers[i].rejectedConnections = 0;
+    }
+
+    RELEASE(publicPeersLock);
+}
+
+// Return if public peer a is preferred to b for outgoing connections: full nodes first, then handshaked peers, then
+// peers with fewer rejected connections
+static bool isPreferredPublicPeer(const PublicPeer& a, const PublicPeer& b)
+{
+    if (a.isFullnode != b.isFullnode)
+        return a.isFullnode;
+    if (a.isHandshaked != b.isHandshaked)
+        return a.isHandshaked;
+    return a.rejectedConnections < b.rejectedConnections;
+}
+
+// Select public peer for an outgoing connection: the better one of two randomly chosen peers. Compared to choosing
+// the best peers directly, this still spreads connections over all peers and lets new peers prove themselves.
+static IPv4Address selectPublicPeerForConnection()
+{
+    const unsigned int count = numberOfPublicPeers;
+    const unsigned int a = random(count);
+    const unsigned int b = random(count);
+    return isPreferredPublicPeer(publicPeers[b], publicPeers[a]) ? publicPeers[b].address : publicPeers[a].address;
+}
+
 static bool peerConnectionNewlyEstablished(unsigned int i)
 {
     PROFILE_SCOPE();
@@ -817,7 +1317,7 @@ static bool peerConnectionNewlyEstablished(unsigned int i)
 
 // This function process all data that arrive in FragmentBuffer.
 // based on RequestResponseHeader to determine whether the received packet is completed or not
-// if it receives a completed packet, it will copy the packet to requestQueueElements to process later in requestProcessors
+// if it receives a completed packet, it will copy the packet to the request queue of its traffic class to process later in requestProcessors
 static void processReceivedData(unsigned int i, unsigned int salt)
 {
     PROFILE_SCOPE();
@@ -844,87 +1344,103 @@ static void processReceivedData(unsigned int i, unsigned int salt)
                     numberOfReceivedBytes += peers[i].receiveData.DataLength;
                     *((unsigned long long*) & peers[i].receiveData.FragmentTable[0].FragmentBuffer) += peers[i].receiveData.DataLength;
 
-                iteration:
-                    unsigned int receivedDataSize = (unsigned int)(((unsigned long long)peers[i].receiveData.FragmentTable[0].FragmentBuffer) - ((unsigned long long)peers[i].receiveBuffer));
-
-                    if (receivedDataSize >= sizeof(RequestResponseHeader))
+                    const unsigned int receivedDataSize = (unsigned int)(((unsigned long long)peers[i].receiveData.FragmentTable[0].FragmentBuffer) - ((unsigned long long)peers[i].receiveBuffer));
+                    const long long remainingDataSize = processReceiveBuffer((unsigned char*)peers[i].receiveBuffer, receivedDataSize, [&](RequestResponseHeader* requestResponseHeader)
                     {
-                        RequestResponseHeader* requestResponseHeader = (RequestResponseHeader*)peers[i].receiveBuffer;
-                        if (requestResponseHeader->size() < sizeof(RequestResponseHeader))
+                        // Compute saltId of packet with K12 of payload and header (size + type temporarily
+                        // overwritten with salt). This is used recognized and skip packet duplicates with
+                        // dejavuFilter, which remembers the packets queued for processing in the last
+                        // DEJAVU_WINDOW_SECONDS.
+                        // Transactions and future tick data are an exception: their full payload digest is
+                        // needed by the request processor anyway (verified txs cache, pending txs pool, tick
+                        // data), so it is computed here once and passed on with the request. The saltedId is
+                        // derived from the salt, the dejavu, and this digest.
+                        unsigned long long saltedId;
+                        m256i payloadDigest = m256i::zero();
+                        if (requestResponseHeader->type() == BROADCAST_TRANSACTION || requestResponseHeader->type() == BROADCAST_FUTURE_TICK_DATA)
                         {
-                            // protocol violation -> forget peer
-                            setText(message, L"Forgetting ");
-                            appendIPv4Address(message, peers[i].address);
-                            appendText(message, L"...");
-                            logToConsole(message);
-                            forgetPublicPeer(peers[i].address);
-                            closePeer(&peers[i]);
+                            KangarooTwelve(requestResponseHeader->getPayload<unsigned char>(), requestResponseHeader->getPayloadSize(), &payloadDigest, sizeof(payloadDigest));
+                            struct
+                            {
+                                unsigned int salt;
+                                unsigned int dejavu;
+                                m256i payloadDigest;
+                            } saltedIdInput = { salt, requestResponseHeader->dejavu(), payloadDigest };
+                            KangarooTwelve(&saltedIdInput, sizeof(saltedIdInput), &saltedId, sizeof(saltedId));
                         }
                         else
                         {
-                            if (receivedDataSize >= requestResponseHeader->size())
+                            const unsigned int header = *((unsigned int*)requestResponseHeader);
+                            *((unsigned int*)requestResponseHeader) = salt;
+                            KangarooTwelve(requestResponseHeader, header & 0xFFFFFF, &saltedId, sizeof(saltedId));
+                            *((unsigned int*)requestResponseHeader) = header;
+                        }
+
+                        // Initiate transfer of already received packet to processing thread
+                        // (or drop it without processing if Dejavu filter tells to ignore it)
+                        const unsigned int now = (unsigned int)(__rdtsc() / frequency);
+                        const bool isDuplicate = dejavuFilter.contains(saltedId, now);
+                        peers[i].countReceivedMessage(isDuplicate);
+                        if (!isDuplicate)
+                        {
+                            const unsigned int queueType = getRequestQueueType(requestResponseHeader->type());
+                            const unsigned int queueBufferSize = requestQueueBufferSizes[queueType];
+                            RequestQueue& queue = requestQueues[queueType];
+                            freeReleasedRequestQueueElements(queue);
+                            if (!isRequestAdmitted(peers[i], queueType, requestResponseHeader->type()))
                             {
-                                // Compute saltId of packet with K12 of payload and header (size + type temporarily
-                                // overwritten with salt). This is used recognized and skip packet duplicates with
-                                // dejavu0 (checking/setting flag for received package). After receiving a certain
-                                // number of packages (DEJAVU_SWAP_LIMIT), dejavu0 is moved to dejavu1 for checking
-                                // and dejavu0 is initialized with an empty buffer for checking/setting.
-                                unsigned int saltedId;
-                                const unsigned int header = *((unsigned int*)requestResponseHeader);
-                                *((unsigned int*)requestResponseHeader) = salt;
-                                KangarooTwelve(requestResponseHeader, header & 0xFFFFFF, &saltedId, sizeof(saltedId));
-                                *((unsigned int*)requestResponseHeader) = header;
-
-                                // Initiate transfer of already received packet to processing thread
-                                // (or drop it without processing if Dejavu filter tells to ignore it)
-                                if (!((dejavu0[saltedId >> 6] | dejavu1[saltedId >> 6]) & (1ULL << (saltedId & 63))))
-                                {
-                                    if ((requestQueueBufferHead >= requestQueueBufferTail || requestQueueBufferHead + requestResponseHeader->size() < requestQueueBufferTail)
-                                        && (unsigned short)(requestQueueElementHead + 1) != requestQueueElementTail)
-                                    {
-                                        dejavu0[saltedId >> 6] |= (1ULL << (saltedId & 63));
-
-                                        ASSERT(requestQueueElementHead < REQUEST_QUEUE_LENGTH);
-                                        ASSERT(requestQueueBufferHead < REQUEST_QUEUE_BUFFER_SIZE);
-                                        ASSERT(requestQueueBufferHead + requestResponseHeader->size() < REQUEST_QUEUE_BUFFER_SIZE);
-
-                                        requestQueueElements[requestQueueElementHead].offset = requestQueueBufferHead;
-                                        copyMem(&requestQueueBuffer[requestQueueBufferHead], peers[i].receiveBuffer, requestResponseHeader->size());
-                                        requestQueueBufferHead += requestResponseHeader->size();
-                                        requestQueueElements[requestQueueElementHead].peer = &peers[i];
-                                        if (requestQueueBufferHead > REQUEST_QUEUE_BUFFER_SIZE - BUFFER_SIZE)
-                                        {
-                                            requestQueueBufferHead = 0;
-                                        }
-                                        // TODO: Place a fence
-                                        requestQueueElementHead++;
-
-                                        if (!(--dejavuSwapCounter))
-                                        {
-                                            unsigned long long* tmp = dejavu1;
-                                            dejavu1 = dejavu0;
-                                            setMem(dejavu0 = tmp, 536870912, 0);
-                                            dejavuSwapCounter = DEJAVU_SWAP_LIMIT;
-                                        }
-                                    }
-                                    else
-                                    {
-                                        _InterlockedIncrement64(&numberOfDiscardedRequests);
-
-                                        enqueueResponse(&peers[i], 0, TryAgain::type(), requestResponseHeader->dejavu(), NULL);
-                                    }
-                                }
-                                else
+                                // peer is over budget -> reject before copying (not inserted into dejavuFilter,
+                                // so the request can be repeated after TryAgain)
+                                enqueueResponse(&peers[i], 0, TryAgain::type(), requestResponseHeader->dejavu(), NULL);
+                            }
+                            else if ((queue.bufferHead >= queue.bufferTail || queue.bufferHead + requestResponseHeader->size() < queue.bufferTail)
+                                && (unsigned short)(queue.elementHead + 1) != queue.elementReleaseTail)
+                            {
+                                dejavuFilter.insert(saltedId, now);
+
+                                ASSERT(queue.elementHead < REQUEST_QUEUE_LENGTH);
+                                ASSERT(queue.bufferHead < queueBufferSize);
+                                ASSERT(queue.bufferHead + requestResponseHeader->size() < queueBufferSize);
+
+                                queue.elements[queue.elementHead].offset = queue.bufferHead;
+                                copyMem(&queue.buffer[queue.bufferHead], requestResponseHeader, requestResponseHeader->size());
+                                queue.bufferHead += requestResponseHeader->size();
+                                queue.elements[queue.elementHead].peer = &peers[i];
+                                queue.elements[queue.elementHead].payloadDigest = payloadDigest;
+                                if (queue.bufferHead > queueBufferSize - BUFFER_SIZE)
                                 {
-                                    _InterlockedIncrement64(&numberOfDuplicateRequests);
+                                    queue.bufferHead = 0;
                                 }
+                                // TODO: Place a fence
+                                queue.elementHead++;
+                            }
+                            else
+                            {
+                                _InterlockedIncrement64(&numberOfDiscardedRequests);
 
-                                copyMem(peers[i].receiveBuffer, ((char*)peers[i].receiveBuffer) + requestResponseHeader->size(), receivedDataSize -= requestResponseHeader->size());
-                                peers[i].receiveData.FragmentTable[0].FragmentBuffer = ((char*)peers[i].receiveBuffer) + receivedDataSize;
-
-                                goto iteration;
+                                enqueueResponse(&peers[i], 0, TryAgain::type(), requestResponseHeader->dejavu(), NULL);
                             }
                         }
+                        else
+                        {
+                            _InterlockedIncrement64(&numberOfDuplicateRequests);
+                        }
+                    });
+
+                    if (remainingDataSize < 0)
+                    {
+                        // protocol violation -> forget peer (closePeer() may release the receive buffer, so it must not
+                        // be touched anymore)
+                        setText(message, L"Forgetting ");
+                        appendIPv4Address(message, peers[i].address);
+                        appendText(message, L"...");
+                        logToConsole(message);
+                        forgetPublicPeer(peers[i].address);
+                        closePeer(&peers[i]);
+                    }
+                    else
+                    {
+                        peers[i].receiveData.FragmentTable[0].FragmentBuffer = ((char*)peers[i].receiveBuffer) + remainingDataSize;
                     }
                 }
             }
@@ -942,10 +1458,21 @@ static void receiveData(unsigned int i, unsigned int salt)
     {
         if (!peers[i].isReceiving && peers[i].isConnectedAccepted && !peers[i].isClosing)
         {
-            // check that receive buffer has enough space (less than BUFFER_SIZE is used)
-            if ((((unsigned long long)peers[i].receiveData.FragmentTable[0].FragmentBuffer) - ((unsigned long long)peers[i].receiveBuffer)) < BUFFER_SIZE)
+            // switch to large receive buffer if the incomplete message at the beginning of the buffer doesn't fit
+            const RequestResponseHeader* incompleteMessageHeader = (const RequestResponseHeader*)peers[i].receiveBuffer;
+            if (peers[i].receiveBufferSize < BUFFER_SIZE
+                && (((unsigned long long)peers[i].receiveData.FragmentTable[0].FragmentBuffer) - ((unsigned long long)peers[i].receiveBuffer)) >= sizeof(RequestResponseHeader)
+                && incompleteMessageHeader->size() > peers[i].receiveBufferSize
+                && !peers[i].growReceiveBuffer())
+            {
+                closePeer(&peers[i]);
+                return;
+            }
+
+            // check that receive buffer has enough space (less than receiveBufferSize is used)
+            if ((((unsigned long long)peers[i].receiveData.FragmentTable[0].FragmentBuffer) - ((unsigned long long)peers[i].receiveBuffer)) < peers[i].receiveBufferSize)
             {
-                unsigned int receiveSize = BUFFER_SIZE - (unsigned int)(((unsigned long long)peers[i].receiveData.FragmentTable[0].FragmentBuffer) - ((unsigned long long)peers[i].receiveBuffer));
+                unsigned int receiveSize = peers[i].receiveBufferSize - (unsigned int)(((unsigned long long)peers[i].receiveData.FragmentTable[0].FragmentBuffer) - ((unsigned long long)peers[i].receiveBuffer));
                 peers[i].receiveData.DataLength = receiveSize;
                 peers[i].receiveData.FragmentTable[0].FragmentLength = receiveSize;
                 if (peers[i].receiveData.DataLength)
@@ -1021,6 +1548,7 @@ static void processTransmittedData(unsigned int i, unsigned int salt)
                 {
                     // success
                     numberOfTransmittedBytes += peers[i].transmitData.DataLength;
+                    peers[i].countCompletedTransmission();
 
                     // Update OM activity time on successful transmit so the inactivity
                     // timer doesn't kill connections that are actively sending queries
@@ -1052,8 +1580,15 @@ static void transmitData(unsigned int i, unsigned int salt)
             }
             else
             {
-                // initiate transmission
-                copyMem(peers[i].transmitData.FragmentTable[0].FragmentBuffer, peers[i].dataToTransmit, peers[i].transmitData.DataLength = peers[i].transmitData.FragmentTable[0].FragmentLength = peers[i].dataToTransmitSize);
+                // initiate transmission: instead of copying the queued data to the transmit buffer, swap the buffers (the
+                // transmit buffer is unused while not transmitting and becomes the buffer for pushing new messages)
+                char* transmitBuffer = (char*)peers[i].transmitData.FragmentTable[0].FragmentBuffer;
+                const unsigned int transmitBufferSize = peers[i].transmitBufferSize;
+                peers[i].transmitData.FragmentTable[0].FragmentBuffer = peers[i].dataToTransmit;
+                peers[i].transmitBufferSize = peers[i].dataToTransmitBufferSize;
+                peers[i].dataToTransmit = transmitBuffer;
+                peers[i].dataToTransmitBufferSize = transmitBufferSize;
+                peers[i].transmitData.DataLength = peers[i].transmitData.FragmentTable[0].FragmentLength = peers[i].dataToTransmitSize;
                 peers[i].dataToTransmitSize = 0;
                 if (status = peers[i].tcp4Protocol->Transmit(peers[i].tcp4Protocol, &peers[i].transmitToken))
                 {
@@ -1063,6 +1598,7 @@ static void transmitData(unsigned int i, unsigned int salt)
                 else
                 {
                     peers[i].isTransmitting = TRUE;
+                    peers[i].transmitStartTime = __rdtsc();
                     if (peers[i].isOracleMachineNode())
                     {
                         peers[i].omTransmitStartTime = __rdtsc();
@@ -1088,6 +1624,20 @@ static void peerReceiveAndTransmit(unsigned int i, unsigned int salt)
     }
 }
 
+// Receive and transmit on all active connections, without handling new or inactive connections. Called by the main
+// loop between housekeeping steps that may take long (such as saving files or logging), so the network is polled more
+// regularly. The UEFI network protocols can only be used from the main processor, so polling cannot be moved to an AP.
+static void peersReceiveAndTransmit(unsigned int salt)
+{
+    ASSERT(isMainProcessor());
+    PROFILE_SCOPE();
+    PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_PEERS_RECEIVE_TRANSMIT);
+    for (unsigned int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS; i++)
+    {
+        peerReceiveAndTransmit(i, salt);
+    }
+}
+
 static void peerReconnectIfInactive(unsigned int i, unsigned short port)
 {
     PROFILE_SCOPE();
@@ -1134,7 +1684,7 @@ static void peerReconnectIfInactive(unsigned int i, unsigned short port)
                 peers[i].isOMNode = FALSE;
                 // randomly select public peer and try to connect if we do not
                 // yet have an outgoing connection to it
-                peers[i].address = publicPeers[random(numberOfPublicPeers)].address;
+                peers[i].address = selectPublicPeerForConnection();
             }
 
             if (peers[i].address.u32 != 0)
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "platform/memory.h"
+
+#include "network_messages/header.h"
+
+// Hand on all complete messages at the beginning of a peer's receive buffer holding receivedDataSize bytes by calling
+// processMessage(RequestResponseHeader*) for each of them. Afterwards, the remaining (incomplete) data is moved to the
+// beginning of the buffer only once, not after each message. Returns the number of bytes left in the buffer.
+// Returns -1 if a message header with a size smaller than the header itself is found (protocol violation). In this
+// case, the buffer is not touched anymore, because the caller closes the connection, which may release the buffer.
+template <typename MessageProcessor>
+static long long processReceiveBuffer(unsigned char* buffer, unsigned int receivedDataSize, MessageProcessor processMessage)
+{
+    unsigned int processedDataSize = 0;
+    while (receivedDataSize - processedDataSize >= sizeof(RequestResponseHeader))
+    {
+        RequestResponseHeader* requestResponseHeader = (RequestResponseHeader*)(buffer + processedDataSize);
+        if (requestResponseHeader->size() < sizeof(RequestResponseHeader))
+        {
+            return -1;
+        }
+        if (receivedDataSize - processedDataSize < requestResponseHeader->size())
+        {
+            break;
+        }
+        processMessage(requestResponseHeader);
+        processedDataSize += requestResponseHeader->size();
+    }
+
+    const unsigned int remainingDataSize = receivedDataSize - processedDataSize;
+    if (processedDataSize && remainingDataSize)
+    {
+        copyMem(buffer, buffer + processedDataSize, remainingDataSize);
+    }
+    return remainingDataSize;
+}
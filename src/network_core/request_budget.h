@@ -0,0 +1,91 @@
+#pragma once
+
+#include "platform/assert.h"
+
+// Token bucket limiting the processing time that request processors spend on the query requests of one peer, so a
+// single client cannot fill the request queue with expensive requests and degrade the node for everyone else. The
+// budget is measured in CPU ticks (TSC) and refilled with sharePercent % of the elapsed time, i.e. a peer may use
+// sharePercent % of one request processor on average. The budget holds at most one second of refill, so short bursts
+// are allowed. A request is admitted as long as the budget isn't negative and its estimated cost is subtracted, so the
+// budget may become negative (debt) and no request is rejected just because its cost is higher than the burst size.
+// A new connection starts with an empty budget, so reconnecting doesn't provide a new burst (only one request, which
+// creates debt that has to be paid back before the next one).
+//
+// Not thread-safe: all functions must be called by the same processor (main processor receiving the requests).
+struct RequestBudget
+{
+    long long budget;
+    unsigned long long lastRefillTime;
+
+    // Statistics since reset()
+    unsigned long long consumedCost;
+    unsigned int admittedCount;
+    unsigned int throttledCount;
+
+    void reset()
+    {
+        budget = 0;
+        lastRefillTime = 0;
+        consumedCost = 0;
+        admittedCount = 0;
+        throttledCount = 0;
+    }
+
+    // Refill budget up to now (TSC) and try to consume cost. Returns false if the request should be rejected.
+    bool tryConsume(unsigned long long cost, unsigned long long now, unsigned long long tscFrequency, unsigned int sharePercent)
+    {
+        ASSERT(sharePercent > 0);
+        const long long maxBudget = (long long)(tscFrequency / 100 * sharePercent);
+        if (!lastRefillTime)
+        {
+            // start with empty budget
+            budget = 0;
+        }
+        else
+        {
+            // guard against time going backwards
+            const unsigned long long elapsed = (now > lastRefillTime) ? now - lastRefillTime : 0;
+            const long long refill = (long long)((elapsed / 100) * sharePercent + (elapsed % 100) * sharePercent / 100);
+            budget = (budget + refill < maxBudget) ? budget + refill : maxBudget;
+        }
+        lastRefillTime = now;
+
+        if (budget < 0)
+        {
+            ++throttledCount;
+            return false;
+        }
+        budget -= (long long)cost;
+        consumedCost += cost;
+        ++admittedCount;
+        return true;
+    }
+};
+
+// Estimated processing cost (CPU ticks) of requests of each message type, kept as moving average of the processing
+// time measured by the request processors. Updates from several processors aren't synchronized, because a lost update
+// only delays the adaptation of the estimate slightly.
+struct RequestCostEstimator
+{
+    volatile unsigned long long averageCost[256];
+
+    void reset()
+    {
+        for (unsigned int i = 0; i < 256; ++i)
+            averageCost[i] = 0;
+    }
+
+    // Add measured processing time of a request with given type
+    void update(unsigned char messageType, unsigned long long cost)
+    {
+        const unsigned long long prevAverage = averageCost[messageType];
+        averageCost[messageType] = (prevAverage) ? (prevAverage * 15 + cost) / 16 : cost;
+    }
+
+    // Return estimated cost of a request with given type, at least minimumCost (also used for types not seen yet)
+    unsigned long long estimate(unsigned char messageType, unsigned long long minimumCost) const
+    {
+        const unsigned long long average = averageCost[messageType];
+        return (average > minimumCost) ? average : minimumCost;
+    }
+};
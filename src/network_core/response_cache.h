@@ -0,0 +1,70 @@
+#pragma once
+
+#include "platform/m256.h"
+#include "platform/read_write_lock.h"
+
+// Payload of a response message that is requested often but whose underlying data changes rarely (such as
+// RespondSystemInfo, which is assembled from many globals). The payload is only rebuilt if the version passed by the
+// caller differs from the version of the cached payload, which is the case whenever the underlying data may have
+// changed (for example, new tick or epoch). Otherwise, requests are answered by copying the cached payload.
+//
+// The version is an arbitrary 256-bit value built by the caller from the counters that change with the data. Payloads
+// may briefly be rebuilt for an older version if requests with different versions race, so the version should only
+// be used for data that may be slightly outdated anyway.
+//
+// An object with all bytes zero is a valid empty cache, so it can be used in global variables without constructor.
+template <typename PayloadType>
+class ResponseCache
+{
+public:
+    // Invalidate cached payload and reset statistics.
+    void reset()
+    {
+        lock.reset();
+        valid = false;
+        version = m256i::zero();
+        rebuildCount = 0;
+    }
+
+    // Return cached payload, rebuilding it with build(PayloadType&) if it isn't of the given version. The payload is
+    // not changed until release() is called, so the caller can copy it into the response queue.
+    template <typename BuildFunction>
+    const PayloadType& acquire(const m256i& currentVersion, BuildFunction build)
+    {
+        lock.acquireRead();
+        if (!valid || version != currentVersion)
+        {
+            lock.releaseRead();
+            lock.acquireWrite();
+            if (!valid || version != currentVersion)
+            {
+                build(payload);
+                version = currentVersion;
+                valid = true;
+                ++rebuildCount;
+            }
+            lock.releaseWrite();
+            lock.acquireRead();
+        }
+        return payload;
+    }
+
+    // Release payload returned by acquire().
+    void release()
+    {
+        lock.releaseRead();
+    }
+
+    // Return how often the payload has been built since reset()
+    unsigned long long getRebuildCount() const
+    {
+        return rebuildCount;
+    }
+
+private:
+    PayloadType payload;
+    m256i version;
+    bool valid;
+    ReadWriteLock lock;
+    unsigned long long rebuildCount;
+};
@@ -0,0 +1,300 @@
+#pragma once
+
+#include "platform/m256.h"
+#include "platform/memory.h"
+#include "platform/assert.h"
+
+#include "network_messages/state_sync.h"
+
+#include "kangaroo_twelve.h"
+#include "merkle_tree.h"
+
+// Client side of RequestStateChunk: downloads the spectrum, the universe, or the state of one contract from peers chunk
+// by chunk. Each response is verified with its Merkle proof against the root digest confirmed by the quorum before its
+// data is copied to the destination. The caller sends the requests returned by getNextRequest() to peers (several in
+// parallel) and passes the responses to processResponse() together with the confirmed digest, which is the
+// prevSpectrumDigest / prevUniverseDigest / prevComputerDigest of the quorum tick following response->tick.
+//
+// The state changes while it is downloaded, so the chunks of the spectrum / universe may belong to different ticks.
+// After all chunks have been downloaded, the digests of all chunks are requested (chunkDigestsFlag) and the chunks
+// that differ are downloaded again. The download is complete when the digests of all chunks have been checked against
+// the same root, so the destination holds the state of getTick(). This converges if the changed chunks can be
+// downloaded again faster than the state changes.
+//
+// Contract states are only proven as a whole. All chunks need to belong to the same version of the state, which is
+// given by the contract state digest sent with each chunk (a chunk of a newer version restarts the download). The
+// digest of the complete state is checked after the last chunk and the download restarts if it doesn't match.
+//
+// Not thread-safe.
+class StateChunkDownload
+{
+public:
+    static constexpr unsigned int maxChunks = 1 << 16;
+
+    // Start download of state of the given type (RequestStateChunk::spectrumState, universeState, or contractState) into
+    // destination, which has size bytes. For the spectrum and universe, size is the capacity times the record size and
+    // depth is the depth of their Merkle tree (SPECTRUM_DEPTH, ASSETS_DEPTH). For contract states, size is the state
+    // size and depth is the depth of the tree of contract state digests. Return false if parameters are invalid.
+    bool init(unsigned char stateType, unsigned short contractIndex, void* destination, unsigned long long size, unsigned int depth)
+    {
+        setMem(this, sizeof(*this), 0);
+        if (!destination || !size || depth >= 64)
+            return false;
+
+        this->stateType = stateType;
+        this->contractIndex = contractIndex;
+        this->destination = (unsigned char*)destination;
+        this->size = size;
+        this->depth = depth;
+        if (stateType == RequestStateChunk::contractState)
+        {
+            if (size > 0xFFFFFFFFULL)
+                return false;
+            chunkSize = RequestStateChunk::maxContractStateBytes;
+            chunkCount = (unsigned int)((size + chunkSize - 1) / chunkSize);
+        }
+        else if (stateType == RequestStateChunk::spectrumState || stateType == RequestStateChunk::universeState)
+        {
+            const unsigned int recordSize = RespondStateChunk::recordSize(stateType);
+            const unsigned long long records = size / recordSize;
+            if (depth > 32 || size != (1ULL << depth) * recordSize)
+                return false;
+            chunkLevel = 0;
+            while ((1ULL << chunkLevel) < records && (1u << chunkLevel) < RequestStateChunk::maxRecords)
+                ++chunkLevel;
+            chunkSize = (1u << chunkLevel) * recordSize;
+            chunkCount = (unsigned int)(records >> chunkLevel);
+            digestsPerRange = (chunkCount < RequestStateChunk::maxRecords) ? chunkCount : RequestStateChunk::maxRecords;
+            rangeCount = chunkCount / digestsPerRange;
+        }
+        return chunkCount && chunkCount <= maxChunks;
+    }
+
+    // Fill request for the next missing chunk or the digests of the next chunks that haven't been checked yet. Chunks are
+    // requested round robin, so requests sent in parallel ask for different chunks. Return false if download is complete.
+    bool getNextRequest(RequestStateChunk& request)
+    {
+        if (isComplete() || !chunkCount)
+            return false;
+
+        setMem(&request, sizeof(request), 0);
+        request.stateType = stateType;
+        request.contractIndex = contractIndex;
+        if (receivedCount < chunkCount)
+        {
+            while (isReceived(nextChunk))
+                nextChunk = (nextChunk + 1 < chunkCount) ? nextChunk + 1 : 0;
+            request.firstIndex = (stateType == RequestStateChunk::contractState) ? nextChunk : nextChunk << chunkLevel;
+            request.numberOfRecords = 1u << chunkLevel;
+            nextChunk = (nextChunk + 1 < chunkCount) ? nextChunk + 1 : 0;
+        }
+        else
+        {
+            while (rangeChecked[nextRange])
+                nextRange = (nextRange + 1 < rangeCount) ? nextRange + 1 : 0;
+            request.stateType |= RequestStateChunk::chunkDigestsFlag;
+            request.level = (unsigned char)chunkLevel;
+            request.firstIndex = nextRange * digestsPerRange;
+            request.numberOfRecords = digestsPerRange;
+            nextRange = (nextRange + 1 < rangeCount) ? nextRange + 1 : 0;
+        }
+        return true;
+    }
+
+    // Verify response of size bytes with confirmedRoot, the digest confirmed by the quorum for response->tick, and
+    // copy the data to the destination. Return false if the response is invalid, doesn't match the current download,
+    // or is outdated.
+    bool processResponse(const RespondStateChunk* response, unsigned long long responseSize, const m256i& confirmedRoot)
+    {
+        if (responseSize < sizeof(RespondStateChunk) || responseSize != response->payloadSize()
+            || !response->numberOfRecords || response->rootDigest != confirmedRoot || !chunkCount)
+            return false;
+
+        if (stateType == RequestStateChunk::contractState)
+            return processContractStateChunk(response);
+        if (response->stateType == stateType)
+            return processRecords(response);
+        if (response->stateType == (stateType | RequestStateChunk::chunkDigestsFlag))
+            return processChunkDigests(response);
+        return false;
+    }
+
+    bool isComplete() const
+    {
+        if (stateType == RequestStateChunk::contractState)
+            return contractStateVerified;
+        return chunkCount && receivedCount == chunkCount && checkedRangeCount == rangeCount;
+    }
+
+    // Return tick of the downloaded state (valid if isComplete())
+    unsigned int getTick() const
+    {
+        return versionTick;
+    }
+
+    unsigned int getChunkCount() const
+    {
+        return chunkCount;
+    }
+
+    unsigned int getReceivedChunkCount() const
+    {
+        return receivedCount;
+    }
+
+private:
+    bool isReceived(unsigned int chunk) const
+    {
+        return (received[chunk >> 6] >> (chunk & 63)) & 1;
+    }
+
+    void setReceived(unsigned int chunk, bool value)
+    {
+        if (isReceived(chunk) == value)
+            return;
+        received[chunk >> 6] ^= (1ULL << (chunk & 63));
+        if (value)
+            ++receivedCount;
+        else
+            --receivedCount;
+    }
+
+    void setRangeChecked(unsigned int range, bool value)
+    {
+        if (rangeChecked[range] == value)
+            return;
+        rangeChecked[range] = value;
+        if (value)
+            ++checkedRangeCount;
+        else
+            --checkedRangeCount;
+    }
+
+    bool processRecords(const RespondStateChunk* response)
+    {
+        const unsigned int count = 1u << chunkLevel;
+        const unsigned int chunk = response->firstIndex >> chunkLevel;
+        if (response->numberOfRecords != count || (response->firstIndex & (count - 1)) || chunk >= chunkCount
+            || response->numberOfSiblings != depth - chunkLevel)
+            return false;
+
+        const unsigned int recordSize = RespondStateChunk::recordSize(stateType);
+        const unsigned char* records = (const unsigned char*)response->records();
+        for (unsigned int i = 0; i < count; ++i)
+            KangarooTwelve(records + i * recordSize, recordSize, &leafDigests[i], 32);
+        m256i chunkDigest;
+        computeMerkleSubtreeRoot(leafDigests, count, chunkDigest);
+        if (!verifyMerkleSubtree(&chunkDigest, chunk, 1, response->siblings(), depth - chunkLevel, response->rootDigest))
+            return false;
+
+        copyMem(destination + (unsigned long long)chunk * chunkSize, records, chunkSize);
+        if (isReceived(chunk) && chunkDigests[chunk] != chunkDigest)
+            setRangeChecked(chunk / digestsPerRange, false);
+        chunkDigests[chunk] = chunkDigest;
+        setReceived(chunk, true);
+        return true;
+    }
+
+    bool processChunkDigests(const RespondStateChunk* response)
+    {
+        unsigned int countLevel = 0;
+        while ((1u << countLevel) < digestsPerRange)
+            ++countLevel;
+        const unsigned int range = response->firstIndex / digestsPerRange;
+        if (response->numberOfRecords != digestsPerRange || (response->firstIndex % digestsPerRange) || range >= rangeCount
+            || response->numberOfSiblings != depth - chunkLevel - countLevel)
+            return false;
+
+        const m256i* digests = (const m256i*)response->records();
+        if (!verifyMerkleSubtree(digests, response->firstIndex, digestsPerRange, response->siblings(), depth - chunkLevel, response->rootDigest))
+            return false;
+
+        // all ranges have to be checked against the same root, a newer one invalidates the checks done before
+        if (checkedRangeCount && response->rootDigest != versionRoot)
+        {
+            if (response->tick <= versionTick)
+                return false;
+            for (unsigned int i = 0; i < rangeCount; ++i)
+                setRangeChecked(i, false);
+        }
+        versionRoot = response->rootDigest;
+        versionTick = response->tick;
+
+        // outdated chunks are downloaded again
+        bool allMatching = true;
+        for (unsigned int i = 0; i < digestsPerRange; ++i)
+        {
+            const unsigned int chunk = response->firstIndex + i;
+            if (!isReceived(chunk) || chunkDigests[chunk] != digests[i])
+            {
+                setReceived(chunk, false);
+                allMatching = false;
+            }
+        }
+        setRangeChecked(range, allMatching);
+        return true;
+    }
+
+    bool processContractStateChunk(const RespondStateChunk* response)
+    {
+        const unsigned int chunk = response->firstIndex;
+        const unsigned long long offset = (unsigned long long)chunk * chunkSize;
+        if (response->stateType != stateType || response->contractIndex != contractIndex || chunk >= chunkCount
+            || response->numberOfRecords != ((size - offset < chunkSize) ? size - offset : chunkSize)
+            || response->numberOfSiblings != 1 + depth)
+            return false;
+
+        const m256i* siblings = response->siblings();
+        if (!verifyMerkleSubtree(&siblings[0], contractIndex, 1, siblings + 1, depth, response->rootDigest))
+            return false;
+
+        // the chunks are only proven by the digest of the complete state, so they have to belong to the same version
+        if (receivedCount && siblings[0] != versionRoot)
+        {
+            if (response->tick <= versionTick)
+                return false;
+            setMem(received, sizeof(received), 0);
+            receivedCount = 0;
+        }
+        versionRoot = siblings[0];
+        versionTick = response->tick;
+
+        copyMem(destination + offset, response->records(), response->numberOfRecords);
+        setReceived(chunk, true);
+        if (receivedCount == chunkCount)
+        {
+            m256i digest;
+            KangarooTwelve(destination, (unsigned int)size, &digest, 32);
+            contractStateVerified = (digest == versionRoot);
+            if (!contractStateVerified)
+            {
+                // some peer sent wrong data, which cannot be attributed to a chunk -> download again
+                setMem(received, sizeof(received), 0);
+                receivedCount = 0;
+            }
+        }
+        return true;
+    }
+
+    unsigned char stateType;
+    unsigned short contractIndex;
+    unsigned char* destination;
+    unsigned long long size;
+    unsigned int depth;
+    unsigned int chunkLevel; // log2 of records per chunk (spectrum and universe)
+    unsigned int chunkSize; // in bytes
+    unsigned int chunkCount;
+    unsigned int receivedCount;
+    unsigned int nextChunk;
+    unsigned int digestsPerRange;
+    unsigned int rangeCount;
+    unsigned int checkedRangeCount;
+    unsigned int nextRange;
+    unsigned int versionTick;
+    m256i versionRoot; // root of checked ranges (spectrum and universe) or digest of contract state
+    bool contractStateVerified;
+    bool rangeChecked[maxChunks / RequestStateChunk::maxRecords];
+    unsigned long long received[maxChunks / 64];
+    m256i chunkDigests[maxChunks];
+    m256i leafDigests[RequestStateChunk::maxRecords];
+};
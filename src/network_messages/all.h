@@ -13,6 +13,7 @@
 #include "logging.h"
 #include "public_peers.h"
 #include "special_command.h"
+#include "state_sync.h"
 #include "tick.h"
 #include "transactions.h"
 #include "system_info.h"
@@ -162,6 +162,7 @@ union RequestAssets
 
     // common flags
     static constexpr unsigned short getSiblings = 0b1;
+    static constexpr unsigned short batchResponse = 0b10000000; // respond with RespondAssetsBatch (filter requests only)
 
     // flags of requestIssuanceRecords
     static constexpr unsigned short anyIssuer = 0b10;
@@ -222,3 +223,49 @@ struct RespondAssetsWithSiblings : public RespondAssets
 };
 
 static_assert(sizeof(RespondAssetsWithSiblings) == 824, "Something is wrong with the struct size.");
+
+// Response message after RequestAssets with flag batchResponse, containing up to maxRecords records sorted by
+// universe index. The payload is this struct followed by numberOfRecords Record and numberOfSiblings m256i.
+// With flag getSiblings, the siblings are a multiproof of all records of the message: the digests that are
+// not on the path of any record, level by level starting at the leaf level, in ascending order of node index
+// within each level. Siblings that can be computed from other records of the message are omitted, so contiguous
+// slots share most of the siblings. Without flag getSiblings, numberOfSiblings is 0.
+struct RespondAssetsBatch
+{
+    static constexpr unsigned int maxRecords = 32;
+    static constexpr unsigned int maxSiblings = maxRecords * ASSETS_DEPTH;
+
+    struct Record
+    {
+        AssetRecord asset;
+        unsigned int universeIndex;
+        unsigned int _padding;
+    };
+
+    unsigned int tick;
+    unsigned short numberOfRecords;
+    unsigned short numberOfSiblings;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_ASSETS_BATCH;
+    }
+
+    Record* records()
+    {
+        return reinterpret_cast<Record*>(this + 1);
+    }
+
+    m256i* siblings()
+    {
+        return reinterpret_cast<m256i*>(records() + numberOfRecords);
+    }
+
+    unsigned int payloadSize() const
+    {
+        return sizeof(RespondAssetsBatch) + numberOfRecords * sizeof(Record) + numberOfSiblings * sizeof(m256i);
+    }
+};
+
+static_assert(sizeof(RespondAssetsBatch) == 8, "Something is wrong with the struct size.");
+static_assert(sizeof(RespondAssetsBatch::Record) == 56, "Something is wrong with the struct size.");
@@ -5,6 +5,7 @@
 #define MESSAGE_TYPE_SOLUTION 0
 #define MESSAGE_TYPE_CUSTOM_MINING_TASK 1
 #define MESSAGE_TYPE_CUSTOM_MINING_SOLUTION 2
+#define MESSAGE_TYPE_CUSTOM_MINING_SOLUTION_BATCH 3
 
 // TODO: documentation needed:
 // "A General Message type used to send/receive messages from/to peers." -> right?
@@ -50,4 +51,18 @@ struct CustomMiningSolutionMessage
     m256i gammingNonce;
 
     // Solution payload
+};
+
+// MESSAGE_TYPE_CUSTOM_MINING_SOLUTION_BATCH
+//  Same as CustomMiningSolutionMessage, but the payload is an array of 1 or more solutions (the payload size must be a
+//  multiple of the solution size), so a computor can relay many shares with one signature that peers verify once.
+//  Solutions are identified by (taskIndex, nonce). Nodes drop (and don't relay) single solution and batch messages
+//  before checking the signature if all solutions are already known.
+struct CustomMiningSolutionBatchMessage
+{
+    m256i sourcePublicKey;
+    m256i zero;
+    m256i gammingNonce;
+
+    // Solutions payload
 };
\ No newline at end of file
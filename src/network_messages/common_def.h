@@ -74,6 +74,7 @@ constexpr uint16_t ORACLE_FLAG_BAD_SIZE_REPLY = 0x200; ///< Oracle engine got re
 constexpr uint16_t ORACLE_FLAG_OM_DISAGREE = 0x400;    ///< Oracle engine got different replies from oracle machines.
 constexpr uint16_t ORACLE_FLAG_BAD_SIZE_REVEAL = 0x800; ///< Reply in a reveal tx had wrong size.
 constexpr uint16_t ORACLE_FLAG_FAKE_COMMITS = 0x1000;   ///< Unresolvable, because reveal exposed too many fake commits.
+constexpr uint16_t ORACLE_FLAG_SHARED_REPLY = 0x2000;   ///< Query shares the reply of an identical earlier query (no own oracle machine query, commits, and reveal).
 
 typedef union IPv4Address
 {
@@ -73,3 +73,62 @@ struct RespondContractFunction // Returns result of contract function invocation
         return NetworkMessageType::RESPOND_CONTRACT_FUNCTION;
     }
 };
+
+
+// Requests pages of contract state that changed since the given version of the state, for mirroring contract states
+// incrementally. The node answers with RespondContractStateChanges, followed by one RespondContractStatePage per page
+// and EndResponse. Pages are read from the contract state snapshot published at the end of a tick (see
+// ContractStateSnapshot), so all pages of a response belong to the same state version.
+//
+// Sync: start with sinceVersion = 0 and streamId = 0 to get all pages. If nextPage in the response isn't 0, request
+// the remaining pages with firstPage = nextPage and the same sinceVersion. Then continue with the lowest version
+// received as sinceVersion and streamId of the response. Pages may be reported that didn't change, but no changed page
+// is missed. If the node restarted in between (different streamId), all pages are sent again.
+struct RequestContractStateChanges
+{
+    unsigned long long streamId;
+    unsigned int contractIndex;
+    unsigned int sinceVersion;
+    unsigned int firstPage;
+    unsigned int maxNumberOfPages; // 0 means maximum supported by node
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_CONTRACT_STATE_CHANGES;
+    }
+};
+
+static_assert(sizeof(RequestContractStateChanges) == 24, "Something is wrong with the struct size.");
+
+
+struct RespondContractStateChanges
+{
+    unsigned long long streamId; // identifies node run, version numbers are only comparable with the same streamId
+    unsigned long long stateSize;
+    unsigned int contractIndex;
+    unsigned int version; // version of state snapshot the pages belong to, 0 if not available (try again later)
+    unsigned int pageSize;
+    unsigned int pageCount; // total number of pages of state, the last one may be shorter than pageSize
+    unsigned int numberOfPages; // number of RespondContractStatePage messages following
+    unsigned int nextPage; // if not 0, more pages have changed, request them with firstPage = nextPage
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_CONTRACT_STATE_CHANGES;
+    }
+};
+
+static_assert(sizeof(RespondContractStateChanges) == 40, "Something is wrong with the struct size.");
+
+
+struct RespondContractStatePage
+{
+    unsigned int contractIndex;
+    unsigned int pageIndex;
+    // Variable-size page data (pageSize bytes, except for the last page of the state)
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_CONTRACT_STATE_PAGE;
+    }
+};
@@ -80,3 +80,29 @@ struct RespondCustomMiningSolutionVerification
     long long status;       // Flag indicate the status of solution
 };
 
+// Message struture for reporting the validity of many solutions in one signed request.
+// Payload: [RequestCustomMiningSolutionVerificationBatch, count * RequestCustomMiningSolutionVerification, signature]
+struct RequestCustomMiningSolutionVerificationBatch
+{
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_CUSTOM_MINING_SOLUTION_VERIFICATION_BATCH;
+    }
+
+    static constexpr unsigned long long maxCount = 1024;
+
+    unsigned long long count;
+};
+
+// Payload: [RespondCustomMiningSolutionVerificationBatch, count * RespondCustomMiningSolutionVerification],
+// in the order of the request
+struct RespondCustomMiningSolutionVerificationBatch
+{
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_CUSTOM_MINING_SOLUTION_VERIFICATION_BATCH;
+    }
+
+    unsigned long long count;
+};
+
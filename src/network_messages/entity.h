@@ -43,3 +43,83 @@ struct RespondEntity
 };
 
 static_assert(sizeof(RespondEntity) == sizeof(EntityRecord) + 4 + 4 + 32 * SPECTRUM_DEPTH, "Something is wrong with the struct size.");
+
+
+// Request for the entity records of multiple public keys. The payload is this struct followed by numberOfPublicKeys
+// m256i public keys. The node replies with RespondEntities messages containing up to RespondEntities::maxRecords
+// records each, followed by EndResponse.
+struct RequestEntities
+{
+    static constexpr unsigned int maxPublicKeys = 1024;
+
+    // Flag: add multiproof of the records found in the spectrum to each RespondEntities message
+    static constexpr unsigned short getSiblings = 1;
+
+    unsigned short numberOfPublicKeys;
+    unsigned short flags;
+    unsigned int _padding;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_ENTITIES;
+    }
+
+    const m256i* publicKeys() const
+    {
+        return reinterpret_cast<const m256i*>(this + 1);
+    }
+
+    unsigned int payloadSize() const
+    {
+        return sizeof(RequestEntities) + numberOfPublicKeys * sizeof(m256i);
+    }
+};
+
+static_assert(sizeof(RequestEntities) == 8, "Something is wrong with the struct size.");
+
+
+// Response message after RequestEntities, containing up to maxRecords records in the order of the request. The payload
+// is this struct followed by numberOfRecords Record and numberOfSiblings m256i. Records of public keys that are not in
+// the spectrum have spectrumIndex -1 and all other fields (except the public key) zero.
+// With flag getSiblings, the siblings are a multiproof of all records of the message that have spectrumIndex >= 0: the
+// digests that are not on the path of any record, level by level starting at the leaf level, in ascending order of
+// node index within each level (same as RespondAssetsBatch). Without flag getSiblings, numberOfSiblings is 0.
+struct RespondEntities
+{
+    static constexpr unsigned int maxRecords = 32;
+    static constexpr unsigned int maxSiblings = maxRecords * SPECTRUM_DEPTH;
+
+    struct Record
+    {
+        EntityRecord entity;
+        int spectrumIndex;
+        unsigned int _padding;
+    };
+
+    unsigned int tick;
+    unsigned short numberOfRecords;
+    unsigned short numberOfSiblings;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_ENTITIES;
+    }
+
+    Record* records()
+    {
+        return reinterpret_cast<Record*>(this + 1);
+    }
+
+    m256i* siblings()
+    {
+        return reinterpret_cast<m256i*>(records() + numberOfRecords);
+    }
+
+    unsigned int payloadSize() const
+    {
+        return sizeof(RespondEntities) + numberOfRecords * sizeof(Record) + numberOfSiblings * sizeof(m256i);
+    }
+};
+
+static_assert(sizeof(RespondEntities) == 8, "Something is wrong with the struct size.");
+static_assert(sizeof(RespondEntities::Record) == 72, "Something is wrong with the struct size.");
@@ -30,6 +30,49 @@ struct RespondLog
 };
 
 
+// Subscribe to (subscribe = 1) or unsubscribe from (subscribe = 0) log events pushed by the node. Subscribed peers
+// get RespondSubscribedLog messages with the new log events whenever the node commits them (at least once per tick),
+// until they unsubscribe or the connection is closed. Events that are not received (for example, because the
+// response queue was full) can be fetched with RequestLog.
+struct RequestLogSubscription
+{
+    unsigned long long passcode[4];
+    unsigned int subscribe;
+    unsigned int _padding;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_LOG_SUBSCRIPTION;
+    }
+};
+
+
+// Response to RequestLogSubscription
+struct RespondLogSubscription
+{
+    // If subscribed, all log events with ID >= nextLogId will be pushed. -1 if the subscription failed (too many
+    // subscribers or connection already subscribed) and after unsubscribing.
+    long long nextLogId;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_LOG_SUBSCRIPTION;
+    }
+};
+
+
+// Log events pushed to subscribed peer, same format as RespondLog
+struct RespondSubscribedLog
+{
+    // Variable-size log;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_SUBSCRIBED_LOG;
+    }
+};
+
+
 // Request logid ranges from tx hash
 struct RequestLogIdRangeFromTx
 {
@@ -81,6 +124,85 @@ struct RespondAllLogIdRangesFromTick
     }
 };
 
+// Summary of the log events of a tick. The events of a tick have consecutive IDs and are stored consecutively in the
+// log buffer, so all events of a tick can be fetched with one RequestLog.
+struct TickLogSummary
+{
+    long long fromLogId;  // ID of first event of the tick (ID of next event if tick has no events)
+    long long bufferOffset; // offset of first event in log buffer
+    unsigned int tick;
+    unsigned int numberOfLogs;
+    unsigned int bufferSize; // total size of events including headers
+    // number of events per log type (see logging/logging.h), last element counts CUSTOM_MESSAGE and other types
+    unsigned int numberOfLogsPerType[17];
+};
+
+static_assert(sizeof(TickLogSummary) == 96, "Unexpected size");
+
+// Request summaries of the log events of numberOfTicks ticks starting with fromTick
+struct RequestTickLogSummaries
+{
+    unsigned long long passcode[4];
+    unsigned int fromTick;
+    unsigned int numberOfTicks;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_TICK_LOG_SUMMARIES;
+    }
+};
+
+// Response to above request, array of TickLogSummary of the requested ticks for which the logs are available (may be
+// fewer than requested if ticks are not processed yet or don't fit into one message)
+struct RespondTickLogSummaries
+{
+    // Variable-size array of TickLogSummary
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_TICK_LOG_SUMMARIES;
+    }
+};
+
+// Request log events of the ticks fromTick to toTick (inclusive) that match all given filters. The node skips ticks
+// without events of the selected types using the tick summaries. If the matching events don't fit into one response,
+// continue with a request with fromTick = nextTick and fromLogId = nextLogId of the response.
+struct RequestFilteredLog
+{
+    unsigned long long passcode[4];
+    unsigned int fromTick;
+    unsigned int toTick;
+    unsigned long long fromLogId; // events with lower ID are skipped
+    // Bit i selects log type i for i < 16, bit 16 selects CUSTOM_MESSAGE and other types (same as index of
+    // TickLogSummary::numberOfLogsPerType)
+    unsigned long long typeMask;
+    // If not zero, only events involving this entity (such as source and destination of transfers) match
+    m256i identity;
+    // If not zero, only asset events (issuance, ownership / possession changes) of this asset match
+    m256i assetIssuer;
+    unsigned long long assetName; // 7 characters, zero-padded
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_FILTERED_LOG;
+    }
+};
+
+// Response to above request, followed by matching events (same format as RespondLog)
+struct RespondFilteredLog
+{
+    // For continuing the query: first tick and log ID that have not been checked yet. If nextTick > toTick, all
+    // requested ticks have been checked.
+    unsigned long long nextLogId;
+    unsigned int nextTick;
+    unsigned int _padding;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_FILTERED_LOG;
+    }
+};
+
 // Request the node to prune logs (to save disk)
 struct RequestPruningLog
 {
@@ -51,8 +51,33 @@ enum NetworkMessageType : unsigned char
     RESPOND_ACTIVE_IPO = 65,
     REQUEST_ORACLE_DATA = 66,
     RESPOND_ORACLE_DATA = 67,
+    RESPOND_ASSETS_BATCH = 68,
+    REQUEST_TICK_PHASE_STATS = 69,
+    RESPOND_TICK_PHASE_STATS = 70,
+    REQUEST_CONTRACT_STATE_CHANGES = 71,
+    RESPOND_CONTRACT_STATE_CHANGES = 72,
+    RESPOND_CONTRACT_STATE_PAGE = 73,
+    REQUEST_CUSTOM_MINING_SOLUTION_VERIFICATION_BATCH = 74,
+    RESPOND_CUSTOM_MINING_SOLUTION_VERIFICATION_BATCH = 75,
+    REQUEST_LOG_SUBSCRIPTION = 76,
+    RESPOND_LOG_SUBSCRIPTION = 77,
+    RESPOND_SUBSCRIBED_LOG = 78,
+    REQUEST_TICK_LOG_SUMMARIES = 79,
+    RESPOND_TICK_LOG_SUMMARIES = 80,
+    REQUEST_FILTERED_LOG = 81,
+    RESPOND_FILTERED_LOG = 82,
+    REQUEST_LOCK_STATS = 83,
+    RESPOND_LOCK_STATS = 84,
+    REQUEST_ENTITIES = 85,
+    RESPOND_ENTITIES = 86,
+    REQUEST_TICK_RANGE = 87,
+    REQUEST_STATE_CHUNK = 88,
+    RESPOND_STATE_CHUNK = 89,
+    RESPOND_TICK_TRANSACTIONS = 90,
     ORACLE_MACHINE_QUERY = 190, // only on communication channel Core node <-> OM node
     ORACLE_MACHINE_REPLY = 191, // only on communication channel Core node <-> OM node
+    ORACLE_MACHINE_QUERY_BATCH = 192, // only on communication channel Core node <-> OM node
+    ORACLE_MACHINE_CAPABILITIES = 193, // only on communication channel Core node <-> OM node
     REQUEST_TX_STATUS = 201, // tx addon only
     RESPOND_TX_STATUS = 202, // tx addon only
     SPECIAL_COMMAND = 255,
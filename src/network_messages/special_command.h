@@ -38,9 +38,9 @@ struct SpecialCommandToggleMainModeRequestAndResponse
 };
 #define SPECIAL_COMMAND_REFRESH_PEER_LIST 9ULL // F4
 #define SPECIAL_COMMAND_FORCE_NEXT_TICK 10ULL // F5
-#define SPECIAL_COMMAND_REISSUE_VOTE 11ULL // F9
-
-
+#define SPECIAL_COMMAND_REISSUE_VOTE 11ULL // F9
+
+
 struct UtcTime
 {
     unsigned short    year;              // 1900 - 9999
@@ -50,9 +50,9 @@ struct UtcTime
     unsigned char     minute;            // 0 - 59
     unsigned char     second;            // 0 - 59
     unsigned char     pad1;
-    unsigned int      nanosecond;        // 0 - 999,999,999
-};
-
+    unsigned int      nanosecond;        // 0 - 999,999,999
+};
+
 #define SPECIAL_COMMAND_QUERY_TIME 12ULL    // send this to node to query time, responds with time read from clock
 #define SPECIAL_COMMAND_SEND_TIME 13ULL     // send this to node to set time, responds with time read from clock after setting
 
@@ -60,9 +60,9 @@ struct SpecialCommandSendTime
 {
     unsigned long long everIncreasingNonceAndCommandType;
     UtcTime utcTime;
-};
-
-#define SPECIAL_COMMAND_GET_MINING_SCORE_RANKING 14ULL
+};
+
+#define SPECIAL_COMMAND_GET_MINING_SCORE_RANKING 14ULL
 #pragma pack( push, 1)
 template<unsigned int maxNumberOfMiners>
 struct SpecialCommandGetMiningScoreRanking
@@ -115,4 +115,99 @@ struct SpecialCommandExecutionFeeMultiplierRequestAndResponse
     unsigned long long everIncreasingNonceAndCommandType;
     unsigned long long multiplierNumerator;
     unsigned long long multiplierDenominator;
-};
\ No newline at end of file
+};
+
+#define SPECIAL_COMMAND_GET_CONTRACT_EXECUTION_PROFILE 21ULL
+// Statistics of calls of one contract entry point in one tick
+struct ContractExecutionProfileEntry
+{
+    unsigned int tick;
+    unsigned int entryPointId; // (contractIndex << 22) | line of the entry point definition in the contract source
+    unsigned int count;
+    unsigned int maxLocalsStackUsage; // bytes of the contract locals stack used after allocating the locals
+    unsigned long long totalCycles;
+    unsigned long long maxCycles;
+};
+
+struct SpecialCommandGetContractExecutionProfileRequest
+{
+    unsigned long long everIncreasingNonceAndCommandType;
+    unsigned long long firstRecord; // index of first record requested, use nextRecord of last response to continue
+};
+
+// The response only contains the numberOfEntries entries that are used.
+struct SpecialCommandGetContractExecutionProfileResponse
+{
+    unsigned long long everIncreasingNonceAndCommandType;
+    unsigned long long firstRecord; // index of entries[0], larger than requested if older records have been overwritten
+    unsigned long long nextRecord;
+    unsigned long long frequency; // CPU cycles per second
+    unsigned long long droppedCalls; // calls not recorded, because too many entry points were called in a tick
+    unsigned int numberOfEntries;
+    unsigned int padding;
+    ContractExecutionProfileEntry entries[1024];
+};
+
+#define SPECIAL_COMMAND_GET_SAMPLED_PROFILE 22ULL
+// Aggregated statistics of the sampling profiler (see platform/sampling_profiler.h)
+struct SpecialCommandGetSampledProfileRequest
+{
+    unsigned long long everIncreasingNonceAndCommandType;
+    unsigned int maxEntries; // top N scopes
+    unsigned char sortByP99; // 0 = sort by total cycles, 1 = sort by 99th percentile of duration
+    unsigned char resetAfterReading; // 1 = reset statistics after filling the response
+    unsigned char padding[2];
+};
+
+// The response only contains the numberOfEntries entries that are used.
+struct SpecialCommandGetSampledProfileResponse
+{
+    struct Entry
+    {
+        char name[32]; // zero-terminated scope name
+        unsigned long long count;
+        unsigned long long totalCycles;
+        unsigned long long p50Cycles; // percentiles have a relative error of at most 1/16
+        unsigned long long p99Cycles;
+        unsigned long long maxCycles;
+    };
+
+    unsigned long long everIncreasingNonceAndCommandType;
+    unsigned long long frequency; // CPU cycles per second
+    unsigned long long lostEvents; // events not aggregated, because ring buffers overflowed
+    unsigned int numberOfEntries;
+    unsigned int padding;
+    Entry entries[64];
+};
+
+#define SPECIAL_COMMAND_DUMP_SAMPLED_PROFILE_TRACE 23ULL
+// Request writing timeline of the last milliseconds to file profiling_trace.json (Chrome trace event format) on the
+// node. The file is written with the next snapshot of the node states. Response is the same as the request.
+struct SpecialCommandDumpSampledProfileTraceRequestAndResponse
+{
+    unsigned long long everIncreasingNonceAndCommandType;
+    unsigned int milliseconds;
+    unsigned int padding;
+};
+
+#define SPECIAL_COMMAND_GET_MEMORY_FOOTPRINT 24ULL
+// Memory allocated per subsystem (see MemoryRegistry in platform/memory.h). The request only consists of
+// everIncreasingNonceAndCommandType. The response only contains the numberOfEntries entries that are used.
+struct SpecialCommandGetMemoryFootprintResponse
+{
+    struct Entry
+    {
+        char name[32]; // zero-terminated subsystem name
+        unsigned long long requestedBytes; // size of live allocations as requested by the subsystem
+        unsigned long long committedBytes; // memory reserved for live allocations (large ones are rounded up to 2 MB)
+        unsigned long long peakCommittedBytes;
+        unsigned int allocationCount; // number of live allocations
+        unsigned int totalAllocationCount; // number of allocations since start, including freed ones
+    };
+
+    unsigned long long everIncreasingNonceAndCommandType;
+    unsigned long long untrackedAllocationCount; // allocations not included in entries, because the registry was full
+    unsigned int numberOfEntries;
+    unsigned int padding;
+    Entry entries[96];
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "common_def.h"
+#include "entity.h"
+#include "assets.h"
+
+
+// Request for a chunk of the spectrum, the universe, or a contract state with Merkle proof, for bootstrapping the state
+// of a node from peers instead of files (see StateChunkDownload for the client side). Chunks can be requested from
+// several peers in parallel. The node answers with RespondStateChunk.
+//
+// spectrumState / universeState: the chunk consists of numberOfRecords = 2^N records (at most maxRecords) starting at
+// firstIndex, which must be a multiple of numberOfRecords, so the chunk is a complete subtree of the Merkle tree of
+// the state.
+//
+// spectrumState / universeState with chunkDigestsFlag: instead of records, the digests of numberOfRecords = 2^N nodes
+// (at most maxRecords) of the given level of the Merkle tree (leaf level is 0) starting at node firstIndex are sent.
+// With level = log2 of the chunk size, this tells which downloaded chunks are outdated without downloading them again.
+//
+// contractState: firstIndex is the index of the chunk of maxContractStateBytes bytes of the state of the contract
+// contractIndex (the last chunk may be shorter) and numberOfRecords is ignored. Contract states are proven as a whole,
+// so the client has to check the digest of the state after downloading all chunks.
+struct RequestStateChunk
+{
+    static constexpr unsigned char spectrumState = 0;
+    static constexpr unsigned char universeState = 1;
+    static constexpr unsigned char contractState = 2;
+    static constexpr unsigned char chunkDigestsFlag = 0x80;
+
+    static constexpr unsigned int maxRecords = 1024;
+    static constexpr unsigned int maxContractStateBytes = 65536;
+
+    unsigned char stateType;
+    unsigned char level; // only used with chunkDigestsFlag
+    unsigned short contractIndex; // only used for contractState
+    unsigned int firstIndex;
+    unsigned int numberOfRecords;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_STATE_CHUNK;
+    }
+};
+
+static_assert(sizeof(RequestStateChunk) == 12, "Something is wrong with the struct size.");
+
+
+// Response to RequestStateChunk. The payload is this struct followed by numberOfRecords records (EntityRecord,
+// AssetRecord, node digests, or bytes of contract state, depending on stateType) and numberOfSiblings m256i. The
+// siblings are the digests on the path from the root of the chunk's subtree to the root of the tree, starting at the
+// lowest level (see verifyMerkleSubtree() in merkle_tree.h). For contract states, the first sibling is the digest of
+// the complete contract state, followed by the siblings of the contract's leaf in the tree of contract state digests.
+// rootDigest is the root of the tree that the chunk belongs to, which is the prevSpectrumDigest / prevUniverseDigest /
+// prevComputerDigest of the quorum votes (Tick) of the tick following the last tick processed by the node. The
+// requester verifies the chunk with the leaf digests of the records and checks that rootDigest is confirmed by the
+// quorum. numberOfRecords is 0 if the request is invalid or the chunk cannot be proven at the moment, because the tick
+// processor is changing these records (try again later).
+struct RespondStateChunk
+{
+    m256i rootDigest;
+    unsigned int tick; // tick of node when the chunk has been read
+    unsigned char stateType;
+    unsigned char numberOfSiblings;
+    unsigned short contractIndex;
+    unsigned int firstIndex;
+    unsigned int numberOfRecords;
+
+    static constexpr unsigned int maxSiblings = (SPECTRUM_DEPTH > ASSETS_DEPTH) ? SPECTRUM_DEPTH : ASSETS_DEPTH;
+    static constexpr unsigned int maxPayloadSize = 48 + RequestStateChunk::maxRecords * sizeof(EntityRecord) + maxSiblings * sizeof(m256i);
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_STATE_CHUNK;
+    }
+
+    static constexpr unsigned int recordSize(unsigned char stateType)
+    {
+        return (stateType & RequestStateChunk::chunkDigestsFlag) ? sizeof(m256i)
+            : (stateType == RequestStateChunk::spectrumState) ? sizeof(EntityRecord)
+            : (stateType == RequestStateChunk::universeState) ? sizeof(AssetRecord) : 1;
+    }
+
+    void* records()
+    {
+        return this + 1;
+    }
+
+    const void* records() const
+    {
+        return this + 1;
+    }
+
+    m256i* siblings()
+    {
+        return reinterpret_cast<m256i*>(reinterpret_cast<unsigned char*>(this + 1) + numberOfRecords * recordSize(stateType));
+    }
+
+    const m256i* siblings() const
+    {
+        return reinterpret_cast<const m256i*>(reinterpret_cast<const unsigned char*>(this + 1) + numberOfRecords * recordSize(stateType));
+    }
+
+    unsigned long long payloadSize() const
+    {
+        return sizeof(RespondStateChunk) + (unsigned long long)numberOfRecords * recordSize(stateType) + numberOfSiblings * sizeof(m256i);
+    }
+};
+
+static_assert(sizeof(RespondStateChunk) == 48, "Something is wrong with the struct size.");
+static_assert(sizeof(EntityRecord) >= sizeof(AssetRecord) && sizeof(EntityRecord) >= sizeof(m256i), "maxPayloadSize is based on spectrum");
+static_assert(RequestStateChunk::maxContractStateBytes <= RequestStateChunk::maxRecords * sizeof(EntityRecord), "maxPayloadSize is based on spectrum");
+static_assert(RespondStateChunk::maxSiblings >= 1 + 10 && (1 << 10) == MAX_NUMBER_OF_CONTRACTS, "maxPayloadSize is based on spectrum");
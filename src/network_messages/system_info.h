@@ -54,3 +54,95 @@ struct RespondSystemInfo
 #pragma pack(pop)
 
 static_assert(sizeof(RespondSystemInfo) == 128, "Something is wrong with the struct size of RespondSystemInfo.");
+
+
+// Phases of the tick processor, used as index of RespondTickPhaseStats::phases
+enum TickPhase : unsigned char
+{
+    TICK_PHASE_WAIT_TICK_DATA = 0, // from end of processing the current tick until data and transactions of next tick are available
+    TICK_PHASE_DIGESTS = 1, // universe and computer digests in processing a tick
+    TICK_PHASE_TX_EXECUTION = 2, // rest of processing a tick (BEGIN_TICK, transactions, ...) without END_TICK and digests
+    TICK_PHASE_END_TICK = 3, // END_TICK procedures of contracts
+    TICK_PHASE_VOTE_COLLECTION = 4, // from data being available until quorum of votes matching own digests
+    TICK_PHASE_QUORUM = 5, // from quorum until switching to next tick (agreeing on next tick data)
+    TICK_PHASE_TOTAL = 6, // whole tick duration
+    TICK_PHASE_COUNT = 7,
+};
+
+struct RequestTickPhaseStats
+{
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_TICK_PHASE_STATS;
+    }
+};
+
+#pragma pack(push, 1)
+struct RespondTickPhaseStats
+{
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_TICK_PHASE_STATS;
+    }
+
+    // Durations in microseconds over the sliding window of the last ticks. Percentiles are approximated by histogram
+    // buckets with about 6% relative error, maximum is exact.
+    struct PhaseStats
+    {
+        unsigned int numberOfSamples;
+        unsigned int p50;
+        unsigned int p99;
+        unsigned int max;
+    };
+
+    unsigned int tick;
+    unsigned int windowSize; // maximum number of samples per phase
+    PhaseStats phases[TICK_PHASE_COUNT];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(RespondTickPhaseStats) == 8 + 16 * TICK_PHASE_COUNT, "Something is wrong with the struct size of RespondTickPhaseStats.");
+
+
+// Locks with contention statistics, used as index of RespondLockStats::locks
+enum LockStatsIndex : unsigned char
+{
+    LOCK_STATS_SPECTRUM = 0, // spectrumLock
+    LOCK_STATS_UNIVERSE = 1, // universeLock (read and write acquisitions, zero unless TRACK_READ_WRITE_LOCK_STATISTICS is defined)
+    LOCK_STATS_PENDING_TXS_POOL = 2, // PendingTxsPool::lock
+    LOCK_STATS_RESPONSE_QUEUE = 3, // responseQueueHeadLock
+    LOCK_STATS_COUNT = 4,
+};
+
+struct RequestLockStats
+{
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_LOCK_STATS;
+    }
+};
+
+#pragma pack(push, 1)
+struct RespondLockStats
+{
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_LOCK_STATS;
+    }
+
+    // Counters since node start (universe counters since last reset of the lock)
+    struct LockStats
+    {
+        unsigned long long acquisitionCount;
+        unsigned long long contendedAcquisitionCount;
+        unsigned long long spinCycles; // CPU ticks spent waiting, divide by tscFrequency for seconds
+    };
+
+    unsigned int tick;
+    unsigned int _padding;
+    unsigned long long tscFrequency;
+    LockStats locks[LOCK_STATS_COUNT];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(RespondLockStats) == 16 + 24 * LOCK_STATS_COUNT, "Something is wrong with the struct size of RespondLockStats.");
@@ -120,6 +120,36 @@ struct RequestTickData
     }
 };
 
+
+// Request for the data of numberOfTicks consecutive ticks starting at firstTick (at most maxNumberOfTicks), used by
+// nodes catching up after a restart or falling behind. For each tick (in ascending order), the node replies with the
+// same messages as for RequestTickData, RequestQuorumTick, and RequestTickTransactions (as selected by flags) without
+// EndResponse. The response ends with one EndResponse after the last tick.
+// With packedTransactions (in addition to withTransactions), the transactions aren't sent as one BROADCAST_TRANSACTION
+// message each, but packed into RespondTickTransactions messages, which may hold transactions of several ticks and may
+// be sent before the other messages of these ticks.
+struct RequestTickRange
+{
+    static constexpr unsigned int maxNumberOfTicks = 16;
+
+    // Flags selecting the data sent for each tick
+    static constexpr unsigned short withTickData = 1;
+    static constexpr unsigned short withQuorumTicks = 2;
+    static constexpr unsigned short withTransactions = 4;
+    static constexpr unsigned short packedTransactions = 8;
+
+    unsigned int firstTick;
+    unsigned short numberOfTicks;
+    unsigned short flags;
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::REQUEST_TICK_RANGE;
+    }
+};
+
+static_assert(sizeof(RequestTickRange) == 8, "Something is wrong with the struct size.");
+
 struct RequestCurrentTickInfo
 {
     static constexpr unsigned char type()
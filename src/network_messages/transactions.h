@@ -65,6 +65,37 @@ struct RequestTickTransactions
     }
 };
 
+// Transactions sent in response to RequestTickRange with flag packedTransactions. The struct is followed by
+// numberOfTransactions transactions in the format of BROADCAST_TRANSACTION (Transaction, input, and signature, see
+// Transaction::totalSize()), stored back-to-back without alignment. The transactions are ordered by tick and by
+// transaction index within the tick. A message only holds complete transactions, the ones of a tick may be split
+// over several messages.
+struct RespondTickTransactions
+{
+    static constexpr unsigned int maxTransactionsSize = 64 * 1024;
+
+    unsigned int numberOfTransactions;
+    unsigned int transactionsSize; // total size of the transactions in bytes
+
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::RESPOND_TICK_TRANSACTIONS;
+    }
+
+    unsigned char* transactions()
+    {
+        return reinterpret_cast<unsigned char*>(this + 1);
+    }
+
+    unsigned int payloadSize() const
+    {
+        return sizeof(RespondTickTransactions) + transactionsSize;
+    }
+};
+
+static_assert(sizeof(RespondTickTransactions) == 8, "Something is wrong with the struct size.");
+static_assert(RespondTickTransactions::maxTransactionsSize >= sizeof(Transaction) + MAX_INPUT_SIZE + SIGNATURE_SIZE, "Largest transaction has to fit into RespondTickTransactions.");
+
 struct RequestTransactionInfo
 {
     m256i txDigest;
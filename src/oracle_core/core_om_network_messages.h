@@ -29,6 +29,49 @@ struct OracleMachineQuery
     unsigned int timeoutInMilliseconds;
 };
 
+// Message sent from Core Node to OM Node in order to query data of multiple oracle queries in one frame, reducing the
+// per-message overhead if many queries are sent at the same time. Behind this struct, numberOfQueries items are
+// attached, each consisting of OracleMachineQueryBatchItem, OracleMachineQuery, and the oracle query data, padded to a
+// multiple of 8 bytes. The OM Node handles each item like a separate OracleMachineQuery message and replies with one
+// OracleMachineReply per query. Only sent to OM Nodes that have announced support with OracleMachineCapabilities.
+struct OracleMachineQueryBatch
+{
+    /// Type to be used in RequestResponseHeader
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::ORACLE_MACHINE_QUERY_BATCH;
+    }
+
+    /// Number of queries in this message
+    unsigned int numberOfQueries;
+
+    unsigned int _padding0;
+};
+
+struct OracleMachineQueryBatchItem
+{
+    /// Size of OracleMachineQuery and oracle query data following this struct (without padding)
+    unsigned int size;
+
+    unsigned int _padding0;
+};
+
+// Message sent from OM Node to Core Node after the connection has been established in order to announce optional
+// protocol features. Without this message, the Core Node only sends plain OracleMachineQuery messages.
+struct OracleMachineCapabilities
+{
+    /// Type to be used in RequestResponseHeader
+    static constexpr unsigned char type()
+    {
+        return NetworkMessageType::ORACLE_MACHINE_CAPABILITIES;
+    }
+
+    /// Maximum number of queries the OM Node accepts in one OracleMachineQueryBatch (0 or 1 if batches aren't supported)
+    unsigned int maxQueriesPerBatch;
+
+    unsigned int _padding0;
+};
+
 // Message sent from OM Node to Core Node in order to send the oracle reply data (following query).
 // Behind this struct, the oracle reply data is attached, with size and content defined by oracleInterfaceIdx of the oracle query.
 // Oracle replies must be set all-0 before setting the member data, making sure that alignment/padding bytes are initialized with 0.
@@ -27,6 +27,10 @@ constexpr uint32_t MAX_SIMULTANEOUS_ORACLE_QUERIES = 1024;
 // TODO: with reasonable max. timeout, subscription period may need to be decoupled
 constexpr uint32_t MAX_ORACLE_TIMEOUT_MILLISEC = 3600 * 1000;
 
+// Number of ticks, for which the reply of a successful query can be reused by identical contract queries (counted from
+// the tick of the query, 0 disables reusing revealed replies; sharing replies of pending queries is not affected)
+constexpr uint32_t ORACLE_REPLY_CACHE_TICKS = 10;
+
 
 #pragma pack(push, 4)
 struct OracleQueryMetadata
@@ -52,6 +56,7 @@ struct OracleQueryMetadata
             uint32_t notificationProcId;
             uint64_t queryStorageOffset;
             uint16_t queryingContract;
+            uint32_t nextSharedReplyQueryIndex; ///< next query sharing the reply of this pending query, 0 for none
         } contract;
 
         struct
@@ -63,7 +68,7 @@ struct OracleQueryMetadata
 
     union
     {
-        /// used before notification
+        /// used before notification (with ORACLE_FLAG_SHARED_REPLY, this is the reply state of the query shared)
         struct
         {
             uint32_t replyStateIndex;
@@ -205,6 +210,61 @@ struct UnsortedMultiset
     }
 };
 
+// Set of up to N values with constant-time add and remove. Each value is identified by a unique key < N (such as the
+// reply state slot), which maps to the position of the value in the values array. Removing a value moves the last
+// value into the gap, so the order of values is not preserved (like UnsortedMultiset::removeByIndex()).
+template <typename T, unsigned int N>
+struct IndexedSet
+{
+    T values[N];
+    unsigned int numValues;
+
+    // key of each entry in values
+    unsigned int keys[N];
+
+    // position of key in values + 1, or 0 if key is not in set
+    unsigned int positions[N];
+
+    void reset()
+    {
+        numValues = 0;
+        setMem(positions, sizeof(positions), 0);
+    }
+
+    bool add(const T& v, unsigned int key)
+    {
+        ASSERT(numValues <= N);
+        ASSERT(key < N);
+        if (numValues >= N || key >= N || positions[key])
+            return false;
+        values[numValues] = v;
+        keys[numValues] = key;
+        positions[key] = ++numValues;
+        return true;
+    }
+
+    bool contains(unsigned int key) const
+    {
+        return key < N && positions[key];
+    }
+
+    bool removeByKey(unsigned int key)
+    {
+        if (!contains(key))
+            return false;
+        const unsigned int idx = positions[key] - 1;
+        positions[key] = 0;
+        --numValues;
+        if (idx != numValues)
+        {
+            values[idx] = values[numValues];
+            keys[idx] = keys[numValues];
+            positions[keys[idx]] = idx + 1;
+        }
+        return true;
+    }
+};
+
 struct OracleEngineStatistics
 {
     /// total number of successful oracle queries
@@ -280,21 +340,30 @@ protected:
     // state of received OM reply and computor commits for each oracle query (used before reveal)
     ReplyState* replyStates;
 
-    // index in replyStates to check next for empty slot (cyclic buffer)
-    int32_t replyStatesIndex;
+    // stack of indices of empty slots in replyStates
+    uint32_t freeReplyStateSlots[MAX_SIMULTANEOUS_ORACLE_QUERIES];
 
-    /// fast lookup of query indices for which oracles are in pending state
-    UnsortedMultiset<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingQueryIndices;
+    // number of elements used in freeReplyStateSlots
+    uint32_t freeReplyStateSlotCount;
 
-    /// fast lookup of reply state indices for which commit tx is pending
-    UnsortedMultiset<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingCommitReplyStateIndices;
+    /// fast lookup of query indices for which oracles are in pending state (key is reply state index of query)
+    IndexedSet<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingQueryIndices;
 
-    /// fast lookup of reply state indices for which reveal tx is pending
-    UnsortedMultiset<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingRevealReplyStateIndices;
+    /// fast lookup of reply state indices for which commit tx is pending (key is reply state index)
+    IndexedSet<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingCommitReplyStateIndices;
+
+    /// fast lookup of reply state indices for which reveal tx is pending (key is reply state index)
+    IndexedSet<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingRevealReplyStateIndices;
 
     // fast lookup of query indices for which the contract should be notified
     UnsortedMultiset<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> notificationQueryIndicies;
 
+    // number of pending queries with ORACLE_FLAG_SHARED_REPLY (not in pendingQueryIndices, derived from queries)
+    uint32_t sharedReplyPendingQueryCount;
+
+    // number of queries with ORACLE_FLAG_SHARED_REPLY in this epoch (derived from queries)
+    uint32_t sharedReplyQueryCount;
+
     // revenue points collected by each computor for fast and correct commit
     uint64_t revenuePoints[NUMBER_OF_COMPUTORS];
 
@@ -328,26 +397,39 @@ protected:
     /// lock for preventing race conditions in concurrent execution
     mutable volatile char lock;
 
-    /// Return empty reply state slot or max uint32 value on error
-    uint32_t getEmptyReplyStateSlot()
+    /// Return empty reply state slot or max uint32 value on error. The slot stays empty until useReplyStateSlot() is called.
+    uint32_t getEmptyReplyStateSlot() const
     {
-        ASSERT(replyStatesIndex < MAX_SIMULTANEOUS_ORACLE_QUERIES);
-        for (uint32_t i = 0; i < MAX_SIMULTANEOUS_ORACLE_QUERIES; ++i)
-        {
-            if (replyStates[replyStatesIndex].queryId <= 0)
-                return replyStatesIndex;
+        ASSERT(freeReplyStateSlotCount <= MAX_SIMULTANEOUS_ORACLE_QUERIES);
+        if (!freeReplyStateSlotCount)
+            return 0xffffffff;
+        return freeReplyStateSlots[freeReplyStateSlotCount - 1];
+    }
 
-            ++replyStatesIndex;
-            if (replyStatesIndex >= MAX_SIMULTANEOUS_ORACLE_QUERIES)
-                replyStatesIndex = 0;
-        }
-        return 0xffffffff;
+    /// Mark slot returned by getEmptyReplyStateSlot() as used
+    void useReplyStateSlot(uint32_t replyStateIdx)
+    {
+        ASSERT(freeReplyStateSlotCount > 0 && freeReplyStateSlots[freeReplyStateSlotCount - 1] == replyStateIdx);
+        --freeReplyStateSlotCount;
     }
 
     void freeReplyStateSlot(uint32_t replyStateIdx)
     {
-        ASSERT(replyStatesIndex < MAX_SIMULTANEOUS_ORACLE_QUERIES);
+        ASSERT(replyStateIdx < MAX_SIMULTANEOUS_ORACLE_QUERIES);
+        ASSERT(freeReplyStateSlotCount < MAX_SIMULTANEOUS_ORACLE_QUERIES);
         setMem(&replyStates[replyStateIdx], sizeof(*replyStates), 0);
+        freeReplyStateSlots[freeReplyStateSlotCount++] = replyStateIdx;
+    }
+
+    /// Init stack of empty reply state slots from replyStates (lowest index is used first)
+    void initFreeReplyStateSlots()
+    {
+        freeReplyStateSlotCount = 0;
+        for (uint32_t i = MAX_SIMULTANEOUS_ORACLE_QUERIES; i-- > 0; )
+        {
+            if (replyStates[i].queryId <= 0)
+                freeReplyStateSlots[freeReplyStateSlotCount++] = i;
+        }
     }
 
     uint32_t findFirstQueryIndexOfTick(uint32_t tick) const
@@ -421,11 +503,13 @@ public:
         oracleQueryCount = 0;
         queryStorageBytesUsed = 8; // reserve offset 0 for "no data"
         setMem(&contractQueryIdState, sizeof(contractQueryIdState), 0);
-        replyStatesIndex = 0;
-        pendingQueryIndices.numValues = 0;
-        pendingCommitReplyStateIndices.numValues = 0;
-        pendingRevealReplyStateIndices.numValues = 0;
+        initFreeReplyStateSlots();
+        pendingQueryIndices.reset();
+        pendingCommitReplyStateIndices.reset();
+        pendingRevealReplyStateIndices.reset();
         notificationQueryIndicies.numValues = 0;
+        sharedReplyPendingQueryCount = 0;
+        sharedReplyQueryCount = 0;
         setMem(revenuePoints, sizeof(revenuePoints), 0);
         setMem(&stats, sizeof(stats), 0);
 
@@ -543,8 +627,9 @@ public:
             return -1;
         }
 
-        // register index of pending query
-        pendingQueryIndices.add(oracleQueryCount);
+        // register index of pending query and occupy reply state slot
+        pendingQueryIndices.add(oracleQueryCount, replyStateSlotIdx);
+        useReplyStateSlot(replyStateSlotIdx);
 
         // init query metadata (persistent)
         auto& queryMetadata = queries[oracleQueryCount++];
@@ -617,7 +702,7 @@ public:
         LockGuard lockGuard(lock);
 
         // check that still have free capacity for the query
-        if (oracleQueryCount >= MAX_ORACLE_QUERIES || pendingQueryIndices.numValues >= MAX_SIMULTANEOUS_ORACLE_QUERIES || queryStorageBytesUsed + querySize > ORACLE_QUERY_STORAGE_SIZE)
+        if (oracleQueryCount >= MAX_ORACLE_QUERIES || pendingQueryIndices.numValues + sharedReplyPendingQueryCount >= MAX_SIMULTANEOUS_ORACLE_QUERIES || queryStorageBytesUsed + querySize > ORACLE_QUERY_STORAGE_SIZE)
         {
 #if !defined(NDEBUG) && !defined(NO_UEFI)
             addDebugMessage(L"Cannot start contract oracle query due to lack of space!");
@@ -625,24 +710,29 @@ public:
             return -1;
         }
 
-        // find slot storing temporary reply state
-        uint32_t replyStateSlotIdx = getEmptyReplyStateSlot();
-        if (replyStateSlotIdx >= MAX_SIMULTANEOUS_ORACLE_QUERIES)
+        // compute timeout as absolute point in time
+        auto timeout = QPI::DateAndTime::now();
+        if (timeoutMillisec > MAX_ORACLE_TIMEOUT_MILLISEC || !timeout.addMillisec(timeoutMillisec))
         {
 #if !defined(NDEBUG) && !defined(NO_UEFI)
-            addDebugMessage(L"Cannot start contract oracle query due to lack of free reply slot!");
+            addDebugMessage(L"Cannot start contract oracle query due to timeout timestamp issue!");
 #endif
             return -1;
         }
 
-        // compute timeout as absolute point in time
-        auto timeout = QPI::DateAndTime::now();
-        if (timeoutMillisec > MAX_ORACLE_TIMEOUT_MILLISEC || !timeout.addMillisec(timeoutMillisec))
+        // share reply of identical query if possible, otherwise find slot storing temporary reply state
+        const uint32_t sharedReplyQueryIdx = findSharedReplyQuery(interfaceIndex, queryData, querySize, timeout);
+        uint32_t replyStateSlotIdx = 0xffffffff;
+        if (sharedReplyQueryIdx == UINT32_MAX)
         {
+            replyStateSlotIdx = getEmptyReplyStateSlot();
+            if (replyStateSlotIdx >= MAX_SIMULTANEOUS_ORACLE_QUERIES)
+            {
 #if !defined(NDEBUG) && !defined(NO_UEFI)
-            addDebugMessage(L"Cannot start contract oracle query due to timeout timestamp issue!");
+                addDebugMessage(L"Cannot start contract oracle query due to lack of free reply slot!");
 #endif
-            return -1;
+                return -1;
+            }
         }
 
         // get sequential query index of contract in tick
@@ -678,11 +768,9 @@ public:
             return -1;
         }
 
-        // register index of pending query
-        pendingQueryIndices.add(oracleQueryCount);
-
         // init query metadata (persistent)
-        auto& queryMetadata = queries[oracleQueryCount++];
+        const uint32_t queryIndex = oracleQueryCount++;
+        auto& queryMetadata = queries[queryIndex];
         queryMetadata.queryId = queryId;
         queryMetadata.type = ORACLE_QUERY_TYPE_CONTRACT_QUERY;
         queryMetadata.status = ORACLE_QUERY_STATUS_PENDING;
@@ -693,19 +781,53 @@ public:
         queryMetadata.typeVar.contract.queryingContract = contractIndex;
         queryMetadata.typeVar.contract.queryStorageOffset = queryStorageBytesUsed;
         queryMetadata.typeVar.contract.notificationProcId = notificationProcId;
-        queryMetadata.statusVar.pending.replyStateIndex = replyStateSlotIdx;
-
-        // init reply state (temporary until reply is revealed)
-        ReplyState& replyState = replyStates[replyStateSlotIdx];
-        setMem(&replyState, sizeof(replyState), 0);
-        replyState.queryId = queryId;
+        queryMetadata.typeVar.contract.nextSharedReplyQueryIndex = 0;
 
         // copy oracle query data to permanent storage
         copyMem(queryStorage + queryStorageBytesUsed, queryData, querySize);
         queryStorageBytesUsed += querySize;
 
-        // enqueue query message to oracle machine node
-        enqueueOracleQuery(queryId, interfaceIndex, timeoutMillisec, queryData, querySize);
+        if (sharedReplyQueryIdx == UINT32_MAX)
+        {
+            // register index of pending query and occupy reply state slot
+            pendingQueryIndices.add(queryIndex, replyStateSlotIdx);
+            useReplyStateSlot(replyStateSlotIdx);
+            queryMetadata.statusVar.pending.replyStateIndex = replyStateSlotIdx;
+
+            // init reply state (temporary until reply is revealed)
+            ReplyState& replyState = replyStates[replyStateSlotIdx];
+            setMem(&replyState, sizeof(replyState), 0);
+            replyState.queryId = queryId;
+
+            // enqueue query message to oracle machine node
+            enqueueOracleQuery(queryId, interfaceIndex, timeoutMillisec, queryData, querySize);
+        }
+        else
+        {
+            // no oracle machine query, commits, and reveal of its own, but the status and reply of the shared query
+            const OracleQueryMetadata& sharedOqm = queries[sharedReplyQueryIdx];
+            queryMetadata.statusFlags = ORACLE_FLAG_SHARED_REPLY;
+            ++sharedReplyQueryCount;
+            if (sharedOqm.status == ORACLE_QUERY_STATUS_SUCCESS)
+            {
+                // reply has been revealed recently -> notify contract right away
+                queryMetadata.status = ORACLE_QUERY_STATUS_SUCCESS;
+                queryMetadata.statusVar = sharedOqm.statusVar;
+                notificationQueryIndicies.add(queryIndex);
+            }
+            else
+            {
+                // append to list of queries finished together with the pending query (see finishSharedReplyQueries()),
+                // which has the same timeout
+                ASSERT(queryMetadata.timeout == sharedOqm.timeout);
+                queryMetadata.statusVar.pending.replyStateIndex = sharedOqm.statusVar.pending.replyStateIndex;
+                uint32_t lastIndex = sharedReplyQueryIdx;
+                while (queries[lastIndex].typeVar.contract.nextSharedReplyQueryIndex)
+                    lastIndex = queries[lastIndex].typeVar.contract.nextSharedReplyQueryIndex;
+                queries[lastIndex].typeVar.contract.nextSharedReplyQueryIndex = queryIndex;
+                ++sharedReplyPendingQueryCount;
+            }
+        }
 
         // log status change
         OracleQueryStatusChange logEvent{ m256i(contractIndex, 0, 0, 0), queryId, interfaceIndex, queryMetadata.type, queryMetadata.status };
@@ -762,6 +884,65 @@ protected:
         enqueueResponse((Peer*)0x1, payloadSize, OracleMachineQuery::type(), 0, omq);
     }
 
+    // Find query whose reply can be shared by a new contract query with the same interface and query data, instead
+    // of querying the oracle machine and committing and revealing the same reply again. Candidates are queries that
+    // succeeded within the last ORACLE_REPLY_CACHE_TICKS ticks and pending contract queries with the same timeout as
+    // the new query (a sharing query is finished together with the shared one, so a later timeout would make it time
+    // out before its own deadline). Returns query index or UINT32_MAX if there is none. Caller must acquire engine lock!
+    uint32_t findSharedReplyQuery(uint32_t interfaceIndex, const void* queryData, uint16_t querySize, const QPI::DateAndTime& timeout) const
+    {
+        // each query sharing a reply will need a notification, so limit them like queries with reply state
+        if (pendingQueryIndices.numValues + sharedReplyPendingQueryCount + notificationQueryIndicies.numValues >= MAX_SIMULTANEOUS_ORACLE_QUERIES)
+            return UINT32_MAX;
+
+        // prefer recently revealed reply (queries are sorted by tick, so scan backwards from latest query)
+        for (uint32_t queryIndex = oracleQueryCount; queryIndex-- > 0 && queries[queryIndex].queryTick + ORACLE_REPLY_CACHE_TICKS > system.tick; )
+        {
+            const OracleQueryMetadata& oqm = queries[queryIndex];
+            if (oqm.status != ORACLE_QUERY_STATUS_SUCCESS || oqm.interfaceIndex != interfaceIndex)
+                continue;
+            const void* sharedQueryData = getOracleQueryPointerFromMetadata(oqm, querySize);
+            if (sharedQueryData && compareMem(sharedQueryData, queryData, querySize) == 0)
+                return queryIndex;
+        }
+
+        // pending contract query (lowest index, so the result does not depend on the order of pendingQueryIndices)
+        uint32_t sharedQueryIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < pendingQueryIndices.numValues; ++i)
+        {
+            const uint32_t queryIndex = pendingQueryIndices.values[i];
+            const OracleQueryMetadata& oqm = queries[queryIndex];
+            if (queryIndex < sharedQueryIndex && oqm.type == ORACLE_QUERY_TYPE_CONTRACT_QUERY && oqm.interfaceIndex == interfaceIndex
+                && timeout == oqm.timeout && compareMem(queryStorage + oqm.typeVar.contract.queryStorageOffset, queryData, querySize) == 0)
+            {
+                sharedQueryIndex = queryIndex;
+            }
+        }
+        return sharedQueryIndex;
+    }
+
+    // Pass final status of pending query oqm (success, unresolvable, or timeout) to the queries sharing its reply
+    // and schedule their notifications. Caller must acquire engine lock!
+    void finishSharedReplyQueries(const OracleQueryMetadata& oqm)
+    {
+        if (oqm.type != ORACLE_QUERY_TYPE_CONTRACT_QUERY)
+            return;
+        for (uint32_t queryIndex = oqm.typeVar.contract.nextSharedReplyQueryIndex; queryIndex; )
+        {
+            ASSERT(queryIndex < oracleQueryCount);
+            OracleQueryMetadata& sharedOqm = queries[queryIndex];
+            ASSERT(sharedOqm.status == ORACLE_QUERY_STATUS_PENDING && (sharedOqm.statusFlags & ORACLE_FLAG_SHARED_REPLY));
+            sharedOqm.status = oqm.status;
+            sharedOqm.statusFlags = oqm.statusFlags | ORACLE_FLAG_SHARED_REPLY;
+            sharedOqm.statusVar = oqm.statusVar;
+            ASSERT(sharedReplyPendingQueryCount > 0);
+            --sharedReplyPendingQueryCount;
+            notificationQueryIndicies.add(queryIndex);
+            logQueryStatusChange(sharedOqm);
+            queryIndex = sharedOqm.typeVar.contract.nextSharedReplyQueryIndex;
+        }
+    }
+
     void logQueryStatusChange(const OracleQueryMetadata& oqm) const
     {
         m256i queryingEntity = m256i::zero();
@@ -792,9 +973,9 @@ public:
         if (!queryIdToIndex->get(replyMessage->oracleQueryId, queryIndex) || queryIndex >= oracleQueryCount)
             return;
 
-        // get query metadata
+        // get query metadata (queries sharing the reply of another query are not sent to the oracle machine)
         OracleQueryMetadata& oqm = queries[queryIndex];
-        if (oqm.status != ORACLE_QUERY_STATUS_PENDING)
+        if (oqm.status != ORACLE_QUERY_STATUS_PENDING || (oqm.statusFlags & ORACLE_FLAG_SHARED_REPLY))
             return;
 
         // check error flags
@@ -848,7 +1029,7 @@ public:
         stats.oracleMachineReplyTicksSum += (system.tick - oqm.queryTick);
 
         // add reply state to set of indices with pending commit tx
-        pendingCommitReplyStateIndices.add(replyStateIdx);
+        pendingCommitReplyStateIndices.add(replyStateIdx, replyStateIdx);
 
 #if ENABLE_ORACLE_STATS_RECORD
         // Update the stats for each type of oracles
@@ -1010,6 +1191,263 @@ public:
         return UINT32_MAX;
     }
 
+    /**
+    * Prepare OracleReplyBatchCommitTransaction in txBuffer with reply commits of multiple own computors, setting all
+    * except co-signatures and signature.
+    *
+    * @param txBuffer Buffer for constructing the transaction. Size must be at least MAX_TRANSACTION_SIZE bytes.
+    * @param computorIndices Indices of own computors in list of computors broadcasted by arbitrator.
+    * @param ownComputorIndices Indices of the same computors in local array computorSeeds.
+    * @param computorCount Number of elements in computorIndices and ownComputorIndices.
+    * @param txScheduleTick Tick, in which the transaction is supposed to be scheduled.
+    * @return Number of computors in the created tx, 0 if no tx needs to be sent. The first computor listed in the tx
+    *         is the tx source, the others have to co-sign the tx. Call again until 0 is returned, because all pending
+    *         commits may not fit into one tx.
+    *
+    * Called from tick processor.
+    */
+    uint32_t getReplyBatchCommitTransaction(
+        void* txBuffer, const uint16_t* computorIndices, const uint16_t* ownComputorIndices,
+        uint32_t computorCount, uint32_t txScheduleTick)
+    {
+        // check inputs
+        ASSERT(txBuffer && computorIndices && ownComputorIndices);
+        if (txScheduleTick <= system.tick)
+            return 0;
+
+        // lock for accessing engine data
+        LockGuard lockGuard(lock);
+
+        auto isValidComputor = [&](uint32_t i)
+        {
+            return ownComputorIndices[i] < ownComputorSeedsCount && computorIndices[i] < NUMBER_OF_COMPUTORS;
+        };
+        auto needsCommit = [&](const ReplyState& replyState, uint16_t ownComputorIdx)
+        {
+            // oracle reply has been received and commit tx is neither executed nor scheduled
+            return replyState.queryId > 0 && replyState.ownReplySize != 0
+                && !replyState.ownReplyCommitComputorTxExecuted[ownComputorIdx]
+                && replyState.ownReplyCommitComputorTxTick[ownComputorIdx] < system.tick;
+        };
+
+        // find first computor with pending commits and select the queries to commit (limit the number of queries,
+        // so at least two computors fit into the tx if there is another candidate)
+        unsigned int replyIndices[OracleReplyBatchCommitTransactionPrefix::maxQueryCount(1)];
+        uint32_t queryCount = 0;
+        uint32_t firstPos = 0;
+        for (; firstPos < computorCount; ++firstPos)
+        {
+            if (!isValidComputor(firstPos))
+                continue;
+            const uint32_t maxQueryCount = OracleReplyBatchCommitTransactionPrefix::maxQueryCount((computorCount - firstPos >= 2) ? 2 : 1);
+            for (unsigned int i = 0; i < pendingCommitReplyStateIndices.numValues && queryCount < maxQueryCount; ++i)
+            {
+                const unsigned int replyIdx = pendingCommitReplyStateIndices.values[i];
+                if (replyIdx < MAX_SIMULTANEOUS_ORACLE_QUERIES && needsCommit(replyStates[replyIdx], ownComputorIndices[firstPos]))
+                    replyIndices[queryCount++] = replyIdx;
+            }
+            if (queryCount)
+                break;
+        }
+
+        // no reply commits needed? -> signal to skip tx
+        if (!queryCount)
+            return 0;
+
+        // add other computors that need to commit all selected queries
+        uint32_t positions[OracleReplyBatchCommitTransactionPrefix::maxComputorCount(1)];
+        uint32_t txComputorCount = 0;
+        positions[txComputorCount++] = firstPos;
+        const uint32_t maxComputorCount = OracleReplyBatchCommitTransactionPrefix::maxComputorCount(queryCount);
+        for (uint32_t pos = firstPos + 1; pos < computorCount && txComputorCount < maxComputorCount; ++pos)
+        {
+            if (!isValidComputor(pos))
+                continue;
+            uint32_t q = 0;
+            while (q < queryCount && needsCommit(replyStates[replyIndices[q]], ownComputorIndices[pos]))
+                ++q;
+            if (q == queryCount)
+                positions[txComputorCount++] = pos;
+        }
+
+        // set query data, knowledge proofs, and computor indices
+        auto* tx = reinterpret_cast<OracleReplyBatchCommitTransactionPrefix*>(txBuffer);
+        tx->queryCount = queryCount;
+        tx->computorCount = txComputorCount;
+        auto* txQueries = const_cast<OracleReplyBatchCommitTransactionQuery*>(tx->queries());
+        auto* txComputorIndices = const_cast<unsigned short*>(tx->computorIndices());
+        for (uint32_t q = 0; q < queryCount; ++q)
+        {
+            ReplyState& replyState = replyStates[replyIndices[q]];
+            txQueries[q].queryId = replyState.queryId;
+            txQueries[q].replyDigest = replyState.ownReplyDigest;
+        }
+        for (uint32_t c = 0; c < txComputorCount; ++c)
+        {
+            const uint16_t computorIdx = computorIndices[positions[c]];
+            const uint16_t ownComputorIdx = ownComputorIndices[positions[c]];
+            m256i* txKnowledgeProofs = const_cast<m256i*>(tx->knowledgeProofs(c));
+            for (uint32_t q = 0; q < queryCount; ++q)
+            {
+                // compute knowledge proof of commit = K12(oracle reply + computor index)
+                ReplyState& replyState = replyStates[replyIndices[q]];
+                ASSERT(replyState.ownReplySize <= MAX_ORACLE_REPLY_SIZE);
+                *(uint16_t*)(replyState.ownReplyData + replyState.ownReplySize) = computorIdx;
+                KangarooTwelve(replyState.ownReplyData, replyState.ownReplySize + 2, &txKnowledgeProofs[q], 32);
+
+                // signal to schedule tx for given tick
+                replyState.ownReplyCommitComputorTxTick[ownComputorIdx] = txScheduleTick;
+            }
+            txComputorIndices[c] = computorIdx;
+        }
+        if (txComputorCount > 1)
+            setMem(const_cast<unsigned char*>(tx->coSignature(1)), (txComputorCount - 1) * SIGNATURE_SIZE, 0);
+
+        // finish all of tx except for signatures
+        tx->sourcePublicKey = ownComputorPublicKeys[ownComputorIndices[firstPos]];
+        tx->destinationPublicKey = m256i::zero();
+        tx->amount = 0;
+        tx->tick = txScheduleTick;
+        tx->inputType = OracleReplyBatchCommitTransactionPrefix::transactionType();
+        tx->inputSize = OracleReplyBatchCommitTransactionPrefix::inputSizeOf(queryCount, txComputorCount);
+
+        return txComputorCount;
+    }
+
+protected:
+    // Process reply commit of computor with index compIdx, contained in tx executed in txTick. Lock must be acquired
+    // by caller.
+    void processReplyCommit(int compIdx, const m256i& computorPublicKey, unsigned long long queryId,
+        const m256i& replyDigest, const m256i& replyKnowledgeProof, uint32_t txTick)
+    {
+        // get and check query index
+        uint32_t queryIndex;
+        if (!queryIdToIndex->get(queryId, queryIndex) || queryIndex >= oracleQueryCount)
+            return;
+
+        // get query metadata and check state (queries sharing the reply of another query have no commits)
+        OracleQueryMetadata& oqm = queries[queryIndex];
+        if ((oqm.status != ORACLE_QUERY_STATUS_PENDING && oqm.status != ORACLE_QUERY_STATUS_COMMITTED)
+            || (oqm.statusFlags & ORACLE_FLAG_SHARED_REPLY))
+            return;
+
+        // get reply state
+        const auto replyStateIdx = oqm.statusVar.pending.replyStateIndex;
+        ASSERT(replyStateIdx < MAX_SIMULTANEOUS_ORACLE_QUERIES);
+        ReplyState& replyState = replyStates[replyStateIdx];
+        ASSERT(replyState.queryId == queryId);
+
+        // ignore commit if we already have processed a commit by this computor
+        if (replyState.replyCommitTicks[compIdx] != 0)
+            return;
+
+        // save reply commit of computor
+        replyState.replyCommitDigests[compIdx] = replyDigest;
+        replyState.replyCommitKnowledgeProofs[compIdx] = replyKnowledgeProof;
+        replyState.replyCommitTicks[compIdx] = txTick;
+
+        // if tx is from own computor, prevent rescheduling of commit tx
+        for (auto i = 0ull; replyState.ownReplyCommitExecCount < ownComputorSeedsCount && i < ownComputorSeedsCount; ++i)
+        {
+            if (!replyState.ownReplyCommitComputorTxExecuted[i] && ownComputorPublicKeys[i] == computorPublicKey)
+            {
+                replyState.ownReplyCommitComputorTxExecuted[i] = txTick;
+                ++replyState.ownReplyCommitExecCount;
+                break;
+            }
+        }
+
+        // update reply commit histogram
+        // 1. search existing or free slot of digest in histogram array
+        uint16_t histIdx = 0;
+        while (replyState.replyCommitHistogramCount[histIdx] != 0 &&
+            replyDigest != replyState.replyCommitDigests[replyState.replyCommitHistogramIdx[histIdx]])
+        {
+            ASSERT(histIdx < NUMBER_OF_COMPUTORS);
+            ++histIdx;
+        }
+        // 2. update slot
+        if (replyState.replyCommitHistogramCount[histIdx] == 0)
+        {
+            // first time we see this commit digest
+            replyState.replyCommitHistogramIdx[histIdx] = compIdx;
+        }
+        ++replyState.replyCommitHistogramCount[histIdx];
+        // 3. update variables that trigger reveal
+        ++replyState.totalCommits;
+        if (replyState.replyCommitHistogramCount[histIdx] > replyState.replyCommitHistogramCount[replyState.mostCommitsHistIdx])
+            replyState.mostCommitsHistIdx = histIdx;
+
+        // check if there are enough computor commits for decision
+        const auto mostCommitsCount = replyState.replyCommitHistogramCount[replyState.mostCommitsHistIdx];
+        if (mostCommitsCount >= QUORUM)
+        {
+            // enough commits for the reply reveal transaction
+            if (oqm.status != ORACLE_QUERY_STATUS_COMMITTED)
+            {
+                // -> switch to status COMMITTED
+                oqm.status = ORACLE_QUERY_STATUS_COMMITTED;
+                pendingCommitReplyStateIndices.removeByKey(replyStateIdx);
+                pendingRevealReplyStateIndices.add(replyStateIdx, replyStateIdx);
+                ++stats.commitCount;
+                stats.commitTicksSum += (system.tick - oqm.queryTick);
+
+                // log status change
+                logQueryStatusChange(oqm);
+
+#if !defined(NDEBUG) && !defined(NO_UEFI) && 1
+                CHAR16 dbgMsg1[200];
+                setText(dbgMsg1, L"oracleEngine.processOracleReplyCommitTransaction(), tick ");
+                appendNumber(dbgMsg1, system.tick, FALSE);
+                appendText(dbgMsg1, ", queryId ");
+                appendNumber(dbgMsg1, oqm.queryId, FALSE);
+                appendText(dbgMsg1, " (");
+                appendNumber(dbgMsg1, mostCommitsCount, FALSE);
+                appendText(dbgMsg1, ":");
+                appendNumber(dbgMsg1, replyState.totalCommits - mostCommitsCount, FALSE);
+                appendText(dbgMsg1, ") -> COMMITTED");
+                addDebugMessage(dbgMsg1);
+#endif
+            }
+        }
+        else if (replyState.totalCommits - mostCommitsCount > NUMBER_OF_COMPUTORS - QUORUM)
+        {
+            // more than 1/3 of commits don't vote for most voted digest -> getting quorum isn't possible
+            // -> switch to status UNRESOLVABLE
+            oqm.status = ORACLE_QUERY_STATUS_UNRESOLVABLE;
+            oqm.statusVar.failure.agreeingCommits = mostCommitsCount;
+            oqm.statusVar.failure.totalCommits = replyState.totalCommits;
+            pendingQueryIndices.removeByKey(replyStateIdx);
+            ++stats.unresolvableCount;
+
+            // cleanup data of pending reply immediately (no info for revenue required)
+            pendingCommitReplyStateIndices.removeByKey(replyStateIdx);
+            freeReplyStateSlot(replyStateIdx);
+
+            // schedule contract notification(s) if needed
+            if (oqm.type != ORACLE_QUERY_TYPE_USER_QUERY)
+                notificationQueryIndicies.add(queryIndex);
+
+            // log status change
+            logQueryStatusChange(oqm);
+
+#if !defined(NDEBUG) && !defined(NO_UEFI) && 1
+            CHAR16 dbgMsg1[200];
+            setText(dbgMsg1, L"oracleEngine.processOracleReplyCommitTransaction(), tick ");
+            appendNumber(dbgMsg1, system.tick, FALSE);
+            appendText(dbgMsg1, ", queryId ");
+            appendNumber(dbgMsg1, oqm.queryId, FALSE);
+            appendText(dbgMsg1, " (");
+            appendNumber(dbgMsg1, mostCommitsCount, FALSE);
+            appendText(dbgMsg1, ":");
+            appendNumber(dbgMsg1, replyState.totalCommits - mostCommitsCount, FALSE);
+            appendText(dbgMsg1, ") -> UNRESOLVABLE");
+            addDebugMessage(dbgMsg1);
+#endif
+        }
+    }
+
+public:
     // Called from tick processor.
     bool processOracleReplyCommitTransaction(const OracleReplyCommitTransactionPrefix* transaction)
     {
@@ -1054,144 +1492,82 @@ public:
         uint32_t size = sizeof(OracleReplyCommitTransactionItem);
         for (; size <= transaction->inputSize; size += sizeof(OracleReplyCommitTransactionItem), ++item)
         {
-            // get and check query index
-            uint32_t queryIndex;
-            if (!queryIdToIndex->get(item->queryId, queryIndex) || queryIndex >= oracleQueryCount)
-                continue;
+            processReplyCommit(compIdx, transaction->sourcePublicKey, item->queryId, item->replyDigest, item->replyKnowledgeProof, transaction->tick);
 
-            // get query metadata and check state
-            OracleQueryMetadata& oqm = queries[queryIndex];
-            if (oqm.status != ORACLE_QUERY_STATUS_PENDING && oqm.status != ORACLE_QUERY_STATUS_COMMITTED)
-                continue;
-
-            // get reply state
-            const auto replyStateIdx = oqm.statusVar.pending.replyStateIndex;
-            ASSERT(replyStateIdx < MAX_SIMULTANEOUS_ORACLE_QUERIES);
-            ReplyState& replyState = replyStates[replyStateIdx];
-            ASSERT(replyState.queryId == item->queryId);
+#if !defined(NDEBUG) && !defined(NO_UEFI) && 0
+            appendNumber(dbgMsg, item->queryId, FALSE);
+            appendText(dbgMsg, " ");
+#endif
+        }
 
-            // ignore commit if we already have processed a commit by this computor
-            if (replyState.replyCommitTicks[compIdx] != 0)
-                continue;
+#if !defined(NDEBUG) && !defined(NO_UEFI) && 0
+        addDebugMessage(dbgMsg);
+#endif
 
-            // save reply commit of computor
-            replyState.replyCommitDigests[compIdx] = item->replyDigest;
-            replyState.replyCommitKnowledgeProofs[compIdx] = item->replyKnowledgeProof;
-            replyState.replyCommitTicks[compIdx] = transaction->tick;
+        return true;
+    }
 
-            // if tx is from own computor, prevent rescheduling of commit tx
-            for (auto i = 0ull; replyState.ownReplyCommitExecCount < ownComputorSeedsCount && i < ownComputorSeedsCount; ++i)
-            {
-                if (!replyState.ownReplyCommitComputorTxExecuted[i] && ownComputorPublicKeys[i] == transaction->sourcePublicKey)
-                {
-                    replyState.ownReplyCommitComputorTxExecuted[i] = transaction->tick;
-                    ++replyState.ownReplyCommitExecCount;
-                    break;
-                }
-            }
+    /**
+    * Process OracleReplyBatchCommitTransaction. The signature of the tx source has been verified before. The
+    * co-signatures of the other computors are checked with verifyComputorSignature(), all against the same digest
+    * of the co-signed part of the tx. Commits of computors with invalid co-signature are ignored.
+    *
+    * Called from tick processor.
+    */
+    bool processOracleReplyBatchCommitTransaction(const OracleReplyBatchCommitTransactionPrefix* transaction,
+        bool (*verifyComputorSignature)(unsigned int computorIndex, const unsigned char* messageDigest, const unsigned char* signature))
+    {
+        // check precondition for calling with ASSERTs
+        ASSERT(transaction != nullptr);
+        ASSERT(verifyComputorSignature != nullptr);
+        ASSERT(transaction->checkValidity());
+        ASSERT(isZero(transaction->destinationPublicKey));
+        ASSERT(transaction->inputType == OracleReplyBatchCommitTransactionPrefix::transactionType());
 
-            // update reply commit histogram
-            // 1. search existing or free slot of digest in histogram array
-            uint16_t histIdx = 0;
-            while (replyState.replyCommitHistogramCount[histIdx] != 0 &&
-                item->replyDigest != replyState.replyCommitDigests[replyState.replyCommitHistogramIdx[histIdx]])
-            {
-                ASSERT(histIdx < NUMBER_OF_COMPUTORS);
-                ++histIdx;
-            }
-            // 2. update slot
-            if (replyState.replyCommitHistogramCount[histIdx] == 0)
-            {
-                // first time we see this commit digest
-                replyState.replyCommitHistogramIdx[histIdx] = compIdx;
-            }
-            ++replyState.replyCommitHistogramCount[histIdx];
-            // 3. update variables that trigger reveal
-            ++replyState.totalCommits;
-            if (replyState.replyCommitHistogramCount[histIdx] > replyState.replyCommitHistogramCount[replyState.mostCommitsHistIdx])
-                replyState.mostCommitsHistIdx = histIdx;
-
-            // check if there are enough computor commits for decision
-            const auto mostCommitsCount = replyState.replyCommitHistogramCount[replyState.mostCommitsHistIdx];
-            if (mostCommitsCount >= QUORUM)
-            {
-                // enough commits for the reply reveal transaction
-                if (oqm.status != ORACLE_QUERY_STATUS_COMMITTED)
-                {
-                    // -> switch to status COMMITTED
-                    oqm.status = ORACLE_QUERY_STATUS_COMMITTED;
-                    pendingCommitReplyStateIndices.removeByValue(replyStateIdx);
-                    pendingRevealReplyStateIndices.add(replyStateIdx);
-                    ++stats.commitCount;
-                    stats.commitTicksSum += (system.tick - oqm.queryTick);
+        // check size of tx (bound counts first to prevent overflow)
+        if (transaction->inputSize < OracleReplyBatchCommitTransactionPrefix::minInputSize())
+            return false;
+        const uint32_t queryCount = transaction->queryCount;
+        const uint32_t computorCount = transaction->computorCount;
+        if (!queryCount || !computorCount || queryCount > MAX_INPUT_SIZE || computorCount > MAX_INPUT_SIZE / SIGNATURE_SIZE + 1
+            || transaction->inputSize != OracleReplyBatchCommitTransactionPrefix::inputSizeOf(queryCount, computorCount))
+            return false;
 
-                    // log status change
-                    logQueryStatusChange(oqm);
+        // first computor must be the tx source, which is authenticated by the tx signature
+        const unsigned short* computorIndices = transaction->computorIndices();
+        const int sourceCompIdx = computorIndex(transaction->sourcePublicKey);
+        if (sourceCompIdx < 0 || computorIndices[0] != sourceCompIdx)
+            return false;
 
-#if !defined(NDEBUG) && !defined(NO_UEFI) && 1
-                    CHAR16 dbgMsg1[200];
-                    setText(dbgMsg1, L"oracleEngine.processOracleReplyCommitTransaction(), tick ");
-                    appendNumber(dbgMsg1, system.tick, FALSE);
-                    appendText(dbgMsg1, ", queryId ");
-                    appendNumber(dbgMsg1, oqm.queryId, FALSE);
-                    appendText(dbgMsg1, " (");
-                    appendNumber(dbgMsg1, mostCommitsCount, FALSE);
-                    appendText(dbgMsg1, ":");
-                    appendNumber(dbgMsg1, replyState.totalCommits - mostCommitsCount, FALSE);
-                    appendText(dbgMsg1, ") -> COMMITTED");
-                    addDebugMessage(dbgMsg1);
-#endif
-                }
-            }
-            else if (replyState.totalCommits - mostCommitsCount > NUMBER_OF_COMPUTORS - QUORUM)
+        // verify co-signatures of the other computors with one digest (before locking, because verifying is slow)
+        bool computorValid[MAX_INPUT_SIZE / SIGNATURE_SIZE + 1];
+        computorValid[0] = true;
+        if (computorCount > 1)
+        {
+            unsigned char digest[32];
+            KangarooTwelve(transaction, transaction->coSignedSize(), digest, sizeof(digest));
+            for (uint32_t c = 1; c < computorCount; ++c)
             {
-                // more than 1/3 of commits don't vote for most voted digest -> getting quorum isn't possible
-                // -> switch to status UNRESOLVABLE
-                oqm.status = ORACLE_QUERY_STATUS_UNRESOLVABLE;
-                oqm.statusVar.failure.agreeingCommits = mostCommitsCount;
-                oqm.statusVar.failure.totalCommits = replyState.totalCommits;
-                pendingQueryIndices.removeByValue(queryIndex);
-                ++stats.unresolvableCount;
-
-                // cleanup data of pending reply immediately (no info for revenue required)
-                pendingCommitReplyStateIndices.removeByValue(replyStateIdx);
-                freeReplyStateSlot(replyStateIdx);
-
-                // schedule contract notification(s) if needed
-                if (oqm.type != ORACLE_QUERY_TYPE_USER_QUERY)
-                    notificationQueryIndicies.add(queryIndex);
-
-                // log status change
-                logQueryStatusChange(oqm);
-
-#if !defined(NDEBUG) && !defined(NO_UEFI) && 1
-                CHAR16 dbgMsg1[200];
-                setText(dbgMsg1, L"oracleEngine.processOracleReplyCommitTransaction(), tick ");
-                appendNumber(dbgMsg1, system.tick, FALSE);
-                appendText(dbgMsg1, ", queryId ");
-                appendNumber(dbgMsg1, oqm.queryId, FALSE);
-                appendText(dbgMsg1, " (");
-                appendNumber(dbgMsg1, mostCommitsCount, FALSE);
-                appendText(dbgMsg1, ":");
-                appendNumber(dbgMsg1, replyState.totalCommits - mostCommitsCount, FALSE);
-                appendText(dbgMsg1, ") -> UNRESOLVABLE");
-                addDebugMessage(dbgMsg1);
-#endif
+                computorValid[c] = computorIndices[c] < NUMBER_OF_COMPUTORS
+                    && verifyComputorSignature(computorIndices[c], digest, transaction->coSignature(c));
             }
-
-#if !defined(NDEBUG) && !defined(NO_UEFI) && 0
-            appendNumber(dbgMsg, item->queryId, FALSE);
-            appendText(dbgMsg, " (");
-            appendNumber(dbgMsg, mostCommitsCount, FALSE);
-            appendText(dbgMsg, ":");
-            appendNumber(dbgMsg, replyState.totalCommits - mostCommitsCount, FALSE);
-            appendText(dbgMsg, ")");
-#endif
         }
 
-#if !defined(NDEBUG) && !defined(NO_UEFI) && 0
-        addDebugMessage(dbgMsg);
-#endif
+        // lock for accessing engine data
+        LockGuard lockGuard(lock);
+
+        // process the commits of all computors with valid signature
+        const OracleReplyBatchCommitTransactionQuery* txQueries = transaction->queries();
+        for (uint32_t c = 0; c < computorCount; ++c)
+        {
+            if (!computorValid[c])
+                continue;
+            const uint16_t compIdx = computorIndices[c];
+            const m256i& computorPublicKey = broadcastedComputors.computors.publicKeys[compIdx];
+            const m256i* knowledgeProofs = transaction->knowledgeProofs(c);
+            for (uint32_t q = 0; q < queryCount; ++q)
+                processReplyCommit(compIdx, computorPublicKey, txQueries[q].queryId, txQueries[q].replyDigest, knowledgeProofs[q], transaction->tick);
+        }
 
         return true;
     }
@@ -1497,12 +1873,12 @@ public:
                 oqm.statusFlags |= ORACLE_FLAG_FAKE_COMMITS;
                 oqm.statusVar.failure.agreeingCommits = correctCommitsCount;
                 oqm.statusVar.failure.totalCommits = replyState->totalCommits;
-                pendingQueryIndices.removeByValue(queryIndex);
+                pendingQueryIndices.removeByKey(replyStateIdx);
                 --stats.commitCount;
                 ++stats.unresolvableCount;
 
                 // cleanup reply state
-                pendingRevealReplyStateIndices.removeByValue(replyStateIdx);
+                pendingRevealReplyStateIndices.removeByKey(replyStateIdx);
                 freeReplyStateSlot(replyStateIdx);
 
                 // schedule contract notification(s) if needed
@@ -1511,6 +1887,7 @@ public:
 
                 // log status change
                 logQueryStatusChange(oqm);
+                finishSharedReplyQueries(oqm);
 
 #if !defined(NDEBUG) && !defined(NO_UEFI) && 1
                 CHAR16 dbgMsg1[200];
@@ -1536,12 +1913,12 @@ public:
         oqm.statusVar.success.revealTick = transaction->tick;
         oqm.statusVar.success.revealTxIndex = txSlotInTickData;
         oqm.status = ORACLE_QUERY_STATUS_SUCCESS;
-        pendingQueryIndices.removeByValue(queryIndex);
+        pendingQueryIndices.removeByKey(replyStateIdx);
         ++stats.successCount;
         stats.successTicksSum += (oqm.statusVar.success.revealTick - oqm.queryTick);
 
         // cleanup reply state
-        pendingRevealReplyStateIndices.removeByValue(replyStateIdx);
+        pendingRevealReplyStateIndices.removeByKey(replyStateIdx);
         freeReplyStateSlot(replyStateIdx);
 
         // schedule contract notification(s) if needed
@@ -1550,6 +1927,7 @@ public:
 
         // log status change
         logQueryStatusChange(oqm);
+        finishSharedReplyQueries(oqm);
 
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         CHAR16 dbgMsg[200];
@@ -1608,11 +1986,11 @@ public:
                 oqm.status = ORACLE_QUERY_STATUS_TIMEOUT;
                 oqm.statusVar.failure.agreeingCommits = mostCommitsCount;
                 oqm.statusVar.failure.totalCommits = replyState.totalCommits;
-                pendingQueryIndices.removeByValue(queryIndex);
+                pendingQueryIndices.removeByKey(replyStateIdx);
 
                 // cleanup reply state
-                pendingCommitReplyStateIndices.removeByValue(replyStateIdx);
-                pendingRevealReplyStateIndices.removeByValue(replyStateIdx);
+                pendingCommitReplyStateIndices.removeByKey(replyStateIdx);
+                pendingRevealReplyStateIndices.removeByKey(replyStateIdx);
                 freeReplyStateSlot(replyStateIdx);
 
                 // schedule contract notification(s) if needed
@@ -1621,6 +1999,7 @@ public:
 
                 // log status change
                 logQueryStatusChange(oqm);
+                finishSharedReplyQueries(oqm);
 
 #if !defined(NDEBUG) && !defined(NO_UEFI)
                 CHAR16 dbgMsg[200];
@@ -1843,6 +2222,8 @@ public:
         uint64_t unresolvableCount = 0;
         uint64_t pendingCount = 0;
         uint64_t committedCount = 0;
+        uint64_t sharedReplyCount = 0;
+        uint64_t sharedReplyPendingCount = 0;
         uint64_t storageBytesUsed = 8;
         for (uint32_t queryIndex = 0; queryIndex < oracleQueryCount; ++queryIndex)
         {
@@ -1888,6 +2269,28 @@ public:
                 break;
             }
 
+            // queries sharing the reply of another query: pending until the shared query is finished
+            if (oqm.statusFlags & ORACLE_FLAG_SHARED_REPLY)
+            {
+                ASSERT(oqm.type == ORACLE_QUERY_TYPE_CONTRACT_QUERY);
+                ++sharedReplyCount;
+                if (oqm.status == ORACLE_QUERY_STATUS_PENDING)
+                {
+                    ++sharedReplyPendingCount;
+                    ASSERT(pendingQueryIndices.contains(oqm.statusVar.pending.replyStateIndex));
+                    ASSERT(replyStates[oqm.statusVar.pending.replyStateIndex].queryId != oqm.queryId);
+                }
+                else
+                {
+                    ASSERT(oqm.status == ORACLE_QUERY_STATUS_SUCCESS || oqm.status == ORACLE_QUERY_STATUS_UNRESOLVABLE || oqm.status == ORACLE_QUERY_STATUS_TIMEOUT);
+                }
+                continue;
+            }
+            else if (oqm.type == ORACLE_QUERY_TYPE_CONTRACT_QUERY && oqm.typeVar.contract.nextSharedReplyQueryIndex)
+            {
+                ASSERT(oqm.typeVar.contract.nextSharedReplyQueryIndex > queryIndex && oqm.typeVar.contract.nextSharedReplyQueryIndex < oracleQueryCount);
+            }
+
             // shared status checks
             const ReplyState* replyState = nullptr;
             uint16_t agreeingCommits = 0;
@@ -1954,7 +2357,9 @@ public:
         }
 
         ASSERT(queryStorageBytesUsed == storageBytesUsed);
-        ASSERT(oracleQueryCount == pendingCount + committedCount + successCount + timeoutCount + unresolvableCount);
+        ASSERT(oracleQueryCount == pendingCount + committedCount + successCount + timeoutCount + unresolvableCount + sharedReplyCount);
+        ASSERT(sharedReplyCount == sharedReplyQueryCount);
+        ASSERT(sharedReplyPendingCount == sharedReplyPendingQueryCount);
         ASSERT(committedCount == pendingRevealReplyStateIndices.numValues); // currently in committed state
         ASSERT(pendingCount + committedCount == pendingQueryIndices.numValues); // not finished (no success / failure)
         ASSERT(successCount == stats.successCount);
@@ -1971,6 +2376,17 @@ public:
             ASSERT(queryIndex < oracleQueryCount);
             const OracleQueryMetadata& oqm = queries[queryIndex];
             ASSERT(oqm.status == ORACLE_QUERY_STATUS_PENDING || oqm.status == ORACLE_QUERY_STATUS_COMMITTED);
+            ASSERT(pendingQueryIndices.keys[i] == oqm.statusVar.pending.replyStateIndex);
+            ASSERT(pendingQueryIndices.positions[pendingQueryIndices.keys[i]] == i + 1);
+        }
+
+        // check that reply state slots of pending queries are used and all others are free
+        ASSERT(freeReplyStateSlotCount + pendingQueryIndices.numValues == MAX_SIMULTANEOUS_ORACLE_QUERIES);
+        for (uint32_t i = 0; i < freeReplyStateSlotCount; ++i)
+        {
+            ASSERT(freeReplyStateSlots[i] < MAX_SIMULTANEOUS_ORACLE_QUERIES);
+            ASSERT(replyStates[freeReplyStateSlots[i]].queryId == 0);
+            ASSERT(!pendingQueryIndices.contains(freeReplyStateSlots[i]));
         }
 
         // check index of reply states with pending reply commit quorum
@@ -2079,6 +2495,11 @@ public:
         appendQuotientWithOneDecimal(message, stats.revealTxCount, stats.successCount);
         appendText(message, " reveal tx per success, wrong knowledge proofs ");
         appendNumber(message, stats.wrongKnowledgeProofCount, FALSE);
+        appendText(message, ", shared replies ");
+        appendNumber(message, sharedReplyQueryCount, FALSE);
+        appendText(message, " (pending ");
+        appendNumber(message, sharedReplyPendingQueryCount, FALSE);
+        appendText(message, ")");
         logToConsole(message);
 
 #if ENABLE_ORACLE_STATS_RECORD
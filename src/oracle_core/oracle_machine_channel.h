@@ -0,0 +1,258 @@
+#pragma once
+
+#include "platform/global_var.h"
+#include "platform/memory_util.h"
+#include "platform/assert.h"
+#include "platform/spin_lock.h"
+
+#include "network_messages/header.h"
+#include "oracle_core/core_om_network_messages.h"
+
+
+// Number of queries per frame sent to OM nodes that haven't announced support of ORACLE_MACHINE_QUERY_BATCH with
+// OracleMachineCapabilities. With 1, each query is sent as plain ORACLE_MACHINE_QUERY message.
+static constexpr unsigned int OM_MAX_QUERIES_PER_FRAME = 1;
+
+// Upper limit of queries coalesced into one ORACLE_MACHINE_QUERY_BATCH frame, if all connected OM nodes support it
+static constexpr unsigned int OM_MAX_QUERIES_PER_BATCH_FRAME = 32;
+
+// Time until a query without reply is sent again
+static constexpr unsigned int OM_QUERY_RESEND_TIMEOUT_SECS = 10;
+
+// Maximum number of times a query is sent to the OM nodes
+static constexpr unsigned int OM_MAX_QUERY_SENDS = 4;
+
+// Maximum number of queries waiting for reply (should be at least MAX_SIMULTANEOUS_ORACLE_QUERIES)
+static constexpr unsigned int OM_CHANNEL_CAPACITY = 1024;
+
+
+// Dedicated channel for sending oracle queries to the OM nodes, decoupled from the generic response queue.
+//
+// Queries are kept in the channel until the reply with the same query ID arrives (or the query expires), so they
+// survive periods without OM connection and are sent again if no reply arrives in time. Queries are pipelined (new
+// queries are sent without waiting for replies of earlier ones). If the OM nodes have announced support, all queries due
+// for sending are coalesced into one ORACLE_MACHINE_QUERY_BATCH frame, so the round-trip time of a query doesn't depend
+// on how many messages are queued.
+//
+// enqueueQuery() and buildFrame() are called by the main processor, processReply() by request processors.
+class OracleMachineChannel
+{
+public:
+    struct Statistics
+    {
+        unsigned long long framesSent;
+        unsigned long long queriesSent;
+        unsigned long long queriesResent;
+        unsigned long long repliesMatched;
+        unsigned long long repliesUnmatched;
+        unsigned long long queriesDropped;
+    };
+
+    // Maximum size of OracleMachineQuery plus oracle query data
+    static constexpr unsigned int maxQueryMessageSize = sizeof(OracleMachineQuery) + MAX_ORACLE_QUERY_SIZE;
+
+    // Maximum size of frame returned by buildFrame()
+    static constexpr unsigned int maxFrameSize = sizeof(RequestResponseHeader) + sizeof(OracleMachineQueryBatch)
+        + OM_MAX_QUERIES_PER_BATCH_FRAME * (sizeof(OracleMachineQueryBatchItem) + ((maxQueryMessageSize + 7) & ~7u));
+
+    bool init()
+    {
+        if (!allocPoolWithErrorLog(L"omChannel", OM_CHANNEL_CAPACITY * maxQueryMessageSize + maxFrameSize, (void**)&queryMessages, __LINE__))
+            return false;
+        frameBuffer = queryMessages + OM_CHANNEL_CAPACITY * maxQueryMessageSize;
+        reset();
+        return true;
+    }
+
+    void deinit()
+    {
+        if (queryMessages)
+        {
+            freePool(queryMessages);
+            queryMessages = nullptr;
+            frameBuffer = nullptr;
+        }
+    }
+
+    // Remove all queries and reset statistics.
+    void reset()
+    {
+        lock.reset();
+        activeCount = 0;
+        for (unsigned int i = 0; i < OM_CHANNEL_CAPACITY; ++i)
+            freeSlots[i] = OM_CHANNEL_CAPACITY - 1 - i;
+        freeCount = OM_CHANNEL_CAPACITY;
+        setMem(&stats, sizeof(stats), 0);
+    }
+
+    // Add query message (OracleMachineQuery followed by query data of size - sizeof(OracleMachineQuery) bytes) to be
+    // sent with the next frame. Return false if the channel is full or the message is invalid.
+    bool enqueueQuery(const OracleMachineQuery* query, unsigned int size, unsigned long long nowTsc, unsigned long long tscFrequency)
+    {
+        if (size < sizeof(OracleMachineQuery) || size > maxQueryMessageSize)
+            return false;
+
+        lock.acquire();
+        if (!freeCount)
+        {
+            ++stats.queriesDropped;
+            lock.release();
+            return false;
+        }
+        const unsigned int slot = freeSlots[--freeCount];
+        Entry& entry = entries[slot];
+        entry.queryId = query->oracleQueryId;
+        entry.expiryTsc = nowTsc + query->timeoutInMilliseconds * tscFrequency / 1000;
+        entry.nextSendTsc = 0;
+        entry.size = size;
+        entry.sendCount = 0;
+        copyMem(queryMessages + slot * maxQueryMessageSize, query, size);
+        activeSlots[activeCount++] = slot;
+        lock.release();
+        return true;
+    }
+
+    // Remove query after receiving the reply. Return false if the query is unknown (already replied or expired).
+    bool processReply(unsigned long long queryId)
+    {
+        lock.acquire();
+        for (unsigned int i = 0; i < activeCount; ++i)
+        {
+            if (entries[activeSlots[i]].queryId == queryId)
+            {
+                removeActive(i);
+                ++stats.repliesMatched;
+                lock.release();
+                return true;
+            }
+        }
+        ++stats.repliesUnmatched;
+        lock.release();
+        return false;
+    }
+
+    // Build frame with queries due for sending (new queries and queries without reply for OM_QUERY_RESEND_TIMEOUT_SECS)
+    // and drop expired queries. The frame includes up to maxQueriesPerFrame queries, which must not be more than the
+    // receiving OM nodes have announced to support. Return frame (RequestResponseHeader with payload) to send to all OM
+    // nodes or nullptr if no query is due. Call repeatedly until nullptr is returned. The frame stays valid until the
+    // next call.
+    const RequestResponseHeader* buildFrame(unsigned long long nowTsc, unsigned long long tscFrequency, unsigned int maxQueriesPerFrame = OM_MAX_QUERIES_PER_FRAME)
+    {
+        ASSERT(frameBuffer);
+        if (maxQueriesPerFrame < 1)
+            maxQueriesPerFrame = 1;
+        if (maxQueriesPerFrame > OM_MAX_QUERIES_PER_BATCH_FRAME)
+            maxQueriesPerFrame = OM_MAX_QUERIES_PER_BATCH_FRAME;
+        auto* header = (RequestResponseHeader*)frameBuffer;
+        auto* batch = (OracleMachineQueryBatch*)(header + 1);
+        unsigned char* payloadEnd = (unsigned char*)(batch + 1);
+        unsigned int firstSlot = 0;
+        unsigned int queryCount = 0;
+
+        lock.acquire();
+        for (unsigned int i = 0; i < activeCount && queryCount < maxQueriesPerFrame; )
+        {
+            const unsigned int slot = activeSlots[i];
+            Entry& entry = entries[slot];
+            if (nowTsc >= entry.expiryTsc || (entry.sendCount >= OM_MAX_QUERY_SENDS && nowTsc >= entry.nextSendTsc))
+            {
+                // OM reply would be ignored by oracle engine (timeout) or OM node doesn't reply -> give up
+                removeActive(i);
+                ++stats.queriesDropped;
+                continue;
+            }
+            if (nowTsc >= entry.nextSendTsc)
+            {
+                auto* item = (OracleMachineQueryBatchItem*)payloadEnd;
+                item->size = entry.size;
+                item->_padding0 = 0;
+                copyMem(item + 1, queryMessages + slot * maxQueryMessageSize, entry.size);
+                const unsigned int paddedSize = (entry.size + 7) & ~7u;
+                setMem((unsigned char*)(item + 1) + entry.size, paddedSize - entry.size, 0);
+                payloadEnd = (unsigned char*)(item + 1) + paddedSize;
+                if (!queryCount)
+                    firstSlot = slot;
+                ++queryCount;
+
+                if (entry.sendCount)
+                    ++stats.queriesResent;
+                ++stats.queriesSent;
+                ++entry.sendCount;
+                entry.nextSendTsc = nowTsc + OM_QUERY_RESEND_TIMEOUT_SECS * tscFrequency;
+            }
+            ++i;
+        }
+        if (queryCount == 1)
+        {
+            // single query -> send as plain ORACLE_MACHINE_QUERY message, supported by all OM nodes
+            const unsigned int size = entries[firstSlot].size;
+            copyMem(header + 1, queryMessages + firstSlot * maxQueryMessageSize, size);
+            header->checkAndSetSize(sizeof(RequestResponseHeader) + size);
+            header->setType(OracleMachineQuery::type());
+        }
+        else if (queryCount > 1)
+        {
+            batch->numberOfQueries = queryCount;
+            batch->_padding0 = 0;
+            header->checkAndSetSize((unsigned int)(payloadEnd - frameBuffer));
+            header->setType(OracleMachineQueryBatch::type());
+        }
+        if (queryCount)
+            ++stats.framesSent;
+        lock.release();
+
+        if (!queryCount)
+            return nullptr;
+        header->setDejavu(0);
+        return header;
+    }
+
+    // Return number of queries waiting for reply.
+    unsigned int getActiveCount() const
+    {
+        return activeCount;
+    }
+
+    // Return statistics (may be slightly inconsistent if the channel is currently used)
+    const Statistics& getStatistics() const
+    {
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        unsigned long long queryId;
+        unsigned long long expiryTsc;
+        unsigned long long nextSendTsc;
+        unsigned int size;
+        unsigned int sendCount;
+    };
+
+    // Remove activeSlots[i] by replacing it with the last one. Lock must be acquired by caller.
+    void removeActive(unsigned int i)
+    {
+        ASSERT(i < activeCount);
+        freeSlots[freeCount++] = activeSlots[i];
+        activeSlots[i] = activeSlots[--activeCount];
+    }
+
+    Entry entries[OM_CHANNEL_CAPACITY];
+
+    // Slots of queries waiting for reply
+    unsigned int activeSlots[OM_CHANNEL_CAPACITY];
+    unsigned int activeCount;
+
+    // Stack of unused slots
+    unsigned int freeSlots[OM_CHANNEL_CAPACITY];
+    unsigned int freeCount;
+
+    // Query messages (OM_CHANNEL_CAPACITY * maxQueryMessageSize), followed by frame buffer (maxFrameSize)
+    unsigned char* queryMessages;
+    unsigned char* frameBuffer;
+
+    SpinLock<> lock;
+    Statistics stats;
+};
+
+GLOBAL_VAR_DECL OracleMachineChannel oracleMachineChannel;
@@ -27,6 +27,92 @@ struct OracleReplyCommitTransactionPrefix : public Transaction
 	// followed by: n times OracleReplyCommitTransactionItem
 };
 
+struct OracleReplyBatchCommitTransactionQuery
+{
+	unsigned long long queryId;
+	m256i replyDigest;
+};
+
+// Transaction for committing oracle replies of multiple computors of one node in one tx, saving tx slots of the tick
+// compared to one OracleReplyCommitTransactionPrefix per computor. The tx source must be the first computor of the
+// batch. The other computors co-sign the tx data up to the co-signatures (see coSignedSize()), so the receiver
+// computes one digest and verifies all co-signatures against it.
+//
+// The tx prefix is followed by:
+// - queryCount times OracleReplyBatchCommitTransactionQuery (reply digest is the same for all computors of the node),
+// - computorCount * queryCount knowledge proofs (m256i), grouped by computor,
+// - computorCount computor indices (unsigned short),
+// - (computorCount - 1) co-signatures (SIGNATURE_SIZE bytes) of computors 1 to (computorCount - 1),
+// and subsequently the signature of the tx source.
+struct OracleReplyBatchCommitTransactionPrefix : public Transaction
+{
+	static constexpr unsigned char transactionType()
+	{
+		return 11; // TODO: Set actual value
+	}
+
+	static constexpr unsigned short minInputSize()
+	{
+		return sizeof(queryCount) + sizeof(computorCount) + sizeof(OracleReplyBatchCommitTransactionQuery) + sizeof(m256i) + sizeof(unsigned short);
+	}
+
+	static constexpr unsigned int inputSizeOf(unsigned int queryCount, unsigned int computorCount)
+	{
+		return sizeof(OracleReplyBatchCommitTransactionPrefix) - sizeof(Transaction)
+			+ queryCount * sizeof(OracleReplyBatchCommitTransactionQuery)
+			+ computorCount * queryCount * sizeof(m256i)
+			+ computorCount * sizeof(unsigned short)
+			+ (computorCount - 1) * SIGNATURE_SIZE;
+	}
+
+	// Maximum number of queries in tx with computorCount computors
+	static constexpr unsigned int maxQueryCount(unsigned int computorCount)
+	{
+		return (MAX_INPUT_SIZE - inputSizeOf(0, computorCount)) / (sizeof(OracleReplyBatchCommitTransactionQuery) + computorCount * sizeof(m256i));
+	}
+
+	// Maximum number of computors in tx with queryCount queries
+	static constexpr unsigned int maxComputorCount(unsigned int queryCount)
+	{
+		unsigned int computorCount = 1;
+		while (inputSizeOf(queryCount, computorCount + 1) <= MAX_INPUT_SIZE)
+			++computorCount;
+		return computorCount;
+	}
+
+	// Number of bytes from the beginning of the tx covered by the co-signatures
+	unsigned int coSignedSize() const
+	{
+		return inputSizeOf(queryCount, computorCount) + sizeof(Transaction) - (computorCount - 1) * SIGNATURE_SIZE;
+	}
+
+	const OracleReplyBatchCommitTransactionQuery* queries() const
+	{
+		return reinterpret_cast<const OracleReplyBatchCommitTransactionQuery*>(this + 1);
+	}
+
+	const m256i* knowledgeProofs(unsigned int computorPos) const
+	{
+		return reinterpret_cast<const m256i*>(queries() + queryCount) + computorPos * queryCount;
+	}
+
+	const unsigned short* computorIndices() const
+	{
+		return reinterpret_cast<const unsigned short*>(knowledgeProofs(computorCount));
+	}
+
+	// Co-signature of computor at computorPos (1 to computorCount - 1)
+	const unsigned char* coSignature(unsigned int computorPos) const
+	{
+		return reinterpret_cast<const unsigned char*>(computorIndices() + computorCount) + (computorPos - 1) * SIGNATURE_SIZE;
+	}
+
+	unsigned int queryCount;
+	unsigned int computorCount;
+
+	// followed by: queries, knowledge proofs, computor indices, co-signatures
+};
+
 // Transaction for revealing oracle reply. The tx prefix is followed by the OracleReply data
 // as defined by the oracle interface of the query, and subsequently the postfix (signature).
 struct OracleReplyRevealTransactionPrefix : public Transaction
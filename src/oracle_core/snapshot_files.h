@@ -13,13 +13,22 @@ static unsigned short ORACLE_SNAPSHOT_QUERY_DATA_FILENAME[] = L"snapshotOracleQu
 static unsigned short ORACLE_SNAPSHOT_REPLY_STATES_FILENAME[] = L"snapshotOracleReplyStates.???";
 
 
+// copy values of pending set to format used in snapshot files
+template <unsigned int N>
+static void copyPendingIndices(UnsortedMultiset<uint32_t, N>& dst, const IndexedSet<uint32_t, N>& src)
+{
+    dst.numValues = src.numValues;
+    copyMem(dst.values, src.values, src.numValues * sizeof(uint32_t));
+    setMem(dst.values + src.numValues, (N - src.numValues) * sizeof(uint32_t), 0);
+}
+
 struct OracleEngineSnapshotData
 {
     uint64_t queryStorageBytesUsed;
     uint32_t oracleQueryCount;
     uint32_t contractQueryIdStateTick;
     uint32_t contractQueryIdStateQueryIndexInTick;
-    int32_t replyStatesIndex;
+    int32_t replyStatesIndex; // unused, kept for compatibility of snapshot files
     UnsortedMultiset<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingQueryIndices;
     UnsortedMultiset<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingCommitReplyStateIndices;
     UnsortedMultiset<uint32_t, MAX_SIMULTANEOUS_ORACLE_QUERIES> pendingRevealReplyStateIndices;
@@ -45,10 +54,10 @@ bool OracleEngine<ownComputorSeedsCount>::saveSnapshot(unsigned short epoch, CHA
     engineData.oracleQueryCount = oracleQueryCount;
     engineData.contractQueryIdStateTick = contractQueryIdState.tick;
     engineData.contractQueryIdStateQueryIndexInTick = contractQueryIdState.queryIndexInTick;
-    engineData.replyStatesIndex = replyStatesIndex;
-    copyMemory(engineData.pendingQueryIndices, pendingQueryIndices);
-    copyMemory(engineData.pendingCommitReplyStateIndices, pendingCommitReplyStateIndices);
-    copyMemory(engineData.pendingRevealReplyStateIndices, pendingRevealReplyStateIndices);
+    engineData.replyStatesIndex = 0;
+    copyPendingIndices(engineData.pendingQueryIndices, pendingQueryIndices);
+    copyPendingIndices(engineData.pendingCommitReplyStateIndices, pendingCommitReplyStateIndices);
+    copyPendingIndices(engineData.pendingRevealReplyStateIndices, pendingRevealReplyStateIndices);
     copyMemory(engineData.notificationQueryIndicies, notificationQueryIndicies);
     copyMemory(engineData.revenuePoints, revenuePoints);
     copyMemory(engineData.stats, stats);
@@ -119,14 +128,13 @@ bool OracleEngine<ownComputorSeedsCount>::loadSnapshot(unsigned short epoch, CHA
     oracleQueryCount = engineData.oracleQueryCount;
     contractQueryIdState.tick = engineData.contractQueryIdStateTick;
     contractQueryIdState.queryIndexInTick = engineData.contractQueryIdStateQueryIndexInTick;
-    replyStatesIndex = engineData.replyStatesIndex;
-    copyMemory(pendingQueryIndices, engineData.pendingQueryIndices);
-    copyMemory(pendingCommitReplyStateIndices, engineData.pendingCommitReplyStateIndices);
-    copyMemory(pendingRevealReplyStateIndices, engineData.pendingRevealReplyStateIndices);
     copyMemory(notificationQueryIndicies, engineData.notificationQueryIndicies);
     copyMemory(revenuePoints, engineData.revenuePoints);
     copyMemory(stats, engineData.stats);
-    if (oracleQueryCount > MAX_ORACLE_QUERIES || queryStorageBytesUsed > ORACLE_QUERY_STORAGE_SIZE)
+    if (oracleQueryCount > MAX_ORACLE_QUERIES || queryStorageBytesUsed > ORACLE_QUERY_STORAGE_SIZE
+        || engineData.pendingQueryIndices.numValues > MAX_SIMULTANEOUS_ORACLE_QUERIES
+        || engineData.pendingCommitReplyStateIndices.numValues > MAX_SIMULTANEOUS_ORACLE_QUERIES
+        || engineData.pendingRevealReplyStateIndices.numValues > MAX_SIMULTANEOUS_ORACLE_QUERIES)
     {
         logToConsole(L"Oracle engine data is invalid!");
         return false;
@@ -171,10 +179,48 @@ bool OracleEngine<ownComputorSeedsCount>::loadSnapshot(unsigned short epoch, CHA
         return false;
     }
 
-    // init queryIdToIndex (not saved to file)
+    // init queryIdToIndex and counters of queries sharing replies (not saved to file)
     queryIdToIndex->reset();
+    sharedReplyQueryCount = 0;
+    sharedReplyPendingQueryCount = 0;
     for (uint32_t queryIndex = 0; queryIndex < oracleQueryCount; ++queryIndex)
+    {
         queryIdToIndex->set(queries[queryIndex].queryId, queryIndex);
+        if (queries[queryIndex].statusFlags & ORACLE_FLAG_SHARED_REPLY)
+        {
+            ++sharedReplyQueryCount;
+            if (queries[queryIndex].status == ORACLE_QUERY_STATUS_PENDING)
+                ++sharedReplyPendingQueryCount;
+        }
+    }
+
+    // init free reply state slots and position maps of pending sets (not saved to file)
+    initFreeReplyStateSlots();
+    pendingQueryIndices.reset();
+    pendingCommitReplyStateIndices.reset();
+    pendingRevealReplyStateIndices.reset();
+    bool pendingIndicesValid = true;
+    for (uint32_t i = 0; i < engineData.pendingQueryIndices.numValues; ++i)
+    {
+        const uint32_t queryIndex = engineData.pendingQueryIndices.values[i];
+        pendingIndicesValid = pendingIndicesValid && queryIndex < oracleQueryCount
+            && pendingQueryIndices.add(queryIndex, queries[queryIndex].statusVar.pending.replyStateIndex);
+    }
+    for (uint32_t i = 0; i < engineData.pendingCommitReplyStateIndices.numValues; ++i)
+    {
+        const uint32_t replyStateIdx = engineData.pendingCommitReplyStateIndices.values[i];
+        pendingIndicesValid = pendingIndicesValid && pendingCommitReplyStateIndices.add(replyStateIdx, replyStateIdx);
+    }
+    for (uint32_t i = 0; i < engineData.pendingRevealReplyStateIndices.numValues; ++i)
+    {
+        const uint32_t replyStateIdx = engineData.pendingRevealReplyStateIndices.values[i];
+        pendingIndicesValid = pendingIndicesValid && pendingRevealReplyStateIndices.add(replyStateIdx, replyStateIdx);
+    }
+    if (!pendingIndicesValid)
+    {
+        logToConsole(L"Oracle engine pending query data is invalid!");
+        return false;
+    }
 
     logToConsole(L"Successfully loaded all oracle engine data from snapshot!");
     return true;
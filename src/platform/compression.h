@@ -0,0 +1,219 @@
+#pragma once
+
+#include "memory_util.h"
+
+// Fast block compression in LZ4 block format (greedy matching with a small hash table, 64 KB window). It is meant
+// for data that is written once and read rarely (such as log pages on disk), where it trades some compression ratio
+// for speed. Compressed blocks are self-contained: decompression only needs the compressed bytes and their size.
+
+// Number of entries of the hash table needed by compressBlock() (hash table is provided by the caller, because it is
+// too large for the stack of the processors)
+static constexpr unsigned int COMPRESSION_HASH_TABLE_SIZE_2FACTOR = 12;
+static constexpr unsigned int COMPRESSION_HASH_TABLE_SIZE = 1 << COMPRESSION_HASH_TABLE_SIZE_2FACTOR;
+
+static constexpr unsigned int COMPRESSION_MIN_MATCH = 4;
+static constexpr unsigned int COMPRESSION_LAST_LITERALS = 5; // last bytes of block are always literals
+static constexpr unsigned int COMPRESSION_MATCH_FIND_LIMIT = 12; // no match starts in the last bytes of block
+static constexpr unsigned int COMPRESSION_MAX_OFFSET = 65535;
+
+static inline unsigned int compressionHash(unsigned int sequence)
+{
+    return (sequence * 2654435761U) >> (32 - COMPRESSION_HASH_TABLE_SIZE_2FACTOR);
+}
+
+static inline unsigned int compressionRead32(const unsigned char* ptr)
+{
+    return *(const unsigned int*)ptr;
+}
+
+// Write one sequence (literals followed by match of matchLength bytes, no match if matchLength is 0) to dst.
+// Returns new output position or 0 if dst is too small.
+static unsigned long long compressionWriteSequence(const unsigned char* literals, unsigned long long literalLength,
+    unsigned long long matchOffset, unsigned long long matchLength, unsigned char* dst, unsigned long long dstPos, unsigned long long dstCapacity)
+{
+    // token + literal length bytes + literals + offset + match length bytes
+    const unsigned long long maxSequenceSize = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+    if (dstPos + maxSequenceSize > dstCapacity)
+    {
+        return 0;
+    }
+
+    unsigned char* token = dst + dstPos++;
+    if (literalLength >= 15)
+    {
+        *token = 15 << 4;
+        unsigned long long remaining = literalLength - 15;
+        for (; remaining >= 255; remaining -= 255)
+        {
+            dst[dstPos++] = 255;
+        }
+        dst[dstPos++] = (unsigned char)remaining;
+    }
+    else
+    {
+        *token = (unsigned char)(literalLength << 4);
+    }
+    copyMem(dst + dstPos, literals, literalLength);
+    dstPos += literalLength;
+
+    if (matchLength)
+    {
+        dst[dstPos++] = (unsigned char)matchOffset;
+        dst[dstPos++] = (unsigned char)(matchOffset >> 8);
+        unsigned long long remaining = matchLength - COMPRESSION_MIN_MATCH;
+        if (remaining >= 15)
+        {
+            *token |= 15;
+            for (remaining -= 15; remaining >= 255; remaining -= 255)
+            {
+                dst[dstPos++] = 255;
+            }
+            dst[dstPos++] = (unsigned char)remaining;
+        }
+        else
+        {
+            *token |= (unsigned char)remaining;
+        }
+    }
+    return dstPos;
+}
+
+// Compress srcSize bytes (less than 4 GB) from src to dst with capacity dstCapacity. hashTable must have
+// COMPRESSION_HASH_TABLE_SIZE entries. Returns compressed size or 0 if the result doesn't fit into dst.
+static unsigned long long compressBlock(const unsigned char* src, unsigned long long srcSize, unsigned char* dst, unsigned long long dstCapacity,
+    unsigned int* hashTable)
+{
+    setMem(hashTable, COMPRESSION_HASH_TABLE_SIZE * sizeof(unsigned int), 0);
+    unsigned long long dstPos = 0;
+    unsigned long long anchor = 0; // begin of literals not written yet
+    unsigned long long pos = 0;
+    const unsigned long long matchEndLimit = (srcSize > COMPRESSION_LAST_LITERALS) ? srcSize - COMPRESSION_LAST_LITERALS : 0;
+
+    while (pos + COMPRESSION_MATCH_FIND_LIMIT <= srcSize)
+    {
+        const unsigned int sequence = compressionRead32(src + pos);
+        const unsigned int hash = compressionHash(sequence);
+        unsigned long long ref = hashTable[hash];
+        hashTable[hash] = (unsigned int)pos;
+        if (ref >= pos || pos - ref > COMPRESSION_MAX_OFFSET || compressionRead32(src + ref) != sequence)
+        {
+            // no match -> skip faster through incompressible data
+            pos += 1 + ((pos - anchor) >> 6);
+            continue;
+        }
+
+        // extend match backwards and forwards
+        while (pos > anchor && ref > 0 && src[pos - 1] == src[ref - 1])
+        {
+            pos--;
+            ref--;
+        }
+        unsigned long long matchLength = COMPRESSION_MIN_MATCH;
+        while (pos + matchLength < matchEndLimit && src[ref + matchLength] == src[pos + matchLength])
+        {
+            matchLength++;
+        }
+
+        dstPos = compressionWriteSequence(src + anchor, pos - anchor, pos - ref, matchLength, dst, dstPos, dstCapacity);
+        if (!dstPos)
+        {
+            return 0;
+        }
+        pos += matchLength;
+        anchor = pos;
+        if (pos >= 2 && pos + COMPRESSION_MATCH_FIND_LIMIT <= srcSize)
+        {
+            hashTable[compressionHash(compressionRead32(src + pos - 2))] = (unsigned int)(pos - 2);
+        }
+    }
+
+    // last literals
+    return compressionWriteSequence(src + anchor, srcSize - anchor, 0, 0, dst, dstPos, dstCapacity);
+}
+
+// Decompress block of srcSize bytes from src to dst with capacity dstCapacity. Returns decompressed size or -1 if
+// the compressed data is invalid or doesn't fit into dst.
+static long long decompressBlock(const unsigned char* src, unsigned long long srcSize, unsigned char* dst, unsigned long long dstCapacity)
+{
+    unsigned long long srcPos = 0;
+    unsigned long long dstPos = 0;
+    while (srcPos < srcSize)
+    {
+        const unsigned char token = src[srcPos++];
+
+        // literals
+        unsigned long long literalLength = token >> 4;
+        if (literalLength == 15)
+        {
+            unsigned char lengthByte;
+            do
+            {
+                if (srcPos >= srcSize)
+                {
+                    return -1;
+                }
+                lengthByte = src[srcPos++];
+                literalLength += lengthByte;
+            } while (lengthByte == 255);
+        }
+        if (literalLength > srcSize - srcPos || literalLength > dstCapacity - dstPos)
+        {
+            return -1;
+        }
+        copyMem(dst + dstPos, src + srcPos, literalLength);
+        srcPos += literalLength;
+        dstPos += literalLength;
+
+        // last sequence has no match
+        if (srcPos == srcSize)
+        {
+            break;
+        }
+
+        // match
+        if (srcSize - srcPos < 2)
+        {
+            return -1;
+        }
+        const unsigned long long offset = src[srcPos] | ((unsigned long long)src[srcPos + 1] << 8);
+        srcPos += 2;
+        if (offset == 0 || offset > dstPos)
+        {
+            return -1;
+        }
+        unsigned long long matchLength = token & 15;
+        if (matchLength == 15)
+        {
+            unsigned char lengthByte;
+            do
+            {
+                if (srcPos >= srcSize)
+                {
+                    return -1;
+                }
+                lengthByte = src[srcPos++];
+                matchLength += lengthByte;
+            } while (lengthByte == 255);
+        }
+        matchLength += COMPRESSION_MIN_MATCH;
+        if (matchLength > dstCapacity - dstPos)
+        {
+            return -1;
+        }
+        const unsigned char* match = dst + dstPos - offset;
+        if (offset >= matchLength)
+        {
+            copyMem(dst + dstPos, match, matchLength);
+        }
+        else
+        {
+            // overlapping match (repeated pattern), copy byte by byte
+            for (unsigned long long i = 0; i < matchLength; i++)
+            {
+                dst[dstPos + i] = match[i];
+            }
+        }
+        dstPos += matchLength;
+    }
+    return dstPos;
+}
@@ -25,6 +25,10 @@ public:
     BusyWaitingTracker(const char* expr, const char* file, unsigned int line);
     ~BusyWaitingTracker();
     void pause();
+
+    // Number of waits and sum of their durations in CPU ticks (of all trackers), for profiling lock contention
+    inline static volatile long long totalWaitCount = 0;
+    inline static volatile long long totalWaitTicks = 0;
 };
 
 // Acquire lock, may block and may log if it is blocked for a long time
@@ -30,6 +30,8 @@ BusyWaitingTracker::BusyWaitingTracker(const char* expr, const char* file, unsig
 BusyWaitingTracker::~BusyWaitingTracker()
 {
     ASSERT(frequency != 0);
+    _InterlockedIncrement64(&totalWaitCount);
+    _InterlockedExchangeAdd64(&totalWaitTicks, __rdtsc() - mStartTsc);
     if (mTotalWaitTimeReport)
     {
         CHAR16 msgBuffer[300];
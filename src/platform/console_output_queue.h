@@ -0,0 +1,109 @@
+#pragma once
+
+#include "console_logging.h"
+#include "memory_util.h"
+
+// Queue of console lines that are written to the console later in small time slices instead of blocking the caller,
+// because console output in UEFI is slow and delays the main loop (including network polling). Lines longer than a
+// slot occupy several consecutive slots. All functions must only be called from the main processor thread (like
+// logToConsole(), which is the only producer), so no synchronization is needed.
+template <unsigned int slotCount, unsigned int slotLength>
+class ConsoleOutputQueue
+{
+    static_assert(slotCount && (slotCount & (slotCount - 1)) == 0, "slotCount must be 2^N");
+    static_assert(slotLength >= 2, "Slot must hold at least one character and terminating NULL");
+
+    CHAR16 slots[slotCount][slotLength];
+    unsigned long long writeIndex;
+    unsigned long long readIndex;
+
+    // Rate limit as token bucket of characters that may be written, refilled with maxCharsPerSecond
+    unsigned long long maxCharsPerSecond;
+    long long charBudget;
+    unsigned long long lastRefillTsc;
+
+    // Maximum number of characters written by one call of render(), to keep each time slice short
+    unsigned long long maxCharsPerRender;
+
+    // Write next slot to console and free it. Returns number of characters written.
+    unsigned int outputSlot()
+    {
+        const CHAR16* text = slots[readIndex & (slotCount - 1)];
+        outputStringToConsole(text);
+        ++readIndex;
+        return stringLength(text);
+    }
+
+public:
+    // Init empty queue, writing at most maxCharsPerSecond characters per second and (apart from the last line
+    // started) at most maxCharsPerRender characters per call in render().
+    void init(unsigned long long maxCharsPerSecond, unsigned long long maxCharsPerRender)
+    {
+        writeIndex = 0;
+        readIndex = 0;
+        this->maxCharsPerSecond = maxCharsPerSecond;
+        charBudget = 0;
+        lastRefillTsc = 0;
+        this->maxCharsPerRender = maxCharsPerRender;
+    }
+
+    // Copy line to queue. Returns false without copying anything if there aren't enough free slots.
+    bool push(const CHAR16* line)
+    {
+        const unsigned int length = stringLength(line);
+        const unsigned int charsPerSlot = slotLength - 1;
+        const unsigned long long neededSlots = (length) ? (length + charsPerSlot - 1) / charsPerSlot : 1;
+        if (writeIndex - readIndex + neededSlots > slotCount)
+            return false;
+
+        for (unsigned long long i = 0; i < neededSlots; ++i)
+        {
+            CHAR16* text = slots[(writeIndex + i) & (slotCount - 1)];
+            const unsigned int offset = (unsigned int)i * charsPerSlot;
+            const unsigned int count = (length - offset < charsPerSlot) ? length - offset : charsPerSlot;
+            copyMem(text, line + offset, count * sizeof(CHAR16));
+            text[count] = 0;
+        }
+        writeIndex += neededSlots;
+        return true;
+    }
+
+    // Return true if no line is waiting to be written.
+    bool isEmpty() const
+    {
+        return readIndex == writeIndex;
+    }
+
+    // Write queued lines to console as long as the rate limit and maxCharsPerRender allow, given the current TSC and
+    // the TSC frequency. Returns the number of slots written.
+    unsigned int render(unsigned long long currentTsc, unsigned long long tscFrequency)
+    {
+        if (lastRefillTsc && tscFrequency)
+        {
+            const unsigned long long elapsed = currentTsc - lastRefillTsc;
+            const unsigned long long refill = (elapsed < tscFrequency) ? elapsed * maxCharsPerSecond / tscFrequency : maxCharsPerSecond;
+            // burst is limited to one second worth of characters
+            charBudget = (charBudget + (long long)refill < (long long)maxCharsPerSecond) ? charBudget + (long long)refill : (long long)maxCharsPerSecond;
+        }
+        lastRefillTsc = currentTsc;
+
+        unsigned int renderedSlots = 0;
+        unsigned long long renderedChars = 0;
+        while (charBudget > 0 && renderedChars < maxCharsPerRender && !isEmpty())
+        {
+            const unsigned int length = outputSlot();
+            charBudget -= length;
+            renderedChars += length;
+            ++renderedSlots;
+        }
+        return renderedSlots;
+    }
+
+    // Write all queued lines to console regardless of the rate limit, for example to keep the order of lines when
+    // writing to the console directly.
+    void flush()
+    {
+        while (!isEmpty())
+            outputSlot();
+    }
+};
@@ -13,22 +13,31 @@
 #include "concurrency.h"
 #include "memory.h"
 
-// If you get an error reading and writing files, set the chunk sizes below to
-// the cluster size set for formatting you disk. If you have no idea about the
+// Minimum size of read / write requests in load() and save(). If you get an error reading and writing files, set
+// the chunk sizes below to the cluster size set for formatting you disk. If you have no idea about the
 // cluster size, try 16384.
 #define READING_CHUNK_SIZE 32768
 #define WRITING_CHUNK_SIZE 32768
 #define FILE_CHUNK_SIZE (209715200ULL) // for large file saving
+
+// Maximum size of read / write requests in load() and save(). Large requests use much more of the bandwidth of
+// NVMe and RAID volumes. If a request larger than READING_CHUNK_SIZE / WRITING_CHUNK_SIZE fails, the chunk size is
+// halved and the request is repeated, so file system drivers that only support small requests still work. Use the
+// file I/O benchmark of benchmark_uefi for measuring the throughput of chunk sizes on a host.
+#define MAX_FILE_IO_CHUNK_SIZE (8 * 1024 * 1024ULL)
 #define VOLUME_LABEL L"Qubic"
 
-// Size of buffer for non-blocking save, this size will divided into ASYNC_FILE_IO_BLOCKING_MAX_QUEUE_ITEMS.
-// Can set by zeros to save memory and don't use non-block save
-static constexpr unsigned long long ASYNC_FILE_IO_WRITE_QUEUE_BUFFER_SIZE = 0;//8 * 1024 * 1024 * 1024ULL; // Set 0 if don't need non-blocking save
+// Size of ring buffer for non-blocking save (write-behind queue). Non-blocking saves that don't fit fall back to
+// blocking saves. Can set by zeros to save memory and don't use non-block save
+static constexpr unsigned long long ASYNC_FILE_IO_WRITE_QUEUE_BUFFER_SIZE = 1024 * 1024 * 1024ULL;
 static constexpr int ASYNC_FILE_IO_BLOCKING_MAX_QUEUE_ITEMS_2FACTOR = 10;
 static constexpr int ASYNC_FILE_IO_MAX_QUEUE_ITEMS_2FACTOR = 4;
 static constexpr int ASYNC_FILE_IO_MAX_FILE_NAME = 64;
 static constexpr int ASYNC_FILE_IO_BLOCKING_MAX_QUEUE_ITEMS = (1ULL << ASYNC_FILE_IO_BLOCKING_MAX_QUEUE_ITEMS_2FACTOR);
 static constexpr int ASYNC_FILE_IO_MAX_QUEUE_ITEMS = (1ULL << ASYNC_FILE_IO_MAX_QUEUE_ITEMS_2FACTOR);
+// Capacity of queue of background removals and number of files removed per flush (see asyncRemoveFileInBackground())
+static constexpr int ASYNC_FILE_IO_BACKGROUND_REMOVE_QUEUE_ITEMS = 4096;
+static constexpr int ASYNC_FILE_IO_BACKGROUND_REMOVES_PER_FLUSH = 8;
 
 static EFI_FILE_PROTOCOL* root = NULL;
 class AsyncFileIO;
@@ -38,6 +47,35 @@ static AsyncFileIO* gAsyncFileIO = NULL;
 static void addDebugMessage(const CHAR16* msg);
 #endif
 
+// Current sizes of read / write requests, reduced after failures (only accessed by main processor doing file I/O)
+static unsigned long long fileReadChunkSize = MAX_FILE_IO_CHUNK_SIZE;
+static unsigned long long fileWriteChunkSize = MAX_FILE_IO_CHUNK_SIZE;
+
+// Halve chunk size after request of failedRequestSize bytes failed. Returns false if the request already wasn't
+// larger than minChunkSize, so retrying with smaller chunks is not possible.
+static bool reduceFileIOChunkSize(unsigned long long& chunkSize, unsigned long long failedRequestSize, unsigned long long minChunkSize)
+{
+    if (failedRequestSize <= minChunkSize)
+    {
+        return false;
+    }
+    unsigned long long newChunkSize = failedRequestSize / 2;
+    newChunkSize -= newChunkSize % minChunkSize;
+    if (newChunkSize < minChunkSize)
+    {
+        newChunkSize = minChunkSize;
+    }
+    if (newChunkSize < chunkSize)
+    {
+        chunkSize = newChunkSize;
+        setText(message, L"Reducing file I/O chunk size to ");
+        appendNumber(message, chunkSize, TRUE);
+        appendText(message, L" bytes");
+        logToConsole(message);
+    }
+    return true;
+}
+
 static long long getFileSize(CHAR16* fileName, CHAR16* directory = NULL)
 {
 #ifdef NO_UEFI
@@ -228,8 +266,21 @@ static bool removeFile(CHAR16* directory, CHAR16* fileName)
 #endif
 }
 
-static long long load(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory = NULL)
+// Function called by loadAndProcess() for each part [begin, end) of the buffer (offsets in bytes) that has been read
+typedef void (*LoadedPartFunction)(void* context, unsigned long long begin, unsigned long long end);
+
+// Load file and call processPart for each loaded part of partSize bytes (the last one may be smaller) while the
+// following data is read, for example to hash data while it is still in cache instead of in a second pass.
+// processPart may be NULL. If allowShorterFile is true, reading a file smaller than totalSize succeeds.
+// Returns number of bytes read or -1 on error.
+static long long loadAndProcess(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory,
+    LoadedPartFunction processPart, void* context, unsigned long long partSize, bool allowShorterFile = false)
 {
+    unsigned long long processedSize = 0;
+    if (!processPart || !partSize)
+    {
+        partSize = totalSize;
+    }
 #ifdef NO_UEFI
     if (directory)
     {
@@ -242,13 +293,28 @@ static long long load(const CHAR16* fileName, unsigned long long totalSize, unsi
         wprintf(L"Error opening file %s!\n", fileName);
         return -1;
     }
-    if (fread(buffer, 1, totalSize, file) != totalSize)
+    while (processedSize < totalSize)
     {
-        wprintf(L"Error reading %llu bytes from %s!\n", totalSize, fileName);
-        return -1;
+        const unsigned long long size = (partSize <= totalSize - processedSize) ? partSize : totalSize - processedSize;
+        const unsigned long long readSize = fread(buffer + processedSize, 1, size, file);
+        if (readSize != size && !(allowShorterFile && feof(file)))
+        {
+            wprintf(L"Error reading %llu bytes from %s!\n", totalSize, fileName);
+            fclose(file);
+            return -1;
+        }
+        if (processPart && readSize)
+        {
+            processPart(context, processedSize, processedSize + readSize);
+        }
+        processedSize += readSize;
+        if (readSize != size)
+        {
+            break;
+        }
     }
     fclose(file);
-    return totalSize;
+    return processedSize;
 #else
     EFI_STATUS status;
     EFI_FILE_PROTOCOL* file;
@@ -288,12 +354,23 @@ static long long load(const CHAR16* fileName, unsigned long long totalSize, unsi
     if (EFI_SUCCESS == status)
     {
         unsigned long long readSize = 0;
-        while (readSize < totalSize)
+        bool endOfFile = false;
+        while (readSize < totalSize && !endOfFile)
         {
-            unsigned long long size = (READING_CHUNK_SIZE <= (totalSize - readSize) ? READING_CHUNK_SIZE : (totalSize - readSize));
+            const unsigned long long requestedSize = (fileReadChunkSize <= (totalSize - readSize) ? fileReadChunkSize : (totalSize - readSize));
+            unsigned long long size = requestedSize;
             status = file->Read(file, &size, &buffer[readSize]);
-            if (status
-                || size != (READING_CHUNK_SIZE <= (totalSize - readSize) ? READING_CHUNK_SIZE : (totalSize - readSize)))
+            if (status && reduceFileIOChunkSize(fileReadChunkSize, requestedSize, READING_CHUNK_SIZE)
+                && file->SetPosition(file, readSize) == EFI_SUCCESS)
+            {
+                // Retry with smaller chunk
+                continue;
+            }
+            if (!status && size < requestedSize && allowShorterFile)
+            {
+                endOfFile = true;
+            }
+            else if (status || size != requestedSize)
             {
                 // If this error occurs, see the definition of READING_CHUNK_SIZE above.
                 logStatusToConsole(L"EFI_FILE_PROTOCOL.Read() fails", status, __LINE__);
@@ -303,6 +380,17 @@ static long long load(const CHAR16* fileName, unsigned long long totalSize, unsi
                 return -1;
             }
             readSize += size;
+
+            // Process completely loaded parts
+            if (processPart)
+            {
+                while (processedSize < readSize && (readSize - processedSize >= partSize || readSize == totalSize || endOfFile))
+                {
+                    const unsigned long long partEnd = (readSize - processedSize >= partSize) ? processedSize + partSize : readSize;
+                    processPart(context, processedSize, partEnd);
+                    processedSize = partEnd;
+                }
+            }
         }
         file->Close(file);
 
@@ -312,7 +400,25 @@ static long long load(const CHAR16* fileName, unsigned long long totalSize, unsi
 #endif
 }
 
-static long long save(const CHAR16* fileName, unsigned long long totalSize, const unsigned char* buffer, const CHAR16* directory = NULL)
+static long long load(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory = NULL)
+{
+    return loadAndProcess(fileName, totalSize, buffer, directory, NULL, NULL, 0);
+}
+
+// Load file of at most maxSize bytes (for files with variable size). Returns size of file if it is smaller than
+// maxSize, maxSize if it is not smaller, or -1 on error.
+static long long loadUpTo(const CHAR16* fileName, unsigned long long maxSize, unsigned char* buffer, const CHAR16* directory = NULL)
+{
+    return loadAndProcess(fileName, maxSize, buffer, directory, NULL, NULL, 0, true);
+}
+
+// Function called by saveGathered() to get the data that follows at offset in the file. Returns a pointer to
+// partSize bytes, with 0 < partSize <= maxPartSize.
+typedef const unsigned char* (*GetPartToSaveFunction)(void* context, unsigned long long offset, unsigned long long maxPartSize, unsigned long long& partSize);
+
+// Save file of totalSize bytes whose data is provided by getPart in consecutive parts, for writing data that isn't
+// stored in one buffer. Returns number of bytes written or -1 on error.
+static long long saveGathered(const CHAR16* fileName, unsigned long long totalSize, GetPartToSaveFunction getPart, void* context, const CHAR16* directory = NULL)
 {
 #ifdef NO_UEFI
     if (directory)
@@ -326,10 +432,18 @@ static long long save(const CHAR16* fileName, unsigned long long totalSize, cons
         wprintf(L"Error opening file %s!\n", fileName);
         return -1;
     }
-    if (fwrite(buffer, 1, totalSize, file) != totalSize)
+    unsigned long long writtenSize = 0;
+    while (writtenSize < totalSize)
     {
-        wprintf(L"Error writting %llu bytes from %s!\n", totalSize, fileName);
-        return -1;
+        unsigned long long partSize = 0;
+        const unsigned char* part = getPart(context, writtenSize, totalSize - writtenSize, partSize);
+        if (!partSize || partSize > totalSize - writtenSize || fwrite(part, 1, partSize, file) != partSize)
+        {
+            wprintf(L"Error writting %llu bytes from %s!\n", totalSize, fileName);
+            fclose(file);
+            return -1;
+        }
+        writtenSize += partSize;
     }
     fclose(file);
     return totalSize;
@@ -380,10 +494,23 @@ static long long save(const CHAR16* fileName, unsigned long long totalSize, cons
         unsigned long long writtenSize = 0;
         while (writtenSize < totalSize)
         {
-            unsigned long long size = (WRITING_CHUNK_SIZE <= (totalSize - writtenSize) ? WRITING_CHUNK_SIZE : (totalSize - writtenSize));
-            status = file->Write(file, &size, (void*)&buffer[writtenSize]);
-            if (status
-                || size != (WRITING_CHUNK_SIZE <= (totalSize - writtenSize) ? WRITING_CHUNK_SIZE : (totalSize - writtenSize)))
+            unsigned long long requestedSize = 0;
+            const unsigned char* part = getPart(context, writtenSize, (fileWriteChunkSize <= (totalSize - writtenSize) ? fileWriteChunkSize : (totalSize - writtenSize)), requestedSize);
+            if (!requestedSize)
+            {
+                logToConsole(L"saveGathered(): no data to write");
+                file->Close(file);
+                return -1;
+            }
+            unsigned long long size = requestedSize;
+            status = file->Write(file, &size, (void*)part);
+            if ((status || size != requestedSize) && reduceFileIOChunkSize(fileWriteChunkSize, requestedSize, WRITING_CHUNK_SIZE)
+                && file->SetPosition(file, writtenSize) == EFI_SUCCESS)
+            {
+                // Retry with smaller chunk
+                continue;
+            }
+            if (status || size != requestedSize)
             {
                 // If this error occurs, see the definition of WRITING_CHUNK_SIZE above.
                 logStatusToConsole(L"EFI_FILE_PROTOCOL.Write() fails", status, __LINE__);
@@ -402,6 +529,17 @@ static long long save(const CHAR16* fileName, unsigned long long totalSize, cons
 #endif
 }
 
+static const unsigned char* getPartOfBufferToSave(void* context, unsigned long long offset, unsigned long long maxPartSize, unsigned long long& partSize)
+{
+    partSize = maxPartSize;
+    return (const unsigned char*)context + offset;
+}
+
+static long long save(const CHAR16* fileName, unsigned long long totalSize, const unsigned char* buffer, const CHAR16* directory = NULL)
+{
+    return saveGathered(fileName, totalSize, getPartOfBufferToSave, (void*)buffer, directory);
+}
+
 OPTIMIZE_OFF()
 
 struct FileItem
@@ -424,6 +562,9 @@ struct FileItem
     char mState;
     unsigned long long mReservedSize;
     long long mAge;
+    long long mLoadResult; // result of load
+    volatile long long* mpLoadResult; // also set to result of load if not NULL (non-blocking load)
+    bool mAllowShorterFile; // load with loadUpTo()
 
     void set(const CHAR16* fileName, unsigned long long fileSize, const CHAR16* directory)
     {
@@ -441,6 +582,17 @@ struct FileItem
     {
         ATOMIC_STORE8(mState, val);
     }
+
+    // Report result of load to the requester
+    void setLoadResult(long long sts)
+    {
+        mLoadResult = sts;
+        if (mpLoadResult)
+        {
+            ATOMIC_STORE64(*mpLoadResult, sts);
+            mpLoadResult = NULL;
+        }
+    }
     // Check if a slot is occupied
     bool waitForProcess()
     {
@@ -548,12 +700,14 @@ template<int maxItems>
 class FileItemStorage
 {
 public:
-    void initializeQueue(unsigned char* pWriteBuffer)
+    void initializeQueue()
     {
         for (int i = 0; i < maxItems; i++)
         {
             mFileItems[i].mpBuffer = NULL;
             mFileItems[i].mpConstBuffer = NULL;
+            mFileItems[i].mpLoadResult = NULL;
+            mFileItems[i].mAllowShorterFile = false;
         }
         mCurrentIdx = 0;
 
@@ -565,18 +719,19 @@ public:
             mFileItems[i].mHaveDirectory = false;
             mFileItems[i].mAge = 0;
         }
+    }
 
-        // If external buffer is provided, allow schedule write file later
-        if (pWriteBuffer != NULL)
+    // Check if there are items waiting for being processed
+    bool hasWaitingItems()
+    {
+        for (int i = 0; i < maxItems; i++)
         {
-            unsigned char* pBuffer = pWriteBuffer;
-            constexpr unsigned long long itemSize = ASYNC_FILE_IO_WRITE_QUEUE_BUFFER_SIZE / maxItems;
-            for (int i = 0; i < maxItems; i++, pBuffer += itemSize)
+            if (mFileItems[i].waitForProcess())
             {
-                mFileItems[i].mReservedSize = itemSize;
-                mFileItems[i].mpBuffer = pBuffer;
+                return true;
             }
         }
+        return false;
     }
 
     FileItem* requestFreeSlot(unsigned long long requestedSize)
@@ -588,6 +743,8 @@ public:
             {
                 mFileItems[index].mState = FileItem::kFillingData;
                 mFileItems[index].mSize = requestedSize;
+                mFileItems[index].mpLoadResult = NULL;
+                mFileItems[index].mAllowShorterFile = false;
                 return &mFileItems[index];
             }
         }
@@ -637,7 +794,9 @@ protected:
                 }
                 else
                 {
-                    sts = load(item.mFileName, item.mSize, item.mpBuffer, item.mHaveDirectory ? item.mDirectory : NULL);
+                    sts = loadAndProcess(item.mFileName, item.mSize, item.mpBuffer, item.mHaveDirectory ? item.mDirectory : NULL,
+                        NULL, NULL, 0, item.mAllowShorterFile);
+                    item.setLoadResult(sts);
                 }
                 item.markAsDone();
             }
@@ -683,7 +842,9 @@ protected:
             }
             else
             {
-                sts = load(item.mFileName, item.mSize, item.mpBuffer, item.mHaveDirectory ? item.mDirectory : NULL);
+                sts = loadAndProcess(item.mFileName, item.mSize, item.mpBuffer, item.mHaveDirectory ? item.mDirectory : NULL,
+                    NULL, NULL, 0, item.mAllowShorterFile);
+                item.setLoadResult(sts);
             }
             item.markAsDone();
         }
@@ -728,6 +889,138 @@ public:
     }
 };
 
+// Bounded FIFO queue of non-blocking saves (write-behind). The data is copied into a ring buffer, so the caller can
+// reuse its buffer immediately. Items are written in the order they have been enqueued, so the last save of a file
+// always wins. If there is no space for the data or no free item, enqueue() fails and the caller has to fall back
+// to a blocking save (backpressure).
+template<int maxItems>
+class WriteBehindQueue
+{
+    static_assert((maxItems & (maxItems - 1)) == 0, "WriteBehindQueue maxItems has to be 2^N");
+public:
+    void initializeQueue(unsigned char* pBuffer, unsigned long long bufferSize)
+    {
+        mpBuffer = pBuffer;
+        mBufferSize = bufferSize;
+        mBufferWritePos = 0;
+        mBufferReadPos = 0;
+        mItemHead = 0;
+        mItemTail = 0;
+        mLock = 0;
+        mFailedWriteCount = 0;
+        for (int i = 0; i < maxItems; i++)
+        {
+            mFileItems[i].mState = FileItem::kFree;
+            mFileItems[i].mAge = 0;
+        }
+    }
+
+    // Copy data into queue. Can be called from any thread. Returns false if the queue is full.
+    bool enqueue(const CHAR16* fileName, unsigned long long totalSize, const unsigned char* buffer, const CHAR16* directory)
+    {
+        if (totalSize > mBufferSize)
+        {
+            return false;
+        }
+
+        ACQUIRE(mLock);
+        if (mItemHead - mItemTail >= maxItems)
+        {
+            RELEASE(mLock);
+            return false;
+        }
+
+        // Data of one item is contiguous, skip the end of the ring buffer if it doesn't fit
+        unsigned long long dataPos = mBufferWritePos;
+        const unsigned long long offset = dataPos % mBufferSize;
+        if (offset + totalSize > mBufferSize)
+        {
+            dataPos += mBufferSize - offset;
+        }
+        if (dataPos + totalSize - mBufferReadPos > mBufferSize)
+        {
+            RELEASE(mLock);
+            return false;
+        }
+        mBufferWritePos = dataPos + totalSize;
+
+        FileItem& item = mFileItems[mItemHead & (maxItems - 1)];
+        mItemEndPos[mItemHead & (maxItems - 1)] = mBufferWritePos;
+        item.setState(FileItem::kFillingData);
+        mItemHead++;
+        RELEASE(mLock);
+
+        // Copying is done without holding the lock. The item is only written after it is marked as waiting.
+        item.set(fileName, totalSize, directory);
+        item.mpBuffer = mpBuffer + (dataPos % mBufferSize);
+        copyMem(item.mpBuffer, buffer, totalSize);
+        item.mpConstBuffer = item.mpBuffer;
+        item.setState(FileItem::kWait);
+        return true;
+    }
+
+    // Write items in the order of enqueuing. Expected to be called in main thread only. Stops at the first item that
+    // is still being filled with data. Writes all items if numberOfProcessedItems is 0. Returns number of remaining
+    // items.
+    int flushWrite(int numberOfProcessedItems = 0)
+    {
+        ASSERT(isMainProcessor());
+        int processedItemsCount = 0;
+        while (mItemTail != mItemHead && (numberOfProcessedItems <= 0 || processedItemsCount < numberOfProcessedItems))
+        {
+            FileItem& item = mFileItems[mItemTail & (maxItems - 1)];
+            char state;
+            ATOMIC_STORE8(state, item.mState);
+            if (state != FileItem::kWait)
+            {
+                break;
+            }
+            const long long sts = save(item.mFileName, item.mSize, item.mpConstBuffer, item.mHaveDirectory ? item.mDirectory : NULL);
+            if (sts != (long long)item.mSize)
+            {
+                ATOMIC_INC64(mFailedWriteCount);
+            }
+            item.setState(FileItem::kFree);
+
+            ACQUIRE(mLock);
+            mBufferReadPos = mItemEndPos[mItemTail & (maxItems - 1)];
+            mItemTail++;
+            RELEASE(mLock);
+            processedItemsCount++;
+        }
+        return (int)(mItemHead - mItemTail);
+    }
+
+    // Check if all enqueued items have been written
+    bool isEmpty() const
+    {
+        return mItemHead == mItemTail;
+    }
+
+    // Number of writes that failed (for health monitoring)
+    long long getFailedWriteCount() const
+    {
+        return mFailedWriteCount;
+    }
+
+protected:
+    FileItem mFileItems[maxItems];
+    unsigned long long mItemEndPos[maxItems];
+    unsigned char* mpBuffer;
+    unsigned long long mBufferSize;
+
+    // Positions in ring buffer, growing monotonically (offset is position modulo buffer size)
+    unsigned long long mBufferWritePos;
+    unsigned long long mBufferReadPos;
+
+    // Items [mItemTail, mItemHead) are enqueued (index is position modulo maxItems)
+    volatile unsigned long long mItemHead;
+    volatile unsigned long long mItemTail;
+
+    volatile char mLock;
+    long long mFailedWriteCount;
+};
+
 class AsyncFileIO
 {
 public:
@@ -739,7 +1032,8 @@ public:
         kBufferFull = -3,
         kUnsupported = -4,
         kTimeOut = -5,
-        kStop = -6
+        kStop = -6,
+        kPending = -7
     };
 
     bool init(EFI_MP_SERVICES_PROTOCOL* pMPServices, unsigned long long totalWriteSize)
@@ -768,8 +1062,8 @@ public:
             }
         }
 #endif
-        mFileBlockingReadQueue.initializeQueue(NULL);
-        mFileBlockingWriteQueue.initializeQueue(NULL);
+        mFileBlockingReadQueue.initializeQueue();
+        mFileBlockingWriteQueue.initializeQueue();
         mEnableNonBlockSave = false;
         mIsStop = false;
 
@@ -783,8 +1077,8 @@ public:
                 return false;
             }
 
-            mFileWriteQueue.initializeQueue(mpSaveBuffer);
-            setMem(mpSaveBuffer, totalWriteSize, 0);
+            // no need to clear the ring buffer, data is always written before it is read
+            mFileWriteQueue.initializeQueue(mpSaveBuffer, totalWriteSize);
             mEnableNonBlockSave = true;
         }
 
@@ -793,6 +1087,9 @@ public:
         mRemoveFilePathQueueCount = 0;
         mRemoveFilePathQueueLock = 0;
 
+        mBackgroundRemoveQueueHead = 0;
+        mBackgroundRemoveQueueCount = 0;
+        mBackgroundRemoveQueueLock = 0;
 
         setMem(mCreateDirQueue, sizeof(mCreateDirQueue), 0);
         mCreateDirQueueCount = 0;
@@ -808,9 +1105,11 @@ public:
 
         // Flush all remained tasks
         flush();
-        if (mpSaveBuffer == NULL)
+        if (mpSaveBuffer != NULL)
         {
             freePool(mpSaveBuffer);
+            mpSaveBuffer = NULL;
+            mEnableNonBlockSave = false;
         }
     }
 
@@ -846,22 +1145,11 @@ public:
             return kUnsupported;
         }
 
-        FileItem* pFileItem = mFileWriteQueue.requestFreeSlot(totalSize);
-        if (pFileItem == NULL)
+        // Non-blocking. Copy data and the write operation happend later
+        if (!mFileWriteQueue.enqueue(fileName, totalSize, buffer, directory))
         {
             return kQueueFull;
         }
-
-        if (pFileItem->mReservedSize < totalSize)
-        {
-            return kBufferFull;
-        }
-
-        // Non-blocking. Copy data and the write operation happend later
-        pFileItem->set(fileName, totalSize, directory);
-        copyMem(pFileItem->mpBuffer, buffer, totalSize);
-        pFileItem->mpConstBuffer = pFileItem->mpBuffer;
-        pFileItem->mState = FileItem::kWait;
         return (long long)totalSize;
     }
 
@@ -884,9 +1172,10 @@ public:
         pFileItem->mpConstBuffer = buffer;
         pFileItem->mState = FileItem::kBlockingWait;
 
-        // Mainthread. Flush the save queue immediately
+        // Mainthread. Flush the save queue immediately (after older non-blocking saves to keep order of saves)
         if (isMainThread())
         {
+            flushNonBlockingSaves();
             mFileBlockingWriteQueue.flushWrite();
             return (long long)totalSize;
         }
@@ -900,8 +1189,10 @@ public:
         return (long long)totalSize;
     }
 
-    // Function to schedule load. Buffer will be filled data, make sure the buffer is untouched until this function done
-    long long asyncLoad(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory = NULL)
+    // Function to schedule load. Buffer will be filled data, make sure the buffer is untouched until this function done.
+    // Returns result of load() (or of loadUpTo() if allowShorterFile is true).
+    long long asyncLoad(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory = NULL,
+        bool allowShorterFile = false)
     {
         // Stop already. Don't process further
         if (mIsStop)
@@ -921,13 +1212,18 @@ public:
         // Get the buffer. Load operation will be execute later in main thread
         pFileItem->set(fileName, totalSize, directory);
         pFileItem->mpBuffer = buffer;
+        pFileItem->mLoadResult = kStop;
+        pFileItem->mAllowShorterFile = allowShorterFile;
         pFileItem->mState = FileItem::kBlockingWait;
 
-        // In case of main thread. Read immediately.
+        // In case of main thread. Read immediately (after pending non-blocking saves, which may write this file).
         if (mainThread)
         {
+            flushNonBlockingSaves();
             mFileBlockingReadQueue.flushRead();
-            return (long long)totalSize;
+            const long long result = pFileItem->mLoadResult;
+            pFileItem->mState = FileItem::kFree;
+            return result;
         }
 
         // Wait for data is processed
@@ -935,10 +1231,57 @@ public:
         {
             sleep(1000);
         }
+        const long long result = pFileItem->isProcessed() ? pFileItem->mLoadResult : kStop;
         pFileItem->mState = FileItem::kFree;
+        return result;
+    }
+
+    // Function to schedule load without waiting for it (for example read-ahead). The buffer will be filled when the
+    // load is processed in main thread, make sure it is untouched until then. *pResult is kPending until the load
+    // has been processed and the result of load() (or loadUpTo() if allowShorterFile) afterwards. Use waitForLoad()
+    // to wait for the load.
+    long long asyncLoadNonBlocking(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory,
+        volatile long long* pResult, bool allowShorterFile = false)
+    {
+        if (mIsStop)
+        {
+            return kStop;
+        }
+
+        FileItem* pFileItem = mFileBlockingReadQueue.requestFreeSlot(totalSize);
+        if (pFileItem == NULL)
+        {
+            return kBufferFull;
+        }
+
+        *pResult = kPending;
+        pFileItem->set(fileName, totalSize, directory);
+        pFileItem->mpBuffer = buffer;
+        pFileItem->mpLoadResult = pResult;
+        pFileItem->mAllowShorterFile = allowShorterFile;
+        pFileItem->setState(FileItem::kWait);
         return (long long)totalSize;
     }
 
+    // Wait until non-blocking load with given result pointer has been processed (or file IO is stopped)
+    void waitForLoad(volatile long long* pResult)
+    {
+        if (*pResult != kPending)
+        {
+            return;
+        }
+        if (isMainThread())
+        {
+            flushNonBlockingSaves();
+            mFileBlockingReadQueue.flushRead();
+            return;
+        }
+        while (*pResult == kPending && !mIsStop)
+        {
+            sleep(1000);
+        }
+    }
+
     void flushRem()
     {
         ACQUIRE(mRemoveFilePathQueueLock);
@@ -955,6 +1298,27 @@ public:
         RELEASE(mRemoveFilePathQueueLock);
     }
 
+    // Remove up to maxItems files of the background removal queue
+    void flushBackgroundRem(int maxItems)
+    {
+        for (int i = 0; i < maxItems; i++)
+        {
+            BackgroundRemoveItem item;
+            ACQUIRE(mBackgroundRemoveQueueLock);
+            if (!mBackgroundRemoveQueueCount)
+            {
+                RELEASE(mBackgroundRemoveQueueLock);
+                break;
+            }
+            copyMem(&item, &mBackgroundRemoveQueue[mBackgroundRemoveQueueHead], sizeof(item));
+            mBackgroundRemoveQueueHead = (mBackgroundRemoveQueueHead + 1) % ASYNC_FILE_IO_BACKGROUND_REMOVE_QUEUE_ITEMS;
+            mBackgroundRemoveQueueCount--;
+            RELEASE(mBackgroundRemoveQueueLock);
+
+            removeFile(item.mHaveDirectory ? item.mDirectory : NULL, item.mFileName);
+        }
+    }
+
     void flushCreateDir()
     {
         ACQUIRE(mCreateDirQueueLock);
@@ -997,6 +1361,44 @@ public:
         }
     }
 
+    // Queue removal of file without waiting. Removals are done in the following flushes, at most
+    // ASYNC_FILE_IO_BACKGROUND_REMOVES_PER_FLUSH per flush, so removing many files doesn't stall the main loop.
+    // Returns kQueueFull if the queue is full and kUnsupported if the names are too long.
+    long long asyncRemBackground(const CHAR16* directory, const CHAR16* fileName)
+    {
+        if (mIsStop)
+        {
+            return kStop;
+        }
+        if (stringLength(fileName) >= ASYNC_FILE_IO_MAX_FILE_NAME || (directory && stringLength(directory) >= ASYNC_FILE_IO_MAX_FILE_NAME))
+        {
+            return kUnsupported;
+        }
+
+        ACQUIRE(mBackgroundRemoveQueueLock);
+        if (mBackgroundRemoveQueueCount == ASYNC_FILE_IO_BACKGROUND_REMOVE_QUEUE_ITEMS)
+        {
+            RELEASE(mBackgroundRemoveQueueLock);
+            return kQueueFull;
+        }
+        BackgroundRemoveItem& item = mBackgroundRemoveQueue[(mBackgroundRemoveQueueHead + mBackgroundRemoveQueueCount) % ASYNC_FILE_IO_BACKGROUND_REMOVE_QUEUE_ITEMS];
+        setText(item.mFileName, fileName);
+        item.mHaveDirectory = (directory != NULL);
+        if (directory)
+        {
+            setText(item.mDirectory, directory);
+        }
+        mBackgroundRemoveQueueCount++;
+        RELEASE(mBackgroundRemoveQueueLock);
+        return kNoError;
+    }
+
+    // Number of files waiting for removal in background
+    int getBackgroundRemoveQueueCount() const
+    {
+        return mBackgroundRemoveQueueCount;
+    }
+
     void asyncCreateDir(const CHAR16* directory)
     {
         if (mIsStop)
@@ -1027,17 +1429,56 @@ public:
     int flush(int numberOfItemsPerQueue = 0)
     {
         int remainedItems = 0;
-        remainedItems = remainedItems + mFileBlockingReadQueue.flushRead(numberOfItemsPerQueue);
-        remainedItems = remainedItems + mFileBlockingWriteQueue.flushWrite(numberOfItemsPerQueue);
+
+        // Non-blocking saves are written first, because later blocking saves or loads may access the same files.
+        // All of them are written before processing loads, so files are never read before pending saves are done.
         if (mEnableNonBlockSave)
         {
-            remainedItems = remainedItems + mFileWriteQueue.flushWrite(numberOfItemsPerQueue);
+            const bool loadsWaiting = mFileBlockingReadQueue.hasWaitingItems();
+            remainedItems = remainedItems + mFileWriteQueue.flushWrite(loadsWaiting ? 0 : numberOfItemsPerQueue);
         }
+        remainedItems = remainedItems + mFileBlockingWriteQueue.flushWrite(numberOfItemsPerQueue);
+        remainedItems = remainedItems + mFileBlockingReadQueue.flushRead(numberOfItemsPerQueue);
         flushRem();
+        flushBackgroundRem(mIsStop ? ASYNC_FILE_IO_BACKGROUND_REMOVE_QUEUE_ITEMS : ASYNC_FILE_IO_BACKGROUND_REMOVES_PER_FLUSH);
         flushCreateDir();
         return remainedItems;
     }
 
+    // Write all pending non-blocking saves (barrier). Expected to be called in main thread only. Non-blocking saves
+    // enqueued concurrently while flushing may also be written.
+    void flushNonBlockingSaves()
+    {
+        if (mEnableNonBlockSave)
+        {
+            mFileWriteQueue.flushWrite();
+        }
+    }
+
+    // Wait until all non-blocking saves enqueued before have been written. Can be called from any thread.
+    void waitForNonBlockingSaves()
+    {
+        if (!mEnableNonBlockSave)
+        {
+            return;
+        }
+        if (isMainThread())
+        {
+            flushNonBlockingSaves();
+            return;
+        }
+        while (!mFileWriteQueue.isEmpty() && !mIsStop)
+        {
+            sleep(1000);
+        }
+    }
+
+    // Number of non-blocking saves that failed
+    long long getFailedNonBlockingSaveCount() const
+    {
+        return (mEnableNonBlockSave) ? mFileWriteQueue.getFailedWriteCount() : 0;
+    }
+
 private:
     EFI_MP_SERVICES_PROTOCOL* mpFileSystemMPServices;
     unsigned int mBSProcID;
@@ -1049,7 +1490,7 @@ private:
     bool mIsStop;
 
     // File queue
-    SaveFileItemStorage<ASYNC_FILE_IO_MAX_QUEUE_ITEMS> mFileWriteQueue;
+    WriteBehindQueue<ASYNC_FILE_IO_MAX_QUEUE_ITEMS> mFileWriteQueue;
     SaveFileItemStorage<ASYNC_FILE_IO_BLOCKING_MAX_QUEUE_ITEMS> mFileBlockingWriteQueue;
     LoadFileItemStorage<ASYNC_FILE_IO_BLOCKING_MAX_QUEUE_ITEMS> mFileBlockingReadQueue;
 
@@ -1059,6 +1500,18 @@ private:
     int mRemoveFilePathQueueCount;
     volatile char mRemoveFilePathQueueLock;
 
+    // Background remove queue: ring buffer of files to remove without blocking the caller (such as pruning of pages)
+    struct BackgroundRemoveItem
+    {
+        CHAR16 mFileName[ASYNC_FILE_IO_MAX_FILE_NAME];
+        CHAR16 mDirectory[ASYNC_FILE_IO_MAX_FILE_NAME];
+        bool mHaveDirectory;
+    };
+    BackgroundRemoveItem mBackgroundRemoveQueue[ASYNC_FILE_IO_BACKGROUND_REMOVE_QUEUE_ITEMS];
+    int mBackgroundRemoveQueueHead;
+    volatile int mBackgroundRemoveQueueCount;
+    volatile char mBackgroundRemoveQueueLock;
+
     // Create directory queue: rare operation, only need a simple queue
     CHAR16 mCreateDirQueue[1024][1024];
     int mCreateDirQueueCount;
@@ -1075,14 +1528,16 @@ static long long asyncSave(const CHAR16* fileName, unsigned long long totalSize,
 {
     if (gAsyncFileIO)
     {
-        if (blocking)
-        {
-            return gAsyncFileIO->asyncBlockingSave(fileName, totalSize, buffer, directory);
-        }
-        else
+        if (!blocking)
         {
-            return gAsyncFileIO->asyncSave(fileName, totalSize, buffer, directory);
+            const long long sts = gAsyncFileIO->asyncSave(fileName, totalSize, buffer, directory);
+            if (sts != AsyncFileIO::kQueueFull && sts != AsyncFileIO::kUnsupported)
+            {
+                return sts;
+            }
+            // Write-behind queue full or disabled -> fall back to blocking save
         }
+        return gAsyncFileIO->asyncBlockingSave(fileName, totalSize, buffer, directory);
     }
 
     return (long long)AsyncFileIO::kUnknown;
@@ -1091,15 +1546,40 @@ static long long asyncSave(const CHAR16* fileName, unsigned long long totalSize,
 // Asynchorous load a file
 // This function can be called from any thread and is a blocking function
 // To avoid lock and the actual load happen, flushAsyncFileIOBuffer must be called in main thread
-static long long asyncLoad(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory = NULL)
+// If allowShorterFile is true, files smaller than totalSize can be loaded (see loadUpTo()).
+static long long asyncLoad(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory = NULL,
+    bool allowShorterFile = false)
 {
     if (gAsyncFileIO)
     {
-        return gAsyncFileIO->asyncLoad(fileName, totalSize, buffer, directory);
+        return gAsyncFileIO->asyncLoad(fileName, totalSize, buffer, directory, allowShorterFile);
     }
     return 0;
 }
 
+// Asynchorous load a file without waiting (for example read-ahead)
+// This function can be called from any thread. It returns false if the load cannot be scheduled. Otherwise *pResult
+// is AsyncFileIO::kPending until the load has been processed in main thread, and the result of load() afterwards. The
+// buffer must not be touched until then. Use waitForAsyncLoad() to wait for the load.
+static bool asyncLoadNonBlocking(const CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, const CHAR16* directory,
+    volatile long long* pResult, bool allowShorterFile = false)
+{
+    if (gAsyncFileIO)
+    {
+        return gAsyncFileIO->asyncLoadNonBlocking(fileName, totalSize, buffer, directory, pResult, allowShorterFile) == (long long)totalSize;
+    }
+    return false;
+}
+
+// Wait for load scheduled with asyncLoadNonBlocking(). Can be called from any thread.
+static void waitForAsyncLoad(volatile long long* pResult)
+{
+    if (gAsyncFileIO)
+    {
+        gAsyncFileIO->waitForLoad(pResult);
+    }
+}
+
 // Asynchorous remove a file
 // This function can be called from any thread and is a blocking function
 // To avoid lock and the actual remove happen, flushAsyncFileIOBuffer must be called in main thread
@@ -1122,6 +1602,28 @@ static long long asyncRemoveFile(CHAR16* fileName, CHAR16* directory = NULL)
     return -1;
 }
 
+// Remove a file in background
+// This function can be called from any thread and returns immediately, the file is removed in one of the next calls
+// of flushAsyncFileIOBuffer in main thread. Returns 0 if the removal is queued (or done), -1 on error (such as queue
+// full).
+static long long asyncRemoveFileInBackground(const CHAR16* fileName, const CHAR16* directory = NULL)
+{
+    if (!fileName)
+    {
+        return -1;
+    }
+    if (gAsyncFileIO)
+    {
+        return (gAsyncFileIO->asyncRemBackground(directory, fileName) == AsyncFileIO::kNoError) ? 0 : -1;
+    }
+    // the only case that gAsyncFileIO == NULL is when main thread initializing => can run rem file directly
+    else if (removeFile((CHAR16*)directory, (CHAR16*)fileName))
+    {
+        return 0;
+    }
+    return -1;
+}
+
 // Asynchorous create a dir if it doesn't exist
 // This function can be called from any thread and is a blocking function
 static long long asyncCreateDir(const CHAR16* directory)
@@ -1285,6 +1787,16 @@ static int flushAsyncFileIOBuffer(int numberOfItemsPerQueue = 0)
     }
     return 0;
 }
+
+// Wait until all non-blocking saves that have been scheduled before are written to disk (write barrier), for
+// example before marking a snapshot as valid. Can be called from any thread.
+static void waitForAsyncFileIONonBlockingSaves()
+{
+    if (gAsyncFileIO)
+    {
+        gAsyncFileIO->waitForNonBlockingSaves();
+    }
+}
 OPTIMIZE_ON()
 
 // add epoch number as an extension to a filename
@@ -1303,15 +1815,29 @@ static unsigned int getTextSize(CHAR16* text, int maximumSize)
     return result;
 }
 
-// Break the large file to many chunks to write if the size is greater or equal FILE_CHUNK_SIZE
-// - skipWriteEqualChunkSize: skip write the chunk file if the size of existed file match with buffer data. Set false if need the write always happens
-static long long saveLargeFile(CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, CHAR16* directory = NULL, bool skipWriteEqualChunkSize = true)
+// Context of saveLargeFileGathered() for passing the offset in the large file to getPart
+struct LargeFileGatheredPart
+{
+    GetPartToSaveFunction getPart;
+    void* context;
+    unsigned long long chunkOffset;
+};
+
+static const unsigned char* getPartOfLargeFileToSave(void* context, unsigned long long offset, unsigned long long maxPartSize, unsigned long long& partSize)
+{
+    const LargeFileGatheredPart* part = (const LargeFileGatheredPart*)context;
+    return part->getPart(part->context, part->chunkOffset + offset, maxPartSize, partSize);
+}
+
+// Same as saveLargeFile(), but the data is provided by getPart in consecutive parts (see saveGathered())
+static long long saveLargeFileGathered(CHAR16* fileName, unsigned long long totalSize, GetPartToSaveFunction getPart, void* context, CHAR16* directory = NULL, bool skipWriteEqualChunkSize = true)
 {
     const unsigned long long maxWriteSizePerChunk = FILE_CHUNK_SIZE;
     if (totalSize < maxWriteSizePerChunk)
     {
-        return save(fileName, totalSize, buffer, directory);
+        return saveGathered(fileName, totalSize, getPart, context, directory);
     }
+    LargeFileGatheredPart part{ getPart, context, 0 };
     int chunkId = 0;
     unsigned long long totalWriteSize = 0;
     while (totalSize)
@@ -1323,13 +1849,13 @@ static long long saveLargeFile(CHAR16* fileName, unsigned long long totalSize, u
         const unsigned long long writeSize = maxWriteSizePerChunk < totalSize ? maxWriteSizePerChunk : totalSize;
         if (!skipWriteEqualChunkSize || (getFileSize(fileNameWithChunkId, directory) != writeSize))
         {
-            unsigned long long res = save(fileNameWithChunkId, writeSize, buffer, directory);
+            part.chunkOffset = totalWriteSize;
+            unsigned long long res = saveGathered(fileNameWithChunkId, writeSize, getPartOfLargeFileToSave, &part, directory);
             if (res != writeSize)
             {
                 return totalWriteSize;
             }
         }
-        buffer += writeSize;
         totalWriteSize += writeSize;
         totalSize -= writeSize;
         chunkId++;
@@ -1337,6 +1863,13 @@ static long long saveLargeFile(CHAR16* fileName, unsigned long long totalSize, u
     return totalWriteSize;
 }
 
+// Break the large file to many chunks to write if the size is greater or equal FILE_CHUNK_SIZE
+// - skipWriteEqualChunkSize: skip write the chunk file if the size of existed file match with buffer data. Set false if need the write always happens
+static long long saveLargeFile(CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, CHAR16* directory = NULL, bool skipWriteEqualChunkSize = true)
+{
+    return saveLargeFileGathered(fileName, totalSize, getPartOfBufferToSave, buffer, directory, skipWriteEqualChunkSize);
+}
+
 static long long loadLargeFile(CHAR16* fileName, unsigned long long totalSize, unsigned char* buffer, CHAR16* directory = NULL)
 {
     const unsigned long long maxReadSizePerChunk = FILE_CHUNK_SIZE;
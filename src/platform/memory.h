@@ -1,5 +1,147 @@
 #pragma once
 
+#include <lib/platform_common/qintrin.h>
+
+#include "common_types.h"
+#include "concurrency.h"
+#include "global_var.h"
+
+// Registry of memory allocated with allocPoolWithErrorLog() and allocLargeWithErrorLog() (see memory_util.h) for
+// reporting the memory footprint per subsystem. The subsystem is the part of the allocation name before "::" or "."
+// (for example "PendingTxsPool" for "PendingTxsPool::txsPriorities") or the whole name. Allocations are tracked by
+// address, so freeing with freePool() or freeLarge() reduces the live size of the subsystem.
+class MemoryRegistry
+{
+public:
+    static constexpr unsigned int maxSubsystems = 96;
+    static constexpr unsigned int maxLiveAllocations = 1024;
+
+    struct Subsystem
+    {
+        char name[32]; // zero-terminated
+        unsigned long long requestedBytes; // size of live allocations as requested by the subsystem
+        unsigned long long committedBytes; // memory reserved for live allocations (large ones are rounded up to 2 MB)
+        unsigned long long peakCommittedBytes;
+        unsigned int allocationCount; // number of live allocations
+        unsigned int totalAllocationCount; // number of allocations since start, including freed ones
+    };
+
+    // Record allocation of buffer. Allocations that don't fit into the registry are only counted as untracked.
+    void add(const CHAR16* name, const void* buffer, unsigned long long requestedBytes, unsigned long long committedBytes)
+    {
+        ACQUIRE_WITHOUT_DEBUG_LOGGING(lock);
+        const unsigned int subsystemIndex = findOrAddSubsystem(name);
+        if (subsystemIndex == maxSubsystems || liveAllocationCount == maxLiveAllocations)
+        {
+            untrackedAllocationCount++;
+        }
+        else
+        {
+            Subsystem& subsystem = subsystems[subsystemIndex];
+            subsystem.requestedBytes += requestedBytes;
+            subsystem.committedBytes += committedBytes;
+            if (subsystem.peakCommittedBytes < subsystem.committedBytes)
+                subsystem.peakCommittedBytes = subsystem.committedBytes;
+            subsystem.allocationCount++;
+            subsystem.totalAllocationCount++;
+
+            LiveAllocation& allocation = liveAllocations[liveAllocationCount++];
+            allocation.buffer = buffer;
+            allocation.requestedBytes = requestedBytes;
+            allocation.committedBytes = committedBytes;
+            allocation.subsystemIndex = subsystemIndex;
+        }
+        RELEASE(lock);
+    }
+
+    // Record that buffer has been freed. Buffers that aren't tracked are ignored.
+    void release(const void* buffer)
+    {
+        if (!buffer)
+            return;
+        ACQUIRE_WITHOUT_DEBUG_LOGGING(lock);
+        for (unsigned int i = 0; i < liveAllocationCount; i++)
+        {
+            if (liveAllocations[i].buffer == buffer)
+            {
+                Subsystem& subsystem = subsystems[liveAllocations[i].subsystemIndex];
+                subsystem.requestedBytes -= liveAllocations[i].requestedBytes;
+                subsystem.committedBytes -= liveAllocations[i].committedBytes;
+                subsystem.allocationCount--;
+                liveAllocations[i] = liveAllocations[--liveAllocationCount];
+                break;
+            }
+        }
+        RELEASE(lock);
+    }
+
+    // Copy up to maxCount subsystems (in order of first allocation) to output. Returns number of subsystems copied.
+    unsigned int getSubsystems(Subsystem* output, unsigned int maxCount)
+    {
+        ACQUIRE_WITHOUT_DEBUG_LOGGING(lock);
+        const unsigned int count = (subsystemCount < maxCount) ? subsystemCount : maxCount;
+        for (unsigned int i = 0; i < count; i++)
+            output[i] = subsystems[i];
+        RELEASE(lock);
+        return count;
+    }
+
+    // Return number of allocations that couldn't be tracked, because the registry was full
+    unsigned long long getUntrackedAllocationCount() const
+    {
+        return untrackedAllocationCount;
+    }
+
+private:
+    struct LiveAllocation
+    {
+        const void* buffer;
+        unsigned long long requestedBytes;
+        unsigned long long committedBytes;
+        unsigned int subsystemIndex;
+    };
+
+    // Return index of subsystem of the allocation name, adding a new subsystem if needed. Returns maxSubsystems if
+    // the subsystem is new and the registry is full. Lock must be held by caller.
+    unsigned int findOrAddSubsystem(const CHAR16* name)
+    {
+        char subsystemName[sizeof(Subsystem::name)];
+        unsigned int length = 0;
+        while (length < sizeof(subsystemName) - 1 && name[length] && name[length] != '.'
+            && !(name[length] == ':' && name[length + 1] == ':'))
+        {
+            subsystemName[length] = (char)name[length];
+            length++;
+        }
+        while (length && subsystemName[length - 1] == ' ')
+            length--;
+        subsystemName[length] = 0;
+
+        for (unsigned int i = 0; i < subsystemCount; i++)
+        {
+            unsigned int j = 0;
+            while (j < length && subsystems[i].name[j] == subsystemName[j])
+                j++;
+            if (j == length && !subsystems[i].name[j])
+                return i;
+        }
+        if (subsystemCount == maxSubsystems)
+            return maxSubsystems;
+        for (unsigned int j = 0; j <= length; j++)
+            subsystems[subsystemCount].name[j] = subsystemName[j];
+        return subsystemCount++;
+    }
+
+    Subsystem subsystems[maxSubsystems];
+    LiveAllocation liveAllocations[maxLiveAllocations];
+    unsigned int subsystemCount;
+    unsigned int liveAllocationCount;
+    unsigned long long untrackedAllocationCount;
+    volatile char lock; // not using ACQUIRE(), because low-level users of memory.h don't link BusyWaitingTracker
+};
+
+GLOBAL_VAR_DECL MemoryRegistry memoryRegistry;
+
 #ifdef NO_UEFI
 
 // Defined in test/stdlib_impl.cpp
@@ -16,14 +158,16 @@ void freePool(void* buffer);
 
 #include <lib/platform_efi/uefi_globals.h>
 
+#include "memory_vectorized.h"
+
 static inline void setMem(void* buffer, unsigned long long size, unsigned char value)
 {
-    bs->SetMem(buffer, size, value);
+    setMemVectorized(buffer, size, value);
 }
 
 static inline void copyMem(void* destination, const void* source, unsigned long long length)
 {
-    bs->CopyMem(destination, (void*)source, length);
+    copyMemVectorized(destination, source, length);
 }
 
 static inline bool allocatePool(unsigned long long size, void** buffer)
@@ -33,6 +177,7 @@ static inline bool allocatePool(unsigned long long size, void** buffer)
 
 static inline void freePool(void* buffer)
 {
+    memoryRegistry.release(buffer);
     bs->FreePool(buffer);
 }
 
@@ -150,27 +295,82 @@ unsigned long long GetLargestFreeConsecutiveMemory()
 }
 #endif
 
-// This should to be optimized if used in non-debugging context (using unsigned long long comparison as much as possible)
+// Check that all bytes are 0. Uses 256-bit loads for size >= 32 (single load for the common case of a 32-byte digest or
+// public key, 4 loads per iteration for large buffers) and 64-bit loads for smaller sizes.
 static inline bool isZero(const void* ptr, unsigned long long size)
 {
-    const char* cPtr = (const char*)ptr;
-    for (unsigned long long i = 0; i < size; ++i)
+    const unsigned char* p = (const unsigned char*)ptr;
+    const unsigned char* const end = p + size;
+    if (size >= 32)
+    {
+        for (; p + 128 <= end; p += 128)
+        {
+            const __m256i v = _mm256_or_si256(
+                _mm256_or_si256(_mm256_loadu_si256((const __m256i*)p), _mm256_loadu_si256((const __m256i*)(p + 32))),
+                _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(p + 64)), _mm256_loadu_si256((const __m256i*)(p + 96))));
+            if (!_mm256_testz_si256(v, v))
+                return false;
+        }
+        for (; p + 32 <= end; p += 32)
+        {
+            const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+            if (!_mm256_testz_si256(v, v))
+                return false;
+        }
+        if (p == end)
+            return true;
+        // remaining bytes: last 32 bytes overlapping with bytes checked before
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(end - 32));
+        return _mm256_testz_si256(v, v);
+    }
+    if (size >= 8)
     {
-        if (cPtr[i] != 0)
+        unsigned long long acc = *(const unsigned long long*)(end - 8);
+        for (; p + 8 <= end; p += 8)
+            acc |= *(const unsigned long long*)p;
+        return acc == 0;
+    }
+    for (; p < end; ++p)
+    {
+        if (*p != 0)
             return false;
     }
     return true;
 }
 
+// Compare memory byte by byte as char, returning -1, 0, or 1. Equal parts are skipped with 256-bit comparisons.
 static inline int compareMem(const void* p1, const void* p2, unsigned long long size)
 {
     const char* cPtr1 = (const char*)p1;
     const char* cPtr2 = (const char*)p2;
-    for (unsigned long long i = 0; i < size; ++i, ++cPtr1, ++cPtr2)
+    unsigned long long i = 0;
+    if (size >= 32)
+    {
+        unsigned int equalMask = 0xFFFFFFFFU;
+        for (; i + 32 <= size; i += 32)
+        {
+            equalMask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i*)(cPtr1 + i)), _mm256_loadu_si256((const __m256i*)(cPtr2 + i))));
+            if (equalMask != 0xFFFFFFFFU)
+                break;
+        }
+        if (equalMask == 0xFFFFFFFFU && i < size)
+        {
+            // remaining bytes: last 32 bytes overlapping with bytes compared before
+            i = size - 32;
+            equalMask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i*)(cPtr1 + i)), _mm256_loadu_si256((const __m256i*)(cPtr2 + i))));
+        }
+        if (equalMask == 0xFFFFFFFFU)
+            return 0;
+        i += _tzcnt_u32(~equalMask);
+        return (cPtr1[i] < cPtr2[i]) ? -1 : 1;
+    }
+    for (; i < size; ++i)
     {
-        if (*cPtr1 < *cPtr2)
+        if (cPtr1[i] < cPtr2[i])
             return -1;
-        else if (*cPtr1 > *cPtr2)
+        else if (cPtr1[i] > cPtr2[i])
             return 1;
     }
     return 0;
@@ -4,11 +4,35 @@
 #include <lib/platform_efi/uefi.h>
 #include "memory.h"
 
+// Large allocations: arrays of several MB or GB that are accessed randomly (spectrum, universe, contract states, tick
+// storage, ...) are allocated with allocLargeWithErrorLog(). The region is aligned to 2 MB (1 GB if the size is at
+// least 1 GB) and its size is rounded up to a multiple of 2 MB, so it can be mapped with large pages, which reduces
+// TLB misses. In the EFI build, the pages are allocated directly and the unaligned head and tail are given back. The
+// identity mapping of the firmware uses 2 MB / 1 GB pages wherever a region is aligned accordingly. In the NO_UEFI
+// build, transparent huge pages are requested with madvise() on Linux. Buffers smaller than largeAllocThreshold are
+// allocated with allocPoolWithErrorLog(). Memory is zeroed. It must be freed with freeLarge() with the same size.
+// Both functions record the allocation in memoryRegistry (see memory.h) under the subsystem derived from the name.
+
+static constexpr unsigned long long largePageSize = 2 * 1024 * 1024;
+static constexpr unsigned long long hugePageSize = 1024 * 1024 * 1024;
+static constexpr unsigned long long largeAllocThreshold = largePageSize;
+
+// Size of large allocation (rounded up to multiple of largePageSize)
+static inline unsigned long long largeAllocSize(unsigned long long size)
+{
+    return (size + largePageSize - 1) & ~(largePageSize - 1);
+}
+
 #ifdef NO_UEFI
 
 #include <cstdlib>
 #include <cstdbool>
 #include <cstdio>
+#ifdef _MSC_VER
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 static bool allocPoolWithErrorLog(const wchar_t* name, const unsigned long long size, void** buffer, const int LINE) 
 {
@@ -22,9 +46,54 @@ static bool allocPoolWithErrorLog(const wchar_t* name, const unsigned long long
     // Zero out allocated memory
     setMem(*buffer, size, 0);
 
+    memoryRegistry.add((const CHAR16*)name, *buffer, size, size);
     return true;
 }
 
+static bool allocLargeWithErrorLog(const wchar_t* name, const unsigned long long size, void** buffer, const int LINE)
+{
+    if (size < largeAllocThreshold)
+        return allocPoolWithErrorLog(name, size, buffer, LINE);
+
+    const unsigned long long allocSize = largeAllocSize(size);
+#ifdef _MSC_VER
+    *buffer = _aligned_malloc(allocSize, largePageSize);
+#else
+    if (posix_memalign(buffer, largePageSize, allocSize) != 0)
+        *buffer = nullptr;
+#endif
+    if (*buffer == nullptr)
+    {
+        printf("Memory allocation failed for %ls on line %u\n", name, LINE);
+        return false;
+    }
+#if !defined(_MSC_VER) && defined(__linux__) && defined(MADV_HUGEPAGE)
+    // hint only, fails if transparent huge pages are disabled
+    madvise(*buffer, allocSize, MADV_HUGEPAGE);
+#endif
+
+    // Zero out allocated memory
+    setMem(*buffer, size, 0);
+
+    memoryRegistry.add((const CHAR16*)name, *buffer, size, allocSize);
+    return true;
+}
+
+static void freeLarge(void* buffer, const unsigned long long size)
+{
+    memoryRegistry.release(buffer);
+    if (size < largeAllocThreshold)
+    {
+        freePool(buffer);
+        return;
+    }
+#ifdef _MSC_VER
+    _aligned_free(buffer);
+#else
+    free(buffer);
+#endif
+}
+
 #else
 
 static bool allocPoolWithErrorLog(const CHAR16* name, const unsigned long long size, void** buffer, const int LINE)
@@ -62,7 +131,72 @@ static bool allocPoolWithErrorLog(const CHAR16* name, const unsigned long long s
     if (*buffer != nullptr) {
         setMem(*buffer, size, 0);
     }
+    memoryRegistry.add(name, *buffer, size, size);
     return true;
 }
 
+// Allocate pageCount pages aligned to alignment (multiple of 4 KB) by allocating alignment - 4 KB more and freeing
+// the unaligned head and tail
+static EFI_STATUS allocateAlignedPages(unsigned long long pageCount, unsigned long long alignment, void** buffer)
+{
+    const unsigned long long alignmentPageCount = alignment / 4096;
+    EFI_PHYSICAL_ADDRESS base = 0;
+    EFI_STATUS status = bs->AllocatePages(AllocateAnyPages, EfiRuntimeServicesData, pageCount + alignmentPageCount - 1, &base);
+    if (status != EFI_SUCCESS)
+        return status;
+
+    const EFI_PHYSICAL_ADDRESS aligned = (base + alignment - 1) & ~(alignment - 1);
+    const unsigned long long headPageCount = (aligned - base) / 4096;
+    const unsigned long long tailPageCount = alignmentPageCount - 1 - headPageCount;
+    if (headPageCount)
+        bs->FreePages(base, headPageCount);
+    if (tailPageCount)
+        bs->FreePages(aligned + pageCount * 4096, tailPageCount);
+    *buffer = (void*)aligned;
+    return EFI_SUCCESS;
+}
+
+static bool allocLargeWithErrorLog(const CHAR16* name, const unsigned long long size, void** buffer, const int LINE)
+{
+    if (size < largeAllocThreshold)
+        return allocPoolWithErrorLog(name, size, buffer, LINE);
+
+    // Try 1 GB alignment for huge buffers, then 2 MB alignment, then no alignment (if free memory is fragmented or
+    // just sufficient for the buffer)
+    const unsigned long long pageCount = largeAllocSize(size) / 4096;
+    EFI_STATUS status = EFI_OUT_OF_RESOURCES;
+    if (size >= hugePageSize)
+        status = allocateAlignedPages(pageCount, hugePageSize, buffer);
+    if (status != EFI_SUCCESS)
+        status = allocateAlignedPages(pageCount, largePageSize, buffer);
+    if (status != EFI_SUCCESS)
+        status = allocateAlignedPages(pageCount, 4096, buffer);
+    if (status != EFI_SUCCESS)
+    {
+        CHAR16 message[512];
+        setText(message, L"EFI_BOOT_SERVICES.AllocatePages() fails for ");
+        appendText(message, name);
+        appendText(message, L" with size ");
+        appendNumber(message, size, TRUE);
+        logStatusAndMemInfoToConsole(message, status, LINE, size);
+        return false;
+    }
+
+    // Zero out allocated memory
+    setMem(*buffer, size, 0);
+    memoryRegistry.add(name, *buffer, size, pageCount * 4096);
+    return true;
+}
+
+static void freeLarge(void* buffer, const unsigned long long size)
+{
+    if (size < largeAllocThreshold)
+    {
+        freePool(buffer);
+        return;
+    }
+    memoryRegistry.release(buffer);
+    bs->FreePages((EFI_PHYSICAL_ADDRESS)buffer, largeAllocSize(size) / 4096);
+}
+
 #endif
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+// Vectorized implementations of setMem() and copyMem(), which are used instead of the firmware functions
+// bs->SetMem() / bs->CopyMem() in the EFI build. The firmware versions are often simple byte loops or rep stosb /
+// rep movsb without non-temporal stores, which is slow for the multi-MB buffers (spectrum, tick storage, contract
+// states) that the node copies and clears regularly.
+//
+// The operations are dispatched by size:
+// - less than 32 bytes: a few (possibly overlapping) scalar or 128-bit stores
+// - up to memNonTemporalThreshold: 256-bit stores (512-bit with AVX-512), destination aligned, tail overlapping
+// - at least memNonTemporalThreshold: non-temporal streaming stores, which don't pollute the cache with data that
+//   will not be read again soon, followed by a store fence
+//
+// copyMemVectorized() supports overlapping buffers like bs->CopyMem() (memmove semantics).
+
+// Minimum size for using non-temporal stores (should be about the size of the last level cache of a core group).
+static constexpr unsigned long long memNonTemporalThreshold = 4 * 1024 * 1024;
+
+#if defined(__AVX512F__)
+static constexpr unsigned long long memVectorSize = 64;
+typedef __m512i MemVector;
+#define MEM_VECTOR_LOAD(ptr) _mm512_loadu_si512((const void*)(ptr))
+#define MEM_VECTOR_STOREU(ptr, v) _mm512_storeu_si512((void*)(ptr), v)
+#define MEM_VECTOR_STORE(ptr, v) _mm512_store_si512((void*)(ptr), v)
+#define MEM_VECTOR_STREAM(ptr, v) _mm512_stream_si512((__m512i*)(ptr), v)
+#define MEM_VECTOR_SET1(value) _mm512_set1_epi8((char)(value))
+#else
+static constexpr unsigned long long memVectorSize = 32;
+typedef __m256i MemVector;
+#define MEM_VECTOR_LOAD(ptr) _mm256_loadu_si256((const __m256i*)(ptr))
+#define MEM_VECTOR_STOREU(ptr, v) _mm256_storeu_si256((__m256i*)(ptr), v)
+#define MEM_VECTOR_STORE(ptr, v) _mm256_store_si256((__m256i*)(ptr), v)
+#define MEM_VECTOR_STREAM(ptr, v) _mm256_stream_si256((__m256i*)(ptr), v)
+#define MEM_VECTOR_SET1(value) _mm256_set1_epi8((char)(value))
+#endif
+
+// Set size < 32 bytes
+static inline void setMemSmall(unsigned char* dst, unsigned long long size, unsigned char value)
+{
+    if (size >= 16)
+    {
+        const __m128i v = _mm_set1_epi8((char)value);
+        _mm_storeu_si128((__m128i*)dst, v);
+        _mm_storeu_si128((__m128i*)(dst + size - 16), v);
+    }
+    else if (size >= 8)
+    {
+        const unsigned long long v = 0x0101010101010101ULL * value;
+        *(unsigned long long*)dst = v;
+        *(unsigned long long*)(dst + size - 8) = v;
+    }
+    else if (size >= 4)
+    {
+        const unsigned int v = 0x01010101U * value;
+        *(unsigned int*)dst = v;
+        *(unsigned int*)(dst + size - 4) = v;
+    }
+    else
+    {
+        for (unsigned long long i = 0; i < size; ++i)
+            dst[i] = value;
+    }
+}
+
+static void setMemVectorized(void* buffer, unsigned long long size, unsigned char value)
+{
+    unsigned char* dst = (unsigned char*)buffer;
+    if (size < 32)
+    {
+        setMemSmall(dst, size, value);
+        return;
+    }
+
+    const __m256i v256 = _mm256_set1_epi8((char)value);
+    if (size <= 2 * memVectorSize)
+    {
+        for (unsigned long long offset = 0; offset + 32 < size; offset += 32)
+            _mm256_storeu_si256((__m256i*)(dst + offset), v256);
+        _mm256_storeu_si256((__m256i*)(dst + size - 32), v256);
+        return;
+    }
+
+    // unaligned head and tail, aligned body
+    const MemVector v = MEM_VECTOR_SET1(value);
+    unsigned char* const end = dst + size;
+    MEM_VECTOR_STOREU(dst, v);
+    MEM_VECTOR_STOREU(end - memVectorSize, v);
+    dst = (unsigned char*)(((unsigned long long)dst + memVectorSize) & ~(memVectorSize - 1));
+    unsigned char* const alignedEnd = (unsigned char*)((unsigned long long)(end - 1) & ~(memVectorSize - 1));
+    if (size >= memNonTemporalThreshold)
+    {
+        for (; dst + 4 * memVectorSize <= alignedEnd; dst += 4 * memVectorSize)
+        {
+            MEM_VECTOR_STREAM(dst, v);
+            MEM_VECTOR_STREAM(dst + memVectorSize, v);
+            MEM_VECTOR_STREAM(dst + 2 * memVectorSize, v);
+            MEM_VECTOR_STREAM(dst + 3 * memVectorSize, v);
+        }
+        for (; dst < alignedEnd; dst += memVectorSize)
+            MEM_VECTOR_STREAM(dst, v);
+        _mm_sfence();
+    }
+    else
+    {
+        for (; dst + 4 * memVectorSize <= alignedEnd; dst += 4 * memVectorSize)
+        {
+            MEM_VECTOR_STORE(dst, v);
+            MEM_VECTOR_STORE(dst + memVectorSize, v);
+            MEM_VECTOR_STORE(dst + 2 * memVectorSize, v);
+            MEM_VECTOR_STORE(dst + 3 * memVectorSize, v);
+        }
+        for (; dst < alignedEnd; dst += memVectorSize)
+            MEM_VECTOR_STORE(dst, v);
+    }
+}
+
+// Copy size < 32 bytes (all loads before stores, so buffers may overlap)
+static inline void copyMemSmall(unsigned char* dst, const unsigned char* src, unsigned long long size)
+{
+    if (size >= 16)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)src);
+        const __m128i b = _mm_loadu_si128((const __m128i*)(src + size - 16));
+        _mm_storeu_si128((__m128i*)dst, a);
+        _mm_storeu_si128((__m128i*)(dst + size - 16), b);
+    }
+    else if (size >= 8)
+    {
+        const unsigned long long a = *(const unsigned long long*)src;
+        const unsigned long long b = *(const unsigned long long*)(src + size - 8);
+        *(unsigned long long*)dst = a;
+        *(unsigned long long*)(dst + size - 8) = b;
+    }
+    else if (size >= 4)
+    {
+        const unsigned int a = *(const unsigned int*)src;
+        const unsigned int b = *(const unsigned int*)(src + size - 4);
+        *(unsigned int*)dst = a;
+        *(unsigned int*)(dst + size - 4) = b;
+    }
+    else if (size)
+    {
+        const unsigned char a = src[0];
+        const unsigned char b = src[size >> 1];
+        const unsigned char c = src[size - 1];
+        dst[0] = a;
+        dst[size >> 1] = b;
+        dst[size - 1] = c;
+    }
+}
+
+static void copyMemVectorized(void* destination, const void* source, unsigned long long length)
+{
+    unsigned char* dst = (unsigned char*)destination;
+    const unsigned char* src = (const unsigned char*)source;
+    if (length < 32)
+    {
+        copyMemSmall(dst, src, length);
+        return;
+    }
+    if (dst == src)
+        return;
+
+    if (length <= 2 * memVectorSize)
+    {
+        // load everything before storing, so buffers may overlap
+        __m256i v[4];
+        const unsigned long long count = (length + 31) / 32;
+        for (unsigned long long i = 0; i + 1 < count; ++i)
+            v[i] = _mm256_loadu_si256((const __m256i*)(src + i * 32));
+        const __m256i last = _mm256_loadu_si256((const __m256i*)(src + length - 32));
+        for (unsigned long long i = 0; i + 1 < count; ++i)
+            _mm256_storeu_si256((__m256i*)(dst + i * 32), v[i]);
+        _mm256_storeu_si256((__m256i*)(dst + length - 32), last);
+        return;
+    }
+
+    if ((unsigned long long)(dst - src) < length)
+    {
+        // destination overlaps end of source: copy backward with aligned destination (unaligned head and tail are
+        // loaded first and stored last, because storing them earlier may overwrite source data not read yet)
+        const MemVector head = MEM_VECTOR_LOAD(src);
+        unsigned char* dstEnd = dst + length;
+        const unsigned char* srcEnd = src + length;
+        const MemVector tail = MEM_VECTOR_LOAD(srcEnd - memVectorSize);
+        unsigned char* const tailDst = dstEnd - memVectorSize;
+        const unsigned long long misalignment = (unsigned long long)dstEnd & (memVectorSize - 1);
+        dstEnd -= misalignment ? misalignment : memVectorSize;
+        srcEnd -= misalignment ? misalignment : memVectorSize;
+        while (dstEnd - memVectorSize > dst)
+        {
+            dstEnd -= memVectorSize;
+            srcEnd -= memVectorSize;
+            MEM_VECTOR_STORE(dstEnd, MEM_VECTOR_LOAD(srcEnd));
+        }
+        MEM_VECTOR_STOREU(tailDst, tail);
+        MEM_VECTOR_STOREU(dst, head);
+        return;
+    }
+
+    // forward copy with aligned destination (unaligned head and tail are stored last, see above)
+    unsigned char* const dstBegin = dst;
+    unsigned char* const dstEnd = dst + length;
+    const MemVector head = MEM_VECTOR_LOAD(src);
+    const MemVector tail = MEM_VECTOR_LOAD(src + length - memVectorSize);
+    const unsigned long long headSize = memVectorSize - ((unsigned long long)dst & (memVectorSize - 1));
+    dst += headSize;
+    src += headSize;
+    unsigned char* const alignedEnd = (unsigned char*)((unsigned long long)(dstEnd - 1) & ~(memVectorSize - 1));
+    if (length >= memNonTemporalThreshold)
+    {
+        for (; dst + 4 * memVectorSize <= alignedEnd; dst += 4 * memVectorSize, src += 4 * memVectorSize)
+        {
+            const MemVector v0 = MEM_VECTOR_LOAD(src);
+            const MemVector v1 = MEM_VECTOR_LOAD(src + memVectorSize);
+            const MemVector v2 = MEM_VECTOR_LOAD(src + 2 * memVectorSize);
+            const MemVector v3 = MEM_VECTOR_LOAD(src + 3 * memVectorSize);
+            MEM_VECTOR_STREAM(dst, v0);
+            MEM_VECTOR_STREAM(dst + memVectorSize, v1);
+            MEM_VECTOR_STREAM(dst + 2 * memVectorSize, v2);
+            MEM_VECTOR_STREAM(dst + 3 * memVectorSize, v3);
+        }
+        for (; dst < alignedEnd; dst += memVectorSize, src += memVectorSize)
+            MEM_VECTOR_STREAM(dst, MEM_VECTOR_LOAD(src));
+        _mm_sfence();
+    }
+    else
+    {
+        for (; dst + 4 * memVectorSize <= alignedEnd; dst += 4 * memVectorSize, src += 4 * memVectorSize)
+        {
+            const MemVector v0 = MEM_VECTOR_LOAD(src);
+            const MemVector v1 = MEM_VECTOR_LOAD(src + memVectorSize);
+            const MemVector v2 = MEM_VECTOR_LOAD(src + 2 * memVectorSize);
+            const MemVector v3 = MEM_VECTOR_LOAD(src + 3 * memVectorSize);
+            MEM_VECTOR_STORE(dst, v0);
+            MEM_VECTOR_STORE(dst + memVectorSize, v1);
+            MEM_VECTOR_STORE(dst + 2 * memVectorSize, v2);
+            MEM_VECTOR_STORE(dst + 3 * memVectorSize, v3);
+        }
+        for (; dst < alignedEnd; dst += memVectorSize, src += memVectorSize)
+            MEM_VECTOR_STORE(dst, MEM_VECTOR_LOAD(src));
+    }
+    MEM_VECTOR_STOREU(dstEnd - memVectorSize, tail);
+    MEM_VECTOR_STOREU(dstBegin, head);
+}
+
+#undef MEM_VECTOR_LOAD
+#undef MEM_VECTOR_STOREU
+#undef MEM_VECTOR_STORE
+#undef MEM_VECTOR_STREAM
+#undef MEM_VECTOR_SET1
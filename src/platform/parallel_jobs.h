@@ -0,0 +1,150 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+#include "global_var.h"
+#include "concurrency.h"
+#include "assert.h"
+
+// Fork-join helper for splitting a large amount of independent work (such as hashing Merkle tree levels)
+// into chunks that are processed by multiple processors in parallel.
+//
+// The owner (for example tick processor) calls run(), which processes chunks itself and returns after all chunks
+// are finished. Idle processors (request processors) help by calling tryHelp() in their waiting loops. If no
+// helper is available (for example in tests), the owner processes all chunks alone, so run() always completes.
+//
+// Only one job is active at a time. Concurrent run() calls are serialized. The chunk function must not call
+// run() itself and must not acquire locks that may be held by helper processors.
+class ParallelJobs
+{
+public:
+    // Function processing the work items [begin, end) of a job
+    typedef void (*ChunkFunction)(void* context, unsigned long long begin, unsigned long long end);
+
+    // Set state to no active job (call before helper processors are started)
+    void reset()
+    {
+        jobLock = 0;
+        jobActive = 0;
+        activeHelpers = 0;
+        function = nullptr;
+        context = nullptr;
+        itemCount = 0;
+        chunkSize = 0;
+        chunkCount = 0;
+        nextChunk = 0;
+        finishedChunks = 0;
+        helpedChunks = 0;
+    }
+
+    // Process work items [0, count) by calling func in chunks of chunkSize items, potentially in parallel.
+    // Blocks until all work items are processed.
+    void run(ChunkFunction func, void* ctx, unsigned long long count, unsigned long long sizeOfChunk)
+    {
+        ASSERT(func);
+        ASSERT(sizeOfChunk > 0);
+        if (!count)
+            return;
+
+        // Small job or no parallelism possible -> process directly without overhead
+        if (count <= sizeOfChunk)
+        {
+            func(ctx, 0, count);
+            return;
+        }
+
+        ACQUIRE(jobLock);
+
+        function = func;
+        context = ctx;
+        itemCount = count;
+        chunkSize = sizeOfChunk;
+        chunkCount = (count + sizeOfChunk - 1) / sizeOfChunk;
+        nextChunk = 0;
+        finishedChunks = 0;
+
+        // Publish job to helpers (all job data has to be written before)
+        _mm_sfence();
+        jobActive = 1;
+
+        // Process chunks in this processor too
+        while (processNextChunk())
+        {
+        }
+
+        // Wait until helpers have finished their chunks
+        WAIT_WHILE(finishedChunks < chunkCount);
+
+        // Retract job and wait until no helper is accessing job data anymore
+        jobActive = 0;
+        WAIT_WHILE(activeHelpers);
+
+        RELEASE(jobLock);
+    }
+
+    // Help processing the active job if there is one. Returns true if at least one chunk has been processed.
+    // To be called by idle processors.
+    bool tryHelp()
+    {
+        if (!jobActive)
+            return false;
+
+        _InterlockedIncrement(&activeHelpers);
+        bool processedAny = false;
+        if (jobActive)
+        {
+            while (processNextChunk())
+            {
+                _InterlockedIncrement64(&helpedChunks);
+                processedAny = true;
+            }
+        }
+        _InterlockedDecrement(&activeHelpers);
+
+        return processedAny;
+    }
+
+    // Return if a job is active (status may change any time)
+    bool isJobActive() const
+    {
+        return jobActive != 0;
+    }
+
+    // Number of chunks processed by helpers since reset() (for statistics)
+    long long getHelpedChunkCount() const
+    {
+        return helpedChunks;
+    }
+
+protected:
+    // Grab next chunk and process it. Returns false if no chunk is left.
+    bool processNextChunk()
+    {
+        const long long chunkIndex = _InterlockedIncrement64(&nextChunk) - 1;
+        if (chunkIndex >= chunkCount)
+            return false;
+
+        const unsigned long long begin = chunkIndex * chunkSize;
+        unsigned long long end = begin + chunkSize;
+        if (end > itemCount)
+            end = itemCount;
+        function(context, begin, end);
+
+        _InterlockedIncrement64(&finishedChunks);
+        return true;
+    }
+
+    volatile char jobLock;
+    volatile char jobActive;
+    volatile long activeHelpers;
+    ChunkFunction function;
+    void* context;
+    unsigned long long itemCount;
+    unsigned long long chunkSize;
+    long long chunkCount;
+    volatile long long nextChunk;
+    volatile long long finishedChunks;
+    volatile long long helpedChunks;
+};
+
+GLOBAL_VAR_DECL ParallelJobs parallelJobs;
@@ -0,0 +1,101 @@
+#pragma once
+
+// Topology-aware order of the processors (CPU threads) used for assigning the roles of the node.
+//
+// qubic.cpp assigns roles by position in the order: position 1 runs the tick processor, position 2 the contract
+// processor, the following positions the tick hook helpers, and the others request processors. The order puts the
+// tick and contract processors on distinct physical cores of the package of the main processor, which runs
+// initialize() and allocates and first touches the large buffers like spectrum, contract states, and tick storage.
+// So on multi-socket servers, they don't pay remote memory latency for every spectrum access, as long as the firmware
+// allocates the memory of the boot processor's node (UEFI has no interface for choosing the NUMA node).
+//
+// Order: first thread of each core of the main package, first thread of each core of other packages (grouped by
+// package), other SMT threads of the main package, other SMT threads of other packages. Optionally, the SMT siblings of
+// the tick and contract processor are left out, so these processors don't share their core with a request processor.
+
+// Maximum number of processors considered for ordering
+static constexpr unsigned int maxNumberOfOrderedProcessors = 1024;
+
+struct ProcessorLocation
+{
+    unsigned int package;
+    unsigned int core;
+    unsigned int thread;
+};
+
+// Fill order with the indices of locations in the order of role assignment and return the number of entries (count
+// limited to maxNumberOfOrderedProcessors, or less if siblings are idle). criticalBegin and criticalEnd define the
+// positions in the order whose SMT siblings are left out if idleCriticalSiblings is true, but only if at least
+// minUsedCount processors remain.
+static unsigned int orderProcessorsByTopology(const ProcessorLocation* locations, unsigned int count, unsigned int mainPackage,
+    unsigned int* order, bool idleCriticalSiblings = false, unsigned int criticalBegin = 1, unsigned int criticalEnd = 3,
+    unsigned int minUsedCount = 4)
+{
+    // rank: 0 = first thread of core in main package, 1 = first thread in other package, 2/3 = other SMT threads
+    auto rank = [&](unsigned int i)
+    {
+        bool firstThread = true;
+        for (unsigned int j = 0; j < count; ++j)
+        {
+            if (j != i && locations[j].package == locations[i].package && locations[j].core == locations[i].core
+                && (locations[j].thread < locations[i].thread || (locations[j].thread == locations[i].thread && j < i)))
+            {
+                firstThread = false;
+                break;
+            }
+        }
+        return (firstThread ? 0 : 2) + (locations[i].package == mainPackage ? 0 : 1);
+    };
+
+    if (count > maxNumberOfOrderedProcessors)
+        count = maxNumberOfOrderedProcessors;
+
+    // stable insertion sort by (rank, package), which keeps the enumeration order of the firmware otherwise
+    unsigned int ranks[maxNumberOfOrderedProcessors];
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        ranks[i] = rank(i);
+        unsigned int pos = i;
+        while (pos > 0)
+        {
+            const unsigned int prev = order[pos - 1];
+            if (ranks[prev] < ranks[i] || (ranks[prev] == ranks[i] && locations[prev].package <= locations[i].package))
+                break;
+            order[pos] = prev;
+            --pos;
+        }
+        order[pos] = i;
+    }
+
+    if (!idleCriticalSiblings)
+        return count;
+
+    // count SMT siblings of critical processors placed behind the critical positions
+    auto isCriticalSibling = [&](unsigned int pos)
+    {
+        const ProcessorLocation& loc = locations[order[pos]];
+        for (unsigned int c = criticalBegin; c < criticalEnd && c < count; ++c)
+        {
+            const ProcessorLocation& critical = locations[order[c]];
+            if (loc.package == critical.package && loc.core == critical.core && loc.thread != critical.thread)
+                return true;
+        }
+        return false;
+    };
+    unsigned int siblingCount = 0;
+    for (unsigned int pos = criticalEnd; pos < count; ++pos)
+    {
+        if (isCriticalSibling(pos))
+            ++siblingCount;
+    }
+    if (!siblingCount || count - siblingCount < minUsedCount)
+        return count;
+
+    unsigned int usedCount = criticalEnd;
+    for (unsigned int pos = criticalEnd; pos < count; ++pos)
+    {
+        if (!isCriticalSibling(pos))
+            order[usedCount++] = order[pos];
+    }
+    return usedCount;
+}
@@ -5,6 +5,7 @@
 #include "memory_util.h"
 #include "time_stamp_counter.h"
 #include "file_io.h"
+#include "sampling_profiler.h"
 
 struct ProfilingData
 {
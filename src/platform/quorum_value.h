@@ -2,8 +2,8 @@
 
 #include "lib/platform_common/sorting.h"
 
-// Calculates percentile value from array (in-place sort)
-// Returns value at position: (count * Numerator) / Denominator
+// Calculates percentile value from array (in-place partial reordering with quickSelect())
+// Returns value at position: (count * Numerator) / Denominator of the sorted array
 template <typename T, unsigned int Numerator, unsigned int Denominator,
           SortingOrder Order = SortingOrder::SortAscending>
 T calculatePercentileValue(T* values, unsigned int count)
@@ -16,11 +16,9 @@ T calculatePercentileValue(T* values, unsigned int count)
         return T(0);
     }
 
-    quickSort(values, 0, count - 1, Order);
-
     unsigned int percentileIndex = (count * Numerator) / Denominator;
 
-    return values[percentileIndex];
+    return quickSelect(values, 0, count - 1, percentileIndex, Order);
 }
 
 // Calculates 2/3 quorum value with ascending sort order
@@ -20,4 +20,28 @@ inline static void random256(m256i* dst)
 {
     ASSERT(dst != NULL);
     dst->setRandomValue();
-}
\ No newline at end of file
+}
+
+// Fast non-cryptographic pseudo-random number generator (xorshift64*) for randomizing orders in hot paths, where calling
+// random() (RDRAND) for every number is too slow. Use seed() once before generating numbers.
+struct FastRandom
+{
+    unsigned long long state;
+
+    // Seed with hardware random number (state must not be 0)
+    void seed()
+    {
+        random64(&state);
+        if (!state)
+            state = 1;
+    }
+
+    // Return pseudo-random number in [0, range)
+    unsigned int next(const unsigned int range)
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (unsigned int)((state * 0x2545F4914F6CDD1DULL) >> 32) % range;
+    }
+};
\ No newline at end of file
@@ -3,6 +3,11 @@
 #include <lib/platform_common/qintrin.h>
 #include "debugging.h"
 #include "concurrency.h"
+#include "spin_lock.h"
+
+// Define TRACK_READ_WRITE_LOCK_STATISTICS (in all compile units) to count acquisitions and contention of ReadWriteLock.
+// It is disabled by default, because every read acquisition atomically updates the counters, which makes their cache
+// line contended between processors that only read.
 
 // Lock that allows multiple readers but only one writer.
 // Priorizes writers, that is, additional readers can only gain access if no writer is waiting.
@@ -20,6 +25,9 @@ public:
     {
         readers = 0;
         writersWaiting = 0;
+#ifdef TRACK_READ_WRITE_LOCK_STATISTICS
+        stats.reset();
+#endif
     }
 
     // Aquire lock for reading (wait if needed).
@@ -29,7 +37,17 @@ public:
         ASSERT(writersWaiting >= 0);
 
         // Wait until getting read access
-        WAIT_WHILE(!tryAcquireRead());
+        if (!tryAcquireRead())
+        {
+#ifdef TRACK_READ_WRITE_LOCK_STATISTICS
+            const unsigned long long startTsc = __rdtsc();
+            WAIT_WHILE(!tryAcquireRead());
+            _InterlockedIncrement64((volatile long long*)&stats.contendedAcquisitionCount);
+            _InterlockedExchangeAdd64((volatile long long*)&stats.spinCycles, __rdtsc() - startTsc);
+#else
+            WAIT_WHILE(!tryAcquireRead());
+#endif
+        }
     }
 
     // Try to aquire lock for reading without waiting. Return true if lock has been acquired.
@@ -67,7 +85,12 @@ public:
             // and we retry in the next iteration of the while loop.
             newReaders = currentReaders + 1;
             if (_InterlockedCompareExchange(&readers, newReaders, currentReaders) == currentReaders)
+            {
+#ifdef TRACK_READ_WRITE_LOCK_STATISTICS
+                _InterlockedIncrement64((volatile long long*)&stats.acquisitionCount);
+#endif
                 return true;
+            }
         }        
     }
 
@@ -91,7 +114,17 @@ public:
         _InterlockedIncrement(&writersWaiting);
 
         // Wait until getting write access
-        WAIT_WHILE(!tryAcquireWrite());
+        if (!tryAcquireWrite())
+        {
+#ifdef TRACK_READ_WRITE_LOCK_STATISTICS
+            const unsigned long long startTsc = __rdtsc();
+            WAIT_WHILE(!tryAcquireWrite());
+            ++stats.contendedAcquisitionCount;
+            stats.spinCycles += __rdtsc() - startTsc;
+#else
+            WAIT_WHILE(!tryAcquireWrite());
+#endif
+        }
 
         // Writer got access -> decrement counter of writers waiting for access
         _InterlockedDecrement(&writersWaiting);
@@ -112,7 +145,12 @@ public:
         //          return true;
         //      }
         if (_InterlockedCompareExchange(&readers, -1, 0) == 0)
+        {
+#ifdef TRACK_READ_WRITE_LOCK_STATISTICS
+            ++stats.acquisitionCount;
+#endif
             return true;
+        }
 
         return false;
     }
@@ -141,10 +179,28 @@ public:
         return readers;
     }
 
+    // Return contention statistics of read and write acquisitions (may be slightly inconsistent if the lock is used).
+    // All counters are zero if TRACK_READ_WRITE_LOCK_STATISTICS isn't defined.
+    const LockStatistics& getStatistics() const
+    {
+#ifdef TRACK_READ_WRITE_LOCK_STATISTICS
+        return stats;
+#else
+        static const LockStatistics noStatistics = { 0, 0, 0 };
+        return noStatistics;
+#endif
+    }
+
 private:
     // Positive values means number of readers using having acquired a read lock; -1 means writer has acquired lock; 0 mean no lock is active
     volatile long readers;
 
     // Number of writers waiting for lock (>= 0)
     volatile long writersWaiting;
+
+#ifdef TRACK_READ_WRITE_LOCK_STATISTICS
+    // Contention counters (read acquisitions are counted atomically, write acquisitions by the lock holder), on their own
+    // cache line, so updating them doesn't slow down processors waiting for readers and writersWaiting
+    alignas(64) LockStatistics stats;
+#endif
 };
@@ -0,0 +1,478 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+#include "global_var.h"
+#include "concurrency.h"
+#include "memory_util.h"
+#include "time_stamp_counter.h"
+#include "file_io.h"
+
+// Always-on low-overhead profiler for production nodes, complementing ProfilingDataCollector (which is only compiled
+// in with ENABLE_PROFILING and does a locked hash map update per scope).
+//
+// Scopes have fixed IDs (SampledScope), so recording a scope just writes one 16-byte event (start TSC, duration,
+// scope) into the ring buffer of the running processor, without hashing or locking. Each ring has a single writer.
+// The ring of the running processor is found by the address of its call stack (see setStack()), because asking the
+// firmware for the processor ID is slow. Callers on an unregistered stack (main processor) use the last ring.
+// The main processor periodically aggregates new events of all rings into per-scope log-linear histograms (see
+// aggregate()), which can be queried with SPECIAL_COMMAND_GET_SAMPLED_PROFILE (top N scopes by total cycles or p99).
+// The events still in the rings can be written as timeline in Chrome trace event format (chrome://tracing, Perfetto)
+// with writeChromeTrace().
+//
+// Recording can be compiled out by defining DISABLE_SAMPLING_PROFILER.
+
+// IDs of scopes measured with PROFILE_SAMPLED_SCOPE()
+enum SampledScope : unsigned short
+{
+    SAMPLED_SCOPE_PROCESS_TICK = 0,
+    SAMPLED_SCOPE_BEGIN_TICK,
+    SAMPLED_SCOPE_PROCESS_SOLUTIONS,
+    SAMPLED_SCOPE_PROCESS_TRANSACTIONS,
+    SAMPLED_SCOPE_END_TICK,
+    SAMPLED_SCOPE_SPECTRUM_DIGEST,
+    SAMPLED_SCOPE_REQUEST_PROCESSING,
+    SAMPLED_SCOPE_SOLUTION_PROCESSING,
+    SAMPLED_SCOPE_PARALLEL_JOB,
+    SAMPLED_SCOPE_PEERS_RECEIVE_TRANSMIT,
+    SAMPLED_SCOPE_COUNT
+};
+
+// Names of SampledScope IDs (used in responses and traces, at most 31 characters)
+static const char* const sampledScopeNames[SAMPLED_SCOPE_COUNT] = {
+    "processTick",
+    "processTick: BEGIN_TICK",
+    "processTick: solutions",
+    "processTick: transactions",
+    "processTick: END_TICK",
+    "processTick: spectrum digest",
+    "requestProcessor: request",
+    "requestProcessor: solution",
+    "requestProcessor: parallel job",
+    "peersReceiveAndTransmit",
+};
+
+// Number of events per processor ring buffer (power of 2). The Chrome trace can only cover the time span of the last
+// samplingProfilerEventsPerProcessor events of each processor.
+static constexpr unsigned int samplingProfilerEventsPerProcessor = 16384;
+
+// Maximum number of events in Chrome trace
+static constexpr unsigned int samplingProfilerMaxTraceEvents = 262144;
+
+struct SampledScopeEvent
+{
+    unsigned long long startTsc;
+    unsigned int durationCycles; // saturated at 0xffffffff (about 1 s)
+    unsigned short scope;
+    unsigned short reserved;
+};
+
+static_assert(sizeof(SampledScopeEvent) == 16, "Unexpected size of SampledScopeEvent");
+
+// Aggregated statistics of one scope (durations in CPU cycles)
+struct SampledScopeStats
+{
+    char name[32];
+    unsigned long long count;
+    unsigned long long totalCycles;
+    unsigned long long p50Cycles;
+    unsigned long long p99Cycles;
+    unsigned long long maxCycles;
+};
+
+class SamplingProfiler
+{
+    // Log-linear histogram buckets like in TickPhaseStats: exact below 16 cycles, then 16 buckets per power of 2
+    static constexpr unsigned int subBucketBits = 4;
+    static constexpr unsigned int subBucketCount = 1 << subBucketBits;
+    static constexpr unsigned int bucketCount = (32 - subBucketBits + 1) * subBucketCount;
+    static constexpr unsigned long long eventIndexMask = samplingProfilerEventsPerProcessor - 1;
+
+    static_assert((samplingProfilerEventsPerProcessor & eventIndexMask) == 0, "samplingProfilerEventsPerProcessor must be power of 2");
+
+    struct ProcessorRing
+    {
+        // Number of events recorded by the processor, only written by the processor owning the ring
+        volatile unsigned long long head;
+        // Stack of the processor owning the ring (see setStack())
+        const unsigned char* stackBottom;
+        const unsigned char* stackTop;
+        unsigned long long padding[5];
+        SampledScopeEvent events[samplingProfilerEventsPerProcessor];
+    };
+
+    struct ScopeHistogram
+    {
+        unsigned long long count;
+        unsigned long long totalCycles;
+        unsigned long long maxCycles;
+        unsigned long long bucketCounts[bucketCount];
+    };
+
+    ProcessorRing* rings;
+    unsigned long long* aggregatedEventCounts; // per processor, only used by aggregating processor with lock
+    unsigned int processorCount;
+    unsigned long long lostEvents; // events overwritten before aggregation
+    ScopeHistogram histograms[SAMPLED_SCOPE_COUNT];
+    volatile char lock;
+
+    static unsigned int bucketIndex(unsigned int value)
+    {
+        if (value < subBucketCount)
+        {
+            return value;
+        }
+        const unsigned int exponent = 63 - (unsigned int)__lzcnt64(value);
+        return (exponent - subBucketBits + 1) * subBucketCount + ((value >> (exponent - subBucketBits)) & (subBucketCount - 1));
+    }
+
+    // Return highest value falling into bucket
+    static unsigned long long bucketUpperBound(unsigned int index)
+    {
+        if (index < subBucketCount)
+        {
+            return index;
+        }
+        const unsigned int shift = index / subBucketCount - 1;
+        const unsigned long long lowerBound = ((unsigned long long)(subBucketCount + index % subBucketCount)) << shift;
+        return lowerBound + (1ULL << shift) - 1;
+    }
+
+    // Return smallest bucket upper bound that at least the given per mille of samples do not exceed. Lock must be held.
+    static unsigned long long percentile(const ScopeHistogram& histogram, unsigned int perMille)
+    {
+        const unsigned long long rank = (histogram.count * perMille + 999) / 1000;
+        unsigned long long count = 0;
+        for (unsigned int i = 0; i < bucketCount; i++)
+        {
+            count += histogram.bucketCounts[i];
+            if (count >= rank)
+            {
+                const unsigned long long upperBound = bucketUpperBound(i);
+                return (upperBound < histogram.maxCycles) ? upperBound : histogram.maxCycles;
+            }
+        }
+        return 0;
+    }
+
+    // Copy events [begin, end) of ring to buffer (end - begin <= eventIndexMask + 1). Return index of first event that
+    // is valid, because events may be overwritten by the processor while copying.
+    static unsigned long long copyEvents(const ProcessorRing& ring, unsigned long long begin, unsigned long long end, SampledScopeEvent* buffer)
+    {
+        for (unsigned long long i = begin; i < end; i++)
+        {
+            buffer[i - begin] = ring.events[i & eventIndexMask];
+        }
+        // event i is valid if the processor hasn't started to write event i + eventsPerProcessor (head <= i + N - 1)
+        const unsigned long long head = ring.head;
+        const unsigned long long firstValid = (head >= samplingProfilerEventsPerProcessor) ? head - samplingProfilerEventsPerProcessor + 1 : 0;
+        return (firstValid > begin) ? firstValid : begin;
+    }
+
+    // Append ASCII text / number to buffer for writing the trace
+    static void appendAscii(char*& out, const char* text)
+    {
+        while (*text)
+            *out++ = *text++;
+    }
+
+    static void appendAsciiNumber(char*& out, unsigned long long value, unsigned int minDigits = 1)
+    {
+        char digits[20];
+        unsigned int count = 0;
+        do
+        {
+            digits[count++] = '0' + (char)(value % 10);
+            value /= 10;
+        } while (value || count < minDigits);
+        while (count)
+            *out++ = digits[--count];
+    }
+
+    // Append TSC difference as microseconds with 3 decimals
+    static void appendAsciiMicroseconds(char*& out, unsigned long long ticks)
+    {
+        const unsigned long long nanoseconds = (ticks / frequency) * 1000000000ULL + (ticks % frequency) * 1000000000ULL / frequency;
+        appendAsciiNumber(out, nanoseconds / 1000);
+        *out++ = '.';
+        appendAsciiNumber(out, nanoseconds % 1000, 3);
+    }
+
+public:
+    // Allocate ring buffers for processors with index < processorCount. The last one is used by callers whose stack
+    // hasn't been registered with setStack().
+    bool init(unsigned int processorCount)
+    {
+        reset();
+        rings = nullptr;
+        aggregatedEventCounts = nullptr;
+        this->processorCount = 0;
+        if (!processorCount
+            || !allocLargeWithErrorLog(L"SamplingProfiler::rings", processorCount * sizeof(ProcessorRing), (void**)&rings, __LINE__)
+            || !allocPoolWithErrorLog(L"SamplingProfiler::aggregatedEventCounts", processorCount * sizeof(unsigned long long), (void**)&aggregatedEventCounts, __LINE__))
+        {
+            return false;
+        }
+        for (unsigned int i = 0; i < processorCount; ++i)
+        {
+            rings[i].stackBottom = nullptr;
+            rings[i].stackTop = nullptr;
+        }
+        this->processorCount = processorCount;
+        return true;
+    }
+
+    void deinit()
+    {
+        const unsigned int count = processorCount;
+        processorCount = 0;
+        if (rings)
+        {
+            freeLarge(rings, count * sizeof(ProcessorRing));
+            rings = nullptr;
+        }
+        if (aggregatedEventCounts)
+        {
+            freePool(aggregatedEventCounts);
+            aggregatedEventCounts = nullptr;
+        }
+    }
+
+    // Reset aggregated statistics (events in rings that are not aggregated yet are kept)
+    void reset()
+    {
+        ACQUIRE_WITHOUT_DEBUG_LOGGING(lock);
+        setMem(histograms, sizeof(histograms), 0);
+        lostEvents = 0;
+        RELEASE(lock);
+    }
+
+    // Record event of scope on given processor. Must only be called by the processor itself.
+    void recordOnProcessor(unsigned long long processor, SampledScope scope, unsigned long long startTsc, unsigned long long endTsc)
+    {
+        if (processor >= processorCount)
+            return;
+        ProcessorRing& ring = rings[processor];
+        const unsigned long long index = ring.head;
+        SampledScopeEvent& event = ring.events[index & eventIndexMask];
+        const unsigned long long duration = (endTsc > startTsc) ? endTsc - startTsc : 0;
+        event.startTsc = startTsc;
+        event.durationCycles = (duration > 0xffffffff) ? 0xffffffff : (unsigned int)duration;
+        event.scope = scope;
+        ring.head = index + 1;
+    }
+
+    // Set stack [stackBottom, stackTop) of the processor using the ring with given index. Must be called before the
+    // processor records events.
+    void setStack(unsigned int processor, const void* stackBottom, const void* stackTop)
+    {
+        if (processor + 1 >= processorCount)
+            return;
+        rings[processor].stackBottom = (const unsigned char*)stackBottom;
+        rings[processor].stackTop = (const unsigned char*)stackTop;
+    }
+
+    // Return index of the ring of the processor running on the stack of the caller (last ring if the stack is unknown).
+    unsigned int findRunningProcessor() const
+    {
+        volatile unsigned char stackMarker = 0;
+        const unsigned char* stackAddress = (const unsigned char*)&stackMarker;
+        for (unsigned int i = 0; i + 1 < processorCount; ++i)
+        {
+            if (stackAddress >= rings[i].stackBottom && stackAddress < rings[i].stackTop)
+                return i;
+        }
+        return processorCount - 1;
+    }
+
+    // Record event of scope on running processor
+    void record(SampledScope scope, unsigned long long startTsc, unsigned long long endTsc)
+    {
+        if (processorCount)
+            recordOnProcessor(findRunningProcessor(), scope, startTsc, endTsc);
+    }
+
+    // Add events recorded since last call to histograms. Should be called periodically, often enough that the rings
+    // don't overflow (otherwise events are counted as lost).
+    void aggregate()
+    {
+        SampledScopeEvent buffer[256];
+        ACQUIRE_WITHOUT_DEBUG_LOGGING(lock);
+        for (unsigned int processor = 0; processor < processorCount; processor++)
+        {
+            const ProcessorRing& ring = rings[processor];
+            const unsigned long long head = ring.head;
+            unsigned long long begin = aggregatedEventCounts[processor];
+            while (begin < head)
+            {
+                const unsigned long long end = (head - begin > 256) ? begin + 256 : head;
+                const unsigned long long firstValid = copyEvents(ring, begin, end, buffer);
+                lostEvents += firstValid - begin;
+                for (unsigned long long i = firstValid; i < end; i++)
+                {
+                    const SampledScopeEvent& event = buffer[i - begin];
+                    if (event.scope < SAMPLED_SCOPE_COUNT)
+                    {
+                        ScopeHistogram& histogram = histograms[event.scope];
+                        ++histogram.count;
+                        histogram.totalCycles += event.durationCycles;
+                        if (histogram.maxCycles < event.durationCycles)
+                            histogram.maxCycles = event.durationCycles;
+                        ++histogram.bucketCounts[bucketIndex(event.durationCycles)];
+                    }
+                }
+                // skip events that have been overwritten (firstValid may be beyond end and head)
+                begin = (firstValid > end) ? firstValid : end;
+            }
+            aggregatedEventCounts[processor] = (begin > head) ? begin : head;
+        }
+        RELEASE(lock);
+    }
+
+    // Number of events that were overwritten before being aggregated
+    unsigned long long getLostEvents() const
+    {
+        return lostEvents;
+    }
+
+    // Get statistics of up to maxEntries scopes that have been executed, sorted descending by total cycles (or p99 if
+    // byP99 is true). Returns number of entries.
+    unsigned int getTopScopes(SampledScopeStats* entries, unsigned int maxEntries, bool byP99)
+    {
+        SampledScopeStats stats[SAMPLED_SCOPE_COUNT];
+        unsigned int count = 0;
+        ACQUIRE_WITHOUT_DEBUG_LOGGING(lock);
+        for (unsigned int scope = 0; scope < SAMPLED_SCOPE_COUNT; scope++)
+        {
+            const ScopeHistogram& histogram = histograms[scope];
+            if (!histogram.count)
+                continue;
+
+            SampledScopeStats entry;
+            setMem(&entry, sizeof(entry), 0);
+            for (unsigned int i = 0; i < sizeof(entry.name) - 1 && sampledScopeNames[scope][i]; i++)
+                entry.name[i] = sampledScopeNames[scope][i];
+            entry.count = histogram.count;
+            entry.totalCycles = histogram.totalCycles;
+            entry.p50Cycles = percentile(histogram, 500);
+            entry.p99Cycles = percentile(histogram, 990);
+            entry.maxCycles = histogram.maxCycles;
+
+            // insertion sort (descending)
+            unsigned int pos = count++;
+            while (pos > 0 && ((byP99) ? stats[pos - 1].p99Cycles < entry.p99Cycles : stats[pos - 1].totalCycles < entry.totalCycles))
+            {
+                stats[pos] = stats[pos - 1];
+                --pos;
+            }
+            stats[pos] = entry;
+        }
+        RELEASE(lock);
+
+        if (count > maxEntries)
+            count = maxEntries;
+        copyMem(entries, stats, count * sizeof(SampledScopeStats));
+        return count;
+    }
+
+    // Write the events of the last milliseconds (as far as they are still in the rings) as Chrome trace JSON file. Thread
+    // IDs are the ring indices, times are in microseconds relative to the oldest event. Returns number of bytes written
+    // or -1 on error.
+    long long writeChromeTrace(const CHAR16* fileName, unsigned long long milliseconds, const CHAR16* directory = NULL)
+    {
+        if (!processorCount || !frequency)
+            return -1;
+
+        // collect events of the time span, which is at most the full rings
+        const unsigned long long endTsc = __rdtsc();
+        const unsigned long long spanTicks = (milliseconds >= 0xffffffffffffffffULL / frequency) ? endTsc : milliseconds * frequency / 1000;
+        const unsigned long long beginTsc = (endTsc > spanTicks) ? endTsc - spanTicks : 0;
+        SampledScopeEvent* events;
+        unsigned short* eventProcessors;
+        if (!allocPoolWithErrorLog(L"SamplingProfiler::traceEvents", samplingProfilerMaxTraceEvents * sizeof(SampledScopeEvent), (void**)&events, __LINE__))
+            return -1;
+        if (!allocPoolWithErrorLog(L"SamplingProfiler::traceEventProcessors", samplingProfilerMaxTraceEvents * sizeof(unsigned short), (void**)&eventProcessors, __LINE__))
+        {
+            freePool(events);
+            return -1;
+        }
+        unsigned int eventCount = 0;
+        unsigned long long minTsc = endTsc;
+        for (unsigned int processor = 0; processor < processorCount && eventCount < samplingProfilerMaxTraceEvents; processor++)
+        {
+            const ProcessorRing& ring = rings[processor];
+            const unsigned long long head = ring.head;
+            unsigned long long begin = (head > samplingProfilerEventsPerProcessor) ? head - samplingProfilerEventsPerProcessor : 0;
+            if (head - begin > samplingProfilerMaxTraceEvents - eventCount)
+                begin = head - (samplingProfilerMaxTraceEvents - eventCount);
+            const unsigned long long firstValid = copyEvents(ring, begin, head, events + eventCount);
+            for (unsigned long long i = firstValid; i < head; i++)
+            {
+                const SampledScopeEvent& event = events[eventCount + i - begin];
+                if (event.startTsc >= beginTsc && event.scope < SAMPLED_SCOPE_COUNT)
+                {
+                    if (minTsc > event.startTsc)
+                        minTsc = event.startTsc;
+                    events[eventCount] = event;
+                    eventProcessors[eventCount] = (unsigned short)processor;
+                    ++eventCount;
+                }
+            }
+        }
+
+        // format JSON (each event needs less than 160 bytes)
+        char* json;
+        long long result = -1;
+        if (allocPoolWithErrorLog(L"SamplingProfiler::traceJson", eventCount * 160ULL + 64, (void**)&json, __LINE__))
+        {
+            char* out = json;
+            appendAscii(out, "{\"traceEvents\":[");
+            for (unsigned int i = 0; i < eventCount; i++)
+            {
+                appendAscii(out, (i) ? ",\n{\"name\":\"" : "\n{\"name\":\"");
+                appendAscii(out, sampledScopeNames[events[i].scope]);
+                appendAscii(out, "\",\"ph\":\"X\",\"pid\":0,\"tid\":");
+                appendAsciiNumber(out, eventProcessors[i]);
+                appendAscii(out, ",\"ts\":");
+                appendAsciiMicroseconds(out, events[i].startTsc - minTsc);
+                appendAscii(out, ",\"dur\":");
+                appendAsciiMicroseconds(out, events[i].durationCycles);
+                *out++ = '}';
+            }
+            appendAscii(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+            result = save(fileName, out - json, (const unsigned char*)json, directory);
+            freePool(json);
+        }
+        freePool(eventProcessors);
+        freePool(events);
+        return result;
+    }
+};
+
+// Global sampling profiler used by SampledProfilingScope
+GLOBAL_VAR_DECL SamplingProfiler gSamplingProfiler;
+
+// Record duration of life-time of object (from construction to destruction) as event of the scope.
+// Construction and destruction must happen on the same processor.
+class SampledProfilingScope
+{
+public:
+    SampledProfilingScope(SampledScope scope) : mScope(scope), mStartTsc(__rdtsc())
+    {
+    }
+
+    ~SampledProfilingScope()
+    {
+        gSamplingProfiler.record(mScope, mStartTsc, __rdtsc());
+    }
+
+protected:
+    SampledScope mScope;
+    unsigned long long mStartTsc;
+};
+
+#ifndef DISABLE_SAMPLING_PROFILER
+#define PROFILE_SAMPLED_SCOPE(scope) SampledProfilingScope __sampledProfilingScopeObject(scope)
+#else
+#define PROFILE_SAMPLED_SCOPE(scope)
+#endif
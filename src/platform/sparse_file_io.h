@@ -0,0 +1,356 @@
+#pragma once
+
+#include "platform/file_io.h"
+#include "platform/memory_util.h"
+
+// Sparse file format for large buffers that are mostly zero, such as the states of contracts with big preallocated
+// arrays of which only a few slots are used. Only pages with non-zero bytes are stored, which makes node state
+// snapshots smaller and faster to write and read.
+//
+// File layout: the non-zero pages packed in order (only the last page of the buffer may be shorter than
+// sparseFilePageSize), followed by a bitmap with one bit per page (1 = page is stored), followed by a
+// SparseFileTrailer. Files saved with saveSparse() are always smaller than the buffer, because the plain format is
+// used if the sparse format wouldn't save space. So loadSparse() can tell the formats apart by the file size.
+
+static constexpr unsigned long long sparseFilePageSize = 4096;
+static constexpr unsigned long long sparseFileMagic = 0x3145535241505351ULL; // "QSPARSE1"
+
+struct SparseFileTrailer
+{
+    unsigned long long magic;
+    unsigned long long bufferSize;
+    unsigned long long storedPageCount;
+};
+
+struct SparseFileWriter
+{
+    const unsigned char* buffer;
+    unsigned long long bufferSize;
+    unsigned long long storedDataSize;  // size of packed pages at the beginning of the file
+    unsigned long long* tail;           // page bitmap followed by trailer
+    unsigned long long tailSize;
+
+    // Cursor for mapping file offsets to pages, valid for file offset cursorStoredPage * sparseFilePageSize
+    unsigned long long cursorStoredPage;
+    unsigned long long cursorPage;
+
+    bool isPageStored(unsigned long long page) const
+    {
+        return (tail[page >> 6] >> (page & 63)) & 1;
+    }
+
+    unsigned long long pageSize(unsigned long long page) const
+    {
+        const unsigned long long begin = page * sparseFilePageSize;
+        return (bufferSize - begin < sparseFilePageSize) ? bufferSize - begin : sparseFilePageSize;
+    }
+
+    // GetPartToSaveFunction: return run of consecutive stored pages or part of tail
+    static const unsigned char* getPart(void* context, unsigned long long offset, unsigned long long maxPartSize, unsigned long long& partSize)
+    {
+        SparseFileWriter* writer = (SparseFileWriter*)context;
+        if (offset >= writer->storedDataSize)
+        {
+            const unsigned long long tailOffset = offset - writer->storedDataSize;
+            partSize = (writer->tailSize - tailOffset < maxPartSize) ? writer->tailSize - tailOffset : maxPartSize;
+            return (const unsigned char*)writer->tail + tailOffset;
+        }
+
+        // find the stored page containing offset (saving may retry a part, so the cursor may have to restart)
+        const unsigned long long storedPage = offset / sparseFilePageSize;
+        if (storedPage < writer->cursorStoredPage)
+        {
+            writer->cursorStoredPage = 0;
+            writer->cursorPage = 0;
+        }
+        while (!writer->isPageStored(writer->cursorPage) || writer->cursorStoredPage < storedPage)
+        {
+            if (writer->isPageStored(writer->cursorPage))
+                ++writer->cursorStoredPage;
+            ++writer->cursorPage;
+        }
+
+        // extend part over following pages as long as they are stored
+        const unsigned long long offsetInPage = offset % sparseFilePageSize;
+        partSize = writer->pageSize(writer->cursorPage) - offsetInPage;
+        unsigned long long page = writer->cursorPage + 1;
+        while (partSize < maxPartSize && page * sparseFilePageSize < writer->bufferSize && writer->isPageStored(page))
+        {
+            partSize += writer->pageSize(page);
+            ++page;
+        }
+        if (partSize > maxPartSize)
+            partSize = maxPartSize;
+        return writer->buffer + writer->cursorPage * sparseFilePageSize + offsetInPage;
+    }
+};
+
+// Save buffer in sparse format if this saves space and in plain format otherwise. Returns number of bytes written
+// or -1 on error.
+static long long saveSparse(const CHAR16* fileName, unsigned long long bufferSize, const unsigned char* buffer, const CHAR16* directory = NULL)
+{
+    const unsigned long long pageCount = (bufferSize + sparseFilePageSize - 1) / sparseFilePageSize;
+    const unsigned long long bitmapSize = (pageCount + 63) / 64 * sizeof(unsigned long long);
+    const unsigned long long tailSize = bitmapSize + sizeof(SparseFileTrailer);
+    if (bufferSize <= tailSize + sparseFilePageSize)
+        return save(fileName, bufferSize, buffer, directory);
+
+    SparseFileWriter writer;
+    if (!allocPoolWithErrorLog(L"SparseFileWriter::tail ", tailSize, (void**)&writer.tail, __LINE__))
+        return -1;
+    setMem(writer.tail, bitmapSize, 0);
+
+    unsigned long long storedPageCount = 0;
+    writer.buffer = buffer;
+    writer.bufferSize = bufferSize;
+    writer.storedDataSize = 0;
+    for (unsigned long long page = 0; page < pageCount; ++page)
+    {
+        const unsigned long long size = writer.pageSize(page);
+        if (!isZero(buffer + page * sparseFilePageSize, size))
+        {
+            writer.tail[page >> 6] |= 1ULL << (page & 63);
+            writer.storedDataSize += size;
+            ++storedPageCount;
+        }
+    }
+
+    long long savedSize;
+    if (writer.storedDataSize + tailSize >= bufferSize)
+    {
+        savedSize = save(fileName, bufferSize, buffer, directory);
+    }
+    else
+    {
+        SparseFileTrailer* trailer = (SparseFileTrailer*)((unsigned char*)writer.tail + bitmapSize);
+        trailer->magic = sparseFileMagic;
+        trailer->bufferSize = bufferSize;
+        trailer->storedPageCount = storedPageCount;
+        writer.tailSize = tailSize;
+        writer.cursorStoredPage = 0;
+        writer.cursorPage = 0;
+        savedSize = saveGathered(fileName, writer.storedDataSize + tailSize, SparseFileWriter::getPart, &writer, directory);
+    }
+
+    freePool(writer.tail);
+    return savedSize;
+}
+
+// Expand file in sparse format that has been loaded into the beginning of buffer (loadedSize bytes) in place.
+// Returns bufferSize on success. If the loaded data isn't a valid sparse file, the buffer isn't changed and
+// loadedSize is returned. Returns -1 if memory allocation failed.
+static long long expandSparse(unsigned long long bufferSize, unsigned char* buffer, long long loadedSize)
+{
+    if (loadedSize < 0 || (unsigned long long)loadedSize >= bufferSize)
+        return loadedSize;
+
+    const unsigned long long pageCount = (bufferSize + sparseFilePageSize - 1) / sparseFilePageSize;
+    const unsigned long long bitmapSize = (pageCount + 63) / 64 * sizeof(unsigned long long);
+    const unsigned long long tailSize = bitmapSize + sizeof(SparseFileTrailer);
+    if ((unsigned long long)loadedSize < tailSize)
+        return loadedSize;
+    const unsigned long long storedDataSize = loadedSize - tailSize;
+    const SparseFileTrailer* trailer = (const SparseFileTrailer*)(buffer + loadedSize - sizeof(SparseFileTrailer));
+    if (trailer->magic != sparseFileMagic || trailer->bufferSize != bufferSize)
+        return loadedSize;
+
+    // copy bitmap out of the buffer, because it is overwritten when moving the pages to their place
+    unsigned long long* bitmap;
+    if (!allocPoolWithErrorLog(L"loadSparse bitmap ", bitmapSize, (void**)&bitmap, __LINE__))
+        return -1;
+    copyMem(bitmap, buffer + storedDataSize, bitmapSize);
+
+    unsigned long long storedPageCount = 0;
+    unsigned long long expectedDataSize = 0;
+    for (unsigned long long page = 0; page < pageCount; ++page)
+    {
+        if ((bitmap[page >> 6] >> (page & 63)) & 1)
+        {
+            const unsigned long long begin = page * sparseFilePageSize;
+            expectedDataSize += (bufferSize - begin < sparseFilePageSize) ? bufferSize - begin : sparseFilePageSize;
+            ++storedPageCount;
+        }
+    }
+    if (storedPageCount != trailer->storedPageCount || expectedDataSize != storedDataSize)
+    {
+        freePool(bitmap);
+        return loadedSize;
+    }
+
+    // Move pages to their place, starting with the last one. Stored page j goes to page i >= j and the distance is a
+    // multiple of the page size, so a page never overwrites a stored page that hasn't been moved yet.
+    for (unsigned long long page = pageCount; page-- > 0; )
+    {
+        const unsigned long long begin = page * sparseFilePageSize;
+        const unsigned long long size = (bufferSize - begin < sparseFilePageSize) ? bufferSize - begin : sparseFilePageSize;
+        if ((bitmap[page >> 6] >> (page & 63)) & 1)
+        {
+            --storedPageCount;
+            if (storedPageCount != page)
+                copyMem(buffer + begin, buffer + storedPageCount * sparseFilePageSize, size);
+        }
+        else
+        {
+            setMem(buffer + begin, size, 0);
+        }
+    }
+
+    freePool(bitmap);
+    return bufferSize;
+}
+
+// Load file saved with saveSparse() (or save()) into buffer of bufferSize bytes. Returns bufferSize on success, a
+// different size or -1 on error.
+static long long loadSparse(const CHAR16* fileName, unsigned long long bufferSize, unsigned char* buffer, const CHAR16* directory = NULL)
+{
+    return expandSparse(bufferSize, buffer, loadUpTo(fileName, bufferSize, buffer, directory));
+}
+
+
+// Zero-run encoding for buffers with many zero areas of any size, such as contract states with sparsely used arrays of
+// small records (finer grained than the pages of the sparse format). The data is split into 8-byte words and each
+// run of at least zeroRunMinWords zero words is replaced by a count.
+//
+// File layout: sequence of ZeroRunToken, each followed by its literal bytes, followed by a ZeroRunFileTrailer. As with
+// saveSparse(), the plain format is used if the encoding wouldn't save space, so the formats can be told apart by the
+// file size.
+
+static constexpr unsigned long long zeroRunFileMagic = 0x3130304e55525a51ULL; // "QZRUN001"
+static constexpr unsigned long long zeroRunMinWords = 2;
+
+struct ZeroRunToken
+{
+    unsigned int zeroSize;      // number of zero bytes
+    unsigned int literalSize;   // number of bytes following the token
+};
+
+struct ZeroRunFileTrailer
+{
+    unsigned long long magic;
+    unsigned long long bufferSize;
+};
+
+// Encode buffer into encoded (of bufferSize bytes). Returns size of encoded data including trailer or 0 if it
+// wouldn't be smaller than the buffer.
+static unsigned long long encodeZeroRuns(const unsigned char* buffer, unsigned long long bufferSize, unsigned char* encoded)
+{
+    if (bufferSize <= sizeof(ZeroRunToken) + sizeof(ZeroRunFileTrailer) || bufferSize > 0xffffffffULL)
+        return 0;
+    const unsigned long long maxEncodedSize = bufferSize - sizeof(ZeroRunFileTrailer) - 1;
+    const unsigned long long* words = (const unsigned long long*)buffer;
+    const unsigned long long wordCount = bufferSize / 8;
+    unsigned long long encodedSize = 0;
+    unsigned long long i = 0;
+    while (i < wordCount)
+    {
+        const unsigned long long zeroBegin = i;
+        while (i < wordCount && !words[i])
+            ++i;
+
+        // literal ends before the next run of at least zeroRunMinWords zero words
+        const unsigned long long literalBegin = i;
+        while (i < wordCount)
+        {
+            if (words[i])
+            {
+                ++i;
+                continue;
+            }
+            unsigned long long j = i;
+            while (j < wordCount && !words[j] && j - i < zeroRunMinWords)
+                ++j;
+            if (j - i >= zeroRunMinWords || j == wordCount)
+                break;
+            i = j;
+        }
+
+        const unsigned long long literalSize = (i - literalBegin) * 8;
+        if (encodedSize + sizeof(ZeroRunToken) + literalSize > maxEncodedSize)
+            return 0;
+        ZeroRunToken* token = (ZeroRunToken*)(encoded + encodedSize);
+        token->zeroSize = (unsigned int)((literalBegin - zeroBegin) * 8);
+        token->literalSize = (unsigned int)literalSize;
+        copyMem(token + 1, buffer + literalBegin * 8, literalSize);
+        encodedSize += sizeof(ZeroRunToken) + literalSize;
+    }
+
+    // bytes after the last full word are always stored as literal
+    const unsigned long long tailSize = bufferSize - wordCount * 8;
+    if (tailSize)
+    {
+        if (encodedSize + sizeof(ZeroRunToken) + tailSize > maxEncodedSize)
+            return 0;
+        ZeroRunToken* token = (ZeroRunToken*)(encoded + encodedSize);
+        token->zeroSize = 0;
+        token->literalSize = (unsigned int)tailSize;
+        copyMem(token + 1, buffer + wordCount * 8, tailSize);
+        encodedSize += sizeof(ZeroRunToken) + tailSize;
+    }
+
+    ZeroRunFileTrailer* trailer = (ZeroRunFileTrailer*)(encoded + encodedSize);
+    trailer->magic = zeroRunFileMagic;
+    trailer->bufferSize = bufferSize;
+    return encodedSize + sizeof(ZeroRunFileTrailer);
+}
+
+// Check if data of encodedSize bytes ends with the trailer of zero-run encoded data of a buffer of bufferSize bytes.
+static bool isZeroRunEncoded(const unsigned char* encoded, unsigned long long encodedSize, unsigned long long bufferSize)
+{
+    if (encodedSize < sizeof(ZeroRunFileTrailer) || encodedSize >= bufferSize)
+        return false;
+    const ZeroRunFileTrailer* trailer = (const ZeroRunFileTrailer*)(encoded + encodedSize - sizeof(ZeroRunFileTrailer));
+    return trailer->magic == zeroRunFileMagic && trailer->bufferSize == bufferSize;
+}
+
+// Decode zero-run encoded data (including trailer) into buffer of bufferSize bytes. Returns false if the encoded data
+// is invalid.
+static bool decodeZeroRuns(const unsigned char* encoded, unsigned long long encodedSize, unsigned char* buffer, unsigned long long bufferSize)
+{
+    if (!isZeroRunEncoded(encoded, encodedSize, bufferSize))
+        return false;
+    const unsigned long long tokensSize = encodedSize - sizeof(ZeroRunFileTrailer);
+    unsigned long long encodedOffset = 0;
+    unsigned long long bufferOffset = 0;
+    while (encodedOffset < tokensSize)
+    {
+        if (tokensSize - encodedOffset < sizeof(ZeroRunToken))
+            return false;
+        const ZeroRunToken* token = (const ZeroRunToken*)(encoded + encodedOffset);
+        encodedOffset += sizeof(ZeroRunToken);
+        if (token->literalSize > tokensSize - encodedOffset
+            || (unsigned long long)token->zeroSize + token->literalSize > bufferSize - bufferOffset)
+            return false;
+        setMem(buffer + bufferOffset, token->zeroSize, 0);
+        bufferOffset += token->zeroSize;
+        copyMem(buffer + bufferOffset, encoded + encodedOffset, token->literalSize);
+        bufferOffset += token->literalSize;
+        encodedOffset += token->literalSize;
+    }
+
+    // trailing zero words don't need a token
+    setMem(buffer + bufferOffset, bufferSize - bufferOffset, 0);
+    return true;
+}
+
+// Save buffer zero-run encoded if this saves space and in plain format otherwise. The encoded data is built in scratch
+// (of bufferSize bytes) first, so the buffer may be changed while the file is written. Returns number of bytes written
+// or -1 on error.
+static long long saveZeroRunEncoded(const CHAR16* fileName, unsigned long long bufferSize, const unsigned char* buffer,
+    unsigned char* scratch, const CHAR16* directory = NULL)
+{
+    const unsigned long long encodedSize = encodeZeroRuns(buffer, bufferSize, scratch);
+    if (!encodedSize)
+        return save(fileName, bufferSize, buffer, directory);
+    return save(fileName, encodedSize, scratch, directory);
+}
+
+// Decode zero-run encoded file that has been loaded into the beginning of buffer (loadedSize bytes), using scratch of
+// loadedSize bytes. Returns bufferSize on success. If the loaded data isn't zero-run encoded, the buffer isn't changed
+// and loadedSize is returned. Returns -1 if the encoded data is invalid.
+static long long expandZeroRunEncoded(unsigned long long bufferSize, unsigned char* buffer, long long loadedSize, unsigned char* scratch)
+{
+    if (loadedSize < 0 || !isZeroRunEncoded(buffer, loadedSize, bufferSize))
+        return loadedSize;
+    copyMem(scratch, buffer, loadedSize);
+    return decodeZeroRuns(scratch, loadedSize, buffer, bufferSize) ? (long long)bufferSize : -1;
+}
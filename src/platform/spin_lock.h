@@ -0,0 +1,176 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+#include "concurrency.h"
+
+// Contention counters of a lock. They are compiled into release builds, so hot locks can be identified in production
+// (see logInfo() and RequestLockStats). Counters are only written by the processor holding the lock (except for read
+// acquisitions of ReadWriteLock, which are only counted if TRACK_READ_WRITE_LOCK_STATISTICS is defined), so they don't
+// need atomic operations in the common case.
+struct LockStatistics
+{
+    // Number of times the lock has been acquired
+    unsigned long long acquisitionCount;
+
+    // Number of acquisitions that had to wait, because the lock was held by another processor
+    unsigned long long contendedAcquisitionCount;
+
+    // Sum of CPU ticks (TSC) spent waiting in contended acquisitions
+    unsigned long long spinCycles;
+
+    void reset()
+    {
+        acquisitionCount = 0;
+        contendedAcquisitionCount = 0;
+        spinCycles = 0;
+    }
+};
+
+// Maximum number of _mm_pause() between two attempts to get the lock in exponential backoff
+static constexpr unsigned int spinLockMaxBackoff = 1024;
+
+// Spin lock with exponential backoff and contention statistics, replacing volatile char locks used with ACQUIRE() and
+// RELEASE() for locks that may be hot. Waiting processors poll the lock less often the longer they wait, which reduces
+// cache line ping-pong between the processors.
+//
+// If ticketFair is true, the lock is a ticket lock, which grants the lock in order of arrival, so no processor can
+// starve. Waiting processors back off proportionally to their position in the queue. This is useful for locks with
+// many waiting processors, but the next processor in the queue has to be running to make progress.
+//
+// An object with all bytes zero is a valid unlocked lock, so it can be used in global variables without constructor.
+template <bool ticketFair = false>
+class SpinLock
+{
+public:
+    // Set lock to unlocked state and reset statistics.
+    void reset()
+    {
+        flag = 0;
+        nextTicket = 0;
+        nowServing = 0;
+        stats.reset();
+    }
+
+    // Acquire lock, wait if needed.
+    void acquire()
+    {
+        if (ticketFair)
+        {
+            const unsigned int ticket = (unsigned int)_InterlockedIncrement((volatile long*)&nextTicket) - 1;
+            if (nowServing != ticket)
+                waitForTicket(ticket);
+        }
+        else
+        {
+            if (_InterlockedCompareExchange8(&flag, 1, 0))
+                waitForFlag();
+        }
+        ++stats.acquisitionCount;
+    }
+
+    // Try to acquire lock without waiting. Return true if lock has been acquired.
+    bool tryAcquire()
+    {
+        if (ticketFair)
+        {
+            // only take a ticket if it is served immediately
+            const unsigned int ticket = nowServing;
+            if (nextTicket != ticket || (unsigned int)_InterlockedCompareExchange((volatile long*)&nextTicket, ticket + 1, ticket) != ticket)
+                return false;
+        }
+        else
+        {
+            if (_InterlockedCompareExchange8(&flag, 1, 0))
+                return false;
+        }
+        ++stats.acquisitionCount;
+        return true;
+    }
+
+    // Release lock. Needs to follow acquire() or successful tryAcquire().
+    void release()
+    {
+        if (ticketFair)
+        {
+            // only the holder of the lock changes nowServing
+            nowServing = nowServing + 1;
+        }
+        else
+        {
+            flag = 0;
+        }
+    }
+
+    // Return if lock is currently held. Note that the status may change any time.
+    bool isLocked() const
+    {
+        return (ticketFair) ? nextTicket != nowServing : flag != 0;
+    }
+
+    // Return contention statistics (may be slightly inconsistent if the lock is currently used)
+    const LockStatistics& getStatistics() const
+    {
+        return stats;
+    }
+
+private:
+    void waitForFlag()
+    {
+        const unsigned long long startTsc = __rdtsc();
+#ifndef NDEBUG
+        BusyWaitingTracker bwt("SpinLock::acquire()", __FILE__, __LINE__);
+#endif
+        unsigned int backoff = 1;
+        while (1)
+        {
+            // only try the expensive atomic operation if the lock seems to be free
+            for (unsigned int i = 1; i < backoff; ++i)
+                _mm_pause();
+#ifndef NDEBUG
+            bwt.pause();
+#else
+            _mm_pause();
+#endif
+            if (!flag && !_InterlockedCompareExchange8(&flag, 1, 0))
+                break;
+            if (backoff < spinLockMaxBackoff)
+                backoff *= 2;
+        }
+        ++stats.contendedAcquisitionCount;
+        stats.spinCycles += __rdtsc() - startTsc;
+    }
+
+    void waitForTicket(unsigned int ticket)
+    {
+        const unsigned long long startTsc = __rdtsc();
+#ifndef NDEBUG
+        BusyWaitingTracker bwt("SpinLock::acquire()", __FILE__, __LINE__);
+#endif
+        unsigned int queuePosition;
+        while ((queuePosition = ticket - nowServing) != 0)
+        {
+            // each processor ahead in the queue holds the lock for a while, so wait longer if the queue is long
+            unsigned int backoff = queuePosition * 32;
+            if (backoff > spinLockMaxBackoff)
+                backoff = spinLockMaxBackoff;
+            for (unsigned int i = 1; i < backoff; ++i)
+                _mm_pause();
+#ifndef NDEBUG
+            bwt.pause();
+#else
+            _mm_pause();
+#endif
+        }
+        ++stats.contendedAcquisitionCount;
+        stats.spinCycles += __rdtsc() - startTsc;
+    }
+
+    // Lock flag used if ticketFair is false (1 = locked)
+    volatile char flag;
+
+    // Ticket counters used if ticketFair is true, locked if nextTicket != nowServing
+    volatile unsigned int nextTicket;
+    volatile unsigned int nowServing;
+
+    LockStatistics stats;
+};
@@ -9,6 +9,7 @@
 #include <lib/platform_common/qintrin.h>
 
 #include "global_var.h"
+#include "platform/assert.h"
 #include "console_logging.h"
 
 #include <lib/platform_common/sleep.h>
@@ -16,6 +17,9 @@
 // frequency of CPU clock
 GLOBAL_VAR_DECL unsigned long long frequency GLOBAL_VAR_INIT(0);
 
+// TSC value at the end of initTimeStampCounter(), origin of monotonicMilliseconds()
+GLOBAL_VAR_DECL unsigned long long monotonicClockOriginTsc GLOBAL_VAR_INIT(0);
+
 
 static void initTimeStampCounter()
 {
@@ -40,4 +44,21 @@ static void initTimeStampCounter()
     appendNumber(message, frequency, TRUE);
     appendText(message, L" Hz.");
     logToConsole(message);
+
+    monotonicClockOriginTsc = __rdtsc();
+}
+
+// Convert TSC ticks to milliseconds (without overflow for the full range of ticks)
+static inline unsigned long long ticksToMilliseconds(unsigned long long ticks)
+{
+    ASSERT(frequency);
+    return (ticks / frequency) * 1000 + (ticks % frequency) * 1000 / frequency;
+}
+
+// Milliseconds since initTimeStampCounter(). Use this instead of utcTime for measuring elapsed time: it can be
+// read on any processor without the slow runtime service GetTime() (which only the main processor may call), it
+// has millisecond resolution, and it doesn't jump if the wall clock is set.
+static inline unsigned long long monotonicMilliseconds()
+{
+    return ticksToMilliseconds(__rdtsc() - monotonicClockOriginTsc);
 }
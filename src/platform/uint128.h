@@ -22,6 +22,31 @@
 #pragma once
 
 #include <lib/platform_common/qstdint.h>
+#include <lib/platform_common/qintrin.h>
+
+#if defined(__SIZEOF_INT128__)
+// 128-bit integer of GCC and Clang. __extension__ keeps -Wpedantic from warning about this non-standard type.
+__extension__ typedef unsigned __int128 uint128_native_t;
+#endif
+
+// Multiply a and b, return low 64 bits of the 128-bit product and store high 64 bits in high
+static inline uint64_t uint128_mul64(uint64_t a, uint64_t b, uint64_t* high){
+#if defined(_MSC_VER) && !defined(__clang__)
+	return _umul128(a, b, high);
+#elif defined(__SIZEOF_INT128__)
+	const uint128_native_t product = (uint128_native_t)a * b;
+	*high = (uint64_t)(product >> 64);
+	return (uint64_t)product;
+#else
+	const uint64_t ll = (a & 0xffffffff) * (b & 0xffffffff);
+	const uint64_t lh = (a & 0xffffffff) * (b >> 32);
+	const uint64_t hl = (a >> 32) * (b & 0xffffffff);
+	const uint64_t hh = (a >> 32) * (b >> 32);
+	const uint64_t mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+	*high = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | (ll & 0xffffffff);
+#endif
+}
 
 class uint128_t{
 public:
@@ -190,6 +215,35 @@ public:
 	}
 
 	void divmod(const uint128_t & lhs, const uint128_t & rhs, uint128_t& q, uint128_t& r) const{
+		// Fast paths with native 128-bit division, giving the same results as the long division below, which is
+		// kept for division by 0 and for divisors the compiler can't handle natively
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+		if (!rhs.high && rhs.low){
+			if (!lhs.high){
+				q = uint128_t(0, lhs.low / rhs.low);
+				r = uint128_t(0, lhs.low % rhs.low);
+				return;
+			}
+			// high word of quotient first, so that the 128/64 division of the rest doesn't overflow
+			uint64_t rem = lhs.high % rhs.low;
+			const uint64_t qHigh = lhs.high / rhs.low;
+			const uint64_t qLow = _udiv128(rem, lhs.low, rhs.low, &rem);
+			q = uint128_t(qHigh, qLow);
+			r = uint128_t(0, rem);
+			return;
+		}
+#elif defined(__SIZEOF_INT128__)
+		if (rhs.high | rhs.low){
+			const uint128_native_t a = ((uint128_native_t)lhs.high << 64) | lhs.low;
+			const uint128_native_t b = ((uint128_native_t)rhs.high << 64) | rhs.low;
+			const uint128_native_t quotient = a / b;
+			const uint128_native_t remainder = a % b;
+			q = uint128_t((uint64_t)(quotient >> 64), (uint64_t)quotient);
+			r = uint128_t((uint64_t)(remainder >> 64), (uint64_t)remainder);
+			return;
+		}
+#endif
+
 		// Save some calculations /////////////////////
 		//if (rhs == uint128_0){
 		//	throw std::domain_error("Error: division or modulus by 0");
@@ -236,51 +290,9 @@ public:
 	}
 
 	uint128_t operator*(const uint128_t& rhs) const{
-		// split values into 4 32-bit parts
-		uint64_t top[4] = {high >> 32, high & 0xffffffff, low >> 32, low & 0xffffffff};
-
-		uint64_t bottom[4] = {rhs.high >> 32, rhs.high & 0xffffffff, rhs.low >> 32, rhs.low & 0xffffffff};
-		uint64_t products[4][4];
-
-		// multiply each component of the values
-		for(int y = 3; y > -1; y--){
-			for(int x = 3; x > -1; x--){
-				products[3 - x][y] = top[x] * bottom[y];
-			}
-		}
-
-		// first row
-		uint64_t fourth32 = (products[0][3] & 0xffffffff);
-		uint64_t third32  = (products[0][2] & 0xffffffff) + (products[0][3] >> 32);
-		uint64_t second32 = (products[0][1] & 0xffffffff) + (products[0][2] >> 32);
-		uint64_t first32  = (products[0][0] & 0xffffffff) + (products[0][1] >> 32);
-
-		// second row
-		third32  += (products[1][3] & 0xffffffff);
-		second32 += (products[1][2] & 0xffffffff) + (products[1][3] >> 32);
-		first32  += (products[1][1] & 0xffffffff) + (products[1][2] >> 32);
-
-		// third row
-		second32 += (products[2][3] & 0xffffffff);
-		first32  += (products[2][2] & 0xffffffff) + (products[2][3] >> 32);
-
-		// fourth row
-		first32  += (products[3][3] & 0xffffffff);
-
-		// move carry to next digit
-		third32  += fourth32 >> 32;
-		second32 += third32  >> 32;
-		first32  += second32 >> 32;
-
-		// remove carry from current digit
-		fourth32 &= 0xffffffff;
-		third32  &= 0xffffffff;
-		second32 &= 0xffffffff;
-		first32  &= 0xffffffff;
-
-		// printf("%llx, %llx, %llx, %llx\n", fourth32, second32, third32, fourth32);
-
-		// combine components
-		return uint128_t((first32<<32|second32), (third32<<32|fourth32));
+		// full product of low words plus low words of cross products (higher terms overflow 128 bits)
+		uint64_t productHigh;
+		const uint64_t productLow = uint128_mul64(low, rhs.low, &productHigh);
+		return uint128_t(productHigh + high * rhs.low + low * rhs.high, productLow);
 	}
 };
\ No newline at end of file
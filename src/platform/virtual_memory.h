@@ -2,10 +2,12 @@
 
 #include "platform/m256.h"
 #include "platform/concurrency.h"
+#include "platform/read_write_lock.h"
 #include "platform/time.h"
 #include "platform/memory_util.h"
 #include "platform/debugging.h"
 #include "platform/file_io.h"
+#include "platform/compression.h"
 
 #include "four_q.h"
 #include "kangaroo_twelve.h"
@@ -28,9 +30,19 @@ inline constexpr const T& min(const T& left, const T& right)
 // template variables meaning:
 // prefixName is used for generating page file names on disk, it must be unique if there are multiple VirtualMemory instances
 // pageCapacity is number of items (T) inside a page
-// it stores (numCachePage) pages on RAM for faster loading (the strategy mimics CPU cache lines)
+// it stores (numCachePage) pages on RAM for faster loading, evicting the least recently used page on a miss
+// (cached pages are found with a hash table, the LRU order is kept in an intrusive doubly linked list)
+// locking: appenders are serialized by memLock and only write behind currentId, so readers of cached pages and of
+// the current page (shared pageLock) run concurrently with each other and with appending. pageLock is acquired
+// exclusively for moving a full page into the cache and for loading a page from disk.
+// read-ahead: if pages are read sequentially, the next (numReadAheadPages) pages are loaded asynchronously by
+// AsyncFileIO into cache slots, so streaming reads are served from RAM instead of waiting for disk on every page.
+// if compressPages is true, pages are compressed before being written to disk (needs one more page of RAM as
+// compression buffer). A page file is either a raw page (pageSize bytes) or a compressed page (smaller than pageSize,
+// starting with CompressedPageHeader), so uncompressed page files can still be read.
 // this class can be used to debug illegal memory access issue
-template <typename T, unsigned long long prefixName, unsigned long long pageDirectory, unsigned long long pageCapacity = 100000, unsigned long long numCachePage = 128>
+template <typename T, unsigned long long prefixName, unsigned long long pageDirectory, unsigned long long pageCapacity = 100000, unsigned long long numCachePage = 128,
+    unsigned long long numReadAheadPages = numCachePage / 4, bool compressPages = false>
 class VirtualMemory
 {
     const unsigned long long pageSize = sizeof(T) * pageCapacity;
@@ -40,12 +52,51 @@ private:
     T* cache[numCachePage + 1];
     CHAR16* pageDir = NULL;
 
-    unsigned long long cachePageId[numCachePage + 1];
-    unsigned long long lastAccessedTimestamp[numCachePage + 1]; // in millisecond
-    unsigned long long currentId; // total items in this array, aka: latest item index + 1
+    static constexpr unsigned long long invalidPageId = 0xffffffffffffffffULL;
+    unsigned long long cachePageId[numCachePage + 1]; // page in cache slot or invalidPageId
+
+    // hash table of cached pages (excluding current page): bucket heads and chains of cache slots (-1 is end)
+    static constexpr unsigned long long computeHashSize()
+    {
+        unsigned long long size = 1;
+        while (size < 2 * (numCachePage + 1))
+            size <<= 1;
+        return size;
+    }
+    static constexpr unsigned long long hashSize = computeHashSize();
+    int hashHead[hashSize];
+    int hashNext[numCachePage + 1];
+
+    // LRU list of cache slots 1..numCachePage, with slot 0 (current page) as sentinel: lruNext[0] is the most
+    // recently used slot, lruPrev[0] the least recently used one
+    int lruPrev[numCachePage + 1];
+    int lruNext[numCachePage + 1];
+    volatile char lruLock; // protects LRU list while pageLock is shared
+
+    // state of asynchronous loads (read-ahead): slot is mapped to its page but cannot be read while slotLoading is
+    // set, slotLoadResult is AsyncFileIO::kPending until the load is done
+    bool slotLoading[numCachePage + 1];
+    volatile long long slotLoadResult[numCachePage + 1];
+    volatile unsigned long long lastReadPageId; // for detecting sequential reads
+
+    // compressed page files
+    struct CompressedPageHeader
+    {
+        unsigned int magic;
+        unsigned int reserved;
+        unsigned long long compressedSize; // size of compressed data following the header
+    };
+    static constexpr unsigned int compressedPageMagic = 0x5a50564d; // "MVPZ"
+    unsigned char* compressionBuffer = NULL; // pageSize bytes, used for compressing and decompressing pages
+    unsigned int* compressionHashTable = NULL;
+    volatile char compressionLock; // protects compression buffer and hash table
+
+    volatile unsigned long long currentId; // total items in this array, aka: latest item index + 1
     unsigned long long currentPageId; // current page index that's written on
+    unsigned long long writtenPageCount; // pages written to disk since reset()
 
-    volatile char memLock; // every read/write needs a memory lock, can optimize later
+    volatile char memLock; // serializes appenders and other modifications
+    ReadWriteLock pageLock; // shared for reading cache pages, exclusive for changing which page is in a slot
 
     void generatePageName(CHAR16 pageName[64], unsigned long long page_id)
     {
@@ -66,14 +117,38 @@ private:
     {
         CHAR16 pageName[64];
         generatePageName(pageName, currentPageId);
+        const unsigned char* data = (const unsigned char*)currentPage;
+        unsigned long long dataSize = pageSize;
+        if (compressPages)
+        {
+            // store compressed page only if it is smaller than the raw page (size of file tells which format is used)
+            ACQUIRE(compressionLock);
+            const unsigned long long compressedSize = (pageSize > sizeof(CompressedPageHeader) + 1) ?
+                compressBlock(data, pageSize, compressionBuffer + sizeof(CompressedPageHeader), pageSize - sizeof(CompressedPageHeader) - 1, compressionHashTable) : 0;
+            if (compressedSize)
+            {
+                CompressedPageHeader* header = (CompressedPageHeader*)compressionBuffer;
+                header->magic = compressedPageMagic;
+                header->reserved = 0;
+                header->compressedSize = compressedSize;
+                data = compressionBuffer;
+                dataSize = sizeof(CompressedPageHeader) + compressedSize;
+            }
+        }
 #ifdef NO_UEFI
-        auto sz = save(pageName, pageSize, (unsigned char*)currentPage, pageDir);
+        auto sz = save(pageName, dataSize, data, pageDir);
 #else
-        auto sz = asyncSave(pageName, pageSize, (unsigned char*)currentPage, pageDir, true);
+        // Non-blocking: page is copied to write-behind queue (falls back to blocking save if queue is full)
+        auto sz = asyncSave(pageName, dataSize, data, pageDir, false);
 #endif
+        if (compressPages)
+        {
+            RELEASE(compressionLock);
+        }
+        writtenPageCount++;
 
 #if !defined(NDEBUG)
-        if (sz != pageSize)
+        if (sz != dataSize)
         {
             addDebugMessage(L"Failed to store virtualMemory to disk. Old data maybe lost");
         }
@@ -94,31 +169,179 @@ private:
 #endif
     }
 
-    // return the most outdated cache page
+    static unsigned long long hashBucket(unsigned long long pageId)
+    {
+        // page ids are mostly consecutive, so the low bits are well distributed
+        return pageId & (hashSize - 1);
+    }
+
+    void insertIntoHash(int slot)
+    {
+        const unsigned long long bucket = hashBucket(cachePageId[slot]);
+        hashNext[slot] = hashHead[bucket];
+        hashHead[bucket] = slot;
+    }
+
+    void removeFromHash(int slot)
+    {
+        int* link = &hashHead[hashBucket(cachePageId[slot])];
+        while (*link != -1)
+        {
+            if (*link == slot)
+            {
+                *link = hashNext[slot];
+                return;
+            }
+            link = &hashNext[*link];
+        }
+    }
+
+    void unlinkFromLru(int slot)
+    {
+        lruNext[lruPrev[slot]] = lruNext[slot];
+        lruPrev[lruNext[slot]] = lruPrev[slot];
+    }
+
+    void linkAsMostRecentlyUsed(int slot)
+    {
+        lruPrev[slot] = 0;
+        lruNext[slot] = lruNext[0];
+        lruPrev[lruNext[0]] = slot;
+        lruNext[0] = slot;
+    }
+
+    void linkAsLeastRecentlyUsed(int slot)
+    {
+        lruNext[slot] = 0;
+        lruPrev[slot] = lruPrev[0];
+        lruNext[lruPrev[0]] = slot;
+        lruPrev[0] = slot;
+    }
+
+    // return the least recently used cache slot (unused slots first) that isn't being loaded asynchronously,
+    // pageLock must be acquired exclusively
     int getMostOutdatedCachePage()
     {
-        // i = 1 because 0 is used for current page
-        int min_index = 1;
-        for (int i = 1; i <= numCachePage; i++)
+        for (int slot = lruPrev[0]; slot != 0; slot = lruPrev[slot])
         {
-            if (lastAccessedTimestamp[i] == 0)
+            if (!slotLoading[slot] || finishAsyncLoad(slot, false))
             {
-                return i;
+                return slot;
             }
-            if ((lastAccessedTimestamp[i] < lastAccessedTimestamp[min_index]) || (lastAccessedTimestamp[i] == lastAccessedTimestamp[min_index] && cachePageId[i] < cachePageId[min_index]))
+        }
+        // all slots are being loaded (numReadAheadPages >= numCachePage) -> wait for least recently used one
+        finishAsyncLoad(lruPrev[0], true);
+        return lruPrev[0];
+    }
+
+    // assign page to cache slot and mark it as most recently used, pageLock must be acquired exclusively
+    void assignCacheSlot(int slot, unsigned long long pageId)
+    {
+        if (cachePageId[slot] != invalidPageId)
+        {
+            removeFromHash(slot);
+        }
+        cachePageId[slot] = pageId;
+        if (pageId != invalidPageId)
+        {
+            insertIntoHash(slot);
+        }
+        unlinkFromLru(slot);
+        linkAsMostRecentlyUsed(slot);
+    }
+
+    // check result of loading a page file into slot and decompress it if it is a compressed page. Returns false if the
+    // page file is invalid. pageLock must be acquired exclusively.
+    bool decodeLoadedPage(int slot, long long loadedSize)
+    {
+        if (loadedSize == (long long)pageSize)
+        {
+            // raw page
+            return true;
+        }
+        if (!compressPages || loadedSize < (long long)sizeof(CompressedPageHeader))
+        {
+            return false;
+        }
+        unsigned char* data = (unsigned char*)cache[slot];
+        const CompressedPageHeader* header = (const CompressedPageHeader*)data;
+        const unsigned long long compressedSize = loadedSize - sizeof(CompressedPageHeader);
+        if (header->magic != compressedPageMagic || header->compressedSize != compressedSize)
+        {
+            return false;
+        }
+        ACQUIRE(compressionLock);
+        copyMem(compressionBuffer, data + sizeof(CompressedPageHeader), compressedSize);
+        const bool decompressed = decompressBlock(compressionBuffer, compressedSize, data, pageSize) == (long long)pageSize;
+        RELEASE(compressionLock);
+        return decompressed;
+    }
+
+    // unmap slot and make it the first one to be reused, pageLock must be acquired exclusively
+    void invalidateCacheSlot(int slot)
+    {
+        assignCacheSlot(slot, invalidPageId);
+        unlinkFromLru(slot);
+        linkAsLeastRecentlyUsed(slot);
+    }
+
+    // finish asynchronous load of slot if it is done (or wait for it if wait is true), invalidating the slot if the
+    // load failed. Returns false if the load is still running. pageLock must be acquired exclusively.
+    bool finishAsyncLoad(int slot, bool wait)
+    {
+        if (slotLoadResult[slot] == AsyncFileIO::kPending)
+        {
+            if (!wait)
             {
-                min_index = i;
+                return false;
             }
+            waitForAsyncLoad(&slotLoadResult[slot]);
+            if (slotLoadResult[slot] == AsyncFileIO::kPending)
+            {
+                // file IO has been stopped
+                return false;
+            }
+        }
+        slotLoading[slot] = false;
+        if (!decodeLoadedPage(slot, slotLoadResult[slot]))
+        {
+#if !defined(NDEBUG)
+            addDebugMessage(L"Failed to read ahead virtualMemory page from disk");
+#endif
+            invalidateCacheSlot(slot);
         }
-        return min_index;
+        return true;
+    }
+
+    // start asynchronous load of page into least recently used slot. Returns false if load cannot be scheduled.
+    // pageLock must be acquired exclusively.
+    bool startAsyncLoad(unsigned long long pageId)
+    {
+        CHAR16 pageName[64];
+        generatePageName(pageName, pageId);
+        const int slot = getMostOutdatedCachePage();
+        assignCacheSlot(slot, pageId);
+        slotLoading[slot] = true;
+#ifdef NO_UEFI
+        // no async file IO in tests -> load immediately (slot is still finished lazily like an async load)
+        slotLoadResult[slot] = loadAndProcess(pageName, pageSize, (unsigned char*)cache[slot], pageDir, NULL, NULL, 0, compressPages);
+        const bool started = true;
+#else
+        const bool started = asyncLoadNonBlocking(pageName, pageSize, (unsigned char*)cache[slot], pageDir, &slotLoadResult[slot], compressPages);
+#endif
+        if (!started)
+        {
+            slotLoading[slot] = false;
+            invalidateCacheSlot(slot);
+        }
+        return started;
     }
 
     void copyCurrentPageToCache()
     {
         int cache_slot_idx = getMostOutdatedCachePage();
         copyMem(cache[cache_slot_idx], currentPage, pageSize);
-        lastAccessedTimestamp[cache_slot_idx] = now_ms();
-        cachePageId[cache_slot_idx] = currentPageId;
+        assignCacheSlot(cache_slot_idx, currentPageId);
 #ifndef NDEBUG
         {
             CHAR16 debugMsg[128];
@@ -142,30 +365,56 @@ private:
         setMem(currentPage, pageSize, 0);
     }
 
-    // return cache id given cache_page_id
-    int findCachePage(unsigned long long requested_page_id)
+    // return slot the page is mapped to (including slots being loaded) or -1, without changing the LRU order.
+    // pageLock must be acquired (shared or exclusive)
+    int lookupCachePage(unsigned long long requested_page_id)
     {
-        // TODO: consider implementing a tree here for faster search
-        for (int i = 0; i <= numCachePage; i++)
+        if (cachePageId[0] == requested_page_id)
         {
-            if (cachePageId[i] == requested_page_id)
+            return 0;
+        }
+        for (int slot = hashHead[hashBucket(requested_page_id)]; slot != -1; slot = hashNext[slot])
+        {
+            if (cachePageId[slot] == requested_page_id)
             {
-#ifdef NO_UEFI
-#else
-                lastAccessedTimestamp[i] = now_ms();
-#endif
-                return i;
+                return slot;
             }
         }
         return -1;
     }
 
+    // return cache id given cache_page_id or -1 if the page isn't cached (or still being loaded asynchronously) and
+    // mark it as most recently used, pageLock must be acquired (shared or exclusive)
+    int findCachePage(unsigned long long requested_page_id)
+    {
+        const int slot = lookupCachePage(requested_page_id);
+        if (slot <= 0)
+        {
+            return slot;
+        }
+        if (slotLoading[slot])
+        {
+            return -1;
+        }
+        ACQUIRE(lruLock);
+        unlinkFromLru(slot);
+        linkAsMostRecentlyUsed(slot);
+        RELEASE(lruLock);
+        return slot;
+    }
+
     // load a page from disk to cache
     // if page is already on cache, return the id
-    // return cache index
+    // return cache index, pageLock must be acquired exclusively
     int loadPageToCache(unsigned long long pageId)
     {
-        int cache_page_id = findCachePage(pageId);
+        int cache_page_id = lookupCachePage(pageId);
+        if (cache_page_id > 0 && slotLoading[cache_page_id])
+        {
+            // page is being read ahead -> wait for it instead of loading it again
+            finishAsyncLoad(cache_page_id, true);
+        }
+        cache_page_id = findCachePage(pageId);
 
         if (cache_page_id != -1)
         {
@@ -174,9 +423,11 @@ private:
         CHAR16 pageName[64];
         generatePageName(pageName, pageId);
         cache_page_id = getMostOutdatedCachePage();
+
+        // slot content is overwritten -> invalidate before loading, keeping it least recently used on failure
+        invalidateCacheSlot(cache_page_id);
 #ifdef NO_UEFI
-        auto sz = load(pageName, pageSize, (unsigned char*)cache[cache_page_id], pageDir);
-        lastAccessedTimestamp[cache_page_id] = 0;
+        auto sz = loadAndProcess(pageName, pageSize, (unsigned char*)cache[cache_page_id], pageDir, NULL, NULL, 0, compressPages);
 #else
 #if !defined(NDEBUG)
         {
@@ -186,17 +437,16 @@ private:
             addDebugMessage(debugMsg);
         }
 #endif
-        auto sz = asyncLoad(pageName, pageSize, (unsigned char*)cache[cache_page_id], pageDir);
-        if (sz != pageSize)
+        auto sz = asyncLoad(pageName, pageSize, (unsigned char*)cache[cache_page_id], pageDir, compressPages);
+#endif
+        if (!decodeLoadedPage(cache_page_id, sz))
         {
 #if !defined(NDEBUG)
             addDebugMessage(L"Failed to load virtualMemory from disk");
 #endif
             return -1;
         }
-        lastAccessedTimestamp[cache_page_id] = now_ms();
-#endif
-        cachePageId[cache_page_id] = pageId;
+        assignCacheSlot(cache_page_id, pageId);
 #if !defined(NDEBUG)
         {
             CHAR16 debugMsg[128];
@@ -216,6 +466,85 @@ private:
         return cache_page_id;
     }
 
+    // copy numItems items starting at offsetInPage of page pageId to dst, loading the page to cache if needed.
+    // Cached pages are read with shared pageLock, so multiple readers and the appender can proceed concurrently.
+    // Returns false if the page cannot be loaded (or isn't cached if cachedPagesOnly is set).
+    bool copyFromPage(T* dst, unsigned long long pageId, unsigned long long offsetInPage, unsigned long long numItems, bool cachedPagesOnly)
+    {
+        pageLock.acquireRead();
+        int cache_page_idx = findCachePage(pageId);
+        if (cache_page_idx != -1)
+        {
+            copyMem(dst, cache[cache_page_idx] + offsetInPage, numItems * sizeof(T));
+        }
+        pageLock.releaseRead();
+
+        // cache miss -> load page exclusively (another thread may have loaded it in the meantime)
+        if (cache_page_idx == -1)
+        {
+            if (cachedPagesOnly)
+            {
+                return false;
+            }
+            pageLock.acquireWrite();
+            cache_page_idx = loadPageToCache(pageId);
+            if (cache_page_idx != -1)
+            {
+                copyMem(dst, cache[cache_page_idx] + offsetInPage, numItems * sizeof(T));
+            }
+            pageLock.releaseWrite();
+            if (cache_page_idx == -1)
+            {
+                return false;
+            }
+        }
+        readAhead(pageId);
+        return true;
+    }
+
+    // detect sequential reads (page following the previously read page) and start asynchronous loading of the next
+    // numReadAheadPages pages that are on disk but not in cache
+    void readAhead(unsigned long long pageId)
+    {
+        const unsigned long long previousPageId = lastReadPageId;
+        if (numReadAheadPages == 0 || pageId == previousPageId)
+        {
+            return;
+        }
+        lastReadPageId = pageId;
+        if (pageId != previousPageId + 1)
+        {
+            return;
+        }
+
+        // check with shared lock first, because usually the pages are already cached or being loaded
+        bool allPagesMapped = true;
+        pageLock.acquireRead();
+        for (unsigned long long p = pageId + 1; p <= pageId + numReadAheadPages && p < currentPageId; p++)
+        {
+            if (lookupCachePage(p) == -1)
+            {
+                allPagesMapped = false;
+                break;
+            }
+        }
+        pageLock.releaseRead();
+        if (allPagesMapped)
+        {
+            return;
+        }
+
+        pageLock.acquireWrite();
+        for (unsigned long long p = pageId + 1; p <= pageId + numReadAheadPages && p < currentPageId; p++)
+        {
+            if (lookupCachePage(p) == -1 && !startAsyncLoad(p))
+            {
+                break;
+            }
+        }
+        pageLock.releaseWrite();
+    }
+
     // only call after append
     // check if current page is full
     // if yes, write current page to disk and cache
@@ -224,11 +553,14 @@ private:
     {
         if (currentId % pageCapacity == 0)
         {
+            // full current page isn't changed anymore, so it can be compressed and written while readers proceed
             writeCurrentPageToDisk();
+            pageLock.acquireWrite();
             copyCurrentPageToCache();
             cleanCurrentPage();
             cachePageId[0] = currentId / pageCapacity;
             currentPageId++;
+            pageLock.releaseWrite();
         }
     }
 
@@ -236,22 +568,37 @@ private:
     {
         setMem(currentPage, pageSize * (numCachePage + 1), 0);
         setMem(cachePageId, sizeof(cachePageId), 0xff);
-        setMem(lastAccessedTimestamp, sizeof(lastAccessedTimestamp), 0);
+        setMem(hashHead, sizeof(hashHead), 0xff);
+        setMem(hashNext, sizeof(hashNext), 0xff);
         cachePageId[0] = 0;
+
+        // all slots are unused, slot 1 is used first
+        lruNext[0] = lruPrev[0] = 0;
+        for (int i = 1; i <= numCachePage; i++)
+        {
+            linkAsLeastRecentlyUsed(i);
+        }
+        lruLock = 0;
+        setMem(slotLoading, sizeof(slotLoading), 0);
+        setMem((void*)slotLoadResult, sizeof(slotLoadResult), 0);
+        lastReadPageId = invalidPageId;
+
         currentId = 0;
         currentPageId = 0;
-        memLock = 0;
+        writtenPageCount = 0;
     }
 
 public:
     VirtualMemory()
     {
         memLock = 0;
+        pageLock.reset();
     }
 
     bool init()
     {
         ACQUIRE(memLock);
+        pageLock.reset();
         if (currentPage == NULL)
         {
             if (!allocPoolWithErrorLog(L"VirtualMemory.Page", pageSize * (numCachePage + 1), (void**)&currentPage, __LINE__))
@@ -264,6 +611,15 @@ public:
                 cache[i] = cache[i - 1] + pageCapacity;
             }
         }
+        if (compressPages && compressionBuffer == NULL)
+        {
+            if (!allocPoolWithErrorLog(L"VirtualMemory.CompressionBuffer", pageSize, (void**)&compressionBuffer, __LINE__)
+                || !allocPoolWithErrorLog(L"VirtualMemory.CompressionHashTable", COMPRESSION_HASH_TABLE_SIZE * sizeof(unsigned int), (void**)&compressionHashTable, __LINE__))
+            {
+                return false;
+            }
+        }
+        compressionLock = 0;
 
         if (pageDir == NULL)
         {
@@ -316,98 +672,58 @@ public:
             freePool(pageDir);
             pageDir = NULL;
         }
+        if (compressionBuffer != NULL)
+        {
+            freePool(compressionBuffer);
+            compressionBuffer = NULL;
+        }
+        if (compressionHashTable != NULL)
+        {
+            freePool(compressionHashTable);
+            compressionHashTable = NULL;
+        }
     }
 
     // getMany: 
     // this operation copies numItems * sizeof(T) bytes from [src+offset] to [dst] - note that src and dst are T* not char*
     // offset + numItems must be less than currentId
+    // if cachedPagesOnly is set, no page is loaded from disk (nothing is copied if a page isn't cached)
     // return number of items has been copied
-    unsigned long long getMany(T* dst, unsigned long long offset, unsigned long long numItems)
+    unsigned long long getMany(T* dst, unsigned long long offset, unsigned long long numItems, bool cachedPagesOnly = false)
     {
-        ACQUIRE(memLock);
         ASSERT(offset + numItems - 1 < currentId);
         if (offset + numItems - 1 >= currentId)
         {
-            RELEASE(memLock);
             return 0;
         }
-        RELEASE(memLock);
 
         // processing
         unsigned long long c_bytes = 0;
-        unsigned long long p_start = offset;
-        unsigned long long p_end = offset + numItems;
+        T* const dstBegin = dst;
 
         // visualizer:
         // [     PAGE N    ] [ PAGE N + 1] [ PAGE N + 2] [ PAGE N + 3] ... [ PAGE N + K-2 ] [ PAGE N + K-1 ] [ PAGE N + K ]
         //        ^[                        REQUESTED MEMORY REGION                               ]^
         //         [HEAD   ] [                            BODY                            ] [TAIL ]
-
-        // HEAD
-        unsigned long long hs = offset; // head start
-        unsigned long long rhs = (hs / pageCapacity) * pageCapacity; // rounded hs
-        unsigned long long r_page_id = rhs / pageCapacity;
-        unsigned long long he = min(rhs + pageCapacity, offset + numItems); // head end
-        unsigned long long n_item = he - hs; // copy [hs, he)
-        ACQUIRE(memLock);
-        int cache_page_idx = loadPageToCache(r_page_id);
-        if (cache_page_idx == -1)
-        {
-#if !defined(NDEBUG)
-            addDebugMessage(L"Invalid cache page index, return zeroes array");
-#endif
-            setMem(dst, numItems * sizeof(T), 0);
-            RELEASE(memLock);
-            return 0;
-        }
-        copyMem(dst, cache[cache_page_idx] + (hs % pageCapacity), n_item * sizeof(T));
-        dst += n_item;
-        c_bytes += n_item * sizeof(T);
-        RELEASE(memLock);
-        // BODY
-        unsigned long long bs = he; //bodystart
-        if (he < p_end && (p_end - he) >= pageCapacity) // need to copy fullpage in the "middle"
+        // every part is copied from one page: [p_start, p_end) is clipped to the page of p_start
+        unsigned long long p_start = offset;
+        const unsigned long long p_end = offset + numItems;
+        while (p_start < p_end)
         {
-            for (bs = he; bs + pageCapacity <= p_end; bs += pageCapacity)
+            const unsigned long long r_page_id = p_start / pageCapacity;
+            const unsigned long long n_item = min((r_page_id + 1) * pageCapacity, p_end) - p_start;
+            if (!copyFromPage(dst, r_page_id, p_start % pageCapacity, n_item, cachedPagesOnly))
             {
-                r_page_id = bs / pageCapacity;
-                ACQUIRE(memLock);
-                cache_page_idx = loadPageToCache(r_page_id);
-                if (cache_page_idx == -1)
-                {
 #if !defined(NDEBUG)
+                if (!cachedPagesOnly)
                     addDebugMessage(L"Invalid cache page index, return zeroes array");
 #endif
-                    setMem(dst, numItems * sizeof(T), 0);
-                    RELEASE(memLock);
-                    return 0;
-                }
-                copyMem(dst, cache[cache_page_idx], pageSize);
-                dst += pageCapacity;
-                c_bytes += pageSize;
-                RELEASE(memLock);
-            }
-        }
-        // TAIL
-        if (bs < p_end)
-        {
-            r_page_id = bs / pageCapacity;
-            n_item = p_end - bs; // copy [bs, p_end)
-            ACQUIRE(memLock);
-            int cache_page_idx = loadPageToCache(r_page_id);
-            if (cache_page_idx == -1)
-            {
-#if !defined(NDEBUG)
-                addDebugMessage(L"Invalid cache page index, return zeroes array");
-#endif
-                setMem(dst, numItems * sizeof(T), 0);
-                RELEASE(memLock);
+                setMem(dstBegin, numItems * sizeof(T), 0);
                 return 0;
             }
-            copyMem(dst, cache[cache_page_idx], n_item * sizeof(T));
             dst += n_item;
             c_bytes += n_item * sizeof(T);
-            RELEASE(memLock);
+            p_start += n_item;
         }
         return c_bytes;
     }
@@ -466,26 +782,7 @@ public:
     T get(unsigned long long index)
     {
         T result;
-        ACQUIRE(memLock);
-        if (index >= currentId) // out of bound
-        {
-            setMem(&result, sizeof(T), 0);
-            RELEASE(memLock);
-            return result;
-        }
-        unsigned long long requested_page_id = index / pageCapacity;
-        int cache_page_idx = loadPageToCache(requested_page_id);
-        if (cache_page_idx == -1)
-        {
-#if !defined(NDEBUG)
-            addDebugMessage(L"Invalid cache page index, return zeroes array");
-#endif
-            setMem(&result, sizeof(T), 0);
-            RELEASE(memLock);
-            return result;
-        }
-        result = cache[cache_page_idx][index % pageCapacity];
-        RELEASE(memLock);
+        getOne(index, &result);
         return result;
     }
 
@@ -494,27 +791,18 @@ public:
     // if index is not in cache it will load the page to most outdated cache
     void getOne(unsigned long long index, T* result)
     {
-        ACQUIRE(memLock);
         if (index >= currentId) // out of bound
         {
             setMem(result, sizeof(T), 0);
-            RELEASE(memLock);
             return;
         }
-        unsigned long long requested_page_id = index / pageCapacity;
-        int cache_page_idx = loadPageToCache(requested_page_id);
-        if (cache_page_idx == -1)
+        if (!copyFromPage(result, index / pageCapacity, index % pageCapacity, 1, false))
         {
 #if !defined(NDEBUG)
             addDebugMessage(L"Invalid cache page index, return zeroes array");
 #endif
             setMem(result, sizeof(T), 0);
-            RELEASE(memLock);
-            return;
         }
-        copyMem(result, &(cache[cache_page_idx][index % pageCapacity]), sizeof(T));
-        RELEASE(memLock);
-        return;
     }
 
     T operator[](unsigned long long index)
@@ -542,8 +830,16 @@ public:
         return currentId;
     }
 
+    // Number of full pages written to disk since init or reset
+    unsigned long long getWrittenPageCount()
+    {
+        return writtenPageCount;
+    }
+
     // delete a page on disk given pageId
-    bool prune(unsigned long long pageId)
+    // With background = true, the removal is only queued (see asyncRemoveFileInBackground()), so the caller doesn't
+    // wait for the file system and appenders aren't blocked while the file is removed.
+    bool prune(unsigned long long pageId, bool background = false)
     {
         if (pageId > currentPageId)
         {
@@ -551,6 +847,10 @@ public:
         }
         CHAR16 pageName[64];
         generatePageName(pageName, pageId);
+        if (background)
+        {
+            return asyncRemoveFileInBackground(pageName, pageDir) == 0;
+        }
         ACQUIRE(memLock);
         bool success = (asyncRemoveFile(pageName, pageDir)) == 0;
         RELEASE(memLock);
@@ -562,7 +862,7 @@ public:
     // fromPageId = (fromId + pageCapacity - 1) // pageCapacity
     // toPageId = (toId   - pageCapacity + 1) // pageCapacity
     // eg: pageCapacity is 50'000. To delete the second page, call prune(50000, 99999)
-    bool pruneRange(long long fromId, long long toId)
+    bool pruneRange(long long fromId, long long toId, bool background = false)
     {
         long long fromPageId = (fromId + pageCapacity - 1) / pageCapacity;
         long long toPageId = (toId - pageCapacity + 1) / pageCapacity;
@@ -585,7 +885,7 @@ public:
         bool success = true;
         for (long long i = fromPageId; i <= toPageId; i++)
         {
-            bool ret = prune(i);
+            bool ret = prune(i, background);
             success &= ret;
             if (!ret) return success;
         }
@@ -642,6 +942,7 @@ public:
     {
         ACQUIRE(memLock);
         unsigned long long ret = 0;
+        pageLock.acquireWrite();
         copyMem(currentPage, buffer, pageSize);
         ret += pageSize;
         buffer += pageSize;
@@ -655,7 +956,7 @@ public:
         ret += 8;
 
         cachePageId[0] = currentPageId;
-        lastAccessedTimestamp[0] = now_ms();
+        pageLock.releaseWrite();
         RELEASE(memLock);
         return ret;
     }
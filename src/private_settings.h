@@ -38,6 +38,7 @@ static const unsigned char oracleMachineIPs[][4] = {
 #define PMAP_LOG_PAGE_SIZE 30000000ULL
 #define IMAP_LOG_PAGE_SIZE 10000ULL
 #define VM_NUM_CACHE_PAGE 8
+#define VM_COMPRESS_PAGES 0 // if 1, compress log pages on disk (needs RAM for one more page per log buffer; files are not readable by older versions)
 
 #if ENABLE_QUBIC_LOGGING_EVENT
 // DO NOT MODIFY THIS AREA UNLESS YOU ARE DEVELOPING LOGGING FEATURES
@@ -74,4 +75,19 @@ static unsigned long long logReaderPasscodes[4] = {
 // Perform state persisting when your node is misaligned will also make your node misaligned after resuming.
 // Thus, picking various TICK_STORAGE_AUTOSAVE_TICK_PERIOD numbers across AUX nodes is recommended.
 // some suggested prime numbers you can try: 971 977 983 991 997
-#define TICK_STORAGE_AUTOSAVE_TICK_PERIOD 1000
\ No newline at end of file
+#define TICK_STORAGE_AUTOSAVE_TICK_PERIOD 1000
+
+// Tiered tick storage:
+// 0: keep all ticks of the epoch in RAM
+// 1: keep only the last TICK_STORAGE_RAM_TICKS ticks in RAM and move older ticks to append-only archive files
+//    (read through a small cache), which reduces the RAM needed by tick storage from hundreds of GB to a few GB.
+//    Cannot be combined with TICK_STORAGE_AUTOSAVE_MODE.
+#define TICK_STORAGE_TIERED_MODE 0
+#define TICK_STORAGE_RAM_TICKS 2048
+
+// Periodic status output (logInfo(), logHealthStatus()) is queued and written to the console in small time slices
+// of the main loop with at most CONSOLE_OUTPUT_MAX_CHARS_PER_SECOND characters per second, because console output
+// is slow and delays network polling. Set to 0 to write all output directly. Each time slice writes at most
+// CONSOLE_OUTPUT_MAX_CHARS_PER_RENDER characters (plus the rest of a started line).
+#define CONSOLE_OUTPUT_MAX_CHARS_PER_SECOND 20000
+#define CONSOLE_OUTPUT_MAX_CHARS_PER_RENDER 1000
\ No newline at end of file
@@ -18,9 +18,43 @@
 // is MAX_NUMBER_OF_PROCESSORS - 1.
 #define NUMBER_OF_CONTRACT_EXECUTION_BUFFERS 10
 
+// If 1, the node allocates one contract execution buffer for the contract processor and each request processor at startup, limited to
+// NUMBER_OF_CONTRACT_EXECUTION_BUFFERS (which should be raised to MAX_NUMBER_OF_PROCESSORS - 1 then). If 0, it always allocates
+// NUMBER_OF_CONTRACT_EXECUTION_BUFFERS.
+#define CONTRACT_EXECUTION_BUFFERS_BY_PROCESSOR_COUNT 0
+
+// If 1, contract functions requested via network run on a read-only copy of the contract state published at the end of each tick,
+// so they don't delay procedures executed by the tick processor. This needs RAM for two copies of each contract state.
+#define CONTRACT_FUNCTION_STATE_SNAPSHOTS 0
+
+// Number of cached outputs of contract functions requested via network (has to be 2^N, 0 disables the cache). Identical queries
+// are answered from the cache until the tick or the contract state snapshot changes, so the cache is only used with
+// CONTRACT_FUNCTION_STATE_SNAPSHOTS.
+// Each entry needs CONTRACT_FUNCTION_CACHE_MAX_OUTPUT_SIZE bytes of RAM; larger outputs are not cached.
+#define CONTRACT_FUNCTION_CACHE_SIZE 2048
+#define CONTRACT_FUNCTION_CACHE_MAX_OUTPUT_SIZE 16384
+
+// If 1, the contract state snapshots also track in which snapshot version each page of the state changed last, so external indexers
+// can mirror contract states incrementally with RequestContractStateChanges. This requires CONTRACT_FUNCTION_STATE_SNAPSHOTS.
+// Responses are much larger than requests, so only enable this on nodes serving indexers.
+#define CONTRACT_STATE_CHANGE_TRACKING 0
+
+// Number of processors helping the contract processor with running BEGIN_TICK and END_TICK of contracts that declare them
+// independent (TICK_HOOKS_ACCESS_ONLY_OWN_STATE()). They are taken from the request processors if at least 2 request processors
+// remain. 0 runs all tick procedures on the contract processor.
+#define NUMBER_OF_TICK_HOOK_HELPER_PROCESSORS 0
+
+// If 1, the SMT siblings (hyper-threads on the same physical core) of the tick processor and the contract processor are left idle
+// instead of running request processors, so the tick and contract processor get the full core. Only applies if at least 4 processors
+// remain. Independent of this setting, tick and contract processor are placed on the CPU package of the main processor.
+#define IDLE_SMT_SIBLINGS_OF_TICK_PROCESSORS 1
+
 #define USE_SCORE_CACHE 1
 #define SCORE_CACHE_SIZE 2000000 // the larger the better
 #define SCORE_CACHE_COLLISION_RETRIES 20 // number of retries to find entry in cache in case of hash collision
+// Number of solutions of broadcast transactions that can wait for being scored speculatively by the solution processors before they
+// are included in a tick (0 disables speculative scoring). Results are stored in the score cache, so this requires USE_SCORE_CACHE.
+#define SPECULATIVE_SCORE_QUEUE_SIZE 1024
 
 // Number of ticks from prior epoch that are kept after seamless epoch transition. These can be requested after transition.
 #define TICKS_TO_KEEP_FROM_PRIOR_EPOCH 100
@@ -36,6 +70,11 @@
 // Number of ticks that are stored in the pending txs pool. This also defines how many ticks in advance a tx can be registered.
 #define PENDING_TXS_POOL_NUM_TICKS (1000 * 60 * 10ULL / TICK_DURATION_FOR_ALLOCATION_MS) // 10 minutes
 
+// Number of ticks following the PENDING_TXS_POOL_NUM_TICKS window for which txs are accepted into the far-future store
+// of the pending txs pool. Its capacity of PENDING_TXS_POOL_FAR_FUTURE_MAX_TXS (< 65535) is shared by all these ticks.
+#define PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS (PENDING_TXS_POOL_NUM_TICKS * 2) // 20 minutes
+#define PENDING_TXS_POOL_FAR_FUTURE_MAX_TXS 16384
+
 // Below are 2 variables that are used for auto-F5 feature:
 #define AUTO_FORCE_NEXT_TICK_THRESHOLD 0ULL // Multiplier of TARGET_TICK_DURATION for the system to detect "F5 case" | set to 0 to disable
                                             // to prevent bad actor causing misalignment.
@@ -28,11 +28,14 @@
 #include <lib/platform_common/compiler_optimization.h>
 #include "platform/time.h"
 #include "platform/file_io.h"
+#include "platform/sparse_file_io.h"
 #include "platform/time_stamp_counter.h"
 #include "platform/memory_util.h"
 #include "platform/profiling.h"
+#include "platform/console_output_queue.h"
 
 #include "platform/custom_stack.h"
+#include "platform/processor_topology.h"
 
 #include "text_output.h"
 
@@ -43,6 +46,7 @@
 
 #include "network_core/tcp4.h"
 #include "network_core/peers.h"
+#include "network_core/response_cache.h"
 
 #include "system.h"
 #include "contract_core/qpi_system_impl.h"
@@ -60,6 +64,12 @@
 #include "ticking/ticking.h"
 #include "ticking/tick_storage.h"
 #include "ticking/pending_txs_pool.h"
+#include "ticking/verified_txs_cache.h"
+#include "ticking/vote_arrival_queue.h"
+#include "ticking/tick_phase_stats.h"
+#include "ticking/epoch_transition_stats.h"
+#include "contract_core/contract_function_cache.h"
+#include "contract_core/contract_state_digest.h"
 #include "contract_core/qpi_ticking_impl.h"
 #include "vote_counter.h"
 #include "ticking/execution_fee_report_collector.h"
@@ -73,6 +83,7 @@
 
 #include "files/files.h"
 #include "mining/mining.h"
+#include "mining/miner_solution_flags.h"
 
 #include "oracle_core/oracle_engine.h"
 #include "oracle_core/net_msg_impl.h"
@@ -86,9 +97,11 @@
 
 #define CONTRACT_STATES_DEPTH 10 // Is derived from MAX_NUMBER_OF_CONTRACTS (=N)
 #define TICK_REQUESTING_PERIOD 500ULL
+#define TICK_RANGE_SYNC_MIN_LAG 16 // Number of ticks the node has to be behind the latest verified tick vote for requesting tick ranges
 #define MAX_NUMBER_EPOCH 1000ULL
 #define MAX_NUMBER_OF_MINERS 8192
 #define NUMBER_OF_MINER_SOLUTION_FLAGS 0x100000000
+#define MAX_NUMBER_OF_LISTED_MINER_SOLUTION_FLAGS 0x100000 // Solutions per epoch for which clearing and saving the flags doesn't touch the whole bitmap
 #define MAX_MESSAGE_PAYLOAD_SIZE MAX_TRANSACTION_SIZE
 #define MAX_UNIVERSE_SIZE 1073741824
 #define MESSAGE_DISSEMINATION_THRESHOLD 1000000000
@@ -101,6 +114,7 @@
 #define TIME_ACCURACY 5000
 constexpr unsigned long long TARGET_MAINTHREAD_LOOP_DURATION = 30; // mcs, it is the target duration of the main thread loop
 constexpr unsigned int COMMON_BUFFERS_COUNT = 2;
+constexpr unsigned int REORG_BUFFERS_COUNT = 1; // with 2, spectrum and universe are reorganized fully in parallel in endEpoch() (costs memory of full spectrum)
 
 
 struct Processor : public CustomStack
@@ -137,6 +151,7 @@ static int solutionPublicationTicks[MAX_NUMBER_OF_SOLUTIONS]; // scheduled tick
 
 static unsigned long long faultyComputorFlags[(NUMBER_OF_COMPUTORS + 63) / 64];
 static unsigned int gTickNumberOfComputors = 0, gTickTotalNumberOfComputors = 0, gFutureTickTotalNumberOfComputors = 0;
+static VoteArrivalQueue<4096> voteArrivalQueue;
 static unsigned int nextTickTransactionsSemaphore = 0, numberOfNextTickTransactions = 0, numberOfKnownNextTickTransactions = 0;
 static unsigned short numberOfOwnComputorIndices;
 static unsigned short ownComputorIndices[computorSeedsCount];
@@ -146,6 +161,31 @@ static VoteCounter voteCounter;
 static ExecutionFeeReportCollector executionFeeReportCollector;
 static TickData nextTickData;
 static PendingTxsPool pendingTxsPool;
+static VerifiedTxsCache verifiedTxsCache;
+#if CONTRACT_FUNCTION_CACHE_SIZE && CONTRACT_FUNCTION_STATE_SNAPSHOTS
+static ContractFunctionCache<CONTRACT_FUNCTION_CACHE_SIZE, CONTRACT_FUNCTION_CACHE_MAX_OUTPUT_SIZE> contractFunctionCache;
+static unsigned char contractFunctionCacheOutputs[MAX_NUMBER_OF_PROCESSORS][CONTRACT_FUNCTION_CACHE_MAX_OUTPUT_SIZE];
+#endif
+#if CONTRACT_STATE_CHANGE_TRACKING
+static_assert(CONTRACT_FUNCTION_STATE_SNAPSHOTS, "CONTRACT_STATE_CHANGE_TRACKING requires CONTRACT_FUNCTION_STATE_SNAPSHOTS");
+// Maximum number of pages sent in response to RequestContractStateChanges (64 KiB), more are requested with nextPage
+static constexpr unsigned int contractStateChangesMaxPagesPerResponse = 16;
+// Random identifier of this node run, snapshot versions restart with each run
+static unsigned long long contractStateChangesStreamId = 0;
+static unsigned char contractStatePageResponses[MAX_NUMBER_OF_PROCESSORS][sizeof(RespondContractStatePage) + contractStateSnapshotPageSize];
+#endif
+
+// Response buffer of the operator command SPECIAL_COMMAND_GET_CONTRACT_EXECUTION_PROFILE (too large for the stack)
+static SpecialCommandGetContractExecutionProfileResponse contractExecutionProfileResponse;
+static volatile char contractExecutionProfileResponseLock = 0;
+
+// Time span of sampling profiler trace requested with SPECIAL_COMMAND_DUMP_SAMPLED_PROFILE_TRACE (0 = no request),
+// written with the next snapshot of the node states (see saveAllNodeStates())
+static volatile unsigned int samplingProfilerTraceMilliseconds = 0;
+static_assert(sizeof(SpecialCommandGetSampledProfileResponse::Entry) == sizeof(SampledScopeStats), "Entry must match SampledScopeStats");
+static_assert(sizeof(SpecialCommandGetSampledProfileResponse::entries) / sizeof(SpecialCommandGetSampledProfileResponse::Entry) >= SAMPLED_SCOPE_COUNT, "Too many sampled scopes for response");
+static_assert(sizeof(SpecialCommandGetMemoryFootprintResponse::Entry) == sizeof(MemoryRegistry::Subsystem), "Entry must match MemoryRegistry::Subsystem");
+static_assert(sizeof(SpecialCommandGetMemoryFootprintResponse::entries) / sizeof(SpecialCommandGetMemoryFootprintResponse::Entry) >= MemoryRegistry::maxSubsystems, "Too many memory subsystems for response");
 
 static m256i uniqueNextTickTransactionDigests[NUMBER_OF_COMPUTORS];
 static unsigned int uniqueNextTickTransactionDigestCounters[NUMBER_OF_COMPUTORS];
@@ -154,7 +194,9 @@ static unsigned int resourceTestingDigest = 0;
 
 static unsigned int numberOfTransactions = 0;
 
-static unsigned long long spectrumChangeFlags[SPECTRUM_CAPACITY / (sizeof(unsigned long long) * 8)];
+// Sum of gTxRevenuePoints[number of transactions in tick] of the ticks processed in this epoch, indexed by tick % NUMBER_OF_COMPUTORS.
+// Updated in processTick(), so endEpoch() doesn't need to scan the tick data of the whole epoch.
+static unsigned long long txRevenueScores[NUMBER_OF_COMPUTORS];
 
 static unsigned long long mainLoopNumerator = 0, mainLoopDenominator = 0;
 static unsigned char contractProcessorState = 0;
@@ -165,8 +207,25 @@ static unsigned char contractProcessorPostIncomingTransferType = 0;
 static const UserProcedureRegistry::UserProcedureData* contractProcessorUserProcedureNotificationProc = 0;
 static const void* contractProcessorUserProcedureNotificationInput = 0;
 static EFI_EVENT contractProcessorEvent;
+
+// Batch of BEGIN_TICK or END_TICK procedures of independent contracts (see contractTickHooksIndependent) that the
+// contract processor runs together with the tick hook helper processors. Contracts are added in the order of the
+// sequential execution and the batch is run before the next contract that isn't independent, so the result is the same.
+static struct
+{
+    unsigned int contractIndices[contractCount];
+    unsigned int count;
+    unsigned int systemProcId;
+    volatile long nextItem; // index of next contract to be claimed by a processor
+    volatile long finishedItems;
+    volatile long open; // helpers only start claiming while batch is open
+    volatile long activeHelpers;
+} tickHookBatch;
 static m256i contractStateDigests[MAX_NUMBER_OF_CONTRACTS * 2 - 1];
 const unsigned long long contractStateDigestsSizeInBytes = sizeof(contractStateDigests);
+static IncrementalMerkleTree<MAX_NUMBER_OF_CONTRACTS> contractStateDigestTree;
+// Seqlock for reading contractStateDigestTree concurrently to getComputerDigest() (odd while digests are updated)
+static volatile long contractStateDigestsSequence = 0;
 
 // targetNextTickDataDigestIsKnown == true signals that we need to fetch TickData (update the version in this node)
 // targetNextTickDataDigestIsKnown == false means there is no consensus on next tick data yet
@@ -176,6 +235,15 @@ static m256i lastExpectedTickTransactionDigest;
 XKCP::KangarooTwelve_Instance g_k12_instance;
 // rdtsc (timestamp) of ticks
 static unsigned long long tickTicks[11];
+static TickPhaseStats<1024> tickPhaseStats;
+
+// Begin of the tick processor phases of the current tick (0 if phase hasn't been reached yet)
+static struct
+{
+    unsigned long long tickProcessed;
+    unsigned long long dataAvailable;
+    unsigned long long quorumReached;
+} tickPhaseClock;
 
 static unsigned int numberOfProcessors = 0;
 static Processor processors[MAX_NUMBER_OF_PROCESSORS];
@@ -196,7 +264,19 @@ static ScoreFunction<
     NUMBER_OF_SOLUTION_PROCESSORS
 > * score = nullptr;
 static volatile char solutionsLock = 0;
-static unsigned long long* minerSolutionFlags = NULL;
+static MinerSolutionFlags<NUMBER_OF_MINER_SOLUTION_FLAGS, MAX_NUMBER_OF_LISTED_MINER_SOLUTION_FLAGS> minerSolutionFlags;
+
+// Verification keys of the public keys in broadcastedComputors, so verifying signatures of tick votes and tick data
+// doesn't need to decode the public key and compute the precomputation tables every time
+struct ComputorVerificationKey
+{
+    m256i publicKey;
+    point_double_precomp_t key;
+    bool computed;
+    bool valid;
+    volatile char lock;
+};
+static ComputorVerificationKey* computorVerificationKeys = NULL;
 static volatile m256i minerPublicKeys[MAX_NUMBER_OF_MINERS + 1];
 static volatile unsigned int minerScores[MAX_NUMBER_OF_MINERS + 1];
 static volatile unsigned int numberOfMiners = NUMBER_OF_COMPUTORS;
@@ -245,14 +325,16 @@ struct
     unsigned int numberOfMiners;
     unsigned int numberOfTransactions;
     unsigned char customMiningSharesCounterData[CustomMiningSharesCounter::_customMiningSolutionCounterDataSize];
+    unsigned long long txRevenueScores[NUMBER_OF_COMPUTORS];
 } nodeStateBuffer;
 #endif
-static bool saveContractStateFiles(CHAR16* directory = NULL);
+static bool saveContractStateFiles(CHAR16* directory = NULL, bool nodeStateSnapshot = false);
 static bool saveContractExecFeeFiles(CHAR16* directory = NULL, bool saveAccumulatedTime = false);
 static bool saveSystem(CHAR16* directory = NULL);
-static bool loadContractStateFiles(CHAR16* directory = NULL, bool forceLoadFromFile = false);
+static bool loadContractStateFiles(CHAR16* directory = NULL, bool forceLoadFromFile = false, bool nodeStateSnapshot = false);
 static bool loadContractExecFeeFiles(CHAR16* directory = NULL, bool loadAccumulatedTime = false);
 static bool saveRevenueComponents(CHAR16* directory = NULL);
+static void addSpeculativeSolutionTask(const Transaction* transaction);
 
 #if ENABLED_LOGGING
 #define PAUSE_BEFORE_CLEAR_MEMORY 1 // Requiring operators to press F10 to clear memory (before switching epoch)
@@ -295,12 +377,21 @@ static struct
     RequestTickTransactions requestedTickTransactions;
 } requestedTickTransactions;
 
-static struct {
-    unsigned char day;
-    unsigned char hour;
-    unsigned char minute;
-    unsigned char second;
-} threadTimeCheckin[MAX_NUMBER_OF_PROCESSORS];
+static struct
+{
+    RequestResponseHeader header;
+    RequestTickRange requestTickRange;
+} requestedTickRange;
+
+// Highest tick with a tick vote with valid signature received per computor, for detecting that the node is behind and
+// should catch up with RequestTickRange
+static volatile long latestVerifiedTickVotes[NUMBER_OF_COMPUTORS];
+
+// End of the tick range requested last with RequestTickRange (first tick that hasn't been requested)
+static unsigned int tickRangeSyncRequestedEnd = 0;
+
+// monotonicMilliseconds() of the latest check-in of each processor (see checkinTime())
+static volatile unsigned long long threadTimeCheckin[MAX_NUMBER_OF_PROCESSORS];
 
 static struct {
     unsigned int tick;
@@ -315,6 +406,23 @@ static struct {
     unsigned long long lastCheck;
 } autoResendTickVotes;
 
+// Periodic status output is queued while deferConsoleOutput is set and written in time slices of the main loop
+static ConsoleOutputQueue<256, 1024> consoleOutputQueue;
+static bool deferConsoleOutput = false;
+
+// Write line to console or queue it if output is deferred. Direct output flushes the queue first to keep the order.
+static void writeLineToConsole(const CHAR16* line)
+{
+#if CONSOLE_OUTPUT_MAX_CHARS_PER_SECOND
+    if (deferConsoleOutput && consoleOutputQueue.push(line))
+    {
+        return;
+    }
+    consoleOutputQueue.flush();
+#endif
+    outputStringToConsole(line);
+}
+
 static void logToConsole(const CHAR16* message)
 {
     if (consoleLoggingLevel == 0)
@@ -358,7 +466,7 @@ static void logToConsole(const CHAR16* message)
     appendText(timestampedMessage, L"\r\n");
 
 #ifdef NDEBUG
-    outputStringToConsole(timestampedMessage);
+    writeLineToConsole(timestampedMessage);
 #else
     bool logAsDebugMessage = epochTransitionState
                                 || system.tick - system.initialTick < 3
@@ -369,7 +477,7 @@ static void logToConsole(const CHAR16* message)
     if (logAsDebugMessage)
         addDebugMessage(timestampedMessage);
     else
-        outputStringToConsole(timestampedMessage);
+        writeLineToConsole(timestampedMessage);
 #endif
 }
 
@@ -390,75 +498,147 @@ static void enableAVX()
         ));
 }
 
+static ContractStateLeafCache contractStateLeafCaches[contractCount];
+
+// Allocate leaf caches of large contract states (optional, digests are computed without cache if this fails)
+static void initContractStateLeafCaches()
+{
+    for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
+    {
+        allocateContractStateLeafCache(contractStateLeafCaches[contractIndex], contractDescriptions[contractIndex].stateSize);
+    }
+}
+
+static void deinitContractStateLeafCaches()
+{
+    for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
+    {
+        freeContractStateLeafCache(contractStateLeafCaches[contractIndex]);
+    }
+}
+
+// Compute digest of contract state and account the time
+static void computeContractStateDigest(unsigned int contractIndex)
+{
+    const unsigned long long size = contractIndex < contractCount ? contractDescriptions[contractIndex].stateSize : 0;
+    if (!size)
+    {
+        contractStateDigests[contractIndex] = m256i::zero();
+        return;
+    }
+
+    // FIXME: We may have a race condition here if a digest is computed here by thread A, the state is changed
+    // + contractStateChangeFlags set afterwards by thread B and contractStateChangeFlags cleared below below
+    // by thread A. We then have a changed state but a cleared contractStateChangeFlags flag leading to wrong
+    // digest.
+    // This is currently avoided by calling getComputerDigest() from tick processor only (and in non-concurrent init)
+    contractStateLock[contractIndex].acquireRead();
+
+    const unsigned long long startTime = __rdtsc();
+    computeContractStateDigestWithLeafCache((const unsigned char*)contractStates[contractIndex], size, contractStateLeafCaches[contractIndex], contractStateDigests[contractIndex]);
+    const unsigned long long executionTime = __rdtsc() - startTime;
+
+    // make new state available to contract functions requested via network
+    contractStateSnapshots[contractIndex].publish(contractStates[contractIndex]);
+
+    contractStateLock[contractIndex].releaseRead();
+
+    // K12 of state is included in contract execution time
+    _interlockedadd64(&contractTotalExecutionTime[contractIndex], executionTime);
+    // do not charge contract 0 state digest computation,
+    // only charge execution time if contract is already constructed/not in IPO
+    // TODO: enable this after adding proper tracking of contract state writes
+    //if (contractIndex > 0 && system.epoch >= contractDescriptions[contractIndex].constructionEpoch)
+    //{
+    //    executionTimeAccumulator.addTime(contractIndex, executionTime);
+    //}
+
+    // Gather data for comparing different versions of K12
+    if (K12MeasurementsCount < 500)
+    {
+        _interlockedadd64((volatile long long*)&K12MeasurementsSum, executionTime);
+        _InterlockedIncrement64((volatile long long*)&K12MeasurementsCount);
+    }
+}
+
+// Compute digests of contract states smallContractStates[begin, end) (ParallelJobs::ChunkFunction)
+static void computeContractStateDigests(void* context, unsigned long long begin, unsigned long long end)
+{
+    const unsigned int* contractIndices = (const unsigned int*)context;
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        computeContractStateDigest(contractIndices[i]);
+    }
+}
+
 // Should only be called from tick processor to avoid concurrent state changes, which can cause race conditions as detailed in FIXME below.
 static void getComputerDigest(m256i& digest)
 {
     PROFILE_SCOPE();
 
-    unsigned int digestIndex;
-    for (digestIndex = 0; digestIndex < MAX_NUMBER_OF_CONTRACTS; digestIndex++)
+    _InterlockedIncrement(&contractStateDigestsSequence);
+
+    // Collect changed contracts. Small states are hashed concurrently by idle processors (one contract per chunk).
+    // Large states are hashed one after another, each one split into K12 leaf chunks processed in parallel.
+    static unsigned int smallContractStates[MAX_NUMBER_OF_CONTRACTS];
+    static unsigned int largeContractStates[MAX_NUMBER_OF_CONTRACTS];
+    unsigned int smallCount = 0, largeCount = 0;
+    for (unsigned int contractIndex = (unsigned int)contractStateDigestTree.findNextChangedLeaf(0); contractIndex < MAX_NUMBER_OF_CONTRACTS;
+        contractIndex = (unsigned int)contractStateDigestTree.findNextChangedLeaf(contractIndex + 1))
     {
-        if (contractStateChangeFlags[digestIndex >> 6] & (1ULL << (digestIndex & 63)))
-        {
-            const unsigned long long size = digestIndex < contractCount ? contractDescriptions[digestIndex].stateSize : 0;
-            if (!size)
-            {
-                contractStateDigests[digestIndex] = m256i::zero();
-            }
-            else
-            {
-                // FIXME: We may have a race condition here if a digest is computed here by thread A, the state is changed
-                // + contractStateChangeFlags set afterwards by thread B and contractStateChangeFlags cleared below below
-                // by thread A. We then have a changed state but a cleared contractStateChangeFlags flag leading to wrong
-                // digest.
-                // This is currently avoided by calling getComputerDigest() from tick processor only (and in non-concurrent init)
-                contractStateLock[digestIndex].acquireRead();
+        const unsigned long long size = contractIndex < contractCount ? contractDescriptions[contractIndex].stateSize : 0;
+        if (size >= contractStateParallelHashingMinSize)
+            largeContractStates[largeCount++] = contractIndex;
+        else
+            smallContractStates[smallCount++] = contractIndex;
+    }
 
-                const unsigned long long startTime = __rdtsc();
-                KangarooTwelve(contractStates[digestIndex], (unsigned int)size, &contractStateDigests[digestIndex], 32);
-                const unsigned long long executionTime = __rdtsc() - startTime;
+    parallelJobs.run(computeContractStateDigests, smallContractStates, smallCount, 1);
+    for (unsigned int i = 0; i < largeCount; i++)
+    {
+        computeContractStateDigest(largeContractStates[i]);
+    }
+
+    // retry publishing snapshots that have been postponed (state may be unchanged, so it is not covered above)
+    for (unsigned int contractIndex = 1; contractIndex < contractCount; contractIndex++)
+    {
+        if (contractStateSnapshots[contractIndex].isPublishPending())
+            publishContractStateSnapshot(contractIndex);
+    }
 
-                contractStateLock[digestIndex].releaseRead();
+    contractStateDigestTree.updateInnerNodes();
 
-                // K12 of state is included in contract execution time
-                _interlockedadd64(&contractTotalExecutionTime[digestIndex], executionTime);
-                // do not charge contract 0 state digest computation,
-                // only charge execution time if contract is already constructed/not in IPO
-                // TODO: enable this after adding proper tracking of contract state writes
-                //if (digestIndex > 0 && system.epoch >= contractDescriptions[digestIndex].constructionEpoch)
-                //{
-                //    executionTimeAccumulator.addTime(digestIndex, executionTime);
-                //}
+    digest = contractStateDigestTree.root();
+    _InterlockedIncrement(&contractStateDigestsSequence);
+}
 
-                // Gather data for comparing different versions of K12
-                if (K12MeasurementsCount < 500)
-                {
-                    K12MeasurementsSum += executionTime;
-                    K12MeasurementsCount++;
-                }
-            }
-        }
-    }
-    unsigned int previousLevelBeginning = 0;
-    unsigned int numberOfLeafs = MAX_NUMBER_OF_CONTRACTS;
-    while (numberOfLeafs > 1)
+// Copy size bytes of the state of a contract starting at offset, the digest of the contract state followed by the
+// siblings of the contract's leaf in contractStateDigestTree, and the root digest, for serving state chunks to peers.
+// Return false if the state has changed since the last update of the digests, because the chunk cannot be proven then.
+static bool readContractStateChunk(unsigned int contractIndex, unsigned long long offset, unsigned int size, unsigned char* data, m256i* siblings, m256i& rootDigest)
+{
+    bool consistent = false;
+    contractStateLock[contractIndex].acquireRead();
+    for (unsigned int attempt = 0; attempt < 4 && !consistent; ++attempt)
     {
-        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
+        const long sequence = contractStateDigestsSequence;
+        if ((sequence & 1) || contractStateDigestTree.isLeafChanged(contractIndex))
         {
-            if (contractStateChangeFlags[i >> 6] & (3ULL << (i & 63)))
-            {
-                KangarooTwelve64To32(&contractStateDigests[previousLevelBeginning + i], &contractStateDigests[digestIndex]);
-                contractStateChangeFlags[i >> 6] &= ~(3ULL << (i & 63));
-                contractStateChangeFlags[i >> 7] |= (1ULL << ((i >> 1) & 63));
-            }
-            digestIndex++;
+            _mm_pause();
+            continue;
         }
-        previousLevelBeginning += numberOfLeafs;
-        numberOfLeafs >>= 1;
-    }
-    contractStateChangeFlags[0] = 0;
+        _mm_lfence();
 
-    digest = contractStateDigests[(MAX_NUMBER_OF_CONTRACTS * 2 - 1) - 1];
+        copyMem(data, contractStates[contractIndex] + offset, size);
+        siblings[0] = contractStateDigests[contractIndex];
+        contractStateDigestTree.getSiblings(contractIndex, siblings + 1);
+        rootDigest = contractStateDigestTree.root();
+
+        _mm_lfence();
+        consistent = contractStateDigestsSequence == sequence && !contractStateDigestTree.isLeafChanged(contractIndex);
+    }
+    contractStateLock[contractIndex].releaseRead();
+    return consistent;
 }
 
 
@@ -471,15 +651,7 @@ static void processExchangePublicPeers(Peer* peer, RequestResponseHeader* header
         // Set isHandshaked if sExchangePublicPeers was received on outgoing connection
         if (peer->address.u32)
         {
-            for (unsigned int j = 0; j < numberOfPublicPeers; j++)
-            {
-                if (peer->address == publicPeers[j].address)
-                {
-                    publicPeers[j].isHandshaked = true;
-
-                    break;
-                }
-            }
+            setPublicPeerHandshaked(peer->address);
         }
     }
 
@@ -493,6 +665,87 @@ static void processExchangePublicPeers(Peer* peer, RequestResponseHeader* header
     }
 }
 
+// Get sub-type (MESSAGE_TYPE_*) of broadcast message with zero destination, which is encoded in the gamming nonce
+static unsigned char getBroadcastMessageSubType(const BroadcastMessage* request)
+{
+    unsigned char sharedKeyAndGammingNonce[64];
+    setMem(sharedKeyAndGammingNonce, 32, 0);
+    copyMem(&sharedKeyAndGammingNonce[32], &request->gammingNonce, 32);
+    unsigned char gammingKey[32];
+    KangarooTwelve64To32(sharedKeyAndGammingNonce, gammingKey);
+    return gammingKey[0];
+}
+
+// Return number of custom mining solutions in broadcast message payload, or 0 if payload isn't a valid solution message
+static unsigned int getCustomMiningSolutionCount(unsigned char messageSubType, unsigned int messagePayloadSize)
+{
+    if (messageSubType == MESSAGE_TYPE_CUSTOM_MINING_SOLUTION)
+    {
+        return (messagePayloadSize == sizeof(CustomMiningSolutionV2)) ? 1 : 0;
+    }
+    if (messageSubType == MESSAGE_TYPE_CUSTOM_MINING_SOLUTION_BATCH && messagePayloadSize % sizeof(CustomMiningSolutionV2) == 0)
+    {
+        return messagePayloadSize / sizeof(CustomMiningSolutionV2);
+    }
+    return 0;
+}
+
+// Check if all solutions have been recorded before. The cache only contains solutions of messages with valid signature.
+static bool areCustomMiningSolutionsKnown(const CustomMiningSolutionV2* solutions, unsigned int solutionCount)
+{
+    for (unsigned int i = 0; i < solutionCount; i++)
+    {
+        CustomMiningSolutionV2CacheEntry cacheEntry;
+        cacheEntry.set(&solutions[i]);
+        if (!gSystemCustomMiningSolutionV2Cache.contains(cacheEntry))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void recordCustomMiningSolution(const CustomMiningSolutionV2* solution)
+{
+    bool isSolutionGood = false;
+
+    CustomMiningSolutionV2CacheEntry cacheEntry;
+    cacheEntry.set(solution);
+
+    unsigned int cacheIndex = 0;
+    int sts = gSystemCustomMiningSolutionV2Cache.tryFetching(cacheEntry, cacheIndex);
+
+    // Check for duplicated solution
+    if (sts == CUSTOM_MINING_CACHE_MISS)
+    {
+        gSystemCustomMiningSolutionV2Cache.addEntry(cacheEntry, cacheIndex);
+        isSolutionGood = true;
+    }
+    if (gCustomMiningStorage.isSolutionStale(solution->taskIndex))
+    {
+        isSolutionGood = false;
+    }
+
+    if (isSolutionGood)
+    {
+        // Check the computor idx of this solution.
+        unsigned short computorID = customMiningGetComputorID(solution);
+
+        ACQUIRE(gCustomMiningSharesCountLock);
+        gCustomMiningSharesCount[computorID]++;
+        RELEASE(gCustomMiningSharesCountLock);
+
+        CustomMiningSolutionStorageEntry solutionStorageEntry;
+        solutionStorageEntry.taskIndex = solution->taskIndex;
+        solutionStorageEntry.nonce = solution->nonce;
+        solutionStorageEntry.cacheEntryIndex = cacheIndex;
+
+        ACQUIRE(gCustomMiningSolutionStorageLock);
+        gCustomMiningStorage._solutionV2Storage.addData(&solutionStorageEntry);
+        RELEASE(gCustomMiningSolutionStorageLock);
+    }
+}
+
 static void processBroadcastMessage(const unsigned long long processorNumber, RequestResponseHeader* header)
 {
     BroadcastMessage* request = header->getPayload<BroadcastMessage>();
@@ -501,6 +754,25 @@ static void processBroadcastMessage(const unsigned long long processorNumber, Re
         && !isZero(request->sourcePublicKey))
     {
         const unsigned int messageSize = header->size() - sizeof(RequestResponseHeader);
+        const unsigned int messagePayloadSize = messageSize - sizeof(BroadcastMessage) - SIGNATURE_SIZE;
+
+        // Solutions are usually received many times, because every peer relays them. Drop messages that only contain
+        // known solutions before the expensive signature check and don't relay them again.
+        unsigned char messageSubType = 0;
+        unsigned int customMiningSolutionCount = 0;
+        const CustomMiningSolutionV2* customMiningSolutions = (const CustomMiningSolutionV2*)((unsigned char*)request + sizeof(BroadcastMessage));
+        if (isZero(request->destinationPublicKey) && messagePayloadSize)
+        {
+            messageSubType = getBroadcastMessageSubType(request);
+            customMiningSolutionCount = getCustomMiningSolutionCount(messageSubType, messagePayloadSize);
+            if (customMiningSolutionCount && areCustomMiningSolutionsKnown(customMiningSolutions, customMiningSolutionCount))
+            {
+                gSystemCustomMiningSolutionV2Cache.addHits(customMiningSolutionCount);
+                ATOMIC_STORE64(gCustomMiningStats.phaseV2.duplicated, gSystemCustomMiningSolutionV2Cache.hitCount());
+                return;
+            }
+        }
+
         bool ok = true;
         m256i digest;
         KangarooTwelve(request, messageSize - SIGNATURE_SIZE, &digest, sizeof(digest));
@@ -523,8 +795,6 @@ static void processBroadcastMessage(const unsigned long long processorNumber, Re
 
             if (isZero(request->destinationPublicKey))
             {
-                const unsigned int messagePayloadSize = messageSize - sizeof(BroadcastMessage) - SIGNATURE_SIZE;
-
                 // Only record task and solution message in idle phase
                 char recordCustomMining = 0;
                 ACQUIRE(gIsInCustomMiningStateLock);
@@ -533,14 +803,8 @@ static void processBroadcastMessage(const unsigned long long processorNumber, Re
 
                 if (messagePayloadSize == sizeof(CustomMiningTaskV2) && request->sourcePublicKey == dispatcherPublicKey)
                 {
-                    unsigned char sharedKeyAndGammingNonce[64];
-                    setMem(sharedKeyAndGammingNonce, 32, 0);
-                    copyMem(&sharedKeyAndGammingNonce[32], &request->gammingNonce, 32);
-                    unsigned char gammingKey[32];
-                    KangarooTwelve64To32(sharedKeyAndGammingNonce, gammingKey);
-
                     // Record the task emitted by dispatcher
-                    if (recordCustomMining && gammingKey[0] == MESSAGE_TYPE_CUSTOM_MINING_TASK)
+                    if (recordCustomMining && messageSubType == MESSAGE_TYPE_CUSTOM_MINING_TASK)
                     {
                         const CustomMiningTaskV2* task = ((CustomMiningTaskV2*)((unsigned char*)request + sizeof(BroadcastMessage)));
 
@@ -555,65 +819,24 @@ static void processBroadcastMessage(const unsigned long long processorNumber, Re
                         RELEASE(gCustomMiningTaskStorageLock);
                     }
                 }
-                else if (messagePayloadSize == sizeof(CustomMiningSolutionV2))
+                else if (customMiningSolutionCount)
                 {
                     for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
                     {
                         if (request->sourcePublicKey == broadcastedComputors.computors.publicKeys[i])
                         {
-                            // Compute the gamming key to get the sub-type of message
-                            unsigned char sharedKeyAndGammingNonce[64];
-                            setMem(sharedKeyAndGammingNonce, 32, 0);
-                            copyMem(&sharedKeyAndGammingNonce[32], &request->gammingNonce, 32);
-                            unsigned char gammingKey[32];
-                            KangarooTwelve64To32(sharedKeyAndGammingNonce, gammingKey);
-
-                            if (recordCustomMining && gammingKey[0] == MESSAGE_TYPE_CUSTOM_MINING_SOLUTION)
+                            if (recordCustomMining)
                             {
-                                // Record the solution
-                                bool isSolutionGood = false;
-                                const CustomMiningSolutionV2* solution = ((CustomMiningSolutionV2*)((unsigned char*)request + sizeof(BroadcastMessage)));
-
-                                CustomMiningSolutionV2CacheEntry cacheEntry;
-                                cacheEntry.set(solution);
-
-                                unsigned int cacheIndex = 0;
-                                int sts = gSystemCustomMiningSolutionV2Cache.tryFetching(cacheEntry, cacheIndex);
-
-                                // Check for duplicated solution
-                                if (sts == CUSTOM_MINING_CACHE_MISS)
-                                {
-                                    gSystemCustomMiningSolutionV2Cache.addEntry(cacheEntry, cacheIndex);
-                                    isSolutionGood = true;
-                                }
-                                if (gCustomMiningStorage.isSolutionStale(solution->taskIndex))
-                                {
-                                    isSolutionGood = false;
-                                }
-
-                                if (isSolutionGood)
+                                // Record the solutions, a batch message is only verified once for all its solutions
+                                for (unsigned int j = 0; j < customMiningSolutionCount; j++)
                                 {
-                                    // Check the computor idx of this solution.
-                                    unsigned short computorID = customMiningGetComputorID(solution);
-
-                                    ACQUIRE(gCustomMiningSharesCountLock);
-                                    gCustomMiningSharesCount[computorID]++;
-                                    RELEASE(gCustomMiningSharesCountLock);
-
-                                    CustomMiningSolutionStorageEntry solutionStorageEntry;
-                                    solutionStorageEntry.taskIndex = solution->taskIndex;
-                                    solutionStorageEntry.nonce = solution->nonce;
-                                    solutionStorageEntry.cacheEntryIndex = cacheIndex;
-
-                                    ACQUIRE(gCustomMiningSolutionStorageLock);
-                                    gCustomMiningStorage._solutionV2Storage.addData(&solutionStorageEntry);
-                                    RELEASE(gCustomMiningSolutionStorageLock);
+                                    recordCustomMiningSolution(&customMiningSolutions[j]);
                                 }
 
                                 // Record stats
-                                const unsigned int hitCount = gSystemCustomMiningSolutionV2Cache.hitCount();
-                                const unsigned int missCount = gSystemCustomMiningSolutionV2Cache.missCount();
-                                const unsigned int collision = gSystemCustomMiningSolutionV2Cache.collisionCount();
+                                const unsigned long long hitCount = gSystemCustomMiningSolutionV2Cache.hitCount();
+                                const unsigned long long missCount = gSystemCustomMiningSolutionV2Cache.missCount();
+                                const unsigned long long collision = gSystemCustomMiningSolutionV2Cache.collisionCount();
 
                                 ATOMIC_STORE64(gCustomMiningStats.phaseV2.shares, missCount);
                                 ATOMIC_STORE64(gCustomMiningStats.phaseV2.duplicated, hitCount);
@@ -630,7 +853,6 @@ static void processBroadcastMessage(const unsigned long long processorNumber, Re
                 {
                     if (request->destinationPublicKey == computorPublicKeys[i])
                     {
-                        const unsigned int messagePayloadSize = messageSize - sizeof(BroadcastMessage) - SIGNATURE_SIZE;
                         if (messagePayloadSize)
                         {
                             unsigned char sharedKeyAndGammingNonce[64];
@@ -736,6 +958,49 @@ static void processBroadcastMessage(const unsigned long long processorNumber, Re
     }
 }
 
+// Compute verification key of publicKey if cached entry holds no key or the key of another entity. Caller has to acquire cached.lock.
+static void updateComputorVerificationKey(ComputorVerificationKey& cached, const m256i& publicKey)
+{
+    if (!cached.computed || cached.publicKey != publicKey)
+    {
+        cached.publicKey = publicKey;
+        cached.valid = getVerificationKey(publicKey.m256i_u8, cached.key);
+        cached.computed = true;
+    }
+}
+
+// Compute verification keys of all public keys in broadcastedComputors (once per epoch, when receiving a new list)
+static void updateComputorVerificationKeys()
+{
+    PROFILE_SCOPE();
+
+    for (unsigned int computorIndex = 0; computorIndex < NUMBER_OF_COMPUTORS; computorIndex++)
+    {
+        const m256i publicKey = broadcastedComputors.computors.publicKeys[computorIndex];
+        ComputorVerificationKey& cached = computorVerificationKeys[computorIndex];
+        ACQUIRE(cached.lock);
+        updateComputorVerificationKey(cached, publicKey);
+        RELEASE(cached.lock);
+    }
+}
+
+// Verify signature of computor at computorIndex in broadcastedComputors, using the cached verification key
+static bool verifyComputorSignature(unsigned int computorIndex, const unsigned char* messageDigest, const unsigned char* signature)
+{
+    ASSERT(computorIndex < NUMBER_OF_COMPUTORS);
+    const m256i publicKey = broadcastedComputors.computors.publicKeys[computorIndex];
+    ComputorVerificationKey& cached = computorVerificationKeys[computorIndex];
+    point_double_precomp_t key;
+
+    ACQUIRE(cached.lock);
+    updateComputorVerificationKey(cached, publicKey);
+    const bool keyValid = cached.valid;
+    copyMem(key, cached.key, sizeof(key));
+    RELEASE(cached.lock);
+
+    return keyValid && verifyWithKey(publicKey.m256i_u8, key, messageDigest, signature);
+}
+
 static void processBroadcastComputors(Peer* peer, RequestResponseHeader* header)
 {
     BroadcastComputors* request = header->getPayload<BroadcastComputors>();
@@ -765,6 +1030,7 @@ static void processBroadcastComputors(Peer* peer, RequestResponseHeader* header)
 
             // Copy computor list
             copyMem(&broadcastedComputors.computors, &request->computors, sizeof(Computors));
+            updateComputorVerificationKeys();
 
             // Update ownComputorIndices and minerPublicKeys
             if (request->computors.epoch == system.epoch)
@@ -803,6 +1069,26 @@ static bool verifyTickVoteSignature(const unsigned char* publicKey, const unsign
     return true;
 }
 
+// Verify tick vote signature of computor at computorIndex in broadcastedComputors, using the cached verification key
+static bool verifyTickVoteSignature(unsigned int computorIndex, const unsigned char* messageDigest, const unsigned char* signature)
+{
+    unsigned int score = _byteswap_ulong(((unsigned int*)signature)[0]);
+    if (score > TARGET_TICK_VOTE_SIGNATURE) return false;
+    return verifyComputorSignature(computorIndex, messageDigest, signature);
+}
+
+// Return tick that at least NUMBER_OF_COMPUTORS / 3 + 1 computors have sent a verified vote for (or for a later tick), so
+// a single computor cannot make the node believe that it is behind.
+static unsigned int getLatestTickVoteOfThirdOfComputors()
+{
+    unsigned int ticks[NUMBER_OF_COMPUTORS];
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    {
+        ticks[i] = (unsigned int)latestVerifiedTickVotes[i];
+    }
+    return quickSelect(ticks, 0, NUMBER_OF_COMPUTORS - 1, NUMBER_OF_COMPUTORS / 3, SortingOrder::SortDescending);
+}
+
 static void processBroadcastTick(Peer* peer, RequestResponseHeader* header)
 {
     BroadcastTick* request = header->getPayload<BroadcastTick>();
@@ -821,14 +1107,22 @@ static void processBroadcastTick(Peer* peer, RequestResponseHeader* header)
         request->tick.computorIndex ^= BroadcastTick::type();
         KangarooTwelve(&request->tick, sizeof(Tick) - SIGNATURE_SIZE, digest, sizeof(digest));
         request->tick.computorIndex ^= BroadcastTick::type();
-        const bool verifyFourQCurve = true;
-        if (verifyTickVoteSignature(broadcastedComputors.computors.publicKeys[request->tick.computorIndex].m256i_u8, digest, request->tick.signature, verifyFourQCurve))
+        if (verifyTickVoteSignature(request->tick.computorIndex, digest, request->tick.signature))
         {
             if (header->isDejavuZero())
             {
                 enqueueResponse(NULL, header);
             }
 
+            long latestTick = latestVerifiedTickVotes[request->tick.computorIndex];
+            while ((long)request->tick.tick > latestTick)
+            {
+                const long prevLatestTick = _InterlockedCompareExchange(&latestVerifiedTickVotes[request->tick.computorIndex], (long)request->tick.tick, latestTick);
+                if (prevLatestTick == latestTick)
+                    break;
+                latestTick = prevLatestTick;
+            }
+
             ts.ticks.acquireLock(request->tick.computorIndex);
 
             // Find element in tick storage and check if contains data (epoch is set to 0 on init)
@@ -852,8 +1146,9 @@ static void processBroadcastTick(Peer* peer, RequestResponseHeader* header)
             }
             else
             {
-                // Copy the sent tick to the tick storage
+                // Copy the sent tick to the tick storage and notify tick processor
                 copyMem(tsTick, &request->tick, sizeof(Tick));
+                voteArrivalQueue.push(request->tick.tick, request->tick.computorIndex);
                 peer->lastActiveTick = max(peer->lastActiveTick, peer->getDejavuTick(header->dejavu()));
             }
 
@@ -862,7 +1157,51 @@ static void processBroadcastTick(Peer* peer, RequestResponseHeader* header)
     }
 }
 
-static void processBroadcastFutureTickData(Peer* peer, RequestResponseHeader* header)
+// Return K12 digest of the payload of the request. The payloadDigest passed by the request processor is a cache slot
+// of the request, which may have been filled when receiving. If it is zero, the digest is computed and stored in it.
+static const m256i& getRequestPayloadDigest(RequestResponseHeader* header, m256i& payloadDigest)
+{
+    if (isZero(payloadDigest))
+    {
+        KangarooTwelve(header->getPayload<unsigned char>(), header->getPayloadSize(), &payloadDigest, sizeof(payloadDigest));
+    }
+    return payloadDigest;
+}
+
+// Return if a non-zero transaction digest is present twice in tickData. Digests are looked up in a small hash set of
+// slot indices instead of comparing each digest with all previous ones.
+static bool hasDuplicateTransactionDigest(const TickData& tickData)
+{
+    constexpr unsigned int hashSetCapacity = 2 * NUMBER_OF_TRANSACTIONS_PER_TICK; // must be 2^N
+    static_assert((hashSetCapacity & (hashSetCapacity - 1)) == 0, "hashSetCapacity must be 2^N");
+    unsigned short* hashSet = (unsigned short*)__acquireScratchpad(hashSetCapacity * sizeof(unsigned short)); // slot + 1, 0 = empty
+    ASSERT(hashSet);
+
+    bool duplicate = false;
+    for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK && !duplicate; i++)
+    {
+        const m256i& transactionDigest = tickData.transactionDigests[i];
+        if (!isZero(transactionDigest))
+        {
+            unsigned int pos = transactionDigest.m256i_u32[0] & (hashSetCapacity - 1);
+            while (hashSet[pos])
+            {
+                if (tickData.transactionDigests[hashSet[pos] - 1] == transactionDigest)
+                {
+                    duplicate = true;
+                    break;
+                }
+                pos = (pos + 1) & (hashSetCapacity - 1);
+            }
+            hashSet[pos] = i + 1;
+        }
+    }
+
+    __releaseScratchpad(hashSet);
+    return duplicate;
+}
+
+static void processBroadcastFutureTickData(Peer* peer, RequestResponseHeader* header, m256i& payloadDigest)
 {
     BroadcastFutureTickData* request = header->getPayload<BroadcastFutureTickData>();
     if (request->tickData.epoch == system.epoch
@@ -877,30 +1216,14 @@ static void processBroadcastFutureTickData(Peer* peer, RequestResponseHeader* he
         && request->tickData.millisecond <= 999
         && ms(request->tickData.year, request->tickData.month, request->tickData.day, request->tickData.hour, request->tickData.minute, request->tickData.second, request->tickData.millisecond) <= ms(utcTime.Year - 2000, utcTime.Month, utcTime.Day, utcTime.Hour, utcTime.Minute, utcTime.Second, utcTime.Nanosecond / 1000000) + TIME_ACCURACY)
     {
-        bool ok = true;
-        for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK && ok; i++)
-        {
-            if (!isZero(request->tickData.transactionDigests[i]))
-            {
-                // Check if same transactionDigest is present twice
-                for (unsigned int j = 0; j < i; j++)
-                {
-                    if (request->tickData.transactionDigests[i] == request->tickData.transactionDigests[j])
-                    {
-                        ok = false;
-
-                        break;
-                    }
-                }
-            }
-        }
-        if (ok)
+        // Check if same transactionDigest is present twice
+        if (!hasDuplicateTransactionDigest(request->tickData))
         {
             unsigned char digest[32];
             request->tickData.computorIndex ^= BroadcastFutureTickData::type();
             KangarooTwelve(&request->tickData, sizeof(TickData) - SIGNATURE_SIZE, digest, sizeof(digest));
             request->tickData.computorIndex ^= BroadcastFutureTickData::type();
-            if (verify(broadcastedComputors.computors.publicKeys[request->tickData.computorIndex].m256i_u8, digest, request->tickData.signature))
+            if (verifyComputorSignature(request->tickData.computorIndex, digest, request->tickData.signature))
             {
                 if (header->isDejavuZero())
                 {
@@ -934,8 +1257,11 @@ static void processBroadcastFutureTickData(Peer* peer, RequestResponseHeader* he
                     {
                         if (!isZero(targetNextTickDataDigest))
                         {
-                            unsigned char digest[32];
-                            KangarooTwelve(&request->tickData, sizeof(TickData), digest, 32);
+                            m256i digest;
+                            if (header->checkPayloadSize(sizeof(BroadcastFutureTickData)))
+                                digest = getRequestPayloadDigest(header, payloadDigest);
+                            else
+                                KangarooTwelve(&request->tickData, sizeof(TickData), &digest, sizeof(digest));
                             if (digest == targetNextTickDataDigest)
                             {
                                 copyMem(&td, &request->tickData, sizeof(TickData));
@@ -978,7 +1304,7 @@ static void processBroadcastFutureTickData(Peer* peer, RequestResponseHeader* he
     }
 }
 
-static void processBroadcastTransaction(Peer* peer, RequestResponseHeader* header)
+static void processBroadcastTransaction(Peer* peer, RequestResponseHeader* header, m256i& payloadDigest)
 {
     Transaction* request = header->getPayload<Transaction>();
     const unsigned int transactionSize = request->totalSize();
@@ -995,9 +1321,21 @@ static void processBroadcastTransaction(Peer* peer, RequestResponseHeader* heade
 #if !defined(NDEBUG) && 1
         appendText(dbgMsg, L" valid");
 #endif
+        // If a tx with the same full digest (incl. signature) is in the pool or the cache of verified txs, its signature
+        // has already been verified
+        const m256i txDigest = getRequestPayloadDigest(header, payloadDigest);
+        const bool knownTx = pendingTxsPool.containsTx(request->tick, txDigest) || verifiedTxsCache.contains(txDigest);
+
         unsigned char digest[32];
-        KangarooTwelve(request, transactionSize - SIGNATURE_SIZE, digest, sizeof(digest));
-        if (verify(request->sourcePublicKey.m256i_u8, digest, request->signaturePtr()))
+        bool verified = knownTx;
+        if (!knownTx)
+        {
+            KangarooTwelve(request, transactionSize - SIGNATURE_SIZE, digest, sizeof(digest));
+            verified = verify(request->sourcePublicKey.m256i_u8, digest, request->signaturePtr());
+            if (verified)
+                verifiedTxsCache.add(txDigest);
+        }
+        if (verified)
         {
 #if !defined(NDEBUG) && 1
             appendText(dbgMsg, L" verified");
@@ -1007,18 +1345,19 @@ static void processBroadcastTransaction(Peer* peer, RequestResponseHeader* heade
                 enqueueResponse(NULL, header);
             }
 
-            pendingTxsPool.add(request);
+            pendingTxsPool.add(request, &txDigest);
+            if (!knownTx)
+                addSpeculativeSolutionTask(request);
 
             unsigned int tickIndex = ts.tickToIndexCurrentEpoch(request->tick);
             ts.tickData.acquireLock();
             if (request->tick == system.tick + 1
                 && ts.tickData[tickIndex].epoch == system.epoch)
             {
-                KangarooTwelve(request, transactionSize, digest, sizeof(digest));
                 auto* tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickIndex(tickIndex);
                 for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
                 {
-                    if (digest == ts.tickData[tickIndex].transactionDigests[i])
+                    if (txDigest == ts.tickData[tickIndex].transactionDigests[i])
                     {
                         ts.tickTransactions.acquireLock();
                         if (!tsReqTickTransactionOffsets[i])
@@ -1077,89 +1416,176 @@ static void processRequestComputors(Peer* peer, RequestResponseHeader* header)
 }
 
 /**
- * Sends Tick data for computors *not* marked in request->voteFlags (0 = requester wants the tick of this computer).
- * Shuffles order, ends with EndResponse.
+ * Sends Tick data for computors *not* marked in quorumTick.voteFlags (0 = requester wants the tick of this computer)
+ * as BroadcastTick messages in shuffled order.
  */
-static void processRequestQuorumTick(Peer* peer, RequestResponseHeader* header)
+static void sendQuorumTicks(Peer* peer, unsigned int dejavu, const RequestedQuorumTick& quorumTick)
 {
-    RequestQuorumTick* request = header->getPayload<RequestQuorumTick>();
-
     unsigned short tickEpoch = 0;
     const Tick* tsCompTicks;
-    if (ts.tickInCurrentEpochStorage(request->quorumTick.tick))
+    if (ts.tickInCurrentEpochStorage(quorumTick.tick))
     {
         tickEpoch = system.epoch;
-        tsCompTicks = ts.ticks.getByTickInCurrentEpoch(request->quorumTick.tick);
+        tsCompTicks = ts.ticks.getByTickInCurrentEpoch(quorumTick.tick);
     }
-    else if (ts.tickInPreviousEpochStorage(request->quorumTick.tick))
+    else if (ts.tickInPreviousEpochStorage(quorumTick.tick))
     {
         tickEpoch = system.epoch - 1;
-        tsCompTicks = ts.ticks.getByTickInPreviousEpoch(request->quorumTick.tick);
+        tsCompTicks = ts.ticks.getByTickInPreviousEpoch(quorumTick.tick);
     }
-
-    if (tickEpoch != 0)
+#if TICK_STORAGE_TIERED_MODE
+    bool archived = false;
+    if (ts.tickInArchive(quorumTick.tick))
     {
-        // Send Tick struct data from tick storage as requested by tick and voteFlags in request->quorumTick.
-        // The order of the computors is randomized using a Fisher–Yates shuffle
-        // Todo: This function may be optimized by moving the checking of voteFlags in the first loop, reducing the number of calls to random().
-        unsigned short computorIndices[NUMBER_OF_COMPUTORS];
-        unsigned short numberOfComputorIndices;
-        for (numberOfComputorIndices = 0; numberOfComputorIndices < NUMBER_OF_COMPUTORS; numberOfComputorIndices++)
+        // keep archive locked while sending, because tsCompTicks points into archive cache
+        ts.tickArchive.acquireLock();
+        const auto* archivedTick = ts.tickArchive.getTick(quorumTick.tick);
+        if (archivedTick)
         {
-            computorIndices[numberOfComputorIndices] = numberOfComputorIndices;
+            tickEpoch = system.epoch;
+            tsCompTicks = archivedTick->ticks;
+            archived = true;
         }
-        while (numberOfComputorIndices)
+        else
         {
-            const unsigned short index = random(numberOfComputorIndices);
+            ts.tickArchive.releaseLock();
+        }
+    }
+#endif
 
-            if (!(request->quorumTick.voteFlags[computorIndices[index] >> 3] & (1 << (computorIndices[index] & 7))))
+    if (tickEpoch != 0)
+    {
+        // Send Tick struct data from tick storage as requested by tick and voteFlags in quorumTick.
+        // The ticks to send are selected first, so only these are shuffled (Fisher–Yates shuffle with a fast PRNG
+        // seeded once). All messages are reserved in the response queue at once and the ticks are copied in place.
+        unsigned short computorIndices[NUMBER_OF_COMPUTORS];
+        unsigned int numberOfComputorIndices = 0;
+        for (unsigned short computorIndex = 0; computorIndex < NUMBER_OF_COMPUTORS; computorIndex++)
+        {
+            if (!(quorumTick.voteFlags[computorIndex >> 3] & (1 << (computorIndex & 7)))
+                && tsCompTicks[computorIndex].epoch == tickEpoch)
             {
-                // Todo: We should acquire ts.ticks lock here if tick >= system.tick
-                const Tick* tsTick = tsCompTicks + computorIndices[index];
-                if (tsTick->epoch == tickEpoch)
-                {
-                    ts.ticks.acquireLock(computorIndices[index]);
-                    enqueueResponse(peer, sizeof(Tick), BroadcastTick::type(), header->dejavu(), tsTick);
-                    ts.ticks.releaseLock(computorIndices[index]);
-                }
+                computorIndices[numberOfComputorIndices++] = computorIndex;
             }
+        }
+        FastRandom rng;
+        rng.seed();
+        for (unsigned int i = numberOfComputorIndices; i > 1; i--)
+        {
+            const unsigned int j = rng.next(i);
+            const unsigned short tmp = computorIndices[i - 1];
+            computorIndices[i - 1] = computorIndices[j];
+            computorIndices[j] = tmp;
+        }
 
-            computorIndices[index] = computorIndices[--numberOfComputorIndices];
+        unsigned short elementIndex;
+        const unsigned int reservedCount = reserveResponses(peer, numberOfComputorIndices, sizeof(Tick), BroadcastTick::type(), dejavu, elementIndex);
+        for (unsigned int i = 0; i < reservedCount; i++, elementIndex++)
+        {
+            const unsigned short computorIndex = computorIndices[i];
+            ts.ticks.acquireLock(computorIndex);
+            copyMem(getReservedResponsePayload(elementIndex), tsCompTicks + computorIndex, sizeof(Tick));
+            ts.ticks.releaseLock(computorIndex);
+            releaseReservedResponse(elementIndex);
         }
     }
+#if TICK_STORAGE_TIERED_MODE
+    if (archived)
+    {
+        ts.tickArchive.releaseLock();
+    }
+#endif
+}
+
+// Send requested ticks of quorum, ends with EndResponse.
+static void processRequestQuorumTick(Peer* peer, RequestResponseHeader* header)
+{
+    RequestQuorumTick* request = header->getPayload<RequestQuorumTick>();
+    sendQuorumTicks(peer, header->dejavu(), request->quorumTick);
     enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
 
-static void processRequestTickData(Peer* peer, RequestResponseHeader* header)
+// Send tick data of tick as BroadcastFutureTickData message. Return false if tick data isn't available.
+static bool sendTickData(Peer* peer, unsigned int dejavu, unsigned int tick)
 {
-    RequestTickData* request = header->getPayload<RequestTickData>();
-    TickData* td = ts.tickData.getByTickIfNotEmpty(request->requestedTickData.tick);
+#if TICK_STORAGE_TIERED_MODE
+    if (ts.tickInArchive(tick))
+    {
+        bool sent = false;
+        ts.tickArchive.acquireLock();
+        const auto* archivedTick = ts.tickArchive.getTick(tick);
+        if (archivedTick && archivedTick->tickData.epoch != 0 && archivedTick->tickData.epoch != INVALIDATED_TICK_DATA)
+        {
+            enqueueResponse(peer, sizeof(TickData), BroadcastFutureTickData::type(), dejavu, &archivedTick->tickData);
+            sent = true;
+        }
+        ts.tickArchive.releaseLock();
+        return sent;
+    }
+#endif
+    TickData* td = ts.tickData.getByTickIfNotEmpty(tick);
     if (td)
     {
-        enqueueResponse(peer, sizeof(TickData), BroadcastFutureTickData::type(), header->dejavu(), td);
+        enqueueResponse(peer, sizeof(TickData), BroadcastFutureTickData::type(), dejavu, td);
+        return true;
     }
-    else
+    return false;
+}
+
+static void processRequestTickData(Peer* peer, RequestResponseHeader* header)
+{
+    RequestTickData* request = header->getPayload<RequestTickData>();
+    if (!sendTickData(peer, header->dejavu(), request->requestedTickData.tick))
     {
         enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
     }
 }
 
-static void processRequestTickTransactions(Peer* peer, RequestResponseHeader* header)
+// Send stored transactions of request.tick that are not flagged in request.transactionFlags as BROADCAST_TRANSACTION
+// messages in random order
+static void sendTickTransactions(Peer* peer, unsigned int dejavu, const RequestTickTransactions& request)
 {
-    RequestTickTransactions* request = header->getPayload<RequestTickTransactions>();
-
     unsigned short tickEpoch = 0;
     const unsigned long long* tsReqTickTransactionOffsets;
-    if (ts.tickInCurrentEpochStorage(request->tick))
+    if (ts.tickInCurrentEpochStorage(request.tick))
     {
         tickEpoch = system.epoch;
-        tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(request->tick);
+        tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(request.tick);
     }
-    else if (ts.tickInPreviousEpochStorage(request->tick))
+    else if (ts.tickInPreviousEpochStorage(request.tick))
     {
         tickEpoch = system.epoch - 1;
-        tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickInPreviousEpoch(request->tick);
+        tsReqTickTransactionOffsets = ts.tickTransactionOffsets.getByTickInPreviousEpoch(request.tick);
     }
+#if TICK_STORAGE_TIERED_MODE
+    else if (ts.tickInArchive(request.tick))
+    {
+        // send transactions of archived tick in random order
+        unsigned int tickTransactionIndices[NUMBER_OF_TRANSACTIONS_PER_TICK];
+        unsigned int numberOfTickTransactions;
+        for (numberOfTickTransactions = 0; numberOfTickTransactions < NUMBER_OF_TRANSACTIONS_PER_TICK; numberOfTickTransactions++)
+        {
+            tickTransactionIndices[numberOfTickTransactions] = numberOfTickTransactions;
+        }
+        ts.tickArchive.acquireLock();
+        while (numberOfTickTransactions)
+        {
+            const unsigned int index = random(numberOfTickTransactions);
+
+            if (!(request.transactionFlags[tickTransactionIndices[index] >> 3] & (1 << (tickTransactionIndices[index] & 7))))
+            {
+                const Transaction* transaction = ts.tickArchive.getTransaction(request.tick, tickTransactionIndices[index]);
+                if (transaction && transaction->tick == request.tick && transaction->checkValidity())
+                {
+                    enqueueResponse(peer, transaction->totalSize(), BROADCAST_TRANSACTION, dejavu, (void*)transaction);
+                }
+            }
+
+            tickTransactionIndices[index] = tickTransactionIndices[--numberOfTickTransactions];
+        }
+        ts.tickArchive.releaseLock();
+    }
+#endif
 
     if (tickEpoch != 0)
     {
@@ -1173,15 +1599,15 @@ static void processRequestTickTransactions(Peer* peer, RequestResponseHeader* he
         {
             const unsigned int index = random(numberOfTickTransactions);
 
-            if (!(request->transactionFlags[tickTransactionIndices[index] >> 3] & (1 << (tickTransactionIndices[index] & 7))))
+            if (!(request.transactionFlags[tickTransactionIndices[index] >> 3] & (1 << (tickTransactionIndices[index] & 7))))
             {
                 unsigned long long tickTransactionOffset = tsReqTickTransactionOffsets[tickTransactionIndices[index]];
                 if (tickTransactionOffset)
                 {
                     const Transaction* transaction = ts.tickTransactions(tickTransactionOffset);
-                    if (transaction->tick == request->tick && transaction->checkValidity())
+                    if (transaction->tick == request.tick && transaction->checkValidity())
                     {
-                        enqueueResponse(peer, transaction->totalSize(), BROADCAST_TRANSACTION, header->dejavu(), (void*)transaction);
+                        enqueueResponse(peer, transaction->totalSize(), BROADCAST_TRANSACTION, dejavu, (void*)transaction);
                     }
                     else
                     {
@@ -1189,7 +1615,7 @@ static void processRequestTickTransactions(Peer* peer, RequestResponseHeader* he
 #if !defined(NDEBUG)
                         CHAR16 dbgMsg[200];
                         setText(dbgMsg, L"Invalid transaction found in processRequestTickTransactions(), tick ");
-                        appendNumber(dbgMsg, request->tick, FALSE);
+                        appendNumber(dbgMsg, request.tick, FALSE);
                         addDebugMessage(dbgMsg);
                         ts.checkStateConsistencyWithAssert();
 #endif
@@ -1200,12 +1626,166 @@ static void processRequestTickTransactions(Peer* peer, RequestResponseHeader* he
             tickTransactionIndices[index] = tickTransactionIndices[--numberOfTickTransactions];
         }
     }
+}
+
+// Packs transactions into RespondTickTransactions messages, which are written in place in the response queue
+struct TickTransactionsPacker
+{
+    Peer* peer;
+    unsigned int dejavu;
+    RespondTickTransactions* response = NULL;
+    unsigned short elementIndex;
+
+    // Append transaction to current message, sending the message first if the transaction doesn't fit. Returns false
+    // if the response queue is full.
+    bool add(const Transaction* transaction)
+    {
+        const unsigned int size = transaction->totalSize();
+        if (response && response->transactionsSize + size > RespondTickTransactions::maxTransactionsSize)
+        {
+            flush();
+        }
+        if (!response)
+        {
+            response = (RespondTickTransactions*)reserveResponse(peer, sizeof(RespondTickTransactions) + RespondTickTransactions::maxTransactionsSize, elementIndex);
+            if (!response)
+            {
+                return false;
+            }
+            response->numberOfTransactions = 0;
+            response->transactionsSize = 0;
+        }
+        copyMem(response->transactions() + response->transactionsSize, transaction, size);
+        response->transactionsSize += size;
+        response->numberOfTransactions++;
+        return true;
+    }
+
+    // Send current message if any
+    void flush()
+    {
+        if (response)
+        {
+            commitResponse(elementIndex, response->payloadSize(), RespondTickTransactions::type(), dejavu);
+            response = NULL;
+        }
+    }
+};
+
+// Add all stored transactions of tick to packer in order of transaction index. Transactions have been checked before
+// they were stored, so only the tick is compared as a guard against corrupted storage. Returns false if the response
+// queue is full.
+static bool packTickTransactions(TickTransactionsPacker& packer, unsigned int tick)
+{
+    const unsigned long long* tickTransactionOffsets = NULL;
+    if (ts.tickInCurrentEpochStorage(tick))
+    {
+        tickTransactionOffsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(tick);
+    }
+    else if (ts.tickInPreviousEpochStorage(tick))
+    {
+        tickTransactionOffsets = ts.tickTransactionOffsets.getByTickInPreviousEpoch(tick);
+    }
+#if TICK_STORAGE_TIERED_MODE
+    else if (ts.tickInArchive(tick))
+    {
+        bool queueFull = false;
+        ts.tickArchive.acquireLock();
+        for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK && !queueFull; i++)
+        {
+            const Transaction* transaction = ts.tickArchive.getTransaction(tick, i);
+            if (transaction && transaction->tick == tick)
+            {
+                ASSERT(transaction->checkValidity());
+                queueFull = !packer.add(transaction);
+            }
+        }
+        ts.tickArchive.releaseLock();
+        return !queueFull;
+    }
+#endif
+
+    if (tickTransactionOffsets)
+    {
+        for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+        {
+            if (tickTransactionOffsets[i])
+            {
+                const Transaction* transaction = ts.tickTransactions(tickTransactionOffsets[i]);
+                if (transaction->tick == tick)
+                {
+                    ASSERT(transaction->checkValidity());
+                    if (!packer.add(transaction))
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void processRequestTickTransactions(Peer* peer, RequestResponseHeader* header)
+{
+    RequestTickTransactions* request = header->getPayload<RequestTickTransactions>();
+    sendTickTransactions(peer, header->dejavu(), *request);
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+}
+
+// Send tick data, quorum ticks, and transactions of a range of ticks for catching up, ends with one EndResponse.
+static void processRequestTickRange(Peer* peer, RequestResponseHeader* header)
+{
+    if (!header->checkPayloadSize(sizeof(RequestTickRange)))
+        return;
+    RequestTickRange* request = header->getPayload<RequestTickRange>();
+    const unsigned int numberOfTicks = (request->numberOfTicks < RequestTickRange::maxNumberOfTicks) ? request->numberOfTicks : RequestTickRange::maxNumberOfTicks;
+
+    // request all votes and transactions of each tick
+    RequestedQuorumTick quorumTick;
+    setMem(quorumTick.voteFlags, sizeof(quorumTick.voteFlags), 0);
+    RequestTickTransactions tickTransactions;
+    setMem(tickTransactions.transactionFlags, sizeof(tickTransactions.transactionFlags), 0);
+    const bool packed = (request->flags & RequestTickRange::packedTransactions) != 0;
+    TickTransactionsPacker packer{ peer, header->dejavu() };
+
+    for (unsigned int i = 0; i < numberOfTicks; i++)
+    {
+        const unsigned int tick = request->firstTick + i;
+        if (request->flags & RequestTickRange::withTickData)
+        {
+            sendTickData(peer, header->dejavu(), tick);
+        }
+        if (request->flags & RequestTickRange::withQuorumTicks)
+        {
+            quorumTick.tick = tick;
+            sendQuorumTicks(peer, header->dejavu(), quorumTick);
+        }
+        if (request->flags & RequestTickRange::withTransactions)
+        {
+            if (packed)
+            {
+                if (!packTickTransactions(packer, tick))
+                    break;
+            }
+            else
+            {
+                tickTransactions.tick = tick;
+                sendTickTransactions(peer, header->dejavu(), tickTransactions);
+            }
+        }
+    }
+    packer.flush();
     enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
 
 static void processRequestTransactionInfo(Peer* peer, RequestResponseHeader* header)
 {
     RequestTransactionInfo* request = header->getPayload<RequestTransactionInfo>();
+#if TICK_STORAGE_TIERED_MODE
+    // transaction may be returned from archive cache
+    ts.tickArchive.acquireLock();
+#endif
     const Transaction* transaction = ts.transactionsDigestAccess.findTransaction(request->txDigest);
     if (transaction)
     {
@@ -1215,6 +1795,9 @@ static void processRequestTransactionInfo(Peer* peer, RequestResponseHeader* hea
     {
         enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
     }
+#if TICK_STORAGE_TIERED_MODE
+    ts.tickArchive.releaseLock();
+#endif
 }
 
 static void processRequestCurrentTickInfo(Peer* peer, RequestResponseHeader* header)
@@ -1282,54 +1865,253 @@ static void processRequestEntity(Peer* peer, RequestResponseHeader* header)
     }
     else
     {
-        copyMem(&respondedEntity.entity, &spectrum[respondedEntity.spectrumIndex], sizeof(EntityRecord));
-        ACQUIRE(spectrumLock);
-        getSiblings<SPECTRUM_DEPTH>(respondedEntity.spectrumIndex, spectrumDigests, respondedEntity.siblings);
-        RELEASE(spectrumLock);
+        // record and siblings are usually read without spectrumLock, both consistent with one version of the digests
+        getSpectrumEntityAndSiblings(respondedEntity.spectrumIndex, respondedEntity.entity, respondedEntity.siblings);
     }
 
 
     enqueueResponse(peer, sizeof(respondedEntity), RespondEntity::type(), header->dejavu(), &respondedEntity);
 }
 
-static void processRequestActiveIPOs(Peer* peer, RequestResponseHeader* header)
+// Send records of many entities packed into RespondEntities messages, with one optional multiproof per message instead
+// of one proof per entity. Like processRequestEntity(), it doesn't acquire spectrumLock in the common case, and the
+// records of each message are read together with its multiproof in one seqlock window.
+static void processRequestEntities(Peer* peer, RequestResponseHeader* header)
 {
-    RespondActiveIPO response;
-    for (unsigned int contractIndex = 1; contractIndex < contractCount; ++contractIndex)
+    RequestEntities* request = header->getPayload<RequestEntities>();
+    if (!header->checkPayloadSizeMinMax(sizeof(RequestEntities), sizeof(RequestEntities) + RequestEntities::maxPublicKeys * sizeof(m256i))
+        || !header->checkPayloadSize(request->payloadSize()))
+    {
+        return;
+    }
+    const m256i* publicKeys = request->publicKeys();
+    const bool withSiblings = (request->flags & RequestEntities::getSiblings) != 0;
+
+    struct
+    {
+        RequestResponseHeader header;
+        RespondEntities payload;
+        unsigned char data[RespondEntities::maxRecords * sizeof(RespondEntities::Record) + RespondEntities::maxSiblings * sizeof(m256i)];
+    } response;
+    static_assert(sizeof(response) < 32 * 1024, "Large alloc in stack may need reconsideration.");
+
+    for (unsigned int begin = 0; begin < request->numberOfPublicKeys; begin += RespondEntities::maxRecords)
     {
-        if (system.epoch == contractDescriptions[contractIndex].constructionEpoch - 1) // IPO happens in the epoch before construction
+        unsigned int count = request->numberOfPublicKeys - begin;
+        if (count > RespondEntities::maxRecords)
+            count = RespondEntities::maxRecords;
+
+        response.payload.tick = system.tick;
+        response.payload.numberOfRecords = (unsigned short)count;
+        response.payload.numberOfSiblings = 0;
+        RespondEntities::Record* records = response.payload.records();
+        unsigned long long leafIndices[RespondEntities::maxRecords];
+        unsigned int leafCount = 0;
+        for (unsigned int i = 0; i < count; i++)
         {
-            response.contractIndex = contractIndex;
-            copyMem(response.assetName, contractDescriptions[contractIndex].assetName, 8);
-            enqueueResponse(peer, sizeof(RespondActiveIPO), RespondActiveIPO::type(), header->dejavu(), &response);
+            const m256i& publicKey = publicKeys[begin + i];
+            const int index = spectrumIndex(publicKey);
+            if (index < 0)
+            {
+                setMem(&records[i].entity, sizeof(EntityRecord), 0);
+                records[i].entity.publicKey = publicKey;
+            }
+            else
+            {
+                // insert into sorted leaf indices without duplicates (required for multiproof)
+                unsigned int j = leafCount;
+                for (; j > 0 && leafIndices[j - 1] > (unsigned long long)index; j--)
+                    ;
+                if (!j || leafIndices[j - 1] != (unsigned long long)index)
+                {
+                    for (unsigned int k = leafCount; k > j; k--)
+                        leafIndices[k] = leafIndices[k - 1];
+                    leafIndices[j] = index;
+                    ++leafCount;
+                }
+            }
+            records[i].spectrumIndex = index;
+            records[i]._padding = 0;
+        }
+        if (leafCount)
+        {
+            unsigned long long workBuffer[RespondEntities::maxRecords];
+            EntityRecord entities[RespondEntities::maxRecords];
+            response.payload.numberOfSiblings = (unsigned short)getSpectrumEntitiesAndMultiproof(leafIndices, workBuffer, leafCount, entities, withSiblings ? response.payload.siblings() : NULL);
+            for (unsigned int i = 0; i < count; i++)
+            {
+                if (records[i].spectrumIndex < 0)
+                    continue;
+                unsigned int j = 0;
+                while (leafIndices[j] != (unsigned long long)records[i].spectrumIndex)
+                    ++j;
+                copyMem(&records[i].entity, &entities[j], sizeof(EntityRecord));
+            }
         }
+
+        response.header.checkAndSetSize(sizeof(RequestResponseHeader) + response.payload.payloadSize());
+        response.header.setType(RespondEntities::type());
+        response.header.setDejavu(header->dejavu());
+        enqueueResponse(peer, &response.header);
     }
+
     enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
 }
 
-static void processRequestContractIPO(Peer* peer, RequestResponseHeader* header)
+// Send chunk of spectrum, universe, or contract state with Merkle proof for syncing the state from peers (see
+// RequestStateChunk). The response is written in place in the response queue.
+static void processRequestStateChunk(Peer* peer, RequestResponseHeader* header)
 {
-    RespondContractIPO respondContractIPO;
+    if (!header->checkPayloadSize(sizeof(RequestStateChunk)))
+        return;
+    RequestStateChunk* request = header->getPayload<RequestStateChunk>();
 
-    RequestContractIPO* request = header->getPayload<RequestContractIPO>();
-    respondContractIPO.contractIndex = request->contractIndex;
-    respondContractIPO.tick = system.tick;
-    if (request->contractIndex >= contractCount
-        || system.epoch != (contractDescriptions[request->contractIndex].constructionEpoch - 1))
+    unsigned short elementIndex;
+    RespondStateChunk* response = (RespondStateChunk*)reserveResponse(peer, RespondStateChunk::maxPayloadSize, elementIndex);
+    if (!response)
+        return;
+    setMem(response, sizeof(RespondStateChunk), 0);
+    response->tick = system.tick;
+    response->stateType = request->stateType;
+    response->firstIndex = request->firstIndex;
+
+    bool proven = false;
+    const unsigned int count = request->numberOfRecords;
+    const bool isDigests = (request->stateType & RequestStateChunk::chunkDigestsFlag) != 0;
+    const unsigned char stateType = (unsigned char)(request->stateType & ~RequestStateChunk::chunkDigestsFlag);
+    if (stateType == RequestStateChunk::contractState && !isDigests)
+    {
+        const unsigned int contractIndex = request->contractIndex;
+        const unsigned long long stateSize = (contractIndex < contractCount) ? contractDescriptions[contractIndex].stateSize : 0;
+        const unsigned long long offset = (unsigned long long)request->firstIndex * RequestStateChunk::maxContractStateBytes;
+        if (offset < stateSize)
+        {
+            response->contractIndex = request->contractIndex;
+            response->numberOfRecords = (unsigned int)((stateSize - offset < RequestStateChunk::maxContractStateBytes) ? stateSize - offset : RequestStateChunk::maxContractStateBytes);
+            proven = readContractStateChunk(contractIndex, offset, response->numberOfRecords, (unsigned char*)response->records(), response->siblings(), response->rootDigest);
+            if (proven)
+                response->numberOfSiblings = (unsigned char)(1 + contractStateDigestTree.depth);
+        }
+    }
+    else if ((stateType == RequestStateChunk::spectrumState || stateType == RequestStateChunk::universeState)
+        && count && count <= RequestStateChunk::maxRecords && !(count & (count - 1)) && !(request->firstIndex & (count - 1)))
+    {
+        const bool isSpectrum = stateType == RequestStateChunk::spectrumState;
+        const unsigned int depth = isSpectrum ? SPECTRUM_DEPTH : ASSETS_DEPTH;
+        unsigned int countLevel = 0;
+        while ((1u << countLevel) < count)
+            ++countLevel;
+        const unsigned int level = isDigests ? request->level : 0;
+        if (level + countLevel <= depth && request->firstIndex < (1ULL << (depth - level)))
+        {
+            response->numberOfRecords = count;
+            if (isDigests)
+            {
+                proven = isSpectrum
+                    ? readSpectrumChunkDigests(level, request->firstIndex, count, countLevel, (m256i*)response->records(), response->siblings(), response->rootDigest)
+                    : readUniverseChunkDigests(level, request->firstIndex, count, countLevel, (m256i*)response->records(), response->siblings(), response->rootDigest);
+            }
+            else
+            {
+                proven = isSpectrum
+                    ? readSpectrumChunk(request->firstIndex, count, countLevel, (EntityRecord*)response->records(), response->siblings(), response->rootDigest)
+                    : readUniverseChunk(request->firstIndex, count, countLevel, (AssetRecord*)response->records(), response->siblings(), response->rootDigest);
+            }
+            if (proven)
+                response->numberOfSiblings = (unsigned char)(depth - level - countLevel);
+        }
+    }
+
+    if (!proven)
     {
-        setMem(respondContractIPO.publicKeys, sizeof(respondContractIPO.publicKeys), 0);
-        setMem(respondContractIPO.prices, sizeof(respondContractIPO.prices), 0);
+        response->numberOfRecords = 0;
+        response->numberOfSiblings = 0;
+        response->rootDigest = m256i::zero();
     }
-    else
+
+    commitResponse(elementIndex, (unsigned int)response->payloadSize(), RespondStateChunk::type(), header->dejavu());
+}
+
+// Responses of the active IPOs of the current epoch, rebuilt once per epoch
+struct ActiveIPOsResponses
+{
+    unsigned int numberOfIPOs;
+    RespondActiveIPO ipos[contractCount];
+};
+static ResponseCache<ActiveIPOsResponses> activeIPOsResponseCache;
+
+static void processRequestActiveIPOs(Peer* peer, RequestResponseHeader* header)
+{
+    const ActiveIPOsResponses& responses = activeIPOsResponseCache.acquire(m256i(system.epoch, 0, 0, 0), [](ActiveIPOsResponses& responses)
+        {
+            responses.numberOfIPOs = 0;
+            for (unsigned int contractIndex = 1; contractIndex < contractCount; ++contractIndex)
+            {
+                if (system.epoch == contractDescriptions[contractIndex].constructionEpoch - 1) // IPO happens in the epoch before construction
+                {
+                    RespondActiveIPO& response = responses.ipos[responses.numberOfIPOs++];
+                    response.contractIndex = contractIndex;
+                    copyMem(response.assetName, contractDescriptions[contractIndex].assetName, 8);
+                }
+            }
+        });
+
+    unsigned short elementIndex;
+    const unsigned int reservedCount = reserveResponses(peer, responses.numberOfIPOs, sizeof(RespondActiveIPO), RespondActiveIPO::type(), header->dejavu(), elementIndex);
+    for (unsigned int i = 0; i < reservedCount; i++, elementIndex++)
     {
-        contractStateLock[request->contractIndex].acquireRead();
-        IPO* ipo = (IPO*)contractStates[request->contractIndex];
-        copyMem(respondContractIPO.publicKeys, ipo->publicKeys, sizeof(respondContractIPO.publicKeys));
-        copyMem(respondContractIPO.prices, ipo->prices, sizeof(respondContractIPO.prices));
-        contractStateLock[request->contractIndex].releaseRead();
+        copyMem(getReservedResponsePayload(elementIndex), &responses.ipos[i], sizeof(RespondActiveIPO));
+        releaseReservedResponse(elementIndex);
     }
+    activeIPOsResponseCache.release();
+
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+}
+
+// Responses of RequestContractIPO, rebuilt if the bids change. Usually only one or two contracts are in IPO at the same
+// time, so a few caches selected by contract index are enough.
+#define CONTRACT_IPO_RESPONSE_CACHES 4
+static ResponseCache<RespondContractIPO> contractIPOResponseCaches[CONTRACT_IPO_RESPONSE_CACHES];
+
+static void processRequestContractIPO(Peer* peer, RequestResponseHeader* header)
+{
+    RequestContractIPO* request = header->getPayload<RequestContractIPO>();
+    const unsigned int contractIndex = request->contractIndex;
+    const bool inIPO = contractIndex < contractCount && system.epoch == (contractDescriptions[contractIndex].constructionEpoch - 1);
 
-    enqueueResponse(peer, sizeof(respondContractIPO), RespondContractIPO::type(), header->dejavu(), &respondContractIPO);
+    // bids of contracts not in IPO are sent as zeros, so the cached payload only depends on the bids if inIPO
+    const m256i version(system.epoch, contractIndex, inIPO ? ipoBidsVersion[contractIndex] : -1, inIPO);
+    ResponseCache<RespondContractIPO>& cache = contractIPOResponseCaches[contractIndex % CONTRACT_IPO_RESPONSE_CACHES];
+    const RespondContractIPO& cachedResponse = cache.acquire(version, [contractIndex, inIPO](RespondContractIPO& response)
+        {
+            response.contractIndex = contractIndex;
+            response.tick = 0;
+            if (!inIPO)
+            {
+                setMem(response.publicKeys, sizeof(response.publicKeys), 0);
+                setMem(response.prices, sizeof(response.prices), 0);
+            }
+            else
+            {
+                contractStateLock[contractIndex].acquireRead();
+                IPO* ipo = (IPO*)contractStates[contractIndex];
+                copyMem(response.publicKeys, ipo->publicKeys, sizeof(response.publicKeys));
+                copyMem(response.prices, ipo->prices, sizeof(response.prices));
+                contractStateLock[contractIndex].releaseRead();
+            }
+        });
+
+    // copy cached payload into the response queue directly and only set the current tick
+    unsigned short elementIndex;
+    RespondContractIPO* response = (RespondContractIPO*)reserveResponse(peer, sizeof(RespondContractIPO), elementIndex);
+    if (response)
+    {
+        copyMem(response, &cachedResponse, sizeof(RespondContractIPO));
+        response->tick = system.tick;
+    }
+    cache.release();
+    if (response)
+        commitResponse(elementIndex, sizeof(RespondContractIPO), RespondContractIPO::type(), header->dejavu());
 }
 
 static void processRequestContractFunction(Peer* peer, const unsigned long long processorNumber, RequestResponseHeader* header)
@@ -1340,16 +2122,37 @@ static void processRequestContractFunction(Peer* peer, const unsigned long long
     if (header->size() != sizeof(RequestResponseHeader) + sizeof(RequestContractFunction) + request->inputSize
         || !request->contractIndex || request->contractIndex >= contractCount
         || system.epoch < contractDescriptions[request->contractIndex].constructionEpoch
-        || !contractUserFunctions[request->contractIndex][request->inputType])
+        || !contractUserFunctions[request->contractIndex][request->inputType].function)
     {
         enqueueResponse(peer, 0, RespondContractFunction::type(), header->dejavu(), NULL);
     }
     else
     {
+#if CONTRACT_FUNCTION_CACHE_SIZE && CONTRACT_FUNCTION_STATE_SNAPSHOTS
+        // serve query that has already been answered with the same tick and contract state from cache
+        m256i cacheKey;
+        KangarooTwelve(request, sizeof(RequestContractFunction) + request->inputSize, &cacheKey, sizeof(cacheKey));
+        const unsigned int tick = system.tick;
+        unsigned char* cachedOutput = contractFunctionCacheOutputs[processorNumber];
+        unsigned int cachedOutputSize;
+        if (contractError[request->contractIndex] == NoContractError
+            && contractFunctionCache.get(cacheKey, tick, contractStateSnapshots[request->contractIndex].getPublishedVersion(), cachedOutput, cachedOutputSize))
+        {
+            enqueueResponse(peer, cachedOutputSize, RespondContractFunction::type(), header->dejavu(), cachedOutput);
+            return;
+        }
+#endif
+
         QpiContextUserFunctionCall qpiContext(request->contractIndex);
-        auto errorCode = qpiContext.call(request->inputType, (((unsigned char*)request) + sizeof(RequestContractFunction)), request->inputSize);
+        // request isn't needed after the call (cache key is computed before), so the function may run on its input directly
+        auto errorCode = qpiContext.call(request->inputType, (((unsigned char*)request) + sizeof(RequestContractFunction)), request->inputSize, true);
         if (errorCode == NoContractError)
         {
+#if CONTRACT_FUNCTION_CACHE_SIZE && CONTRACT_FUNCTION_STATE_SNAPSHOTS
+            // only outputs computed from a snapshot are cached (snapshotVersion is 0 if live state has been read)
+            contractFunctionCache.add(cacheKey, tick, qpiContext.snapshotVersion, qpiContext.outputBuffer, qpiContext.outputSize);
+#endif
+
             // success: respond with function output
             enqueueResponse(peer, qpiContext.outputSize, RespondContractFunction::type(), header->dejavu(), qpiContext.outputBuffer);
         }
@@ -1365,10 +2168,78 @@ static void processRequestContractFunction(Peer* peer, const unsigned long long
     }
 }
 
-static void processRequestSystemInfo(Peer* peer, RequestResponseHeader* header)
+#if CONTRACT_STATE_CHANGE_TRACKING
+static void processRequestContractStateChanges(Peer* peer, const unsigned long long processorNumber, RequestResponseHeader* header)
 {
-    RespondSystemInfo respondedSystemInfo;
+    RequestContractStateChanges* request = header->getPayload<RequestContractStateChanges>();
+    if (header->size() != sizeof(RequestResponseHeader) + sizeof(RequestContractStateChanges)
+        || !request->contractIndex || request->contractIndex >= contractCount
+        || system.epoch < contractDescriptions[request->contractIndex].constructionEpoch)
+    {
+        enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+        return;
+    }
+
+    ContractStateSnapshot& snapshot = contractStateSnapshots[request->contractIndex];
+    RespondContractStateChanges response;
+    setMem(&response, sizeof(response), 0);
+    response.streamId = contractStateChangesStreamId;
+    response.stateSize = contractDescriptions[request->contractIndex].stateSize;
+    response.contractIndex = request->contractIndex;
+    response.pageSize = contractStateSnapshotPageSize;
+    response.pageCount = snapshot.getPageCount();
+
+    // pages are read from the published snapshot, which isn't changed while it is acquired
+    unsigned int bufferIndex;
+    const unsigned char* state = (snapshot.isTrackingPageChanges()) ? (const unsigned char*)snapshot.acquire(bufferIndex) : nullptr;
+    if (!state)
+    {
+        // version 0: snapshot not available at the moment
+        enqueueResponse(peer, sizeof(response), RespondContractStateChanges::type(), header->dejavu(), &response);
+        enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+        return;
+    }
+    response.version = snapshot.getVersion(bufferIndex);
+
+    // versions of other node runs or newer than the snapshot (other node) are unknown -> send all pages
+    const unsigned int sinceVersion = (request->streamId == contractStateChangesStreamId && request->sinceVersion <= response.version) ? request->sinceVersion : 0;
+    const unsigned int maxNumberOfPages = (request->maxNumberOfPages && request->maxNumberOfPages < contractStateChangesMaxPagesPerResponse) ? request->maxNumberOfPages : contractStateChangesMaxPagesPerResponse;
+    unsigned int pages[contractStateChangesMaxPagesPerResponse];
+    for (unsigned int page = request->firstPage; page < response.pageCount; ++page)
+    {
+        if (snapshot.getPageVersion(page) > sinceVersion)
+        {
+            if (response.numberOfPages == maxNumberOfPages)
+            {
+                response.nextPage = page;
+                break;
+            }
+            pages[response.numberOfPages++] = page;
+        }
+    }
+    enqueueResponse(peer, sizeof(response), RespondContractStateChanges::type(), header->dejavu(), &response);
+
+    RespondContractStatePage* pageResponse = (RespondContractStatePage*)contractStatePageResponses[processorNumber];
+    pageResponse->contractIndex = request->contractIndex;
+    for (unsigned int i = 0; i < response.numberOfPages; ++i)
+    {
+        const unsigned long long begin = pages[i] * contractStateSnapshotPageSize;
+        const unsigned int pageSize = (unsigned int)((response.stateSize - begin < contractStateSnapshotPageSize) ? response.stateSize - begin : contractStateSnapshotPageSize);
+        pageResponse->pageIndex = pages[i];
+        copyMem(pageResponse + 1, state + begin, pageSize);
+        enqueueResponse(peer, sizeof(RespondContractStatePage) + pageSize, RespondContractStatePage::type(), header->dejavu(), pageResponse);
+    }
+    snapshot.release(bufferIndex);
+
+    enqueueResponse(peer, 0, EndResponse::type(), header->dejavu(), NULL);
+}
+#endif
+
+// RespondSystemInfo, rebuilt if tick, epoch, number of transactions, or spectrum info change
+static ResponseCache<RespondSystemInfo> systemInfoResponseCache;
 
+static void buildSystemInfo(RespondSystemInfo& respondedSystemInfo)
+{
     respondedSystemInfo.version = system.version;
     respondedSystemInfo.epoch = system.epoch;
     respondedSystemInfo.tick = system.tick;
@@ -1403,11 +2274,86 @@ static void processRequestSystemInfo(Peer* peer, RequestResponseHeader* header)
     {
         respondedSystemInfo.computorPacketSignature = 0;
     }
-    
+}
+
+static void processRequestSystemInfo(Peer* peer, RequestResponseHeader* header)
+{
+    // dust thresholds only change together with the number of entities
+    const m256i version(((unsigned long long)system.epoch << 32) | system.tick,
+        ((unsigned long long)system.latestCreatedTick << 32) | numberOfTransactions,
+        ((unsigned long long)broadcastedComputors.computors.epoch << 32) | spectrumInfo.numberOfEntities,
+        spectrumInfo.totalAmount);
+    const RespondSystemInfo& respondedSystemInfo = systemInfoResponseCache.acquire(version, buildSystemInfo);
     enqueueResponse(peer, sizeof(respondedSystemInfo), RespondSystemInfo::type(), header->dejavu(), &respondedSystemInfo);
+    systemInfoResponseCache.release();
+}
+
+static void processRequestTickPhaseStats(Peer* peer, RequestResponseHeader* header)
+{
+    RespondTickPhaseStats respondedTickPhaseStats;
+
+    respondedTickPhaseStats.tick = system.tick;
+    tickPhaseStats.getStats(respondedTickPhaseStats);
+
+    enqueueResponse(peer, sizeof(respondedTickPhaseStats), RespondTickPhaseStats::type(), header->dejavu(), &respondedTickPhaseStats);
+}
+
+static void getLockStats(RespondLockStats& lockStats)
+{
+    const LockStatistics* locks[LOCK_STATS_COUNT] = {
+        &spectrumLock.getStatistics(),
+        &universeLock.getStatistics(),
+        &pendingTxsPool.getLockStatistics(),
+        &responseQueueHeadLock.getStatistics(),
+    };
+    lockStats.tick = system.tick;
+    lockStats._padding = 0;
+    lockStats.tscFrequency = frequency;
+    for (unsigned int i = 0; i < LOCK_STATS_COUNT; i++)
+    {
+        lockStats.locks[i].acquisitionCount = locks[i]->acquisitionCount;
+        lockStats.locks[i].contendedAcquisitionCount = locks[i]->contendedAcquisitionCount;
+        lockStats.locks[i].spinCycles = locks[i]->spinCycles;
+    }
+}
+
+static void processRequestLockStats(Peer* peer, RequestResponseHeader* header)
+{
+    RespondLockStats respondedLockStats;
+    getLockStats(respondedLockStats);
+
+    enqueueResponse(peer, sizeof(respondedLockStats), RespondLockStats::type(), header->dejavu(), &respondedLockStats);
 }
 
 
+// Update share count and stats after the validity of a solution has been stored in the cache (if the solution has been
+// found in the cache). Returns status for RespondCustomMiningSolutionVerification.
+static long long applyCustomMiningSolutionVerification(RequestCustomMiningSolutionVerification* request, bool foundInCache)
+{
+    if (!foundInCache)
+    {
+        return RespondCustomMiningSolutionVerification::notExisted;
+    }
+
+    if (0 == request->isValid)
+    {
+        // Reduce the share of this nonce if it is invalid
+        CustomMiningSolutionV2 solution = customMiningVerificationRequestToSolution(request);
+        unsigned short computorID = customMiningGetComputorID(&solution);
+        ACQUIRE(gCustomMiningSharesCountLock);
+        gCustomMiningSharesCount[computorID] = gCustomMiningSharesCount[computorID] > 0 ? gCustomMiningSharesCount[computorID] - 1 : 0;
+        RELEASE(gCustomMiningSharesCountLock);
+
+        // Save the number of invalid share count
+        ATOMIC_INC64(gCustomMiningStats.phaseV2.invalid);
+
+        return RespondCustomMiningSolutionVerification::invalid;
+    }
+
+    ATOMIC_INC64(gCustomMiningStats.phaseV2.valid);
+    return RespondCustomMiningSolutionVerification::valid;
+}
+
 // Process the request for custom mining solution verification.
 // The request contains a single solution along with its validity status.
 // Once the validity is determined, the solution is marked as verified in storage
@@ -1438,33 +2384,9 @@ static void processRequestedCustomMiningSolutionVerificationRequest(Peer* peer,
                 fullEntry.setVerified(true);
                 fullEntry.setValid(request->isValid > 0);
 
-                // Check the computor idx of this solution
-                unsigned short computorID = customMiningGetComputorID(&solution);
                 // Also re-update the cache data with verified = true and validity
-                if ( gSystemCustomMiningSolutionV2Cache.tryFetchingAndUpdateHitData(fullEntry))
-                {
-                    // Reduce the share of this nonce if it is invalid
-                    if (0 == request->isValid)
-                    {
-                        ACQUIRE(gCustomMiningSharesCountLock);
-                        gCustomMiningSharesCount[computorID] = gCustomMiningSharesCount[computorID] > 0 ? gCustomMiningSharesCount[computorID] - 1 : 0;
-                        RELEASE(gCustomMiningSharesCountLock);
-
-                        // Save the number of invalid share count
-                        ATOMIC_INC64(gCustomMiningStats.phaseV2.invalid);
-
-                        respond.status = RespondCustomMiningSolutionVerification::invalid;
-                    }
-                    else
-                    {
-                        ATOMIC_INC64(gCustomMiningStats.phaseV2.valid);
-                        respond.status = RespondCustomMiningSolutionVerification::valid;
-                    }
-                }
-                else
-                {
-                    respond.status = RespondCustomMiningSolutionVerification::notExisted;
-                }
+                const bool found = gSystemCustomMiningSolutionV2Cache.tryFetchingAndUpdateHitData(fullEntry);
+                respond.status = applyCustomMiningSolutionVerification(request, found);
             }
             else
             {
@@ -1475,6 +2397,69 @@ static void processRequestedCustomMiningSolutionVerificationRequest(Peer* peer,
     }
 }
 
+// Batch version of processRequestedCustomMiningSolutionVerificationRequest() for verifiers reporting many solutions:
+// one signature check and one lookup pass through the cache for up to RequestCustomMiningSolutionVerificationBatch::maxCount
+// solutions. The response lists the status of each solution in the order of the request.
+static void processRequestedCustomMiningSolutionVerificationBatchRequest(Peer* peer, const unsigned long long processorNumber, RequestResponseHeader* header)
+{
+    RequestCustomMiningSolutionVerificationBatch* request = header->getPayload<RequestCustomMiningSolutionVerificationBatch>();
+    if (header->size() < sizeof(RequestResponseHeader) + sizeof(RequestCustomMiningSolutionVerificationBatch) + SIGNATURE_SIZE
+        || request->count > RequestCustomMiningSolutionVerificationBatch::maxCount
+        || header->size() != sizeof(RequestResponseHeader) + sizeof(RequestCustomMiningSolutionVerificationBatch) + request->count * sizeof(RequestCustomMiningSolutionVerification) + SIGNATURE_SIZE)
+    {
+        return;
+    }
+
+    unsigned char digest[32];
+    KangarooTwelve(request, header->size() - sizeof(RequestResponseHeader) - SIGNATURE_SIZE, digest, sizeof(digest));
+    if (!verify(operatorPublicKey.m256i_u8, digest, ((const unsigned char*)header + (header->size() - SIGNATURE_SIZE))))
+    {
+        return;
+    }
+
+    char recordSolutions = 0;
+    ACQUIRE(gIsInCustomMiningStateLock);
+    recordSolutions = gIsInCustomMiningState;
+    RELEASE(gIsInCustomMiningStateLock);
+
+    // Processor buffer layout: [response header, count * response, count * cache entry, count * hit flag]
+    const unsigned int count = (unsigned int)request->count;
+    static_assert(sizeof(RespondCustomMiningSolutionVerificationBatch) + RequestCustomMiningSolutionVerificationBatch::maxCount
+        * (sizeof(RespondCustomMiningSolutionVerification) + sizeof(CustomMiningSolutionV2CacheEntry) + sizeof(bool)) <= CUSTOM_MINING_STORAGE_PROCESSOR_MAX_STORAGE,
+        "Processor buffer too small for batch of custom mining solution verifications");
+    RequestCustomMiningSolutionVerification* items = (RequestCustomMiningSolutionVerification*)(request + 1);
+    RespondCustomMiningSolutionVerificationBatch* respond = (RespondCustomMiningSolutionVerificationBatch*)gCustomMiningStorage._dataBuffer[processorNumber];
+    RespondCustomMiningSolutionVerification* responses = (RespondCustomMiningSolutionVerification*)(respond + 1);
+    CustomMiningSolutionV2CacheEntry* entries = (CustomMiningSolutionV2CacheEntry*)(responses + count);
+    bool* found = (bool*)(entries + count);
+
+    respond->count = count;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        responses[i] = customMiningVerificationRequestToRespond(&items[i]);
+        responses[i].status = RespondCustomMiningSolutionVerification::customMiningStateEnded;
+    }
+
+    if (recordSolutions)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            CustomMiningSolutionV2 solution = customMiningVerificationRequestToSolution(&items[i]);
+            entries[i].set(&solution);
+            entries[i].setVerified(true);
+            entries[i].setValid(items[i].isValid > 0);
+        }
+        gSystemCustomMiningSolutionV2Cache.tryFetchingAndUpdateHitData(entries, count, found);
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            responses[i].status = applyCustomMiningSolutionVerification(&items[i], found[i]);
+        }
+    }
+
+    enqueueResponse(peer, (unsigned int)(sizeof(RespondCustomMiningSolutionVerificationBatch) + count * sizeof(RespondCustomMiningSolutionVerification)),
+        RespondCustomMiningSolutionVerificationBatch::type(), header->dejavu(), respond);
+}
+
 // Process custom mining data requests.
 // Currently supports:
 // - Requesting a range of tasks (using Unix timestamps as unique indexes; each task has only one unique index).
@@ -1797,6 +2782,66 @@ static void processSpecialCommand(Peer* peer, RequestResponseHeader* header)
             }
             break;
 
+            case SPECIAL_COMMAND_GET_CONTRACT_EXECUTION_PROFILE:
+            {
+                const auto* _request = header->getPayload<SpecialCommandGetContractExecutionProfileRequest>();
+                ACQUIRE(contractExecutionProfileResponseLock);
+                SpecialCommandGetContractExecutionProfileResponse& response = contractExecutionProfileResponse;
+                response.everIncreasingNonceAndCommandType = _request->everIncreasingNonceAndCommandType;
+                response.firstRecord = _request->firstRecord;
+                response.numberOfEntries = contractExecutionProfile.getRecords(response.firstRecord, response.nextRecord,
+                    response.entries, sizeof(response.entries) / sizeof(response.entries[0]));
+                response.frequency = frequency;
+                response.droppedCalls = contractExecutionProfile.getDroppedCalls();
+                response.padding = 0;
+                const unsigned int responseSize = offsetof(SpecialCommandGetContractExecutionProfileResponse, entries)
+                    + response.numberOfEntries * sizeof(ContractExecutionProfileEntry);
+                enqueueResponse(peer, responseSize, SpecialCommand::type(), header->dejavu(), &response);
+                RELEASE(contractExecutionProfileResponseLock);
+            }
+            break;
+
+            case SPECIAL_COMMAND_GET_SAMPLED_PROFILE:
+            {
+                const auto* _request = header->getPayload<SpecialCommandGetSampledProfileRequest>();
+                SpecialCommandGetSampledProfileResponse response;
+                response.everIncreasingNonceAndCommandType = _request->everIncreasingNonceAndCommandType;
+                response.frequency = frequency;
+                response.lostEvents = gSamplingProfiler.getLostEvents();
+                const unsigned int maxEntries = (_request->maxEntries < SAMPLED_SCOPE_COUNT) ? _request->maxEntries : SAMPLED_SCOPE_COUNT;
+                response.numberOfEntries = gSamplingProfiler.getTopScopes((SampledScopeStats*)response.entries, maxEntries, _request->sortByP99 != 0);
+                response.padding = 0;
+                if (_request->resetAfterReading)
+                {
+                    gSamplingProfiler.reset();
+                }
+                const unsigned int responseSize = offsetof(SpecialCommandGetSampledProfileResponse, entries)
+                    + response.numberOfEntries * sizeof(SpecialCommandGetSampledProfileResponse::Entry);
+                enqueueResponse(peer, responseSize, SpecialCommand::type(), header->dejavu(), &response);
+            }
+            break;
+
+            case SPECIAL_COMMAND_DUMP_SAMPLED_PROFILE_TRACE:
+            {
+                const auto* _request = header->getPayload<SpecialCommandDumpSampledProfileTraceRequestAndResponse>();
+                samplingProfilerTraceMilliseconds = (_request->milliseconds) ? _request->milliseconds : 1;
+                enqueueResponse(peer, sizeof(SpecialCommandDumpSampledProfileTraceRequestAndResponse), SpecialCommand::type(), header->dejavu(), _request);
+            }
+            break;
+
+            case SPECIAL_COMMAND_GET_MEMORY_FOOTPRINT:
+            {
+                SpecialCommandGetMemoryFootprintResponse response;
+                response.everIncreasingNonceAndCommandType = request->everIncreasingNonceAndCommandType;
+                response.untrackedAllocationCount = memoryRegistry.getUntrackedAllocationCount();
+                response.numberOfEntries = memoryRegistry.getSubsystems((MemoryRegistry::Subsystem*)response.entries, MemoryRegistry::maxSubsystems);
+                response.padding = 0;
+                const unsigned int responseSize = offsetof(SpecialCommandGetMemoryFootprintResponse, entries)
+                    + response.numberOfEntries * sizeof(SpecialCommandGetMemoryFootprintResponse::Entry);
+                enqueueResponse(peer, responseSize, SpecialCommand::type(), header->dejavu(), &response);
+            }
+            break;
+
             }
         }
     }
@@ -1813,18 +2858,33 @@ static void processOracleMachineReply(Peer* peer, RequestResponseHeader* header)
     auto* msg = header->getPayload<OracleMachineReply>();
     if (header->size() >= sizeof(RequestResponseHeader) + sizeof(OracleMachineReply))
     {
+        oracleMachineChannel.processReply(msg->oracleQueryId);
         oracleEngine.processOracleMachineReply(msg, header->getPayloadSize());
         peer->lastOMActivityTime = __rdtsc();
     }
 }
 
+static void processOracleMachineCapabilities(Peer* peer, RequestResponseHeader* header)
+{
+    // Ignore message fron non oracle machine node
+    if (!peer->isOracleMachineNode())
+    {
+        return;
+    }
+
+    auto* msg = header->getPayload<OracleMachineCapabilities>();
+    if (header->size() >= sizeof(RequestResponseHeader) + sizeof(OracleMachineCapabilities))
+    {
+        // batch frames are only sent after the OM node has announced support
+        peer->omMaxQueriesPerFrame = max(OM_MAX_QUERIES_PER_FRAME, min(msg->maxQueriesPerBatch, OM_MAX_QUERIES_PER_BATCH_FRAME));
+        peer->lastOMActivityTime = __rdtsc();
+    }
+}
+
 // a tracker to detect if a thread is crashed
 static void checkinTime(unsigned long long processorNumber)
 {
-    threadTimeCheckin[processorNumber].second = utcTime.Second;
-    threadTimeCheckin[processorNumber].minute = utcTime.Minute;
-    threadTimeCheckin[processorNumber].hour = utcTime.Hour;
-    threadTimeCheckin[processorNumber].day = utcTime.Day;
+    threadTimeCheckin[processorNumber] = monotonicMilliseconds();
 }
 
 static void setNewMiningSeed()
@@ -2042,6 +3102,18 @@ static void requestProcessor(void* ProcedureArgument)
 
     Processor* processor = (Processor*)ProcedureArgument;
     RequestResponseHeader* header = (RequestResponseHeader*)processor->buffer;
+
+    // request processors are assigned to the traffic classes round-robin, the preferred request queue is processed first
+    unsigned int preferredRequestQueueType = CONSENSUS_REQUEST_QUEUE;
+    for (int i = 0; i < nRequestProcessorIDs; i++)
+    {
+        if (requestProcessorIDs[i] == processorNumber)
+        {
+            preferredRequestQueueType = i % NUMBER_OF_REQUEST_QUEUES;
+            break;
+        }
+    }
+
     while (!shutDownNode)
     {
         checkinTime(processorNumber);
@@ -2051,29 +3123,18 @@ static void requestProcessor(void* ProcedureArgument)
             _InterlockedIncrement(&epochTransitionWaitingRequestProcessors);
             BEGIN_WAIT_WHILE(epochTransitionState)
             {
+                // help tick processor with parallel jobs of epoch transition (such as rebuilding spectrum digests)
+                // and run independent phases of the transition concurrently
+                parallelJobs.tryHelp();
+                epochTransitionJobs.tryHelp();
+
                 {
-                    // to avoid potential overflow: consume the queue without processing requests
-                    ACQUIRE(requestQueueTailLock);
-                    if (requestQueueElementTail == requestQueueElementHead)
-                    {
-                        RELEASE(requestQueueTailLock);
-                    }
-                    else
+                    // to avoid potential overflow: consume the queues without processing requests
+                    unsigned int queueType;
+                    unsigned short elementIndex;
+                    if (claimRequestQueueElement(preferredRequestQueueType, queueType, elementIndex))
                     {
-                        {
-                            RequestResponseHeader* requestHeader = (RequestResponseHeader*)&requestQueueBuffer[requestQueueElements[requestQueueElementTail].offset];
-                            copyMem(header, requestHeader, requestHeader->size());
-                            requestQueueBufferTail += requestHeader->size();
-                        }
-
-                        Peer* peer = requestQueueElements[requestQueueElementTail].peer;
-
-                        if (requestQueueBufferTail > REQUEST_QUEUE_BUFFER_SIZE - BUFFER_SIZE)
-                        {
-                            requestQueueBufferTail = 0;
-                        }
-                        requestQueueElementTail++;
-                        RELEASE(requestQueueTailLock);
+                        releaseRequestQueueElement(requestQueues[queueType], elementIndex);
                     }
                 }
             }
@@ -2085,41 +3146,46 @@ static void requestProcessor(void* ProcedureArgument)
         if (solutionProcessorFlags[processorNumber])
         {
             PROFILE_NAMED_SCOPE("requestProcessor(): solution processing");
+            PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_SOLUTION_PROCESSING);
             score->tryProcessSolution(processorNumber);
         }
-        
-        if (requestQueueElementTail == requestQueueElementHead)
+
+        // help processing parallel jobs of tick or contract processor if any
+        if (parallelJobs.isJobActive())
         {
-            _mm_pause();
+            PROFILE_NAMED_SCOPE("requestProcessor(): parallel job processing");
+            PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_PARALLEL_JOB);
+            parallelJobs.tryHelp();
         }
-        else
+        
+        unsigned int queueType;
+        unsigned short elementIndex;
+        if (!claimRequestQueueElement(preferredRequestQueueType, queueType, elementIndex))
         {
-            ACQUIRE(requestQueueTailLock);
-
-            if (requestQueueElementTail == requestQueueElementHead)
+            // no request -> clear tick storage of new epoch if needed (see TickStorage::beginEpoch())
+            if (!ts.isClearingPending() || !ts.clearAhead())
             {
-                RELEASE(requestQueueTailLock);
+                _mm_pause();
             }
-            else
+        }
+        else
+        {
             {
                 PROFILE_NAMED_SCOPE("requestProcessor(): request processing");
+                PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_REQUEST_PROCESSING);
                 const unsigned long long beginningTick = __rdtsc();
 
+                // copy request in parallel with other request processors and release queue element afterwards
+                RequestQueue& queue = requestQueues[queueType];
                 {
-                    RequestResponseHeader* requestHeader = (RequestResponseHeader*)&requestQueueBuffer[requestQueueElements[requestQueueElementTail].offset];
+                    RequestResponseHeader* requestHeader = (RequestResponseHeader*)&queue.buffer[queue.elements[elementIndex].offset];
                     copyMem(header, requestHeader, requestHeader->size());
-                    requestQueueBufferTail += requestHeader->size();
-                }
-
-                Peer* peer = requestQueueElements[requestQueueElementTail].peer;
-
-                if (requestQueueBufferTail > REQUEST_QUEUE_BUFFER_SIZE - BUFFER_SIZE)
-                {
-                    requestQueueBufferTail = 0;
                 }
-                requestQueueElementTail++;
+                Peer* peer = queue.elements[elementIndex].peer;
+                m256i payloadDigest = queue.elements[elementIndex].payloadDigest;
+                releaseRequestQueueElement(queue, elementIndex);
+                const unsigned char requestType = header->type();
 
-                RELEASE(requestQueueTailLock);
                 switch (header->type())
                 {
                 case ExchangePublicPeers::type():
@@ -2148,13 +3214,13 @@ static void requestProcessor(void* ProcedureArgument)
 
                 case BroadcastFutureTickData::type():
                 {
-                    processBroadcastFutureTickData(peer, header);
+                    processBroadcastFutureTickData(peer, header, payloadDigest);
                 }
                 break;
 
                 case BROADCAST_TRANSACTION:
                 {
-                    processBroadcastTransaction(peer, header);
+                    processBroadcastTransaction(peer, header, payloadDigest);
                 }
                 break;
 
@@ -2182,6 +3248,12 @@ static void requestProcessor(void* ProcedureArgument)
                 }
                 break;
 
+                case RequestTickRange::type():
+                {
+                    processRequestTickRange(peer, header);
+                }
+                break;
+
                 case RequestTransactionInfo::type():
                 {
                     processRequestTransactionInfo(peer, header);
@@ -2206,6 +3278,18 @@ static void requestProcessor(void* ProcedureArgument)
                 }
                 break;
 
+                case RequestEntities::type():
+                {
+                    processRequestEntities(peer, header);
+                }
+                break;
+
+                case RequestStateChunk::type():
+                {
+                    processRequestStateChunk(peer, header);
+                }
+                break;
+
                 case RequestActiveIPOs::type():
                 {
                     processRequestActiveIPOs(peer, header);
@@ -2242,12 +3326,38 @@ static void requestProcessor(void* ProcedureArgument)
                 }
                 break;
 
+#if CONTRACT_STATE_CHANGE_TRACKING
+                case RequestContractStateChanges::type():
+                {
+                    processRequestContractStateChanges(peer, processorNumber, header);
+                }
+                break;
+#endif
+
                 case RequestLog::type():
                 {
                     logger.processRequestLog(processorNumber, peer, header);
                 }
                 break;
 
+                case RequestLogSubscription::type():
+                {
+                    logger.processRequestLogSubscription(peer, header);
+                }
+                break;
+
+                case RequestTickLogSummaries::type():
+                {
+                    logger.processRequestTickLogSummaries(processorNumber, peer, header);
+                }
+                break;
+
+                case RequestFilteredLog::type():
+                {
+                    logger.processRequestFilteredLog(processorNumber, peer, header);
+                }
+                break;
+
                 case RequestLogIdRangeFromTx::type():
                 {
                     logger.processRequestTxLogInfo(processorNumber, peer, header);
@@ -2278,6 +3388,18 @@ static void requestProcessor(void* ProcedureArgument)
                 }
                 break;
 
+                case RequestTickPhaseStats::type():
+                {
+                    processRequestTickPhaseStats(peer, header);
+                }
+                break;
+
+                case RequestLockStats::type():
+                {
+                    processRequestLockStats(peer, header);
+                }
+                break;
+
                 case RequestAssets::type():
                 {
                     processRequestAssets(peer, header);
@@ -2290,6 +3412,12 @@ static void requestProcessor(void* ProcedureArgument)
                 }
                 break;
 
+                case RequestCustomMiningSolutionVerificationBatch::type():
+                {
+                    processRequestedCustomMiningSolutionVerificationBatchRequest(peer, processorNumber, header);
+                }
+                break;
+
                 case RequestCustomMiningData::type():
                 {
                     processCustomMiningDataRequest(peer, processorNumber, header);
@@ -2308,6 +3436,12 @@ static void requestProcessor(void* ProcedureArgument)
                 }
                 break;
 
+                case OracleMachineCapabilities::type():
+                {
+                    processOracleMachineCapabilities(peer, header);
+                }
+                break;
+
                 case RequestOracleData::type():
                 {
                     oracleEngine.processRequestOracleData(peer, header);
@@ -2325,7 +3459,9 @@ static void requestProcessor(void* ProcedureArgument)
 
                 }
 
-                queueProcessingNumerator += __rdtsc() - beginningTick;
+                const unsigned long long processingTicks = __rdtsc() - beginningTick;
+                requestCostEstimator.update(requestType, processingTicks);
+                queueProcessingNumerator += processingTicks;
                 queueProcessingDenominator++;
 
                 _InterlockedIncrement64(&numberOfProcessedRequests);
@@ -2335,6 +3471,74 @@ static void requestProcessor(void* ProcedureArgument)
 }
 OPTIMIZE_ON()
 
+// Run procedures of tick hook batch until all have been claimed
+static void runTickHookBatchItems()
+{
+    long item;
+    while ((item = _InterlockedIncrement(&tickHookBatch.nextItem) - 1) < (long)tickHookBatch.count)
+    {
+        QpiContextSystemProcedureCall qpiContext(tickHookBatch.contractIndices[item], (SystemProcedureID)tickHookBatch.systemProcId, false);
+        qpiContext.call();
+        _InterlockedIncrement(&tickHookBatch.finishedItems);
+    }
+}
+
+// Run procedures of contracts collected in tickHookBatch and empty batch, called by contract processor
+static void runTickHookBatch()
+{
+    if (!tickHookBatch.count)
+        return;
+
+    contractActionTracker.init();
+    tickHookBatch.nextItem = 0;
+    tickHookBatch.finishedItems = 0;
+    if (tickHookBatch.count > 1)
+        _InterlockedExchange(&tickHookBatch.open, 1);
+
+    runTickHookBatchItems();
+    WAIT_WHILE(tickHookBatch.finishedItems < (long)tickHookBatch.count);
+
+    // make sure no helper is still reading the batch before it is changed
+    _InterlockedExchange(&tickHookBatch.open, 0);
+    WAIT_WHILE(tickHookBatch.activeHelpers);
+    tickHookBatch.count = 0;
+}
+
+// Add contract to tick hook batch or run its procedure directly if it isn't independent
+static void runOrBatchTickHook(unsigned int contractIndex, SystemProcedureID systemProcId)
+{
+    if (contractTickHooksIndependent[contractIndex] && nContractProcessorIDs > 1)
+    {
+        tickHookBatch.systemProcId = systemProcId;
+        tickHookBatch.contractIndices[tickHookBatch.count++] = contractIndex;
+    }
+    else
+    {
+        runTickHookBatch();
+        QpiContextSystemProcedureCall qpiContext(contractIndex, systemProcId);
+        qpiContext.call();
+    }
+}
+
+// Helps the contract processor with running the procedures of tick hook batches
+static void tickHookHelperProcessor(void*)
+{
+    enableAVX();
+
+    while (!shutDownNode)
+    {
+        if (tickHookBatch.open)
+        {
+            // announce being active before checking again, so the contract processor waits before changing the batch
+            _InterlockedIncrement(&tickHookBatch.activeHelpers);
+            if (tickHookBatch.open)
+                runTickHookBatchItems();
+            _InterlockedDecrement(&tickHookBatch.activeHelpers);
+        }
+        _mm_pause();
+    }
+}
+
 static void contractProcessor(void*)
 {
     enableAVX();
@@ -2415,10 +3619,10 @@ static void contractProcessor(void*)
                     continue;
                 }
 
-                QpiContextSystemProcedureCall qpiContext(executedContractIndex, BEGIN_TICK);
-                qpiContext.call();
+                runOrBatchTickHook(executedContractIndex, BEGIN_TICK);
             }
         }
+        runTickHookBatch();
     }
     break;
 
@@ -2442,10 +3646,10 @@ static void contractProcessor(void*)
                     continue;
                 }
 
-                QpiContextSystemProcedureCall qpiContext(executedContractIndex, END_TICK);
-                qpiContext.call();
+                runOrBatchTickHook(executedContractIndex, END_TICK);
             }
         }
+        runTickHookBatch();
     }
     break;
 
@@ -2514,7 +3718,7 @@ static void contractProcessor(void*)
         if (contractProcessorPhase == USER_PROCEDURE_CALL)
         {
             // Run user procedure
-            ASSERT(contractUserProcedures[contractIndex][transaction->inputType]);
+            ASSERT(contractUserProcedures[contractIndex][transaction->inputType].function);
 
             QpiContextUserProcedureCall qpiContext(contractIndex, transaction->sourcePublicKey, transaction->amount);
             qpiContext.call(transaction->inputType, transaction->inputPtr(), transaction->inputSize);
@@ -2618,7 +3822,7 @@ static bool processTickTransactionContractProcedure(const Transaction* transacti
     ASSERT(system.epoch >= contractDescriptions[contractIndex].constructionEpoch);
     ASSERT(system.epoch < contractDescriptions[contractIndex].destructionEpoch);
 
-    if (contractUserProcedures[contractIndex][transaction->inputType])
+    if (contractUserProcedures[contractIndex][transaction->inputType].function)
     {
         // Run user procedure call of transaction in contract processor
         // and wait for completion
@@ -2664,9 +3868,8 @@ static void processTickTransactionSolution(const MiningSolutionTransaction* tran
     static_assert(sizeof(data) == 3 * 32, "Unexpected array size");
     unsigned int flagIndex;
     KangarooTwelve(data, sizeof(data), &flagIndex, sizeof(flagIndex));
-    if (!(minerSolutionFlags[flagIndex >> 6] & (1ULL << (flagIndex & 63))))
+    if (minerSolutionFlags.set(flagIndex))
     {
-        minerSolutionFlags[flagIndex >> 6] |= (1ULL << (flagIndex & 63));
 
         unsigned int solutionScore = (*::score)(processorNumber, transaction->sourcePublicKey, transaction->miningSeed, transaction->nonce);
         score_engine::AlgoType selectedAlgo = score_engine::getAlgoType(transaction->nonce.m256i_u8);
@@ -2855,6 +4058,84 @@ static void processTickTransactionSolution(const MiningSolutionTransaction* tran
     }
 }
 
+// Entity lookups of the transactions of a tick, done before the tick is processed (see prefetchTickTransactions()).
+// The indices are hints only: the public key of the entity is checked before an index is used, because entities may
+// be created or the spectrum may be reorganized in between. Only accessed by tick processor (and helpers while it
+// waits for them).
+static struct
+{
+    unsigned int tick;
+    const Transaction* transactions[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    int sourceIndices[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    int destinationIndices[NUMBER_OF_TRANSACTIONS_PER_TICK];
+} transactionPrefetch;
+
+// Look up entities of transactions in slots [begin, end) (ParallelJobs::ChunkFunction). Comparing the public keys
+// in the hash map also loads the entity records into the shared cache.
+static void prefetchTransactionEntities(void*, unsigned long long begin, unsigned long long end)
+{
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        const Transaction* transaction = transactionPrefetch.transactions[i];
+        if (transaction)
+        {
+            transactionPrefetch.sourceIndices[i] = ::spectrumIndex(transaction->sourcePublicKey);
+            transactionPrefetch.destinationIndices[i] = ::spectrumIndex(transaction->destinationPublicKey);
+        }
+        else
+        {
+            transactionPrefetch.sourceIndices[i] = -1;
+            transactionPrefetch.destinationIndices[i] = -1;
+        }
+    }
+}
+
+// Deterministic read-only pass over the transactions of tick (described by nextTickData) that looks up their
+// source and destination entities in parallel. Called by the tick processor when all transactions of the next tick
+// are available, so the memory latency of the lookups is hidden while waiting for votes instead of adding to the
+// serial execution in processTick().
+static void prefetchTickTransactions(unsigned int tick)
+{
+    PROFILE_SCOPE();
+
+    transactionPrefetch.tick = tick;
+    const auto* tsTransactionOffsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(tick);
+    ts.tickTransactions.acquireLock();
+    for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+    {
+        // transactions are stored completely before the lock is released and aren't moved afterwards
+        transactionPrefetch.transactions[i] = (!isZero(nextTickData.transactionDigests[i]) && tsTransactionOffsets[i])
+            ? ts.tickTransactions(tsTransactionOffsets[i]) : nullptr;
+    }
+    ts.tickTransactions.releaseLock();
+
+    parallelJobs.run(prefetchTransactionEntities, nullptr, NUMBER_OF_TRANSACTIONS_PER_TICK, 64);
+}
+
+// Return index of entity publicKey in spectrum or -1, using the prefetched index if it is still valid
+static int prefetchedSpectrumIndex(int prefetchedIndex, const m256i& publicKey)
+{
+    if (prefetchedIndex >= 0 && spectrum[prefetchedIndex].publicKey == publicKey)
+    {
+        return prefetchedIndex;
+    }
+    return ::spectrumIndex(publicKey);
+}
+
+// Return spectrum index of source of transaction in slot of current tick or -1
+static int transactionSourceIndex(const Transaction* transaction, unsigned int transactionIndex)
+{
+    const bool prefetched = (transactionPrefetch.tick == system.tick && transactionPrefetch.transactions[transactionIndex] == transaction);
+    return prefetchedSpectrumIndex(prefetched ? transactionPrefetch.sourceIndices[transactionIndex] : -1, transaction->sourcePublicKey);
+}
+
+// Return spectrum index of destination of transaction in slot of current tick or -1
+static int transactionDestinationIndex(const Transaction* transaction, unsigned int transactionIndex)
+{
+    const bool prefetched = (transactionPrefetch.tick == system.tick && transactionPrefetch.transactions[transactionIndex] == transaction);
+    return prefetchedSpectrumIndex(prefetched ? transactionPrefetch.destinationIndices[transactionIndex] : -1, transaction->destinationPublicKey);
+}
+
 static void processTickTransaction(const Transaction* transaction, unsigned int transactionIndex, unsigned long long processorNumber)
 {
     PROFILE_SCOPE();
@@ -2893,14 +4174,11 @@ static void processTickTransaction(const Transaction* transaction, unsigned int
     }
 #endif
 
-    const int spectrumIndex = ::spectrumIndex(transaction->sourcePublicKey);
+    const int spectrumIndex = transactionSourceIndex(transaction, transactionIndex);
     if (spectrumIndex >= 0)
     {
         numberOfTransactions++;
         bool moneyFlew = false;
-#if ADDON_TX_STATUS_REQUEST
-        txStatusData.tickTxIndexStart[system.tick - system.initialTick + 1] = numberOfTransactions; // qli: part of tx_status_request add-on
-#endif
         if (decreaseEnergy(spectrumIndex, transaction->amount))
         {
             increaseEnergy(transaction->destinationPublicKey, transaction->amount);
@@ -2966,7 +4244,13 @@ static void processTickTransaction(const Transaction* transaction, unsigned int
 
                 case OracleReplyCommitTransactionPrefix::transactionType():
                 {
-                    oracleEngine.processOracleReplyCommitTransaction((OracleReplyCommitTransactionPrefix*)transaction);
+                    oracleEngine.processOracleReplyCommitTransaction((OracleReplyCommitTransactionPrefix*)transaction);
+                }
+                break;
+
+                case OracleReplyBatchCommitTransactionPrefix::transactionType():
+                {
+                    oracleEngine.processOracleReplyBatchCommitTransaction((OracleReplyBatchCommitTransactionPrefix*)transaction, verifyComputorSignature);
                 }
                 break;
 
@@ -3054,9 +4338,341 @@ static void processTickTransaction(const Transaction* transaction, unsigned int
         }
 
 #if ADDON_TX_STATUS_REQUEST
-        saveConfirmedTx(numberOfTransactions - 1, moneyFlew, system.tick, transactionDigest); // qli: save tx
+        saveConfirmedTx(system.tick, transactionIndex, moneyFlew); // qli: save tx
+#endif
+    }
+}
+
+// Deterministic parallel execution of independent QU transfers of a tick.
+//
+// A run is a sequence of consecutive transaction slots that only contain plain QU transfers: destination is an
+// existing entity that is neither the system (zero public key) nor a contract. The effects of such a transaction on
+// the spectrum only depend on its source and destination entity. Contract procedures and system transactions may
+// access arbitrary entities, so they end a run and are executed serially as before.
+//
+// The transfers of a run are partitioned into groups of transactions that (transitively) share entities. Groups are
+// executed in parallel with ParallelJobs, each group in canonical (slot) order. Afterwards, all transactions of the
+// run are committed serially in slot order (digest map, counters, logging, tx status, change flags), so spectrum,
+// logs, and digests are identical to serial execution.
+static constexpr unsigned int minTransfersForParallelExecution = 32;
+static constexpr unsigned int transferRunEntitySlots = 4 * NUMBER_OF_TRANSACTIONS_PER_TICK; // power of 2, > 2 entities per tx
+
+// Only used by tick processor
+static struct
+{
+    unsigned int size;
+    unsigned int numberOfGroups;
+    const Transaction* transactions[NUMBER_OF_TRANSACTIONS_PER_TICK]; // nullptr for empty slot
+    unsigned short slots[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    int sourceIndices[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    int destinationIndices[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    bool transferred[NUMBER_OF_TRANSACTIONS_PER_TICK];
+
+    // union-find parent of each transaction of run, order of transactions grouped by group, and begin of each group
+    unsigned short parents[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    unsigned short groupIds[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    unsigned short order[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    unsigned short groupBegin[NUMBER_OF_TRANSACTIONS_PER_TICK + 1];
+
+    // hash map spectrum index -> first transaction of run accessing the entity
+    int entityKeys[transferRunEntitySlots];
+    unsigned short entityTransactions[transferRunEntitySlots];
+} transferRun;
+
+// Check if transaction is a plain QU transfer (without looking up entities)
+static bool isPlainTransferCandidate(const Transaction* transaction)
+{
+    if (isZero(transaction->destinationPublicKey))
+    {
+        return false;
+    }
+    m256i maskedDestinationPublicKey = transaction->destinationPublicKey;
+    maskedDestinationPublicKey.m256i_u64[0] &= ~(MAX_NUMBER_OF_CONTRACTS - 1ULL);
+    const unsigned int contractIndex = (unsigned int)transaction->destinationPublicKey.m256i_u64[0];
+    return !(isZero(maskedDestinationPublicKey) && contractIndex < contractCount);
+}
+
+// Look up source and destination entities of transactions [begin, end) of run (ParallelJobs::ChunkFunction)
+static void lookUpTransferRunEntities(void*, unsigned long long begin, unsigned long long end)
+{
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        const Transaction* transaction = transferRun.transactions[i];
+        if (transaction)
+        {
+            transferRun.sourceIndices[i] = transactionSourceIndex(transaction, transferRun.slots[i]);
+            transferRun.destinationIndices[i] = transactionDestinationIndex(transaction, transferRun.slots[i]);
+        }
+    }
+}
+
+// Execute transfers of groups [begin, end) of run (ParallelJobs::ChunkFunction)
+static void executeTransferRunGroups(void*, unsigned long long begin, unsigned long long end)
+{
+    for (unsigned long long i = transferRun.groupBegin[begin]; i < transferRun.groupBegin[end]; i++)
+    {
+        const unsigned int t = transferRun.order[i];
+        transferRun.transferred[t] = transferEnergyWithoutLocking(transferRun.sourceIndices[t], transferRun.destinationIndices[t], transferRun.transactions[t]->amount);
+    }
+}
+
+static unsigned int findTransferRunRoot(unsigned int t)
+{
+    while (transferRun.parents[t] != t)
+    {
+        transferRun.parents[t] = transferRun.parents[transferRun.parents[t]];
+        t = transferRun.parents[t];
+    }
+    return t;
+}
+
+// Join group of transaction t with group of the transaction that accessed the entity first
+static void addTransferRunEntity(int entityIndex, unsigned int t)
+{
+    unsigned int slot = ((unsigned int)entityIndex * 2654435761U) & (transferRunEntitySlots - 1);
+    while (transferRun.entityKeys[slot] >= 0)
+    {
+        if (transferRun.entityKeys[slot] == entityIndex)
+        {
+            const unsigned int a = findTransferRunRoot(t);
+            const unsigned int b = findTransferRunRoot(transferRun.entityTransactions[slot]);
+            if (a != b)
+            {
+                // keep lower index as root, so the result doesn't depend on the order of joining
+                if (a < b)
+                    transferRun.parents[b] = a;
+                else
+                    transferRun.parents[a] = b;
+            }
+            return;
+        }
+        slot = (slot + 1) & (transferRunEntitySlots - 1);
+    }
+    transferRun.entityKeys[slot] = entityIndex;
+    transferRun.entityTransactions[slot] = t;
+}
+
+// Execute transfers [begin, end) of run in parallel and commit them in slot order. All transactions in the range
+// must have unknown source or existing destination.
+static void executeTransferSubRun(unsigned int begin, unsigned int end)
+{
+    // Partition into groups of transfers sharing entities. Transactions with unknown source are ignored.
+    for (unsigned int i = 0; i < transferRunEntitySlots; i++)
+    {
+        transferRun.entityKeys[i] = -1;
+    }
+    for (unsigned int t = begin; t < end; t++)
+    {
+        transferRun.parents[t] = t;
+        transferRun.transferred[t] = false;
+        if (transferRun.transactions[t] && transferRun.sourceIndices[t] >= 0)
+        {
+            addTransferRunEntity(transferRun.sourceIndices[t], t);
+            addTransferRunEntity(transferRun.destinationIndices[t], t);
+        }
+    }
+
+    // Number groups in order of first transaction and sort transactions by group (counting sort keeps slot order)
+    transferRun.numberOfGroups = 0;
+    setMem(transferRun.groupBegin, sizeof(transferRun.groupBegin), 0);
+    for (unsigned int t = begin; t < end; t++)
+    {
+        if (transferRun.transactions[t] && transferRun.sourceIndices[t] >= 0)
+        {
+            const unsigned int root = findTransferRunRoot(t);
+            if (root == t)
+            {
+                transferRun.groupIds[t] = transferRun.numberOfGroups++;
+            }
+            else
+            {
+                transferRun.groupIds[t] = transferRun.groupIds[root];
+            }
+            transferRun.groupBegin[transferRun.groupIds[t] + 1]++;
+        }
+    }
+    for (unsigned int g = 0; g < transferRun.numberOfGroups; g++)
+    {
+        transferRun.groupBegin[g + 1] += transferRun.groupBegin[g];
+    }
+    {
+        unsigned short groupFill[NUMBER_OF_TRANSACTIONS_PER_TICK];
+        copyMem(groupFill, transferRun.groupBegin, transferRun.numberOfGroups * sizeof(groupFill[0]));
+        for (unsigned int t = begin; t < end; t++)
+        {
+            if (transferRun.transactions[t] && transferRun.sourceIndices[t] >= 0)
+            {
+                transferRun.order[groupFill[transferRun.groupIds[t]]++] = t;
+            }
+        }
+    }
+
+    // Execute groups in parallel. Holding spectrumLock makes the batch atomic for other readers of the spectrum.
+    spectrumLock.acquire();
+    parallelJobs.run(executeTransferRunGroups, nullptr, transferRun.numberOfGroups, 16);
+    for (unsigned int t = begin; t < end; t++)
+    {
+        if (transferRun.transferred[t])
+        {
+            spectrumDigestTree.markLeafChanged(transferRun.sourceIndices[t]);
+            spectrumDigestTree.markLeafChanged(transferRun.destinationIndices[t]);
+        }
+    }
+    spectrumLock.release();
+
+    // Commit in slot order with the same side effects as processTickTransaction()
+    for (unsigned int t = begin; t < end; t++)
+    {
+        const Transaction* transaction = transferRun.transactions[t];
+        if (!transaction)
+        {
+            continue;
+        }
+        const unsigned int transactionIndex = transferRun.slots[t];
+        const m256i& transactionDigest = nextTickData.transactionDigests[transactionIndex];
+        logger.registerNewTx(transaction->tick, transactionIndex);
+
+        ts.transactionsDigestAccess.acquireLock();
+        ts.transactionsDigestAccess.insertTransaction(transactionDigest, transaction);
+        ts.transactionsDigestAccess.releaseLock();
+
+        if (transferRun.sourceIndices[t] >= 0)
+        {
+            numberOfTransactions++;
+            bool moneyFlew = false;
+            if (transferRun.transferred[t])
+            {
+                const QuTransfer quTransfer = { transaction->sourcePublicKey , transaction->destinationPublicKey , transaction->amount };
+                logger.logQuTransfer(quTransfer);
+                moneyFlew = (transaction->amount != 0);
+            }
+#if ADDON_TX_STATUS_REQUEST
+            saveConfirmedTx(system.tick, transactionIndex, moneyFlew); // qli: save tx
+#else
+            (void)moneyFlew;
 #endif
+        }
+    }
+}
+
+// Execute transactions [begin, end) of run serially
+static void processTransferRunSerially(unsigned int begin, unsigned int end, unsigned long long processorNumber)
+{
+    for (unsigned int t = begin; t < end; t++)
+    {
+        const Transaction* transaction = transferRun.transactions[t];
+        if (transaction)
+        {
+            logger.registerNewTx(transaction->tick, transferRun.slots[t]);
+            processTickTransaction(transaction, transferRun.slots[t], processorNumber);
+        }
+    }
+}
+
+// Process the run of plain QU transfers beginning at slot beginSlot. Returns the first slot that has not been
+// processed, which is beginSlot if the run is too short and the transaction has to be executed serially with
+// processTickTransaction(). Transfers that create a new entity split the run. They and parts of the run that are
+// too short are executed serially.
+static unsigned int processTickTransferRun(unsigned int beginSlot, const unsigned long long* tsTransactionOffsets, unsigned long long processorNumber)
+{
+    PROFILE_SCOPE();
+
+    if (isSpectrumReorganizationPending())
+    {
+        // increaseEnergy() would burn dust and reorganize, changing entity indices
+        return beginSlot;
+    }
+
+    // Collect candidates by static check of the transactions
+    unsigned int numberOfTransfers = 0;
+    transferRun.size = 0;
+    for (unsigned int slot = beginSlot; slot < NUMBER_OF_TRANSACTIONS_PER_TICK; slot++)
+    {
+        const Transaction* transaction = nullptr;
+        if (!isZero(nextTickData.transactionDigests[slot]))
+        {
+            if (!tsTransactionOffsets[slot])
+            {
+                break;
+            }
+            transaction = ts.tickTransactions(tsTransactionOffsets[slot]);
+            if (!isPlainTransferCandidate(transaction))
+            {
+                break;
+            }
+            numberOfTransfers++;
+        }
+        transferRun.transactions[transferRun.size] = transaction;
+        transferRun.slots[transferRun.size] = slot;
+        transferRun.sourceIndices[transferRun.size] = -1;
+        transferRun.destinationIndices[transferRun.size] = -1;
+        transferRun.size++;
+    }
+    if (numberOfTransfers < minTransfersForParallelExecution)
+    {
+        return beginSlot;
+    }
+
+    // Look up entities in parallel (spectrumIndex() is lock-free)
+    parallelJobs.run(lookUpTransferRunEntities, nullptr, transferRun.size, 64);
+
+    bool entityCreated = false;
+    unsigned int t = 0;
+    while (t < transferRun.size)
+    {
+        // Sub-run ends before the next transfer that creates a new entity. Entities that were unknown when looking
+        // them up may have been created by a transfer before, so they are looked up again while scanning the sub-run.
+        unsigned int end = t;
+        numberOfTransfers = 0;
+        for (; end < transferRun.size; end++)
+        {
+            const Transaction* transaction = transferRun.transactions[end];
+            if (!transaction)
+            {
+                continue;
+            }
+            if (entityCreated)
+            {
+                if (transferRun.sourceIndices[end] < 0)
+                {
+                    transferRun.sourceIndices[end] = ::spectrumIndex(transaction->sourcePublicKey);
+                }
+                if (transferRun.destinationIndices[end] < 0)
+                {
+                    transferRun.destinationIndices[end] = ::spectrumIndex(transaction->destinationPublicKey);
+                }
+            }
+            if (transferRun.sourceIndices[end] >= 0 && transferRun.destinationIndices[end] < 0)
+            {
+                break;
+            }
+            numberOfTransfers++;
+        }
+        if (numberOfTransfers >= minTransfersForParallelExecution)
+        {
+            executeTransferSubRun(t, end);
+        }
+        else
+        {
+            processTransferRunSerially(t, end, processorNumber);
+        }
+        if (end == transferRun.size)
+        {
+            break;
+        }
+
+        // Create entity serially. If this may reorganize the spectrum, looked up indices may become invalid.
+        const bool reorganizationPending = isSpectrumReorganizationPending();
+        processTransferRunSerially(end, end + 1, processorNumber);
+        if (reorganizationPending)
+        {
+            return transferRun.slots[end] + 1;
+        }
+        entityCreated = true;
+        t = end + 1;
     }
+
+    return transferRun.slots[transferRun.size - 1] + 1;
 }
 
 static void makeAndBroadcastTickVotesTransaction(int i, BroadcastFutureTickData& td, int txSlot)
@@ -3211,9 +4827,80 @@ static bool makeAndBroadcastExecutionFeeTransaction(int i, BroadcastFutureTickDa
 }
 
 OPTIMIZE_OFF()
+// Check if transaction is a solution that hasn't been seen before
+static bool isNewSolutionTransaction(const Transaction* transaction, int sourceSpectrumIndex)
+{
+    if (sourceSpectrumIndex >= 0)
+    {
+        // Solution transactions
+        if (isZero(transaction->destinationPublicKey)
+            && transaction->amount >= MiningSolutionTransaction::minAmount()
+            && transaction->inputType == MiningSolutionTransaction::transactionType())
+        {
+            if (transaction->inputSize == 32 + 32)
+            {
+                const m256i& solution_miningSeed = *(m256i*)transaction->inputPtr();
+                const m256i& solution_nonce = *(m256i*)(transaction->inputPtr() + 32);
+                m256i data[3] = { transaction->sourcePublicKey, solution_miningSeed, solution_nonce };
+                static_assert(sizeof(data) == 3 * 32, "Unexpected array size");
+                unsigned int flagIndex;
+                KangarooTwelve(data, sizeof(data), &flagIndex, sizeof(flagIndex));
+                return !minerSolutionFlags.isSet(flagIndex);
+            }
+        }
+    }
+    return false;
+}
+
+// Add task to score->taskQueue if transaction is a solution that hasn't been seen before
+static void addSolutionTask(const Transaction* transaction, int sourceSpectrumIndex)
+{
+    if (isNewSolutionTransaction(transaction, sourceSpectrumIndex))
+    {
+        score->addTask(transaction->sourcePublicKey, *(m256i*)transaction->inputPtr(), *(m256i*)(transaction->inputPtr() + 32));
+    }
+}
+
+// Queue solution of broadcast transaction for speculative scoring, so its score is usually cached when the transaction
+// is processed in a tick (see ScoreFunction::addSpeculativeTask())
+static void addSpeculativeSolutionTask(const Transaction* transaction)
+{
+    if (transaction->inputType == MiningSolutionTransaction::transactionType()
+        && isNewSolutionTransaction(transaction, spectrumIndex(transaction->sourcePublicKey)))
+    {
+        score->addSpeculativeTask(transaction->sourcePublicKey, *(m256i*)transaction->inputPtr(), *(m256i*)(transaction->inputPtr() + 32));
+    }
+}
+
+// Speculatively compute the scores of the solutions of the next tick (after prefetchTickTransactions()), while the
+// tick processor waits for the votes of the current tick. The task queue is started without waiting for it, so
+// request processors compute the scores in their idle time and store them in the score cache. This is free of side
+// effects on the state: processTick() resets the queue (waiting for tasks in progress) and computes all scores of the
+// tick again, which are then fetched from the cache. Solutions of the next tick that become known in the current
+// tick are checked again in processTickTransactionSolution().
+static void speculateNextTickSolutions()
+{
+    PROFILE_SCOPE();
+
+    score->resetTaskQueue();
+    for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+    {
+        const Transaction* transaction = transactionPrefetch.transactions[i];
+        if (transaction)
+        {
+            addSolutionTask(transaction, transactionPrefetch.sourceIndices[i]);
+        }
+    }
+    score->startProcessTaskQueue();
+}
+
 static void processTick(unsigned long long processorNumber)
 {
     PROFILE_SCOPE();
+    PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_PROCESS_TICK);
+
+    const unsigned long long processTickBegin = __rdtsc();
+    unsigned long long digestTicks = 0;
 
     if (system.tick > system.initialTick)
     {
@@ -3222,6 +4909,7 @@ static void processTick(unsigned long long processorNumber)
         getUniverseDigest(etalonTick.prevUniverseDigest);
         getComputerDigest(etalonTick.prevComputerDigest);
         etalonTick.prevTransactionBodyDigest = etalonTick.saltedTransactionBodyDigest;
+        digestTicks += __rdtsc() - processTickBegin;
     }
     else if (system.tick == system.initialTick) // the first tick of an epoch
     {
@@ -3278,6 +4966,7 @@ static void processTick(unsigned long long processorNumber)
     }
 
     PROFILE_NAMED_SCOPE_BEGIN("processTick(): BEGIN_TICK");
+    PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_BEGIN_TICK);
     logger.registerNewTx(system.tick, logger.SC_BEGIN_TICK_TX);
     contractProcessorPhase = BEGIN_TICK;
     contractProcessorState = 1;
@@ -3292,67 +4981,54 @@ static void processTick(unsigned long long processorNumber)
     if (nextTickData.epoch == system.epoch)
     {
         auto* tsCurrentTickTransactionOffsets = ts.tickTransactionOffsets.getByTickIndex(tickIndex);
-#if ADDON_TX_STATUS_REQUEST
-        txStatusData.tickTxIndexStart[system.tick - system.initialTick] = numberOfTransactions; // qli: part of tx_status_request add-on
-#endif
         PROFILE_NAMED_SCOPE_BEGIN("processTick(): pre-scan solutions");
         // reset solution task queue
         score->resetTaskQueue();
-        // pre-scan any solution tx and add them to solution task queue
+        // pre-scan any solution tx and add them to solution task queue, count transactions for tx revenue score
+        unsigned int tickTransactionCount = 0;
         for (unsigned int transactionIndex = 0; transactionIndex < NUMBER_OF_TRANSACTIONS_PER_TICK; transactionIndex++)
         {
             if (!isZero(nextTickData.transactionDigests[transactionIndex]))
             {
+                tickTransactionCount++;
                 if (tsCurrentTickTransactionOffsets[transactionIndex])
                 {
                     Transaction* transaction = ts.tickTransactions(tsCurrentTickTransactionOffsets[transactionIndex]);
                     ASSERT(transaction->checkValidity());
                     ASSERT(transaction->tick == system.tick);
-                    const int spectrumIndex = ::spectrumIndex(transaction->sourcePublicKey);
-                    if (spectrumIndex >= 0)
-                    {
-                        // Solution transactions
-                        if (isZero(transaction->destinationPublicKey)
-                            && transaction->amount >= MiningSolutionTransaction::minAmount()
-                            && transaction->inputType == MiningSolutionTransaction::transactionType())
-                        {
-                            if (transaction->inputSize == 32 + 32)
-                            {
-                                const m256i& solution_miningSeed = *(m256i*)transaction->inputPtr();
-                                const m256i& solution_nonce = *(m256i*)(transaction->inputPtr() + 32);
-                                m256i data[3] = { transaction->sourcePublicKey, solution_miningSeed, solution_nonce };
-                                static_assert(sizeof(data) == 3 * 32, "Unexpected array size");
-                                unsigned int flagIndex;
-                                KangarooTwelve(data, sizeof(data), &flagIndex, sizeof(flagIndex));
-                                if (!(minerSolutionFlags[flagIndex >> 6] & (1ULL << (flagIndex & 63))))
-                                {
-                                    score->addTask(transaction->sourcePublicKey, solution_miningSeed, solution_nonce);
-                                }
-                            }
-                        }
-                    }
+                    addSolutionTask(transaction, transactionSourceIndex(transaction, transactionIndex));
                 }
             }
         }
+        txRevenueScores[system.tick % NUMBER_OF_COMPUTORS] += gTxRevenuePoints[tickTransactionCount];
         PROFILE_SCOPE_END();
 
         {
             // Process solutions in this tick and store in cache. In parallel, score->tryProcessSolution() is called by
             // request processors to speed up solution processing.
             PROFILE_NAMED_SCOPE("processTick(): process solutions");
+            PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_PROCESS_SOLUTIONS);
             score->startProcessTaskQueue();
             while (!score->isTaskQueueProcessed())
             {
-                score->tryProcessSolution(processorNumber);
+                score->tryProcessSolution(processorNumber, /*speculative=*/false);
             }
             score->stopProcessTaskQueue();
         }
         solutionTotalExecutionTicks = __rdtsc() - solutionProcessStartTick; // for tracking the time processing solutions
 
-        // Process all transaction of the tick
+        // Process all transaction of the tick. Runs of independent QU transfers are executed in parallel.
         PROFILE_NAMED_SCOPE_BEGIN("processTick(): process transactions");
+        PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_PROCESS_TRANSACTIONS);
         for (unsigned int transactionIndex = 0; transactionIndex < NUMBER_OF_TRANSACTIONS_PER_TICK; transactionIndex++)
         {
+            const unsigned int runEnd = processTickTransferRun(transactionIndex, tsCurrentTickTransactionOffsets, processorNumber);
+            if (runEnd > transactionIndex)
+            {
+                transactionIndex = runEnd - 1;
+                continue;
+            }
+
             if (!isZero(nextTickData.transactionDigests[transactionIndex]))
             {
                 if (tsCurrentTickTransactionOffsets[transactionIndex])
@@ -3404,48 +5080,35 @@ static void processTick(unsigned long long processorNumber)
     }
 
     PROFILE_NAMED_SCOPE_BEGIN("processTick(): END_TICK");
+    PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_END_TICK);
+    const unsigned long long endTickBegin = __rdtsc();
     logger.registerNewTx(system.tick, logger.SC_END_TICK_TX);
     contractProcessorPhase = END_TICK;
     contractProcessorState = 1;
     WAIT_WHILE(contractProcessorState);
+    const unsigned long long endTickTicks = __rdtsc() - endTickBegin;
     PROFILE_SCOPE_END();
 
     PROFILE_NAMED_SCOPE_BEGIN("processTick(): get spectrum digest");
-    unsigned int digestIndex;
-    ACQUIRE(spectrumLock);
-    for (digestIndex = 0; digestIndex < SPECTRUM_CAPACITY; digestIndex++)
-    {
-        if (spectrum[digestIndex].latestIncomingTransferTick == system.tick || spectrum[digestIndex].latestOutgoingTransferTick == system.tick)
-        {
-            KangarooTwelve64To32(&spectrum[digestIndex], &spectrumDigests[digestIndex]);
-            spectrumChangeFlags[digestIndex >> 6] |= (1ULL << (digestIndex & 63));
-        }
-    }
-    unsigned int previousLevelBeginning = 0;
-    unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
-    while (numberOfLeafs > 1)
-    {
-        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
-        {
-            if (spectrumChangeFlags[i >> 6] & (3ULL << (i & 63)))
-            {
-                KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[digestIndex]);
-                spectrumChangeFlags[i >> 6] &= ~(3ULL << (i & 63));
-                spectrumChangeFlags[i >> 7] |= (1ULL << ((i >> 1) & 63));
-            }
-            digestIndex++;
-        }
-        previousLevelBeginning += numberOfLeafs;
-        numberOfLeafs >>= 1;
-    }
-    spectrumChangeFlags[0] = 0;
-
-    etalonTick.saltedSpectrumDigest = spectrumDigests[(SPECTRUM_CAPACITY * 2 - 1) - 1];
-    RELEASE(spectrumLock);
+    PROFILE_SAMPLED_SCOPE(SAMPLED_SCOPE_SPECTRUM_DIGEST);
+    spectrumLock.acquire();
+    pendingTxsPool.collectChangedEntities();
+    updateSpectrumDigests();
+    etalonTick.saltedSpectrumDigest = spectrumDigestTree.root();
+    spectrumLock.release();
+    pendingTxsPool.updateTxsPrioritiesOfChangedEntities(system.tick + TICK_TRANSACTIONS_PUBLICATION_OFFSET);
     PROFILE_SCOPE_END();
 
+    const unsigned long long saltedDigestsBegin = __rdtsc();
     getUniverseDigest(etalonTick.saltedUniverseDigest);
     getComputerDigest(etalonTick.saltedComputerDigest);
+    digestTicks += __rdtsc() - saltedDigestsBegin;
+
+    const unsigned long long processTickTicks = __rdtsc() - processTickBegin;
+    tickPhaseStats.addSample(TICK_PHASE_DIGESTS, digestTicks * 1000000 / frequency);
+    tickPhaseStats.addSample(TICK_PHASE_END_TICK, endTickTicks * 1000000 / frequency);
+    tickPhaseStats.addSample(TICK_PHASE_TX_EXECUTION, (processTickTicks - digestTicks - endTickTicks) * 1000000 / frequency);
+    contractExecutionProfile.finishTick(system.tick);
 
 #if !defined(NDEBUG) && 1
     {
@@ -3549,38 +5212,32 @@ static void processTick(unsigned long long processorNumber)
                     KangarooTwelve(timelockPreimage, sizeof(timelockPreimage), &broadcastedFutureTickData.tickData.timelock, sizeof(broadcastedFutureTickData.tickData.timelock));
 
                     unsigned int nextTxIndex = 0;
-                    unsigned int numPendingTickTxs = pendingTxsPool.getNumberOfPendingTickTxs(system.tick + TICK_TRANSACTIONS_PUBLICATION_OFFSET);
-                    pendingTxsPool.acquireLock();
-                    for (unsigned int tx = 0; tx < numPendingTickTxs; ++tx)
                     {
-// #if !defined(NDEBUG) && !defined(NO_UEFI)
-//                         addDebugMessage(L"pendingTxsPool.get() call in processTick()");
-// #endif
-                        const Transaction* pendingTransaction = pendingTxsPool.getTx(system.tick + TICK_TRANSACTIONS_PUBLICATION_OFFSET, tx);
-                        if (pendingTransaction)
+                        // get all pending txs of the tick at once, highest priority first
+                        const Transaction* pendingTransactions[NUMBER_OF_TRANSACTIONS_PER_TICK];
+                        const m256i* pendingDigests[NUMBER_OF_TRANSACTIONS_PER_TICK];
+                        static_assert(sizeof(pendingTransactions) + sizeof(pendingDigests) < 32 * 1024, "Large alloc in stack may need reconsideration.");
+                        pendingTxsPool.acquireLock();
+                        const unsigned int numPendingTickTxs = pendingTxsPool.getTickTxsByPriority(system.tick + TICK_TRANSACTIONS_PUBLICATION_OFFSET,
+                            pendingTransactions, pendingDigests, NUMBER_OF_TRANSACTIONS_PER_TICK);
+                        ts.tickTransactions.acquireLock();
+                        for (unsigned int tx = 0; tx < numPendingTickTxs; ++tx)
                         {
+                            const Transaction* pendingTransaction = pendingTransactions[tx];
                             ASSERT(pendingTransaction->checkValidity());
                             const unsigned int transactionSize = pendingTransaction->totalSize();
-                            ts.tickTransactions.acquireLock();
                             if (ts.nextTickTransactionOffset + transactionSize <= ts.tickTransactions.storageSpaceCurrentEpoch)
                             {
                                 ts.tickTransactionOffsets(pendingTransaction->tick, nextTxIndex) = ts.nextTickTransactionOffset;
                                 copyMem(ts.tickTransactions(ts.nextTickTransactionOffset), (void*)pendingTransaction, transactionSize);
-                                const m256i* digest = pendingTxsPool.getDigest(system.tick + TICK_TRANSACTIONS_PUBLICATION_OFFSET, tx);
-                                // digest should always be != nullptr because pendingTransaction != nullptr
-                                ASSERT(digest);
-                                broadcastedFutureTickData.tickData.transactionDigests[nextTxIndex] = digest ? *digest : m256i::zero();
+                                broadcastedFutureTickData.tickData.transactionDigests[nextTxIndex] = *pendingDigests[tx];
                                 ts.nextTickTransactionOffset += transactionSize;
                                 nextTxIndex++;
                             }
-                            ts.tickTransactions.releaseLock();
-                        }
-                        else
-                        {
-                            break;
                         }
+                        ts.tickTransactions.releaseLock();
+                        pendingTxsPool.releaseLock();
                     }
-                    pendingTxsPool.releaseLock();
 
                     {
                         // insert & broadcast vote counter tx
@@ -3628,41 +5285,51 @@ static void processTick(unsigned long long processorNumber)
     if (isMainMode())
     {
         unsigned char digest[32];
-        void* txBuffer = commonBuffers.acquireBuffer(MAX_TRANSACTION_SIZE);
+        void* txBuffer = __acquireScratchpad(MAX_TRANSACTION_SIZE, /*initZero=*/false);
         {
             PROFILE_NAMED_SCOPE("processTick(): broadcast oracle reply transactions");
             const auto txTick = system.tick + ORACLE_REPLY_COMMIT_PUBLICATION_OFFSET;
-            auto* tx = (OracleReplyCommitTransactionPrefix*)txBuffer;
+            auto* tx = (OracleReplyBatchCommitTransactionPrefix*)txBuffer;
             unsigned int txCount = 0;
-            for (unsigned int i = 0; i < numberOfOwnComputorIndices; i++)
+
+            // create batch reply commit transactions of multiple own computors in tx (without signatures) until
+            // 0 is returned (no more reply commits to send)
+            unsigned int txComputorCount;
+            while ((txComputorCount = oracleEngine.getReplyBatchCommitTransaction(tx, ownComputorIndices, ownComputorIndicesMapping, numberOfOwnComputorIndices, txTick)) != 0)
             {
-                const auto ownCompIdx = ownComputorIndicesMapping[i];
-                const auto overallCompIdx = ownComputorIndices[i];
-                unsigned int retCode = 0;
-                do
+                // co-sign by all computors except for the first one, which is the tx source
+                const unsigned short* txComputorIndices = tx->computorIndices();
+                unsigned short sourceOwnCompIdx = 0;
+                if (txComputorCount > 1)
+                    KangarooTwelve(tx, tx->coSignedSize(), digest, sizeof(digest));
+                for (unsigned int c = 0; c < txComputorCount; c++)
                 {
-                    // create reply commit transaction in tx (without signature), returning:
-                    // - 0 if no tx was created (no need to send reply commits)
-                    // - UINT32_MAX if we all pending reply commits fitted into this one tx
-                    // - otherwise, an index value that has to be passed to the next call for building another tx
-                    retCode = oracleEngine.getReplyCommitTransaction(tx, overallCompIdx, ownCompIdx, txTick, retCode);
-                    if (!retCode)
-                        break;
-
-                    // sign and broadcast tx
-                    KangarooTwelve(tx, sizeof(Transaction) + tx->inputSize, digest, sizeof(digest));
-                    sign(computorSubseeds[ownCompIdx].m256i_u8, computorPublicKeys[ownCompIdx].m256i_u8, digest, tx->signaturePtr());
-                    enqueueResponse(NULL, tx->totalSize(), BROADCAST_TRANSACTION, 0, tx);
-                    ++txCount;
+                    for (unsigned int i = 0; i < numberOfOwnComputorIndices; i++)
+                    {
+                        if (ownComputorIndices[i] == txComputorIndices[c])
+                        {
+                            const auto ownCompIdx = ownComputorIndicesMapping[i];
+                            if (c == 0)
+                                sourceOwnCompIdx = ownCompIdx;
+                            else
+                                sign(computorSubseeds[ownCompIdx].m256i_u8, computorPublicKeys[ownCompIdx].m256i_u8, digest, (unsigned char*)tx->coSignature(c));
+                            break;
+                        }
+                    }
                 }
-                while (retCode != UINT32_MAX);
+
+                // sign and broadcast tx
+                KangarooTwelve(tx, sizeof(Transaction) + tx->inputSize, digest, sizeof(digest));
+                sign(computorSubseeds[sourceOwnCompIdx].m256i_u8, computorPublicKeys[sourceOwnCompIdx].m256i_u8, digest, tx->signaturePtr());
+                enqueueResponse(NULL, tx->totalSize(), BROADCAST_TRANSACTION, 0, tx);
+                ++txCount;
             }
 
 #if !defined(NDEBUG)
             if (txCount)
             {
                 CHAR16 dbgMsg[300];
-                setText(dbgMsg, L"oracleEngine.getReplyCommitTransaction(), tick ");
+                setText(dbgMsg, L"oracleEngine.getReplyBatchCommitTransaction(), tick ");
                 appendNumber(dbgMsg, system.tick, FALSE);
                 appendText(dbgMsg, ", txScheduleTick ");
                 appendNumber(dbgMsg, txTick, FALSE);
@@ -3675,13 +5342,14 @@ static void processTick(unsigned long long processorNumber)
                 }
                 appendText(dbgMsg, ", total number of tx ");
                 appendNumber(dbgMsg, txCount, FALSE);
-                appendText(dbgMsg, ", last tx queryId");
-                unsigned short commitCount = tx->inputSize / sizeof(OracleReplyCommitTransactionItem);
-                auto* commits = reinterpret_cast<OracleReplyCommitTransactionItem*>(tx->inputPtr());
-                for (unsigned short i = 0; i < commitCount; ++i)
+                appendText(dbgMsg, ", last tx computors ");
+                appendNumber(dbgMsg, tx->computorCount, FALSE);
+                appendText(dbgMsg, ", queryId");
+                const OracleReplyBatchCommitTransactionQuery* txQueries = tx->queries();
+                for (unsigned int i = 0; i < tx->queryCount; ++i)
                 {
                     appendText(dbgMsg, " ");
-                    appendNumber(dbgMsg, commits[i].queryId, FALSE);
+                    appendNumber(dbgMsg, txQueries[i].queryId, FALSE);
                 }
                 addDebugMessage(dbgMsg);
             }
@@ -3705,7 +5373,7 @@ static void processTick(unsigned long long processorNumber)
             }
         }
 
-        commonBuffers.releaseBuffer(txBuffer);
+        __releaseScratchpad(txBuffer);
     }
 
     if (isMainMode())
@@ -3833,6 +5501,18 @@ static void resetCustomMining()
     gCustomMiningStats.epochReset();
 }
 
+static void beginEpochTickStorage()
+{
+    // most of the tick storage is cleared in the background by idle request processors
+    const bool deferClearing = true;
+    ts.beginEpoch(system.initialTick, deferClearing);
+}
+
+static void beginEpochPendingTxsPool()
+{
+    pendingTxsPool.beginEpoch(system.initialTick);
+}
+
 static void beginEpoch()
 {
     // This version doesn't support migration from contract IPO to contract operation!
@@ -3850,8 +5530,14 @@ static void beginEpoch()
     ts.checkStateConsistencyWithAssert();
     pendingTxsPool.checkStateConsistencyWithAssert();
 #endif
-    ts.beginEpoch(system.initialTick);
-    pendingTxsPool.beginEpoch(system.initialTick);
+    {
+        // clearing tick storage and pending transactions touch disjoint memory
+        const EpochTransitionTask tasks[] = {
+            { EPOCH_TRANSITION_PHASE_TICK_STORAGE, beginEpochTickStorage },
+            { EPOCH_TRANSITION_PHASE_PENDING_TXS_POOL, beginEpochPendingTxsPool },
+        };
+        runConcurrentEpochTransitionPhases(tasks, sizeof(tasks) / sizeof(tasks[0]));
+    }
     oracleEngine.beginEpoch();
     voteCounter.init();
 #ifndef NDEBUG
@@ -3885,9 +5571,12 @@ static void beginEpoch()
     CONTRACT_EXEC_FEES_REC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME[0]) - 3] = (system.epoch % 100) / 10 + L'0';
     CONTRACT_EXEC_FEES_REC_FILE_NAME[sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME) / sizeof(CONTRACT_EXEC_FEES_REC_FILE_NAME[0]) - 2] = system.epoch % 10 + L'0';
 
+    unsigned long long phaseStartTsc = __rdtsc();
+    score->resetTaskQueue(); // wait for speculative tasks before initializing memory
+    score->pauseSpeculativeTasks();
     score->initMemory();
-    score->resetTaskQueue();
-    setMem(minerSolutionFlags, NUMBER_OF_MINER_SOLUTION_FLAGS / 8, 0);
+    epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_SCORE_INIT, phaseStartTsc);
+    minerSolutionFlags.reset();
     setMem((void*)minerPublicKeys, sizeof(minerPublicKeys), 0);
     setMem((void*)minerScores, sizeof(minerScores), 0);
     numberOfMiners = NUMBER_OF_COMPUTORS;
@@ -3918,22 +5607,36 @@ static void beginEpoch()
     resourceTestingDigest = 0;
 
     numberOfTransactions = 0;
+    setMem(txRevenueScores, sizeof(txRevenueScores), 0);
 #if TICK_STORAGE_AUTOSAVE_MODE
     ts.initMetaData(system.epoch); // for save/load state
 #endif
 
+    phaseStartTsc = __rdtsc();
     logger.reset(system.initialTick);
-
+    epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_LOGGING_RESET, phaseStartTsc);
 }
 
 
+// Reorganize spectrum hash map (also updates spectrumInfo)
+static void endEpochSpectrum()
+{
+    spectrumLock.acquire();
+
+    reorganizeSpectrum();
+
+    spectrumLock.release();
+}
+
 // called by tickProcessor() after system.tick has been incremented
 static void endEpoch()
 {
+    unsigned long long phaseStartTsc = __rdtsc();
     logger.registerNewTx(system.tick, logger.SC_END_EPOCH_TX);
     contractProcessorPhase = END_EPOCH;
     contractProcessorState = 1;
     WAIT_WHILE(contractProcessorState);
+    phaseStartTsc = epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_CONTRACT_END_EPOCH, phaseStartTsc);
 
     // treating endEpoch as a tick, start updating etalonTick:
     // this is the last tick of an epoch, should we set prevResourceTestingDigest to zero? nodes that start from scratch (for the new epoch)
@@ -3946,47 +5649,27 @@ static void endEpoch()
 
     // Handle IPO
     finishIPOs();
+    phaseStartTsc = epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_FINISH_IPOS, phaseStartTsc);
 
     system.initialMillisecond = etalonTick.millisecond;
     system.initialSecond = etalonTick.second;
     system.initialMinute = etalonTick.minute;
     system.initialHour = etalonTick.hour;
-    system.initialDay = etalonTick.day;
-    system.initialMonth = etalonTick.month;
-    system.initialYear = etalonTick.year;
-
-
-    // Only issue qus if the max supply is not yet reached
-    if (spectrumInfo.totalAmount + ISSUANCE_RATE <= MAX_SUPPLY)
-    {
-        // Compute revenue scores of computors
-        unsigned long long revenueScore[NUMBER_OF_COMPUTORS];
-        setMem(revenueScore, sizeof(revenueScore), 0);
-        for (unsigned int tick = system.initialTick; tick < system.tick; tick++)
-        {
-            ts.tickData.acquireLock();
-            TickData& td = ts.tickData.getByTickInCurrentEpoch(tick);
-            if (td.epoch == system.epoch)
-            {
-                unsigned int numberOfTransactions = 0;
-                for (unsigned int transactionIndex = 0; transactionIndex < NUMBER_OF_TRANSACTIONS_PER_TICK; transactionIndex++)
-                {
-                    if (!isZero(td.transactionDigests[transactionIndex]))
-                    {
-                        numberOfTransactions++;
-                    }
-                }
-                revenueScore[tick % NUMBER_OF_COMPUTORS] += gTxRevenuePoints[numberOfTransactions];
-            }
-            ts.tickData.releaseLock();
-        }
+    system.initialDay = etalonTick.day;
+    system.initialMonth = etalonTick.month;
+    system.initialYear = etalonTick.year;
+
 
+    // Only issue qus if the max supply is not yet reached
+    if (spectrumInfo.totalAmount + ISSUANCE_RATE <= MAX_SUPPLY)
+    {
+        // Revenue scores of computors from transactions have been accumulated in processTick()
         // Save data of custom mining.
         {
             for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
             {
                 gRevenueComponents.voteScore[i] = voteCounter.getVoteCount(i);
-                gRevenueComponents.txScore[i] = revenueScore[i];
+                gRevenueComponents.txScore[i] = txRevenueScores[i];
                 gRevenueComponents.customMiningScore[i] = gCustomMiningSharesCounter.getSharesCount(i);
             }
             computeRevenue(
@@ -4050,17 +5733,16 @@ static void endEpoch()
         const QuTransfer quTransfer = { m256i::zero(), arbitratorPublicKey, arbitratorRevenue };
         logger.logQuTransfer(quTransfer);
     }
+    epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_REVENUE, phaseStartTsc);
 
-    // Reorganize spectrum hash map (also updates spectrumInfo)
+    // Reorganize spectrum and universe hash maps (touching disjoint data) concurrently
     {
-        ACQUIRE(spectrumLock);
-
-        reorganizeSpectrum();
-
-        RELEASE(spectrumLock);
+        const EpochTransitionTask tasks[] = {
+            { EPOCH_TRANSITION_PHASE_SPECTRUM_REORG, endEpochSpectrum },
+            { EPOCH_TRANSITION_PHASE_UNIVERSE_REORG, assetsEndEpoch },
+        };
+        runConcurrentEpochTransitionPhases(tasks, sizeof(tasks) / sizeof(tasks[0]));
     }
-
-    assetsEndEpoch();
     {
         // this is the last logging event of the epoch
         // a hint message for 3rd party services the end of the epoch
@@ -4233,7 +5915,8 @@ static bool saveAllNodeStates()
     appendText(message, directory); appendText(message, L"/");
     appendText(message, SPECTRUM_FILE_NAME);
     logToConsole(message);
-    if (!saveSpectrum(SPECTRUM_FILE_NAME, directory))
+    CHAR16 SPECTRUM_DELTA_FILE_NAME[] = L"snapshotSpectrumDelta";
+    if (!saveSpectrumSnapshot(SPECTRUM_FILE_NAME, SPECTRUM_DELTA_FILE_NAME, directory))
     {
         logToConsole(L"Failed to save spectrum");
         return false;
@@ -4246,7 +5929,8 @@ static bool saveAllNodeStates()
     appendText(message, directory); appendText(message, L"/");
     appendText(message, UNIVERSE_FILE_NAME);
     logToConsole(message);
-    if (!saveUniverse(UNIVERSE_FILE_NAME, directory))
+    CHAR16 UNIVERSE_DELTA_FILE_NAME[] = L"snapshotUniverseDelta";
+    if (!saveUniverseSnapshot(UNIVERSE_FILE_NAME, UNIVERSE_DELTA_FILE_NAME, directory))
     {
         logToConsole(L"Failed to save universe");
         return false;
@@ -4266,7 +5950,7 @@ static bool saveAllNodeStates()
 
     setText(message, L"Saving computer files");
     logToConsole(message);
-    if (!saveContractStateFiles(directory))
+    if (!saveContractStateFiles(directory, /*nodeStateSnapshot=*/true))
     {
         logToConsole(L"Failed to save contract state files");
         return false;
@@ -4303,6 +5987,7 @@ static bool saveAllNodeStates()
     nodeStateBuffer.currentRandomSeed = score->currentRandomSeed;
     nodeStateBuffer.numberOfMiners = numberOfMiners;
     nodeStateBuffer.numberOfTransactions = numberOfTransactions;    
+    copyMem(nodeStateBuffer.txRevenueScores, txRevenueScores, sizeof(txRevenueScores));
     voteCounter.saveAllDataToArray(nodeStateBuffer.voteCounterData);
     gCustomMiningSharesCounter.saveAllDataToArray(nodeStateBuffer.customMiningSharesCounterData);
 
@@ -4333,6 +6018,15 @@ static bool saveAllNodeStates()
         return false;
     }
 
+    // Leafs changed since the last digest update need to be rehashed after loading (digests of them are outdated)
+    CHAR16 UNIVERSE_CHANGE_FLAGS_FILE_NAME[] = L"snapshotUniverseChangeFlags";
+    savedSize = save(UNIVERSE_CHANGE_FLAGS_FILE_NAME, assetDigestTree.changeFlagsSizeInBytes, (unsigned char*)assetChangeFlags, directory);
+    if (savedSize != assetDigestTree.changeFlagsSizeInBytes)
+    {
+        logToConsole(L"Failed to save universe change flags");
+        return false;
+    }
+
     CHAR16 COMPUTER_DIGEST_FILE_NAME[] = L"snapshotComputerDigest";
     savedSize = save(COMPUTER_DIGEST_FILE_NAME, contractStateDigestsSizeInBytes, (unsigned char*)contractStateDigests, directory);
     logToConsole(L"Saving computer digests");
@@ -4344,19 +6038,33 @@ static bool saveAllNodeStates()
 
     CHAR16 MINER_SOL_FLAG_FILE_NAME[] = L"snapshotMinerSolutionFlag";
     logToConsole(L"Saving miner solution flags");
-    savedSize = save(MINER_SOL_FLAG_FILE_NAME, NUMBER_OF_MINER_SOLUTION_FLAGS / 8, (unsigned char*)minerSolutionFlags, directory);
-    if (savedSize != NUMBER_OF_MINER_SOLUTION_FLAGS / 8)
+    if (!minerSolutionFlags.save(MINER_SOL_FLAG_FILE_NAME, directory))
     {
         logToConsole(L"Failed to save miner solution flag");
         return false;
     }
 
-    setText(message, L"Saving tick storage ");
-    logToConsole(message);
-    if (ts.trySaveToFile(system.epoch, system.tick, directory) != 0)
+    // Pending transactions are only a cache for the upcoming ticks, so the snapshot stays valid without them
+    static_assert(PendingTxsPool::maxSnapshotSize <= defaultCommonBuffersSize, "commonBuffers too small for pending txs pool");
+    CHAR16 PENDING_TXS_POOL_FILE_NAME[] = L"snapshotPendingTxsPool";
+    logToConsole(L"Saving pending txs pool");
+    unsigned char* pendingTxsPoolBuffer = (unsigned char*)commonBuffers.acquireBuffer(PendingTxsPool::maxSnapshotSize);
+    savedSize = pendingTxsPool.saveToFile(PENDING_TXS_POOL_FILE_NAME, pendingTxsPoolBuffer, directory);
+    commonBuffers.releaseBuffer(pendingTxsPoolBuffer);
+    if (savedSize < 0)
     {
-        logToConsole(L"Failed to save tick storage");
-        return false;
+        logToConsole(L"Failed to save pending txs pool");
+    }
+
+    // Sampling profiler trace isn't part of the snapshot, but is written here to keep the file output off the main loop
+    if (samplingProfilerTraceMilliseconds)
+    {
+        const long long traceSize = gSamplingProfiler.writeChromeTrace(L"profiling_trace.json", samplingProfilerTraceMilliseconds);
+        samplingProfilerTraceMilliseconds = 0;
+        setText(message, (traceSize >= 0) ? L"Saved sampling profiler trace to profiling_trace.json (" : L"Failed to save sampling profiler trace (");
+        appendNumber(message, (traceSize >= 0) ? traceSize : 0, TRUE);
+        appendText(message, L" bytes).");
+        logToConsole(message);
     }
 
 #if !defined(NDEBUG)
@@ -4368,7 +6076,7 @@ static bool saveAllNodeStates()
     }
 
 #if ADDON_TX_STATUS_REQUEST
-    if (!saveStateTxStatus(numberOfTransactions, directory))
+    if (!saveStateTxStatus(directory))
     {
         logToConsole(L"Failed to save tx status");
         return false;
@@ -4385,6 +6093,40 @@ static bool saveAllNodeStates()
     return true;
 }
 
+// Save tick storage part of the snapshot after saveAllNodeStates() succeeded. This is done after resuming the tick
+// processor, because the data of the ticks up to the saved tick doesn't change anymore and concurrent access is
+// secured by the locks of the tick storage. The tick storage metadata is written at the end, marking the snapshot as
+// valid. Can only called from main thread.
+static bool saveAllNodeStatesTickStorage(unsigned short epoch, unsigned int tick)
+{
+    PROFILE_SCOPE();
+
+#if !defined(NDEBUG)
+    forceLogToConsoleAsAddDebugMessage = true;
+#endif
+
+    CHAR16 directory[16];
+    setText(directory, L"ep");
+    appendNumber(directory, epoch, false);
+
+    // Make sure all pending non-blocking saves are on disk before the tick storage metadata marks the snapshot valid
+    waitForAsyncFileIONonBlockingSaves();
+
+    setText(message, L"Saving tick storage ");
+    logToConsole(message);
+    const bool saved = (ts.trySaveToFile(epoch, tick, directory) == 0);
+    if (!saved)
+    {
+        logToConsole(L"Failed to save tick storage");
+    }
+
+#if !defined(NDEBUG)
+    forceLogToConsoleAsAddDebugMessage = false;
+#endif
+
+    return saved;
+}
+
 static bool loadAllNodeStates()
 {
 #if !defined(NDEBUG)
@@ -4414,7 +6156,8 @@ static bool loadAllNodeStates()
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 4] = L'0';
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 3] = L'0';
     SPECTRUM_FILE_NAME[sizeof(SPECTRUM_FILE_NAME) / sizeof(SPECTRUM_FILE_NAME[0]) - 2] = L'0';
-    if (!loadSpectrum(SPECTRUM_FILE_NAME, directory))
+    CHAR16 SPECTRUM_DELTA_FILE_NAME[] = L"snapshotSpectrumDelta";
+    if (!loadSpectrumSnapshot(SPECTRUM_FILE_NAME, SPECTRUM_DELTA_FILE_NAME, directory))
     {
         logToConsole(L"Failed to load spectrum");
         return false;
@@ -4423,7 +6166,8 @@ static bool loadAllNodeStates()
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 4] = L'0';
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 3] = L'0';
     UNIVERSE_FILE_NAME[sizeof(UNIVERSE_FILE_NAME) / sizeof(UNIVERSE_FILE_NAME[0]) - 2] = L'0';
-    if (!loadUniverse(UNIVERSE_FILE_NAME, directory))
+    CHAR16 UNIVERSE_DELTA_FILE_NAME[] = L"snapshotUniverseDelta";
+    if (!loadUniverseSnapshot(UNIVERSE_FILE_NAME, UNIVERSE_DELTA_FILE_NAME, directory))
     {
         logToConsole(L"Failed to load universe");
         return false;
@@ -4433,7 +6177,7 @@ static bool loadAllNodeStates()
     CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 3] = L'0';
     CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 2] = L'0';
 
-    if (!loadContractStateFiles(directory, /*forceLoadFromFile=*/true))
+    if (!loadContractStateFiles(directory, /*forceLoadFromFile=*/true, /*nodeStateSnapshot=*/true))
     {
         logToConsole(L"Failed to load contract state files");
         return false;
@@ -4473,6 +6217,7 @@ static bool loadAllNodeStates()
     numberOfMiners = nodeStateBuffer.numberOfMiners;
     initialRandomSeedFromPersistingState = nodeStateBuffer.currentRandomSeed;
     numberOfTransactions = nodeStateBuffer.numberOfTransactions;
+    copyMem(txRevenueScores, nodeStateBuffer.txRevenueScores, sizeof(txRevenueScores));
     loadMiningSeedFromFile = true;
     voteCounter.loadAllDataFromArray(nodeStateBuffer.voteCounterData);
     gCustomMiningSharesCounter.loadAllDataFromArray(nodeStateBuffer.customMiningSharesCounterData);
@@ -4501,8 +6246,6 @@ static bool loadAllNodeStates()
     }
     updateNumberOfTickTransactions();
 
-    setMem(assetChangeFlags, sizeof(assetChangeFlags), 0);
-    setMem(spectrumChangeFlags, sizeof(spectrumChangeFlags), 0);
     CHAR16 SPECTRUM_DIGEST_FILE_NAME[] = L"snapshotSpectrumDigest";
     loadedSize = load(SPECTRUM_DIGEST_FILE_NAME, spectrumDigestsSizeInByte, (unsigned char*)spectrumDigests, directory);
     logToConsole(L"Loading spectrum digests");
@@ -4512,6 +6255,16 @@ static bool loadAllNodeStates()
         return false;
     }
 
+    // Entities changed in the current tick need to be rehashed when processing the tick (same as before saving)
+    spectrumDigestTree.clearChangeFlags();
+    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
+    {
+        if (spectrum[i].latestIncomingTransferTick == system.tick || spectrum[i].latestOutgoingTransferTick == system.tick)
+        {
+            spectrumDigestTree.markLeafChanged(i);
+        }
+    }
+
     CHAR16 UNIVERSE_DIGEST_FILE_NAME[] = L"snapshotUniverseDigest";
     loadedSize = load(UNIVERSE_DIGEST_FILE_NAME, assetDigestsSizeInBytes, (unsigned char*)assetDigests, directory);
     logToConsole(L"Loading universe digests");
@@ -4521,6 +6274,16 @@ static bool loadAllNodeStates()
         return false;
     }
 
+    // Only leafs changed before saving need to be rehashed. If the flags are missing (snapshot of older version),
+    // all leafs are rehashed.
+    CHAR16 UNIVERSE_CHANGE_FLAGS_FILE_NAME[] = L"snapshotUniverseChangeFlags";
+    if (getFileSize(UNIVERSE_CHANGE_FLAGS_FILE_NAME, directory) != (long long)assetDigestTree.changeFlagsSizeInBytes
+        || load(UNIVERSE_CHANGE_FLAGS_FILE_NAME, assetDigestTree.changeFlagsSizeInBytes, (unsigned char*)assetChangeFlags, directory) != (long long)assetDigestTree.changeFlagsSizeInBytes)
+    {
+        logToConsole(L"No valid universe change flags, rehashing all universe digests");
+        assetDigestTree.markAllLeafsChanged();
+    }
+
     CHAR16 COMPUTER_DIGEST_FILE_NAME[] = L"snapshotComputerDigest";
     loadedSize = load(COMPUTER_DIGEST_FILE_NAME, contractStateDigestsSizeInBytes, (unsigned char*)contractStateDigests, directory);
     logToConsole(L"Loading computer digests");
@@ -4532,13 +6295,30 @@ static bool loadAllNodeStates()
 
     CHAR16 MINER_SOL_FLAG_FILE_NAME[] = L"snapshotMinerSolutionFlag";
     logToConsole(L"Loading miner solution flags");
-    loadedSize = load(MINER_SOL_FLAG_FILE_NAME, NUMBER_OF_MINER_SOLUTION_FLAGS / 8, (unsigned char*)minerSolutionFlags, directory);
-    if (loadedSize != NUMBER_OF_MINER_SOLUTION_FLAGS / 8)
+    if (!minerSolutionFlags.load(MINER_SOL_FLAG_FILE_NAME, directory))
     {
         logToConsole(L"Failed to load miner solution flag");
         return false;
     }
 
+    // Warm-start the pending txs pool, so txs broadcast before the restart don't need to be received again.
+    // Missing in snapshots of older versions, in which case the pool starts empty.
+    CHAR16 PENDING_TXS_POOL_FILE_NAME[] = L"snapshotPendingTxsPool";
+    unsigned char* pendingTxsPoolBuffer = (unsigned char*)commonBuffers.acquireBuffer(PendingTxsPool::maxSnapshotSize);
+    loadedSize = pendingTxsPool.loadFromFile(PENDING_TXS_POOL_FILE_NAME, pendingTxsPoolBuffer, directory);
+    commonBuffers.releaseBuffer(pendingTxsPoolBuffer);
+    if (loadedSize < 0)
+    {
+        logToConsole(L"No valid pending txs pool, starting with empty pool");
+    }
+    else
+    {
+        setText(message, L"Loaded ");
+        appendNumber(message, loadedSize, TRUE);
+        appendText(message, L" pending txs");
+        logToConsole(message);
+    }
+
     if (!oracleEngine.loadSnapshot(system.epoch, directory))
     {
         return false;
@@ -4548,7 +6328,7 @@ static bool loadAllNodeStates()
 #endif
 
 #if ADDON_TX_STATUS_REQUEST
-    if (!loadStateTxStatus(numberOfTransactions, directory))
+    if (!loadStateTxStatus(directory))
     {
         logToConsole(L"Failed to load tx status");
         return false;
@@ -4569,80 +6349,159 @@ static bool loadAllNodeStates()
 
 #endif
 
-// Count the number of future tick vote (system.tick + 1) and then update it to gFutureTickTotalNumberOfComputors
-static void updateFutureTickCount()
+// Running tally of the votes of one tick. The tick processor keeps tallies of the current tick (system.tick) and the
+// next tick, so checking for quorum doesn't need to rescan all computor slots of ts.ticks. New votes are added when
+// processBroadcastTick() notifies about them through voteArrivalQueue. A tally is rebuilt from ts.ticks if its tick
+// or the epoch changes or if events have been dropped.
+struct TickVoteTally
 {
-    const unsigned int nextTick = system.tick + 1;
-    const unsigned int nextTickIndex = ts.tickToIndexCurrentEpoch(nextTick);
-    const Tick* tsCompTicks = ts.ticks.getByTickIndex(nextTickIndex);
-    unsigned int futureTickTotalNumberOfComputors = 0;
+    unsigned int tick; // 0 if invalid
+    unsigned int generation; // changed by each rebuild, voters are append-only while generation stays the same
+    unsigned int numberOfVotes;
+    unsigned short voters[NUMBER_OF_COMPUTORS]; // computor indices in order of arrival
+    unsigned long long counted[(NUMBER_OF_COMPUTORS + 63) / 64];
+
+    // unique transactionDigests of the votes, used to find the tick data digest of the next tick
+    m256i uniqueTransactionDigests[NUMBER_OF_COMPUTORS];
+    unsigned int uniqueTransactionDigestCounters[NUMBER_OF_COMPUTORS];
+    unsigned int numberOfUniqueTransactionDigests;
+    unsigned int numberOfEmptyTransactionDigests;
+};
+
+// Only accessed by tick processor
+static struct
+{
+    unsigned int epoch;
+    unsigned int generationCounter;
+    TickVoteTally tallies[2]; // indexed by tick & 1
+} voteTallies;
+
+// Add vote of computor to tally if it is stored in ts.ticks and hasn't been counted yet
+static void addVoteToTally(TickVoteTally& tally, unsigned int computorIndex)
+{
+    if (computorIndex >= NUMBER_OF_COMPUTORS
+        || (tally.counted[computorIndex >> 6] & (1ULL << (computorIndex & 63))))
+    {
+        return;
+    }
+
+    const Tick* tsCompTicks = ts.ticks.getByTickIndex(ts.tickToIndexCurrentEpoch(tally.tick));
+    ts.ticks.acquireLock(computorIndex);
+    const bool hasVote = (tsCompTicks[computorIndex].epoch == system.epoch);
+    const m256i transactionDigest = tsCompTicks[computorIndex].transactionDigest;
+    ts.ticks.releaseLock(computorIndex);
+    if (!hasVote)
+    {
+        return;
+    }
+
+    tally.counted[computorIndex >> 6] |= (1ULL << (computorIndex & 63));
+    tally.voters[tally.numberOfVotes++] = computorIndex;
+
+    unsigned int j;
+    for (j = 0; j < tally.numberOfUniqueTransactionDigests; j++)
+    {
+        if (transactionDigest == tally.uniqueTransactionDigests[j])
+        {
+            break;
+        }
+    }
+    if (j == tally.numberOfUniqueTransactionDigests)
+    {
+        tally.uniqueTransactionDigests[tally.numberOfUniqueTransactionDigests] = transactionDigest;
+        tally.uniqueTransactionDigestCounters[tally.numberOfUniqueTransactionDigests++] = 1;
+    }
+    else
+    {
+        tally.uniqueTransactionDigestCounters[j]++;
+    }
+
+    if (isZero(transactionDigest))
+    {
+        tally.numberOfEmptyTransactionDigests++;
+    }
+}
+
+static void rebuildVoteTally(TickVoteTally& tally, unsigned int tick)
+{
+    tally.tick = tick;
+    tally.generation = ++voteTallies.generationCounter;
+    tally.numberOfVotes = 0;
+    tally.numberOfUniqueTransactionDigests = 0;
+    tally.numberOfEmptyTransactionDigests = 0;
+    setMem(tally.counted, sizeof(tally.counted), 0);
     for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
     {
-        if (tsCompTicks[i].epoch == system.epoch)
+        addVoteToTally(tally, i);
+    }
+}
+
+// Bring vote tallies of system.tick and system.tick + 1 up to date, costing O(number of new votes) if the tick
+// hasn't changed. Requires both ticks to be in the tick storage of the current epoch.
+static void updateVoteTallies()
+{
+    // overflow flag has to be cleared before rebuilding, so votes dropped later are detected on next call
+    const bool rebuildAll = voteArrivalQueue.checkAndClearOverflow() || voteTallies.epoch != system.epoch;
+    voteTallies.epoch = system.epoch;
+    for (unsigned int tick = system.tick; tick <= system.tick + 1; tick++)
+    {
+        TickVoteTally& tally = voteTallies.tallies[tick & 1];
+        if (rebuildAll || tally.tick != tick)
+        {
+            rebuildVoteTally(tally, tick);
+        }
+    }
+
+    // votes that have been counted by the rebuild are skipped, votes of other ticks are counted when the tally of
+    // their tick is built
+    unsigned int tick, computorIndex;
+    while (voteArrivalQueue.pop(tick, computorIndex))
+    {
+        TickVoteTally& tally = voteTallies.tallies[tick & 1];
+        if (tally.tick == tick)
         {
-            futureTickTotalNumberOfComputors++;
+            addVoteToTally(tally, computorIndex);
         }
     }
-    gFutureTickTotalNumberOfComputors = futureTickTotalNumberOfComputors;
+}
+
+// Count the number of future tick vote (system.tick + 1) and then update it to gFutureTickTotalNumberOfComputors
+static void updateFutureTickCount()
+{
+    updateVoteTallies();
+    gFutureTickTotalNumberOfComputors = voteTallies.tallies[(system.tick + 1) & 1].numberOfVotes;
 }
 
 // find next tick data digest from next tick votes
-// Scan all tick votes of the next tick (system.tick + 1):
+// Use tally of all tick votes of the next tick (system.tick + 1):
 // if there are 451+ (QUORUM) votes agree on the same transactionDigest - or 226+ (VETO) votes agree on empty tick
 // then next tick digest is known (from the point of view of the node) - targetNextTickDataDigest
 static void findNextTickDataDigestFromNextTickVotes()
 {
-    const unsigned int nextTick = system.tick + 1;
-    const unsigned int nextTickIndex = ts.tickToIndexCurrentEpoch(nextTick);
-    const Tick* tsCompTicks = ts.ticks.getByTickIndex(nextTickIndex);
-    unsigned int numberOfEmptyNextTickTransactionDigest = 0;
-    unsigned int numberOfUniqueNextTickTransactionDigests = 0;
-    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    updateVoteTallies();
+    const TickVoteTally& tally = voteTallies.tallies[(system.tick + 1) & 1];
+    if (!tally.numberOfUniqueTransactionDigests)
     {
-        if (tsCompTicks[i].epoch == system.epoch)
-        {
-            unsigned int j;
-            for (j = 0; j < numberOfUniqueNextTickTransactionDigests; j++)
-            {
-                if (tsCompTicks[i].transactionDigest == uniqueNextTickTransactionDigests[j])
-                {
-                    break;
-                }
-            }
-            if (j == numberOfUniqueNextTickTransactionDigests)
-            {
-                uniqueNextTickTransactionDigests[numberOfUniqueNextTickTransactionDigests] = tsCompTicks[i].transactionDigest;
-                uniqueNextTickTransactionDigestCounters[numberOfUniqueNextTickTransactionDigests++] = 1;
-            }
-            else
-            {
-                uniqueNextTickTransactionDigestCounters[j]++;
-            }
-
-            if (isZero(tsCompTicks[i].transactionDigest))
-            {
-                numberOfEmptyNextTickTransactionDigest++;
-            }
-        }
+        return;
     }
-    unsigned int mostPopularUniqueNextTickTransactionDigestIndex = 0, totalUniqueNextTickTransactionDigestCounter = uniqueNextTickTransactionDigestCounters[0];
-    for (unsigned int i = 1; i < numberOfUniqueNextTickTransactionDigests; i++)
+    unsigned int mostPopularUniqueNextTickTransactionDigestIndex = 0, totalUniqueNextTickTransactionDigestCounter = tally.uniqueTransactionDigestCounters[0];
+    for (unsigned int i = 1; i < tally.numberOfUniqueTransactionDigests; i++)
     {
-        if (uniqueNextTickTransactionDigestCounters[i] > uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex])
+        if (tally.uniqueTransactionDigestCounters[i] > tally.uniqueTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex])
         {
             mostPopularUniqueNextTickTransactionDigestIndex = i;
         }
-        totalUniqueNextTickTransactionDigestCounter += uniqueNextTickTransactionDigestCounters[i];
+        totalUniqueNextTickTransactionDigestCounter += tally.uniqueTransactionDigestCounters[i];
     }
-    if (uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex] >= QUORUM)
+    if (tally.uniqueTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex] >= QUORUM)
     {
-        targetNextTickDataDigest = uniqueNextTickTransactionDigests[mostPopularUniqueNextTickTransactionDigestIndex];
+        targetNextTickDataDigest = tally.uniqueTransactionDigests[mostPopularUniqueNextTickTransactionDigestIndex];
         targetNextTickDataDigestIsKnown = true;
     }
     else
     {
-        if (numberOfEmptyNextTickTransactionDigest > NUMBER_OF_COMPUTORS - QUORUM
-            || uniqueNextTickTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex] + (NUMBER_OF_COMPUTORS - totalUniqueNextTickTransactionDigestCounter) < QUORUM)
+        if (tally.numberOfEmptyTransactionDigests > NUMBER_OF_COMPUTORS - QUORUM
+            || tally.uniqueTransactionDigestCounters[mostPopularUniqueNextTickTransactionDigestIndex] + (NUMBER_OF_COMPUTORS - totalUniqueNextTickTransactionDigestCounter) < QUORUM)
         {
             // Create empty tick
             targetNextTickDataDigest = m256i::zero();
@@ -4718,21 +6577,61 @@ static void findNextTickDataDigestFromCurrentTickVotes()
 // return number of current tick vote
 static unsigned int countCurrentTickVote()
 {
-    const unsigned int currentTickIndex = ts.tickToIndexCurrentEpoch(system.tick);
-    unsigned int tickTotalNumberOfComputors = 0;
-    const Tick* tsCompTicks = ts.ticks.getByTickIndex(currentTickIndex);
-    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-    {
-        ts.ticks.acquireLock(i);
+    updateVoteTallies();
+    return voteTallies.tallies[system.tick & 1].numberOfVotes;
+}
 
-        if (tsCompTicks[i].epoch == system.epoch)
+// Send requestedTickTransactions to a random peer and a full node peer. If many transactions are missing (such as when
+// catching up in busy ticks), the missing transactions are split between the two requests, so each of them is only
+// sent once instead of twice. The halves are swapped with every request, so a transaction that the one peer does not
+// have is requested from the other peer next time.
+// Can only be called from the main thread.
+static void pushRequestedTickTransactions()
+{
+    static constexpr unsigned int minNumberOfMissingTransactionsToSplit = NUMBER_OF_TRANSACTIONS_PER_TICK / 8;
+    static unsigned int splitParity = 0;
+
+    unsigned int numberOfMissingTransactions = 0;
+    for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+    {
+        if (!(requestedTickTransactions.requestedTickTransactions.transactionFlags[i >> 3] & (1 << (i & 7))))
         {
-            tickTotalNumberOfComputors++;
+            numberOfMissingTransactions++;
         }
+    }
 
-        ts.ticks.releaseLock(i);
+    // Without a full node peer, the half for the full node would never be requested -> request all from any peer
+    if (numberOfMissingTransactions < minNumberOfMissingTransactionsToSplit || !isAnyFullNodeConnected())
+    {
+        requestedTickTransactions.header.randomizeDejavu();
+        pushToAny(&requestedTickTransactions.header);
+        pushToAnyFullNode(&requestedTickTransactions.header);
+        return;
+    }
+
+    // In each half, flag the missing transactions of the other half as not requested (flag = 1)
+    auto anyPeerRequest = requestedTickTransactions;
+    auto fullNodeRequest = requestedTickTransactions;
+    splitParity ^= 1;
+    unsigned int missingTransactionCounter = 0;
+    for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+    {
+        if (!(requestedTickTransactions.requestedTickTransactions.transactionFlags[i >> 3] & (1 << (i & 7))))
+        {
+            if ((missingTransactionCounter++ & 1) == splitParity)
+            {
+                fullNodeRequest.requestedTickTransactions.transactionFlags[i >> 3] |= (1 << (i & 7));
+            }
+            else
+            {
+                anyPeerRequest.requestedTickTransactions.transactionFlags[i >> 3] |= (1 << (i & 7));
+            }
+        }
     }
-    return tickTotalNumberOfComputors;
+    anyPeerRequest.header.randomizeDejavu();
+    pushToAny(&anyPeerRequest.header);
+    fullNodeRequest.header.randomizeDejavu();
+    pushToAnyFullNode(&fullNodeRequest.header);
 }
 
 // This function scans through all transactions digest in next tickData
@@ -4743,6 +6642,143 @@ static unsigned int countCurrentTickVote()
 // - 1 tx per source publickey per tick
 // - 128 txs per computor publickey per tick
 // Note requestedTickTransactions.transactionFlags are set to 0 for tx we want to request and 1 for tx we are not interested in
+// Verification state of the transactions of the next tick and incremental computation of its transaction body digest.
+// prepareNextTickTransactions() is called in each iteration of the tick processor loop while waiting for tick data,
+// transactions, or votes. It remembers which slots have been verified instead of hashing all transactions again in
+// each call, and feeds the verified transactions to the K12 instance of the body digest in slot order as soon as all
+// preceding slots are available. computeTxBodyDigestBase() then only needs to hash the remaining slots and finalize.
+// Only accessed by the tick processor.
+static struct
+{
+    unsigned int tick;
+
+    // Digest (from nextTickData) and offset of the transaction in slot i at the time it was verified. Offset is 0 if
+    // slot isn't verified. Slots before bodyDigestSlot have been absorbed by bodyDigestInstance, verifiedDigests[i]
+    // is zero for the empty slots among them.
+    m256i verifiedDigests[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    unsigned long long verifiedOffsets[NUMBER_OF_TRANSACTIONS_PER_TICK];
+
+    XKCP::KangarooTwelve_Instance bodyDigestInstance;
+    unsigned int bodyDigestSlot;
+} nextTickTransactionsState;
+
+static void restartTxBodyDigest()
+{
+    XKCP::KangarooTwelve_Initialize(&nextTickTransactionsState.bodyDigestInstance, 128, sizeof(etalonTick.saltedTransactionBodyDigest));
+    nextTickTransactionsState.bodyDigestSlot = 0;
+}
+
+// Reset state if tick changed and restart body digest if nextTickData changed in the already absorbed slots
+static void checkNextTickTransactionsState(unsigned int tick)
+{
+    auto& state = nextTickTransactionsState;
+    if (state.tick != tick)
+    {
+        state.tick = tick;
+        setMem(state.verifiedOffsets, sizeof(state.verifiedOffsets), 0);
+        restartTxBodyDigest();
+        return;
+    }
+    for (unsigned int i = 0; i < state.bodyDigestSlot; i++)
+    {
+        if (state.verifiedDigests[i] != nextTickData.transactionDigests[i])
+        {
+            restartTxBodyDigest();
+            return;
+        }
+    }
+}
+
+static bool isNextTickTransactionVerified(unsigned int slot, unsigned long long offset)
+{
+    return offset
+        && nextTickTransactionsState.verifiedOffsets[slot] == offset
+        && nextTickTransactionsState.verifiedDigests[slot] == nextTickData.transactionDigests[slot];
+}
+
+static void setNextTickTransactionVerified(unsigned int slot, unsigned long long offset)
+{
+    auto& state = nextTickTransactionsState;
+    if (slot < state.bodyDigestSlot && state.verifiedOffsets[slot] != offset)
+    {
+        // transaction in absorbed slot has been replaced
+        restartTxBodyDigest();
+    }
+    state.verifiedOffsets[slot] = offset;
+    state.verifiedDigests[slot] = nextTickData.transactionDigests[slot];
+}
+
+static void setNextTickTransactionUnverified(unsigned int slot)
+{
+    auto& state = nextTickTransactionsState;
+    if (slot < state.bodyDigestSlot && state.verifiedOffsets[slot])
+    {
+        restartTxBodyDigest();
+    }
+    state.verifiedOffsets[slot] = 0;
+}
+
+// Absorb verified transactions of the next tick into the body digest, up to the first slot that is missing
+static void advanceTxBodyDigest(const unsigned long long* tsTransactionOffsets)
+{
+    auto& state = nextTickTransactionsState;
+    while (state.bodyDigestSlot < NUMBER_OF_TRANSACTIONS_PER_TICK)
+    {
+        const unsigned int i = state.bodyDigestSlot;
+        if (isZero(nextTickData.transactionDigests[i]))
+        {
+            state.verifiedDigests[i] = m256i::zero();
+            state.verifiedOffsets[i] = 0;
+        }
+        else
+        {
+            ts.tickTransactions.acquireLock();
+            const bool verified = isNextTickTransactionVerified(i, tsTransactionOffsets[i]);
+            if (verified)
+            {
+                const Transaction* transaction = ts.tickTransactions(tsTransactionOffsets[i]);
+                XKCP::KangarooTwelve_Update(&state.bodyDigestInstance, reinterpret_cast<const unsigned char*>(transaction), transaction->totalSize());
+            }
+            ts.tickTransactions.releaseLock();
+            if (!verified)
+            {
+                break;
+            }
+        }
+        state.bodyDigestSlot++;
+    }
+}
+
+// Transactions of the next tick that are in tick storage but haven't been verified yet, collected by
+// prepareNextTickTransactions() for hashing them in parallel
+static struct
+{
+    unsigned int count;
+    unsigned int slots[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    unsigned long long offsets[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    bool digestMatches[NUMBER_OF_TRANSACTIONS_PER_TICK];
+} nextTickTransactionsToVerify;
+
+// Number of transactions hashed per chunk when verifying transactions of the next tick in parallel
+static constexpr unsigned long long nextTickTransactionsVerifyChunkSize = 16;
+
+// Hash transactions [begin, end) of nextTickTransactionsToVerify and compare them with the digests in nextTickData
+// (ParallelJobs::ChunkFunction). Transactions in tick storage aren't changed after they have been written (new ones
+// are appended), so they can be read without lock at the offsets collected before.
+static void verifyNextTickTransactions(void*, unsigned long long begin, unsigned long long end)
+{
+    auto& toVerify = nextTickTransactionsToVerify;
+    for (unsigned long long k = begin; k < end; k++)
+    {
+        const Transaction* transaction = ts.tickTransactions(toVerify.offsets[k]);
+        ASSERT(transaction->checkValidity());
+        ASSERT(transaction->tick == nextTickTransactionsState.tick);
+        unsigned char digest[32];
+        KangarooTwelve(transaction, transaction->totalSize(), digest, sizeof(digest));
+        toVerify.digestMatches[k] = (digest == nextTickData.transactionDigests[toVerify.slots[k]]);
+    }
+}
+
 static void prepareNextTickTransactions()
 {
     const unsigned int nextTick = system.tick + 1;
@@ -4750,6 +6786,7 @@ static void prepareNextTickTransactions()
 
     nextTickTransactionsSemaphore = 1; // signal a flag for displaying on the console log
 
+    checkNextTickTransactionsState(nextTick);
 
     // unknownTransactions is set to 1 if a transaction is missing in the local storage
     unsigned long long unknownTransactions[NUMBER_OF_TRANSACTIONS_PER_TICK / 64];
@@ -4759,35 +6796,49 @@ static void prepareNextTickTransactions()
     // This function maybe called multiple times per tick due to lack of data (txs or votes)
     // Here we do a simple pre scan to check txs via tsNextTickTransactionOffsets (already processed - aka already copying from pendingTransaction array to tickTransaction)
     // Mark all transaction that are not in the tickStorage as missing
+    // Transactions that have been verified in a previous call aren't hashed again. The others that are in the tick
+    // storage are collected and hashed by idle processors in parallel.
+    auto& toVerify = nextTickTransactionsToVerify;
+    toVerify.count = 0;
+    ts.tickTransactions.acquireLock();
     for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
     {
         if (!isZero(nextTickData.transactionDigests[i]))
         {
             numberOfNextTickTransactions++;
 
-            ts.tickTransactions.acquireLock();
-
-            if (tsNextTickTransactionOffsets[i])
+            const unsigned long long offset = tsNextTickTransactionOffsets[i];
+            if (isNextTickTransactionVerified(i, offset))
             {
-                const Transaction* transaction = ts.tickTransactions(tsNextTickTransactionOffsets[i]);
-                ASSERT(transaction->checkValidity());
-                ASSERT(transaction->tick == nextTick);
-                unsigned char digest[32];
-                KangarooTwelve(transaction, transaction->totalSize(), digest, sizeof(digest));
-                if (digest == nextTickData.transactionDigests[i])
-                {
-                    numberOfKnownNextTickTransactions++;
-                }
-                else
-                {
-                    unknownTransactions[i >> 6] |= (1ULL << (i & 63));
-                }
+                numberOfKnownNextTickTransactions++;
+            }
+            else if (offset)
+            {
+                toVerify.slots[toVerify.count] = i;
+                toVerify.offsets[toVerify.count++] = offset;
             }
             else
             {
+                setNextTickTransactionUnverified(i);
                 unknownTransactions[i >> 6] |= (1ULL << (i & 63));
             }
-            ts.tickTransactions.releaseLock();
+        }
+    }
+    ts.tickTransactions.releaseLock();
+
+    parallelJobs.run(verifyNextTickTransactions, nullptr, toVerify.count, nextTickTransactionsVerifyChunkSize);
+    for (unsigned int k = 0; k < toVerify.count; k++)
+    {
+        const unsigned int i = toVerify.slots[k];
+        if (toVerify.digestMatches[k])
+        {
+            setNextTickTransactionVerified(i, toVerify.offsets[k]);
+            numberOfKnownNextTickTransactions++;
+        }
+        else
+        {
+            setNextTickTransactionUnverified(i);
+            unknownTransactions[i >> 6] |= (1ULL << (i & 63));
         }
     }
 
@@ -4795,50 +6846,37 @@ static void prepareNextTickTransactions()
     {
         // Checks if any of the missing transactions is available in the pending transaction pool and remove unknownTransaction flag if found
 
-        unsigned int numPendingTickTxs = pendingTxsPool.getNumberOfPendingTickTxs(nextTick);
+        // Look up each unknown transaction by digest instead of comparing each pending tx with all digests of the tick
+        auto* tsPendingTransactionOffsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(nextTick);
         pendingTxsPool.acquireLock();
-        for (unsigned int i = 0; i < numPendingTickTxs; ++i)
+        for (unsigned int j = 0; j < NUMBER_OF_TRANSACTIONS_PER_TICK; j++)
         {
-// #if !defined(NDEBUG) && !defined(NO_UEFI)
-//             addDebugMessage(L"pendingTxsPool.get() call in prepareNextTickTransactions()");
-// #endif
-            Transaction* pendingTransaction = pendingTxsPool.getTx(nextTick, i);
-            if (pendingTransaction)
+            if (unknownTransactions[j >> 6] & (1ULL << (j & 63)))
             {
-                ASSERT(pendingTransaction->checkValidity());
-                auto* tsPendingTransactionOffsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(pendingTransaction->tick);
-
-                const m256i* digest = pendingTxsPool.getDigest(nextTick, i);
-                if (digest)
+                const Transaction* pendingTransaction = pendingTxsPool.findTx(nextTick, nextTickData.transactionDigests[j]);
+                if (pendingTransaction)
                 {
-                    for (unsigned int j = 0; j < NUMBER_OF_TRANSACTIONS_PER_TICK; j++)
+                    ASSERT(pendingTransaction->checkValidity());
+                    ts.tickTransactions.acquireLock();
+                    // write tx to tick tx storage, no matter if tsNextTickTransactionOffsets[i] is 0 (new tx)
+                    // or not (tx with digest that doesn't match tickData needs to be overwritten)
                     {
-                        if (unknownTransactions[j >> 6] & (1ULL << (j & 63)))
+                        const unsigned int transactionSize = pendingTransaction->totalSize();
+                        if (ts.nextTickTransactionOffset + transactionSize <= ts.tickTransactions.storageSpaceCurrentEpoch)
                         {
-                            if (*digest == nextTickData.transactionDigests[j])
-                            {
-                                ts.tickTransactions.acquireLock();
-                                // write tx to tick tx storage, no matter if tsNextTickTransactionOffsets[i] is 0 (new tx)
-                                // or not (tx with digest that doesn't match tickData needs to be overwritten)
-                                {
-                                    const unsigned int transactionSize = pendingTransaction->totalSize();
-                                    if (ts.nextTickTransactionOffset + transactionSize <= ts.tickTransactions.storageSpaceCurrentEpoch)
-                                    {
-                                        tsPendingTransactionOffsets[j] = ts.nextTickTransactionOffset;
-                                        copyMem(ts.tickTransactions(ts.nextTickTransactionOffset), pendingTransaction, transactionSize);
-                                        ts.nextTickTransactionOffset += transactionSize;
-
-                                        numberOfKnownNextTickTransactions++;
-                                    }
-                                }
-                                ts.tickTransactions.releaseLock();
+                            tsPendingTransactionOffsets[j] = ts.nextTickTransactionOffset;
+                            copyMem(ts.tickTransactions(ts.nextTickTransactionOffset), pendingTransaction, transactionSize);
+                            ts.nextTickTransactionOffset += transactionSize;
 
-                                unknownTransactions[j >> 6] &= ~(1ULL << (j & 63));
+                            // found by digest, so it doesn't need to be hashed for verification
+                            setNextTickTransactionVerified(j, tsPendingTransactionOffsets[j]);
 
-                                break;         
-                            }
+                            numberOfKnownNextTickTransactions++;
                         }
                     }
+                    ts.tickTransactions.releaseLock();
+
+                    unknownTransactions[j >> 6] &= ~(1ULL << (j & 63));
                 }
             }
         }
@@ -4863,30 +6901,35 @@ static void prepareNextTickTransactions()
             }
         }
     }
+
+    // Hash transaction bodies while waiting for the remaining data, so computeTxBodyDigestBase() is fast
+    advanceTxBodyDigest(tsNextTickTransactionOffsets);
+
     nextTickTransactionsSemaphore = 0;
 }
 
 
 // Computes the digest of all tx bodies of a certain tick and saves it in etalonTick (4 bytes)
+// The slots that have been absorbed by prepareNextTickTransactions() are reused, so usually only the finalization
+// is left to do here.
 // This function can only be called by tickProcessor
 static void computeTxBodyDigestBase(const int tick)
 {
     ASSERT(nextTickData.epoch == system.epoch); // nextTickData need to be valid
-    constexpr size_t outputLen = 4; // output length in bytes
-
-    XKCP::KangarooTwelve_Initialize(&g_k12_instance, 128, outputLen);
 
     const unsigned int tickIndex = ts.tickToIndexCurrentEpoch(tick);
     const auto* tsTransactionOffsets = ts.tickTransactionOffsets.getByTickIndex(tickIndex);
 
-    for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+    checkNextTickTransactionsState(tick);
+    advanceTxBodyDigest(tsTransactionOffsets);
+
+    // Finalize copy of instance, so the state can still be used if nextTickData changes in the remaining slots
+    copyMem(&g_k12_instance, &nextTickTransactionsState.bodyDigestInstance, sizeof(g_k12_instance));
+
+    for (unsigned int i = nextTickTransactionsState.bodyDigestSlot; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
     {
         if (!isZero(nextTickData.transactionDigests[i]))
         {
-            // TODO: Optimization to check: We have the ts locked for the whole K12_Update.
-            //       It might be worth to copy the transaction and release lock before update the K12 state.
-            // TODO: Here we check each Tx against the nextTickData again (before we did it in prepareNextTickTransactions
-            //       Might be worth to do only do it once.
             ts.tickTransactions.acquireLock();
 
             if (tsTransactionOffsets[i]) {
@@ -4942,26 +6985,22 @@ static void computeTxBodyDigestBase(const int tick)
     }
 }
 
-// special procedure to sign the tick vote
-static void signTickVote(const unsigned char* subseed, const unsigned char* publicKey, const unsigned char* messageDigest, unsigned char* signature)
+// special procedure to sign the tick vote of computor seed: random nonces are drawn until the signature fulfills
+// TARGET_TICK_VOTE_SIGNATURE, using the signing key precomputed at startup
+static void signTickVote(unsigned int computorSeedIndex, const unsigned char* messageDigest, unsigned char* signature)
 {
     PROFILE_SCOPE();
 
-    signWithRandomK(subseed, publicKey, messageDigest, signature);
-    bool isOk = verifyTickVoteSignature(publicKey, messageDigest, signature, false);
-    while (!isOk)
-    {
-        signWithRandomK(subseed, publicKey, messageDigest, signature);
-        isOk = verifyTickVoteSignature(publicKey, messageDigest, signature, false);
-    }
+    signWithSigningKeyAndRandomK(computorSigningKeys[computorSeedIndex].m256i_u8, computorPublicKeys[computorSeedIndex].m256i_u8, messageDigest, signature, TARGET_TICK_VOTE_SIGNATURE);
+    ASSERT(verifyTickVoteSignature(computorPublicKeys[computorSeedIndex].m256i_u8, messageDigest, signature, false));
 }
 
-// broadcast all tickVotes from all IDs in this node
-static void broadcastTickVotes()
+// Sign and broadcast tick votes of own computors [begin, end) (chunk function of broadcastTickVotes())
+static void signAndBroadcastTickVotes(void*, unsigned long long begin, unsigned long long end)
 {
     BroadcastTick broadcastTick;
     copyMem(&broadcastTick.tick, &etalonTick, sizeof(Tick));
-    for (unsigned int i = 0; i < numberOfOwnComputorIndices; i++)
+    for (unsigned long long i = begin; i < end; i++)
     {
         broadcastTick.tick.computorIndex = ownComputorIndices[i] ^ BroadcastTick::type();
         broadcastTick.tick.epoch = system.epoch;
@@ -4986,8 +7025,7 @@ static void broadcastTickVotes()
         unsigned char digest[32];
         KangarooTwelve(&broadcastTick.tick, sizeof(Tick) - SIGNATURE_SIZE, digest, sizeof(digest));
         broadcastTick.tick.computorIndex ^= BroadcastTick::type();
-        signTickVote(computorSubseeds[ownComputorIndicesMapping[i]].m256i_u8, computorPublicKeys[ownComputorIndicesMapping[i]].m256i_u8, digest, broadcastTick.tick.signature);
-
+        signTickVote(ownComputorIndicesMapping[i], digest, broadcastTick.tick.signature);
 
         enqueueResponse(NULL, sizeof(broadcastTick), BroadcastTick::type(), 0, &broadcastTick);
         // NOTE: here we don't copy these votes to memory, instead we wait other nodes echoing these votes back because:
@@ -4997,77 +7035,133 @@ static void broadcastTickVotes()
     }
 }
 
+// broadcast all tickVotes from all IDs in this node
+// Signing is on the critical path to quorum and costs at least one scalar multiplication per vote (several on average
+// due to TARGET_TICK_VOTE_SIGNATURE), so the votes are signed in parallel with the help of idle request processors.
+static void broadcastTickVotes()
+{
+    PROFILE_SCOPE();
+
+    parallelJobs.run(signAndBroadcastTickVotes, nullptr, numberOfOwnComputorIndices, 1);
+}
+
+// State of validating the votes of the current tick against etalonTick. Votes are validated in the order of the vote
+// tally, so each updateVotesCount() call only needs to check the votes that arrived since the last call, unless
+// etalonTick, the tick, or the tally changed.
+static struct
+{
+    // etalonTick and resourceTestingDigest that the results are based on (validation restarts if they change)
+    Tick etalonTick;
+    unsigned int resourceTestingDigest;
+    unsigned int tick;
+    unsigned int tallyGeneration;
+    unsigned int numberOfValidatedVotes; // number of voters of the tally that have been validated
+    unsigned int numberOfMatchingVotes;
+} voteValidationState;
+
+// Compare vote of computor with etalonTick. Returns if all digests except expectedNextTickTransactionDigest and
+// saltedTransactionBodyDigest match. registerVote is set if the vote is counted by voteCounter.
+static bool validateVote(const Tick* tick, bool& registerVote)
+{
+    registerVote = false;
+    if (*((unsigned long long*) & tick->millisecond) == *((unsigned long long*) & etalonTick.millisecond)
+        && tick->prevSpectrumDigest == etalonTick.prevSpectrumDigest
+        && tick->prevUniverseDigest == etalonTick.prevUniverseDigest
+        && tick->prevComputerDigest == etalonTick.prevComputerDigest
+        && tick->transactionDigest == etalonTick.transactionDigest)
+    {
+        m256i saltedData[2];
+        m256i saltedDigest;
+        saltedData[0] = broadcastedComputors.computors.publicKeys[tick->computorIndex];
+        saltedData[1].m256i_u32[0] = resourceTestingDigest;
+        KangarooTwelve(saltedData, 32 + sizeof(resourceTestingDigest), &saltedDigest, sizeof(resourceTestingDigest));
+        if (tick->saltedResourceTestingDigest == saltedDigest.m256i_u32[0])
+        {
+            saltedData[1] = etalonTick.saltedSpectrumDigest;
+            KangarooTwelve64To32(saltedData, &saltedDigest);
+            if (tick->saltedSpectrumDigest == saltedDigest)
+            {
+                saltedData[1] = etalonTick.saltedUniverseDigest;
+                KangarooTwelve64To32(saltedData, &saltedDigest);
+                if (tick->saltedUniverseDigest == saltedDigest)
+                {
+                    saltedData[1] = etalonTick.saltedComputerDigest;
+                    KangarooTwelve64To32(saltedData, &saltedDigest);
+                    if (tick->saltedComputerDigest == saltedDigest)
+                    {
+                        // expectedNextTickTransactionDigest and txBodyDigest is ignored to find consensus of current tick
+                        // Vote of a node is only counting if txBodyDigest is matching with the version of the node
+                        if (!isZero(etalonTick.expectedNextTickTransactionDigest))
+                        {
+                            saltedData[1] = m256i::zero();
+                            saltedData[1].m256i_u32[0] = etalonTick.saltedTransactionBodyDigest;
+                            KangarooTwelve(saltedData, 32 + sizeof(etalonTick.saltedTransactionBodyDigest), &saltedDigest, sizeof(etalonTick.saltedTransactionBodyDigest));
+                            // to avoid submitting invalid votes (eg: all zeroes with valid signature)
+                            // only count votes that matched etalonTick
+                            registerVote = (tick->saltedTransactionBodyDigest == saltedDigest.m256i_u32[0]);
+                        }
+                        else // If expectedNextTickTransactionDigest changes to to empty due to time-out,
+                             // we count votes anyway, otherwise we may end up with no or very few votes
+                        {
+                            registerVote = true;
+                        }
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
 // count the votes of current tick (system.tick) and compare it with etalonTick
 // tickNumberOfComputors: total number of votes that have matched digests with this node states
 // tickTotalNumberOfComputors: total number of received votes
 // NOTE: this doesn't compare expectedNextTickTransactionDigest
+// Only votes that arrived since the last call are validated, unless etalonTick or the tick changed.
 static void updateVotesCount(unsigned int& tickNumberOfComputors, unsigned int& tickTotalNumberOfComputors)
 {
+    updateVoteTallies();
+    const TickVoteTally& tally = voteTallies.tallies[system.tick & 1];
+
+    if (voteValidationState.tick != system.tick
+        || voteValidationState.tallyGeneration != tally.generation
+        || voteValidationState.resourceTestingDigest != resourceTestingDigest
+        || compareMem(&voteValidationState.etalonTick, &etalonTick, sizeof(Tick)) != 0)
+    {
+        // etalonTick, tick, or tally changed -> validate all votes again
+        voteValidationState.tick = system.tick;
+        voteValidationState.tallyGeneration = tally.generation;
+        voteValidationState.resourceTestingDigest = resourceTestingDigest;
+        copyMem(&voteValidationState.etalonTick, &etalonTick, sizeof(Tick));
+        voteValidationState.numberOfValidatedVotes = 0;
+        voteValidationState.numberOfMatchingVotes = 0;
+    }
+
     const unsigned int currentTickIndex = ts.tickToIndexCurrentEpoch(system.tick);
     const Tick* tsCompTicks = ts.ticks.getByTickIndex(currentTickIndex);
-    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    for (; voteValidationState.numberOfValidatedVotes < tally.numberOfVotes; voteValidationState.numberOfValidatedVotes++)
     {
+        const unsigned int i = tally.voters[voteValidationState.numberOfValidatedVotes];
         ts.ticks.acquireLock(i);
 
+        // votes in tally are stored in ts.ticks and don't change until the end of the epoch
         const Tick* tick = &tsCompTicks[i];
-        if (tick->epoch == system.epoch)
+        bool registerVote;
+        if (validateVote(tick, registerVote))
         {
-            tickTotalNumberOfComputors++;
-
-            if (*((unsigned long long*) & tick->millisecond) == *((unsigned long long*) & etalonTick.millisecond)
-                && tick->prevSpectrumDigest == etalonTick.prevSpectrumDigest
-                && tick->prevUniverseDigest == etalonTick.prevUniverseDigest
-                && tick->prevComputerDigest == etalonTick.prevComputerDigest
-                && tick->transactionDigest == etalonTick.transactionDigest)
+            voteValidationState.numberOfMatchingVotes++;
+            if (registerVote)
             {
-                m256i saltedData[2];
-                m256i saltedDigest;
-                saltedData[0] = broadcastedComputors.computors.publicKeys[tick->computorIndex];
-                saltedData[1].m256i_u32[0] = resourceTestingDigest;
-                KangarooTwelve(saltedData, 32 + sizeof(resourceTestingDigest), &saltedDigest, sizeof(resourceTestingDigest));
-                if (tick->saltedResourceTestingDigest == saltedDigest.m256i_u32[0])
-                {
-                    saltedData[1] = etalonTick.saltedSpectrumDigest;
-                    KangarooTwelve64To32(saltedData, &saltedDigest);
-                    if (tick->saltedSpectrumDigest == saltedDigest)
-                    {
-                        saltedData[1] = etalonTick.saltedUniverseDigest;
-                        KangarooTwelve64To32(saltedData, &saltedDigest);
-                        if (tick->saltedUniverseDigest == saltedDigest)
-                        {
-                            saltedData[1] = etalonTick.saltedComputerDigest;
-                            KangarooTwelve64To32(saltedData, &saltedDigest);
-                            if (tick->saltedComputerDigest == saltedDigest)
-                            {
-                                // expectedNextTickTransactionDigest and txBodyDigest is ignored to find consensus of current tick
-                                tickNumberOfComputors++;
-
-                                // Vote of a node is only counting if txBodyDigest is matching with the version of the node
-                                if (!isZero(etalonTick.expectedNextTickTransactionDigest))
-                                {
-                                    saltedData[1] = m256i::zero();
-                                    saltedData[1].m256i_u32[0] = etalonTick.saltedTransactionBodyDigest;
-                                    KangarooTwelve(saltedData, 32 + sizeof(etalonTick.saltedTransactionBodyDigest), &saltedDigest, sizeof(etalonTick.saltedTransactionBodyDigest));
-                                    if(tick->saltedTransactionBodyDigest == saltedDigest.m256i_u32[0])
-                                    {
-                                        // to avoid submitting invalid votes (eg: all zeroes with valid signature)
-                                        // only count votes that matched etalonTick
-                                        voteCounter.registerNewVote(tick->tick, tick->computorIndex);
-                                    }
-                                }
-                                else // If expectedNextTickTransactionDigest changes to to empty due to time-out,
-                                     // we count votes anyway, otherwise we may end up with no or very few votes
-                                {
-                                    voteCounter.registerNewVote(tick->tick, tick->computorIndex);
-                                }
-                            }
-                        }
-                    }
-                }
+                voteCounter.registerNewVote(tick->tick, tick->computorIndex);
             }
         }
+
         ts.ticks.releaseLock(i);
     }
+
+    tickNumberOfComputors += voteValidationState.numberOfMatchingVotes;
+    tickTotalNumberOfComputors += tally.numberOfVotes;
 }
 
 // try to resend tick votes if local system.tick gets stuck for too long
@@ -5206,6 +7300,10 @@ static void tickProcessor(void*)
                 }
                 processTick(processorNumber);
                 latestProcessedTick = system.tick;
+
+                tickPhaseClock.tickProcessed = __rdtsc();
+                tickPhaseClock.dataAvailable = 0;
+                tickPhaseClock.quorumReached = 0;
             }
 
             if (gFutureTickTotalNumberOfComputors > NUMBER_OF_COMPUTORS - QUORUM)
@@ -5370,6 +7468,12 @@ static void tickProcessor(void*)
                     // This node has all required transactions
                     requestedTickTransactions.requestedTickTransactions.tick = 0;
 
+                    if (tickPhaseClock.tickProcessed && !tickPhaseClock.dataAvailable)
+                    {
+                        tickPhaseClock.dataAvailable = __rdtsc();
+                        tickPhaseStats.addSample(TICK_PHASE_WAIT_TICK_DATA, (tickPhaseClock.dataAvailable - tickPhaseClock.tickProcessed) * 1000000 / frequency);
+                    }
+
                     if (ts.tickData[currentTickIndex].epoch == system.epoch)
                     {
                         KangarooTwelve(&ts.tickData[currentTickIndex], sizeof(TickData), &etalonTick.transactionDigest, 32);
@@ -5395,6 +7499,11 @@ static void tickProcessor(void*)
                         {
                             computeTxBodyDigestBase(nextTick);
                             lastExpectedTickTransactionDigest = etalonTick.expectedNextTickTransactionDigest;
+
+                            // All transactions of the next tick are known -> warm up their entities and compute scores
+                            // of solutions for processTick()
+                            prefetchTickTransactions(nextTick);
+                            speculateNextTickSolutions();
                         }
                     }
                     else
@@ -5426,6 +7535,12 @@ static void tickProcessor(void*)
 
                     if (tickNumberOfComputors >= QUORUM)
                     {
+                        if (tickPhaseClock.dataAvailable && !tickPhaseClock.quorumReached)
+                        {
+                            tickPhaseClock.quorumReached = __rdtsc();
+                            tickPhaseStats.addSample(TICK_PHASE_VOTE_COLLECTION, (tickPhaseClock.quorumReached - tickPhaseClock.dataAvailable) * 1000000 / frequency);
+                        }
+
                         tryForceEmptyNextTick();
 
                         if (targetNextTickDataDigestIsKnown)
@@ -5522,10 +7637,22 @@ static void tickProcessor(void*)
                                     ts.tickData.releaseLock();
                                 }
 
+                                if (tickPhaseClock.quorumReached)
+                                {
+                                    tickPhaseStats.addSample(TICK_PHASE_QUORUM, (__rdtsc() - tickPhaseClock.quorumReached) * 1000000 / frequency);
+                                }
+                                tickPhaseClock.tickProcessed = 0;
+
                                 system.tick++;
 
+                                // fallback if idle request processors haven't cleared tick storage of new epoch fast enough
+                                ts.ensureClearedAhead(system.tick);
+
                                 updateNumberOfTickTransactions();
                                 pendingTxsPool.incrementFirstStoredTick();
+#if TICK_STORAGE_TIERED_MODE
+                                ts.archiveOldTicks(system.tick);
+#endif
 
                                 if (system.tick % NUMBER_OF_COMPUTORS == 0)
                                 {
@@ -5535,27 +7662,34 @@ static void tickProcessor(void*)
                                 bool isBeginEpoch = false;
                                 if (epochTransitionState == 1)
                                 {
+                                    epochTransitionStats.reset();
+                                    const unsigned long long epochTransitionStartTsc = __rdtsc();
 
                                     // wait until all request processors are in waiting state
                                     WAIT_WHILE(epochTransitionWaitingRequestProcessors < nRequestProcessorIDs);
+                                    epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_WAIT_REQUEST_PROCESSORS, epochTransitionStartTsc);
 
                                     // end current epoch
                                     endEpoch();
 
                                     // Save the file of revenue. This blocking save can be called from any thread
+                                    unsigned long long phaseStartTsc = __rdtsc();
                                     saveRevenueComponents(NULL);
+                                    phaseStartTsc = epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_SAVE_REVENUE, phaseStartTsc);
 
                                     // Reorder futureComputors so requalifying computors keep their index
                                     // This is needed for correct execution fee reporting across epoch boundaries
-                                    static_assert(defaultCommonBuffersSize >= stableComputorIndexBufferSize(), "commonBuffers too small for stable computor index");
-                                    void* reorgBuffer = commonBuffers.acquireBuffer(stableComputorIndexBufferSize());
+                                    static_assert(reorgBuffersSize >= stableComputorIndexBufferSize(), "reorgBuffers too small for stable computor index");
+                                    void* reorgBuffer = reorgBuffers.acquireBuffer(stableComputorIndexBufferSize());
                                     ASSERT(reorgBuffer);
                                     calculateStableComputorIndex(system.futureComputors, broadcastedComputors.computors.publicKeys, reorgBuffer);
-                                    commonBuffers.releaseBuffer(reorgBuffer);
+                                    reorgBuffers.releaseBuffer(reorgBuffer);
+                                    phaseStartTsc = epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_STABLE_COMPUTOR_INDEX, phaseStartTsc);
 
                                     // instruct main loop to save system and wait until it is done
                                     systemMustBeSaved = true;
                                     WAIT_WHILE(systemMustBeSaved);
+                                    epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_SAVE_SYSTEM, phaseStartTsc);
                                     epochTransitionState = 2;
 
                                     beginEpoch();
@@ -5566,7 +7700,7 @@ static void tickProcessor(void*)
                                     ASSERT(numberOfMiners == NUMBER_OF_COMPUTORS);
                                     ASSERT(isZero(system.solutions, sizeof(system.solutions)));
                                     ASSERT(isZero(solutionPublicationTicks, sizeof(solutionPublicationTicks)));
-                                    ASSERT(isZero(minerSolutionFlags, NUMBER_OF_MINER_SOLUTION_FLAGS / 8));
+                                    ASSERT(minerSolutionFlags.getCount() == 0);
                                     ASSERT(isZero((void*)minerScores, sizeof(minerScores)));
                                     ASSERT(isZero((void*)minerPublicKeys, sizeof(minerPublicKeys)));
                                     ASSERT(isZero(competitorScores, sizeof(competitorScores)));
@@ -5575,10 +7709,12 @@ static void tickProcessor(void*)
                                     ASSERT(minimumComputorScore == 0 && minimumCandidateScore == 0);
 
                                     // instruct main loop to save files and wait until it is done
+                                    phaseStartTsc = __rdtsc();
                                     spectrumMustBeSaved = true;
                                     universeMustBeSaved = true;
                                     computerMustBeSaved = true;
                                     WAIT_WHILE(computerMustBeSaved || universeMustBeSaved || spectrumMustBeSaved);
+                                    epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_SAVE_FILES, phaseStartTsc);
 
                                     // update etalon tick
                                     etalonTick.epoch++;
@@ -5587,6 +7723,7 @@ static void tickProcessor(void*)
                                     getUniverseDigest(etalonTick.saltedUniverseDigest);
                                     getComputerDigest(etalonTick.saltedComputerDigest);
 
+                                    epochTransitionStats.endPhase(EPOCH_TRANSITION_PHASE_TOTAL, epochTransitionStartTsc);
                                     epochTransitionState = 0;
                                 }
                                 ASSERT(epochTransitionWaitingRequestProcessors >= 0 && epochTransitionWaitingRequestProcessors <= nRequestProcessorIDs);
@@ -5613,11 +7750,16 @@ static void tickProcessor(void*)
                                 numberOfNextTickTransactions = 0;
                                 numberOfKnownNextTickTransactions = 0;
 
+                                const unsigned long long tickEnd = __rdtsc();
+                                if (tickTicks[sizeof(tickTicks) / sizeof(tickTicks[0]) - 1])
+                                {
+                                    tickPhaseStats.addSample(TICK_PHASE_TOTAL, (tickEnd - tickTicks[sizeof(tickTicks) / sizeof(tickTicks[0]) - 1]) * 1000000 / frequency);
+                                }
                                 for (unsigned int i = 0; i < sizeof(tickTicks) / sizeof(tickTicks[0]) - 1; i++)
                                 {
                                     tickTicks[i] = tickTicks[i + 1];
                                 }
-                                tickTicks[sizeof(tickTicks) / sizeof(tickTicks[0]) - 1] = __rdtsc();
+                                tickTicks[sizeof(tickTicks) / sizeof(tickTicks[0]) - 1] = tickEnd;
                             }
                         }
                     }
@@ -5663,7 +7805,9 @@ static void contractProcessorShutdownCallback(EFI_EVENT Event, void* Context)
 
 // directory: source directory to load the file. Default: NULL - load from root dir /
 // forceLoadFromFile: when loading node states from file, we want to make sure it load from file and ignore constructionEpoch == system.epoch case
-static bool loadContractStateFiles(CHAR16* directory, bool forceLoadFromFile)
+// nodeStateSnapshot: files may be zero-run encoded or in sparse format (see saveContractStateFiles()). Epoch files are
+// always in plain format.
+static bool loadContractStateFiles(CHAR16* directory, bool forceLoadFromFile, bool nodeStateSnapshot)
 {
     logToConsole(L"Loading contract files ...");
     for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
@@ -5682,7 +7826,24 @@ static bool loadContractStateFiles(CHAR16* directory, bool forceLoadFromFile)
         }
         else
         {
-            long long loadedSize = load(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory);
+            // With leaf cache, the K12 leafs of the state are hashed while loading
+            ContractStateLeafCache& cache = contractStateLeafCaches[contractIndex];
+            ContractStateLeafsJob job{ (const unsigned char*)contractStates[contractIndex], cache.leafChainingValues, cache.stateCopy, false };
+            cache.valid = false;
+            long long loadedSize = loadAndProcess(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory,
+                cache.stateCopy ? computeLoadedContractStateLeafs : NULL, &job, contractStateParallelHashingLeafsPerChunk * K12_chunkSize, true);
+            cache.valid = (cache.stateCopy && loadedSize == contractDescriptions[contractIndex].stateSize);
+            if (nodeStateSnapshot && loadedSize >= 0 && loadedSize < contractDescriptions[contractIndex].stateSize)
+            {
+                // file of node state snapshot may be zero-run encoded or, if saved by older versions, in sparse format
+                // (data has been moved, so leafs are rehashed)
+                cache.valid = false;
+                unsigned char* scratch = (unsigned char*)commonBuffers.acquireBuffer(loadedSize);
+                ASSERT(scratch);
+                loadedSize = expandZeroRunEncoded(contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], loadedSize, scratch);
+                commonBuffers.releaseBuffer(scratch);
+                loadedSize = expandSparse(contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], loadedSize);
+            }
             setText(message, L" -> "); // set the message after loading otherwise `message` will contain potential messages from load()
             appendText(message, CONTRACT_FILE_NAME);
             if (loadedSize != contractDescriptions[contractIndex].stateSize)
@@ -5725,33 +7886,80 @@ static bool loadContractExecFeeFiles(CHAR16* directory, bool loadAccumulatedTime
     return true;
 }
 
-static bool saveContractStateFiles(CHAR16* directory)
+// Digests of the contract states in the files of the last node state snapshot of epoch snapshotContractStatesEpoch
+// (zero if unknown). The snapshot of an epoch is always saved to the same directory, so the files of states that
+// haven't changed since the last snapshot don't need to be written again.
+static m256i snapshotContractStateDigests[contractCount];
+static unsigned short snapshotContractStatesEpoch = 0;
+
+// Epoch files are saved in plain format, so they can be read by external tools and the zero extension of states whose
+// size grows keeps working. nodeStateSnapshot: save states zero-run encoded if this saves space (see sparse_file_io.h,
+// the digests are computed over the plain states) and skip states that haven't changed since the last node state
+// snapshot. Must be called while the tick processor is paused.
+static bool saveContractStateFiles(CHAR16* directory, bool nodeStateSnapshot)
 {
     logToConsole(L"Saving contract files...");
 
     unsigned long long beginningTick = __rdtsc();
 
     unsigned long long totalSize = 0;
+    unsigned long long unchangedSize = 0;
     long long savedSize = 0;
 
+    if (nodeStateSnapshot && snapshotContractStatesEpoch != system.epoch)
+    {
+        setMem(snapshotContractStateDigests, sizeof(snapshotContractStateDigests), 0);
+        snapshotContractStatesEpoch = system.epoch;
+    }
+
     for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
     {
         CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 9] = contractIndex / 1000 + L'0';
         CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 8] = (contractIndex % 1000) / 100 + L'0';
         CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 7] = (contractIndex % 100) / 10 + L'0';
         CONTRACT_FILE_NAME[sizeof(CONTRACT_FILE_NAME) / sizeof(CONTRACT_FILE_NAME[0]) - 6] = contractIndex % 10 + L'0';
-        contractStateLock[contractIndex].acquireRead();
-        savedSize = save(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory);
-        contractStateLock[contractIndex].releaseRead();
-        totalSize += savedSize;
-        if (savedSize != contractDescriptions[contractIndex].stateSize)
+
+        // the digest is up to date if the state hasn't changed since it was computed at the end of the last tick
+        const bool digestUpToDate = !(contractStateChangeFlags[contractIndex >> 6] & (1ULL << (contractIndex & 63)));
+        if (nodeStateSnapshot)
+        {
+            if (digestUpToDate && !isZero(snapshotContractStateDigests[contractIndex])
+                && snapshotContractStateDigests[contractIndex] == contractStateDigests[contractIndex])
+            {
+                unchangedSize += contractDescriptions[contractIndex].stateSize;
+                continue;
+            }
+            snapshotContractStateDigests[contractIndex] = m256i::zero();
+        }
+
+        if (nodeStateSnapshot)
+        {
+            unsigned char* scratch = (unsigned char*)commonBuffers.acquireBuffer(contractDescriptions[contractIndex].stateSize);
+            ASSERT(scratch);
+            contractStateLock[contractIndex].acquireRead();
+            savedSize = saveZeroRunEncoded(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], scratch, directory);
+            contractStateLock[contractIndex].releaseRead();
+            commonBuffers.releaseBuffer(scratch);
+        }
+        else
+        {
+            contractStateLock[contractIndex].acquireRead();
+            savedSize = save(CONTRACT_FILE_NAME, contractDescriptions[contractIndex].stateSize, contractStates[contractIndex], directory);
+            contractStateLock[contractIndex].releaseRead();
+        }
+        if (savedSize < 0 || (!nodeStateSnapshot && savedSize != contractDescriptions[contractIndex].stateSize))
         {
             return false;
         }
+        totalSize += savedSize;
+        if (nodeStateSnapshot && digestUpToDate)
+            snapshotContractStateDigests[contractIndex] = contractStateDigests[contractIndex];
     }
 
     setNumber(message, totalSize, TRUE);
-    appendText(message, L" bytes of the contract state files are saved (");
+    appendText(message, L" bytes of the contract state files are saved, ");
+    appendNumber(message, unchangedSize, TRUE);
+    appendText(message, L" bytes of unchanged states are skipped (");
     appendNumber(message, (__rdtsc() - beginningTick) * 1000000 / frequency, TRUE);
     appendText(message, L" microseconds).");
     logToConsole(message);
@@ -5810,6 +8018,35 @@ static bool saveRevenueComponents(CHAR16* directory)
     return false;
 }
 
+// Number of contract locals stacks to allocate. With CONTRACT_EXECUTION_BUFFERS_BY_PROCESSOR_COUNT, one for the contract
+// processor and each request processor (the main processor and the tick processor do not run contracts, see main())
+static unsigned int getContractLocalsStackCount()
+{
+#if !CONTRACT_EXECUTION_BUFFERS_BY_PROCESSOR_COUNT
+    return NUMBER_OF_CONTRACT_EXECUTION_BUFFERS;
+#else
+    EFI_GUID mpServiceProtocolGuid = EFI_MP_SERVICES_PROTOCOL_GUID;
+    EFI_MP_SERVICES_PROTOCOL* mpServices = NULL;
+    unsigned long long numberOfAllProcessors = 0, numberOfEnabledProcessors = 0;
+    if (bs->LocateProtocol(&mpServiceProtocolGuid, NULL, (void**)&mpServices) != EFI_SUCCESS
+        || mpServices->GetNumberOfProcessors(mpServices, &numberOfAllProcessors, &numberOfEnabledProcessors) != EFI_SUCCESS)
+    {
+        return NUMBER_OF_CONTRACT_EXECUTION_BUFFERS;
+    }
+
+    // enabled application processors (all except main), limited like in main()
+    unsigned long long usedProcessors = (numberOfEnabledProcessors > 1) ? numberOfEnabledProcessors - 1 : 0;
+    if (usedProcessors > MAX_NUMBER_OF_PROCESSORS)
+        usedProcessors = MAX_NUMBER_OF_PROCESSORS;
+    unsigned long long count = (usedProcessors > 1) ? usedProcessors - 1 : 0;
+    if (count < 2)
+        count = 2;
+    if (count > NUMBER_OF_CONTRACT_EXECUTION_BUFFERS)
+        count = NUMBER_OF_CONTRACT_EXECUTION_BUFFERS;
+    return (unsigned int)count;
+#endif
+}
+
 static bool initialize()
 {
     enableAVX();
@@ -5833,6 +8070,14 @@ static bool initialize()
         return false;
     }
 #endif
+#ifndef DISABLE_SAMPLING_PROFILER
+    // one ring per entry of processors[] and one for the main processor
+    if (!gSamplingProfiler.init(MAX_NUMBER_OF_PROCESSORS + 1))
+    {
+        logToConsole(L"gSamplingProfiler.init() failed!");
+        return false;
+    }
+#endif
 
     setMem(&tickTicks, sizeof(tickTicks), 0);
 
@@ -5849,6 +8094,14 @@ static bool initialize()
     requestedTickTransactions.header.setSize<sizeof(requestedTickTransactions)>();
     requestedTickTransactions.header.setType(RequestTickTransactions::type());
     requestedTickTransactions.requestedTickTransactions.tick = 0;
+    requestedTickRange.header.setSize<sizeof(requestedTickRange)>();
+    requestedTickRange.header.setType(RequestTickRange::type());
+    requestedTickRange.requestTickRange.flags = RequestTickRange::withTickData | RequestTickRange::withQuorumTicks | RequestTickRange::withTransactions;
+
+    systemInfoResponseCache.reset();
+    activeIPOsResponseCache.reset();
+    for (unsigned int i = 0; i < CONTRACT_IPO_RESPONSE_CACHES; ++i)
+        contractIPOResponseCaches[i].reset();
 
     if (!initFilesystem())
         return false;
@@ -5861,27 +8114,51 @@ static bool initialize()
         if (!pendingTxsPool.init())
             return false;        
 
-        setMem(spectrumChangeFlags, sizeof(spectrumChangeFlags), 0);
+        if (!verifiedTxsCache.init())
+            return false;
+
+#if CONTRACT_FUNCTION_CACHE_SIZE && CONTRACT_FUNCTION_STATE_SNAPSHOTS
+        if (!contractFunctionCache.init())
+            return false;
+#endif
+#if CONTRACT_STATE_CHANGE_TRACKING
+        while (!contractStateChangesStreamId)
+            random64(&contractStateChangesStreamId);
+#endif
 
         if (!initSpectrum())
             return false;
 
-        if (!commonBuffers.init(COMMON_BUFFERS_COUNT))
+        if (!commonBuffers.init(COMMON_BUFFERS_COUNT)
+            || !reorgBuffers.init(REORG_BUFFERS_COUNT, reorgBuffersSize)
+            || !processorScratchpads.init(MAX_NUMBER_OF_PROCESSORS))
             return false;
 
+        parallelJobs.reset();
+        epochTransitionJobs.reset();
+        epochTransitionStats.reset();
+        voteArrivalQueue.reset();
+        tickPhaseStats.reset();
+
         if (!initAssets())
             return false;
 
-        initContractExec();
+        if (!initContractExec(getContractLocalsStackCount()))
+            return false;
+        contractStateDigestTree.init(contractStateDigests, contractStateChangeFlags);
         executionFeeReportCollector.init();
         for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
         {
             unsigned long long size = contractDescriptions[contractIndex].stateSize;
-            if (!allocPoolWithErrorLog(L"contractStates",  size, (void**)&contractStates[contractIndex], __LINE__))
+            if (!allocLargeWithErrorLog(L"contractStates",  size, (void**)&contractStates[contractIndex], __LINE__))
             {
                 return false;
             }
         }
+        initContractStateLeafCaches();
+#if CONTRACT_FUNCTION_STATE_SNAPSHOTS
+        initContractStateSnapshots();
+#endif
 
         if (!allocPoolWithErrorLog(L"score", sizeof(*score), (void**)&score, __LINE__))
         {
@@ -5896,10 +8173,16 @@ static bool initialize()
         setMem(score_qpi, sizeof(*score_qpi), 0);
 
         setMem(&solutionThreshold[0][0], sizeof(int) * MAX_NUMBER_EPOCH * score_engine::AlgoType::MaxAlgoCount, 0);
-        if (!allocPoolWithErrorLog(L"minserSolutionFlag", NUMBER_OF_MINER_SOLUTION_FLAGS / 8, (void**)&minerSolutionFlags, __LINE__))
+        if (!minerSolutionFlags.init())
+        {
+            return false;
+        }
+
+        if (!allocPoolWithErrorLog(L"computorVerificationKeys", NUMBER_OF_COMPUTORS * sizeof(ComputorVerificationKey), (void**)&computorVerificationKeys, __LINE__))
         {
             return false;
         }
+        setMem(computorVerificationKeys, NUMBER_OF_COMPUTORS * sizeof(ComputorVerificationKey), 0);
 
         if (!logger.initLogging())
         {
@@ -5911,7 +8194,7 @@ static bool initialize()
             logToConsole(L"initOracleInterfaces() failed! Not all interfaces are properly defined!");
             return false;
         }
-        if (!oracleEngine.init(computorPublicKeys))
+        if (!oracleEngine.init(computorPublicKeys) || !oracleMachineChannel.init())
             return false;
 
 #if ADDON_TX_STATUS_REQUEST
@@ -5953,7 +8236,7 @@ static bool initialize()
 #if TICK_STORAGE_AUTOSAVE_MODE
         bool canLoadFromFile = loadAllNodeStates();
 
-        // loading might have changed system.tick, so restart pendingTxsPool 
+        // loading might have changed system.tick, so restart pendingTxsPool (keeping loaded txs of later ticks)
         pendingTxsPool.beginEpoch(system.tick);
 #else
         bool canLoadFromFile = false;
@@ -5972,36 +8255,19 @@ static bool initialize()
             etalonTick.month = system.initialMonth;
             etalonTick.year = system.initialYear;
 
-            loadSpectrum();
-
-#ifdef INCLUDE_CONTRACT_TEST_EXAMPLES
-            increaseEnergy(id(TESTEXC_CONTRACT_INDEX, 0, 0, 0), 100000000llu);
-#endif
-
             {
                 const unsigned long long beginningTick = __rdtsc();
 
-                // compute spectrum digest
-                unsigned int digestIndex;
-                for (digestIndex = 0; digestIndex < SPECTRUM_CAPACITY; digestIndex++)
-                {
-                    KangarooTwelve64To32(&spectrum[digestIndex], &spectrumDigests[digestIndex]);
-                }
-                unsigned int previousLevelBeginning = 0;
-                unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
-                while (numberOfLeafs > 1)
-                {
-                    for (unsigned int i = 0; i < numberOfLeafs; i += 2)
-                    {
-                        KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[digestIndex++]);
-                    }
+                // load spectrum and compute spectrum digests while loading
+                loadSpectrum(SPECTRUM_FILE_NAME, nullptr, /*computeDigests=*/true);
 
-                    previousLevelBeginning += numberOfLeafs;
-                    numberOfLeafs >>= 1;
-                }
+#ifdef INCLUDE_CONTRACT_TEST_EXAMPLES
+                increaseEnergy(id(TESTEXC_CONTRACT_INDEX, 0, 0, 0), 100000000llu);
+                updateSpectrumDigests();
+#endif
 
                 setNumber(message, SPECTRUM_CAPACITY * sizeof(EntityRecord), TRUE);
-                appendText(message, L" bytes of the spectrum data are hashed (");
+                appendText(message, L" bytes of the spectrum data are loaded and hashed (");
                 appendNumber(message, (__rdtsc() - beginningTick) * 1000000 / frequency, TRUE);
                 appendText(message, L" microseconds).");
                 logToConsole(message);
@@ -6019,7 +8285,7 @@ static bool initialize()
                 logToConsole(message);
             }
             logToConsole(L"Loading universe file ...");
-            if (!loadUniverse())
+            if (!loadUniverse(UNIVERSE_FILE_NAME, NULL, /*computeDigests=*/true))
                 return false;
             m256i universeDigest;
             {
@@ -6082,31 +8348,39 @@ static bool initialize()
     loadCustomMiningCache(system.epoch);
 
     logToConsole(L"Allocating buffers ...");
-    if ((!allocPoolWithErrorLog(L"dejavu0", 536870912, (void**)&dejavu0, __LINE__)) ||
-        (!allocPoolWithErrorLog(L"dejavu1", 536870912, (void**)&dejavu1, __LINE__)))
+    if (!dejavuFilter.init(DEJAVU_WINDOW_SECONDS))
     {
         return false;
     }
-    setMem((void*)dejavu0, 536870912, 0);
-    setMem((void*)dejavu1, 536870912, 0);
 
     if ((!allocPoolWithErrorLog(L"requestQueueBuffer", REQUEST_QUEUE_BUFFER_SIZE, (void**)&requestQueueBuffer, __LINE__)) ||
         (!allocPoolWithErrorLog(L"respondQueueBuffer", RESPONSE_QUEUE_BUFFER_SIZE, (void**)&responseQueueBuffer, __LINE__)))
     {
         return false;
     }
+    initRequestQueues();
+
+    for (unsigned int i = 0; i < NUMBER_OF_PEER_LARGE_BUFFERS; i++)
+    {
+        if (!allocPoolWithErrorLog(L"peerLargeBuffer", BUFFER_SIZE, &peerLargeBuffers[i], __LINE__))
+        {
+            return false;
+        }
+        numberOfFreePeerLargeBuffers++;
+    }
 
     for (unsigned int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS; i++)
     {
         peers[i].receiveData.FragmentCount = 1;
         peers[i].transmitData.FragmentCount = 1;
 
-        if ((!allocPoolWithErrorLog(L"receiveBuffer", BUFFER_SIZE, &peers[i].receiveBuffer, __LINE__))  ||
-            (!allocPoolWithErrorLog(L"FragmentBuffer", BUFFER_SIZE, &peers[i].transmitData.FragmentTable[0].FragmentBuffer, __LINE__)) ||
-            (!allocPoolWithErrorLog(L"dataToTransmit", BUFFER_SIZE, (void**)&peers[i].dataToTransmit, __LINE__)))
+        if ((!allocPoolWithErrorLog(L"receiveBuffer", PEER_SMALL_BUFFER_SIZE, &peers[i].smallBuffers[0], __LINE__)) ||
+            (!allocPoolWithErrorLog(L"dataToTransmit", PEER_SMALL_BUFFER_SIZE, &peers[i].smallBuffers[1], __LINE__)) ||
+            (!allocPoolWithErrorLog(L"FragmentBuffer", PEER_SMALL_BUFFER_SIZE, &peers[i].smallBuffers[2], __LINE__)))
         {
             return false;
         }
+        peers[i].useSmallBuffers();
 
         if ((status = createEvent(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, emptyCallback, NULL, &peers[i].connectAcceptToken.CompletionToken.Event))
             || (status = createEvent(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, emptyCallback, NULL, &peers[i].receiveToken.CompletionToken.Event))
@@ -6218,6 +8492,9 @@ static void deinitialize()
     deinitAssets();
     deinitSpectrum();
     commonBuffers.deinit();
+    reorgBuffers.deinit();
+    processorScratchpads.deinit();
+    gSamplingProfiler.deinit();
 
     logger.deinitLogging();
 
@@ -6228,37 +8505,37 @@ static void deinitialize()
 #endif
 
     oracleEngine.deinit();
+    oracleMachineChannel.deinit();
 
     deinitContractExec();
+    deinitContractStateLeafCaches();
     for (unsigned int contractIndex = 0; contractIndex < contractCount; contractIndex++)
     {
         if (contractStates[contractIndex])
         {
-            freePool(contractStates[contractIndex]);
+            freeLarge(contractStates[contractIndex], contractDescriptions[contractIndex].stateSize);
         }
     }
 
     ts.deinit();
 
     pendingTxsPool.deinit();
+    verifiedTxsCache.deinit();
+#if CONTRACT_FUNCTION_CACHE_SIZE && CONTRACT_FUNCTION_STATE_SNAPSHOTS
+    contractFunctionCache.deinit();
+#endif
 
     if (score)
     {
         freePool(score);
     }
-    if (minerSolutionFlags)
+    minerSolutionFlags.deinit();
+    if (computorVerificationKeys)
     {
-        freePool(minerSolutionFlags);
+        freePool(computorVerificationKeys);
     }
 
-    if (dejavu0)
-    {
-        freePool((void*)dejavu0);
-    }
-    if (dejavu1)
-    {
-        freePool((void*)dejavu1);
-    }
+    dejavuFilter.deinit();
 
     if (requestQueueBuffer)
     {
@@ -6279,23 +8556,31 @@ static void deinitialize()
 
     for (unsigned int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS; i++)
     {
-        if (peers[i].receiveBuffer)
+        if (peers[i].smallBuffers[2])
+        {
+            peers[i].useSmallBuffers();
+        }
+        if (peers[i].smallBuffers[0])
         {
-            freePool(peers[i].receiveBuffer);
+            freePool(peers[i].smallBuffers[0]);
         }
-        if (peers[i].transmitData.FragmentTable[0].FragmentBuffer)
+        if (peers[i].smallBuffers[1])
         {
-            freePool(peers[i].transmitData.FragmentTable[0].FragmentBuffer);
+            freePool(peers[i].smallBuffers[1]);
         }
-        if (peers[i].dataToTransmit)
+        if (peers[i].smallBuffers[2])
         {
-            freePool(peers[i].dataToTransmit);
+            freePool(peers[i].smallBuffers[2]);
 
             closeEvent(peers[i].connectAcceptToken.CompletionToken.Event);
             closeEvent(peers[i].receiveToken.CompletionToken.Event);
             closeEvent(peers[i].transmitToken.CompletionToken.Event);
         }
     }
+    while (numberOfFreePeerLargeBuffers)
+    {
+        freePool(acquirePeerLargeBuffer());
+    }
 
     customMiningDeinitialize();
 }
@@ -6341,6 +8626,8 @@ static void logInfo()
     appendNumber(message, numberOfDuplicateRequests - prevNumberOfDuplicateRequests, TRUE);
     appendText(message, L" /");
     appendNumber(message, numberOfDisseminatedRequests - prevNumberOfDisseminatedRequests, TRUE);
+    appendText(message, L" !");
+    appendNumber(message, numberOfThrottledRequests - prevNumberOfThrottledRequests, TRUE);
     appendText(message, L"] ");
 
     unsigned int numberOfConnectingSlots = 0, numberOfConnectedSlots = 0;
@@ -6382,12 +8669,15 @@ static void logInfo()
     appendNumber(message, score->scoreCache.collisionCount(), TRUE);
     appendText(message, L" | Miss ");
     appendNumber(message, score->scoreCache.missCount(), TRUE);
+    appendText(message, L" | Eviction ");
+    appendNumber(message, score->scoreCache.evictionCount(), TRUE);
 #endif
     logToConsole(message);
     prevNumberOfProcessedRequests = numberOfProcessedRequests;
     prevNumberOfDiscardedRequests = numberOfDiscardedRequests;
     prevNumberOfDuplicateRequests = numberOfDuplicateRequests;
     prevNumberOfDisseminatedRequests = numberOfDisseminatedRequests;
+    prevNumberOfThrottledRequests = numberOfThrottledRequests;
     prevNumberOfReceivedBytes = numberOfReceivedBytes;
     prevNumberOfTransmittedBytes = numberOfTransmittedBytes;
 
@@ -6480,9 +8770,14 @@ static void logInfo()
     appendText(message, L" pending transactions.");
     logToConsole(message);
 
-    unsigned int filledRequestQueueBufferSize = (requestQueueBufferHead >= requestQueueBufferTail) ? (requestQueueBufferHead - requestQueueBufferTail) : (REQUEST_QUEUE_BUFFER_SIZE - (requestQueueBufferTail - requestQueueBufferHead));
+    unsigned int filledRequestQueueBufferSize = 0, filledRequestQueueLength = 0;
+    for (unsigned int queueType = 0; queueType < NUMBER_OF_REQUEST_QUEUES; queueType++)
+    {
+        const RequestQueue& queue = requestQueues[queueType];
+        filledRequestQueueBufferSize += (queue.bufferHead >= queue.bufferTail) ? (queue.bufferHead - queue.bufferTail) : (requestQueueBufferSizes[queueType] - (queue.bufferTail - queue.bufferHead));
+        filledRequestQueueLength += (unsigned short)(queue.elementHead - queue.elementTail);
+    }
     unsigned int filledResponseQueueBufferSize = (responseQueueBufferHead >= responseQueueBufferTail) ? (responseQueueBufferHead - responseQueueBufferTail) : (RESPONSE_QUEUE_BUFFER_SIZE - (responseQueueBufferTail - responseQueueBufferHead));
-    unsigned int filledRequestQueueLength = (requestQueueElementHead >= requestQueueElementTail) ? (requestQueueElementHead - requestQueueElementTail) : (REQUEST_QUEUE_LENGTH - (requestQueueElementTail - requestQueueElementHead));
     unsigned int filledResponseQueueLength = (responseQueueElementHead >= responseQueueElementTail) ? (responseQueueElementHead - responseQueueElementTail) : (RESPONSE_QUEUE_LENGTH - (responseQueueElementTail - responseQueueElementHead));
     setNumber(message, filledRequestQueueBufferSize, TRUE);
     appendText(message, L" (");
@@ -6509,6 +8804,62 @@ static void logInfo()
     appendText(message, L" ms.");
     logToConsole(message);
 
+    // Log p50/p99/max of tick processor phases over the last ticks
+    RespondTickPhaseStats phaseStats;
+    tickPhaseStats.getStats(phaseStats);
+    const CHAR16* phaseNames[TICK_PHASE_COUNT] = { L"Tick data", L"Digests", L"Execution", L"END_TICK", L"Votes", L"Quorum", L"Total" };
+    setText(message, L"Tick phases (p50/p99/max ms):");
+    for (unsigned int i = 0; i < TICK_PHASE_COUNT; i++)
+    {
+        appendText(message, (i == 0) ? L" " : L" | ");
+        appendText(message, phaseNames[i]);
+        appendText(message, L" ");
+        appendNumber(message, phaseStats.phases[i].p50 / 1000, FALSE);
+        appendText(message, L"/");
+        appendNumber(message, phaseStats.phases[i].p99 / 1000, FALSE);
+        appendText(message, L"/");
+        appendNumber(message, phaseStats.phases[i].max / 1000, FALSE);
+    }
+    appendText(message, L".");
+    logToConsole(message);
+
+    // Log durations of the phases of the last epoch transition
+    if (epochTransitionStats.getPhaseTicks(EPOCH_TRANSITION_PHASE_TOTAL))
+    {
+        const CHAR16* transitionPhaseNames[EPOCH_TRANSITION_PHASE_COUNT] = { L"Parking", L"END_EPOCH", L"IPOs", L"Revenue",
+            L"Spectrum", L"Universe", L"Save revenue", L"Computor index", L"Save system", L"Tick storage", L"Pending txs",
+            L"Score", L"Logging", L"Save files", L"Total" };
+        setText(message, L"Last epoch transition (ms):");
+        for (unsigned int i = 0; i < EPOCH_TRANSITION_PHASE_COUNT; i++)
+        {
+            appendText(message, (i == 0) ? L" " : L" | ");
+            appendText(message, transitionPhaseNames[i]);
+            appendText(message, L" ");
+            appendNumber(message, epochTransitionStats.getPhaseTicks((EpochTransitionPhase)i) * 1000 / frequency, TRUE);
+        }
+        appendText(message, L".");
+        logToConsole(message);
+    }
+
+    // Log acquisitions/contended acquisitions/waiting time of hot locks since start
+    RespondLockStats lockStats;
+    getLockStats(lockStats);
+    const CHAR16* lockNames[LOCK_STATS_COUNT] = { L"Spectrum", L"Universe", L"PendingTxs", L"ResponseQueue" };
+    setText(message, L"Locks (acquired/contended/wait ms):");
+    for (unsigned int i = 0; i < LOCK_STATS_COUNT; i++)
+    {
+        appendText(message, (i == 0) ? L" " : L" | ");
+        appendText(message, lockNames[i]);
+        appendText(message, L" ");
+        appendNumber(message, lockStats.locks[i].acquisitionCount, TRUE);
+        appendText(message, L"/");
+        appendNumber(message, lockStats.locks[i].contendedAcquisitionCount, TRUE);
+        appendText(message, L"/");
+        appendNumber(message, lockStats.locks[i].spinCycles / (frequency / 1000), TRUE);
+    }
+    appendText(message, L".");
+    logToConsole(message);
+
     // Log infomation about custom mining
     setText(message, L"CustomMining: ");
 
@@ -6538,6 +8889,24 @@ static void logInfo()
     logToConsole(message);
 
     oracleEngine.logStatus();
+
+    const OracleMachineChannel::Statistics& omChannelStats = oracleMachineChannel.getStatistics();
+    setText(message, L"OM channel: waiting for reply ");
+    appendNumber(message, oracleMachineChannel.getActiveCount(), FALSE);
+    appendText(message, L", frames sent ");
+    appendNumber(message, omChannelStats.framesSent, FALSE);
+    appendText(message, L", queries sent ");
+    appendNumber(message, omChannelStats.queriesSent, FALSE);
+    appendText(message, L" (resent ");
+    appendNumber(message, omChannelStats.queriesResent, FALSE);
+    appendText(message, L", dropped ");
+    appendNumber(message, omChannelStats.queriesDropped, FALSE);
+    appendText(message, L"), replies ");
+    appendNumber(message, omChannelStats.repliesMatched, FALSE);
+    appendText(message, L" (unmatched ");
+    appendNumber(message, omChannelStats.repliesUnmatched, FALSE);
+    appendText(message, L").");
+    logToConsole(message);
 }
 
 static void logHealthStatus()
@@ -6548,14 +8917,13 @@ static void logHealthStatus()
     logToConsole(message);
 
     // print statuses of thread
-    // this accepts a small error when switching day to first day of the next month
+    const unsigned long long nowMilliseconds = monotonicMilliseconds();
     bool allThreadsAreGood = true;
     setText(message, L"Thread status: ");
     for (int i = 0; i < nTickProcessorIDs; i++)
     {
         unsigned long long tid = tickProcessorIDs[i];
-        long long diffInSecond = 86400 * (utcTime.Day - threadTimeCheckin[tid].day) + 3600 * (utcTime.Hour - threadTimeCheckin[tid].hour)
-            + 60 * (utcTime.Minute - threadTimeCheckin[tid].minute) + (utcTime.Second - threadTimeCheckin[tid].second);
+        long long diffInSecond = (long long)(nowMilliseconds - threadTimeCheckin[tid]) / 1000;
         if (diffInSecond > 120) // if they don't check in in 2 minutes, we can assume the thread is already crashed
         {
             allThreadsAreGood = false;
@@ -6568,8 +8936,7 @@ static void logHealthStatus()
     for (int i = 0; i < nRequestProcessorIDs; i++)
     {
         unsigned long long tid = requestProcessorIDs[i];
-        long long diffInSecond = 86400 * (utcTime.Day - threadTimeCheckin[tid].day) + 3600 * (utcTime.Hour - threadTimeCheckin[tid].hour)
-            + 60 * (utcTime.Minute - threadTimeCheckin[tid].minute) + (utcTime.Second - threadTimeCheckin[tid].second);
+        long long diffInSecond = (long long)(nowMilliseconds - threadTimeCheckin[tid]) / 1000;
         if (diffInSecond > 120) // if they don't check in in 2 minutes, we can assume the thread is already crashed
         {
             allThreadsAreGood = false;
@@ -6584,6 +8951,37 @@ static void logHealthStatus()
     }
     logToConsole(message);
 
+    // Print peers with the highest estimated processing time of query requests since connecting (see isRequestAdmitted())
+    setText(message, L"Top query request peers: ");
+    bool reportedPeer[NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS] = { false };
+    for (unsigned int rank = 0; rank < 3; rank++)
+    {
+        int topPeer = -1;
+        for (unsigned int i = 0; i < NUMBER_OF_OUTGOING_CONNECTIONS + NUMBER_OF_INCOMING_CONNECTIONS; i++)
+        {
+            if (peers[i].tcp4Protocol && !reportedPeer[i] && peers[i].queryRequestBudget.consumedCost
+                && (topPeer < 0 || peers[i].queryRequestBudget.consumedCost > peers[topPeer].queryRequestBudget.consumedCost))
+            {
+                topPeer = i;
+            }
+        }
+        if (topPeer < 0)
+        {
+            break;
+        }
+        reportedPeer[topPeer] = true;
+        const RequestBudget& budget = peers[topPeer].queryRequestBudget;
+        appendIPv4Address(message, peers[topPeer].address);
+        appendText(message, L" ");
+        appendNumber(message, budget.consumedCost * 1000 / frequency, TRUE);
+        appendText(message, L" ms (");
+        appendNumber(message, budget.admittedCount, TRUE);
+        appendText(message, L" admitted, ");
+        appendNumber(message, budget.throttledCount, TRUE);
+        appendText(message, L" throttled) | ");
+    }
+    logToConsole(message);
+
     // Print used function call stack size
     setText(message, L"Function call stack usage: ");
     unsigned int maxStackUsageTick = 0;
@@ -6663,11 +9061,11 @@ static void logHealthStatus()
 
     // Print info about stack buffers used to run contracts
     setText(message, L"Contract stack buffer usage: ");
-    for (int i = 0; i < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS; ++i)
+    for (unsigned int i = 0; i < contractLocalsStackCount; ++i)
     {
         appendText(message, L"buf ");
         appendNumber(message, i, FALSE);
-        if (contractLocalsStackLock[i])
+        if (isContractLocalsStackInUse(i))
             appendText(message, L" (locked)");
         appendText(message, L" current ");
         appendNumber(message, contractLocalsStack[i].size(), TRUE);
@@ -6681,6 +9079,13 @@ static void logHealthStatus()
     }
     appendText(message, L"capacity per buf ");
     appendNumber(message, contractLocalsStack[0].capacity(), TRUE);
+    appendText(message, L" | max entry point peak ");
+    appendNumber(message, (unsigned short)contractLocalsStackPeakMaxKB, TRUE);
+    appendText(message, L" KiB (contract ");
+    appendNumber(message, contractLocalsStackPeakMaxContractIndex, FALSE);
+    appendText(message, L"), headroom ");
+    appendNumber(message, contractLocalsStack[0].capacity() / 1024 - (unsigned short)contractLocalsStackPeakMaxKB, TRUE);
+    appendText(message, L" KiB");
     appendText(message, L" | max processors waiting ");
     appendNumber(message, contractLocalsStackLockWaitingCountMax, TRUE);
     logToConsole(message);
@@ -6689,6 +9094,13 @@ static void logHealthStatus()
     appendNumber(message, commonBuffers.getInvalidReleaseCount(), FALSE);
     appendText(message, L", max waiting processors ");
     appendNumber(message, commonBuffers.getMaxWaitingProcessorCount(), FALSE);
+    appendText(message, L" | Reorg buffers: invalid release ");
+    appendNumber(message, reorgBuffers.getInvalidReleaseCount(), FALSE);
+    appendText(message, L", max waiting processors ");
+    appendNumber(message, reorgBuffers.getMaxWaitingProcessorCount(), FALSE);
+    appendText(message, L" | Max scratch arena usage ");
+    appendNumber(message, processorScratchpads.getMaxArenaUsage(), TRUE);
+    appendText(message, L" bytes");
     logToConsole(message);
 
     setText(message, L"Connections:");
@@ -6720,6 +9132,48 @@ static void logHealthStatus()
     logToConsole(message);
 }
 
+static void logMemoryFootprint()
+{
+    MemoryRegistry::Subsystem subsystems[MemoryRegistry::maxSubsystems];
+    const unsigned int subsystemCount = memoryRegistry.getSubsystems(subsystems, MemoryRegistry::maxSubsystems);
+    unsigned long long totalRequestedBytes = 0, totalCommittedBytes = 0;
+    for (unsigned int i = 0; i < subsystemCount; i++)
+    {
+        if (!subsystems[i].allocationCount)
+            continue;
+        totalRequestedBytes += subsystems[i].requestedBytes;
+        totalCommittedBytes += subsystems[i].committedBytes;
+
+        setText(message, L"Memory ");
+        for (unsigned int j = 0; subsystems[i].name[j]; j++)
+        {
+            const CHAR16 c[2] = { (CHAR16)subsystems[i].name[j], 0 };
+            appendText(message, c);
+        }
+        appendText(message, L": ");
+        appendNumber(message, subsystems[i].committedBytes, TRUE);
+        appendText(message, L" bytes committed (");
+        appendNumber(message, subsystems[i].requestedBytes, TRUE);
+        appendText(message, L" requested, peak ");
+        appendNumber(message, subsystems[i].peakCommittedBytes, TRUE);
+        appendText(message, L") in ");
+        appendNumber(message, subsystems[i].allocationCount, TRUE);
+        appendText(message, L" allocations");
+        logToConsole(message);
+    }
+
+    setText(message, L"Memory total: ");
+    appendNumber(message, totalCommittedBytes, TRUE);
+    appendText(message, L" bytes committed (");
+    appendNumber(message, totalRequestedBytes, TRUE);
+    appendText(message, L" requested) | Untracked allocations: ");
+    appendNumber(message, memoryRegistry.getUntrackedAllocationCount(), TRUE);
+    appendText(message, L" | Free RAM: ");
+    appendNumber(message, GetFreeRAMSize(), TRUE);
+    appendText(message, L" bytes");
+    logToConsole(message);
+}
+
 static void processKeyPresses()
 {
     EFI_INPUT_KEY key;
@@ -6737,6 +9191,12 @@ static void processKeyPresses()
             key.ScanCode = 0x48; // map to pause key; action defined below
             break;
             /*
+            * Prints the memory committed by each subsystem (see MemoryRegistry)
+            */
+        case L'm':
+            logMemoryFootprint();
+            return;
+            /*
             * Just prints QUBIC QUBIC QUBIC QUBIC QUBIC to the screen
             * An example how to use other keys and directly return to not continue with the ScanCode
             * Uncomment it for testing
@@ -7124,6 +9584,7 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
 
     bs->SetWatchdogTimer(0, 0, 0, NULL);
 
+    consoleOutputQueue.init(CONSOLE_OUTPUT_MAX_CHARS_PER_SECOND, CONSOLE_OUTPUT_MAX_CHARS_PER_RENDER);
     initTime();
 
     st->ConOut->ClearScreen(st->ConOut);
@@ -7165,60 +9626,96 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
             solutionProcessorFlags[i] = false;
         }
 
-        for (unsigned int i = 0; i < numberOfAllProcessors && numberOfProcessors < MAX_NUMBER_OF_PROCESSORS; i++)
+        // Discover topology (package / core / SMT thread) of the enabled APs and order them, so that the tick and
+        // contract processor run on distinct cores of the package of the main processor (see processor_topology.h).
+        // Only APs with index < MAX_NUMBER_OF_PROCESSORS are considered, because the index is used for per-processor arrays.
+        static ProcessorLocation processorLocations[maxNumberOfOrderedProcessors];
+        static unsigned int processorIndices[maxNumberOfOrderedProcessors];
+        static unsigned int processorOrder[maxNumberOfOrderedProcessors];
+        unsigned int numberOfUsableProcessors = 0;
+        unsigned int mainPackage = 0;
+        for (unsigned int i = 0; i < numberOfAllProcessors; i++)
         {
             EFI_PROCESSOR_INFORMATION processorInformation;
             mpServicesProtocol->GetProcessorInfo(mpServicesProtocol, i, &processorInformation);
-            if (processorInformation.StatusFlag == (PROCESSOR_ENABLED_BIT | PROCESSOR_HEALTH_STATUS_BIT))
+            if (i == mainThreadProcessorID)
             {
-                if (!allocPoolWithErrorLog(L"processor[i]", BUFFER_SIZE, &processors[numberOfProcessors].buffer, __LINE__))
-                {
-                    numberOfProcessors = 0;
+                mainPackage = processorInformation.Location.Package;
+            }
+            if (processorInformation.StatusFlag == (PROCESSOR_ENABLED_BIT | PROCESSOR_HEALTH_STATUS_BIT)
+                && i < MAX_NUMBER_OF_PROCESSORS && numberOfUsableProcessors < maxNumberOfOrderedProcessors)
+            {
+                processorLocations[numberOfUsableProcessors].package = processorInformation.Location.Package;
+                processorLocations[numberOfUsableProcessors].core = processorInformation.Location.Core;
+                processorLocations[numberOfUsableProcessors].thread = processorInformation.Location.Thread;
+                processorIndices[numberOfUsableProcessors] = i;
+                numberOfUsableProcessors++;
+            }
+        }
+        const unsigned int numberOfOrderedProcessors = orderProcessorsByTopology(processorLocations, numberOfUsableProcessors, mainPackage,
+            processorOrder, IDLE_SMT_SIBLINGS_OF_TICK_PROCESSORS);
 
-                    break;
-                }
-                if (!processors[numberOfProcessors].alloc(STACK_SIZE))
+        for (unsigned int k = 0; k < numberOfOrderedProcessors && numberOfProcessors < MAX_NUMBER_OF_PROCESSORS; k++)
+        {
+            const unsigned int i = processorIndices[processorOrder[k]];
+            if (!allocPoolWithErrorLog(L"processor[i]", BUFFER_SIZE, &processors[numberOfProcessors].buffer, __LINE__))
+            {
+                numberOfProcessors = 0;
+
+                break;
+            }
+            if (!processors[numberOfProcessors].alloc(STACK_SIZE))
+            {
+                logToConsole(L"Failed to allocate stack for processor!");
+                numberOfProcessors = 0;
+                break;
+            }
+            processorScratchpads.setStack(numberOfProcessors, processors[numberOfProcessors].getStackBottom(), processors[numberOfProcessors].getStackTop());
+            gSamplingProfiler.setStack(numberOfProcessors, processors[numberOfProcessors].getStackBottom(), processors[numberOfProcessors].getStackTop());
+
+            if (numberOfProcessors == 2)
+            {
+                processors[numberOfProcessors].type = Processor::ContractProcessor;
+                processors[numberOfProcessors].setupFunction(contractProcessor, 0);
+                computingProcessorNumber = numberOfProcessors;
+                contractProcessorIDs[nContractProcessorIDs++] = i;
+            }
+            else
+            {
+                if (numberOfProcessors == 1)
                 {
-                    logToConsole(L"Failed to allocate stack for processor!");
-                    numberOfProcessors = 0;
-                    break;
+                    processors[numberOfProcessors].type = Processor::TickProcessor;
+                    processors[numberOfProcessors].setupFunction(tickProcessor, &processors[numberOfProcessors]);
+                    tickProcessorIDs[nTickProcessorIDs++] = i;
                 }
-
-                if (numberOfProcessors == 2)
+                else if (numberOfProcessors < 3 + NUMBER_OF_TICK_HOOK_HELPER_PROCESSORS
+                    && numberOfOrderedProcessors + 1 >= 6 + NUMBER_OF_TICK_HOOK_HELPER_PROCESSORS)
                 {
+                    // only if at least 2 request processors remain
                     processors[numberOfProcessors].type = Processor::ContractProcessor;
-                    processors[numberOfProcessors].setupFunction(contractProcessor, 0);
-                    computingProcessorNumber = numberOfProcessors;
+                    processors[numberOfProcessors].setupFunction(tickHookHelperProcessor, 0);
                     contractProcessorIDs[nContractProcessorIDs++] = i;
                 }
                 else
                 {
-                    if (numberOfProcessors == 1)
-                    {
-                        processors[numberOfProcessors].type = Processor::TickProcessor;
-                        processors[numberOfProcessors].setupFunction(tickProcessor, &processors[numberOfProcessors]);
-                        tickProcessorIDs[nTickProcessorIDs++] = i;
-                    }
-                    else
-                    {
-                        processors[numberOfProcessors].type = Processor::RequestProcessor;
-                        processors[numberOfProcessors].setupFunction(requestProcessor, &processors[numberOfProcessors]);
-                        requestProcessorIDs[nRequestProcessorIDs++] = i;
-                    }
+                    processors[numberOfProcessors].type = Processor::RequestProcessor;
+                    processors[numberOfProcessors].setupFunction(requestProcessor, &processors[numberOfProcessors]);
+                    requestProcessorIDs[nRequestProcessorIDs++] = i;
+                }
 
-                    createEvent(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, shutdownCallback, NULL, &processors[numberOfProcessors].event);
-                    mpServicesProtocol->StartupThisAP(mpServicesProtocol, Processor::runFunction, i, processors[numberOfProcessors].event, 0, &processors[numberOfProcessors], NULL);
+                createEvent(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, shutdownCallback, NULL, &processors[numberOfProcessors].event);
+                mpServicesProtocol->StartupThisAP(mpServicesProtocol, Processor::runFunction, i, processors[numberOfProcessors].event, 0, &processors[numberOfProcessors], NULL);
 
-                    if (!solutionProcessorFlags[i % NUMBER_OF_SOLUTION_PROCESSORS]
-                        && !solutionProcessorFlags[i])
-                    {
-                        solutionProcessorFlags[i % NUMBER_OF_SOLUTION_PROCESSORS] = true;
-                        solutionProcessorFlags[i] = true;
-                        solutionProcessorIDs[nSolutionProcessorIDs++] = i;
-                    }
+                if (processors[numberOfProcessors].type != Processor::ContractProcessor
+                    && !solutionProcessorFlags[i % NUMBER_OF_SOLUTION_PROCESSORS]
+                    && !solutionProcessorFlags[i])
+                {
+                    solutionProcessorFlags[i % NUMBER_OF_SOLUTION_PROCESSORS] = true;
+                    solutionProcessorFlags[i] = true;
+                    solutionProcessorIDs[nSolutionProcessorIDs++] = i;
                 }
-                numberOfProcessors++;
             }
+            numberOfProcessors++;
         }
         if (numberOfProcessors < 3)
         {
@@ -7236,6 +9733,12 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
             appendNumber(message, mainThreadProcessorID, false);
             logToConsole(message);
 
+            setText(message, L"Main package: #");
+            appendNumber(message, mainPackage, false);
+            appendText(message, L" | SMT siblings left idle: ");
+            appendNumber(message, numberOfUsableProcessors - numberOfOrderedProcessors, false);
+            logToConsole(message);
+
             setText(message, L"Tick processors: ");
             for (int i = 0; i < nTickProcessorIDs; i++)
             {
@@ -7245,6 +9748,15 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
             }
             logToConsole(message);
 
+            setText(message, L"Contract processors: ");
+            for (int i = 0; i < nContractProcessorIDs; i++)
+            {
+                appendText(message, L"Processor #");
+                appendNumber(message, contractProcessorIDs[i], false);
+                if (i != nContractProcessorIDs - 1) appendText(message, L" | ");
+            }
+            logToConsole(message);
+
             setText(message, L"Request processors: ");
             for (int i = 0; i < nRequestProcessorIDs; i++)
             {
@@ -7279,6 +9791,7 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
 #endif
             
             unsigned long long clockTick = 0, systemDataSavingTick = 0, loggingTick = 0, peerRefreshingTick = 0, tickRequestingTick = 0;
+            unsigned long long samplingProfilerAggregationTick = 0;
             unsigned int tickRequestingIndicator = 0, futureTickRequestingIndicator = 0;
             autoResendTickVotes.lastTick = system.initialTick;
             autoResendTickVotes.lastCheck = __rdtsc();
@@ -7535,11 +10048,38 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                         pushToAnyFullNode(&requestedTickData.header);
                     }
 
+                    if (isNewTick && getLatestTickVoteOfThirdOfComputors() > system.tick + TICK_RANGE_SYNC_MIN_LAG)
+                    {
+                        // Far behind the quorum (such as after restart) -> request all data of the next ticks at once
+                        // instead of tick by tick. Incoming votes are verified by all request processors in parallel.
+                        // Each tick is only requested once: the next range is requested when half of the last one has
+                        // been processed (ranges that got lost are covered by the tick by tick requests).
+                        if (tickRangeSyncRequestedEnd < system.tick || tickRangeSyncRequestedEnd > system.tick + 2 * RequestTickRange::maxNumberOfTicks)
+                        {
+                            tickRangeSyncRequestedEnd = system.tick;
+                        }
+                        if (tickRangeSyncRequestedEnd <= system.tick + RequestTickRange::maxNumberOfTicks / 2)
+                        {
+                            const unsigned int firstTick = tickRangeSyncRequestedEnd;
+                            unsigned int numberOfTicks = RequestTickRange::maxNumberOfTicks;
+                            while (numberOfTicks > 0 && !ts.tickInCurrentEpochStorage(firstTick + numberOfTicks - 1))
+                            {
+                                numberOfTicks--;
+                            }
+                            if (numberOfTicks)
+                            {
+                                requestedTickRange.header.randomizeDejavu();
+                                requestedTickRange.requestTickRange.firstTick = firstTick;
+                                requestedTickRange.requestTickRange.numberOfTicks = (unsigned short)numberOfTicks;
+                                pushToAnyFullNode(&requestedTickRange.header);
+                                tickRangeSyncRequestedEnd = firstTick + numberOfTicks;
+                            }
+                        }
+                    }
+
                     if (requestedTickTransactions.requestedTickTransactions.tick)
                     {
-                        requestedTickTransactions.header.randomizeDejavu();
-                        pushToAny(&requestedTickTransactions.header);
-                        pushToAnyFullNode(&requestedTickTransactions.header);
+                        pushRequestedTickTransactions();
 
                         requestedTickTransactions.requestedTickTransactions.tick = 0;
                     }
@@ -7549,22 +10089,27 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                 const unsigned short responseQueueElementHead = ::responseQueueElementHead;
                 if (responseQueueElementTail != responseQueueElementHead)
                 {
-                    while (responseQueueElementTail != responseQueueElementHead)
+                    while (responseQueueElementTail != responseQueueElementHead && !responseQueueElements[responseQueueElementTail].isReserved)
                     {
                         RequestResponseHeader* responseHeader = (RequestResponseHeader*)&responseQueueBuffer[responseQueueElements[responseQueueElementTail].offset];
-                        if (responseQueueElements[responseQueueElementTail].peer == 0)
+                        if (responseQueueElements[responseQueueElementTail].isCanceled)
+                        {
+                            // reservation given up with cancelResponse(), nothing to send
+                        }
+                        else if (responseQueueElements[responseQueueElementTail].peer == 0)
                         {
                             pushToSeveral(responseHeader);
                         }
                         else if (responseQueueElements[responseQueueElementTail].peer == (Peer*)1)
                         {
-                            pushToOracleMachineNodes(responseHeader);
+                            // oracle machine query, sent by pushToOracleMachineNodes() below
+                            oracleMachineChannel.enqueueQuery(responseHeader->getPayload<OracleMachineQuery>(), responseHeader->getPayloadSize(), __rdtsc(), frequency);
                         }
                         else
                         {
                             push(responseQueueElements[responseQueueElementTail].peer, responseHeader);
                         }
-                        responseQueueBufferTail += responseHeader->size();
+                        responseQueueBufferTail = responseQueueElements[responseQueueElementTail].offset + responseQueueElements[responseQueueElementTail].size;
                         if (responseQueueBufferTail > RESPONSE_QUEUE_BUFFER_SIZE - BUFFER_SIZE)
                         {
                             responseQueueBufferTail = 0;
@@ -7573,28 +10118,33 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                         responseQueueElementTail++;
                     }
                 }
+                pushToOracleMachineNodes();
 
                 if (systemMustBeSaved)
                 {
                     systemDataSavingTick = curTimeTick; // set last save tick to avoid overwrite in main loop
                     saveSystem();
                     systemMustBeSaved = false;
+                    peersReceiveAndTransmit(salt);
                 }
                 if (spectrumMustBeSaved)
                 {
                     saveSpectrum();
                     spectrumMustBeSaved = false;
+                    peersReceiveAndTransmit(salt);
                 }
                 if (universeMustBeSaved)
                 {
                     saveUniverse();
                     universeMustBeSaved = false;
+                    peersReceiveAndTransmit(salt);
                 }
                 if (computerMustBeSaved)
                 {
                     saveContractStateFiles();
                     saveContractExecFeeFiles();
                     computerMustBeSaved = false;
+                    peersReceiveAndTransmit(salt);
                 }
 
                 if (forceRefreshPeerList)
@@ -7603,6 +10153,13 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                     closeAllPeers();
                 }
 
+                // Aggregate events of sampling profiler 10 times per second, so the ring buffers don't overflow
+                if (curTimeTick - samplingProfilerAggregationTick >= frequency / 10)
+                {
+                    samplingProfilerAggregationTick = curTimeTick;
+                    gSamplingProfiler.aggregate();
+                }
+
                 processKeyPresses();
 
 #if TICK_STORAGE_AUTOSAVE_MODE
@@ -7642,11 +10199,19 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                     closeAllPeers(true);
 
                     logToConsole(L"Saving node state...");
-                    saveAllNodeStates();
+                    const unsigned short savedEpoch = system.epoch;
+                    const unsigned int savedTick = system.tick;
+                    const bool savedNodeStates = saveAllNodeStates();
+
+                    // Tick storage can be saved while the tick processor is running
+                    ATOMIC_STORE32(requestPersistingNodeState, 0);
+                    if (savedNodeStates)
+                    {
+                        saveAllNodeStatesTickStorage(savedEpoch, savedTick);
+                    }
 #ifdef ENABLE_PROFILING
                     gProfilingDataCollector.writeToFile();
 #endif
-                    ATOMIC_STORE32(requestPersistingNodeState, 0);
                     logToConsole(L"Complete saving all node states");
                 }
 #if TICK_STORAGE_AUTOSAVE_MODE == 1
@@ -7663,6 +10228,9 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                 {
                     loggingTick = curTimeTick;
 
+                    // queue status output instead of blocking the main loop (written by consoleOutputQueue.render() below)
+                    deferConsoleOutput = true;
+
                     logInfo();
 
                     if (mainLoopDenominator)
@@ -7726,6 +10294,11 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
                         logHealthStatus();
                     }
 #endif
+
+                    deferConsoleOutput = false;
+
+                    // console output may be slow, so poll network again before continuing with the loop
+                    peersReceiveAndTransmit(salt);
                 }
                 else
                 {
@@ -7735,6 +10308,9 @@ EFI_STATUS efi_main(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable)
 
 #if !defined(NDEBUG)
                 printDebugMessages();
+#endif
+#if CONSOLE_OUTPUT_MAX_CHARS_PER_SECOND
+                consoleOutputQueue.render(__rdtsc(), frequency);
 #endif
                 // Flush the file system. Only flush one item at a time to avoid the main loop stay too long
                 // Even if the time is not satisfied, when still flush at least some items to make sure the save/load not stuck forever
@@ -38,6 +38,12 @@ struct ScoreFunction
     unsigned char externalPoolVec[score_engine::POOL_VEC_PADDING_SIZE];
     unsigned char poolVec[score_engine::POOL_VEC_PADDING_SIZE];
 
+    // Seeds that externalPoolVec and poolVec have been generated from (zero if not generated yet). Each pool block
+    // is the Keccak permutation of the previous block, so generation is inherently serial and is only done when
+    // the seed actually changes.
+    m256i externalPoolSeed;
+    m256i poolSeed;
+
     void initPool(const unsigned char* miningSeed)
     {
         // Init random2 pool with mining seed
@@ -55,17 +61,27 @@ struct ScoreFunction
 
     void initMiningData(m256i randomSeed)
     {
-        // Below assume when a new mining seed is provided, we need to re-calculate the random2 pool
-        // Check if random pool need to be re-generated
-        if (!isZero(randomSeed))
+        // speculative tasks must not run while the pool changes, queued ones are for the old seed
+        pauseSpeculativeTasks();
+
+        // Re-calculate the random2 pool only if a new mining seed is provided. A zero seed (no qubic mining phase)
+        // keeps the pool of the last seed.
+        if (!isZero(randomSeed) && randomSeed != externalPoolSeed)
         {
             initPool(randomSeed.m256i_u8);
+            externalPoolSeed = randomSeed;
         }
         currentRandomSeed = randomSeed; // persist the initial random seed to be able to send it back on system info response
 
-        ACQUIRE(random2PoolLock);
-        copyMem(poolVec, externalPoolVec, score_engine::POOL_VEC_PADDING_SIZE);
-        RELEASE(random2PoolLock);
+        if (poolSeed != externalPoolSeed)
+        {
+            ACQUIRE(random2PoolLock);
+            copyMem(poolVec, externalPoolVec, score_engine::POOL_VEC_PADDING_SIZE);
+            poolSeed = externalPoolSeed;
+            RELEASE(random2PoolLock);
+        }
+
+        resumeSpeculativeTasks();
     }
 
     ~ScoreFunction()
@@ -80,6 +96,8 @@ struct ScoreFunction
     bool initMemory()
     {
         random2PoolLock = 0;
+        externalPoolSeed = m256i::zero();
+        poolSeed = m256i::zero();
 
         // Make sure all padding data is set as zeros
         setMem(_computeBuffer, sizeof(_computeBuffer), 0);
@@ -98,6 +116,15 @@ struct ScoreFunction
         setMem(&scoreCache, sizeof(scoreCache), 0);
 #endif
 
+#if USE_SCORE_CACHE && SPECULATIVE_SCORE_QUEUE_SIZE
+        // enabled by initMiningData()
+        speculativeTaskQueueLock = 0;
+        _nSpeculativeTaskBegin = 0;
+        _nSpeculativeTask = 0;
+        _nSpeculativeProcessing = 0;
+        _speculativeTaskQueueEnabled = false;
+#endif
+
         return true;
     }
 
@@ -155,6 +182,25 @@ struct ScoreFunction
         return _computeBuffer[solutionBufIdx].computeScore(publicKey.m256i_u8, nonce.m256i_u8, poolVec);
     }
 
+    // Lock a free compute buffer, preferring the one of the processor. Processors computing scores at the same time
+    // only wait if all buffers are in use.
+    unsigned long long acquireComputeBuffer(const unsigned long long processor_Number)
+    {
+        const unsigned long long preferredIdx = processor_Number % solutionBufferCount;
+        while (true)
+        {
+            for (unsigned long long i = 0; i < solutionBufferCount; i++)
+            {
+                const unsigned long long idx = (preferredIdx + i) % solutionBufferCount;
+                if (TRY_ACQUIRE(solutionEngineLock[idx]))
+                {
+                    return idx;
+                }
+            }
+            _mm_pause();
+        }
+    }
+
     m256i getLastOutput(const unsigned long long processor_Number)
     {
         ACQUIRE(solutionEngineLock[processor_Number]);
@@ -185,8 +231,7 @@ struct ScoreFunction
         score = 0;
 #endif
 
-        const int solutionBufIdx = (int)(processor_Number % solutionBufferCount);
-        ACQUIRE(solutionEngineLock[solutionBufIdx]);
+        const unsigned long long solutionBufIdx = acquireComputeBuffer(processor_Number);
 
         score = computeScore(solutionBufIdx, publicKey, nonce);
 
@@ -221,9 +266,18 @@ struct ScoreFunction
     unsigned int _nFinished;
     bool _nIsTaskQueueReady;
 
+    // Reset queue. Tasks may still be processed by other processors if the queue has been started speculatively
+    // (without waiting for isTaskQueueProcessed()), so stop handing out tasks and wait for the ones in progress.
     void resetTaskQueue()
     {
         ACQUIRE(taskQueueLock);
+        _nIsTaskQueueReady = false;
+        while (_nFinished != _nProcessing)
+        {
+            RELEASE(taskQueueLock);
+            _mm_pause();
+            ACQUIRE(taskQueueLock);
+        }
         _nTask = 0;
         _nProcessing = 0;
         _nFinished = 0;
@@ -296,7 +350,120 @@ struct ScoreFunction
         return _nFinished == _nTask;
     }
 
-    void tryProcessSolution(unsigned long long processorNumber)
+    // Speculative scoring of solutions seen in broadcast transactions before they are included in a tick:
+    // solution processors compute the scores when the task queue of the tick is empty and store them in the score
+    // cache, so processing the tick mostly fetches scores from the cache. Only solutions for the current mining seed
+    // are queued. This is free of side effects on the state, because scores only depend on the solution and the seed.
+#if USE_SCORE_CACHE && SPECULATIVE_SCORE_QUEUE_SIZE
+    volatile char speculativeTaskQueueLock = 0;
+    struct
+    {
+        m256i publicKey[SPECULATIVE_SCORE_QUEUE_SIZE];
+        m256i nonce[SPECULATIVE_SCORE_QUEUE_SIZE];
+    } speculativeTaskQueue; // ring buffer
+    unsigned int _nSpeculativeTaskBegin;
+    unsigned int _nSpeculativeTask;
+    unsigned int _nSpeculativeProcessing;
+    bool _speculativeTaskQueueEnabled;
+#endif
+
+    // Add solution for speculative scoring, can call on any thread. Ignored if the queue is full, the seed isn't
+    // current, or the score is cached already.
+    void addSpeculativeTask(const m256i& publicKey, const m256i& miningSeed, const m256i& nonce)
+    {
+#if USE_SCORE_CACHE && SPECULATIVE_SCORE_QUEUE_SIZE
+        if (isZero(miningSeed))
+        {
+            return;
+        }
+        ACQUIRE(speculativeTaskQueueLock);
+        if (_speculativeTaskQueueEnabled && _nSpeculativeTask < SPECULATIVE_SCORE_QUEUE_SIZE && miningSeed == currentRandomSeed
+            && scoreCache.tryFetching(publicKey, miningSeed, nonce, scoreCache.getCacheIndex(publicKey, miningSeed, nonce)) < scoreCache.MIN_VALID_SCORE)
+        {
+            const unsigned int index = (_nSpeculativeTaskBegin + _nSpeculativeTask++) % SPECULATIVE_SCORE_QUEUE_SIZE;
+            speculativeTaskQueue.publicKey[index] = publicKey;
+            speculativeTaskQueue.nonce[index] = nonce;
+        }
+        RELEASE(speculativeTaskQueueLock);
+#endif
+    }
+
+    // Stop handing out speculative tasks, drop queued ones, and wait for the ones in progress
+    void pauseSpeculativeTasks()
+    {
+#if USE_SCORE_CACHE && SPECULATIVE_SCORE_QUEUE_SIZE
+        ACQUIRE(speculativeTaskQueueLock);
+        _speculativeTaskQueueEnabled = false;
+        _nSpeculativeTaskBegin = 0;
+        _nSpeculativeTask = 0;
+        while (_nSpeculativeProcessing)
+        {
+            RELEASE(speculativeTaskQueueLock);
+            _mm_pause();
+            ACQUIRE(speculativeTaskQueueLock);
+        }
+        RELEASE(speculativeTaskQueueLock);
+#endif
+    }
+
+    void resumeSpeculativeTasks()
+    {
+#if USE_SCORE_CACHE && SPECULATIVE_SCORE_QUEUE_SIZE
+        ACQUIRE(speculativeTaskQueueLock);
+        _speculativeTaskQueueEnabled = true;
+        RELEASE(speculativeTaskQueueLock);
+#endif
+    }
+
+    unsigned int getNumberOfSpeculativeTasks() const
+    {
+#if USE_SCORE_CACHE && SPECULATIVE_SCORE_QUEUE_SIZE
+        return _nSpeculativeTask;
+#else
+        return 0;
+#endif
+    }
+
+    // Get a speculative task, can call on any thread. If successful, finishSpeculativeTask() must be called after
+    // computing the score.
+    bool getSpeculativeTask(m256i* publicKey, m256i* miningSeed, m256i* nonce)
+    {
+#if USE_SCORE_CACHE && SPECULATIVE_SCORE_QUEUE_SIZE
+        if (!_nSpeculativeTask)
+        {
+            return false;
+        }
+        bool result = false;
+        ACQUIRE(speculativeTaskQueueLock);
+        if (_speculativeTaskQueueEnabled && _nSpeculativeTask)
+        {
+            const unsigned int index = _nSpeculativeTaskBegin;
+            _nSpeculativeTaskBegin = (_nSpeculativeTaskBegin + 1) % SPECULATIVE_SCORE_QUEUE_SIZE;
+            --_nSpeculativeTask;
+            ++_nSpeculativeProcessing;
+            *publicKey = speculativeTaskQueue.publicKey[index];
+            *miningSeed = currentRandomSeed;
+            *nonce = speculativeTaskQueue.nonce[index];
+            result = true;
+        }
+        RELEASE(speculativeTaskQueueLock);
+        return result;
+#else
+        return false;
+#endif
+    }
+
+    void finishSpeculativeTask()
+    {
+#if USE_SCORE_CACHE && SPECULATIVE_SCORE_QUEUE_SIZE
+        ACQUIRE(speculativeTaskQueueLock);
+        --_nSpeculativeProcessing;
+        RELEASE(speculativeTaskQueueLock);
+#endif
+    }
+
+    // Process a task of the tick, or a speculative task if the tick has no waiting tasks (and speculative is true)
+    void tryProcessSolution(unsigned long long processorNumber, bool speculative = true)
     {
         m256i publicKey;
         m256i miningSeed;
@@ -307,5 +474,10 @@ struct ScoreFunction
             (*this)(processorNumber, publicKey, miningSeed, nonce);
             this->finishTask();
         }
+        else if (speculative && this->getSpeculativeTask(&publicKey, &miningSeed, &nonce))
+        {
+            (*this)(processorNumber, publicKey, miningSeed, nonce);
+            this->finishSpeculativeTask();
+        }
     }
 };
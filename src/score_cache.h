@@ -10,10 +10,20 @@
 #include "kangaroo_twelve.h"
 
 /// Cache storing scores for pairs of publicKey and nonce (hash map)
+///
+/// The table is split into shards of consecutive entries with one lock each, so solution processors verifying in
+/// parallel rarely wait for each other. Probing for collisions wraps around within the shard of the hashed index, so
+/// each access only needs the lock of one shard. If all entries probed are used, the entry to overwrite is selected
+/// by second chance (clock) eviction: entries that have been fetched since they were added or last skipped are kept.
 template <unsigned int size, unsigned int collisionRetries = 20>
 class ScoreCache
 {
     static_assert(collisionRetries < size, "Number of fetch retries in case of collision is too big!");
+
+    static constexpr unsigned int maxShardCount = 1024;
+    static constexpr unsigned int shardSize = (size + maxShardCount - 1) / maxShardCount;
+    static constexpr unsigned int shardCount = (size + shardSize - 1) / shardSize;
+
 public:
 
     /// Init cache
@@ -25,12 +35,13 @@ public:
     /// Reset all cache entries
     void reset()
     {
-        ACQUIRE(lock);
+        acquireAllShards();
         setMem((unsigned char*)cache, sizeof(cache), 0);
         hits = 0;
         misses = 0;
         collisions = 0;
-        RELEASE(lock);
+        evictions = 0;
+        releaseAllShards();
     }
 
     /// Return maximum number of entries that can be stored in cache
@@ -58,57 +69,93 @@ public:
     // increments counter of hits, misses, or collisions
     int tryFetching(const m256i& publicKey, const m256i& miningSeed, const m256i& nonce, unsigned int & cacheIndex)
     {
-        int retVal;
+        int retVal = SCORE_CACHE_COLLISION;
         unsigned int tryFetchIdx = cacheIndex % capacity();
-        ACQUIRE(lock);
-        for (unsigned int i = 0; i < collisionRetries; ++i)
+        const unsigned int shard = tryFetchIdx / shardSize;
+        const unsigned int retries = probeCount(shard);
+        ACQUIRE(shardLocks[shard]);
+        for (unsigned int i = 0; i < retries; ++i)
         {
-            const m256i& cachedPublicKey = cache[tryFetchIdx].publicKey;
-            if (isZero(cachedPublicKey))
+            CacheEntry& entry = cache[tryFetchIdx];
+            if (isZero(entry.publicKey))
             {
                 // miss: data not available in cache yet (entry is empty)
-                misses++;
                 retVal = SCORE_CACHE_MISS;
                 break;
             }
 
-            const m256i& cachedMiningSeed = cache[tryFetchIdx].miningSeed;
-            const m256i& cachedNonce = cache[tryFetchIdx].nonce;
-            if (cachedPublicKey == publicKey && cachedMiningSeed == miningSeed && cachedNonce == nonce)
+            if (entry.publicKey == publicKey && entry.miningSeed == miningSeed && entry.nonce == nonce)
             {
                 // hit: data available in cache -> return score
-                hits++;
-                retVal = cache[tryFetchIdx].score;
+                entry.referenced = 1;
+                retVal = entry.score;
                 break;
             }
 
             // collision: other data is mapped to same index -> retry at following index
-            retVal = SCORE_CACHE_COLLISION;
-            tryFetchIdx = (tryFetchIdx + 1) % capacity();
+            tryFetchIdx = nextIndexInShard(tryFetchIdx, shard);
         }
-        RELEASE(lock);
+        RELEASE(shardLocks[shard]);
 
         if (retVal == SCORE_CACHE_COLLISION)
         {
-            collisions++;
+            _InterlockedIncrement64(&collisions);
         }
         else
         {
+            _InterlockedIncrement64((retVal == SCORE_CACHE_MISS) ? &misses : &hits);
             cacheIndex = tryFetchIdx;
         }
         return retVal;
     }
 
-    /// Add entry to cache (may overwrite existing entry)
+    /// Add entry to cache, probing from cacheIndex (hashed index or index returned by tryFetching()). Updates the
+    /// entry with the same key or uses an empty entry if there is one. Otherwise, overwrites an entry selected by
+    /// second chance eviction.
     void addEntry(const m256i& publicKey, const m256i& miningSeed, const m256i& nonce, unsigned int cacheIndex, int score)
     {
         cacheIndex %= capacity();
-        ACQUIRE(lock);
-        cache[cacheIndex].publicKey = publicKey;
-        cache[cacheIndex].miningSeed = miningSeed;
-        cache[cacheIndex].nonce = nonce;
-        cache[cacheIndex].score = score;
-        RELEASE(lock);
+        const unsigned int shard = cacheIndex / shardSize;
+        const unsigned int retries = probeCount(shard);
+        ACQUIRE(shardLocks[shard]);
+
+        // entries may have been added by other processors since tryFetching()
+        unsigned int idx = cacheIndex;
+        bool found = false;
+        for (unsigned int i = 0; i < retries; ++i)
+        {
+            const CacheEntry& entry = cache[idx];
+            if (isZero(entry.publicKey)
+                || (entry.publicKey == publicKey && entry.miningSeed == miningSeed && entry.nonce == nonce))
+            {
+                found = true;
+                break;
+            }
+            idx = nextIndexInShard(idx, shard);
+        }
+
+        if (!found)
+        {
+            // second chance: clear reference flags until an entry without flag is found (first probed entry if all have it)
+            idx = cacheIndex;
+            unsigned int i = 0;
+            for (; i < retries && cache[idx].referenced; ++i)
+            {
+                cache[idx].referenced = 0;
+                idx = nextIndexInShard(idx, shard);
+            }
+            if (i == retries)
+                idx = cacheIndex;
+            _InterlockedIncrement64(&evictions);
+        }
+
+        CacheEntry& entry = cache[idx];
+        entry.publicKey = publicKey;
+        entry.miningSeed = miningSeed;
+        entry.nonce = nonce;
+        entry.score = score;
+        entry.referenced = 0;
+        RELEASE(shardLocks[shard]);
     }
 
     /// Save score cache to file
@@ -117,9 +164,9 @@ public:
         logToConsole(L"Saving score cache file...");
 
         const unsigned long long beginningTick = __rdtsc();
-        ACQUIRE(lock);
+        acquireAllShards();
         long long savedSize = ::save(filename, sizeof(cache), (unsigned char*)cache, directory);
-        RELEASE(lock);
+        releaseAllShards();
         if (savedSize == sizeof(cache))
         {
             setNumber(message, savedSize, TRUE);
@@ -136,9 +183,9 @@ public:
         bool success = true;
         logToConsole(L"Loading score cache...");
         reset();
-        ACQUIRE(lock);
+        acquireAllShards();
         long long loadedSize = ::load(filename, sizeof(cache), (unsigned char*)cache, directory);
-        RELEASE(lock);
+        releaseAllShards();
         if (loadedSize != sizeof(cache))
         {
             if (loadedSize == -1)
@@ -163,23 +210,29 @@ public:
     }
 
     // Return number of hits (data available in cache when fetched)
-    unsigned int hitCount() const
+    unsigned long long hitCount() const
     {
         return hits;
     }
 
     // Return number of misses (data not in cache yet)
-    unsigned int missCount() const
+    unsigned long long missCount() const
     {
         return misses;
     }
 
     // Return number of collisions (other data is mapped to same index)
-    unsigned int collisionCount() const
+    unsigned long long collisionCount() const
     {
         return collisions;
     }
 
+    // Return number of entries overwritten by other data
+    unsigned long long evictionCount() const
+    {
+        return evictions;
+    }
+
 private:
     struct CacheEntry
     {
@@ -187,16 +240,45 @@ private:
         m256i miningSeed;
         m256i nonce;
         int score;
+        unsigned char referenced; // fetched since added or skipped by eviction (in former padding, file format unchanged)
     };
-    
+    static_assert(sizeof(CacheEntry) == 3 * 32 + 8, "Unexpected size of ScoreCache entry, would change score cache file format");
+
+    // Number of entries to probe in shard, which may be smaller than collisionRetries for the last shard
+    static unsigned int probeCount(unsigned int shard)
+    {
+        const unsigned int end = (shard + 1) * shardSize;
+        const unsigned int entriesInShard = ((end < size) ? end : size) - shard * shardSize;
+        return (entriesInShard < collisionRetries) ? entriesInShard : collisionRetries;
+    }
+
+    static unsigned int nextIndexInShard(unsigned int index, unsigned int shard)
+    {
+        ++index;
+        return (index == size || index == (shard + 1) * shardSize) ? shard * shardSize : index;
+    }
+
+    void acquireAllShards()
+    {
+        for (unsigned int i = 0; i < shardCount; ++i)
+            ACQUIRE(shardLocks[i]);
+    }
+
+    void releaseAllShards()
+    {
+        for (unsigned int i = 0; i < shardCount; ++i)
+            RELEASE(shardLocks[i]);
+    }
+
     // cache entries (set zero or load from a file on init)
     CacheEntry cache[size];
 
-    // lock to prevent race conditions on parallel access
-    volatile char lock = 0;
+    // locks to prevent race conditions on parallel access, one per shard of shardSize entries
+    volatile char shardLocks[shardCount] = {};
 
-    // statistics of hits, misses, and collisions
-    unsigned int hits = 0;
-    unsigned int misses = 0;
-    unsigned int collisions = 0;
+    // statistics of hits, misses, collisions, and evictions
+    volatile long long hits = 0;
+    volatile long long misses = 0;
+    volatile long long collisions = 0;
+    volatile long long evictions = 0;
 };
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "platform/memory_util.h"
+#include "platform/assert.h"
+
+#include <lib/platform_common/qintrin.h>
+
+// Sparse file format of an array of capacity records that is mostly empty, such as the spectrum and universe hash
+// maps. Empty slots (all bytes zero) are not written, so the size of the file grows with the fill factor instead of
+// the capacity.
+//
+// Layout: SparseHeader | occupancy bitmap (capacity / 64 words, bit set for non-empty slot) | non-empty records in
+// index order
+//
+// The sparse format is only used if it is smaller than the full array, so files of both formats can be told apart
+// by their size. Loading code reads files of up to full size and calls unpack() if less than the full size was read.
+//
+// Unlike the page-based format of platform/sparse_file_io.h, which suits contract states with large zero areas, this
+// format works on single records. Hash maps spread their entries evenly, so almost every page contains at least one
+// non-empty record even at low fill factors.
+template <unsigned long long capacity, typename RecordType>
+class SparseSnapshot
+{
+public:
+    static_assert(capacity % 64 == 0, "SparseSnapshot requires capacity that is a multiple of 64");
+    static_assert(sizeof(RecordType) % sizeof(unsigned long long) == 0, "SparseSnapshot requires record size that is a multiple of 8");
+
+    static constexpr unsigned long long fullSizeInBytes = capacity * sizeof(RecordType);
+    static constexpr unsigned long long bitmapWordCount = capacity / 64;
+
+    struct SparseHeader
+    {
+        unsigned long long magic;
+        unsigned long long occupiedCount;
+    };
+
+    // "QSPREC01" in little-endian byte order (different from sparseFileMagic of the page-based format)
+    static constexpr unsigned long long magicValue = 0x3130434552505351ULL;
+
+    // Return size of sparse data with given number of non-empty records
+    static constexpr unsigned long long sparseSizeInBytes(unsigned long long occupiedCount)
+    {
+        return sizeof(SparseHeader) + bitmapWordCount * sizeof(unsigned long long) + occupiedCount * sizeof(RecordType);
+    }
+
+    // Check if record is empty (all bytes zero)
+    static bool isEmpty(const RecordType& record)
+    {
+        const unsigned long long* words = (const unsigned long long*)&record;
+        unsigned long long orOfWords = 0;
+        for (unsigned int i = 0; i < sizeof(RecordType) / sizeof(unsigned long long); ++i)
+        {
+            orOfWords |= words[i];
+        }
+        return !orOfWords;
+    }
+
+    // Write sparse data of records to buffer (of fullSizeInBytes). Returns size of sparse data in bytes or 0 if the
+    // sparse data wouldn't be smaller than the full array, which should be saved instead.
+    static unsigned long long build(const RecordType* records, unsigned char* buffer)
+    {
+        SparseHeader* header = (SparseHeader*)buffer;
+        unsigned long long* bitmap = (unsigned long long*)(header + 1);
+        RecordType* packedRecords = (RecordType*)(bitmap + bitmapWordCount);
+        constexpr unsigned long long maxOccupiedCount = (fullSizeInBytes - sparseSizeInBytes(0) - 1) / sizeof(RecordType);
+        static_assert(sparseSizeInBytes(maxOccupiedCount) < fullSizeInBytes, "Sparse data must be smaller than full array");
+
+        unsigned long long occupiedCount = 0;
+        for (unsigned long long wordIndex = 0; wordIndex < bitmapWordCount; ++wordIndex)
+        {
+            unsigned long long word = 0;
+            const RecordType* blockRecords = records + wordIndex * 64;
+            for (unsigned int bit = 0; bit < 64; ++bit)
+            {
+                if (!isEmpty(blockRecords[bit]))
+                {
+                    if (occupiedCount >= maxOccupiedCount)
+                    {
+                        return 0;
+                    }
+                    copyMem(&packedRecords[occupiedCount++], &blockRecords[bit], sizeof(RecordType));
+                    word |= 1ULL << bit;
+                }
+            }
+            bitmap[wordIndex] = word;
+        }
+        header->magic = magicValue;
+        header->occupiedCount = occupiedCount;
+        return sparseSizeInBytes(occupiedCount);
+    }
+
+    // Restore all records from sparse data of given size. Returns false if the sparse data is invalid (records are
+    // undefined in this case).
+    static bool unpack(const unsigned char* buffer, unsigned long long size, RecordType* records)
+    {
+        if (size < sparseSizeInBytes(0))
+        {
+            return false;
+        }
+        const SparseHeader* header = (const SparseHeader*)buffer;
+        const unsigned long long* bitmap = (const unsigned long long*)(header + 1);
+        const RecordType* packedRecords = (const RecordType*)(bitmap + bitmapWordCount);
+        if (header->magic != magicValue || header->occupiedCount > capacity || size != sparseSizeInBytes(header->occupiedCount))
+        {
+            return false;
+        }
+        unsigned long long occupiedCount = 0;
+        for (unsigned long long wordIndex = 0; wordIndex < bitmapWordCount; ++wordIndex)
+        {
+            occupiedCount += _mm_popcnt_u64(bitmap[wordIndex]);
+        }
+        if (occupiedCount != header->occupiedCount)
+        {
+            return false;
+        }
+
+        setMem(records, fullSizeInBytes, 0);
+        occupiedCount = 0;
+        for (unsigned long long wordIndex = 0; wordIndex < bitmapWordCount; ++wordIndex)
+        {
+            for (unsigned long long word = bitmap[wordIndex]; word; word &= word - 1)
+            {
+                const unsigned long long index = wordIndex * 64 + _tzcnt_u64(word);
+                copyMem(&records[index], &packedRecords[occupiedCount++], sizeof(RecordType));
+            }
+        }
+        return true;
+    }
+};
@@ -14,6 +14,7 @@ static constexpr unsigned long long computorSeedsCount = sizeof(computorSeeds) /
 GLOBAL_VAR_DECL m256i operatorPublicKey;
 GLOBAL_VAR_DECL m256i computorSubseeds[computorSeedsCount];
 GLOBAL_VAR_DECL m256i computorPrivateKeys[computorSeedsCount];
+GLOBAL_VAR_DECL m256i computorSigningKeys[computorSeedsCount]; // precomputed for signing tick votes, see getSigningKey()
 GLOBAL_VAR_DECL m256i computorPublicKeys[computorSeedsCount];
 GLOBAL_VAR_DECL m256i arbitratorPublicKey;
 GLOBAL_VAR_DECL m256i dispatcherPublicKey;
@@ -37,6 +38,7 @@ static bool initSpecialEntities()
         }
         getPrivateKey(computorSubseeds[i].m256i_u8, computorPrivateKeys[i].m256i_u8);
         getPublicKey(computorPrivateKeys[i].m256i_u8, computorPublicKeys[i].m256i_u8);
+        getSigningKey(computorPrivateKeys[i].m256i_u8, computorSigningKeys[i].m256i_u8);
     }
 
     getPublicKeyFromIdentity((const unsigned char*)ARBITRATOR, (unsigned char*)&arbitratorPublicKey);
@@ -52,6 +54,7 @@ static void deinitSpecialEntities()
     setMem(computorSeeds, sizeof(computorSeeds), 0);
     setMem(computorSubseeds, sizeof(computorSubseeds), 0);
     setMem(computorPrivateKeys, sizeof(computorPrivateKeys), 0);
+    setMem(computorSigningKeys, sizeof(computorSigningKeys), 0);
     setMem(computorPublicKeys, sizeof(computorPublicKeys), 0);
 }
 
@@ -7,6 +7,7 @@
 #include "platform/time_stamp_counter.h"
 #include "platform/memory.h"
 #include "platform/profiling.h"
+#include "platform/parallel_jobs.h"
 
 #include "network_messages/entity.h"
 
@@ -16,8 +17,29 @@
 #include "system.h"
 #include "kangaroo_twelve.h"
 #include "common_buffers.h"
-
-GLOBAL_VAR_DECL volatile char spectrumLock GLOBAL_VAR_INIT(0);
+#include "merkle_tree.h"
+#include "merkle_siblings_cache.h"
+#include "delta_snapshot.h"
+#include "sparse_snapshot.h"
+#include "platform/spin_lock.h"
+
+GLOBAL_VAR_DECL SpinLock<> spectrumLock;
+
+// Sequence counter for lock-free lookups in the spectrum hash map (seqlock). It is odd while the structure of the
+// hash map changes (slot gets public key, reorganization, loading), which is done by writers holding spectrumLock.
+// Readers retry if the counter changed during the lookup.
+GLOBAL_VAR_DECL volatile long spectrumStructureSequence GLOBAL_VAR_INIT(0);
+
+// One tag byte per slot of the spectrum hash map for probing many slots per instruction before comparing full
+// public keys. Tag is 0 for empty slots and spectrumTag(publicKey) otherwise. Needs to be updated whenever public
+// keys in the spectrum are changed (see rebuildSpectrumTags()).
+GLOBAL_VAR_DECL unsigned char* spectrumTags GLOBAL_VAR_INIT(nullptr);
+
+// Balance (incomingAmount - outgoingAmount) of each slot of the spectrum hash map as a contiguous array, for
+// statistics and dust selection that only need balances and would otherwise iterate all 64-byte records. Together
+// with spectrumTags (occupancy), this is a structure-of-arrays shadow of the spectrum that is only kept in memory.
+// Updated by increaseEnergy() / decreaseEnergy() and rebuildSpectrumTagsAndBalances().
+GLOBAL_VAR_DECL long long* spectrumBalances GLOBAL_VAR_INIT(nullptr);
 GLOBAL_VAR_DECL EntityRecord* spectrum GLOBAL_VAR_INIT(nullptr);
 GLOBAL_VAR_DECL struct SpectrumInfo {
     unsigned int numberOfEntities = 0;  // Number of entities in the spectrum hash map, may include entries with balance == 0
@@ -28,11 +50,135 @@ GLOBAL_VAR_DECL unsigned int entityCategoryPopulations[48]; // Array size depend
 static constexpr unsigned char entityCategoryCount = sizeof(entityCategoryPopulations) / sizeof(entityCategoryPopulations[0]);
 GLOBAL_VAR_DECL unsigned long long dustThresholdBurnAll GLOBAL_VAR_INIT(0), dustThresholdBurnHalf GLOBAL_VAR_INIT(0);
 
+// Anti-dust passes over the spectrum are split into chunks of slots that are processed in parallel (see ParallelJobs)
+static constexpr unsigned long long antiDustParallelChunkSize = 1024 * 1024;
+static constexpr unsigned long long antiDustParallelChunkCount = (SPECTRUM_CAPACITY + antiDustParallelChunkSize - 1) / antiDustParallelChunkSize;
+
+// Per-chunk results of the parallel anti-dust passes: category populations of each chunk and number of
+// burn-half candidates in the chunks before (used for selecting every second candidate in slot order)
+GLOBAL_VAR_DECL unsigned int antiDustChunkCategoryPopulations[antiDustParallelChunkCount][entityCategoryCount];
+GLOBAL_VAR_DECL unsigned int antiDustChunkBurnHalfCandidates[antiDustParallelChunkCount];
+
 GLOBAL_VAR_DECL m256i* spectrumDigests GLOBAL_VAR_INIT(nullptr);
 static constexpr unsigned long long spectrumDigestsSizeInByte = (SPECTRUM_CAPACITY * 2 - 1) * 32ULL;
 
+// Change flags of spectrum leafs, set by increaseEnergy() / decreaseEnergy() (protected by spectrumLock)
+GLOBAL_VAR_DECL unsigned long long* spectrumChangeFlags GLOBAL_VAR_INIT(nullptr);
+GLOBAL_VAR_DECL IncrementalMerkleTree<SPECTRUM_CAPACITY> spectrumDigestTree;
+
+// Sequence counter for reading spectrumDigests without lock (seqlock). It is odd while the digests are updated, which
+// is done by writers holding spectrumLock (see updateSpectrumDigests() and rebuildSpectrumDigests()). Readers retry
+// if the counter changed while reading. The even values identify versions of the digests.
+GLOBAL_VAR_DECL volatile long spectrumDigestsSequence GLOBAL_VAR_INIT(0);
+
+// Siblings of recently requested entities keyed by (spectrum index, spectrumDigestsSequence), see
+// getSpectrumEntityAndSiblings()
+GLOBAL_VAR_DECL MerkleSiblingsCache<SPECTRUM_DEPTH> spectrumSiblingsCache;
+
+// Tracking of spectrum changes since the last full spectrum snapshot (see saveSpectrumSnapshot())
+GLOBAL_VAR_DECL DeltaSnapshot<SPECTRUM_CAPACITY, EntityRecord> spectrumDeltaSnapshot;
+
+// Sparse file format of the spectrum (see saveSpectrumRecords())
+typedef SparseSnapshot<SPECTRUM_CAPACITY, EntityRecord> SpectrumSparseSnapshot;
+
 GLOBAL_VAR_DECL unsigned long long spectrumReorgTotalExecutionTicks GLOBAL_VAR_INIT(0);
 
+// Number of reorganizations, which change entity indices and remove entities without flagging the leafs in
+// spectrumDigestTree (incremented by reorganizeSpectrum() while holding spectrumLock)
+GLOBAL_VAR_DECL unsigned int spectrumReorganizationCount GLOBAL_VAR_INIT(0);
+
+
+// Tag of non-empty slot (never 0). Uses bits of the public key that are not used for the hash map index.
+static inline unsigned char spectrumTag(const m256i& publicKey)
+{
+    const unsigned char tag = publicKey.m256i_u8[4];
+    return tag ? tag : 1;
+}
+
+// Compute tags and balances of spectrum slots [begin, end) (ParallelJobs::ChunkFunction)
+static void computeSpectrumTagsAndBalances(void*, unsigned long long begin, unsigned long long end)
+{
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        spectrumTags[i] = isZero(spectrum[i].publicKey) ? 0 : spectrumTag(spectrum[i].publicKey);
+        spectrumBalances[i] = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
+    }
+}
+
+// Recompute all spectrum tags and balances, needs to be called after modifying the spectrum directly (not through
+// increaseEnergy() / decreaseEnergy()). Caller has to acquire spectrumLock if other processors may access the spectrum.
+static void rebuildSpectrumTagsAndBalances()
+{
+    parallelJobs.run(computeSpectrumTagsAndBalances, nullptr, SPECTRUM_CAPACITY, 1024 * 1024);
+}
+
+// Find slot of public key in spectrum hash map. Returns index of the slot containing the public key or, if it is
+// not in the spectrum, of the first empty slot (same result as comparing the public key slot by slot). Returns
+// SPECTRUM_CAPACITY if all slots were checked without success, which may only happen with inconsistent
+// state seen by lock-free readers during reorganization.
+static unsigned int findSpectrumSlot(const m256i& publicKey)
+{
+    const unsigned char tag = spectrumTag(publicKey);
+    unsigned int index = publicKey.m256i_u32[0] & (SPECTRUM_CAPACITY - 1);
+#if defined(__AVX512BW__)
+    constexpr unsigned int tagsPerStep = 64;
+    const __m512i tagVector = _mm512_set1_epi8(tag);
+#else
+    constexpr unsigned int tagsPerStep = 32;
+    const __m256i tagVector = _mm256_set1_epi8(tag);
+    const __m256i zeroVector = _mm256_setzero_si256();
+#endif
+    for (unsigned int checkedSlots = 0; checkedSlots < SPECTRUM_CAPACITY; )
+    {
+        if (index <= SPECTRUM_CAPACITY - tagsPerStep)
+        {
+            // Compare tagsPerStep tags at once, consider only matches before the first empty slot
+#if defined(__AVX512BW__)
+            const __m512i tags = _mm512_loadu_si512(spectrumTags + index);
+            const unsigned long long emptyMask = _mm512_testn_epi8_mask(tags, tags);
+            unsigned long long matchMask = _mm512_cmpeq_epi8_mask(tags, tagVector);
+            if (emptyMask)
+                matchMask &= (emptyMask - 1);
+            while (matchMask)
+            {
+                const unsigned int slot = index + (unsigned int)_tzcnt_u64(matchMask);
+                if (spectrum[slot].publicKey == publicKey)
+                    return slot;
+                matchMask &= matchMask - 1;
+            }
+            if (emptyMask)
+                return index + (unsigned int)_tzcnt_u64(emptyMask);
+#else
+            const __m256i tags = _mm256_loadu_si256((const __m256i*)(spectrumTags + index));
+            const unsigned int emptyMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(tags, zeroVector));
+            unsigned int matchMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(tags, tagVector));
+            if (emptyMask)
+                matchMask &= (emptyMask - 1);
+            while (matchMask)
+            {
+                const unsigned int slot = index + _tzcnt_u32(matchMask);
+                if (spectrum[slot].publicKey == publicKey)
+                    return slot;
+                matchMask &= matchMask - 1;
+            }
+            if (emptyMask)
+                return index + _tzcnt_u32(emptyMask);
+#endif
+            index = (index + tagsPerStep) & (SPECTRUM_CAPACITY - 1);
+            checkedSlots += tagsPerStep;
+        }
+        else
+        {
+            // Slot by slot at end of hash map (wrap around)
+            if (!spectrumTags[index] || (spectrumTags[index] == tag && spectrum[index].publicKey == publicKey))
+                return index;
+            index = (index + 1) & (SPECTRUM_CAPACITY - 1);
+            ++checkedSlots;
+        }
+    }
+    return SPECTRUM_CAPACITY;
+}
+
 
 // Update SpectrumInfo data (exensive, because it iterates the whole spectrum), acquire no lock
 static void updateSpectrumInfo(SpectrumInfo& si = spectrumInfo)
@@ -42,8 +188,8 @@ static void updateSpectrumInfo(SpectrumInfo& si = spectrumInfo)
     si.totalAmount = 0;
     for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
     {
-        long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
-        if (balance || !isZero(spectrum[i].publicKey))
+        const long long balance = spectrumBalances[i];
+        if (balance || spectrumTags[i])
         {
             si.numberOfEntities++;
             si.totalAmount += balance;
@@ -51,6 +197,20 @@ static void updateSpectrumInfo(SpectrumInfo& si = spectrumInfo)
     }
 }
 
+// Count non-zero balances of spectrum slots [begin, end) per entity category (ParallelJobs::ChunkFunction)
+static void computeChunkEntityCategoryPopulations(void*, unsigned long long begin, unsigned long long end)
+{
+    unsigned int* populations = antiDustChunkCategoryPopulations[begin / antiDustParallelChunkSize];
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        const unsigned long long balance = spectrumBalances[i];
+        if (balance)
+        {
+            populations[63 - __lzcnt64(balance)]++;
+        }
+    }
+}
+
 // Compute balances that count as dust and are burned if 75% of spectrum hash map is filled.
 // All balances <= dustThresholdBurnAll are burned in this case.
 // Every 2nd balance <= dustThresholdBurnHalf is burned in this case.
@@ -58,14 +218,16 @@ static void updateAndAnalzeEntityCategoryPopulations()
 {
     PROFILE_SCOPE();
     static_assert(MAX_SUPPLY < (1llu << entityCategoryCount));
-    setMem(entityCategoryPopulations, sizeof(entityCategoryPopulations), 0);
 
-    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
+    // Histogram per chunk in parallel, then sum up
+    setMem(antiDustChunkCategoryPopulations, sizeof(antiDustChunkCategoryPopulations), 0);
+    parallelJobs.run(computeChunkEntityCategoryPopulations, nullptr, SPECTRUM_CAPACITY, antiDustParallelChunkSize);
+    setMem(entityCategoryPopulations, sizeof(entityCategoryPopulations), 0);
+    for (unsigned int chunkIndex = 0; chunkIndex < antiDustParallelChunkCount; chunkIndex++)
     {
-        const unsigned long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
-        if (balance)
+        for (unsigned int categoryIndex = 0; categoryIndex < entityCategoryCount; categoryIndex++)
         {
-            entityCategoryPopulations[63 - __lzcnt64(balance)]++;
+            entityCategoryPopulations[categoryIndex] += antiDustChunkCategoryPopulations[chunkIndex][categoryIndex];
         }
     }
 
@@ -118,14 +280,14 @@ struct DustBurnLogger
 
     DustBurnLogger()
     {
-        buf = (DustBurning*)commonBuffers.acquireBuffer(2 + maxEntries * sizeof(DustBurning::Entity));
+        buf = (DustBurning*)__acquireScratchpad(2 + maxEntries * sizeof(DustBurning::Entity), /*initZero=*/false);
         ASSERT(buf);
         buf->numberOfBurns = 0;
     }
 
     ~DustBurnLogger()
     {
-        commonBuffers.releaseBuffer(buf);
+        __releaseScratchpad(buf);
     }
 
     // Add burned amount of of entity, may send buffered message to logging.
@@ -151,6 +313,364 @@ private:
     DustBurning* buf;
 };
 
+static constexpr unsigned short quTransferBatchMaxTransfers = 1000;
+GLOBAL_VAR_DECL m256i quTransferBatchLogBuffer[(sizeof(m256i) + 2 + quTransferBatchMaxTransfers * sizeof(QuTransferBatch::Transfer) + sizeof(m256i) - 1) / sizeof(m256i)];
+
+// Build and log variable-size QuTransferBatch log messages for consecutive transfers from one source, instead of one
+// QuTransfer message per transfer. A batch of a single transfer is logged as QuTransfer. Only used by the contract
+// processor (not concurrently). Call finished() before anything else is logged, such as by the POST_INCOMING_TRANSFER
+// callback of a contract receiving QU, to keep the order of log messages. The buffer is shared, so no transfers may
+// be pending while another QuTransferBatchLogger is used (in the callback).
+struct QuTransferBatchLogger
+{
+    QuTransferBatchLogger(const m256i& sourcePublicKey) : sourcePublicKey(sourcePublicKey), numberOfTransfers(0)
+    {
+    }
+
+    ~QuTransferBatchLogger()
+    {
+        finished();
+    }
+
+    // Add transfer, may send buffered message to logging.
+    void addTransfer(const m256i& destinationPublicKey, long long amount)
+    {
+        QuTransferBatch* buf = (QuTransferBatch*)quTransferBatchLogBuffer;
+        buf->numberOfTransfers = ++numberOfTransfers;
+        QuTransferBatch::Transfer& t = buf->transfer(numberOfTransfers - 1);
+        t.destinationPublicKey = destinationPublicKey;
+        t.amount = amount;
+
+        if (numberOfTransfers == quTransferBatchMaxTransfers)
+            finished();
+    }
+
+    // Send buffered transfers to logging
+    void finished()
+    {
+        QuTransferBatch* buf = (QuTransferBatch*)quTransferBatchLogBuffer;
+        if (numberOfTransfers == 1)
+        {
+            const QuTransfer quTransfer = { sourcePublicKey, buf->transfer(0).destinationPublicKey, buf->transfer(0).amount };
+            logger.logQuTransfer(quTransfer);
+        }
+        else if (numberOfTransfers > 1)
+        {
+            buf->sourcePublicKey = sourcePublicKey;
+            logger.logQuTransferBatch(buf);
+        }
+        numberOfTransfers = 0;
+    }
+
+private:
+    m256i sourcePublicKey;
+    unsigned short numberOfTransfers;
+};
+
+// Check if balance is burned by the first anti-dust pass (all balances <= dustThresholdBurnAll)
+static bool isDustBurnAllBalance(unsigned long long balance)
+{
+    return balance && balance <= dustThresholdBurnAll;
+}
+
+// Check if balance is candidate of the second anti-dust pass (every second is burned). The second pass is only
+// applied after the first, so candidates are the balances in (dustThresholdBurnAll, dustThresholdBurnHalf].
+static bool isDustBurnHalfCandidate(unsigned long long balance)
+{
+    return balance > dustThresholdBurnAll && balance <= dustThresholdBurnHalf;
+}
+
+// Count burn-half candidates of spectrum slots [begin, end) (ParallelJobs::ChunkFunction)
+static void countChunkDustBurnHalfCandidates(void*, unsigned long long begin, unsigned long long end)
+{
+    unsigned int count = 0;
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        count += isDustBurnHalfCandidate(spectrumBalances[i]);
+    }
+    antiDustChunkBurnHalfCandidates[begin / antiDustParallelChunkSize] = count;
+}
+
+// Burn dust of spectrum slots [begin, end), requires antiDustChunkBurnHalfCandidates to contain the number of
+// candidates in previous chunks (ParallelJobs::ChunkFunction)
+static void burnChunkDust(void*, unsigned long long begin, unsigned long long end)
+{
+    unsigned int countBurnCanadiates = antiDustChunkBurnHalfCandidates[begin / antiDustParallelChunkSize];
+    for (unsigned long long i = begin; i < end; i++)
+    {
+        const unsigned long long balance = spectrumBalances[i];
+        if (isDustBurnAllBalance(balance) || (isDustBurnHalfCandidate(balance) && (++countBurnCanadiates & 1)))
+        {
+            spectrum[i].outgoingAmount = spectrum[i].incomingAmount;
+            spectrumBalances[i] = 0;
+        }
+    }
+}
+
+#if LOG_SPECTRUM
+// Log the burns that burnSpectrumDust() will do, must be called before burning. Burns of the first pass are
+// logged first, followed by the burns of the second pass, each in slot order.
+static void logSpectrumDustBurns()
+{
+    PROFILE_SCOPE();
+
+    DustBurnLogger dbl;
+
+    if (dustThresholdBurnAll > 0)
+    {
+        for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
+        {
+            const unsigned long long balance = spectrumBalances[i];
+            if (isDustBurnAllBalance(balance))
+            {
+                dbl.addDustBurn(spectrum[i].publicKey, balance);
+            }
+        }
+    }
+
+    if (dustThresholdBurnHalf > 0)
+    {
+        unsigned int countBurnCanadiates = 0;
+        for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
+        {
+            const unsigned long long balance = spectrumBalances[i];
+            if (isDustBurnHalfCandidate(balance) && (++countBurnCanadiates & 1))
+            {
+                dbl.addDustBurn(spectrum[i].publicKey, balance);
+            }
+        }
+    }
+
+    // Finished dust burning (pass message to log)
+    dbl.finished();
+}
+#endif
+
+// Burn every balance <= dustThresholdBurnAll and every second balance <= dustThresholdBurnHalf (in slot order) as
+// computed by updateAndAnalzeEntityCategoryPopulations(). Candidates for burning half are counted per chunk in
+// parallel first, so the chunks can be burned in parallel afterwards. Caller has to acquire spectrumLock.
+static void burnSpectrumDust()
+{
+    PROFILE_SCOPE();
+
+    if (!dustThresholdBurnAll && !dustThresholdBurnHalf)
+        return;
+
+    setMem(antiDustChunkBurnHalfCandidates, sizeof(antiDustChunkBurnHalfCandidates), 0);
+    if (dustThresholdBurnHalf > 0)
+    {
+        parallelJobs.run(countChunkDustBurnHalfCandidates, nullptr, SPECTRUM_CAPACITY, antiDustParallelChunkSize);
+
+        // Convert counts per chunk to counts of previous chunks
+        unsigned int countBurnCanadiates = 0;
+        for (unsigned int chunkIndex = 0; chunkIndex < antiDustParallelChunkCount; chunkIndex++)
+        {
+            const unsigned int chunkCount = antiDustChunkBurnHalfCandidates[chunkIndex];
+            antiDustChunkBurnHalfCandidates[chunkIndex] = countBurnCanadiates;
+            countBurnCanadiates += chunkCount;
+        }
+    }
+
+    parallelJobs.run(burnChunkDust, nullptr, SPECTRUM_CAPACITY, antiDustParallelChunkSize);
+}
+
+// Number of leafs / digests hashed per chunk when rebuilding spectrum digests in parallel
+static constexpr unsigned long long spectrumDigestsParallelChunkSize = 65536;
+
+// Hash spectrum entities [begin, end) into leaf digests (ParallelJobs::ChunkFunction)
+static void computeSpectrumLeafDigests(void*, unsigned long long begin, unsigned long long end)
+{
+    KangarooTwelve64To32Batch(&spectrum[begin], &spectrumDigests[begin], end - begin);
+}
+
+// Recompute all digests of the spectrum Merkle tree. Leafs and lower levels are split into chunks that are
+// processed by idle processors in parallel. Upper levels with at most one chunk are computed by the calling
+// processor only. The result is the same as the serial computation.
+static void rebuildSpectrumDigests()
+{
+    PROFILE_SCOPE();
+
+    _InterlockedIncrement(&spectrumDigestsSequence);
+    parallelJobs.run(computeSpectrumLeafDigests, nullptr, SPECTRUM_CAPACITY, spectrumDigestsParallelChunkSize);
+    spectrumDigestTree.rebuildInnerNodes();
+    _InterlockedIncrement(&spectrumDigestsSequence);
+}
+
+// Update digests of the spectrum Merkle tree for all entities changed since the last update, only rehashing the
+// paths from the changed leafs to the root. Caller has to acquire spectrumLock.
+static void updateSpectrumDigests()
+{
+    PROFILE_SCOPE();
+
+    _InterlockedIncrement(&spectrumDigestsSequence);
+    KangarooTwelve64To32Batcher batcher;
+    for (unsigned long long i = spectrumDigestTree.findNextChangedLeaf(0); i < SPECTRUM_CAPACITY; i = spectrumDigestTree.findNextChangedLeaf(i + 1))
+    {
+        batcher.add(&spectrum[i], &spectrumDigests[i]);
+    }
+    batcher.flush();
+
+    spectrumDigestTree.updateInnerNodes();
+    _InterlockedIncrement(&spectrumDigestsSequence);
+}
+
+// Maximum number of lock-free attempts of getSpectrumEntityAndSiblings() before falling back to acquiring spectrumLock
+static constexpr unsigned int spectrumSiblingsMaxRetries = 4;
+
+// Copy the record of spectrum leaf index and get the siblings of its path to the root of the last committed spectrum
+// digests. Usually doesn't acquire spectrumLock: the record is copied and the siblings are taken from
+// spectrumSiblingsCache or the tree within one read window of the seqlock spectrumDigestsSequence, which is retried if
+// the digests were updated or the record was changed (leaf flagged) concurrently. Returns the version of the digests.
+static long getSpectrumEntityAndSiblings(unsigned long long index, EntityRecord& entity, m256i siblings[SPECTRUM_DEPTH])
+{
+    for (unsigned int attempt = 0; attempt < spectrumSiblingsMaxRetries; ++attempt)
+    {
+        const long sequence = spectrumDigestsSequence;
+        if ((sequence & 1) || spectrumDigestTree.isLeafChanged(index))
+        {
+            _mm_pause();
+            continue;
+        }
+        _mm_lfence();
+
+        copyMem(&entity, &spectrum[index], sizeof(EntityRecord));
+        const bool cached = spectrumSiblingsCache.get(index, sequence, siblings);
+        if (!cached)
+            spectrumDigestTree.getSiblings(index, siblings);
+
+        _mm_lfence();
+        if (spectrumDigestsSequence == sequence && !spectrumDigestTree.isLeafChanged(index))
+        {
+            if (!cached)
+                spectrumSiblingsCache.add(index, sequence, siblings);
+            return sequence;
+        }
+    }
+
+    // digests or record are updated continuously (or reading is very slow) -> wait for lock
+    spectrumLock.acquire();
+    const long sequence = spectrumDigestsSequence;
+    copyMem(&entity, &spectrum[index], sizeof(EntityRecord));
+    spectrumDigestTree.getSiblings(index, siblings);
+    spectrumLock.release();
+    spectrumSiblingsCache.add(index, sequence, siblings);
+    return sequence;
+}
+
+// Copy count spectrum records starting at firstIndex, which need to form a complete subtree of 2^level leafs, together
+// with the siblings of the subtree up to the root (SPECTRUM_DEPTH - level digests) and the root digest, for serving
+// state chunks to peers. Reads without spectrumLock, using the seqlock spectrumDigestsSequence for the digests and the
+// change flags for the records, so serving chunks doesn't block the tick processor. Return false if any of the records
+// has changed since the last update of the digests (tick is being processed), because the records cannot be proven
+// then. A record that is written while it is copied and flagged after the final check fails verification by the
+// requester, who requests the chunk again.
+static bool readSpectrumChunk(unsigned int firstIndex, unsigned int count, unsigned int level, EntityRecord* records, m256i* siblings, m256i& rootDigest)
+{
+    ASSERT(count == (1u << level) && !(firstIndex & (count - 1)));
+    for (unsigned int attempt = 0; attempt < spectrumSiblingsMaxRetries; ++attempt)
+    {
+        const long sequence = spectrumDigestsSequence;
+        if ((sequence & 1) || spectrumDigestTree.anyLeafChanged(firstIndex, firstIndex + count))
+        {
+            _mm_pause();
+            continue;
+        }
+        _mm_lfence();
+
+        copyMem(records, &spectrum[firstIndex], count * sizeof(EntityRecord));
+        spectrumDigestTree.getSubtreeSiblings(firstIndex >> level, level, siblings);
+        rootDigest = spectrumDigestTree.root();
+
+        _mm_lfence();
+        if (spectrumDigestsSequence == sequence && !spectrumDigestTree.anyLeafChanged(firstIndex, firstIndex + count))
+            return true;
+    }
+    return false;
+}
+
+// Copy the digests of count nodes of the given level of the spectrum Merkle tree starting at node firstNode, which need
+// to form a complete subtree of 2^countLevel nodes, together with the siblings of the subtree up to the root
+// (SPECTRUM_DEPTH - level - countLevel digests) and the root digest, for serving state chunk digests to peers. Reads
+// with the seqlock like readSpectrumChunk(). Return false if the nodes are not up to date.
+static bool readSpectrumChunkDigests(unsigned int level, unsigned int firstNode, unsigned int count, unsigned int countLevel, m256i* nodeDigests, m256i* siblings, m256i& rootDigest)
+{
+    ASSERT(count == (1u << countLevel) && !(firstNode & (count - 1)) && level + countLevel <= SPECTRUM_DEPTH);
+    const unsigned long long firstLeaf = (unsigned long long)firstNode << level;
+    const unsigned long long endLeaf = (unsigned long long)(firstNode + count) << level;
+    for (unsigned int attempt = 0; attempt < spectrumSiblingsMaxRetries; ++attempt)
+    {
+        const long sequence = spectrumDigestsSequence;
+        if ((sequence & 1) || spectrumDigestTree.anyLeafChanged(firstLeaf, endLeaf))
+        {
+            _mm_pause();
+            continue;
+        }
+        _mm_lfence();
+
+        for (unsigned int i = 0; i < count; ++i)
+            nodeDigests[i] = spectrumDigestTree.nodeDigest(level, firstNode + i);
+        spectrumDigestTree.getSubtreeSiblings(firstNode >> countLevel, level + countLevel, siblings);
+        rootDigest = spectrumDigestTree.root();
+
+        _mm_lfence();
+        if (spectrumDigestsSequence == sequence && !spectrumDigestTree.anyLeafChanged(firstLeaf, endLeaf))
+            return true;
+    }
+    return false;
+}
+
+// Return true if any of the count spectrum leafs (not necessarily a contiguous range) is flagged as changed
+static bool anySpectrumLeafChanged(const unsigned long long* leafIndices, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (spectrumDigestTree.isLeafChanged(leafIndices[i]))
+            return true;
+    }
+    return false;
+}
+
+// Read part of getSpectrumEntitiesAndMultiproof(), without synchronization
+static unsigned int readSpectrumEntitiesAndMultiproof(const unsigned long long* leafIndices, unsigned long long* workBuffer, unsigned int count, EntityRecord* entities, m256i* siblings)
+{
+    for (unsigned int i = 0; i < count; ++i)
+        copyMem(&entities[i], &spectrum[leafIndices[i]], sizeof(EntityRecord));
+    if (!siblings)
+        return 0;
+    copyMem(workBuffer, leafIndices, count * sizeof(unsigned long long));
+    return spectrumDigestTree.getMultiproofSiblings(workBuffer, count, siblings);
+}
+
+// Copy the records of count spectrum leafs to entities and, if siblings isn't NULL, get their multiproof siblings (see
+// IncrementalMerkleTree::getMultiproofSiblings()) of the last committed spectrum digests, all within one read window of
+// the seqlock spectrumDigestsSequence like getSpectrumEntityAndSiblings(). leafIndices must be sorted in ascending order
+// without duplicates and is kept, workBuffer (count elements) is overwritten. Return number of siblings.
+static unsigned int getSpectrumEntitiesAndMultiproof(const unsigned long long* leafIndices, unsigned long long* workBuffer, unsigned int count, EntityRecord* entities, m256i* siblings)
+{
+    for (unsigned int attempt = 0; attempt < spectrumSiblingsMaxRetries; ++attempt)
+    {
+        const long sequence = spectrumDigestsSequence;
+        if ((sequence & 1) || anySpectrumLeafChanged(leafIndices, count))
+        {
+            _mm_pause();
+            continue;
+        }
+        _mm_lfence();
+
+        const unsigned int siblingCount = readSpectrumEntitiesAndMultiproof(leafIndices, workBuffer, count, entities, siblings);
+
+        _mm_lfence();
+        if (spectrumDigestsSequence == sequence && !anySpectrumLeafChanged(leafIndices, count))
+            return siblingCount;
+    }
+
+    // digests or records are updated continuously (or reading is very slow) -> wait for lock
+    spectrumLock.acquire();
+    const unsigned int siblingCount = readSpectrumEntitiesAndMultiproof(leafIndices, workBuffer, count, entities, siblings);
+    spectrumLock.release();
+    return siblingCount;
+}
+
 // Clean up spectrum hash map, removing all entities with balance 0. Updates spectrumInfo.
 static void reorganizeSpectrum()
 {
@@ -158,7 +678,7 @@ static void reorganizeSpectrum()
 
     unsigned long long spectrumReorgStartTick = __rdtsc();
 
-    EntityRecord* reorgSpectrum = (EntityRecord*)commonBuffers.acquireBuffer(spectrumSizeInBytes);
+    EntityRecord* reorgSpectrum = (EntityRecord*)reorgBuffers.acquireBuffer(spectrumSizeInBytes);
     ASSERT(reorgSpectrum);
     setMem(reorgSpectrum, spectrumSizeInBytes, 0);
     for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
@@ -180,32 +700,23 @@ static void reorganizeSpectrum()
             }
         }
     }
+    _InterlockedIncrement(&spectrumStructureSequence);
     copyMem(spectrum, reorgSpectrum, SPECTRUM_CAPACITY * sizeof(EntityRecord));
-    commonBuffers.releaseBuffer(reorgSpectrum);
-
-    unsigned int digestIndex;
-    for (digestIndex = 0; digestIndex < SPECTRUM_CAPACITY; digestIndex++)
-    {
-        KangarooTwelve64To32(&spectrum[digestIndex], &spectrumDigests[digestIndex]);
-    }
-    unsigned int previousLevelBeginning = 0;
-    unsigned int numberOfLeafs = SPECTRUM_CAPACITY;
-    while (numberOfLeafs > 1)
-    {
-        for (unsigned int i = 0; i < numberOfLeafs; i += 2)
-        {
-            KangarooTwelve64To32(&spectrumDigests[previousLevelBeginning + i], &spectrumDigests[digestIndex++]);
-        }
+    rebuildSpectrumTagsAndBalances();
+    _InterlockedIncrement(&spectrumStructureSequence);
+    reorgBuffers.releaseBuffer(reorgSpectrum);
 
-        previousLevelBeginning += numberOfLeafs;
-        numberOfLeafs >>= 1;
-    }
+    rebuildSpectrumDigests();
+    spectrumReorganizationCount++;
 
     updateSpectrumInfo();
 
     spectrumReorgTotalExecutionTicks += __rdtsc() - spectrumReorgStartTick;
 }
 
+// Return index of entity in spectrum or -1 if not found. Does not acquire spectrumLock. Slots are only filled (never
+// moved or cleared) between reorganizations, so the lookup only needs to be repeated if the structure of the hash
+// map changed concurrently (see spectrumStructureSequence).
 static int spectrumIndex(const m256i& publicKey)
 {
     if (isZero(publicKey))
@@ -213,30 +724,23 @@ static int spectrumIndex(const m256i& publicKey)
         return -1;
     }
 
-    unsigned int index = publicKey.m256i_u32[0] & (SPECTRUM_CAPACITY - 1);
-
-    ACQUIRE(spectrumLock);
-
-iteration:
-    if (spectrum[index].publicKey == publicKey)
-    {
-        RELEASE(spectrumLock);
-
-        return index;
-    }
-    else
+    while (true)
     {
-        if (isZero(spectrum[index].publicKey))
+        const long sequence = spectrumStructureSequence;
+        if (sequence & 1)
         {
-            RELEASE(spectrumLock);
-
-            return -1;
+            _mm_pause();
+            continue;
         }
-        else
-        {
-            index = (index + 1) & (SPECTRUM_CAPACITY - 1);
+        _mm_lfence();
+
+        const unsigned int index = findSpectrumSlot(publicKey);
+        const int result = (index < SPECTRUM_CAPACITY && spectrum[index].publicKey == publicKey) ? index : -1;
 
-            goto iteration;
+        _mm_lfence();
+        if (spectrumStructureSequence == sequence)
+        {
+            return result;
         }
     }
 }
@@ -246,17 +750,19 @@ static long long energy(const int index)
     return spectrum[index].incomingAmount - spectrum[index].outgoingAmount;
 }
 
-// Increase balance of entity.
-static void increaseEnergy(const m256i& publicKey, long long amount)
+// Check if increaseEnergy() may trigger anti-dust burning and reorganization of the spectrum, changing entity indices
+static bool isSpectrumReorganizationPending()
+{
+    return spectrumInfo.numberOfEntities >= (SPECTRUM_CAPACITY / 2) + (SPECTRUM_CAPACITY / 4);
+}
+
+// Increase balance of entity. Caller must hold spectrumLock.
+static void increaseEnergyWithoutLock(const m256i& publicKey, long long amount)
 {
     if (!isZero(publicKey) && amount >= 0)
     {
-        unsigned int index = publicKey.m256i_u32[0] & (SPECTRUM_CAPACITY - 1);
-
-        ACQUIRE(spectrumLock);
-
         // Anti-dust feature: prevent that spectrum fills to more than 75% of capacity to keep hash map lookup fast
-        if (spectrumInfo.numberOfEntities >= (SPECTRUM_CAPACITY / 2) + (SPECTRUM_CAPACITY / 4))
+        if (isSpectrumReorganizationPending())
         {
             // Update anti-dust burn thresholds (and log spectrum stats before burning)
             updateAndAnalzeEntityCategoryPopulations();
@@ -264,54 +770,12 @@ static void increaseEnergy(const m256i& publicKey, long long amount)
             logSpectrumStats();
 #endif
 
-            // Burn the dust and log the burns. The extra scope is needed to make sure that DurstBurnLogger is
-            // destructed (and its common buffer is released) before reorganizeSpectrum() is called.
-            {
+            // Log the burns (the DustBurnLogger's common buffer is released before reorganizeSpectrum() is called)
+            // and burn the dust
 #if LOG_SPECTRUM
-                DustBurnLogger dbl;
+            logSpectrumDustBurns();
 #endif
-
-                if (dustThresholdBurnAll > 0)
-                {
-                    // Burn every balance with balance < dustThresholdBurnAll
-                    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
-                    {
-                        const unsigned long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
-                        if (balance <= dustThresholdBurnAll && balance)
-                        {
-                            spectrum[i].outgoingAmount = spectrum[i].incomingAmount;
-#if LOG_SPECTRUM
-                            dbl.addDustBurn(spectrum[i].publicKey, balance);
-#endif
-                        }
-                    }
-                }
-
-                if (dustThresholdBurnHalf > 0)
-                {
-                    // Burn every second balance with balance < dustThresholdBurnHalf
-                    unsigned int countBurnCanadiates = 0;
-                    for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
-                    {
-                        const unsigned long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
-                        if (balance <= dustThresholdBurnHalf && balance)
-                        {
-                            if (++countBurnCanadiates & 1)
-                            {
-                                spectrum[i].outgoingAmount = spectrum[i].incomingAmount;
-#if LOG_SPECTRUM
-                                dbl.addDustBurn(spectrum[i].publicKey, balance);
-#endif
-                            }
-                        }
-                    }
-                }
-
-#if LOG_SPECTRUM
-                // Finished dust burning (pass message to log)
-                dbl.finished();
-#endif
-            }
+            burnSpectrumDust();
 
             // Remove entries with balance zero from hash map
             reorganizeSpectrum();
@@ -323,101 +787,215 @@ static void increaseEnergy(const m256i& publicKey, long long amount)
 #endif
         }
 
-    iteration:
+        const unsigned int index = findSpectrumSlot(publicKey);
+        ASSERT(index < SPECTRUM_CAPACITY);
         if (spectrum[index].publicKey == publicKey)
         {
             spectrum[index].incomingAmount += amount;
+            spectrumBalances[index] += amount;
             spectrum[index].numberOfIncomingTransfers++;
             spectrum[index].latestIncomingTransferTick = system.tick;
+            spectrumDigestTree.markLeafChanged(index);
 
             spectrumInfo.totalAmount += amount;
         }
         else
         {
-            if (isZero(spectrum[index].publicKey))
-            {
-                spectrum[index].publicKey = publicKey;
-                spectrum[index].incomingAmount = amount;
-                spectrum[index].numberOfIncomingTransfers = 1;
-                spectrum[index].latestIncomingTransferTick = system.tick;
+            // Empty slot -> create entity
+            _InterlockedIncrement(&spectrumStructureSequence);
+            spectrum[index].publicKey = publicKey;
+            spectrumTags[index] = spectrumTag(publicKey);
+            _InterlockedIncrement(&spectrumStructureSequence);
+            spectrum[index].incomingAmount = amount;
+            spectrumBalances[index] = amount;
+            spectrum[index].numberOfIncomingTransfers = 1;
+            spectrum[index].latestIncomingTransferTick = system.tick;
+            spectrumDigestTree.markLeafChanged(index);
 
-                spectrumInfo.numberOfEntities++;
-                spectrumInfo.totalAmount += amount;
+            spectrumInfo.numberOfEntities++;
+            spectrumInfo.totalAmount += amount;
 
 #if LOG_SPECTRUM
-                if ((spectrumInfo.numberOfEntities & 0x7ffff) == 1)
-                {
-                    // Log spectrum stats when the number of entities hits the next half million
-                    // (== 1 is to avoid duplicate when anti-dust is triggered)
-                    updateAndAnalzeEntityCategoryPopulations();
-                    logSpectrumStats();
-                }
-#endif
-            }
-            else
+            if ((spectrumInfo.numberOfEntities & 0x7ffff) == 1)
             {
-                index = (index + 1) & (SPECTRUM_CAPACITY - 1);
-
-                goto iteration;
+                // Log spectrum stats when the number of entities hits the next half million
+                // (== 1 is to avoid duplicate when anti-dust is triggered)
+                updateAndAnalzeEntityCategoryPopulations();
+                logSpectrumStats();
             }
+#endif
         }
+    }
+}
 
-        RELEASE(spectrumLock);
+// Increase balance of entity.
+static void increaseEnergy(const m256i& publicKey, long long amount)
+{
+    if (!isZero(publicKey) && amount >= 0)
+    {
+        spectrumLock.acquire();
+        increaseEnergyWithoutLock(publicKey, amount);
+        spectrumLock.release();
     }
 }
 
+// Increase balances of count entities, acquiring spectrumLock only once.
+static void increaseEnergyOfMany(const m256i* publicKeys, const long long* amounts, unsigned long long count)
+{
+    spectrumLock.acquire();
+    for (unsigned long long i = 0; i < count; ++i)
+    {
+        increaseEnergyWithoutLock(publicKeys[i], amounts[i]);
+    }
+    spectrumLock.release();
+}
+
 // Decrease balance of entity if it is high enough. Does NOT check if index is valid.
-static bool decreaseEnergy(const int index, long long amount)
+// numberOfTransfers is the number of outgoing transfers the amount is the sum of.
+static bool decreaseEnergy(const int index, long long amount, unsigned int numberOfTransfers = 1)
 {
     if (amount >= 0)
     {
-        ACQUIRE(spectrumLock);
+        spectrumLock.acquire();
 
         if (energy(index) >= amount)
         {
             spectrum[index].outgoingAmount += amount;
-            spectrum[index].numberOfOutgoingTransfers++;
+            spectrumBalances[index] -= amount;
+            spectrum[index].numberOfOutgoingTransfers += numberOfTransfers;
             spectrum[index].latestOutgoingTransferTick = system.tick;
+            spectrumDigestTree.markLeafChanged(index);
 
             spectrumInfo.totalAmount -= amount;
 
-            RELEASE(spectrumLock);
+            spectrumLock.release();
 
             return true;
         }
 
-        RELEASE(spectrumLock);
+        spectrumLock.release();
     }
 
     return false;
 }
 
+// Move amount from entity srcIndex to existing entity dstIndex if the balance is high enough, with the same effect on
+// the entity records as decreaseEnergy() followed by increaseEnergy(). Used for executing independent transfers in
+// parallel, so it neither locks nor flags changed leafs of spectrumDigestTree. The caller has to hold spectrumLock,
+// make sure that no other processor accesses the two entities concurrently, and call markLeafChanged() for both
+// entities if true is returned. spectrumInfo doesn't change, because the total amount stays the same.
+static bool transferEnergyWithoutLocking(const int srcIndex, const int dstIndex, long long amount)
+{
+    if (amount >= 0 && energy(srcIndex) >= amount)
+    {
+        spectrum[srcIndex].outgoingAmount += amount;
+        spectrumBalances[srcIndex] -= amount;
+        spectrum[srcIndex].numberOfOutgoingTransfers++;
+        spectrum[srcIndex].latestOutgoingTransferTick = system.tick;
+
+        spectrum[dstIndex].incomingAmount += amount;
+        spectrumBalances[dstIndex] += amount;
+        spectrum[dstIndex].numberOfIncomingTransfers++;
+        spectrum[dstIndex].latestIncomingTransferTick = system.tick;
+
+        return true;
+    }
+    return false;
+}
+
+// Compute tags, balances and optionally leaf digests of spectrum part [begin, end) in bytes that has just been
+// loaded (LoadedPartFunction, context != nullptr means computing leaf digests)
+static void processLoadedSpectrumPart(void* computeLeafDigests, unsigned long long begin, unsigned long long end)
+{
+    begin /= sizeof(EntityRecord);
+    end /= sizeof(EntityRecord);
+    computeSpectrumTagsAndBalances(nullptr, begin, end);
+    if (computeLeafDigests)
+    {
+        computeSpectrumLeafDigests(nullptr, begin, end);
+    }
+}
 
-static bool loadSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR16* directory = nullptr)
+// Load spectrum from file saved in full or sparse format. Tags and balances are computed while loading. If
+// computeDigests is true, the leaf digests are also computed while loading and all digests are up to date afterwards
+// (no need to call rebuildSpectrumDigests()).
+static bool loadSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR16* directory = nullptr, bool computeDigests = false)
 {
     logToConsole(L"Loading spectrum file ...");
-    long long loadedSize = load(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory);
+    _InterlockedIncrement(&spectrumStructureSequence);
+    long long loadedSize = loadAndProcess(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory,
+        processLoadedSpectrumPart, computeDigests ? spectrum : nullptr, spectrumDigestsParallelChunkSize * sizeof(EntityRecord),
+        /*allowShorterFile=*/true);
+    if (loadedSize > 0 && loadedSize < (long long)spectrumSizeInBytes)
+    {
+        // File is shorter than the full spectrum -> sparse format, the tags, balances, and digests computed while
+        // loading are invalid
+        unsigned char* sparseBuffer = (unsigned char*)reorgBuffers.acquireBuffer(loadedSize);
+        ASSERT(sparseBuffer);
+        copyMem(sparseBuffer, spectrum, loadedSize);
+        const bool okay = SpectrumSparseSnapshot::unpack(sparseBuffer, loadedSize, spectrum);
+        reorgBuffers.releaseBuffer(sparseBuffer);
+        if (okay)
+        {
+            rebuildSpectrumTagsAndBalances();
+            _InterlockedIncrement(&spectrumStructureSequence);
+            if (computeDigests)
+            {
+                rebuildSpectrumDigests();
+            }
+            updateSpectrumInfo();
+            return true;
+        }
+        logToConsole(L"Invalid sparse spectrum file");
+    }
     if (loadedSize != SPECTRUM_CAPACITY * sizeof(EntityRecord))
     {
+        rebuildSpectrumTagsAndBalances();
+        _InterlockedIncrement(&spectrumStructureSequence);
+        if (computeDigests)
+        {
+            rebuildSpectrumDigests();
+        }
         logStatusToConsole(L"EFI_FILE_PROTOCOL.Read() reads invalid number of bytes", loadedSize, __LINE__);
 
         return false;
     }
+    _InterlockedIncrement(&spectrumStructureSequence);
+    if (computeDigests)
+    {
+        _InterlockedIncrement(&spectrumDigestsSequence);
+        spectrumDigestTree.rebuildInnerNodes();
+        _InterlockedIncrement(&spectrumDigestsSequence);
+    }
     updateSpectrumInfo();
     return true;
 }
 
+// Save spectrum in sparse format (only non-empty slots, see SparseSnapshot) if that is smaller than the full spectrum,
+// otherwise in full format. Both can be loaded with loadSpectrum(). buffer needs spectrumSizeInBytes. Caller has to
+// acquire spectrumLock. Returns number of bytes written or -1 on error.
+static long long saveSpectrumRecords(const CHAR16* fileName, const CHAR16* directory, unsigned char* buffer)
+{
+    const unsigned long long sparseSize = SpectrumSparseSnapshot::build(spectrum, buffer);
+    const unsigned long long size = sparseSize ? sparseSize : spectrumSizeInBytes;
+    const long long savedSize = save(fileName, size, sparseSize ? buffer : (unsigned char*)spectrum, directory);
+    return (savedSize == (long long)size) ? savedSize : -1;
+}
+
 static bool saveSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR16* directory = nullptr)
 {
     logToConsole(L"Saving spectrum file...");
 
     const unsigned long long beginningTick = __rdtsc();
 
-    ACQUIRE(spectrumLock);
-    long long savedSize = save(fileName, SPECTRUM_CAPACITY * sizeof(EntityRecord), (unsigned char*)spectrum, directory);
-    RELEASE(spectrumLock);
+    unsigned char* buffer = (unsigned char*)reorgBuffers.acquireBuffer(spectrumSizeInBytes);
+    ASSERT(buffer);
+    spectrumLock.acquire();
+    long long savedSize = saveSpectrumRecords(fileName, directory, buffer);
+    spectrumLock.release();
+    reorgBuffers.releaseBuffer(buffer);
 
-    if (savedSize == SPECTRUM_CAPACITY * sizeof(EntityRecord))
+    if (savedSize >= 0)
     {
         setNumber(message, savedSize, TRUE);
         appendText(message, L" bytes of the spectrum data are saved (");
@@ -429,28 +1007,146 @@ static bool saveSpectrum(const CHAR16* fileName = SPECTRUM_FILE_NAME, const CHAR
     return false;
 }
 
+// Save spectrum to node state snapshot: if there is a full spectrum file of the current epoch saved before and not
+// too much changed since then, only a delta of the changed blocks is saved. Otherwise, the full spectrum is saved as
+// new base and an empty delta. Must be loaded with loadSpectrumSnapshot().
+static bool saveSpectrumSnapshot(const CHAR16* baseFileName, const CHAR16* deltaFileName, const CHAR16* directory)
+{
+    PROFILE_SCOPE();
+
+    const unsigned long long beginningTick = __rdtsc();
+
+    unsigned char* deltaBuffer = (unsigned char*)reorgBuffers.acquireBuffer(spectrumSizeInBytes);
+    ASSERT(deltaBuffer);
+    spectrumLock.acquire();
+
+    unsigned long long deltaSize = 0;
+    if (spectrumDeltaSnapshot.hasBase(system.epoch))
+    {
+        deltaSize = spectrumDeltaSnapshot.buildDelta(spectrumDigestTree, spectrum, deltaBuffer);
+    }
+    if (!deltaSize)
+    {
+        // Base needs to be saved -> forget old base in case saving fails (delta buffer is large enough to be used
+        // for building the sparse base before building the delta)
+        spectrumDeltaSnapshot.reset();
+        logToConsole(L"Saving spectrum as base of delta snapshots ...");
+        decltype(spectrumDeltaSnapshot)::DeltaHeader marker;
+        const unsigned long long markerSize = spectrumDeltaSnapshot.buildBaseBeingSavedMarker((unsigned char*)&marker);
+        if (save(deltaFileName, markerSize, (unsigned char*)&marker, directory) != (long long)markerSize
+            || saveSpectrumRecords(baseFileName, directory, deltaBuffer) < 0)
+        {
+            spectrumLock.release();
+            reorgBuffers.releaseBuffer(deltaBuffer);
+            return false;
+        }
+        spectrumDeltaSnapshot.setBase(spectrumDigestTree, system.epoch);
+        deltaSize = spectrumDeltaSnapshot.buildDelta(spectrumDigestTree, spectrum, deltaBuffer);
+    }
+    spectrumLock.release();
+
+    const long long savedSize = save(deltaFileName, deltaSize, deltaBuffer, directory);
+    reorgBuffers.releaseBuffer(deltaBuffer);
+    if (savedSize != (long long)deltaSize)
+    {
+        return false;
+    }
+
+    setNumber(message, savedSize, TRUE);
+    appendText(message, L" bytes of spectrum delta are saved (");
+    appendNumber(message, (__rdtsc() - beginningTick) * 1000000 / frequency, TRUE);
+    appendText(message, L" microseconds).");
+    logToConsole(message);
+    return true;
+}
+
+// Load spectrum from node state snapshot saved with saveSpectrumSnapshot(). A missing delta file is treated as empty
+// delta (snapshot saved before delta snapshots have been introduced).
+static bool loadSpectrumSnapshot(const CHAR16* baseFileName, CHAR16* deltaFileName, CHAR16* directory)
+{
+    if (!loadSpectrum(baseFileName, directory))
+    {
+        return false;
+    }
+
+    const long long deltaSize = getFileSize(deltaFileName, directory);
+    if (deltaSize < 0)
+    {
+        return true;
+    }
+    if (deltaSize > (long long)spectrumDeltaSnapshot.maxDeltaSizeInBytes)
+    {
+        logToConsole(L"Invalid size of spectrum delta file");
+        return false;
+    }
+
+    unsigned char* deltaBuffer = (unsigned char*)reorgBuffers.acquireBuffer(spectrumDeltaSnapshot.maxDeltaSizeInBytes);
+    ASSERT(deltaBuffer);
+    bool okay = load(deltaFileName, deltaSize, deltaBuffer, directory) == deltaSize;
+    if (okay)
+    {
+        _InterlockedIncrement(&spectrumStructureSequence);
+        okay = spectrumDeltaSnapshot.applyDelta(deltaBuffer, deltaSize, spectrum);
+        rebuildSpectrumTagsAndBalances();
+        _InterlockedIncrement(&spectrumStructureSequence);
+    }
+    reorgBuffers.releaseBuffer(deltaBuffer);
+    if (!okay)
+    {
+        logToConsole(L"Failed to load spectrum delta");
+        return false;
+    }
+    updateSpectrumInfo();
+    return true;
+}
+
 static bool initSpectrum()
 {
-    if (!allocPoolWithErrorLog(L"spectrum", spectrumSizeInBytes, (void**)&spectrum, __LINE__)
-        || !allocPoolWithErrorLog(L"spectrumDigests", spectrumDigestsSizeInByte, (void**)&spectrumDigests, __LINE__))
+    if (!allocLargeWithErrorLog(L"spectrum", spectrumSizeInBytes, (void**)&spectrum, __LINE__)
+        || !allocLargeWithErrorLog(L"spectrumDigests", spectrumDigestsSizeInByte, (void**)&spectrumDigests, __LINE__)
+        || !allocLargeWithErrorLog(L"spectrumChangeFlags", spectrumDigestTree.changeFlagsSizeInBytes, (void**)&spectrumChangeFlags, __LINE__)
+        || !allocLargeWithErrorLog(L"spectrumTags", SPECTRUM_CAPACITY, (void**)&spectrumTags, __LINE__)
+        || !allocLargeWithErrorLog(L"spectrumBalances", SPECTRUM_CAPACITY * sizeof(long long), (void**)&spectrumBalances, __LINE__)
+        || !spectrumDeltaSnapshot.init())
     {
         return false;
     }
-    spectrumLock = 0;
+    spectrumDigestTree.init(spectrumDigests, spectrumChangeFlags);
+    spectrumLock.reset();
+    spectrumStructureSequence = 0;
+    spectrumDigestsSequence = 0;
+    spectrumSiblingsCache.reset();
 
     return true;
 }
 
 static void deinitSpectrum()
 {
+    spectrumDigestTree.deinit();
+    spectrumDeltaSnapshot.deinit();
+    if (spectrumBalances)
+    {
+        freeLarge(spectrumBalances, SPECTRUM_CAPACITY * sizeof(long long));
+        spectrumBalances = nullptr;
+    }
+    if (spectrumTags)
+    {
+        freeLarge(spectrumTags, SPECTRUM_CAPACITY);
+        spectrumTags = nullptr;
+    }
+    if (spectrumChangeFlags)
+    {
+        freeLarge(spectrumChangeFlags, spectrumDigestTree.changeFlagsSizeInBytes);
+        spectrumChangeFlags = nullptr;
+    }
     if (spectrumDigests)
     {
-        freePool(spectrumDigests);
+        freeLarge(spectrumDigests, spectrumDigestsSizeInByte);
         spectrumDigests = nullptr;
     }
     if (spectrum)
     {
-        freePool(spectrum);
+        freeLarge(spectrum, spectrumSizeInBytes);
         spectrum = nullptr;
     }
 }
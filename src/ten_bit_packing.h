@@ -0,0 +1,102 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+// Packing of arrays of 10-bit numbers, used for the vote counter and custom mining share counter transactions.
+// Numbers are stored big-endian bitwise: each group of 4 numbers occupies 5 bytes and the first number of a group
+// starts at the most significant bit of the first byte.
+
+// Get number idx from packed data
+static inline unsigned int read10Bit(const unsigned char* data, unsigned int idx)
+{
+    const unsigned int byteIdx = idx + (idx >> 2);
+    const unsigned int shift = 6 - (idx & 3) * 2;
+    return ((((unsigned int)data[byteIdx]) << 8 | data[byteIdx + 1]) >> shift) & 0x3ff;
+}
+
+// Set number idx in packed data, keeping the other numbers
+static inline void write10Bit(unsigned char* data, unsigned int idx, unsigned int value)
+{
+    const unsigned int byteIdx = idx + (idx >> 2);
+    const unsigned int shift = 6 - (idx & 3) * 2;
+    const unsigned int mask = 0x3ff << shift;
+    const unsigned int bits = ((((unsigned int)data[byteIdx]) << 8 | data[byteIdx + 1]) & ~mask) | ((value << shift) & mask);
+    data[byteIdx] = (unsigned char)(bits >> 8);
+    data[byteIdx + 1] = (unsigned char)bits;
+}
+
+// Unpack count numbers from data to values. Reads (count * 10 + 7) / 8 bytes.
+static void unpack10BitArray(const unsigned char* data, unsigned int* values, unsigned int count)
+{
+    // Per 128-bit lane: gather the 2 bytes containing each number as big-endian 16-bit value into the low bytes of
+    // a 32-bit element (lane 0 for numbers 0-3 of 8, lane 1 for numbers 4-7), then shift and mask.
+    const __m256i shuffle = _mm256_setr_epi8(
+        1, 0, -1, -1, 2, 1, -1, -1, 3, 2, -1, -1, 4, 3, -1, -1,
+        6, 5, -1, -1, 7, 6, -1, -1, 8, 7, -1, -1, 9, 8, -1, -1);
+    const __m256i shifts = _mm256_setr_epi32(6, 4, 2, 0, 6, 4, 2, 0);
+    const __m256i mask = _mm256_set1_epi32(0x3ff);
+
+    // 8 numbers per iteration, which are stored in 10 bytes (16 bytes are loaded)
+    const unsigned int packedSize = (count * 10 + 7) / 8;
+    unsigned int i = 0;
+    for (; i + 8 <= count && (i / 8) * 10 + 16 <= packedSize; i += 8)
+    {
+        const __m128i bytes = _mm_loadu_si128((const __m128i*)(data + (i / 8) * 10));
+        __m256i v = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(bytes), shuffle);
+        v = _mm256_and_si256(_mm256_srlv_epi32(v, shifts), mask);
+        _mm256_storeu_si256((__m256i*)(values + i), v);
+    }
+    for (; i < count; i++)
+    {
+        values[i] = read10Bit(data, i);
+    }
+}
+
+// Pack count numbers (each less than 1024) from values to data. Writes (count * 10 + 7) / 8 bytes. If count isn't
+// a multiple of 4, the unused bits of the last byte keep their value.
+static void pack10BitArray(const unsigned int* values, unsigned char* data, unsigned int count)
+{
+    const __m256i mask = _mm256_set1_epi16(0x3ff);
+    const __m256i pairFactors = _mm256_set1_epi32(0x00010400); // 16-bit factors (1024, 1) for (even, odd) number
+    const __m256i low32 = _mm256_set1_epi64x(0xffffffff);
+    // per 128-bit lane: 40-bit groups in the two 64-bit elements to 5 big-endian bytes each
+    const __m256i shuffle = _mm256_setr_epi8(
+        4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1,
+        4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1);
+
+    // 16 numbers per iteration, which are stored in 20 bytes (26 bytes are written, the surplus is overwritten by
+    // next iteration)
+    const unsigned int packedSize = (count * 10 + 7) / 8;
+    unsigned int i = 0;
+    for (; i + 16 <= count && (i / 16) * 20 + 26 <= packedSize; i += 16)
+    {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(values + i));
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(values + i + 8));
+        // 16 x 16-bit in order (packus interleaves the 128-bit lanes)
+        __m256i v = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        v = _mm256_and_si256(v, mask);
+        // 8 x 20-bit pairs (even << 10 | odd)
+        v = _mm256_madd_epi16(v, pairFactors);
+        // 4 x 40-bit groups (pair0 << 20 | pair1)
+        v = _mm256_or_si256(_mm256_slli_epi64(_mm256_and_si256(v, low32), 20), _mm256_srli_epi64(v, 32));
+        v = _mm256_shuffle_epi8(v, shuffle);
+        unsigned char* out = data + (i / 16) * 20;
+        _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)(out + 10), _mm256_extracti128_si256(v, 1));
+    }
+    for (; i + 4 <= count; i += 4)
+    {
+        const unsigned long long group = ((unsigned long long)(values[i] & 0x3ff) << 30) | ((unsigned long long)(values[i + 1] & 0x3ff) << 20)
+            | ((values[i + 2] & 0x3ff) << 10) | (values[i + 3] & 0x3ff);
+        unsigned char* out = data + (i / 4) * 5;
+        out[0] = (unsigned char)(group >> 32);
+        out[1] = (unsigned char)(group >> 24);
+        out[2] = (unsigned char)(group >> 16);
+        out[3] = (unsigned char)(group >> 8);
+        out[4] = (unsigned char)group;
+    }
+    for (; i < count; i++)
+    {
+        write10Bit(data, i, values[i]);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+#include "platform/global_var.h"
+#include "platform/memory_util.h"
+#include "platform/assert.h"
+#include "platform/parallel_jobs.h"
+
+// Phases of the seamless epoch transition (endEpoch(), saving, beginEpoch()) in the tick processor
+enum EpochTransitionPhase
+{
+    EPOCH_TRANSITION_PHASE_WAIT_REQUEST_PROCESSORS = 0, // until all request processors are parked
+    EPOCH_TRANSITION_PHASE_CONTRACT_END_EPOCH,
+    EPOCH_TRANSITION_PHASE_FINISH_IPOS,
+    EPOCH_TRANSITION_PHASE_REVENUE,
+    EPOCH_TRANSITION_PHASE_SPECTRUM_REORG,
+    EPOCH_TRANSITION_PHASE_UNIVERSE_REORG,
+    EPOCH_TRANSITION_PHASE_SAVE_REVENUE,
+    EPOCH_TRANSITION_PHASE_STABLE_COMPUTOR_INDEX,
+    EPOCH_TRANSITION_PHASE_SAVE_SYSTEM,
+    EPOCH_TRANSITION_PHASE_TICK_STORAGE,
+    EPOCH_TRANSITION_PHASE_PENDING_TXS_POOL,
+    EPOCH_TRANSITION_PHASE_SCORE_INIT,
+    EPOCH_TRANSITION_PHASE_LOGGING_RESET,
+    EPOCH_TRANSITION_PHASE_SAVE_FILES, // spectrum, universe, and contract states
+    EPOCH_TRANSITION_PHASE_TOTAL,
+    EPOCH_TRANSITION_PHASE_COUNT
+};
+
+// Durations of the phases of the last epoch transition, for finding the critical path of the network downtime at the
+// end of the epoch. Phases run concurrently with runConcurrentEpochTransitionPhases() are measured individually, so the
+// sum of the phases may exceed the total.
+//
+// Durations are written by the tick processor and its helpers (each phase by one processor only) and may be read by
+// any processor.
+class EpochTransitionStats
+{
+public:
+    void reset()
+    {
+        setMem((void*)phaseTicks, sizeof(phaseTicks), 0);
+    }
+
+    // Set duration of phase to the CPU ticks (TSC) since startTsc. Return current TSC, which can be used as start of
+    // the next phase.
+    unsigned long long endPhase(EpochTransitionPhase phase, unsigned long long startTsc)
+    {
+        ASSERT(phase < EPOCH_TRANSITION_PHASE_COUNT);
+        const unsigned long long now = __rdtsc();
+        phaseTicks[phase] = now - startTsc;
+        return now;
+    }
+
+    // Return duration of phase in CPU ticks (TSC), 0 if the phase hasn't been run yet
+    unsigned long long getPhaseTicks(EpochTransitionPhase phase) const
+    {
+        ASSERT(phase < EPOCH_TRANSITION_PHASE_COUNT);
+        return phaseTicks[phase];
+    }
+
+private:
+    volatile unsigned long long phaseTicks[EPOCH_TRANSITION_PHASE_COUNT];
+};
+
+GLOBAL_VAR_DECL EpochTransitionStats epochTransitionStats;
+
+// Phase of the epoch transition that can run concurrently with other phases touching disjoint data
+struct EpochTransitionTask
+{
+    EpochTransitionPhase phase;
+    void (*function)();
+};
+
+// Jobs for running independent epoch transition phases in parallel. This is separate from parallelJobs, because the
+// phases (such as reorganizing the spectrum) use parallelJobs internally. Request processors help while they are
+// parked in the epoch transition.
+GLOBAL_VAR_DECL ParallelJobs epochTransitionJobs;
+
+// Run tasks [begin, end) and measure their durations (ParallelJobs::ChunkFunction)
+static void runEpochTransitionTasks(void* context, unsigned long long begin, unsigned long long end)
+{
+    const EpochTransitionTask* tasks = (const EpochTransitionTask*)context;
+    for (unsigned long long i = begin; i < end; ++i)
+    {
+        const unsigned long long startTsc = __rdtsc();
+        tasks[i].function();
+        epochTransitionStats.endPhase(tasks[i].phase, startTsc);
+    }
+}
+
+// Run independent phases of the epoch transition concurrently with the help of the parked request processors (or one
+// after another if no helper is available). Returns after all phases are finished.
+static void runConcurrentEpochTransitionPhases(const EpochTransitionTask* tasks, unsigned int count)
+{
+    epochTransitionJobs.run(runEpochTransitionTasks, (void*)tasks, count, 1);
+}
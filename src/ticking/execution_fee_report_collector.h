@@ -40,6 +40,19 @@ if (contractIndex < contractCount)
 return nullptr;
 }
 
+// Return quorum value of the reports received so far in the current phase for a contract, which is the fee that
+// processReports() would deduct at this point. The reports are not changed.
+unsigned long long getQuorumValue(unsigned int contractIndex) const
+{
+if (contractIndex == 0 || contractIndex >= contractCount)
+{
+    return 0;
+}
+unsigned long long reports[NUMBER_OF_COMPUTORS];
+copyMem(reports, executionFeeReports[contractIndex], sizeof(reports));
+return calculateAscendingQuorumValue(reports, NUMBER_OF_COMPUTORS);
+}
+
 bool validateReportEntries(const unsigned int* contractIndices, const unsigned long long* executionFees, unsigned int numEntries)
 {
 for (unsigned int i = 0; i < numEntries; i++)
@@ -3,7 +3,9 @@
 #include "network_messages/transactions.h"
 
 #include "platform/memory_util.h"
+#include "platform/file_io.h"
 #include "platform/concurrency.h"
+#include "platform/spin_lock.h"
 #include "platform/console_logging.h"
 #include "platform/debugging.h"
 
@@ -32,6 +34,11 @@ protected:
     static constexpr unsigned long long tickTransactionsSize =  maxNumTxsTotal * MAX_TRANSACTION_SIZE;
     static constexpr unsigned long long txsDigestsSize = maxNumTxsTotal * sizeof(m256i);
 
+    // Capacity of the digest hash set of each tick (2^N with load factor <= 50%)
+    static constexpr unsigned int txsDigestSetCapacity = NUMBER_OF_TRANSACTIONS_PER_TICK * 2;
+    static constexpr unsigned long long txsDigestSetsSize = PENDING_TXS_POOL_NUM_TICKS * txsDigestSetCapacity * sizeof(unsigned short);
+    static_assert(maxNumTxsPerTick < 0xffff, "Transaction index + 1 must fit into digest set entry");
+
     // `maxNumTxsTotal` priorities have to be saved at a time. Collection capacity has to be 2^N so find the next bigger power of 2.
     static constexpr unsigned long long txsPrioritiesCapacity = math_lib::findNextPowerOf2(maxNumTxsTotal);
 
@@ -44,6 +51,11 @@ protected:
     // Allocated txsDigests buffer with maxNumTxs elements
     inline static m256i* txsDigestsBuffer = nullptr;
 
+    // Allocated hash sets of transaction digests for each tick (txsDigestSetCapacity entries per tick). An entry is
+    // the transaction index + 1 (0 means empty slot), the digest is stored in txsDigestsBuffer. Open addressing
+    // with linear probing, starting at the slot given by the first 32 bits of the digest.
+    inline static unsigned short* txsDigestSetsBuffer = nullptr;
+
     // Records the number of saved transactions for each tick
     inline static unsigned int numSavedTxsPerTick[PENDING_TXS_POOL_NUM_TICKS];
 
@@ -52,13 +64,99 @@ protected:
     inline static unsigned int buffersBeginIndex = 0;
 
     // Lock for securing the data in the PendingTxsPool
-    inline static volatile char lock = 0;
-
-    // Priority queues for transactions in each saved tick
-    inline static Collection<unsigned int, txsPrioritiesCapacity>* txsPriorities;
+    inline static SpinLock<> lock;
+
+    // Priority queues for transactions in each saved tick (self-balancing, because the node-local tree layout isn't
+    // part of any digest and priorities of many transactions are similar)
+    inline static Collection<unsigned int, txsPrioritiesCapacity, true>* txsPriorities;
+
+    // Scratchpad for rebuilding txsPriorities, so request processors don't wait for commonBuffers used by contracts
+    inline static CommonBuffers scratchpadBuffers;
+
+    // Index of the txs in the per-tick buffers by source public key, for updating the priorities of the txs of changed
+    // entities. The hash set stores the position + 1 of the first tx of each source (0 means empty slot, position is
+    // tickIndex * maxNumTxsPerTick + txIndex), open addressing with linear probing starting at the slot given by the
+    // first 32 bits of the public key. The txs of each source form a doubly linked list (position + 1, 0 = none).
+    static constexpr unsigned long long txsOfSourceSetCapacity = math_lib::findNextPowerOf2(maxNumTxsTotal * 2);
+    static constexpr unsigned long long txsOfSourceSetSize = txsOfSourceSetCapacity * sizeof(unsigned int);
+    static constexpr unsigned long long txsOfSourceListSize = maxNumTxsTotal * sizeof(unsigned int);
+    static_assert(maxNumTxsTotal < 0xffffffff, "Tx position + 1 must fit into source index entries");
+    inline static unsigned int* txsOfSourceSet = nullptr;
+    inline static unsigned int* nextTxOfSource = nullptr;
+    inline static unsigned int* prevTxOfSource = nullptr;
+
+    // Snapshot of the entities changed in the last tick taken by collectChangedEntities() while holding spectrumLock,
+    // so updateTxsPrioritiesOfChangedEntities() can run without it. Public keys and priority inputs are stored in
+    // separate arrays, the public keys are indexed by a hash set with the layout of the digest sets. If more entities
+    // changed or the spectrum has been reorganized, allEntitiesChanged is set and all priorities are recomputed.
+    struct ChangedEntity
+    {
+        sint64 balance;
+        unsigned int latestTransferTick;
+    };
+    static constexpr unsigned int changedEntitiesSetCapacity = 1 << 16;
+    static constexpr unsigned int maxNumChangedEntities = changedEntitiesSetCapacity / 2;
+    inline static m256i* changedEntityKeys = nullptr;
+    inline static ChangedEntity* changedEntities = nullptr;
+    inline static unsigned short changedEntitiesSet[changedEntitiesSetCapacity];
+    inline static unsigned int numChangedEntities = 0;
+    inline static bool allEntitiesChanged = true;
+    inline static unsigned int lastSpectrumReorganizationCount = 0;
+
+    // Ticks with txs of changed entities, set in updateTxsPrioritiesOfChangedEntities()
+    inline static bool tickHasChangedEntity[PENDING_TXS_POOL_NUM_TICKS];
+
+    // Far-future store for the ticks [firstStoredTick + PENDING_TXS_POOL_NUM_TICKS, + PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS[.
+    // Instead of reserving maxNumTxsPerTick slots per tick, these ticks share farFutureMaxTxs slots. The txs of a tick
+    // form a linked list starting at farFutureFirstTx[tick % PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS], which is unique
+    // within the range. Priorities are computed when a tick enters the storage window and its txs are moved into the
+    // per-tick buffers above (see promoteFarFutureTxs()).
+    static constexpr unsigned int farFutureMaxTxs = PENDING_TXS_POOL_FAR_FUTURE_MAX_TXS;
+    static constexpr unsigned int farFutureDigestSetCapacity = (unsigned int)math_lib::findNextPowerOf2(farFutureMaxTxs * 2);
+    static_assert(farFutureMaxTxs < 0xffff, "Far-future tx index + 1 must fit into digest set and list entries");
+    static constexpr unsigned long long farFutureTxsSize = farFutureMaxTxs * MAX_TRANSACTION_SIZE;
+    static constexpr unsigned long long farFutureDigestsSize = farFutureMaxTxs * sizeof(m256i);
+
+    // Allocated buffers with farFutureMaxTxs transactions and digests
+    inline static unsigned char* farFutureTxsBuffer = nullptr;
+    inline static m256i* farFutureDigestsBuffer = nullptr;
+
+    // Hash set of far-future tx digests (same layout as the per-tick digest sets)
+    inline static unsigned short farFutureDigestSet[farFutureDigestSetCapacity];
+
+    // Index + 1 of the first tx of each far-future tick, the next tx of each tx, and the first free tx (0 = none).
+    // Free txs are linked with farFutureNextTx as well.
+    inline static unsigned short farFutureFirstTx[PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS];
+    inline static unsigned short farFutureNextTx[farFutureMaxTxs];
+    inline static unsigned int farFutureFreeTx = 0;
+
+    // Number of txs of each far-future tick (at most maxNumTxsPerTick) and of all far-future ticks
+    inline static unsigned int farFutureNumTxsPerTick[PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS];
+    inline static unsigned int farFutureNumTxs = 0;
+
+    // Priority of each far-future tx when it was added, used for evicting the tx with the lowest priority if the tick
+    // or the whole far-future store is full
+    inline static sint64 farFuturePriorities[farFutureMaxTxs];
+
+    // Header of the file written by saveToFile(), followed by txCount records of transaction digest and transaction.
+    // Records are padded to 32 bytes, so digests and transactions can be used in place after loading.
+    struct SnapshotHeader
+    {
+        unsigned int firstStoredTick;
+        unsigned int txCount;
+        unsigned long long dataSize;
+        unsigned long long reserved[2];
+    };
+    static_assert(sizeof(SnapshotHeader) == 32, "Records following the header must be aligned to 32 bytes");
+
+    inline static constexpr unsigned long long snapshotRecordSize(unsigned long long transactionSize)
+    {
+        return sizeof(m256i) + ((transactionSize + 31) & ~31ULL);
+    }
 
     static void cleanupTxsPriorities(unsigned int tickIndex)
     {
+        ScopedScratchpadPool scratchpadPool(scratchpadBuffers);
         sint64 elementIndex = txsPriorities->headIndex(m256i{ tickIndex, 0, 0, 0 });
         // use a `for` instead of a `while` loop to make sure it cannot run forever 
         // there can be at most `maxNumTxsPerTick` elements in one pov
@@ -72,37 +170,40 @@ protected:
         txsPriorities->cleanupIfNeeded();
     }
 
-    static sint64 calculateTxPriority(const Transaction* tx)
+    // Return priority of tx whose source entity has the given balance and latestTransferTick, which is
+    // latestOutgoingTransferTick if > 0 and latestIncomingTransferTick otherwise (new entity).
+    static sint64 calculateTxPriority(const Transaction* tx, sint64 balance, unsigned int latestTransferTick)
     {
         sint64 priority = 0;
-        int sourceIndex = spectrumIndex(tx->sourcePublicKey);
-        if (sourceIndex >= 0)
+        if (balance > 0)
         {
-            sint64 balance = energy(sourceIndex);
-            if (balance > 0)
+            if (isZero(tx->destinationPublicKey) && tx->amount == 0LL
+                && (tx->inputType == VOTE_COUNTER_INPUT_TYPE || tx->inputType == CustomMiningSolutionTransaction::transactionType() || tx->inputType == ExecutionFeeReportTransactionPrefix::transactionType()))
             {
-                if (isZero(tx->destinationPublicKey) && tx->amount == 0LL
-                    && (tx->inputType == VOTE_COUNTER_INPUT_TYPE || tx->inputType == CustomMiningSolutionTransaction::transactionType() || tx->inputType == ExecutionFeeReportTransactionPrefix::transactionType()))
-                {
-                    // protocol-level tx always have max priority
-                    return INT64_MAX;
-                }
-                else
-                {
-                    // Calculate tx priority as: [balance of src] * [scheduledTick - latestTransferTick + 1] with
-                    // latestTransferTick = latestOutgoingTransferTick   if latestOutgoingTransferTick > 0,
-                    // latestTransferTick = latestIncomingTransferTick   otherwise (new entity).
-                    const EntityRecord& entity = spectrum[sourceIndex];
-                    const unsigned int latestTransferTick = (entity.latestOutgoingTransferTick) ? entity.latestOutgoingTransferTick : entity.latestIncomingTransferTick;
-                    priority = math_lib::smul(balance, static_cast<sint64>(tx->tick - latestTransferTick + 1));
-                    // decrease by 1 to make sure no normal tx reaches max priority
-                    priority--;
-                }
+                // protocol-level tx always have max priority
+                return INT64_MAX;
+            }
+            else
+            {
+                // Calculate tx priority as: [balance of src] * [scheduledTick - latestTransferTick + 1]
+                priority = math_lib::smul(balance, static_cast<sint64>(tx->tick - latestTransferTick + 1));
+                // decrease by 1 to make sure no normal tx reaches max priority
+                priority--;
             }
         }
         return priority;
     }
 
+    static sint64 calculateTxPriority(const Transaction* tx)
+    {
+        int sourceIndex = spectrumIndex(tx->sourcePublicKey);
+        if (sourceIndex < 0)
+            return 0;
+        const EntityRecord& entity = spectrum[sourceIndex];
+        const unsigned int latestTransferTick = (entity.latestOutgoingTransferTick) ? entity.latestOutgoingTransferTick : entity.latestIncomingTransferTick;
+        return calculateTxPriority(tx, energy(sourceIndex), latestTransferTick);
+    }
+
     // Return pointer to Transaction based on tickIndex and transactionIndex (checking offset with ASSERT)
     inline static Transaction* getTxPtr(unsigned int tickIndex, unsigned int transactionIndex)
     {
@@ -119,6 +220,168 @@ protected:
         return &txsDigestsBuffer[tickIndex * maxNumTxsPerTick + transactionIndex];
     }
 
+    // Return pointer to digest set of tick based on tickIndex
+    inline static unsigned short* getDigestSetPtr(unsigned int tickIndex)
+    {
+        ASSERT(tickIndex < PENDING_TXS_POOL_NUM_TICKS);
+        return &txsDigestSetsBuffer[tickIndex * txsDigestSetCapacity];
+    }
+
+    // Return index of digest in digest set or notFound. A digest set is a hash set with capacity 2^N, whose entries
+    // are indices + 1 into the array digests (0 means empty slot). Open addressing with linear probing, starting at the
+    // slot given by the first 32 bits of the digest.
+    static unsigned int findInDigestSet(const unsigned short* digestSet, unsigned int capacity, const m256i* digests, const m256i& digest, unsigned int notFound)
+    {
+        unsigned int slot = digest.m256i_u32[0] & (capacity - 1);
+        while (digestSet[slot])
+        {
+            const unsigned int index = digestSet[slot] - 1;
+            if (digests[index] == digest)
+                return index;
+            slot = (slot + 1) & (capacity - 1);
+        }
+        return notFound;
+    }
+
+    // Add index to digest set (digests[index] must have been stored before)
+    static void insertIntoDigestSet(unsigned short* digestSet, unsigned int capacity, const m256i* digests, unsigned int index)
+    {
+        unsigned int slot = digests[index].m256i_u32[0] & (capacity - 1);
+        while (digestSet[slot])
+            slot = (slot + 1) & (capacity - 1);
+        digestSet[slot] = (unsigned short)(index + 1);
+    }
+
+    // Remove index from digest set (before digests[index] is overwritten). Following entries are shifted back to close
+    // the gap, so lookups don't need tombstones.
+    static void eraseFromDigestSet(unsigned short* digestSet, unsigned int capacity, const m256i* digests, unsigned int index)
+    {
+        unsigned int hole = digests[index].m256i_u32[0] & (capacity - 1);
+        while (digestSet[hole] != index + 1)
+        {
+            ASSERT(digestSet[hole]);
+            hole = (hole + 1) & (capacity - 1);
+        }
+        digestSet[hole] = 0;
+
+        for (unsigned int slot = (hole + 1) & (capacity - 1); digestSet[slot]; slot = (slot + 1) & (capacity - 1))
+        {
+            // move entry into hole if the hole is between its home slot and its current slot
+            const unsigned int homeSlot = digests[digestSet[slot] - 1].m256i_u32[0] & (capacity - 1);
+            if (((slot - homeSlot) & (capacity - 1)) >= ((slot - hole) & (capacity - 1)))
+            {
+                digestSet[hole] = digestSet[slot];
+                digestSet[slot] = 0;
+                hole = slot;
+            }
+        }
+    }
+
+    // Return index of transaction with digest in tick or maxNumTxsPerTick if not found. Caller has to acquire lock.
+    static unsigned int findTxIndex(unsigned int tickIndex, const m256i& digest)
+    {
+        return findInDigestSet(getDigestSetPtr(tickIndex), txsDigestSetCapacity, getDigestPtr(tickIndex, 0), digest, maxNumTxsPerTick);
+    }
+
+    // Add transaction to digest set of tick (digest must have been stored before). Caller has to acquire lock.
+    static void addToDigestSet(unsigned int tickIndex, unsigned int txIndex)
+    {
+        ASSERT(txIndex < maxNumTxsPerTick);
+        insertIntoDigestSet(getDigestSetPtr(tickIndex), txsDigestSetCapacity, getDigestPtr(tickIndex, 0), txIndex);
+    }
+
+    // Remove transaction from digest set of tick (before its digest is overwritten). Caller has to acquire lock.
+    static void removeFromDigestSet(unsigned int tickIndex, unsigned int txIndex)
+    {
+        ASSERT(txIndex < maxNumTxsPerTick);
+        eraseFromDigestSet(getDigestSetPtr(tickIndex), txsDigestSetCapacity, getDigestPtr(tickIndex, 0), txIndex);
+    }
+
+    // Reset digest sets of tick indices [beginTickIndex, endTickIndex)
+    static void clearDigestSets(unsigned int beginTickIndex, unsigned int endTickIndex)
+    {
+        ASSERT(beginTickIndex <= endTickIndex && endTickIndex <= PENDING_TXS_POOL_NUM_TICKS);
+        setMem(txsDigestSetsBuffer + beginTickIndex * txsDigestSetCapacity, (endTickIndex - beginTickIndex) * txsDigestSetCapacity * sizeof(unsigned short), 0);
+    }
+
+    // Return source public key of tx at position in the per-tick buffers
+    inline static const m256i& getSourceOfTx(unsigned long long position)
+    {
+        ASSERT(position < maxNumTxsTotal);
+        return ((const Transaction*)(tickTransactionsBuffer + position * MAX_TRANSACTION_SIZE))->sourcePublicKey;
+    }
+
+    // Return slot of source in txsOfSourceSet or the empty slot where it would be inserted. Caller has to acquire lock.
+    static unsigned long long findSourceSlot(const m256i& source)
+    {
+        unsigned long long slot = source.m256i_u32[0] & (txsOfSourceSetCapacity - 1);
+        while (txsOfSourceSet[slot] && getSourceOfTx(txsOfSourceSet[slot] - 1) != source)
+            slot = (slot + 1) & (txsOfSourceSetCapacity - 1);
+        return slot;
+    }
+
+    // Add stored tx to the index of txs by source. Caller has to acquire lock.
+    static void addToSourceIndex(unsigned int tickIndex, unsigned int txIndex)
+    {
+        ASSERT(txIndex < maxNumTxsPerTick);
+        const unsigned int position = tickIndex * maxNumTxsPerTick + txIndex;
+        const unsigned long long slot = findSourceSlot(getSourceOfTx(position));
+        nextTxOfSource[position] = txsOfSourceSet[slot];
+        prevTxOfSource[position] = 0;
+        if (txsOfSourceSet[slot])
+            prevTxOfSource[txsOfSourceSet[slot] - 1] = position + 1;
+        txsOfSourceSet[slot] = position + 1;
+    }
+
+    // Remove tx from the index of txs by source (before it is overwritten). Caller has to acquire lock.
+    static void removeFromSourceIndex(unsigned int tickIndex, unsigned int txIndex)
+    {
+        ASSERT(txIndex < maxNumTxsPerTick);
+        const unsigned int position = tickIndex * maxNumTxsPerTick + txIndex;
+        const unsigned int next = nextTxOfSource[position];
+        const unsigned int prev = prevTxOfSource[position];
+        if (next)
+            prevTxOfSource[next - 1] = prev;
+        if (prev)
+        {
+            nextTxOfSource[prev - 1] = next;
+            return;
+        }
+
+        // tx is the first of its source
+        unsigned long long hole = findSourceSlot(getSourceOfTx(position));
+        ASSERT(txsOfSourceSet[hole] == position + 1);
+        if (next)
+        {
+            txsOfSourceSet[hole] = next;
+            return;
+        }
+
+        // last tx of source -> remove from hash set, shifting following entries back like in eraseFromDigestSet()
+        txsOfSourceSet[hole] = 0;
+        for (unsigned long long slot = (hole + 1) & (txsOfSourceSetCapacity - 1); txsOfSourceSet[slot]; slot = (slot + 1) & (txsOfSourceSetCapacity - 1))
+        {
+            const unsigned long long homeSlot = getSourceOfTx(txsOfSourceSet[slot] - 1).m256i_u32[0] & (txsOfSourceSetCapacity - 1);
+            if (((slot - homeSlot) & (txsOfSourceSetCapacity - 1)) >= ((slot - hole) & (txsOfSourceSetCapacity - 1)))
+            {
+                txsOfSourceSet[hole] = txsOfSourceSet[slot];
+                txsOfSourceSet[slot] = 0;
+                hole = slot;
+            }
+        }
+    }
+
+    // Remove all txs of tick indices [beginTickIndex, endTickIndex) from the index of txs by source (before the
+    // ticks are cleared). Caller has to acquire lock.
+    static void removeTicksFromSourceIndex(unsigned int beginTickIndex, unsigned int endTickIndex)
+    {
+        for (unsigned int tickIndex = beginTickIndex; tickIndex < endTickIndex; ++tickIndex)
+        {
+            for (unsigned int txIndex = 0; txIndex < numSavedTxsPerTick[tickIndex]; ++txIndex)
+                removeFromSourceIndex(tickIndex, txIndex);
+        }
+    }
+
     // Check whether tick is stored in the pending txs pool
     inline static bool tickInStorage(unsigned int tick)
     {
@@ -131,25 +394,388 @@ protected:
         return ((tick - firstStoredTick) + buffersBeginIndex) % PENDING_TXS_POOL_NUM_TICKS;
     }
 
+    // Add tx with digest and priority > 0 to tick, which must not contain the tx yet. If the tick is full, the tx
+    // replaces the tx with the lowest priority if its priority is higher. Return whether tx was added. Caller has to
+    // acquire lock.
+    static bool addToTick(unsigned int tickIndex, const Transaction* tx, unsigned int transactionSize, const m256i& digest, sint64 priority)
+    {
+        m256i povIndex{ tickIndex, 0, 0, 0 };
+
+        if (numSavedTxsPerTick[tickIndex] < maxNumTxsPerTick)
+        {
+            copyMem(getDigestPtr(tickIndex, numSavedTxsPerTick[tickIndex]), &digest, sizeof(m256i));
+            copyMem(getTxPtr(tickIndex, numSavedTxsPerTick[tickIndex]), tx, transactionSize);
+            addToDigestSet(tickIndex, numSavedTxsPerTick[tickIndex]);
+            addToSourceIndex(tickIndex, numSavedTxsPerTick[tickIndex]);
+            txsPriorities->add(povIndex, numSavedTxsPerTick[tickIndex], priority);
+
+            numSavedTxsPerTick[tickIndex]++;
+            return true;
+        }
+        else
+        {
+            // check if priority is higher than lowest priority tx in this tick and replace in this case
+            sint64 lowestElementIndex = txsPriorities->tailIndex(povIndex);
+            if (lowestElementIndex != NULL_INDEX)
+            {
+                if (txsPriorities->priority(lowestElementIndex) < priority)
+                {
+                    unsigned int replacedTxIndex = txsPriorities->element(lowestElementIndex);
+                    txsPriorities->remove(lowestElementIndex);
+                    txsPriorities->add(povIndex, replacedTxIndex, priority);
+
+                    removeFromDigestSet(tickIndex, replacedTxIndex);
+                    removeFromSourceIndex(tickIndex, replacedTxIndex);
+                    copyMem(getDigestPtr(tickIndex, replacedTxIndex), &digest, sizeof(m256i));
+                    copyMem(getTxPtr(tickIndex, replacedTxIndex), tx, transactionSize);
+                    addToDigestSet(tickIndex, replacedTxIndex);
+                    addToSourceIndex(tickIndex, replacedTxIndex);
+
+                    return true;
+                }
+#if !defined(NDEBUG) && !defined(NO_UEFI) && 0
+                else
+                {
+                    CHAR16 dbgMsgBuf[300];
+                    setText(dbgMsgBuf, L"tx could not be added, already saved ");
+                    appendNumber(dbgMsgBuf, numSavedTxsPerTick[tickIndex], FALSE);
+                    appendText(dbgMsgBuf, L" txs for tick ");
+                    appendNumber(dbgMsgBuf, tx->tick, FALSE);
+                    appendText(dbgMsgBuf, L" and priority ");
+                    appendNumber(dbgMsgBuf, priority, FALSE);
+                    appendText(dbgMsgBuf, L" is lower than lowest saved priority ");
+                    appendNumber(dbgMsgBuf, txsPriorities->priority(lowestElementIndex), FALSE);
+                    addDebugMessage(dbgMsgBuf);
+                }
+#endif      
+            }
+#if !defined(NDEBUG) && !defined(NO_UEFI)
+            else
+            {
+                // debug log, this should never happen
+                CHAR16 dbgMsgBuf[300];
+                setText(dbgMsgBuf, L"maximum number of txs ");
+                appendNumber(dbgMsgBuf, numSavedTxsPerTick[tickIndex], FALSE);
+                appendText(dbgMsgBuf, L" saved for tick ");
+                appendNumber(dbgMsgBuf, tx->tick, FALSE);
+                appendText(dbgMsgBuf, L" but povIndex is unknown. This should never happen.");
+                addDebugMessage(dbgMsgBuf);
+            }
+#endif
+        }
+        return false;
+    }
+
+    // Recompute priorities of the txs of tick whose source entity changed (all txs if allEntitiesChanged), then rebuild
+    // the priority queue and digest set of the tick, compacting out txs whose priority dropped to 0. Caller has to
+    // acquire lock (and spectrumLock if allEntitiesChanged).
+    static void updateTickTxsPriorities(unsigned int tickIndex)
+    {
+        sint64 priorities[maxNumTxsPerTick];
+        bool entityChanged[maxNumTxsPerTick];
+
+        const unsigned int numSavedForTick = numSavedTxsPerTick[tickIndex];
+        bool anyEntityChanged = false;
+        bool anyTxEvicted = false;
+        for (unsigned int txIndex = 0; txIndex < numSavedForTick; ++txIndex)
+        {
+            const Transaction* tx = getTxPtr(tickIndex, txIndex);
+            if (allEntitiesChanged)
+            {
+                entityChanged[txIndex] = true;
+                priorities[txIndex] = calculateTxPriority(tx);
+            }
+            else
+            {
+                const unsigned int entityIndex = findInDigestSet(changedEntitiesSet, changedEntitiesSetCapacity, changedEntityKeys, tx->sourcePublicKey, maxNumChangedEntities);
+                entityChanged[txIndex] = entityIndex < maxNumChangedEntities;
+                if (entityChanged[txIndex])
+                    priorities[txIndex] = calculateTxPriority(tx, changedEntities[entityIndex].balance, changedEntities[entityIndex].latestTransferTick);
+            }
+            if (entityChanged[txIndex])
+            {
+                anyEntityChanged = true;
+                anyTxEvicted |= (priorities[txIndex] <= 0);
+            }
+        }
+        if (!anyEntityChanged)
+            return;
+
+        // keep priorities of other txs
+        m256i povIndex{ tickIndex, 0, 0, 0 };
+        for (sint64 elementIndex = txsPriorities->headIndex(povIndex); elementIndex != NULL_INDEX; elementIndex = txsPriorities->nextElementIndex(elementIndex))
+        {
+            const unsigned int txIndex = txsPriorities->element(elementIndex);
+            if (!entityChanged[txIndex])
+                priorities[txIndex] = txsPriorities->priority(elementIndex);
+        }
+
+        // rebuild priority queue and digest set of tick, compacting the remaining txs (which moves them in the source index)
+        cleanupTxsPriorities(tickIndex);
+        clearDigestSets(tickIndex, tickIndex + 1);
+        if (anyTxEvicted)
+            removeTicksFromSourceIndex(tickIndex, tickIndex + 1);
+        unsigned int numKeptTxs = 0;
+        for (unsigned int txIndex = 0; txIndex < numSavedForTick; ++txIndex)
+        {
+            if (priorities[txIndex] <= 0)
+                continue;
+            if (numKeptTxs != txIndex)
+            {
+                copyMem(getDigestPtr(tickIndex, numKeptTxs), getDigestPtr(tickIndex, txIndex), sizeof(m256i));
+                copyMem(getTxPtr(tickIndex, numKeptTxs), getTxPtr(tickIndex, txIndex), MAX_TRANSACTION_SIZE);
+            }
+            addToDigestSet(tickIndex, numKeptTxs);
+            if (anyTxEvicted)
+                addToSourceIndex(tickIndex, numKeptTxs);
+            txsPriorities->add(povIndex, numKeptTxs, priorities[txIndex]);
+            ++numKeptTxs;
+        }
+
+        // set memory of evicted txs to 0
+        const unsigned int numEvictedTxs = numSavedForTick - numKeptTxs;
+        if (numEvictedTxs)
+        {
+            setMem(getTxPtr(tickIndex, numKeptTxs), numEvictedTxs * MAX_TRANSACTION_SIZE, 0);
+            setMem(getDigestPtr(tickIndex, numKeptTxs), numEvictedTxs * sizeof(m256i), 0);
+            numSavedTxsPerTick[tickIndex] = numKeptTxs;
+        }
+    }
+
+    // Check whether tick is stored in the far-future store
+    inline static bool tickInFarFutureStorage(unsigned int tick)
+    {
+        return tick >= firstStoredTick + PENDING_TXS_POOL_NUM_TICKS
+            && tick < firstStoredTick + PENDING_TXS_POOL_NUM_TICKS + PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS;
+    }
+
+    // Return index of far-future tick in farFutureFirstTx and farFutureNumTxsPerTick (does not check tick)
+    inline static unsigned int tickToFarFutureIndex(unsigned int tick)
+    {
+        return tick % PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS;
+    }
+
+    // Return pointer to far-future Transaction based on txIndex (checking offset with ASSERT)
+    inline static Transaction* getFarFutureTxPtr(unsigned int txIndex)
+    {
+        ASSERT(txIndex < farFutureMaxTxs);
+        return (Transaction*)(farFutureTxsBuffer + txIndex * MAX_TRANSACTION_SIZE);
+    }
+
+    // Remove all txs from far-future store. Caller has to acquire lock.
+    static void resetFarFutureStorage()
+    {
+        setMem(farFutureDigestSet, sizeof(farFutureDigestSet), 0);
+        setMem(farFutureFirstTx, sizeof(farFutureFirstTx), 0);
+        setMem(farFutureNumTxsPerTick, sizeof(farFutureNumTxsPerTick), 0);
+        for (unsigned int txIndex = 0; txIndex < farFutureMaxTxs; ++txIndex)
+            farFutureNextTx[txIndex] = (unsigned short)((txIndex + 1 < farFutureMaxTxs) ? txIndex + 2 : 0);
+        farFutureFreeTx = 1;
+        farFutureNumTxs = 0;
+    }
+
+    // Add tx with digest to far-future store if it isn't known yet and there is space left, both in total and for its
+    // tick (maxNumTxsPerTick, so all txs fit when the tick enters the storage window). Caller has to acquire lock.
+    // Position of a far-future tx in the list of its tick (index + 1 of the tx and of its predecessor, 0 = none)
+    struct FarFutureTxPosition
+    {
+        unsigned int farTickIndex;
+        unsigned int prevTx;
+        unsigned int tx;
+        sint64 priority;
+    };
+
+    // Update lowest with the tx of lowest priority in the list of the far-future tick if it is lower. Caller has to
+    // acquire lock.
+    static void findLowestPriorityFarFutureTx(unsigned int farTickIndex, FarFutureTxPosition& lowest)
+    {
+        unsigned int prevTx = 0;
+        for (unsigned int nextTx = farFutureFirstTx[farTickIndex]; nextTx; prevTx = nextTx, nextTx = farFutureNextTx[nextTx - 1])
+        {
+            if (!lowest.tx || farFuturePriorities[nextTx - 1] < lowest.priority)
+                lowest = { farTickIndex, prevTx, nextTx, farFuturePriorities[nextTx - 1] };
+        }
+    }
+
+    // Add far-future tx to the list of free txs. The tx must have been unlinked from the list of its tick. Caller has
+    // to acquire lock.
+    static void freeFarFutureTx(unsigned int txIndex)
+    {
+        eraseFromDigestSet(farFutureDigestSet, farFutureDigestSetCapacity, farFutureDigestsBuffer, txIndex);
+        farFutureNextTx[txIndex] = (unsigned short)farFutureFreeTx;
+        farFutureFreeTx = txIndex + 1;
+        farFutureNumTxs--;
+    }
+
+    // Add tx with digest and priority > 0 to the far-future store. If its tick or the store is full, the tx replaces
+    // the tx with the lowest priority in the tick or the store if its priority is higher, so the store cannot be
+    // blocked by spamming it first. Return whether tx was added. Caller has to acquire lock.
+    static bool addToFarFuture(const Transaction* tx, unsigned int transactionSize, const m256i& digest, sint64 priority)
+    {
+        const unsigned int farTickIndex = tickToFarFutureIndex(tx->tick);
+        if (findInDigestSet(farFutureDigestSet, farFutureDigestSetCapacity, farFutureDigestsBuffer, digest, farFutureMaxTxs) < farFutureMaxTxs)
+            return false;
+
+        if (!farFutureFreeTx || farFutureNumTxsPerTick[farTickIndex] >= maxNumTxsPerTick)
+        {
+            FarFutureTxPosition lowest{};
+            if (farFutureNumTxsPerTick[farTickIndex] >= maxNumTxsPerTick)
+            {
+                findLowestPriorityFarFutureTx(farTickIndex, lowest);
+            }
+            else
+            {
+                for (unsigned int i = 0; i < PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS; ++i)
+                    findLowestPriorityFarFutureTx(i, lowest);
+            }
+            if (!lowest.tx || lowest.priority >= priority)
+                return false;
+
+            const unsigned int evictedTx = lowest.tx - 1;
+            if (lowest.prevTx)
+                farFutureNextTx[lowest.prevTx - 1] = farFutureNextTx[evictedTx];
+            else
+                farFutureFirstTx[lowest.farTickIndex] = farFutureNextTx[evictedTx];
+            farFutureNumTxsPerTick[lowest.farTickIndex]--;
+            freeFarFutureTx(evictedTx);
+        }
+
+        const unsigned int txIndex = farFutureFreeTx - 1;
+        farFutureFreeTx = farFutureNextTx[txIndex];
+        copyMem(&farFutureDigestsBuffer[txIndex], &digest, sizeof(m256i));
+        copyMem(getFarFutureTxPtr(txIndex), tx, transactionSize);
+        insertIntoDigestSet(farFutureDigestSet, farFutureDigestSetCapacity, farFutureDigestsBuffer, txIndex);
+        farFuturePriorities[txIndex] = priority;
+
+        farFutureNextTx[txIndex] = farFutureFirstTx[farTickIndex];
+        farFutureFirstTx[farTickIndex] = (unsigned short)(txIndex + 1);
+        farFutureNumTxsPerTick[farTickIndex]++;
+        farFutureNumTxs++;
+        return true;
+    }
+
+    // Move tx from far-future store to the per-tick buffers if its tick is in the storage window and its priority is
+    // still > 0, otherwise drop it. The tx must have been unlinked from the list of its tick. Caller has to acquire lock.
+    static void promoteFarFutureTx(unsigned int txIndex)
+    {
+        const Transaction* tx = getFarFutureTxPtr(txIndex);
+        const m256i& digest = farFutureDigestsBuffer[txIndex];
+        if (tickInStorage(tx->tick))
+        {
+            const unsigned int tickIndex = tickToIndex(tx->tick);
+            const sint64 priority = calculateTxPriority(tx);
+            if (priority > 0 && findTxIndex(tickIndex, digest) == maxNumTxsPerTick)
+                addToTick(tickIndex, tx, tx->totalSize(), digest, priority);
+        }
+
+        freeFarFutureTx(txIndex);
+    }
+
+    // Move far-future txs of tick that just entered the storage window to the per-tick buffers. Caller has to acquire lock.
+    static void promoteFarFutureTxs(unsigned int tick)
+    {
+        ScopedScratchpadPool scratchpadPool(scratchpadBuffers);
+        const unsigned int farTickIndex = tickToFarFutureIndex(tick);
+        unsigned int nextTx = farFutureFirstTx[farTickIndex];
+        farFutureFirstTx[farTickIndex] = 0;
+        farFutureNumTxsPerTick[farTickIndex] = 0;
+        while (nextTx)
+        {
+            const unsigned int txIndex = nextTx - 1;
+            nextTx = farFutureNextTx[txIndex];
+            ASSERT(getFarFutureTxPtr(txIndex)->tick == tick);
+            promoteFarFutureTx(txIndex);
+        }
+    }
+
+    // Sort far-future txs into the new ranges after the storage window has been moved by an arbitrary number of ticks:
+    // txs of ticks in the storage window are moved to the per-tick buffers, txs of ticks in neither range are dropped.
+    // Caller has to acquire lock.
+    static void redistributeFarFutureTxs()
+    {
+        ScopedScratchpadPool scratchpadPool(scratchpadBuffers);
+        // unlink lists of all ticks into one list
+        unsigned int allTxs = 0;
+        for (unsigned int farTickIndex = 0; farTickIndex < PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS; ++farTickIndex)
+        {
+            unsigned int nextTx = farFutureFirstTx[farTickIndex];
+            while (nextTx)
+            {
+                const unsigned int txIndex = nextTx - 1;
+                nextTx = farFutureNextTx[txIndex];
+                farFutureNextTx[txIndex] = (unsigned short)allTxs;
+                allTxs = txIndex + 1;
+            }
+            farFutureFirstTx[farTickIndex] = 0;
+            farFutureNumTxsPerTick[farTickIndex] = 0;
+        }
+
+        while (allTxs)
+        {
+            const unsigned int txIndex = allTxs - 1;
+            allTxs = farFutureNextTx[txIndex];
+            const unsigned int tick = getFarFutureTxPtr(txIndex)->tick;
+            if (tickInFarFutureStorage(tick))
+            {
+                const unsigned int farTickIndex = tickToFarFutureIndex(tick);
+                farFutureNextTx[txIndex] = farFutureFirstTx[farTickIndex];
+                farFutureFirstTx[farTickIndex] = (unsigned short)(txIndex + 1);
+                farFutureNumTxsPerTick[farTickIndex]++;
+            }
+            else
+            {
+                promoteFarFutureTx(txIndex);
+            }
+        }
+    }
+
+    // Return number of far-future txs scheduled for tick >= beginTick. Caller has to acquire lock.
+    static unsigned int countFarFutureTxs(unsigned int beginTick)
+    {
+        const unsigned int farFutureBeginTick = firstStoredTick + PENDING_TXS_POOL_NUM_TICKS;
+        if (beginTick <= farFutureBeginTick)
+            return farFutureNumTxs;
+        unsigned int res = 0;
+        for (unsigned int tick = beginTick; tick < farFutureBeginTick + PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS; ++tick)
+            res += farFutureNumTxsPerTick[tickToFarFutureIndex(tick)];
+        return res;
+    }
+
 public:
 
     // Init at node startup.
     static bool init()
     {
-        if (!allocPoolWithErrorLog(L"PendingTxsPool::tickTransactionsPtr ", tickTransactionsSize, (void**)&tickTransactionsBuffer, __LINE__)
-            || !allocPoolWithErrorLog(L"PendingTxsPool::txsDigestsPtr ", txsDigestsSize, (void**)&txsDigestsBuffer, __LINE__)
-            || !allocPoolWithErrorLog(L"PendingTxsPool::txsPriorities", sizeof(Collection<unsigned int, txsPrioritiesCapacity>), (void**)&txsPriorities, __LINE__))
+        if (!allocLargeWithErrorLog(L"PendingTxsPool::tickTransactionsPtr ", tickTransactionsSize, (void**)&tickTransactionsBuffer, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::txsDigestsPtr ", txsDigestsSize, (void**)&txsDigestsBuffer, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::txsDigestSets ", txsDigestSetsSize, (void**)&txsDigestSetsBuffer, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::txsPriorities", sizeof(Collection<unsigned int, txsPrioritiesCapacity, true>), (void**)&txsPriorities, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::farFutureTxs", farFutureTxsSize, (void**)&farFutureTxsBuffer, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::farFutureDigests", farFutureDigestsSize, (void**)&farFutureDigestsBuffer, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::txsOfSourceSet", txsOfSourceSetSize, (void**)&txsOfSourceSet, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::nextTxOfSource", txsOfSourceListSize, (void**)&nextTxOfSource, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::prevTxOfSource", txsOfSourceListSize, (void**)&prevTxOfSource, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::changedEntityKeys", maxNumChangedEntities * sizeof(m256i), (void**)&changedEntityKeys, __LINE__)
+            || !allocLargeWithErrorLog(L"PendingTxsPool::changedEntities", maxNumChangedEntities * sizeof(ChangedEntity), (void**)&changedEntities, __LINE__)
+            || !scratchpadBuffers.init(1, sizeof(Collection<unsigned int, txsPrioritiesCapacity, true>)))
         {
             return false;
         }
 
-        ASSERT(lock == 0);
+        ASSERT(!lock.isLocked());
 
         setMem(tickTransactionsBuffer, tickTransactionsSize, 0);
         setMem(txsDigestsBuffer, txsDigestsSize, 0);
+        setMem(txsDigestSetsBuffer, txsDigestSetsSize, 0);
         setMem(numSavedTxsPerTick, sizeof(numSavedTxsPerTick), 0);
+        setMem(txsOfSourceSet, txsOfSourceSetSize, 0);
 
         txsPriorities->reset();
+        resetFarFutureStorage();
+
+        numChangedEntities = 0;
+        allEntitiesChanged = true;
+        lastSpectrumReorganizationCount = spectrumReorganizationCount;
 
         firstStoredTick = 0;
         buffersBeginIndex = 0;
@@ -162,28 +788,67 @@ public:
     {
         if (tickTransactionsBuffer)
         {
-            freePool(tickTransactionsBuffer);
+            freeLarge(tickTransactionsBuffer, tickTransactionsSize);
         }
         if (txsDigestsBuffer)
         {
-            freePool(txsDigestsBuffer);
+            freeLarge(txsDigestsBuffer, txsDigestsSize);
+        }
+        if (txsDigestSetsBuffer)
+        {
+            freeLarge(txsDigestSetsBuffer, txsDigestSetsSize);
         }
         if (txsPriorities)
         {
-            freePool(txsPriorities);
+            freeLarge(txsPriorities, sizeof(Collection<unsigned int, txsPrioritiesCapacity, true>));
+        }
+        if (farFutureTxsBuffer)
+        {
+            freeLarge(farFutureTxsBuffer, farFutureTxsSize);
+        }
+        if (farFutureDigestsBuffer)
+        {
+            freeLarge(farFutureDigestsBuffer, farFutureDigestsSize);
         }
+        if (txsOfSourceSet)
+        {
+            freeLarge(txsOfSourceSet, txsOfSourceSetSize);
+        }
+        if (nextTxOfSource)
+        {
+            freeLarge(nextTxOfSource, txsOfSourceListSize);
+        }
+        if (prevTxOfSource)
+        {
+            freeLarge(prevTxOfSource, txsOfSourceListSize);
+        }
+        if (changedEntityKeys)
+        {
+            freeLarge(changedEntityKeys, maxNumChangedEntities * sizeof(m256i));
+        }
+        if (changedEntities)
+        {
+            freeLarge(changedEntities, maxNumChangedEntities * sizeof(ChangedEntity));
+        }
+        scratchpadBuffers.deinit();
     }
 
     // Acquire lock for returned pointers to transactions or digests.
     inline static void acquireLock()
     {
-        ACQUIRE(lock);
+        lock.acquire();
     }
 
     // Release lock for returned pointers to transactions or digests.
     inline static void releaseLock()
     {
-        RELEASE(lock);
+        lock.release();
+    }
+
+    // Return contention statistics of the lock.
+    inline static const LockStatistics& getLockStatistics()
+    {
+        return lock.getStatistics();
     }
 
     // Return number of transactions scheduled for the specified tick.
@@ -193,12 +858,16 @@ public:
 //        addDebugMessage(L"Begin pendingTxsPool.getNumberOfPendingTickTxs()");
 //#endif
         unsigned int res = 0;
-        ACQUIRE(lock);
+        lock.acquire();
         if (tickInStorage(tick))
         {
             res = numSavedTxsPerTick[tickToIndex(tick)];
         }
-        RELEASE(lock);
+        else if (tickInFarFutureStorage(tick))
+        {
+            res = farFutureNumTxsPerTick[tickToFarFutureIndex(tick)];
+        }
+        lock.release();
 
 //#if !defined(NDEBUG) && !defined(NO_UEFI)
 //        CHAR16 dbgMsgBuf[200];
@@ -218,7 +887,7 @@ public:
 //        addDebugMessage(L"Begin pendingTxsPool.getTotalNumberOfPendingTxs()");
 //#endif
         unsigned int res = 0;
-        ACQUIRE(lock);
+        lock.acquire();
         if (tickInStorage(tick + 1))
         {
             unsigned int startIndex = tickToIndex(tick + 1);
@@ -236,7 +905,11 @@ public:
                     res += numSavedTxsPerTick[t];
             }
         }
-        RELEASE(lock);
+        if (tick + 1 >= firstStoredTick)
+        {
+            res += countFarFutureTxs(tick + 1);
+        }
+        lock.release();
 
 //#if !defined(NDEBUG) && !defined(NO_UEFI)
 //        CHAR16 dbgMsgBuf[200];
@@ -249,97 +922,142 @@ public:
         return res;
     }
 
+    // Size of the buffer needed by saveToFile() and loadFromFile()
+    static constexpr unsigned long long maxSnapshotSize = sizeof(SnapshotHeader) + (maxNumTxsTotal + farFutureMaxTxs) * (sizeof(m256i) + ((MAX_TRANSACTION_SIZE + 31) & ~31ULL));
+
+    // Save transactions of all stored ticks (including the far-future store) to file, packing them into buffer with at least maxSnapshotSize bytes
+    // first. Priorities aren't saved, because they only depend on the spectrum, which is saved with the pool.
+    // Returns number of bytes written or -1 on error.
+    static long long saveToFile(const CHAR16* fileName, unsigned char* buffer, const CHAR16* directory = NULL)
+    {
+        SnapshotHeader* header = (SnapshotHeader*)buffer;
+        setMem(header, sizeof(SnapshotHeader), 0);
+        unsigned long long size = sizeof(SnapshotHeader);
+
+        lock.acquire();
+        header->firstStoredTick = firstStoredTick;
+        for (unsigned int t = 0; t < PENDING_TXS_POOL_NUM_TICKS; ++t)
+        {
+            const unsigned int tickIndex = (buffersBeginIndex + t) % PENDING_TXS_POOL_NUM_TICKS;
+            for (unsigned int txIndex = 0; txIndex < numSavedTxsPerTick[tickIndex]; ++txIndex)
+            {
+                const Transaction* transaction = getTxPtr(tickIndex, txIndex);
+                const unsigned int transactionSize = transaction->totalSize();
+                const unsigned long long recordSize = snapshotRecordSize(transactionSize);
+                copyMem(buffer + size, getDigestPtr(tickIndex, txIndex), sizeof(m256i));
+                copyMem(buffer + size + sizeof(m256i), transaction, transactionSize);
+                setMem(buffer + size + sizeof(m256i) + transactionSize, recordSize - sizeof(m256i) - transactionSize, 0);
+                size += recordSize;
+                header->txCount++;
+            }
+        }
+        for (unsigned int farTickIndex = 0; farTickIndex < PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS; ++farTickIndex)
+        {
+            for (unsigned int nextTx = farFutureFirstTx[farTickIndex]; nextTx; nextTx = farFutureNextTx[nextTx - 1])
+            {
+                const Transaction* transaction = getFarFutureTxPtr(nextTx - 1);
+                const unsigned int transactionSize = transaction->totalSize();
+                const unsigned long long recordSize = snapshotRecordSize(transactionSize);
+                copyMem(buffer + size, &farFutureDigestsBuffer[nextTx - 1], sizeof(m256i));
+                copyMem(buffer + size + sizeof(m256i), transaction, transactionSize);
+                setMem(buffer + size + sizeof(m256i) + transactionSize, recordSize - sizeof(m256i) - transactionSize, 0);
+                size += recordSize;
+                header->txCount++;
+            }
+        }
+        lock.release();
+
+        header->dataSize = size - sizeof(SnapshotHeader);
+        return ::save(fileName, size, buffer, directory);
+    }
+
+    // Restart pool at the first tick saved with saveToFile() and add the saved transactions, using buffer with at
+    // least maxSnapshotSize bytes. Stored digests are reused and priorities are recomputed from the current spectrum.
+    // Returns number of transactions added or -1 on error (pool is unchanged in this case).
+    static long long loadFromFile(const CHAR16* fileName, unsigned char* buffer, const CHAR16* directory = NULL)
+    {
+        const long long loadedSize = loadUpTo(fileName, maxSnapshotSize, buffer, directory);
+        if (loadedSize < (long long)sizeof(SnapshotHeader))
+            return -1;
+        const SnapshotHeader* header = (const SnapshotHeader*)buffer;
+        if (header->dataSize != loadedSize - sizeof(SnapshotHeader) || header->txCount > maxNumTxsTotal + farFutureMaxTxs)
+            return -1;
+
+        // validate all records before touching the pool
+        unsigned long long offset = sizeof(SnapshotHeader);
+        for (unsigned int i = 0; i < header->txCount; ++i)
+        {
+            if (offset + snapshotRecordSize(sizeof(Transaction)) > (unsigned long long)loadedSize)
+                return -1;
+            const Transaction* transaction = (const Transaction*)(buffer + offset + sizeof(m256i));
+            if (!transaction->checkValidity())
+                return -1;
+            offset += snapshotRecordSize(transaction->totalSize());
+        }
+        if (offset != (unsigned long long)loadedSize)
+            return -1;
+
+        beginEpoch(header->firstStoredTick);
+
+        long long addedCount = 0;
+        offset = sizeof(SnapshotHeader);
+        for (unsigned int i = 0; i < header->txCount; ++i)
+        {
+            const m256i* digest = (const m256i*)(buffer + offset);
+            const Transaction* transaction = (const Transaction*)(buffer + offset + sizeof(m256i));
+            if (add(transaction, digest))
+                ++addedCount;
+            offset += snapshotRecordSize(transaction->totalSize());
+        }
+        return addedCount;
+    }
+
     // Check validity of transaction and add to the pool. Return boolean indicating whether transaction was added.
-    static bool add(const Transaction* tx)
+    // Txs for ticks after the storage window are added to the far-future store (if there is space left).
+    // If the caller already has the digest of the full transaction (including signature), it may pass it as txDigest
+    // to avoid recomputing it.
+    static bool add(const Transaction* tx, const m256i* txDigest = nullptr)
     {
+        ScopedScratchpadPool scratchpadPool(scratchpadBuffers);
 //#if !defined(NDEBUG) && !defined(NO_UEFI)
 //        addDebugMessage(L"Begin pendingTxsPool.add()");
 //#endif
+        // Check validity, compute digest, and compute priority before locking, so concurrent callers only
+        // serialize for updating the pool
+        const bool txValid = tx->checkValidity();
+        const unsigned int transactionSize = (txValid) ? tx->totalSize() : 0;
+        m256i digest;
+        sint64 priority = 0;
+        if (txValid)
+        {
+            if (txDigest)
+                digest = *txDigest;
+            else
+                KangarooTwelve(tx, transactionSize, &digest, sizeof(m256i));
+            priority = calculateTxPriority(tx);
+        }
+
         bool txAdded = false;
-        ACQUIRE(lock);
-        if (tx->checkValidity() && tickInStorage(tx->tick))
+        lock.acquire();
+        if (txValid && tickInStorage(tx->tick))
         {
             unsigned int tickIndex = tickToIndex(tx->tick);
-            const unsigned int transactionSize = tx->totalSize();
 
             // check if tx with same digest already exists
-            m256i digest;
-            KangarooTwelve(tx, transactionSize, &digest, sizeof(m256i));
-            for (unsigned int txIndex = 0; txIndex < numSavedTxsPerTick[tickIndex]; ++txIndex)
+            if (findTxIndex(tickIndex, digest) < maxNumTxsPerTick)
             {
-                if (*getDigestPtr(tickIndex, txIndex) == digest)
-                {
 #if !defined(NDEBUG) && !defined(NO_UEFI)
-                    CHAR16 dbgMsgBuf[100];
-                    setText(dbgMsgBuf, L"tx with the same digest already exists for tick ");
-                    appendNumber(dbgMsgBuf, tx->tick, FALSE);
-                    addDebugMessage(dbgMsgBuf);
+                CHAR16 dbgMsgBuf[100];
+                setText(dbgMsgBuf, L"tx with the same digest already exists for tick ");
+                appendNumber(dbgMsgBuf, tx->tick, FALSE);
+                addDebugMessage(dbgMsgBuf);
 #endif
-                    goto end_add_function;
-                }
+                goto end_add_function;
             }
 
-            sint64 priority = calculateTxPriority(tx);
             if (priority > 0)
             {
-                m256i povIndex{ tickIndex, 0, 0, 0 };
-
-                if (numSavedTxsPerTick[tickIndex] < maxNumTxsPerTick)
-                {
-                    copyMem(getDigestPtr(tickIndex, numSavedTxsPerTick[tickIndex]), &digest, sizeof(m256i));
-                    copyMem(getTxPtr(tickIndex, numSavedTxsPerTick[tickIndex]), tx, transactionSize);
-                    txsPriorities->add(povIndex, numSavedTxsPerTick[tickIndex], priority);
-
-                    numSavedTxsPerTick[tickIndex]++;
-                    txAdded = true;
-                }
-                else
-                {
-                    // check if priority is higher than lowest priority tx in this tick and replace in this case
-                    sint64 lowestElementIndex = txsPriorities->tailIndex(povIndex);
-                    if (lowestElementIndex != NULL_INDEX)
-                    {
-                        if (txsPriorities->priority(lowestElementIndex) < priority)
-                        {
-                            unsigned int replacedTxIndex = txsPriorities->element(lowestElementIndex);
-                            txsPriorities->remove(lowestElementIndex);
-                            txsPriorities->add(povIndex, replacedTxIndex, priority);
-
-                            copyMem(getDigestPtr(tickIndex, replacedTxIndex), &digest, sizeof(m256i));
-                            copyMem(getTxPtr(tickIndex, replacedTxIndex), tx, transactionSize);
-
-                            txAdded = true;
-                        }
-#if !defined(NDEBUG) && !defined(NO_UEFI) && 0
-                        else
-                        {
-                            CHAR16 dbgMsgBuf[300];
-                            setText(dbgMsgBuf, L"tx could not be added, already saved ");
-                            appendNumber(dbgMsgBuf, numSavedTxsPerTick[tickIndex], FALSE);
-                            appendText(dbgMsgBuf, L" txs for tick ");
-                            appendNumber(dbgMsgBuf, tx->tick, FALSE);
-                            appendText(dbgMsgBuf, L" and priority ");
-                            appendNumber(dbgMsgBuf, priority, FALSE);
-                            appendText(dbgMsgBuf, L" is lower than lowest saved priority ");
-                            appendNumber(dbgMsgBuf, txsPriorities->priority(lowestElementIndex), FALSE);
-                            addDebugMessage(dbgMsgBuf);
-                        }
-#endif      
-                    }
-#if !defined(NDEBUG) && !defined(NO_UEFI)
-                    else
-                    {
-                        // debug log, this should never happen
-                        CHAR16 dbgMsgBuf[300];
-                        setText(dbgMsgBuf, L"maximum number of txs ");
-                        appendNumber(dbgMsgBuf, numSavedTxsPerTick[tickIndex], FALSE);
-                        appendText(dbgMsgBuf, L" saved for tick ");
-                        appendNumber(dbgMsgBuf, tx->tick, FALSE);
-                        appendText(dbgMsgBuf, L" but povIndex is unknown. This should never happen.");
-                        addDebugMessage(dbgMsgBuf);
-                    }
-#endif
-                }
+                txAdded = addToTick(tickIndex, tx, transactionSize, digest, priority);
             }
 #if !defined(NDEBUG) && !defined(NO_UEFI)
             else
@@ -351,6 +1069,11 @@ public:
             }
 #endif
         }
+        else if (txValid && priority > 0 && tickInFarFutureStorage(tx->tick))
+        {
+            // the priority is only used for eviction here, it is computed again when the tick enters the window
+            txAdded = addToFarFuture(tx, transactionSize, digest, priority);
+        }
 #if !defined(NDEBUG) && !defined(NO_UEFI) && 0
         else
         {
@@ -372,7 +1095,7 @@ public:
 #endif
 
     end_add_function:
-        RELEASE(lock);
+        lock.release();
 
 //#if !defined(NDEBUG) && !defined(NO_UEFI)
 //        if (txAdded)
@@ -383,6 +1106,95 @@ public:
         return txAdded;
     }
 
+    // Check if transaction with given digest (of the full transaction including signature) is stored for tick.
+    static bool containsTx(unsigned int tick, const m256i& digest)
+    {
+        bool found = false;
+        lock.acquire();
+        if (tickInStorage(tick))
+        {
+            found = findTxIndex(tickToIndex(tick), digest) < maxNumTxsPerTick;
+        }
+        else if (tickInFarFutureStorage(tick))
+        {
+            found = findInDigestSet(farFutureDigestSet, farFutureDigestSetCapacity, farFutureDigestsBuffer, digest, farFutureMaxTxs) < farFutureMaxTxs;
+        }
+        lock.release();
+        return found;
+    }
+
+    // Take snapshot of the entities flagged as changed in spectrumDigestTree for updateTxsPrioritiesOfChangedEntities().
+    // Has to be called before updateSpectrumDigests() clears the change flags. Only the tick processor may call this.
+    // Caller has to acquire spectrumLock.
+    static void collectChangedEntities()
+    {
+        PROFILE_SCOPE();
+        setMem(changedEntitiesSet, sizeof(changedEntitiesSet), 0);
+        numChangedEntities = 0;
+        allEntitiesChanged = (spectrumReorganizationCount != lastSpectrumReorganizationCount);
+        lastSpectrumReorganizationCount = spectrumReorganizationCount;
+        if (allEntitiesChanged)
+            return;
+
+        for (unsigned long long i = spectrumDigestTree.findNextChangedLeaf(0); i < SPECTRUM_CAPACITY; i = spectrumDigestTree.findNextChangedLeaf(i + 1))
+        {
+            const EntityRecord& entity = spectrum[i];
+            if (isZero(entity.publicKey))
+                continue;
+            if (numChangedEntities == maxNumChangedEntities)
+            {
+                allEntitiesChanged = true;
+                return;
+            }
+            changedEntityKeys[numChangedEntities] = entity.publicKey;
+            changedEntities[numChangedEntities].balance = energy((int)i);
+            changedEntities[numChangedEntities].latestTransferTick = (entity.latestOutgoingTransferTick) ? entity.latestOutgoingTransferTick : entity.latestIncomingTransferTick;
+            insertIntoDigestSet(changedEntitiesSet, changedEntitiesSetCapacity, changedEntityKeys, numChangedEntities);
+            ++numChangedEntities;
+        }
+    }
+
+    // Recompute priorities of pending txs scheduled for tick >= beginTick whose source entity is in the snapshot taken
+    // by collectChangedEntities(), evicting those whose priority dropped to 0. Only ticks with txs of changed entities
+    // are touched, which are found with the index of txs by source. If the snapshot is incomplete (too many changes or
+    // reorganization of the spectrum), the priorities of all txs are recomputed while holding spectrumLock. Txs of
+    // ticks that may already have been published should not be evicted, so beginTick should not be lower than
+    // system.tick + TICK_TRANSACTIONS_PUBLICATION_OFFSET. Only the tick processor may call this. Caller must not hold
+    // spectrumLock.
+    static void updateTxsPrioritiesOfChangedEntities(unsigned int beginTick)
+    {
+        PROFILE_SCOPE();
+        ScopedScratchpadPool scratchpadPool(scratchpadBuffers);
+
+        if (allEntitiesChanged)
+            spectrumLock.acquire();
+        lock.acquire();
+        if (beginTick < firstStoredTick)
+            beginTick = firstStoredTick;
+
+        if (!allEntitiesChanged)
+        {
+            setMem(tickHasChangedEntity, sizeof(tickHasChangedEntity), 0);
+            for (unsigned int i = 0; i < numChangedEntities; ++i)
+            {
+                const unsigned long long slot = findSourceSlot(changedEntityKeys[i]);
+                for (unsigned int position = txsOfSourceSet[slot]; position; position = nextTxOfSource[position - 1])
+                    tickHasChangedEntity[(position - 1) / maxNumTxsPerTick] = true;
+            }
+        }
+
+        for (unsigned int tick = beginTick; tick < firstStoredTick + PENDING_TXS_POOL_NUM_TICKS; ++tick)
+        {
+            const unsigned int tickIndex = tickToIndex(tick);
+            if (allEntitiesChanged || tickHasChangedEntity[tickIndex])
+                updateTickTxsPriorities(tickIndex);
+        }
+
+        lock.release();
+        if (allEntitiesChanged)
+            spectrumLock.release();
+    }
+
     // Get a transaction for the specified tick. If no more transactions for this tick, return nullptr.
     // ATTENTION: when running multiple threads, you need to have acquired the lock via acquireLock() before calling this function.
     static Transaction* getTx(unsigned int tick, unsigned int index)
@@ -421,14 +1233,57 @@ public:
             return nullptr;
     }
 
+    // Get pointers to the transactions and digests of the specified tick in priority order (highest first), writing
+    // at most maxCount entries to txs and digests. Return the number of entries written.
+    // ATTENTION: when running multiple threads, you need to have acquired the lock via acquireLock() before calling this
+    // function and keep it until you are done with the returned pointers.
+    static unsigned int getTickTxsByPriority(unsigned int tick, const Transaction** txs, const m256i** digests, unsigned int maxCount)
+    {
+        if (!tickInStorage(tick))
+            return 0;
+
+        const unsigned int tickIndex = tickToIndex(tick);
+        unsigned int count = 0;
+        for (sint64 elementIndex = txsPriorities->headIndex(m256i{ tickIndex, 0, 0, 0 }); elementIndex != NULL_INDEX && count < maxCount;
+            elementIndex = txsPriorities->nextElementIndex(elementIndex))
+        {
+            const unsigned int txIndex = txsPriorities->element(elementIndex);
+            ASSERT(txIndex < numSavedTxsPerTick[tickIndex]);
+            txs[count] = getTxPtr(tickIndex, txIndex);
+            digests[count] = getDigestPtr(tickIndex, txIndex);
+            ++count;
+        }
+        ASSERT(count == maxCount || count == numSavedTxsPerTick[tickIndex]);
+        return count;
+    }
+
+    // Get transaction with the specified digest (of the full transaction including signature) for the tick. If there is
+    // no such transaction, return nullptr.
+    // ATTENTION: when running multiple threads, you need to have acquired the lock via acquireLock() before calling this function.
+    static Transaction* findTx(unsigned int tick, const m256i& digest)
+    {
+        if (!tickInStorage(tick))
+            return nullptr;
+
+        const unsigned int tickIndex = tickToIndex(tick);
+        const unsigned int txIndex = findTxIndex(tickIndex, digest);
+        if (txIndex < maxNumTxsPerTick)
+            return getTxPtr(tickIndex, txIndex);
+        else
+            return nullptr;
+    }
+
     static void incrementFirstStoredTick()
     {
-        ACQUIRE(lock);
+        lock.acquire();
+
+        removeTicksFromSourceIndex(buffersBeginIndex, buffersBeginIndex + 1);
 
         // set memory at buffersBeginIndex to 0 
         unsigned long long numTxsBeforeBegin = buffersBeginIndex * maxNumTxsPerTick;
         setMem(tickTransactionsBuffer + numTxsBeforeBegin * MAX_TRANSACTION_SIZE, maxNumTxsPerTick * MAX_TRANSACTION_SIZE, 0);
         setMem(txsDigestsBuffer + numTxsBeforeBegin, maxNumTxsPerTick * sizeof(m256i), 0);
+        clearDigestSets(buffersBeginIndex, buffersBeginIndex + 1);
         numSavedTxsPerTick[buffersBeginIndex] = 0;
 
         // remove txs priorities stored for firstStoredTick
@@ -438,7 +1293,10 @@ public:
         firstStoredTick++;
         buffersBeginIndex = (buffersBeginIndex + 1) % PENDING_TXS_POOL_NUM_TICKS;
 
-        RELEASE(lock);
+        // last tick of the window has been in the far-future store before
+        promoteFarFutureTxs(firstStoredTick + PENDING_TXS_POOL_NUM_TICKS - 1);
+
+        lock.release();
     }
 
     static void beginEpoch(unsigned int newInitialTick)
@@ -446,7 +1304,7 @@ public:
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         addDebugMessage(L"Begin pendingTxsPool.beginEpoch()");
 #endif
-        ACQUIRE(lock);
+        lock.acquire();
         if (tickInStorage(newInitialTick))
         {
             unsigned int newInitialIndex = tickToIndex(newInitialTick);
@@ -454,10 +1312,14 @@ public:
             // reset memory of discarded ticks
             if (newInitialIndex < buffersBeginIndex)
             {
+                removeTicksFromSourceIndex(0, newInitialIndex);
+                removeTicksFromSourceIndex(buffersBeginIndex, PENDING_TXS_POOL_NUM_TICKS);
+
                 unsigned long long numTxsBeforeNew = newInitialIndex * maxNumTxsPerTick;
                 setMem(tickTransactionsBuffer, numTxsBeforeNew * MAX_TRANSACTION_SIZE, 0);
                 setMem(txsDigestsBuffer, numTxsBeforeNew * sizeof(m256i), 0);
                 setMem(numSavedTxsPerTick, newInitialIndex * sizeof(unsigned int), 0);
+                clearDigestSets(0, newInitialIndex);
 
                 for (unsigned int tickIndex = 0; tickIndex < newInitialIndex; ++tickIndex)
                     cleanupTxsPriorities(tickIndex);
@@ -467,17 +1329,21 @@ public:
                 setMem(tickTransactionsBuffer + numTxsBeforeBegin * MAX_TRANSACTION_SIZE, numTxsStartingAtBegin * MAX_TRANSACTION_SIZE, 0);
                 setMem(txsDigestsBuffer + numTxsBeforeBegin, numTxsStartingAtBegin * sizeof(m256i), 0);
                 setMem(numSavedTxsPerTick + buffersBeginIndex, (PENDING_TXS_POOL_NUM_TICKS - buffersBeginIndex) * sizeof(unsigned int), 0);
+                clearDigestSets(buffersBeginIndex, PENDING_TXS_POOL_NUM_TICKS);
 
                 for (unsigned int tickIndex = buffersBeginIndex; tickIndex < PENDING_TXS_POOL_NUM_TICKS; ++tickIndex)
                     cleanupTxsPriorities(tickIndex);
             }
             else
             {
+                removeTicksFromSourceIndex(buffersBeginIndex, newInitialIndex);
+
                 unsigned long long numTxsBeforeBegin = buffersBeginIndex * maxNumTxsPerTick;
                 unsigned long long numTxsStartingAtBegin = (newInitialIndex - buffersBeginIndex) * maxNumTxsPerTick;
                 setMem(tickTransactionsBuffer + numTxsBeforeBegin * MAX_TRANSACTION_SIZE, numTxsStartingAtBegin * MAX_TRANSACTION_SIZE, 0);
                 setMem(txsDigestsBuffer + numTxsBeforeBegin, numTxsStartingAtBegin * sizeof(m256i), 0);
                 setMem(numSavedTxsPerTick + buffersBeginIndex, (newInitialIndex - buffersBeginIndex) * sizeof(unsigned int), 0);
+                clearDigestSets(buffersBeginIndex, newInitialIndex);
 
                 for (unsigned int tickIndex = buffersBeginIndex; tickIndex < newInitialIndex; ++tickIndex)
                     cleanupTxsPriorities(tickIndex);
@@ -489,7 +1355,9 @@ public:
         {
             setMem(tickTransactionsBuffer, tickTransactionsSize, 0);
             setMem(txsDigestsBuffer, txsDigestsSize, 0);
+            setMem(txsDigestSetsBuffer, txsDigestSetsSize, 0);
             setMem(numSavedTxsPerTick, sizeof(numSavedTxsPerTick), 0);
+            setMem(txsOfSourceSet, txsOfSourceSetSize, 0);
 
             txsPriorities->reset();
 
@@ -497,8 +1365,9 @@ public:
         }
 
         firstStoredTick = newInitialTick;
+        redistributeFarFutureTxs();
 
-        RELEASE(lock);
+        lock.release();
 
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         addDebugMessage(L"End pendingTxsPool.beginEpoch()");
@@ -508,7 +1377,7 @@ public:
     // Useful for debugging, but expensive: check that everything is as expected.
     static void checkStateConsistencyWithAssert()
     {
-        ACQUIRE(lock);
+        lock.acquire();
 
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         addDebugMessage(L"Begin tsxPool.checkStateConsistencyWithAssert()");
@@ -539,6 +1408,8 @@ public:
                     Transaction* transaction = (Transaction*)(tickTransactionsBuffer + (tickIndex * maxNumTxsPerTick + txIndex) * MAX_TRANSACTION_SIZE);
                     ASSERT(transaction->checkValidity());
                     ASSERT(transaction->tick == tick);
+                    ASSERT(findTxIndex(tickIndex, *getDigestPtr(tickIndex, txIndex)) == txIndex);
+                    ASSERT(txsOfSourceSet[findSourceSlot(transaction->sourcePublicKey)] != 0);
 #if !defined(NDEBUG) && !defined(NO_UEFI)
                     if (!transaction->checkValidity() || transaction->tick != tick)
                     {
@@ -563,7 +1434,31 @@ public:
             }
         }
 
-        RELEASE(lock);
+        ASSERT(farFutureTxsBuffer != nullptr);
+        ASSERT(farFutureDigestsBuffer != nullptr);
+
+        unsigned int numFarFutureTxs = 0;
+        for (unsigned int tick = firstStoredTick + PENDING_TXS_POOL_NUM_TICKS; tick < firstStoredTick + PENDING_TXS_POOL_NUM_TICKS + PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS; ++tick)
+        {
+            ASSERT(tickInFarFutureStorage(tick));
+            const unsigned int farTickIndex = tickToFarFutureIndex(tick);
+            unsigned int numForTick = 0;
+            for (unsigned int nextTx = farFutureFirstTx[farTickIndex]; nextTx; nextTx = farFutureNextTx[nextTx - 1])
+            {
+                const unsigned int txIndex = nextTx - 1;
+                const Transaction* transaction = getFarFutureTxPtr(txIndex);
+                ASSERT(transaction->checkValidity());
+                ASSERT(transaction->tick == tick);
+                ASSERT(findInDigestSet(farFutureDigestSet, farFutureDigestSetCapacity, farFutureDigestsBuffer, farFutureDigestsBuffer[txIndex], farFutureMaxTxs) == txIndex);
+                ++numForTick;
+            }
+            ASSERT(numForTick == farFutureNumTxsPerTick[farTickIndex]);
+            ASSERT(numForTick <= maxNumTxsPerTick);
+            numFarFutureTxs += numForTick;
+        }
+        ASSERT(numFarFutureTxs == farFutureNumTxs);
+
+        lock.release();
 
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         addDebugMessage(L"End pendingTxsPool.checkStateConsistencyWithAssert()");
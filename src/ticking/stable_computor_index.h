@@ -4,33 +4,72 @@
 #include "platform/memory.h"
 #include "public_settings.h"
 
-// Minimum buffer size: NUMBER_OF_COMPUTORS * sizeof(m256i) + 2 * NUMBER_OF_COMPUTORS bytes (~23KB)
+// Number of slots of the hash map of current computors (power of 2, load factor about 1/3)
+constexpr unsigned int stableComputorIndexHashMapSize = 2048;
+static_assert(stableComputorIndexHashMapSize >= 2 * NUMBER_OF_COMPUTORS, "Hash map of current computors too small");
+static_assert((stableComputorIndexHashMapSize & (stableComputorIndexHashMapSize - 1)) == 0, "Hash map size must be power of 2");
+
+// Value of previousComputorIndices for slots filled with a new computor
+constexpr unsigned short NO_PREVIOUS_COMPUTOR_INDEX = 0xffff;
+
+// Minimum buffer size: NUMBER_OF_COMPUTORS * sizeof(m256i) + 2 * NUMBER_OF_COMPUTORS bytes
+// + stableComputorIndexHashMapSize * 2 bytes (~27KB)
 constexpr unsigned long long stableComputorIndexBufferSize()
 {
-    return NUMBER_OF_COMPUTORS * sizeof(m256i) + 2 * NUMBER_OF_COMPUTORS;
+    return NUMBER_OF_COMPUTORS * sizeof(m256i) + 2 * NUMBER_OF_COMPUTORS + stableComputorIndexHashMapSize * sizeof(unsigned short);
+}
+
+// Return first slot of public key in hash map of current computors
+static inline unsigned int stableComputorIndexHashSlot(const m256i& publicKey)
+{
+    const unsigned long long mixed = (publicKey.m256i_u64[0] ^ publicKey.m256i_u64[1] ^ publicKey.m256i_u64[2] ^ publicKey.m256i_u64[3]) * 0x9E3779B97F4A7C15ULL;
+    return (unsigned int)(mixed >> 32) & (stableComputorIndexHashMapSize - 1);
 }
 
 // Reorders futureComputors so requalifying computors keep their current index.
 // New computors fill remaining slots. See doc/stable_computor_index_diagram.svg
+// If previousComputorIndices is not nullptr, the mapping is written to it: for each index of the reordered
+// futureComputors, the index in currentComputors (which is the same index for requalifying computors) or
+// NO_PREVIOUS_COMPUTOR_INDEX for new computors. Arrays indexed by computor can be carried over to the new epoch with it.
 // Returns false if there aren't enough computors to fill all slots.
 static bool calculateStableComputorIndex(
     m256i* futureComputors,
     const m256i* currentComputors,
-    void* tempBuffer)
+    void* tempBuffer,
+    unsigned short* previousComputorIndices = nullptr)
 {
     m256i* tempComputorList = (m256i*)tempBuffer;
     bool* isIndexTaken = (bool*)(tempComputorList + NUMBER_OF_COMPUTORS);
     bool* isFutureComputorUsed = isIndexTaken + NUMBER_OF_COMPUTORS;
+    // Open addressing hash map of current computors: current index + 1 (0 is empty slot)
+    unsigned short* currentComputorSlots = (unsigned short*)(isFutureComputorUsed + NUMBER_OF_COMPUTORS);
 
     setMem(tempComputorList, NUMBER_OF_COMPUTORS * sizeof(m256i), 0);
     setMem(isIndexTaken, NUMBER_OF_COMPUTORS, 0);
     setMem(isFutureComputorUsed, NUMBER_OF_COMPUTORS, 0);
+    setMem(currentComputorSlots, stableComputorIndexHashMapSize * sizeof(unsigned short), 0);
+
+    // Step 0: Hash current computors (if a key occurs multiple times, the lowest index is kept)
+    for (unsigned int currentIdx = 0; currentIdx < NUMBER_OF_COMPUTORS; currentIdx++)
+    {
+        unsigned int slot = stableComputorIndexHashSlot(currentComputors[currentIdx]);
+        while (currentComputorSlots[slot] && currentComputors[currentComputorSlots[slot] - 1] != currentComputors[currentIdx])
+        {
+            slot = (slot + 1) & (stableComputorIndexHashMapSize - 1);
+        }
+        if (!currentComputorSlots[slot])
+        {
+            currentComputorSlots[slot] = (unsigned short)(currentIdx + 1);
+        }
+    }
 
     // Step 1: Requalifying computors keep their current index
     for (unsigned int futureIdx = 0; futureIdx < NUMBER_OF_COMPUTORS; futureIdx++)
     {
-        for (unsigned int currentIdx = 0; currentIdx < NUMBER_OF_COMPUTORS; currentIdx++)
+        unsigned int slot = stableComputorIndexHashSlot(futureComputors[futureIdx]);
+        while (currentComputorSlots[slot])
         {
+            const unsigned int currentIdx = currentComputorSlots[slot] - 1;
             if (futureComputors[futureIdx] == currentComputors[currentIdx])
             {
                 tempComputorList[currentIdx] = futureComputors[futureIdx];
@@ -38,6 +77,7 @@ static bool calculateStableComputorIndex(
                 isFutureComputorUsed[futureIdx] = true;
                 break;
             }
+            slot = (slot + 1) & (stableComputorIndexHashMapSize - 1);
         }
     }
 
@@ -65,5 +105,13 @@ static bool calculateStableComputorIndex(
 
     copyMem(futureComputors, tempComputorList, NUMBER_OF_COMPUTORS * sizeof(m256i));
 
+    if (previousComputorIndices)
+    {
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        {
+            previousComputorIndices[i] = (isIndexTaken[i]) ? (unsigned short)i : NO_PREVIOUS_COMPUTOR_INDEX;
+        }
+    }
+
     return true;
 }
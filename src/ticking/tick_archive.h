@@ -0,0 +1,350 @@
+#pragma once
+
+#include "network_messages/tick.h"
+#include "network_messages/transactions.h"
+
+#include "platform/memory_util.h"
+#include "platform/concurrency.h"
+#include "platform/console_logging.h"
+#include "platform/debugging.h"
+#include "platform/file_io.h"
+
+#include "public_settings.h"
+
+// Append-only archive of ticks that have been moved out of the RAM of TickStorage (see TICK_STORAGE_TIERED_MODE).
+//
+// Ticks are appended in order. Each segment of segmentTicks consecutive ticks is written to its own file once it is
+// full, so the file system maps tick to segment file. A segment is indexed by fixed-size records at its beginning:
+// - SegmentHeader
+// - segmentTicks TickRecords (TickData, Tick of each computor, and offsets of the transactions in the segment)
+// - transactions of all ticks of the segment (variable size)
+// The segment that is currently appended to stays in RAM. Other segments are read through a cache of numCacheSegments
+// segments, evicting the least recently used one on a miss.
+//
+// Locking: pointers returned by getTick(), getTransaction(), and findTransaction() point into the cache, so the lock
+// must be held while appending and while using the returned data.
+template <unsigned int segmentTicks, unsigned int numCacheSegments>
+class TickArchive
+{
+public:
+    struct TickRecord
+    {
+        TickData tickData;
+        Tick ticks[NUMBER_OF_COMPUTORS];
+        unsigned int transactionOffsets[NUMBER_OF_TRANSACTIONS_PER_TICK]; // offset in segment, 0 if not available
+    };
+
+private:
+    // 32 bytes to keep the tick records aligned
+    struct SegmentHeader
+    {
+        unsigned int magic;
+        unsigned int firstTick;
+        unsigned int numberOfTicks;
+        unsigned int size; // total size of segment in bytes (header, tick records, and transactions)
+        unsigned int reserved[4];
+    };
+    static_assert(sizeof(SegmentHeader) == 32, "Unexpected size of SegmentHeader");
+    static constexpr unsigned int segmentMagic = 0x41434954; // "TICA"
+
+    static constexpr unsigned long long transactionsBegin = sizeof(SegmentHeader) + ((unsigned long long)segmentTicks) * sizeof(TickRecord);
+    static constexpr unsigned long long segmentCapacity = transactionsBegin + ((unsigned long long)segmentTicks) * NUMBER_OF_TRANSACTIONS_PER_TICK * MAX_TRANSACTION_SIZE;
+    static_assert(segmentCapacity < 0xffffffffULL, "Offsets in segment must fit into 32 bits");
+    static_assert(numCacheSegments >= 1, "Need at least one cache segment");
+
+    static constexpr unsigned int invalidTick = 0xffffffff;
+
+    // slot 0 is the segment that is currently appended to, slots 1..numCacheSegments are the cache
+    unsigned char* segments[numCacheSegments + 1];
+    unsigned int segmentFirstTick[numCacheSegments + 1]; // first tick of segment in slot or invalidTick
+    unsigned long long segmentLastUse[numCacheSegments + 1];
+    unsigned long long useCounter;
+
+    // ticks in [firstTick, endTick) are archived
+    unsigned int firstTick;
+    unsigned int endTick;
+
+    CHAR16 directory[16];
+    volatile char lock;
+
+    SegmentHeader* header(int slot)
+    {
+        return (SegmentHeader*)segments[slot];
+    }
+
+    TickRecord* record(int slot, unsigned int index)
+    {
+        return (TickRecord*)(segments[slot] + sizeof(SegmentHeader)) + index;
+    }
+
+    unsigned int segmentFirstTickOf(unsigned int tick) const
+    {
+        return tick - (tick - firstTick) % segmentTicks;
+    }
+
+    static void generateSegmentFileName(CHAR16 fileName[32], unsigned int segmentFirstTick)
+    {
+        setText(fileName, L"tick");
+        appendNumber(fileName, segmentFirstTick, FALSE);
+        appendText(fileName, L".arc");
+    }
+
+    const CHAR16* segmentDirectory() const
+    {
+#ifdef NO_UEFI
+        // directories are not supported by save() in tests
+        return NULL;
+#else
+        return directory;
+#endif
+    }
+
+    // Write full segment in slot 0 to disk and move it into the cache (swapping buffers, so no copy is needed)
+    void finishSegment()
+    {
+        CHAR16 fileName[32];
+        generateSegmentFileName(fileName, segmentFirstTick[0]);
+#ifdef NO_UEFI
+        const long long sz = save(fileName, header(0)->size, segments[0], segmentDirectory());
+#else
+        // Non-blocking: segment is copied to write-behind queue (falls back to blocking save if queue is full)
+        const long long sz = asyncSave(fileName, header(0)->size, segments[0], segmentDirectory(), false);
+#endif
+        if (sz != header(0)->size)
+        {
+            // segment stays readable until it is evicted from the cache
+            addDebugMessage(L"Failed to save tick archive segment");
+        }
+
+        const int slot = leastRecentlyUsedSlot();
+        unsigned char* tmp = segments[slot];
+        segments[slot] = segments[0];
+        segments[0] = tmp;
+        segmentFirstTick[slot] = segmentFirstTick[0];
+        segmentLastUse[slot] = ++useCounter;
+        segmentFirstTick[0] = invalidTick;
+    }
+
+    int leastRecentlyUsedSlot() const
+    {
+        int slot = 1;
+        for (int i = 2; i <= (int)numCacheSegments; i++)
+        {
+            if (segmentLastUse[i] < segmentLastUse[slot])
+            {
+                slot = i;
+            }
+        }
+        return slot;
+    }
+
+    // Return slot of segment, loading it from disk if it isn't in RAM, or -1 on error
+    int getSegment(unsigned int firstTickOfSegment)
+    {
+        if (segmentFirstTick[0] == firstTickOfSegment)
+        {
+            return 0;
+        }
+        for (int i = 1; i <= (int)numCacheSegments; i++)
+        {
+            if (segmentFirstTick[i] == firstTickOfSegment)
+            {
+                segmentLastUse[i] = ++useCounter;
+                return i;
+            }
+        }
+
+        const int slot = leastRecentlyUsedSlot();
+        CHAR16 fileName[32];
+        generateSegmentFileName(fileName, firstTickOfSegment);
+#ifdef NO_UEFI
+        const long long sz = loadUpTo(fileName, segmentCapacity, segments[slot], segmentDirectory());
+#else
+        const long long sz = asyncLoad(fileName, segmentCapacity, segments[slot], segmentDirectory(), true);
+#endif
+        const SegmentHeader* h = header(slot);
+        if (sz < (long long)transactionsBegin || h->magic != segmentMagic || h->firstTick != firstTickOfSegment
+            || h->numberOfTicks != segmentTicks || h->size != (unsigned long long)sz)
+        {
+            addDebugMessage(L"Failed to load tick archive segment");
+            segmentFirstTick[slot] = invalidTick;
+            segmentLastUse[slot] = 0;
+            return -1;
+        }
+        segmentFirstTick[slot] = firstTickOfSegment;
+        segmentLastUse[slot] = ++useCounter;
+        return slot;
+    }
+
+public:
+    // Number of bytes of RAM used by the archive
+    static constexpr unsigned long long ramSize = (numCacheSegments + 1) * segmentCapacity;
+
+    bool init()
+    {
+        if (!allocPoolWithErrorLog(L"tickArchive", ramSize, (void**)&segments[0], __LINE__))
+        {
+            return false;
+        }
+        for (int i = 1; i <= (int)numCacheSegments; i++)
+        {
+            segments[i] = segments[i - 1] + segmentCapacity;
+        }
+        lock = 0;
+        reset(0);
+        return true;
+    }
+
+    void deinit()
+    {
+        if (segments[0])
+        {
+            // slot buffers may have been swapped, so free the lowest address (begin of allocated buffer)
+            unsigned char* begin = segments[0];
+            for (int i = 1; i <= (int)numCacheSegments; i++)
+            {
+                if (segments[i] < begin)
+                {
+                    begin = segments[i];
+                }
+            }
+            freePool(begin);
+            segments[0] = nullptr;
+        }
+    }
+
+    // Discard archive and begin a new one starting with tick (at the beginning of an epoch). Files of the new archive
+    // are stored in directory "ticks<tick>".
+    void reset(unsigned int tick)
+    {
+        firstTick = tick;
+        endTick = tick;
+        useCounter = 0;
+        for (int i = 0; i <= (int)numCacheSegments; i++)
+        {
+            segmentFirstTick[i] = invalidTick;
+            segmentLastUse[i] = 0;
+        }
+
+        setText(directory, L"ticks");
+        appendNumber(directory, tick, FALSE);
+#ifndef NO_UEFI
+        if (tick && asyncCreateDir(directory) != 0)
+        {
+            addDebugMessage(L"Failed to create tick archive directory");
+        }
+#endif
+    }
+
+    void acquireLock()
+    {
+        ACQUIRE(lock);
+    }
+
+    void releaseLock()
+    {
+        RELEASE(lock);
+    }
+
+    // Check whether tick is archived
+    bool contains(unsigned int tick) const
+    {
+        return tick >= firstTick && tick < endTick;
+    }
+
+    // First tick that has not been archived yet (next tick to append)
+    unsigned int getEndTick() const
+    {
+        return endTick;
+    }
+
+    // Append tick getEndTick() with transactions[i] being the transaction in slot i of the tick or nullptr.
+    // Lock must be held.
+    void appendTick(const TickData& tickData, const Tick* ticks, const Transaction* const* transactions)
+    {
+        const unsigned int index = (endTick - firstTick) % segmentTicks;
+        if (index == 0)
+        {
+            SegmentHeader* h = header(0);
+            setMem(h, sizeof(SegmentHeader), 0);
+            h->magic = segmentMagic;
+            h->firstTick = endTick;
+            h->size = (unsigned int)transactionsBegin;
+            segmentFirstTick[0] = endTick;
+        }
+
+        SegmentHeader* h = header(0);
+        TickRecord* r = record(0, index);
+        copyMem(&r->tickData, &tickData, sizeof(TickData));
+        copyMem(r->ticks, ticks, sizeof(r->ticks));
+        for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+        {
+            if (transactions[i])
+            {
+                const unsigned int transactionSize = transactions[i]->totalSize();
+                ASSERT(h->size + transactionSize <= segmentCapacity);
+                r->transactionOffsets[i] = h->size;
+                copyMem(segments[0] + h->size, transactions[i], transactionSize);
+                h->size += transactionSize;
+            }
+            else
+            {
+                r->transactionOffsets[i] = 0;
+            }
+        }
+        ++h->numberOfTicks;
+        ++endTick;
+
+        if (h->numberOfTicks == segmentTicks)
+        {
+            finishSegment();
+        }
+    }
+
+    // Get archived tick or nullptr if it isn't archived or cannot be loaded. Lock must be held.
+    const TickRecord* getTick(unsigned int tick)
+    {
+        if (!contains(tick))
+        {
+            return nullptr;
+        }
+        const int slot = getSegment(segmentFirstTickOf(tick));
+        if (slot < 0)
+        {
+            return nullptr;
+        }
+        return record(slot, (tick - firstTick) % segmentTicks);
+    }
+
+    // Get transaction in slot of archived tick or nullptr if it isn't available. Lock must be held.
+    const Transaction* getTransaction(unsigned int tick, unsigned int transactionSlot)
+    {
+        ASSERT(transactionSlot < NUMBER_OF_TRANSACTIONS_PER_TICK);
+        const TickRecord* r = getTick(tick);
+        if (!r || !r->transactionOffsets[transactionSlot])
+        {
+            return nullptr;
+        }
+        // r is in the most recently used slot
+        const unsigned char* segment = (const unsigned char*)r - sizeof(SegmentHeader) - ((tick - firstTick) % segmentTicks) * sizeof(TickRecord);
+        return (const Transaction*)(segment + r->transactionOffsets[transactionSlot]);
+    }
+
+    // Find transaction of archived tick by digest, or return nullptr. Lock must be held.
+    const Transaction* findTransaction(unsigned int tick, const m256i& digest)
+    {
+        const TickRecord* r = getTick(tick);
+        if (!r)
+        {
+            return nullptr;
+        }
+        for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; i++)
+        {
+            if (r->tickData.transactionDigests[i] == digest)
+            {
+                return getTransaction(tick, i);
+            }
+        }
+        return nullptr;
+    }
+};
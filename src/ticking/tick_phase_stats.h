@@ -0,0 +1,129 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+#include "network_messages/system_info.h"
+
+#include "platform/concurrency.h"
+#include "platform/memory_util.h"
+#include "platform/assert.h"
+
+// Durations of the tick processor phases (see TickPhase) over a sliding window of the last windowSize samples of each
+// phase, for finding out where tick latency comes from.
+//
+// Each phase has a ring buffer of the samples in the window and a log-linear histogram of the same samples (similar
+// to HDR histograms), which is updated incrementally when a sample enters or leaves the window. Buckets are exact below
+// 16 mcs; above, each power of 2 is split into 16 buckets, so percentiles have a relative error of at most 1/16.
+//
+// Samples are added by the tick processor. Statistics may be read by any processor, so both are done with lock.
+template <unsigned int windowSize>
+class TickPhaseStats
+{
+    static constexpr unsigned int subBucketBits = 4;
+    static constexpr unsigned int subBucketCount = 1 << subBucketBits;
+    static constexpr unsigned int bucketCount = (32 - subBucketBits + 1) * subBucketCount;
+
+    struct Phase
+    {
+        unsigned int samples[windowSize];
+        unsigned int bucketSampleCounts[bucketCount];
+        unsigned int numberOfSamples;
+        unsigned int nextSample; // ring buffer index of next sample to add
+    };
+
+    Phase phases[TICK_PHASE_COUNT];
+    volatile char lock;
+
+    static unsigned int bucketIndex(unsigned int value)
+    {
+        if (value < subBucketCount)
+        {
+            return value;
+        }
+        const unsigned int exponent = 63 - (unsigned int)__lzcnt64(value);
+        return (exponent - subBucketBits + 1) * subBucketCount + ((value >> (exponent - subBucketBits)) & (subBucketCount - 1));
+    }
+
+    // Return highest value falling into bucket
+    static unsigned int bucketUpperBound(unsigned int index)
+    {
+        if (index < subBucketCount)
+        {
+            return index;
+        }
+        const unsigned int shift = index / subBucketCount - 1;
+        const unsigned long long lowerBound = ((unsigned long long)(subBucketCount + index % subBucketCount)) << shift;
+        return (unsigned int)(lowerBound + (1ULL << shift) - 1);
+    }
+
+    // Return smallest bucket upper bound that at least the given per mille of samples do not exceed. Lock must be held.
+    static unsigned int percentile(const Phase& phase, unsigned int perMille)
+    {
+        // rank of sample (1-based), rounding up
+        const unsigned long long rank = ((unsigned long long)phase.numberOfSamples * perMille + 999) / 1000;
+        unsigned long long count = 0;
+        for (unsigned int i = 0; i < bucketCount; i++)
+        {
+            count += phase.bucketSampleCounts[i];
+            if (count >= rank)
+            {
+                return bucketUpperBound(i);
+            }
+        }
+        return 0;
+    }
+
+public:
+    void reset()
+    {
+        setMem(phases, sizeof(phases), 0);
+        lock = 0;
+    }
+
+    // Add duration of phase in microseconds
+    void addSample(TickPhase phase, unsigned long long durationMicroseconds)
+    {
+        ASSERT(phase < TICK_PHASE_COUNT);
+        const unsigned int value = (durationMicroseconds > 0xffffffff) ? 0xffffffff : (unsigned int)durationMicroseconds;
+
+        ACQUIRE(lock);
+        Phase& p = phases[phase];
+        if (p.numberOfSamples == windowSize)
+        {
+            // window is full -> remove oldest sample, which is overwritten
+            --p.bucketSampleCounts[bucketIndex(p.samples[p.nextSample])];
+        }
+        else
+        {
+            ++p.numberOfSamples;
+        }
+        p.samples[p.nextSample] = value;
+        ++p.bucketSampleCounts[bucketIndex(value)];
+        p.nextSample = (p.nextSample + 1) % windowSize;
+        RELEASE(lock);
+    }
+
+    // Get statistics of all phases
+    void getStats(RespondTickPhaseStats& stats)
+    {
+        stats.windowSize = windowSize;
+        ACQUIRE(lock);
+        for (unsigned int i = 0; i < TICK_PHASE_COUNT; i++)
+        {
+            const Phase& p = phases[i];
+            RespondTickPhaseStats::PhaseStats& s = stats.phases[i];
+            s.numberOfSamples = p.numberOfSamples;
+            s.p50 = percentile(p, 500);
+            s.p99 = percentile(p, 990);
+            s.max = 0;
+            for (unsigned int j = 0; j < p.numberOfSamples; j++)
+            {
+                if (p.samples[j] > s.max)
+                {
+                    s.max = p.samples[j];
+                }
+            }
+        }
+        RELEASE(lock);
+    }
+};
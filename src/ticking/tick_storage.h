@@ -11,6 +11,10 @@
 
 #include "public_settings.h"
 
+#if TICK_STORAGE_TIERED_MODE
+#include "ticking/tick_archive.h"
+#endif
+
 #if TICK_STORAGE_AUTOSAVE_MODE
 static unsigned short SNAPSHOT_METADATA_FILE_NAME[] = L"snapshotMetadata.???";
 static unsigned short SNAPSHOT_TICK_DATA_FILE_NAME[] = L"snapshotTickdata.???";
@@ -18,6 +22,9 @@ static unsigned short SNAPSHOT_TICKS_FILE_NAME[] = L"snapshotTicks.???";
 static unsigned short SNAPSHOT_TICK_TRANSACTION_OFFSET_FILE_NAME[] = L"snapshotTickTransactionOffsets.???";
 static unsigned short SNAPSHOT_TRANSACTIONS_FILE_NAME[] = L"snapshotTickTransaction.???";
 #endif
+#if TICK_STORAGE_TIERED_MODE && TICK_STORAGE_AUTOSAVE_MODE
+#error "TICK_STORAGE_TIERED_MODE cannot be combined with TICK_STORAGE_AUTOSAVE_MODE"
+#endif
 constexpr unsigned short INVALIDATED_TICK_DATA = 0xffff;
 // Encapsulated tick storage of current epoch that can additionally keep the last ticks of the previous epoch.
 // The number of ticks to keep from the previous epoch is TICKS_TO_KEEP_FROM_PRIOR_EPOCH (defined in public_settings.h).
@@ -30,27 +37,68 @@ constexpr unsigned short INVALIDATED_TICK_DATA = 0xffff;
 // - tickTransactions (continuous buffer efficiently storing the variable-size transactions)
 // - tickTransactionOffsets (offsets of transactions in buffer, order in tickTransactions may differ)
 // - nextTickTransactionOffset (offset of next transaction to be added)
+//
+// Tiered mode (TICK_STORAGE_TIERED_MODE in private_settings.h): only ticksInRamCurrentEpoch ticks of the current epoch
+// are kept in RAM, stored in ring buffers. Tick indices and transaction offsets are the same as without tiered mode
+// and are mapped to the ring buffers by the access structs. archiveOldTicks() moves ticks that are older than half of
+// the RAM window to tickArchive, from which they are read via ts.tickArchive (see tick_archive.h).
+// The transaction ring buffer has space for the transactions of two RAM windows, because transactions of a tick may
+// be added before the transactions of older ticks that are still in RAM. It is followed by MAX_TRANSACTION_SIZE bytes of
+// slack, so a transaction starting at the end of the ring is continuous in memory.
+//
+// Deferred clearing (beginEpoch() with deferClearing = true): in the seamless epoch transition, only the storage of the
+// first deferredClearingSyncTicks ticks of the new epoch is cleared in beginEpoch(). The rest is cleared in chunks by
+// clearAhead(), which is called by idle processors. Ticks whose storage hasn't been cleared yet are treated as not
+// stored (see tickInCurrentEpochStorage()), so stale data of the previous epoch is never read or sent out.
 class TickStorage
 {
 private:
     static constexpr unsigned long long tickDataLength = MAX_NUMBER_OF_TICKS_PER_EPOCH + TICKS_TO_KEEP_FROM_PRIOR_EPOCH;
-    static constexpr unsigned long long tickDataSize = tickDataLength * sizeof(TickData);
-    
+
+#if TICK_STORAGE_TIERED_MODE
+    static constexpr unsigned long long ticksInRamCurrentEpoch = (TICK_STORAGE_RAM_TICKS < MAX_NUMBER_OF_TICKS_PER_EPOCH) ? TICK_STORAGE_RAM_TICKS : MAX_NUMBER_OF_TICKS_PER_EPOCH;
+    static_assert(ticksInRamCurrentEpoch >= 2 * TICKS_TO_KEEP_FROM_PRIOR_EPOCH, "TICK_STORAGE_RAM_TICKS too small");
+    static constexpr unsigned int archiveSegmentTicks = 16;
+    static constexpr unsigned int archiveCacheSegments = 4;
+#else
+    static constexpr unsigned long long ticksInRamCurrentEpoch = MAX_NUMBER_OF_TICKS_PER_EPOCH;
+#endif
+    static constexpr unsigned long long tickDataLengthInRam = ticksInRamCurrentEpoch + TICKS_TO_KEEP_FROM_PRIOR_EPOCH;
+    static constexpr unsigned long long tickDataSize = tickDataLengthInRam * sizeof(TickData);
+
     static constexpr unsigned long long ticksLengthCurrentEpoch = ((unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH) * NUMBER_OF_COMPUTORS;
     static constexpr unsigned long long ticksLengthPreviousEpoch = ((unsigned long long)TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_COMPUTORS;
     static constexpr unsigned long long ticksLength = ticksLengthCurrentEpoch + ticksLengthPreviousEpoch;
-    static constexpr unsigned long long ticksSize = ticksLength * sizeof(Tick);
+    static constexpr unsigned long long ticksLengthInRam = (ticksInRamCurrentEpoch + TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_COMPUTORS;
+    static constexpr unsigned long long ticksSize = ticksLengthInRam * sizeof(Tick);
 
     static constexpr unsigned long long tickTransactionsSizeCurrentEpoch = FIRST_TICK_TRANSACTION_OFFSET + (((unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK * MAX_TRANSACTION_SIZE / TRANSACTION_SPARSENESS);
     static constexpr unsigned long long tickTransactionsSizePreviousEpoch = (((unsigned long long)TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK * MAX_TRANSACTION_SIZE / TRANSACTION_SPARSENESS);
     static constexpr unsigned long long tickTransactionsSize = tickTransactionsSizeCurrentEpoch + tickTransactionsSizePreviousEpoch;
+#if TICK_STORAGE_TIERED_MODE
+    static constexpr unsigned long long tickTransactionsRingSize = 2 * ticksInRamCurrentEpoch * NUMBER_OF_TRANSACTIONS_PER_TICK * MAX_TRANSACTION_SIZE;
+    static_assert(tickTransactionsRingSize >= tickTransactionsSizePreviousEpoch, "Transactions of previous epoch must fit into ring");
+    static constexpr unsigned long long tickTransactionsSizeCurrentEpochInRam = tickTransactionsRingSize + MAX_TRANSACTION_SIZE;
+#else
+    static constexpr unsigned long long tickTransactionsSizeCurrentEpochInRam = tickTransactionsSizeCurrentEpoch;
+#endif
+    static constexpr unsigned long long tickTransactionsSizeInRam = tickTransactionsSizeCurrentEpochInRam + tickTransactionsSizePreviousEpoch;
 
     static constexpr unsigned long long tickTransactionOffsetsLengthCurrentEpoch = ((unsigned long long)MAX_NUMBER_OF_TICKS_PER_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK;
     static constexpr unsigned long long tickTransactionOffsetsLengthPreviousEpoch = ((unsigned long long)TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK;
     static constexpr unsigned long long tickTransactionOffsetsLength = tickTransactionOffsetsLengthCurrentEpoch + tickTransactionOffsetsLengthPreviousEpoch;
     static constexpr unsigned long long tickTransactionOffsetsSizeCurrentEpoch = tickTransactionOffsetsLengthCurrentEpoch * sizeof(unsigned long long);
     static constexpr unsigned long long tickTransactionOffsetsSizePreviousEpoch = tickTransactionOffsetsLengthPreviousEpoch * sizeof(unsigned long long);
-    static constexpr unsigned long long tickTransactionOffsetsSize = tickTransactionOffsetsLength * sizeof(unsigned long long);
+    static constexpr unsigned long long tickTransactionOffsetsLengthInRam = (ticksInRamCurrentEpoch + TICKS_TO_KEEP_FROM_PRIOR_EPOCH) * NUMBER_OF_TRANSACTIONS_PER_TICK;
+    static constexpr unsigned long long tickTransactionOffsetsSize = tickTransactionOffsetsLengthInRam * sizeof(unsigned long long);
+
+#if TICK_STORAGE_TIERED_MODE
+    // Entries of transactions in archived ticks are reused, so the hash map only needs to cover the ticks in RAM
+    static constexpr unsigned long long transactionsDigestLength = 4 * ticksInRamCurrentEpoch * NUMBER_OF_TRANSACTIONS_PER_TICK;
+    static constexpr unsigned long long transactionsDigestMaxProbes = 256;
+#else
+    static constexpr unsigned long long transactionsDigestLength = tickTransactionOffsetsLengthCurrentEpoch;
+#endif
 
 
     // Tick number range of current epoch storage
@@ -61,28 +109,53 @@ private:
     inline static unsigned int oldTickBegin = 0;
     inline static unsigned int oldTickEnd = 0;
 
-    // Allocated tick data buffer with tickDataLength elements (includes current and previous epoch data)
+    // Number of ticks cleared in beginEpoch() with deferred clearing
+    static constexpr unsigned int deferredClearingSyncTicks = 32;
+
+    // Number of ticks / transaction bytes cleared per call of clearAhead()
+    static constexpr unsigned int deferredClearingChunkTicks = 16;
+    static constexpr unsigned long long deferredClearingChunkTransactionBytes = 1024 * 1024;
+
+    // Ticks [tickBegin, clearedTickEnd) of current epoch have been cleared (clearedTickEnd == tickEnd if clearing is done)
+    inline static volatile unsigned int clearedTickEnd = 0;
+
+    // Number of tick slots of current epoch in RAM that have been cleared
+    inline static unsigned long long clearedTickSlots = 0;
+
+    // Transaction buffer of current epoch in RAM has been cleared up to this offset (except for the space occupied by
+    // transactions added after beginEpoch(), which doesn't need to be cleared)
+    inline static unsigned long long clearedTransactionsEnd = 0;
+
+    // Lock for clearing (only one processor clears at a time)
+    inline static volatile char clearingLock = 0;
+
+#if TICK_STORAGE_TIERED_MODE
+    // First tick of current epoch that is stored in RAM (ticks in [tickBegin, ramTickBegin) are in tickArchive)
+    inline static volatile unsigned int ramTickBegin = 0;
+#endif
+
+    // Allocated tick data buffer with tickDataLengthInRam elements (includes current and previous epoch data)
     inline static TickData* tickDataPtr = nullptr;
 
-    // Allocated ticks buffer with ticksLength elements (includes current and previous epoch data)
+    // Allocated ticks buffer with ticksLengthInRam elements (includes current and previous epoch data)
     inline static Tick* ticksPtr = nullptr;
 
-    // Allocated tickTransactions buffer with tickTransactionsSize bytes (includes current and previous epoch data)
+    // Allocated tickTransactions buffer with tickTransactionsSizeInRam bytes (includes current and previous epoch data)
     inline static unsigned char* tickTransactionsPtr = nullptr;
 
-    // Allocated tickTransactionOffsets buffer with tickTransactionOffsetsLength elements (includes current and previous epoch data)
+    // Allocated tickTransactionOffsets buffer with tickTransactionOffsetsLengthInRam elements (includes current and previous epoch data)
     inline static unsigned long long* tickTransactionOffsetsPtr = nullptr;
 
-    // Tick data of previous epoch. Points to tickData + MAX_NUMBER_OF_TICKS_PER_EPOCH
+    // Tick data of previous epoch. Points to tickData + ticksInRamCurrentEpoch
     inline static TickData* oldTickDataPtr = nullptr;
 
-    // Ticks of previous epoch. Points to ticksPtr + ticksLengthCurrentEpoch
+    // Ticks of previous epoch. Points to ticksPtr + ticksInRamCurrentEpoch * NUMBER_OF_COMPUTORS
     inline static Tick* oldTicksPtr = nullptr;
 
-    // Tick transaction buffer of previous epoch. Points to tickTransactionsPtr + tickTransactionsSizeCurrentEpoch.
+    // Tick transaction buffer of previous epoch. Points to tickTransactionsPtr + tickTransactionsSizeCurrentEpochInRam.
     inline static unsigned char* oldTickTransactionsPtr = nullptr;
 
-    // Tick transaction offsets of previous epoch. Points to tickTransactionOffsetsPtr + tickTransactionOffsetsLengthCurrentEpoch.
+    // Tick transaction offsets of previous epoch. Points to tickTransactionOffsetsPtr + ticksInRamCurrentEpoch * NUMBER_OF_TRANSACTIONS_PER_TICK.
     inline static unsigned long long* oldTickTransactionOffsetsPtr = nullptr;
 
     // Allocated transaction access digest buffer with current epoch transactions.
@@ -110,6 +183,54 @@ private:
         // may need to store more meta data here to verify consistency when loading (ie: some nodes have different configs and can't use the saved files)
     } metaData;
     inline static unsigned long long lastCheckTransactionOffset = 0; // use for save/load transaction state
+
+    // Data of the tick storage is saved by copying it in parts into saveStagingBuffer while holding the lock(s)
+    // protecting it, so the locks aren't held while writing to disk. Saving fails if tickBegin changed (new epoch).
+    enum class SaveLock { tickData, ticks, tickTransactions };
+    struct LockedSaveSource
+    {
+        const unsigned char* data;
+        SaveLock lock;
+        unsigned int tickBegin;
+    };
+    static constexpr unsigned long long saveStagingBufferSize = MAX_FILE_IO_CHUNK_SIZE;
+    inline static unsigned char* saveStagingBuffer = nullptr;
+
+    static const unsigned char* copyLockedPartToSave(void* context, unsigned long long offset, unsigned long long maxPartSize, unsigned long long& partSize)
+    {
+        const LockedSaveSource* source = (const LockedSaveSource*)context;
+        partSize = (maxPartSize < saveStagingBufferSize) ? maxPartSize : saveStagingBufferSize;
+        switch (source->lock)
+        {
+        case SaveLock::tickData:
+            TickDataAccess::acquireLock();
+            copyMem(saveStagingBuffer, source->data + offset, partSize);
+            TickDataAccess::releaseLock();
+            break;
+        case SaveLock::ticks:
+            for (int i = 0; i < NUMBER_OF_COMPUTORS; i++) TicksAccess::acquireLock(i);
+            copyMem(saveStagingBuffer, source->data + offset, partSize);
+            for (int i = 0; i < NUMBER_OF_COMPUTORS; i++) TicksAccess::releaseLock(i);
+            break;
+        case SaveLock::tickTransactions:
+            TickTransactionsAccess::acquireLock();
+            copyMem(saveStagingBuffer, source->data + offset, partSize);
+            TickTransactionsAccess::releaseLock();
+            break;
+        }
+        if (tickBegin != source->tickBegin)
+        {
+            // epoch changed while saving -> data may have been cleared, abort
+            partSize = 0;
+        }
+        return saveStagingBuffer;
+    }
+
+    bool saveLocked(CHAR16* fileName, unsigned long long totalSize, const void* data, SaveLock lock, unsigned int savedTickBegin, CHAR16* directory)
+    {
+        LockedSaveSource source{ (const unsigned char*)data, lock, savedTickBegin };
+        return saveLargeFileGathered(fileName, totalSize, copyLockedPartToSave, &source, directory) == (long long)totalSize;
+    }
     void prepareMetaDataFilename(short epoch)
     {
         addEpochToFileName(SNAPSHOT_METADATA_FILE_NAME, sizeof(SNAPSHOT_METADATA_FILE_NAME) / sizeof(SNAPSHOT_METADATA_FILE_NAME[0]), epoch);
@@ -136,38 +257,28 @@ private:
         }
         return true;
     }
-    bool saveTickData(unsigned long long nTick, CHAR16* directory = NULL)
+    bool saveTickData(unsigned long long nTick, unsigned int savedTickBegin, CHAR16* directory = NULL)
     {
-        long long totalWriteSize = nTick * sizeof(TickData);
-        auto sz = saveLargeFile(SNAPSHOT_TICK_DATA_FILE_NAME, totalWriteSize, (unsigned char*)tickDataPtr, directory);
-        if (sz != totalWriteSize)
-        {
-            return false;
-        }
-        return true;
+        return saveLocked(SNAPSHOT_TICK_DATA_FILE_NAME, nTick * sizeof(TickData), tickDataPtr, SaveLock::tickData, savedTickBegin, directory);
     }
-    bool saveTicks(unsigned long long nTick, CHAR16* directory = NULL)
+    bool saveTicks(unsigned long long nTick, unsigned int savedTickBegin, CHAR16* directory = NULL)
     {
-        long long totalWriteSize = nTick * sizeof(Tick) * NUMBER_OF_COMPUTORS;
-        auto sz = saveLargeFile(SNAPSHOT_TICKS_FILE_NAME, totalWriteSize, (unsigned char*)ticksPtr, directory);
-        if (sz != totalWriteSize)
-        {
-            return false;
-        }
-        return true;
+        return saveLocked(SNAPSHOT_TICKS_FILE_NAME, nTick * sizeof(Tick) * NUMBER_OF_COMPUTORS, ticksPtr, SaveLock::ticks, savedTickBegin, directory);
+    }
+    bool saveTickTransactionOffsets(unsigned long long nTick, unsigned int savedTickBegin, CHAR16* directory = NULL)
+    {
+        return saveLocked(SNAPSHOT_TICK_TRANSACTION_OFFSET_FILE_NAME, nTick * sizeof(tickTransactionOffsetsPtr[0]) * NUMBER_OF_TRANSACTIONS_PER_TICK,
+            tickTransactionOffsetsPtr, SaveLock::tickTransactions, savedTickBegin, directory);
     }
-    bool saveTickTransactionOffsets(unsigned long long nTick, CHAR16* directory = NULL)
+    bool saveTransactions(unsigned long long nTick, unsigned int savedTickBegin, long long& outTotalTransactionSize, unsigned long long& outNextTickTransactionOffset, CHAR16* directory = NULL)
     {
-        long long totalWriteSize = nTick * sizeof(tickTransactionOffsetsPtr[0]) * NUMBER_OF_TRANSACTIONS_PER_TICK;
-        auto sz = saveLargeFile(SNAPSHOT_TICK_TRANSACTION_OFFSET_FILE_NAME, totalWriteSize, (unsigned char*)tickTransactionOffsetsPtr, directory);
-        if (sz != totalWriteSize)
+        tickTransactions.acquireLock();
+        if (tickBegin != savedTickBegin)
         {
+            tickTransactions.releaseLock();
+            outTotalTransactionSize = -1;
             return false;
         }
-        return true;
-    }
-    bool saveTransactions(unsigned long long nTick, long long& outTotalTransactionSize, unsigned long long& outNextTickTransactionOffset, CHAR16* directory = NULL)
-    {
         unsigned int toTick = tickBegin + (unsigned int)(nTick) - 1;
         unsigned long long toPtr = 0;
         outNextTickTransactionOffset = FIRST_TICK_TRANSACTION_OFFSET;
@@ -195,12 +306,11 @@ private:
             toPtr = maxOffset;
             outNextTickTransactionOffset = maxOffset;
         }
+        tickTransactions.releaseLock();
         
         // saving from the first tx of from tick to the last tx of (totick)
         long long totalWriteSize = toPtr;
-        unsigned char* ptr = tickTransactionsPtr;
-        auto sz = saveLargeFile(SNAPSHOT_TRANSACTIONS_FILE_NAME, totalWriteSize, (unsigned char*)ptr, directory);
-        if (sz != totalWriteSize)
+        if (!saveLocked(SNAPSHOT_TRANSACTIONS_FILE_NAME, totalWriteSize, tickTransactionsPtr, SaveLock::tickTransactions, savedTickBegin, directory))
         {
             outTotalTransactionSize = -1;
             return false;
@@ -296,53 +406,64 @@ public:
     // (1) check current meta data state
     // (2) write all missing chunks to disk
     // (3) update metadata state
+    // The data is copied in parts while holding the locks and written without them (see copyLockedPartToSave()). If the
+    // epoch changes while saving, it is aborted before the metadata marks the files as valid (returns 7).
     int trySaveToFile(unsigned int epoch, unsigned int tick, CHAR16* directory = NULL)
     {   
-        if (tick <= tickBegin) {
+        const unsigned int savedTickBegin = tickBegin;
+        if (tick <= savedTickBegin) {
             return 6;
         }
-        unsigned long long nTick = tick - tickBegin + 1; // inclusive [tickBegin, tick]
+        unsigned long long nTick = tick - savedTickBegin + 1; // inclusive [tickBegin, tick]
         prepareFilenames(epoch);
 
+        if (!allocLargeWithErrorLog(L"saveStagingBuffer", saveStagingBufferSize, (void**)&saveStagingBuffer, __LINE__))
+        {
+            return 8;
+        }
+        const int result = trySaveToFileWithStagingBuffer(epoch, tick, nTick, savedTickBegin, directory);
+        freeLarge(saveStagingBuffer, saveStagingBufferSize);
+        saveStagingBuffer = nullptr;
+        return result;
+    }
+
+private:
+    int trySaveToFileWithStagingBuffer(unsigned int epoch, unsigned int tick, unsigned long long nTick, unsigned int savedTickBegin, CHAR16* directory)
+    {
         logToConsole(L"Saving tick data...");
-        tickData.acquireLock();
-        if (!saveTickData(nTick, directory))
+        if (!saveTickData(nTick, savedTickBegin, directory))
         {
-            tickData.releaseLock();
             logToConsole(L"Failed to save tickData");
             return 5;
         }
-        tickData.releaseLock();
 
         logToConsole(L"Saving quorum ticks");
-        for (int i = 0; i < NUMBER_OF_COMPUTORS; i++) ticks.acquireLock(i);
-        if (!saveTicks(nTick, directory))
+        if (!saveTicks(nTick, savedTickBegin, directory))
         {
-            for (int i = 0; i < NUMBER_OF_COMPUTORS; i++) ticks.releaseLock(i);
             logToConsole(L"Failed to save Ticks");
             return 4;
         }
-        for (int i = 0; i < NUMBER_OF_COMPUTORS; i++) ticks.releaseLock(i);
 
-
-        tickTransactions.acquireLock();
         logToConsole(L"Saving tick transaction offset");
-        if (!saveTickTransactionOffsets(nTick, directory))
+        if (!saveTickTransactionOffsets(nTick, savedTickBegin, directory))
         {
-            tickTransactions.releaseLock();
             logToConsole(L"Failed to save transactionOffset");
             return 3;
         }
         logToConsole(L"Saving transactions");
         long long outTotalTransactionSize = 0;
         unsigned long long outNextTickTransactionOffset = 0;
-        if (!saveTransactions(nTick, outTotalTransactionSize, outNextTickTransactionOffset, directory))
+        if (!saveTransactions(nTick, savedTickBegin, outTotalTransactionSize, outNextTickTransactionOffset, directory))
         {
-            tickTransactions.releaseLock();
             logToConsole(L"Failed to save transactions");
             return 2;
         }
-        tickTransactions.releaseLock();
+
+        if (tickBegin != savedTickBegin)
+        {
+            logToConsole(L"Epoch changed while saving tick storage");
+            return 7;
+        }
 
         logToConsole(L"Saving meta data");
         if (!saveMetaData(epoch, tick, outTotalTransactionSize, outNextTickTransactionOffset, directory))
@@ -354,6 +475,8 @@ public:
         return 0;
     }
 
+public:
+
     // Load procedure:
     // (1) try to load metadata file
     // (2) sanity check meta data file
@@ -444,31 +567,45 @@ public:
     static bool init()
     {
         // TODO: allocate everything with one continuous buffer
-        if (!allocPoolWithErrorLog(L"tickDataPtr ", tickDataSize, (void**)&tickDataPtr, __LINE__)
-            || !allocPoolWithErrorLog(L"tickPtr", ticksSize, (void**)&ticksPtr, __LINE__)
-            || !allocPoolWithErrorLog(L"tickTransactionPtr", tickTransactionsSize, (void**)&tickTransactionsPtr, __LINE__)
-            || !allocPoolWithErrorLog(L"tickTransactionOffset", tickTransactionOffsetsSize, (void**)&tickTransactionOffsetsPtr, __LINE__)
-            || !allocPoolWithErrorLog(L"tickTransactionsDigestPtr", tickTransactionOffsetsLengthCurrentEpoch * sizeof(TransactionsDigestAccess::HashMapEntry), (void**)&tickTransactionsDigestPtr, __LINE__))
+        if (!allocLargeWithErrorLog(L"tickDataPtr ", tickDataSize, (void**)&tickDataPtr, __LINE__)
+            || !allocLargeWithErrorLog(L"tickPtr", ticksSize, (void**)&ticksPtr, __LINE__)
+            || !allocLargeWithErrorLog(L"tickTransactionPtr", tickTransactionsSizeInRam, (void**)&tickTransactionsPtr, __LINE__)
+            || !allocLargeWithErrorLog(L"tickTransactionOffset", tickTransactionOffsetsSize, (void**)&tickTransactionOffsetsPtr, __LINE__)
+            || !allocLargeWithErrorLog(L"tickTransactionsDigestPtr", transactionsDigestLength * sizeof(TransactionsDigestAccess::HashMapEntry), (void**)&tickTransactionsDigestPtr, __LINE__))
+        {
+            return false;
+        }
+#if TICK_STORAGE_TIERED_MODE
+        if (!tickArchive.init())
         {
             return false;
         }
+#endif
 
         ASSERT(tickDataLock == 0);
         setMem((void*)ticksLocks, sizeof(ticksLocks), 0);
         ASSERT(tickTransactionsLock == 0);
         nextTickTransactionOffset = FIRST_TICK_TRANSACTION_OFFSET;
 
-        oldTickDataPtr = tickDataPtr + MAX_NUMBER_OF_TICKS_PER_EPOCH;
-        oldTicksPtr = ticksPtr + ticksLengthCurrentEpoch;
-        oldTickTransactionsPtr = tickTransactionsPtr + tickTransactionsSizeCurrentEpoch;
-        oldTickTransactionOffsetsPtr = tickTransactionOffsetsPtr + tickTransactionOffsetsLengthCurrentEpoch;
+        clearingLock = 0;
+        clearedTickEnd = 0;
+        clearedTickSlots = 0;
+        clearedTransactionsEnd = 0;
+
+        oldTickDataPtr = tickDataPtr + ticksInRamCurrentEpoch;
+        oldTicksPtr = ticksPtr + ticksInRamCurrentEpoch * NUMBER_OF_COMPUTORS;
+        oldTickTransactionsPtr = tickTransactionsPtr + tickTransactionsSizeCurrentEpochInRam;
+        oldTickTransactionOffsetsPtr = tickTransactionOffsetsPtr + ticksInRamCurrentEpoch * NUMBER_OF_TRANSACTIONS_PER_TICK;
 
         tickBegin = 0;
         tickEnd = 0;
         oldTickBegin = 0;
         oldTickEnd = 0;
+#if TICK_STORAGE_TIERED_MODE
+        ramTickBegin = 0;
+#endif
 
-        setMem((void*)tickTransactionsDigestPtr, tickTransactionOffsetsLengthCurrentEpoch * sizeof(TransactionsDigestAccess::HashMapEntry), 0);
+        setMem((void*)tickTransactionsDigestPtr, transactionsDigestLength * sizeof(TransactionsDigestAccess::HashMapEntry), 0);
 
         return true;
     }
@@ -478,33 +615,39 @@ public:
     {
         if (tickDataPtr)
         {
-            freePool(tickDataPtr);
+            freeLarge(tickDataPtr, tickDataSize);
         }
 
         if (ticksPtr)
         {
-            freePool(ticksPtr);
+            freeLarge(ticksPtr, ticksSize);
         }
 
         if (tickTransactionOffsetsPtr)
         {
-            freePool(tickTransactionOffsetsPtr);
+            freeLarge(tickTransactionOffsetsPtr, tickTransactionOffsetsSize);
         }
 
         if (tickTransactionsPtr)
         {
-            freePool(tickTransactionsPtr);
+            freeLarge(tickTransactionsPtr, tickTransactionsSizeInRam);
         }
 
         if (tickTransactionsDigestPtr)
         {
-            freePool(tickTransactionsDigestPtr);
+            freeLarge(tickTransactionsDigestPtr, transactionsDigestLength * sizeof(TransactionsDigestAccess::HashMapEntry));
         }
+
+#if TICK_STORAGE_TIERED_MODE
+        tickArchive.deinit();
+#endif
     }
 
     // Begin new epoch. If not called the first time (seamless transition), assume that the ticks to keep
     // are ticks in [newInitialTick-TICKS_TO_KEEP_FROM_PRIOR_EPOCH, newInitialTick-1].
-    static void beginEpoch(unsigned int newInitialTick)
+    // Begin new epoch starting with newInitialTick. With deferClearing, most of the storage of the new epoch is cleared
+    // later by clearAhead() (only applies to seamless epoch transition, not to node startup).
+    static void beginEpoch(unsigned int newInitialTick, bool deferClearing = false)
     {
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         addDebugMessage(L"Begin ts.beginEpoch()");
@@ -530,8 +673,18 @@ public:
             const unsigned int tickCount = oldTickEnd - oldTickBegin;
 
             // copy ticks and tick data from recently ended epoch into storage of previous epoch
+#if TICK_STORAGE_TIERED_MODE
+            // ticks may wrap around the end of the ring buffers
+            ASSERT(oldTickBegin >= ramTickBegin);
+            for (unsigned int i = 0; i < tickCount; ++i)
+            {
+                copyMem(oldTickDataPtr + i, &TickDataAccess::getByTickInCurrentEpoch(oldTickBegin + i), sizeof(TickData));
+                copyMem(oldTicksPtr + i * NUMBER_OF_COMPUTORS, TicksAccess::getByTickInCurrentEpoch(oldTickBegin + i), NUMBER_OF_COMPUTORS * sizeof(Tick));
+            }
+#else
             copyMem(oldTickDataPtr, tickDataPtr + tickIndex, tickCount * sizeof(TickData));
             copyMem(oldTicksPtr, ticksPtr + (tickIndex * NUMBER_OF_COMPUTORS), tickCount * NUMBER_OF_COMPUTORS * sizeof(Tick));
+#endif
 
             // copy transactions and transactionOffsets
             {
@@ -539,7 +692,9 @@ public:
                 const unsigned long long totalTransactionSizesSum = nextTickTransactionOffset - FIRST_TICK_TRANSACTION_OFFSET;
                 const unsigned long long keepTransactionSizesSum = (totalTransactionSizesSum <= tickTransactionsSizePreviousEpoch) ? totalTransactionSizesSum : tickTransactionsSizePreviousEpoch;
                 const unsigned long long firstToKeepOffset = nextTickTransactionOffset - keepTransactionSizesSum;
+#if !TICK_STORAGE_TIERED_MODE
                 copyMem(oldTickTransactionsPtr, tickTransactionsPtr + firstToKeepOffset, keepTransactionSizesSum);
+#endif
 
                 // adjust offsets (based on end of transactions)
                 const unsigned long long offsetDelta = (tickTransactionsSizeCurrentEpoch + keepTransactionSizesSum) - nextTickTransactionOffset;
@@ -560,6 +715,10 @@ public:
                             // set offset of transcation
                             const unsigned long long offsetPrevEp = offset + offsetDelta;
                             tickOffsetsPrevEp[transactionIdx] = offsetPrevEp;
+#if TICK_STORAGE_TIERED_MODE
+                            // transactions are copied one by one, because the byte range may wrap around the end of the ring buffer
+                            copyMem(TickTransactionsAccess::ptr(offsetPrevEp), TickTransactionsAccess::ptr(offset), TickTransactionsAccess::ptr(offset)->totalSize());
+#endif
 
                             // check offset and transaction
                             ASSERT(offset >= FIRST_TICK_TRANSACTION_OFFSET);
@@ -584,11 +743,15 @@ public:
                 }
             }
 
-            // reset data storage of new epoch
-            setMem(tickDataPtr, MAX_NUMBER_OF_TICKS_PER_EPOCH * sizeof(TickData), 0);
-            setMem(ticksPtr, ticksLengthCurrentEpoch * sizeof(Tick), 0);
-            setMem(tickTransactionOffsetsPtr, tickTransactionOffsetsSizeCurrentEpoch, 0);
-            setMem(tickTransactionsPtr, tickTransactionsSizeCurrentEpoch, 0);
+            // reset data storage of new epoch (or only the first ticks with deferred clearing)
+            clearedTickSlots = 0;
+            clearedTransactionsEnd = 0;
+            clearTickSlots((deferClearing && deferredClearingSyncTicks < ticksInRamCurrentEpoch) ? deferredClearingSyncTicks : ticksInRamCurrentEpoch);
+            if (!deferClearing)
+            {
+                setMem(tickTransactionsPtr, tickTransactionsSizeCurrentEpochInRam, 0);
+                clearedTransactionsEnd = tickTransactionsSizeCurrentEpochInRam;
+            }
         }
         else
         {
@@ -596,15 +759,24 @@ public:
             setMem(tickDataPtr, tickDataSize, 0);
             setMem(ticksPtr, ticksSize, 0);
             setMem(tickTransactionOffsetsPtr, tickTransactionOffsetsSize, 0);
-            setMem(tickTransactionsPtr, tickTransactionsSize, 0);
+            setMem(tickTransactionsPtr, tickTransactionsSizeInRam, 0);
+            clearedTickSlots = ticksInRamCurrentEpoch;
+            clearedTransactionsEnd = tickTransactionsSizeCurrentEpochInRam;
             oldTickBegin = 0;
             oldTickEnd = 0;
         }
         // Transaction digest look up need to reset at the begining of epoch for pointing to valid current epoch transaction
-        setMem((void*)tickTransactionsDigestPtr, tickTransactionOffsetsLengthCurrentEpoch * sizeof(TransactionsDigestAccess::HashMapEntry), 0);
+        setMem((void*)tickTransactionsDigestPtr, transactionsDigestLength * sizeof(TransactionsDigestAccess::HashMapEntry), 0);
 
         tickBegin = newInitialTick;
         tickEnd = newInitialTick + MAX_NUMBER_OF_TICKS_PER_EPOCH;
+        updateClearedTickEnd();
+#if TICK_STORAGE_TIERED_MODE
+        ramTickBegin = newInitialTick;
+        tickArchive.acquireLock();
+        tickArchive.reset(newInitialTick);
+        tickArchive.releaseLock();
+#endif
 
         nextTickTransactionOffset = FIRST_TICK_TRANSACTION_OFFSET;
 #if !defined(NDEBUG) && !defined(NO_UEFI)
@@ -612,6 +784,99 @@ public:
 #endif
     }
 
+    // Return if deferred clearing of the current epoch storage hasn't been finished yet.
+    static bool isClearingPending()
+    {
+        return clearedTickSlots < ticksInRamCurrentEpoch || clearedTransactionsEnd < tickTransactionsSizeCurrentEpochInRam;
+    }
+
+    // Clear next chunk of the current epoch storage after beginEpoch() with deferred clearing. To be called by idle
+    // processors. Returns false if nothing has been cleared (because clearing is done or another processor is clearing).
+    static bool clearAhead()
+    {
+        if (!isClearingPending() || !TRY_ACQUIRE(clearingLock))
+            return false;
+
+        bool cleared = false;
+        if (clearedTickSlots < ticksInRamCurrentEpoch)
+        {
+            // ticks first, because ticks that are not cleared cannot be received
+            const unsigned long long remaining = ticksInRamCurrentEpoch - clearedTickSlots;
+            clearTickSlots((remaining < deferredClearingChunkTicks) ? remaining : deferredClearingChunkTicks);
+            updateClearedTickEnd();
+            cleared = true;
+        }
+        else if (clearedTransactionsEnd < tickTransactionsSizeCurrentEpochInRam)
+        {
+            // Transactions are added at nextTickTransactionOffset, so the space before doesn't need to be cleared and
+            // must not be overwritten. Holding the lock makes sure no transaction is added to the chunk concurrently.
+            TickTransactionsAccess::acquireLock();
+            unsigned long long begin = clearedTransactionsEnd;
+            const unsigned long long nextOffsetInRam = transactionOffsetInRam(nextTickTransactionOffset);
+            if (nextTickTransactionOffset >= tickTransactionsSizeCurrentEpochInRam - MAX_TRANSACTION_SIZE)
+                begin = tickTransactionsSizeCurrentEpochInRam; // all space has been used (or ring has wrapped around in tiered mode)
+            else if (begin < nextOffsetInRam)
+                begin = nextOffsetInRam;
+            unsigned long long end = begin + deferredClearingChunkTransactionBytes;
+            if (end > tickTransactionsSizeCurrentEpochInRam)
+                end = tickTransactionsSizeCurrentEpochInRam;
+            if (begin < end)
+                setMem(tickTransactionsPtr + begin, end - begin, 0);
+            clearedTransactionsEnd = (begin < end) ? end : tickTransactionsSizeCurrentEpochInRam;
+            TickTransactionsAccess::releaseLock();
+            cleared = true;
+        }
+
+        RELEASE(clearingLock);
+        return cleared;
+    }
+
+    // Make sure that the storage of the ticks up to deferredClearingSyncTicks / 2 ahead of currentTick has been cleared,
+    // clearing it now if needed. Called by the tick processor in case idle processors haven't cleared fast enough.
+    static void ensureClearedAhead(unsigned int currentTick)
+    {
+        const unsigned int tick = currentTick + deferredClearingSyncTicks / 2;
+        while (clearedTickEnd <= tick && clearedTickEnd < tickEnd)
+        {
+            if (!clearAhead())
+                _mm_pause();
+        }
+    }
+
+#if TICK_STORAGE_TIERED_MODE
+    // Move ticks that are more than half of the RAM window older than currentTick from RAM to tickArchive. Called by the
+    // tick processor after each tick, so the other half of the RAM window is left for ticks that are received ahead.
+    static void archiveOldTicks(unsigned int currentTick)
+    {
+        const Transaction* transactions[NUMBER_OF_TRANSACTIONS_PER_TICK];
+        while (currentTick > ramTickBegin && currentTick - ramTickBegin > ticksInRamCurrentEpoch / 2 && ramTickBegin < tickEnd)
+        {
+            const unsigned int tick = ramTickBegin;
+            TickData& td = TickDataAccess::getByTickInCurrentEpoch(tick);
+            Tick* computorTicks = TicksAccess::getByTickInCurrentEpoch(tick);
+            unsigned long long* offsets = TickTransactionOffsetsAccess::getByTickInCurrentEpoch(tick);
+
+            TickDataAccess::acquireLock();
+            TickTransactionsAccess::acquireLock();
+            for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; ++i)
+            {
+                transactions[i] = (offsets[i]) ? TickTransactionsAccess::ptr(offsets[i]) : nullptr;
+            }
+            tickArchive.acquireLock();
+            tickArchive.appendTick(td, computorTicks, transactions);
+            tickArchive.releaseLock();
+
+            // free RAM slots for tick + ticksInRamCurrentEpoch
+            setMem(&td, sizeof(TickData), 0);
+            setMem(computorTicks, NUMBER_OF_COMPUTORS * sizeof(Tick), 0);
+            setMem(offsets, NUMBER_OF_TRANSACTIONS_PER_TICK * sizeof(unsigned long long), 0);
+            ramTickBegin = tick + 1;
+            TickTransactionsAccess::releaseLock();
+            TickDataAccess::releaseLock();
+        }
+    }
+#endif
+
     // Useful for debugging, but expensive: check that everything is as expected.
     static void checkStateConsistencyWithAssert()
     {
@@ -638,10 +903,15 @@ public:
         ASSERT(ticksPtr != nullptr);
         ASSERT(tickTransactionsPtr != nullptr);
         ASSERT(tickTransactionOffsetsPtr != nullptr);
-        ASSERT(oldTickDataPtr == tickDataPtr + MAX_NUMBER_OF_TICKS_PER_EPOCH);
-        ASSERT(oldTicksPtr == ticksPtr + ticksLengthCurrentEpoch);
-        ASSERT(oldTickTransactionsPtr == tickTransactionsPtr + tickTransactionsSizeCurrentEpoch);
-        ASSERT(oldTickTransactionOffsetsPtr == tickTransactionOffsetsPtr + tickTransactionOffsetsLengthCurrentEpoch);
+        ASSERT(oldTickDataPtr == tickDataPtr + ticksInRamCurrentEpoch);
+        ASSERT(oldTicksPtr == ticksPtr + ticksInRamCurrentEpoch * NUMBER_OF_COMPUTORS);
+        ASSERT(oldTickTransactionsPtr == tickTransactionsPtr + tickTransactionsSizeCurrentEpochInRam);
+        ASSERT(oldTickTransactionOffsetsPtr == tickTransactionOffsetsPtr + ticksInRamCurrentEpoch * NUMBER_OF_TRANSACTIONS_PER_TICK);
+#if TICK_STORAGE_TIERED_MODE
+        ASSERT(tickBegin <= ramTickBegin);
+        ASSERT(ramTickBegin <= tickEnd);
+        ASSERT(tickArchive.getEndTick() == ramTickBegin);
+#endif
 
         ASSERT(nextTickTransactionOffset >= FIRST_TICK_TRANSACTION_OFFSET);
         ASSERT(nextTickTransactionOffset <= tickTransactionsSizeCurrentEpoch);
@@ -700,7 +970,12 @@ public:
         test_current_epoch:
 #endif
         unsigned long long lastTransactionEndOffset = FIRST_TICK_TRANSACTION_OFFSET;
-        for (unsigned int tickId = tickBegin; tickId < tickEnd; ++tickId)
+#if TICK_STORAGE_TIERED_MODE
+        const unsigned int ramTickEnd = (clearedTickEnd - ramTickBegin < ticksInRamCurrentEpoch) ? clearedTickEnd : (unsigned int)(ramTickBegin + ticksInRamCurrentEpoch);
+        for (unsigned int tickId = ramTickBegin; tickId < ramTickEnd; ++tickId)
+#else
+        for (unsigned int tickId = tickBegin; tickId < clearedTickEnd; ++tickId)
+#endif
         {
             const TickData& tickData = TickDataAccess::getByTickInCurrentEpoch(tickId);
             ASSERT(tickData.epoch == 0 || tickData.epoch == INVALIDATED_TICK_DATA || (tickData.tick == tickId));
@@ -751,19 +1026,37 @@ public:
                 }
             }
         }
+#if TICK_STORAGE_TIERED_MODE
+        // the last transactions added may belong to archived ticks
+        ASSERT(lastTransactionEndOffset <= nextTickTransactionOffset);
+#else
         ASSERT(lastTransactionEndOffset == nextTickTransactionOffset);
+#endif
 #if !defined(NDEBUG) && !defined(NO_UEFI)
         leave_test:
         addDebugMessage(L"End ts.checkStateConsistencyWithAssert()");
 #endif
     }
 
-    // Check whether tick is stored in the current epoch storage.
+    // Check whether tick is stored in the current epoch storage. In tiered mode, only ticks in RAM are considered
+    // (archived ticks are checked by tickInArchive()).
     inline static bool tickInCurrentEpochStorage(unsigned int tick)
     {
-        return tick >= tickBegin && tick < tickEnd;
+#if TICK_STORAGE_TIERED_MODE
+        return tick >= ramTickBegin && tick < clearedTickEnd && tick - ramTickBegin < ticksInRamCurrentEpoch;
+#else
+        return tick >= tickBegin && tick < clearedTickEnd;
+#endif
     }
 
+#if TICK_STORAGE_TIERED_MODE
+    // Check whether tick of current epoch has been moved from RAM to the archive.
+    inline static bool tickInArchive(unsigned int tick)
+    {
+        return tick >= tickBegin && tick < ramTickBegin;
+    }
+#endif
+
     // Check whether tick is stored in the previous epoch storage.
     inline static bool tickInPreviousEpochStorage(unsigned int tick)
     {
@@ -782,6 +1075,51 @@ public:
         return tick - oldTickBegin + MAX_NUMBER_OF_TICKS_PER_EPOCH;
     }
 
+private:
+    // Clear storage of the next count tick slots of current epoch in RAM (starting at clearedTickSlots)
+    static void clearTickSlots(unsigned long long count)
+    {
+        ASSERT(clearedTickSlots + count <= ticksInRamCurrentEpoch);
+        setMem(tickDataPtr + clearedTickSlots, count * sizeof(TickData), 0);
+        setMem(ticksPtr + clearedTickSlots * NUMBER_OF_COMPUTORS, count * NUMBER_OF_COMPUTORS * sizeof(Tick), 0);
+        setMem(tickTransactionOffsetsPtr + clearedTickSlots * NUMBER_OF_TRANSACTIONS_PER_TICK, count * NUMBER_OF_TRANSACTIONS_PER_TICK * sizeof(unsigned long long), 0);
+        clearedTickSlots += count;
+    }
+
+    // Publish cleared tick slots, so the ticks can be accessed (slots are cleared before, see clearTickSlots())
+    static void updateClearedTickEnd()
+    {
+        // in the beginning of the epoch, tick slot i holds tick tickBegin + i (also in tiered mode)
+        _mm_sfence(); // setMem() may use non-temporal stores
+        clearedTickEnd = (clearedTickSlots >= ticksInRamCurrentEpoch) ? tickEnd : (unsigned int)(tickBegin + clearedTickSlots);
+    }
+
+    // Map tick index (see tickToIndexCurrentEpoch() and tickToIndexPreviousEpoch()) to index in RAM buffers
+    inline static unsigned int tickIndexInRam(unsigned int tickIndex)
+    {
+#if TICK_STORAGE_TIERED_MODE
+        if (tickIndex < MAX_NUMBER_OF_TICKS_PER_EPOCH)
+            return tickIndex % ticksInRamCurrentEpoch;
+        return (unsigned int)(tickIndex - MAX_NUMBER_OF_TICKS_PER_EPOCH + ticksInRamCurrentEpoch);
+#else
+        return tickIndex;
+#endif
+    }
+
+    // Map transaction offset to offset in RAM buffer
+    inline static unsigned long long transactionOffsetInRam(unsigned long long transactionOffset)
+    {
+#if TICK_STORAGE_TIERED_MODE
+        if (transactionOffset < tickTransactionsSizeCurrentEpoch)
+            return transactionOffset % tickTransactionsRingSize;
+        return transactionOffset - tickTransactionsSizeCurrentEpoch + tickTransactionsSizeCurrentEpochInRam;
+#else
+        return transactionOffset;
+#endif
+    }
+
+public:
+
     // Struct for structured, convenient access via ".tickData"
     struct TickDataAccess
     {
@@ -806,7 +1144,7 @@ public:
             else
                 return nullptr;
 
-            TickData* td = tickDataPtr + index;
+            TickData* td = tickDataPtr + tickIndexInRam(index);
             // td->epoch == 0: not yet received or temporarily disabled
             // td->epoch == INVALIDATED_TICK_DATA: invalidated by this node
             // in both cases, this data shouldn't be sent out
@@ -820,28 +1158,28 @@ public:
         inline static TickData& getByTickInCurrentEpoch(unsigned int tick)
         {
             ASSERT(tickInCurrentEpochStorage(tick));
-            return tickDataPtr[tickToIndexCurrentEpoch(tick)];
+            return tickDataPtr[tickIndexInRam(tickToIndexCurrentEpoch(tick))];
         }
 
         // Get tick data by tick in previous epoch (checking tick with ASSERT)
         inline static TickData& getByTickInPreviousEpoch(unsigned int tick)
         {
             ASSERT(tickInPreviousEpochStorage(tick));
-            return tickDataPtr[tickToIndexPreviousEpoch(tick)];
+            return tickDataPtr[tickIndexInRam(tickToIndexPreviousEpoch(tick))];
         }
 
         // Get tick data at index independent of epoch (checking index with ASSERT)
         inline TickData& operator[](unsigned int index)
         {
             ASSERT(index < tickDataLength);
-            return tickDataPtr[index];
+            return tickDataPtr[tickIndexInRam(index)];
         }
 
         // Get tick data at index independent of epoch (checking index with ASSERT)
         inline const TickData& operator[](unsigned int index) const
         {
             ASSERT(index < tickDataLength);
-            return tickDataPtr[index];
+            return tickDataPtr[tickIndexInRam(index)];
         }
     } tickData;
 
@@ -864,35 +1202,35 @@ public:
         inline static Tick* getByTickIndex(unsigned int tickIndex)
         {
             ASSERT(tickIndex < tickDataLength);
-            return ticksPtr + tickIndex * NUMBER_OF_COMPUTORS;
+            return ticksPtr + tickIndexInRam(tickIndex) * NUMBER_OF_COMPUTORS;
         }
 
         // Return pointer to array of one Tick per computor in current epoch by tick (checking tick with ASSERT)
         inline static Tick* getByTickInCurrentEpoch(unsigned int tick)
         {
             ASSERT(tickInCurrentEpochStorage(tick));
-            return ticksPtr + tickToIndexCurrentEpoch(tick) * NUMBER_OF_COMPUTORS;
+            return getByTickIndex(tickToIndexCurrentEpoch(tick));
         }
 
         // Return pointer to array of one Tick per computor in previous epoch by tick (checking tick with ASSERT)
         inline static Tick* getByTickInPreviousEpoch(unsigned int tick)
         {
             ASSERT(tickInPreviousEpochStorage(tick));
-            return ticksPtr + tickToIndexPreviousEpoch(tick) * NUMBER_OF_COMPUTORS;
+            return getByTickIndex(tickToIndexPreviousEpoch(tick));
         }
 
         // Get ticks element at offset (checking offset with ASSERT)
         inline Tick& operator[](unsigned int offset)
         {
             ASSERT(offset < ticksLength);
-            return ticksPtr[offset];
+            return ticksPtr[tickIndexInRam(offset / NUMBER_OF_COMPUTORS) * NUMBER_OF_COMPUTORS + offset % NUMBER_OF_COMPUTORS];
         }
 
         // Get ticks element at offset (checking offset with ASSERT)
         inline const Tick& operator[](unsigned int offset) const
         {
             ASSERT(offset < ticksLength);
-            return ticksPtr[offset];
+            return ticksPtr[tickIndexInRam(offset / NUMBER_OF_COMPUTORS) * NUMBER_OF_COMPUTORS + offset % NUMBER_OF_COMPUTORS];
         }
     } ticks;
 
@@ -903,7 +1241,7 @@ public:
         inline static unsigned long long* getByTickIndex(unsigned int tickIndex)
         {
             ASSERT(tickIndex < tickDataLength);
-            return tickTransactionOffsetsPtr + (tickIndex * NUMBER_OF_TRANSACTIONS_PER_TICK);
+            return tickTransactionOffsetsPtr + (tickIndexInRam(tickIndex) * NUMBER_OF_TRANSACTIONS_PER_TICK);
         }
 
         // Return pointer to offset array of transactions of tick in current epoch by tick (checking tick with ASSERT)
@@ -933,6 +1271,11 @@ public:
     // Offset of next free space in tick transaction storage
     inline static unsigned long long nextTickTransactionOffset = FIRST_TICK_TRANSACTION_OFFSET;
 
+#if TICK_STORAGE_TIERED_MODE
+    // Ticks of current epoch that have been moved out of RAM (see tickInArchive())
+    inline static TickArchive<archiveSegmentTicks, archiveCacheSegments> tickArchive;
+#endif
+
     // Struct for structured, convenient access via ".tickTransactions"
     struct TickTransactionsAccess
     {
@@ -953,7 +1296,7 @@ public:
         inline static Transaction* ptr(unsigned long long transactionOffset)
         {
             ASSERT(transactionOffset < tickTransactionsSize);
-            return (Transaction*)(tickTransactionsPtr + transactionOffset);
+            return (Transaction*)(tickTransactionsPtr + transactionOffsetInRam(transactionOffset));
         }
 
         // Return pointer to Transaction based on transaction offset independent of epoch (checking offset with ASSERT)
@@ -980,10 +1323,13 @@ public:
         {
             m256i digest; // isZero mean not occupied
             const Transaction* transaction;
+#if TICK_STORAGE_TIERED_MODE
+            unsigned int tick; // entries of archived ticks may be reused
+#endif
         };
         unsigned long long hashFunc(const m256i& digest)
         {
-            return digest.m256i_u32[7] % tickTransactionOffsetsLengthCurrentEpoch;
+            return digest.m256i_u32[7] % transactionsDigestLength;
         }
 
         void insertTransaction(const m256i& digest, const Transaction* transaction)
@@ -997,10 +1343,24 @@ public:
             HashMapEntry* pHashMap = (HashMapEntry*)tickTransactionsDigestPtr;
             unsigned long long index = hashFunc(digest);
             unsigned long long original_index = index;
+#if TICK_STORAGE_TIERED_MODE
+            unsigned long long probes = 0;
+#endif
             // TODO: check alraeady added tx ?
             while (!isZero(pHashMap[index].digest))
             {
-                index = (index + 1) % tickTransactionOffsetsLengthCurrentEpoch;
+#if TICK_STORAGE_TIERED_MODE
+                if (tickInArchive(pHashMap[index].tick))
+                {
+                    // reuse entry of transaction that is no longer in RAM
+                    break;
+                }
+                if (++probes == transactionsDigestMaxProbes)
+                {
+                    return;
+                }
+#endif
+                index = (index + 1) % transactionsDigestLength;
                 if (index == original_index)
                 {
                     // Don't have enough place in the table
@@ -1009,8 +1369,13 @@ public:
             }
             pHashMap[index].transaction = transaction;
             pHashMap[index].digest = digest;
+#if TICK_STORAGE_TIERED_MODE
+            pHashMap[index].tick = transaction->tick;
+#endif
         }
 
+        // In tiered mode, the transaction may be returned from tickArchive, so the lock of ts.tickArchive must be held
+        // while using the result.
         const Transaction* findTransaction(const m256i& digest)
         {
             // Zero digest. No further process
@@ -1022,13 +1387,28 @@ public:
             HashMapEntry* pHashMap = (HashMapEntry*)tickTransactionsDigestPtr;
             unsigned long long index = hashFunc(digest);
             unsigned long long original_index = index;
+#if TICK_STORAGE_TIERED_MODE
+            unsigned long long probes = 0;
+#endif
             while (!isZero(pHashMap[index].digest))
             {
                 if (pHashMap[index].digest == digest)
                 {
+#if TICK_STORAGE_TIERED_MODE
+                    if (tickInArchive(pHashMap[index].tick))
+                    {
+                        return tickArchive.findTransaction(pHashMap[index].tick, digest);
+                    }
+#endif
                     return pHashMap[index].transaction;
                 }
-                index = (index + 1) % tickTransactionOffsetsLengthCurrentEpoch;
+#if TICK_STORAGE_TIERED_MODE
+                if (++probes == transactionsDigestMaxProbes)
+                {
+                    break;
+                }
+#endif
+                index = (index + 1) % transactionsDigestLength;
                 if (index == original_index)
                 {
                     break;
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "platform/m256.h"
+#include "platform/memory_util.h"
+#include "platform/concurrency.h"
+#include "platform/debugging.h"
+
+// Cache of digests of transactions whose signature has been verified successfully. The digest is computed from the
+// full transaction including the signature, so a hit means that exactly the same bytes have been verified before and
+// verify() can be skipped. Direct-mapped: a new entry overwrites the entry with the same slot.
+// This is a kind of singleton class with only static members (so all instances refer to the same data).
+class VerifiedTxsCache
+{
+protected:
+    // Number of cached digests (has to be 2^N)
+    static constexpr unsigned int capacity = 1 << 16;
+    static_assert((capacity & (capacity - 1)) == 0, "VerifiedTxsCache capacity has to be 2^N");
+
+    // Allocated buffer with capacity digests (zero digest means empty slot)
+    inline static m256i* digests = nullptr;
+
+    // Lock for securing the digests
+    inline static volatile char lock = 0;
+
+    // Return slot of digest, using 32 bits of the digest that are not used for the digest sets of PendingTxsPool
+    inline static unsigned int slot(const m256i& digest)
+    {
+        return digest.m256i_u32[1] & (capacity - 1);
+    }
+
+public:
+    // Init at node startup.
+    static bool init()
+    {
+        if (!allocPoolWithErrorLog(L"VerifiedTxsCache::digests ", capacity * sizeof(m256i), (void**)&digests, __LINE__))
+        {
+            return false;
+        }
+        ASSERT(lock == 0);
+        setMem(digests, capacity * sizeof(m256i), 0);
+        return true;
+    }
+
+    // Cleanup at node shutdown.
+    static void deinit()
+    {
+        if (digests)
+        {
+            freePool(digests);
+            digests = nullptr;
+        }
+    }
+
+    // Record that the signature of the transaction with the given digest (of the full transaction including
+    // signature) is valid.
+    static void add(const m256i& digest)
+    {
+        ASSERT(!isZero(digest));
+        ACQUIRE(lock);
+        digests[slot(digest)] = digest;
+        RELEASE(lock);
+    }
+
+    // Check if the signature of the transaction with the given digest has been verified before.
+    static bool contains(const m256i& digest)
+    {
+        ACQUIRE(lock);
+        const bool found = !isZero(digest) && digests[slot(digest)] == digest;
+        RELEASE(lock);
+        return found;
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <lib/platform_common/qintrin.h>
+
+#include "platform/concurrency.h"
+
+// Bounded queue notifying the tick processor about tick votes that have been stored in ts.ticks.
+//
+// Producers (request processors running processBroadcastTick()) push (tick, computorIndex) lock-free, so storing a
+// vote is never blocked by the consumer. There is only one consumer (tick processor). The implementation follows the
+// common bounded queue with per-cell sequence numbers: a producer claims a cell by increasing enqueuePos with a
+// compare-exchange and publishes the content by setting the sequence number of the cell afterwards.
+//
+// If the queue is full, the event is dropped and the overflow flag is set. The consumer is expected to rebuild its
+// state from ts.ticks in this case (see checkAndClearOverflow()).
+template <unsigned int capacity>
+class VoteArrivalQueue
+{
+    static_assert(capacity >= 2 && (capacity & (capacity - 1)) == 0, "Capacity must be a power of 2");
+
+    struct Cell
+    {
+        volatile long sequence;
+        unsigned int tick;
+        unsigned int computorIndex;
+    };
+
+    Cell cells[capacity];
+    volatile long enqueuePos;
+    long dequeuePos;
+    volatile char overflow;
+
+public:
+    // Init empty queue (call before producers are started)
+    void reset()
+    {
+        for (unsigned int i = 0; i < capacity; i++)
+        {
+            cells[i].sequence = i;
+            cells[i].tick = 0;
+            cells[i].computorIndex = 0;
+        }
+        enqueuePos = 0;
+        dequeuePos = 0;
+        overflow = 0;
+    }
+
+    // Add vote arrival event. May be called by multiple processors concurrently. Returns false if the queue is full.
+    bool push(unsigned int tick, unsigned int computorIndex)
+    {
+        long pos = enqueuePos;
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells[pos & (capacity - 1)];
+            const long diff = (long)((unsigned long)cell->sequence - (unsigned long)pos);
+            if (diff == 0)
+            {
+                // cell is free -> try to claim it
+                const long prevPos = _InterlockedCompareExchange(&enqueuePos, (long)((unsigned long)pos + 1), pos);
+                if (prevPos == pos)
+                {
+                    break;
+                }
+                pos = prevPos;
+            }
+            else if (diff < 0)
+            {
+                // cell hasn't been consumed yet -> queue is full
+                ATOMIC_STORE8(overflow, 1);
+                return false;
+            }
+            else
+            {
+                // other producer claimed cell
+                pos = enqueuePos;
+            }
+        }
+
+        cell->tick = tick;
+        cell->computorIndex = computorIndex;
+
+        // publish content (interlocked operation is a full barrier)
+        _InterlockedExchange(&cell->sequence, (long)((unsigned long)pos + 1));
+        return true;
+    }
+
+    // Get next vote arrival event if available. Must only be called by the consumer.
+    bool pop(unsigned int& tick, unsigned int& computorIndex)
+    {
+        Cell& cell = cells[dequeuePos & (capacity - 1)];
+        const long diff = (long)((unsigned long)cell.sequence - ((unsigned long)dequeuePos + 1));
+        if (diff < 0)
+        {
+            // empty (or producer hasn't finished writing the cell yet)
+            return false;
+        }
+
+        tick = cell.tick;
+        computorIndex = cell.computorIndex;
+
+        // release cell for producers
+        _InterlockedExchange(&cell.sequence, (long)((unsigned long)dequeuePos + capacity));
+        dequeuePos = (long)((unsigned long)dequeuePos + 1);
+        return true;
+    }
+
+    // Return whether events have been dropped since last call. Must only be called by the consumer. The flag is
+    // cleared before the consumer rescans the state, so events dropped afterwards are reported by the next call.
+    bool checkAndClearOverflow()
+    {
+        return _InterlockedExchange8(&overflow, 0) != 0;
+    }
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include "platform/memory.h"
 #include "network_messages/transactions.h"
+#include "ten_bit_packing.h"
 #define VOTE_COUNTER_INPUT_TYPE 1
 #define VOTE_COUNTER_DATA_SIZE_IN_BYTES 848
 #define VOTE_COUNTER_NUM_BIT_PER_COMP 10
@@ -10,36 +11,21 @@ static_assert(VOTE_COUNTER_DATA_SIZE_IN_BYTES * 8 >= NUMBER_OF_COMPUTORS * VOTE_
 class VoteCounter
 {
 private:
-	unsigned int votes[NUMBER_OF_COMPUTORS*2][NUMBER_OF_COMPUTORS];
+	// Rolling window of the votes of the last NUMBER_OF_COMPUTORS*2 ticks: bit j of voteFlags[slot] is set if computor j
+	// voted for tick slotTicks[slot] (slot = tick % (NUMBER_OF_COMPUTORS*2)). Votes are registered for the current tick,
+	// so ticks are increasing and a slot is cleared when it is reused for a new tick.
+	unsigned int slotTicks[NUMBER_OF_COMPUTORS*2];
+	unsigned long long voteFlags[NUMBER_OF_COMPUTORS*2][(NUMBER_OF_COMPUTORS + 63) / 64];
 	unsigned long long accumulatedVoteCount[NUMBER_OF_COMPUTORS];
 	unsigned int buffer[NUMBER_OF_COMPUTORS];
 protected:
 	unsigned int extract10Bit(const unsigned char* data, unsigned int idx)
 	{
-		//TODO: simplify this
-		unsigned int byte0 = data[idx + (idx >> 2)];
-		unsigned int byte1 = data[idx + (idx >> 2) + 1];
-		unsigned int last_bit0 = 8 - (idx & 3) * 2;
-		unsigned int first_bit1 = 10 - last_bit0;
-		unsigned int res = (byte0 & ((1 << last_bit0) - 1)) << first_bit1;
-		res |= (byte1 >> (8 - first_bit1));
-		return res;
+		return read10Bit(data, idx);
 	}
 	void update10Bit(unsigned char* data, unsigned int idx, unsigned int value)
 	{
-		//TODO: simplify this
-		unsigned char& byte0 = data[idx + (idx >> 2)];
-		unsigned char& byte1 = data[idx + (idx >> 2) + 1];
-		unsigned int last_bit0 = 8 - (idx & 3) * 2;
-		unsigned int first_bit1 = 10 - last_bit0;
-		unsigned char mask0 = ~((1 << last_bit0) - 1);
-		unsigned char mask1 = ((1 << (8-first_bit1)) - 1);
-		byte0 &= mask0;
-		byte1 &= mask1;
-		unsigned char ubyte0 = (value >> first_bit1);
-		unsigned char ubyte1 = (value & ((1 << first_bit1) - 1)) << (8-first_bit1);
-		byte0 |= ubyte0;
-		byte1 |= ubyte1;
+		write10Bit(data, idx, value);
 	}
 
 	void accumulateVoteCount(unsigned int computorIdx, unsigned int value)
@@ -48,17 +34,24 @@ protected:
 	}
 
 public:
-	static constexpr unsigned int VoteCounterDataSize = sizeof(votes) + sizeof(accumulatedVoteCount);
+	static constexpr unsigned int VoteCounterDataSize = sizeof(slotTicks) + sizeof(voteFlags) + sizeof(accumulatedVoteCount);
 	void init()
 	{
-		setMem(votes, sizeof(votes), 0);
+		setMem(slotTicks, sizeof(slotTicks), 0);
+		setMem(voteFlags, sizeof(voteFlags), 0);
 		setMem(accumulatedVoteCount, sizeof(accumulatedVoteCount), 0);
 	}
 	
 	void registerNewVote(unsigned int tick, unsigned int computorIdx)
 	{
 		unsigned int slotId = tick % (NUMBER_OF_COMPUTORS * 2);
-		votes[slotId][computorIdx] = tick;
+		if (slotTicks[slotId] != tick)
+		{
+			// slot is reused for new tick -> discard votes of old tick
+			slotTicks[slotId] = tick;
+			setMem(voteFlags[slotId], sizeof(voteFlags[slotId]), 0);
+		}
+		voteFlags[slotId][computorIdx >> 6] |= 1ULL << (computorIdx & 63);
 	}
 
 	// get and compress number of votes of 676 computors to 676x10 bit numbers between [fromTick, toTick)
@@ -69,27 +62,30 @@ public:
 		for (unsigned int i = fromTick; i < toTick; i++)
 		{
 			unsigned int slotId = i % (NUMBER_OF_COMPUTORS * 2);
-			for (int j = 0; j < NUMBER_OF_COMPUTORS; j++)
+			if (slotTicks[slotId] != i)
+			{
+				continue;
+			}
+			for (unsigned int k = 0; k < (NUMBER_OF_COMPUTORS + 63) / 64; k++)
 			{
-				if (votes[slotId][j] == i)
+				unsigned long long flags = voteFlags[slotId][k];
+				while (flags)
 				{
-					buffer[j]++;
+					buffer[k * 64 + _tzcnt_u64(flags)]++;
+					flags &= flags - 1;
 				}
 			}
 		}
 		buffer[computorIdx] = 0; // remove self-report
-		for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
-		{
-			update10Bit(votePacket, i, buffer[i]);
-		}
+		pack10BitArray(buffer, votePacket, NUMBER_OF_COMPUTORS);
 	}
 
 	bool validateNewVotesPacket(const unsigned char* votePacket, unsigned int computorIdx)
 	{
 		unsigned long long sum = 0;
+		unpack10BitArray(votePacket, buffer, NUMBER_OF_COMPUTORS);
 		for (int i = 0; i < NUMBER_OF_COMPUTORS; i++)
 		{
-			buffer[i] = extract10Bit(votePacket, i);
 			if (buffer[i] > NUMBER_OF_COMPUTORS)
 			{
 				return false;
@@ -111,12 +107,12 @@ public:
 
 	void addVotes(const unsigned char* newVotePacket, unsigned int computorIdx)
 	{
+		// validateNewVotesPacket() unpacks the vote counts to buffer
 		if (validateNewVotesPacket(newVotePacket, computorIdx))
 		{
 			for (int i = 0; i < NUMBER_OF_COMPUTORS; i++)
 			{
-				unsigned int vote_count = extract10Bit(newVotePacket, i);
-				accumulateVoteCount(i, vote_count);
+				accumulateVoteCount(i, buffer[i]);
 			}
 		}
 	}
@@ -156,13 +152,15 @@ public:
 
 	void saveAllDataToArray(unsigned char* dst)
 	{
-		copyMem(dst, &votes[0][0], sizeof(votes));
-		copyMem(dst + sizeof(votes), &accumulatedVoteCount[0], sizeof(accumulatedVoteCount));
+		copyMem(dst, &slotTicks[0], sizeof(slotTicks));
+		copyMem(dst + sizeof(slotTicks), &voteFlags[0][0], sizeof(voteFlags));
+		copyMem(dst + sizeof(slotTicks) + sizeof(voteFlags), &accumulatedVoteCount[0], sizeof(accumulatedVoteCount));
 	}
 
 	void loadAllDataFromArray(const unsigned char* src)
 	{
-		copyMem(&votes[0][0], src, sizeof(votes));
-		copyMem(&accumulatedVoteCount[0], src + sizeof(votes), sizeof(accumulatedVoteCount));
+		copyMem(&slotTicks[0], src, sizeof(slotTicks));
+		copyMem(&voteFlags[0][0], src + sizeof(slotTicks), sizeof(voteFlags));
+		copyMem(&accumulatedVoteCount[0], src + sizeof(slotTicks) + sizeof(voteFlags), sizeof(accumulatedVoteCount));
 	}
 };
\ No newline at end of file
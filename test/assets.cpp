@@ -21,12 +21,12 @@ public:
     AssetsTest()
     {
         initAssets();
-        commonBuffers.init(1, universeSizeInBytes);
+        reorgBuffers.init(1, universeReorgSizeInBytes);
     }
 
     ~AssetsTest()
     {
-        commonBuffers.deinit();
+        reorgBuffers.deinit();
         deinitAssets();
     }
 
@@ -119,6 +119,52 @@ public:
             EXPECT_EQ(it1->second, it2->second);
         }
 
+        // check that each ownership / possession record is in list of its owner / possessor, both with the entity
+        // index and with the universe scan used if the entity index is full
+        const bool isEntityIndexComplete = indexLists.isEntityIndexComplete;
+        for (int useScan = 0; useScan < 2; ++useScan)
+        {
+            indexLists.isEntityIndexComplete = isEntityIndexComplete && !useScan;
+            for (unsigned int index = 0; index < ASSETS_CAPACITY; index++)
+            {
+                const unsigned char type = assets[index].varStruct.issuance.type;
+                if (type != OWNERSHIP && type != POSSESSION)
+                    continue;
+                const m256i& publicKey = assets[index].varStruct.issuance.publicKey;
+                bool found = false;
+                unsigned int entityIdx = indexLists.entityFirstRecordIdx(publicKey, type);
+                while (entityIdx != NO_ASSET_INDEX)
+                {
+                    EXPECT_LT(entityIdx, ASSETS_CAPACITY);
+                    EXPECT_EQ(assets[entityIdx].varStruct.issuance.type, type);
+                    EXPECT_TRUE(assets[entityIdx].varStruct.issuance.publicKey == publicKey);
+                    found = found || (entityIdx == index);
+                    entityIdx = indexLists.entityNextRecordIdx(publicKey, type, entityIdx);
+                }
+                EXPECT_TRUE(found);
+            }
+        }
+        indexLists.isEntityIndexComplete = isEntityIndexComplete;
+
+        // check that each issuance record is in list of its asset name
+        for (unsigned int index = 0; index < ASSETS_CAPACITY; index++)
+        {
+            if (assets[index].varStruct.issuance.type != ISSUANCE)
+                continue;
+            const unsigned long long assetName = (*((unsigned long long*)assets[index].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF;
+            bool found = false;
+            unsigned int nameIdx = indexLists.assetNameFirstIssuanceIdx(assetName);
+            while (nameIdx != NO_ASSET_INDEX)
+            {
+                EXPECT_LT(nameIdx, ASSETS_CAPACITY);
+                EXPECT_EQ(assets[nameIdx].varStruct.issuance.type, ISSUANCE);
+                EXPECT_EQ((*((unsigned long long*)assets[nameIdx].varStruct.issuance.name)) & 0xFFFFFFFFFFFFFF, assetName);
+                found = found || (nameIdx == index);
+                nameIdx = indexLists.entityNextIdx[nameIdx];
+            }
+            EXPECT_TRUE(found);
+        }
+
         // check that number of owned and possessed shares are equal for each issuance
         issuanceIdx = indexLists.issuancesFirstIdx;
         while (issuanceIdx != NO_ASSET_INDEX)
@@ -652,6 +698,14 @@ TEST(TestCoreAssets, AssetIterators)
     // check consistency after rebuild/cleanup of hash map
     assetsEndEpoch();
     test.checkAssetsConsistency();
+
+    // digests are rebuilt by assetsEndEpoch() and match full rehashing
+    EXPECT_FALSE(assetDigestTree.anyLeafChanged(0, ASSETS_CAPACITY));
+    const m256i rootAfterEndEpoch = assetDigestTree.root();
+    assetDigestTree.markAllLeafsChanged();
+    m256i universeDigest;
+    getUniverseDigest(universeDigest);
+    EXPECT_TRUE(universeDigest == rootAfterEndEpoch);
 }
 
 TEST(TestCoreAssets, AssetTransferShareManagementRights)
@@ -750,8 +804,8 @@ TEST(TestCoreAssets, AssetTransferShareManagementRights)
         }
     }
 }
-
-
-
-
-
+
+
+
+
+
@@ -0,0 +1,79 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/platform/compression.h"
+
+#include <random>
+#include <vector>
+
+static std::vector<unsigned char> compressAndDecompress(const std::vector<unsigned char>& data, unsigned long long* compressedSize)
+{
+    std::vector<unsigned int> hashTable(COMPRESSION_HASH_TABLE_SIZE);
+    std::vector<unsigned char> compressed(data.size() + data.size() / 255 + 16);
+    *compressedSize = compressBlock(data.data(), data.size(), compressed.data(), compressed.size(), hashTable.data());
+    EXPECT_GT(*compressedSize, 0ull);
+
+    std::vector<unsigned char> decompressed(data.size());
+    EXPECT_EQ(decompressBlock(compressed.data(), *compressedSize, decompressed.data(), decompressed.size()), (long long)data.size());
+    return decompressed;
+}
+
+TEST(TestCompression, RoundTrip)
+{
+    std::mt19937_64 gen(42);
+    unsigned long long compressedSize = 0;
+
+    // tiny inputs (only literals)
+    for (size_t size : { 0, 1, 5, 12, 13, 20 })
+    {
+        std::vector<unsigned char> data(size);
+        for (auto& byte : data)
+            byte = (unsigned char)gen();
+        EXPECT_EQ(compressAndDecompress(data, &compressedSize), data);
+    }
+
+    // zeros compress very well (long overlapping matches)
+    std::vector<unsigned char> zeros(1000000, 0);
+    EXPECT_EQ(compressAndDecompress(zeros, &compressedSize), zeros);
+    EXPECT_LT(compressedSize, zeros.size() / 100);
+
+    // repeated records with changing fields (similar to logs), including matches further away than the window
+    std::vector<unsigned char> records(3000000);
+    for (size_t i = 0; i < records.size(); i++)
+        records[i] = (i % 64 < 8) ? (unsigned char)gen() : (unsigned char)(i % 64);
+    EXPECT_EQ(compressAndDecompress(records, &compressedSize), records);
+    EXPECT_LT(compressedSize, records.size() / 2);
+
+    // random data is incompressible, but still round trips
+    std::vector<unsigned char> random(100000);
+    for (auto& byte : random)
+        byte = (unsigned char)gen();
+    EXPECT_EQ(compressAndDecompress(random, &compressedSize), random);
+    EXPECT_GT(compressedSize, random.size());
+}
+
+TEST(TestCompression, LimitsAndInvalidData)
+{
+    std::vector<unsigned int> hashTable(COMPRESSION_HASH_TABLE_SIZE);
+    std::vector<unsigned char> data(10000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i % 100);
+    std::vector<unsigned char> compressed(data.size() * 2);
+    const unsigned long long compressedSize = compressBlock(data.data(), data.size(), compressed.data(), compressed.size(), hashTable.data());
+    ASSERT_GT(compressedSize, 0ull);
+
+    // output buffer too small
+    EXPECT_EQ(compressBlock(data.data(), data.size(), compressed.data(), compressedSize - 1, hashTable.data()), 0ull);
+    std::vector<unsigned char> decompressed(data.size());
+    EXPECT_EQ(decompressBlock(compressed.data(), compressedSize, decompressed.data(), data.size() - 1), -1);
+
+    // truncated data
+    EXPECT_EQ(decompressBlock(compressed.data(), compressedSize - 1, decompressed.data(), decompressed.size()), -1);
+
+    // match offset before beginning of output
+    const unsigned char invalidOffset[] = { 0x14, 'a', 0x05, 0x00, 0x00 };
+    EXPECT_EQ(decompressBlock(invalidOffset, sizeof(invalidOffset), decompressed.data(), decompressed.size()), -1);
+    const unsigned char zeroOffset[] = { 0x14, 'a', 0x00, 0x00, 0x00 };
+    EXPECT_EQ(decompressBlock(zeroOffset, sizeof(zeroOffset), decompressed.data(), decompressed.size()), -1);
+}
@@ -0,0 +1,105 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/platform/console_output_queue.h"
+
+#include <string>
+
+TEST(TestCoreConsoleOutputQueue, PushAndFlush)
+{
+    static ConsoleOutputQueue<8, 16> queue;
+    queue.init(1000, 1000);
+    EXPECT_TRUE(queue.isEmpty());
+
+    EXPECT_TRUE(queue.push(L"first line\r\n"));
+    EXPECT_TRUE(queue.push(L""));
+    EXPECT_FALSE(queue.isEmpty());
+    queue.flush();
+    EXPECT_TRUE(queue.isEmpty());
+
+    // slots are reused after flush
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 8; ++i)
+            EXPECT_TRUE(queue.push(L"line\r\n"));
+        EXPECT_FALSE(queue.push(L"queue full\r\n"));
+        queue.flush();
+        EXPECT_TRUE(queue.isEmpty());
+    }
+}
+
+TEST(TestCoreConsoleOutputQueue, LongLines)
+{
+    static ConsoleOutputQueue<8, 4> queue;
+    queue.init(1000, 1000);
+
+    // 10 characters need 4 slots of 3 characters
+    EXPECT_TRUE(queue.push(L"0123456789"));
+    EXPECT_TRUE(queue.push(L"abcdefghijkl"));
+    EXPECT_FALSE(queue.push(L"x"));
+    queue.flush();
+
+    // line longer than the whole queue is rejected
+    EXPECT_FALSE(queue.push(L"0123456789012345678901234567"));
+    EXPECT_TRUE(queue.isEmpty());
+
+    // reservation wraps around the end of the slot array
+    EXPECT_TRUE(queue.push(L"abcdefghi"));
+    queue.flush();
+    EXPECT_TRUE(queue.push(L"012345678901234567"));
+    EXPECT_TRUE(queue.push(L"abcdef"));
+    EXPECT_FALSE(queue.push(L"x"));
+    queue.flush();
+    EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(TestCoreConsoleOutputQueue, RateLimit)
+{
+    static ConsoleOutputQueue<16, 64> queue;
+    const unsigned long long tscFrequency = 1000;
+    queue.init(/*maxCharsPerSecond=*/100, /*maxCharsPerRender=*/100);
+
+    for (int i = 0; i < 6; ++i)
+        EXPECT_TRUE(queue.push(L"0123456789012345678901234567890123456789"));
+
+    // first call only starts the time measurement
+    EXPECT_EQ(queue.render(1000, tscFrequency), 0);
+
+    // half a second allows 50 characters: second line overdraws the budget
+    EXPECT_EQ(queue.render(1500, tscFrequency), 2);
+    EXPECT_EQ(queue.render(1500, tscFrequency), 0);
+
+    // debt of 30 characters has to be paid back first
+    EXPECT_EQ(queue.render(1800, tscFrequency), 0);
+    EXPECT_EQ(queue.render(1810, tscFrequency), 1);
+
+    // burst is limited to one second worth of characters
+    EXPECT_EQ(queue.render(100000, tscFrequency), 2);
+    EXPECT_EQ(queue.render(101000, tscFrequency), 1);
+    EXPECT_TRUE(queue.isEmpty());
+
+    // flush ignores the rate limit
+    for (int i = 0; i < 6; ++i)
+        EXPECT_TRUE(queue.push(L"0123456789012345678901234567890123456789"));
+    queue.flush();
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(queue.render(101000, tscFrequency), 0);
+}
+
+TEST(TestCoreConsoleOutputQueue, MaxCharsPerRender)
+{
+    static ConsoleOutputQueue<16, 16> queue;
+    const unsigned long long tscFrequency = 1000;
+    queue.init(/*maxCharsPerSecond=*/1000, /*maxCharsPerRender=*/25);
+
+    for (int i = 0; i < 8; ++i)
+        EXPECT_TRUE(queue.push(L"0123456789"));
+    EXPECT_EQ(queue.render(1000, tscFrequency), 0);
+
+    // budget of one second would allow all lines, but each call stops after the slot reaching 25 characters
+    EXPECT_EQ(queue.render(2000, tscFrequency), 3);
+    EXPECT_EQ(queue.render(2000, tscFrequency), 3);
+    EXPECT_EQ(queue.render(2000, tscFrequency), 2);
+    EXPECT_TRUE(queue.isEmpty());
+}
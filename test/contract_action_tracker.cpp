@@ -0,0 +1,43 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+#include "../src/contract_core/contract_action_tracker.h"
+
+TEST(TestContractActionTracker, QuTransferBalance)
+{
+    ContractActionTracker<8> tracker;
+    EXPECT_TRUE(tracker.allocBuffer());
+
+    const m256i a(1, 2, 3, 4), b(5, 6, 7, 8), c(9, 10, 11, 12);
+    for (int watch = 0; watch < 2; ++watch)
+    {
+        // balance of watched entity is tracked while adding, others are computed by iterating the actions
+        if (watch)
+            tracker.init(a);
+        else
+            tracker.init();
+        EXPECT_EQ(tracker.getOverallQuTransferBalance(a), 0);
+        EXPECT_TRUE(tracker.addQuTransfer(a, b, 100));
+        EXPECT_TRUE(tracker.addQuTransfer(b, a, 30));
+        EXPECT_TRUE(tracker.addQuTransfer(b, c, 50));
+        EXPECT_TRUE(tracker.addQuTransfer(a, a, 7));
+        EXPECT_EQ(tracker.getOverallQuTransferBalance(a), -70);
+        EXPECT_EQ(tracker.getOverallQuTransferBalance(b), 20);
+        EXPECT_EQ(tracker.getOverallQuTransferBalance(c), 50);
+        EXPECT_TRUE(tracker.hasCapacity(4));
+        EXPECT_FALSE(tracker.hasCapacity(5));
+
+        // number of actions is limited
+        for (int i = 0; i < 4; ++i)
+            EXPECT_TRUE(tracker.addQuTransfer(c, a, 1));
+        EXPECT_FALSE(tracker.addQuTransfer(c, a, 1));
+        EXPECT_EQ(tracker.getOverallQuTransferBalance(a), -66);
+        EXPECT_EQ(tracker.getOverallQuTransferBalance(c), 46);
+    }
+
+    // init() resets the balance
+    tracker.init(a);
+    EXPECT_EQ(tracker.getOverallQuTransferBalance(a), 0);
+
+    tracker.freeBuffer();
+}
@@ -91,10 +91,24 @@ TEST(TestCoreContractCore, StackBuffer)
     EXPECT_EQ(ptr, p);
     EXPECT_EQ(special, true);
 
+    EXPECT_EQ(s1.size(), 0);
+    EXPECT_EQ(s1.peakSize(), 120);
+    s1.resetPeakSize();
+    EXPECT_EQ(s1.peakSize(), 0);
+    EXPECT_NE(p = s1.allocate(10, false), nullptr);
+    EXPECT_NE(p = s1.allocate(20, false), nullptr);
+    EXPECT_TRUE(s1.free());
+    EXPECT_EQ(s1.peakSize(), 32);
+    s1.resetPeakSize();
+    EXPECT_EQ(s1.peakSize(), 11);
+    EXPECT_TRUE(s1.free());
+    EXPECT_EQ(s1.peakSize(), 11);
+
     StackBuffer<unsigned int, 128000> s2;
     s2.init();
     EXPECT_EQ(s2.capacity(), 128000);
     EXPECT_EQ(s2.size(), 0);
+    EXPECT_EQ(s2.peakSize(), 0);
     EXPECT_EQ(s2.maxSizeObserved(), 0);
     EXPECT_EQ(s2.failedAllocAttempts(), 0);
     EXPECT_FALSE(s2.free());
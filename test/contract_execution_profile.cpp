@@ -0,0 +1,137 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+#include "../src/contract_core/contract_execution_profile.h"
+
+TEST(TestContractExecutionProfile, TickStatisticsAndRingBuffer)
+{
+    typedef ContractExecutionProfile<8, 16, 3> Profile;
+    Profile* profile = new Profile();
+    EXPECT_TRUE(profile->init());
+
+    ContractExecutionProfileEntry entries[32];
+    unsigned long long firstRecord = 0, nextRecord = 0;
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 32), 0);
+    EXPECT_EQ(nextRecord, 0);
+
+    // calls of same entry point are aggregated per tick
+    const unsigned int idA = (1 << 22) | 100;
+    const unsigned int idB = (2 << 22) | 100;
+    profile->addCall(0, idA, 100, 64);
+    profile->addCall(0, idA, 300, 32);
+    profile->addCall(0, idB, 50, 0);
+    profile->finishTick(10);
+    profile->finishTick(11); // no calls, no records
+    profile->addCall(0, idA, 7, 16);
+    profile->finishTick(12);
+
+    firstRecord = 0;
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 32), 3);
+    EXPECT_EQ(firstRecord, 0);
+    EXPECT_EQ(nextRecord, 3);
+    const ContractExecutionProfileEntry& a10 = (entries[0].entryPointId == idA) ? entries[0] : entries[1];
+    const ContractExecutionProfileEntry& b10 = (entries[0].entryPointId == idA) ? entries[1] : entries[0];
+    EXPECT_EQ(a10.tick, 10);
+    EXPECT_EQ(a10.entryPointId, idA);
+    EXPECT_EQ(a10.count, 2);
+    EXPECT_EQ(a10.totalCycles, 400);
+    EXPECT_EQ(a10.maxCycles, 300);
+    EXPECT_EQ(a10.maxLocalsStackUsage, 64);
+    EXPECT_EQ(b10.tick, 10);
+    EXPECT_EQ(b10.entryPointId, idB);
+    EXPECT_EQ(b10.count, 1);
+    EXPECT_EQ(b10.totalCycles, 50);
+    EXPECT_EQ(entries[2].tick, 12);
+    EXPECT_EQ(entries[2].entryPointId, idA);
+    EXPECT_EQ(entries[2].count, 1);
+    EXPECT_EQ(entries[2].maxLocalsStackUsage, 16);
+
+    // continue with next record, limited count
+    firstRecord = 2;
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 32), 1);
+    EXPECT_EQ(nextRecord, 3);
+    firstRecord = 0;
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 2), 2);
+    EXPECT_EQ(nextRecord, 2);
+
+    // table of tick is limited to 3/4 of capacity
+    for (unsigned int i = 1; i <= 8; ++i)
+        profile->addCall(1, i, i, 0);
+    EXPECT_EQ(profile->getDroppedCalls(), 2);
+    profile->finishTick(13);
+    EXPECT_EQ(profile->getDroppedCalls(), 2);
+
+    // oldest records are overwritten
+    for (unsigned int tick = 14; tick < 22; ++tick)
+    {
+        profile->addCall(Profile::sharedShard, idA, tick, 0);
+        profile->finishTick(tick);
+    }
+    firstRecord = 0;
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 32), 16);
+    EXPECT_EQ(firstRecord, 3 + 6 + 8 - 16);
+    EXPECT_EQ(nextRecord, 17);
+    EXPECT_EQ(entries[15].tick, 21);
+    EXPECT_EQ(entries[15].totalCycles, 21);
+
+    // requesting future records returns nothing
+    firstRecord = 100;
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 32), 0);
+    EXPECT_EQ(nextRecord, 17);
+
+    profile->deinit();
+    delete profile;
+}
+
+TEST(TestContractExecutionProfile, ShardsAreMergedAtEndOfTick)
+{
+    typedef ContractExecutionProfile<8, 16, 3> Profile;
+    Profile* profile = new Profile();
+    EXPECT_TRUE(profile->init());
+
+    // calls of the same entry point in different shards (and invalid shard, which is mapped to the shared shard)
+    const unsigned int idA = (1 << 22) | 100;
+    const unsigned int idB = (2 << 22) | 100;
+    profile->addCall(0, idA, 100, 64);
+    profile->addCall(1, idA, 300, 32);
+    profile->addCall(Profile::sharedShard, idA, 20, 0);
+    profile->addCall(100, idA, 5, 128);
+    profile->addCall(1, idB, 50, 0);
+    profile->finishTick(10);
+
+    ContractExecutionProfileEntry entries[32];
+    unsigned long long firstRecord = 0, nextRecord = 0;
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 32), 2);
+    const ContractExecutionProfileEntry& a = (entries[0].entryPointId == idA) ? entries[0] : entries[1];
+    const ContractExecutionProfileEntry& b = (entries[0].entryPointId == idA) ? entries[1] : entries[0];
+    EXPECT_EQ(a.tick, 10);
+    EXPECT_EQ(a.entryPointId, idA);
+    EXPECT_EQ(a.count, 4);
+    EXPECT_EQ(a.totalCycles, 425);
+    EXPECT_EQ(a.maxCycles, 300);
+    EXPECT_EQ(a.maxLocalsStackUsage, 128);
+    EXPECT_EQ(b.entryPointId, idB);
+    EXPECT_EQ(b.count, 1);
+    EXPECT_EQ(b.totalCycles, 50);
+
+    // shards are empty after merging
+    profile->finishTick(11);
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 32), 2);
+    EXPECT_EQ(nextRecord, 2);
+
+    // each shard is limited to 3/4 of capacity, dropped calls of all shards are summed up
+    for (unsigned int i = 1; i <= 8; ++i)
+    {
+        profile->addCall(0, i, i, 0);
+        profile->addCall(1, i, i, 0);
+    }
+    EXPECT_EQ(profile->getDroppedCalls(), 4);
+    profile->finishTick(12);
+    firstRecord = 2;
+    EXPECT_EQ(profile->getRecords(firstRecord, nextRecord, entries, 32), 6);
+    for (unsigned int i = 0; i < 6; ++i)
+        EXPECT_EQ(entries[i].count, 2);
+
+    profile->deinit();
+    delete profile;
+}
@@ -0,0 +1,51 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+#include "../src/contract_core/contract_function_cache.h"
+
+TEST(TestContractFunctionCache, AddAndGet)
+{
+    typedef ContractFunctionCache<16, 64> Cache;
+    Cache* cache = new Cache();
+    EXPECT_TRUE(cache->init());
+
+    const m256i key1(1, 2, 3, 4);
+    const m256i key2(2, 2, 3, 4);
+    const unsigned char output1[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    unsigned char output[64];
+    unsigned int outputSize = 0;
+
+    EXPECT_FALSE(cache->get(key1, 100, 1, output, outputSize));
+    cache->add(key1, 100, 1, output1, sizeof(output1));
+    EXPECT_TRUE(cache->get(key1, 100, 1, output, outputSize));
+    EXPECT_EQ(outputSize, sizeof(output1));
+    EXPECT_EQ(memcmp(output, output1, sizeof(output1)), 0);
+
+    // other key, tick, or state version misses
+    EXPECT_FALSE(cache->get(key2, 100, 1, output, outputSize));
+    EXPECT_FALSE(cache->get(key1, 101, 1, output, outputSize));
+    EXPECT_FALSE(cache->get(key1, 100, 2, output, outputSize));
+
+    // outputs not computed from snapshot (version 0) and too large outputs are not cached
+    cache->add(key2, 100, 0, output1, sizeof(output1));
+    EXPECT_FALSE(cache->get(key2, 100, 0, output, outputSize));
+    unsigned char largeOutput[65] = { 0 };
+    cache->add(key2, 100, 1, largeOutput, sizeof(largeOutput));
+    EXPECT_FALSE(cache->get(key2, 100, 1, output, outputSize));
+
+    // empty output is valid
+    cache->add(key2, 100, 1, output1, 0);
+    EXPECT_TRUE(cache->get(key2, 100, 1, output, outputSize));
+    EXPECT_EQ(outputSize, 0);
+
+    // entry of same slot is overwritten
+    const m256i key3(1 + 16, 2, 3, 4);
+    cache->add(key3, 100, 1, output1 + 1, 5);
+    EXPECT_FALSE(cache->get(key1, 100, 1, output, outputSize));
+    EXPECT_TRUE(cache->get(key3, 100, 1, output, outputSize));
+    EXPECT_EQ(outputSize, 5);
+    EXPECT_EQ(output[0], 2);
+
+    cache->deinit();
+    delete cache;
+}
@@ -591,6 +591,35 @@ TEST(ContractMsVault, GetVaults_Multiple)
         static_cast<unsigned int>(vaultsForOwner2Before.numberOfVaults + 2U));
 }
 
+TEST(ContractMsVault, GetVaults_CoOwnerLimit)
+{
+    ContractTestingMsVault msVault;
+
+    increaseEnergy(OWNER1, 100000000ULL);
+
+    // Fill up OWNER1's co-owner quota with vaults that have a varying second owner
+    for (uint64 i = 0; i < MSVAULT_MAX_COOWNER; i++)
+    {
+        const id otherOwner = (i % 2) ? OWNER2 : OWNER3;
+        auto regOut = msVault.registerVault(2ULL, TEST_VAULT_NAME, { OWNER1, otherOwner }, MSVAULT_REGISTERING_FEE);
+        EXPECT_EQ(regOut.status, 1ULL);
+    }
+
+    auto vaultsO1 = msVault.getVaults(OWNER1);
+    EXPECT_EQ(vaultsO1.numberOfVaults, MSVAULT_MAX_COOWNER);
+    for (uint64 i = 1; i < vaultsO1.numberOfVaults; i++)
+    {
+        EXPECT_LT(vaultsO1.vaultIds.get(i - 1), vaultsO1.vaultIds.get(i));
+    }
+    EXPECT_EQ(msVault.getVaults(OWNER2).numberOfVaults, MSVAULT_MAX_COOWNER / 2);
+    EXPECT_EQ(msVault.getVaults(OWNER3).numberOfVaults, MSVAULT_MAX_COOWNER - MSVAULT_MAX_COOWNER / 2);
+
+    // One more vault with OWNER1 exceeds the limit
+    auto regOut = msVault.registerVault(2ULL, TEST_VAULT_NAME, { OWNER1, OWNER2 }, MSVAULT_REGISTERING_FEE);
+    EXPECT_EQ(regOut.status, 7ULL);
+    EXPECT_EQ(msVault.getVaults(OWNER1).numberOfVaults, MSVAULT_MAX_COOWNER);
+}
+
 TEST(ContractMsVault, GetRevenue)
 {
     ContractTestingMsVault msVault;
@@ -1256,3 +1285,22 @@ TEST(ContractMsVault, RevokeAssetManagementRights_Success)
     sint64 finalManagedByQx = numberOfShares(asset, { USER, QX_CONTRACT_INDEX }, { USER, QX_CONTRACT_INDEX });
     EXPECT_EQ(finalManagedByQx, (initialShares - sharesToManage) + sharesToRevoke); // 6000 + 3000 = 9000
 }
+
+TEST(ContractMsVault, BenchmarkDeposit)
+{
+    ContractTestingMsVault msVault;
+    constexpr unsigned int depositCount = 200;
+
+    auto vaultsBefore = msVault.getVaults(OWNER1);
+    increaseEnergy(OWNER1, MSVAULT_REGISTERING_FEE);
+    EXPECT_EQ(msVault.registerVault(TWO_OF_TWO, TEST_VAULT_NAME, { OWNER1, OWNER2 }, MSVAULT_REGISTERING_FEE).status, 1ULL);
+    uint64 vaultId = msVault.getVaults(OWNER1).vaultIds.get(vaultsBefore.numberOfVaults);
+
+    auto deposits = benchmarkContractCalls(MSVAULT_CONTRACT_INDEX, depositCount, [&](unsigned int i)
+        {
+            EXPECT_EQ(msVault.deposit(vaultId, 1000 + i, (i & 1) ? OWNER2 : OWNER1).status, 1ULL);
+        });
+    deposits.print("MSVAULT deposit");
+    EXPECT_TRUE(deposits.stateChangeFlagged);
+    EXPECT_EQ(msVault.getBalanceOf(vaultId).balance, depositCount * 1000ULL + depositCount * (depositCount - 1) / 2);
+}
@@ -349,6 +349,62 @@ TEST(ContractQBond, AddRemoveBidOrder)
     EXPECT_EQ(userOrders.bidOrders.get(0).price, 0);
 }
 
+TEST(ContractQBond, OrdersAtInnerPriceLevel)
+{
+    ContractTestingQBond qbond;
+    qbond.beginEpoch();
+    increaseEnergy(testAddress1, 1000000000);
+    increaseEnergy(testAddress2, 1000000000);
+    qbond.stake(testAddress1, 50, 50250000);
+    EXPECT_EQ(qbond.transfer(testAddress1, testAddress2, system.epoch, 20, 100).transferredMBonds, 20);
+
+    // asks on three price levels, the inner level has orders of two owners
+    EXPECT_EQ(qbond.addAskOrder(testAddress1, system.epoch, 1500000, 2, 0).addedMBondsAmount, 2);
+    EXPECT_EQ(qbond.addAskOrder(testAddress1, system.epoch, 1700000, 2, 0).addedMBondsAmount, 2);
+    EXPECT_EQ(qbond.addAskOrder(testAddress2, system.epoch, 1600000, 4, 0).addedMBondsAmount, 4);
+    EXPECT_EQ(qbond.addAskOrder(testAddress1, system.epoch, 1600000, 3, 0).addedMBondsAmount, 3);
+
+    // adding at an existing level merges with the order of the same owner
+    EXPECT_EQ(qbond.addAskOrder(testAddress1, system.epoch, 1600000, 5, 0).addedMBondsAmount, 5);
+    auto orders = qbond.getOrders(system.epoch, 0, 0);
+    EXPECT_EQ(orders.askOrders.get(1).owner, testAddress2);
+    EXPECT_EQ(orders.askOrders.get(1).numberOfMBonds, 4);
+    EXPECT_EQ(orders.askOrders.get(2).owner, testAddress1);
+    EXPECT_EQ(orders.askOrders.get(2).numberOfMBonds, 8);
+    EXPECT_EQ(orders.askOrders.get(2).price, 1600000);
+    EXPECT_EQ(orders.askOrders.get(3).price, 1700000);
+    EXPECT_EQ(orders.askOrders.get(4).owner, NULL_ID);
+
+    // removal at the inner level only affects the order of the invocator
+    EXPECT_EQ(qbond.removeAskOrder(testAddress1, system.epoch, 1600000, 100, 0).removedMBondsAmount, 8);
+    EXPECT_EQ(qbond.removeAskOrder(testAddress1, system.epoch, 1600000, 100, 0).removedMBondsAmount, 0);
+    orders = qbond.getOrders(system.epoch, 0, 0);
+    EXPECT_EQ(orders.askOrders.get(1).owner, testAddress2);
+    EXPECT_EQ(orders.askOrders.get(1).numberOfMBonds, 4);
+    EXPECT_EQ(orders.askOrders.get(2).price, 1700000);
+
+    // same for bids
+    EXPECT_EQ(qbond.addBidOrder(testAddress2, system.epoch, 1300000, 1, 1300000).addedMBondsAmount, 1);
+    EXPECT_EQ(qbond.addBidOrder(testAddress2, system.epoch, 1100000, 1, 1100000).addedMBondsAmount, 1);
+    EXPECT_EQ(qbond.addBidOrder(testAddress1, system.epoch, 1200000, 1, 1200000).addedMBondsAmount, 1);
+    EXPECT_EQ(qbond.addBidOrder(testAddress2, system.epoch, 1200000, 2, 2400000).addedMBondsAmount, 2);
+    EXPECT_EQ(qbond.addBidOrder(testAddress2, system.epoch, 1200000, 3, 3600000).addedMBondsAmount, 3);
+    orders = qbond.getOrders(system.epoch, 0, 0);
+    EXPECT_EQ(orders.bidOrders.get(1).owner, testAddress1);
+    EXPECT_EQ(orders.bidOrders.get(2).owner, testAddress2);
+    EXPECT_EQ(orders.bidOrders.get(2).numberOfMBonds, 5);
+    EXPECT_EQ(orders.bidOrders.get(3).price, 1100000);
+    EXPECT_EQ(orders.bidOrders.get(4).owner, NULL_ID);
+
+    int64_t prevBalance = getBalance(testAddress2);
+    EXPECT_EQ(qbond.removeBidOrder(testAddress2, system.epoch, 1200000, 4, 0).removedMBondsAmount, 4);
+    EXPECT_EQ(getBalance(testAddress2) - prevBalance, 4800000);
+    orders = qbond.getOrders(system.epoch, 0, 0);
+    EXPECT_EQ(orders.bidOrders.get(1).owner, testAddress1);
+    EXPECT_EQ(orders.bidOrders.get(2).owner, testAddress2);
+    EXPECT_EQ(orders.bidOrders.get(2).numberOfMBonds, 1);
+}
+
 TEST(ContractQBond, BurnQu)
 {
     ContractTestingQBond qbond;
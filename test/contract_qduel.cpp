@@ -486,6 +486,39 @@ TEST(ContractQDuel, EndTickExpiresRoomCreatesNewWhenDepositAvailable)
 	EXPECT_EQ(userAfter.locked, stake);
 }
 
+TEST(ContractQDuel, EndTickExpiresManyRoomsEachFinalizedOnce)
+{
+	ContractTestingQDuel qduel;
+	qduel.state()->setState(QDUEL::EState::NONE);
+	qduel.setDeterministicTime(2025, 1, 1, 0);
+
+	// Finalizing the expired rooms creates follow-up rooms in the same hash map that is swept.
+	constexpr uint64 ownerCount = 200;
+	const sint64 stake = qduel.state()->minDuelAmount();
+	for (uint64 i = 0; i < ownerCount; ++i)
+	{
+		const id owner(100 + i, 0, 0, 0);
+		increaseEnergy(owner, stake);
+		EXPECT_EQ(qduel.createRoom(owner, NULL_ID, stake, 1, stake, stake).returnCode, QDUEL::toReturnCode(QDUEL::EReturnCode::SUCCESS));
+	}
+	EXPECT_EQ(qduel.state()->roomCount(), ownerCount);
+
+	qduel.setDeterministicTime(2025, 1, 1, 3);
+	qduel.forceEndTick();
+
+	// Each expired room is replaced by exactly one fresh room of its owner.
+	EXPECT_EQ(qduel.state()->roomCount(), ownerCount);
+	for (uint64 i = 0; i < ownerCount; ++i)
+	{
+		const id owner(100 + i, 0, 0, 0);
+		QDUEL::UserData userData{};
+		ASSERT_TRUE(qduel.state()->getUserData(owner, userData));
+		EXPECT_TRUE(qduel.state()->hasRoom(userData.roomId));
+		EXPECT_EQ(userData.locked, stake);
+	}
+	EXPECT_EQ(qduel.state()->firstRoom().closeTimer, static_cast<uint64>(qduel.state()->ttl()) * 3600ULL);
+}
+
 TEST(ContractQDuel, EndTickExpiresRoomWithoutAvailableDepositRemovesUser)
 {
 	ContractTestingQDuel qduel;
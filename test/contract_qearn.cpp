@@ -981,3 +981,22 @@ TEST(TestContractQearn, RandomLockAndUnlock)
     testRandomLockWithUnlock(100, 20000, 10000, 8000);
 #endif
 }
+
+TEST(TestContractQearn, BenchmarkLock)
+{
+    ContractTestingQearn qearn;
+    constexpr unsigned int lockCount = 200;
+
+    system.epoch = QEARN_INITIAL_EPOCH;
+    qearn.beginEpoch();
+    for (unsigned int i = 0; i < lockCount; ++i)
+        increaseEnergy(getUser(i), QEARN_MINIMUM_LOCKING_AMOUNT + i);
+
+    auto locks = benchmarkContractCalls(QEARN_CONTRACT_INDEX, lockCount, [&](unsigned int i)
+        {
+            EXPECT_EQ(qearn.lock(getUser(i), QEARN_MINIMUM_LOCKING_AMOUNT + i), QEARN_LOCK_SUCCESS);
+        });
+    locks.print("QEARN lock");
+    EXPECT_TRUE(locks.stateChangeFlagged);
+    EXPECT_GT(locks.stateBytesChanged, 0);
+}
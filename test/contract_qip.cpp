@@ -1309,6 +1309,78 @@ TEST(ContractQIP, END_EPOCH_Phase3ReturnToCreator)
     EXPECT_EQ(numberOfPossessedShares(assetName, issuer, QIP_CONTRACT_ID, QIP_CONTRACT_ID, QIP_CONTRACT_INDEX, QIP_CONTRACT_INDEX), totalShares - remainingPhase3);
 }
 
+TEST(ContractQIP, END_EPOCH_ManyICOs)
+{
+    ContractTestingQIP QIP;
+
+    const uint32 epoch0 = system.epoch;
+    const char* assetNames[4] = { "ICOA", "ICOB", "ICOC", "ICOD" };
+    const uint32 startEpochs[4] = { epoch0 + 2, epoch0 + 3, epoch0 + 2, epoch0 + 3 };
+    const sint64 totalShares = 1000000;
+    const sint64 extraShares = 1000;
+    id issuer = QIP_testIssuer;
+
+    QIP::createICO_input createInput;
+    setMemory(createInput, 0);
+    createInput.issuer = issuer;
+    createInput.address1 = QIP_testAddress1;
+    createInput.price1 = 100;
+    createInput.price2 = 200;
+    createInput.price3 = 300;
+    createInput.saleAmountForPhase1 = 300000;
+    createInput.saleAmountForPhase2 = 300000;
+    createInput.saleAmountForPhase3 = 400000;
+    createInput.percent1 = 95;
+
+    for (int i = 0; i < 4; i++)
+    {
+        Asset asset{ issuer, assetNameFromString(assetNames[i]) };
+        increaseEnergy(issuer, QIP_ISSUE_ASSET_FEE + QIP_TRANSFER_ASSET_FEE * 2 + 1);
+        EXPECT_EQ(QIP.issueAsset(issuer, asset.assetName, totalShares + extraShares), totalShares + extraShares);
+        EXPECT_EQ(QIP.transferShareManagementRightsQX(issuer, asset, totalShares, QIP_CONTRACT_INDEX, QIP_TRANSFER_ASSET_FEE), totalShares);
+
+        createInput.assetName = asset.assetName;
+        createInput.startEpoch = startEpochs[i];
+        EXPECT_EQ(QIP.createICO(issuer, createInput).returnCode, QIPLogInfo::QIP_success);
+
+        // Keep some shares managed by QIP outside of the ICO
+        EXPECT_EQ(QIP.transferShareManagementRightsQX(issuer, asset, extraShares, QIP_CONTRACT_INDEX, QIP_TRANSFER_ASSET_FEE), extraShares);
+    }
+    EXPECT_EQ(QIP.getState()->getNumberOfICO(), 4);
+
+    for (system.epoch = epoch0 + 2; system.epoch < epoch0 + 4; ++system.epoch)
+    {
+        QIP.endEpoch();
+    }
+
+    // Phase 3 of ICOA and ICOC ends and phase 2 of ICOB and ICOD ends. The last ICO moves into the index of a removed one.
+    QIP.endEpoch();
+    EXPECT_EQ(QIP.getState()->getNumberOfICO(), 2);
+    EXPECT_EQ(QIP.getICOInfo(0).assetName, assetNameFromString("ICOD"));
+    EXPECT_EQ(QIP.getICOInfo(1).assetName, assetNameFromString("ICOB"));
+    for (uint32 i = 0; i < 2; i++)
+    {
+        QIP::getICOInfo_output icoInfo = QIP.getICOInfo(i);
+        EXPECT_EQ(icoInfo.remainingAmountForPhase1, 0);
+        EXPECT_EQ(icoInfo.remainingAmountForPhase2, 0);
+        EXPECT_EQ(icoInfo.remainingAmountForPhase3, totalShares);
+    }
+    EXPECT_EQ(numberOfPossessedShares(assetNameFromString("ICOA"), issuer, issuer, issuer, QIP_CONTRACT_INDEX, QIP_CONTRACT_INDEX), totalShares + extraShares);
+    EXPECT_EQ(numberOfPossessedShares(assetNameFromString("ICOC"), issuer, issuer, issuer, QIP_CONTRACT_INDEX, QIP_CONTRACT_INDEX), totalShares + extraShares);
+    EXPECT_EQ(numberOfPossessedShares(assetNameFromString("ICOB"), issuer, issuer, issuer, QIP_CONTRACT_INDEX, QIP_CONTRACT_INDEX), extraShares);
+
+    // Management rights of ICOA can be transferred away again, the ones of ICOB are still locked by its ICO
+    increaseEnergy(issuer, QIP_TRANSFER_RIGHTS_FEE * 2);
+    EXPECT_EQ(QIP.transferShareManagementRights(issuer, { issuer, assetNameFromString("ICOA") }, extraShares, QX_CONTRACT_INDEX, QIP_TRANSFER_RIGHTS_FEE), extraShares);
+    EXPECT_EQ(QIP.transferShareManagementRights(issuer, { issuer, assetNameFromString("ICOB") }, extraShares, QX_CONTRACT_INDEX, QIP_TRANSFER_RIGHTS_FEE), 0);
+
+    ++system.epoch;
+    QIP.endEpoch();
+    EXPECT_EQ(QIP.getState()->getNumberOfICO(), 0);
+    EXPECT_EQ(numberOfPossessedShares(assetNameFromString("ICOB"), issuer, issuer, issuer, QIP_CONTRACT_INDEX, QIP_CONTRACT_INDEX), totalShares + extraShares);
+    EXPECT_EQ(numberOfPossessedShares(assetNameFromString("ICOD"), issuer, issuer, issuer, QIP_CONTRACT_INDEX, QIP_CONTRACT_INDEX), totalShares + extraShares);
+}
+
 TEST(ContractQIP, TransferShareManagementRights)
 {
     ContractTestingQIP QIP;
@@ -18,6 +18,8 @@ constexpr uint32 QUOTE_EXACT_QU_OUTPUT_IDX = 5;
 constexpr uint32 QUOTE_EXACT_ASSET_INPUT_IDX = 6;
 constexpr uint32 QUOTE_EXACT_ASSET_OUTPUT_IDX = 7;
 constexpr uint32 INVEST_REWARDS_INFO_IDX = 8;
+constexpr uint32 QUOTE_MANY_IDX = 9;
+constexpr uint32 QUOTE_EXACT_ASSET_FOR_ASSET_IDX = 10;
 //
 constexpr uint32 ISSUE_ASSET_IDX = 1;
 constexpr uint32 TRANSFER_SHARE_OWNERSHIP_AND_POSSESSION_IDX = 2;
@@ -30,6 +32,7 @@ constexpr uint32 SWAP_EXACT_ASSET_FOR_QU_IDX = 8;
 constexpr uint32 SWAP_ASSET_FOR_EXACT_QU_IDX = 9;
 constexpr uint32 SET_INVEST_REWARDS_INFO_IDX = 10;
 constexpr uint32 TRANSFER_SHARE_MANAGEMENT_RIGHTS_IDX = 11;
+constexpr uint32 SWAP_EXACT_ASSET_FOR_ASSET_IDX = 12;
 
 
 class QswapChecker : public QSWAP
@@ -243,6 +246,35 @@ public:
 		callFunction(QSWAP_CONTRACT_INDEX, QUOTE_EXACT_ASSET_OUTPUT_IDX, input, output);
 		return output;
     }
+
+    QSWAP::QuoteMany_output quoteMany(const QSWAP::QuoteMany_input& input)
+    {
+		QSWAP::QuoteMany_output output;
+		callFunction(QSWAP_CONTRACT_INDEX, QUOTE_MANY_IDX, input, output);
+		return output;
+    }
+
+    QSWAP::QuoteExactAssetForAsset_output quoteExactAssetForAsset(QSWAP::QuoteExactAssetForAsset_input input)
+    {
+		QSWAP::QuoteExactAssetForAsset_output output;
+		callFunction(QSWAP_CONTRACT_INDEX, QUOTE_EXACT_ASSET_FOR_ASSET_IDX, input, output);
+		return output;
+    }
+
+	QSWAP::SwapExactAssetForAsset_output swapExactAssetForAsset(const id& issuer, QSWAP::SwapExactAssetForAsset_input input, uint64 inputValue)
+    {
+		QSWAP::SwapExactAssetForAsset_output output;
+		invokeUserProcedure(
+			QSWAP_CONTRACT_INDEX,
+			SWAP_EXACT_ASSET_FOR_ASSET_IDX,
+			input,
+			output,
+			issuer,
+			inputValue
+		);
+
+		return output;
+	}
 };
 
 TEST(ContractSwap, InvestRewardsInfoTest)
@@ -330,6 +362,93 @@ TEST(ContractSwap, QuoteTest)
     }
 }
 
+TEST(ContractSwap, QuoteManyAndMultiHop)
+{
+    ContractTestingQswap qswap;
+
+    id issuer(1, 2, 3, 4);
+    uint64 assetNames[2] = { assetNameFromString("QSWAP0"), assetNameFromString("QSWAP1") };
+    sint64 numberOfShares = 10000 * 1000;
+
+    // issue two assets, create pools, and init liquidity
+    for (int i = 0; i < 2; i++)
+    {
+        increaseEnergy(issuer, QSWAP_ISSUE_ASSET_FEE);
+        QSWAP::IssueAsset_input input = { assetNames[i], numberOfShares, 0, 0 };
+        EXPECT_EQ(qswap.issueAsset(issuer, input), numberOfShares);
+
+        increaseEnergy(issuer, QSWAP_CREATE_POOL_FEE);
+        EXPECT_TRUE(qswap.createPool(issuer, assetNames[i]));
+
+        sint64 inputValue = (i + 1) * 200 * 1000;
+        increaseEnergy(issuer, inputValue);
+        QSWAP::AddLiquidity_input alInput = { issuer, assetNames[i], 100 * 1000, 0, 0 };
+        qswap.addLiquidity(issuer, alInput, inputValue);
+    }
+
+    // batched quotes are the same as single quotes
+    {
+        QSWAP::QuoteMany_input input;
+        setMemory(input, 0);
+        input.requests.set(0, { issuer, assetNames[0], 1000, QSWAP_QUOTE_EXACT_QU_INPUT });
+        input.requests.set(1, { issuer, assetNames[1], 1000, QSWAP_QUOTE_EXACT_QU_OUTPUT });
+        input.requests.set(2, { issuer, assetNames[0], 1000, QSWAP_QUOTE_EXACT_ASSET_INPUT });
+        input.requests.set(3, { issuer, assetNames[1], 1000, QSWAP_QUOTE_EXACT_ASSET_OUTPUT });
+        input.requests.set(4, { issuer, assetNameFromString("NOPOOL"), 1000, QSWAP_QUOTE_EXACT_QU_INPUT });
+        input.requests.set(5, { issuer, assetNames[0], 1000, 4 });
+        input.requests.set(6, { issuer, assetNames[0], 1000, QSWAP_QUOTE_EXACT_QU_INPUT });
+        input.count = 6;
+        QSWAP::QuoteMany_output output = qswap.quoteMany(input);
+
+        EXPECT_EQ(output.amounts.get(0), qswap.quoteExactQuInput({ issuer, assetNames[0], 1000 }).assetAmountOut);
+        EXPECT_EQ(output.amounts.get(1), qswap.quoteExactQuOutput({ issuer, assetNames[1], 1000 }).assetAmountIn);
+        EXPECT_EQ(output.amounts.get(2), qswap.quoteExactAssetInput({ issuer, assetNames[0], 1000 }).quAmountOut);
+        EXPECT_EQ(output.amounts.get(3), qswap.quoteExactAssetOutput({ issuer, assetNames[1], 1000 }).quAmountIn);
+        EXPECT_GT(output.amounts.get(0), 0);
+        EXPECT_EQ(output.amounts.get(4), -1);
+        EXPECT_EQ(output.amounts.get(5), -1);
+        EXPECT_EQ(output.amounts.get(6), -1); // beyond count
+    }
+
+    // multi-hop swap asset0 -> qu -> asset1
+    {
+        id user(1, 2, 3, 4);
+        sint64 assetAmountIn = 10 * 1000;
+        QSWAP::QuoteExactAssetForAsset_output quote = qswap.quoteExactAssetForAsset({ issuer, assetNames[0], issuer, assetNames[1], assetAmountIn });
+        EXPECT_EQ(quote.quAmount, qswap.quoteExactAssetInput({ issuer, assetNames[0], assetAmountIn }).quAmountOut);
+        EXPECT_EQ(quote.assetAmountOut, qswap.quoteExactQuInput({ issuer, assetNames[1], quote.quAmount }).assetAmountOut);
+        EXPECT_GT(quote.assetAmountOut, 0);
+
+        // same pool for both hops is rejected
+        EXPECT_EQ(qswap.quoteExactAssetForAsset({ issuer, assetNames[0], issuer, assetNames[0], assetAmountIn }).assetAmountOut, -1);
+
+        const sint64 asset0Before = numberOfPossessedShares(assetNames[0], issuer, user, user, QSWAP_CONTRACT_INDEX, QSWAP_CONTRACT_INDEX);
+        const sint64 asset1Before = numberOfPossessedShares(assetNames[1], issuer, user, user, QSWAP_CONTRACT_INDEX, QSWAP_CONTRACT_INDEX);
+        QSWAP::GetPoolBasicState_output pool0Before = qswap.getPoolBasicState(issuer, assetNames[0]);
+        QSWAP::GetPoolBasicState_output pool1Before = qswap.getPoolBasicState(issuer, assetNames[1]);
+
+        // min amount out not reached -> nothing changes
+        QSWAP::SwapExactAssetForAsset_input input = { issuer, assetNames[0], assetAmountIn, issuer, assetNames[1], quote.assetAmountOut + 1 };
+        EXPECT_EQ(qswap.swapExactAssetForAsset(user, input, 0).assetAmountOut, 0);
+        EXPECT_EQ(numberOfPossessedShares(assetNames[0], issuer, user, user, QSWAP_CONTRACT_INDEX, QSWAP_CONTRACT_INDEX), asset0Before);
+
+        input.assetAmountOutMin = quote.assetAmountOut;
+        EXPECT_EQ(qswap.swapExactAssetForAsset(user, input, 0).assetAmountOut, quote.assetAmountOut);
+        EXPECT_EQ(numberOfPossessedShares(assetNames[0], issuer, user, user, QSWAP_CONTRACT_INDEX, QSWAP_CONTRACT_INDEX), asset0Before - assetAmountIn);
+        EXPECT_EQ(numberOfPossessedShares(assetNames[1], issuer, user, user, QSWAP_CONTRACT_INDEX, QSWAP_CONTRACT_INDEX), asset1Before + quote.assetAmountOut);
+
+        QSWAP::GetPoolBasicState_output pool0After = qswap.getPoolBasicState(issuer, assetNames[0]);
+        QSWAP::GetPoolBasicState_output pool1After = qswap.getPoolBasicState(issuer, assetNames[1]);
+        EXPECT_EQ(pool0After.reservedAssetAmount, pool0Before.reservedAssetAmount + assetAmountIn);
+        EXPECT_LT(pool0After.reservedQuAmount, pool0Before.reservedQuAmount - quote.quAmount);
+        EXPECT_EQ(pool1After.reservedAssetAmount, pool1Before.reservedAssetAmount - quote.assetAmountOut);
+        EXPECT_GT(pool1After.reservedQuAmount, pool1Before.reservedQuAmount);
+        EXPECT_LT(pool1After.reservedQuAmount, pool1Before.reservedQuAmount + quote.quAmount);
+        EXPECT_EQ(pool0After.totalLiquidity, pool0Before.totalLiquidity);
+        EXPECT_EQ(pool1After.totalLiquidity, pool1Before.totalLiquidity);
+    }
+}
+
 /*
 0. normally issue asset
 1. not enough qu for asset issue fee
@@ -808,3 +927,35 @@ TEST(ContractSwap, LiqTest2)
         EXPECT_EQ(output.assetAmount, 0);
     }
 }
+
+TEST(ContractSwap, BenchmarkSwapExactQuForAsset)
+{
+    ContractTestingQswap qswap;
+
+    id issuer(1, 2, 3, 4);
+    uint64 assetName = assetNameFromString("QSWAP0");
+    sint64 numberOfShares = 10000 * 1000;
+    constexpr unsigned int swapCount = 200;
+    constexpr sint64 swapAmount = 1000;
+
+    increaseEnergy(issuer, QSWAP_ISSUE_ASSET_FEE);
+    QSWAP::IssueAsset_input input = { assetName, numberOfShares, 0, 0 };
+    EXPECT_EQ(qswap.issueAsset(issuer, input), numberOfShares);
+    increaseEnergy(issuer, QSWAP_CREATE_POOL_FEE);
+    EXPECT_TRUE(qswap.createPool(issuer, assetName));
+    increaseEnergy(issuer, 1000 * 1000);
+    QSWAP::AddLiquidity_input alInput = { issuer, assetName, 1000 * 1000, 0, 0 };
+    qswap.addLiquidity(issuer, alInput, 1000 * 1000);
+
+    for (unsigned int i = 0; i < swapCount; ++i)
+        increaseEnergy(id(i, 3, 4, 5), swapAmount);
+
+    auto swaps = benchmarkContractCalls(QSWAP_CONTRACT_INDEX, swapCount, [&](unsigned int i)
+        {
+            QSWAP::SwapExactQuForAsset_input swapInput = { issuer, assetName, 0 };
+            EXPECT_GT(qswap.swapExactQuForAsset(id(i, 3, 4, 5), swapInput, swapAmount).assetAmountOut, 0);
+        });
+    swaps.print("QSWAP SwapExactQuForAsset");
+    EXPECT_TRUE(swaps.stateChangeFlagged);
+    EXPECT_GT(swaps.stateBytesChanged, 0);
+}
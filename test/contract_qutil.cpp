@@ -1749,3 +1749,40 @@ TEST(QUtilTest, DistributeQuToShareholders)
     EXPECT_EQ(output.amountPerShare, amountPerShare);
     EXPECT_EQ(output.fees, 7 * QUTIL_DISTRIBUTE_QU_TO_SHAREHOLDER_FEE_PER_SHAREHOLDER);
 }
+
+TEST(QUtilTest, BenchmarkVotes)
+{
+    ContractTestingQUtil qutil;
+    id creator = generateRandomId();
+    uint64_t min_amount = 1000;
+    constexpr unsigned int voteCount = 200;
+
+    QUTIL::CreatePoll_input create_input;
+    create_input.poll_name = generateRandomId();
+    create_input.poll_type = QUTIL_POLL_TYPE_QUBIC;
+    create_input.min_amount = min_amount;
+    create_input.github_link = stringToArray("https://github.com/qubic/proposal/benchmark");
+    create_input.num_assets = 0;
+    increaseEnergy(creator, QUTIL_POLL_CREATION_FEE);
+    uint64_t poll_id = qutil.createPoll(creator, create_input, QUTIL_POLL_CREATION_FEE).poll_id;
+
+    std::vector<id> voters(voteCount);
+    for (auto& voter : voters)
+    {
+        voter = generateRandomId();
+        increaseEnergy(voter, min_amount + QUTIL_VOTE_FEE);
+    }
+
+    auto votes = benchmarkContractCalls(QUTIL_CONTRACT_INDEX, voteCount, [&](unsigned int i)
+        {
+            QUTIL::Vote_input vote_input;
+            vote_input.poll_id = poll_id;
+            vote_input.address = voters[i];
+            vote_input.amount = min_amount;
+            vote_input.chosen_option = i % 4;
+            EXPECT_TRUE(qutil.vote(voters[i], vote_input, QUTIL_VOTE_FEE).success);
+        });
+    votes.print("QUTIL Vote");
+    EXPECT_TRUE(votes.stateChangeFlagged);
+    EXPECT_GT(votes.stateBytesChanged, 0);
+}
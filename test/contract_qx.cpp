@@ -151,6 +151,22 @@ public:
         return output.issuedNumberOfShares;
     }
 
+    sint64 addToAskOrder(const id& user, const id& issuer, uint64 assetName, sint64 price, sint64 numberOfShares)
+    {
+        QX::AddToAskOrder_input input{ issuer, assetName, price, numberOfShares };
+        QX::AddToAskOrder_output output;
+        invokeUserProcedure(QX_CONTRACT_INDEX, 5, input, output, user, 0);
+        return output.addedNumberOfShares;
+    }
+
+    sint64 addToBidOrder(const id& user, const id& issuer, uint64 assetName, sint64 price, sint64 numberOfShares)
+    {
+        QX::AddToBidOrder_input input{ issuer, assetName, price, numberOfShares };
+        QX::AddToBidOrder_output output;
+        invokeUserProcedure(QX_CONTRACT_INDEX, 6, input, output, user, price * numberOfShares);
+        return output.addedNumberOfShares;
+    }
+
     // TODO: add other procedures
 
     void endTick(bool expectSuccess = true)
@@ -251,3 +267,37 @@ TEST(ContractQx, CleanupCollections)
         std::cout << "QX state file not found. Skipping file test..." << std::endl;
     }
 }
+
+TEST(ContractQx, BenchmarkOrders)
+{
+    ContractTestingQx qx;
+
+    id issuer(1, 2, 3, 4);
+    uint64 assetName = assetNameFromString("BENCH");
+    constexpr unsigned int orderCount = 200;
+
+    increaseEnergy(issuer, QX_ISSUE_ASSET_FEE);
+    EXPECT_EQ(qx.issueAsset(issuer, assetName, orderCount, 0, 0), orderCount);
+    for (unsigned int i = 0; i < orderCount; ++i)
+        increaseEnergy(id(i, 5, 6, 7), 10 + i % 50);
+
+    // bids with different prices by different users, filling the order collections
+    auto bids = benchmarkContractCalls(QX_CONTRACT_INDEX, orderCount, [&](unsigned int i)
+        {
+            EXPECT_EQ(qx.addToBidOrder(id(i, 5, 6, 7), issuer, assetName, 10 + i % 50, 1), 1);
+        });
+    bids.print("QX AddToBidOrder");
+    EXPECT_TRUE(bids.stateChangeFlagged);
+    EXPECT_GT(bids.stateBytesChanged, 0);
+
+    // asks matching the bids, transferring shares and removing bid orders
+    auto asks = benchmarkContractCalls(QX_CONTRACT_INDEX, orderCount, [&](unsigned int i)
+        {
+            EXPECT_EQ(qx.addToAskOrder(issuer, issuer, assetName, 10, 1), 1);
+        });
+    asks.print("QX AddToAskOrder");
+    EXPECT_TRUE(asks.stateChangeFlagged);
+
+    qx.getState()->checkCollectionConsistency();
+    EXPECT_EQ(qx.assetBidOrders(issuer, assetName, 0).orders.get(0).price, 0);
+}
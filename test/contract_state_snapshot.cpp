@@ -0,0 +1,137 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/contract_core/contract_state_snapshot.h"
+
+TEST(TestContractStateSnapshot, PublishAcquireRelease)
+{
+    constexpr unsigned int stateSize = 1000;
+    unsigned char state[stateSize];
+    for (unsigned int i = 0; i < stateSize; ++i)
+        state[i] = (unsigned char)i;
+
+    ContractStateSnapshot snapshot;
+    snapshot.reset();
+    unsigned int bufferIndex;
+    EXPECT_FALSE(snapshot.isEnabled());
+    EXPECT_EQ(snapshot.acquire(bufferIndex), nullptr);
+    EXPECT_TRUE(snapshot.publish(state));
+
+    EXPECT_TRUE(snapshot.init(stateSize));
+    EXPECT_TRUE(snapshot.isEnabled());
+
+    // nothing published yet
+    EXPECT_EQ(snapshot.acquire(bufferIndex), nullptr);
+    EXPECT_EQ(snapshot.getPublishedVersion(), 0);
+
+    // published copy stays unchanged when state is changed
+    EXPECT_TRUE(snapshot.publish(state));
+    state[0] = 200;
+    unsigned int bufferIndex1;
+    const unsigned char* view1 = (const unsigned char*)snapshot.acquire(bufferIndex1);
+    ASSERT_NE(view1, nullptr);
+    EXPECT_EQ(snapshot.getVersion(bufferIndex1), 1);
+    EXPECT_EQ(snapshot.getPublishedVersion(), 1);
+    EXPECT_EQ(view1[0], 0);
+    EXPECT_EQ(view1[stateSize - 1], (unsigned char)(stateSize - 1));
+
+    // publishing while reader is active in old snapshot uses other buffer
+    EXPECT_TRUE(snapshot.publish(state));
+    EXPECT_EQ(view1[0], 0);
+    unsigned int bufferIndex2;
+    const unsigned char* view2 = (const unsigned char*)snapshot.acquire(bufferIndex2);
+    ASSERT_NE(view2, nullptr);
+    EXPECT_NE(bufferIndex1, bufferIndex2);
+    EXPECT_EQ(snapshot.getVersion(bufferIndex2), 2);
+    EXPECT_EQ(view2[0], 200);
+    snapshot.release(bufferIndex2);
+
+    // reader still active in unpublished buffer -> publishing is postponed and snapshot is unavailable
+    state[0] = 201;
+    EXPECT_FALSE(snapshot.publish(state));
+    EXPECT_TRUE(snapshot.isPublishPending());
+    EXPECT_EQ(snapshot.acquire(bufferIndex), nullptr);
+    EXPECT_EQ(snapshot.getPublishedVersion(), 0);
+    EXPECT_EQ(view1[0], 0);
+
+    // retry succeeds after reader is done
+    snapshot.release(bufferIndex1);
+    EXPECT_TRUE(snapshot.publish(state));
+    EXPECT_FALSE(snapshot.isPublishPending());
+    const unsigned char* view3 = (const unsigned char*)snapshot.acquire(bufferIndex);
+    ASSERT_NE(view3, nullptr);
+    EXPECT_EQ(view3[0], 201);
+    EXPECT_EQ(snapshot.getPublishedVersion(), 3);
+    snapshot.release(bufferIndex);
+
+    snapshot.deinit();
+    EXPECT_FALSE(snapshot.isEnabled());
+}
+
+TEST(TestContractStateSnapshot, PageChangeTracking)
+{
+    constexpr unsigned int stateSize = 3 * contractStateSnapshotPageSize + 100;
+    unsigned char* state = new unsigned char[stateSize];
+    setMem(state, stateSize, 0);
+
+    ContractStateSnapshot snapshot;
+    snapshot.reset();
+    EXPECT_TRUE(snapshot.init(stateSize));
+    EXPECT_FALSE(snapshot.isTrackingPageChanges());
+    EXPECT_EQ(snapshot.getPageCount(), 0);
+    snapshot.deinit();
+
+    EXPECT_TRUE(snapshot.init(stateSize, true));
+    EXPECT_TRUE(snapshot.isTrackingPageChanges());
+    EXPECT_EQ(snapshot.getPageCount(), 4);
+
+    // first version contains all pages
+    EXPECT_TRUE(snapshot.publish(state));
+    for (unsigned int page = 0; page < 4; ++page)
+        EXPECT_EQ(snapshot.getPageVersion(page), 1);
+
+    // unchanged state
+    EXPECT_TRUE(snapshot.publish(state));
+    for (unsigned int page = 0; page < 4; ++page)
+        EXPECT_EQ(snapshot.getPageVersion(page), 1);
+
+    // change second page and last byte of short last page
+    state[contractStateSnapshotPageSize + 17] = 1;
+    state[stateSize - 1] = 2;
+    EXPECT_TRUE(snapshot.publish(state));
+    EXPECT_EQ(snapshot.getPageVersion(0), 1);
+    EXPECT_EQ(snapshot.getPageVersion(1), 3);
+    EXPECT_EQ(snapshot.getPageVersion(2), 1);
+    EXPECT_EQ(snapshot.getPageVersion(3), 3);
+
+    // change while publishing is postponed is tracked when publishing succeeds
+    unsigned int bufferIndex1, bufferIndex2;
+    ASSERT_NE(snapshot.acquire(bufferIndex1), nullptr);
+    state[0] = 3;
+    EXPECT_TRUE(snapshot.publish(state));
+    EXPECT_EQ(snapshot.getPageVersion(0), 4);
+    ASSERT_NE(snapshot.acquire(bufferIndex2), nullptr);
+    snapshot.release(bufferIndex2);
+    state[2 * contractStateSnapshotPageSize] = 4;
+    EXPECT_FALSE(snapshot.publish(state));
+    EXPECT_EQ(snapshot.getPageVersion(2), 1);
+    snapshot.release(bufferIndex1);
+    EXPECT_TRUE(snapshot.publish(state));
+    EXPECT_EQ(snapshot.getPublishedVersion(), 5);
+    EXPECT_EQ(snapshot.getPageVersion(0), 4);
+    EXPECT_EQ(snapshot.getPageVersion(1), 3);
+    EXPECT_EQ(snapshot.getPageVersion(2), 5);
+    EXPECT_EQ(snapshot.getPageVersion(3), 3);
+
+    // published snapshot contains state of version
+    const unsigned char* view = (const unsigned char*)snapshot.acquire(bufferIndex1);
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(view[0], 3);
+    EXPECT_EQ(view[2 * contractStateSnapshotPageSize], 4);
+    EXPECT_EQ(view[stateSize - 1], 2);
+    snapshot.release(bufferIndex1);
+
+    snapshot.deinit();
+    delete[] state;
+}
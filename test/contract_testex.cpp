@@ -2,6 +2,7 @@
 
 #include <thread>
 #include <chrono>
+#include <random>
 
 #include "contract_testing.h"
 #include "oracle_testing.h"
@@ -1294,6 +1295,104 @@ TEST(ContractTestEx, QpiFunctionsIPO)
     EXPECT_EQ(getBalance(TESTEXC_CONTRACT_ID), initialBalance - 76 * finalPrice);
 }
 
+// Reference of IPO bidding that inserts the units of a bid one by one, like bidInContractIPO() did before
+// inserting all units at once
+struct IpoBidsReference
+{
+    m256i publicKeys[NUMBER_OF_COMPUTORS];
+    long long prices[NUMBER_OF_COMPUTORS];
+
+    long long bid(long long price, unsigned short quantity, const m256i& publicKey)
+    {
+        long long registeredBids = 0;
+        for (unsigned int i = 0; i < quantity; i++)
+        {
+            if (price > prices[NUMBER_OF_COMPUTORS - 1])
+            {
+                publicKeys[NUMBER_OF_COMPUTORS - 1] = publicKey;
+                prices[NUMBER_OF_COMPUTORS - 1] = price;
+                for (unsigned int j = NUMBER_OF_COMPUTORS - 1; j && prices[j - 1] < prices[j]; j--)
+                {
+                    std::swap(publicKeys[j - 1], publicKeys[j]);
+                    std::swap(prices[j - 1], prices[j]);
+                }
+                ++registeredBids;
+            }
+        }
+        return registeredBids;
+    }
+};
+
+TEST(ContractTestEx, IPOBidsMatchPerUnitReference)
+{
+    ContractTestingTestEx test;
+    system.epoch = contractDescriptions[TESTEXD_CONTRACT_INDEX].constructionEpoch - 1;
+    const IPO* ipo = (const IPO*)contractStates[TESTEXD_CONTRACT_INDEX];
+    static IpoBidsReference reference;
+    copyMem(reference.publicKeys, ipo->publicKeys, sizeof(reference.publicKeys));
+    copyMem(reference.prices, ipo->prices, sizeof(reference.prices));
+
+    // few bidders and prices, so the same bidders bid repeatedly and many bids have equal prices
+    constexpr long long initialBalance = 1000000000000ll;
+    id bidders[7];
+    for (unsigned int i = 0; i < 7; i++)
+    {
+        bidders[i] = id(1000 + i, 2000, 3000, 4000);
+        increaseEnergy(bidders[i], initialBalance);
+    }
+
+    std::mt19937_64 gen(113);
+    unsigned int fullBookBids = 0, partiallyAcceptedBids = 0, rejectedBids = 0;
+    for (unsigned int bidIndex = 0; bidIndex < 1000; bidIndex++)
+    {
+        const id& bidder = bidders[gen() % 7];
+        const long long price = 1 + gen() % 30 + bidIndex / 10;
+        const unsigned short quantity = (unsigned short)((gen() % 4) ? 1 + gen() % 50 : 1 + gen() % NUMBER_OF_COMPUTORS);
+        if (reference.prices[NUMBER_OF_COMPUTORS - 1])
+            ++fullBookBids;
+
+        const long long expectedBids = reference.bid(price, quantity, bidder);
+        EXPECT_EQ(bidInContractIPO(price, quantity, bidder, spectrumIndex(bidder), TESTEXD_CONTRACT_INDEX), expectedBids);
+        if (expectedBids == 0)
+            ++rejectedBids;
+        else if (expectedBids < quantity)
+            ++partiallyAcceptedBids;
+
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        {
+            ASSERT_EQ(ipo->publicKeys[i], reference.publicKeys[i]);
+            ASSERT_EQ(ipo->prices[i], reference.prices[i]);
+        }
+        // all bids that are not in the book have been refunded
+        for (unsigned int i = 0; i < 7; i++)
+        {
+            long long spent = 0;
+            for (unsigned int j = 0; j < NUMBER_OF_COMPUTORS; j++)
+                if (reference.publicKeys[j] == bidders[i])
+                    spent += reference.prices[j];
+            EXPECT_EQ(getBalance(bidders[i]), initialBalance - spent);
+        }
+    }
+    EXPECT_GT(fullBookBids, 900u);
+    EXPECT_GT(partiallyAcceptedBids, 10u);
+    EXPECT_GT(rejectedBids, 10u);
+
+    // bids above the final price are refunded partially
+    finishIPOs();
+
+    Asset asset{ NULL_ID, assetNameFromString("TESTEXD") };
+    const long long finalPrice = reference.prices[NUMBER_OF_COMPUTORS - 1];
+    for (unsigned int i = 0; i < 7; i++)
+    {
+        long long shares = 0;
+        for (unsigned int j = 0; j < NUMBER_OF_COMPUTORS; j++)
+            if (reference.publicKeys[j] == bidders[i])
+                ++shares;
+        EXPECT_EQ(numberOfShares(asset, { bidders[i], QX_CONTRACT_INDEX }, { bidders[i], QX_CONTRACT_INDEX }), shares);
+        EXPECT_EQ(getBalance(bidders[i]), initialBalance - shares * finalPrice);
+    }
+}
+
 //-------------------------------------------------------------------
 // Test CallbackPostIncomingTransfer
 
@@ -21,9 +21,14 @@
 #include "contract_core/qpi_ipo_impl.h"
 #include "contract_core/qpi_mining_impl.h"
 #include "contract_core/qpi_oracle_impl.h"
+#include "contract_core/contract_state_digest.h"
 
 #include "test_util.h"
 
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
 
 class ContractTesting : public LoggingTest
 {
@@ -35,6 +40,7 @@ public:
         initAVX512FourQConstants();
 #endif
         commonBuffers.init(1);
+        reorgBuffers.init(1, reorgBuffersSize);
         initContractExec();
         initSpecialEntities();
 
@@ -48,6 +54,7 @@ public:
         deinitAssets();
         deinitSpectrum();
         commonBuffers.deinit();
+        reorgBuffers.deinit();
         deinitContractExec();
         for (unsigned int i = 0; i < contractCount; ++i)
         {
@@ -63,6 +70,7 @@ public:
     {
         initSpectrum();
         memset(spectrum, 0, spectrumSizeInBytes);
+        rebuildSpectrumTagsAndBalances();
         updateSpectrumInfo();
     }
 
@@ -81,7 +89,7 @@ public:
         QpiContextUserFunctionCall qpiContext(contractIndex);
         if (checkInputSize)
         {
-            unsigned short expectedInputSize = contractUserFunctionInputSizes[contractIndex][functionInputType];
+            unsigned short expectedInputSize = contractUserFunctions[contractIndex][functionInputType].inputSize;
             EXPECT_EQ((int)expectedInputSize, sizeof(input));
         }
         unsigned int errorCode = qpiContext.call(functionInputType, &input, sizeof(input));
@@ -106,7 +114,7 @@ public:
         EXPECT_NE(contractStates[contractIndex], nullptr);
         if (checkInputSize)
         {
-            unsigned short expectedInputSize = contractUserProcedureInputSizes[contractIndex][procedureInputType];
+            unsigned short expectedInputSize = contractUserProcedures[contractIndex][procedureInputType].inputSize;
             EXPECT_EQ((int)expectedInputSize, sizeof(input));
         }
         setMemory(output, 0);
@@ -194,15 +202,112 @@ static inline void checkContractExecCleanup()
         EXPECT_EQ(contractStateLock[i].getCurrentReaderLockCount(), 0);
     }
 
-    for (unsigned int i = 0; i < NUMBER_OF_CONTRACT_EXECUTION_BUFFERS; ++i)
+    for (unsigned int i = 0; i < contractLocalsStackCount; ++i)
     {
         EXPECT_EQ(contractLocalsStack[i].size(), 0);
-        EXPECT_EQ(contractLocalsStackLock[i], 0);
+        EXPECT_FALSE(isContractLocalsStackInUse(i));
     }
     EXPECT_EQ(contractLocalsStackLockWaitingCount, 0);
+    EXPECT_EQ(contractLocalsStackNextTicket, contractLocalsStackServingTicket);
     EXPECT_EQ(contractCallbacksRunning, NoContractCallback);
 }
 
+// Performance of contract calls measured with benchmarkContractCalls()
+struct ContractCallBenchmark
+{
+    // Number of calls and CPU ticks (TSC) per call
+    unsigned long long calls = 0;
+    unsigned long long totalCycles = 0;
+    unsigned long long minCycles = 0;
+    unsigned long long maxCycles = 0;
+
+    // Maximum number of bytes used in a contract locals stack during the calls (including nested calls)
+    unsigned long long localsStackHighWaterMark = 0;
+
+    // Bytes and K12 chunks (K12_chunkSize) of the contract state that differ after all calls
+    unsigned long long stateBytesChanged = 0;
+    unsigned long long stateChunksChanged = 0;
+    unsigned long long stateChunkCount = 0;
+
+    // If the calls set the contract's bit in contractStateChangeFlags, the state digest is recomputed at the end of the
+    // tick, which costs stateDigestCycles CPU ticks. Like in the node, large states are rehashed incrementally with the
+    // leaf cache filled before the calls, so only changed chunks are hashed again (stateDigestIncremental).
+    bool stateChangeFlagged = false;
+    bool stateDigestIncremental = false;
+    unsigned long long stateDigestCycles = 0;
+
+    void print(const char* name) const
+    {
+        std::cout << name << ": " << calls << " calls, cycles per call avg " << (calls ? totalCycles / calls : 0)
+            << " min " << minCycles << " max " << maxCycles << ", locals stack high-water mark " << localsStackHighWaterMark
+            << " bytes, state changed " << stateBytesChanged << " bytes in " << stateChunksChanged << "/" << stateChunkCount
+            << " chunks, rehash " << (stateChangeFlagged ? stateDigestCycles : 0) << " cycles"
+            << (stateDigestIncremental ? " (incremental)" : "") << std::endl;
+    }
+};
+
+// Run call(i) for i = 0 ... calls - 1, which invokes a procedure or function of contract contractIndex with input
+// generated from i (for example with a helper of the contract's ContractTesting subclass), and measure the cost.
+template <typename CallFunction>
+static ContractCallBenchmark benchmarkContractCalls(unsigned int contractIndex, unsigned int calls, CallFunction call)
+{
+    EXPECT_LT(contractIndex, contractCount);
+    EXPECT_NE(contractStates[contractIndex], nullptr);
+    const unsigned long long stateSize = contractDescriptions[contractIndex].stateSize;
+    const std::vector<unsigned char> stateBefore(contractStates[contractIndex], contractStates[contractIndex] + stateSize);
+    contractStateChangeFlags[contractIndex >> 6] &= ~(1ULL << (contractIndex & 63));
+    for (unsigned int i = 0; i < contractLocalsStackCount; ++i)
+        contractLocalsStack[i].init();
+
+    // digest of the state before the calls fills the leaf cache, as at the end of the previous tick in the node
+    ContractStateLeafCache leafCache;
+    m256i digest;
+    allocateContractStateLeafCache(leafCache, stateSize);
+    computeContractStateDigestWithLeafCache(contractStates[contractIndex], stateSize, leafCache, digest);
+
+    ContractCallBenchmark result;
+    result.calls = calls;
+    result.minCycles = calls ? ~0ULL : 0;
+    for (unsigned int i = 0; i < calls; ++i)
+    {
+        const unsigned long long startTsc = __rdtsc();
+        call(i);
+        const unsigned long long cycles = __rdtsc() - startTsc;
+        result.totalCycles += cycles;
+        result.minCycles = std::min(result.minCycles, cycles);
+        result.maxCycles = std::max(result.maxCycles, cycles);
+    }
+
+    for (unsigned int i = 0; i < contractLocalsStackCount; ++i)
+        result.localsStackHighWaterMark = std::max<unsigned long long>(result.localsStackHighWaterMark, contractLocalsStack[i].maxSizeObserved());
+
+    const unsigned char* state = contractStates[contractIndex];
+    for (unsigned long long chunkBegin = 0; chunkBegin < stateSize; chunkBegin += K12_chunkSize)
+    {
+        const unsigned long long chunkEnd = std::min(chunkBegin + K12_chunkSize, stateSize);
+        unsigned long long changedBytes = 0;
+        for (unsigned long long i = chunkBegin; i < chunkEnd; ++i)
+            changedBytes += (state[i] != stateBefore[i]);
+        result.stateBytesChanged += changedBytes;
+        result.stateChunksChanged += (changedBytes != 0);
+        ++result.stateChunkCount;
+    }
+
+    result.stateChangeFlagged = (contractStateChangeFlags[contractIndex >> 6] >> (contractIndex & 63)) & 1;
+    result.stateDigestIncremental = leafCache.valid;
+    const unsigned long long startTsc = __rdtsc();
+    computeContractStateDigestWithLeafCache(state, stateSize, leafCache, digest);
+    result.stateDigestCycles = __rdtsc() - startTsc;
+    freeContractStateLeafCache(leafCache);
+
+    // incremental digest has to match K12 of the whole state
+    m256i fullDigest;
+    KangarooTwelve(state, (unsigned int)stateSize, &fullDigest, sizeof(fullDigest));
+    EXPECT_TRUE(digest == fullDigest);
+
+    return result;
+}
+
 // Issue contract shares and transfer ownership/possession of all shares to one entity
 static inline void issueContractShares(unsigned int contractIndex, std::vector<std::pair<m256i, unsigned int>>& initialOwnerShares, bool warnOnTooFewShares = true)
 {
@@ -116,6 +116,42 @@ TEST(CustomMining, TaskStorageExistedItem)
     storage.deinit();
 }
 
+TEST(CustomMining, TaskStorageCopyData)
+{
+    constexpr unsigned long long NUMBER_OF_TASKS = 100;
+    CustomMiningTaskV2Storage storage;
+
+    // Storage queried with copyData() only doesn't need processor buffers
+    storage.init(false);
+
+    for (unsigned long long i = 0; i < NUMBER_OF_TASKS; i++)
+    {
+        CustomMiningTaskV2 task;
+        task.taskIndex = (NUMBER_OF_TASKS - i) * 10;
+        storage.addData(&task);
+    }
+
+    CustomMiningTaskV2 tasks[NUMBER_OF_TASKS];
+
+    // Range [from, to) is copied in ascending order
+    EXPECT_EQ(storage.copyData(105, 200, (unsigned char*)tasks, NUMBER_OF_TASKS), 9);
+    for (unsigned long long i = 0; i < 9; i++)
+    {
+        EXPECT_EQ(tasks[i].taskIndex, 110 + i * 10);
+    }
+
+    // No upper bound, limited by max item count
+    EXPECT_EQ(storage.copyData(500, 0, (unsigned char*)tasks, NUMBER_OF_TASKS), 51);
+    EXPECT_EQ(tasks[50].taskIndex, 1000);
+    EXPECT_EQ(storage.copyData(0, 0, (unsigned char*)tasks, 5), 5);
+    EXPECT_EQ(tasks[4].taskIndex, 50);
+
+    // Nothing after the last task
+    EXPECT_EQ(storage.copyData(1001, 0, (unsigned char*)tasks, NUMBER_OF_TASKS), 0);
+
+    storage.deinit();
+}
+
 TEST(CustomMining, TaskStorageOverflow)
 {
     constexpr unsigned long long NUMBER_OF_TASKS = CUSTOM_MINING_TASK_STORAGE_COUNT;
@@ -277,3 +313,109 @@ TEST(CustomMining, SolutionsStorageOverflow)
 
     storage.deinit();
 }
+
+TEST(CustomMining, SolutionCacheBatchVerification)
+{
+    constexpr unsigned int NUMBER_OF_SOLUTIONS = 300;
+    typedef CustomMininingCache<CustomMiningSolutionV2CacheEntry, 4096, 20> Cache;
+    Cache* cache = new Cache();
+    cache->init();
+
+    // Record solutions
+    for (unsigned int i = 0; i < NUMBER_OF_SOLUTIONS; i++)
+    {
+        CustomMiningSolutionV2 solution{};
+        solution.taskIndex = 1 + i / 10;
+        solution.nonce = i;
+        CustomMiningSolutionV2CacheEntry entry;
+        entry.set(&solution);
+
+        unsigned int cacheIndex = 0;
+        EXPECT_EQ(cache->tryFetching(entry, cacheIndex), CUSTOM_MINING_CACHE_MISS);
+        cache->addEntry(entry, cacheIndex);
+        EXPECT_EQ(cache->tryFetching(entry, cacheIndex), CUSTOM_MINING_CACHE_HIT);
+    }
+    EXPECT_EQ(cache->missCount(), NUMBER_OF_SOLUTIONS);
+    EXPECT_EQ(cache->hitCount(), NUMBER_OF_SOLUTIONS);
+
+    // Verify all recorded solutions and some unknown ones in one batch
+    constexpr unsigned int BATCH_SIZE = NUMBER_OF_SOLUTIONS + 20;
+    CustomMiningSolutionV2CacheEntry* entries = new CustomMiningSolutionV2CacheEntry[BATCH_SIZE];
+    bool found[BATCH_SIZE];
+    for (unsigned int i = 0; i < BATCH_SIZE; i++)
+    {
+        CustomMiningSolutionV2 solution{};
+        solution.taskIndex = 1 + i / 10;
+        solution.nonce = (i < NUMBER_OF_SOLUTIONS) ? i : 1000000 + i;
+        entries[i].set(&solution);
+        entries[i].setVerified(true);
+        entries[i].setValid(i % 3 != 0);
+    }
+    EXPECT_EQ(cache->tryFetchingAndUpdateHitData(entries, BATCH_SIZE, found), NUMBER_OF_SOLUTIONS);
+
+    for (unsigned int i = 0; i < BATCH_SIZE; i++)
+    {
+        EXPECT_EQ(found[i], i < NUMBER_OF_SOLUTIONS);
+        if (i < NUMBER_OF_SOLUTIONS)
+        {
+            CustomMiningSolutionV2CacheEntry entry;
+            CustomMiningSolutionV2 solution{};
+            solution.taskIndex = 1 + i / 10;
+            solution.nonce = i;
+            entry.set(&solution);
+            unsigned int cacheIndex = 0;
+            EXPECT_EQ(cache->tryFetching(entry, cacheIndex), CUSTOM_MINING_CACHE_HIT);
+            cache->getEntry(entry, cacheIndex);
+            EXPECT_EQ(entry.getNonce(), i);
+            EXPECT_TRUE(entry.isVerified());
+            EXPECT_EQ(entry.isValid(), i % 3 != 0);
+        }
+    }
+
+    cache->reset();
+    EXPECT_EQ(cache->tryFetchingAndUpdateHitData(entries, BATCH_SIZE, found), 0);
+    EXPECT_EQ(cache->hitCount(), 0);
+
+    delete[] entries;
+    delete cache;
+}
+
+TEST(CustomMining, SolutionCacheContains)
+{
+    typedef CustomMininingCache<CustomMiningSolutionV2CacheEntry, 1024, 20> Cache;
+    Cache* cache = new Cache();
+    cache->init();
+
+    CustomMiningSolutionV2 solution{};
+    solution.taskIndex = 7;
+    solution.nonce = 42;
+    CustomMiningSolutionV2CacheEntry entry;
+    entry.set(&solution);
+
+    // Probing doesn't change the cache or its counters
+    EXPECT_FALSE(cache->contains(entry));
+    EXPECT_EQ(cache->hitCount(), 0);
+    EXPECT_EQ(cache->missCount(), 0);
+
+    unsigned int cacheIndex = 0;
+    EXPECT_EQ(cache->tryFetching(entry, cacheIndex), CUSTOM_MINING_CACHE_MISS);
+    cache->addEntry(entry, cacheIndex);
+    EXPECT_TRUE(cache->contains(entry));
+    EXPECT_EQ(cache->hitCount(), 0);
+    EXPECT_EQ(cache->missCount(), 1);
+
+    // Solutions are identified by task index and nonce only
+    CustomMiningSolutionV2 sameKey = solution;
+    sameKey.computorRandom = 123;
+    sameKey.result.m256i_u64[0] = 1;
+    entry.set(&sameKey);
+    EXPECT_TRUE(cache->contains(entry));
+    sameKey.nonce = 43;
+    entry.set(&sameKey);
+    EXPECT_FALSE(cache->contains(entry));
+
+    cache->addHits(3);
+    EXPECT_EQ(cache->hitCount(), 3);
+
+    delete cache;
+}
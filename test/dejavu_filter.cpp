@@ -0,0 +1,103 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/network_core/dejavu_filter.h"
+
+#include <random>
+#include <vector>
+
+TEST(TestDejavuFilter, DuplicatesWithinTimeWindow)
+{
+    DejavuFilter<1024>* filter = new DejavuFilter<1024>();
+    ASSERT_TRUE(filter->init(30));
+
+    const unsigned long long id = 0x123456789abcdef0ULL;
+    EXPECT_FALSE(filter->contains(id, 100));
+    filter->insert(id, 100);
+    EXPECT_TRUE(filter->contains(id, 100));
+    EXPECT_TRUE(filter->contains(id, 129));
+    EXPECT_FALSE(filter->contains(id, 130));
+    EXPECT_FALSE(filter->contains(id + 1, 100));
+
+    // expired entry is reused, packet is remembered again
+    filter->insert(id, 200);
+    EXPECT_TRUE(filter->contains(id, 229));
+
+    // time wrapping around
+    filter->insert(id + 2, 0xfffffff0);
+    EXPECT_TRUE(filter->contains(id + 2, 5));
+    EXPECT_FALSE(filter->contains(id + 2, 20));
+
+    filter->reset();
+    EXPECT_FALSE(filter->contains(id, 229));
+
+    filter->deinit();
+    delete filter;
+}
+
+TEST(TestDejavuFilter, NoFalseNegativesBelowCapacity)
+{
+    constexpr unsigned long long bucketCount = 4096;
+    constexpr unsigned int packetsPerSecond = 1000;
+    DejavuFilter<bucketCount>* filter = new DejavuFilter<bucketCount>();
+    ASSERT_TRUE(filter->init(10));
+
+    // 10 seconds window at 1000 packets per second fill the filter by 61%, ids of three windows are inserted
+    std::mt19937_64 gen(42);
+    std::vector<unsigned long long> ids;
+    for (unsigned int second = 0; second < 30; ++second)
+    {
+        for (unsigned int i = 0; i < packetsPerSecond; ++i)
+        {
+            const unsigned long long id = gen();
+            ids.push_back(id);
+            filter->insert(id, second);
+        }
+    }
+    EXPECT_EQ(filter->getOverflowCount(), 0);
+
+    // all packets of the last window are found, false positive rate of new packets is tiny
+    for (unsigned long long i = ids.size() - 10 * packetsPerSecond; i < ids.size(); ++i)
+        EXPECT_TRUE(filter->contains(ids[i], 29));
+    unsigned int falsePositives = 0;
+    for (unsigned int i = 0; i < 100000; ++i)
+        falsePositives += filter->contains(gen(), 29);
+    EXPECT_LE(falsePositives, 1);
+
+    filter->deinit();
+    delete filter;
+}
+
+TEST(TestDejavuFilter, OverflowDropsOldEntries)
+{
+    constexpr unsigned long long bucketCount = 64;
+    DejavuFilter<bucketCount>* filter = new DejavuFilter<bucketCount>();
+    ASSERT_TRUE(filter->init(1000));
+
+    // inserting 4 times the capacity drops entries, but the filter stays usable
+    constexpr unsigned int capacity = bucketCount * DejavuFilter<bucketCount>::entriesPerBucket;
+    std::mt19937_64 gen(7);
+    std::vector<unsigned long long> ids;
+    for (unsigned int i = 0; i < 4 * capacity; ++i)
+    {
+        const unsigned long long id = gen();
+        ids.push_back(id);
+        filter->insert(id, 1);
+    }
+    EXPECT_GE(filter->getOverflowCount(), 3 * capacity);
+    unsigned int found = 0;
+    for (unsigned long long id : ids)
+        found += filter->contains(id, 1);
+    EXPECT_LE(found, capacity);
+    EXPECT_GE(found, capacity * 9 / 10);
+
+    // after the window, all entries have expired and new packets fit again
+    for (unsigned int i = 0; i < capacity / 2; ++i)
+        filter->insert(ids[i], 1001);
+    for (unsigned int i = 0; i < capacity / 2; ++i)
+        EXPECT_TRUE(filter->contains(ids[i], 1001));
+
+    filter->deinit();
+    delete filter;
+}
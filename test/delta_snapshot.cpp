@@ -0,0 +1,145 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/delta_snapshot.h"
+
+#include <random>
+#include <set>
+#include <vector>
+
+struct TestRecord
+{
+    unsigned long long values[6];
+};
+
+template <unsigned long long capacity>
+struct DeltaSnapshotTestData
+{
+    std::vector<TestRecord> records;
+    std::vector<m256i> digests;
+    std::vector<unsigned long long> changeFlags;
+    IncrementalMerkleTree<capacity> tree;
+    DeltaSnapshot<capacity, TestRecord> deltaSnapshot;
+    std::vector<unsigned char> deltaBuffer;
+
+    DeltaSnapshotTestData() : records(capacity), digests(capacity * 2 - 1),
+        changeFlags(IncrementalMerkleTree<capacity>::changeFlagWords),
+        deltaBuffer(DeltaSnapshot<capacity, TestRecord>::maxDeltaSizeInBytes)
+    {
+        tree.init(digests.data(), changeFlags.data());
+        EXPECT_TRUE(deltaSnapshot.init());
+    }
+
+    ~DeltaSnapshotTestData()
+    {
+        deltaSnapshot.deinit();
+    }
+
+    void changeRecord(unsigned long long index, std::mt19937_64& gen)
+    {
+        records[index].values[gen() % 6] = gen();
+        tree.markLeafChanged(index);
+    }
+
+    void updateDigests()
+    {
+        for (unsigned long long i = tree.findNextChangedLeaf(0); i < capacity; i = tree.findNextChangedLeaf(i + 1))
+            KangarooTwelve(&records[i], sizeof(TestRecord), &digests[i], 32);
+        tree.updateInnerNodes();
+    }
+
+    // Return block indices contained in delta
+    std::set<unsigned int> deltaBlocks(unsigned long long deltaSize) const
+    {
+        typedef typename DeltaSnapshot<capacity, TestRecord>::DeltaHeader DeltaHeader;
+        const DeltaHeader* header = (const DeltaHeader*)deltaBuffer.data();
+        EXPECT_EQ(deltaSize, deltaSnapshot.deltaSizeInBytes(header->blockCount));
+        const unsigned int* blockIndices = (const unsigned int*)(deltaBuffer.data() + sizeof(DeltaHeader));
+        return std::set<unsigned int>(blockIndices, blockIndices + header->blockCount);
+    }
+};
+
+TEST(TestCoreDeltaSnapshot, BuildAndApplyDelta)
+{
+    constexpr unsigned long long capacity = 4096;
+    typedef DeltaSnapshot<capacity, TestRecord> TestDeltaSnapshot;
+    std::mt19937_64 gen(42);
+    DeltaSnapshotTestData<capacity> test;
+
+    for (auto& record : test.records)
+        for (auto& value : record.values)
+            value = gen();
+    test.tree.markAllLeafsChanged();
+    test.updateDigests();
+
+    // no base yet
+    EXPECT_FALSE(test.deltaSnapshot.hasBase(100));
+
+    // base without changes -> empty delta
+    const std::vector<TestRecord> baseRecords = test.records;
+    test.deltaSnapshot.setBase(test.tree, 100);
+    EXPECT_TRUE(test.deltaSnapshot.hasBase(100));
+    EXPECT_FALSE(test.deltaSnapshot.hasBase(101));
+    unsigned long long deltaSize = test.deltaSnapshot.buildDelta(test.tree, test.records.data(), test.deltaBuffer.data());
+    EXPECT_EQ(deltaSize, TestDeltaSnapshot::deltaSizeInBytes(0));
+    EXPECT_TRUE(test.deltaBlocks(deltaSize).empty());
+
+    // changed and hashed records
+    std::set<unsigned int> expectedBlocks;
+    for (unsigned long long index : { 0ull, 1ull, 63ull, 64ull, 1000ull, 4095ull })
+    {
+        test.changeRecord(index, gen);
+        expectedBlocks.insert((unsigned int)(index / TestDeltaSnapshot::recordsPerBlock));
+    }
+    test.updateDigests();
+
+    // changed records that are not hashed yet
+    test.changeRecord(2000, gen);
+    expectedBlocks.insert(2000 / TestDeltaSnapshot::recordsPerBlock);
+
+    deltaSize = test.deltaSnapshot.buildDelta(test.tree, test.records.data(), test.deltaBuffer.data());
+    EXPECT_EQ(test.deltaBlocks(deltaSize), expectedBlocks);
+
+    // applying delta to base results in current records
+    std::vector<TestRecord> loadedRecords = baseRecords;
+    EXPECT_TRUE(TestDeltaSnapshot::applyDelta(test.deltaBuffer.data(), deltaSize, loadedRecords.data()));
+    EXPECT_EQ(memcmp(loadedRecords.data(), test.records.data(), capacity * sizeof(TestRecord)), 0);
+
+    // invalid deltas are rejected
+    EXPECT_FALSE(TestDeltaSnapshot::applyDelta(test.deltaBuffer.data(), deltaSize - 1, loadedRecords.data()));
+    EXPECT_FALSE(TestDeltaSnapshot::applyDelta(test.deltaBuffer.data(), 4, loadedRecords.data()));
+
+    // marker written before saving a new base is rejected (saving has been interrupted before the real delta is written)
+    std::vector<unsigned char> marker(sizeof(TestDeltaSnapshot::DeltaHeader));
+    const unsigned long long markerSize = TestDeltaSnapshot::buildBaseBeingSavedMarker(marker.data());
+    EXPECT_EQ(markerSize, sizeof(TestDeltaSnapshot::DeltaHeader));
+    EXPECT_FALSE(TestDeltaSnapshot::applyDelta(marker.data(), markerSize, loadedRecords.data()));
+    EXPECT_EQ(memcmp(loadedRecords.data(), test.records.data(), capacity * sizeof(TestRecord)), 0);
+
+    // reverting change to base content removes block from delta
+    test.records[4095] = baseRecords[4095];
+    test.tree.markLeafChanged(4095);
+    test.updateDigests();
+    expectedBlocks.erase(4095 / TestDeltaSnapshot::recordsPerBlock);
+    deltaSize = test.deltaSnapshot.buildDelta(test.tree, test.records.data(), test.deltaBuffer.data());
+    EXPECT_EQ(test.deltaBlocks(deltaSize), expectedBlocks);
+
+    // too many changed blocks -> new base needed
+    for (unsigned long long index = 0; index < capacity; index += TestDeltaSnapshot::recordsPerBlock)
+        test.changeRecord(index, gen);
+    test.updateDigests();
+    EXPECT_EQ(test.deltaSnapshot.buildDelta(test.tree, test.records.data(), test.deltaBuffer.data()), 0);
+
+    // block with records that are not hashed at time of base is always part of delta (base content unknown)
+    test.changeRecord(10, gen);
+    const TestRecord recordInBase = test.records[10];
+    test.deltaSnapshot.setBase(test.tree, 101);
+    test.updateDigests();
+    test.records[10] = recordInBase;
+    deltaSize = test.deltaSnapshot.buildDelta(test.tree, test.records.data(), test.deltaBuffer.data());
+    EXPECT_EQ(test.deltaBlocks(deltaSize), std::set<unsigned int>({ 0 }));
+
+    test.deltaSnapshot.reset();
+    EXPECT_FALSE(test.deltaSnapshot.hasBase(101));
+}
@@ -254,6 +254,33 @@ TEST(ExecutionFeeReportCollector, MultipleComputorsReporting) {
     EXPECT_EQ(reports2[10], 0);
 }
 
+TEST(ExecutionFeeReportCollector, QuorumValuePreview) {
+    ExecutionFeeReportCollector collector;
+    collector.init();
+
+    // no reports -> no fee
+    EXPECT_EQ(collector.getQuorumValue(1), 0);
+
+    // less than 1/3 of the computors report -> quorum value is 0 (missing reports count as 0)
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS / 3; i++)
+        collector.storeReport(1, i, 1000 + i);
+    EXPECT_EQ(collector.getQuorumValue(1), 0);
+
+    // all computors report -> value at index (676 * 2) / 3 = 450 of sorted reports
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        collector.storeReport(1, i, 1000 + i);
+    EXPECT_EQ(collector.getQuorumValue(1), 1450);
+
+    // preview doesn't change reports
+    const unsigned long long* reports = collector.getReportsForContract(1);
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        EXPECT_EQ(reports[i], 1000 + i);
+
+    // invalid contract indices
+    EXPECT_EQ(collector.getQuorumValue(0), 0);
+    EXPECT_EQ(collector.getQuorumValue(contractCount), 0);
+}
+
 TEST(ExecutionFeeReportBuilder, BuildAndParseEvenEntries) {
     ExecutionFeeReportPayload payload;
     unsigned long long contractTimes[contractCount] = {0};
@@ -8,8 +8,10 @@
 #include <mutex>
 #include <fstream>
 #include <chrono>
+#include <atomic>
 
 #include "../src/platform/file_io.h"
+#include "../src/platform/sparse_file_io.h"
 
 static constexpr unsigned long long THREAD_COUNT = 4;
 static constexpr unsigned long long MEM_BUFFER_SIZE = 52ULL * 1024ULL * 1024ULL;
@@ -502,6 +504,244 @@ TEST(TestAsyncFileIO, AsyncNonBlockingSaveLargeFileWithLimitItems)
 }
 
 
+TEST(TestAsyncFileIO, WriteBehindQueueOrderAndBackpressure)
+{
+    constexpr unsigned long long bufferSize = 1024;
+    std::vector<unsigned char> ringBuffer(bufferSize);
+    WriteBehindQueue<4> queue;
+    queue.initializeQueue(ringBuffer.data(), bufferSize);
+    EXPECT_TRUE(queue.isEmpty());
+
+    // Later save of the same file wins, because items are written in order
+    std::vector<unsigned char> data0(400, 1), data1(400, 2), data2(400, 3);
+    EXPECT_TRUE(queue.enqueue(L"tmp_write_behind", data0.size(), data0.data(), NULL));
+    EXPECT_TRUE(queue.enqueue(L"tmp_write_behind", data1.size(), data1.data(), NULL));
+
+    // Data is copied, so the caller can reuse its buffer
+    data1.assign(data1.size(), 4);
+
+    // No space left in ring buffer -> caller has to fall back to blocking save
+    EXPECT_FALSE(queue.enqueue(L"tmp_write_behind_2", data2.size(), data2.data(), NULL));
+    EXPECT_FALSE(queue.enqueue(L"tmp_write_behind_2", bufferSize + 1, data2.data(), NULL));
+
+    EXPECT_EQ(queue.flushWrite(1), 1);
+    EXPECT_FALSE(queue.isEmpty());
+
+    // Space of first item is free again (wraps around end of ring buffer)
+    EXPECT_TRUE(queue.enqueue(L"tmp_write_behind_2", data2.size(), data2.data(), NULL));
+    EXPECT_EQ(queue.flushWrite(), 0);
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(queue.getFailedWriteCount(), 0);
+
+    std::vector<unsigned char> loaded(400);
+    EXPECT_EQ(loadFile(L"tmp_write_behind", loaded.size(), (char*)loaded.data()), (long long)loaded.size());
+    EXPECT_EQ(loaded, std::vector<unsigned char>(400, 2));
+    EXPECT_EQ(loadFile(L"tmp_write_behind_2", loaded.size(), (char*)loaded.data()), (long long)loaded.size());
+    EXPECT_EQ(loaded, data2);
+
+    // Limited number of items
+    for (int i = 0; i < 4; i++)
+    {
+        EXPECT_TRUE(queue.enqueue(L"tmp_write_behind", 10, data0.data(), NULL));
+    }
+    EXPECT_FALSE(queue.enqueue(L"tmp_write_behind", 10, data0.data(), NULL));
+    EXPECT_EQ(queue.flushWrite(), 0);
+}
+
+TEST(TestAsyncFileIO, BackgroundRemoveQueue)
+{
+    FileSystemWrapper fs;
+    EXPECT_EQ(gAsyncFileIO->getBackgroundRemoveQueueCount(), 0);
+
+    // removals are queued without waiting
+    constexpr int count = 2 * ASYNC_FILE_IO_BACKGROUND_REMOVES_PER_FLUSH + 3;
+    for (int i = 0; i < count; i++)
+    {
+        EXPECT_EQ(asyncRemoveFileInBackground(L"tmp_background_remove", (i & 1) ? L"tmp_dir" : NULL), 0);
+    }
+    EXPECT_EQ(gAsyncFileIO->getBackgroundRemoveQueueCount(), count);
+
+    // names that don't fit into queue item are rejected
+    CHAR16 longName[ASYNC_FILE_IO_MAX_FILE_NAME + 1];
+    for (int i = 0; i < ASYNC_FILE_IO_MAX_FILE_NAME; i++)
+    {
+        longName[i] = L'a';
+    }
+    longName[ASYNC_FILE_IO_MAX_FILE_NAME] = 0;
+    EXPECT_EQ(asyncRemoveFileInBackground(longName), -1);
+
+    // each flush removes a limited number of files
+    flushAsyncFileIOBuffer();
+    EXPECT_EQ(gAsyncFileIO->getBackgroundRemoveQueueCount(), count - ASYNC_FILE_IO_BACKGROUND_REMOVES_PER_FLUSH);
+    flushAsyncFileIOBuffer();
+    flushAsyncFileIOBuffer();
+    EXPECT_EQ(gAsyncFileIO->getBackgroundRemoveQueueCount(), 0);
+}
+
+static void recordLoadedPart(void* context, unsigned long long begin, unsigned long long end)
+{
+    std::vector<std::pair<unsigned long long, unsigned long long>>* parts = (std::vector<std::pair<unsigned long long, unsigned long long>>*)context;
+    parts->emplace_back(begin, end);
+}
+
+TEST(TestAsyncFileIO, LoadAndProcess)
+{
+    std::vector<unsigned char> data(1000), loaded(1000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 7);
+    EXPECT_EQ(save(L"tmp_load_and_process", data.size(), data.data()), (long long)data.size());
+
+    // Parts are processed in order, the last one may be smaller
+    std::vector<std::pair<unsigned long long, unsigned long long>> parts;
+    EXPECT_EQ(loadAndProcess(L"tmp_load_and_process", loaded.size(), loaded.data(), NULL, recordLoadedPart, &parts, 300), (long long)loaded.size());
+    EXPECT_EQ(loaded, data);
+    std::vector<std::pair<unsigned long long, unsigned long long>> expected = { {0, 300}, {300, 600}, {600, 900}, {900, 1000} };
+    EXPECT_EQ(parts, expected);
+
+    // Without function, same as load()
+    setMem(loaded.data(), loaded.size(), 0);
+    EXPECT_EQ(loadAndProcess(L"tmp_load_and_process", loaded.size(), loaded.data(), NULL, NULL, NULL, 300), (long long)loaded.size());
+    EXPECT_EQ(loaded, data);
+
+    // Reading more than the file size fails
+    parts.clear();
+    std::vector<unsigned char> tooLarge(2000);
+    EXPECT_LT(loadAndProcess(L"tmp_load_and_process", tooLarge.size(), tooLarge.data(), NULL, recordLoadedPart, &parts, 300), 0);
+
+    // ... except if shorter files are allowed
+    parts.clear();
+    EXPECT_EQ(loadAndProcess(L"tmp_load_and_process", tooLarge.size(), tooLarge.data(), NULL, recordLoadedPart, &parts, 300, true), (long long)data.size());
+    EXPECT_EQ(parts, expected);
+    EXPECT_EQ(memcmp(tooLarge.data(), data.data(), data.size()), 0);
+    EXPECT_EQ(loadUpTo(L"tmp_load_and_process", tooLarge.size(), tooLarge.data()), (long long)data.size());
+    EXPECT_EQ(loadUpTo(L"tmp_load_and_process", 500, tooLarge.data()), 500);
+}
+
+TEST(TestAsyncFileIO, SparseSaveAndLoad)
+{
+    // last page is partial, non-zero pages are at start, end, and in runs
+    std::vector<unsigned char> data(100 * sparseFilePageSize + 100), loaded(data.size());
+    const unsigned long long nonZeroPages[] = { 0, 7, 8, 9, 50, 98, 100 };
+    for (unsigned long long page : nonZeroPages)
+        data[page * sparseFilePageSize + page % 60] = (unsigned char)(page + 1);
+    const long long sparseSize = saveSparse(L"tmp_sparse", data.size(), data.data());
+    EXPECT_GT(sparseSize, 0);
+    EXPECT_LT(sparseSize, (long long)data.size());
+    memset(loaded.data(), 0xff, loaded.size());
+    EXPECT_EQ(loadSparse(L"tmp_sparse", loaded.size(), loaded.data()), (long long)loaded.size());
+    EXPECT_EQ(loaded, data);
+
+    // all zero
+    std::vector<unsigned char> zero(data.size());
+    EXPECT_GT(saveSparse(L"tmp_sparse", zero.size(), zero.data()), 0);
+    memset(loaded.data(), 0xff, loaded.size());
+    EXPECT_EQ(loadSparse(L"tmp_sparse", loaded.size(), loaded.data()), (long long)loaded.size());
+    EXPECT_EQ(loaded, zero);
+
+    // dense data is saved in plain format, which can be read with load() and loadSparse()
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 7 + 1);
+    EXPECT_EQ(saveSparse(L"tmp_sparse", data.size(), data.data()), (long long)data.size());
+    EXPECT_EQ(loadSparse(L"tmp_sparse", loaded.size(), loaded.data()), (long long)loaded.size());
+    EXPECT_EQ(loaded, data);
+
+    // a truncated plain file isn't valid
+    EXPECT_EQ(save(L"tmp_sparse", data.size() / 2, data.data()), (long long)data.size() / 2);
+    EXPECT_EQ(loadSparse(L"tmp_sparse", loaded.size(), loaded.data()), (long long)data.size() / 2);
+}
+
+TEST(TestAsyncFileIO, ZeroRunSaveAndLoad)
+{
+    // small records scattered over the buffer (every page non-zero), size not a multiple of 8, non-zero last byte
+    std::vector<unsigned char> data(100 * sparseFilePageSize + 5), loaded(data.size()), scratch(data.size());
+    for (size_t i = 0; i < data.size(); i += 1000)
+        data[i] = (unsigned char)(i / 1000 + 1);
+    data[8] = data[23] = 1;
+    data.back() = 0xff;
+    const long long encodedSize = saveZeroRunEncoded(L"tmp_zero_run", data.size(), data.data(), scratch.data());
+    EXPECT_GT(encodedSize, 0);
+    EXPECT_LT(encodedSize, (long long)data.size() / 10);
+    memset(loaded.data(), 0xff, loaded.size());
+    long long loadedSize = loadUpTo(L"tmp_zero_run", loaded.size(), loaded.data());
+    EXPECT_EQ(loadedSize, encodedSize);
+    EXPECT_EQ(expandZeroRunEncoded(loaded.size(), loaded.data(), loadedSize, scratch.data()), (long long)loaded.size());
+    EXPECT_EQ(loaded, data);
+
+    // all zero
+    std::vector<unsigned char> zero(data.size());
+    EXPECT_GT(saveZeroRunEncoded(L"tmp_zero_run", zero.size(), zero.data(), scratch.data()), 0);
+    memset(loaded.data(), 0xff, loaded.size());
+    loadedSize = loadUpTo(L"tmp_zero_run", loaded.size(), loaded.data());
+    EXPECT_EQ(expandZeroRunEncoded(loaded.size(), loaded.data(), loadedSize, scratch.data()), (long long)loaded.size());
+    EXPECT_EQ(loaded, zero);
+
+    // corrupted token is detected
+    EXPECT_GT(saveZeroRunEncoded(L"tmp_zero_run", data.size(), data.data(), scratch.data()), 0);
+    loadedSize = loadUpTo(L"tmp_zero_run", loaded.size(), loaded.data());
+    ((ZeroRunToken*)loaded.data())->literalSize = (unsigned int)loaded.size();
+    EXPECT_EQ(expandZeroRunEncoded(loaded.size(), loaded.data(), loadedSize, scratch.data()), -1);
+
+    // dense data is saved in plain format
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 7 + 1);
+    EXPECT_EQ(saveZeroRunEncoded(L"tmp_zero_run", data.size(), data.data(), scratch.data()), (long long)data.size());
+    loadedSize = loadUpTo(L"tmp_zero_run", loaded.size(), loaded.data());
+    EXPECT_EQ(expandZeroRunEncoded(loaded.size(), loaded.data(), loadedSize, scratch.data()), (long long)loaded.size());
+    EXPECT_EQ(loaded, data);
+
+    // files in sparse format aren't changed by expandZeroRunEncoded()
+    memset(data.data(), 0, data.size());
+    data[5 * sparseFilePageSize] = 1;
+    const long long sparseSize = saveSparse(L"tmp_zero_run", data.size(), data.data());
+    loadedSize = loadUpTo(L"tmp_zero_run", loaded.size(), loaded.data());
+    EXPECT_EQ(expandZeroRunEncoded(loaded.size(), loaded.data(), loadedSize, scratch.data()), sparseSize);
+    EXPECT_EQ(expandSparse(loaded.size(), loaded.data(), sparseSize), (long long)loaded.size());
+    EXPECT_EQ(loaded, data);
+}
+
+TEST(TestAsyncFileIO, AsyncNonBlockingLoad)
+{
+    std::vector<unsigned char> data(1000), loaded(1000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 3);
+    EXPECT_EQ(save(L"tmp_non_blocking_load", data.size(), data.data()), (long long)data.size());
+
+    // Load is pending until processed by flush in main thread
+    volatile long long result = 0;
+    EXPECT_TRUE(asyncLoadNonBlocking(L"tmp_non_blocking_load", loaded.size(), loaded.data(), NULL, &result));
+    EXPECT_EQ(result, AsyncFileIO::kPending);
+    flushAsyncFileIOBuffer();
+    EXPECT_EQ(result, (long long)data.size());
+    EXPECT_EQ(loaded, data);
+
+    // Waiting in other thread while main thread flushes
+    setMem(loaded.data(), loaded.size(), 0);
+    EXPECT_TRUE(asyncLoadNonBlocking(L"tmp_non_blocking_load", loaded.size(), loaded.data(), NULL, &result));
+    std::thread waitingThread([&result]() { waitForAsyncLoad(&result); });
+    while (result == AsyncFileIO::kPending)
+        flushAsyncFileIOBuffer();
+    waitingThread.join();
+    EXPECT_EQ(result, (long long)data.size());
+    EXPECT_EQ(loaded, data);
+
+    // Blocking load (processed by flushing in other thread) returns result of load, so shorter files are returned
+    // with their size if allowed
+    std::vector<unsigned char> larger(2000);
+    std::atomic<bool> loadsDone = false;
+    std::thread flushingThread([&loadsDone]() { while (!loadsDone) flushAsyncFileIOBuffer(); });
+    EXPECT_LT(asyncLoad(L"tmp_non_blocking_load", larger.size(), larger.data()), 0);
+    EXPECT_EQ(asyncLoad(L"tmp_non_blocking_load", larger.size(), larger.data(), NULL, true), (long long)data.size());
+    loadsDone = true;
+    flushingThread.join();
+    EXPECT_EQ(memcmp(larger.data(), data.data(), data.size()), 0);
+
+    // Failed load reports error
+    EXPECT_TRUE(asyncLoadNonBlocking(L"tmp_non_blocking_load_missing", loaded.size(), loaded.data(), NULL, &result));
+    flushAsyncFileIOBuffer();
+    EXPECT_LT(result, 0);
+    EXPECT_NE(result, AsyncFileIO::kPending);
+}
+
 TEST(TestAsyncFileIO, AsyncSaveFile)
 {
     EXPECT_EQ(runTestAsyncSaveFile(true, false, false), THREAD_COUNT);
@@ -184,6 +184,30 @@ TEST(TestFourQ, TestGenerateKeys)
     }
 }
 
+TEST(TestFourQ, TestGetIdentities)
+{
+    // number of keys not divisible by number of K12 lanes to test remainder
+    constexpr unsigned int count = 3 * K12_64TO32_LANES + 1;
+    m256i publicKeys[count];
+    for (unsigned int i = 0; i < count; i++)
+        publicKeys[i].setRandomValue();
+
+    CHAR16 identities[count * 61];
+    for (int isLowerCase = 0; isLowerCase < 2; isLowerCase++)
+    {
+        getIdentities(publicKeys, identities, count, isLowerCase);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            CHAR16 expectedIdentity[61];
+            getIdentity(publicKeys[i].m256i_u8, expectedIdentity, isLowerCase);
+            for (unsigned int k = 0; k < 61; k++)
+            {
+                EXPECT_EQ(expectedIdentity[k], identities[i * 61 + k]) << " at [" << i << "][" << k << "]";
+            }
+        }
+    }
+}
+
 // sign(const unsigned char* subseed, const unsigned char* publicKey, const unsigned char* messageDigest, unsigned char* signature)
 TEST(TestFourQ, TestSign)
 {
@@ -262,3 +286,76 @@ TEST(TestFourQ, TestSign)
         }
     }
 }
+
+TEST(TestFourQ, TestVerifyWithKey)
+{
+#ifdef __AVX512F__
+    initAVX512FourQConstants();
+#endif
+
+    const m256i subseed = test_utils::hexTo32Bytes("4ac19e2bf0d3776519aabe31924f7dc2589b3d0e7411a65f84c9b16df72c038e", 32);
+    unsigned char publicKey[32];
+    unsigned char privateKey[32];
+    getPrivateKey((unsigned char*)subseed.m256i_u8, privateKey);
+    getPublicKey(privateKey, publicKey);
+
+    point_double_precomp_t verificationKey;
+    EXPECT_TRUE(getVerificationKey(publicKey, verificationKey));
+
+    // one verification key is used for several messages
+    for (unsigned int i = 0; i < 10; ++i)
+    {
+        m256i messageDigest(i, 2 * i, 3 * i, 4 * i);
+        unsigned char signature[64];
+        sign(subseed.m256i_u8, publicKey, messageDigest.m256i_u8, signature);
+        EXPECT_TRUE(verifyWithKey(publicKey, verificationKey, messageDigest.m256i_u8, signature));
+        EXPECT_TRUE(verify(publicKey, messageDigest.m256i_u8, signature));
+
+        // modified message or signature is rejected
+        messageDigest.m256i_u8[0] ^= 1;
+        EXPECT_FALSE(verifyWithKey(publicKey, verificationKey, messageDigest.m256i_u8, signature));
+        EXPECT_FALSE(verify(publicKey, messageDigest.m256i_u8, signature));
+        messageDigest.m256i_u8[0] ^= 1;
+        signature[40] ^= 1;
+        EXPECT_FALSE(verifyWithKey(publicKey, verificationKey, messageDigest.m256i_u8, signature));
+        EXPECT_FALSE(verify(publicKey, messageDigest.m256i_u8, signature));
+    }
+
+    // invalid public key encoding
+    publicKey[15] |= 0x80;
+    EXPECT_FALSE(getVerificationKey(publicKey, verificationKey));
+}
+
+TEST(TestFourQ, TestSignWithSigningKeyAndRandomK)
+{
+#ifdef __AVX512F__
+    initAVX512FourQConstants();
+#endif
+
+    const m256i subseed = test_utils::hexTo32Bytes("9d3f27a1c84be0567f12ad93e6c05b4871a2fe3d96c8047b5e21d9aa0f63b7c4", 32);
+    unsigned char publicKey[32];
+    unsigned char privateKey[32];
+    unsigned char signingKey[32];
+    getPrivateKey((unsigned char*)subseed.m256i_u8, privateKey);
+    getPublicKey(privateKey, publicKey);
+    getSigningKey(privateKey, signingKey);
+
+    for (unsigned int i = 0; i < 10; ++i)
+    {
+        m256i messageDigest(5 * i, 6 * i, 7 * i, 8 * i);
+        unsigned char signature[64];
+
+        // signatures with precomputed signing key and with subseed are valid
+        signWithSigningKeyAndRandomK(signingKey, publicKey, messageDigest.m256i_u8, signature);
+        EXPECT_TRUE(verify(publicKey, messageDigest.m256i_u8, signature));
+        signWithRandomK(subseed.m256i_u8, publicKey, messageDigest.m256i_u8, signature);
+        EXPECT_TRUE(verify(publicKey, messageDigest.m256i_u8, signature));
+
+        // nonces are drawn until signature score is low enough
+        const unsigned int maxSignatureScore = 0x0fffffff;
+        signWithSigningKeyAndRandomK(signingKey, publicKey, messageDigest.m256i_u8, signature, maxSignatureScore);
+        const unsigned int signatureScore = ((unsigned int)signature[0] << 24) | ((unsigned int)signature[1] << 16) | ((unsigned int)signature[2] << 8) | signature[3];
+        EXPECT_LE(signatureScore, maxSignatureScore);
+        EXPECT_TRUE(verify(publicKey, messageDigest.m256i_u8, signature));
+    }
+}
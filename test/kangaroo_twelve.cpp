@@ -8,6 +8,7 @@
 
 #include <chrono>
 #include <iostream>
+#include <vector>
 
 
 TEST(TestCoreK12, PerformanceDigest32Of1GB)
@@ -90,3 +91,133 @@ TEST(TestCoreK12, CompareK12Implementations)
     ASSERT_EQ(memcmp(outputArrayXKCP, outputArray, outputN), 0);
     delete [] inputPtr;
 }
+
+TEST(TestCoreK12, Compare64To32BatchWithSingle)
+{
+    // count not divisible by number of lanes to also test remainder handling
+    constexpr size_t count = 10 * K12_64TO32_LANES + 3;
+    std::vector<unsigned char> input(count * 64);
+    for (size_t i = 0; i < input.size(); i += 4)
+    {
+        unsigned int val;
+        _rdrand32_step(&val);
+        memcpy(&input[i], &val, 4);
+    }
+
+    std::vector<unsigned char> expected(count * 32), batchOutput(count * 32), batcherOutput(count * 32);
+    for (size_t i = 0; i < count; ++i)
+        KangarooTwelve64To32(&input[i * 64], &expected[i * 32]);
+
+    KangarooTwelve64To32Batch(input.data(), batchOutput.data(), count);
+    EXPECT_EQ(memcmp(expected.data(), batchOutput.data(), expected.size()), 0);
+
+    // batcher with arbitrary order of addresses
+    KangarooTwelve64To32Batcher batcher;
+    for (size_t i = count; i-- > 0; )
+        batcher.add(&input[i * 64], &batcherOutput[i * 32]);
+    batcher.flush();
+    EXPECT_EQ(memcmp(expected.data(), batcherOutput.data(), expected.size()), 0);
+}
+
+TEST(TestCoreK12, CompareShortLanesWithSingle)
+{
+    // all supported input lengths (including 0), count not divisible by number of lanes
+    constexpr unsigned int count = K12_SHORT_MAX_INPUT_SIZE + 1;
+    std::vector<unsigned char> input(count * K12_SHORT_MAX_INPUT_SIZE);
+    for (size_t i = 0; i < input.size(); i += 2)
+    {
+        unsigned short val;
+        _rdrand16_step(&val);
+        memcpy(&input[i], &val, 2);
+    }
+
+    std::vector<unsigned long long> expected(count), batcherOutput8(count);
+    std::vector<unsigned char> expected32(count * 32), batcherOutput32(count * 32);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        KangarooTwelve(&input[i * K12_SHORT_MAX_INPUT_SIZE], i, &expected[i], 8);
+        KangarooTwelve(&input[i * K12_SHORT_MAX_INPUT_SIZE], i, &expected32[i * 32], 32);
+    }
+
+    KangarooTwelveShortBatcher<8> batcher8;
+    KangarooTwelveShortBatcher<32> batcher32;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        batcher8.add(&input[i * K12_SHORT_MAX_INPUT_SIZE], i, &batcherOutput8[i]);
+        batcher32.add(&input[i * K12_SHORT_MAX_INPUT_SIZE], i, &batcherOutput32[i * 32]);
+    }
+    batcher8.flush();
+    batcher32.flush();
+    for (unsigned int i = 0; i < count; ++i)
+        EXPECT_EQ(expected[i], batcherOutput8[i]) << "input length " << i;
+    EXPECT_EQ(memcmp(expected32.data(), batcherOutput32.data(), expected32.size()), 0);
+}
+
+TEST(TestCoreK12, CompareWithPrecomputedLeafs)
+{
+    // sizes around chunk boundaries (the final node also absorbs the trailing encoding of the empty customization string)
+    const unsigned int sizes[] = { 1, 8191, 8192, 8193, 2 * 8192 - 1, 2 * 8192, 2 * 8192 + 1, 3 * 8192, 5 * 8192 + 100, 100 * 8192, 100 * 8192 + 8191 };
+    std::vector<unsigned char> input(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+    for (size_t i = 0; i + 4 <= input.size(); i += 4)
+    {
+        unsigned int val;
+        _rdrand32_step(&val);
+        memcpy(&input[i], &val, 4);
+    }
+
+    for (unsigned int size : sizes)
+    {
+        const unsigned int leafCount = KangarooTwelveFullLeafCount(size);
+        std::vector<unsigned char> leafChainingValues(leafCount * 32 + 1);
+        for (unsigned int i = 0; i < leafCount; ++i)
+            KangarooTwelveLeaf(&input[(i + 1) * 8192], &leafChainingValues[i * 32]);
+
+        unsigned char expected[32], output[32];
+        KangarooTwelve(input.data(), size, expected, 32);
+        KangarooTwelve(input.data(), size, output, 32, leafChainingValues.data());
+        EXPECT_EQ(memcmp(expected, output, 32), 0) << "size " << size;
+    }
+}
+
+TEST(TestCoreK12, CompareLeafLanesWithSingle)
+{
+    constexpr unsigned int leafCount = 4 * K12_64TO32_LANES + 3;
+    std::vector<unsigned char> input(leafCount * K12_chunkSize);
+    for (size_t i = 0; i + 4 <= input.size(); i += 4)
+    {
+        unsigned int val;
+        _rdrand32_step(&val);
+        memcpy(&input[i], &val, 4);
+    }
+
+    std::vector<unsigned char> expected(leafCount * K12_capacityInBytes);
+    for (unsigned int i = 0; i < leafCount; ++i)
+        KangarooTwelveLeaf(&input[i * K12_chunkSize], &expected[i * K12_capacityInBytes]);
+
+    // batcher with number of leafs that isn't a multiple of the lanes, added in reverse order
+    std::vector<unsigned char> output(leafCount * K12_capacityInBytes);
+    KangarooTwelveLeafBatcher batcher;
+    for (unsigned int i = leafCount; i-- > 0; )
+        batcher.add(&input[i * K12_chunkSize], &output[i * K12_capacityInBytes]);
+    batcher.flush();
+    EXPECT_EQ(memcmp(expected.data(), output.data(), expected.size()), 0);
+
+    // performance of single vs multi-lane leaf hashing
+    constexpr unsigned int repN = 64;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (unsigned int rep = 0; rep < repN; ++rep)
+        for (unsigned int i = 0; i < leafCount; ++i)
+            KangarooTwelveLeaf(&input[i * K12_chunkSize], &expected[i * K12_capacityInBytes]);
+    auto singleMicroSec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime);
+    startTime = std::chrono::high_resolution_clock::now();
+    for (unsigned int rep = 0; rep < repN; ++rep)
+    {
+        for (unsigned int i = 0; i < leafCount; ++i)
+            batcher.add(&input[i * K12_chunkSize], &output[i * K12_capacityInBytes]);
+        batcher.flush();
+    }
+    auto lanesMicroSec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime);
+    std::cout << repN * leafCount << " K12 leafs: single " << singleMicroSec.count() << " us, "
+        << K12_64TO32_LANES << " lanes " << lanesMicroSec.count() << " us" << std::endl;
+    EXPECT_EQ(memcmp(expected.data(), output.data(), expected.size()), 0);
+}
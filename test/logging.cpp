@@ -0,0 +1,275 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// log contract messages in addition to the spectrum events enabled in logging_test.h
+#include "private_settings.h"
+#undef LOG_CONTRACT_INFO_MESSAGES
+#define LOG_CONTRACT_INFO_MESSAGES 1
+
+#include "logging_test.h"
+#include "platform/time_stamp_counter.h"
+
+// Benchmark of the logging pipeline, disabled by default because it takes a few minutes. Run it with
+//   --gtest_also_run_disabled_tests --gtest_filter=TestCoreLogging.DISABLED_Benchmark
+// It replays synthetic ticks with transfers and contract messages through qLogger while request processor threads
+// read events, and appends to VirtualMemory instances with different page sizes for the log buffer
+// (LOG_BUFFER_PAGE_SIZE), log ID map (PMAP_LOG_PAGE_SIZE), and tx map (IMAP_LOG_PAGE_SIZE) with concurrent readers.
+// Results are written to LOGGING_BENCHMARK_RESULT_FILE_NAME as CSV. Lock wait times are measured with
+// BusyWaitingTracker, so they are only available in builds without NDEBUG.
+static const std::string LOGGING_BENCHMARK_RESULT_FILE_NAME = "logging_benchmark.csv";
+static constexpr unsigned int LOGGING_BENCHMARK_READERS = 4;
+
+struct BenchmarkContractMessage
+{
+    unsigned int _contractIndex;
+    unsigned int _type;
+    m256i invocator;
+    long long amount;
+    long long values[4];
+
+    char _terminator;
+};
+
+struct LoggingBenchmarkResult
+{
+    std::string benchmark;
+    unsigned long long pageCapacity;
+    unsigned long long appendedItems;
+    double appendSeconds;
+    double digestSeconds;
+    unsigned long long pageWrites;
+    unsigned long long readItems;
+    long long lockWaitCount;
+    double lockWaitMilliseconds;
+
+    double appendsPerSecond() const
+    {
+        return appendedItems / appendSeconds;
+    }
+};
+
+// Measure lock waits of all BusyWaitingTrackers between construction and stop()
+struct LockWaitMeasurement
+{
+    long long startCount = 0, startTicks = 0;
+
+    LockWaitMeasurement()
+    {
+#ifndef NDEBUG
+        startCount = BusyWaitingTracker::totalWaitCount;
+        startTicks = BusyWaitingTracker::totalWaitTicks;
+#endif
+    }
+
+    void stop(LoggingBenchmarkResult& result) const
+    {
+#ifndef NDEBUG
+        result.lockWaitCount = BusyWaitingTracker::totalWaitCount - startCount;
+        result.lockWaitMilliseconds = double(BusyWaitingTracker::totalWaitTicks - startTicks) * 1000.0 / frequency;
+#else
+        result.lockWaitCount = -1;
+        result.lockWaitMilliseconds = -1.0;
+#endif
+    }
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Replay numberOfTicks ticks, each with transfersPerTick transactions logging a QU transfer and END_TICK logging
+// contractMessagesPerTick contract messages, while reader threads fetch random events that have been flushed.
+static void benchmarkTickReplay(unsigned int numberOfTicks, unsigned int transfersPerTick, unsigned int contractMessagesPerTick,
+    std::vector<LoggingBenchmarkResult>& results)
+{
+    const unsigned int tickBegin = 20000000;
+    logger.reset(tickBegin);
+
+    std::atomic<unsigned long long> flushedEvents(0);
+    std::atomic<unsigned long long> readEvents(0);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> readers;
+    for (unsigned int r = 0; r < LOGGING_BENCHMARK_READERS; ++r)
+    {
+        readers.emplace_back([&, r]()
+            {
+                std::mt19937_64 rnd(r);
+                std::vector<char> buffer(LOG_HEADER_SIZE + sizeof(BenchmarkContractMessage));
+                while (!stop)
+                {
+                    const unsigned long long n = flushedEvents;
+                    if (!n)
+                        continue;
+                    qLogger::BlobInfo bi = logger.logBuf.getBlobInfo(rnd() % n);
+                    if (bi.length > 0 && bi.length <= (long long)buffer.size())
+                        logger.logBuf.getMany(buffer.data(), bi.startIndex, bi.length);
+                    ++readEvents;
+                }
+            });
+    }
+
+    LoggingBenchmarkResult result{ "tick_replay", LOG_BUFFER_PAGE_SIZE };
+    std::mt19937_64 rnd(42);
+    double updateTickSeconds = 0.0;
+    LockWaitMeasurement lockWait;
+    const auto begin = std::chrono::steady_clock::now();
+    for (unsigned int tick = tickBegin; tick < tickBegin + numberOfTicks; ++tick)
+    {
+        for (unsigned int i = 0; i < transfersPerTick; ++i)
+        {
+            logger.registerNewTx(tick, i);
+            const QuTransfer transfer{ m256i(rnd(), rnd(), rnd(), rnd()), m256i(rnd(), rnd(), rnd(), rnd()), (long long)(rnd() % 1000000) };
+            logger.logQuTransfer(transfer);
+        }
+        logger.registerNewTx(tick, logger.SC_END_TICK_TX);
+        for (unsigned int i = 0; i < contractMessagesPerTick; ++i)
+        {
+            BenchmarkContractMessage message{ 0, 0, m256i(rnd(), rnd(), rnd(), rnd()), (long long)rnd(), { (long long)rnd(), 1, 2, 3 } };
+            logger.__logContractInfoMessage(1 + i % 16, message);
+        }
+
+        // flushes staged events (computing digests) and writes full pages
+        const auto updateBegin = std::chrono::steady_clock::now();
+        logger.updateTick(tick);
+        updateTickSeconds += secondsSince(updateBegin);
+        flushedEvents = logger.getNextLogId();
+    }
+    result.appendSeconds = secondsSince(begin);
+    lockWait.stop(result);
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    result.appendedItems = logger.getNextLogId();
+    result.readItems = readEvents;
+    result.pageWrites = logger.getWrittenPageCount();
+
+    // digests of events of one tick as computed by flushStagedLogs(), repeated for all ticks
+    std::vector<QuTransfer> transfers(transfersPerTick);
+    std::vector<BenchmarkContractMessage> messages(contractMessagesPerTick);
+    for (auto& transfer : transfers)
+        transfer = QuTransfer{ m256i(rnd(), rnd(), rnd(), rnd()), m256i(rnd(), rnd(), rnd(), rnd()), (long long)(rnd() % 1000000) };
+    for (auto& message : messages)
+        message = BenchmarkContractMessage{ 1, 0, m256i(rnd(), rnd(), rnd(), rnd()), (long long)rnd(), { (long long)rnd(), 1, 2, 3 } };
+    std::vector<unsigned long long> digests(transfersPerTick + contractMessagesPerTick);
+    const auto digestBegin = std::chrono::steady_clock::now();
+    for (unsigned int tick = 0; tick < numberOfTicks; ++tick)
+    {
+        KangarooTwelveShortBatcher<8> digestBatcher;
+        for (unsigned int i = 0; i < transfersPerTick; ++i)
+            digestBatcher.add(&transfers[i], offsetof(QuTransfer, _terminator), &digests[i]);
+        for (unsigned int i = 0; i < contractMessagesPerTick; ++i)
+            digestBatcher.add(&messages[i], offsetof(BenchmarkContractMessage, _terminator), &digests[transfersPerTick + i]);
+        digestBatcher.flush();
+    }
+    result.digestSeconds = secondsSince(digestBegin);
+
+    std::cout << "tick_replay: " << numberOfTicks << " ticks, " << transfersPerTick << " transfers and " << contractMessagesPerTick
+        << " contract messages per tick, " << result.appendsPerSecond() << " events/s, updateTick " << updateTickSeconds
+        << " s, digests " << result.digestSeconds << " s, " << result.readItems << " events read concurrently" << std::endl;
+    results.push_back(result);
+}
+
+// Append numberOfItems items in chunks of itemsPerAppend to a VirtualMemory with pageCapacity items per page (with the
+// cache and compression settings of the logger) while reader threads fetch random chunks that have been appended.
+template <typename T, unsigned long long prefixName, unsigned long long pageCapacity>
+static void benchmarkPageSize(const char* name, unsigned long long numberOfItems, unsigned long long itemsPerAppend,
+    std::vector<LoggingBenchmarkResult>& results)
+{
+    typedef VirtualMemory<T, prefixName, 0, pageCapacity, VM_NUM_CACHE_PAGE, VM_NUM_CACHE_PAGE / 4, VM_COMPRESS_PAGES> BenchmarkVirtualMemory;
+    BenchmarkVirtualMemory* vm = new BenchmarkVirtualMemory();
+    ASSERT_TRUE(vm->init());
+
+    // partly compressible data, similar to log events
+    std::vector<T> chunk(itemsPerAppend);
+    std::mt19937_64 rnd(prefixName);
+    unsigned char* chunkBytes = (unsigned char*)chunk.data();
+    for (unsigned long long i = 0; i < chunk.size() * sizeof(T); ++i)
+        chunkBytes[i] = (i % 4 == 0) ? (unsigned char)rnd() : (unsigned char)(i % 7);
+
+    std::atomic<unsigned long long> readItems(0);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> readers;
+    for (unsigned int r = 0; r < LOGGING_BENCHMARK_READERS; ++r)
+    {
+        readers.emplace_back([&, r]()
+            {
+                std::mt19937_64 rnd(r);
+                std::vector<T> buffer(itemsPerAppend);
+                while (!stop)
+                {
+                    const unsigned long long size = vm->size();
+                    if (size < itemsPerAppend)
+                        continue;
+                    readItems += vm->getMany(buffer.data(), rnd() % (size - itemsPerAppend + 1), itemsPerAppend);
+                }
+            });
+    }
+
+    LoggingBenchmarkResult result{ name, pageCapacity };
+    LockWaitMeasurement lockWait;
+    const auto begin = std::chrono::steady_clock::now();
+    for (unsigned long long appended = 0; appended < numberOfItems; appended += itemsPerAppend)
+    {
+        vm->appendMany(chunk.data(), itemsPerAppend);
+    }
+    result.appendSeconds = secondsSince(begin);
+    lockWait.stop(result);
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    result.appendedItems = vm->size();
+    result.readItems = readItems;
+    result.pageWrites = vm->getWrittenPageCount();
+    result.digestSeconds = 0.0;
+    std::cout << name << " page capacity " << pageCapacity << ": " << result.appendsPerSecond() << " items/s, "
+        << result.pageWrites << " page writes, " << result.readItems << " items read concurrently, lock waits "
+        << result.lockWaitMilliseconds << " ms" << std::endl;
+    results.push_back(result);
+
+    vm->deinit();
+    delete vm;
+}
+
+TEST(TestCoreLogging, DISABLED_Benchmark)
+{
+    initFilesystem();
+    registerAsynFileIO(NULL);
+    if (!frequency)
+        initTimeStampCounter();
+    LoggingTest test;
+
+    std::vector<LoggingBenchmarkResult> results;
+    benchmarkTickReplay(2000, 1024, 64, results);
+
+    // event data of about 100 ticks with 1024 transfers per append
+    benchmarkPageSize<char, 1001, 3000000>("log_buffer", 1200000000ULL, 10000000, results);
+    benchmarkPageSize<char, 1002, 30000000>("log_buffer", 1200000000ULL, 10000000, results);
+    benchmarkPageSize<char, 1003, 300000000>("log_buffer", 1200000000ULL, 10000000, results);
+    benchmarkPageSize<qLogger::BlobInfo, 1004, 300000>("log_id_map", 60000000ULL, 100000, results);
+    benchmarkPageSize<qLogger::BlobInfo, 1005, 3000000>("log_id_map", 60000000ULL, 100000, results);
+    benchmarkPageSize<qLogger::BlobInfo, 1006, 30000000>("log_id_map", 60000000ULL, 100000, results);
+    benchmarkPageSize<qLogger::TickBlobInfo, 1007, 1000>("tx_map", 20000ULL, 1, results);
+    benchmarkPageSize<qLogger::TickBlobInfo, 1008, 3000>("tx_map", 20000ULL, 1, results);
+    benchmarkPageSize<qLogger::TickBlobInfo, 1009, 10000>("tx_map", 20000ULL, 1, results);
+
+    std::ofstream resultFile(LOGGING_BENCHMARK_RESULT_FILE_NAME);
+    resultFile << "benchmark,page_capacity,appended_items,append_seconds,appends_per_second,digest_seconds,page_writes,read_items,lock_waits,lock_wait_ms" << std::endl;
+    for (const auto& result : results)
+    {
+        resultFile << result.benchmark << "," << result.pageCapacity << "," << result.appendedItems << "," << result.appendSeconds << ","
+            << result.appendsPerSecond() << "," << result.digestSeconds << "," << result.pageWrites << "," << result.readItems << ","
+            << result.lockWaitCount << "," << result.lockWaitMilliseconds << std::endl;
+    }
+    std::cout << "Benchmark results written to " << LOGGING_BENCHMARK_RESULT_FILE_NAME << std::endl;
+}
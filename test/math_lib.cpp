@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 
 #include <cmath>
+#include <chrono>
+#include <iostream>
 #include "../src/contracts/math_lib.h"
 
 TEST(TestCoreMathLib, Max) {
@@ -86,3 +88,50 @@ TEST(TestCoreMathLib, DivUp) {
     testDivUp<unsigned int>();
     testDivUp<unsigned long long>();
 }
+
+TEST(TestCoreMathLib, Smul) {
+    EXPECT_EQ(math_lib::smul(0LL, INT64_MAX), 0LL);
+    EXPECT_EQ(math_lib::smul(-3LL, 7LL), -21LL);
+    EXPECT_EQ(math_lib::smul(-3LL, -7LL), 21LL);
+    EXPECT_EQ(math_lib::smul(INT64_MAX, 1LL), INT64_MAX);
+    EXPECT_EQ(math_lib::smul(INT64_MIN, 1LL), INT64_MIN);
+    EXPECT_EQ(math_lib::smul(INT64_MAX, 2LL), INT64_MAX);
+    EXPECT_EQ(math_lib::smul(INT64_MAX, -2LL), INT64_MIN);
+    EXPECT_EQ(math_lib::smul(INT64_MIN, -1LL), INT64_MAX);
+    EXPECT_EQ(math_lib::smul(4294967296LL, 1073741824LL), 4294967296LL * 1073741824LL);
+    EXPECT_EQ(math_lib::smul(4294967296LL, 4294967296LL), INT64_MAX);
+    EXPECT_EQ(math_lib::smul(-4294967296LL, 4294967296LL), INT64_MIN);
+
+    EXPECT_EQ(math_lib::smul(0ULL, UINT64_MAX), 0ULL);
+    EXPECT_EQ(math_lib::smul(3ULL, 7ULL), 21ULL);
+    EXPECT_EQ(math_lib::smul(UINT64_MAX, 1ULL), UINT64_MAX);
+    EXPECT_EQ(math_lib::smul(UINT64_MAX, 2ULL), UINT64_MAX);
+    EXPECT_EQ(math_lib::smul(4294967296ULL, 4294967295ULL), 4294967296ULL * 4294967295ULL);
+    EXPECT_EQ(math_lib::smul(4294967296ULL, 4294967296ULL), UINT64_MAX);
+
+    EXPECT_EQ(math_lib::smul(-65536, 65536), INT32_MIN);
+    EXPECT_EQ(math_lib::smul(65536, 65536), INT32_MAX);
+    EXPECT_EQ(math_lib::smul(65536u, 65536u), UINT32_MAX);
+    EXPECT_EQ(math_lib::smul(65535u, 65537u), 65535u * 65537u);
+}
+
+TEST(TestCoreMathLib, SmulPerformance) {
+    constexpr unsigned long long N = 100000000;
+    volatile unsigned long long optimizeBarrierValue = 0x123456789ULL;
+    unsigned long long sumUnsigned = 0;
+    long long sumSigned = 0;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (unsigned long long i = 0; i < N; ++i)
+        sumUnsigned += math_lib::smul(optimizeBarrierValue, i);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::cout << N << " x smul(uint64, uint64): " << ms << " milliseconds (checksum " << sumUnsigned << ")" << std::endl;
+
+    t0 = std::chrono::high_resolution_clock::now();
+    for (unsigned long long i = 0; i < N; ++i)
+        sumSigned += math_lib::smul((long long)optimizeBarrierValue, -(long long)i);
+    t1 = std::chrono::high_resolution_clock::now();
+    ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::cout << N << " x smul(sint64, sint64): " << ms << " milliseconds (checksum " << sumSigned << ")" << std::endl;
+}
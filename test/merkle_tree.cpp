@@ -0,0 +1,346 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/merkle_tree.h"
+#include "../src/merkle_siblings_cache.h"
+#include "../src/network_messages/common_def.h"
+
+#include <random>
+#include <vector>
+
+static_assert(IncrementalMerkleTree<2>::depth == 1);
+static_assert(IncrementalMerkleTree<4096>::depth == 12);
+static_assert(merkleTreeDepth(1ULL << 24) == 24);
+
+
+template <unsigned long long capacity>
+struct MerkleTreeTestData
+{
+    std::vector<m256i> digests;
+    std::vector<unsigned long long> changeFlags;
+    IncrementalMerkleTree<capacity> tree;
+
+    MerkleTreeTestData() : digests(capacity * 2 - 1), changeFlags(IncrementalMerkleTree<capacity>::changeFlagWords)
+    {
+        tree.init(digests.data(), changeFlags.data());
+    }
+
+    // Compute all inner nodes serially (reference implementation)
+    void computeReferenceDigests(std::vector<m256i>& refDigests) const
+    {
+        refDigests = digests;
+        unsigned long long digestIndex = capacity;
+        unsigned long long previousLevelBeginning = 0;
+        unsigned long long numberOfLeafs = capacity;
+        while (numberOfLeafs > 1)
+        {
+            for (unsigned long long i = 0; i < numberOfLeafs; i += 2)
+            {
+                KangarooTwelve64To32(&refDigests[previousLevelBeginning + i], &refDigests[digestIndex++]);
+            }
+            previousLevelBeginning += numberOfLeafs;
+            numberOfLeafs >>= 1;
+        }
+    }
+
+    void expectAllFlagsCleared() const
+    {
+        for (unsigned long long i = 0; i < changeFlags.size(); ++i)
+            EXPECT_EQ(changeFlags[i], 0ull);
+    }
+};
+
+template <unsigned long long capacity>
+static void testIncrementalUpdate(unsigned int seed, unsigned int changesPerRound, unsigned int rounds)
+{
+    std::mt19937_64 gen(seed);
+    MerkleTreeTestData<capacity> test;
+    std::vector<m256i> refDigests;
+
+    // initial full build
+    for (unsigned long long i = 0; i < capacity; ++i)
+        test.digests[i] = m256i(gen(), gen(), gen(), gen());
+    test.tree.markAllLeafsChanged();
+    test.tree.rebuildInnerNodes();
+    test.expectAllFlagsCleared();
+    test.computeReferenceDigests(refDigests);
+    EXPECT_TRUE(test.tree.root() == refDigests[capacity * 2 - 2]);
+
+    for (unsigned int round = 0; round < rounds; ++round)
+    {
+        for (unsigned int j = 0; j < changesPerRound; ++j)
+        {
+            const unsigned long long leafIndex = gen() % capacity;
+            test.tree.leafDigest(leafIndex) = m256i(gen(), gen(), gen(), gen());
+            test.tree.markLeafChanged(leafIndex);
+            EXPECT_TRUE(test.tree.isLeafChanged(leafIndex));
+        }
+
+        test.tree.updateInnerNodes();
+        test.expectAllFlagsCleared();
+
+        test.computeReferenceDigests(refDigests);
+        for (unsigned long long i = 0; i < capacity * 2 - 1; ++i)
+            EXPECT_TRUE(test.digests[i] == refDigests[i]);
+    }
+}
+
+TEST(TestCoreMerkleTree, IncrementalUpdate)
+{
+    testIncrementalUpdate<2>(1, 1, 5);
+    testIncrementalUpdate<64>(2, 3, 20);
+    testIncrementalUpdate<128>(3, 1, 20);
+    testIncrementalUpdate<1024>(4, 10, 20);
+    testIncrementalUpdate<1024>(5, 2000, 5);
+    testIncrementalUpdate<(1 << 16)>(6, 100, 5);
+}
+
+TEST(TestCoreMerkleTree, FindNextChangedLeaf)
+{
+    MerkleTreeTestData<1024> test;
+    test.tree.clearChangeFlags();
+    EXPECT_EQ(test.tree.findNextChangedLeaf(0), 1024);
+
+    const unsigned long long changed[] = { 0, 1, 63, 64, 200, 1023 };
+    for (unsigned long long leafIndex : changed)
+        test.tree.markLeafChanged(leafIndex);
+
+    unsigned long long found = 0;
+    for (unsigned long long i = test.tree.findNextChangedLeaf(0); i < 1024; i = test.tree.findNextChangedLeaf(i + 1))
+    {
+        ASSERT_LT(found, sizeof(changed) / sizeof(changed[0]));
+        EXPECT_EQ(i, changed[found]);
+        ++found;
+    }
+    EXPECT_EQ(found, sizeof(changed) / sizeof(changed[0]));
+    EXPECT_EQ(test.tree.findNextChangedLeaf(1024), 1024);
+}
+
+TEST(TestCoreMerkleTree, GetSiblings)
+{
+    std::mt19937_64 gen(42);
+    MerkleTreeTestData<4096> test;
+    for (unsigned long long i = 0; i < 4096; ++i)
+        test.digests[i] = m256i(gen(), gen(), gen(), gen());
+    test.tree.rebuildInnerNodes();
+
+    constexpr unsigned int depth = IncrementalMerkleTree<4096>::depth;
+    EXPECT_EQ(depth, 12u);
+    for (int leafIndex : { 0, 1, 2, 1000, 4094, 4095 })
+    {
+        m256i siblings[depth], refSiblings[depth];
+        test.tree.getSiblings(leafIndex, siblings);
+        getSiblings<depth>(leafIndex, test.digests.data(), refSiblings);
+        for (unsigned int j = 0; j < depth; ++j)
+            EXPECT_TRUE(siblings[j] == refSiblings[j]);
+    }
+}
+
+TEST(TestCoreMerkleTree, EmptySubtrees)
+{
+    constexpr unsigned long long capacity = 4096;
+    std::mt19937_64 gen(123);
+    MerkleTreeTestData<capacity> test;
+    std::vector<m256i> refDigests;
+
+    const m256i emptyLeafDigest(gen(), gen(), gen(), gen());
+    test.tree.setEmptyLeafDigest(emptyLeafDigest);
+    for (unsigned int level = 1; level <= test.tree.depth; ++level)
+    {
+        const m256i pair[2] = { test.tree.emptyDigest(level - 1), test.tree.emptyDigest(level - 1) };
+        m256i expected;
+        KangarooTwelve64To32(pair, &expected);
+        EXPECT_TRUE(test.tree.emptyDigest(level) == expected);
+    }
+
+    // sparse tree with a few populated leafs (rebuild)
+    for (unsigned long long i = 0; i < capacity; ++i)
+        test.digests[i] = (gen() % 100 == 0) ? m256i(gen(), gen(), gen(), gen()) : emptyLeafDigest;
+    test.tree.rebuildInnerNodes();
+    test.computeReferenceDigests(refDigests);
+    for (unsigned long long i = 0; i < capacity * 2 - 1; ++i)
+        EXPECT_TRUE(test.digests[i] == refDigests[i]);
+
+    // populate / clear leafs (incremental update)
+    for (unsigned int round = 0; round < 20; ++round)
+    {
+        for (unsigned int j = 0; j < 20; ++j)
+        {
+            const unsigned long long leafIndex = gen() % capacity;
+            test.tree.leafDigest(leafIndex) = (gen() & 1) ? m256i(gen(), gen(), gen(), gen()) : emptyLeafDigest;
+            test.tree.markLeafChanged(leafIndex);
+        }
+        test.tree.updateInnerNodes();
+        test.expectAllFlagsCleared();
+
+        test.computeReferenceDigests(refDigests);
+        for (unsigned long long i = 0; i < capacity * 2 - 1; ++i)
+            EXPECT_TRUE(test.digests[i] == refDigests[i]);
+    }
+
+    // completely empty tree
+    for (unsigned long long i = 0; i < capacity; ++i)
+        test.digests[i] = emptyLeafDigest;
+    test.tree.rebuildInnerNodes();
+    EXPECT_TRUE(test.tree.root() == test.tree.emptyDigest(test.tree.depth));
+}
+
+// Compute root from leaf digests and multiproof siblings (reference verifier)
+template <unsigned long long capacity>
+static m256i computeRootFromMultiproof(std::vector<std::pair<unsigned long long, m256i>> nodes, const m256i* siblings, unsigned int siblingCount)
+{
+    unsigned int siblingIndex = 0;
+    for (unsigned int level = 0; level < IncrementalMerkleTree<capacity>::depth; ++level)
+    {
+        std::vector<std::pair<unsigned long long, m256i>> parents;
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            m256i pair[2];
+            const unsigned long long nodeIndex = nodes[i].first;
+            if (!(nodeIndex & 1) && i + 1 < nodes.size() && nodes[i + 1].first == nodeIndex + 1)
+            {
+                pair[0] = nodes[i].second;
+                pair[1] = nodes[i + 1].second;
+                ++i;
+            }
+            else
+            {
+                EXPECT_LT(siblingIndex, siblingCount);
+                pair[nodeIndex & 1] = nodes[i].second;
+                pair[(nodeIndex & 1) ^ 1] = siblings[siblingIndex++];
+            }
+            m256i parent;
+            KangarooTwelve64To32(pair, &parent);
+            parents.emplace_back(nodeIndex >> 1, parent);
+        }
+        nodes = parents;
+    }
+    EXPECT_EQ(siblingIndex, siblingCount);
+    EXPECT_EQ(nodes.size(), 1);
+    return nodes[0].second;
+}
+
+TEST(TestCoreMerkleTree, MultiproofSiblings)
+{
+    constexpr unsigned long long capacity = 4096;
+    constexpr unsigned int depth = IncrementalMerkleTree<capacity>::depth;
+    std::mt19937_64 gen(77);
+    MerkleTreeTestData<capacity> test;
+    for (unsigned long long i = 0; i < capacity; ++i)
+        test.digests[i] = m256i(gen(), gen(), gen(), gen());
+    test.tree.rebuildInnerNodes();
+
+    const std::vector<std::vector<unsigned long long>> leafSets = {
+        { 0 }, { 4095 }, { 0, 1 }, { 0, 4095 }, { 10, 11, 12, 13, 14, 15, 16, 17 }, { 1, 2, 100, 101, 2000, 4094 }
+    };
+    for (const auto& leafSet : leafSets)
+    {
+        std::vector<unsigned long long> leafIndices = leafSet;
+        std::vector<m256i> siblings(leafSet.size() * depth);
+        const unsigned int siblingCount = test.tree.getMultiproofSiblings(leafIndices.data(), (unsigned int)leafSet.size(), siblings.data());
+        EXPECT_LE(siblingCount, leafSet.size() * depth);
+        if (leafSet.size() == 1)
+            EXPECT_EQ(siblingCount, depth);
+
+        std::vector<std::pair<unsigned long long, m256i>> leafs;
+        for (unsigned long long leafIndex : leafSet)
+            leafs.emplace_back(leafIndex, test.digests[leafIndex]);
+        EXPECT_TRUE(computeRootFromMultiproof<capacity>(leafs, siblings.data(), siblingCount) == test.tree.root());
+    }
+
+    // 8 contiguous aligned leafs share all siblings above level 3
+    std::vector<unsigned long long> leafIndices = { 16, 17, 18, 19, 20, 21, 22, 23 };
+    m256i siblings[8 * depth];
+    EXPECT_EQ(test.tree.getMultiproofSiblings(leafIndices.data(), 8, siblings), depth - 3);
+}
+
+TEST(TestCoreMerkleTree, SiblingsCache)
+{
+    std::mt19937_64 gen(42);
+    MerkleTreeTestData<4096> test;
+    for (unsigned long long i = 0; i < 4096; ++i)
+        test.digests[i] = m256i(gen(), gen(), gen(), gen());
+    test.tree.rebuildInnerNodes();
+
+    constexpr unsigned int depth = IncrementalMerkleTree<4096>::depth;
+    MerkleSiblingsCache<depth, 4> cache;
+    cache.reset();
+
+    m256i siblings[depth], cachedSiblings[depth];
+    EXPECT_FALSE(cache.get(10, 2, cachedSiblings));
+    test.tree.getSiblings(10, siblings);
+    cache.add(10, 2, siblings);
+    EXPECT_TRUE(cache.get(10, 2, cachedSiblings));
+    for (unsigned int j = 0; j < depth; ++j)
+        EXPECT_TRUE(siblings[j] == cachedSiblings[j]);
+
+    // other version of digests is a miss, adding it replaces the entry of the same leaf
+    EXPECT_FALSE(cache.get(10, 4, cachedSiblings));
+    cache.add(10, 4, siblings);
+    EXPECT_FALSE(cache.get(10, 2, cachedSiblings));
+    EXPECT_TRUE(cache.get(10, 4, cachedSiblings));
+
+    // fill cache, use leaf 10 so leaf 11 is least recently used and replaced by leaf 14
+    for (unsigned long long leafIndex = 11; leafIndex < 14; ++leafIndex)
+    {
+        test.tree.getSiblings(leafIndex, siblings);
+        cache.add(leafIndex, 4, siblings);
+    }
+    EXPECT_TRUE(cache.get(10, 4, cachedSiblings));
+    test.tree.getSiblings(14, siblings);
+    cache.add(14, 4, siblings);
+    EXPECT_FALSE(cache.get(11, 4, cachedSiblings));
+    for (unsigned long long leafIndex : { 10, 12, 13, 14 })
+    {
+        EXPECT_TRUE(cache.get(leafIndex, 4, cachedSiblings));
+        test.tree.getSiblings(leafIndex, siblings);
+        for (unsigned int j = 0; j < depth; ++j)
+            EXPECT_TRUE(siblings[j] == cachedSiblings[j]);
+    }
+
+    EXPECT_EQ(cache.getStatistics().hits, 7ull);
+    EXPECT_EQ(cache.getStatistics().misses, 4ull);
+}
+
+TEST(TestCoreMerkleTree, VerifySubtree)
+{
+    std::mt19937_64 gen(7);
+    MerkleTreeTestData<1024> test;
+    for (unsigned long long i = 0; i < 1024; ++i)
+        test.digests[i] = m256i(gen(), gen(), gen(), gen());
+    test.tree.rebuildInnerNodes();
+    constexpr unsigned int depth = IncrementalMerkleTree<1024>::depth;
+    const m256i root = test.tree.root();
+
+    for (unsigned int level = 0; level <= depth; ++level)
+    {
+        const unsigned long long count = 1ull << level;
+        const unsigned long long firstLeaf = (gen() % (1024 >> level)) << level;
+        m256i siblings[depth];
+        test.tree.getSubtreeSiblings(firstLeaf >> level, level, siblings);
+        EXPECT_TRUE(verifyMerkleSubtree(&test.digests[firstLeaf], firstLeaf, count, siblings, depth, root));
+
+        // tampered leaf and wrong position are rejected
+        m256i leafs[1024];
+        for (unsigned long long i = 0; i < count; ++i)
+            leafs[i] = test.digests[firstLeaf + i];
+        leafs[count - 1].m256i_u8[0] ^= 1;
+        EXPECT_FALSE(verifyMerkleSubtree(leafs, firstLeaf, count, siblings, depth, root));
+        if (level < depth)
+            EXPECT_FALSE(verifyMerkleSubtree(&test.digests[firstLeaf], firstLeaf ^ count, count, siblings, depth, root));
+    }
+
+    // unaligned or non-power-of-two chunks are invalid
+    m256i siblings[depth];
+    test.tree.getSubtreeSiblings(1, 2, siblings);
+    EXPECT_FALSE(verifyMerkleSubtree(&test.digests[4], 5, 4, siblings, depth, root));
+    EXPECT_FALSE(verifyMerkleSubtree(&test.digests[4], 4, 3, siblings, depth, root));
+
+    test.tree.clearChangeFlags();
+    test.tree.markLeafChanged(100);
+    EXPECT_FALSE(test.tree.anyLeafChanged(0, 100));
+    EXPECT_TRUE(test.tree.anyLeafChanged(64, 128));
+    EXPECT_TRUE(test.tree.anyLeafChanged(100, 101));
+    EXPECT_FALSE(test.tree.anyLeafChanged(101, 1024));
+}
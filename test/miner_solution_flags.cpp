@@ -0,0 +1,75 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/mining/miner_solution_flags.h"
+
+#include <random>
+#include <set>
+
+template <unsigned long long flagCount, unsigned int listCapacity>
+static void expectFlags(const MinerSolutionFlags<flagCount, listCapacity>& flags, const std::set<unsigned long long>& expected)
+{
+    EXPECT_EQ(flags.getCount(), expected.size());
+    for (unsigned long long i = 0; i < flagCount; ++i)
+        EXPECT_EQ(flags.isSet(i), expected.count(i) != 0);
+}
+
+template <unsigned long long flagCount, unsigned int listCapacity>
+static void testMinerSolutionFlags(unsigned int numberOfFlags, unsigned int seed)
+{
+    MinerSolutionFlags<flagCount, listCapacity> flags;
+    EXPECT_TRUE(flags.init());
+    std::mt19937_64 gen(seed);
+    std::set<unsigned long long> expected;
+
+    for (int round = 0; round < 3; ++round)
+    {
+        // set flags, setting again is detected
+        for (unsigned int i = 0; i < numberOfFlags; ++i)
+        {
+            const unsigned long long flagIndex = gen() % flagCount;
+            EXPECT_EQ(flags.set(flagIndex), expected.insert(flagIndex).second);
+            EXPECT_FALSE(flags.set(flagIndex));
+        }
+        expectFlags(flags, expected);
+
+        // save and load
+        EXPECT_TRUE(flags.save(L"tmp_miner_solution_flags"));
+        flags.reset();
+        expectFlags(flags, {});
+        EXPECT_TRUE(flags.load(L"tmp_miner_solution_flags"));
+        expectFlags(flags, expected);
+
+        // reset clears all flags
+        flags.reset();
+        expected.clear();
+        expectFlags(flags, expected);
+    }
+
+    flags.deinit();
+}
+
+TEST(TestMinerSolutionFlags, FlagsInList)
+{
+    testMinerSolutionFlags<1024 * 64, 64>(50, 1);
+}
+
+TEST(TestMinerSolutionFlags, ListOverflow)
+{
+    testMinerSolutionFlags<1024 * 64, 64>(1000, 2);
+}
+
+TEST(TestMinerSolutionFlags, LoadInvalidFile)
+{
+    MinerSolutionFlags<1024, 16> flags;
+    EXPECT_TRUE(flags.init());
+
+    // list of 3 flags, but file only contains 2
+    unsigned char data[8 + 2 * 4] = { 3 };
+    EXPECT_EQ(save(L"tmp_miner_solution_flags", sizeof(data), data), sizeof(data));
+    EXPECT_FALSE(flags.load(L"tmp_miner_solution_flags"));
+    EXPECT_EQ(flags.getCount(), 0);
+
+    flags.deinit();
+}
@@ -0,0 +1,415 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/platform/memory.h"
+#include "../src/kangaroo_twelve.h"
+#include "../src/network_core/dejavu_filter.h"
+#include "../src/network_messages/header.h"
+#include "../src/network_messages/tick.h"
+
+#include <algorithm>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <vector>
+
+// In-process simulation of the vote dissemination between nodes for measuring the time until each node has received
+// a quorum of votes, depending on peer count, dissemination multiplier, latency, bandwidth, packet loss, and
+// background load.
+//
+// Nodes exchange real BroadcastTick messages over an in-memory transport with per-link latency (plus jitter), uplink
+// bandwidth limit, and random packet loss, driven by a discrete event queue (time in microseconds). Like
+// receiveFromPeers() and processBroadcastTick(), a node computes the salted id of each received packet, drops
+// duplicates with DejavuFilter, and forwards new packets to disseminationMultiplier random peers (see pushCustom()).
+// The tick and request processors of qubic.cpp aren't included (UEFI only), so votes are counted without verifying
+// signatures and the ticks are started at fixed intervals.
+
+struct NetworkSimulationConfig
+{
+    unsigned int nodeCount = 32;
+    unsigned int outgoingConnections = 8; // NUMBER_OF_REGULAR_OUTGOING_CONNECTIONS
+    unsigned int disseminationMultiplier = 6; // DISSEMINATION_MULTIPLIER
+    unsigned long long latencyMicroseconds = 50000;
+    unsigned long long latencyJitterMicroseconds = 20000;
+    unsigned long long uplinkBytesPerSecond = 12500000; // 100 MBit/s
+    double lossProbability = 0.0;
+    unsigned int transactionsPerTick = 0; // background load, BROADCAST_TRANSACTION of 400 bytes
+    unsigned int tickCount = 1;
+    unsigned long long tickIntervalMicroseconds = 2000000;
+    unsigned int seed = 1;
+};
+
+struct NetworkSimulationResult
+{
+    // Number of (node, tick) pairs that reached quorum
+    unsigned long long quorumCount;
+    unsigned long long expectedQuorumCount;
+
+    // Time from tick start until the node has received QUORUM votes of the tick
+    double averageMicrosecondsToQuorum;
+    unsigned long long medianMicrosecondsToQuorum;
+    unsigned long long maxMicrosecondsToQuorum;
+
+    // Traffic per node (including votes and background transactions)
+    double averageBytesSentPerNode;
+    unsigned long long maxBytesSentPerNode;
+
+    // Packets received, duplicates dropped by the dejavu filter, and packets lost in transport
+    unsigned long long packetsReceived;
+    unsigned long long duplicatePackets;
+    unsigned long long lostPackets;
+
+    double duplicateRate() const
+    {
+        return packetsReceived ? (double)duplicatePackets / packetsReceived : 0.0;
+    }
+
+    void print(std::ostream& out) const
+    {
+        out << "quorum " << quorumCount << "/" << expectedQuorumCount << ", time to quorum avg "
+            << averageMicrosecondsToQuorum / 1000 << " ms, median " << medianMicrosecondsToQuorum / 1000.0 << " ms, max "
+            << maxMicrosecondsToQuorum / 1000.0 << " ms, sent per node avg " << averageBytesSentPerNode / 1024
+            << " KB, max " << maxBytesSentPerNode / 1024 << " KB, duplicate rate " << duplicateRate()
+            << ", lost " << lostPackets << std::endl;
+    }
+};
+
+class NetworkSimulation
+{
+public:
+    static constexpr unsigned long long dejavuFilterBuckets = 65536;
+    static constexpr unsigned int dejavuWindowSeconds = 30; // DEJAVU_WINDOW_SECONDS
+    static constexpr unsigned int transactionSize = 400;
+
+    explicit NetworkSimulation(const NetworkSimulationConfig& config) : config(config), rng(config.seed), nodes(config.nodeCount)
+    {
+        // random graph: each node connects to outgoingConnections other nodes, connections are used in both directions
+        for (unsigned int i = 0; i < config.nodeCount; ++i)
+        {
+            Node& node = nodes[i];
+            node.salt = (unsigned int)rng();
+            node.filter = new DejavuFilter<dejavuFilterBuckets>();
+            EXPECT_TRUE(node.filter->init(dejavuWindowSeconds));
+            node.filter->reset();
+            node.voteCounts.resize(config.tickCount);
+            node.voteFlags.resize((unsigned long long)config.tickCount * NUMBER_OF_COMPUTORS);
+            node.quorumTimes.resize(config.tickCount, 0);
+            const unsigned int outgoing = std::min(config.outgoingConnections, config.nodeCount - 1);
+            while (node.outgoingCount < outgoing && node.peers.size() < config.nodeCount - 1)
+            {
+                const unsigned int other = rng() % config.nodeCount;
+                if (other != i && !isConnected(i, other))
+                {
+                    node.peers.push_back(other);
+                    nodes[other].peers.push_back(i);
+                    ++node.outgoingCount;
+                }
+            }
+        }
+    }
+
+    ~NetworkSimulation()
+    {
+        for (Node& node : nodes)
+        {
+            node.filter->deinit();
+            delete node.filter;
+        }
+    }
+
+    NetworkSimulationResult run()
+    {
+        const unsigned int voteMessageSize = sizeof(RequestResponseHeader) + sizeof(BroadcastTick);
+        for (unsigned int tickIndex = 0; tickIndex < config.tickCount; ++tickIndex)
+        {
+            const unsigned long long tickStart = tickIndex * config.tickIntervalMicroseconds;
+
+            // computor i runs on node i % nodeCount and broadcasts its vote shortly after the tick start
+            for (unsigned int computorIndex = 0; computorIndex < NUMBER_OF_COMPUTORS; ++computorIndex)
+            {
+                std::vector<unsigned char> message(voteMessageSize, 0);
+                RequestResponseHeader* header = (RequestResponseHeader*)message.data();
+                header->checkAndSetSize(voteMessageSize);
+                header->setType(BroadcastTick::type());
+                header->setDejavu((unsigned int)rng() | 1);
+                Tick& vote = header->getPayload<BroadcastTick>()->tick;
+                vote.computorIndex = computorIndex;
+                vote.tick = tickIndex;
+                vote.saltedSpectrumDigest = m256i(rng(), rng(), rng(), rng());
+                messages.push_back(std::move(message));
+                const unsigned int node = computorIndex % config.nodeCount;
+                events.push({ tickStart + rng() % 1000, node, node, (unsigned int)messages.size() - 1 });
+            }
+
+            for (unsigned int i = 0; i < config.transactionsPerTick; ++i)
+            {
+                std::vector<unsigned char> message(transactionSize, 0);
+                RequestResponseHeader* header = (RequestResponseHeader*)message.data();
+                header->checkAndSetSize(transactionSize);
+                header->setType(BROADCAST_TRANSACTION);
+                header->setDejavu((unsigned int)rng() | 1);
+                *((unsigned long long*)(header + 1)) = ((unsigned long long)tickIndex << 32) | i;
+                messages.push_back(std::move(message));
+                const unsigned int node = rng() % config.nodeCount;
+                events.push({ tickStart + rng() % config.tickIntervalMicroseconds, node, node, (unsigned int)messages.size() - 1 });
+            }
+        }
+
+        while (!events.empty())
+        {
+            const Event event = events.top();
+            events.pop();
+            receive(event);
+        }
+
+        return collectResult();
+    }
+
+private:
+    struct Node
+    {
+        std::vector<unsigned int> peers;
+        unsigned int outgoingCount = 0;
+        unsigned int salt = 0;
+        DejavuFilter<dejavuFilterBuckets>* filter = nullptr;
+        unsigned long long uplinkFreeTime = 0;
+        unsigned long long bytesSent = 0;
+        std::vector<unsigned short> voteCounts;
+        std::vector<bool> voteFlags;
+        std::vector<unsigned long long> quorumTimes; // 0 = no quorum yet
+    };
+
+    // Delivery of message to node at time (from == to for messages originating at the node)
+    struct Event
+    {
+        unsigned long long time;
+        unsigned int from;
+        unsigned int to;
+        unsigned int messageIndex;
+
+        bool operator>(const Event& other) const
+        {
+            return time > other.time;
+        }
+    };
+
+    bool isConnected(unsigned int a, unsigned int b) const
+    {
+        return std::find(nodes[a].peers.begin(), nodes[a].peers.end(), b) != nodes[a].peers.end();
+    }
+
+    // Salted id of packet as computed by receiveFromPeers()
+    static unsigned long long computeSaltedId(unsigned int salt, const std::vector<unsigned char>& message)
+    {
+        unsigned long long saltedId;
+        const RequestResponseHeader* header = (const RequestResponseHeader*)message.data();
+        if (header->type() == BROADCAST_TRANSACTION)
+        {
+            struct
+            {
+                unsigned int salt;
+                unsigned int dejavu;
+                m256i payloadDigest;
+            } saltedIdInput = { salt, header->dejavu(), m256i::zero() };
+            KangarooTwelve(message.data() + sizeof(RequestResponseHeader), (unsigned int)message.size() - sizeof(RequestResponseHeader),
+                &saltedIdInput.payloadDigest, sizeof(saltedIdInput.payloadDigest));
+            KangarooTwelve(&saltedIdInput, sizeof(saltedIdInput), &saltedId, sizeof(saltedId));
+        }
+        else
+        {
+            std::vector<unsigned char> saltedMessage(message);
+            *((unsigned int*)saltedMessage.data()) = salt;
+            KangarooTwelve(saltedMessage.data(), (unsigned int)saltedMessage.size(), &saltedId, sizeof(saltedId));
+        }
+        return saltedId;
+    }
+
+    void receive(const Event& event)
+    {
+        Node& node = nodes[event.to];
+        const std::vector<unsigned char>& message = messages[event.messageIndex];
+        const unsigned int now = (unsigned int)(event.time / 1000000);
+        const unsigned long long saltedId = computeSaltedId(node.salt, message);
+        if (event.from != event.to)
+        {
+            ++packetsReceived;
+            if (node.filter->contains(saltedId, now))
+            {
+                ++duplicatePackets;
+                return;
+            }
+        }
+        node.filter->insert(saltedId, now);
+
+        const RequestResponseHeader* header = (const RequestResponseHeader*)message.data();
+        if (header->type() == BroadcastTick::type())
+        {
+            const Tick& vote = ((const BroadcastTick*)(header + 1))->tick;
+            const unsigned long long flagIndex = (unsigned long long)vote.tick * NUMBER_OF_COMPUTORS + vote.computorIndex;
+            if (!node.voteFlags[flagIndex])
+            {
+                node.voteFlags[flagIndex] = true;
+                if (++node.voteCounts[vote.tick] == QUORUM)
+                    node.quorumTimes[vote.tick] = event.time - vote.tick * config.tickIntervalMicroseconds;
+            }
+        }
+
+        // forward to disseminationMultiplier random peers like enqueueResponse(NULL, ...)
+        std::vector<unsigned int> candidates(node.peers);
+        for (unsigned int i = 0; i < config.disseminationMultiplier && !candidates.empty(); ++i)
+        {
+            const unsigned int candidateIndex = rng() % candidates.size();
+            send(event.to, candidates[candidateIndex], event.messageIndex, event.time);
+            candidates[candidateIndex] = candidates.back();
+            candidates.pop_back();
+        }
+    }
+
+    void send(unsigned int from, unsigned int to, unsigned int messageIndex, unsigned long long now)
+    {
+        Node& node = nodes[from];
+        const unsigned long long size = messages[messageIndex].size();
+        const unsigned long long start = std::max(now, node.uplinkFreeTime);
+        node.uplinkFreeTime = start + (size * 1000000 + config.uplinkBytesPerSecond - 1) / config.uplinkBytesPerSecond;
+        node.bytesSent += size;
+        if (config.lossProbability > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng) < config.lossProbability)
+        {
+            ++lostPackets;
+            return;
+        }
+        unsigned long long latency = config.latencyMicroseconds;
+        if (config.latencyJitterMicroseconds)
+            latency += rng() % config.latencyJitterMicroseconds;
+        events.push({ node.uplinkFreeTime + latency, from, to, messageIndex });
+    }
+
+    NetworkSimulationResult collectResult() const
+    {
+        NetworkSimulationResult result{};
+        std::vector<unsigned long long> quorumTimes;
+        for (const Node& node : nodes)
+        {
+            for (unsigned long long quorumTime : node.quorumTimes)
+            {
+                if (quorumTime)
+                    quorumTimes.push_back(quorumTime);
+            }
+            result.averageBytesSentPerNode += node.bytesSent;
+            result.maxBytesSentPerNode = std::max(result.maxBytesSentPerNode, node.bytesSent);
+        }
+        result.averageBytesSentPerNode /= nodes.size();
+        result.expectedQuorumCount = (unsigned long long)nodes.size() * config.tickCount;
+        result.quorumCount = quorumTimes.size();
+        if (!quorumTimes.empty())
+        {
+            std::sort(quorumTimes.begin(), quorumTimes.end());
+            unsigned long long sum = 0;
+            for (unsigned long long quorumTime : quorumTimes)
+                sum += quorumTime;
+            result.averageMicrosecondsToQuorum = (double)sum / quorumTimes.size();
+            result.medianMicrosecondsToQuorum = quorumTimes[quorumTimes.size() / 2];
+            result.maxMicrosecondsToQuorum = quorumTimes.back();
+        }
+        result.packetsReceived = packetsReceived;
+        result.duplicatePackets = duplicatePackets;
+        result.lostPackets = lostPackets;
+        return result;
+    }
+
+    NetworkSimulationConfig config;
+    std::mt19937_64 rng;
+    std::vector<Node> nodes;
+    std::vector<std::vector<unsigned char>> messages;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    unsigned long long packetsReceived = 0;
+    unsigned long long duplicatePackets = 0;
+    unsigned long long lostPackets = 0;
+};
+
+static NetworkSimulationResult simulateNetwork(const NetworkSimulationConfig& config)
+{
+    NetworkSimulation simulation(config);
+    return simulation.run();
+}
+
+TEST(TestNetworkSimulation, AllNodesReachQuorum)
+{
+    NetworkSimulationConfig config;
+    config.nodeCount = 16;
+    config.tickCount = 2;
+    const NetworkSimulationResult result = simulateNetwork(config);
+    result.print(std::cout);
+
+    EXPECT_EQ(result.quorumCount, result.expectedQuorumCount);
+    EXPECT_GE(result.medianMicrosecondsToQuorum, config.latencyMicroseconds);
+    EXPECT_LE(result.maxMicrosecondsToQuorum, config.tickIntervalMicroseconds);
+    EXPECT_EQ(result.lostPackets, 0);
+
+    // each vote is forwarded by every node, so most received packets are duplicates
+    EXPECT_GT(result.duplicatePackets, 0);
+    EXPECT_GT(result.duplicateRate(), 0.5);
+
+    // every node sends each vote to disseminationMultiplier peers
+    const double voteBytes = (double)config.tickCount * NUMBER_OF_COMPUTORS * config.disseminationMultiplier
+        * (sizeof(RequestResponseHeader) + sizeof(BroadcastTick));
+    EXPECT_NEAR(result.averageBytesSentPerNode, voteBytes, voteBytes * 0.01);
+}
+
+TEST(TestNetworkSimulation, Deterministic)
+{
+    NetworkSimulationConfig config;
+    config.nodeCount = 8;
+    config.lossProbability = 0.1;
+    const NetworkSimulationResult result1 = simulateNetwork(config);
+    const NetworkSimulationResult result2 = simulateNetwork(config);
+    EXPECT_EQ(result1.quorumCount, result2.quorumCount);
+    EXPECT_EQ(result1.maxMicrosecondsToQuorum, result2.maxMicrosecondsToQuorum);
+    EXPECT_EQ(result1.duplicatePackets, result2.duplicatePackets);
+    EXPECT_EQ(result1.lostPackets, result2.lostPackets);
+}
+
+TEST(TestNetworkSimulation, LatencyLossAndBandwidth)
+{
+    NetworkSimulationConfig config;
+    config.nodeCount = 24;
+    const NetworkSimulationResult baseline = simulateNetwork(config);
+
+    // time to quorum grows with latency
+    NetworkSimulationConfig slowConfig = config;
+    slowConfig.latencyMicroseconds *= 4;
+    const NetworkSimulationResult slow = simulateNetwork(slowConfig);
+    EXPECT_EQ(slow.quorumCount, slow.expectedQuorumCount);
+    EXPECT_GT(slow.medianMicrosecondsToQuorum, baseline.medianMicrosecondsToQuorum);
+
+    // redundant dissemination compensates for moderate packet loss
+    NetworkSimulationConfig lossyConfig = config;
+    lossyConfig.lossProbability = 0.05;
+    const NetworkSimulationResult lossy = simulateNetwork(lossyConfig);
+    EXPECT_GT(lossy.lostPackets, 0);
+    EXPECT_EQ(lossy.quorumCount, lossy.expectedQuorumCount);
+
+    // background load on limited uplinks delays the votes
+    NetworkSimulationConfig loadedConfig = config;
+    loadedConfig.uplinkBytesPerSecond = 2500000;
+    loadedConfig.transactionsPerTick = 2000;
+    const NetworkSimulationResult loaded = simulateNetwork(loadedConfig);
+    EXPECT_GT(loaded.averageBytesSentPerNode, baseline.averageBytesSentPerNode);
+    EXPECT_GT(loaded.medianMicrosecondsToQuorum, baseline.medianMicrosecondsToQuorum);
+}
+
+TEST(TestNetworkSimulation, DisseminationMultiplierReport)
+{
+    for (unsigned int multiplier = 2; multiplier <= 8; multiplier += 2)
+    {
+        NetworkSimulationConfig config;
+        config.nodeCount = 48;
+        config.disseminationMultiplier = multiplier;
+        config.lossProbability = 0.01;
+        config.transactionsPerTick = 500;
+        const NetworkSimulationResult result = simulateNetwork(config);
+        std::cout << "dissemination multiplier " << multiplier << ": ";
+        result.print(std::cout);
+        EXPECT_GT(result.quorumCount, 0);
+    }
+}
@@ -1,9 +1,13 @@
 #define NO_UEFI
 
 #include "oracle_testing.h"
+#include "oracle_core/oracle_machine_channel.h"
 
 #include "platform/random.h"
 
+#include <map>
+#include <algorithm>
+
 
 struct OracleEngineTest : public LoggingTest
 {
@@ -1259,6 +1263,282 @@ TEST(OracleEngine, UserQuerySuccess)
 	oracleEngine3.checkStateConsistencyWithAssert();
 }
 
+static unsigned int batchCommitVerifyCount = 0;
+
+static bool batchCommitVerifyStub(unsigned int computorIndex, const unsigned char* messageDigest, const unsigned char* signature)
+{
+	++batchCommitVerifyCount;
+	// computor 5 has invalid co-signature
+	return computorIndex != 5;
+}
+
+TEST(OracleEngine, ContractQueryBatchCommitSuccess)
+{
+	OracleEngineTest test;
+
+	// simulate two nodes: one with 400 computor IDs and one with 276
+	const m256i* allCompPubKeys = broadcastedComputors.computors.publicKeys;
+	OracleEngineWithInitAndDeinit<400> oracleEngine1(allCompPubKeys);
+	OracleEngineWithInitAndDeinit<276> oracleEngine2(allCompPubKeys + 400);
+	uint16_t computorIndices[NUMBER_OF_COMPUTORS], ownComputorIndices[NUMBER_OF_COMPUTORS];
+	for (uint16_t i = 0; i < NUMBER_OF_COMPUTORS; ++i)
+	{
+		computorIndices[i] = i;
+		ownComputorIndices[i] = (i < 400) ? i : i - 400;
+	}
+
+	OI::Price::OracleQuery priceQuery;
+	priceQuery.oracle = m256i(1, 2, 3, 4);
+	priceQuery.currency1 = m256i(2, 3, 4, 5);
+	priceQuery.currency2 = m256i(3, 4, 5, 6);
+	priceQuery.timestamp = QPI::DateAndTime::now();
+	QPI::uint32 interfaceIndex = 0;
+	QPI::uint16 contractIndex = 1;
+	QPI::uint32 timeout = 30000;
+	const QPI::uint32 notificationProcId = 12345;
+	EXPECT_TRUE(userProcedureRegistry->add(notificationProcId, { dummyNotificationProc, 1, 128, 128, 1 }));
+
+	// start contract query and process reply of OM node
+	QPI::sint64 queryId = oracleEngine1.startContractQuery(contractIndex, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout, notificationProcId);
+	EXPECT_EQ(queryId, oracleEngine2.startContractQuery(contractIndex, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout, notificationProcId));
+	struct
+	{
+		OracleMachineReply metadata;
+		OI::Price::OracleReply data;
+	} priceOracleMachineReply;
+	priceOracleMachineReply.metadata.oracleMachineErrorFlags = 0;
+	priceOracleMachineReply.metadata.oracleQueryId = queryId;
+	priceOracleMachineReply.data.numerator = 1234;
+	priceOracleMachineReply.data.denominator = 1;
+	oracleEngine1.processOracleMachineReply(&priceOracleMachineReply.metadata, sizeof(priceOracleMachineReply));
+	oracleEngine2.processOracleMachineReply(&priceOracleMachineReply.metadata, sizeof(priceOracleMachineReply));
+
+	//-------------------------------------------------------------------------
+	// create batch commit tx of both nodes
+	constexpr unsigned int maxComputorCount = OracleReplyBatchCommitTransactionPrefix::maxComputorCount(1);
+	std::vector<std::vector<uint8_t>> txs;
+	uint8_t txBuffer[MAX_TRANSACTION_SIZE];
+	auto* batchCommitTx = (OracleReplyBatchCommitTransactionPrefix*)txBuffer;
+	uint32_t txComputorCount;
+	uint16_t expectedComputorIdx = 0;
+	while ((txComputorCount = oracleEngine1.getReplyBatchCommitTransaction(txBuffer, computorIndices, ownComputorIndices, 400, system.tick + 3)) != 0)
+	{
+		EXPECT_EQ((int)batchCommitTx->inputType, (int)OracleReplyBatchCommitTransactionPrefix::transactionType());
+		EXPECT_EQ(batchCommitTx->sourcePublicKey, allCompPubKeys[expectedComputorIdx]);
+		EXPECT_TRUE(isZero(batchCommitTx->destinationPublicKey));
+		EXPECT_EQ(batchCommitTx->tick, system.tick + 3);
+		EXPECT_EQ(batchCommitTx->queryCount, 1u);
+		EXPECT_EQ(batchCommitTx->queries()[0].queryId, queryId);
+		EXPECT_EQ(batchCommitTx->computorCount, txComputorCount);
+		EXPECT_EQ(txComputorCount, std::min(maxComputorCount, 400u - expectedComputorIdx));
+		EXPECT_EQ((unsigned int)batchCommitTx->inputSize, OracleReplyBatchCommitTransactionPrefix::inputSizeOf(1, txComputorCount));
+		EXPECT_LE((unsigned int)batchCommitTx->inputSize, MAX_INPUT_SIZE);
+		for (uint32_t c = 0; c < txComputorCount; ++c)
+			EXPECT_EQ(batchCommitTx->computorIndices()[c], expectedComputorIdx++);
+		txs.emplace_back(txBuffer, txBuffer + batchCommitTx->totalSize());
+	}
+	EXPECT_EQ(expectedComputorIdx, 400);
+	EXPECT_EQ(txs.size(), (400 + maxComputorCount - 1) / maxComputorCount);
+	while ((txComputorCount = oracleEngine2.getReplyBatchCommitTransaction(txBuffer, computorIndices + 400, ownComputorIndices + 400, 276, system.tick + 3)) != 0)
+	{
+		EXPECT_EQ(batchCommitTx->sourcePublicKey, allCompPubKeys[batchCommitTx->computorIndices()[0]]);
+		expectedComputorIdx += txComputorCount;
+		txs.emplace_back(txBuffer, txBuffer + batchCommitTx->totalSize());
+	}
+	EXPECT_EQ(expectedComputorIdx, NUMBER_OF_COMPUTORS);
+
+	// second call in the same tick: no commits for tx
+	EXPECT_EQ(oracleEngine1.getReplyBatchCommitTransaction(txBuffer, computorIndices, ownComputorIndices, 400, system.tick + 3), 0);
+
+	// first computor must be tx source
+	memcpy(txBuffer, txs[0].data(), txs[0].size());
+	const_cast<unsigned short*>(batchCommitTx->computorIndices())[0] = 1;
+	EXPECT_FALSE(oracleEngine1.processOracleReplyBatchCommitTransaction(batchCommitTx, batchCommitVerifyStub));
+	oracleEngine1.checkPendingState(queryId, 0, 0, ORACLE_QUERY_STATUS_PENDING);
+
+	//-------------------------------------------------------------------------
+	// process commit tx of node 1: all except for computor 5 with invalid co-signature are accepted
+	system.tick += 3;
+	const unsigned int node1TxCount = (400 + maxComputorCount - 1) / maxComputorCount;
+	batchCommitVerifyCount = 0;
+	for (unsigned int i = 0; i < node1TxCount; ++i)
+	{
+		EXPECT_TRUE(oracleEngine1.processOracleReplyBatchCommitTransaction((OracleReplyBatchCommitTransactionPrefix*)txs[i].data(), batchCommitVerifyStub));
+		EXPECT_TRUE(oracleEngine2.processOracleReplyBatchCommitTransaction((OracleReplyBatchCommitTransactionPrefix*)txs[i].data(), batchCommitVerifyStub));
+	}
+	EXPECT_EQ(batchCommitVerifyCount, 2 * (400 - node1TxCount));
+	oracleEngine1.checkPendingState(queryId, 399, 399, ORACLE_QUERY_STATUS_PENDING);
+	oracleEngine2.checkPendingState(queryId, 399, 0, ORACLE_QUERY_STATUS_PENDING);
+
+	// process commit tx of node 2 -> quorum reached
+	for (unsigned int i = node1TxCount; i < txs.size(); ++i)
+	{
+		EXPECT_TRUE(oracleEngine1.processOracleReplyBatchCommitTransaction((OracleReplyBatchCommitTransactionPrefix*)txs[i].data(), batchCommitVerifyStub));
+		EXPECT_TRUE(oracleEngine2.processOracleReplyBatchCommitTransaction((OracleReplyBatchCommitTransactionPrefix*)txs[i].data(), batchCommitVerifyStub));
+	}
+	oracleEngine1.checkPendingState(queryId, 675, 399, ORACLE_QUERY_STATUS_COMMITTED);
+	oracleEngine2.checkPendingState(queryId, 675, 276, ORACLE_QUERY_STATUS_COMMITTED);
+
+	//-------------------------------------------------------------------------
+	// reveal and check that knowledge proofs of batch commits are correct
+	EXPECT_EQ(oracleEngine1.getReplyRevealTransaction(txBuffer, 0, system.tick + 3, 0), 1);
+	system.tick += 3;
+	auto* replyRevealTx = (OracleReplyRevealTransactionPrefix*)txBuffer;
+	const unsigned int txIndex = 10;
+	addOracleTransactionToTickStorage(replyRevealTx, txIndex);
+	oracleEngine1.processOracleReplyRevealTransaction(replyRevealTx, txIndex);
+	EXPECT_EQ(oracleEngine1.getOracleQueryStatus(queryId), ORACLE_QUERY_STATUS_SUCCESS);
+
+	OracleRevenuePoints rev1; oracleEngine1.getRevenuePoints(rev1);
+	for (int i = 0; i < NUMBER_OF_COMPUTORS; ++i)
+		EXPECT_EQ(rev1.computorRevPoints[i], (i == 5) ? 0 : 1);
+
+	// check that oracle engine is in consistent state
+	oracleEngine1.checkStateConsistencyWithAssert();
+	oracleEngine2.checkStateConsistencyWithAssert();
+}
+
+// Get all pending notifications, mapping query ID to (contract index, status)
+template <typename OracleEngine>
+static std::map<QPI::sint64, std::pair<QPI::uint16, QPI::uint8>> getPriceNotifications(OracleEngine& oracleEngine, QPI::uint64 expectedNumerator)
+{
+	std::map<QPI::sint64, std::pair<QPI::uint16, QPI::uint8>> notifications;
+	while (const OracleNotificationData* notification = oracleEngine.getNotification())
+	{
+		const auto* notificationInput = (const OracleNotificationInput<OI::Price>*) & notification->inputBuffer;
+		EXPECT_FALSE(notifications.contains(notificationInput->queryId));
+		notifications[notificationInput->queryId] = { notification->contractIndex, notificationInput->status };
+		if (notificationInput->status == ORACLE_QUERY_STATUS_SUCCESS)
+			EXPECT_EQ(notificationInput->reply.numerator, expectedNumerator);
+	}
+	return notifications;
+}
+
+TEST(OracleEngine, ContractQuerySharedReply)
+{
+	OracleEngineTest test;
+
+	// simulate one node
+	const m256i* allCompPubKeys = broadcastedComputors.computors.publicKeys;
+	OracleEngineWithInitAndDeinit<676> oracleEngine1(allCompPubKeys);
+
+	OI::Price::OracleQuery priceQuery;
+	priceQuery.oracle = m256i(1, 2, 3, 4);
+	priceQuery.currency1 = m256i(2, 3, 4, 5);
+	priceQuery.currency2 = m256i(3, 4, 5, 6);
+	priceQuery.timestamp = QPI::DateAndTime::now();
+	QPI::uint32 interfaceIndex = 0;
+	QPI::uint32 timeout = 30000;
+	const QPI::uint32 notificationProcId = 12345;
+	EXPECT_TRUE(userProcedureRegistry->add(notificationProcId, { dummyNotificationProc, 1, 128, 128, 1 }));
+
+	//-------------------------------------------------------------------------
+	// first query is sent to OM node, identical queries of other contracts share its reply (unless their timeout
+	// differs from the one of the first query)
+	const QPI::sint64 queryId1 = oracleEngine1.startContractQuery(1, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout, notificationProcId);
+	checkNetworkMessageOracleMachineQuery<OI::Price>(queryId1, timeout, priceQuery);
+	setMemory(enqueuedNetworkMessage, 0);
+	const QPI::sint64 queryId2 = oracleEngine1.startContractQuery(2, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout, notificationProcId);
+	EXPECT_EQ(queryId2, getContractOracleQueryId(system.tick, 1));
+	EXPECT_EQ(enqueuedNetworkMessage.header.size(), 0);
+	EXPECT_EQ(oracleEngine1.getOracleQueryStatus(queryId2), ORACLE_QUERY_STATUS_PENDING);
+	OI::Price::OracleQuery priceQueryReturned;
+	EXPECT_TRUE(oracleEngine1.getOracleQuery(queryId2, &priceQueryReturned, sizeof(priceQueryReturned)));
+	EXPECT_EQ(memcmp(&priceQueryReturned, &priceQuery, sizeof(priceQuery)), 0);
+	const QPI::sint64 queryId3 = oracleEngine1.startContractQuery(3, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout - 1000, notificationProcId);
+	checkNetworkMessageOracleMachineQuery<OI::Price>(queryId3, timeout - 1000, priceQuery);
+	setMemory(enqueuedNetworkMessage, 0);
+	const QPI::sint64 queryId7 = oracleEngine1.startContractQuery(7, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout + 1000, notificationProcId);
+	checkNetworkMessageOracleMachineQuery<OI::Price>(queryId7, timeout + 1000, priceQuery);
+	setMemory(enqueuedNetworkMessage, 0);
+
+	//-------------------------------------------------------------------------
+	// OM reply, commits, and reveal only exist for queries 1, 3, and 7
+	struct
+	{
+		OracleMachineReply metadata;
+		OI::Price::OracleReply data;
+	} priceOracleMachineReply;
+	priceOracleMachineReply.metadata.oracleMachineErrorFlags = 0;
+	priceOracleMachineReply.metadata.oracleQueryId = queryId2;
+	priceOracleMachineReply.data.numerator = 1234;
+	priceOracleMachineReply.data.denominator = 1;
+	oracleEngine1.processOracleMachineReply(&priceOracleMachineReply.metadata, sizeof(priceOracleMachineReply));
+	priceOracleMachineReply.metadata.oracleQueryId = queryId1;
+	oracleEngine1.processOracleMachineReply(&priceOracleMachineReply.metadata, sizeof(priceOracleMachineReply));
+
+	uint8_t txBuffer[MAX_TRANSACTION_SIZE];
+	auto* replyCommitTx = (OracleReplyCommitTransactionPrefix*)txBuffer;
+	system.tick += 3;
+	for (int i = 0; i < QUORUM; ++i)
+	{
+		EXPECT_EQ(oracleEngine1.getReplyCommitTransaction(txBuffer, i, i, system.tick + 3, 0), UINT32_MAX);
+		EXPECT_EQ((int)replyCommitTx->inputSize, (int)sizeof(OracleReplyCommitTransactionItem));
+		EXPECT_EQ(((OracleReplyCommitTransactionItem*)replyCommitTx->inputPtr())->queryId, queryId1);
+		EXPECT_TRUE(oracleEngine1.processOracleReplyCommitTransaction(replyCommitTx));
+	}
+	oracleEngine1.checkStatus(queryId1, ORACLE_QUERY_STATUS_COMMITTED);
+	oracleEngine1.checkStatus(queryId2, ORACLE_QUERY_STATUS_PENDING);
+	EXPECT_EQ(oracleEngine1.getNotification(), nullptr);
+
+	EXPECT_EQ(oracleEngine1.getReplyRevealTransaction(txBuffer, 0, system.tick + 3, 0), 1);
+	system.tick += 3;
+	auto* replyRevealTx = (OracleReplyRevealTransactionPrefix*)txBuffer;
+	const unsigned int txIndex = 10;
+	addOracleTransactionToTickStorage(replyRevealTx, txIndex);
+	EXPECT_TRUE(oracleEngine1.processOracleReplyRevealTransaction(replyRevealTx, txIndex));
+
+	// reply is fanned out to the queries of contract 1 and 2
+	auto notifications = getPriceNotifications(oracleEngine1, 1234);
+	EXPECT_EQ(notifications.size(), 2);
+	EXPECT_EQ(notifications[queryId1], std::make_pair(QPI::uint16(1), ORACLE_QUERY_STATUS_SUCCESS));
+	EXPECT_EQ(notifications[queryId2], std::make_pair(QPI::uint16(2), ORACLE_QUERY_STATUS_SUCCESS));
+	OI::Price::OracleReply reply;
+	EXPECT_TRUE(oracleEngine1.getOracleReply(queryId2, &reply, sizeof(reply)));
+	EXPECT_EQ(reply.numerator, 1234);
+	oracleEngine1.checkStatus(queryId3, ORACLE_QUERY_STATUS_PENDING);
+	oracleEngine1.checkStatus(queryId7, ORACLE_QUERY_STATUS_PENDING);
+
+	//-------------------------------------------------------------------------
+	// recently revealed reply is reused right away
+	const QPI::sint64 queryId4 = oracleEngine1.startContractQuery(4, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout, notificationProcId);
+	EXPECT_EQ(enqueuedNetworkMessage.header.size(), 0);
+	EXPECT_EQ(oracleEngine1.getOracleQueryStatus(queryId4), ORACLE_QUERY_STATUS_SUCCESS);
+	notifications = getPriceNotifications(oracleEngine1, 1234);
+	EXPECT_EQ(notifications.size(), 1);
+	EXPECT_EQ(notifications[queryId4], std::make_pair(QPI::uint16(4), ORACLE_QUERY_STATUS_SUCCESS));
+	EXPECT_TRUE(oracleEngine1.getOracleReply(queryId4, &reply, sizeof(reply)));
+	EXPECT_EQ(reply.numerator, 1234);
+
+	// queries 3 and 7 time out
+	++etalonTick.hour;
+	oracleEngine1.processTimeouts();
+	notifications = getPriceNotifications(oracleEngine1, 1234);
+	EXPECT_EQ(notifications.size(), 2);
+	EXPECT_EQ(notifications[queryId3], std::make_pair(QPI::uint16(3), ORACLE_QUERY_STATUS_TIMEOUT));
+	EXPECT_EQ(notifications[queryId7], std::make_pair(QPI::uint16(7), ORACLE_QUERY_STATUS_TIMEOUT));
+
+	//-------------------------------------------------------------------------
+	// after ORACLE_REPLY_CACHE_TICKS, the reply isn't reused anymore and a timeout is shared as well
+	system.tick += ORACLE_REPLY_CACHE_TICKS;
+	const QPI::sint64 queryId5 = oracleEngine1.startContractQuery(5, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout, notificationProcId);
+	checkNetworkMessageOracleMachineQuery<OI::Price>(queryId5, timeout, priceQuery);
+	setMemory(enqueuedNetworkMessage, 0);
+	const QPI::sint64 queryId6 = oracleEngine1.startContractQuery(6, interfaceIndex, &priceQuery, sizeof(priceQuery), timeout, notificationProcId);
+	EXPECT_EQ(enqueuedNetworkMessage.header.size(), 0);
+	oracleEngine1.checkStateConsistencyWithAssert();
+
+	++etalonTick.hour;
+	oracleEngine1.processTimeouts();
+	notifications = getPriceNotifications(oracleEngine1, 1234);
+	EXPECT_EQ(notifications.size(), 2);
+	EXPECT_EQ(notifications[queryId5], std::make_pair(QPI::uint16(5), ORACLE_QUERY_STATUS_TIMEOUT));
+	EXPECT_EQ(notifications[queryId6], std::make_pair(QPI::uint16(6), ORACLE_QUERY_STATUS_TIMEOUT));
+
+	// check that oracle engine is in consistent state
+	oracleEngine1.checkStateConsistencyWithAssert();
+}
+
 TEST(OracleEngine, FindFirstQueryIndexOfTick)
 {
 	OracleEngineTest test;
@@ -1304,3 +1584,158 @@ TEST(OracleEngine, FindFirstQueryIndexOfTick)
 	}
 	oracleEngine.testFindFirstQueryIndexOfTick(ticks);
 }
+
+TEST(OracleEngine, IndexedSet)
+{
+	static IndexedSet<uint32_t, 64> set;
+	set.reset();
+	EXPECT_FALSE(set.removeByKey(3));
+	EXPECT_FALSE(set.removeByKey(64));
+
+	// random test against std::map (key -> value)
+	std::map<uint32_t, uint32_t> reference;
+	for (int i = 0; i < 10000; ++i)
+	{
+		const uint32_t key = (uint32_t)random(64);
+		if (random(2))
+		{
+			const uint32_t value = (uint32_t)random(1000000);
+			EXPECT_EQ(set.add(value, key), !reference.count(key));
+			reference.emplace(key, value);
+		}
+		else
+		{
+			EXPECT_EQ(set.removeByKey(key), reference.erase(key) == 1);
+		}
+
+		ASSERT_EQ(set.numValues, reference.size());
+		for (uint32_t j = 0; j < set.numValues; ++j)
+		{
+			EXPECT_EQ(reference[set.keys[j]], set.values[j]);
+			EXPECT_EQ(set.positions[set.keys[j]], j + 1);
+		}
+		for (uint32_t k = 0; k < 64; ++k)
+			EXPECT_EQ(set.contains(k), reference.count(k) == 1);
+	}
+}
+
+static void enqueueTestOracleMachineQuery(OracleMachineChannel& channel, unsigned long long queryId, unsigned int querySize, unsigned int timeoutMillisec, unsigned long long nowTsc)
+{
+	uint8_t buffer[sizeof(OracleMachineQuery) + MAX_ORACLE_QUERY_SIZE];
+	auto* query = (OracleMachineQuery*)buffer;
+	query->oracleQueryId = queryId;
+	query->oracleInterfaceIndex = 0;
+	query->timeoutInMilliseconds = timeoutMillisec;
+	for (unsigned int i = 0; i < querySize; ++i)
+		buffer[sizeof(OracleMachineQuery) + i] = (uint8_t)(queryId + i);
+	EXPECT_TRUE(channel.enqueueQuery(query, sizeof(OracleMachineQuery) + querySize, nowTsc, 1000));
+}
+
+TEST(OracleEngine, OracleMachineChannel)
+{
+	// use TSC frequency of 1000 ticks per second in this test
+	static OracleMachineChannel channel;
+	EXPECT_TRUE(channel.init());
+	unsigned long long now = 1000000;
+
+	// nothing to send
+	EXPECT_EQ(channel.buildFrame(now, 1000), nullptr);
+
+	// single query is sent as plain ORACLE_MACHINE_QUERY message
+	enqueueTestOracleMachineQuery(channel, 100, 13, 60000, now);
+	const RequestResponseHeader* frame = channel.buildFrame(now, 1000);
+	EXPECT_NE(frame, nullptr);
+	EXPECT_EQ(frame->type(), OracleMachineQuery::type());
+	EXPECT_EQ(frame->size(), sizeof(RequestResponseHeader) + sizeof(OracleMachineQuery) + 13);
+	EXPECT_EQ(((const OracleMachineQuery*)(frame + 1))->oracleQueryId, 100);
+	EXPECT_EQ(channel.buildFrame(now, 1000), nullptr);
+
+	// without negotiated batch support, each query is sent in its own plain frame
+	static_assert(OM_MAX_QUERIES_PER_FRAME == 1);
+	enqueueTestOracleMachineQuery(channel, 90, 5, 60000, now);
+	enqueueTestOracleMachineQuery(channel, 91, 6, 60000, now);
+	for (int frameIdx = 0; frameIdx < 2; ++frameIdx)
+	{
+		frame = channel.buildFrame(now, 1000);
+		EXPECT_NE(frame, nullptr);
+		EXPECT_EQ(frame->type(), OracleMachineQuery::type());
+	}
+	EXPECT_EQ(channel.buildFrame(now, 1000), nullptr);
+	EXPECT_TRUE(channel.processReply(90));
+	EXPECT_TRUE(channel.processReply(91));
+
+	// with negotiated batch support, queries enqueued together are coalesced into one frame, the one already sent is
+	// not included
+	const unsigned int maxQueriesPerBatch = 16;
+	for (unsigned long long queryId = 101; queryId < 101 + maxQueriesPerBatch + 3; ++queryId)
+		enqueueTestOracleMachineQuery(channel, queryId, (unsigned int)(queryId % 20), 30000, now);
+	std::vector<unsigned long long> sentQueryIds;
+	for (int frameIdx = 0; frameIdx < 2; ++frameIdx)
+	{
+		frame = channel.buildFrame(now, 1000, maxQueriesPerBatch);
+		EXPECT_NE(frame, nullptr);
+		EXPECT_EQ(frame->type(), OracleMachineQueryBatch::type());
+		const auto* batch = (const OracleMachineQueryBatch*)(frame + 1);
+		EXPECT_EQ(batch->numberOfQueries, (frameIdx == 0) ? maxQueriesPerBatch : 3u);
+		const uint8_t* itemPtr = (const uint8_t*)(batch + 1);
+		for (unsigned int i = 0; i < batch->numberOfQueries; ++i)
+		{
+			const auto* item = (const OracleMachineQueryBatchItem*)itemPtr;
+			const auto* query = (const OracleMachineQuery*)(item + 1);
+			EXPECT_EQ(item->size, sizeof(OracleMachineQuery) + query->oracleQueryId % 20);
+			for (unsigned int j = 0; j < item->size - sizeof(OracleMachineQuery); ++j)
+				EXPECT_EQ(((const uint8_t*)(query + 1))[j], (uint8_t)(query->oracleQueryId + j));
+			sentQueryIds.push_back(query->oracleQueryId);
+			itemPtr += sizeof(OracleMachineQueryBatchItem) + ((item->size + 7) & ~7u);
+		}
+		EXPECT_EQ(itemPtr, (const uint8_t*)frame + frame->size());
+	}
+	EXPECT_EQ(channel.buildFrame(now, 1000, maxQueriesPerBatch), nullptr);
+	std::sort(sentQueryIds.begin(), sentQueryIds.end());
+	EXPECT_EQ(sentQueryIds.size(), maxQueriesPerBatch + 3);
+	for (unsigned int i = 0; i < sentQueryIds.size(); ++i)
+		EXPECT_EQ(sentQueryIds[i], 101 + i);
+	EXPECT_EQ(channel.getActiveCount(), maxQueriesPerBatch + 4);
+
+	// replies are correlated by query ID
+	for (unsigned long long queryId = 101; queryId < 101 + maxQueriesPerBatch + 3; ++queryId)
+		EXPECT_TRUE(channel.processReply(queryId));
+	EXPECT_FALSE(channel.processReply(101));
+	EXPECT_EQ(channel.getActiveCount(), 1);
+
+	// query without reply is resent after timeout until maximum number of sends is reached
+	for (unsigned int sendCount = 1; sendCount < OM_MAX_QUERY_SENDS; ++sendCount)
+	{
+		now += OM_QUERY_RESEND_TIMEOUT_SECS * 1000 - 1;
+		EXPECT_EQ(channel.buildFrame(now, 1000), nullptr);
+		now += 1;
+		frame = channel.buildFrame(now, 1000);
+		EXPECT_NE(frame, nullptr);
+		EXPECT_EQ(((const OracleMachineQuery*)(frame + 1))->oracleQueryId, 100);
+	}
+	now += OM_QUERY_RESEND_TIMEOUT_SECS * 1000;
+	EXPECT_EQ(channel.buildFrame(now, 1000), nullptr);
+	EXPECT_EQ(channel.getActiveCount(), 0);
+
+	// expired query is dropped without sending
+	enqueueTestOracleMachineQuery(channel, 200, 8, 5000, now);
+	now += 5000;
+	EXPECT_EQ(channel.buildFrame(now, 1000), nullptr);
+	EXPECT_EQ(channel.getActiveCount(), 0);
+
+	const OracleMachineChannel::Statistics& stats = channel.getStatistics();
+	EXPECT_EQ(stats.framesSent, 5 + OM_MAX_QUERY_SENDS - 1);
+	EXPECT_EQ(stats.queriesSent, maxQueriesPerBatch + 5 + OM_MAX_QUERY_SENDS);
+	EXPECT_EQ(stats.queriesResent, OM_MAX_QUERY_SENDS - 1);
+	EXPECT_EQ(stats.repliesMatched, maxQueriesPerBatch + 5);
+	EXPECT_EQ(stats.repliesUnmatched, 1);
+	EXPECT_EQ(stats.queriesDropped, 2);
+
+	// channel full
+	for (unsigned int i = 0; i < OM_CHANNEL_CAPACITY; ++i)
+		enqueueTestOracleMachineQuery(channel, 1000 + i, 0, 30000, now);
+	OracleMachineQuery query{ 5000, 0, 30000 };
+	EXPECT_FALSE(channel.enqueueQuery(&query, sizeof(query), now, 1000));
+
+	channel.deinit();
+}
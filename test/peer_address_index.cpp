@@ -0,0 +1,158 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/network_core/peer_address_index.h"
+
+#include <random>
+#include <vector>
+
+static IPv4Address makeAddress(unsigned int u32)
+{
+    IPv4Address address;
+    address.u32 = u32;
+    return address;
+}
+
+// Find count addresses with the same home position
+template <unsigned int capacityBits>
+static std::vector<IPv4Address> findCollidingAddresses(unsigned int home, unsigned int count)
+{
+    std::vector<IPv4Address> addresses;
+    for (unsigned int u32 = 1; addresses.size() < count; ++u32)
+    {
+        if (PeerAddressIndex<capacityBits>::home(makeAddress(u32)) == home)
+            addresses.push_back(makeAddress(u32));
+    }
+    return addresses;
+}
+
+TEST(TestPeerAddressIndex, AddRemoveLookup)
+{
+    PeerAddressIndex<8> index;
+    index.reset();
+    EXPECT_EQ(index.size(), 0u);
+    EXPECT_EQ(index.find(makeAddress(0x0100007f)), -1);
+
+    EXPECT_TRUE(index.insert(makeAddress(0x0100007f), 0));
+    EXPECT_TRUE(index.insert(makeAddress(0x0101a8c0), 1));
+    EXPECT_TRUE(index.insert(makeAddress(0x08080808), 2));
+    EXPECT_EQ(index.size(), 3u);
+    EXPECT_EQ(index.find(makeAddress(0x0100007f)), 0);
+    EXPECT_EQ(index.find(makeAddress(0x0101a8c0)), 1);
+    EXPECT_EQ(index.find(makeAddress(0x08080808)), 2);
+    EXPECT_EQ(index.find(makeAddress(0x04040404)), -1);
+
+    // duplicates are rejected and keep their slot
+    EXPECT_FALSE(index.insert(makeAddress(0x0101a8c0), 5));
+    EXPECT_EQ(index.find(makeAddress(0x0101a8c0)), 1);
+    EXPECT_EQ(index.size(), 3u);
+
+    // moving the last peer to the slot of a removed one, like forgetPublicPeer()
+    EXPECT_TRUE(index.remove(makeAddress(0x0100007f)));
+    index.setSlot(makeAddress(0x08080808), 0);
+    EXPECT_EQ(index.find(makeAddress(0x0100007f)), -1);
+    EXPECT_EQ(index.find(makeAddress(0x08080808)), 0);
+    EXPECT_EQ(index.find(makeAddress(0x0101a8c0)), 1);
+    EXPECT_FALSE(index.remove(makeAddress(0x0100007f)));
+    EXPECT_EQ(index.size(), 2u);
+
+    // removed address can be added again
+    EXPECT_TRUE(index.insert(makeAddress(0x0100007f), 2));
+    EXPECT_EQ(index.find(makeAddress(0x0100007f)), 2);
+}
+
+TEST(TestPeerAddressIndex, Collisions)
+{
+    constexpr unsigned int capacityBits = 4;
+    typedef PeerAddressIndex<capacityBits> Index;
+    Index index;
+    index.reset();
+
+    // probe sequence of colliding addresses wraps around at the end of the table
+    const unsigned int home = Index::capacity - 2;
+    std::vector<IPv4Address> colliding = findCollidingAddresses<capacityBits>(home, 4);
+    std::vector<IPv4Address> other = findCollidingAddresses<capacityBits>(0, 2);
+    for (unsigned int i = 0; i < 4; ++i)
+        EXPECT_TRUE(index.insert(colliding[i], i));
+    for (unsigned int i = 0; i < 2; ++i)
+        EXPECT_TRUE(index.insert(other[i], 10 + i));
+    for (unsigned int i = 0; i < 4; ++i)
+        EXPECT_EQ(index.find(colliding[i]), (int)i);
+    for (unsigned int i = 0; i < 2; ++i)
+        EXPECT_EQ(index.find(other[i]), 10 + (int)i);
+
+    // removing from the middle of probe sequences keeps following entries reachable (backward shift)
+    EXPECT_TRUE(index.remove(colliding[1]));
+    EXPECT_EQ(index.find(colliding[1]), -1);
+    EXPECT_EQ(index.find(colliding[0]), 0);
+    EXPECT_EQ(index.find(colliding[2]), 2);
+    EXPECT_EQ(index.find(colliding[3]), 3);
+    EXPECT_EQ(index.find(other[0]), 10);
+    EXPECT_EQ(index.find(other[1]), 11);
+
+    EXPECT_TRUE(index.remove(colliding[0]));
+    EXPECT_TRUE(index.remove(other[0]));
+    EXPECT_EQ(index.find(colliding[2]), 2);
+    EXPECT_EQ(index.find(colliding[3]), 3);
+    EXPECT_EQ(index.find(other[1]), 11);
+    EXPECT_EQ(index.size(), 3u);
+
+    // index doesn't get completely full, so probing always ends at an empty entry
+    index.reset();
+    std::vector<IPv4Address> addresses = findCollidingAddresses<capacityBits>(3, Index::capacity);
+    for (unsigned int i = 0; i < Index::capacity - 1; ++i)
+        EXPECT_TRUE(index.insert(addresses[i], i));
+    EXPECT_FALSE(index.insert(addresses[Index::capacity - 1], Index::capacity - 1));
+    EXPECT_EQ(index.find(addresses[Index::capacity - 1]), -1);
+    EXPECT_EQ(index.find(addresses[Index::capacity - 2]), (int)Index::capacity - 2);
+}
+
+TEST(TestPeerAddressIndex, RandomOperations)
+{
+    // compare with a plain table that is scanned, like publicPeers before indexing
+    constexpr unsigned int maxPeers = 512;
+    PeerAddressIndex<10>* index = new PeerAddressIndex<10>();
+    index->reset();
+    std::vector<IPv4Address> peers;
+    std::mt19937 gen(42);
+    for (unsigned int op = 0; op < 100000; ++op)
+    {
+        // small address range for many duplicates and collisions
+        const IPv4Address address = makeAddress(1 + gen() % 2048);
+        int expected = -1;
+        for (unsigned int i = 0; i < peers.size(); ++i)
+        {
+            if (peers[i] == address)
+                expected = i;
+        }
+        ASSERT_EQ(index->find(address), expected);
+
+        if (gen() % 2)
+        {
+            if (expected < 0 && peers.size() < maxPeers)
+            {
+                EXPECT_TRUE(index->insert(address, (unsigned int)peers.size()));
+                peers.push_back(address);
+            }
+            else if (expected >= 0)
+            {
+                EXPECT_FALSE(index->insert(address, (unsigned int)peers.size()));
+            }
+        }
+        else if (expected >= 0)
+        {
+            EXPECT_TRUE(index->remove(address));
+            if (expected != (int)peers.size() - 1)
+            {
+                index->setSlot(peers.back(), expected);
+                peers[expected] = peers.back();
+            }
+            peers.pop_back();
+        }
+        ASSERT_EQ(index->size(), peers.size());
+    }
+    for (unsigned int i = 0; i < peers.size(); ++i)
+        EXPECT_EQ(index->find(peers[i]), (int)i);
+    delete index;
+}
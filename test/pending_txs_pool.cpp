@@ -42,6 +42,7 @@ public:
             spectrum[NUM_INITIALIZED_ENTITIES + i].outgoingAmount = 0;
             spectrum[NUM_INITIALIZED_ENTITIES + i].publicKey = m256i{ 0, 0, 0, NUM_INITIALIZED_ENTITIES + i + 1 };
         }
+        rebuildSpectrumTagsAndBalances();
         updateSpectrumInfo();
         commonBuffers.init(1, sizeof(*txsPriorities));
     }
@@ -57,6 +58,11 @@ public:
         return maxNumTxsPerTick;
     }
 
+    unsigned int getHighestPriorityTxIndex(unsigned int tick)
+    {
+        return txsPriorities->element(txsPriorities->headIndex(m256i{ tickToIndex(tick), 0, 0, 0 }));
+    }
+
     bool addTransaction(unsigned int tick, long long amount, unsigned int inputSize, const m256i* dest = nullptr, const m256i* src = nullptr)
     {
         Transaction* transaction = (Transaction*)transactionBuffer;
@@ -129,6 +135,7 @@ public:
             m256i tpDigest;
             KangarooTwelve(tp, tp->totalSize(), &tpDigest, 32);
             EXPECT_EQ(*digest, tpDigest);
+            EXPECT_TRUE(containsTx(tick, tpDigest));
         }
     }
 };
@@ -418,6 +425,92 @@ TEST(TestPendingTxsPool, TxsPrioritizationMoreThanMaxTxs)
             EXPECT_EQ(pendingTxsPool.getTx(firstEpochTick0, t)->amount, pendingTxsPool.getMaxNumTxsPerTick() + t + 1);
         else
             EXPECT_EQ(pendingTxsPool.getTx(firstEpochTick0, t)->amount, t + 1);
+
+        // digest set is updated when replacing txs
+        EXPECT_TRUE(pendingTxsPool.containsTx(firstEpochTick0, *pendingTxsPool.getDigest(firstEpochTick0, t)));
+    }
+    pendingTxsPool.checkStateConsistencyWithAssert();
+
+    // bulk access returns txs in priority order and findTx() finds each of them
+    const Transaction* txs[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    const m256i* digests[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    EXPECT_EQ(pendingTxsPool.getTickTxsByPriority(firstEpochTick0, txs, digests, 10), 10u);
+    EXPECT_EQ(pendingTxsPool.getTickTxsByPriority(firstEpochTick0, txs, digests, NUMBER_OF_TRANSACTIONS_PER_TICK), pendingTxsPool.getMaxNumTxsPerTick());
+    for (unsigned int t = 0; t < pendingTxsPool.getMaxNumTxsPerTick(); ++t)
+    {
+        EXPECT_EQ(txs[t]->amount, pendingTxsPool.getMaxNumTxsPerTick() + numAdditionalTxs - t);
+        EXPECT_EQ(pendingTxsPool.findTx(firstEpochTick0, *digests[t]), txs[t]);
+    }
+    EXPECT_EQ(pendingTxsPool.findTx(firstEpochTick0, m256i::zero()), nullptr);
+    EXPECT_EQ(pendingTxsPool.getTickTxsByPriority(firstEpochTick0 + PENDING_TXS_POOL_NUM_TICKS, txs, digests, NUMBER_OF_TRANSACTIONS_PER_TICK), 0u);
+
+    pendingTxsPool.deinit();
+}
+
+TEST(TestPendingTxsPool, TxsPrioritiesUpdateOfChangedEntities)
+{
+    TestPendingTxsPool pendingTxsPool;
+
+    pendingTxsPool.init();
+    const unsigned int tick0 = 1000;
+    pendingTxsPool.beginEpoch(tick0);
+
+    // add one tx of the entities 1 to 10 in two ticks
+    m256i srcPublicKey = m256i::zero();
+    for (unsigned int t = 0; t < 10; ++t)
+    {
+        srcPublicKey.u64._3 = t + 1;
+        EXPECT_TRUE(pendingTxsPool.addTransaction(tick0, /*amount=*/t + 1, /*inputSize=*/0, /*dest=*/nullptr, &srcPublicKey));
+        EXPECT_TRUE(pendingTxsPool.addTransaction(tick0 + 1, /*amount=*/t + 1, /*inputSize=*/0, /*dest=*/nullptr, &srcPublicKey));
+    }
+    const m256i drainedTxDigest = *pendingTxsPool.getDigest(tick0 + 1, 2);
+
+    // drain entity 3 and increase balance of entity 1 to make it the highest priority
+    spectrumDigestTree.clearChangeFlags();
+    spectrum[2].outgoingAmount = spectrum[2].incomingAmount;
+    spectrumDigestTree.markLeafChanged(2);
+    spectrum[0].incomingAmount += 1000;
+    spectrumDigestTree.markLeafChanged(0);
+
+    // only txs of tick >= tick0 + 1 are updated
+    pendingTxsPool.collectChangedEntities();
+    spectrumDigestTree.clearChangeFlags();
+    pendingTxsPool.updateTxsPrioritiesOfChangedEntities(tick0 + 1);
+    pendingTxsPool.checkStateConsistencyWithAssert();
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tick0), 10u);
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tick0 + 1), 9u);
+    EXPECT_FALSE(pendingTxsPool.containsTx(tick0 + 1, drainedTxDigest));
+    for (unsigned int t = 0; t < 9; ++t)
+    {
+        EXPECT_NE(pendingTxsPool.getTx(tick0 + 1, t)->amount, 3);
+        EXPECT_TRUE(pendingTxsPool.containsTx(tick0 + 1, *pendingTxsPool.getDigest(tick0 + 1, t)));
+    }
+
+    // highest priority tx of tick is the one of entity 1
+    EXPECT_EQ(pendingTxsPool.getTx(tick0 + 1, pendingTxsPool.getHighestPriorityTxIndex(tick0 + 1))->amount, 1);
+
+    // drain entity 5 after compaction moved its txs
+    spectrum[4].outgoingAmount = spectrum[4].incomingAmount;
+    spectrumDigestTree.markLeafChanged(4);
+    pendingTxsPool.collectChangedEntities();
+    spectrumDigestTree.clearChangeFlags();
+    pendingTxsPool.updateTxsPrioritiesOfChangedEntities(tick0);
+    pendingTxsPool.checkStateConsistencyWithAssert();
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tick0), 9u);
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tick0 + 1), 8u);
+
+    // after reorganization of the spectrum, all txs are updated (removed entities aren't flagged as changed)
+    spectrum[5].outgoingAmount = spectrum[5].incomingAmount;
+    spectrumReorganizationCount++;
+    pendingTxsPool.collectChangedEntities();
+    pendingTxsPool.updateTxsPrioritiesOfChangedEntities(tick0);
+    pendingTxsPool.checkStateConsistencyWithAssert();
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tick0), 8u);
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tick0 + 1), 7u);
+    for (unsigned int t = 0; t < 7; ++t)
+    {
+        EXPECT_NE(pendingTxsPool.getTx(tick0 + 1, t)->amount, 5);
+        EXPECT_NE(pendingTxsPool.getTx(tick0 + 1, t)->amount, 6);
     }
 
     pendingTxsPool.deinit();
@@ -463,6 +556,39 @@ TEST(TestPendingTxsPool, RejectDuplicateTxs)
     pendingTxsPool.deinit();
 }
 
+TEST(TestPendingTxsPool, AddWithPrecomputedDigest)
+{
+    TestPendingTxsPool pendingTxsPool;
+    pendingTxsPool.init();
+
+    const unsigned int tick0 = 4781;
+    pendingTxsPool.beginEpoch(tick0);
+
+    m256i dest{ 562, 789, 234, 121 };
+    m256i src{ 0, 0, 0, NUM_INITIALIZED_ENTITIES / 3 };
+    EXPECT_TRUE(pendingTxsPool.addTransaction(tick0, /*amount=*/1, /*inputSize=*/0, &dest, &src));
+
+    // add modified copy of tx, passing digest of full tx
+    unsigned char txBuffer[sizeof(Transaction) + SIGNATURE_SIZE];
+    Transaction* tx = (Transaction*)txBuffer;
+    copyMem(tx, pendingTxsPool.getTx(tick0, 0), sizeof(txBuffer));
+    tx->amount = 2;
+    m256i txDigest;
+    KangarooTwelve(tx, tx->totalSize(), &txDigest, sizeof(txDigest));
+    EXPECT_FALSE(pendingTxsPool.containsTx(tick0, txDigest));
+    EXPECT_TRUE(pendingTxsPool.add(tx, &txDigest));
+    EXPECT_TRUE(pendingTxsPool.containsTx(tick0, txDigest));
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tick0), 2);
+
+    // duplicate is rejected with and without precomputed digest
+    EXPECT_FALSE(pendingTxsPool.add(tx, &txDigest));
+    EXPECT_FALSE(pendingTxsPool.add(tx));
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tick0), 2);
+    pendingTxsPool.checkStateConsistencyWithAssert();
+
+    pendingTxsPool.deinit();
+}
+
 TEST(TestPendingTxsPool, ProtocolLevelTxsMaxPriority)
 {
     TestPendingTxsPool pendingTxsPool;
@@ -541,4 +667,149 @@ TEST(TestPendingTxsPool, TxsWithSrcBalance0AreRejected)
 
         pendingTxsPool.deinit();
     }
-}
\ No newline at end of file
+}
+
+TEST(TestPendingTxsPool, SaveAndLoadFile)
+{
+    TestPendingTxsPool pendingTxsPool;
+    unsigned long long seed = 4286;
+    const wchar_t* fileName = L"pending_txs_pool_test.snp";
+    std::vector<unsigned char> buffer(TestPendingTxsPool::maxSnapshotSize);
+
+    pendingTxsPool.init();
+    const unsigned int firstTick = 71230;
+    pendingTxsPool.beginEpoch(firstTick);
+
+    // move begin of the ring buffer, so saved ticks wrap around
+    for (unsigned int i = 0; i < 7; ++i)
+        pendingTxsPool.incrementFirstStoredTick();
+    const unsigned int firstStoredTick = firstTick + 7;
+
+    unsigned int numSavedTxs = 0;
+    unsigned int numSavedTxsOfTick[PENDING_TXS_POOL_NUM_TICKS];
+    for (unsigned int t = 0; t < PENDING_TXS_POOL_NUM_TICKS; ++t)
+    {
+        numSavedTxsOfTick[t] = pendingTxsPool.addTickTransactions(firstStoredTick + t, seed + t, TestPendingTxsPool::getMaxNumTxsPerTick());
+        numSavedTxs += numSavedTxsOfTick[t];
+    }
+    const unsigned int highestPriorityTxIndex = pendingTxsPool.getHighestPriorityTxIndex(firstStoredTick + 3);
+
+    EXPECT_GT(pendingTxsPool.saveToFile(fileName, buffer.data()), 0);
+    pendingTxsPool.deinit();
+
+    // load into fresh pool
+    pendingTxsPool.init();
+    pendingTxsPool.beginEpoch(12);
+    EXPECT_EQ(pendingTxsPool.loadFromFile(fileName, buffer.data()), numSavedTxs);
+    pendingTxsPool.checkStateConsistencyWithAssert();
+
+    EXPECT_EQ(pendingTxsPool.getTotalNumberOfPendingTxs(firstStoredTick - 1), numSavedTxs);
+    for (unsigned int t = 0; t < PENDING_TXS_POOL_NUM_TICKS; ++t)
+    {
+        EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(firstStoredTick + t), numSavedTxsOfTick[t]);
+        pendingTxsPool.checkTickTransactions(firstStoredTick + t, seed + t, TestPendingTxsPool::getMaxNumTxsPerTick());
+    }
+    EXPECT_EQ(pendingTxsPool.getHighestPriorityTxIndex(firstStoredTick + 3), highestPriorityTxIndex);
+
+    // corrupted file is rejected without changing the pool
+    FILE* file = nullptr;
+    ASSERT_EQ(_wfopen_s(&file, fileName, L"r+b"), 0);
+    const unsigned int wrongCount = numSavedTxs + 1;
+    fseek(file, 4, SEEK_SET);
+    fwrite(&wrongCount, sizeof(wrongCount), 1, file);
+    fclose(file);
+    EXPECT_EQ(pendingTxsPool.loadFromFile(fileName, buffer.data()), -1);
+    EXPECT_EQ(pendingTxsPool.getTotalNumberOfPendingTxs(firstStoredTick - 1), numSavedTxs);
+
+    // missing file
+    _wremove(fileName);
+    EXPECT_EQ(pendingTxsPool.loadFromFile(fileName, buffer.data()), -1);
+
+    pendingTxsPool.deinit();
+}
+
+TEST(TestPendingTxsPool, FarFutureTxs)
+{
+    TestPendingTxsPool pendingTxsPool;
+    unsigned long long seed = 9021;
+
+    pendingTxsPool.init();
+    const unsigned int firstTick = 283517;
+    pendingTxsPool.beginEpoch(firstTick);
+
+    // ticks after the storage window are accepted until the end of the far-future window
+    const unsigned int farTick0 = firstTick + PENDING_TXS_POOL_NUM_TICKS;
+    const unsigned int farTickEnd = farTick0 + PENDING_TXS_POOL_FAR_FUTURE_NUM_TICKS;
+    m256i srcPublicKey = m256i{ 0, 0, 0, 1 };
+    EXPECT_FALSE(pendingTxsPool.addTransaction(farTickEnd, 10, 0, /*dest=*/nullptr, &srcPublicKey));
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(farTickEnd), 0);
+
+    unsigned int numAddedFirstFarTick = pendingTxsPool.addTickTransactions(farTick0, seed, TestPendingTxsPool::getMaxNumTxsPerTick());
+    unsigned int numAddedLastFarTick = pendingTxsPool.addTickTransactions(farTickEnd - 1, seed + 1, TestPendingTxsPool::getMaxNumTxsPerTick());
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(farTick0), numAddedFirstFarTick);
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(farTickEnd - 1), numAddedLastFarTick);
+    EXPECT_EQ(pendingTxsPool.getTotalNumberOfPendingTxs(firstTick), numAddedFirstFarTick + numAddedLastFarTick);
+    EXPECT_EQ(pendingTxsPool.getTotalNumberOfPendingTxs(farTick0), numAddedLastFarTick);
+    EXPECT_EQ(pendingTxsPool.getTotalNumberOfPendingTxs(farTickEnd - 1), 0);
+
+    // far-future txs are not accessible by index before their tick enters the storage window
+    EXPECT_EQ(pendingTxsPool.getTx(farTick0, 0), nullptr);
+
+    // duplicates are rejected, far-future txs can be found with containsTx()
+    unsigned char txBuffer[MAX_TRANSACTION_SIZE];
+    Transaction* tx = (Transaction*)txBuffer;
+    tx->sourcePublicKey = srcPublicKey;
+    tx->destinationPublicKey = m256i{ 1, 2, 3, 4 };
+    tx->amount = 17;
+    tx->tick = farTick0 + 5;
+    tx->inputType = 0;
+    tx->inputSize = 0;
+    m256i txDigest;
+    KangarooTwelve(tx, tx->totalSize(), &txDigest, 32);
+    EXPECT_FALSE(pendingTxsPool.containsTx(tx->tick, txDigest));
+    EXPECT_TRUE(pendingTxsPool.add(tx));
+    EXPECT_FALSE(pendingTxsPool.add(tx));
+    EXPECT_TRUE(pendingTxsPool.containsTx(tx->tick, txDigest));
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tx->tick), 1);
+
+    // number of txs per far-future tick is limited to the number of txs that fit into a tick of the storage window
+    const unsigned int fullTick = farTick0 + 7;
+    for (unsigned int i = 0; i < TestPendingTxsPool::getMaxNumTxsPerTick(); ++i)
+        EXPECT_TRUE(pendingTxsPool.addTransaction(fullTick, 1, 0, /*dest=*/nullptr, &srcPublicKey));
+    EXPECT_FALSE(pendingTxsPool.addTransaction(fullTick, 1, 0, /*dest=*/nullptr, &srcPublicKey));
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(fullTick), TestPendingTxsPool::getMaxNumTxsPerTick());
+    pendingTxsPool.checkStateConsistencyWithAssert();
+
+    // txs with higher priority replace txs with lowest priority in full tick
+    const m256i richSrcPublicKey = m256i{ 0, 0, 0, NUM_INITIALIZED_ENTITIES };
+    EXPECT_TRUE(pendingTxsPool.addTransaction(fullTick, 1, 0, /*dest=*/nullptr, &richSrcPublicKey));
+    EXPECT_FALSE(pendingTxsPool.addTransaction(fullTick, 2, 0, /*dest=*/nullptr, &srcPublicKey));
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(fullTick), TestPendingTxsPool::getMaxNumTxsPerTick());
+    pendingTxsPool.checkStateConsistencyWithAssert();
+
+    // txs are moved to the storage window when their tick enters it
+    pendingTxsPool.incrementFirstStoredTick();
+    pendingTxsPool.checkStateConsistencyWithAssert();
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(farTick0), numAddedFirstFarTick);
+    if (numAddedFirstFarTick)
+        EXPECT_NE(pendingTxsPool.getTx(farTick0, 0), nullptr);
+    EXPECT_EQ(pendingTxsPool.getTotalNumberOfPendingTxs(firstTick), numAddedFirstFarTick + numAddedLastFarTick + 1 + TestPendingTxsPool::getMaxNumTxsPerTick());
+    pendingTxsPool.checkTickTransactions(farTick0, seed, TestPendingTxsPool::getMaxNumTxsPerTick());
+
+    for (unsigned int i = 0; i < 7; ++i)
+        pendingTxsPool.incrementFirstStoredTick();
+    pendingTxsPool.checkStateConsistencyWithAssert();
+    EXPECT_TRUE(pendingTxsPool.containsTx(tx->tick, txDigest));
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(tx->tick), 1);
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(fullTick), TestPendingTxsPool::getMaxNumTxsPerTick());
+    EXPECT_NE(pendingTxsPool.getTx(fullTick, TestPendingTxsPool::getMaxNumTxsPerTick() - 1), nullptr);
+
+    // jumping the window moves txs of all ticks that enter it
+    pendingTxsPool.beginEpoch(farTickEnd - 10);
+    pendingTxsPool.checkStateConsistencyWithAssert();
+    EXPECT_EQ(pendingTxsPool.getTotalNumberOfPendingTxs(farTickEnd - 11), numAddedLastFarTick);
+    EXPECT_EQ(pendingTxsPool.getNumberOfPendingTickTxs(farTickEnd - 1), numAddedLastFarTick);
+    pendingTxsPool.checkTickTransactions(farTickEnd - 1, seed + 1, TestPendingTxsPool::getMaxNumTxsPerTick());
+
+    pendingTxsPool.deinit();
+}
@@ -2,12 +2,22 @@
 
 #include "gtest/gtest.h"
 #include "../src/platform/read_write_lock.h"
+#include "../src/platform/spin_lock.h"
 #include "../src/platform/stack_size_tracker.h"
 #include "../src/platform/custom_stack.h"
 #include "../src/platform/profiling.h"
+#include "../src/platform/parallel_jobs.h"
+#include "../src/platform/memory.h"
+#include "../src/platform/memory_vectorized.h"
+#include "../src/platform/memory_util.h"
+#include "../src/platform/processor_topology.h"
 
 #include "common_buffers.h"
 #include <thread>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <random>
 
 TEST(TestCoreReadWriteLock, SimpleSingleThread)
 {
@@ -41,6 +51,82 @@ TEST(TestCoreReadWriteLock, SimpleSingleThread)
 
     l.acquireWrite();
     l.releaseWrite();
+
+#ifdef TRACK_READ_WRITE_LOCK_STATISTICS
+    // 10 + 1 + 1 successful read acquisitions and 1 + 1 write acquisitions, no waiting
+    EXPECT_EQ(l.getStatistics().acquisitionCount, 14);
+#else
+    // not tracked
+    EXPECT_EQ(l.getStatistics().acquisitionCount, 0);
+#endif
+    EXPECT_EQ(l.getStatistics().contendedAcquisitionCount, 0);
+}
+
+template <bool ticketFair>
+static void testSpinLock()
+{
+    SpinLock<ticketFair> l;
+    l.reset();
+    EXPECT_FALSE(l.isLocked());
+
+    EXPECT_TRUE(l.tryAcquire());
+    EXPECT_TRUE(l.isLocked());
+    EXPECT_FALSE(l.tryAcquire());
+    l.release();
+    EXPECT_FALSE(l.isLocked());
+    l.acquire();
+    l.release();
+    EXPECT_EQ(l.getStatistics().acquisitionCount, 2);
+    EXPECT_EQ(l.getStatistics().contendedAcquisitionCount, 0);
+    EXPECT_EQ(l.getStatistics().spinCycles, 0);
+
+    // waiting for lock held by other thread is counted
+    l.acquire();
+    std::thread waiting([&]()
+        {
+            l.acquire();
+            l.release();
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    l.release();
+    waiting.join();
+    EXPECT_EQ(l.getStatistics().acquisitionCount, 4);
+    EXPECT_EQ(l.getStatistics().contendedAcquisitionCount, 1);
+    EXPECT_GT(l.getStatistics().spinCycles, 0);
+
+    // concurrent non-atomic increments are consistent if protected by lock (fewer iterations for ticket lock, which
+    // is slow if there are more threads than free CPU cores)
+    constexpr unsigned int numThreads = 2, numIncrements = (ticketFair) ? 1000 : 20000;
+    unsigned long long counter = 0;
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&]()
+            {
+                for (unsigned int i = 0; i < numIncrements; ++i)
+                {
+                    l.acquire();
+                    counter = counter + 1;
+                    l.release();
+                }
+            });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(counter, numThreads * numIncrements);
+    EXPECT_FALSE(l.isLocked());
+    EXPECT_EQ(l.getStatistics().acquisitionCount, 4 + numThreads * numIncrements);
+    EXPECT_LE(l.getStatistics().contendedAcquisitionCount, 1 + numThreads * numIncrements);
+}
+
+TEST(TestCoreSpinLock, SpinLock)
+{
+    testSpinLock<false>();
+}
+
+TEST(TestCoreSpinLock, TicketLock)
+{
+    testSpinLock<true>();
 }
 
 
@@ -328,6 +414,99 @@ TEST(TestCoreProfiling, CheckTicksToMicroseconds)
     checkTicksToMicroseconds(2, 0xffffffffffffffffllu, 123456);
 }
 
+TEST(TestCoreTimeStampCounter, TicksToMilliseconds)
+{
+    const unsigned long long savedFrequency = frequency;
+
+    frequency = 3000000000llu;
+    EXPECT_EQ(ticksToMilliseconds(0), 0);
+    EXPECT_EQ(ticksToMilliseconds(2999999), 0);
+    EXPECT_EQ(ticksToMilliseconds(3000000), 1);
+    EXPECT_EQ(ticksToMilliseconds(4500000000llu), 1500);
+
+    // no overflow for the full range of ticks
+    EXPECT_EQ(ticksToMilliseconds(0xffffffffffffffffllu), 6148914691236llu);
+    frequency = 1234567891llu;
+    EXPECT_EQ(ticksToMilliseconds(0xffffffffffffffffllu), 14941862823572llu);
+
+    frequency = savedFrequency;
+}
+
+TEST(TestCoreTimeStampCounter, MonotonicMilliseconds)
+{
+    if (!frequency)
+        initTimeStampCounter();
+
+    const unsigned long long begin = monotonicMilliseconds();
+    unsigned long long previous = begin;
+    for (int i = 0; i < 1000; ++i)
+    {
+        const unsigned long long current = monotonicMilliseconds();
+        EXPECT_GE(current, previous);
+        previous = current;
+    }
+
+    sleepMilliseconds(200);
+    const unsigned long long elapsed = monotonicMilliseconds() - begin;
+    EXPECT_GE(elapsed, 190);
+    EXPECT_LT(elapsed, 2000);
+}
+
+TEST(TestCoreProfiling, SamplingProfiler)
+{
+    static SamplingProfiler profiler;
+    ASSERT_TRUE(profiler.init(2));
+
+    // processor 0: 100 x request (10..1000 cycles); processor 1: 10 x END_TICK (100000 cycles), events of processors
+    // without ring are ignored
+    const unsigned long long baseTsc = __rdtsc();
+    for (unsigned int i = 1; i <= 100; ++i)
+        profiler.recordOnProcessor(0, SAMPLED_SCOPE_REQUEST_PROCESSING, baseTsc + i * 1000, baseTsc + i * 1000 + i * 10);
+    for (unsigned int i = 0; i < 10; ++i)
+        profiler.recordOnProcessor(1, SAMPLED_SCOPE_END_TICK, baseTsc + i * 200000, baseTsc + i * 200000 + 100000);
+    profiler.recordOnProcessor(2, SAMPLED_SCOPE_PROCESS_TICK, baseTsc, baseTsc + 10);
+    profiler.aggregate();
+    EXPECT_EQ(profiler.getLostEvents(), 0);
+
+    SampledScopeStats stats[SAMPLED_SCOPE_COUNT];
+    ASSERT_EQ(profiler.getTopScopes(stats, SAMPLED_SCOPE_COUNT, false), 2);
+    EXPECT_STREQ(stats[0].name, sampledScopeNames[SAMPLED_SCOPE_END_TICK]);
+    EXPECT_EQ(stats[0].count, 10);
+    EXPECT_EQ(stats[0].totalCycles, 1000000);
+    EXPECT_EQ(stats[0].maxCycles, 100000);
+    EXPECT_EQ(stats[0].p99Cycles, 100000);
+    EXPECT_STREQ(stats[1].name, sampledScopeNames[SAMPLED_SCOPE_REQUEST_PROCESSING]);
+    EXPECT_EQ(stats[1].count, 100);
+    EXPECT_EQ(stats[1].totalCycles, 50500);
+    EXPECT_EQ(stats[1].maxCycles, 1000);
+    // percentiles are bucket upper bounds with relative error up to 1/16
+    EXPECT_GE(stats[1].p50Cycles, 500);
+    EXPECT_LE(stats[1].p50Cycles, 500 + 500 / 16);
+    EXPECT_GE(stats[1].p99Cycles, 990);
+    EXPECT_LE(stats[1].p99Cycles, 1000);
+
+    // top 1 by p99, aggregating again doesn't count events twice
+    profiler.aggregate();
+    ASSERT_EQ(profiler.getTopScopes(stats, 1, true), 1);
+    EXPECT_STREQ(stats[0].name, sampledScopeNames[SAMPLED_SCOPE_END_TICK]);
+    EXPECT_EQ(stats[0].count, 10);
+
+    // overflow of ring buffer is counted as lost events
+    for (unsigned int i = 0; i < samplingProfilerEventsPerProcessor + 5; ++i)
+        profiler.recordOnProcessor(0, SAMPLED_SCOPE_PARALLEL_JOB, baseTsc, baseTsc + 1);
+    profiler.aggregate();
+    EXPECT_EQ(profiler.getLostEvents(), 6);
+    ASSERT_EQ(profiler.getTopScopes(stats, SAMPLED_SCOPE_COUNT, false), 3);
+    EXPECT_EQ(stats[2].count, samplingProfilerEventsPerProcessor - 1);
+
+    // reset clears statistics
+    profiler.reset();
+    EXPECT_EQ(profiler.getTopScopes(stats, SAMPLED_SCOPE_COUNT, false), 0);
+    EXPECT_EQ(profiler.getLostEvents(), 0);
+
+    profiler.deinit();
+}
+
 static volatile bool waitingForAcquire = false;
 
 static void acquireAndReleaseCommonBuffer()
@@ -499,3 +678,341 @@ TEST(TestCoreCommonBuffers, ThreeBuffers)
     EXPECT_EQ(commonBuffers.getMaxWaitingProcessorCount(), 0);
     EXPECT_EQ(commonBuffers.acquiredBuffers(), 0);
 }
+
+TEST(TestCoreCommonBuffers, ProcessorScratchpads)
+{
+    ProcessorScratchpads scratchpads;
+    CommonBuffers pool;
+    EXPECT_FALSE(scratchpads.init(0, 1024));
+    EXPECT_TRUE(scratchpads.init(2, 1000));
+    EXPECT_TRUE(commonBuffers.init(1, 4096));
+    EXPECT_TRUE(pool.init(1, 4096));
+
+    // small scratchpads are taken from arena of processor (aligned to 64 bytes)
+    unsigned char* a = (unsigned char*)scratchpads.acquire(0, 100);
+    unsigned char* b = (unsigned char*)scratchpads.acquire(0, 200);
+    unsigned char* c = (unsigned char*)scratchpads.acquire(1, 100);
+    EXPECT_EQ(b, a + 128);
+    EXPECT_NE(c, a);
+    EXPECT_EQ(scratchpads.arenaUsage(0), 128 + 256);
+    EXPECT_EQ(scratchpads.arenaUsage(1), 128);
+    EXPECT_EQ(commonBuffers.acquiredBuffers(), 0);
+
+    // too large for rest of arena -> commonBuffers or pool set for the processor
+    void* d = scratchpads.acquire(0, 1000);
+    EXPECT_TRUE(commonBuffers.containsBuffer(d));
+    EXPECT_EQ(scratchpads.setPool(1, &pool), nullptr);
+    void* e = scratchpads.acquire(1, 1000);
+    EXPECT_TRUE(pool.containsBuffer(e));
+    EXPECT_EQ(commonBuffers.acquiredBuffers(), 1);
+    EXPECT_EQ(pool.acquiredBuffers(), 1);
+    scratchpads.release(0, d);
+    scratchpads.release(1, e);
+    EXPECT_EQ(commonBuffers.acquiredBuffers(), 0);
+    EXPECT_EQ(pool.acquiredBuffers(), 0);
+    EXPECT_EQ(scratchpads.setPool(1, nullptr), &pool);
+
+    // arena space is freed when all scratchpads on top of it are released
+    scratchpads.release(0, a);
+    EXPECT_EQ(scratchpads.arenaUsage(0), 128 + 256);
+    scratchpads.release(0, b);
+    EXPECT_EQ(scratchpads.arenaUsage(0), 0);
+    scratchpads.release(1, c);
+    EXPECT_EQ(scratchpads.arenaUsage(1), 0);
+    EXPECT_EQ(scratchpads.getMaxArenaUsage(), 128 + 256);
+
+    // number of nested arena scratchpads is limited
+    void* nested[ProcessorScratchpads::maxNestedArenaScratchpads + 1];
+    for (unsigned int i = 0; i <= ProcessorScratchpads::maxNestedArenaScratchpads; ++i)
+        nested[i] = scratchpads.acquire(0, 1);
+    EXPECT_TRUE(commonBuffers.containsBuffer(nested[ProcessorScratchpads::maxNestedArenaScratchpads]));
+    for (unsigned int i = ProcessorScratchpads::maxNestedArenaScratchpads + 1; i-- > 0; )
+        scratchpads.release(0, nested[i]);
+    EXPECT_EQ(scratchpads.arenaUsage(0), 0);
+    EXPECT_EQ(commonBuffers.acquiredBuffers(), 0);
+
+    // processors without arena use commonBuffers
+    void* f = scratchpads.acquire(2, 10);
+    EXPECT_TRUE(commonBuffers.containsBuffer(f));
+    scratchpads.release(2, f);
+    EXPECT_EQ(commonBuffers.getInvalidReleaseCount(), 0);
+
+    // running processor is found by the address of its stack
+    EXPECT_EQ(scratchpads.findRunningProcessor(), 2);
+    unsigned char stackMarker = 0;
+    scratchpads.setStack(0, &stackMarker - 4096, &stackMarker - 1024);
+    EXPECT_EQ(scratchpads.findRunningProcessor(), 2);
+    scratchpads.setStack(1, &stackMarker - 65536, &stackMarker + 65536);
+    EXPECT_EQ(scratchpads.findRunningProcessor(), 1);
+
+    pool.deinit();
+    commonBuffers.deinit();
+    scratchpads.deinit();
+}
+
+
+static ParallelJobs testParallelJobs;
+static volatile bool parallelJobsHelpersRunning = false;
+
+static void markItems(void* context, unsigned long long begin, unsigned long long end)
+{
+    std::vector<unsigned char>& items = *(std::vector<unsigned char>*)context;
+    for (unsigned long long i = begin; i < end; ++i)
+        ++items[i];
+}
+
+static void parallelJobsHelper()
+{
+    while (parallelJobsHelpersRunning)
+        testParallelJobs.tryHelp();
+}
+
+TEST(TestCoreParallelJobs, WithoutHelpers)
+{
+    testParallelJobs.reset();
+    EXPECT_FALSE(testParallelJobs.isJobActive());
+    EXPECT_FALSE(testParallelJobs.tryHelp());
+
+    // empty job, job smaller than chunk, job with incomplete last chunk
+    for (unsigned long long count : { 0ull, 10ull, 1000ull, 1001ull, 12345ull })
+    {
+        std::vector<unsigned char> items(count, 0);
+        testParallelJobs.run(markItems, &items, count, 100);
+        for (unsigned long long i = 0; i < count; ++i)
+            EXPECT_EQ(items[i], 1);
+    }
+
+    EXPECT_FALSE(testParallelJobs.isJobActive());
+    EXPECT_EQ(testParallelJobs.getHelpedChunkCount(), 0);
+}
+
+TEST(TestCoreParallelJobs, WithHelpers)
+{
+    testParallelJobs.reset();
+    parallelJobsHelpersRunning = true;
+    std::thread helpers[3];
+    for (auto& helper : helpers)
+        helper = std::thread(parallelJobsHelper);
+
+    for (int rep = 0; rep < 100; ++rep)
+    {
+        constexpr unsigned long long count = 100000;
+        std::vector<unsigned char> items(count, 0);
+        testParallelJobs.run(markItems, &items, count, 64);
+        for (unsigned long long i = 0; i < count; ++i)
+            EXPECT_EQ(items[i], 1);
+        EXPECT_FALSE(testParallelJobs.isJobActive());
+    }
+
+    parallelJobsHelpersRunning = false;
+    for (auto& helper : helpers)
+        helper.join();
+}
+
+TEST(TestCoreMemory, VectorizedSetAndCopy)
+{
+    std::mt19937 gen32(42);
+    const unsigned long long sizes[] = { 0, 1, 2, 3, 5, 8, 15, 16, 31, 32, 33, 63, 64, 65, 127, 128, 129, 257, 4097, 100003, memNonTemporalThreshold + 77 };
+    for (unsigned long long size : sizes)
+    {
+        std::vector<unsigned char> initial(2 * size + 400);
+        for (auto& c : initial)
+            c = (unsigned char)gen32();
+
+        for (unsigned long long offset = 0; offset < 70; offset += (size > 100000) ? 23 : 1)
+        {
+            // set
+            std::vector<unsigned char> buffer = initial, expected = initial;
+            setMemVectorized(buffer.data() + offset, size, 0x5a);
+            memset(expected.data() + offset, 0x5a, size);
+            EXPECT_EQ(buffer, expected);
+
+            // copy without overlap and with overlap in both directions (memmove semantics)
+            for (long long delta : { (long long)size + 100, 1ll, 5ll, 33ll, 64ll, -1ll, -7ll, -65ll })
+            {
+                const unsigned long long source = 100 + offset;
+                buffer = initial;
+                expected = initial;
+                copyMemVectorized(buffer.data() + source + delta, buffer.data() + source, size);
+                memmove(expected.data() + source + delta, expected.data() + source, size);
+                EXPECT_EQ(buffer, expected);
+            }
+        }
+    }
+}
+
+static int compareMemReference(const void* p1, const void* p2, unsigned long long size)
+{
+    const char* cPtr1 = (const char*)p1;
+    const char* cPtr2 = (const char*)p2;
+    for (unsigned long long i = 0; i < size; ++i)
+    {
+        if (cPtr1[i] != cPtr2[i])
+            return (cPtr1[i] < cPtr2[i]) ? -1 : 1;
+    }
+    return 0;
+}
+
+TEST(TestCoreMemory, IsZeroAndCompareMem)
+{
+    std::mt19937 gen32(42);
+    for (unsigned long long size : { 0ull, 1ull, 7ull, 8ull, 9ull, 31ull, 32ull, 33ull, 64ull, 100ull, 128ull, 129ull, 1000ull })
+    {
+        for (unsigned long long offset = 0; offset < 8; ++offset)
+        {
+            std::vector<unsigned char> buffer(size + 16, 0);
+            std::vector<unsigned char> other(size + 16, 0);
+            unsigned char* data = buffer.data() + offset;
+            unsigned char* otherData = other.data() + offset;
+
+            // non-zero bytes outside of range don't matter
+            buffer[offset + size] = 1;
+            if (offset)
+                buffer[offset - 1] = 1;
+            EXPECT_TRUE(isZero(data, size));
+            EXPECT_EQ(compareMem(data, otherData, size), 0);
+
+            // each single non-zero byte is found, including bytes with sign bit set
+            for (unsigned long long i = 0; i < size; ++i)
+            {
+                data[i] = (i & 1) ? 0x80 : (unsigned char)(gen32() | 1);
+                EXPECT_FALSE(isZero(data, size));
+                EXPECT_EQ(compareMem(data, otherData, size), compareMemReference(data, otherData, size));
+                EXPECT_EQ(compareMem(otherData, data, size), compareMemReference(otherData, data, size));
+                data[i] = 0;
+            }
+
+            // first difference decides
+            for (unsigned long long i = 0; i < size; ++i)
+                data[i] = otherData[i] = (unsigned char)gen32();
+            EXPECT_EQ(compareMem(data, otherData, size), 0);
+            for (int rep = 0; rep < 10 && size; ++rep)
+            {
+                const unsigned long long i = gen32() % size;
+                data[i] = (unsigned char)gen32();
+                EXPECT_EQ(compareMem(data, otherData, size), compareMemReference(data, otherData, size));
+            }
+        }
+    }
+
+    // m256i
+    m256i a = m256i::zero();
+    EXPECT_TRUE(isZero(&a, sizeof(a)));
+    a.m256i_u8[31] = 1;
+    EXPECT_FALSE(isZero(&a, sizeof(a)));
+}
+
+TEST(TestCoreMemory, LargeAllocation)
+{
+    EXPECT_EQ(largeAllocSize(1), largePageSize);
+    EXPECT_EQ(largeAllocSize(largePageSize), largePageSize);
+    EXPECT_EQ(largeAllocSize(largePageSize + 1), 2 * largePageSize);
+
+    // small buffers are allocated from the pool
+    unsigned char* buffer = nullptr;
+    ASSERT_TRUE(allocLargeWithErrorLog(L"small", 1000, (void**)&buffer, __LINE__));
+    EXPECT_TRUE(isZero(buffer, 1000));
+    freeLarge(buffer, 1000);
+
+    // large buffers are aligned to large pages and zeroed
+    for (unsigned long long size : { largeAllocThreshold, 3 * largePageSize + 12345 })
+    {
+        ASSERT_TRUE(allocLargeWithErrorLog(L"large", size, (void**)&buffer, __LINE__));
+        EXPECT_EQ((unsigned long long)buffer % largePageSize, 0);
+        EXPECT_TRUE(isZero(buffer, size));
+        buffer[0] = 1;
+        buffer[size - 1] = 2;
+        freeLarge(buffer, size);
+    }
+}
+
+TEST(TestCoreMemory, MemoryRegistry)
+{
+    MemoryRegistry* registry = new MemoryRegistry();
+    MemoryRegistry::Subsystem subsystems[4];
+    int buffers[8];
+
+    // allocations are grouped by the name part before "::" or "." (trailing spaces removed)
+    registry->add(L"PendingTxsPool::txsPriorities", &buffers[0], 100, 2097152);
+    registry->add(L"PendingTxsPool::txsDigestSets ", &buffers[1], 50, 50);
+    registry->add(L"VirtualMemory.Page", &buffers[2], 10, 10);
+    registry->add(L"score", &buffers[3], 7, 7);
+    registry->add(L"score", &buffers[4], 8, 8);
+    registry->add(L"loadSparse bitmap ", &buffers[5], 1, 1);
+    EXPECT_EQ(registry->getSubsystems(subsystems, 4), 4);
+    EXPECT_STREQ(subsystems[0].name, "PendingTxsPool");
+    EXPECT_EQ(subsystems[0].requestedBytes, 150);
+    EXPECT_EQ(subsystems[0].committedBytes, 2097202);
+    EXPECT_EQ(subsystems[0].allocationCount, 2);
+    EXPECT_STREQ(subsystems[1].name, "VirtualMemory");
+    EXPECT_STREQ(subsystems[2].name, "score");
+    EXPECT_EQ(subsystems[2].committedBytes, 15);
+    EXPECT_EQ(subsystems[2].allocationCount, 2);
+    EXPECT_STREQ(subsystems[3].name, "loadSparse bitmap");
+
+    // freeing reduces live size, but keeps peak and total count
+    registry->release(&buffers[0]);
+    registry->release(&buffers[0]);
+    registry->release(&buffers[7]);
+    registry->release(nullptr);
+    EXPECT_EQ(registry->getSubsystems(subsystems, 1), 1);
+    EXPECT_EQ(subsystems[0].requestedBytes, 50);
+    EXPECT_EQ(subsystems[0].committedBytes, 50);
+    EXPECT_EQ(subsystems[0].peakCommittedBytes, 2097202);
+    EXPECT_EQ(subsystems[0].allocationCount, 1);
+    EXPECT_EQ(subsystems[0].totalAllocationCount, 2);
+    EXPECT_EQ(registry->getUntrackedAllocationCount(), 0);
+
+    // allocations of new subsystems are only counted if the registry is full
+    for (unsigned int i = 4; i < MemoryRegistry::maxSubsystems; i++)
+    {
+        CHAR16 name[] = L"subsystem__";
+        name[9] = L'a' + (CHAR16)(i / 26);
+        name[10] = L'a' + (CHAR16)(i % 26);
+        registry->add(name, &buffers[6], 1, 1);
+        registry->release(&buffers[6]);
+    }
+    registry->add(L"oneTooMany", &buffers[6], 1, 1);
+    EXPECT_EQ(registry->getUntrackedAllocationCount(), 1);
+    registry->add(L"score", &buffers[6], 1, 1);
+    EXPECT_EQ(registry->getUntrackedAllocationCount(), 1);
+
+    delete registry;
+}
+
+TEST(TestCoreProcessorTopology, OrderProcessors)
+{
+    // 2 packages with 4 cores and 2 SMT threads each, enumerated thread by thread
+    ProcessorLocation locations[16];
+    unsigned int count = 0;
+    for (unsigned int package = 0; package < 2; ++package)
+        for (unsigned int core = 0; core < 4; ++core)
+            for (unsigned int thread = 0; thread < 2; ++thread)
+                locations[count++] = { package, core, thread };
+    unsigned int order[16];
+
+    // first threads of main package, first threads of other package, SMT threads of main package, other SMT threads
+    EXPECT_EQ(orderProcessorsByTopology(locations, count, 1, order), 16);
+    const unsigned int expectedOrder[16] = { 8, 10, 12, 14, 0, 2, 4, 6, 9, 11, 13, 15, 1, 3, 5, 7 };
+    for (unsigned int i = 0; i < 16; ++i)
+        EXPECT_EQ(order[i], expectedOrder[i]);
+
+    // SMT siblings of tick processor (position 1) and contract processor (position 2) are left out
+    EXPECT_EQ(orderProcessorsByTopology(locations, count, 1, order, true), 14);
+    const unsigned int expectedOrderIdle[14] = { 8, 10, 12, 14, 0, 2, 4, 6, 9, 15, 1, 3, 5, 7 };
+    for (unsigned int i = 0; i < 14; ++i)
+        EXPECT_EQ(order[i], expectedOrderIdle[i]);
+
+    // siblings are used if too few processors would remain
+    EXPECT_EQ(orderProcessorsByTopology(locations, 4, 0, order, true), 4);
+    const unsigned int expectedOrderFew[4] = { 0, 2, 1, 3 };
+    for (unsigned int i = 0; i < 4; ++i)
+        EXPECT_EQ(order[i], expectedOrderFew[i]);
+
+    // without SMT and single package, the enumeration order is kept
+    for (unsigned int i = 0; i < 8; ++i)
+        locations[i] = { 0, 7 - i, 0 };
+    EXPECT_EQ(orderProcessorsByTopology(locations, 8, 0, order, true), 8);
+    for (unsigned int i = 0; i < 8; ++i)
+        EXPECT_EQ(order[i], i);
+}
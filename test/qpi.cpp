@@ -3,6 +3,10 @@
 #include "contract_testing.h"
 
 #include <type_traits>
+#include <thread>
+#include <vector>
+#include <random>
+#include <chrono>
 
 // changing offset simulates changed computor set with changed epoch
 void initComputors(unsigned short computorIdOffset)
@@ -699,6 +703,22 @@ TEST(TestCoreQPI, ProposalAndVotingByShareholdersTestSorting)
 }
 
 // Test internal class ProposalWithAllVoteData that stores valid proposals along with its votes
+// Check countOptionVotes() against the histogram computed with getVoteValue()
+template <typename ProposalT, QPI::uint32 numVoters>
+void expectOptionVoteCountsMatch(const QPI::ProposalWithAllVoteData<ProposalT, numVoters>& pwav)
+{
+    QPI::uint32 expected[8] = { 0 }, counts[8] = { 0 };
+    for (QPI::uint32 i = 0; i < numVoters; ++i)
+    {
+        QPI::sint64 value = pwav.getVoteValue(i);
+        if (value != QPI::NO_VOTE_VALUE)
+            ++expected[value];
+    }
+    pwav.countOptionVotes(counts);
+    for (int i = 0; i < 8; ++i)
+        EXPECT_EQ(counts[i], expected[i]);
+}
+
 template <typename ProposalT, QPI::uint32 numVoters>
 void testProposalWithAllVoteDataOptionVotes(
     QPI::ProposalWithAllVoteData<ProposalT, numVoters>& pwav,
@@ -737,11 +757,17 @@ void testProposalWithAllVoteDataOptionVotes(
             EXPECT_TRUE(pwav.setVoteValue(i, (j + i) % numOptions));
         for (QPI::uint32 i = 0; i < numVoters; ++i)
             EXPECT_EQ(pwav.getVoteValue(i), (j + i) % numOptions);
+        expectOptionVoteCountsMatch(pwav);
 
         for (QPI::uint32 i = 0; i < numVoters; ++i)
             EXPECT_TRUE(pwav.setVoteValue(i, (j + numVoters - i) % numOptions));
         for (QPI::uint32 i = 0; i < numVoters; ++i)
             EXPECT_EQ(pwav.getVoteValue(i), (j + numVoters - i) % numOptions);
+
+        // some voters without vote
+        for (QPI::uint32 i = j; i < numVoters; i += 5)
+            EXPECT_TRUE(pwav.setVoteValue(i, QPI::NO_VOTE_VALUE));
+        expectOptionVoteCountsMatch(pwav);
     }
 
     // clear vote
@@ -972,6 +998,57 @@ TEST(TestCoreQPI, ProposalWithAllVoteDataYesNoProposals)
     EXPECT_FALSE(proposal.checkValidity());
 }
 
+// Measure computing the option vote histogram of a proposal with a vote of every computor with countOptionVotes()
+// compared to calling getVoteValue() for each vote (as done in getVotingSummary() before)
+template <typename ProposalT>
+static void benchmarkCountOptionVotes(const char* description, QPI::uint16 proposalType, QPI::sint64 numOptions)
+{
+    typedef QPI::ProposalWithAllVoteData<ProposalT, NUMBER_OF_COMPUTORS> ProposalWithVotesT;
+    ProposalWithVotesT* pwav = new ProposalWithVotesT;
+    ProposalT proposal;
+    QPI::setMemory(proposal, 0);
+    proposal.type = proposalType;
+    EXPECT_TRUE(pwav->set(proposal));
+    std::mt19937_64 gen(42);
+    for (QPI::uint32 i = 0; i < NUMBER_OF_COMPUTORS; ++i)
+    {
+        const QPI::sint64 value = gen() % (numOptions + 1);
+        EXPECT_TRUE(pwav->setVoteValue(i, (value == numOptions) ? QPI::NO_VOTE_VALUE : value));
+    }
+
+    constexpr int repetitions = 10000;
+    QPI::uint32 expected[8] = { 0 }, counts[8] = { 0 };
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repetitions; ++r)
+    {
+        for (QPI::uint32 i = 0; i < NUMBER_OF_COMPUTORS; ++i)
+        {
+            QPI::sint64 value = pwav->getVoteValue(i);
+            if (value != QPI::NO_VOTE_VALUE && value >= 0 && value < numOptions)
+                ++expected[value];
+        }
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repetitions; ++r)
+        pwav->countOptionVotes(counts);
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < 8; ++i)
+        EXPECT_EQ(counts[i], expected[i]);
+    std::cout << description << ": getVoteValue() loop " << std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count()
+        << " us, countOptionVotes() " << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+        << " us (" << repetitions << " summaries of " << NUMBER_OF_COMPUTORS << " votes)" << std::endl;
+
+    delete pwav;
+}
+
+TEST(TestCoreQPI, ProposalVotingSummaryPerformance)
+{
+    benchmarkCountOptionVotes<QPI::ProposalDataYesNo>("[VotingSummaryPerformance] ProposalDataYesNo", QPI::ProposalTypes::YesNo, 2);
+    benchmarkCountOptionVotes<QPI::ProposalDataV1<false>>("[VotingSummaryPerformance] ProposalDataV1<false>", QPI::ProposalTypes::MultiVariablesFourOptions, 4);
+    benchmarkCountOptionVotes<QPI::ProposalDataV1<true>>("[VotingSummaryPerformance] ProposalDataV1<true>", QPI::ProposalTypes::MultiVariablesFourOptions, 4);
+}
+
 template <typename ProposalVotingType>
 void expectNoVotes(
     const QPI::QpiContextFunctionCall& qpi,
@@ -2311,3 +2388,103 @@ TEST(TestCoreQPI, ProposalVotingV1shareholderWithoutScalarVoteSupport)
 {
     testProposalVotingShareholdersV1<false>();
 }
+
+TEST(TestCoreQPI, ContractLocalsStackPool)
+{
+    EXPECT_TRUE(initContractExec(4));
+    EXPECT_EQ(contractLocalsStackCount, 4);
+
+    // high priority gets lowest free stack, low priority skips reserved stacks
+    int stack0 = -1, stack1 = -1, stack2 = -1, stack3 = -1;
+    acquireContractLocalsStack(stack1, 1);
+    EXPECT_EQ(stack1, 1);
+    acquireContractLocalsStack(stack0);
+    EXPECT_EQ(stack0, 0);
+    acquireContractLocalsStack(stack2, 1);
+    EXPECT_EQ(stack2, 2);
+    EXPECT_TRUE(isContractLocalsStackInUse(0));
+    EXPECT_TRUE(isContractLocalsStackInUse(2));
+    EXPECT_FALSE(isContractLocalsStackInUse(3));
+    acquireContractLocalsStack(stack3, 1);
+    EXPECT_EQ(stack3, 3);
+
+    // low priority waiters get stacks in order of their requests
+    std::vector<int> order;
+    volatile char orderLock = 0;
+    auto waiter = [&](int id)
+    {
+        int stack = -1;
+        acquireContractLocalsStack(stack, 1);
+        ACQUIRE(orderLock);
+        order.push_back(id);
+        RELEASE(orderLock);
+        releaseContractLocalsStack(stack);
+    };
+    std::thread t1(waiter, 1);
+    while (contractLocalsStackNextTicket < 1)
+        _mm_pause();
+    std::thread t2(waiter, 2);
+    while (contractLocalsStackNextTicket < 2)
+        _mm_pause();
+    EXPECT_EQ(contractLocalsStackLockWaitingCount, 2);
+
+    // released reserved stack is not used by low priority waiters
+    releaseContractLocalsStack(stack0);
+    EXPECT_EQ(stack0, -1);
+    EXPECT_EQ(contractLocalsStackLockWaitingCount, 2);
+
+    releaseContractLocalsStack(stack2);
+    t1.join();
+    t2.join();
+    ASSERT_EQ(order.size(), 2);
+    EXPECT_EQ(order[0], 1);
+    EXPECT_EQ(order[1], 2);
+    EXPECT_EQ(contractLocalsStackLockWaitingCount, 0);
+    EXPECT_EQ(contractLocalsStackLockWaitingCountMax, 2);
+
+    releaseContractLocalsStack(stack1);
+    releaseContractLocalsStack(stack3);
+    for (unsigned int i = 0; i < contractLocalsStackCount; ++i)
+        EXPECT_FALSE(isContractLocalsStackInUse(i));
+
+    deinitContractExec();
+}
+
+template <typename T, QPI::uint64 N>
+static void testK12Batch(const QpiContextUserProcedureCall& qpi, std::mt19937_64& gen)
+{
+    QPI::Array<T, N> data;
+    for (QPI::uint64 i = 0; i < N; ++i)
+    {
+        T value;
+        for (unsigned int j = 0; j < sizeof(T); ++j)
+            ((unsigned char*)&value)[j] = (unsigned char)gen();
+        data.set(i, value);
+    }
+
+    // full array, and a count that leaves elements not hashed with the multi-lane kernel
+    for (QPI::uint64 count : { N, N - 3 })
+    {
+        QPI::Array<QPI::id, N> digests;
+        digests.setAll(QPI::NULL_ID);
+        qpi.K12Batch(data, digests, count);
+        for (QPI::uint64 i = 0; i < N; ++i)
+            EXPECT_EQ(digests.get(i), (i < count) ? qpi.K12(data.get(i)) : QPI::NULL_ID);
+    }
+}
+
+TEST(TestCoreQPI, K12BatchAndHash64)
+{
+    QpiContextUserProcedureCall qpi(0, QPI::id(1, 2, 3, 4), 123);
+    std::mt19937_64 gen(42);
+
+    testK12Batch<QPI::uint64, 32>(qpi, gen);
+    testK12Batch<QPI::id, 64>(qpi, gen);
+    testK12Batch<QPI::Array<QPI::id, 2>, 32>(qpi, gen);
+    testK12Batch<QPI::Array<QPI::uint64, 16>, 32>(qpi, gen);
+    testK12Batch<QPI::Array<QPI::id, 8>, 16>(qpi, gen);
+
+    const QPI::id someId(1, 2, 3, 4);
+    EXPECT_EQ(qpi.hash64(someId), QPI::FastHashFunction<QPI::id>::hash(someId));
+    EXPECT_EQ(qpi.hash64(QPI::uint64(0x0123456789abcdefull)), 0xdb222d677489a9fcull);
+}
@@ -905,6 +905,23 @@ TEST(TestCoreQPI, CollectionOnePovMultiElements)
     testCollectionOnePovMultiElements<128>(1, 1);
 }
 
+TEST(TestCoreQPI, CollectionReclaimRemovedSlots)
+{
+    // with reclaimRemovedSlots, the slot of a pov is reclaimed on removal of its last element (without cleanup())
+    using ReclaimingCollection = QPI::Collection<int, 128, false, true>;
+    ReclaimingCollection* coll = new ReclaimingCollection;
+    ReclaimingCollection* resetColl = new ReclaimingCollection;
+    coll->reset();
+    resetColl->reset();
+    for (int i = 0; i < 20; ++i)
+        EXPECT_NE(coll->add(QPI::id(i % 5, 0, 0, 0), i, i), QPI::NULL_INDEX);
+    while (coll->population())
+        coll->remove(coll->population() - 1);
+    EXPECT_EQ(memcmp(coll, resetColl, sizeof(*coll)), 0);
+    delete coll;
+    delete resetColl;
+}
+
 TEST(TestCoreQPI, CollectionOnePovMultiElementsSamePrioOrder)
 {
     constexpr unsigned long long capacity = 16;
@@ -1447,6 +1464,74 @@ TEST(TestCoreQPI, CollectionReplaceElements)
     }
 }
 
+TEST(TestCoreQPI, CollectionElementIndexByPriority)
+{
+    // use collection as multimap: pov = user, priority = unique key per user
+    QPI::Collection<QPI::uint64, 512> coll;
+    coll.reset();
+
+    const int numUsers = 16;
+    const int keysPerUser = 20;
+    for (int user = 0; user < numUsers; user++)
+    {
+        QPI::id pov(user, 7, 8, 9);
+        for (int key = 0; key < keysPerUser; key++)
+        {
+            // interleave insertion order and skip odd keys for odd users
+            const int k = (key * 7) % keysPerUser;
+            if (user % 2 && k % 2)
+                continue;
+            coll.add(pov, user * 1000 + k, k * 3);
+        }
+    }
+    checkCollectionValidState(coll, numUsers);
+
+    for (int user = 0; user < numUsers; user++)
+    {
+        QPI::id pov(user, 7, 8, 9);
+        for (int k = -1; k <= keysPerUser * 3; k++)
+        {
+            QPI::sint64 idx = coll.elementIndex(pov, k);
+            if (k >= 0 && k % 3 == 0 && k / 3 < keysPerUser && !(user % 2 && (k / 3) % 2))
+            {
+                ASSERT_NE(idx, QPI::NULL_INDEX);
+                EXPECT_EQ(coll.pov(idx), pov);
+                EXPECT_EQ(coll.priority(idx), k);
+                EXPECT_EQ(coll.element(idx), user * 1000 + k / 3);
+            }
+            else
+            {
+                EXPECT_EQ(idx, QPI::NULL_INDEX);
+            }
+        }
+    }
+
+    // unknown pov
+    EXPECT_EQ(coll.elementIndex(QPI::id(numUsers, 7, 8, 9), 0), QPI::NULL_INDEX);
+
+    // in-place update of found element
+    QPI::sint64 idx = coll.elementIndex(QPI::id(2, 7, 8, 9), 15);
+    coll.replace(idx, 42);
+    EXPECT_EQ(coll.element(coll.elementIndex(QPI::id(2, 7, 8, 9), 15)), 42);
+
+    // removed key is not found anymore, other keys of the pov still are
+    coll.remove(idx);
+    EXPECT_EQ(coll.elementIndex(QPI::id(2, 7, 8, 9), 15), QPI::NULL_INDEX);
+    idx = coll.elementIndex(QPI::id(2, 7, 8, 9), 18);
+    ASSERT_NE(idx, QPI::NULL_INDEX);
+    EXPECT_EQ(coll.element(idx), 2006);
+
+    // pov that became empty
+    for (int k = 0; k < keysPerUser; k++)
+    {
+        idx = coll.elementIndex(QPI::id(3, 7, 8, 9), k * 3);
+        if (idx != QPI::NULL_INDEX)
+            coll.remove(idx);
+    }
+    EXPECT_EQ(coll.population(QPI::id(3, 7, 8, 9)), 0);
+    EXPECT_EQ(coll.elementIndex(QPI::id(3, 7, 8, 9), 0), QPI::NULL_INDEX);
+}
+
 template <unsigned long long capacity>
 void testCollectionPseudoRandom(int povs, int seed, bool povCollisions, int cleanups, int percentAdd = 70, int percentAddSecondHalf = -1)
 {
@@ -1714,3 +1799,84 @@ TEST(TestCoreQPI, CollectionPerformance)
         std::cout << "* [CollectionPerformance] Total:\t\t" << total << " ms\n";
     }
 }
+
+template <bool selfBalancing>
+std::vector<QPI::uint64> getCollectionIterationOrder(const QPI::Collection<QPI::uint64, 1024, selfBalancing>& coll, const QPI::id& pov)
+{
+    std::vector<QPI::uint64> values;
+    for (QPI::sint64 idx = coll.headIndex(pov); idx != QPI::NULL_INDEX; idx = coll.nextElementIndex(idx))
+    {
+        values.push_back(coll.element(idx));
+        if (coll.nextElementIndex(idx) != QPI::NULL_INDEX)
+        {
+            EXPECT_GE(coll.priority(idx), coll.priority(coll.nextElementIndex(idx)));
+        }
+    }
+    std::vector<QPI::uint64> reverseValues;
+    for (QPI::sint64 idx = coll.tailIndex(pov); idx != QPI::NULL_INDEX; idx = coll.prevElementIndex(idx))
+    {
+        reverseValues.insert(reverseValues.begin(), coll.element(idx));
+    }
+    EXPECT_EQ(values, reverseValues);
+    EXPECT_EQ(values.size(), coll.population(pov));
+    return values;
+}
+
+TEST(TestCoreQPI, CollectionSelfBalancingSameOrder)
+{
+    auto* coll = new QPI::Collection<QPI::uint64, 1024>();
+    auto* balancedColl = new QPI::Collection<QPI::uint64, 1024, true>();
+    EXPECT_EQ(sizeof(*coll), sizeof(*balancedColl));
+    EXPECT_TRUE(commonBuffers.init(1, sizeof(*balancedColl)));
+    std::mt19937_64 gen64(42);
+
+    // increasing, decreasing, constant, and random priorities (with duplicates), each in own pov
+    for (int mode = 0; mode < 4; ++mode)
+    {
+        coll->reset();
+        balancedColl->reset();
+        for (QPI::uint64 i = 0; i < 1000; ++i)
+        {
+            const QPI::id pov(i % 3, 0, 0, 0);
+            QPI::sint64 priority;
+            switch (mode)
+            {
+            case 0: priority = i / 2; break;
+            case 1: priority = -(QPI::sint64)(i / 2); break;
+            case 2: priority = 7; break;
+            default: priority = gen64() % 50; break;
+            }
+            EXPECT_EQ(coll->add(pov, i, priority), balancedColl->add(pov, i, priority));
+
+            // remove some elements from the middle of the queue
+            if (i % 10 == 9)
+            {
+                QPI::sint64 idx = coll->headIndex(pov);
+                for (int j = 0; j < 5 && coll->nextElementIndex(idx) != QPI::NULL_INDEX; ++j)
+                    idx = coll->nextElementIndex(idx);
+                QPI::sint64 balancedIdx = balancedColl->headIndex(pov);
+                for (int j = 0; j < 5 && balancedColl->nextElementIndex(balancedIdx) != QPI::NULL_INDEX; ++j)
+                    balancedIdx = balancedColl->nextElementIndex(balancedIdx);
+                EXPECT_EQ(coll->element(idx), balancedColl->element(balancedIdx));
+                coll->remove(idx);
+                balancedColl->remove(balancedIdx);
+            }
+        }
+
+        for (QPI::uint64 p = 0; p < 3; ++p)
+        {
+            const QPI::id pov(p, 0, 0, 0);
+            EXPECT_EQ(getCollectionIterationOrder(*coll, pov), getCollectionIterationOrder(*balancedColl, pov));
+            EXPECT_EQ(coll->headIndex(pov, 100) == QPI::NULL_INDEX, balancedColl->headIndex(pov, 100) == QPI::NULL_INDEX);
+            if (coll->headIndex(pov, 100) != QPI::NULL_INDEX)
+            {
+                EXPECT_EQ(coll->element(coll->headIndex(pov, 100)), balancedColl->element(balancedColl->headIndex(pov, 100)));
+                EXPECT_EQ(coll->element(coll->tailIndex(pov, 100)), balancedColl->element(balancedColl->tailIndex(pov, 100)));
+            }
+        }
+    }
+
+    commonBuffers.deinit();
+    delete coll;
+    delete balancedColl;
+}
@@ -12,6 +12,8 @@
 #include <set>
 #include <random>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 
 
 // New KeyT, ValueT combinations for testing need to implement the following functions:
@@ -167,6 +169,70 @@ TEST(NonTypedQPIHashMapTest, TestHashFunction)
 	}
 }
 
+TEST(NonTypedQPIHashMapTest, TestFastHashFunction)
+{
+	// Results must be the same on all nodes (and after code changes, because hash maps may be stored).
+	EXPECT_EQ(QPI::FastHashFunction<QPI::uint64>::hash(0), 0x3230365dd199e1c1ull);
+	EXPECT_EQ(QPI::FastHashFunction<QPI::uint64>::hash(0x0123456789abcdefull), 0xdb222d677489a9fcull);
+	EXPECT_EQ(QPI::FastHashFunction<QPI::uint16>::hash(1), 0x49f08123ce313135ull);
+	EXPECT_EQ(QPI::FastHashFunction<QPI::bit_1024>::hash(QPI::bit_1024()), 0xe092c278016a0292ull);
+
+	// same for id as HashFunction
+	auto randomId = QPI::id::randomValue();
+	EXPECT_EQ(QPI::FastHashFunction<QPI::id>::hash(randomId), randomId.u64._0);
+
+	// different hashes for 0...N and well-distributed low bits used for bucket index
+	std::unordered_set<QPI::uint64> hashesSoFar;
+	std::set<QPI::uint64> bucketsSoFar;
+	for (int i = 0; i < 1000; ++i)
+	{
+		QPI::uint64 hashRes = QPI::FastHashFunction<int>::hash(i);
+		EXPECT_FALSE(hashesSoFar.contains(hashRes));
+		hashesSoFar.insert(hashRes);
+		bucketsSoFar.insert(hashRes & 1023);
+	}
+	EXPECT_GT(bucketsSoFar.size(), 550);
+
+	// keys with size that isn't multiple of 8 (zero-padded last word mustn't collide with shorter key)
+	struct Key12
+	{
+		QPI::uint64 a;
+		QPI::uint32 b;
+	};
+	hashesSoFar.clear();
+	for (QPI::uint32 i = 0; i < 1000; ++i)
+	{
+		Key12 key;
+		memset(&key, 0, sizeof(key));
+		key.a = i / 10;
+		key.b = i % 10;
+		QPI::uint64 hashRes = QPI::FastHashFunction<Key12>::hash(key);
+		EXPECT_FALSE(hashesSoFar.contains(hashRes));
+		hashesSoFar.insert(hashRes);
+	}
+	EXPECT_NE(QPI::FastHashFunction<QPI::uint32>::hash(7), QPI::FastHashFunction<QPI::uint64>::hash(7));
+}
+
+TEST(NonTypedQPIHashMapTest, TestHashMapWithFastHashFunction)
+{
+	constexpr QPI::uint64 capacity = 256;
+	auto* hashMap = new QPI::HashMap<QPI::uint64, QPI::uint64, capacity, QPI::FastHashFunction<QPI::uint64>>();
+	hashMap->reset();
+	for (QPI::uint64 i = 0; i < 200; ++i)
+	{
+		EXPECT_NE(hashMap->set(i * 1000, i), QPI::NULL_INDEX);
+	}
+	EXPECT_EQ(hashMap->population(), 200);
+	for (QPI::uint64 i = 0; i < 200; ++i)
+	{
+		QPI::uint64 value;
+		EXPECT_TRUE(hashMap->get(i * 1000, value));
+		EXPECT_EQ(value, i);
+	}
+	EXPECT_FALSE(hashMap->contains(1));
+	delete hashMap;
+}
+
 TYPED_TEST_P(QPIHashMapTest, TestCreation)
 {
 	constexpr QPI::uint64 capacity = 2;
@@ -454,6 +520,150 @@ TEST(NonTypedQPIHashMapTest, TestCleanupLargeMapSameHashes)
 	commonBuffers.deinit();
 }
 
+TEST(NonTypedQPIHashMapTest, TestRemoveReclaimsSlots)
+{
+	constexpr QPI::uint64 capacity = 1024;
+	auto* hashSet = new QPI::HashSet<QPI::uint64, capacity, QPI::FastHashFunction<QPI::uint64>, true>();
+	auto* resetHashSet = new QPI::HashSet<QPI::uint64, capacity, QPI::FastHashFunction<QPI::uint64>, true>();
+	hashSet->reset();
+	resetHashSet->reset();
+	std::mt19937_64 gen64(123);
+
+	std::vector<QPI::uint64> keys(400);
+	for (auto& key : keys)
+	{
+		key = gen64();
+		EXPECT_NE(hashSet->add(key), QPI::NULL_INDEX);
+	}
+
+	// remove half of the keys while iterating: removal doesn't move elements, so no element is skipped
+	QPI::uint64 visited = 0;
+	for (QPI::sint64 idx = hashSet->nextElementIndex(QPI::NULL_INDEX); idx != QPI::NULL_INDEX; idx = hashSet->nextElementIndex(idx))
+	{
+		if (visited++ % 2)
+		{
+			hashSet->removeByIndex(idx);
+		}
+	}
+	EXPECT_EQ(visited, keys.size());
+	EXPECT_EQ(hashSet->population(), keys.size() / 2);
+	for (const auto& key : keys)
+	{
+		const QPI::sint64 idx = hashSet->getElementIndex(key);
+		if (idx != QPI::NULL_INDEX)
+		{
+			EXPECT_EQ(hashSet->key(idx), key);
+		}
+	}
+
+	// removing all keys (in random order) reclaims all slots without cleanup()
+	std::shuffle(keys.begin(), keys.end(), gen64);
+	for (const auto& key : keys)
+	{
+		hashSet->remove(key);
+		EXPECT_FALSE(hashSet->contains(key));
+	}
+	EXPECT_EQ(hashSet->population(), 0);
+	EXPECT_EQ(memcmp(hashSet, resetHashSet, sizeof(*hashSet)), 0);
+
+	delete hashSet;
+	delete resetHashSet;
+
+	// by default, removed slots stay marked until cleanup() (content of existing contract states must not change)
+	auto* defaultHashSet = new QPI::HashSet<QPI::uint64, capacity, QPI::FastHashFunction<QPI::uint64>>();
+	auto* resetDefaultHashSet = new QPI::HashSet<QPI::uint64, capacity, QPI::FastHashFunction<QPI::uint64>>();
+	defaultHashSet->reset();
+	resetDefaultHashSet->reset();
+	defaultHashSet->add(keys[0]);
+	defaultHashSet->remove(keys[0]);
+	EXPECT_EQ(defaultHashSet->population(), 0);
+	EXPECT_NE(memcmp(defaultHashSet, resetDefaultHashSet, sizeof(*defaultHashSet)), 0);
+	delete defaultHashSet;
+	delete resetDefaultHashSet;
+}
+
+TEST(NonTypedQPIHashMapTest, TestBatchOperations)
+{
+	constexpr QPI::uint64 capacity = 256;
+	auto* hashMap = new QPI::HashMap<QPI::uint64, QPI::uint64, capacity>();
+	auto* refHashMap = new QPI::HashMap<QPI::uint64, QPI::uint64, capacity>();
+	auto* hashSet = new QPI::HashSet<QPI::uint64, capacity>();
+	auto* refHashSet = new QPI::HashSet<QPI::uint64, capacity>();
+	auto* keys = new QPI::Array<QPI::uint64, 64>();
+	auto* values = new QPI::Array<QPI::uint64, 64>();
+	auto* elementIndices = new QPI::Array<QPI::sint64, 64>();
+	hashMap->reset();
+	refHashMap->reset();
+	hashSet->reset();
+	refHashSet->reset();
+	std::mt19937_64 gen64(42);
+
+	for (int round = 0; round < 10; ++round)
+	{
+		// keys with duplicates, some already contained
+		const QPI::uint64 count = (round == 0) ? 64 : gen64() % 65;
+		for (QPI::uint64 i = 0; i < 64; ++i)
+		{
+			keys->set(i, gen64() % 300);
+			values->set(i, gen64());
+		}
+
+		// set/add: same result and memory as single-key functions
+		QPI::uint64 expectedSetCount = 0, expectedAddCount = 0;
+		for (QPI::uint64 i = 0; i < count; ++i)
+		{
+			expectedSetCount += (refHashMap->set(keys->get(i), values->get(i)) != QPI::NULL_INDEX);
+			expectedAddCount += (refHashSet->add(keys->get(i)) != QPI::NULL_INDEX);
+		}
+		EXPECT_EQ(hashMap->setMany(*keys, *values, count), expectedSetCount);
+		EXPECT_EQ(hashSet->addMany(*keys, count), expectedAddCount);
+		EXPECT_EQ(memcmp(hashMap, refHashMap, sizeof(*hashMap)), 0);
+		EXPECT_EQ(memcmp(hashSet, refHashSet, sizeof(*hashSet)), 0);
+
+		// lookup
+		for (QPI::uint64 i = 0; i < 64; ++i)
+			keys->set(i, gen64() % 300);
+		QPI::uint64 expectedFound = 0;
+		for (QPI::uint64 i = 0; i < 64; ++i)
+			expectedFound += refHashMap->contains(keys->get(i));
+		EXPECT_EQ(hashMap->getElementIndices(*keys, *elementIndices), expectedFound);
+		for (QPI::uint64 i = 0; i < 64; ++i)
+			EXPECT_EQ(elementIndices->get(i), hashMap->getElementIndex(keys->get(i)));
+		values->setAll(0);
+		EXPECT_EQ(hashMap->getMany(*keys, *values), expectedFound);
+		for (QPI::uint64 i = 0; i < 64; ++i)
+		{
+			QPI::uint64 value = 0;
+			refHashMap->get(keys->get(i), value);
+			EXPECT_EQ(values->get(i), value);
+		}
+		EXPECT_EQ(hashSet->getElementIndices(*keys, *elementIndices), expectedFound);
+		for (QPI::uint64 i = 0; i < 64; ++i)
+			EXPECT_EQ(elementIndices->get(i), hashSet->getElementIndex(keys->get(i)));
+
+		// remove
+		const QPI::uint64 removeCount = gen64() % 33;
+		QPI::uint64 expectedRemoved = 0;
+		for (QPI::uint64 i = 0; i < removeCount; ++i)
+		{
+			expectedRemoved += (refHashMap->removeByKey(keys->get(i)) != QPI::NULL_INDEX);
+			refHashSet->remove(keys->get(i));
+		}
+		EXPECT_EQ(hashMap->removeMany(*keys, removeCount), expectedRemoved);
+		EXPECT_EQ(hashSet->removeMany(*keys, removeCount), expectedRemoved);
+		EXPECT_EQ(memcmp(hashMap, refHashMap, sizeof(*hashMap)), 0);
+		EXPECT_EQ(memcmp(hashSet, refHashSet, sizeof(*hashSet)), 0);
+	}
+
+	delete hashMap;
+	delete refHashMap;
+	delete hashSet;
+	delete refHashSet;
+	delete keys;
+	delete values;
+	delete elementIndices;
+}
+
 TYPED_TEST_P(QPIHashMapTest, TestReplace)
 {
 	constexpr QPI::uint64 capacity = 8;
@@ -1007,3 +1217,48 @@ TEST(QPIHashMapTest, HashSetPerfTest)
 
 	// measure lookups/seconds -> O(1) if population is sparse -> O(N) if population is high with N = max population since last cleanup
 }
+
+struct HashFunctionPerfKey
+{
+	QPI::id owner;
+	QPI::uint64 assetName;
+};
+
+template <typename HashFunc, typename KeyT>
+static QPI::uint64 perfTestHashFunction(const std::vector<KeyT>& keys, const char* description)
+{
+	QPI::uint64 checksum = 0;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (int rep = 0; rep < 10; ++rep)
+	{
+		for (const auto& key : keys)
+		{
+			checksum += HashFunc::hash(key);
+		}
+	}
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << description << ": " << double(nanoseconds) / (10 * keys.size()) << " ns/hash" << std::endl;
+	return checksum;
+}
+
+TEST(QPIHashMapTest, HashFunctionPerfTest)
+{
+	std::mt19937_64 gen64(42);
+	constexpr int keyCount = 100000;
+
+	std::vector<QPI::uint64> intKeys(keyCount);
+	std::vector<HashFunctionPerfKey> structKeys(keyCount);
+	for (int i = 0; i < keyCount; ++i)
+	{
+		intKeys[i] = gen64();
+		structKeys[i].owner = QPI::id(gen64(), gen64(), gen64(), gen64());
+		structKeys[i].assetName = gen64();
+	}
+
+	QPI::uint64 checksum = 0;
+	checksum += perfTestHashFunction<QPI::HashFunction<QPI::uint64>>(intKeys, "HashFunction<uint64>");
+	checksum += perfTestHashFunction<QPI::FastHashFunction<QPI::uint64>>(intKeys, "FastHashFunction<uint64>");
+	checksum += perfTestHashFunction<QPI::HashFunction<HashFunctionPerfKey>>(structKeys, "HashFunction<id+uint64>");
+	checksum += perfTestHashFunction<QPI::FastHashFunction<HashFunctionPerfKey>>(structKeys, "FastHashFunction<id+uint64>");
+	EXPECT_NE(checksum, 0);
+}
@@ -0,0 +1,186 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/contract_core/pre_qpi_def.h"
+#include "../src/contracts/qpi.h"
+#include "../src/common_buffers.h"
+#include "../src/contract_core/qpi_collection_impl.h"
+#include "../src/contract_core/qpi_order_book_impl.h"
+#include "../src/contract_core/qpi_trivial_impl.h"
+
+#include <map>
+#include <deque>
+#include <random>
+
+typedef QPI::OrderBook<QPI::uint64, 1024, 256> TestOrderBook;
+
+// Reference: per pov map of priority -> FIFO queue of (value, quantity), best level is highest priority
+typedef std::map<QPI::sint64, std::deque<std::pair<QPI::uint64, QPI::sint64>>, std::greater<QPI::sint64>> ReferenceSide;
+
+static void checkSide(const TestOrderBook& book, const QPI::id& pov, const ReferenceSide& reference)
+{
+    EXPECT_EQ(book.populationOfLevels(pov), reference.size());
+    QPI::sint64 levelIdx = book.bestLevelIndex(pov);
+    for (const auto& [priority, queue] : reference)
+    {
+        ASSERT_NE(levelIdx, QPI::NULL_INDEX);
+        EXPECT_EQ(book.levelPriority(levelIdx), priority);
+        EXPECT_EQ(book.levelIndex(pov, priority), levelIdx);
+        EXPECT_EQ(book.levelOrderCount(levelIdx), queue.size());
+
+        QPI::sint64 quantity = 0;
+        QPI::sint64 orderIdx = book.firstOrderIndex(levelIdx);
+        for (const auto& [value, orderQuantity] : queue)
+        {
+            ASSERT_TRUE(book.isOrder(orderIdx));
+            EXPECT_EQ(book.order(orderIdx), value);
+            EXPECT_EQ(book.quantity(orderIdx), orderQuantity);
+            EXPECT_EQ(book.priority(orderIdx), priority);
+            EXPECT_TRUE(book.pov(orderIdx) == pov);
+            quantity += orderQuantity;
+            orderIdx = book.nextOrderIndex(orderIdx);
+        }
+        EXPECT_EQ(orderIdx, QPI::NULL_INDEX);
+        EXPECT_EQ(book.levelQuantity(levelIdx), quantity);
+
+        levelIdx = book.nextLevelIndex(levelIdx);
+    }
+    EXPECT_EQ(levelIdx, QPI::NULL_INDEX);
+}
+
+TEST(TestCoreQPIOrderBook, PriceLevelsAndFifo)
+{
+    TestOrderBook* book = new TestOrderBook();
+    book->reset();
+    const QPI::id pov(1, 2, 3, 4);
+
+    EXPECT_EQ(book->bestLevelIndex(pov), QPI::NULL_INDEX);
+    EXPECT_EQ(book->add(pov, 1, 100, 0), QPI::NULL_INDEX);
+    EXPECT_EQ(book->population(), 0);
+
+    // two orders at same level keep FIFO order, better level comes first
+    const QPI::sint64 o1 = book->add(pov, 1, 100, 10);
+    const QPI::sint64 o2 = book->add(pov, 2, 100, 20);
+    const QPI::sint64 o3 = book->add(pov, 3, 110, 5);
+    EXPECT_EQ(book->population(), 3);
+    EXPECT_EQ(book->populationOfLevels(), 2);
+    ReferenceSide reference;
+    reference[100] = { {1, 10}, {2, 20} };
+    reference[110] = { {3, 5} };
+    checkSide(*book, pov, reference);
+
+    // partial fill keeps position, full removal of best level makes next level best
+    EXPECT_TRUE(book->setQuantity(o1, 4));
+    reference[100][0].second = 4;
+    checkSide(*book, pov, reference);
+    EXPECT_EQ(book->remove(o3), QPI::NULL_INDEX);
+    reference.erase(110);
+    checkSide(*book, pov, reference);
+    EXPECT_EQ(book->remove(o1), o2);
+    reference[100].pop_front();
+    checkSide(*book, pov, reference);
+    EXPECT_FALSE(book->isOrder(o1));
+    EXPECT_FALSE(book->setQuantity(o1, 4));
+    EXPECT_EQ(book->remove(o1), QPI::NULL_INDEX);
+
+    // freed slot is reused, order indices of other orders are stable
+    const QPI::sint64 o4 = book->add(pov, 4, 90, 1);
+    EXPECT_TRUE(o4 == o1 || o4 == o3);
+    reference[90] = { {4, 1} };
+    checkSide(*book, pov, reference);
+    EXPECT_EQ(book->order(o2), 2);
+
+    // setting quantity to 0 removes order and empty level
+    EXPECT_TRUE(book->setQuantity(o2, 0));
+    reference.erase(100);
+    checkSide(*book, pov, reference);
+    EXPECT_EQ(book->population(), 1);
+
+    book->reset();
+    EXPECT_EQ(book->population(), 0);
+    EXPECT_EQ(book->populationOfLevels(), 0);
+    EXPECT_EQ(book->bestLevelIndex(pov), QPI::NULL_INDEX);
+    delete book;
+}
+
+TEST(TestCoreQPIOrderBook, RandomOperationsMatchReference)
+{
+    TestOrderBook* book = new TestOrderBook();
+    book->reset();
+    std::mt19937_64 rnd(42);
+    const QPI::id povs[3] = { QPI::id(1, 0, 0, 0), QPI::id(2, 0, 0, 0), QPI::id(1 + 256, 0, 0, 0) };
+    std::map<int, ReferenceSide> reference;
+    std::map<QPI::uint64, QPI::sint64> orderIndexOfValue;
+    QPI::uint64 nextValue = 1;
+
+    for (int step = 0; step < 20000; ++step)
+    {
+        const int p = rnd() % 3;
+        const QPI::sint64 priority = -50 + (QPI::sint64)(rnd() % 40);
+        const int op = rnd() % 10;
+        if (op < 5 || orderIndexOfValue.empty())
+        {
+            const QPI::sint64 quantity = 1 + rnd() % 100;
+            const bool levelExists = reference[p].count(priority) != 0;
+            const QPI::sint64 orderIdx = book->add(povs[p], nextValue, priority, quantity);
+            if (book->population() == TestOrderBook::capacity() && orderIdx == QPI::NULL_INDEX)
+                continue;
+            if (!levelExists && book->populationOfLevels() == TestOrderBook::capacityOfLevels() && orderIdx == QPI::NULL_INDEX)
+                continue;
+            ASSERT_NE(orderIdx, QPI::NULL_INDEX);
+            reference[p][priority].push_back({ nextValue, quantity });
+            orderIndexOfValue[nextValue] = orderIdx;
+            ++nextValue;
+        }
+        else
+        {
+            // pick random existing order
+            auto it = orderIndexOfValue.lower_bound(rnd() % nextValue);
+            if (it == orderIndexOfValue.end())
+                it = orderIndexOfValue.begin();
+            const QPI::uint64 value = it->first;
+            const QPI::sint64 orderIdx = it->second;
+            int orderPov = 0;
+            while (!(book->pov(orderIdx) == povs[orderPov]))
+                ++orderPov;
+            auto& queue = reference[orderPov][book->priority(orderIdx)];
+            auto qit = queue.begin();
+            while (qit->first != value)
+                ++qit;
+
+            if (op < 7)
+            {
+                const QPI::sint64 newQuantity = rnd() % 50;
+                EXPECT_TRUE(book->setQuantity(orderIdx, newQuantity));
+                if (newQuantity)
+                {
+                    qit->second = newQuantity;
+                    continue;
+                }
+            }
+            else
+            {
+                const QPI::sint64 expectedNext = (qit + 1 == queue.end()) ? QPI::NULL_INDEX : orderIndexOfValue[(qit + 1)->first];
+                EXPECT_EQ(book->remove(orderIdx), expectedNext);
+            }
+            const QPI::sint64 levelPriority = book->priority(orderIdx); // 0, order is removed
+            EXPECT_EQ(levelPriority, 0);
+            const QPI::sint64 priorityOfQueue = [&]() { for (auto& [pr, q] : reference[orderPov]) if (&q == &queue) return pr; return QPI::sint64(0); }();
+            queue.erase(qit);
+            if (queue.empty())
+                reference[orderPov].erase(priorityOfQueue);
+            orderIndexOfValue.erase(it);
+        }
+
+        if (step % 1000 == 0)
+        {
+            for (int i = 0; i < 3; ++i)
+                checkSide(*book, povs[i], reference[i]);
+        }
+    }
+    for (int i = 0; i < 3; ++i)
+        checkSide(*book, povs[i], reference[i]);
+    EXPECT_EQ(book->population(), orderIndexOfValue.size());
+    delete book;
+}
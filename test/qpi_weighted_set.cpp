@@ -0,0 +1,160 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/contract_core/pre_qpi_def.h"
+#include "../src/contracts/qpi.h"
+#include "../src/common_buffers.h"
+#include "../src/contract_core/qpi_hash_map_impl.h"
+#include "../src/contract_core/qpi_weighted_set_impl.h"
+
+#include <map>
+#include <random>
+
+typedef QPI::WeightedSet<QPI::id, 256> TestWeightedSet;
+
+// Check that set matches reference and that sampling covers each key with a range of exactly its weight
+static void checkWeightedSet(const TestWeightedSet& set, const std::map<QPI::id, QPI::uint64>& reference)
+{
+    QPI::uint64 total = 0;
+    for (const auto& [key, weight] : reference)
+    {
+        EXPECT_EQ(set.weight(key), weight);
+        EXPECT_TRUE(set.contains(key));
+        total += weight;
+    }
+    EXPECT_EQ(set.population(), reference.size());
+    EXPECT_EQ(set.totalWeight(), total);
+
+    std::map<QPI::id, QPI::uint64> sampledWeights;
+    for (QPI::uint64 r = 0; r < total; r++)
+    {
+        QPI::sint64 idx = set.sample(r);
+        ASSERT_NE(idx, QPI::NULL_INDEX);
+        ASSERT_FALSE(set.isEmptySlot(idx));
+        sampledWeights[set.key(idx)]++;
+    }
+    EXPECT_EQ(sampledWeights, reference);
+}
+
+TEST(TestCoreQPIWeightedSet, AddSampleRemove)
+{
+    TestWeightedSet set;
+    set.reset();
+    EXPECT_EQ(set.population(), 0);
+    EXPECT_EQ(set.totalWeight(), 0);
+    EXPECT_EQ(set.sample(12345), QPI::NULL_INDEX);
+
+    std::map<QPI::id, QPI::uint64> reference;
+
+    // adding to existing key only accumulates weight
+    EXPECT_NE(set.add(QPI::id(1, 0, 0, 0), 3), QPI::NULL_INDEX);
+    EXPECT_EQ(set.add(QPI::id(1, 0, 0, 0), 2), set.getElementIndex(QPI::id(1, 0, 0, 0)));
+    reference[QPI::id(1, 0, 0, 0)] = 5;
+    checkWeightedSet(set, reference);
+
+    // single key always wins
+    EXPECT_EQ(set.key(set.sample(0)), QPI::id(1, 0, 0, 0));
+    EXPECT_EQ(set.key(set.sample(~0ULL)), QPI::id(1, 0, 0, 0));
+
+    // invalid weights
+    EXPECT_EQ(set.add(QPI::id(2, 0, 0, 0), 0), QPI::NULL_INDEX);
+    EXPECT_EQ(set.add(QPI::id(2, 0, 0, 0), ~0ULL), QPI::NULL_INDEX);
+    checkWeightedSet(set, reference);
+
+    for (int i = 2; i < 50; i++)
+    {
+        EXPECT_NE(set.add(QPI::id(i, 0, 0, 0), i), QPI::NULL_INDEX);
+        reference[QPI::id(i, 0, 0, 0)] = i;
+    }
+    checkWeightedSet(set, reference);
+
+    EXPECT_EQ(set.removeWeight(QPI::id(10, 0, 0, 0), 4), 6);
+    reference[QPI::id(10, 0, 0, 0)] = 6;
+    EXPECT_EQ(set.removeWeight(QPI::id(11, 0, 0, 0), 11), 0);
+    reference.erase(QPI::id(11, 0, 0, 0));
+    EXPECT_EQ(set.removeWeight(QPI::id(100, 0, 0, 0), 1), 0);
+    EXPECT_NE(set.removeByKey(QPI::id(12, 0, 0, 0)), QPI::NULL_INDEX);
+    reference.erase(QPI::id(12, 0, 0, 0));
+    EXPECT_EQ(set.removeByKey(QPI::id(12, 0, 0, 0)), QPI::NULL_INDEX);
+    EXPECT_FALSE(set.contains(QPI::id(12, 0, 0, 0)));
+    EXPECT_EQ(set.weight(QPI::id(12, 0, 0, 0)), 0);
+    checkWeightedSet(set, reference);
+
+    // cleanup moves elements and rebuilds tree
+    set.cleanup();
+    checkWeightedSet(set, reference);
+
+    // iteration
+    QPI::uint64 count = 0;
+    for (QPI::sint64 idx = set.nextElementIndex(QPI::NULL_INDEX); idx != QPI::NULL_INDEX; idx = set.nextElementIndex(idx))
+    {
+        EXPECT_EQ(set.weightAt(idx), reference[set.key(idx)]);
+        count++;
+    }
+    EXPECT_EQ(count, reference.size());
+
+    set.reset();
+    reference.clear();
+    checkWeightedSet(set, reference);
+}
+
+TEST(TestCoreQPIWeightedSet, FullSet)
+{
+    QPI::WeightedSet<QPI::uint64, 16> set;
+    set.reset();
+    for (QPI::uint64 i = 0; i < 16; i++)
+    {
+        EXPECT_NE(set.add(i, 1), QPI::NULL_INDEX);
+    }
+    EXPECT_EQ(set.add(16, 1), QPI::NULL_INDEX);
+    EXPECT_NE(set.add(3, 1), QPI::NULL_INDEX);
+    EXPECT_EQ(set.population(), 16);
+    EXPECT_EQ(set.totalWeight(), 17);
+    EXPECT_EQ(set.weight(16), 0);
+}
+
+TEST(TestCoreQPIWeightedSet, RandomOperationsMatchReference)
+{
+    std::mt19937_64 gen64(4711);
+    TestWeightedSet set;
+    set.reset();
+    std::map<QPI::id, QPI::uint64> reference;
+
+    for (int round = 0; round < 20; round++)
+    {
+        for (int op = 0; op < 200; op++)
+        {
+            const QPI::id key(gen64() % 300, 1, 2, 3);
+            const QPI::uint64 weight = gen64() % 20 + 1;
+            const int type = gen64() % 10;
+            if (type < 6)
+            {
+                if (reference.size() < set.capacity() || reference.count(key))
+                {
+                    EXPECT_NE(set.add(key, weight), QPI::NULL_INDEX);
+                    reference[key] += weight;
+                }
+            }
+            else if (type < 9)
+            {
+                const QPI::uint64 remaining = set.removeWeight(key, weight);
+                if (reference.count(key))
+                {
+                    reference[key] = (reference[key] > weight) ? reference[key] - weight : 0;
+                    if (!reference[key])
+                        reference.erase(key);
+                }
+                EXPECT_EQ(remaining, reference.count(key) ? reference[key] : 0);
+            }
+            else
+            {
+                set.removeByKey(key);
+                reference.erase(key);
+            }
+        }
+        checkWeightedSet(set, reference);
+        set.cleanupIfNeeded(10);
+        checkWeightedSet(set, reference);
+    }
+}
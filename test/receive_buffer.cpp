@@ -0,0 +1,81 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/network_core/receive_buffer.h"
+
+#include <vector>
+
+static void writeMessage(unsigned char* buffer, unsigned int size, unsigned char type, unsigned char fill)
+{
+    RequestResponseHeader* header = (RequestResponseHeader*)buffer;
+    header->checkAndSetSize(size);
+    header->setType(type);
+    header->setDejavu(0);
+    for (unsigned int i = sizeof(RequestResponseHeader); i < size; ++i)
+        buffer[i] = fill;
+}
+
+TEST(TestCoreReceiveBuffer, CompleteMessagesAndRemainder)
+{
+    unsigned char buffer[256];
+    writeMessage(buffer, 40, 1, 0x11);
+    writeMessage(buffer + 40, 8, 2, 0);
+    writeMessage(buffer + 48, 100, 3, 0x33);
+
+    // third message is incomplete
+    std::vector<unsigned char> types;
+    long long remaining = processReceiveBuffer(buffer, 48 + 30, [&](RequestResponseHeader* header) { types.push_back(header->type()); });
+    EXPECT_EQ(remaining, 30);
+    ASSERT_EQ(types.size(), 2);
+    EXPECT_EQ(types[0], 1);
+    EXPECT_EQ(types[1], 2);
+
+    // incomplete message has been moved to the beginning
+    RequestResponseHeader* header = (RequestResponseHeader*)buffer;
+    EXPECT_EQ(header->size(), 100);
+    EXPECT_EQ(header->type(), 3);
+    EXPECT_EQ(buffer[29], 0x33);
+
+    // rest of the message arrives
+    for (unsigned int i = 30; i < 100; ++i)
+        buffer[i] = 0x33;
+    types.clear();
+    remaining = processReceiveBuffer(buffer, 100, [&](RequestResponseHeader* header) { types.push_back(header->type()); });
+    EXPECT_EQ(remaining, 0);
+    ASSERT_EQ(types.size(), 1);
+    EXPECT_EQ(types[0], 3);
+
+    // incomplete header
+    types.clear();
+    remaining = processReceiveBuffer(buffer, 5, [&](RequestResponseHeader* header) { types.push_back(header->type()); });
+    EXPECT_EQ(remaining, 5);
+    EXPECT_EQ(types.size(), 0);
+}
+
+TEST(TestCoreReceiveBuffer, ProtocolViolationLeavesBufferUntouched)
+{
+    unsigned char buffer[256];
+    writeMessage(buffer, 40, 1, 0x11);
+    writeMessage(buffer + 40, 4, 2, 0);
+    for (unsigned int i = 48; i < sizeof(buffer); ++i)
+        buffer[i] = 0x55;
+    unsigned char bufferCopy[sizeof(buffer)];
+    memcpy(bufferCopy, buffer, sizeof(buffer));
+
+    // valid message followed by header with size < 8: valid message is handed on, then violation is reported
+    // without compacting the buffer (the connection is closed and the buffer may be released)
+    std::vector<unsigned char> types;
+    long long remaining = processReceiveBuffer(buffer, sizeof(buffer), [&](RequestResponseHeader* header) { types.push_back(header->type()); });
+    EXPECT_EQ(remaining, -1);
+    ASSERT_EQ(types.size(), 1);
+    EXPECT_EQ(types[0], 1);
+    EXPECT_EQ(memcmp(buffer, bufferCopy, sizeof(buffer)), 0);
+
+    // header with size 0 at the beginning
+    writeMessage(buffer, 0, 1, 0);
+    types.clear();
+    remaining = processReceiveBuffer(buffer, sizeof(buffer), [&](RequestResponseHeader* header) { types.push_back(header->type()); });
+    EXPECT_EQ(remaining, -1);
+    EXPECT_EQ(types.size(), 0);
+}
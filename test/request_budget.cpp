@@ -0,0 +1,92 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/network_core/request_budget.h"
+
+static constexpr unsigned long long tscFrequency = 1000000;
+
+TEST(TestCoreRequestBudget, StartsWithEmptyBudget)
+{
+    RequestBudget budget;
+    budget.reset();
+
+    // new connection only gets one request, which creates debt
+    EXPECT_TRUE(budget.tryConsume(100000, 1000, tscFrequency, 50));
+    EXPECT_FALSE(budget.tryConsume(100000, 1000, tscFrequency, 50));
+    EXPECT_EQ(budget.budget, -100000);
+
+    // 50% share -> debt of 100000 ticks is paid back after 200000 ticks
+    EXPECT_FALSE(budget.tryConsume(100000, 1000 + 199998, tscFrequency, 50));
+    EXPECT_TRUE(budget.tryConsume(100000, 1000 + 200000, tscFrequency, 50));
+    EXPECT_EQ(budget.admittedCount, 2);
+    EXPECT_EQ(budget.throttledCount, 2);
+    EXPECT_EQ(budget.consumedCost, 200000);
+
+    // reconnecting doesn't provide a full burst
+    budget.reset();
+    EXPECT_TRUE(budget.tryConsume(100000, 5000000, tscFrequency, 50));
+    EXPECT_FALSE(budget.tryConsume(100000, 5000000, tscFrequency, 50));
+}
+
+TEST(TestCoreRequestBudget, ExpensiveRequestCreatesDebt)
+{
+    RequestBudget budget;
+    budget.reset();
+
+    // request more expensive than the whole burst is admitted while budget isn't negative
+    EXPECT_TRUE(budget.tryConsume(2000000, 1000, tscFrequency, 50));
+    EXPECT_LT(budget.budget, 0);
+
+    // debt of 2000000 ticks is paid back with 500000 per second
+    EXPECT_FALSE(budget.tryConsume(1, 1000 + 2 * tscFrequency, tscFrequency, 50));
+    EXPECT_FALSE(budget.tryConsume(1, 1000 + 3 * tscFrequency + tscFrequency / 2, tscFrequency, 50));
+    EXPECT_FALSE(budget.tryConsume(1, 1000 + 4 * tscFrequency - 10, tscFrequency, 50));
+    EXPECT_TRUE(budget.tryConsume(1, 1000 + 4 * tscFrequency + 10, tscFrequency, 50));
+}
+
+TEST(TestCoreRequestBudget, RefillIsCappedAtOneSecond)
+{
+    RequestBudget budget;
+    budget.reset();
+
+    unsigned long long now = 5000;
+    EXPECT_TRUE(budget.tryConsume(500000, now, tscFrequency, 50));
+    EXPECT_FALSE(budget.tryConsume(1, now, tscFrequency, 50));
+
+    // after a long idle period, only one second worth of budget is available (last request creates debt)
+    now += 100 * tscFrequency;
+    for (int i = 0; i < 10; ++i)
+        EXPECT_TRUE(budget.tryConsume(50000, now, tscFrequency, 50));
+    EXPECT_TRUE(budget.tryConsume(50000, now, tscFrequency, 50));
+    EXPECT_FALSE(budget.tryConsume(50000, now, tscFrequency, 50));
+
+    // sustained rate follows the share: 0.1 s refill allows 50000 ticks
+    now += tscFrequency / 10;
+    EXPECT_TRUE(budget.tryConsume(50000, now, tscFrequency, 50));
+    EXPECT_FALSE(budget.tryConsume(50000, now, tscFrequency, 50));
+}
+
+TEST(TestCoreRequestCostEstimator, MovingAverage)
+{
+    RequestCostEstimator estimator;
+    estimator.reset();
+
+    // unknown types use minimum cost
+    EXPECT_EQ(estimator.estimate(42, 10), 10);
+
+    estimator.update(42, 1600);
+    EXPECT_EQ(estimator.estimate(42, 10), 1600);
+
+    // moving average adapts slowly to new measurements
+    estimator.update(42, 0);
+    EXPECT_EQ(estimator.estimate(42, 10), 1500);
+    for (int i = 0; i < 200; ++i)
+        estimator.update(42, 160);
+    EXPECT_LT(estimator.estimate(42, 10), 200);
+    EXPECT_GE(estimator.estimate(42, 10), 160);
+
+    // estimate is never below minimum cost
+    EXPECT_EQ(estimator.estimate(42, 1000), 1000);
+    EXPECT_EQ(estimator.estimate(43, 10), 10);
+}
@@ -0,0 +1,96 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/network_core/response_cache.h"
+
+#include <thread>
+#include <vector>
+
+struct TestPayload
+{
+    unsigned long long version;
+    unsigned long long data[16];
+};
+
+TEST(TestResponseCache, RebuildOnlyOnVersionChange)
+{
+    ResponseCache<TestPayload>* cache = new ResponseCache<TestPayload>();
+    cache->reset();
+    unsigned int buildCalls = 0;
+    auto build = [&buildCalls](unsigned long long version)
+    {
+        return [&buildCalls, version](TestPayload& payload)
+        {
+            ++buildCalls;
+            payload.version = version;
+            for (unsigned int i = 0; i < 16; ++i)
+                payload.data[i] = version * 100 + i;
+        };
+    };
+
+    // first request builds payload, following requests with same version use cache
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        const TestPayload& payload = cache->acquire(m256i(1, 0, 0, 0), build(1));
+        EXPECT_EQ(payload.version, 1ull);
+        EXPECT_EQ(payload.data[15], 115ull);
+        cache->release();
+    }
+    EXPECT_EQ(buildCalls, 1u);
+
+    // any word of the version differing leads to rebuild
+    const TestPayload& payload = cache->acquire(m256i(1, 0, 0, 2), build(2));
+    EXPECT_EQ(payload.version, 2ull);
+    cache->release();
+    EXPECT_EQ(buildCalls, 2u);
+    EXPECT_EQ(cache->getRebuildCount(), 2ull);
+
+    // reset invalidates cache, even if version is zero
+    cache->reset();
+    cache->acquire(m256i::zero(), build(3));
+    cache->release();
+    EXPECT_EQ(buildCalls, 3u);
+    EXPECT_EQ(cache->getRebuildCount(), 1ull);
+
+    delete cache;
+}
+
+TEST(TestResponseCache, ConcurrentReaders)
+{
+    ResponseCache<TestPayload>* cache = new ResponseCache<TestPayload>();
+    cache->reset();
+
+    // each thread requests increasing versions, payload must always be consistent while acquired
+    std::vector<std::thread> threads;
+    volatile bool inconsistent = false;
+    for (unsigned int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([cache, &inconsistent]()
+            {
+                for (unsigned long long i = 0; i < 10000; ++i)
+                {
+                    const unsigned long long version = i / 100;
+                    const TestPayload& payload = cache->acquire(m256i(version, 0, 0, 0), [version](TestPayload& payload)
+                        {
+                            payload.version = version;
+                            for (unsigned int j = 0; j < 16; ++j)
+                                payload.data[j] = version;
+                        });
+                    for (unsigned int j = 0; j < 16; ++j)
+                    {
+                        if (payload.data[j] != payload.version)
+                            inconsistent = true;
+                    }
+                    cache->release();
+                }
+            });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_FALSE(inconsistent);
+    EXPECT_GE(cache->getRebuildCount(), 100ull);
+
+    delete cache;
+}
@@ -907,4 +907,236 @@ TEST(TestQubicScoreFunction, TestDeterministic)
         }
     }
 }
+
+TEST(TestQubicScoreFunction, TestBatchScores)
+{
+    constexpr unsigned int NUMBER_OF_SAMPLES = 8;
+    using CurrentConfig = std::tuple_element_t<0, ConfigList>;
+    using ScoreEngineType = score_engine::ScoreEngine<typename CurrentConfig::HyperIdentity, typename CurrentConfig::Addition>;
+
+    auto sampleString = readSampleAsStr(COMMON_TEST_SAMPLES_FILE_NAME);
+    ASSERT_GE(sampleString.size(), NUMBER_OF_SAMPLES);
+    std::vector<m256i> publicKeys(NUMBER_OF_SAMPLES);
+    std::vector<m256i> nonces(NUMBER_OF_SAMPLES);
+    for (unsigned int i = 0; i < NUMBER_OF_SAMPLES; ++i)
+    {
+        publicKeys[i] = hexTo32Bytes(sampleString[i][1], 32);
+        nonces[i] = hexTo32Bytes(sampleString[i][2], 32);
+    }
+    // make sure both algorithms are mixed in the batch
+    nonces[0].m256i_u8[0] &= ~1;
+    nonces[1].m256i_u8[0] |= 1;
+
+    m256i miningSeed = hexTo32Bytes(sampleString[0][0], 32);
+    std::vector<unsigned char> state(score_engine::STATE_SIZE);
+    std::vector<unsigned char> poolVec(score_engine::POOL_VEC_PADDING_SIZE);
+    score_engine::generateRandom2Pool(miningSeed.m256i_u8, state.data(), poolVec.data());
+
+    std::unique_ptr<ScoreEngineType> scoreEngine = std::make_unique<ScoreEngineType>();
+    scoreEngine->initMemory();
+
+    // batch scores match scores computed one by one
+    unsigned int batchScores[NUMBER_OF_SAMPLES];
+    scoreEngine->computeScores(publicKeys.data(), nonces.data(), NUMBER_OF_SAMPLES, poolVec.data(), batchScores);
+    for (unsigned int i = 0; i < NUMBER_OF_SAMPLES; ++i)
+    {
+        EXPECT_EQ(batchScores[i], scoreEngine->computeScore(publicKeys[i].m256i_u8, nonces[i].m256i_u8, poolVec.data()));
+    }
+}
+#endif
+
+// Benchmark of score computation, disabled by default because it takes a few minutes. Run it with
+//   --gtest_also_run_disabled_tests --gtest_filter=TestQubicScoreFunction.DISABLED_Benchmark
+// It measures scores/sec for HyperIdentity and Addition with each parameter set of score_params.h (single thread),
+// the cache miss and hit paths of ScoreFunction, and the scaling of the deployed parameters with the number of threads.
+// Results are written to SCORE_BENCHMARK_RESULT_FILE_NAME as CSV. If SCORE_BENCHMARK_BASELINE_FILE_NAME exists
+// (a result file of the previous release measured on the same machine), results that are more than
+// SCORE_BENCHMARK_TOLERANCE slower than the baseline fail the test.
+static const std::string SCORE_BENCHMARK_RESULT_FILE_NAME = "score_benchmark.csv";
+static const std::string SCORE_BENCHMARK_BASELINE_FILE_NAME = "data/score_benchmark_baseline.csv";
+static constexpr double SCORE_BENCHMARK_TOLERANCE = 0.1;
+static constexpr unsigned int SCORE_BENCHMARK_SCORES_PER_CONFIG = 8;
+static constexpr unsigned int SCORE_BENCHMARK_SCORES_PER_THREAD = 4;
+
+struct BenchmarkResult
+{
+    std::string benchmark;
+    std::string config;
+    std::string algorithm;
+    unsigned int threads;
+    unsigned long long scores;
+    double seconds;
+
+    std::string key() const
+    {
+        return benchmark + "," + config + "," + algorithm + "," + std::to_string(threads);
+    }
+
+    double scoresPerSecond() const
+    {
+        return (seconds > 0) ? scores / seconds : 0;
+    }
+};
+
+struct BenchmarkSamples
+{
+    std::vector<unsigned char> poolVec;
+    std::vector<m256i> miningSeeds;
+    std::vector<m256i> publicKeys;
+    std::vector<m256i> nonces;
+};
+
+template <typename CurrentConfig>
+static unsigned int benchmarkScores(
+    score_engine::ScoreEngine<typename CurrentConfig::HyperIdentity, typename CurrentConfig::Addition>& scoreEngine,
+    const BenchmarkSamples& samples, score_engine::AlgoType algo, unsigned int first, unsigned int count)
+{
+    unsigned int checksum = 0;
+    for (unsigned int i = first; i < first + count; ++i)
+    {
+        const unsigned int sample = i % samples.nonces.size();
+        if (algo == score_engine::AlgoType::HyperIdentity)
+            checksum += scoreEngine.computeHyperIdentityScore(samples.publicKeys[sample].m256i_u8, samples.nonces[sample].m256i_u8, samples.poolVec.data());
+        else
+            checksum += scoreEngine.computeAdditionScore(samples.publicKeys[sample].m256i_u8, samples.nonces[sample].m256i_u8, samples.poolVec.data());
+    }
+    return checksum;
+}
+
+template <typename CurrentConfig>
+static void benchmarkConfig(const std::string& configName, const BenchmarkSamples& samples, std::vector<BenchmarkResult>& results)
+{
+    using ScoreEngineType = score_engine::ScoreEngine<typename CurrentConfig::HyperIdentity, typename CurrentConfig::Addition>;
+    std::unique_ptr<ScoreEngineType> scoreEngine = std::make_unique<ScoreEngineType>();
+    scoreEngine->initMemory();
+
+    for (const auto& [algo, algoName] : TEST_ALGOS)
+    {
+        if (algo != score_engine::AlgoType::HyperIdentity && algo != score_engine::AlgoType::Addition)
+            continue;
+
+        // warm up caches and memory
+        benchmarkScores<CurrentConfig>(*scoreEngine, samples, algo, 0, 1);
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+        benchmarkScores<CurrentConfig>(*scoreEngine, samples, algo, 0, SCORE_BENCHMARK_SCORES_PER_CONFIG);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        results.push_back({ "score", configName, algoName, 1, SCORE_BENCHMARK_SCORES_PER_CONFIG, std::chrono::duration<double>(t1 - t0).count() });
+    }
+}
+
+template <std::size_t... I>
+static void benchmarkConfigList(const BenchmarkSamples& samples, std::vector<BenchmarkResult>& results, std::index_sequence<I...>)
+{
+    (benchmarkConfig<std::tuple_element_t<I, ConfigList>>("Config" + std::to_string(I), samples, results), ...);
+}
+
+static void benchmarkScoreCache(const BenchmarkSamples& samples, std::vector<BenchmarkResult>& results)
+{
+    std::unique_ptr<ScoreFunction<1>> pScore = std::make_unique<ScoreFunction<1>>();
+    pScore->initMemory();
+    pScore->initMiningData(samples.miningSeeds[0]);
+
+    // miss: first request of each solution computes the score, hit: repeated request is served from the cache
+    const unsigned int count = (unsigned int)samples.nonces.size();
+    for (const char* path : { "score_cache_miss", "score_cache_hit" })
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < count; ++i)
+            (*pScore)(0, samples.publicKeys[i], samples.miningSeeds[0], samples.nonces[i]);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        results.push_back({ path, "ConfigProfile", "Mixed", 1, count, std::chrono::duration<double>(t1 - t0).count() });
+    }
+}
+
+static void benchmarkThreadScaling(const BenchmarkSamples& samples, std::vector<BenchmarkResult>& results)
+{
+    using ScoreEngineType = score_engine::ScoreEngine<typename ConfigProfile::HyperIdentity, typename ConfigProfile::Addition>;
+    const unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int numberOfThreads = 1; numberOfThreads < maxThreads; numberOfThreads *= 2)
+        threadCounts.push_back(numberOfThreads);
+    threadCounts.push_back(maxThreads);
+
+    for (const auto& [algo, algoName] : TEST_ALGOS)
+    {
+        if (algo != score_engine::AlgoType::HyperIdentity && algo != score_engine::AlgoType::Addition)
+            continue;
+
+        for (unsigned int numberOfThreads : threadCounts)
+        {
+            // each thread has its own engine, as the processors of the node
+            std::vector<std::unique_ptr<ScoreEngineType>> scoreEngines(numberOfThreads);
+            for (auto& scoreEngine : scoreEngines)
+            {
+                scoreEngine = std::make_unique<ScoreEngineType>();
+                scoreEngine->initMemory();
+            }
+
+            std::vector<std::thread> threads;
+            auto t0 = std::chrono::high_resolution_clock::now();
+            for (unsigned int t = 0; t < numberOfThreads; ++t)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    benchmarkScores<ConfigProfile>(*scoreEngines[t], samples, algo, t * SCORE_BENCHMARK_SCORES_PER_THREAD, SCORE_BENCHMARK_SCORES_PER_THREAD);
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+            auto t1 = std::chrono::high_resolution_clock::now();
+            results.push_back({ "thread_scaling", "ConfigProfile", algoName, numberOfThreads,
+                (unsigned long long)numberOfThreads * SCORE_BENCHMARK_SCORES_PER_THREAD, std::chrono::duration<double>(t1 - t0).count() });
+        }
+    }
+}
+
+TEST(TestQubicScoreFunction, DISABLED_Benchmark)
+{
+#if defined (__AVX512F__) && !GENERIC_K12
+    initAVX512KangarooTwelveConstants();
 #endif
+    auto sampleString = readSampleAsStr(COMMON_TEST_SAMPLES_FILE_NAME);
+    ASSERT_GT(sampleString.size(), 0);
+    const unsigned long long numberOfSamples = std::min<unsigned long long>(sampleString.size(), PROFILING_NUMBER_OF_SAMPLES);
+
+    BenchmarkSamples samples;
+    samples.miningSeeds.resize(numberOfSamples);
+    samples.publicKeys.resize(numberOfSamples);
+    samples.nonces.resize(numberOfSamples);
+    loadSamples(sampleString, numberOfSamples, sampleString.size(), samples.miningSeeds, samples.publicKeys, samples.nonces);
+    std::vector<unsigned char> state(score_engine::STATE_SIZE);
+    samples.poolVec.resize(score_engine::POOL_VEC_PADDING_SIZE);
+    score_engine::generateRandom2Pool(samples.miningSeeds[0].m256i_u8, state.data(), samples.poolVec.data());
+
+    std::vector<BenchmarkResult> results;
+    benchmarkConfigList(samples, results, std::make_index_sequence<CONFIG_COUNT>{});
+    benchmarkConfig<ConfigProfile>("ConfigProfile", samples, results);
+    benchmarkScoreCache(samples, results);
+    benchmarkThreadScaling(samples, results);
+
+    std::ofstream resultFile(SCORE_BENCHMARK_RESULT_FILE_NAME);
+    resultFile << "benchmark,config,algorithm,threads,scores,seconds,scores_per_second" << std::endl;
+    for (const auto& result : results)
+    {
+        resultFile << result.key() << "," << result.scores << "," << result.seconds << "," << result.scoresPerSecond() << std::endl;
+        std::cout << result.key() << ": " << result.scoresPerSecond() << " scores/s" << std::endl;
+    }
+    std::cout << "Benchmark results written to " << SCORE_BENCHMARK_RESULT_FILE_NAME << std::endl;
+
+    // compare with baseline (columns as in result file)
+    std::map<std::string, double> baseline;
+    for (const auto& row : readCSV(SCORE_BENCHMARK_BASELINE_FILE_NAME))
+    {
+        if (row.size() == 7 && row[0] != "benchmark")
+            baseline[row[0] + "," + row[1] + "," + row[2] + "," + row[3]] = std::stod(row[6]);
+    }
+    for (const auto& result : results)
+    {
+        auto it = baseline.find(result.key());
+        if (it != baseline.end())
+        {
+            EXPECT_GE(result.scoresPerSecond(), it->second * (1.0 - SCORE_BENCHMARK_TOLERANCE)) << "Regression in " << result.key();
+        }
+    }
+}
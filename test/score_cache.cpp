@@ -199,3 +199,48 @@ TEST(TestQubicScoreCache, RandomSeeds80pctFilled) {
     testCacheRandomSeeds<200000>(80);     // non-prime number as cache size
     testCacheRandomSeeds<199999>(80);     // prime number as cache size
 }
+
+TEST(TestQubicScoreCache, SecondChanceEviction) {
+    // 4096 entries -> 1024 shards of 4 entries, so all 4 entries probed are in the same shard
+    typedef ScoreCache<4096, 4> CacheType;
+    CacheType* cache = new CacheType();
+    const m256i miningSeed(1, 2, 3, 4);
+
+    // fill shard starting at index 8 with keys 1..4, all using index 8 as hashed index
+    for (unsigned long long k = 1; k <= 4; ++k)
+    {
+        unsigned int idx = 8;
+        EXPECT_EQ(cache->tryFetching(m256i(k, 0, 0, 0), miningSeed, m256i::zero(), idx), cache->SCORE_CACHE_MISS);
+        EXPECT_EQ(idx, 8 + k - 1);
+        cache->addEntry(m256i(k, 0, 0, 0), miningSeed, m256i::zero(), idx, (int)k);
+    }
+    EXPECT_EQ(cache->evictionCount(), 0);
+
+    // fetching keys 1 and 2 gives them a second chance
+    for (unsigned long long k = 1; k <= 2; ++k)
+    {
+        unsigned int idx = 8;
+        EXPECT_EQ(cache->tryFetching(m256i(k, 0, 0, 0), miningSeed, m256i::zero(), idx), (int)k);
+    }
+
+    // key 5 evicts key 3 (first one not fetched)
+    unsigned int idx = 8;
+    EXPECT_EQ(cache->tryFetching(m256i(5, 0, 0, 0), miningSeed, m256i::zero(), idx), cache->SCORE_CACHE_COLLISION);
+    EXPECT_EQ(idx, 8);
+    cache->addEntry(m256i(5, 0, 0, 0), miningSeed, m256i::zero(), idx, 5);
+    EXPECT_EQ(cache->evictionCount(), 1);
+    const int expectedScores[6] = { 0, 1, 2, cache->SCORE_CACHE_COLLISION, 4, 5 };
+    for (unsigned long long k = 1; k <= 5; ++k)
+    {
+        idx = 8;
+        EXPECT_EQ(cache->tryFetching(m256i(k, 0, 0, 0), miningSeed, m256i::zero(), idx), expectedScores[k]);
+    }
+
+    // adding existing key updates entry
+    idx = 8;
+    cache->addEntry(m256i(4, 0, 0, 0), miningSeed, m256i::zero(), idx, 44);
+    EXPECT_EQ(cache->evictionCount(), 1);
+    EXPECT_EQ(cache->tryFetching(m256i(4, 0, 0, 0), miningSeed, m256i::zero(), idx), 44);
+
+    delete cache;
+}
@@ -83,6 +83,47 @@ void testSortDescending(unsigned int seed)
     EXPECT_EQ(vec, referenceVec);
 }
 
+template <typename T>
+void testQuickSelect(unsigned int seed, SortingOrder order)
+{
+    std::vector vec = prepareData<T>(seed);
+
+    // make some elements equal to test three-way partitioning
+    std::mt19937 gen32(seed);
+    for (unsigned int i = 0; i < vec.size() / 2; ++i)
+        vec[gen32() % vec.size()] = vec[0];
+
+    std::vector<T> referenceVec = vec;
+    if (order == SortingOrder::SortAscending)
+        std::sort(referenceVec.begin(), referenceVec.end(), std::less<>());
+    else
+        std::sort(referenceVec.begin(), referenceVec.end(), std::greater<>());
+
+    const int k = static_cast<int>(gen32() % vec.size());
+    const T result = quickSelect(vec.data(), 0, static_cast<int>(vec.size() - 1), k, order);
+
+    EXPECT_EQ(result, referenceVec[k]);
+    EXPECT_EQ(vec[k], referenceVec[k]);
+
+    // elements before / after k are not sorted, but in correct partition
+    for (int i = 0; i < k; ++i)
+        EXPECT_FALSE((order == SortingOrder::SortAscending) ? (result < vec[i]) : (vec[i] < result));
+    for (int i = k + 1; i < static_cast<int>(vec.size()); ++i)
+        EXPECT_FALSE((order == SortingOrder::SortAscending) ? (vec[i] < result) : (result < vec[i]));
+}
+
+TEST(FixedTypeSortingTest, QuickSelectSimple)
+{
+    int arr[5] = { 3, 6, 1, 9, 2 };
+    EXPECT_EQ(quickSelect(arr, 0, 4, 1, SortingOrder::SortAscending), 2);
+    EXPECT_EQ(quickSelect(arr, 0, 4, 1, SortingOrder::SortDescending), 6);
+
+    int zeros[676] = { 0 };
+    zeros[7] = 5;
+    EXPECT_EQ(quickSelect(zeros, 0, 675, 450, SortingOrder::SortAscending), 0);
+    EXPECT_EQ(quickSelect(zeros, 0, 675, 675, SortingOrder::SortAscending), 5);
+}
+
 template <typename T>
 class SortingTest : public testing::Test {};
 
@@ -108,9 +149,22 @@ TYPED_TEST_P(SortingTest, SortDescending)
         testSortDescending<TypeParam>(/*seed=*/gen32());
 }
 
+TYPED_TEST_P(SortingTest, QuickSelect)
+{
+    unsigned int metaSeed = 61339;
+    std::mt19937 gen32(metaSeed);
+
+    for (unsigned int t = 0; t < MAX_NUM_TESTS_PER_TYPE; ++t)
+    {
+        testQuickSelect<TypeParam>(/*seed=*/gen32(), SortingOrder::SortAscending);
+        testQuickSelect<TypeParam>(/*seed=*/gen32(), SortingOrder::SortDescending);
+    }
+}
+
 REGISTER_TYPED_TEST_CASE_P(SortingTest,
 	SortAscending,
-    SortDescending
+    SortDescending,
+    QuickSelect
 );
 
 // GTest produces a linker error when using `unsigned short` as test type due to unresolved print function - skip for now.
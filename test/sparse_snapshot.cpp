@@ -0,0 +1,115 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/sparse_snapshot.h"
+
+#include <random>
+#include <vector>
+
+struct TestRecord
+{
+    unsigned long long values[6];
+};
+
+static constexpr unsigned long long testCapacity = 4096;
+typedef SparseSnapshot<testCapacity, TestRecord> TestSparseSnapshot;
+
+static void fillRandomRecords(std::vector<TestRecord>& records, unsigned long long count, std::mt19937_64& gen)
+{
+    for (unsigned long long i = 0; i < count; i++)
+    {
+        TestRecord& record = records[gen() % testCapacity];
+        for (auto& value : record.values)
+        {
+            value = gen();
+        }
+    }
+}
+
+TEST(TestCoreSparseSnapshot, EmptyRecords)
+{
+    std::vector<TestRecord> records(testCapacity);
+    std::vector<unsigned char> buffer(TestSparseSnapshot::fullSizeInBytes);
+    EXPECT_EQ(TestSparseSnapshot::build(records.data(), buffer.data()), TestSparseSnapshot::sparseSizeInBytes(0));
+
+    std::vector<TestRecord> loaded(testCapacity);
+    memset(loaded.data(), 0xff, TestSparseSnapshot::fullSizeInBytes);
+    EXPECT_TRUE(TestSparseSnapshot::unpack(buffer.data(), TestSparseSnapshot::sparseSizeInBytes(0), loaded.data()));
+    EXPECT_EQ(memcmp(records.data(), loaded.data(), TestSparseSnapshot::fullSizeInBytes), 0);
+}
+
+TEST(TestCoreSparseSnapshot, BuildAndUnpack)
+{
+    std::mt19937_64 gen(42);
+    for (unsigned long long count : { 1ull, 10ull, 100ull, 1000ull, 3000ull })
+    {
+        std::vector<TestRecord> records(testCapacity);
+        fillRandomRecords(records, count, gen);
+        unsigned long long occupiedCount = 0;
+        for (const auto& record : records)
+        {
+            occupiedCount += !TestSparseSnapshot::isEmpty(record);
+        }
+
+        std::vector<unsigned char> buffer(TestSparseSnapshot::fullSizeInBytes);
+        const unsigned long long size = TestSparseSnapshot::build(records.data(), buffer.data());
+        EXPECT_EQ(size, TestSparseSnapshot::sparseSizeInBytes(occupiedCount));
+        EXPECT_LT(size, TestSparseSnapshot::fullSizeInBytes);
+
+        std::vector<TestRecord> loaded(testCapacity);
+        fillRandomRecords(loaded, testCapacity, gen);
+        EXPECT_TRUE(TestSparseSnapshot::unpack(buffer.data(), size, loaded.data()));
+        EXPECT_EQ(memcmp(records.data(), loaded.data(), TestSparseSnapshot::fullSizeInBytes), 0);
+    }
+}
+
+TEST(TestCoreSparseSnapshot, FullRecords)
+{
+    // Sparse format isn't used if it isn't smaller than the full array
+    std::mt19937_64 gen(43);
+    std::vector<TestRecord> records(testCapacity);
+    for (auto& record : records)
+    {
+        record.values[0] = gen() | 1;
+    }
+    std::vector<unsigned char> buffer(TestSparseSnapshot::fullSizeInBytes);
+    EXPECT_EQ(TestSparseSnapshot::build(records.data(), buffer.data()), 0);
+
+    // Largest number of records that are saved in sparse format
+    for (unsigned long long i = 0; i < testCapacity; i++)
+    {
+        if (TestSparseSnapshot::sparseSizeInBytes(testCapacity - i) < TestSparseSnapshot::fullSizeInBytes)
+            break;
+        records[i].values[0] = 0;
+    }
+    EXPECT_GT(TestSparseSnapshot::build(records.data(), buffer.data()), 0);
+}
+
+TEST(TestCoreSparseSnapshot, InvalidData)
+{
+    std::mt19937_64 gen(44);
+    std::vector<TestRecord> records(testCapacity);
+    fillRandomRecords(records, 100, gen);
+    std::vector<unsigned char> buffer(TestSparseSnapshot::fullSizeInBytes);
+    const unsigned long long size = TestSparseSnapshot::build(records.data(), buffer.data());
+    ASSERT_GT(size, 0);
+    std::vector<TestRecord> loaded(testCapacity);
+
+    // wrong size
+    EXPECT_FALSE(TestSparseSnapshot::unpack(buffer.data(), size - 1, loaded.data()));
+    EXPECT_FALSE(TestSparseSnapshot::unpack(buffer.data(), 8, loaded.data()));
+
+    // wrong magic
+    std::vector<unsigned char> corrupted = buffer;
+    corrupted[0] ^= 1;
+    EXPECT_FALSE(TestSparseSnapshot::unpack(corrupted.data(), size, loaded.data()));
+
+    // bitmap inconsistent with record count
+    corrupted = buffer;
+    corrupted[sizeof(TestSparseSnapshot::SparseHeader)] ^= 1;
+    EXPECT_FALSE(TestSparseSnapshot::unpack(corrupted.data(), size, loaded.data()));
+
+    EXPECT_TRUE(TestSparseSnapshot::unpack(buffer.data(), size, loaded.data()));
+    EXPECT_EQ(memcmp(records.data(), loaded.data(), TestSparseSnapshot::fullSizeInBytes), 0);
+}
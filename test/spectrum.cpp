@@ -4,8 +4,11 @@
 
 #include "gtest/gtest.h"
 
+#include <atomic>
 #include <chrono>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include "logging_test.h"
 #include "spectrum/spectrum.h"
@@ -67,6 +70,8 @@ static SpectrumInfo checkAndGetInfo()
     for (unsigned int i = 0; i < SPECTRUM_CAPACITY; i++)
     {
         long long balance = spectrum[i].incomingAmount - spectrum[i].outgoingAmount;
+        EXPECT_EQ(spectrumBalances[i], balance);
+        EXPECT_EQ(spectrumTags[i] != 0, !isZero(spectrum[i].publicKey));
         if (!balance && isZero(spectrum[i].publicKey))
             continue;
         EXPECT_GE(balance, 0);
@@ -133,6 +138,7 @@ struct SpectrumTest : public LoggingTest
         rnd64.seed(seed);
         EXPECT_TRUE(initSpectrum());
         EXPECT_TRUE(commonBuffers.init(1));
+        EXPECT_TRUE(reorgBuffers.init(1, spectrumSizeInBytes));
         system.tick = 15700000;
         clearSpectrum();
         antiDustCornerCase = false;
@@ -142,11 +148,13 @@ struct SpectrumTest : public LoggingTest
     {
         deinitSpectrum();
         commonBuffers.deinit();
+        reorgBuffers.deinit();
     }
 
     void clearSpectrum()
     {
         memset(spectrum, 0, spectrumSizeInBytes);
+        rebuildSpectrumTagsAndBalances();
         updateSpectrumInfo();
     }
 
@@ -241,6 +249,35 @@ TEST(TestCoreSpectrum, AntiDustFile)
     }
 }
 
+TEST(TestCoreSpectrum, SaveAndLoadSparseFile)
+{
+    SpectrumTest test;
+    for (unsigned int i = 0; i < 1000; ++i)
+        increaseEnergy(m256i(test.rnd64(), test.rnd64(), test.rnd64(), test.rnd64()), i + 1);
+    const SpectrumInfo savedInfo = checkAndGetInfo();
+    std::vector<EntityRecord> savedSpectrum(spectrum, spectrum + SPECTRUM_CAPACITY);
+    rebuildSpectrumDigests();
+    const m256i savedDigest = spectrumDigestTree.root();
+
+    // Sparse format is much smaller than full spectrum
+    EXPECT_TRUE(saveSpectrum(L"spectrum_sparse_test.000"));
+    FILE* file = nullptr;
+    ASSERT_EQ(_wfopen_s(&file, L"spectrum_sparse_test.000", L"rb"), 0);
+    fseek(file, 0, SEEK_END);
+    EXPECT_EQ((unsigned long long)ftell(file), SpectrumSparseSnapshot::sparseSizeInBytes(savedInfo.numberOfEntities));
+    fclose(file);
+
+    test.clearSpectrum();
+    EXPECT_TRUE(loadSpectrum(L"spectrum_sparse_test.000", nullptr, /*computeDigests=*/true));
+    EXPECT_EQ(memcmp(savedSpectrum.data(), spectrum, spectrumSizeInBytes), 0);
+    SpectrumInfo loadedInfo = checkAndGetInfo();
+    EXPECT_EQ(loadedInfo.numberOfEntities, savedInfo.numberOfEntities);
+    EXPECT_EQ(loadedInfo.totalAmount, savedInfo.totalAmount);
+    EXPECT_EQ(spectrumDigestTree.root(), savedDigest);
+
+    _wremove(L"spectrum_sparse_test.000");
+}
+
 TEST(TestCoreSpectrum, AntiDustOneRichRandomDust)
 {
     // Create spectrum with one rich ID
@@ -283,6 +320,7 @@ TEST(TestCoreSpectrum, AntiDustEdgeCaseAllInSameBin)
 SpectrumStats getSpectrumStatsLog(long long id)
 {
     SpectrumStats res;
+    logger.flushStagedLogs();
     qLogger::BlobInfo bi = logger.logBuf.getBlobInfo(id);
     EXPECT_EQ(bi.length, LOG_HEADER_SIZE + sizeof(SpectrumStats));
     logger.logBuf.getMany((char*)&res, bi.startIndex + LOG_HEADER_SIZE, sizeof(SpectrumStats));
@@ -292,6 +330,7 @@ SpectrumStats getSpectrumStatsLog(long long id)
 void getDustBurningLog(long long id, char* ptr)
 {
     DustBurning res;
+    logger.flushStagedLogs();
     qLogger::BlobInfo bi = logger.logBuf.getBlobInfo(id);
     logger.logBuf.getMany((char*)&res, bi.startIndex + LOG_HEADER_SIZE, sizeof(DustBurning));
     EXPECT_EQ(bi.length, LOG_HEADER_SIZE + res.messageSize());
@@ -407,3 +446,228 @@ TEST(TestCoreSpectrum, AntiDustEdgeCaseHugeBinZeroBalance)
     test.afterAntiDust();
 }
 
+
+TEST(TestCoreSpectrum, SpectrumIndexConcurrentToInserts)
+{
+    SpectrumTest test;
+    constexpr unsigned int entityCount = 200000;
+    std::vector<m256i> publicKeys(entityCount);
+    for (unsigned int i = 0; i < entityCount; ++i)
+        publicKeys[i] = m256i(test.rnd64(), test.rnd64(), test.rnd64(), i + 1);
+
+    // writer thread inserts entities while readers look up entities that are known to be inserted
+    std::atomic<unsigned int> insertedCount = 0;
+    std::thread writer([&]()
+        {
+            for (unsigned int i = 0; i < entityCount; ++i)
+            {
+                increaseEnergy(publicKeys[i], 1);
+                insertedCount.store(i + 1);
+            }
+        });
+
+    std::atomic<unsigned int> errorCount = 0;
+    std::vector<std::thread> readers;
+    for (unsigned int t = 0; t < 3; ++t)
+    {
+        readers.emplace_back([&, t]()
+            {
+                std::mt19937_64 rnd(t);
+                unsigned int inserted;
+                while ((inserted = insertedCount.load()) < entityCount)
+                {
+                    if (!inserted)
+                        continue;
+                    const unsigned int i = rnd() % inserted;
+                    const int index = spectrumIndex(publicKeys[i]);
+                    if (index < 0 || !(spectrum[index].publicKey == publicKeys[i]))
+                        ++errorCount;
+                }
+            });
+    }
+
+    writer.join();
+    for (auto& reader : readers)
+        reader.join();
+    EXPECT_EQ(errorCount.load(), 0u);
+    EXPECT_EQ(spectrumStructureSequence & 1, 0);
+
+    for (unsigned int i = 0; i < entityCount; ++i)
+        EXPECT_TRUE(spectrum[spectrumIndex(publicKeys[i])].publicKey == publicKeys[i]);
+    EXPECT_EQ(spectrumIndex(m256i(1, 2, 3, 0)), -1);
+}
+
+TEST(TestCoreSpectrum, IncreaseEnergyOfMany)
+{
+    SpectrumTest test;
+    const m256i src(1, 2, 3, 4);
+    increaseEnergy(src, 1000);
+    const int srcIndex = spectrumIndex(src);
+    ASSERT_GE(srcIndex, 0);
+
+    // duplicate destinations, zero amount, and NULL_ID (destroying energy) like in sequence of single transfers
+    const m256i destinations[5] = { m256i(5, 6, 7, 8), m256i(9, 10, 11, 12), m256i(5, 6, 7, 8), m256i::zero(), m256i(13, 14, 15, 16) };
+    const long long amounts[5] = { 100, 200, 50, 25, 0 };
+    EXPECT_FALSE(decreaseEnergy(srcIndex, 1001, 5));
+    EXPECT_TRUE(decreaseEnergy(srcIndex, 375, 5));
+    increaseEnergyOfMany(destinations, amounts, 5);
+
+    EXPECT_EQ(energy(spectrumIndex(src)), 625);
+    EXPECT_EQ(spectrum[srcIndex].numberOfOutgoingTransfers, 5);
+    EXPECT_EQ(energy(spectrumIndex(destinations[0])), 150);
+    EXPECT_EQ(spectrum[spectrumIndex(destinations[0])].numberOfIncomingTransfers, 2);
+    EXPECT_EQ(energy(spectrumIndex(destinations[1])), 200);
+    EXPECT_GE(spectrumIndex(destinations[4]), 0);
+    EXPECT_EQ(energy(spectrumIndex(destinations[4])), 0);
+    EXPECT_EQ(spectrumInfo.totalAmount, 1000 - 25);
+    EXPECT_FALSE(spectrumLock.isLocked());
+}
+
+TEST(TestCoreSpectrum, QuTransferBatchLogger)
+{
+    SpectrumTest test;
+    const m256i src(1, 2, 3, 4);
+    const unsigned long long firstLogId = logger.getNextLogId();
+
+    {
+        QuTransferBatchLogger batchLogger(src);
+        for (unsigned int i = 0; i < quTransferBatchMaxTransfers + 2; ++i)
+            batchLogger.addTransfer(m256i(i, 5, 6, 7), i + 10);
+
+        // single transfer is logged as QuTransfer, nothing is logged if no transfers are pending
+        batchLogger.finished();
+        batchLogger.finished();
+        batchLogger.addTransfer(m256i(9, 9, 9, 9), 99);
+    }
+    EXPECT_EQ(logger.getNextLogId(), firstLogId + 3);
+    logger.flushStagedLogs();
+
+    std::vector<char> buffer(LOG_HEADER_SIZE + sizeof(m256i) + 2 + quTransferBatchMaxTransfers * sizeof(QuTransferBatch::Transfer));
+    unsigned int transferIndex = 0;
+    for (unsigned long long logId = firstLogId; logId < firstLogId + 2; ++logId)
+    {
+        qLogger::BlobInfo bi = logger.logBuf.getBlobInfo(logId);
+        logger.logBuf.getMany(buffer.data(), bi.startIndex, bi.length);
+        QuTransferBatch* batch = (QuTransferBatch*)(buffer.data() + LOG_HEADER_SIZE);
+        EXPECT_EQ(batch->sourcePublicKey, src);
+        EXPECT_EQ(batch->numberOfTransfers, (logId == firstLogId) ? quTransferBatchMaxTransfers : 2);
+        EXPECT_EQ(bi.length, LOG_HEADER_SIZE + batch->messageSize());
+        for (unsigned short i = 0; i < batch->numberOfTransfers; ++i, ++transferIndex)
+        {
+            EXPECT_EQ(batch->transfer(i).destinationPublicKey, m256i(transferIndex, 5, 6, 7));
+            EXPECT_EQ(batch->transfer(i).amount, transferIndex + 10);
+        }
+    }
+    EXPECT_EQ(transferIndex, quTransferBatchMaxTransfers + 2);
+
+    qLogger::BlobInfo bi = logger.logBuf.getBlobInfo(firstLogId + 2);
+    EXPECT_EQ(bi.length, LOG_HEADER_SIZE + offsetof(QuTransfer, _terminator));
+    logger.logBuf.getMany(buffer.data(), bi.startIndex, bi.length);
+    QuTransfer* quTransfer = (QuTransfer*)(buffer.data() + LOG_HEADER_SIZE);
+    EXPECT_EQ(quTransfer->sourcePublicKey, src);
+    EXPECT_EQ(quTransfer->destinationPublicKey, m256i(9, 9, 9, 9));
+    EXPECT_EQ(quTransfer->amount, 99);
+}
+
+TEST(TestCoreSpectrum, TickLogSummary)
+{
+    SpectrumTest test;
+    logger.reset(100);
+    logger.registerNewTx(100, 0);
+    const QuTransfer transfer{ m256i(1, 2, 3, 4), m256i(5, 6, 7, 8), 10 };
+    const unsigned long long transferLogSize = LOG_HEADER_SIZE + offsetof(QuTransfer, _terminator);
+    logger.logQuTransfer(transfer);
+    logger.logQuTransfer(transfer);
+    logger.updateTick(100);
+    logger.updateTick(101);
+    logger.registerNewTx(102, 3);
+    logger.logQuTransfer(transfer);
+    logger.updateTick(102);
+
+    TickLogSummary summary;
+    EXPECT_FALSE(logger.getTickSummary(99, summary));
+    EXPECT_FALSE(logger.getTickSummary(103, summary));
+
+    ASSERT_TRUE(logger.getTickSummary(100, summary));
+    EXPECT_EQ(summary.tick, 100);
+    EXPECT_EQ(summary.fromLogId, 0);
+    EXPECT_EQ(summary.numberOfLogs, 2);
+    EXPECT_EQ(summary.bufferOffset, 0);
+    EXPECT_EQ(summary.bufferSize, 2 * transferLogSize);
+    EXPECT_EQ(summary.numberOfLogsPerType[QU_TRANSFER], 2);
+    EXPECT_EQ(summary.numberOfLogsPerType[QU_TRANSFER_BATCH], 0);
+
+    // tick without events
+    ASSERT_TRUE(logger.getTickSummary(101, summary));
+    EXPECT_EQ(summary.fromLogId, 2);
+    EXPECT_EQ(summary.numberOfLogs, 0);
+    EXPECT_EQ(summary.bufferSize, 0);
+
+    ASSERT_TRUE(logger.getTickSummary(102, summary));
+    EXPECT_EQ(summary.fromLogId, 2);
+    EXPECT_EQ(summary.numberOfLogs, 1);
+    EXPECT_EQ(summary.bufferOffset, 2 * transferLogSize);
+    EXPECT_EQ(summary.numberOfLogsPerType[QU_TRANSFER], 1);
+
+    // events of tick are stored consecutively
+    qLogger::BlobInfo bi = logger.logBuf.getBlobInfo(summary.fromLogId);
+    EXPECT_EQ(bi.startIndex, summary.bufferOffset);
+    EXPECT_EQ(bi.length, summary.bufferSize);
+}
+
+TEST(TestCoreSpectrum, LogFilter)
+{
+    const m256i a(1, 2, 3, 4), b(5, 6, 7, 8), c(9, 10, 11, 12);
+    RequestFilteredLog filter;
+    setMem(&filter, sizeof(filter), 0);
+
+    QuTransfer transfer{ a, b, 10 };
+    const unsigned int transferSize = offsetof(QuTransfer, _terminator);
+    EXPECT_FALSE(qLogger::matchesFilter(filter, QU_TRANSFER, (const char*)&transfer, transferSize));
+    filter.typeMask = 1ULL << QU_TRANSFER;
+    EXPECT_TRUE(qLogger::matchesFilter(filter, QU_TRANSFER, (const char*)&transfer, transferSize));
+    EXPECT_FALSE(qLogger::matchesFilter(filter, BURNING, (const char*)&transfer, transferSize));
+
+    // CUSTOM_MESSAGE and other types share the last bit
+    filter.typeMask = 1ULL << 16;
+    EXPECT_TRUE(qLogger::matchesFilter(filter, CUSTOM_MESSAGE, (const char*)&transfer, transferSize));
+
+    // identity filter
+    filter.typeMask = ~0ULL;
+    filter.identity = b;
+    EXPECT_TRUE(qLogger::matchesFilter(filter, QU_TRANSFER, (const char*)&transfer, transferSize));
+    EXPECT_FALSE(qLogger::matchesFilter(filter, QU_TRANSFER, (const char*)&transfer, transferSize - 1));
+    EXPECT_FALSE(qLogger::matchesFilter(filter, CUSTOM_MESSAGE, (const char*)&transfer, transferSize));
+    filter.identity = c;
+    EXPECT_FALSE(qLogger::matchesFilter(filter, QU_TRANSFER, (const char*)&transfer, transferSize));
+
+    // batch matches if any destination matches
+    std::vector<char> batchBuffer(sizeof(m256i) + 2 + 3 * sizeof(QuTransferBatch::Transfer));
+    QuTransferBatch* batch = (QuTransferBatch*)batchBuffer.data();
+    batch->sourcePublicKey = a;
+    batch->numberOfTransfers = 3;
+    batch->transfer(0).destinationPublicKey = b;
+    batch->transfer(1).destinationPublicKey = b;
+    batch->transfer(2).destinationPublicKey = c;
+    EXPECT_TRUE(qLogger::matchesFilter(filter, QU_TRANSFER_BATCH, batchBuffer.data(), batch->messageSize()));
+    batch->transfer(2).destinationPublicKey = b;
+    EXPECT_FALSE(qLogger::matchesFilter(filter, QU_TRANSFER_BATCH, batchBuffer.data(), batch->messageSize()));
+
+    // asset filter only matches asset events
+    AssetOwnershipChange ownershipChange;
+    setMem(&ownershipChange, sizeof(ownershipChange), 0);
+    ownershipChange.sourcePublicKey = a;
+    ownershipChange.destinationPublicKey = b;
+    ownershipChange.issuerPublicKey = c;
+    copyMem(ownershipChange.name, "QX\0\0\0\0\0", 7);
+    const unsigned int ownershipChangeSize = offsetof(AssetOwnershipChange, _terminator);
+    filter.identity = m256i::zero();
+    filter.assetIssuer = c;
+    filter.assetName = 'Q' | ('X' << 8);
+    EXPECT_TRUE(qLogger::matchesFilter(filter, ASSET_OWNERSHIP_CHANGE, (const char*)&ownershipChange, ownershipChangeSize));
+    EXPECT_FALSE(qLogger::matchesFilter(filter, QU_TRANSFER, (const char*)&transfer, transferSize));
+    filter.identity = a;
+    EXPECT_TRUE(qLogger::matchesFilter(filter, ASSET_OWNERSHIP_CHANGE, (const char*)&ownershipChange, ownershipChangeSize));
+    filter.assetName = 'Q';
+    EXPECT_FALSE(qLogger::matchesFilter(filter, ASSET_OWNERSHIP_CHANGE, (const char*)&ownershipChange, ownershipChangeSize));
+}
@@ -212,3 +212,99 @@ TEST_F(StableComputorIndexTest, MaxChange225)
     }
 }
 
+// Test: Mapping to previous indices is returned
+TEST_F(StableComputorIndexTest, PreviousComputorIndices)
+{
+    // Current: IDs 1 to 676
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    {
+        currentComputors[i] = makeId(i + 1);
+    }
+
+    // Future: IDs of multiples of 3 requalify (in reversed order), others are new
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    {
+        const unsigned int id = NUMBER_OF_COMPUTORS - i;
+        futureComputors[i] = (id % 3 == 0) ? makeId(id) : makeId(id + 1000);
+    }
+
+    unsigned short previousComputorIndices[NUMBER_OF_COMPUTORS];
+    bool result = calculateStableComputorIndex(futureComputors, currentComputors, tempBuffer, previousComputorIndices);
+    ASSERT_TRUE(result);
+
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    {
+        if ((i + 1) % 3 == 0)
+        {
+            EXPECT_EQ(futureComputors[i], makeId(i + 1)) << "Index " << i << " mismatch";
+            EXPECT_EQ(previousComputorIndices[i], i);
+        }
+        else
+        {
+            EXPECT_EQ(previousComputorIndices[i], NO_PREVIOUS_COMPUTOR_INDEX);
+        }
+    }
+}
+
+// Reference implementation with nested loops, which was used before the hash map
+static void calculateStableComputorIndexReference(m256i* futureComputors, const m256i* currentComputors)
+{
+    m256i result[NUMBER_OF_COMPUTORS];
+    bool isIndexTaken[NUMBER_OF_COMPUTORS] = { false };
+    bool isFutureComputorUsed[NUMBER_OF_COMPUTORS] = { false };
+    for (unsigned int futureIdx = 0; futureIdx < NUMBER_OF_COMPUTORS; futureIdx++)
+    {
+        for (unsigned int currentIdx = 0; currentIdx < NUMBER_OF_COMPUTORS; currentIdx++)
+        {
+            if (futureComputors[futureIdx] == currentComputors[currentIdx])
+            {
+                result[currentIdx] = futureComputors[futureIdx];
+                isIndexTaken[currentIdx] = true;
+                isFutureComputorUsed[futureIdx] = true;
+                break;
+            }
+        }
+    }
+    unsigned int nextNewComputorIdx = 0;
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+    {
+        if (!isIndexTaken[i])
+        {
+            while (isFutureComputorUsed[nextNewComputorIdx])
+                nextNewComputorIdx++;
+            result[i] = futureComputors[nextNewComputorIdx++];
+        }
+    }
+    memcpy(futureComputors, result, sizeof(result));
+}
+
+// Test: Same result as reference implementation with random keys, including duplicate and zero keys
+TEST_F(StableComputorIndexTest, RandomKeysMatchReference)
+{
+    for (unsigned int t = 0; t < 20; t++)
+    {
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        {
+            currentComputors[i] = m256i::randomValue();
+        }
+        currentComputors[1] = currentComputors[0];
+        currentComputors[2] = m256i::zero();
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        {
+            // future computors are unique, so duplicate current key is only taken once
+            const unsigned int currentIdx = (i * 7 + t) % NUMBER_OF_COMPUTORS;
+            futureComputors[i] = (i % 4 == 0 || currentIdx == 1) ? m256i::randomValue() : currentComputors[currentIdx];
+        }
+
+        m256i expectedComputors[NUMBER_OF_COMPUTORS];
+        memcpy(expectedComputors, futureComputors, sizeof(futureComputors));
+        calculateStableComputorIndexReference(expectedComputors, currentComputors);
+
+        bool result = calculateStableComputorIndex(futureComputors, currentComputors, tempBuffer);
+        ASSERT_TRUE(result);
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        {
+            EXPECT_EQ(futureComputors[i], expectedComputors[i]) << "Index " << i << " mismatch in test " << t;
+        }
+    }
+}
@@ -0,0 +1,226 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/network_core/state_chunk_download.h"
+
+#include <random>
+#include <vector>
+
+// Node side of RequestStateChunk for a small spectrum-like state, built like processRequestStateChunk() in qubic.cpp
+template <unsigned long long capacity>
+struct TestStateChunkServer
+{
+    std::vector<EntityRecord> records;
+    std::vector<m256i> digests;
+    std::vector<unsigned long long> changeFlags;
+    IncrementalMerkleTree<capacity> tree;
+    unsigned int tick = 100;
+
+    TestStateChunkServer() : records(capacity), digests(capacity * 2 - 1), changeFlags(IncrementalMerkleTree<capacity>::changeFlagWords)
+    {
+        std::mt19937_64 gen(42);
+        for (auto& record : records)
+        {
+            for (unsigned int i = 0; i < sizeof(EntityRecord) / 8; ++i)
+                ((unsigned long long*)&record)[i] = gen();
+        }
+        tree.init(digests.data(), changeFlags.data());
+        tree.markAllLeafsChanged();
+        update();
+    }
+
+    void update()
+    {
+        for (unsigned long long i = 0; i < capacity; ++i)
+        {
+            if (tree.isLeafChanged(i))
+                KangarooTwelve(&records[i], sizeof(EntityRecord), &tree.leafDigest(i), 32);
+        }
+        tree.updateInnerNodes();
+        ++tick;
+    }
+
+    void changeRecord(unsigned long long index)
+    {
+        records[index].incomingAmount += 1;
+        tree.markLeafChanged(index);
+    }
+
+    unsigned long long respond(const RequestStateChunk& request, std::vector<unsigned char>& buffer) const
+    {
+        buffer.assign(RespondStateChunk::maxPayloadSize, 0);
+        RespondStateChunk* response = (RespondStateChunk*)buffer.data();
+        response->tick = tick;
+        response->stateType = request.stateType;
+        response->firstIndex = request.firstIndex;
+        response->numberOfRecords = request.numberOfRecords;
+        response->rootDigest = tree.root();
+        unsigned int countLevel = 0;
+        while ((1u << countLevel) < request.numberOfRecords)
+            ++countLevel;
+        if (request.stateType & RequestStateChunk::chunkDigestsFlag)
+        {
+            for (unsigned int i = 0; i < request.numberOfRecords; ++i)
+                ((m256i*)response->records())[i] = tree.nodeDigest(request.level, request.firstIndex + i);
+            tree.getSubtreeSiblings(request.firstIndex >> countLevel, request.level + countLevel, response->siblings());
+            response->numberOfSiblings = (unsigned char)(tree.depth - request.level - countLevel);
+        }
+        else
+        {
+            copyMem(response->records(), &records[request.firstIndex], request.numberOfRecords * sizeof(EntityRecord));
+            tree.getSubtreeSiblings(request.firstIndex >> countLevel, countLevel, response->siblings());
+            response->numberOfSiblings = (unsigned char)(tree.depth - countLevel);
+        }
+        return response->payloadSize();
+    }
+};
+
+static StateChunkDownload download;
+
+TEST(TestCoreStateChunkDownload, DownloadsAndVerifiesRecords)
+{
+    constexpr unsigned long long capacity = 1ULL << 13;
+    TestStateChunkServer<capacity> server;
+    std::vector<EntityRecord> destination(capacity);
+    EXPECT_FALSE(download.init(RequestStateChunk::spectrumState, 0, destination.data(), capacity * sizeof(EntityRecord) - 1, 13));
+    ASSERT_TRUE(download.init(RequestStateChunk::spectrumState, 0, destination.data(), capacity * sizeof(EntityRecord), 13));
+    EXPECT_EQ(download.getChunkCount(), capacity / RequestStateChunk::maxRecords);
+
+    std::vector<unsigned char> buffer;
+    RequestStateChunk request;
+    unsigned int requests = 0;
+    while (download.getNextRequest(request))
+    {
+        ASSERT_LT(++requests, 100u);
+        const unsigned long long size = server.respond(request, buffer);
+        const RespondStateChunk* response = (const RespondStateChunk*)buffer.data();
+
+        // wrong root, tampered records, and wrong size are rejected
+        EXPECT_FALSE(download.processResponse(response, size, m256i::zero()));
+        EXPECT_FALSE(download.processResponse(response, size - 1, server.tree.root()));
+        buffer[sizeof(RespondStateChunk) + 5] ^= 1;
+        EXPECT_FALSE(download.processResponse(response, size, server.tree.root()));
+        buffer[sizeof(RespondStateChunk) + 5] ^= 1;
+
+        EXPECT_TRUE(download.processResponse(response, size, server.tree.root()));
+    }
+    // one request per chunk and one for checking the digests of all chunks
+    EXPECT_EQ(requests, download.getChunkCount() + 1);
+    EXPECT_TRUE(download.isComplete());
+    EXPECT_EQ(download.getTick(), server.tick);
+    EXPECT_EQ(memcmp(destination.data(), server.records.data(), capacity * sizeof(EntityRecord)), 0);
+}
+
+TEST(TestCoreStateChunkDownload, DownloadsChangedChunksAgain)
+{
+    constexpr unsigned long long capacity = 1ULL << 12;
+    TestStateChunkServer<capacity> server;
+    std::vector<EntityRecord> destination(capacity);
+    ASSERT_TRUE(download.init(RequestStateChunk::spectrumState, 0, destination.data(), capacity * sizeof(EntityRecord), 12));
+
+    std::vector<unsigned char> buffer;
+    RequestStateChunk request;
+    unsigned int requests = 0;
+    while (download.getNextRequest(request))
+    {
+        ASSERT_LT(++requests, 100u);
+
+        // records of the first chunk change after it has been downloaded
+        if (requests == 2 || requests == 3)
+        {
+            server.changeRecord(requests * 100);
+            server.update();
+        }
+
+        const unsigned long long size = server.respond(request, buffer);
+        EXPECT_TRUE(download.processResponse((const RespondStateChunk*)buffer.data(), size, server.tree.root()));
+    }
+    // first chunk and digests are requested again
+    EXPECT_EQ(requests, download.getChunkCount() + 3);
+    EXPECT_TRUE(download.isComplete());
+    EXPECT_EQ(download.getTick(), server.tick);
+    EXPECT_EQ(memcmp(destination.data(), server.records.data(), capacity * sizeof(EntityRecord)), 0);
+}
+
+TEST(TestCoreStateChunkDownload, ContractState)
+{
+    constexpr unsigned int contractIndex = 5;
+    constexpr unsigned int depth = 4;
+    const unsigned int stateSize = 2 * RequestStateChunk::maxContractStateBytes + 1000;
+    std::vector<unsigned char> state(stateSize), destination(stateSize);
+    std::mt19937 gen(1);
+    for (auto& byte : state)
+        byte = (unsigned char)gen();
+
+    std::vector<m256i> digests(2 * (1 << depth) - 1);
+    std::vector<unsigned long long> changeFlags(1);
+    IncrementalMerkleTree<1 << depth> tree;
+    tree.init(digests.data(), changeFlags.data());
+    auto updateTree = [&]()
+    {
+        for (unsigned int i = 0; i < (1 << depth); ++i)
+        {
+            tree.leafDigest(i) = m256i::zero();
+            tree.markLeafChanged(i);
+        }
+        KangarooTwelve(state.data(), stateSize, &tree.leafDigest(contractIndex), 32);
+        tree.updateInnerNodes();
+    };
+    updateTree();
+
+    unsigned int tick = 10;
+    std::vector<unsigned char> buffer;
+    auto respond = [&](const RequestStateChunk& request, bool tamper)
+    {
+        buffer.assign(RespondStateChunk::maxPayloadSize, 0);
+        RespondStateChunk* response = (RespondStateChunk*)buffer.data();
+        const unsigned int offset = request.firstIndex * RequestStateChunk::maxContractStateBytes;
+        EXPECT_LT(offset, stateSize);
+        response->tick = tick;
+        response->stateType = request.stateType;
+        response->contractIndex = request.contractIndex;
+        response->firstIndex = request.firstIndex;
+        response->numberOfRecords = std::min(stateSize - offset, RequestStateChunk::maxContractStateBytes);
+        response->rootDigest = tree.root();
+        copyMem(response->records(), state.data() + offset, response->numberOfRecords);
+        if (tamper)
+            ((unsigned char*)response->records())[0] ^= 1;
+        response->siblings()[0] = tree.leafDigest(contractIndex);
+        tree.getSiblings(contractIndex, response->siblings() + 1);
+        response->numberOfSiblings = 1 + depth;
+        return response->payloadSize();
+    };
+
+    ASSERT_TRUE(download.init(RequestStateChunk::contractState, contractIndex, destination.data(), stateSize, depth));
+    EXPECT_EQ(download.getChunkCount(), 3u);
+
+    // state changes after the first chunk -> chunk of new version restarts download
+    RequestStateChunk request;
+    ASSERT_TRUE(download.getNextRequest(request));
+    unsigned long long size = respond(request, false);
+    EXPECT_TRUE(download.processResponse((const RespondStateChunk*)buffer.data(), size, tree.root()));
+    EXPECT_EQ(download.getReceivedChunkCount(), 1u);
+    state[10] ^= 0xFF;
+    updateTree();
+    ++tick;
+    ASSERT_TRUE(download.getNextRequest(request));
+    size = respond(request, false);
+    EXPECT_TRUE(download.processResponse((const RespondStateChunk*)buffer.data(), size, tree.root()));
+    EXPECT_EQ(download.getReceivedChunkCount(), 1u);
+
+    // data not matching the state digest is detected after the last chunk
+    unsigned int requests = 0;
+    bool tamper = true;
+    while (download.getNextRequest(request))
+    {
+        ASSERT_LT(++requests, 20u);
+        size = respond(request, tamper);
+        tamper = false;
+        EXPECT_TRUE(download.processResponse((const RespondStateChunk*)buffer.data(), size, tree.root()));
+    }
+    EXPECT_GT(requests, 2u);
+    EXPECT_TRUE(download.isComplete());
+    EXPECT_EQ(download.getTick(), tick);
+    EXPECT_EQ(state, destination);
+}
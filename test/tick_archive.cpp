@@ -0,0 +1,119 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/ticking/tick_archive.h"
+
+#include <random>
+#include <vector>
+
+typedef TickArchive<2, 2> TestTickArchive;
+
+// Build pseudo-random tick with transactions in some slots
+static void buildTick(unsigned int tick, unsigned int seed, TickData& tickData, std::vector<Tick>& ticks,
+    std::vector<std::vector<unsigned char>>& transactionBuffers, const Transaction** transactions)
+{
+    std::mt19937 gen32(seed);
+
+    setMem(&tickData, sizeof(TickData), 0);
+    tickData.epoch = 123;
+    tickData.tick = tick;
+    tickData.computorIndex = gen32() % NUMBER_OF_COMPUTORS;
+
+    ticks.resize(NUMBER_OF_COMPUTORS);
+    setMem(ticks.data(), NUMBER_OF_COMPUTORS * sizeof(Tick), 0);
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; ++i)
+    {
+        ticks[i].epoch = 123;
+        ticks[i].tick = tick;
+        ticks[i].computorIndex = i;
+        ticks[i].prevResourceTestingDigest = gen32();
+    }
+
+    transactionBuffers.assign(NUMBER_OF_TRANSACTIONS_PER_TICK, std::vector<unsigned char>());
+    const unsigned int transactionNum = gen32() % 20;
+    for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; ++i)
+        transactions[i] = nullptr;
+    for (unsigned int i = 0; i < transactionNum; ++i)
+    {
+        const unsigned int slot = gen32() % NUMBER_OF_TRANSACTIONS_PER_TICK;
+        transactionBuffers[slot].assign(MAX_TRANSACTION_SIZE, 0);
+        Transaction* transaction = (Transaction*)transactionBuffers[slot].data();
+        transaction->sourcePublicKey = m256i((unsigned long long)gen32(), (unsigned long long)gen32(), 0ULL, 0ULL);
+        transaction->destinationPublicKey = m256i((unsigned long long)gen32(), (unsigned long long)gen32(), 0ULL, 0ULL);
+        transaction->amount = gen32();
+        transaction->tick = tick;
+        transaction->inputType = 0;
+        transaction->inputSize = gen32() % MAX_INPUT_SIZE;
+        transactions[slot] = transaction;
+        tickData.transactionDigests[slot] = m256i((unsigned long long)gen32(), (unsigned long long)gen32(), (unsigned long long)gen32(), (unsigned long long)tick);
+    }
+}
+
+TEST(TestTickArchive, AppendAndRead)
+{
+    TestTickArchive* archive = new TestTickArchive();
+    ASSERT_TRUE(archive->init());
+
+    const unsigned int firstTick = 7000000;
+    const unsigned int tickCount = 9;
+    archive->reset(firstTick);
+    EXPECT_FALSE(archive->contains(firstTick));
+    EXPECT_EQ(archive->getEndTick(), firstTick);
+
+    // append ticks, more than fit into the cache, so some are loaded from disk below
+    TickData tickData;
+    std::vector<Tick> ticks;
+    std::vector<std::vector<unsigned char>> transactionBuffers;
+    const Transaction* transactions[NUMBER_OF_TRANSACTIONS_PER_TICK];
+    archive->acquireLock();
+    for (unsigned int i = 0; i < tickCount; ++i)
+    {
+        buildTick(firstTick + i, i, tickData, ticks, transactionBuffers, transactions);
+        archive->appendTick(tickData, ticks.data(), transactions);
+    }
+    archive->releaseLock();
+    EXPECT_EQ(archive->getEndTick(), firstTick + tickCount);
+
+    // read in different orders: full segments in cache, on disk, and current segment
+    const unsigned int readOrder[] = { 8, 0, 1, 2, 7, 3, 4, 5, 6, 0, 8 };
+    archive->acquireLock();
+    for (unsigned int i : readOrder)
+    {
+        const unsigned int tick = firstTick + i;
+        buildTick(tick, i, tickData, ticks, transactionBuffers, transactions);
+
+        const TestTickArchive::TickRecord* record = archive->getTick(tick);
+        ASSERT_NE(record, nullptr);
+        EXPECT_EQ(memcmp(&record->tickData, &tickData, sizeof(TickData)), 0);
+        EXPECT_EQ(memcmp(record->ticks, ticks.data(), NUMBER_OF_COMPUTORS * sizeof(Tick)), 0);
+
+        for (unsigned int slot = 0; slot < NUMBER_OF_TRANSACTIONS_PER_TICK; ++slot)
+        {
+            const Transaction* transaction = archive->getTransaction(tick, slot);
+            if (!transactions[slot])
+            {
+                EXPECT_EQ(transaction, nullptr);
+                continue;
+            }
+            ASSERT_NE(transaction, nullptr);
+            EXPECT_EQ(memcmp(transaction, transactions[slot], transactions[slot]->totalSize()), 0);
+
+            const Transaction* found = archive->findTransaction(tick, tickData.transactionDigests[slot]);
+            ASSERT_NE(found, nullptr);
+            EXPECT_EQ(memcmp(found, transactions[slot], transactions[slot]->totalSize()), 0);
+        }
+    }
+
+    EXPECT_EQ(archive->getTick(firstTick - 1), nullptr);
+    EXPECT_EQ(archive->getTick(firstTick + tickCount), nullptr);
+    EXPECT_EQ(archive->findTransaction(firstTick, m256i(1ULL, 2ULL, 3ULL, 4ULL)), nullptr);
+    archive->releaseLock();
+
+    // reset discards archive
+    archive->reset(firstTick + 100);
+    EXPECT_FALSE(archive->contains(firstTick));
+
+    archive->deinit();
+    delete archive;
+}
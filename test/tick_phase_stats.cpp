@@ -0,0 +1,61 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/ticking/tick_phase_stats.h"
+
+TEST(TestTickPhaseStats, PercentilesAndSlidingWindow)
+{
+    TickPhaseStats<100>* stats = new TickPhaseStats<100>();
+    stats->reset();
+
+    RespondTickPhaseStats result;
+    stats->getStats(result);
+    EXPECT_EQ(result.windowSize, 100);
+    for (unsigned int i = 0; i < TICK_PHASE_COUNT; ++i)
+    {
+        EXPECT_EQ(result.phases[i].numberOfSamples, 0);
+        EXPECT_EQ(result.phases[i].p50, 0);
+        EXPECT_EQ(result.phases[i].p99, 0);
+        EXPECT_EQ(result.phases[i].max, 0);
+    }
+
+    // small values are exact
+    for (unsigned int i = 1; i <= 10; ++i)
+        stats->addSample(TICK_PHASE_DIGESTS, i);
+    stats->getStats(result);
+    EXPECT_EQ(result.phases[TICK_PHASE_DIGESTS].numberOfSamples, 10);
+    EXPECT_EQ(result.phases[TICK_PHASE_DIGESTS].p50, 5);
+    EXPECT_EQ(result.phases[TICK_PHASE_DIGESTS].p99, 10);
+    EXPECT_EQ(result.phases[TICK_PHASE_DIGESTS].max, 10);
+    EXPECT_EQ(result.phases[TICK_PHASE_QUORUM].numberOfSamples, 0);
+
+    // large values have bounded relative error, max is exact
+    for (unsigned int i = 1; i <= 100; ++i)
+        stats->addSample(TICK_PHASE_TOTAL, i * 10007ULL);
+    stats->getStats(result);
+    const RespondTickPhaseStats::PhaseStats& total = result.phases[TICK_PHASE_TOTAL];
+    EXPECT_EQ(total.numberOfSamples, 100);
+    EXPECT_GE(total.p50, 50 * 10007U);
+    EXPECT_LE(total.p50, 50 * 10007U + 50 * 10007U / 16);
+    EXPECT_GE(total.p99, 99 * 10007U);
+    EXPECT_LE(total.p99, 99 * 10007U + 99 * 10007U / 16);
+    EXPECT_EQ(total.max, 100 * 10007U);
+
+    // old samples leave window
+    for (unsigned int i = 0; i < 100; ++i)
+        stats->addSample(TICK_PHASE_TOTAL, 3);
+    stats->getStats(result);
+    EXPECT_EQ(result.phases[TICK_PHASE_TOTAL].numberOfSamples, 100);
+    EXPECT_EQ(result.phases[TICK_PHASE_TOTAL].p50, 3);
+    EXPECT_EQ(result.phases[TICK_PHASE_TOTAL].p99, 3);
+    EXPECT_EQ(result.phases[TICK_PHASE_TOTAL].max, 3);
+
+    // huge values are clamped
+    stats->addSample(TICK_PHASE_TOTAL, 1ULL << 40);
+    stats->getStats(result);
+    EXPECT_EQ(result.phases[TICK_PHASE_TOTAL].max, 0xffffffff);
+    EXPECT_EQ(result.phases[TICK_PHASE_TOTAL].p99, 3);
+
+    delete stats;
+}
@@ -207,3 +207,90 @@ TEST(TestCoreTickStorage, EpochTransition)
         ts.deinit();
     }
 }
+
+TEST(TestCoreTickStorage, EpochTransitionDeferredClearing)
+{
+    TestTickStorage ts;
+    unsigned int seed = 43;
+    std::mt19937 gen32(seed);
+    const unsigned short maxTransactions = NUMBER_OF_TRANSACTIONS_PER_TICK;
+
+    for (int testIdx = 0; testIdx < 3; ++testIdx)
+    {
+        ts.init();
+
+        // fill almost all ticks of first epoch (last one is first tick of next epoch), so stale data would be left in the storage
+        const int firstEpochTicks = MAX_NUMBER_OF_TICKS_PER_EPOCH - 1;
+        const unsigned int firstEpochTick0 = gen32() % 10000000;
+        const unsigned int secondEpochTick0 = firstEpochTick0 + firstEpochTicks;
+        unsigned int firstEpochSeeds[MAX_NUMBER_OF_TICKS_PER_EPOCH];
+        unsigned int secondEpochSeeds[MAX_NUMBER_OF_TICKS_PER_EPOCH];
+        for (int i = 0; i < MAX_NUMBER_OF_TICKS_PER_EPOCH; ++i)
+            firstEpochSeeds[i] = gen32();
+        for (int i = 0; i < MAX_NUMBER_OF_TICKS_PER_EPOCH; ++i)
+            secondEpochSeeds[i] = gen32();
+
+        ts.beginEpoch(firstEpochTick0, true);
+        EXPECT_FALSE(ts.isClearingPending());
+        for (int i = 0; i < firstEpochTicks; ++i)
+            ts.addTick(firstEpochTick0 + i, firstEpochSeeds[i], maxTransactions);
+
+        // epoch transition with deferred clearing: only first ticks are available
+        ts.beginEpoch(secondEpochTick0, true);
+        ts.checkStateConsistencyWithAssert();
+        EXPECT_TRUE(ts.isClearingPending());
+        EXPECT_TRUE(ts.tickInCurrentEpochStorage(secondEpochTick0));
+        EXPECT_FALSE(ts.tickInCurrentEpochStorage(secondEpochTick0 + MAX_NUMBER_OF_TICKS_PER_EPOCH - 1));
+        EXPECT_EQ(ts.tickData.getByTickIfNotEmpty(secondEpochTick0 + MAX_NUMBER_OF_TICKS_PER_EPOCH - 1), nullptr);
+        for (int i = 0; i < MAX_NUMBER_OF_TICKS_PER_EPOCH; ++i)
+        {
+            const unsigned int tick = secondEpochTick0 + i;
+            if (ts.tickInCurrentEpochStorage(tick))
+            {
+                EXPECT_EQ(ts.tickData.getByTickInCurrentEpoch(tick).epoch, 0);
+                EXPECT_EQ(ts.ticks.getByTickInCurrentEpoch(tick)[0].epoch, 0);
+            }
+        }
+
+        // add some ticks with transactions before clearing is finished
+        const int ticksBeforeClearing = 3;
+        for (int i = 0; i < ticksBeforeClearing; ++i)
+            ts.addTick(secondEpochTick0 + i, secondEpochSeeds[i], maxTransactions);
+
+        // clear rest in steps, this must not touch the transactions already added
+        if (testIdx == 0)
+        {
+            ts.ensureClearedAhead(secondEpochTick0 + MAX_NUMBER_OF_TICKS_PER_EPOCH);
+            EXPECT_TRUE(ts.tickInCurrentEpochStorage(secondEpochTick0 + MAX_NUMBER_OF_TICKS_PER_EPOCH - 1));
+        }
+        unsigned int steps = 0;
+        while (ts.clearAhead())
+            ++steps;
+        EXPECT_GT(steps, 0u);
+        EXPECT_FALSE(ts.isClearingPending());
+        EXPECT_FALSE(ts.clearAhead());
+        ts.checkStateConsistencyWithAssert();
+
+        for (int i = 0; i < ticksBeforeClearing; ++i)
+            ts.checkTick(secondEpochTick0 + i, secondEpochSeeds[i], maxTransactions);
+        for (int i = ticksBeforeClearing; i < MAX_NUMBER_OF_TICKS_PER_EPOCH; ++i)
+        {
+            const unsigned int tick = secondEpochTick0 + i;
+            EXPECT_TRUE(ts.tickInCurrentEpochStorage(tick));
+            EXPECT_EQ(ts.tickData.getByTickInCurrentEpoch(tick).epoch, 0);
+            const unsigned long long* offsets = ts.tickTransactionOffsets.getByTickInCurrentEpoch(tick);
+            for (unsigned int j = 0; j < NUMBER_OF_TRANSACTIONS_PER_TICK; ++j)
+                EXPECT_EQ(offsets[j], 0);
+        }
+
+        // fill remaining ticks and check all
+        for (int i = ticksBeforeClearing; i < MAX_NUMBER_OF_TICKS_PER_EPOCH; ++i)
+            ts.addTick(secondEpochTick0 + i, secondEpochSeeds[i], maxTransactions);
+        for (int i = 0; i < MAX_NUMBER_OF_TICKS_PER_EPOCH; ++i)
+            ts.checkTick(secondEpochTick0 + i, secondEpochSeeds[i], maxTransactions);
+        for (int i = 0; i < firstEpochTicks; ++i)
+            ts.checkTick(firstEpochTick0 + i, firstEpochSeeds[i], maxTransactions, true);
+
+        ts.deinit();
+    }
+}
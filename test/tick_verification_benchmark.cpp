@@ -0,0 +1,498 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/platform/memory.h"
+#include "../src/four_q.h"
+#include "../src/kangaroo_twelve.h"
+#include "../src/network_messages/tick.h"
+#include "../src/network_messages/transactions.h"
+#include "../src/public_settings.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Offline benchmark of the tick data verification, run on the ticks stored in a tick storage snapshot (files written
+// by TickStorage::trySaveToFile()), for measuring its throughput independently of the network.
+//
+// This is not a replay of the ticks: processTick() and the contract procedures live in qubic.cpp, which is only built
+// for UEFI, so the transactions aren't executed and no spectrum/universe/computer digests are compared. For each tick,
+// the benchmark checks the tick data against the digest the quorum voted for in the previous tick, and checks digest
+// and signature of each transaction. The real snapshot of an epoch is verified by
+// TestCoreTickVerificationBenchmark.SnapshotFromEnvironment if QUBIC_TICK_VERIFICATION_DIR and
+// QUBIC_TICK_VERIFICATION_EPOCH are set (optionally QUBIC_TICK_VERIFICATION_MAX_TICKS).
+
+// Snapshot file names of epoch, see SNAPSHOT_*_FILE_NAME in tick_storage.h
+static std::string snapshotFileName(const std::string& directory, const char* name, unsigned int epoch)
+{
+    char suffix[8];
+    snprintf(suffix, sizeof(suffix), ".%03u", epoch % 1000);
+    return directory + "/" + name + suffix;
+}
+
+// Reads snapshot files of tick storage, streaming the data of one tick at a time
+class TickStorageSnapshotReader
+{
+public:
+    // Layout of TickStorage::MetaData
+    struct MetaData
+    {
+        unsigned int epoch;
+        unsigned int tickBegin;
+        unsigned int tickEnd;
+        long long outTotalTransactionSize;
+        unsigned long long outNextTickTransactionOffset;
+    };
+    static_assert(sizeof(MetaData) == 32, "Unexpected size of MetaData");
+
+    bool open(const std::string& directory, unsigned int epoch)
+    {
+        std::ifstream metaDataFile(snapshotFileName(directory, "snapshotMetadata", epoch), std::ios::binary);
+        if (!metaDataFile || !metaDataFile.read((char*)&metaData, sizeof(metaData)))
+            return false;
+        if (metaData.epoch != epoch || metaData.tickBegin > metaData.tickEnd)
+            return false;
+
+        tickDataFile.open(snapshotFileName(directory, "snapshotTickdata", epoch), std::ios::binary);
+        ticksFile.open(snapshotFileName(directory, "snapshotTicks", epoch), std::ios::binary);
+        offsetsFile.open(snapshotFileName(directory, "snapshotTickTransactionOffsets", epoch), std::ios::binary);
+        transactionsFile.open(snapshotFileName(directory, "snapshotTickTransaction", epoch), std::ios::binary);
+        return tickDataFile && ticksFile && offsetsFile && transactionsFile;
+    }
+
+    unsigned int tickBegin() const
+    {
+        return metaData.tickBegin;
+    }
+
+    unsigned int tickEnd() const
+    {
+        return metaData.tickEnd;
+    }
+
+    // Read tick data, NUMBER_OF_COMPUTORS votes, and NUMBER_OF_TRANSACTIONS_PER_TICK transaction offsets of tick
+    bool readTick(unsigned int tick, TickData& tickData, Tick* votes, unsigned long long* offsets)
+    {
+        const unsigned long long tickIndex = tick - metaData.tickBegin;
+        return readAt(tickDataFile, tickIndex * sizeof(TickData), &tickData, sizeof(TickData))
+            && readAt(ticksFile, tickIndex * NUMBER_OF_COMPUTORS * sizeof(Tick), votes, NUMBER_OF_COMPUTORS * sizeof(Tick))
+            && readAt(offsetsFile, tickIndex * NUMBER_OF_TRANSACTIONS_PER_TICK * sizeof(unsigned long long), offsets,
+                NUMBER_OF_TRANSACTIONS_PER_TICK * sizeof(unsigned long long));
+    }
+
+    // Read transaction at offset into buffer of MAX_TRANSACTION_SIZE bytes
+    bool readTransaction(unsigned long long offset, unsigned char* buffer)
+    {
+        if (offset + sizeof(Transaction) > (unsigned long long)metaData.outTotalTransactionSize
+            || !readAt(transactionsFile, offset, buffer, sizeof(Transaction)))
+            return false;
+        const Transaction* transaction = (const Transaction*)buffer;
+        if (transaction->inputSize > MAX_INPUT_SIZE
+            || offset + transaction->totalSize() > (unsigned long long)metaData.outTotalTransactionSize)
+            return false;
+        return readAt(transactionsFile, offset + sizeof(Transaction), buffer + sizeof(Transaction), transaction->totalSize() - sizeof(Transaction));
+    }
+
+private:
+    static bool readAt(std::ifstream& file, unsigned long long offset, void* buffer, unsigned long long size)
+    {
+        file.seekg(offset);
+        return (bool)file.read((char*)buffer, size);
+    }
+
+    MetaData metaData;
+    std::ifstream tickDataFile, ticksFile, offsetsFile, transactionsFile;
+};
+
+// Verifies ticks of snapshot and collects statistics
+class TickVerificationBenchmark
+{
+public:
+    enum Phase
+    {
+        PHASE_LOAD = 0,
+        PHASE_TICK_DATA_DIGEST,
+        PHASE_TRANSACTION_DIGESTS,
+        PHASE_SIGNATURES,
+        PHASE_COUNT
+    };
+
+    struct Statistics
+    {
+        unsigned long long ticks;
+        unsigned long long emptyTicks;
+        unsigned long long transactions;
+        unsigned long long transactionBytes;
+
+        // Ticks whose tick data digest differs from the one confirmed by a quorum of votes of the previous tick
+        unsigned long long tickDataMismatches;
+
+        // Ticks without quorum on the tick data digest in the snapshot (e.g. first tick of snapshot, missing votes)
+        unsigned long long unconfirmedTicks;
+
+        // Transactions that are missing, have a digest not matching the tick data, or have an invalid signature
+        unsigned long long invalidTransactions;
+
+        // Transactions and bytes per destination contract (index 0: transfers to non-contract entities)
+        unsigned long long contractTransactions[MAX_NUMBER_OF_CONTRACTS];
+        unsigned long long contractTransactionBytes[MAX_NUMBER_OF_CONTRACTS];
+
+        double phaseSeconds[PHASE_COUNT];
+        double totalSeconds;
+    };
+
+    TickVerificationBenchmark()
+        : votes(NUMBER_OF_COMPUTORS), previousVotes(NUMBER_OF_COMPUTORS), offsets(NUMBER_OF_TRANSACTIONS_PER_TICK),
+        transactionBuffer(MAX_TRANSACTION_SIZE)
+    {
+    }
+
+    // Verify ticks [tickBegin, tickBegin + maxTicks) of snapshot (limited to the ticks in the snapshot). Return false on
+    // read error.
+    bool run(TickStorageSnapshotReader& snapshot, unsigned long long maxTicks = ~0ULL)
+    {
+        setMem(&stats, sizeof(stats), 0);
+        const auto startTime = std::chrono::steady_clock::now();
+        bool havePreviousVotes = false;
+        for (unsigned int tick = snapshot.tickBegin(); tick <= snapshot.tickEnd() && stats.ticks < maxTicks; ++tick)
+        {
+            auto phaseStart = std::chrono::steady_clock::now();
+            if (!snapshot.readTick(tick, tickData, votes.data(), offsets.data()))
+                return false;
+            endPhase(PHASE_LOAD, phaseStart);
+
+            m256i tickDataDigest = m256i::zero();
+            if (tickData.epoch)
+                KangarooTwelve(&tickData, sizeof(TickData), &tickDataDigest, sizeof(tickDataDigest));
+            else
+                ++stats.emptyTicks;
+            if (havePreviousVotes)
+                checkTickDataDigest(tickDataDigest);
+            else
+                ++stats.unconfirmedTicks;
+            endPhase(PHASE_TICK_DATA_DIGEST, phaseStart);
+
+            if (tickData.epoch)
+            {
+                for (unsigned int i = 0; i < NUMBER_OF_TRANSACTIONS_PER_TICK; ++i)
+                {
+                    if (isZero(tickData.transactionDigests[i]))
+                        continue;
+                    if (!verifyTransaction(snapshot, tickData.transactionDigests[i], offsets[i]))
+                        ++stats.invalidTransactions;
+                }
+            }
+
+            votes.swap(previousVotes);
+            havePreviousVotes = true;
+            ++stats.ticks;
+        }
+        stats.totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        return true;
+    }
+
+    const Statistics& getStatistics() const
+    {
+        return stats;
+    }
+
+    void printReport(std::ostream& out) const
+    {
+        static const char* phaseNames[PHASE_COUNT] = { "load", "tick data digest", "transaction digests", "signatures" };
+        const double seconds = (stats.totalSeconds > 0) ? stats.totalSeconds : 1e-9;
+        out << "Verified " << stats.ticks << " ticks (" << stats.emptyTicks << " empty) with " << stats.transactions
+            << " transactions (" << stats.transactionBytes << " bytes) in " << stats.totalSeconds << " s: "
+            << stats.ticks / seconds << " ticks/s, " << stats.transactions / seconds << " txs/s" << std::endl;
+        out << "Tick data mismatches: " << stats.tickDataMismatches << ", unconfirmed ticks: " << stats.unconfirmedTicks
+            << ", invalid transactions: " << stats.invalidTransactions << std::endl;
+        for (unsigned int phase = 0; phase < PHASE_COUNT; ++phase)
+        {
+            out << "  " << phaseNames[phase] << ": " << stats.phaseSeconds[phase] << " s ("
+                << 100.0 * stats.phaseSeconds[phase] / seconds << "%)" << std::endl;
+        }
+        for (unsigned int contractIndex = 0; contractIndex < MAX_NUMBER_OF_CONTRACTS; ++contractIndex)
+        {
+            if (stats.contractTransactions[contractIndex])
+            {
+                out << "  contract " << contractIndex << ": " << stats.contractTransactions[contractIndex] << " txs, "
+                    << stats.contractTransactionBytes[contractIndex] << " bytes" << std::endl;
+            }
+        }
+    }
+
+private:
+    void endPhase(Phase phase, std::chrono::steady_clock::time_point& phaseStart)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        stats.phaseSeconds[phase] += std::chrono::duration<double>(now - phaseStart).count();
+        phaseStart = now;
+    }
+
+    // Compare digest of tick data with expectedNextTickTransactionDigest of the votes for the previous tick
+    void checkTickDataDigest(const m256i& tickDataDigest)
+    {
+        unsigned int matchingVotes = 0, otherVotes = 0;
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; ++i)
+        {
+            if (!previousVotes[i].epoch)
+                continue;
+            if (previousVotes[i].expectedNextTickTransactionDigest == tickDataDigest)
+                ++matchingVotes;
+            else
+                ++otherVotes;
+        }
+        if (otherVotes >= QUORUM)
+            ++stats.tickDataMismatches;
+        else if (matchingVotes < QUORUM)
+            ++stats.unconfirmedTicks;
+    }
+
+    // Load transaction, check its digest and signature, and count it. Return false if transaction is invalid.
+    bool verifyTransaction(TickStorageSnapshotReader& snapshot, const m256i& expectedDigest, unsigned long long offset)
+    {
+        auto phaseStart = std::chrono::steady_clock::now();
+        const bool loaded = offset && snapshot.readTransaction(offset, transactionBuffer.data());
+        endPhase(PHASE_LOAD, phaseStart);
+        if (!loaded)
+            return false;
+
+        const Transaction* transaction = (const Transaction*)transactionBuffer.data();
+        const unsigned int transactionSize = transaction->totalSize();
+        m256i digest;
+        KangarooTwelve(transaction, transactionSize, &digest, sizeof(digest));
+        endPhase(PHASE_TRANSACTION_DIGESTS, phaseStart);
+        if (digest != expectedDigest)
+            return false;
+
+        KangarooTwelve(transaction, transactionSize - SIGNATURE_SIZE, &digest, sizeof(digest));
+        const bool signatureValid = verify(transaction->sourcePublicKey.m256i_u8, digest.m256i_u8,
+            transactionBuffer.data() + transactionSize - SIGNATURE_SIZE);
+        endPhase(PHASE_SIGNATURES, phaseStart);
+        if (!signatureValid)
+            return false;
+
+        // contracts are identified by public keys with the contract index in the first 8 bytes and zero otherwise
+        const m256i& destination = transaction->destinationPublicKey;
+        unsigned long long contractIndex = destination.m256i_u64[0];
+        if (destination.m256i_u64[1] || destination.m256i_u64[2] || destination.m256i_u64[3] || contractIndex >= MAX_NUMBER_OF_CONTRACTS)
+            contractIndex = 0;
+        ++stats.contractTransactions[contractIndex];
+        stats.contractTransactionBytes[contractIndex] += transactionSize;
+        ++stats.transactions;
+        stats.transactionBytes += transactionSize;
+        return true;
+    }
+
+    TickData tickData;
+    std::vector<Tick> votes, previousVotes;
+    std::vector<unsigned long long> offsets;
+    std::vector<unsigned char> transactionBuffer;
+    Statistics stats;
+};
+
+
+// Builds snapshot files of a few ticks with signed transactions and votes
+class TestSnapshotWriter
+{
+public:
+    TestSnapshotWriter(unsigned int epoch, unsigned int tickBegin, unsigned int tickCount)
+        : epoch(epoch), tickBegin(tickBegin), tickDatas(tickCount), votes(tickCount * NUMBER_OF_COMPUTORS),
+        offsets(tickCount * NUMBER_OF_TRANSACTIONS_PER_TICK), transactions(FIRST_TICK_TRANSACTION_OFFSET)
+    {
+        subseed = m256i(1, 2, 3, 4);
+        m256i privateKey;
+        getPrivateKey(subseed.m256i_u8, privateKey.m256i_u8);
+        getPublicKey(privateKey.m256i_u8, publicKey.m256i_u8);
+    }
+
+    // Add transaction with inputSize bytes of payload to tick
+    void addTransaction(unsigned int tick, unsigned int transactionIndex, unsigned long long destinationContract, unsigned short inputSize)
+    {
+        const unsigned int tickIndex = tick - tickBegin;
+        TickData& tickData = tickDatas[tickIndex];
+        tickData.epoch = epoch;
+        tickData.tick = tick;
+
+        std::vector<unsigned char> buffer(sizeof(Transaction) + inputSize + SIGNATURE_SIZE);
+        Transaction* transaction = (Transaction*)buffer.data();
+        transaction->sourcePublicKey = publicKey;
+        transaction->destinationPublicKey = m256i(destinationContract, 0, 0, 0);
+        transaction->amount = 1000;
+        transaction->tick = tick;
+        transaction->inputType = 1;
+        transaction->inputSize = inputSize;
+        for (unsigned int i = 0; i < inputSize; ++i)
+            transaction->inputPtr()[i] = (unsigned char)(i * 7 + tick);
+        m256i digest;
+        KangarooTwelve(transaction, transaction->totalSize() - SIGNATURE_SIZE, &digest, sizeof(digest));
+        sign(subseed.m256i_u8, publicKey.m256i_u8, digest.m256i_u8, transaction->signaturePtr());
+        KangarooTwelve(transaction, transaction->totalSize(), &tickData.transactionDigests[transactionIndex], sizeof(m256i));
+
+        offsets[tickIndex * NUMBER_OF_TRANSACTIONS_PER_TICK + transactionIndex] = transactions.size();
+        transactions.insert(transactions.end(), buffer.begin(), buffer.end());
+    }
+
+    // Add votes of voteCount computors for each tick, confirming the tick data of the following tick
+    void addVotes(unsigned int voteCount)
+    {
+        for (unsigned int tickIndex = 0; tickIndex < tickDatas.size(); ++tickIndex)
+        {
+            m256i nextTickDataDigest = m256i::zero();
+            if (tickIndex + 1 < tickDatas.size() && tickDatas[tickIndex + 1].epoch)
+                KangarooTwelve(&tickDatas[tickIndex + 1], sizeof(TickData), &nextTickDataDigest, sizeof(nextTickDataDigest));
+            for (unsigned int computorIndex = 0; computorIndex < voteCount; ++computorIndex)
+            {
+                Tick& vote = votes[tickIndex * NUMBER_OF_COMPUTORS + computorIndex];
+                vote.computorIndex = computorIndex;
+                vote.epoch = epoch;
+                vote.tick = tickBegin + tickIndex;
+                vote.expectedNextTickTransactionDigest = nextTickDataDigest;
+            }
+        }
+    }
+
+    std::vector<unsigned char>& transactionData()
+    {
+        return transactions;
+    }
+
+    void write(const std::string& directory) const
+    {
+        TickStorageSnapshotReader::MetaData metaData;
+        metaData.epoch = epoch;
+        metaData.tickBegin = tickBegin;
+        metaData.tickEnd = tickBegin + (unsigned int)tickDatas.size() - 1;
+        metaData.outTotalTransactionSize = transactions.size();
+        metaData.outNextTickTransactionOffset = transactions.size();
+        writeFile(snapshotFileName(directory, "snapshotMetadata", epoch), &metaData, sizeof(metaData));
+        writeFile(snapshotFileName(directory, "snapshotTickdata", epoch), tickDatas.data(), tickDatas.size() * sizeof(TickData));
+        writeFile(snapshotFileName(directory, "snapshotTicks", epoch), votes.data(), votes.size() * sizeof(Tick));
+        writeFile(snapshotFileName(directory, "snapshotTickTransactionOffsets", epoch), offsets.data(), offsets.size() * sizeof(unsigned long long));
+        writeFile(snapshotFileName(directory, "snapshotTickTransaction", epoch), transactions.data(), transactions.size());
+    }
+
+    void remove(const std::string& directory) const
+    {
+        for (const char* name : { "snapshotMetadata", "snapshotTickdata", "snapshotTicks", "snapshotTickTransactionOffsets", "snapshotTickTransaction" })
+            std::remove(snapshotFileName(directory, name, epoch).c_str());
+    }
+
+private:
+    static void writeFile(const std::string& fileName, const void* data, unsigned long long size)
+    {
+        std::ofstream file(fileName, std::ios::binary);
+        ASSERT_TRUE(file && file.write((const char*)data, size));
+    }
+
+    unsigned int epoch;
+    unsigned int tickBegin;
+    m256i subseed, publicKey;
+    std::vector<TickData> tickDatas;
+    std::vector<Tick> votes;
+    std::vector<unsigned long long> offsets;
+    std::vector<unsigned char> transactions;
+};
+
+TEST(TestCoreTickVerificationBenchmark, SyntheticSnapshot)
+{
+    constexpr unsigned int epoch = 123, tickBegin = 20000000, tickCount = 6;
+    const std::string directory = ".";
+    TestSnapshotWriter writer(epoch, tickBegin, tickCount);
+    for (unsigned int i = 0; i < 10; ++i)
+        writer.addTransaction(tickBegin, i, 0, 0);
+    for (unsigned int i = 0; i < 5; ++i)
+        writer.addTransaction(tickBegin + 1, 2 * i, 1, 100);
+    writer.addTransaction(tickBegin + 3, 0, 4, 1000);
+    writer.addTransaction(tickBegin + 3, 1023, 0, 16);
+    for (unsigned int i = 0; i < 20; ++i)
+        writer.addTransaction(tickBegin + 5, i, 1 + i % 3, 32);
+    writer.addVotes(QUORUM);
+    writer.write(directory);
+
+    TickVerificationBenchmark* benchmark = new TickVerificationBenchmark();
+    {
+        TickStorageSnapshotReader snapshot;
+        ASSERT_TRUE(snapshot.open(directory, epoch));
+        EXPECT_EQ(snapshot.tickBegin(), tickBegin);
+        EXPECT_EQ(snapshot.tickEnd(), tickBegin + tickCount - 1);
+        EXPECT_TRUE(benchmark->run(snapshot));
+        benchmark->printReport(std::cout);
+
+        const TickVerificationBenchmark::Statistics& stats = benchmark->getStatistics();
+        EXPECT_EQ(stats.ticks, tickCount);
+        EXPECT_EQ(stats.emptyTicks, 2);
+        EXPECT_EQ(stats.transactions, 37);
+        EXPECT_EQ(stats.tickDataMismatches, 0);
+        EXPECT_EQ(stats.unconfirmedTicks, 1); // first tick has no votes of previous tick
+        EXPECT_EQ(stats.invalidTransactions, 0);
+        EXPECT_EQ(stats.contractTransactions[0], 11);
+        EXPECT_EQ(stats.contractTransactions[1], 5 + 7);
+        EXPECT_EQ(stats.contractTransactions[2], 7);
+        EXPECT_EQ(stats.contractTransactions[3], 6);
+        EXPECT_EQ(stats.contractTransactions[4], 1);
+        EXPECT_EQ(stats.contractTransactionBytes[4], sizeof(Transaction) + 1000 + SIGNATURE_SIZE);
+    }
+
+    // limit number of ticks
+    {
+        TickStorageSnapshotReader snapshot;
+        ASSERT_TRUE(snapshot.open(directory, epoch));
+        EXPECT_TRUE(benchmark->run(snapshot, 2));
+        EXPECT_EQ(benchmark->getStatistics().ticks, 2);
+        EXPECT_EQ(benchmark->getStatistics().transactions, 15);
+    }
+
+    // corrupted transaction is detected
+    writer.transactionData()[FIRST_TICK_TRANSACTION_OFFSET + 40] ^= 1;
+    writer.write(directory);
+    {
+        TickStorageSnapshotReader snapshot;
+        ASSERT_TRUE(snapshot.open(directory, epoch));
+        EXPECT_TRUE(benchmark->run(snapshot));
+        EXPECT_EQ(benchmark->getStatistics().invalidTransactions, 1);
+        EXPECT_EQ(benchmark->getStatistics().transactions, 36);
+    }
+
+    // votes of other computors for different tick data are detected
+    writer.addVotes(NUMBER_OF_COMPUTORS);
+    writer.addTransaction(tickBegin + 2, 0, 0, 0);
+    writer.write(directory);
+    {
+        TickStorageSnapshotReader snapshot;
+        ASSERT_TRUE(snapshot.open(directory, epoch));
+        EXPECT_TRUE(benchmark->run(snapshot));
+        EXPECT_EQ(benchmark->getStatistics().tickDataMismatches, 1);
+    }
+
+    // wrong epoch
+    {
+        TickStorageSnapshotReader snapshot;
+        EXPECT_FALSE(snapshot.open(directory, epoch + 1));
+    }
+
+    writer.remove(directory);
+    delete benchmark;
+}
+
+TEST(TestCoreTickVerificationBenchmark, SnapshotFromEnvironment)
+{
+    const char* directory = getenv("QUBIC_TICK_VERIFICATION_DIR");
+    const char* epoch = getenv("QUBIC_TICK_VERIFICATION_EPOCH");
+    if (!directory || !epoch)
+        GTEST_SKIP() << "Set QUBIC_TICK_VERIFICATION_DIR and QUBIC_TICK_VERIFICATION_EPOCH to verify a tick storage snapshot";
+    const char* maxTicks = getenv("QUBIC_TICK_VERIFICATION_MAX_TICKS");
+
+    TickStorageSnapshotReader snapshot;
+    ASSERT_TRUE(snapshot.open(directory, atoi(epoch)));
+    TickVerificationBenchmark* benchmark = new TickVerificationBenchmark();
+    EXPECT_TRUE(benchmark->run(snapshot, maxTicks ? strtoull(maxTicks, nullptr, 10) : ~0ULL));
+    benchmark->printReport(std::cout);
+    EXPECT_EQ(benchmark->getStatistics().tickDataMismatches, 0);
+    EXPECT_EQ(benchmark->getStatistics().invalidTransactions, 0);
+    delete benchmark;
+}
@@ -24,6 +24,11 @@
 #include "gtest/gtest.h"
 #include "../src/platform/uint128.h"
 
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
 
 TEST(Uint128Arithmetic, add){
     uint128_t low (0, 1);
@@ -61,6 +66,30 @@ TEST(Uint128Arithmetic, divide){
     EXPECT_EQ(big_val   / big_val,   uint128_t(0, 1));
 
     // EXPECT_THROW(uint128_t(1) / uint128_t(0), std::domain_error);
+
+    // 128-bit dividends with 64-bit and 128-bit divisors
+    const uint128_t max(0xffffffffffffffffULL, 0xffffffffffffffffULL);
+    EXPECT_EQ(max / uint128_t(2), uint128_t(0x7fffffffffffffffULL, 0xffffffffffffffffULL));
+    EXPECT_EQ(max / uint128_t(0xffffffffffffffffULL), uint128_t(1, 1));
+    EXPECT_EQ(max / uint128_t(1, 0), uint128_t(0xffffffffffffffffULL));
+    EXPECT_EQ(max / max, uint128_t(1));
+    EXPECT_EQ(uint128_t(0xfdb8e2bacbfe7cefULL, 0x010e6cd7a44a4100ULL) / big_val, big_val);
+}
+
+TEST(Uint128Arithmetic, divmodRandom){
+    std::mt19937_64 gen64(42);
+    for (int i = 0; i < 100000; ++i){
+        // vary magnitude of dividend and divisor to cover all code paths
+        const uint128_t lhs = uint128_t(gen64(), gen64()) >> uint128_t(gen64() % 128);
+        const uint128_t rhs = uint128_t(gen64(), gen64()) >> uint128_t(gen64() % 128);
+        if (!rhs)
+            continue;
+        uint128_t q(0), r(0);
+        lhs.divmod(lhs, rhs, q, r);
+        EXPECT_TRUE(r < rhs);
+        EXPECT_EQ(q * rhs + r, lhs);
+        EXPECT_EQ(lhs / rhs, q);
+    }
 }
 
 TEST(Uint128Arithmetic, multiply){
@@ -75,6 +104,47 @@ TEST(Uint128Arithmetic, multiply){
     const uint128_t one = 1;
     EXPECT_EQ(val * one, val);
     EXPECT_EQ(one * val, val);
+
+    // overflow beyond 128 bits is discarded
+    const uint128_t max(0xffffffffffffffffULL, 0xffffffffffffffffULL);
+    EXPECT_EQ(max * max, one);
+    EXPECT_EQ(uint128_t(1, 0) * uint128_t(1, 0), zero);
+    EXPECT_EQ(uint128_t(0x123456789abcdefULL, 0xfedcba9876543210ULL) * uint128_t(0x10),
+        uint128_t(0x123456789abcdeffULL, 0xedcba98765432100ULL));
+    EXPECT_EQ(uint128_t(3, 5) * uint128_t(7, 11), uint128_t(3 * 11 + 5 * 7, 55));
+}
+
+TEST(Uint128Arithmetic, performance){
+    constexpr int N = 10000000;
+    std::mt19937_64 gen64(42);
+    std::vector<uint64_t> values(1024);
+    for (auto& v : values)
+        v = gen64();
+    uint128_t sum(0);
+
+    // 64x64 -> 128-bit multiplication, as used by contracts for prices and fees
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < N; ++i)
+        sum += uint128_t(values[i & 1023]) * uint128_t(values[(i + 1) & 1023]);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::cout << N << " x multiply: " << ms << " milliseconds" << std::endl;
+
+    // 128/64-bit division
+    t0 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < N; ++i)
+        sum += uint128_t(values[i & 1023], values[(i + 1) & 1023]) / uint128_t(values[(i + 2) & 1023] | 1);
+    t1 = std::chrono::high_resolution_clock::now();
+    ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::cout << N << " x divide 128/64: " << ms << " milliseconds" << std::endl;
+
+    // 128/128-bit division
+    t0 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < N; ++i)
+        sum += uint128_t(values[i & 1023], values[(i + 1) & 1023]) / uint128_t(values[(i + 2) & 1023] >> 32, values[(i + 3) & 1023]);
+    t1 = std::chrono::high_resolution_clock::now();
+    ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::cout << N << " x divide 128/128: " << ms << " milliseconds (checksum " << sum.high << " " << sum.low << ")" << std::endl;
 }
 
 TEST(Uint128Comparison, equals){
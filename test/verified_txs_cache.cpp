@@ -0,0 +1,53 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+#include "../src/ticking/verified_txs_cache.h"
+
+#include <random>
+
+class TestVerifiedTxsCache : public VerifiedTxsCache
+{
+public:
+    static unsigned int getSlot(const m256i& digest)
+    {
+        return slot(digest);
+    }
+};
+
+TEST(TestVerifiedTxsCache, AddAndContains)
+{
+    TestVerifiedTxsCache cache;
+    EXPECT_TRUE(cache.init());
+
+    std::mt19937_64 gen64(4321);
+    m256i digests[100];
+    for (unsigned int i = 0; i < 100; ++i)
+    {
+        // make sure the digests use different slots
+        m256i& digest = digests[i];
+        digest = m256i(gen64(), gen64(), gen64(), gen64());
+        digest.m256i_u32[1] = i;
+        EXPECT_FALSE(cache.contains(digest));
+    }
+    EXPECT_FALSE(cache.contains(m256i::zero()));
+
+    for (const auto& digest : digests)
+        cache.add(digest);
+    for (const auto& digest : digests)
+        EXPECT_TRUE(cache.contains(digest));
+
+    // digest with same slot replaces old entry
+    m256i otherDigest = digests[0];
+    otherDigest.m256i_u64[3] ^= 1;
+    EXPECT_EQ(cache.getSlot(otherDigest), cache.getSlot(digests[0]));
+    EXPECT_FALSE(cache.contains(otherDigest));
+    cache.add(otherDigest);
+    EXPECT_TRUE(cache.contains(otherDigest));
+    EXPECT_FALSE(cache.contains(digests[0]));
+
+    // init clears the cache
+    cache.deinit();
+    EXPECT_TRUE(cache.init());
+    EXPECT_FALSE(cache.contains(digests[1]));
+    cache.deinit();
+}
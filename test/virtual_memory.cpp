@@ -6,6 +6,8 @@
 #include "../src/platform/virtual_memory.h"
 
 #include <random>
+#include <thread>
+#include <atomic>
 
 TEST(TestVirtualMemory, TestVirtualMemory_NativeChar) {
     initFilesystem();
@@ -236,4 +238,149 @@ TEST(TestVirtualMemory, TestVirtualMemory_SpecialCases) {
     }
 
     test_vm.deinit();
-}
\ No newline at end of file
+}
+TEST(TestVirtualMemory, TestVirtualMemory_ConcurrentReadersSmallCache) {
+    initFilesystem();
+    registerAsynFileIO(NULL);
+    const unsigned long long name_u64 = 123456789;
+    const unsigned long long pageDir = 0;
+    const unsigned long long pageCap = 997;
+    VirtualMemory<unsigned long long, name_u64, pageDir, pageCap, 4> test_vm;
+    test_vm.init();
+
+    // readers check random and recent items (cache hits in current page, misses loading old pages) while appending
+    const unsigned long long N = 200000;
+    std::atomic<bool> done = false;
+    std::atomic<unsigned long long> errors = 0;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++)
+    {
+        readers.emplace_back([&, t]()
+            {
+                std::mt19937_64 gen(t);
+                unsigned long long buffer[3000];
+                while (!done)
+                {
+                    const unsigned long long size = test_vm.size();
+                    if (size < 3000)
+                        continue;
+                    const unsigned long long index = (gen() & 1) ? size - 1 - gen() % pageCap : gen() % size;
+                    if (test_vm[index] != index * 7 + 1)
+                        ++errors;
+                    const unsigned long long offset = gen() % (size - 3000);
+                    test_vm.getMany(buffer, offset, 3000);
+                    for (unsigned long long i = 0; i < 3000; i++)
+                        if (buffer[i] != (offset + i) * 7 + 1)
+                            ++errors;
+                }
+            });
+    }
+    for (unsigned long long i = 0; i < N; i++)
+    {
+        test_vm.append(i * 7 + 1);
+    }
+    done = true;
+    for (auto& reader : readers)
+        reader.join();
+    EXPECT_EQ(errors, 0);
+
+    // LRU: recently used page stays cached while other pages are loaded
+    std::mt19937_64 gen(42);
+    for (int i = 0; i < 1000; i++)
+    {
+        EXPECT_EQ(test_vm[5], 5 * 7 + 1);
+        const unsigned long long index = gen() % N;
+        EXPECT_EQ(test_vm[index], index * 7 + 1);
+    }
+    test_vm.deinit();
+}
+
+template <unsigned long long numCachePage, unsigned long long numReadAheadPages>
+static void testSequentialReadAhead()
+{
+    const unsigned long long name_u64 = 123456789;
+    const unsigned long long pageDir = 0;
+    const unsigned long long pageCap = 1000;
+    VirtualMemory<unsigned long long, name_u64, pageDir, pageCap, numCachePage, numReadAheadPages> test_vm;
+    test_vm.init();
+    const unsigned long long N = pageCap * 20 + 123;
+    for (unsigned long long i = 0; i < N; i++)
+        test_vm.append(i * 3 + 2);
+
+    // forward streaming (read-ahead), backward streaming (no read-ahead), and interleaved random reads
+    for (unsigned long long i = 0; i < N; i++)
+        EXPECT_EQ(test_vm[i], i * 3 + 2);
+    for (unsigned long long i = N; i-- > 0; )
+        EXPECT_EQ(test_vm[i], i * 3 + 2);
+    std::mt19937_64 gen(numCachePage);
+    for (unsigned long long i = 0; i < N; i += 7)
+    {
+        EXPECT_EQ(test_vm[i], i * 3 + 2);
+        const unsigned long long index = gen() % N;
+        EXPECT_EQ(test_vm[index], index * 3 + 2);
+    }
+    test_vm.deinit();
+}
+
+TEST(TestVirtualMemory, TestVirtualMemory_SequentialReadAhead) {
+    initFilesystem();
+    registerAsynFileIO(NULL);
+    testSequentialReadAhead<8, 2>();
+    testSequentialReadAhead<4, 4>();
+    testSequentialReadAhead<4, 0>();
+}
+
+TEST(TestVirtualMemory, TestVirtualMemory_CompressedPages) {
+    initFilesystem();
+    registerAsynFileIO(NULL);
+    const unsigned long long name_u64 = 123456789;
+    const unsigned long long pageDir = 0;
+    const unsigned long long pageCap = 1000;
+    VirtualMemory<unsigned long long, name_u64, pageDir, pageCap, 4, 1, true> test_vm;
+    test_vm.init();
+
+    // compressible pages (small values) and incompressible pages (random values, stored raw) are mixed
+    std::mt19937_64 gen(7);
+    std::vector<unsigned long long> arr(pageCap * 12 + 5);
+    for (size_t i = 0; i < arr.size(); i++)
+        arr[i] = ((i / pageCap) % 3 == 2) ? gen() : i % 17;
+    test_vm.appendMany(arr.data(), arr.size());
+
+    for (int i = 0; i < 2000; i++)
+    {
+        const unsigned long long index = gen() % arr.size();
+        EXPECT_EQ(test_vm[index], arr[index]);
+    }
+    std::vector<unsigned long long> fetcher(arr.size());
+    test_vm.getMany(fetcher.data(), 0, arr.size());
+    EXPECT_EQ(fetcher, arr);
+    test_vm.deinit();
+}
+
+TEST(TestVirtualMemory, TestVirtualMemory_CachedPagesOnly) {
+    initFilesystem();
+    registerAsynFileIO(NULL);
+    const unsigned long long name_u64 = 123456789;
+    const unsigned long long pageDir = 0;
+    const unsigned long long pageCap = 1000;
+    VirtualMemory<unsigned long long, name_u64, pageDir, pageCap, 4, 0> test_vm;
+    test_vm.init();
+    const unsigned long long N = pageCap * 10 + 123;
+    for (unsigned long long i = 0; i < N; i++)
+        test_vm.append(i * 5 + 3);
+
+    // current page and recently written pages are cached, old pages have to be loaded from disk
+    std::vector<unsigned long long> fetcher(2 * pageCap);
+    EXPECT_EQ(test_vm.getMany(fetcher.data(), N - 1500, 1500, true), 1500 * sizeof(unsigned long long));
+    for (unsigned long long i = 0; i < 1500; i++)
+        EXPECT_EQ(fetcher[i], (N - 1500 + i) * 5 + 3);
+    EXPECT_EQ(test_vm.getMany(fetcher.data(), 500, 1000, true), 0);
+    EXPECT_EQ(test_vm.getMany(fetcher.data(), 500, 1000), 1000 * sizeof(unsigned long long));
+    EXPECT_EQ(test_vm.getMany(fetcher.data() + pageCap, 500, 1000, true), 1000 * sizeof(unsigned long long));
+    for (unsigned long long i = 0; i < 1000; i++)
+    {
+        EXPECT_EQ(fetcher[i], (500 + i) * 5 + 3);
+        EXPECT_EQ(fetcher[pageCap + i], (500 + i) * 5 + 3);
+    }
+    test_vm.deinit();
+}
@@ -0,0 +1,91 @@
+#define NO_UEFI
+
+#include "gtest/gtest.h"
+
+#include "../src/ticking/vote_arrival_queue.h"
+
+#include <thread>
+#include <vector>
+
+TEST(TestVoteArrivalQueue, PushPopAndOverflow)
+{
+    VoteArrivalQueue<8>* queue = new VoteArrivalQueue<8>();
+    queue->reset();
+
+    unsigned int tick, computorIndex;
+    EXPECT_FALSE(queue->pop(tick, computorIndex));
+    EXPECT_FALSE(queue->checkAndClearOverflow());
+
+    // wrap around several times
+    for (unsigned int round = 0; round < 5; ++round)
+    {
+        for (unsigned int i = 0; i < 6; ++i)
+            EXPECT_TRUE(queue->push(1000 + round, i));
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            EXPECT_TRUE(queue->pop(tick, computorIndex));
+            EXPECT_EQ(tick, 1000 + round);
+            EXPECT_EQ(computorIndex, i);
+        }
+        EXPECT_FALSE(queue->pop(tick, computorIndex));
+    }
+    EXPECT_FALSE(queue->checkAndClearOverflow());
+
+    // fill queue, next push is dropped and reported
+    for (unsigned int i = 0; i < 8; ++i)
+        EXPECT_TRUE(queue->push(2000, i));
+    EXPECT_FALSE(queue->push(2000, 8));
+    EXPECT_TRUE(queue->checkAndClearOverflow());
+    EXPECT_FALSE(queue->checkAndClearOverflow());
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        EXPECT_TRUE(queue->pop(tick, computorIndex));
+        EXPECT_EQ(computorIndex, i);
+    }
+    EXPECT_FALSE(queue->pop(tick, computorIndex));
+
+    delete queue;
+}
+
+TEST(TestVoteArrivalQueue, ConcurrentProducers)
+{
+    constexpr unsigned int producerCount = 4;
+    constexpr unsigned int eventsPerProducer = 10000;
+    VoteArrivalQueue<256>* queue = new VoteArrivalQueue<256>();
+    queue->reset();
+
+    std::vector<std::thread> producers;
+    for (unsigned int p = 0; p < producerCount; ++p)
+    {
+        producers.emplace_back([queue, p]()
+            {
+                for (unsigned int i = 0; i < eventsPerProducer; ++i)
+                {
+                    while (!queue->push(p, i))
+                        _mm_pause();
+                }
+            });
+    }
+
+    // consume: events of each producer must arrive complete and in order
+    std::vector<unsigned int> nextExpected(producerCount, 0);
+    unsigned int received = 0;
+    while (received < producerCount * eventsPerProducer)
+    {
+        unsigned int tick, computorIndex;
+        if (queue->pop(tick, computorIndex))
+        {
+            ASSERT_LT(tick, producerCount);
+            EXPECT_EQ(computorIndex, nextExpected[tick]);
+            nextExpected[tick] = computorIndex + 1;
+            ++received;
+        }
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+    for (unsigned int p = 0; p < producerCount; ++p)
+        EXPECT_EQ(nextExpected[p], eventsPerProducer);
+
+    delete queue;
+}
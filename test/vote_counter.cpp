@@ -5,6 +5,8 @@
 #include "../src/public_settings.h"
 #include "../src/vote_counter.h"
 
+#include <chrono>
+#include <iostream>
 #include <random>
 
 
@@ -169,4 +171,103 @@ TEST(TestCoreVoteCounter, RegisterNewCompressVotes) {
         EXPECT_TRUE(isMatched);
         //printf("[PASSED] tick %u\n", tick);
     }
-}
\ No newline at end of file
+}
+
+TEST(TestCoreVoteCounter, TenBitsArrayPackUnpack) {
+    std::mt19937 gen32(42);
+    for (unsigned int count = 1; count <= 700; count++)
+    {
+        unsigned int values[700], unpacked[700];
+        unsigned char packed[900], expectedPacked[900];
+        for (unsigned int i = 0; i < 900; i++)
+            packed[i] = expectedPacked[i] = (unsigned char)gen32();
+        for (unsigned int i = 0; i < count; i++)
+            values[i] = gen32() % 1024;
+
+        // array functions match single number functions, bytes after packed data are kept
+        for (unsigned int i = 0; i < count; i++)
+            tvc.testUpdate10Bit(expectedPacked, i, values[i]);
+        pack10BitArray(values, packed, count);
+        EXPECT_EQ(memcmp(packed, expectedPacked, sizeof(packed)), 0) << "count " << count;
+
+        unpack10BitArray(packed, unpacked, count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            EXPECT_EQ(unpacked[i], values[i]) << "count " << count << ", index " << i;
+            EXPECT_EQ(tvc.testExtract10Bit(packed, i), values[i]) << "count " << count << ", index " << i;
+        }
+    }
+}
+
+TEST(TestCoreVoteCounter, TenBitsArrayPackUnpackPerformance) {
+    constexpr int N = 100000;
+    unsigned int values[NUMBER_OF_COMPUTORS];
+    unsigned char packed[VOTE_COUNTER_DATA_SIZE_IN_BYTES] = { 0 };
+    volatile unsigned int optimizeBarrier = 0;
+    for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+        values[i] = (i * 7) % 1024;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (int n = 0; n < N; n++)
+    {
+        values[0] = n % 1024;
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+            tvc.testUpdate10Bit(packed, i, values[i]);
+        for (unsigned int i = 0; i < NUMBER_OF_COMPUTORS; i++)
+            values[i] = tvc.testExtract10Bit(packed, i);
+        optimizeBarrier = values[NUMBER_OF_COMPUTORS - 1];
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::cout << N << " x pack and unpack " << NUMBER_OF_COMPUTORS << " numbers one by one: " << ms << " milliseconds" << std::endl;
+
+    t0 = std::chrono::high_resolution_clock::now();
+    for (int n = 0; n < N; n++)
+    {
+        values[0] = n % 1024;
+        pack10BitArray(values, packed, NUMBER_OF_COMPUTORS);
+        unpack10BitArray(packed, values, NUMBER_OF_COMPUTORS);
+        optimizeBarrier = values[NUMBER_OF_COMPUTORS - 1];
+    }
+    t1 = std::chrono::high_resolution_clock::now();
+    ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::cout << N << " x pack and unpack " << NUMBER_OF_COMPUTORS << " numbers as array: " << ms << " milliseconds" << std::endl;
+
+    EXPECT_EQ(optimizeBarrier, (NUMBER_OF_COMPUTORS - 1) * 7 % 1024);
+}
+
+TEST(TestCoreVoteCounter, SaveLoadAndWindowReuse) {
+    unsigned char data_u10[848] = { 0 };
+    unsigned char savedData[VoteCounter::VoteCounterDataSize];
+    tvc.init();
+
+    // all computors vote for tick 1000, every second computor for tick 1001
+    for (unsigned int i = 0; i < 676; i++)
+    {
+        tvc.registerNewVote(1000, i);
+        if (i % 2 == 0)
+            tvc.registerNewVote(1001, i);
+    }
+    tvc.saveAllDataToArray(savedData);
+
+    TestVoteCounter* loaded = new TestVoteCounter();
+    loaded->init();
+    loaded->loadAllDataFromArray(savedData);
+    loaded->compressNewVotesPacket(1000, 1002, 5, data_u10);
+    for (unsigned int i = 0; i < 676; i++)
+    {
+        unsigned int expected = (i == 5) ? 0 : ((i % 2 == 0) ? 2 : 1);
+        EXPECT_EQ(loaded->testExtract10Bit(data_u10, i), expected);
+    }
+
+    // slot of tick 1000 is reused by tick 1000 + 2 * 676, which only has vote of computor 3
+    loaded->registerNewVote(1000 + 2 * 676, 3);
+    loaded->compressNewVotesPacket(1000, 1001, 5, data_u10);
+    for (unsigned int i = 0; i < 676; i++)
+        EXPECT_EQ(loaded->testExtract10Bit(data_u10, i), 0);
+    loaded->compressNewVotesPacket(1000 + 2 * 676, 1000 + 2 * 676 + 1, 5, data_u10);
+    for (unsigned int i = 0; i < 676; i++)
+        EXPECT_EQ(loaded->testExtract10Bit(data_u10, i), (i == 3) ? 1 : 0);
+
+    delete loaded;
+}